@@ -0,0 +1,60 @@
+/** @file
+    Fast gain control, steps the tuner gain from the clipping of the input samples.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_AGC_H_
+#define INCLUDE_AGC_H_
+
+#include <stdint.h>
+
+struct baseband_clip;
+
+/// Headroom below full scale in dB the gain is raised to, unless set with -Y agc.
+#define AGC_HEADROOM_DB 12.0f
+
+/// Gain control state.
+typedef struct agc {
+    float gain;          ///< the commanded tuner gain in dB
+    float headroom;      ///< raise the gain while the peak stays below full scale less this many dB
+    uint64_t settle;     ///< samples to skip until the last gain step applies
+    uint64_t quiet;      ///< samples with the peak below the headroom
+    unsigned steps_up;   ///< gain steps up so far
+    unsigned steps_down; ///< gain steps down so far
+} agc_t;
+
+/** Create a gain control.
+
+    @param gain_str the initial tuner gain, NULL or empty for the start gain of the tuner auto gain
+    @param headroom the headroom in dB, 0 for the default
+    @return the new gain control or NULL on alloc failure
+*/
+agc_t *agc_create(char const *gain_str, float headroom);
+
+void agc_free(agc_t *agc);
+
+/** Restart the gain control from a gain, e.g. set with the gain RPC.
+
+    @param agc the gain control
+    @param gain_str the tuner gain, NULL, empty, or 0 for the start gain
+*/
+void agc_set_gain(agc_t *agc, char const *gain_str);
+
+/** Check the clipping of an input buffer and step the gain.
+
+    The gain steps down at once if more than one sample in 10000 is clipped,
+    and steps up if the peak stayed below the headroom for a second. Between
+    the two the gain holds, the steps wait for the tuner to settle.
+
+    @param agc the gain control
+    @param clip the clipping of the buffer
+    @param samp_rate the sample rate
+    @return 1 if the gain changed, 0 otherwise
+*/
+int agc_update(agc_t *agc, struct baseband_clip const *clip, uint32_t samp_rate);
+
+#endif /* INCLUDE_AGC_H_ */
@@ -0,0 +1,55 @@
+/** @file
+    Heap allocation counters, for the allocations of each pipeline stage.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_ALLOC_COUNT_H_
+#define INCLUDE_ALLOC_COUNT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Heap allocations and frees of a thread.
+typedef struct alloc_count {
+    uint64_t allocs; ///< calls to malloc, calloc, realloc, and strdup
+    uint64_t frees;  ///< calls to free with a pointer
+} alloc_count_t;
+
+/// Returns 1 if the build counts the allocations, see ENABLE_ALLOC_COUNT.
+int alloc_count_enabled(void);
+
+/** Get the allocations of the calling thread so far.
+
+    The allocations are counted by wrapping the allocation functions at link time,
+    allocations inside the C library, e.g. by fopen(), are not counted.
+    @return the counts, zero if the build does not count the allocations
+*/
+alloc_count_t alloc_count_get(void);
+
+/** Get the bytes of all threads in live heap allocations.
+
+    Counted with the allocations where the C library tells the size of a block (glibc),
+    blocks allocated inside the C library and freed by the caller are not matched.
+    @return the bytes, 0 if the build does not count the allocations or the size is unknown
+*/
+uint64_t alloc_count_heap_bytes(void);
+
+/** Get the usable size of a heap block, for structures without a known size.
+
+    @param ptr a block of malloc(), calloc(), realloc(), or strdup(), may be NULL
+    @return the size in bytes, 0 if NULL or the C library does not tell the size
+*/
+size_t alloc_block_size(void const *ptr);
+
+/** Free a block the C library allocated, e.g. the result of realpath().
+
+    The block was not counted, it must not be subtracted from the live heap bytes.
+    @param ptr a block allocated inside the C library, may be NULL
+*/
+void alloc_count_free_libc(void *ptr);
+
+#endif /* INCLUDE_ALLOC_COUNT_H_ */
@@ -15,7 +15,7 @@
 #include <stdint.h>
 #include "samp_grab.h"
 
-#define PULSE_DATA_SIZE 4000 /* maximum number of pulses */
+#define PULSE_DATA_SIZE 4000 /* maximum number of pulses classified as one batch */
 
 typedef struct am_analyze {
     int level_limit;
@@ -36,7 +36,9 @@ typedef struct am_analyze {
     unsigned pulse_avg;
     unsigned signal_start;
     unsigned signal_pulse_counter;
-    unsigned signal_pulse_data[4000][3];
+    unsigned signal_pulse_size;        ///< capacity of the pulse store, grown up to PULSE_DATA_SIZE
+    unsigned (*signal_pulse_data)[3];  ///< start, end, and length of each pulse
+    unsigned *signal_distance_data;    ///< the gaps between the pulses, for the classification
 } am_analyze_t;
 
 /// Create an AM-Analyzer. Might fail and return NULL.
@@ -46,8 +48,14 @@ void am_analyze_free(am_analyze_t *a);
 
 void am_analyze_skip(am_analyze_t *a, unsigned n_samples);
 
+/** Find the pulses and signals of a buffer above the level limit.
+
+    The threshold crossings are searched in blocks, a signal is classified when
+    it ends, or as a batch once PULSE_DATA_SIZE pulses are stored.
+*/
 void am_analyze(am_analyze_t *a, int16_t *am_buf, unsigned n_samples, int debug_output, samp_grab_t *g);
 
+/// Classify and print the stored pulses, then clear them.
 void am_analyze_classify(am_analyze_t *aa);
 
 #endif /* INCLUDE_AM_ANALYZE_H_ */
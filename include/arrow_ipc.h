@@ -0,0 +1,109 @@
+/** @file
+    Arrow IPC file writer, the columnar container of the pulse and event exports.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_ARROW_IPC_H_
+#define INCLUDE_ARROW_IPC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// The column types, a list has int32 items.
+enum arrow_type {
+    ARROW_INT32,
+    ARROW_INT64,
+    ARROW_FLOAT32,
+    ARROW_FLOAT64,
+    ARROW_UTF8,
+    ARROW_LIST_INT32,
+};
+
+typedef struct arrow_column {
+    char const *name;
+    enum arrow_type type;
+    int nullable;
+} arrow_column_t;
+
+/** The body of a record batch, the buffers of the columns in schema order.
+
+    A column has a node and a validity buffer (empty if there are no nulls), then
+    an int32 offsets buffer for utf8 and list, and the values buffer.
+    A list adds the node, validity, and values buffers of the items.
+*/
+typedef struct arrow_body {
+    uint8_t *buf;
+    size_t len;
+    size_t size;
+    uint64_t *nodes;   ///< length and null count of each node
+    unsigned num_nodes;
+    unsigned nodes_size;
+    uint64_t *buffers; ///< offset and length of each buffer
+    unsigned num_buffers;
+    unsigned buffers_size;
+    int failed; ///< an alloc failed, the batch is not written
+} arrow_body_t;
+
+typedef struct arrow_ipc arrow_ipc_t;
+
+/** Start an Arrow IPC file (Feather V2), the schema is written here.
+
+    @param file the file to write, opened for writing at the start
+    @param columns the schema, the names are copied into the schema message
+    @param num_columns the number of columns
+    @return the new writer or NULL on alloc failure
+*/
+arrow_ipc_t *arrow_ipc_create(FILE *file, arrow_column_t const *columns, unsigned num_columns);
+
+/** Add a node of a column to the body.
+
+    @param body the body to add to
+    @param length the number of values
+    @param null_count the number of nulls
+*/
+void arrow_body_node(arrow_body_t *body, size_t length, size_t null_count);
+
+/** Add a buffer to the body, the data is padded to 8 bytes.
+
+    @param body the body to add to
+    @param len the length of the buffer in bytes
+    @return the zeroed buffer to fill in, valid until the next buffer is added, NULL on alloc failure
+*/
+uint8_t *arrow_body_buffer(arrow_body_t *body, size_t len);
+
+/// Clear the body to build the next batch, the allocations are kept.
+void arrow_body_reset(arrow_body_t *body);
+
+/// Free the allocations of the body.
+void arrow_body_free(arrow_body_t *body);
+
+/** Write a record batch.
+
+    @param w the writer
+    @param length the number of rows
+    @param body the buffers of the columns
+*/
+void arrow_ipc_write_batch(arrow_ipc_t *w, size_t length, arrow_body_t const *body);
+
+/** Write the end marker and the footer, and free the writer.
+
+    The file is flushed but not closed.
+
+    @param w the writer, NULL is ignored
+    @return 0 on success, -1 if the file is incomplete
+*/
+int arrow_ipc_close(arrow_ipc_t *w);
+
+/// Put a little-endian value of 1 to 8 bytes.
+static inline void arrow_put(uint8_t *p, uint64_t v, unsigned size)
+{
+    for (unsigned i = 0; i < size; ++i)
+        p[i] = (uint8_t)(v >> (i * 8));
+}
+
+#endif /* INCLUDE_ARROW_IPC_H_ */
@@ -16,6 +16,23 @@
 #include <stdint.h>
 #include <math.h>
 
+/// SIMD kernel implementations.
+enum baseband_simd {
+    BASEBAND_SIMD_NONE, ///< scalar reference kernels
+    BASEBAND_SIMD_SSE2,
+    BASEBAND_SIMD_AVX2,
+    BASEBAND_SIMD_NEON,
+    BASEBAND_SIMD_END,
+};
+
+/// CU8 envelope kernel implementations, all give identical output.
+enum baseband_envelope {
+    BASEBAND_ENVELOPE_LUT,  ///< 256 entry squares LUT (512 bytes), the reference
+    BASEBAND_ENVELOPE_MUL,  ///< integer multiply, no table
+    BASEBAND_ENVELOPE_SIMD, ///< multiply-add with the selected SIMD level
+    BASEBAND_ENVELOPE_END,
+};
+
 /** This will give a noisy envelope of OOK/ASK signals.
 
     Subtract the bias (-128) and get an envelope estimation (absolute squared).
@@ -32,6 +49,7 @@ float magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
 float magnitude_true_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
 float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len);
 float magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+float magnitude_est_cf32(float const *iq_buf, uint16_t *y_buf, uint32_t len);
 
 #define AMP_TO_DB(x) (10.0f * ((x) > 0 ? log10f(x) : 0) - 42.1442f)  // 10*log10f(16384.0f)
 #define MAG_TO_DB(x) (20.0f * ((x) > 0 ? log10f(x) : 0) - 84.2884f)  // 20*log10f(16384.0f)
@@ -87,16 +105,36 @@ tabulated magnitude and amplitude values:
 
 #define FILTER_ORDER 1
 
+/// Maximum number of biquad sections, i.e. a maximum Butterworth order of 8.
+#define FILTER_MAX_SECTIONS 4
+
 /// Filter state buffer.
 typedef struct filter_state {
     int16_t y[FILTER_ORDER];
-    int16_t x[FILTER_ORDER];
+    uint16_t x[FILTER_ORDER];
+    int order;         ///< Butterworth order, 0 or 1 without a cutoff for the fixed 1st order filter, up to 2 * FILTER_MAX_SECTIONS
+    float cutoff;      ///< Cutoff frequency in Hz, 0 for 0.025 of the sample rate (as the fixed filter)
+    uint32_t rate;     ///< Sample rate the biquad coeffs are set up for
+    int sections;      ///< Number of biquad sections in use, 0 for the fixed filter
+    float b[FILTER_MAX_SECTIONS][3]; ///< Biquad B coeffs
+    float a[FILTER_MAX_SECTIONS][2]; ///< Biquad A coeffs, a0 is 1
+    float z[FILTER_MAX_SECTIONS][2]; ///< Biquad state, transposed direct form II
 } filter_state_t;
 
+/// FM discriminator precision.
+enum baseband_fm_mode {
+    BASEBAND_FM_INT,     ///< integer atan2, max error 0.07 radians (default)
+    BASEBAND_FM_FAST,    ///< vectorized first order atan2 approximation, max error 0.004 radians
+    BASEBAND_FM_PRECISE, ///< vectorized polynomial atan2 approximation, max error 1e-5 radians
+};
+
 /// FM_Demod state buffer.
 typedef struct demodfm_state {
+    int mode;          ///< Discriminator precision, a BASEBAND_FM_ mode
     int32_t xr;        ///< Last I/Q sample, real part
     int32_t xi;        ///< Last I/Q sample, imag part
+    float xr_f;        ///< Last CF32 I/Q sample, real part
+    float xi_f;        ///< Last CF32 I/Q sample, imag part
     int32_t xf;        ///< Last Instantaneous frequency
     int32_t yf;        ///< Last Instantaneous frequency, low pass filtered
     uint32_t rate;     ///< Current sample rate
@@ -106,6 +144,30 @@ typedef struct demodfm_state {
     int64_t blp_32[2]; ///< Current low pass filter B coeffs, 32 bit
 } demodfm_state_t;
 
+/// DC offset and IQ imbalance correction state.
+typedef struct iq_correct_state {
+    int enabled;  ///< apply the correction to CU8 input
+    int init;     ///< estimates are valid
+    float dc_i;   ///< running DC estimate, I
+    float dc_q;   ///< running DC estimate, Q
+    float pow_i;  ///< running I power estimate
+    float pow_q;  ///< running Q power estimate
+    float pow_iq; ///< running I/Q cross power estimate
+} iq_correct_state_t;
+
+/** DC offset and IQ imbalance correction, CU8 samples.
+
+    Removes the DC offset, then orthogonalizes Q against I and matches the Q gain to I.
+    The estimates are updated once per buffer, the correction is block constant
+    so both passes are simple loops which vectorize well.
+    Function is stateful.
+    @param iq_buf input samples (I/Q samples in interleaved uint8)
+    @param[out] out_buf corrected output samples, may be the same as iq_buf
+    @param len number of samples to process
+    @param[in,out] state State to store between chunk processing
+*/
+void baseband_iq_correct_cu8(uint8_t const *iq_buf, uint8_t *out_buf, uint32_t len, iq_correct_state_t *state);
+
 /** Lowpass filter.
 
     Function is stateful.
@@ -116,6 +178,38 @@ typedef struct demodfm_state {
 */
 void baseband_low_pass_filter(uint16_t const *x_buf, int16_t *y_buf, uint32_t len, filter_state_t *state);
 
+/** Compress a low pass filtered envelope to a saturating 8-bit log scale.
+
+    Levels up to 31 are kept, above that each octave has 16 steps (about 4%),
+    INT16_MAX is code 191, negative levels are code 0. The codes are monotonic in the level,
+    a search on the codes finds candidates that are then checked on the envelope,
+    see envelope_find_above_8bit(). The loop is branch-free to vectorize.
+    @param am_buf low pass filtered envelope
+    @param[out] am8_buf 8-bit codes of the envelope
+    @param len number of samples to process
+*/
+void baseband_envelope_8bit(int16_t const *am_buf, uint8_t *am8_buf, uint32_t len);
+
+/// The 8-bit code of an envelope level, see baseband_envelope_8bit().
+int envelope_8bit_code(int level);
+
+/// The lowest envelope level with an 8-bit code, INT16_MIN for code 0.
+int envelope_8bit_min(int code);
+
+/// The highest envelope level with an 8-bit code.
+int envelope_8bit_max(int code);
+
+/** Set up the low pass filter for a sample rate.
+
+    With an order above 1, or order 1 and a cutoff, a Butterworth filter
+    cascade is designed for the cutoff frequency, otherwise the fixed 1st
+    order filter is used.
+    The coeffs are only computed if the sample rate changed, the filter state is kept.
+    @param[in,out] state filter state with the order and cutoff frequency set
+    @param samp_rate sample rate
+*/
+void baseband_low_pass_set_rate(filter_state_t *state, uint32_t samp_rate);
+
 /** FM demodulator.
 
     Function is stateful.
@@ -130,8 +224,112 @@ void baseband_demod_FM(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_s
 /// For evaluation.
 void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state);
 
-/** Initialize tables and constants.
-    Should be called once at startup.
+/** Fused AM and FM demodulator, CU8 samples.
+
+    Equivalent to envelope_detect() (or magnitude_est_cu8()), baseband_low_pass_filter()
+    and baseband_demod_FM(), but processes the samples in cache-sized tiles
+    so each IQ sample is only fetched from memory once.
+    Function is stateful.
+    @param iq_buf input samples (I/Q samples in interleaved uint8)
+    @param[out] am_buf output from the AM demodulator, low pass filtered envelope
+    @param[out] fm_buf output from the FM demodulator, NULL to skip FM demodulation
+    @param num_samples number of samples to process
+    @param samp_rate sample rate
+    @param low_pass FM low-pass filter frequency or ratio
+    @param use_mag_est use the magnitude estimate instead of the envelope for AM
+    @param[in,out] lp_state AM low pass filter state
+    @param[in,out] fm_state FM demodulator state
+    @return the average level in dB
+*/
+float baseband_demod_AM_FM(uint8_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state);
+
+/// Fused AM and FM demodulator, CS16 samples, always uses the magnitude estimate.
+float baseband_demod_AM_FM_cs16(int16_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, filter_state_t *lp_state, demodfm_state_t *fm_state);
+
+/// FM demodulator, CF32 samples, always uses a float discriminator.
+void baseband_demod_FM_cf32(float const *x_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state);
+
+/// Fused AM and FM demodulator, CS8 samples, the output is identical to CU8 samples.
+float baseband_demod_AM_FM_cs8(int8_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state);
+
+/// Fused AM and FM demodulator, CF32 samples, always uses the magnitude estimate, scaled as CS16.
+float baseband_demod_AM_FM_cf32(float const *iq_buf, int16_t *am_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, filter_state_t *lp_state, demodfm_state_t *fm_state);
+
+/// Full scale of the clipping statistics, the components are counted on a CS16 scale.
+#define BASEBAND_CLIP_FS 32768
+
+/** Clipping statistics of the input samples, counted along with the envelope.
+
+    A component within 1/128 of full scale, e.g. 0, 1, or 255 for CU8, counts as clipped:
+    the ADC saturates. Both components within 1/128 of zero count as near zero:
+    the gain is too low to use the ADC range.
+*/
+typedef struct baseband_clip {
+    uint32_t samples;   ///< I/Q samples counted
+    uint32_t clipped;   ///< samples with I or Q near full scale
+    uint32_t near_zero; ///< samples with I and Q near zero
+    uint32_t peak;      ///< the largest I or Q, BASEBAND_CLIP_FS is full scale
+} baseband_clip_t;
+
+/// The peak of the clipping statistics in dB relative to full scale.
+float baseband_clip_peak_dbfs(baseband_clip_t const *clip);
+
+/// Baseband kernels for one I/Q sample format, the samples are processed without conversion.
+typedef struct baseband_kernels {
+    uint32_t format; ///< I/Q sample format, CU8_IQ, CS16_IQ, CS8_IQ, or CF32_IQ
+    int sample_size; ///< bytes per I/Q sample
+    /// Envelope or magnitude estimate, returns the average level in dB, adds to the clipping statistics unless NULL.
+    float (*envelope)(void const *iq_buf, uint16_t *y_buf, uint32_t len, int use_mag_est, baseband_clip_t *clip);
+    /// FM demodulator, see baseband_demod_FM().
+    void (*demod_FM)(void const *iq_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state);
+    /// Fused AM and FM demodulator, see baseband_demod_AM_FM(), adds to the clipping statistics unless NULL,
+    /// also writes the 8-bit envelope by tiles unless am8_buf is NULL, see baseband_envelope_8bit().
+    float (*demod_AM_FM)(void const *iq_buf, int16_t *am_buf, uint8_t *am8_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state, baseband_clip_t *clip);
+    /// Only count the clipping statistics, for inputs that are demodulated after conversion.
+    void (*clip_count)(void const *iq_buf, uint32_t len, baseband_clip_t *clip);
+} baseband_kernels_t;
+
+/** Look up the baseband kernels for a sample format.
+
+    @param format a file_info_t I/Q format, or 0 to select by sample size (SDR input)
+    @param sample_size bytes per I/Q sample, e.g. from sdr_get_sample_size(), 2 is CU8 and 4 is CS16
+    @return the kernels, or NULL if the format is not supported
+*/
+baseband_kernels_t const *baseband_get_kernels(uint32_t format, int sample_size);
+
+/** Select the SIMD kernels for envelope_detect(), magnitude_est_cu8(), magnitude_est_cs16()
+    and the float FM discriminators.
+
+    The kernels are bit-identical to the scalar reference.
+    @param level a BASEBAND_SIMD_ level, or -1 to select the best supported level
+    @return the selected level, or -1 if the level is not supported on this CPU
+*/
+int baseband_set_simd(int level);
+
+/// Return the currently selected SIMD level.
+int baseband_get_simd(void);
+
+/// Return a name for a SIMD level.
+char const *baseband_simd_str(int level);
+
+/** Select the envelope kernel for envelope_detect().
+
+    The SIMD kernel follows the level set with baseband_set_simd(),
+    with the scalar level it falls back to the LUT until a SIMD level is selected again.
+    @param kernel a BASEBAND_ENVELOPE_ kernel, or -1 to time each kernel and select the fastest
+    @return the selected kernel, or -1 if the kernel is not supported
+*/
+int baseband_set_envelope(int kernel);
+
+/// Return the currently selected envelope kernel.
+int baseband_get_envelope(void);
+
+/// Return a name for an envelope kernel.
+char const *baseband_envelope_str(int kernel);
+
+/** Select the kernels at startup.
+    Selects the best SIMD kernels and the envelope kernel (build option BASEBAND_ENVELOPE,
+    default is to calibrate). Only the first call selects, the tables are constant.
 */
 void baseband_init(void);
 
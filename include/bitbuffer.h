@@ -33,6 +33,7 @@ typedef bitrow_t bitarray_t[BITBUF_ROWS];
 typedef struct bitbuffer {
     uint16_t num_rows;                      ///< Number of active rows
     uint16_t free_row;                      ///< Index of next free row
+    uint16_t dirty_rows;                    ///< Rows below may hold data, all rows from there on are zero, see bitbuffer_reset()
     uint16_t bits_per_row[BITBUF_ROWS];     ///< Number of active bits per row
     uint16_t syncs_before_row[BITBUF_ROWS]; ///< Number of sync pulses before row
     bitarray_t bb;                          ///< The actual bits buffer
@@ -41,9 +42,28 @@ typedef struct bitbuffer {
 /// Clear the content of the bitbuffer.
 void bitbuffer_clear(bitbuffer_t *bits);
 
+/// Initialize a bitbuffer, the whole bitbuffer is cleared once.
+void bitbuffer_init(bitbuffer_t *bits);
+
+/// Clear the content of the bitbuffer, only the rows that were started are cleared.
+///
+/// The rows must be started with the bitbuffer functions, not directly,
+/// the rows past the rows in use then stay zero as the decoders expect.
+void bitbuffer_reset(bitbuffer_t *bits);
+
+/// Copy the rows in use of a bitbuffer, the other rows of an initialized dst are cleared.
+void bitbuffer_copy(bitbuffer_t *dst, bitbuffer_t const *src);
+
 /// Add a single bit at the end of the bitbuffer (MSB first).
 void bitbuffer_add_bit(bitbuffer_t *bits, int bit);
 
+/// Add a number of bits to the current (last) row, the first bit is the highest of the
+/// 'count' low bits of 'value'. At most 32 bits are added.
+void bitbuffer_add_bits(bitbuffer_t *bits, uint32_t value, unsigned count);
+
+/// Add a run of 'count' identical bits to the current (last) row.
+void bitbuffer_add_run(bitbuffer_t *bits, int bit, unsigned count);
+
 /// Add a new row to the bitbuffer.
 void bitbuffer_add_row(bitbuffer_t *bits);
 
@@ -54,6 +74,12 @@ void bitbuffer_add_sync(bitbuffer_t *bits);
 void bitbuffer_extract_bytes(bitbuffer_t *bitbuffer, unsigned row,
         unsigned pos, uint8_t *out, unsigned len);
 
+/// Extract a (potentially unaligned) number of up to 32 bits, MSB first. Len is bits.
+uint32_t bitbuffer_extract_u32(bitbuffer_t const *bitbuffer, unsigned row, unsigned pos, unsigned len);
+
+/// Extract a (potentially unaligned) number of up to 64 bits, MSB first. Len is bits.
+uint64_t bitbuffer_extract_u64(bitbuffer_t const *bitbuffer, unsigned row, unsigned pos, unsigned len);
+
 /// Invert all bits in the bitbuffer (do not invert the empty bits).
 void bitbuffer_invert(bitbuffer_t *bits);
 
@@ -102,9 +128,29 @@ void bitbuffer_parse(bitbuffer_t *bits, const char *code);
 /// of the row if no match is found.
 /// The pattern starts in the high bit. For example if searching for 011011
 /// the byte pointed to by 'pattern' would be 0xAC. (011011xx).
+/// Nothing is found once the decoder is over its time budget, see decode_budget.h.
 unsigned bitbuffer_search(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
         const uint8_t *pattern, unsigned pattern_bits_len);
 
+/// A search pattern prepared for bitbuffer_search_pattern().
+typedef struct bitbuffer_pattern {
+    const uint8_t *pattern; ///< The pattern bytes, starting in the high bit
+    unsigned len;           ///< Number of bits in the pattern
+    uint64_t bits;          ///< The first 64 bits of the pattern, starting in the high bit
+    uint64_t mask;          ///< Mask of the pattern bits in `bits`
+} bitbuffer_pattern_t;
+
+/// Prepare a pattern to search for, the pattern bytes must stay valid.
+///
+/// Patterns of up to 64 bits are matched a word at a time.
+void bitbuffer_pattern_init(bitbuffer_pattern_t *pattern, const uint8_t *pattern_bits, unsigned pattern_bits_len);
+
+/// Search the specified row of the bitbuffer, starting from bit 'start', for
+/// a prepared pattern. Return the location of the first match, or the end
+/// of the row if no match is found. Same as bitbuffer_search().
+unsigned bitbuffer_search_pattern(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        bitbuffer_pattern_t const *pattern);
+
 /// Manchester decoding from one bitbuffer into another, starting at the
 /// specified row and start bit. Decode at most 'max' data bits (i.e. 2*max)
 /// bits from the input buffer). Return the bit position in the input row
@@ -113,6 +159,12 @@ unsigned bitbuffer_search(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
 unsigned bitbuffer_manchester_decode(bitbuffer_t *inbuf, unsigned row, unsigned start,
         bitbuffer_t *outbuf, unsigned max);
 
+/// Manchester decoding of a row into a byte buffer, same as bitbuffer_manchester_decode()
+/// without a second bitbuffer. Decode at most 'max' data bits into 'out', which must hold
+/// (max + 7) / 8 bytes and is cleared first. Return the number of bits decoded.
+unsigned bitbuffer_manchester_decode_row(bitbuffer_t *inbuf, unsigned row, unsigned start,
+        uint8_t *out, unsigned max);
+
 /// Differential Manchester decoding from one bitbuffer into another, starting at the
 /// specified row and start bit. Decode at most 'max' data bits (i.e. 2*max)
 /// bits from the input buffer). Return the bit position in the input row
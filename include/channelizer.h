@@ -0,0 +1,104 @@
+/** @file
+    Channelizer, splits one wideband capture into decimated sub-channels.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_CHANNELIZER_H_
+#define INCLUDE_CHANNELIZER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "list.h"
+
+/// Maximum number of sub-channels.
+#define CHANNELIZER_MAX_CHANNELS 32
+
+/// Taps per decimation step for the channel low pass filter.
+#define CHANNELIZER_TAPS_PER_STEP 8
+
+/// A sub-channel, mixed to baseband, low pass filtered and decimated.
+typedef struct channel {
+    uint32_t frequency;   ///< requested channel center frequency
+    uint32_t sample_rate; ///< requested channel sample rate
+    uint32_t out_rate;    ///< actual channel sample rate, input rate over decimation
+    unsigned decimation;  ///< input samples per output sample, 0 if the channel is out of band
+    unsigned skip;        ///< input samples to skip until the next output sample
+    unsigned num_taps;
+    float *taps;          ///< low pass filter coeffs
+    float lo_re;          ///< local oscillator, real part
+    float lo_im;          ///< local oscillator, imag part
+    float step_re;        ///< local oscillator step, real part
+    float step_im;        ///< local oscillator step, imag part
+    float *mix_buf;       ///< mixed I/Q, num_taps - 1 history samples followed by the current input
+    unsigned long mix_size;
+    int16_t *out_buf;     ///< CS16 output samples
+    unsigned long out_len;
+    unsigned long out_size;
+    uint64_t out_pos;     ///< output samples processed, maintained by the caller
+    float const *in_buf;  ///< current input, set for the worker
+    unsigned long in_len;
+} channel_t;
+
+/// Compute backends of the channelizer.
+typedef enum channelizer_backend {
+    CHANNELIZER_CPU,    ///< the channels on a pool of worker threads
+    CHANNELIZER_OPENCL, ///< all channels on an OpenCL device, see channelizer_cl.h
+} channelizer_backend_t;
+
+/// Channelizer state.
+typedef struct channelizer {
+    list_t channels;      ///< list of channel_t
+    uint32_t center_frequency; ///< input center frequency the channels are set up for
+    uint32_t samp_rate;   ///< input sample rate the channels are set up for
+    float *in_buf;        ///< input converted to float, scaled to Q0.15
+    unsigned long in_size;
+    struct channelizer_cl *cl; ///< the OpenCL backend, NULL to process on the CPU
+    struct decoder_pool *pool; ///< the workers for the channels, NULL for a single channel
+} channelizer_t;
+
+channelizer_t *channelizer_create(void);
+
+void channelizer_free(channelizer_t *chz);
+
+/// Get the bytes of the channelizer and the buffers of all channels, 0 if chz is NULL.
+size_t channelizer_memory(channelizer_t const *chz);
+
+/** Select the compute backend, the CPU is the default.
+
+    If the backend fails later on the channels are processed on the CPU again.
+    @param chz the channelizer
+    @param backend the backend
+    @param device for OpenCL the platform and device index as "<platform>[.<device>]", NULL for the first GPU
+    @return 0 on success, -1 if the backend is not available, the CPU stays selected
+*/
+int channelizer_set_backend(channelizer_t *chz, channelizer_backend_t backend, char const *device);
+
+/** Add a sub-channel.
+
+    @param chz the channelizer
+    @param frequency channel center frequency
+    @param sample_rate wanted channel sample rate, the actual rate will be the input rate over an integer decimation
+    @return the new channel or NULL on error
+*/
+channel_t *channelizer_add(channelizer_t *chz, uint32_t frequency, uint32_t sample_rate);
+
+/** Process a buffer of input samples into the sub-channels.
+
+    If the center frequency or sample rate changed, the oscillators and filters are set up again.
+    Channels outside of the captured bandwidth produce no output.
+    With threads support the channels are processed in parallel on workers started once,
+    with the OpenCL backend all channels are processed in batches on the device.
+    @param chz the channelizer
+    @param iq_buf input I/Q samples, CU8 or CS16
+    @param n_samples number of input samples
+    @param sample_size 2 for CU8, 4 for CS16
+    @param center_frequency input center frequency
+    @param samp_rate input sample rate
+*/
+void channelizer_process(channelizer_t *chz, uint8_t const *iq_buf, unsigned long n_samples, int sample_size, uint32_t center_frequency, uint32_t samp_rate);
+
+#endif /* INCLUDE_CHANNELIZER_H_ */
@@ -0,0 +1,51 @@
+/** @file
+    OpenCL backend of the channelizer, mixes, filters, and decimates all sub-channels on a GPU.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_CHANNELIZER_CL_H_
+#define INCLUDE_CHANNELIZER_CL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Input samples per block, the blocks alternate between two sets of device buffers.
+#define CHANNELIZER_CL_BLOCK 65536
+
+struct channelizer;
+
+typedef struct channelizer_cl channelizer_cl_t;
+
+/** Open an OpenCL device and build the channel kernel.
+
+    @param device the platform and device index as "<platform>[.<device>]", NULL for the first GPU or else the first device
+    @return the backend, or NULL on error or if built without OpenCL support
+*/
+channelizer_cl_t *channelizer_cl_create(char const *device);
+
+void channelizer_cl_free(channelizer_cl_t *cl);
+
+/// Get the bytes of the host buffers of the backend, 0 if cl is NULL.
+size_t channelizer_cl_memory(channelizer_cl_t const *cl);
+
+/** Process a buffer of input samples into the sub-channels on the device.
+
+    The raw samples are uploaded, the channels are set up by the caller.
+    The blocks of a buffer are double buffered: while the device filters a block
+    the next block is uploaded and the outputs of the previous block are copied out.
+    On error the channel state is kept as it was before the call.
+    @param cl the backend
+    @param chz the channelizer, the channels get the output samples
+    @param iq_buf input I/Q samples, CU8 or CS16
+    @param n_samples number of input samples
+    @param sample_size 2 for CU8, 4 for CS16
+    @param setup the channels were set up again since the last call
+    @return 0 on success, -1 on error
+*/
+int channelizer_cl_process(channelizer_cl_t *cl, struct channelizer *chz, uint8_t const *iq_buf, unsigned long n_samples, int sample_size, int setup);
+
+#endif /* INCLUDE_CHANNELIZER_CL_H_ */
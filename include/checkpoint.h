@@ -0,0 +1,53 @@
+/** @file
+    Checkpoints of an offline run, to resume an interrupted run of the input files.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_CHECKPOINT_H_
+#define INCLUDE_CHECKPOINT_H_
+
+#include <stdint.h>
+#include "baseband.h"
+#include "pulse_detect.h"
+
+/// Length of the input file name kept with a checkpoint, including the terminator.
+#define CHECKPOINT_NAME_SIZE 1024
+
+/// The position and the demod state of an offline run at the end of a block, see -Y checkpoint.
+typedef struct checkpoint {
+    uint32_t file_index;  ///< the input file to continue with, the number of files if all are done
+    uint64_t file_sample; ///< the samples of the input file that are processed
+    uint64_t input_pos;   ///< the samples of all input files that are processed
+    uint64_t events;      ///< the events output, the last sequence number with -M seq
+    float noise_level;
+    float min_level_auto;
+    filter_state_t lowpass_filter_state;
+    demodfm_state_t demod_FM_state;
+    iq_correct_state_t iq_correct_state;
+    pulse_detect_state_t pulse_detect;
+    char file_name[CHECKPOINT_NAME_SIZE]; ///< the input file, to check it is the same on resume
+} checkpoint_t;
+
+/** Write a checkpoint, replaces the file at once so a checkpoint is never partially written.
+
+    @param path the checkpoint file
+    @param checkpoint the checkpoint to write
+    @return 0 on success, -1 on error
+*/
+int checkpoint_write(char const *path, checkpoint_t const *checkpoint);
+
+/** Read a checkpoint.
+
+    A checkpoint is only read by the same build that wrote it, the states are not portable.
+
+    @param path the checkpoint file
+    @param[out] checkpoint the checkpoint read
+    @return 0 on success, 1 if there is no checkpoint, -1 if the file is not a valid checkpoint
+*/
+int checkpoint_read(char const *path, checkpoint_t *checkpoint);
+
+#endif /* INCLUDE_CHECKPOINT_H_ */
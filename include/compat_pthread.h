@@ -4,6 +4,7 @@
 #ifndef THREADS
 
 // explicit request for "no threads"
+#define THREAD_LOCAL
 
 #elif _MSC_VER>=1200
 
@@ -11,6 +12,7 @@
 #include <process.h>
 #define THREAD_CALL                     __cdecl
 #define THREAD_RETURN                   unsigned int
+#define THREAD_LOCAL                    __declspec(thread)
 typedef HANDLE                          pthread_t;
 #define pthread_create(tp, x, p, d)     ((*tp=(HANDLE)_beginthread(p, 0, d)) == NULL ? -1 : 0)
 #define pthread_cancel(th)              TerminateThread(th, 0)
@@ -37,6 +39,7 @@ typedef CONDITION_VARIABLE              pthread_cond_t;
 #include <pthread.h>
 #define THREAD_CALL
 #define THREAD_RETURN                   void*
+#define THREAD_LOCAL                    __thread
 
 #endif
 
@@ -25,6 +25,19 @@
 */
 int timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y);
 
+/** Get a monotonic timestamp, for measuring short durations.
+
+    @return the time in microseconds since an unspecified point
+*/
+double monotonic_time_us(void);
+
+/** Sleep until a monotonic timestamp, returns at once if the time has passed.
+
+    The deadline is absolute, repeated sleeps to a computed schedule do not drift.
+    @param deadline_us the time to wake up as from monotonic_time_us()
+*/
+void monotonic_sleep_until_us(double deadline_us);
+
 // platform-specific functions
 
 #ifdef _WIN32
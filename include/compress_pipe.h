@@ -0,0 +1,34 @@
+/** @file
+    Compressed sample files, streamed through an external (de)compressor.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_COMPRESS_PIPE_H_
+#define INCLUDE_COMPRESS_PIPE_H_
+
+#include <stdio.h>
+
+/** Open a compressed file for streaming.
+
+    The file is decompressed or compressed by a "gzip" or "zstd" process,
+    so the (de)compression runs concurrently with the demodulation.
+
+    @param path the file path
+    @param compression a file_compression, F_GZIP or F_ZSTD
+    @param write 0 to read the decompressed samples, 1 to write samples compressed
+    @return the pipe to read or write, NULL on error
+*/
+FILE *compress_pipe_open(char const *path, unsigned compression, int write);
+
+/** Close a pipe from compress_pipe_open(), waits for the (de)compressor to finish.
+
+    @param pipe the pipe to close
+    @return 0 on success, -1 if the (de)compressor failed
+*/
+int compress_pipe_close(FILE *pipe);
+
+#endif /* INCLUDE_COMPRESS_PIPE_H_ */
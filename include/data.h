@@ -64,13 +64,59 @@ typedef union data_value {
     void        *v_ptr;
 } data_value_t;
 
+/// Well-known keys, interned by data_make() and identified by a small integer.
+enum data_key_id {
+    DATA_KEY_NONE = 0, ///< not a well-known key
+    DATA_KEY_TIME,
+    DATA_KEY_TAG,
+    DATA_KEY_MODEL,
+    DATA_KEY_TYPE,
+    DATA_KEY_SUBTYPE,
+    DATA_KEY_ID,
+    DATA_KEY_CHANNEL,
+    DATA_KEY_BATTERY_OK,
+    DATA_KEY_TEMPERATURE_C,
+    DATA_KEY_TEMPERATURE_F,
+    DATA_KEY_HUMIDITY,
+    DATA_KEY_MIC,
+    DATA_KEY_MOD,
+    DATA_KEY_FREQ,
+    DATA_KEY_FREQ1,
+    DATA_KEY_FREQ2,
+    DATA_KEY_RSSI,
+    DATA_KEY_SNR,
+    DATA_KEY_NOISE,
+    DATA_KEY_MSG,
+    DATA_KEY_CODES,
+    DATA_KEY_COUNT, ///< number of key ids
+};
+
+/** Returns the id of a well-known key, DATA_KEY_NONE otherwise. */
+R_API int data_key_lookup(char const *key);
+
+/// The key was replaced, see data_replace_key().
+#define DATA_HEAP_KEY 1
+/// The format was replaced, see data_replace_format().
+#define DATA_HEAP_FORMAT 2
+
+/** A data element, a node in a linked list.
+
+    The elements made by one data_make(), data_append(), or data_prepend() call are
+    a single allocation (chunk) together with their key, pretty key, format, and string value.
+    Well-known keys are not copied but point to the interned key, see data_key_lookup().
+    The elements of a chunk are consecutive in the list and the chunk is freed with the list.
+*/
 typedef struct data {
     char        *key;
     char        *pretty_key; /**< the name used for displaying data to user in with a nicer name */
     data_type_t type;
     char        *format; /**< if not null, contains special formatting string */
     data_value_t value;
-    unsigned    retain; /**< incremented on data_retain, data_free only frees if this is zero */
+    unsigned    retain; /**< incremented on data_retain, data_free only frees if this is zero, changed atomically */
+    int         key_id; /**< DATA_KEY_* id of a well-known key, the key is then interned */
+    unsigned    heap_strings; /**< DATA_HEAP_KEY, DATA_HEAP_FORMAT if replaced with allocated strings */
+    unsigned    frozen; /**< set on the first element by data_freeze(), the list is not changed anymore */
+    struct data *chunk; /**< the allocation holding this element and its strings */
     struct data *next; /**< chaining to the next element in the linked list; NULL indicates end-of-list */
 } data_t;
 
@@ -119,6 +165,55 @@ R_API data_t *data_append(data_t *first, const char *key, const char *pretty_key
 */
 R_API data_t *data_prepend(data_t *first, const char *key, const char *pretty_key, ...);
 
+/// A typed value of a data record, see data_record_create().
+typedef struct data_slot {
+    data_type_t type;       ///< DATA_INT, DATA_DOUBLE, DATA_STRING, or DATA_COUNT if not set
+    data_value_t value;     ///< a string is referenced, it is copied by data_record_make()
+    char const *pretty_key; ///< NULL to use the key, "" to omit the label, as with data_make()
+    char const *format;     ///< NULL for the default format
+} data_slot_t;
+
+/** The typed values of an event with a fixed schema, e.g. the fields of a decoder.
+
+    A record is allocated once and filled for each event, the values are not boxed
+    and the strings are not copied. The elements are only made with data_record_make()
+    if the event is used, in the order of the schema, unset slots are skipped.
+*/
+typedef struct data_record {
+    char const *const *keys; ///< the schema, NULL-terminated, needs to outlive the record
+    int *key_ids;            ///< the DATA_KEY_* ids of the keys, looked up once
+    unsigned num_slots;
+    data_slot_t *slots;
+} data_record_t;
+
+/** Create a record for a schema.
+
+    @param keys the keys of the slots, NULL-terminated, may be NULL for no slots
+    @return the new record with all slots unset, or NULL if there was a memory allocation error
+*/
+R_API data_record_t *data_record_create(char const *const *keys);
+
+/** Unset all slots of a record. */
+R_API void data_record_clear(data_record_t *record);
+
+/** Set a slot to an integer, a record of NULL or a slot outside the schema are ignored. */
+R_API void data_record_int(data_record_t *record, unsigned slot, char const *pretty_key, char const *format, int value);
+
+/** Set a slot to a double, a record of NULL or a slot outside the schema are ignored. */
+R_API void data_record_double(data_record_t *record, unsigned slot, char const *pretty_key, char const *format, double value);
+
+/** Set a slot to a string, referenced until the record is made or cleared. */
+R_API void data_record_string(data_record_t *record, unsigned slot, char const *pretty_key, char const *value);
+
+/** Make the elements of the set slots, in one chunk as with data_make().
+
+    @return the constructed data_t* object, NULL if no slot is set or there was a memory allocation error
+*/
+R_API data_t *data_record_make(data_record_t const *record);
+
+/** Releases a record. */
+R_API void data_record_free(data_record_t *record);
+
 /** Constructs an array from given data of the given uniform type.
 
     @param num_values The number of values to be copied.
@@ -133,14 +228,34 @@ R_API data_array_t *data_array(int num_values, data_type_t type, void *ptr);
 /** Releases a data array. */
 R_API void data_array_free(data_array_t *array);
 
-/** Retain a structure object, returns the structure object passed in. */
+/** Retain a structure object, returns the structure object passed in.
+
+    The count is atomic, a frozen event may be retained and freed on any thread.
+*/
 R_API data_t *data_retain(data_t *data);
 
 /** Releases a structure object if retain is zero, decrement retain otherwise. */
 R_API void data_free(data_t *data);
 
+/** Freeze a finished event, returns the structure object passed in.
+
+    A frozen event is not changed anymore, the outputs on any thread may read
+    it concurrently, retain it, and free it without a lock. Appending or
+    prepending to a frozen event is an error, reported in debug builds.
+*/
+R_API data_t *data_freeze(data_t *data);
+
+/** Replaces the key of a data element, takes ownership of the allocated @p key. */
+R_API void data_replace_key(data_t *data, char *key);
+
+/** Replaces the format of a data element, takes ownership of the allocated @p format (may be NULL). */
+R_API void data_replace_format(data_t *data, char *format);
+
 struct data_output;
 
+/// The top-level fields an output prints, see data_projection_create().
+typedef struct data_projection data_projection_t;
+
 typedef struct data_output {
     void (R_API_CALLCONV *print_data)(struct data_output *output, data_t *data, char const *format);
     void (R_API_CALLCONV *print_array)(struct data_output *output, data_array_t *data, char const *format);
@@ -150,6 +265,14 @@ typedef struct data_output {
     void (R_API_CALLCONV *output_start)(struct data_output *output, char const *const *fields, int num_fields);
     void (R_API_CALLCONV *output_flush)(struct data_output *output);
     void (R_API_CALLCONV *output_free)(struct data_output *output);
+    void (R_API_CALLCONV *output_sync)(struct data_output *output, int force);
+    void (R_API_CALLCONV *output_batch)(struct data_output *output, unsigned num_events); ///< optional, writes out the events of a batch at once
+    unsigned (R_API_CALLCONV *output_drops)(struct data_output *output); ///< optional, the events or messages the output dropped so far
+    void (R_API_CALLCONV *output_urgent)(struct data_output *output, data_t *data); ///< optional, prints an event ahead of the queued ones, see data_output_print_urgent()
+    size_t (R_API_CALLCONV *output_memory)(struct data_output *output); ///< optional, the bytes held in buffers, backlogs, and queues
+    data_projection_t *projection; ///< the top-level fields to print, NULL for all, see data_output_project()
+    int batch;             ///< 1 while a batch is printed, see data_output_batch_begin()
+    unsigned batch_events; ///< the events printed in the batch
 } data_output_t;
 
 /** Setup known field keys and start output, used by CSV only.
@@ -164,14 +287,141 @@ R_API void data_output_start(struct data_output *output, char const *const *fiel
 /** Prints a structured data object, flushes the output if applicable. */
 R_API void data_output_print(struct data_output *output, data_t *data);
 
+/** Prints an urgent event, e.g. an alarm, ahead of queued events and writes it out at once, also in a batch.
+
+    @param output the data_output handle, may be NULL
+    @param data the event
+*/
+R_API void data_output_print_urgent(struct data_output *output, data_t *data);
+
+/** Start a batch, e.g. the events of a sample buffer, outputs with an output_batch hook write them out at once.
+
+    @param output the data_output handle, may be NULL
+*/
+R_API void data_output_batch_begin(struct data_output *output);
+
+/** End a batch, the output_batch hook gets the number of events printed, if any.
+
+    @param output the data_output handle, may be NULL
+*/
+R_API void data_output_batch_end(struct data_output *output);
+
+/** Writes out batched events if the flush policy is due, always if @p force is set.
+
+    Outputs that flush every event do not implement this.
+*/
+R_API void data_output_sync(struct data_output *output, int force);
+
+/** Get the number of events or messages an output dropped, e.g. for a full queue, a slow client, or a full backlog.
+
+    @param output the data_output handle, may be NULL
+    @return the number dropped so far, 0 if the output does not drop
+*/
+R_API unsigned data_output_drops(struct data_output *output);
+
+/** Get the bytes an output holds in buffers, backlogs, and queues, e.g. the HTTP history or an MQTT backlog.
+
+    @param output the data_output handle, may be NULL
+    @return the bytes, 0 if the output does not tell
+*/
+R_API size_t data_output_memory(struct data_output *output);
+
 R_API void data_output_free(struct data_output *output);
 
+/** Create a projection of the top-level fields of events.
+
+    Well-known keys are a bitmask over the key ids, other keys are matched by their hash.
+    @param fields the fields to keep separated by ':', NULL or empty to keep all
+    @param exclude the fields to drop separated by ':', NULL or empty to drop none
+    @return the new projection, or NULL if it keeps all fields or on alloc failure
+*/
+R_API data_projection_t *data_projection_create(char const *fields, char const *exclude);
+
+/** Free a projection. */
+R_API void data_projection_free(data_projection_t *projection);
+
+/** Check if a projection keeps a top-level field.
+
+    @param projection the projection, NULL keeps all fields
+    @param key the key of the field
+    @param key_id the id of a well-known key, see data_key_lookup()
+    @return 1 if the field is kept, 0 otherwise
+*/
+R_API int data_projection_keeps(data_projection_t const *projection, char const *key, int key_id);
+
+/** Set the projection of an output, the output owns it and frees it.
+
+    Excluded fields are skipped when the output prints an event, without formatting them.
+    Events without any kept field are not printed. The kept fields are linked in a list of
+    copies that is only valid while printing, set the projection on the output that prints
+    the event and not on a queue that retains it.
+    @param output the output
+    @param projection the projection, NULL to print all fields
+*/
+R_API void data_output_project(struct data_output *output, data_projection_t *projection);
+
 /* data output helpers */
 
 R_API void print_value(data_output_t *output, data_type_t type, data_value_t value, char const *format);
 
 R_API void print_array_value(data_output_t *output, data_array_t *array, char const *format, int idx);
 
+/// A reusable buffer for serialized events, grows to the largest event.
+typedef struct data_buf {
+    char *buf;
+    size_t size;
+} data_buf_t;
+
+/** Make room for @p size bytes in a reusable buffer.
+
+    @return 1 on success, 0 on alloc failure
+*/
+R_API int data_buf_reserve(data_buf_t *buf, size_t size);
+
+/** Free the memory of a reusable buffer, it can be used again. */
+R_API void data_buf_free(data_buf_t *buf);
+
+/** Serialize to compact JSON, truncated to @p len.
+
+    If the data is the event set by data_print_jsons_cache() the serialization is done once
+    and copied for each call.
+    @return the length of the JSON string
+*/
 R_API size_t data_print_jsons(data_t *data, char *dst, size_t len);
 
+/** Set the event to cache the compact JSON for, NULL to stop caching.
+
+    Set before passing an event to all outputs and clear before the event is freed.
+    The cache is not thread-safe, it is meant for the thread that runs the outputs.
+*/
+R_API void data_print_jsons_cache(data_t *data);
+
+/** Get the compact JSON of the event set by data_print_jsons_cache() without copying it.
+
+    @param data the event
+    @param[out] len the length of the JSON string
+    @return the JSON string, valid until the cache is cleared, or NULL if the data is not cached
+*/
+R_API char const *data_print_jsons_cached(data_t *data, size_t *len);
+
+/** Serialize to compact JSON in a single pass into a reusable buffer that grows as needed.
+
+    If the data is the event set by data_print_jsons_cache() the shared serialization is returned.
+    @param data the event
+    @param buf the buffer of the output
+    @param[out] len the length of the JSON string, may be NULL
+    @return the JSON string, valid until the next use of the buffer or until the cache is cleared,
+            or NULL on alloc failure
+*/
+R_API char const *data_print_jsons_buf(data_t *data, data_buf_t *buf, size_t *len);
+
+/** Serialize to JSON with spaces after the separators and 3 decimals, the layout of the JSON file output.
+
+    @param data the event
+    @param buf the buffer of the output
+    @param[out] len the length of the JSON string, may be NULL
+    @return the JSON string, valid until the next use of the buffer, or NULL on alloc failure
+*/
+R_API char const *data_print_json_spaced(data_t *data, data_buf_t *buf, size_t *len);
+
 #endif // INCLUDE_DATA_H_
@@ -0,0 +1,71 @@
+/** @file
+    Decimator, reduces the sample rate of the I/Q input before demodulation.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DECIMATOR_H_
+#define INCLUDE_DECIMATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Maximum number of half-band stages, i.e. a maximum decimation of 64.
+#define DECIMATOR_MAX_STAGES 6
+
+/// Half-band filter length, the window spans -9 to +9 samples.
+#define DECIMATOR_TAPS 19
+
+/// Decimator state, a cascade of half-band filters each decimating by 2.
+typedef struct decimator {
+    uint32_t processing_rate; ///< requested minimum output sample rate
+    uint32_t samp_rate;       ///< input sample rate the stages are set up for
+    uint32_t out_rate;        ///< output sample rate, input rate over 2^stages
+    unsigned stages;          ///< number of half-band stages, 0 if no decimation is needed
+    unsigned skip[DECIMATOR_MAX_STAGES]; ///< input samples to skip until the next output sample
+    int16_t *work_buf;        ///< filter history followed by the current stage input, CS16
+    unsigned long work_size;
+    int16_t hist[DECIMATOR_MAX_STAGES][2 * (DECIMATOR_TAPS - 1)]; ///< filter history for each stage
+    int16_t *out_buf;         ///< CS16 output samples
+    unsigned long out_len;
+    unsigned long out_size;
+    uint64_t out_pos;         ///< output samples processed, maintained by the caller
+} decimator_t;
+
+/** Create a decimator.
+
+    @param processing_rate the minimum sample rate to process at
+    @return the new decimator or NULL on error
+*/
+decimator_t *decimator_create(uint32_t processing_rate);
+
+void decimator_free(decimator_t *dec);
+
+/// Get the bytes of the decimator and its buffers, 0 if dec is NULL.
+size_t decimator_memory(decimator_t const *dec);
+
+/** Set up the stages for an input sample rate.
+
+    The decimation is the largest power of two that keeps the output rate
+    at or above the processing rate. The state is only reset if the rate changed.
+    @param dec the decimator
+    @param samp_rate input sample rate
+    @return the decimation factor, 1 if the input does not need decimation
+*/
+unsigned decimator_set_rate(decimator_t *dec, uint32_t samp_rate);
+
+/** Decimate a buffer of input samples to CS16 output in `out_buf`.
+
+    Function is stateful.
+    @param dec the decimator
+    @param iq_buf input I/Q samples
+    @param n_samples number of input samples
+    @param format input sample format, CU8_IQ, CS8_IQ, CS16_IQ, or CF32_IQ
+    @return the number of output samples
+*/
+unsigned long decimator_process(decimator_t *dec, void const *iq_buf, unsigned long n_samples, uint32_t format);
+
+#endif /* INCLUDE_DECIMATOR_H_ */
@@ -0,0 +1,35 @@
+/** @file
+    Decoder time budget, a cooperative guard against decoders that take too long on a package.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DECODE_BUDGET_H_
+#define INCLUDE_DECODE_BUDGET_H_
+
+/// Checks of decode_budget_expired() between reads of the clock.
+#define DECODE_BUDGET_CHECKS 16
+
+/** Start the budget of a decoder run on this thread.
+
+    @param budget_us the microseconds the run may take, 0 for no budget
+*/
+void decode_budget_start(unsigned budget_us);
+
+/** End the budget of a decoder run on this thread.
+
+    @return 1 if the run took longer than the budget, 0 otherwise or without a budget
+*/
+int decode_budget_stop(void);
+
+/** Check if the budget of the running decoder is spent, for the loops of the helpers.
+
+    The clock is only read on every DECODE_BUDGET_CHECKS-th call, once expired the budget stays expired.
+    @return 1 if the helper should give up, 0 to go on or without a budget
+*/
+int decode_budget_expired(void);
+
+#endif /* INCLUDE_DECODE_BUDGET_H_ */
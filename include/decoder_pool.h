@@ -0,0 +1,41 @@
+/** @file
+    Decoder pool, runs independent decoder jobs on worker threads.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_DECODER_POOL_H_
+#define INCLUDE_DECODER_POOL_H_
+
+/// Maximum number of worker threads.
+#define DECODER_POOL_MAX_THREADS 16
+
+typedef struct decoder_pool decoder_pool_t;
+
+/// A job function, called with the job context and the job index.
+typedef void (*decoder_pool_fn)(void *ctx, unsigned job);
+
+/** Create a decoder pool.
+
+    @param num_threads number of worker threads, the calling thread also runs jobs
+    @return the new pool or NULL on error or if built without threads support
+*/
+decoder_pool_t *decoder_pool_create(unsigned num_threads);
+
+void decoder_pool_free(decoder_pool_t *pool);
+
+/** Run jobs on the pool and wait for all to finish.
+
+    Idle threads take the next job, the calling thread takes part.
+    Without a pool the jobs are run in order on the calling thread.
+    @param pool the pool, may be NULL
+    @param num_jobs number of jobs, the job index runs from 0 to num_jobs - 1
+    @param fn the job function
+    @param ctx the job context
+*/
+void decoder_pool_run(decoder_pool_t *pool, unsigned num_jobs, decoder_pool_fn fn, void *ctx);
+
+#endif /* INCLUDE_DECODER_POOL_H_ */
@@ -29,11 +29,23 @@
 #endif
 
 /// Create a new r_device, copy from dev_template if not NULL.
-r_device *create_device(r_device *dev_template);
+r_device *create_device(r_device const *dev_template);
 
 /// Output data.
 void decoder_output_data(r_device *decoder, data_t *data);
 
+/** Get the record of the decoder fields, all slots unset.
+
+    The slots are the indexes into the fields of the decoder, set them with
+    data_record_int(), data_record_double(), data_record_string() and
+    output with decoder_output_record(). The data is only made if an output uses it.
+    @return the record, NULL on alloc failure, the setters then do nothing
+*/
+data_record_t *decoder_record(r_device *decoder);
+
+/// Output a record, see decoder_record().
+void decoder_output_record(r_device *decoder, data_record_t *record);
+
 /// Output a log message.
 void decoder_log(r_device *decoder, int level, char const *func, char const *msg);
 
@@ -110,4 +122,49 @@ void decoder_output_bitrowf(r_device *decoder, uint8_t const *bitrow, unsigned b
 #endif
         ;
 
+/** Find the preamble of the decoder, like bitbuffer_search().
+
+    The positions found by a shared slicer are used if they are for this bitbuffer,
+    otherwise the row is searched for the given pattern.
+    Invert the pattern to search inverted bits, the positions of r_device.preamble stay the same.
+    @param decoder the decoder, r_device.preamble_bits must equal the pattern length to use the positions
+    @param bitbuffer the bits passed to the decoder
+    @param row the row to search
+    @param start the bit position to start the search at
+    @param pattern the pattern to search for, starting in the high bit
+    @param pattern_bits_len the length of the pattern in bits
+    @return the position of the first match at or after start, or the row length if not found
+*/
+unsigned decoder_search_preamble(r_device const *decoder, bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        uint8_t const *pattern, unsigned pattern_bits_len);
+
+// learned parameter functions
+
+#define DECODER_LEARNED_MAX 16 ///< Parameters kept for a decoder, further ones are not learned.
+
+/// Parameters a decoder inferred, e.g. an ID found by a search, kept in its decode_ctx.
+typedef struct decoder_learned {
+    char path[256]; ///< File the parameters are kept in across restarts, empty to keep them in memory only.
+    unsigned len;
+    struct {
+        char key[16];
+        uint32_t value;
+    } entry[DECODER_LEARNED_MAX];
+} decoder_learned_t;
+
+/** Keep the learned parameters in a file, the parameters saved in the file are loaded.
+
+    The file has a `key value` line for each parameter, a missing file is created on the first change.
+    @param learned the learned parameters, e.g. cleared with the decode_ctx
+    @param path the file name
+    @return the number of parameters loaded
+*/
+unsigned decoder_learned_load(decoder_learned_t *learned, char const *path);
+
+/// Look up a learned parameter, return 1 and set the value if found, 0 otherwise.
+int decoder_learned_get(decoder_learned_t const *learned, char const *key, uint32_t *value);
+
+/// Set a learned parameter, the file is written if the value changed.
+void decoder_learned_set(decoder_learned_t *learned, char const *key, uint32_t value);
+
 #endif /* INCLUDE_DECODER_UTIL_H_ */
@@ -0,0 +1,60 @@
+/** @file
+    Event de-duplication, drops events identical to one output within a time window.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_EVENT_DEDUP_H_
+#define INCLUDE_EVENT_DEDUP_H_
+
+#include <stdint.h>
+
+/// Slots of the event hash table, a power of two.
+#define EVENT_DEDUP_SIZE 256
+/// Slots probed for an event, the oldest probed slot is reused if none is free.
+#define EVENT_DEDUP_PROBES 8
+/// The initial hash for event_dedup_hash_field(), the FNV-1a offset basis.
+#define EVENT_DEDUP_HASH_INIT 14695981039346656037ull
+
+struct data;
+
+/// Events seen within the window, an open addressing hash table with linear probing.
+typedef struct event_dedup {
+    unsigned window_ms;        ///< events identical to one seen within this time are dropped, 0 is off
+    unsigned suppressed;       ///< events dropped, stats counter for the interval
+    uint64_t suppressed_total; ///< events dropped, not reset with the stats
+    struct event_dedup_slot {
+        uint64_t hash;    ///< hash of all fields, 0 for a never used slot
+        uint64_t seen_ms; ///< time the event was last seen
+    } slot[EVENT_DEDUP_SIZE];
+} event_dedup_t;
+
+/** Hash the keys and values of an event, including nested data and arrays.
+
+    @param data the event
+    @return the hash, never 0
+*/
+uint64_t event_dedup_hash(struct data const *data);
+
+/** Add the key and value of one field to a hash, nested data and arrays are included.
+
+    @param hash the hash so far, EVENT_DEDUP_HASH_INIT to start
+    @param field the field, the following fields are not included
+    @return the new hash
+*/
+uint64_t event_dedup_hash_field(uint64_t hash, struct data const *field);
+
+/** Check an event against the events seen within the window, the time of a match is refreshed.
+
+    Slots older than the window are expired and reused.
+    @param dedup the table
+    @param data the event
+    @param now_ms the time of the event
+    @return 1 if the event is a duplicate and was counted as suppressed, 0 if the event is new
+*/
+int event_dedup_check(event_dedup_t *dedup, struct data const *data, uint64_t now_ms);
+
+#endif /* INCLUDE_EVENT_DEDUP_H_ */
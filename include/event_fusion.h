@@ -0,0 +1,70 @@
+/** @file
+    Event fusion, merges the events of several receivers into one event.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_EVENT_FUSION_H_
+#define INCLUDE_EVENT_FUSION_H_
+
+#include <stdint.h>
+
+/// Events held within the window, a power of two, the oldest event is output early if full.
+#define EVENT_FUSION_SIZE 4096
+/// Slots of the hash table, a power of two.
+#define EVENT_FUSION_SLOTS (EVENT_FUSION_SIZE * 2)
+/// Slots probed for an event, the event is held without a slot if none is free.
+#define EVENT_FUSION_PROBES 8
+/// Receivers told apart, the events of further receivers are not fused.
+#define EVENT_FUSION_RECEIVERS 64
+/// Longest receiver name, e.g. a numeric IPv6 address.
+#define EVENT_FUSION_NAME 48
+
+struct data;
+
+typedef struct event_fusion event_fusion_t;
+
+/** Create a fusion stage.
+
+    @param window_ms the events heard within this time of the first one are fused
+    @return the new fusion stage or NULL on error
+*/
+event_fusion_t *event_fusion_create(unsigned window_ms);
+
+/// Free a fusion stage and the events held.
+void event_fusion_free(event_fusion_t *fusion);
+
+/** Add an event heard by a receiver.
+
+    An event with the hash of one held within the window is fused and freed,
+    the fused event keeps the data of the receiver with the best RSSI.
+    Pop the due events first, there then is room for the event.
+    @param fusion the fusion stage
+    @param hash the hash of the decoded fields, see event_dedup_hash()
+    @param data the event, taken over
+    @param receiver the name of the receiver
+    @param rssi the RSSI of the package in dB
+    @param now_ms the time the event was heard
+    @return 1 if the event was fused into a held event, 0 if it is held as a new event
+*/
+int event_fusion_add(event_fusion_t *fusion, uint64_t hash, struct data *data, char const *receiver, float rssi, uint64_t now_ms);
+
+/** Take the oldest event out if its window is over, or if the fusion stage is full.
+
+    The "receiver" with the best RSSI and all "receivers" are appended to the event.
+    @param fusion the fusion stage
+    @param now_ms the time now, UINT64_MAX to take all events out
+    @return the event, to be output, or NULL if none is due
+*/
+struct data *event_fusion_pop(event_fusion_t *fusion, uint64_t now_ms);
+
+/// Get the number of events fused into another, the stats counter is reset with @p reset.
+unsigned event_fusion_fused(event_fusion_t *fusion, int reset);
+
+/// Get the total number of events fused into another, not reset with the stats.
+uint64_t event_fusion_fused_total(event_fusion_t const *fusion);
+
+#endif /* INCLUDE_EVENT_FUSION_H_ */
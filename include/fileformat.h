@@ -15,6 +15,8 @@
 #include <stdint.h>
 #include <stdio.h>
 
+struct sample_index;
+
 char const *file_basename(char const *path);
 
 /// a single handy number to define the file type.
@@ -41,6 +43,9 @@ enum file_type {
     F_LOGIC    = 5 << 16,
     F_VCD      = 6 << 16,
     F_OOK      = 7 << 16,
+    F_OOK_BIN  = 8 << 16,
+    F_SR       = 9 << 16,
+    F_ARROW    = 10 << 16,
     // format types
     F_U8       = F_1CH | F_UNSIGNED | F_INT | F_W8,
     F_S8       = F_1CH | F_SIGNED   | F_INT | F_W8,
@@ -70,16 +75,30 @@ enum file_type {
     U8_LOGIC   = F_LOGIC | F_U8,
     VCD_LOGIC  = F_VCD,
     PULSE_OOK  = F_OOK,
+    PULSE_OOK_BIN = F_OOK_BIN,
+    SIGROK_SR  = F_SR, ///< logic, I, Q, AM, and FM channels in a Sigrok file
+    PULSE_ARROW = F_ARROW, ///< pulse data columns in an Arrow IPC file
+};
+
+/// compression of a file, detected from the file name extension.
+enum file_compression {
+    F_UNCOMPRESSED = 0,
+    F_GZIP         = 1, ///< ".gz"
+    F_ZSTD         = 2, ///< ".zst"
 };
 
 typedef struct {
     uint32_t format;
     uint32_t raw_format;
+    uint32_t compression; ///< a file_compression, the file is read or written through a (de)compressor
     uint32_t center_frequency;
     uint32_t sample_rate;
     char const *spec;
     char const *path;
     FILE *file;
+    struct sample_index *index; ///< sidecar index of a sample dumper, see -Y index
+    char *file_buffer; ///< the file buffer of a text dumper, freed after the file is closed
+    struct pulse_arrow *arrow; ///< the Arrow writer of a pulse dumper
 } file_info_t;
 
 /// Clear all file info.
@@ -100,6 +119,7 @@ void file_info_clear(file_info_t *info);
 /// - 2ch formats: "cu8", "cs8", "cs16", "cs32", "cf32"
 /// - 1ch formats: "u8", "s8", "s16", "u16", "s32", "u32", "f32"
 /// - text formats: "vcd", "ook"
+/// - binary pulse formats: "ookbin", "arrow"
 /// - content types: "iq", "i", "q", "am", "fm", "logic"
 ///
 /// Parses left to right, with the exception of a prefix up to the last colon ":"
@@ -109,6 +129,7 @@ void file_info_clear(file_info_t *info);
 ///
 /// - default detection, e.g.: path/filename.am.s16
 /// - overrides, e.g.: am:s16:path/filename.ext
+/// - compressed files, e.g.: path/filename.cu8.zst, path/filename.cs16.gz
 /// - other styles are detected but discouraged, e.g.:
 ///   am-s16:path/filename.ext, am.s16:path/filename.ext, path/filename.am_s16
 ///
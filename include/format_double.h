@@ -0,0 +1,32 @@
+/** @file
+    Fast formatting of doubles for the text outputs.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_FORMAT_DOUBLE_H_
+#define INCLUDE_FORMAT_DOUBLE_H_
+
+#include <stddef.h>
+
+/// Buffer size that holds any double formatted with up to 9 decimals, e.g. "%.3f" or "%g".
+#define FORMAT_DOUBLE_BUFLEN 64
+
+/** Format a double like snprintf() with a format of a single double conversion.
+
+    The formats "%f", "%.<n>f" with n up to 9, an optional text after the conversion, and "%g"
+    are formatted with exact integer arithmetic, the text is identical to snprintf().
+    Other formats and values out of range, e.g. "%g" with an exponent, fall back to snprintf().
+
+    @param buf the output buffer
+    @param size the size of the buffer
+    @param format the format with a single double conversion
+    @param value the value to format
+    @return the length of the formatted text, as with snprintf() the text is truncated if at least size
+*/
+int format_double(char *buf, size_t size, char const *format, double value);
+
+#endif /* INCLUDE_FORMAT_DOUBLE_H_ */
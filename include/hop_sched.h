@@ -0,0 +1,91 @@
+/** @file
+    Hop scheduler, chooses the dwell time on each hop frequency.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_HOP_SCHED_H_
+#define INCLUDE_HOP_SCHED_H_
+
+#include <stdint.h>
+
+/// The activity of a hop frequency.
+typedef struct hop_slot {
+    double base_dwell;  ///< the configured dwell time in seconds
+    double rate;        ///< events per second, smoothed over the visits, negative if not visited yet
+    double noise_level; ///< noise level in dB at the end of the last visit
+    unsigned events;    ///< events of the current visit
+    unsigned packages;  ///< packages of the current visit
+} hop_slot_t;
+
+/// Hop scheduler state.
+typedef struct hop_sched {
+    unsigned len;
+    int adapt;          ///< adapt the dwell times to the activity
+    double min_dwell;   ///< lower bound of an adapted dwell in seconds, 0 for a quarter of the base dwell
+    double max_dwell;   ///< upper bound of an adapted dwell in seconds, 0 for four times the base dwell
+    unsigned idle_ms;   ///< hop early after this time without packages, 0 is off
+    uint64_t quiet_samples; ///< samples since the last package or retune
+    uint32_t samp_rate; ///< sample rate of the quiet samples
+    hop_slot_t slot[];
+} hop_sched_t;
+
+/** Create a hop scheduler.
+
+    @param frequencies the number of hop frequencies
+    @param hop_time the dwell time of each frequency in seconds, the last one is used for the rest
+    @param hop_times the number of dwell times, at least 1
+    @return the new scheduler or NULL on error
+*/
+hop_sched_t *hop_sched_create(unsigned frequencies, int const *hop_time, unsigned hop_times);
+
+void hop_sched_free(hop_sched_t *sched);
+
+/** Count the packages and events of a buffer on the tuned frequency.
+
+    @param sched the scheduler
+    @param index the tuned frequency
+    @param n_samples the samples in the buffer
+    @param samp_rate the sample rate
+    @param packages the packages detected in the buffer
+    @param events the events decoded from the buffer
+*/
+void hop_sched_observe(hop_sched_t *sched, unsigned index, unsigned long n_samples, uint32_t samp_rate, unsigned packages, unsigned events);
+
+/** Restart the quiet time, call when a retune is applied. */
+void hop_sched_tuned(hop_sched_t *sched);
+
+/** Get the dwell time of a frequency.
+
+    The adapted dwell shares the total configured dwell time in proportion to the event
+    rates, with a prior of one event per hop cycle, clamped to the bounds.
+    The base dwell is used until all frequencies are visited.
+
+    @param sched the scheduler
+    @param index the frequency
+    @return the dwell time in seconds
+*/
+double hop_sched_dwell(hop_sched_t const *sched, unsigned index);
+
+/** Check if it is time to hop from a frequency.
+
+    @param sched the scheduler
+    @param index the requested frequency
+    @param secs the time since the hop to the frequency in seconds
+    @return 1 if the dwell time is over or the frequency has been idle long enough, 0 otherwise
+*/
+int hop_sched_due(hop_sched_t const *sched, unsigned index, double secs);
+
+/** Conclude a visit of a frequency, call when hopping away.
+
+    @param sched the scheduler
+    @param index the frequency
+    @param secs the time spent on the frequency in seconds
+    @param noise_level the noise level estimate in dB
+*/
+void hop_sched_leave(hop_sched_t *sched, unsigned index, double secs, float noise_level);
+
+#endif /* INCLUDE_HOP_SCHED_H_ */
@@ -17,6 +17,15 @@
 struct mg_mgr;
 struct r_cfg;
 
-struct data_output *data_output_http_create(struct mg_mgr *mgr, const char *host, const char *port, struct r_cfg *cfg);
+/** Create an HTTP server output.
+
+    A client that does not keep up has its events dropped or is closed once its
+    send queue reaches the high-water mark.
+    @param queue_limit high-water mark of a client send queue in bytes, 0 for the default of 1M
+    @param evict close a slow client instead of dropping events
+    @param history_size size of the event history for new websocket clients in bytes, 0 for the default of 256k
+    @param compress offer gzip and websocket deflate to the clients, needs zlib
+*/
+struct data_output *data_output_http_create(struct mg_mgr *mgr, const char *host, const char *port, struct r_cfg *cfg, unsigned queue_limit, int evict, unsigned history_size, int compress);
 
 #endif /* INCLUDE_HTTP_SERVER_H_ */
@@ -0,0 +1,47 @@
+/** @file
+    Large sample buffers, backed by huge pages if enabled.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_HUGE_BUF_H_
+#define INCLUDE_HUGE_BUF_H_
+
+#include <stddef.h>
+
+/** Back the buffers allocated afterwards with huge pages, set with -Y hugepages.
+
+    The setting is process wide, buffers keep the pages they were allocated with.
+    @param enable 1 to use huge pages, 0 for the normal allocation
+*/
+void huge_buf_enable(int enable);
+
+/// Returns 1 if huge pages are enabled.
+int huge_buf_enabled(void);
+
+/** The size of a huge page.
+
+    @return the default huge page size in bytes, or 0 if there are no huge pages on this platform
+*/
+size_t huge_buf_page_size(void);
+
+/** Allocate a zeroed buffer.
+
+    With huge pages enabled the buffer is mapped from reserved huge pages (MAP_HUGETLB),
+    or else from normal pages hinted for transparent huge pages (MADV_HUGEPAGE).
+    Otherwise, or if mapping fails, the buffer is a normal allocation.
+    @param size the size in bytes
+    @return the buffer, release with huge_buf_free(), or NULL on alloc failure
+*/
+void *huge_buf_create(size_t size);
+
+/** Release a buffer of huge_buf_create().
+
+    @param buf the buffer, may be NULL
+*/
+void huge_buf_free(void *buf);
+
+#endif /* INCLUDE_HUGE_BUF_H_ */
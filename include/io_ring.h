@@ -0,0 +1,100 @@
+/** @file
+    Queued file I/O with io_uring on Linux, a thin wrapper of the system calls.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_IO_RING_H_
+#define INCLUDE_IO_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Use of the ring, set with -Y io.
+typedef enum io_ring_mode {
+    IO_RING_AUTO,   ///< queue the dumper writes and the reads of files that can not be mapped
+    IO_RING_ALWAYS, ///< also read the files that could be mapped through the ring
+    IO_RING_OFF,    ///< stdio only
+} io_ring_mode_t;
+
+typedef struct io_ring io_ring_t;
+
+/** Set the use of the ring for the readers and writers started afterwards.
+
+    The setting is process wide, without io_uring support all modes are stdio.
+    @param mode the use of the ring
+*/
+void io_ring_set_mode(io_ring_mode_t mode);
+
+/// Returns the use of the ring.
+io_ring_mode_t io_ring_get_mode(void);
+
+/** Create a ring, the requests queued and in flight are limited to the depth.
+
+    @param depth the number of requests at most
+    @return the new ring, or NULL if io_uring is not available (not Linux, an old kernel, or a seccomp filter) or set off
+*/
+io_ring_t *io_ring_create(unsigned depth);
+
+/** Wait for the requests in flight and free the ring.
+
+    @param ring the ring, may be NULL
+*/
+void io_ring_free(io_ring_t *ring);
+
+/** Register fixed buffers, the reads into them skip the page mapping per request.
+
+    @param ring the ring
+    @param buf the start of the buffers
+    @param len the length of a buffer
+    @param count the number of buffers, consecutive from the start
+    @return 0 on success, -1 if not possible, e.g. the locked memory limit
+*/
+int io_ring_register(io_ring_t *ring, void *buf, size_t len, unsigned count);
+
+/// Returns the number of requests that can be queued.
+unsigned io_ring_space(io_ring_t const *ring);
+
+/// Returns the number of requests queued and in flight.
+unsigned io_ring_pending(io_ring_t const *ring);
+
+/** Queue a read, it is submitted with the next io_ring_wait().
+
+    @param ring the ring
+    @param fd the file
+    @param buf the buffer
+    @param len the length to read
+    @param offset the file offset, -1 for the file position
+    @param buf_index the index of the registered buffer, -1 if not registered
+    @param user the tag of the completion
+    @return 0 if queued, -1 if the ring is full
+*/
+int io_ring_read(io_ring_t *ring, int fd, void *buf, unsigned len, int64_t offset, int buf_index, uint64_t user);
+
+/** Queue a write, it is submitted with the next io_ring_wait().
+
+    Linked writes run in order, a failed or short write cancels the writes linked after it.
+    @param ring the ring
+    @param fd the file
+    @param buf the data, must stay valid until completed
+    @param len the length to write
+    @param offset the file offset, -1 for the file position
+    @param link 1 to link the next queued request to this one
+    @param user the tag of the completion
+    @return 0 if queued, -1 if the ring is full
+*/
+int io_ring_write(io_ring_t *ring, int fd, void const *buf, unsigned len, int64_t offset, int link, uint64_t user);
+
+/** Submit the queued requests and wait for a completion.
+
+    @param ring the ring
+    @param[out] user the tag of the completed request
+    @param[out] res the result, the length transferred or a negative errno
+    @return 0 on a completion, -1 if nothing is in flight or on error
+*/
+int io_ring_wait(io_ring_t *ring, uint64_t *user, int *res);
+
+#endif /* INCLUDE_IO_RING_H_ */
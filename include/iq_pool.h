@@ -0,0 +1,70 @@
+/** @file
+    Pool of refcounted IQ sample buffers, owned by the acquisition.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_IQ_POOL_H_
+#define INCLUDE_IQ_POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct iq_pool;
+
+/// A buffer of the pool, held by the acquisition until processed and by the consumers that retain it.
+typedef struct iq_buf {
+    uint8_t *data;         ///< the samples
+    size_t size;           ///< capacity in bytes
+    int owned;             ///< the acquisition holds the buffer, see iq_pool_put()
+    unsigned retained;     ///< references of the consumers, see iq_buf_retain()
+    struct iq_pool *pool;
+} iq_buf_t;
+
+typedef struct iq_pool iq_pool_t;
+
+/** Create a pool of equally sized buffers.
+
+    The consumers may retain at most the spare buffers at a time, so the
+    acquisition always finds a free buffer while it holds no more than
+    num - spare buffers.
+
+    @param num the number of buffers
+    @param size the size of each buffer in bytes
+    @param spare the number of buffers the consumers may retain
+    @return the new pool, or NULL on alloc failure
+*/
+iq_pool_t *iq_pool_create(unsigned num, size_t size, unsigned spare);
+
+/// Free the pool, or once the last retained buffer is released.
+void iq_pool_free(iq_pool_t *pool);
+
+/// Get the bytes of the pool, the buffers and their bookkeeping, 0 if pool is NULL.
+size_t iq_pool_memory(iq_pool_t const *pool);
+
+/// Take a free buffer for the acquisition, returns NULL if none is free.
+iq_buf_t *iq_pool_get(iq_pool_t *pool);
+
+/// Hand back a buffer of iq_pool_get(), it is reused once no consumer retains it, may be NULL.
+void iq_pool_put(iq_buf_t *buf);
+
+/** Keep a buffer beyond the processing instead of copying it, may be called on any thread.
+
+    @param buf the buffer, may be NULL
+    @return 0 on success, -1 if buf is NULL or the spare buffers are all retained, then copy the samples
+*/
+int iq_buf_retain(iq_buf_t *buf);
+
+/// Release a buffer of iq_buf_retain(), may be called on any thread.
+void iq_buf_release(iq_buf_t *buf);
+
+/// Check if the samples at a pointer are in a buffer.
+static inline int iq_buf_holds(iq_buf_t const *buf, void const *ptr, size_t len)
+{
+    return buf && (uint8_t const *)ptr >= buf->data && (uint8_t const *)ptr + len <= buf->data + buf->size;
+}
+
+#endif /* INCLUDE_IQ_POOL_H_ */
@@ -0,0 +1,72 @@
+/** @file
+    Load shedding, degrades the processing in steps when it falls behind real time.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_LOAD_SHED_H_
+#define INCLUDE_LOAD_SHED_H_
+
+#include <stdint.h>
+
+/// The steps of shedding, each level includes the ones below.
+typedef enum load_shed_level {
+    LOAD_SHED_NONE,     ///< normal processing
+    LOAD_SHED_PRIORITY, ///< skip the decoders with a priority above 0
+    LOAD_SHED_UNUSED,   ///< skip the decoders without events so far or demoted, see -Y adaptive
+    LOAD_SHED_FM,       ///< skip the FM demodulation of buffers with noise only
+    LOAD_SHED_OUTPUTS,  ///< stop the pulse and AM analyzers and the dumpers
+    LOAD_SHED_LEVELS,
+} load_shed_level_t;
+
+/// Load shedding state, updated on the thread that processes the sample buffers.
+typedef struct load_shed {
+    double high;        ///< shed a level above this load, the processing time over the sample time
+    double low;         ///< restore a level below this load
+    double load;        ///< the load of the last window
+    double busy_us;     ///< processing time of the current window
+    double real_us;     ///< sample time of the current window
+    unsigned calm;      ///< windows below the low load since the last change
+    uint64_t lost;      ///< lost buffers at the last window
+    int level;          ///< the current level, see load_shed_level_t
+    unsigned changes;   ///< level changes
+    uint64_t buffers[LOAD_SHED_LEVELS]; ///< buffers processed at each level
+    uint64_t fm_skipped;     ///< buffers not FM demodulated
+    uint64_t outputs_skipped; ///< buffers not analyzed or dumped
+} load_shed_t;
+
+/** Create a load shedding state.
+
+    @param high the load to shed at, e.g. 0.8 of real time, restored below half of it
+    @return the new state, or NULL on alloc failure
+*/
+load_shed_t *load_shed_create(double high);
+
+void load_shed_free(load_shed_t *shed);
+
+/// Returns the current level, LOAD_SHED_NONE without shedding.
+static inline int load_shed_level(load_shed_t const *shed)
+{
+    return shed ? shed->level : LOAD_SHED_NONE;
+}
+
+/** Account a processed buffer, the level changes by one step at the end of a window.
+
+    A window with lost buffers or a load above the high mark sheds a level, a level is
+    restored after a few windows below the low mark.
+
+    @param shed the state
+    @param busy_us the processing time of the buffer
+    @param real_us the sample time of the buffer, the inputs share the time
+    @param lost the lost buffers of the inputs so far
+    @return the change of the level, -1, 0, or 1
+*/
+int load_shed_update(load_shed_t *shed, double busy_us, double real_us, uint64_t lost);
+
+/// Returns a description of what a level sheds.
+char const *load_shed_name(int level);
+
+#endif /* INCLUDE_LOAD_SHED_H_ */
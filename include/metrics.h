@@ -0,0 +1,134 @@
+/** @file
+    Pipeline metrics, counters and histograms of the time spent in each stage.
+
+    The metrics are only updated on the thread that processes the sample
+    buffers, the decoder pool workers only touch their own decoder. The HTTP
+    server formats them on the same thread when scraped, see /metrics.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_METRICS_H_
+#define INCLUDE_METRICS_H_
+
+#include "alloc_count.h"
+
+#include <stdint.h>
+
+/// Stages of the buffer processing, timed for each buffer.
+typedef enum metrics_stage {
+    METRICS_BASEBAND,     ///< IQ correction, AM and FM demodulation
+    METRICS_PULSE_DETECT, ///< pulse detection
+    METRICS_DECODE,       ///< slicers and decoders
+    METRICS_OUTPUT,       ///< printing events to all outputs
+    METRICS_STAGES,
+} metrics_stage_t;
+
+/// Baseband kernels, only timed separately for -Y bench as the pipeline runs them fused.
+typedef enum metrics_kernel {
+    METRICS_ENVELOPE, ///< envelope detection
+    METRICS_LOW_PASS, ///< AM low pass filter
+    METRICS_DEMOD_FM, ///< FM demodulation
+    METRICS_KERNELS,
+} metrics_kernel_t;
+
+/// Stages open at a time, the outputs run inside the decode stage.
+#define METRICS_NESTING 4
+
+/// Number of histogram buckets, the last bucket is +Inf.
+#define METRICS_BUCKETS 15
+
+/// Upper bounds of the histogram buckets in microseconds, without the +Inf bucket.
+extern double const metrics_bucket_us[METRICS_BUCKETS - 1];
+
+typedef struct metrics_histogram {
+    uint64_t count;
+    double sum_us;
+    double max_us;
+    uint64_t buckets[METRICS_BUCKETS]; ///< observations in each bucket, not cumulative
+} metrics_histogram_t;
+
+typedef struct metrics {
+    uint64_t buffers;       ///< sample buffers processed
+    uint64_t buffers_quiet; ///< buffers with noise only, not searched for pulses
+    uint64_t buffers_lost;  ///< SDR buffers missing from the sequence numbers, dropped by a full acquisition ring
+    uint64_t buffer_seq;    ///< sequence number of the last buffer of the main SDR, see sdr_event_t
+    uint64_t samples;
+    uint64_t samples_clipped;   ///< input samples at full scale, see baseband_clip_t
+    uint64_t samples_near_zero; ///< input samples with next to no signal
+    float input_peak_dbfs;      ///< peak of the last input buffer, dB full scale
+    uint64_t frames_ook;
+    uint64_t frames_fsk;
+    uint64_t frames_events; ///< frames that decoded to events
+    uint64_t frames_dedup;  ///< frames identical to a recent one, dropped or run through its decoders, see -Y dedup
+    uint64_t events;        ///< data printed to the outputs
+    double stage_us[METRICS_STAGES]; ///< time of each stage in the current buffer
+    unsigned stage_ran;     ///< bit mask of the stages that ran in the current buffer
+    metrics_histogram_t stage[METRICS_STAGES];
+    metrics_histogram_t buffer; ///< whole buffers
+    metrics_histogram_t acquire_latency; ///< time buffers waited between the acquisition thread and processing
+    metrics_histogram_t callback_interval; ///< time between the sample callbacks of the SDR, see watchdog_feed()
+    metrics_histogram_t callback_duration; ///< time spent in each sample callback of the SDR, including the outputs
+    double kernel_us[METRICS_KERNELS]; ///< total time of each baseband kernel, see -Y bench
+    metrics_histogram_t event_latency; ///< time from the end of a package on air to its event given to the outputs
+    metrics_histogram_t urgent_latency; ///< the event latency of the alarms only, see -Y urgent
+    alloc_count_t alloc_mark[METRICS_NESTING]; ///< allocations at the start of the open stages, see metrics_begin()
+    unsigned alloc_depth;   ///< stages open
+    alloc_count_t stage_allocs[METRICS_STAGES]; ///< allocations of each stage in the current buffer
+    alloc_count_t allocs[METRICS_STAGES];       ///< allocations of each stage, if counted, see alloc_count_enabled()
+    uint64_t buffers_idle;       ///< buffers without events
+    uint64_t idle_allocs;        ///< allocations of the buffers without events, outputs excluded
+    uint64_t idle_alloc_buffers; ///< buffers without events that allocated
+    double buffer_us;       ///< wall time the current SDR buffer arrived, 0 for file inputs
+    double package_end_us;  ///< wall time the package being decoded ended on air, 0 if unknown
+} metrics_t;
+
+/// Add an observation to a histogram.
+void metrics_observe(metrics_histogram_t *hist, double us);
+
+/** Estimate a percentile from the histogram buckets.
+
+    The value is interpolated in its bucket and capped at the largest observation.
+    @param hist the histogram
+    @param q the fraction of observations at or below the result, e.g. 0.99
+    @return the estimated percentile in microseconds, 0 if there are no observations
+*/
+double metrics_percentile(metrics_histogram_t const *hist, double q);
+
+/// Get the wall time in microseconds, the time base of the buffer and package times.
+double metrics_wall_time_us(void);
+
+/** Start timing a stage and counting its allocations.
+
+    The time spent and the allocations in outputs meanwhile, e.g. printing events
+    from the decoders, are not counted for the stage.
+    @return the start mark to pass to metrics_end()
+*/
+double metrics_begin(metrics_t *metrics);
+
+/// End timing a stage, the time and the allocations add to the stage in the current buffer.
+void metrics_end(metrics_t *metrics, metrics_stage_t stage, double begin);
+
+/** Count the buffers missing before an SDR buffer from its sequence number.
+
+    @param metrics the metrics
+    @param[in,out] last_seq the sequence number of the last buffer of the SDR
+    @param seq the sequence number of the buffer, 0 if not numbered
+*/
+void metrics_buffer_seq(metrics_t *metrics, uint64_t *last_seq, uint64_t seq);
+
+/** End a sample buffer, observes the stages that ran and adds up their allocations.
+
+    The outputs of a buffer may run after it ends, e.g. batched, the allocations of a buffer
+    without events are counted without the outputs.
+    @param metrics the metrics
+    @param begin the start of the buffer from monotonic_time_us()
+    @param n_samples the samples of the buffer
+    @param events 1 if the buffer decoded to events, 0 otherwise
+*/
+void metrics_end_buffer(metrics_t *metrics, double begin, unsigned n_samples, int events);
+
+#endif /* INCLUDE_METRICS_H_ */
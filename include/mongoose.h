@@ -3863,8 +3863,12 @@ struct mg_ssl_if_conn_params {
   const char *cipher_suites;
   const char *psk_identity;
   const char *psk_key;
+  struct mg_ssl_session **session;
 };
 
+/* Opaque TLS session of a client, to resume on the next connect. */
+struct mg_ssl_session;
+
 enum mg_ssl_if_result mg_ssl_if_conn_init(
     struct mg_connection *nc, const struct mg_ssl_if_conn_params *params,
     const char **err_msg);
@@ -3877,6 +3881,14 @@ enum mg_ssl_if_result mg_ssl_if_handshake(struct mg_connection *nc);
 int mg_ssl_if_read(struct mg_connection *nc, void *buf, size_t buf_size);
 int mg_ssl_if_write(struct mg_connection *nc, const void *data, size_t len);
 
+/* Frees a session stored with `mg_connect_opts.ssl_session`, NULL is ignored. */
+void mg_ssl_session_free(struct mg_ssl_session *session);
+/*
+ * Stops storing the sessions of a connection, call before the storage
+ * is freed while the connection may still be open.
+ */
+void mg_ssl_session_detach(struct mg_connection *nc);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -4292,6 +4304,13 @@ struct mg_connect_opts {
    */
   const char *ssl_psk_identity;
   const char *ssl_psk_key;
+  /*
+   * Client session resumption. If set, the session stored there is offered
+   * on connect, and the sessions the server hands out are stored there, to
+   * skip the full handshake on the next connect. Free the stored session
+   * with mg_ssl_session_free(). Only supported with OpenSSL.
+   */
+  struct mg_ssl_session **ssl_session;
 #endif
 };
 
@@ -5049,6 +5068,7 @@ struct mg_connection *mg_connect_ws_opt(
  * Orred with one of the flags:
  *
  * - WEBSOCKET_DONT_FIN: Don't set the FIN flag on the frame to be sent.
+ * - WEBSOCKET_RSV1: Set the RSV1 flag, e.g. for a compressed message.
  *
  * `data` and `data_len` contain frame data.
  */
@@ -5093,6 +5113,23 @@ void mg_printf_websocket_frame(struct mg_connection *nc, int op_and_flags,
  */
 #define WEBSOCKET_DONT_FIN 0x100
 
+/*
+ * If set causes the RSV1 flag to be set on outbound frames, this marks
+ * a compressed message with the permessage-deflate extension.
+ */
+#define WEBSOCKET_RSV1 0x200
+
+/*
+ * Sends the WebSocket handshake reply with extra headers, e.g. an accepted
+ * `Sec-WebSocket-Extensions`, each header terminated with CRLF.
+ *
+ * Call this from the MG_EV_WEBSOCKET_HANDSHAKE_REQUEST handler, mongoose
+ * then does not send its own reply.
+ */
+void mg_send_websocket_handshake_reply(struct mg_connection *nc,
+                                       struct http_message *hm,
+                                       const char *extra_headers);
+
 #endif /* MG_ENABLE_HTTP_WEBSOCKET */
 
 /*
@@ -0,0 +1,80 @@
+/** @file
+    Network thread, polls the mongoose manager off the SDR thread.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_NET_THREAD_H_
+#define INCLUDE_NET_THREAD_H_
+
+/// Events queued for each network output, unless set with -O.
+#define NET_THREAD_QUEUE_SIZE 1024
+
+struct mg_mgr;
+struct data_output;
+
+typedef struct net_thread net_thread_t;
+
+/** Create a network thread for a mongoose manager, the thread waits for net_thread_start().
+
+    @param mgr the manager to poll
+    @return the new network thread, or NULL on error or if built without threads support
+*/
+net_thread_t *net_thread_create(struct mg_mgr *mgr);
+
+/** Put a network output behind a queue that is printed on the network thread.
+
+    Call before net_thread_start(). The queue drops events if the network thread falls behind.
+    @param net the network thread, NULL to keep the output as it is
+    @param output the output to print on the network thread
+    @param size maximum number of queued events
+    @param drop_newest drop the new event instead of the oldest queued if the queue is full
+    @return the queue output, or the output on error
+*/
+struct data_output *net_thread_queue_output(net_thread_t *net, struct data_output *output, unsigned size, int drop_newest);
+
+/** Start polling the manager, from here on only the network thread may use the manager.
+
+    @param net the network thread, may be NULL
+*/
+void net_thread_start(net_thread_t *net);
+
+/** Coalesce the wakes of the network thread to save power.
+
+    The queued events no longer wake the thread, they are printed on net_thread_flush()
+    or at the latest after the poll timeout. Connections still wake the thread.
+    @param net the network thread, may be NULL
+    @param poll_ms the poll timeout, 0 to wake for each queued event again
+*/
+void net_thread_coalesce(net_thread_t *net, unsigned poll_ms);
+
+/** Wake the network thread if events were queued since the last flush.
+
+    @param net the network thread, may be NULL
+*/
+void net_thread_flush(net_thread_t *net);
+
+/** Stop and free a network thread, the queued outputs are printed when freed.
+
+    @param net the network thread, may be NULL
+*/
+void net_thread_free(net_thread_t *net);
+
+/** Take the decode lock.
+
+    The SDR thread holds the lock while a buffer is decoded, the connection
+    handlers that use the config take it too.
+    @param net the network thread, may be NULL
+*/
+void net_thread_lock(net_thread_t *net);
+
+/** Release the decode lock.
+
+    @param net the network thread, may be NULL
+*/
+void net_thread_unlock(net_thread_t *net);
+
+#endif /* INCLUDE_NET_THREAD_H_ */
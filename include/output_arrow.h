@@ -0,0 +1,35 @@
+/** @file
+    Arrow IPC file output for rtl_433 events, a columnar archive per model.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_ARROW_H_
+#define INCLUDE_OUTPUT_ARROW_H_
+
+#include "data.h"
+
+/// Events per record batch of a model.
+#define OUTPUT_ARROW_BATCH_ROWS 1024
+
+/** Construct data output for Arrow IPC files (Feather V2), a file per model.
+
+    The events of each model are written to "<path>.<model>.arrow", with the ".arrow"
+    extension of the path removed first, and events without a model to the path.
+    The columns of a model are the declared fields (see data_output_start()) in its
+    first batch of events, the column types are inferred from the values of that batch:
+    int32 if all are integers, float64 if all are numbers, and utf8 otherwise.
+    Later values are converted to the column type or are null if that is not possible,
+    nested data and arrays are written as JSON text.
+
+    @param path the path of the files, existing files are replaced
+    @param batch_rows the events per record batch, 0 for the default
+    @return The initialized data output.
+            You must release this object with data_output_free once you're done with it.
+*/
+struct data_output *data_output_arrow_create(char const *path, unsigned batch_rows);
+
+#endif /* INCLUDE_OUTPUT_ARROW_H_ */
@@ -0,0 +1,29 @@
+/** @file
+    CBOR encoding of rtl_433 events.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_CBOR_H_
+#define INCLUDE_OUTPUT_CBOR_H_
+
+#include "data.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/** Encode a data structure as a CBOR map (RFC 8949).
+
+    Keys are text strings, integers and doubles keep their type,
+    doubles are encoded as single precision if that is exact.
+    The formats of the values are not used.
+    @param data the data structure
+    @param dst the output buffer, may be NULL if @p len is 0
+    @param len the size of the output buffer
+    @return the length of the encoding, the encoding is truncated if this is larger than @p len
+*/
+R_API size_t data_print_cbor(data_t *data, uint8_t *dst, size_t len);
+
+#endif /* INCLUDE_OUTPUT_CBOR_H_ */
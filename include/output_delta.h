@@ -0,0 +1,100 @@
+/** @file
+    Compact delta encoded frames of the sensor values, for uplinks of a few hundred bytes a minute.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_DELTA_H_
+#define INCLUDE_OUTPUT_DELTA_H_
+
+#include "data.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/// Time between the frames in seconds, unless set with the interval option.
+#define DELTA_INTERVAL 60
+/// Largest frame in bytes, unless set with the mtu option, this is the largest LoRaWAN payload.
+#define DELTA_MTU 222
+/// A sensor is defined again with its full values after this many updates, unless set with the key option.
+#define DELTA_KEY_UPDATES 10
+/// Sensors in the table at most, the events of further sensors are dropped.
+#define DELTA_SENSORS_MAX 1024
+/// Fields of a sensor at most, the width of the changed-field bitmask.
+#define DELTA_FIELDS_MAX 64
+
+typedef struct delta_encoder delta_encoder_t;
+
+/** Create an empty table of the last values of the sensors.
+
+    @param key_updates define a sensor again after this many updates, 0 for DELTA_KEY_UPDATES
+    @return the new encoder, or NULL on alloc failure
+*/
+delta_encoder_t *delta_encoder_create(unsigned key_updates);
+
+void delta_encoder_free(delta_encoder_t *enc);
+
+/** Set the fields that are sent, the fields of a sensor are kept in this order.
+
+    The schema is the list of fields of the decoders, as with CSV output.
+    Without a schema all fields are sent, in the order they first appear.
+    @param enc the encoder
+    @param fields the list of fields, the strings are copied
+    @param num_fields number of fields
+*/
+void delta_encoder_schema(delta_encoder_t *enc, char const *const *fields, int num_fields);
+
+/** Update the last values of the sensor of an event, keyed by model, id, and channel.
+
+    Integer, double, and string fields are kept, the changed fields are sent with the next frame.
+    Events without a model are ignored.
+*/
+void delta_encoder_add(delta_encoder_t *enc, data_t *data);
+
+/** Encode the changes since the last frame.
+
+    The sensors are taken in turn, the sensors that do not fit are sent with a later frame.
+    @param enc the encoder
+    @param buf the output buffer
+    @param size the largest frame
+    @param now the time of the frame
+    @return the length of the frame, 0 if there are no changes
+*/
+size_t delta_encoder_frame(delta_encoder_t *enc, uint8_t *buf, size_t size, time_t now);
+
+/// Get the bytes of the sensor table, 0 if enc is NULL.
+size_t delta_encoder_memory(delta_encoder_t const *enc);
+
+/// Send an encoded frame to a byte sink, e.g. a file, a serial port, or a datagram.
+typedef void (*delta_sink_fn)(void *ctx, uint8_t const *frame, size_t len);
+
+/// Free the context of a byte sink.
+typedef void (*delta_sink_free_fn)(void *ctx);
+
+/// Options of the delta output.
+typedef struct delta_output_opts {
+    unsigned interval;    ///< time between the frames in seconds, 0 for DELTA_INTERVAL
+    unsigned mtu;         ///< largest frame in bytes, 0 for DELTA_MTU
+    unsigned key_updates; ///< define a sensor again after this many updates, 0 for DELTA_KEY_UPDATES
+} delta_output_opts_t;
+
+/** Construct data output of delta encoded frames to a byte sink.
+
+    A frame is encoded and sent on the sync of the output once the interval is over,
+    a last frame is sent when the output is freed.
+    @param opts the options
+    @param sink the byte sink
+    @param sink_free frees the context of the sink with the output, may be NULL
+    @param ctx the context of the sink, it is not freed if the output can not be created
+    @return the new output, or NULL on alloc failure
+*/
+struct data_output *data_output_delta_create(delta_output_opts_t const *opts, delta_sink_fn sink, delta_sink_free_fn sink_free, void *ctx);
+
+/// Construct data output of delta encoded frames to a file or serial port, each frame is prefixed with its length as a varint.
+struct data_output *data_output_delta_file_create(FILE *file, delta_output_opts_t const *opts);
+
+#endif /* INCLUDE_OUTPUT_DELTA_H_ */
@@ -27,4 +27,29 @@ struct data_output *data_output_json_create(FILE *file);
 
 struct data_output *data_output_kv_create(FILE *file);
 
+/** Construct data output for a CBOR sequence, one CBOR map per event.
+
+    @param file the output stream, should be opened in binary mode
+    @return The initialized data output.
+            You must release this object with data_output_free once you're done with it.
+*/
+struct data_output *data_output_cbor_create(FILE *file);
+
+/// Flush policy of a file output, all zero flushes after every event.
+typedef struct file_flush_policy {
+    unsigned events; ///< flush after this many events
+    unsigned secs;   ///< flush if this many seconds passed since the last flush
+    unsigned bytes;  ///< size of the file buffer, a full buffer is written out, not used for stdout
+    int sync;        ///< fsync() the file after each flush
+} file_flush_policy_t;
+
+/** Set the flush policy of a CSV, JSON, KV, or CBOR output.
+
+    Must be called before the first event is printed.
+    Pending events are written out by data_output_sync() and when the output is freed.
+    @param output the data_output handle from data_output_x_create
+    @param policy the flush policy, the values are copied
+*/
+void data_output_file_policy(struct data_output *output, file_flush_policy_t const *policy);
+
 #endif /* INCLUDE_OUTPUT_FILE_H_ */
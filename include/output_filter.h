@@ -0,0 +1,122 @@
+/** @file
+    Output filter, passes only changed events of each sensor or limits the rate per sensor,
+    selects the models and the printed fields.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_FILTER_H_
+#define INCLUDE_OUTPUT_FILTER_H_
+
+#include <stdint.h>
+
+/// Sensors kept by a filter, a power of two, the least recently passed sensor is replaced if full.
+#define OUTPUT_FILTER_SIZE 1024
+/// Slots probed for a sensor.
+#define OUTPUT_FILTER_PROBES 8
+/// Numbers of an event compared with the tolerance, further numbers must be equal.
+#define OUTPUT_FILTER_VALUES 8
+
+struct data;
+struct data_projection;
+
+/// Time between IQ captures of a filter, unless set with the iq option.
+#define OUTPUT_FILTER_IQ_MS 1000
+
+/// Length of the lists of fields and models of the filter options.
+#define OUTPUT_FILTER_LIST 512
+
+/// Filter options of an output, e.g. "changes=0.1,every=10m,limit=30s,models=Acurite*,exclude=mic,iq=1m".
+typedef struct output_filter_opts {
+    int changes;       ///< pass only events that differ from the last passed event of the sensor
+    double tolerance;  ///< numbers that differ by at most this are unchanged
+    unsigned every_ms; ///< pass an unchanged event after this time, 0 for never
+    unsigned limit_ms; ///< pass at most one event of a sensor within this time, 0 for no limit
+    char fields[OUTPUT_FILTER_LIST];  ///< ':' separated fields to print, empty for all
+    char exclude[OUTPUT_FILTER_LIST]; ///< ':' separated fields not to print
+    char models[OUTPUT_FILTER_LIST];  ///< ':' separated models to pass, a trailing '*' matches a prefix, empty for all
+    int raw;           ///< 1: also the raw packages of -Y raw, 2: only the raw packages
+    int iq;            ///< capture the IQ samples of the events of the listed models
+    unsigned iq_ms;    ///< capture at most one event within this time
+} output_filter_opts_t;
+
+typedef struct output_filter output_filter_t;
+
+/** Take the filter options out of an output argument.
+
+    The options "changes[=<tolerance>]", "every=<time>", "limit=<time>", "fields=<list>",
+    "exclude=<list>", "models=<list>", "raw[=only]" and "iq[=<time>]" are removed from the comma separated options,
+    the remaining argument is left for the output.
+    @param arg the output argument, modified in place, may be NULL
+    @param opts the options found
+    @return 1 if any filter option was found, 0 otherwise
+*/
+int output_filter_strip(char *arg, output_filter_opts_t *opts);
+
+/** Create a filter for the output at an index of the output handlers.
+
+    @param index the index of the output
+    @param opts the filter options
+    @return the new filter, or NULL on error
+*/
+output_filter_t *output_filter_create(unsigned index, output_filter_opts_t const *opts);
+
+/// Free a filter.
+void output_filter_free(output_filter_t *filter);
+
+/// Get the index of the output of a filter.
+unsigned output_filter_index(output_filter_t const *filter);
+
+/// Get the number of events a filter dropped.
+unsigned output_filter_drops(output_filter_t const *filter);
+
+/// Get the raw option of a filter, 1: also the raw packages, 2: only the raw packages.
+int output_filter_raw(output_filter_t const *filter);
+
+/// Get the ':' separated models of the models option, empty for all.
+char const *output_filter_models(output_filter_t const *filter);
+
+/// Check if a filter needs to see each event, with the changes or limit options, otherwise only the model is checked.
+int output_filter_per_event(output_filter_t const *filter);
+
+/// Count an event dropped for the models option, see output_route_lookup().
+void output_filter_drop(output_filter_t *filter);
+
+/** Create the projection of the fields and exclude options of a filter.
+
+    @param filter the filter
+    @return the new projection, see data_projection_create(), or NULL if all fields are printed
+*/
+struct data_projection *output_filter_projection(output_filter_t const *filter);
+
+/** Check an event, events without a model are always passed.
+
+    Events of a model that is not listed by the models option are dropped.
+    The sensor is keyed by the model, id, and channel. The time, and the modulation,
+    frequency, and level meta data are not compared.
+    @param filter the filter
+    @param data the event
+    @param now_ms the time of the event
+    @return 1 to print the event, 0 if it is dropped
+*/
+int output_filter_pass(output_filter_t *filter, struct data const *data, uint64_t now_ms);
+
+/** Check if the IQ samples of an event are to be captured.
+
+    The event needs a model listed by the models option, at most one event
+    is captured within the time of the iq option. The changes and limit options
+    do not apply.
+    @param filter the filter
+    @param data the event
+    @param now_ms the time of the event
+    @return 1 to capture the event, 0 otherwise
+*/
+int output_filter_iq(output_filter_t *filter, struct data const *data, uint64_t now_ms);
+
+/// Check if a model is in a ':' separated list, a trailing '*' matches a prefix.
+int output_filter_model_listed(char const *list, char const *model);
+
+#endif /* INCLUDE_OUTPUT_FILTER_H_ */
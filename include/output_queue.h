@@ -0,0 +1,92 @@
+/** @file
+    Output queue, prints events to a slow output on a writer thread.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_QUEUE_H_
+#define INCLUDE_OUTPUT_QUEUE_H_
+
+#include <stddef.h>
+
+struct data_output;
+
+/// What to do with an event if the queue is full.
+typedef enum output_queue_policy {
+    OUTPUT_QUEUE_BLOCK,       ///< wait for the writer thread to take an event
+    OUTPUT_QUEUE_DROP_OLDEST, ///< drop the oldest queued event
+    OUTPUT_QUEUE_DROP_NEWEST, ///< drop the new event
+} output_queue_policy_t;
+
+/** Create an output queue in front of an output.
+
+    The events are retained and printed and flushed on a writer thread,
+    the queue owns the inner output and frees it after the last event is printed.
+    The queue must only be fed and freed from one thread.
+    Urgent events, see data_output_print_urgent(), take a small lane served first.
+    @param inner the output to print to
+    @param size maximum number of queued events
+    @param policy what to do with an event if the queue is full
+    @return the new queue output, or the inner output on error or if built without threads support
+*/
+struct data_output *data_output_queue_create(struct data_output *inner, unsigned size, output_queue_policy_t policy);
+
+/** Create an output queue in front of an output that is printed by polling.
+
+    Like data_output_queue_create() but without a writer thread, the events are
+    printed and flushed by data_output_queue_poll() on the thread that owns the inner output.
+    Freeing the queue prints the remaining events, stop the polling thread first.
+    @param inner the output to print to
+    @param size maximum number of queued events
+    @param policy what to do with an event if the queue is full, must not block if the polling thread waits for the feeding thread
+    @param wake called on the feeding thread for each queued event or sync request
+    @param wake_ctx the context for @p wake
+    @return the new queue output, or the inner output on error or if built without threads support
+*/
+struct data_output *data_output_queue_create_polled(struct data_output *inner, unsigned size, output_queue_policy_t policy, void (*wake)(void *ctx), void *wake_ctx);
+
+/** Print the queued events and sync requests of a polled output queue.
+
+    @param output an output from data_output_queue_create_polled()
+*/
+void data_output_queue_poll(struct data_output *output);
+
+/** Get the number of events dropped by an output queue.
+
+    @param output an output from data_output_queue_create()
+    @return the number of dropped events, 0 if the output is not a queue
+*/
+unsigned data_output_queue_drops(struct data_output *output);
+
+/** Get the number of events waiting in an output queue.
+
+    @param output an output from data_output_queue_create()
+    @return the number of queued events, 0 if the output is not a queue
+*/
+unsigned data_output_queue_depth(struct data_output *output);
+
+/** Get the bytes of an output queue, the ring and the queued events, without the inner output.
+
+    @param output an output from data_output_queue_create()
+    @return the bytes, 0 if the output is not a queue
+*/
+size_t data_output_queue_memory(struct data_output *output);
+
+/** Check if an output is an output queue.
+
+    @param output an output
+    @return 1 if the output is from data_output_queue_create(), 0 otherwise
+*/
+int data_output_queue_check(struct data_output *output);
+
+/** Get the output an output queue prints to.
+
+    @param output an output
+    @return the inner output if the output is from data_output_queue_create(), the output otherwise
+*/
+struct data_output *data_output_queue_inner(struct data_output *output);
+
+#endif /* INCLUDE_OUTPUT_QUEUE_H_ */
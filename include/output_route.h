@@ -0,0 +1,53 @@
+/** @file
+    Output routing table, the outputs of an event by model as a bitmask.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_ROUTE_H_
+#define INCLUDE_OUTPUT_ROUTE_H_
+
+#include <stdint.h>
+
+/// Models in the routing table, a power of two, further models are routed without caching.
+#define OUTPUT_ROUTE_MODELS 512
+
+struct output_filter;
+
+typedef struct output_route output_route_t;
+
+/** Compile the routing table of the outputs.
+
+    The models and raw options of the filters are compiled into masks of the outputs,
+    the masks of a model are computed on its first event.
+    @param num_outputs number of outputs
+    @param filters the filter of each output, NULL for an output without a filter
+    @return the new routing table, or NULL on alloc failure
+*/
+output_route_t *output_route_create(unsigned num_outputs, struct output_filter *const *filters);
+
+void output_route_free(output_route_t *route);
+
+/// Get the number of outputs of a routing table, 0 if route is NULL.
+unsigned output_route_outputs(output_route_t const *route);
+
+/** Get the outputs of an event.
+
+    Outputs with a models option that does not list the model are dropped,
+    the drop is counted by the filter. Events without a model go to all outputs.
+    Raw packages go only to the outputs with the raw option, if there are any,
+    and outputs with the raw=only option get only those.
+    @param route the routing table
+    @param model the model of the event, may be NULL
+    @param raw_event the event is a raw package
+    @return the mask of the outputs, a bit for each output in words of 64 bits
+*/
+uint64_t const *output_route_lookup(output_route_t *route, char const *model, int raw_event);
+
+/// Check if the filter of an output needs to see each event, see output_filter_per_event().
+int output_route_per_event(output_route_t const *route, unsigned index);
+
+#endif /* INCLUDE_OUTPUT_ROUTE_H_ */
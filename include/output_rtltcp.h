@@ -18,14 +18,27 @@
 
 struct r_cfg;
 
+/** Options of an rtl_tcp server, the processing is shared by all clients of the server.
+
+    With any of sample_rate, frequency, or sample_size set the samples are processed once
+    on the server thread, the frames are queued for the server thread as read.
+*/
+typedef struct rtltcp_output_opts {
+    unsigned client_buffer; ///< bytes queued for each client before frames are dropped, 0 for the default of 4M
+    uint32_t sample_rate;   ///< decimate to about this sample rate, 0 to keep the input rate
+    uint32_t frequency;     ///< select the sub-channel at this frequency, 0 for the center frequency
+    int sample_size;        ///< requantize to 2 for CU8 or 4 for CS16, 0 to keep the input format
+} rtltcp_output_opts_t;
+
 /** Construct rtl_tcp data output.
 
     @param host the server host to bind
     @param port the server port to bind
     @param cfg the r_api config to use
+    @param opts the options of the server
     @return The initialized rtltcp output instance.
             You must release this object with raw_output_free once you're done with it.
 */
-struct raw_output *raw_output_rtltcp_create(char const *host, char const *port, struct r_cfg *cfg);
+struct raw_output *raw_output_rtltcp_create(char const *host, char const *port, struct r_cfg *cfg, rtltcp_output_opts_t const *opts);
 
 #endif /* INCLUDE_OUTPUT_RTLTCP_H_ */
@@ -0,0 +1,26 @@
+/** @file
+    Shared memory ring output for rtl_433 events.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_SHM_H_
+#define INCLUDE_OUTPUT_SHM_H_
+
+#include "data.h"
+#include <stddef.h>
+
+/** Construct data output for a shared memory ring, see shm_ring.h.
+
+    @param name the name of the shared memory object
+    @param size the size of the ring in bytes
+    @param format the payload format, SHM_RING_JSON or SHM_RING_CBOR
+    @return The initialized data output or NULL on error.
+            You must release this object with data_output_free once you're done with it.
+*/
+struct data_output *data_output_shm_create(char const *name, size_t size, unsigned format);
+
+#endif /* INCLUDE_OUTPUT_SHM_H_ */
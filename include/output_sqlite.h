@@ -0,0 +1,38 @@
+/** @file
+    SQLite output for rtl_433 events, a table per model.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_OUTPUT_SQLITE_H_
+#define INCLUDE_OUTPUT_SQLITE_H_
+
+#include "data.h"
+
+/// Events per transaction.
+#define OUTPUT_SQLITE_BATCH_ROWS 1000
+/// Seconds a transaction is kept open at most.
+#define OUTPUT_SQLITE_BATCH_SECS 1
+
+/** Construct data output for an SQLite database, a table per model.
+
+    The events of each model are inserted into a table named after the model, and
+    events without a model into the "events" table. The tables are created as needed,
+    with the declared fields (see data_output_start()) as columns, in that order.
+    A key not yet in a table adds a column, the column type is from the first value:
+    INTEGER, REAL, or TEXT. Nested data and arrays are written as JSON text.
+    The inserts use a prepared statement per table and are batched into transactions,
+    committed when full, when older than the time given, and on exit.
+
+    @param path the path of the database, an existing database is appended to
+    @param batch_rows the events per transaction, 0 for the default
+    @param batch_secs the seconds a transaction is kept open at most, 0 for the default
+    @return The initialized data output, NULL if SQLite is not available or the database can not be opened.
+            You must release this object with data_output_free once you're done with it.
+*/
+struct data_output *data_output_sqlite_create(char const *path, unsigned batch_rows, unsigned batch_secs);
+
+#endif /* INCLUDE_OUTPUT_SQLITE_H_ */
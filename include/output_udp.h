@@ -13,7 +13,23 @@
 #define INCLUDE_OUTPUT_UDP_H_
 
 #include "data.h"
+#include "output_delta.h"
 
-struct data_output *data_output_syslog_create(const char *host, const char *port);
+/** Construct data output for RFC 5424 syslog datagrams with the JSON event data.
+
+    @param host the syslog host
+    @param port the syslog port
+    @param mtu the maximum datagram size, larger events are dropped, 0 for the default of 1024
+    @param batch the number of datagrams to queue and send at once, they are sent at least on each sync
+    @return the new output, or NULL on error
+*/
+struct data_output *data_output_syslog_create(const char *host, const char *port, unsigned mtu, unsigned batch);
+
+/// Construct data output for CBOR datagrams, one event per datagram, see data_print_cbor().
+/// The mtu defaults to 1472 bytes and the batch is as with data_output_syslog_create().
+struct data_output *data_output_cbor_udp_create(const char *host, const char *port, unsigned mtu, unsigned batch);
+
+/// Construct data output of delta encoded frames as datagrams, one frame per datagram, see data_output_delta_create().
+struct data_output *data_output_delta_udp_create(const char *host, const char *port, delta_output_opts_t const *opts);
 
 #endif /* INCLUDE_OUTPUT_UDP_H_ */
@@ -0,0 +1,44 @@
+/** @file
+    Runtime control of the CPU profiler, starts and stops a profile of a running instance.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PROFILER_H_
+#define INCLUDE_PROFILER_H_
+
+#define PROFILER_DEFAULT_SECONDS 60
+
+/// Returns 1 if the build has the CPU profiler, see ENABLE_PROFILER.
+int profiler_available(void);
+
+/** Start a CPU profile of all threads.
+
+    The profile is written with the gperftools format, view it with
+    `pprof -text ./src/rtl_433 <path>`.
+
+    @param path the output file, NULL for "rtl_433_<time>.prof"
+    @param seconds stop the profile after this time, 0 to run until profiler_stop()
+    @return 0 on success, -1 if not available, already running, or on error
+*/
+int profiler_start(char const *path, unsigned seconds);
+
+/** Stop a running CPU profile and write out the file.
+
+    @return 0 on success, -1 if no profile is running
+*/
+int profiler_stop(void);
+
+/// Stop the running CPU profile once the time is up, call this regularly.
+void profiler_poll(void);
+
+/// Returns 1 if a CPU profile is running.
+int profiler_running(void);
+
+/// Get the output file of the current or last profile, an empty string if none.
+char const *profiler_path(void);
+
+#endif /* INCLUDE_PROFILER_H_ */
@@ -14,7 +14,72 @@
 
 #include "pulse_detect.h"
 
+/// The modulation guessed by the analyzer.
+typedef enum pulse_class {
+    PULSE_CLASS_UNKNOWN,
+    PULSE_CLASS_SINGLE,
+    PULSE_CLASS_UNMODULATED,
+    PULSE_CLASS_PPM,
+    PULSE_CLASS_PWM_FIXED_GAP,
+    PULSE_CLASS_PWM_FIXED_PERIOD,
+    PULSE_CLASS_MANCHESTER,
+    PULSE_CLASS_PWM_PACKETS,
+    PULSE_CLASS_PCM,
+    PULSE_CLASS_PWM_SYNC,
+    PULSE_CLASS_COUNT,
+} pulse_class_t;
+
+/// Accumulated statistics of one signal class.
+typedef struct pulse_class_stats {
+    unsigned packages;
+    unsigned pulses;
+    double short_us; ///< sum of the short widths
+    double long_us;  ///< sum of the long widths
+    double reset_us; ///< sum of the reset limits
+} pulse_class_stats_t;
+
+/// Statistics of the batch mode, per package type (OOK, FSK) and signal class.
+typedef struct pulse_analyzer_stats {
+    unsigned interval; ///< packages between the summaries
+    unsigned packages; ///< packages since the last summary
+    unsigned total;    ///< packages analyzed
+    pulse_class_stats_t classes[2][PULSE_CLASS_COUNT];
+} pulse_analyzer_stats_t;
+
+/// Size of a flex decoder spec from pulse_analyzer_suggest().
+#define FLEX_SPEC_SIZE 256
+
 /// Analyze and print result.
 void pulse_analyzer(pulse_data_t *data, int package_type);
 
+/** Guess the modulation of a package quietly and format a flex decoder spec for it.
+
+    @param data the package
+    @param package_type PULSE_DATA_OOK or PULSE_DATA_FSK
+    @param name the decoder name in the spec
+    @param[out] spec the flex spec, empty if there is no flex modulation for the guess
+    @param size the size of spec, e.g. FLEX_SPEC_SIZE
+    @return the guessed modulation
+*/
+pulse_class_t pulse_analyzer_suggest(pulse_data_t const *data, int package_type, char const *name, char *spec, size_t size);
+
+/// A short name of a guessed modulation, e.g. "PWM fixed gap".
+char const *pulse_class_str(pulse_class_t guess);
+
+/** Create the statistics of the quiet batch mode.
+
+    @param interval number of packages between the summaries, 0 for only a summary at the end
+    @return the new statistics or NULL on alloc failure
+*/
+pulse_analyzer_stats_t *pulse_analyzer_stats_create(unsigned interval);
+
+/// Print the remaining summary and free the statistics, NULL is ignored.
+void pulse_analyzer_stats_free(pulse_analyzer_stats_t *stats);
+
+/// Analyze a package quietly and add the guessed signal class to the statistics, prints a summary every interval packages.
+void pulse_analyzer_batch(pulse_analyzer_stats_t *stats, pulse_data_t const *data, int package_type);
+
+/// Print a compact summary of the signal classes since the last summary, then clear them.
+void pulse_analyzer_stats_print(pulse_analyzer_stats_t *stats);
+
 #endif /* INCLUDE_PULSE_ANALYZER_H_ */
@@ -0,0 +1,50 @@
+/** @file
+    Arrow IPC pulse data export, a columnar file of the packages for offline analysis.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PULSE_ARROW_H_
+#define INCLUDE_PULSE_ARROW_H_
+
+#include <stdio.h>
+#include "pulse_data.h"
+
+/// Packages per record batch, a batch is also written once it has this many pulses.
+#define PULSE_ARROW_BATCH_ROWS 4096
+#define PULSE_ARROW_BATCH_PULSES (1 << 20)
+
+typedef struct pulse_arrow pulse_arrow_t;
+
+/** Start an Arrow IPC file (Feather V2) of packages, the schema is written here.
+
+    The columns are offset, rate_Hz, mod, freq_Hz, freq1_Hz, freq2_Hz, rssi_dB, snr_dB,
+    noise_dB, events, and the pulses and gaps as lists of widths in samples.
+    With threads support the record batches are encoded and written on a writer thread.
+
+    @param file the file to write, opened for writing at the start
+    @return the new writer or NULL on alloc failure
+*/
+pulse_arrow_t *pulse_arrow_create(FILE *file);
+
+/** Add a package, a full record batch is handed to the writer.
+
+    @param w the writer
+    @param data the package, with the levels of calc_rssi_snr()
+    @param events the events of the decoders for the package
+*/
+void pulse_arrow_add(pulse_arrow_t *w, pulse_data_t const *data, int events);
+
+/** Write the last record batch and the footer, and free the writer.
+
+    The file is flushed but not closed.
+
+    @param w the writer, NULL is ignored
+    @return 0 on success, -1 if the file is incomplete
+*/
+int pulse_arrow_close(pulse_arrow_t *w);
+
+#endif /* INCLUDE_PULSE_ARROW_H_ */
@@ -0,0 +1,96 @@
+/** @file
+    Binary pulse data format, a compact and fast to parse container of pulse_data_t.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PULSE_BIN_H_
+#define INCLUDE_PULSE_BIN_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "pulse_data.h"
+#include "sample_reader.h"
+
+/// Longest encoded package, all varints at their maximum length.
+#define PULSE_BIN_MAX_PACKAGE (9 * 10 + 7 * 4 + PD_MAX_PULSES * 2 * 5)
+/// Room needed to encode a package with a number of pulses, see pulse_bin_encode_package().
+#define PULSE_BIN_PACKAGE_SIZE(num_pulses) (9 * 10 + 7 * 4 + ((size_t)(num_pulses) + 1) * 2 * 5)
+
+/// A binary pulse data file being read, regular files are mapped.
+typedef struct pulse_bin_reader {
+    sample_reader_t reader;
+    uint8_t const *pos; ///< next byte to parse
+    uint8_t const *end; ///< end of the parsable bytes
+    uint8_t *buf;       ///< read buffer, used if the file is not mapped
+    uint32_t sample_rate;
+} pulse_bin_reader_t;
+
+/// Print a header for the binary pulse data format.
+void pulse_bin_print_header(FILE *file, uint32_t sample_rate);
+
+/// Write the content of a pulse_data_t structure in the binary pulse data format.
+void pulse_bin_dump(FILE *file, pulse_data_t const *data);
+
+/** Encode a header and one package in the binary pulse data format, e.g. for a datagram.
+
+    @param buf the buffer to write to
+    @param size the size of the buffer, PULSE_BIN_MAX_PACKAGE and a header always fit
+    @param sample_rate the sample rate for the header
+    @param data the pulse data to encode
+    @return the encoded length, 0 if there are no pulses or the package does not fit
+*/
+size_t pulse_bin_encode(uint8_t *buf, size_t size, uint32_t sample_rate, pulse_data_t const *data);
+
+/** Encode one package without a header, e.g. to be appended to a file after pulse_bin_print_header().
+
+    @param buf the buffer to write to
+    @param size the size of the buffer, PULSE_BIN_MAX_PACKAGE always fits
+    @param data the pulse data to encode
+    @return the encoded length, 0 if there are no pulses or the package does not fit
+*/
+size_t pulse_bin_encode_package(uint8_t *buf, size_t size, pulse_data_t const *data);
+
+/** Decode a header and one package in the binary pulse data format, see pulse_bin_encode().
+
+    @param buf the encoded bytes
+    @param len the number of bytes, all need to be used by the package
+    @param data the pulse data to load into
+    @return 0 on success, -1 on a truncated or invalid package
+*/
+int pulse_bin_decode(uint8_t const *buf, size_t len, pulse_data_t *data);
+
+/** Decode one package without a header, see pulse_bin_encode_package().
+
+    @param buf the encoded bytes
+    @param len the number of bytes, all need to be used by the package
+    @param sample_rate the sample rate for a package without one
+    @param data the pulse data to load into
+    @return 0 on success, -1 on a truncated or invalid package
+*/
+int pulse_bin_decode_package(uint8_t const *buf, size_t len, uint32_t sample_rate, pulse_data_t *data);
+
+/** Open a binary pulse data file and check the header.
+
+    @param reader the reader to set up
+    @param file the open file, stays owned by the caller
+    @return 0 on success, -1 if the header is invalid or on alloc failure
+*/
+int pulse_bin_reader_open(pulse_bin_reader_t *reader, FILE *file);
+
+/** Read the next pulse_data_t structure from a binary pulse data file.
+
+    @param reader the reader
+    @param data the pulse data to load into
+    @return 1 if a package was loaded, 0 at the end of the file, -1 on a truncated or invalid package
+*/
+int pulse_bin_load(pulse_bin_reader_t *reader, pulse_data_t *data);
+
+/** Release the reader, the file is not closed. */
+void pulse_bin_reader_close(pulse_bin_reader_t *reader);
+
+#endif /* INCLUDE_PULSE_BIN_H_ */
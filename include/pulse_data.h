@@ -17,7 +17,8 @@
 #include <stdio.h>
 #include "data.h"
 
-#define PD_MAX_PULSES        1200 // Maximum number of pulses before forcing End Of Package
+#define PD_MAX_PULSES        16384 // Maximum number of pulses before forcing End Of Package (sanity limit)
+#define PD_INIT_PULSES       64   // Initial pulse storage, the storage grows as needed
 #define PD_MIN_PULSES        16   // Minimum number of pulses before declaring a proper package
 #define PD_MIN_PULSE_SAMPLES 10   // Minimum number of samples in a pulse for proper detection
 #define PD_MIN_GAP_MS        10   // Minimum gap size in milliseconds to exceed to declare End Of Package
@@ -33,8 +34,9 @@ typedef struct pulse_data {
     unsigned start_ago;   ///< Start of first pulse in number of samples ago.
     unsigned end_ago;     ///< End of last pulse in number of samples ago.
     unsigned int num_pulses;
-    int pulse[PD_MAX_PULSES]; ///< Width of pulses (high) in number of samples.
-    int gap[PD_MAX_PULSES];   ///< Width of gaps between pulses (low) in number of samples.
+    unsigned max_pulses;      ///< Allocated length of pulse and gap, see pulse_data_reserve().
+    int *pulse;               ///< Width of pulses (high) in number of samples.
+    int *gap;                 ///< Width of gaps between pulses (low) in number of samples.
     int ook_low_estimate;     ///< Estimate for the OOK low level (base noise level) at beginning of package.
     int ook_high_estimate;    ///< Estimate for the OOK high level at end of package.
     int fsk_f1_est;           ///< Estimate for the F1 frequency for FSK.
@@ -46,24 +48,60 @@ typedef struct pulse_data {
     float rssi_db;
     float snr_db;
     float noise_db;
+    int levels_due;           ///< The levels and frequencies above are not computed yet, see calc_rssi_snr().
 } pulse_data_t;
 
-/// Clear the content of a pulse_data_t structure.
+/// Clear the content of a pulse_data_t structure, keeps the allocated storage.
 void pulse_data_clear(pulse_data_t *data);
 
+/// Free the storage of a pulse_data_t structure and clear it.
+void pulse_data_free(pulse_data_t *data);
+
+/// Get the bytes of the allocated storage of a pulse_data_t structure.
+size_t pulse_data_memory(pulse_data_t const *data);
+
+/** Grow the storage of a pulse_data_t structure.
+
+    The storage starts at PD_INIT_PULSES and doubles as needed, up to PD_MAX_PULSES.
+    @param data the pulse data
+    @param num_pulses the number of pulses (and gaps) needed
+    @return 0 on success, -1 if the limit is reached or on alloc failure
+*/
+int pulse_data_reserve(pulse_data_t *data, unsigned num_pulses);
+
 /// Shift out part of the data to make room for more.
 void pulse_data_shift(pulse_data_t *data);
 
+/** Compute a fingerprint of the pulse and gap widths.
+
+    The widths are quantized to about 12% so repeated transmissions of the same frame
+    usually map to the same value, the final gap is not included.
+    @param data the pulse train
+    @return a hash of the quantized widths and the number of pulses
+*/
+uint32_t pulse_data_fingerprint(pulse_data_t const *data);
+
 /// Print the content of a pulse_data_t structure (for debug).
 void pulse_data_print(pulse_data_t const *data);
 
 /// Dump the content of a pulse_data_t structure as raw binary.
 void pulse_data_dump_raw(uint8_t *buf, unsigned len, uint64_t buf_offset, pulse_data_t const *data, uint8_t bits);
 
-/// Print a header for the VCD format.
+/// VCD value changes are formatted in blocks of this size and written at once.
+#define VCD_BLOCK_SIZE 8192
+/// Size of the file buffer of a VCD dumper, the blocks are flushed to the file in this size.
+#define VCD_FILE_BUFFER (1 << 20)
+
+/// Print a header for the VCD format, the FRAME, AM (OOK), and FM (FSK) signals of one file.
 void pulse_data_print_vcd_header(FILE *file, uint32_t sample_rate);
 
-/// Print the content of a pulse_data_t structure in VCD format.
+/** Print the content of a pulse_data_t structure in VCD format.
+
+    The pulses are the signal ch_id, the package is marked on the FRAME signal.
+    @param file the VCD file
+    @param data the pulses
+    @param ch_id the VCD id of the signal, '\'' for AM (OOK), '"' for FM (FSK)
+*/
 void pulse_data_print_vcd(FILE *file, pulse_data_t const *data, int ch_id);
 
 /// Read the next pulse_data_t structure from OOK text.
@@ -78,4 +116,7 @@ void pulse_data_dump(FILE *file, pulse_data_t *data);
 /// Print the content of a pulse_data_t structure as OOK json.
 data_t *pulse_data_print_data(pulse_data_t *data);
 
+/// Print a pulse_data_t structure as OOK json with the pulses as one compact RfRaw string, see rfraw_format().
+data_t *pulse_data_print_rfraw(pulse_data_t const *data);
+
 #endif /* INCLUDE_PULSE_DATA_H_ */
@@ -16,6 +16,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include "pulse_data.h"
+#include "pulse_detect_fsk.h"
 #include "data.h"
 
 /// Package types.
@@ -29,15 +30,22 @@ enum {
     FSK_PULSE_DETECT_OLD,
     FSK_PULSE_DETECT_NEW,
     FSK_PULSE_DETECT_AUTO,
+    FSK_PULSE_DETECT_BOTH,
     FSK_PULSE_DETECT_END,
 };
 
 typedef struct pulse_detect pulse_detect_t;
 
+/// Extra fixed detection levels at most, see pulse_detect_set_extra_levels().
+#define PULSE_DETECT_EXTRA_LEVELS 2
+
 pulse_detect_t *pulse_detect_create(void);
 
 void pulse_detect_free(pulse_detect_t *pulse_detect);
 
+/// Get the bytes of the pulse detector and its pulse storage, 0 if pulse_detect is NULL.
+size_t pulse_detect_memory(pulse_detect_t const *pulse_detect);
+
 /// Set pulse detector level values.
 ///
 /// @param pulse_detect The pulse_detect instance
@@ -48,6 +56,114 @@ void pulse_detect_free(pulse_detect_t *pulse_detect);
 /// @param verbosity Debug output verbosity, 0=None, 1=Levels, 2=Histograms
 void pulse_detect_set_levels(pulse_detect_t *pulse_detect, int use_mag_est, float fixed_high_level, float min_high_level, float high_low_ratio, int verbosity);
 
+/// Drop the package in progress, the level estimates are kept.
+///
+/// E.g. when the input is interrupted by a retune and resumed later.
+///
+/// @param pulse_detect The pulse_detect instance
+void pulse_detect_reset(pulse_detect_t *pulse_detect);
+
+/// The level estimates of a detector at an extra level, see pulse_detect_state_t.
+typedef struct pulse_detect_levels {
+    int ook_low_estimate;  ///< Estimate for the OOK low level (base noise level)
+    int ook_high_estimate; ///< Estimate for the OOK high level
+    int lead_in_counter;   ///< Counter for allowing initial noise estimate to settle
+} pulse_detect_levels_t;
+
+/// The state of an idle pulse detector between input buffers, see pulse_detect_get_state().
+typedef struct pulse_detect_state {
+    pulse_detect_levels_t levels;                          ///< The level estimates
+    pulse_detect_fsk_t fsk;                                ///< State of the FSK detector
+    pulse_detect_fsk_t fsk_alt;                            ///< State of the other FSK detector
+    pulse_detect_levels_t extra[PULSE_DETECT_EXTRA_LEVELS]; ///< The level estimates at the extra levels
+} pulse_detect_state_t;
+
+/// Get the state of an idle detector, e.g. to continue an interrupted run of a file.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param[out] state The state, only valid if the detector is idle
+/// @return 0 on success, -1 while a package is in progress
+int pulse_detect_get_state(pulse_detect_t const *pulse_detect, pulse_detect_state_t *state);
+
+/// Restore the state of an idle detector, the levels set are kept.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param state The state from pulse_detect_get_state()
+void pulse_detect_set_state(pulse_detect_t *pulse_detect, pulse_detect_state_t const *state);
+
+/// Enable running the other FSK pulse detector alongside the selected one.
+///
+/// Both detectors see the same FM data in one pass,
+/// the second pulse train is available with pulse_detect_fsk_alt_pulses().
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param enable 1 to run both FSK detectors, 0 to run only the selected one
+void pulse_detect_set_fsk_alt(pulse_detect_t *pulse_detect, int enable);
+
+/// Get the pulse train of the other FSK pulse detector.
+///
+/// Valid after pulse_detect_package() returned PULSE_DATA_FSK.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @return the second FSK pulse train or NULL if not enabled
+pulse_data_t *pulse_detect_fsk_alt_pulses(pulse_detect_t *pulse_detect);
+
+/// Detect packages at extra fixed levels too, e.g. a weak signal next to a strong one.
+///
+/// Each level runs a detector of its own over the same envelope and FM data,
+/// the packages are read with pulse_detect_extra_package() after pulse_detect_package().
+/// The detectors follow pulse_detect_set_levels(), with their own fixed level.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param levels The fixed levels in dB, e.g. -20.0
+/// @param num The number of levels, at most PULSE_DETECT_EXTRA_LEVELS, 0 for none
+/// @return 0 on success, -1 on alloc failure
+int pulse_detect_set_extra_levels(pulse_detect_t *pulse_detect, float const *levels, unsigned num);
+
+/// Get the number of extra levels.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @return the number of extra levels set, 0 for none
+unsigned pulse_detect_extra_levels(pulse_detect_t const *pulse_detect);
+
+/// Detect the next package at an extra level, see pulse_detect_package().
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param index The index of the extra level
+/// @param envelope_data Samples with amplitude envelope of carrier
+/// @param fm_data Samples with frequency offset from center frequency
+/// @param len Number of samples in input buffers
+/// @param samp_rate Sample rate in samples per second
+/// @param sample_offset Offset tracking for ringbuffer
+/// @param fpdm Index of filter setting to use
+/// @param[out] pulses The OOK pulse train of the extra level
+/// @param[out] fsk_pulses The FSK pulse train of the extra level
+/// @return the package type as with pulse_detect_package(), 0 if all input sample data is processed
+int pulse_detect_extra_package(pulse_detect_t *pulse_detect, unsigned index, int16_t const *envelope_data, int16_t const *fm_data, int len, uint32_t samp_rate, uint64_t sample_offset, unsigned fpdm, pulse_data_t **pulses, pulse_data_t **fsk_pulses);
+
+/// Set the 8-bit envelope of the samples given to the next calls of pulse_detect_package().
+///
+/// The search for the next pulse and the test for silent blocks run on the 8-bit codes,
+/// twice the samples per vector, and fall back to the envelope only near the threshold.
+/// The level estimates always use the envelope, the result is the same with or without.
+/// The extra levels use it too. See baseband_envelope_8bit().
+///
+/// @param pulse_detect The pulse_detect instance
+/// @param envelope_8bit The 8-bit codes of the envelope, NULL to search the envelope
+void pulse_detect_set_envelope_8bit(pulse_detect_t *pulse_detect, uint8_t const *envelope_8bit);
+
+/// Get the envelope level the FM samples are needed above.
+///
+/// The detector reads FM samples only in a pulse, which ends below the threshold
+/// less the hysteresis. The threshold is at least half the minimum high level
+/// (or the fixed level), samples up to the returned level can not be in a pulse.
+/// A short gap start after a pulse is read too, guard samples need to cover that.
+/// The extra levels are included.
+///
+/// @param pulse_detect The pulse_detect instance
+/// @return the highest envelope level where the FM samples can be skipped
+int pulse_detect_fm_level(pulse_detect_t const *pulse_detect);
+
 /// Demodulate On/Off Keying (OOK) and Frequency Shift Keying (FSK) from an envelope signal.
 ///
 /// Function is stateful and can be called with chunks of input data.
@@ -67,4 +183,25 @@ void pulse_detect_set_levels(pulse_detect_t *pulse_detect, int use_mag_est, floa
 /// @retval 2 FSK package is detected (but all sample data is still not completely processed)
 int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_data, int16_t const *fm_data, int len, uint32_t samp_rate, uint64_t sample_offset, pulse_data_t *pulses, pulse_data_t *fsk_pulses, unsigned fpdm);
 
+/// Find the first envelope sample above a level, compares in blocks of 16 to vectorize.
+///
+/// @return the index of the first sample above the level, or len if there is none
+int envelope_find_above(int16_t const *envelope_data, int len, int level);
+
+/// Find the first envelope sample below a level, compares in blocks of 16 to vectorize.
+///
+/// @return the index of the first sample below the level, or len if there is none
+int envelope_find_below(int16_t const *envelope_data, int len, int level);
+
+/// Find the first envelope sample above a level, compares the 8-bit codes in blocks of 32
+/// and checks the blocks with candidates on the envelope, see baseband_envelope_8bit().
+///
+/// @return the index of the first sample above the level, or len if there is none
+int envelope_find_above_8bit(uint8_t const *envelope_8bit, int16_t const *envelope_data, int len, int level);
+
+/// Find the first envelope sample below a level, see envelope_find_above_8bit().
+///
+/// @return the index of the first sample below the level, or len if there is none
+int envelope_find_below_8bit(uint8_t const *envelope_8bit, int16_t const *envelope_data, int len, int level);
+
 #endif /* INCLUDE_PULSE_DETECT_H_ */
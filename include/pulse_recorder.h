@@ -0,0 +1,70 @@
+/** @file
+    Pulse flight recorder, keeps the recent packages in a ring to dump on demand.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PULSE_RECORDER_H_
+#define INCLUDE_PULSE_RECORDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// Default time the packages are kept, in minutes.
+#define PULSE_RECORDER_MINUTES 10
+/// Default size of the ring, in MB.
+#define PULSE_RECORDER_MB 4
+
+struct pulse_data;
+struct data;
+
+typedef struct pulse_recorder pulse_recorder_t;
+
+/** Create a recorder, the ring is allocated once.
+
+    @param minutes the packages older than this are dropped
+    @param size the size of the ring in bytes, the oldest packages are dropped if full
+    @return the new recorder or NULL on alloc failure
+*/
+pulse_recorder_t *pulse_recorder_create(unsigned minutes, size_t size);
+
+/// Free a recorder and the packages kept.
+void pulse_recorder_free(pulse_recorder_t *rec);
+
+/// Get the bytes of the recorder ring, 0 if rec is NULL.
+size_t pulse_recorder_memory(pulse_recorder_t const *rec);
+
+/** Keep a copy of a package, encoded as in the binary pulse data format.
+
+    @param rec the recorder
+    @param data the package, with the levels computed
+    @param time_ms the wall time of the package in ms since the epoch
+*/
+void pulse_recorder_add(pulse_recorder_t *rec, struct pulse_data const *data, uint64_t time_ms);
+
+/** Write the packages kept in the binary pulse data format, readable with -r.
+
+    @param rec the recorder
+    @param file the open file, stays owned by the caller
+    @param sample_rate the sample rate for the header
+    @return the number of packages written
+*/
+unsigned pulse_recorder_dump(pulse_recorder_t *rec, FILE *file, uint32_t sample_rate);
+
+/** Write the packages kept to a new file named with the time, see pulse_recorder_dump().
+
+    @param rec the recorder
+    @param sample_rate the sample rate for the header
+    @param[out] path the file name written, at least 64 chars
+    @return the number of packages written, -1 if the file can not be created
+*/
+int pulse_recorder_dump_file(pulse_recorder_t *rec, uint32_t sample_rate, char *path);
+
+/// Get the packages kept as a list of rfraw codes with the time and levels of each.
+struct data *pulse_recorder_data(pulse_recorder_t *rec);
+
+#endif /* INCLUDE_PULSE_RECORDER_H_ */
@@ -16,6 +16,7 @@
 
 #include "pulse_detect.h"
 #include "r_device.h"
+#include "bitbuffer.h"
 
 /// Demodulate a Pulse Code Modulation signal.
 ///
@@ -158,4 +159,48 @@ int pulse_slicer_osv1(const pulse_data_t *pulses, r_device *device);
 /// @return number of events processed
 int pulse_slicer_string(const char *code, r_device *device);
 
+/// Distinct decoder preambles matched in one pass over a shared slice, see r_device.preamble.
+#define SLICE_CACHE_PATTERNS 32
+
+/// Bit buffers of one sliced package, shared by decoders with the same slicing parameters.
+typedef struct slice_cache {
+    unsigned refs;        ///< number of decoders sharing this cache
+    int valid;            ///< set if the entries are for the current package
+    int recording;        ///< set while the slicer runs, events are recorded instead of decoded
+    unsigned num_entries;
+    unsigned max_entries;
+    struct slice_cache_entry *entries;
+    unsigned num_patterns; ///< distinct preambles of the sharing decoders
+    bitbuffer_pattern_t patterns[SLICE_CACHE_PATTERNS];
+} slice_cache_t;
+
+/// Slicer function, e.g. pulse_slicer_pcm().
+typedef int (*pulse_slicer_fn)(const pulse_data_t *pulses, r_device *device);
+
+/// Share the slice cache of a decoder with the same modulation and timing.
+///
+/// @param device The decoder to join
+/// @param other A decoder with the same slicing parameters, a cache is created if needed
+/// @return 0 on success, -1 on allocation failure
+int pulse_slicer_share(r_device *device, r_device *other);
+
+/// Release the slice cache of a decoder, the cache is freed with the last reference.
+void pulse_slicer_release(r_device *device);
+
+/// Mark the slice cache of a decoder as outdated, call this for each new package.
+void pulse_slicer_invalidate(r_device *device);
+
+/// Run a slicer, or reuse the bit buffers sliced for another decoder of the same cache.
+///
+/// The first decoder of a cache to see a package runs the slicer, the bit buffers are recorded.
+/// Each decoder then decodes a private copy of the recorded bit buffers.
+/// The preambles of all decoders of the cache are searched in one pass over each recorded event,
+/// decoders with a preamble that is in no row are not run.
+///
+/// @param pulses The pulse sequence to demodulate
+/// @param device The decoder to run
+/// @param slicer The slicer for the modulation of the decoder
+/// @return number of events processed
+int pulse_slicer_shared(const pulse_data_t *pulses, r_device *device, pulse_slicer_fn slicer);
+
 #endif /* INCLUDE_PULSE_SLICER_H_ */
@@ -0,0 +1,67 @@
+/** @file
+    UDP transport of pulse trains, from edge receivers to a central decoder.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_PULSE_UDP_H_
+#define INCLUDE_PULSE_UDP_H_
+
+#include <stdint.h>
+#include "pulse_data.h"
+
+/// Default port of the pulse trains.
+#define PULSE_UDP_PORT "1433"
+
+/// Longest numeric host of a sender, e.g. an IPv6 address.
+#define PULSE_UDP_PEER 48
+
+typedef struct pulse_udp pulse_udp_t;
+
+/** Create a sender of pulse trains, see -F pulses.
+
+    @param host the host of the central decoder
+    @param port the port of the central decoder
+    @return the new sender or NULL on error
+*/
+pulse_udp_t *pulse_udp_sender_create(char const *host, char const *port);
+
+/** Send a package as a datagram in the binary pulse data format.
+
+    A package too large for a datagram is dropped.
+
+    @param udp the sender
+    @param data the package to send
+*/
+void pulse_udp_send(pulse_udp_t *udp, pulse_data_t const *data);
+
+/** Create a receiver of pulse trains, see -r pulses.
+
+    @param host the host to bind, NULL for all addresses
+    @param port the port to bind
+    @return the new receiver or NULL on error
+*/
+pulse_udp_t *pulse_udp_receiver_create(char const *host, char const *port);
+
+/** Wait for the next package.
+
+    @param udp the receiver
+    @param data the pulse data to load into
+    @param timeout_ms the time to wait
+    @return 1 if a package was loaded, 0 on timeout, -1 on an invalid datagram or error
+*/
+int pulse_udp_receive(pulse_udp_t *udp, pulse_data_t *data, int timeout_ms);
+
+/// Get the numeric host of the edge receiver that sent the last package.
+char const *pulse_udp_peer(pulse_udp_t const *udp);
+
+/// Get the counts of packages sent or received, and dropped or invalid.
+void pulse_udp_counts(pulse_udp_t const *udp, unsigned *packages, unsigned *dropped);
+
+/// Close the socket and release the sender or receiver.
+void pulse_udp_free(pulse_udp_t *udp);
+
+#endif /* INCLUDE_PULSE_UDP_H_ */
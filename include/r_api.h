@@ -12,14 +12,24 @@
 #ifndef INCLUDE_R_API_H_
 #define INCLUDE_R_API_H_
 
+#include <stddef.h>
 #include <stdint.h>
+#include <time.h>
 
 struct r_cfg;
 struct r_device;
 struct data;
+struct data_record;
 struct pulse_data;
 struct list;
 struct mg_mgr;
+struct decoder_pool;
+struct decoder_dispatch;
+struct decoder_entry;
+struct sdr_input;
+struct dm_state;
+struct timeval;
+struct baseband_clip;
 
 /* general */
 
@@ -31,6 +41,15 @@ void r_init_cfg(struct r_cfg *cfg);
 
 void r_free_cfg(struct r_cfg *cfg);
 
+/// Create a config for a batch worker, with the settings of @p cfg and its own demod state and decoders, call after all decoders are registered.
+struct r_cfg *r_create_batch_cfg(struct r_cfg *cfg);
+
+/// Start a batch worker config over with a new demod state and new decoders, e.g. for the next file.
+void r_reset_batch_cfg(struct r_cfg *batch, struct r_cfg *cfg);
+
+/// Free a config from r_create_batch_cfg(), the shared settings are kept.
+void r_free_batch_cfg(struct r_cfg *batch);
+
 /* device decoder protocols */
 
 void register_protocol(struct r_cfg *cfg, struct r_device *r_dev, char *arg);
@@ -45,6 +64,9 @@ void register_all_protocols(struct r_cfg *cfg, unsigned disabled);
 
 void calc_rssi_snr(struct r_cfg *cfg, struct pulse_data *pulse_data);
 
+/// Compute the levels and frequencies of a package on first use, if they are due.
+void ensure_rssi_snr(struct r_cfg *cfg, struct pulse_data *pulse_data);
+
 char *time_pos_str(struct r_cfg *cfg, unsigned samples_ago, char *buf);
 
 char const **well_known_output_fields(struct r_cfg *cfg);
@@ -55,14 +77,133 @@ int run_ook_demods(struct list *r_devs, struct pulse_data *pulse_data);
 
 int run_fsk_demods(struct list *r_devs, struct pulse_data *fsk_pulse_data);
 
+/** Run the OOK decoders through a dispatch, the decoders of a priority run in parallel on the pool.
+
+    The dispatch is rebuilt from the decoders if it is not valid, e.g. after a decoder is registered.
+    @param pool the decoder pool, NULL to run on this thread
+    @param dispatch the dispatch of the decoders
+    @param r_devs the decoders
+    @param pulse_data the package
+    @return the number of events
+*/
+int run_ook_dispatch(struct decoder_pool *pool, struct decoder_dispatch *dispatch, struct list *r_devs, struct pulse_data *pulse_data);
+
+/// Run the FSK decoders through a dispatch, see run_ook_dispatch().
+int run_fsk_dispatch(struct decoder_pool *pool, struct decoder_dispatch *dispatch, struct list *r_devs, struct pulse_data *fsk_pulse_data);
+
+/** Run only the given decoders on a package, e.g. the decoders with events of an identical package.
+
+    @param entries the decoders with their slicers
+    @param len the number of decoders
+    @param pulse_data the package
+    @return the events of the decoders
+*/
+int run_decoder_entries(struct decoder_entry const *entries, unsigned len, struct pulse_data *pulse_data);
+
+/// Free the entries of a dispatch, it is then rebuilt on the next run.
+void decoder_dispatch_free(struct decoder_dispatch *dispatch);
+
+/// Rebuild all dispatches of the decoders on the next run, e.g. after a decoder is registered.
+void decoder_dispatch_invalidate(struct dm_state *demod);
+
+/** Get the dispatch of the decoders for a frequency.
+
+    When hopping with -Y bands the decoders declared for another band are left out,
+    the decoders for each band are built on first use. Frequencies outside the bands run all decoders.
+    @param cfg the config, for the hop frequencies
+    @param decoders the demod state with the decoders
+    @param frequency the frequency of the package in Hz
+    @return the dispatch to run the package through
+*/
+struct decoder_dispatch *select_dispatch(struct r_cfg *cfg, struct dm_state *decoders, uint32_t frequency);
+
 /* handlers */
 
+/** The event callback of r_set_event_callback().
+
+    @param ctx the user context
+    @param data the event, only valid during the call, e.g. serialize it with
+                data_print_jsons_cached(), data_print_jsons(), or data_print_cbor()
+*/
+typedef void (*r_event_callback_fn)(void *ctx, struct data *data);
+
+/// Call @p cb with each event before the output handlers, NULL for none, e.g. to embed the decoder.
+void r_set_event_callback(struct r_cfg *cfg, r_event_callback_fn cb, void *ctx);
+
+/// Pass a complete event to all output handlers, or collect it for a batch worker. Frees data afterwards.
+void output_event(struct r_cfg *cfg, struct data *data);
+
+/// Start a batch of events on all outputs, e.g. for a sample buffer, see data_output_batch_begin().
+void begin_event_batch(struct r_cfg *cfg);
+
+/// End the batch of events, the outputs write out the events at once.
+void end_event_batch(struct r_cfg *cfg);
+
+/// Output the fused events with the window over, or all held events, see -Y fusion.
+void flush_fused_events(struct r_cfg *cfg, int all);
+
 void event_occurred_handler(struct r_cfg *cfg, struct data *data);
 
+/// Pass a raw package of -Y raw to the outputs, only to those with the raw filter option if there are any. Frees data afterwards.
+void raw_event_handler(struct r_cfg *cfg, struct data *data);
+
 void data_acquired_handler(struct r_device *r_dev, struct data *data);
 
+/// Pass a record of the decoder fields on, the data is only made if the event is used, see decoder_record().
+void record_acquired_handler(struct r_device *r_dev, struct data_record *record);
+
 struct data *create_report_data(struct r_cfg *cfg, int level);
 
+/// Number of pipeline stages besides the outputs, see get_pipeline_loss().
+#define PIPELINE_LOSS_STAGES 4
+
+/// The items dropped at a queue of the pipeline, see get_pipeline_loss().
+typedef struct pipeline_loss {
+    char const *stage; ///< "acquire", "grab", "dump", "retry", or "output"
+    char const *unit;  ///< what is counted: "buffers", "signals", "packages", or "events" (the messages or lines of a network backlog)
+    int output;        ///< the index of the output for the "output" stage, -1 otherwise
+    uint64_t dropped;
+} pipeline_loss_t;
+
+/** Get the items dropped at each queue of the pipeline since the start.
+
+    The stages are the acquisition (SDR overflows and a full acquisition ring), the
+    signal grabber, the dumpers, the retry queue, and each output (a full output queue,
+    slow HTTP clients, a full MQTT, InfluxDB, or NATS backlog). A stage without drops is lossless.
+    @param cfg the config
+    @param[out] loss the stages
+    @param size the number of stages @p loss holds, PIPELINE_LOSS_STAGES and the number of outputs for all
+    @return the number of stages, at most @p size
+*/
+unsigned get_pipeline_loss(struct r_cfg *cfg, pipeline_loss_t *loss, unsigned size);
+
+/// Number of subsystems besides the outputs, see get_memory_usage().
+#define MEMORY_SUBSYSTEMS 5
+
+/// The bytes a subsystem holds, see get_memory_usage().
+typedef struct memory_usage {
+    char const *subsystem; ///< "buffers", "pulses", "decoders", "pools", "heap", "output", or "output_queue"
+    int output;            ///< the index of the output for "output" and "output_queue", -1 otherwise
+    uint64_t bytes;
+} memory_usage_t;
+
+/** Get the bytes each subsystem holds.
+
+    The subsystems are the sample buffers of the demodulators, channelizer, and decimator
+    (buffers), the pulse storage of the detectors, packages, and the recorder (pulses),
+    the decoder instances with their decode_ctx (decoders), the acquisition rings and the
+    signal grabber (pools), each output (the HTTP history and clients, an MQTT, InfluxDB,
+    or NATS backlog), and each output queue with its events.
+    The bytes are counted by the pools and buffers, the sizes of the other blocks by the
+    C library where it tells them, see alloc_block_size().
+    With allocation counting the live heap of all subsystems is reported as "heap".
+    @param cfg the config
+    @param[out] mem the subsystems
+    @param size the number of subsystems @p mem holds, MEMORY_SUBSYSTEMS and twice the number of outputs for all
+    @return the number of subsystems, at most @p size
+*/
+unsigned get_memory_usage(struct r_cfg *cfg, memory_usage_t *mem, unsigned size);
+
 void flush_report_data(struct r_cfg *cfg);
 
 /* setup */
@@ -73,12 +214,24 @@ void add_csv_output(struct r_cfg *cfg, char *param);
 
 void add_kv_output(struct r_cfg *cfg, char *param);
 
+void add_cbor_output(struct r_cfg *cfg, char *param);
+
+void add_delta_output(struct r_cfg *cfg, char *param);
+
+void add_arrow_output(struct r_cfg *cfg, char *param);
+
+void add_sqlite_output(struct r_cfg *cfg, char *param);
+
 void add_mqtt_output(struct r_cfg *cfg, char *param);
 
 void add_influx_output(struct r_cfg *cfg, char *param);
 
+void add_nats_output(struct r_cfg *cfg, char *param);
+
 void add_syslog_output(struct r_cfg *cfg, char *param);
 
+void add_shm_output(struct r_cfg *cfg, char *param);
+
 void add_http_output(struct r_cfg *cfg, char *param);
 
 void add_trigger_output(struct r_cfg *cfg, char *param);
@@ -87,20 +240,108 @@ void add_null_output(struct r_cfg *cfg, char *param);
 
 void add_rtltcp_output(struct r_cfg *cfg, char *param);
 
+/// Send the detected packages to a central decoder, a "[host][:port]" spec.
+void add_pulses_output(struct r_cfg *cfg, char *param);
+
+struct output_filter_opts;
+
+/// Filter the events of the last added output, see output_filter.h.
+void add_output_filter(struct r_cfg *cfg, struct output_filter_opts const *opts);
+
 void start_outputs(struct r_cfg *cfg, char const *const *well_known);
 
-void add_sr_dumper(struct r_cfg *cfg, char const *spec, int overwrite);
+/// Size the SDR buffers and transfers for the -B profile, call when the sample size is known.
+void apply_buffer_profile(struct r_cfg *cfg, int sample_size);
+
+/// Report the event latency of the run, if a buffer profile is set or verbose.
+void report_buffer_latency(struct r_cfg *cfg);
+
+/// Poll the network and print the network outputs on a thread, call when the input is ready.
+void start_net_thread(struct r_cfg *cfg);
 
 void close_dumpers(struct r_cfg *cfg);
 
 void add_dumper(struct r_cfg *cfg, char const *spec, int overwrite);
 
+/// Add an input file, or a "pulses:[host][:port]" spec to receive the packages of edge receivers.
 void add_infile(struct r_cfg *cfg, char *in_file);
 
+/// Add a sub-channel from a "frequency[:sample rate]" spec.
+void add_channel(struct r_cfg *cfg, char const *spec);
+
+/// Create the demod states for all sub-channels, call after all demod options are set.
+void start_channels(struct r_cfg *cfg);
+
+/// Add an additional SDR device, read into the acquisition ring of the first device.
+void add_sdr_input(struct r_cfg *cfg, char const *dev_query);
+
+/// Insert an additional SDR device at a position, e.g. for the other channels of a device.
+struct sdr_input *insert_sdr_input(struct r_cfg *cfg, size_t idx, char const *dev_query);
+
+/// Create the demod states for all additional SDR devices and assign the frequencies, call after all devices are opened.
+void start_sdr_inputs(struct r_cfg *cfg);
+
+/// Create the input decimator if a processing rate is set, call after all channels are added.
+void start_decimator(struct r_cfg *cfg);
+
+/// Create a demod state for each hop frequency, call after all demod options are set.
+void start_hop_states(struct r_cfg *cfg);
+
+/// Swap in the demod state of a hop frequency, call when the retune to the frequency is applied.
+void select_hop_state(struct r_cfg *cfg, unsigned index);
+
 void add_data_tag(struct r_cfg *cfg, char *param);
 
 /* runtime */
 
+/** Demodulate and decode a buffer of samples, the push mode of the decoder.
+
+    The events are passed to the callback of r_set_event_callback() and to the outputs
+    before this returns. Each config is independent, configs can be used on different
+    threads, but a config must not be used by more than one thread at a time.
+    The config needs the decoders registered, e.g. with register_all_protocols(), and
+    the sample rate and frequency set, see r_init_cfg() for the defaults.
+
+    @param cfg the config
+    @param iq_buf the samples
+    @param len the number of bytes, a multiple of the sample size
+    @param format the I/Q sample format, e.g. CU8_IQ, CS16_IQ, CS8_IQ, or CF32_IQ,
+                  0 to keep the format of the last buffer or the SDR
+    @param read_time the time of the samples, NULL for now
+    @return the number of events, -1 if the format is not supported
+*/
+int r_process_iq(struct r_cfg *cfg, unsigned char *iq_buf, uint32_t len, uint32_t format, struct timeval const *read_time);
+
+/** Decode a package of pulse data, e.g. from a pulse file or another detector.
+
+    The package is decoded as FSK if it has a second frequency estimate, as OOK otherwise.
+
+    @param cfg the config, see r_process_iq()
+    @param pulse_data the package
+    @return the number of events
+*/
+int r_process_pulses(struct r_cfg *cfg, struct pulse_data *pulse_data);
+
+/** Demodulate and decode one buffer of samples with a demod state and decoders, returns the number of events.
+
+    @param decoders the demod state with the decoders, the channels and inputs use the decoders of the main demod state
+
+    @param clip counts the clipping of the samples into the metrics, NULL if the samples are derived, e.g. decimated
+*/
+int demod_buffer(struct r_cfg *cfg, struct dm_state *demod, struct dm_state *decoders, unsigned char *iq_buf, uint32_t len, unsigned long n_samples, uint32_t frequency, time_t last_frame_sec, struct baseband_clip *clip);
+
+/** Account the processing time of a live buffer and shed load when behind real time, see -Y shed.
+
+    @param cfg the config, does nothing without load shedding
+    @param busy_us the processing time of the buffer
+    @param n_samples the samples of the buffer
+    @param samp_rate the sample rate of the buffer
+*/
+void shed_load(struct r_cfg *cfg, double busy_us, unsigned long n_samples, uint32_t samp_rate);
+
+/// Size the sample buffers of a demod state for n_samples and allocate the ones the options need, exits on failure.
+void reserve_demod_buffers(struct r_cfg *cfg, struct dm_state *demod, unsigned long n_samples);
+
 struct mg_mgr *get_mgr(struct r_cfg *cfg);
 
 void set_center_freq(struct r_cfg *cfg, uint32_t center_freq);
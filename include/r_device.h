@@ -5,6 +5,8 @@
 #ifndef INCLUDE_R_DEVICE_H_
 #define INCLUDE_R_DEVICE_H_
 
+#include <stdint.h>
+
 /**
     Supported Modulation and Coding types.
 
@@ -49,10 +51,80 @@ enum decode_return_codes {
     /** Message Integrity Check failed: e.g. checksum/CRC doesn't validate. */
     DECODE_FAIL_MIC     = -3,
     DECODE_FAIL_SANITY  = -4,
+    /** The decoder took longer than its time budget, counted by the dispatcher, not returned by decoders. */
+    DECODE_FAIL_BUDGET  = -5,
 };
 
 struct bitbuffer;
+
+/// Demoted decoders run only on every n-th package, see -Y adaptive and -Y budget.
+#define ADAPT_SAMPLING 16
+
+/// Preamble matches recorded for an event of a shared slicer, more matches set the overflow.
+#define PREAMBLE_MATCHES_MAX 64
+
+/// Positions of the decoder preambles in an event of a shared slicer, see r_device.preamble.
+typedef struct preamble_matches {
+    unsigned num;      ///< number of recorded matches, in order of row and position
+    unsigned overflow; ///< set if not all matches are recorded
+    struct preamble_match {
+        unsigned mask; ///< the bit of the pattern, see r_device.preamble_mask
+        unsigned row;
+        unsigned pos;
+    } match[PREAMBLE_MATCHES_MAX];
+} preamble_matches_t;
 struct data;
+struct data_record;
+struct slice_cache;
+
+/// The bands a decoder is meant for, see r_device.bands.
+enum decoder_band {
+    BAND_315 = 1 << 0, ///< 300 to 350 MHz
+    BAND_433 = 1 << 1, ///< 420 to 450 MHz
+    BAND_868 = 1 << 2, ///< 860 to 880 MHz
+    BAND_915 = 1 << 3, ///< 900 to 930 MHz
+};
+
+/// Number of bands in enum decoder_band.
+#define BAND_COUNT 4
+
+/** Bit bounds of the PPM and PWM slicers in samples, non inclusive. */
+struct slice_bounds {
+    int zero_l, zero_u;
+    int one_l, one_u;
+    int sync_l, sync_u;
+};
+
+/** Slicer timings converted to samples, computed once per sample rate by the pulse slicer. */
+struct slice_plan {
+    unsigned sample_rate; ///< Sample rate of the plan, 0 if not yet computed.
+    int too_low;          ///< The sample rate is too low for the timings, a timing rounds to zero.
+    int s_short;
+    int s_long;
+    int s_reset;
+    int s_gap;
+    int s_sync;
+    int s_tolerance;
+    int max_zeros;        ///< Zero bits at most in a PCM gap.
+    uint64_t r_short;     ///< Reciprocal of the short width in samples, 32.32 fixed-point rounded up, 0 if unused.
+    uint64_t r_long;      ///< Reciprocal of the long width in samples, 32.32 fixed-point rounded up, 0 if unused.
+    struct slice_bounds ppm; ///< Bounds of the gaps, short=0, long=1.
+    struct slice_bounds pwm; ///< Bounds of the pulses, short=1, long=0.
+};
+
+/** Decoder results of a stats interval, see -M stats. */
+typedef struct decoder_stats {
+    unsigned events;
+    unsigned ok;
+    unsigned messages;
+    unsigned fails[6];
+    unsigned truncated; ///< Packages cut short of the length they announce, counted by the decoder.
+    unsigned shed;      ///< Packages skipped to shed load, see -Y shed.
+    double decode_time; ///< Microseconds spent in decode_fn, if profiling.
+    double slicer_time; ///< Microseconds spent slicing, excluding decode_fn, if profiling.
+    uint64_t decode_allocs; ///< Heap allocations in decode_fn, including the outputs, if profiling.
+    uint64_t slicer_allocs; ///< Heap allocations slicing, excluding decode_fn, if profiling.
+} decoder_stats_t;
 
 /** Device protocol decoder struct. */
 typedef struct r_device {
@@ -72,21 +144,62 @@ typedef struct r_device {
     unsigned priority; ///< Run later and only if no previous events were produced
     unsigned disabled; ///< 0: default enabled, 1: default disabled, 2: disabled, 3: disabled and hidden
     char **fields; ///< List of fields this decoder produces; required for CSV output. NULL-terminated.
+    unsigned min_pulses; ///< Skip slicing if the package has fewer pulses, 0 for no limit.
+    unsigned min_rows;   ///< Abort with DECODE_ABORT_LENGTH on fewer rows, 0 for no limit.
+    unsigned max_rows;   ///< Abort with DECODE_ABORT_LENGTH on more rows, the slicer skips the rest of the message, 0 for no limit.
+    unsigned min_bits;   ///< Abort with DECODE_ABORT_LENGTH unless a row has at least this many bits, 0 for no limit.
+    unsigned max_bits;   ///< Abort with DECODE_ABORT_LENGTH unless a row has at most this many bits, 0 for no limit.
+    unsigned char const *preamble; ///< Skip the decoder in a shared slicer unless a row holds this raw bit pattern, NULL for none.
+    unsigned preamble_bits;        ///< Length of the preamble in bits, at most 64.
+    unsigned bands; ///< Skip the decoder when hopping on another band, BAND_* bits, 0 for all bands.
+    unsigned urgent; ///< Events are alarms, output at once ahead of other events, see -Y urgent.
 
     /* public for each decoder */
     int verbose;
     int verbose_bits;
     void (*output_fn)(struct r_device *decoder, struct data *data);
+    void (*output_record_fn)(struct r_device *decoder, struct data_record *record); ///< NULL to make the data and use output_fn
+    unsigned timing_bins; ///< Pulse widths (as log2 us bins) this decoder can match, 0 to always run.
+    int profile; ///< Measure the time spent in the slicer and decoder.
+    unsigned time_budget; ///< Microseconds a decoder run may take, the decoder is demoted if over, 0 for no budget.
 
     /* Decoder results / statistics */
-    unsigned decode_events;
-    unsigned decode_ok;
-    unsigned decode_messages;
-    unsigned decode_fails[5];
+    decoder_stats_t stats; ///< the current stats interval
+    decoder_stats_t prior; ///< the sum of the previous stats intervals, the metrics are the sum
 
     /* private for flex decoder and output callback */
     void *decode_ctx;
     void *output_ctx;
+    struct data_record *record; ///< the record of the fields, see decoder_record()
+
+    /* private for the output, the declared fields and their unit conversions, shared with the clones */
+    struct unit_fields *unit_fields;
+
+    /* private for the registration, to create the decoder again for a batch worker */
+    char *create_args; ///< the arguments passed to create_fn()
+    unsigned in_table; ///< registered in place as the entry of the devices table, not allocated
+
+    /* private for the pulse slicer, shared by decoders with the same slicing parameters */
+    struct slice_cache *slice_cache;
+    struct slice_plan slice_plan;
+    unsigned preamble_mask; ///< bit of the preamble in the patterns of the slice cache, 0 if not matched there
+    preamble_matches_t const *preamble_matches; ///< preamble positions in the bits being decoded, NULL if unknown
+    struct bitbuffer const *preamble_bitbuffer;  ///< the bits the preamble positions are for
+
+    /* private for adaptive decoding, see -Y adaptive and -Y budget */
+    unsigned sample_every; ///< Run only on every n-th package, 0 to run on all packages.
+    unsigned sample_count; ///< Packages skipped since the last run.
+    unsigned hits;         ///< Runs that produced events.
+    unsigned adapt_hits;   ///< Hits at the last adaptation.
+    int shed;              ///< Skipped while the load is shed, see -Y shed.
+
+    /* private for the coverage report, see -Y coverage */
+    int coverage;            ///< Count the packages, all priorities run to find the overlaps.
+    unsigned cover_packages; ///< Packages the decoder ran on.
+    unsigned cover_decoded;  ///< Packages with events.
+    unsigned cover_overlaps; ///< Packages with events of other decoders too.
+    unsigned cover_first;    ///< Packages this decoder would output, the decoder with events of the first priority.
+    int cover_hit;           ///< The current package had events.
 } r_device;
 
 #endif /* INCLUDE_R_DEVICE_H_ */
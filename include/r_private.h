@@ -10,12 +10,70 @@
 #include "list.h"
 #include "baseband.h"
 #include "pulse_detect.h"
+#include "pulse_slicer.h"
 #include "fileformat.h"
 #include "samp_grab.h"
+#include "sample_dump.h"
 #include "am_analyze.h"
+#include "pulse_analyzer.h"
 #include "rtl_433.h"
 #include "compat_time.h"
 
+/// A decoder with the slicer of its modulation.
+typedef struct decoder_entry {
+    r_device *r_dev;
+    pulse_slicer_fn slicer;
+} decoder_entry_t;
+
+/// Number of decoders with events of a run that are remembered, see -Y dedup.
+#define DISPATCH_HITS 4
+
+/// The OOK and the FSK decoders each sorted by priority, rebuilt when the decoders change.
+typedef struct decoder_dispatch {
+    decoder_entry_t *ook;
+    unsigned ook_len;
+    decoder_entry_t *fsk;
+    unsigned fsk_len;
+    unsigned band; ///< only the decoders for this band, see r_device.bands, 0 for all decoders
+    int timing; ///< skip the decoders whose timing does not fit the package widths, see -Y timingskip
+    int valid; ///< 0 if the decoders changed since the build
+    decoder_entry_t hits[DISPATCH_HITS]; ///< the decoders with events of the last run, see -Y dedup
+    unsigned num_hits; ///< decoders with events of the last run, only the first DISPATCH_HITS are kept
+} decoder_dispatch_t;
+
+/// Number of recently decoded packages to remember.
+#define PACKAGE_CACHE_SIZE 16
+
+/// A recently decoded package, to skip decoding repeated transmissions.
+typedef struct package_cache_entry {
+    uint32_t fingerprint; ///< pulse_data_fingerprint() of the package
+    unsigned num_pulses;
+    int package_type;     ///< PULSE_DATA_OOK or PULSE_DATA_FSK, 0 if unused
+    uint64_t offset;      ///< sample offset of the last occurrence
+    decoder_entry_t decoders[DISPATCH_HITS]; ///< the decoders with events, run again with -Y dedup=<ms>:reuse
+    unsigned num_decoders;
+    int fsk_alt;          ///< the events are from the pulses of the other FSK detector
+} package_cache_entry_t;
+
+/// Number of recent packages with events the extra detection levels check for overlaps.
+#define DECODED_SPANS 16
+
+/// The samples of a recent package with events, see r_process.c.
+typedef struct decoded_span {
+    uint64_t start; ///< sample offset of the first sample
+    uint64_t end;   ///< sample offset past the last sample
+} decoded_span_t;
+
+/// The demod state of a hop frequency, swapped in while the frequency is tuned.
+typedef struct hop_state {
+    pulse_detect_t *pulse_detect;
+    filter_state_t lowpass_filter_state;
+    demodfm_state_t demod_FM_state;
+    iq_correct_state_t iq_correct_state;
+    float noise_level;
+    float min_level_auto;
+} hop_state_t;
+
 struct dm_state {
     float auto_level;
     float squelch_offset;
@@ -27,30 +85,61 @@ struct dm_state {
     float low_pass;
     int use_mag_est;
     int detect_verbosity;
+    float extra_levels[PULSE_DETECT_EXTRA_LEVELS]; // fixed detection levels in dB detected alongside, see -Y levels
+    unsigned extra_level_count;
+    unsigned decoded_span_next;
+    decoded_span_t decoded_spans[DECODED_SPANS]; // packages with events, the extra levels skip packages overlapping them
 
-    int16_t am_buf[MAXIMAL_BUF_LENGTH];  // AM demodulated signal (for OOK decoding)
-    union {
-        // These buffers aren't used at the same time, so let's use a union to save some memory
-        int16_t fm[MAXIMAL_BUF_LENGTH];  // FM demodulated signal (for FSK decoding)
-        uint16_t temp[MAXIMAL_BUF_LENGTH];  // Temporary buffer (to be optimized out..)
-    } buf;
-    uint8_t u8_buf[MAXIMAL_BUF_LENGTH]; // format conversion buffer
-    float f32_buf[MAXIMAL_BUF_LENGTH]; // format conversion buffer
-    int sample_size; // CU8: 2, CS16: 4
+    // sample buffers, see reserve_demod_buffers(), NULL if not needed
+    unsigned long buf_len; // capacity of the sample buffers in samples
+    int16_t *am_buf;    // AM demodulated signal (for OOK decoding)
+    int16_t *fm_buf;    // FM demodulated signal (for FSK decoding)
+    uint16_t *temp_buf; // envelope with squelch
+    float *f32_buf;     // scratch buffer for -Y bench, two floats per sample
+    uint8_t *iq_buf;    // DC offset and IQ imbalance corrected CU8 samples
+    uint8_t *am8_buf;   // 8-bit codes of the AM signal for the pulse search, see -Y env8
+    int sample_size; // CU8, CS8: 2, CS16: 4, CF32: 8
+    baseband_kernels_t const *kernels; // baseband kernels for the sample format
     pulse_detect_t *pulse_detect;
     filter_state_t lowpass_filter_state;
     demodfm_state_t demod_FM_state;
+    iq_correct_state_t iq_correct_state;
+    baseband_clip_t clip; // clipping of the last input buffer
     int enable_FM_demod;
+    int demod_threads; // demodulate AM and FM on separate threads
+    int fm_full; // demodulate FM of all samples, not only where the envelope can hold a pulse
+    int env8; // search the pulses on an 8-bit envelope, see -Y env8
+    unsigned decoder_threads; // run the decoders on this many threads
+    struct decoder_pool *decoder_pool;
+    struct decoder_pool *demod_pool; // the worker for the FM demodulation, see -Y threads
+    unsigned dedup_ms; // skip decoding packages identical to one seen within this time, 0 is off
+    int dedup_reuse; // run only the decoders with events of the first package again instead of dropping a repeat
+    unsigned package_cache_next;
+    package_cache_entry_t package_cache[PACKAGE_CACHE_SIZE];
+    unsigned adapt_secs; // demote decoders without events for this time, 0 is off
+    double adapt_time; // signal time of the next adaptation, in seconds
     unsigned fsk_pulse_detect_mode;
     unsigned frequency;
+    hop_state_t *hop_states; // a state for each hop frequency, NULL if not hopping
+    unsigned hop_states_len;
+    unsigned hop_index; // the hop frequency of the current state
     samp_grab_t *samp_grab;
+    unsigned package_start_ago; // the span of the package of the current events, 0 if not from a package
+    unsigned package_end_ago;
+    sample_dump_t *sample_dump; // the writer of the sample formats of the dumpers, NULL without dumpers
     am_analyze_t *am_analyze;
     int analyze_pulses;
+    pulse_analyzer_stats_t *analyzer_stats; // the quiet batch mode of the pulse analyzer, NULL otherwise
     file_info_t load_info;
     list_t dumper;
 
     /* Protocol states */
     list_t r_devs;
+    struct r_device *r_devs_block; // the decoders of a batch worker in one block, NULL otherwise
+    decoder_dispatch_t dispatch; // the decoders of r_devs by modulation and priority
+    decoder_dispatch_t band_dispatch[BAND_COUNT]; // the decoders for each band when hopping, see select_dispatch()
+    int bands; // run only the decoders for the band when hopping, see -Y bands
+    int timing_skip; // skip the decoders whose timing does not fit the package widths, see -Y timingskip
 
     pulse_data_t    pulse_data;
     pulse_data_t    fsk_pulse_data;
@@ -61,4 +150,18 @@ struct dm_state {
     float sample_file_pos;
 };
 
+/// An additional SDR device, demodulated with its own state and decoded with the shared decoders.
+typedef struct sdr_input {
+    struct r_cfg *cfg;
+    char const *dev_query;
+    char const *dev_info;
+    struct sdr_dev *dev;
+    struct dm_state *demod;
+    uint32_t frequency;        ///< the requested frequency
+    uint32_t center_frequency; ///< the applied frequency, from the sdr event
+    uint32_t samp_rate;        ///< the applied sample rate, from the sdr event
+    uint64_t input_pos;
+    uint64_t buffer_seq;       ///< sequence number of the last buffer, from the sdr event
+} sdr_input_t;
+
 #endif /* INCLUDE_R_PRIVATE_H_ */
@@ -43,6 +43,8 @@ void get_time_now(struct timeval *tv);
 
 /** Printable timestamp in local time.
 
+    The formatted second is cached for each thread, it is only rebuilt when the second changes.
+
     @param[out] buf output buffer, long enough for "YYYY-MM-DD HH:MM:SS+0000"
     @param format time format string, uses "%Y-%m-%d %H:%M:%S" if NULL
     @param with_tz 1 to add a time offset, 0 otherwise
@@ -53,6 +55,8 @@ char *format_time_str(char *buf, char const *format, int with_tz, time_t time_se
 
 /** Printable timestamp in local time with microseconds.
 
+    The formatted second is cached like format_time_str(), only the microseconds are formatted for each call.
+
     @param[out] buf output buffer, long enough for "YYYY-MM-DD HH:MM:SS.uuuuuu+0000"
     @param format time format string without usec, uses "%Y-%m-%d %H:%M:%S" if NULL
     @param with_tz 1 to add a time offset, 0 otherwise
@@ -15,14 +15,25 @@
 #include <stdint.h>
 
 struct raw_output;
+struct iq_buf;
 
 typedef struct raw_output {
     void (*output_frame)(struct raw_output *output, uint8_t const *data, uint32_t len);
+    void (*output_frame_ref)(struct raw_output *output, struct iq_buf *ref, uint8_t const *data, uint32_t len); ///< optional, retains the buffer instead of copying
     void (*output_free)(struct raw_output *output);
 } raw_output_t;
 
 void raw_output_frame(struct raw_output *output, uint8_t const *data, uint32_t len);
 
+/** Output a frame held by a pooled buffer, the output may retain the buffer instead of copying the data.
+
+    @param output the output
+    @param ref the pooled buffer holding the data, NULL to copy
+    @param data the frame
+    @param len the length of the frame in bytes
+*/
+void raw_output_frame_ref(struct raw_output *output, struct iq_buf *ref, uint8_t const *data, uint32_t len);
+
 void raw_output_free(struct raw_output *output);
 
 #endif /* INCLUDE_RAW_OUTPUT_H_ */
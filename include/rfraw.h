@@ -21,4 +21,22 @@ bool rfraw_check(char const *p);
 /// Decode RfRaw string to pulse data.
 bool rfraw_parse(pulse_data_t *data, char const *p);
 
+/// Timing bins of an RfRaw B1 string.
+#define RFRAW_BINS 8
+
+/// Size of the RfRaw string of a number of pulses, including the terminator.
+#define RFRAW_FORMAT_SIZE(num_pulses) (2 * (4 + 2 * RFRAW_BINS + (size_t)(num_pulses)) + 1)
+
+/** Encode pulse data as an RfRaw B1 string, the inverse of rfraw_parse().
+
+    The pulse and gap widths in us are quantized to at most RFRAW_BINS bins within 20% tolerance,
+    further widths use the nearest bin.
+
+    @param data the pulses
+    @param[out] buf the hex string, e.g. "AAB10301900320271481819055"
+    @param size the size of buf, at least RFRAW_FORMAT_SIZE(data->num_pulses)
+    @return the length of the string, 0 if buf is too small
+*/
+size_t rfraw_format(pulse_data_t const *data, char *buf, size_t size);
+
 #endif /* INCLUDE_RFRAW_H_ */
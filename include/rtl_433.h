@@ -7,18 +7,29 @@
 
 #include <stdint.h>
 #include "list.h"
+#include "event_dedup.h"
+#include "event_fusion.h"
+#include "second_chance.h"
+#include "signal_cluster.h"
 #include <time.h>
 #include <signal.h>
 
 #define DEFAULT_SAMPLE_RATE     250000
 #define DEFAULT_FREQUENCY       433920000
+#define DEFAULT_CHANNEL_RATE    250000
 #define DEFAULT_HOP_TIME        (60*10)
+#define DEFAULT_SETTLE_MS       10
 #define DEFAULT_ASYNC_BUF_NUMBER    0 // Force use of default value (librtlsdr default: 15)
 #define DEFAULT_BUF_LENGTH      (16 * 32 * 512) // librtlsdr default
 #define FSK_PULSE_DETECTOR_LIMIT 800000000
 
 #define MINIMAL_BUF_LENGTH      512
 #define MAXIMAL_BUF_LENGTH      (256 * 16384)
+#define BUFFER_PROFILE_LOW_LATENCY_MS   10  // buffer duration of -B low-latency
+#define BUFFER_PROFILE_LOW_LATENCY_NUM  32  // USB transfers of -B low-latency
+#define BUFFER_PROFILE_THROUGHPUT_MS    250 // buffer duration of -B throughput, at least DEFAULT_BUF_LENGTH
+#define BUFFER_PROFILE_THROUGHPUT_NUM   4   // USB transfers of -B throughput
+#define BUFFER_PROFILE_FILE_BUFFER      65536 // file buffer of -B throughput
 #define SIGNAL_GRABBER_BUFFER   (12 * DEFAULT_BUF_LENGTH)
 #define MAX_FREQS               32
 
@@ -26,7 +37,17 @@
 
 struct sdr_dev;
 struct r_device;
+struct data;
 struct mg_mgr;
+struct channelizer;
+struct decimator;
+struct trace_event;
+struct net_thread;
+struct watchdog;
+struct agc;
+struct spectrum;
+struct pulse_recorder;
+struct output_route;
 
 typedef enum {
     CONVERT_NATIVE,
@@ -43,18 +64,62 @@ typedef enum {
     REPORT_TIME_OFF,
 } time_mode_t;
 
+typedef enum {
+    BUFFER_PROFILE_DEFAULT,
+    BUFFER_PROFILE_LOW_LATENCY,
+    BUFFER_PROFILE_THROUGHPUT,
+} buffer_profile_t;
+
 typedef struct r_cfg {
     char *dev_query;
     char const *dev_info;
     char *gain_str;
+    float agc_headroom; ///< control the gain so the peak stays within this many dB below full scale, 0 is off, see -Y agc
+    struct agc *agc; ///< the gain control of the main SDR, NULL if off
+    unsigned spectrum_bins; ///< FFT bins of the spectrum monitor, 0 is off, see -Y spectrum
+    unsigned spectrum_interval; ///< take a spectrum snapshot of every n-th buffer
+    struct spectrum *spectrum; ///< the spectrum monitor, NULL if off
+    unsigned recorder_minutes; ///< keep the packages of this many minutes, 0 is off, see -Y recorder
+    unsigned recorder_mb;      ///< size of the ring of the pulse recorder in MB
+    struct pulse_recorder *pulse_recorder; ///< the pulse flight recorder, NULL if off
     char *settings_str;
     int ppm_error;
     uint32_t out_block_size;
+    int out_block_size_set; ///< the block size was given with -b, a buffer profile keeps it
+    uint32_t async_buf_number; ///< USB transfers of the SDR, 0 for the default
+    int buffer_profile; ///< a buffer_profile_t, see -B
+    unsigned acquire_buffers; ///< buffers in the SDR acquisition ring, 0 to read on the processing thread
+    unsigned lowpower_ms; ///< process the SDR buffers in bursts at most this late, 0 is off, see -Y lowpower
     char const *test_data;
     list_t in_files;
     char const *in_filename;
-    int in_replay;
+    char *pulse_input; ///< receive the packages of edge receivers, a "[host][:port]" spec, see -r pulses
+    float in_replay;       ///< replay speed as multiple of realtime, 0 to read as fast as possible
+    unsigned in_replay_ms; ///< coalesce the replay sleeps to at most one every this many ms
+    unsigned batch_jobs; ///< read the input files on this many threads, see -Y jobs
+    uint32_t batch_chunk; ///< split larger input files into chunks of this many bytes, see -Y chunk
+    unsigned batch_overlap_ms; ///< overlap of the chunks, 0 for the longest package of the decoders
+    char *checkpoint_path;     ///< write checkpoints of reading the input files to this file, NULL for none, see -Y checkpoint
+    unsigned checkpoint_secs;  ///< time between the checkpoints, 0 for one after each block
+    int checkpoint_resume;     ///< continue from the last checkpoint, see -Y resume
+    int checkpoint_reading;    ///< 1 while the input files are read in turn with checkpoints
+    unsigned checkpoint_index; ///< the input file being read
+    double checkpoint_due_us;  ///< monotonic time of the next checkpoint
+    int dump_index; ///< write a sidecar index of wall time and level for the sample dumpers, see -Y index
+    unsigned bench_passes; ///< read the input files this many times and report the throughput, see -Y bench
+    double start_us;       ///< monotonic time at the start of main(), see -Y bench
+    double register_us;    ///< time spent registering the default decoders, see -Y bench
+    double config_us;      ///< time spent reading the config files and options, see -Y bench
+    int coverage_report;   ///< run the input files through all decoders and report the coverage, see -Y coverage
     volatile sig_atomic_t hop_now;
+    volatile sig_atomic_t sync_now; ///< write out all batched output
+    volatile sig_atomic_t reload_now; ///< rebuild the decoders before the next buffer, see SIGHUP
+    volatile sig_atomic_t dump_pulses_now; ///< write out the pulse recorder, see SIGUSR2
+    volatile sig_atomic_t profile_now; ///< start or stop a CPU profile, see SIGRTMIN+1
+    int reload_only; ///< only parse the decoder options, set on the scratch config of a reload
+    int argc;        ///< the command line to reload the decoders from
+    char **argv;
+    time_t sync_time; ///< time of the last output sync
     volatile sig_atomic_t exit_async;
     volatile sig_atomic_t exit_code; ///< 0=no err, 1=params or cmd line err, 2=sdr device read error, 3=usb init error, 5=USB error (reset), other=other error
     int frequencies;
@@ -65,6 +130,13 @@ typedef struct r_cfg {
     int hop_times;
     int hop_time[MAX_FREQS];
     time_t hop_start_time;
+    struct hop_sched *hop_sched; ///< the dwell times, NULL if not hopping
+    int hop_adapt; ///< adapt the dwell times to the activity of the frequencies
+    int hop_min_dwell; ///< lower bound of the adapted dwell in seconds, 0 for the default
+    int hop_max_dwell; ///< upper bound of the adapted dwell in seconds, 0 for the default
+    unsigned hop_idle_ms; ///< hop early after this time without packages, 0 is off
+    int settle_ms; ///< discard this time of samples after a retune, -1 for the default when hopping
+    unsigned long settle_samples; ///< samples left to discard after the last retune
     int duration;
     time_t stop_time;
     int after_successful_events_flag;
@@ -72,8 +144,16 @@ typedef struct r_cfg {
     uint64_t input_pos;
     uint32_t bytes_to_read;
     struct sdr_dev *dev;
+    unsigned watchdog_ms; ///< a stall of the sample callback after this time resets the SDR, 0 for no watchdog, see -Y watchdog
+    unsigned watchdog_warn_ms; ///< log callback intervals and durations above this time as near stalls, 0 for none
+    struct watchdog *watchdog; ///< the watchdog thread while the SDR is read, NULL to use alarm()
+    list_t sdr_inputs; ///< additional SDR devices from repeated -d options, an sdr_input_t each
     int grab_mode; ///< Signal grabber mode: 0=off, 1=all, 2=unknown, 3=known
     int raw_mode; ///< Raw pulses printing mode: 0=off, 1=all, 2=unknown, 3=known
+    int raw_rfraw; ///< print the raw pulses as a compact RfRaw string instead of an array, see -Y rfraw
+    int raw_event; ///< the event being output is a raw package
+    unsigned raw_outputs; ///< outputs with the raw filter option, raw packages are only sent to these if any
+    unsigned iq_outputs; ///< outputs with the iq filter option, events then reference a capture of their IQ samples
     int verbosity; ///< 0=normal, 1=verbose, 2=verbose decoders, 3=debug decoders, 4=trace decoding.
     int verbose_bits;
     conversion_mode_t conversion_mode;
@@ -85,8 +165,21 @@ typedef struct r_cfg {
     int report_time_tz;
     int report_time_utc;
     int report_description;
+    int report_seq; ///< add the sequence number of the events, see -M seq
+    event_dedup_t event_dedup; ///< drops repeated events before the outputs, see -Y eventdedup
+    unsigned fusion_ms; ///< fuse the events of several receivers within this time, see -Y fusion
+    event_fusion_t *event_fusion; ///< holds the events to fuse, NULL if not used
+    char const *pulse_receiver; ///< the edge receiver of the package being decoded, see -r pulses
+    signal_cluster_t signal_cluster; ///< suggests flex decoders for recurring unclaimed packages, see -Y suggest
+    int retry_packages; ///< retry the unclaimed packages on an idle worker, see -Y retry
+    second_chance_t *second_chance; ///< the worker retrying the unclaimed packages, NULL if not used
     int report_stats;
     int stats_interval;
+    int report_profile; ///< Measure and report the time spent in each decoder.
+    unsigned decode_budget; ///< Microseconds a decoder run may take, 0 for no budget, see -Y budget.
+    struct load_shed *load_shed; ///< sheds work when the processing falls behind, NULL if off, see -Y shed
+    char *urgent_models; ///< ':' separated models also output as alarms, NULL if none, see -Y urgent
+    int urgent_event; ///< the event being output is an alarm, see r_device.urgent
     volatile sig_atomic_t stats_now;
     time_t stats_time;
     int no_default_devices;
@@ -94,8 +187,27 @@ typedef struct r_cfg {
     uint16_t num_r_devices;
     list_t data_tags;
     list_t output_handler;
+    void (*event_cb)(void *ctx, struct data *data); ///< called with each event before the output handlers, see r_set_event_callback()
+    void *event_ctx;
+    list_t output_filters; ///< output_filter_t of the outputs with filter options, by output index
+    struct output_route *output_route; ///< the outputs of an event by model, compiled from the filters when the outputs are started
+    list_t *batch_events; ///< collect the events instead of printing them, if set, see -Y jobs
+    uint64_t output_start; ///< only output the events of packages starting from this sample, see -Y chunk and -r
+    uint64_t output_end; ///< only output the events of packages starting before this sample, 0 for no limit
+    list_t file_outputs; ///< outputs to put behind a queue, only until the outputs are started
+    unsigned output_queue_size; ///< queue the file outputs if not 0
+    int output_queue_policy; ///< an output_queue_policy_t
+    list_t flush_outputs; ///< file outputs without flush options, only until the outputs are started
     list_t raw_handler;
+    struct iq_buf *iq_ref; ///< the pooled buffer being processed, NULL if not pooled, see sdr_event_t.iq
+    list_t pulse_handler; ///< pulse_udp_t senders of the detected packages, see -F pulses
     struct dm_state *demod;
+    struct channelizer *channelizer; ///< sub-channels of the captured band, NULL if not used
+    list_t channel_demods; ///< a demod state for each sub-channel
+    int channelizer_opencl; ///< process the sub-channels on an OpenCL device, see -Y channelizer
+    char *channelizer_device; ///< the OpenCL platform and device index, NULL for the first GPU
+    uint32_t processing_rate; ///< decimate the input to at least this rate, 0 to disable
+    struct decimator *decimator; ///< input decimator, NULL if not used
     char const *sr_filename;
     int sr_execopen;
     /* stats*/
@@ -103,7 +215,12 @@ typedef struct r_cfg {
     unsigned frames_count; ///< stats counter for interval
     unsigned frames_fsk; ///< stats counter for interval
     unsigned frames_events; ///< stats counter for interval
+    unsigned frames_dedup; ///< stats counter for interval, repeats of a recent package, see -Y dedup
+    struct metrics *metrics; ///< pipeline metrics, not reset with the stats
+    struct trace_event *trace; ///< timeline of the processing, see -M trace
     struct mg_mgr *mgr;
+    struct net_thread *net_thread; ///< polls the network and prints the network outputs, NULL to poll on the SDR thread
+    list_t net_outputs; ///< outputs that use the network, only until the network thread is started
 } r_cfg_t;
 
 #endif /* INCLUDE_RTL_433_H_ */
@@ -235,8 +235,14 @@
 
     /* Add new decoders here. */
 
-#define DECL(name) extern r_device name;
+#ifdef RTL433_DEVICES_SELECTED
+#include "rtl_433_devices_selected.h" // the decoders of a slim build, see RTL433_DEVICES
+#endif
+
+#define DECL(name) extern r_device const name;
+#define OMIT(name)
 DEVICES
+#undef OMIT
 #undef DECL
 
 #endif /* INCLUDE_RTL_433_DEVICES_H_ */
@@ -12,24 +12,67 @@
 #ifndef INCLUDE_SAMP_GRAB_H_
 #define INCLUDE_SAMP_GRAB_H_
 
+#include <stddef.h>
 #include <stdint.h>
+#include "compat_time.h"
+
+/// Grabs waiting for the writer thread, further grabs are dropped.
+#define SAMP_GRAB_QUEUE_SIZE 8
+
+struct samp_grab_writer;
+struct samp_grab_container;
 
 typedef struct samp_grab {
     uint32_t *frequency;
     uint32_t *samp_rate;
     int *sample_size;
+    struct timeval const *now; ///< wall time of the end of the ring, optional
 
     unsigned sg_counter;
     char *sg_buf;
     unsigned sg_size;
     unsigned sg_index;
     unsigned sg_len;
+    int sg_mirror; ///< sg_buf is mapped twice in a row, a region never wraps
+
+    struct samp_grab_container *container; ///< the container file for all grabs, NULL for a file per grab
+    struct samp_grab_writer *writer;       ///< the writer thread and queue, NULL if written synchronously
+    unsigned grabs;                        ///< grabs written or queued
+    unsigned drops;                        ///< grabs dropped because the queue was full
+    unsigned snippets;                     ///< the counter of the snippet file names
 } samp_grab_t;
 
+/** Create a grabber.
+
+    The ring size is rounded up to a power of two. Where possible the ring is
+    mapped twice in a row so that pushes and grabs are a single contiguous copy.
+
+    @param size the ring size in bytes
+    @return the new grabber or NULL on error
+*/
 samp_grab_t *samp_grab_create(unsigned size);
 
+/// Write the queued grabs and free the grabber.
 void samp_grab_free(samp_grab_t *g);
 
+/** Append all grabs to a container file instead of a file per grab.
+
+    The container is named "<prefix>NNN_<freq>M_<rate>k.<format>" with a sidecar
+    ".idx" sample index of the start, wall time and level of each grab.
+    A new container is started if the frequency, rate or format change, or the size is reached.
+
+    @param g the grabber
+    @param prefix the file name prefix
+    @param max_size the size in bytes to start the next container at, 0 for no limit
+*/
+void samp_grab_set_container(samp_grab_t *g, char const *prefix, unsigned long max_size);
+
+/// Write the grabs on a thread, grabs are copied to a queue of at most SAMP_GRAB_QUEUE_SIZE.
+void samp_grab_start_writer(samp_grab_t *g);
+
+/// Number of grabs waiting to be written.
+unsigned samp_grab_queue_depth(samp_grab_t *g);
+
 void samp_grab_push(samp_grab_t *g, unsigned char *iq_buf, uint32_t len);
 
 void samp_grab_reset(samp_grab_t *g);
@@ -37,4 +80,19 @@ void samp_grab_reset(samp_grab_t *g);
 /// grab_end is counted in samples from end of buf.
 void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end);
 
+/** Grab the exact region of an event to a file of its own, named "iqNNNNNN_<freq>M_<rate>k.<format>".
+
+    The file name is chosen at once and the region is queued for the writer,
+    the container is not used. Counts as a grab, or as a drop if the region is
+    no longer in the ring or the queue is full.
+
+    @param g the grabber
+    @param grab_len the length of the region in samples
+    @param grab_end the end of the region counted in samples from the end of the ring
+    @param[out] name the file name
+    @param name_size the size of the name buffer
+    @return 0 on success, -1 if the region was dropped
+*/
+int samp_grab_snippet(samp_grab_t *g, unsigned grab_len, unsigned grab_end, char *name, size_t name_size);
+
 #endif /* INCLUDE_SAMP_GRAB_H_ */
@@ -0,0 +1,111 @@
+/** @file
+    Sample dumper writer, the sample formats of -w written on a thread.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SAMPLE_DUMP_H_
+#define INCLUDE_SAMPLE_DUMP_H_
+
+#include <stdint.h>
+#include "compat_time.h"
+#include "list.h"
+#include "pulse_data.h"
+
+/// Buffers waiting for the writer thread, further buffers stall or are dropped.
+#define SAMPLE_DUMP_QUEUE_SIZE 16
+
+/// Writes submitted at once by the writer thread with io_uring, see -Y io.
+#define SAMPLE_DUMP_RING_DEPTH 64
+
+struct sample_dump_writer;
+struct sample_dump_run;
+struct sigrok_writer;
+struct sample_dump_ring_write;
+struct io_ring;
+struct iq_buf;
+
+typedef struct sample_dump {
+    list_t *dumpers; ///< the file_info_t of the dumpers, the sample formats are written here
+    int dump_index;  ///< write a sidecar index for each dumper, see -Y index
+
+    struct sample_dump_writer *writer; ///< the writer thread and queue, NULL if written synchronously
+    unsigned buffers;                  ///< buffers written or queued
+    unsigned stalls;                   ///< buffers of a file input that waited for a free queue slot
+    unsigned drops;                    ///< buffers of a live input dropped because the queue was full
+
+    /* private for the demodulation thread */
+    struct sample_dump_run *runs; ///< the logic states of the current buffer
+    unsigned runs_len;
+    unsigned runs_size;
+
+    /* private for writing, on the writer thread if there is one */
+    uint8_t *scratch; ///< format conversion buffer
+    unsigned long scratch_size;
+    struct sigrok_writer *sigrok; ///< the channels of a SIGROK_SR dumper, NULL until the first buffer
+    uint32_t sigrok_rate;         ///< the sample rate of the Sigrok channels
+    struct io_ring *ring;         ///< the writes of a batch of buffers on the writer thread, NULL to write with stdio
+    struct sample_dump_ring_write *ring_writes; ///< the writes queued on the ring, in order
+    unsigned ring_len;
+} sample_dump_t;
+
+/** Create a writer for the sample formats of the dumpers.
+
+    The text formats (VCD, pulse OOK) are not handled here, these are written by the demodulation.
+
+    @param dumpers the list of file_info_t, opened by add_dumper()
+    @return the new writer or NULL on alloc failure
+*/
+sample_dump_t *sample_dump_create(list_t *dumpers);
+
+/// Write on a thread, buffers are copied to a queue of at most SAMPLE_DUMP_QUEUE_SIZE.
+void sample_dump_start_writer(sample_dump_t *d);
+
+/// Write the queued buffers and free the writer, a Sigrok file is completed but the files are not closed.
+void sample_dump_free(sample_dump_t *d);
+
+/// Number of buffers waiting to be written.
+unsigned sample_dump_queue_depth(sample_dump_t *d);
+
+/** Record the logic states of a pulse train for the U8_LOGIC dumpers.
+
+    The states are rasterized when the buffer is written, later trains overwrite earlier ones.
+
+    @param d the writer
+    @param n_samples the length of the current buffer
+    @param buf_offset the input position of the current buffer
+    @param pulses the pulse train, may extend outside the buffer
+    @param bits the state bits of a pulse, a gap is 0x01
+*/
+void sample_dump_logic(sample_dump_t *d, unsigned long n_samples, uint64_t buf_offset, pulse_data_t const *pulses, uint8_t bits);
+
+/// The samples of a buffer and the input state at the time.
+typedef struct sample_dump_input {
+    uint8_t const *iq_buf;
+    int16_t const *am_buf;
+    int16_t const *fm_buf;
+    unsigned long n_samples;
+    int sample_size; ///< CU8, CS8: 2, CS16: 4, CF32: 8
+    uint32_t samp_rate;
+    uint32_t center_frequency;
+    struct timeval now;
+    float avg_db;
+    int live; ///< drop the buffer if the queue is full, otherwise wait for the writer
+    struct iq_buf *iq_ref; ///< the pooled buffer holding iq_buf, retained by the writer thread instead of copied, NULL to copy
+} sample_dump_input_t;
+
+/** Write a buffer to all sample dumpers, the logic states recorded since the last buffer are used.
+
+    With a writer thread the samples are copied, or the pooled IQ buffer retained,
+    and the conversion and writes happen on the thread.
+
+    @param d the writer
+    @param in the samples, only read during the call
+    @return 0 on success, -1 if a write failed and the dump is incomplete
+*/
+int sample_dump_write(sample_dump_t *d, sample_dump_input_t const *in);
+
+#endif /* INCLUDE_SAMPLE_DUMP_H_ */
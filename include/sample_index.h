@@ -0,0 +1,54 @@
+/** @file
+    Sample index, a sidecar file mapping sample offsets to wall time and level.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SAMPLE_INDEX_H_
+#define INCLUDE_SAMPLE_INDEX_H_
+
+#include <stdint.h>
+#include "compat_time.h"
+
+/// The index of a sample file being written.
+typedef struct sample_index sample_index_t;
+
+/** Create the sidecar index for a sample file, the index is written to "<path>.idx".
+
+    @param path the path of the sample file
+    @param sample_rate the sample rate of the sample file
+    @param center_frequency the center frequency of the sample file
+    @return the new index, NULL on error
+*/
+sample_index_t *sample_index_create(char const *path, uint32_t sample_rate, uint32_t center_frequency);
+
+/** Add a block of samples to the index.
+
+    @param index the index
+    @param n_samples the number of samples in the block
+    @param time the wall time the block was received
+    @param level_db the average level of the block in dB
+*/
+void sample_index_add(sample_index_t *index, unsigned long n_samples, struct timeval const *time, float level_db);
+
+/** Close the index. */
+void sample_index_free(sample_index_t *index);
+
+/** Find the sample offset of a position in a sample file.
+
+    A position with a colon is a wall time of day (HH:MM[:SS]) and needs the "<path>.idx" index,
+    the first such time after the start of the recording is found.
+    Otherwise the position is a time from the start of the file (e.g. 90, 1m30s).
+
+    @param path the path of the sample file
+    @param sample_rate the sample rate of the sample file
+    @param pos the position to find
+    @param[out] offset the sample offset of the position
+    @return 0 on success, -1 if the index or the time was not found
+*/
+int sample_index_find(char const *path, uint32_t sample_rate, char const *pos, uint64_t *offset);
+
+#endif /* INCLUDE_SAMPLE_INDEX_H_ */
@@ -0,0 +1,72 @@
+/** @file
+    Sample file reader, maps regular files or reads them ahead with io_uring, and reads pipes in blocks.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SAMPLE_READER_H_
+#define INCLUDE_SAMPLE_READER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// Blocks read ahead with io_uring.
+#define SAMPLE_READER_DEPTH 4
+
+struct io_ring;
+
+/// A sample file, the blocks point into the mapping if the file could be mapped.
+typedef struct sample_reader {
+    FILE *file;
+    uint8_t const *map; ///< the mapped file, NULL if read with fread()
+    size_t map_size;
+    size_t map_pos;
+
+    struct io_ring *ring; ///< the reads queued ahead, NULL if not read with io_uring
+    int ring_file;        ///< a regular file not mapped, the ring is set up with the first block
+    int ring_fixed;       ///< the blocks are registered buffers
+    int ring_eof;         ///< the end of the file was read, no further reads are queued
+    uint8_t *ring_buf;    ///< SAMPLE_READER_DEPTH blocks
+    size_t ring_block;    ///< the length of a block
+    int64_t ring_offset;  ///< the file offset of the next read queued
+    unsigned ring_next;   ///< the block returned next
+    unsigned ring_queued; ///< the blocks with a read queued, from ring_next on
+    size_t ring_pos;      ///< the part of the next block returned
+    struct {
+        int64_t offset;
+        size_t fill; ///< the length read
+        int done;    ///< the read is complete, full or at the end of the file
+    } ring_reads[SAMPLE_READER_DEPTH];
+} sample_reader_t;
+
+/** Open a sample file, regular files are mapped, other files (e.g. stdin or a pipe) are read.
+
+    With -Y io regular files that can not be mapped, or all regular files with -Y io=uring,
+    are read ahead with io_uring instead, see io_ring_set_mode().
+
+    @param reader the reader to set up
+    @param file the open file, stays owned by the caller
+*/
+void sample_reader_open(sample_reader_t *reader, FILE *file);
+
+/** Get the next block of a sample file.
+
+    The block points into the mapping, to a read-ahead block, or to the buffer if the file is read.
+    A mapped block is read-only and valid until sample_reader_close(), a read-ahead block until the next call.
+
+    @param reader the reader
+    @param[out] block the start of the block
+    @param buf a buffer of at least len bytes, used if the file is not mapped
+    @param len the maximum block length in bytes
+    @return the block length in bytes, 0 at the end of the file
+*/
+size_t sample_reader_next(sample_reader_t *reader, uint8_t const **block, uint8_t *buf, size_t len);
+
+/** Release the mapping or the read-ahead blocks, the file is not closed. */
+void sample_reader_close(sample_reader_t *reader);
+
+#endif /* INCLUDE_SAMPLE_READER_H_ */
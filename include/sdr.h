@@ -12,10 +12,15 @@
 #ifndef INCLUDE_SDR_H_
 #define INCLUDE_SDR_H_
 
+#include <stddef.h>
 #include <stdint.h>
 
+struct iq_buf;
+
 #define SDR_DEFAULT_BUF_NUMBER 15
 #define SDR_DEFAULT_BUF_LENGTH 0x40000
+#define SDR_MAX_DEVICES 8 ///< devices read into one acquisition ring, see sdr_add_acquire()
+#define SDR_RING_SPARE 16 ///< pooled buffers the consumers may retain beyond the acquisition ring
 
 typedef struct sdr_dev sdr_dev_t;
 
@@ -36,6 +41,11 @@ typedef struct sdr_event {
     char const *gain_str;
     void *buf;
     int len;
+    unsigned lost;   ///< samples lost right before this buffer, dropped by the device or by a full acquisition ring
+    int64_t time_us; ///< wall clock time the buffer was read in microseconds, with an acquisition thread
+    uint64_t seq;    ///< sequence number of the buffer from the device, with an acquisition thread, a gap are buffers dropped by a full ring
+    struct iq_buf *iq; ///< the pooled buffer holding buf with an acquisition thread, retain it to keep the samples, NULL otherwise
+    unsigned queued; ///< events queued after this one in the acquisition ring, 0 ends a burst
 } sdr_event_t;
 
 typedef void (*sdr_event_cb_t)(sdr_event_t *ev, void *ctx);
@@ -49,6 +59,28 @@ typedef void (*sdr_event_cb_t)(sdr_event_t *ev, void *ctx);
 */
 int sdr_open(sdr_dev_t **out_dev, char const *dev_query, int verbose);
 
+/** Get the number of channels the device reads in one stream.
+
+    SoapySDR devices read several channels with a "channels=<n>" option in the device query.
+
+    @param dev the device handle
+    @return the number of channels, 1 for most devices
+*/
+unsigned sdr_get_channel_num(sdr_dev_t *dev);
+
+/** Open a handle for another channel of a device, for the settings and the events of the channel.
+
+    The channel is read by the read loop of the device, add the handle with sdr_add_acquire()
+    to get its events, otherwise the samples of the channel are discarded.
+    The handle does not start or stop anything, close it after sdr_start() of the device returned.
+
+    @param[out] out_dev the channel handle
+    @param dev the device handle
+    @param channel the channel, 1 to sdr_get_channel_num() - 1
+    @return 0 on success, -1 if the channel is not read or already open
+*/
+int sdr_open_channel(sdr_dev_t **out_dev, sdr_dev_t *dev, unsigned channel);
+
 /** Close the device.
 
     @note
@@ -81,6 +113,27 @@ int sdr_get_sample_size(sdr_dev_t *dev);
 */
 int sdr_get_sample_signed(sdr_dev_t *dev);
 
+/** Get the number of sample buffers dropped by the device, e.g. on SoapySDR overflows.
+
+    @param dev the device handle
+    @return the number of dropped buffers, 0 if unknown
+*/
+unsigned sdr_get_overflows(sdr_dev_t *dev);
+
+/** Get the bytes of the sample buffers of the device, the acquisition ring and the read buffer.
+
+    @param dev the device handle
+    @return the bytes, 0 if unknown
+*/
+size_t sdr_get_memory(sdr_dev_t *dev);
+
+/** Get the number of samples dropped by the device on overflows, from the stream time, e.g. with SoapySDR.
+
+    @param dev the device handle
+    @return the number of dropped samples, 0 if unknown
+*/
+uint64_t sdr_get_dropped_samples(sdr_dev_t *dev);
+
 /** Set device frequency, optionally report status.
 
     @param dev the device handle
@@ -182,8 +235,9 @@ int sdr_reset(sdr_dev_t *dev, int verbose);
 /** Start the SDR data acquisition.
 
     @note
-    All previous sdr_event_t buffers will be invalid if @p buf_num or @p buf_len changed.
-    Make sure none are in use anymore.
+    The sdr_event_t buffers are only valid until the callback returns,
+    with RTL-SDR they are the USB transfer buffers and are handed back to the device.
+    Copy the data if it is needed later, or retain the pooled buffer, see sdr_event_t.iq.
 
     @param dev the device handle
     @param cb a callback for sdr_event_t messages
@@ -194,6 +248,54 @@ int sdr_reset(sdr_dev_t *dev, int verbose);
 */
 int sdr_start(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len);
 
+/** Read the SDR on an acquisition thread, call before sdr_start().
+
+    The buffers are copied to a ring and the callback still runs on the thread calling sdr_start().
+    The ring buffers come from a pool, consumers may retain up to SDR_RING_SPARE of them instead of copying.
+    If the ring is full, whole buffers are dropped and the next buffer reports the samples lost.
+    Changes to the SDR settings are applied by the acquisition thread and reported in order.
+
+    @param dev the device handle
+    @param ring_num the number of buffers in the ring, 0 to read on the calling thread
+    @return 0 on success, -1 if not supported
+*/
+int sdr_set_acquire(sdr_dev_t *dev, unsigned ring_num);
+
+/** Hand the buffers of the acquisition ring over in bursts, call before sdr_start().
+
+    The processing thread sleeps while the buffers queue up and is woken once the oldest is
+    delay_ms old, or the ring is half full, then all queued events are passed in one burst.
+    The last event of a burst has no events queued after it.
+    Size the ring to hold twice the buffers of the delay, see sdr_set_acquire().
+
+    @param dev the device handle, sdr_set_acquire() must be set
+    @param delay_ms the most a buffer is held, 0 to pass each buffer as it is read
+    @return 0 on success, -1 if not supported
+*/
+int sdr_set_batch(sdr_dev_t *dev, unsigned delay_ms);
+
+/** Read another device on its own acquisition thread into the ring of a device, call before sdr_start().
+
+    The events of the other device are passed to its callback on the thread calling sdr_start() for the device,
+    in turn with the events of the device, so both callbacks can share state without locking.
+    The ring holds the set number of buffers for each device. If one read loop returns all are stopped.
+    The other device must stay open until sdr_start() returned, it is not started or stopped by itself.
+
+    @param dev the device handle, sdr_set_acquire() must be set
+    @param other the device handle of the other device
+    @param cb the callback for the events of the other device
+    @param ctx the context for the callback
+    @return 0 on success, -1 if not supported or more than SDR_MAX_DEVICES devices are added
+*/
+int sdr_add_acquire(sdr_dev_t *dev, sdr_dev_t *other, sdr_event_cb_t cb, void *ctx);
+
+/** Get the number of samples lost because the acquisition ring was full.
+
+    @param dev the device handle
+    @return the number of samples lost
+*/
+uint64_t sdr_get_lost_samples(sdr_dev_t *dev);
+
 /** Stop the SDR data acquisition.
 
     @note
@@ -0,0 +1,67 @@
+/** @file
+    Second-chance decoding, retries the unclaimed packages on an idle worker.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SECOND_CHANCE_H_
+#define INCLUDE_SECOND_CHANCE_H_
+
+#include <stdint.h>
+#include "compat_time.h"
+
+/// Packages waiting for the worker, further packages are dropped.
+#define SECOND_CHANCE_QUEUE_SIZE 16
+
+/// Samples kept before the start and after the end of a package, in ms, for the detector to settle on the noise.
+#define SECOND_CHANCE_LEAD_MS 10
+
+struct r_cfg;
+
+typedef struct second_chance second_chance_t;
+
+/// The samples of an unclaimed package, from before its start to after its end.
+typedef struct second_chance_span {
+    unsigned char const *iq_buf;
+    uint32_t len;          ///< length of the samples in bytes
+    uint32_t format;       ///< the sample format, e.g. CU8_IQ
+    uint32_t samp_rate;
+    uint32_t frequency;    ///< the tuned frequency
+    uint64_t input_pos;    ///< the sample position of the span in the input
+    struct timeval now;    ///< wall time of the end of the span
+    float sample_file_pos; ///< file position of the end of the span in seconds
+    int fsk;               ///< the package is FSK, the other FSK detector is tried too
+} second_chance_span_t;
+
+/** Create the worker, with its own demod state and decoders cloned from the config.
+
+    The worker thread runs at the idle priority where supported.
+    @param cfg the config, the decoders need to be registered
+    @return the new worker or NULL if threads are not supported or on error
+*/
+second_chance_t *second_chance_create(struct r_cfg *cfg);
+
+/// Wait for the queued packages to be retried, output the events, and free the worker.
+void second_chance_free(second_chance_t *sc, struct r_cfg *cfg);
+
+/** Queue a package to retry, the samples are copied.
+
+    @param sc the worker
+    @param span the samples of the package
+    @return 0 if queued, -1 if dropped as the queue is full
+*/
+int second_chance_push(second_chance_t *sc, second_chance_span_t const *span);
+
+/// Output the events of the retried packages, on the thread of the outputs, with "retried" set.
+void second_chance_output(second_chance_t *sc, struct r_cfg *cfg);
+
+/// Clone the decoders again, e.g. after a reload, the queued packages are dropped.
+void second_chance_reset(second_chance_t *sc, struct r_cfg *cfg);
+
+/// Get the counts of the packages queued, dropped as the queue was full, and the events decoded.
+void second_chance_counts(second_chance_t *sc, unsigned *queued, unsigned *dropped, unsigned *events);
+
+#endif /* INCLUDE_SECOND_CHANCE_H_ */
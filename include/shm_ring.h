@@ -0,0 +1,108 @@
+/** @file
+    Shared memory ring of serialized events, one writer and any number of readers.
+
+    The ring is a POSIX shared memory object: a header followed by the data area.
+    Each record is a record header and the payload, padded to 8 bytes.
+    The writer overwrites the oldest records, a reader that falls behind loses them
+    and continues with the oldest record still in the ring.
+
+    Readers only need this header and shm_ring.c, e.g.
+
+        shm_ring_t *ring = shm_ring_open("rtl_433");
+        char buf[4096];
+        uint64_t seq;
+        for (;;) {
+            int len = shm_ring_read(ring, buf, sizeof(buf), &seq);
+            if (len > 0)
+                handle_event(buf, len);
+            else
+                usleep(10000);
+        }
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SHM_RING_H_
+#define INCLUDE_SHM_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Magic number of the ring header, "r433" in little endian.
+#define SHM_RING_MAGIC 0x33333472
+/// Version of the ring layout.
+#define SHM_RING_VERSION 1
+
+/// Payload format of the records.
+enum shm_ring_format {
+    SHM_RING_JSON = 0, ///< compact JSON, not terminated
+    SHM_RING_CBOR = 1, ///< a CBOR map, see data_print_cbor()
+};
+
+/// Header of the shared memory object, the data area follows.
+typedef struct shm_ring_header {
+    uint32_t magic;   ///< SHM_RING_MAGIC
+    uint32_t version; ///< SHM_RING_VERSION
+    uint32_t format;  ///< payload format, an enum shm_ring_format
+    uint32_t reserved;
+    uint64_t size;    ///< size of the data area in bytes, a power of two
+    uint64_t head;    ///< end of the newest record, the number of bytes ever written
+    uint64_t tail;    ///< start of the oldest record that is not overwritten
+    uint64_t seq;     ///< sequence number of the newest record, the first record is 1
+    uint64_t pad[2];
+} shm_ring_header_t;
+
+/// Header of a record in the data area, the payload follows.
+typedef struct shm_ring_record {
+    uint32_t len;     ///< payload length in bytes
+    uint32_t reserved;
+    uint64_t seq;     ///< sequence number of the record
+} shm_ring_record_t;
+
+typedef struct shm_ring shm_ring_t;
+
+/** Create a ring to write to, an existing ring of that name is replaced.
+
+    @param name the name of the shared memory object, without the leading slash
+    @param size the size of the data area, rounded up to a power of two
+    @param format the payload format, an enum shm_ring_format
+    @return the new ring or NULL on error
+*/
+shm_ring_t *shm_ring_create(char const *name, size_t size, unsigned format);
+
+/** Append a record, overwriting the oldest records if needed.
+
+    @return 0 on success, -1 if the record is larger than the ring
+*/
+int shm_ring_write(shm_ring_t *ring, void const *buf, size_t len);
+
+/** Open a ring to read from, reading starts with the next record written.
+
+    @param name the name of the shared memory object, without the leading slash
+    @return the ring or NULL on error
+*/
+shm_ring_t *shm_ring_open(char const *name);
+
+/** Read the next record.
+
+    @param ring the ring from shm_ring_open()
+    @param buf the buffer for the payload
+    @param len the size of the buffer, a larger record is skipped
+    @param[out] seq the sequence number of the record, may be NULL
+    @return the payload length, 0 if there is no new record, -1 if a record was skipped
+*/
+int shm_ring_read(shm_ring_t *ring, void *buf, size_t len, uint64_t *seq);
+
+/** Get the payload format of a ring, an enum shm_ring_format. */
+unsigned shm_ring_format(shm_ring_t *ring);
+
+/** Get the number of records a reader lost because they were overwritten or skipped. */
+uint64_t shm_ring_lost(shm_ring_t *ring);
+
+/** Close a ring, a writer also removes the shared memory object. */
+void shm_ring_free(shm_ring_t *ring);
+
+#endif /* INCLUDE_SHM_RING_H_ */
@@ -0,0 +1,58 @@
+/** @file
+    Signal clustering, suggests flex decoder specs for recurring packages no decoder claimed.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SIGNAL_CLUSTER_H_
+#define INCLUDE_SIGNAL_CLUSTER_H_
+
+#include <stdint.h>
+#include "pulse_data.h"
+
+/// Slots of the cluster hash table, a power of two.
+#define SIGNAL_CLUSTER_SIZE 256
+/// Slots probed for a package, the least recently seen probed slot is reused if none is free.
+#define SIGNAL_CLUSTER_PROBES 8
+
+/// Clusters of unclaimed packages by timing fingerprint, an open addressing hash table with linear probing.
+typedef struct signal_cluster {
+    unsigned repeats;   ///< packages of a cluster before a flex spec is suggested, 0 is off
+    unsigned packages;  ///< unclaimed packages counted
+    unsigned clusters;  ///< clusters started, also the id of the last one
+    unsigned suggested; ///< flex specs suggested
+    unsigned evicted;   ///< clusters replaced by a new one
+    struct signal_cluster_slot {
+        uint32_t fingerprint; ///< quantized timing fingerprint, 0 for a never used slot
+        unsigned id;          ///< the cluster number, used in the suggested decoder name
+        unsigned count;       ///< packages in the cluster
+        unsigned seen;        ///< the package count when last seen
+        int suggested;        ///< a spec was suggested, the cluster is only counted
+    } slot[SIGNAL_CLUSTER_SIZE];
+} signal_cluster_t;
+
+/** The timing fingerprint of a package.
+
+    The pulse and gap widths are quantized to steps of about 19% and only the set of widths is kept,
+    the order of the widths, i.e. the data bits, does not change the fingerprint.
+
+    @param data the package
+    @param package_type PULSE_DATA_OOK or PULSE_DATA_FSK
+    @return the fingerprint, never 0
+*/
+uint32_t signal_cluster_fingerprint(pulse_data_t const *data, int package_type);
+
+/** Count a package no decoder claimed, a cluster seen repeats times is analyzed once and the flex spec printed.
+
+    Packages with less than PD_MIN_PULSES pulses are not counted.
+    @param sc the table
+    @param data the package
+    @param package_type PULSE_DATA_OOK or PULSE_DATA_FSK
+    @return 1 if a flex spec was suggested, 0 otherwise
+*/
+int signal_cluster_add(signal_cluster_t *sc, pulse_data_t const *data, int package_type);
+
+#endif /* INCLUDE_SIGNAL_CLUSTER_H_ */
@@ -0,0 +1,72 @@
+/** @file
+    Spectrum monitor, the occupancy and noise floor of FFT bins of the input band.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_SPECTRUM_H_
+#define INCLUDE_SPECTRUM_H_
+
+#include <stdint.h>
+
+struct data;
+
+/// FFT bins, unless set with -Y spectrum.
+#define SPECTRUM_BINS 256
+
+/// A bin is occupied in a snapshot if its power is this many dB above its noise floor.
+#define SPECTRUM_OCCUPIED_DB 10.0f
+
+typedef struct spectrum spectrum_t;
+
+/** Create a spectrum monitor.
+
+    With threads the snapshots are transformed on a side thread, a snapshot
+    is skipped while the thread is busy with the previous one.
+
+    @param bins the FFT size, a power of 2 from 16 to 4096
+    @param interval take a snapshot of every interval-th buffer, at least 1
+    @param bands the number of bands, one for each hop frequency
+    @return the new spectrum monitor or NULL on error
+*/
+spectrum_t *spectrum_create(unsigned bins, unsigned interval, unsigned bands);
+
+/// Stop the side thread and release the spectrum monitor.
+void spectrum_free(spectrum_t *spec);
+
+/** Take a snapshot of a sample buffer if one is due.
+
+    The statistics of a band restart if its center frequency or sample rate changed.
+
+    @param spec the spectrum monitor
+    @param band the band of the buffer, the hop frequency index
+    @param iq_buf the IQ samples
+    @param n_samples the number of samples
+    @param format the sample format, CU8_IQ, CS8_IQ, CS16_IQ, or CF32_IQ
+    @param center_frequency the center frequency of the samples
+    @param samp_rate the sample rate of the samples
+*/
+void spectrum_push(spectrum_t *spec, unsigned band, void const *iq_buf, unsigned long n_samples, uint32_t format, uint32_t center_frequency, uint32_t samp_rate);
+
+/** Get the fraction of occupied bins of a band.
+
+    @param spec the spectrum monitor
+    @param band the band
+    @return the mean occupancy of the bins from 0 to 1, or -1 if the band has no snapshots yet
+*/
+double spectrum_occupancy(spectrum_t *spec, unsigned band);
+
+/** Report the statistics of all bands.
+
+    Each band has the smoothed power, the noise floor, and the occupancy of each bin,
+    from the lowest to the highest frequency.
+
+    @param spec the spectrum monitor
+    @return the report, NULL on alloc failure
+*/
+struct data *spectrum_data(spectrum_t *spec);
+
+#endif /* INCLUDE_SPECTRUM_H_ */
@@ -46,6 +46,18 @@ typedef enum term_color {
 
 void term_set_fg(void *ctx, term_color_t color);
 
+/*
+ * Buffer size that holds any escape sequence of 'term_fg_escape()'.
+ */
+#define TERM_ESCAPE_MAX 8
+
+/*
+ * Write the escape sequence that sets the foreground color, to buffer the output with the colors.
+ * Returns the length, or 0 if the terminal sets colors with calls (the Windows console),
+ * then write out the buffered output and use 'term_set_fg()'.
+ */
+int term_fg_escape(term_color_t color, char *buf);
+
 void term_set_bg(void *ctx, term_color_t color);
 
 /*
@@ -0,0 +1,53 @@
+/** @file
+    Thread placement, pins the pipeline threads to CPUs and sets a realtime priority.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_THREAD_PIN_H_
+#define INCLUDE_THREAD_PIN_H_
+
+/// Realtime priority for the acquisition, unless set with -Y realtime.
+#define THREAD_PIN_REALTIME_PRIO 50
+
+/// The roles of the pipeline threads.
+typedef enum thread_role {
+    THREAD_ACQUIRE, ///< the acquisition threads of -Y acquire
+    THREAD_DEMOD,   ///< the processing thread, with the per-channel and FM demod threads it starts, and the spectrum thread
+    THREAD_DECODE,  ///< the decoder pool of -Y decthreads
+    THREAD_OUTPUT,  ///< the output queues and the file writers
+    THREAD_NET,     ///< the network thread polling mongoose, and the rtl_tcp server
+    THREAD_ROLES,
+} thread_role_t;
+
+/** Set the CPUs of a role, replaces an earlier setting of the role.
+
+    The settings are process wide and apply to the threads started, or pinned, afterwards.
+    @param arg "<role>:<cpus>", the role is one of acquire, demod, decode, output, net,
+               the cpus are numbers or ranges separated by colons, e.g. "demod:1-2:3"
+    @return 0 on success, -1 on a parse error
+*/
+int thread_pin_parse(char const *arg);
+
+/** Set the realtime priority (SCHED_FIFO) of the acquisition threads.
+
+    @param prio the priority, 0 for the normal scheduling
+*/
+void thread_pin_realtime(int prio);
+
+/** Pin the calling thread to the CPUs of a role.
+
+    A thread with a role without CPUs is returned to the CPUs of the process at the first
+    setting, as threads inherit the CPUs of the thread that starts them.
+    Does nothing if no role is set, logs a failure once per role.
+    @param role the role of the calling thread
+*/
+void thread_pin_self(thread_role_t role);
+
+/// Run the calling thread only on otherwise idle CPUs (SCHED_IDLE), e.g. for background work.
+void thread_pin_idle(void);
+
+#endif /* INCLUDE_THREAD_PIN_H_ */
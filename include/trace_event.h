@@ -0,0 +1,45 @@
+/** @file
+    Trace event file, a timeline of the processing in the Chrome trace event format.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_TRACE_EVENT_H_
+#define INCLUDE_TRACE_EVENT_H_
+
+/// Timeline rows of the trace.
+enum trace_event_row {
+    TRACE_BUFFERS = 1, ///< sample buffers demodulated and decoded
+    TRACE_PACKAGES,    ///< packages on air, from the first pulse to the last
+    TRACE_DECODE,      ///< decoders run on a package
+    TRACE_OUTPUTS,     ///< events printed to the outputs
+};
+
+typedef struct trace_event trace_event_t;
+
+/** Create a trace file, e.g. to load in chrome://tracing or https://ui.perfetto.dev/
+
+    @param path the file to write
+    @return the trace, or NULL if the file can not be created
+*/
+trace_event_t *trace_event_open(char const *path);
+
+/** Add a complete event to a trace.
+
+    @param trace the trace
+    @param name the event name
+    @param row the timeline row, a TRACE_ row
+    @param ts_us the start as wall time in microseconds
+    @param dur_us the duration in microseconds
+    @param arg_name the name of an argument to show with the event, or NULL
+    @param arg the argument value
+*/
+void trace_event_complete(trace_event_t *trace, char const *name, unsigned row, double ts_us, double dur_us, char const *arg_name, double arg);
+
+/** Finish and close a trace file. */
+void trace_event_close(trace_event_t *trace);
+
+#endif /* INCLUDE_TRACE_EVENT_H_ */
@@ -0,0 +1,56 @@
+/** @file
+    Unit conversion of event fields to SI or customary units, see -C.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_UNIT_CONVERT_H_
+#define INCLUDE_UNIT_CONVERT_H_
+
+struct data;
+
+/// The unit system to convert to.
+typedef enum unit_system {
+    UNIT_SI,
+    UNIT_CUSTOMARY,
+    UNIT_SYSTEMS, ///< number of unit systems
+} unit_system_t;
+
+/// The declared fields of a decoder with the conversion of each, an open addressing hash set.
+typedef struct unit_fields unit_fields_t;
+
+/** Index the declared fields of a decoder and look up their conversions.
+
+    The converted keys are interned for the process lifetime, queued events may refer to them
+    after the decoder is gone.
+    @param fields the NULL-terminated fields, must stay valid, may be NULL
+    @return the new set, or NULL if there are no fields or on error
+*/
+unit_fields_t *unit_fields_create(char const *const *fields);
+
+/// Free a set of fields.
+void unit_fields_free(unit_fields_t *set);
+
+/** Check if a key is a declared field.
+
+    @param set the fields, may be NULL
+    @param key the key to look up
+    @return 1 if the key is declared, 0 otherwise
+*/
+int unit_fields_declared(unit_fields_t const *set, char const *key);
+
+/** Convert the value, key, and format of a field if it has a unit of the other system.
+
+    Declared fields and the well-known keys are a lookup without allocations,
+    the format is rewritten in place unless the new unit is longer.
+    Other keys are matched by their suffix and the key is replaced.
+    @param set the fields of the decoder, may be NULL
+    @param to the unit system to convert to
+    @param field the field, the following fields are not converted
+*/
+void unit_convert_field(unit_fields_t const *set, unit_system_t to, struct data *field);
+
+#endif /* INCLUDE_UNIT_CONVERT_H_ */
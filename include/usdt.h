@@ -0,0 +1,44 @@
+/** @file
+    Static tracepoints (USDT) at the boundaries of the pipeline stages.
+
+    With USDT each probe is a nop in the code and a note in the ELF file,
+    attach to them e.g. with `bpftrace -l 'usdt:./src/rtl_433:rtl_433:*'`.
+    Without USDT the probes compile to nothing. Keep the arguments cheap,
+    they are evaluated even if no tracer is attached.
+
+    Probes, all in the provider rtl_433:
+    - buffer_in(n_samples, input_pos): a sample buffer enters the pipeline
+    - baseband_done(n_samples, process_frame): the buffer is demodulated
+    - package(package_type, num_pulses): a package is detected
+    - decoder_start(protocol_num), decoder_end(protocol_num, ret): a decoder runs on a bitbuffer
+    - event_out(raw_event): an event is passed to the outputs
+    - buffer_done(n_samples, events): the buffer is processed
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_USDT_H_
+#define INCLUDE_USDT_H_
+
+#ifdef USDT
+
+#include <sys/sdt.h>
+
+#define USDT_PROBE1(name, a)    DTRACE_PROBE1(rtl_433, name, a)
+#define USDT_PROBE2(name, a, b) DTRACE_PROBE2(rtl_433, name, a, b)
+
+#else
+
+#define USDT_PROBE1(name, a) \
+    do {                     \
+    } while (0)
+#define USDT_PROBE2(name, a, b) \
+    do {                        \
+    } while (0)
+
+#endif
+
+#endif /* INCLUDE_USDT_H_ */
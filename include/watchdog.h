@@ -0,0 +1,71 @@
+/** @file
+    Watchdog thread, measures the stalls of the sample callback and recovers from them.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#ifndef INCLUDE_WATCHDOG_H_
+#define INCLUDE_WATCHDOG_H_
+
+/// Time without a callback until a stall, unless set with -Y watchdog.
+#define WATCHDOG_STALL_MS 3000
+/// Callback interval or duration logged as a near stall, unless set with -Y watchdog.
+#define WATCHDOG_WARN_MS 1000
+/// Stalls in a row that are recovered before giving up.
+#define WATCHDOG_RESETS 3
+
+/** Handle a stall, called on the watchdog thread.
+
+    @param ctx the context of watchdog_create()
+    @param stalls the stalls in a row, 1 for a new stall, then once more for each stall time
+    @param stalled_us the time since the last callback
+*/
+typedef void (*watchdog_stall_fn)(void *ctx, unsigned stalls, double stalled_us);
+
+typedef struct watchdog watchdog_t;
+
+/** Create a watchdog thread, the watchdog waits for watchdog_feed().
+
+    @param stall_ms the time without a callback that is a stall
+    @param warn_ms the callback interval or duration to log as a near stall, 0 for none
+    @param stall_fn the handler of stalls
+    @param ctx the context of the handler
+    @return the new watchdog, or NULL on error or if built without threads support
+*/
+watchdog_t *watchdog_create(unsigned stall_ms, unsigned warn_ms, watchdog_stall_fn stall_fn, void *ctx);
+
+/** Feed the watchdog at the start of a callback, arms it if paused.
+
+    Logs an interval above the near stall time.
+    @param w the watchdog
+    @return the time since the last feed in microseconds, 0 if the watchdog was paused
+*/
+double watchdog_feed(watchdog_t *w);
+
+/** Mark the end of a callback.
+
+    Logs a duration above the near stall time.
+    @param w the watchdog
+    @return the time since the feed in microseconds, also if paused meanwhile, 0 if not fed
+*/
+double watchdog_done(watchdog_t *w);
+
+/// Pause the watchdog until the next feed, e.g. if the next callback is late for a retune.
+void watchdog_pause(watchdog_t *w);
+
+/// The number of stalls.
+unsigned watchdog_stalls(watchdog_t *w);
+
+/// The number of near stalls, callback intervals or durations above the near stall time.
+unsigned watchdog_near_stalls(watchdog_t *w);
+
+/** Stop and free a watchdog.
+
+    @param w the watchdog, may be NULL
+*/
+void watchdog_free(watchdog_t *w);
+
+#endif /* INCLUDE_WATCHDOG_H_ */
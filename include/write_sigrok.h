@@ -12,15 +12,42 @@
 #ifndef INCLUDE_WRITE_SIGROK_
 #define INCLUDE_WRITE_SIGROK_
 
-/** Write a Sigrok file from data dump files.
+#include <stdio.h>
 
-    @param filename file to write
+/// Channel data is buffered up to this size and then written as the next chunk entry.
+#define SIGROK_CHUNK_SIZE (1 << 20)
+
+typedef struct sigrok_writer sigrok_writer_t;
+
+/** Start a Sigrok file, the channel data is streamed to it in chunks.
+
+    @param file the file to write, opened for writing at the start
+    @param probes number of binary channels, written as one byte per sample
+    @param analogs number of analog channels, written as float samples, numbered from probes+1
+    @param labels channel labels, probes+analog strings or NULL for generic labels, must outlive the writer
+    @return the new writer or NULL on alloc failure
+*/
+sigrok_writer_t *sigrok_writer_create(FILE *file, unsigned probes, unsigned analogs, char const *labels[]);
+
+/** Add the samples of a channel.
+
+    @param sr the writer
+    @param channel 0 for the logic probes, 1 to analogs for the analog channels
+    @param buf the samples, one byte per sample for the probes, a float per sample otherwise
+    @param len the size of the samples in bytes
+    @return 0 on success, -1 on a failed write
+*/
+int sigrok_writer_add(sigrok_writer_t *sr, unsigned channel, void const *buf, size_t len);
+
+/** Write the remaining chunks, the metadata and the zip directory, and free the writer.
+
+    The file is flushed but not closed.
+
+    @param sr the writer, NULL is ignored
     @param samplerate sample rate for the channels
-    @param probes number of binary channels, needs "logic-1-1" file
-    @param analogs number of analog channels, needs "analog-1-N-1" with N starting at probes+1
-    @param labels channel labels, probes+analog strings or NULL for generic labels
+    @return 0 on success, -1 if the file is incomplete
 */
-void write_sigrok(char const *filename, unsigned samplerate, unsigned probes, unsigned analogs, char const *labels[]);
+int sigrok_writer_close(sigrok_writer_t *sr, unsigned samplerate);
 
 /** Open a file in a forked Pulseview.
 
@@ -0,0 +1,92 @@
+/** @file
+    Fast gain control, steps the tuner gain from the clipping of the input samples.
+
+    The clipping is counted in the envelope pass of each buffer, so control reacts
+    within a buffer of a strong signal, much faster than the tuner AGC reacts to
+    the average power. Clipped samples step the gain down, a peak well below full
+    scale for a while steps it up, the dead band between keeps the gain stable.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "agc.h"
+#include "baseband.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define AGC_STEP_DB 3.0f      // gain step up or down
+#define AGC_MIN_DB 1.0f       // a gain of 0 selects the tuner auto gain
+#define AGC_MAX_DB 50.0f      // above the largest gain of most tuners
+#define AGC_START_DB 30.0f    // start gain if the tuner was on auto gain
+#define AGC_CLIP_RATIO 1e-4   // clipped samples per sample that step the gain down
+#define AGC_HOLD_MS 1000      // time with the peak below the headroom that steps the gain up
+#define AGC_SETTLE_MS 250     // time for a gain step to apply
+
+agc_t *agc_create(char const *gain_str, float headroom)
+{
+    agc_t *agc = calloc(1, sizeof(*agc));
+    if (!agc) {
+        WARN_CALLOC("agc_create()");
+        return NULL;
+    }
+
+    agc_set_gain(agc, gain_str);
+    agc->headroom = headroom > 0.0f ? headroom : AGC_HEADROOM_DB;
+    return agc;
+}
+
+void agc_set_gain(agc_t *agc, char const *gain_str)
+{
+    float gain  = gain_str && *gain_str ? (float)atof(gain_str) : AGC_START_DB;
+    agc->gain   = gain < AGC_MIN_DB ? AGC_START_DB : gain > AGC_MAX_DB ? AGC_MAX_DB : gain;
+    agc->quiet  = 0;
+    agc->settle = 0;
+}
+
+void agc_free(agc_t *agc)
+{
+    free(agc);
+}
+
+int agc_update(agc_t *agc, baseband_clip_t const *clip, uint32_t samp_rate)
+{
+    if (!clip->samples)
+        return 0;
+
+    if (agc->settle > clip->samples) {
+        agc->settle -= clip->samples;
+        return 0;
+    }
+    agc->settle = 0;
+
+    float gain = agc->gain;
+    if (clip->clipped > clip->samples * AGC_CLIP_RATIO) {
+        gain -= AGC_STEP_DB;
+        agc->quiet = 0;
+    }
+    else if (baseband_clip_peak_dbfs(clip) < -agc->headroom) {
+        agc->quiet += clip->samples;
+        if (agc->quiet >= (uint64_t)samp_rate * AGC_HOLD_MS / 1000) {
+            gain += AGC_STEP_DB;
+            agc->quiet = 0;
+        }
+    }
+    else {
+        agc->quiet = 0;
+    }
+
+    gain = gain < AGC_MIN_DB ? AGC_MIN_DB : gain > AGC_MAX_DB ? AGC_MAX_DB : gain;
+    if (gain == agc->gain)
+        return 0;
+
+    agc->steps_up += gain > agc->gain;
+    agc->steps_down += gain < agc->gain;
+    agc->gain   = gain;
+    agc->settle = (uint64_t)samp_rate * AGC_SETTLE_MS / 1000;
+    return 1;
+}
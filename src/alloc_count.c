@@ -0,0 +1,128 @@
+/** @file
+    Heap allocation counters, for the allocations of each pipeline stage.
+
+    With ALLOC_COUNT the executables are linked with --wrap for each allocation
+    function, the wrappers count the calls of each thread and call the real function.
+    With glibc the wrappers also sum the bytes of the live blocks of all threads,
+    the blocks allocated inside the C library are freed with alloc_count_free_libc().
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "alloc_count.h"
+#include "compat_pthread.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#define BLOCK_SIZE(ptr) malloc_usable_size(ptr)
+#endif
+
+#ifdef ALLOC_COUNT
+
+static THREAD_LOCAL alloc_count_t thread_count;
+
+#ifdef BLOCK_SIZE
+static uint64_t heap_bytes; ///< changed atomically, blocks are freed on other threads
+#define BLOCK_BYTES(ptr)   BLOCK_SIZE(ptr)
+#define HEAP_ADD(ptr, old) __atomic_add_fetch(&heap_bytes, (uint64_t)BLOCK_SIZE(ptr) - (uint64_t)(old), __ATOMIC_RELAXED)
+#define HEAP_SUB(ptr)      __atomic_sub_fetch(&heap_bytes, (uint64_t)BLOCK_SIZE(ptr), __ATOMIC_RELAXED)
+#else
+#define BLOCK_BYTES(ptr)   0
+#define HEAP_ADD(ptr, old) ((void)(old))
+#define HEAP_SUB(ptr)      ((void)0)
+#endif
+
+// defines the wrapper of an allocation function that counts the calls of the thread,
+// and the bytes of the blocks, old is the size of the block the call replaces
+#define ALLOC_COUNT_WRAP(name, ret, params, args, old) \
+    ret __real_##name params;                          \
+    ret __wrap_##name params;                          \
+    ret __wrap_##name params                           \
+    {                                                  \
+        thread_count.allocs++;                         \
+        size_t old_bytes = (old);                      \
+        ret p            = __real_##name args;         \
+        if (p)                                         \
+            HEAP_ADD(p, old_bytes);                    \
+        return p;                                      \
+    }
+
+ALLOC_COUNT_WRAP(malloc, void *, (size_t size), (size), 0)
+ALLOC_COUNT_WRAP(calloc, void *, (size_t nmemb, size_t size), (nmemb, size), 0)
+ALLOC_COUNT_WRAP(realloc, void *, (void *ptr, size_t size), (ptr, size), ptr ? BLOCK_BYTES(ptr) : 0)
+ALLOC_COUNT_WRAP(strdup, char *, (char const *s), (s), 0)
+
+void __real_free(void *ptr);
+void __wrap_free(void *ptr);
+void __wrap_free(void *ptr)
+{
+    if (ptr) {
+        thread_count.frees++;
+        HEAP_SUB(ptr);
+    }
+    __real_free(ptr);
+}
+
+void alloc_count_free_libc(void *ptr)
+{
+    __real_free(ptr);
+}
+
+int alloc_count_enabled(void)
+{
+    return 1;
+}
+
+alloc_count_t alloc_count_get(void)
+{
+    return thread_count;
+}
+
+uint64_t alloc_count_heap_bytes(void)
+{
+#ifdef BLOCK_SIZE
+    return __atomic_load_n(&heap_bytes, __ATOMIC_RELAXED);
+#else
+    return 0;
+#endif
+}
+
+#else
+
+void alloc_count_free_libc(void *ptr)
+{
+    free(ptr);
+}
+
+int alloc_count_enabled(void)
+{
+    return 0;
+}
+
+alloc_count_t alloc_count_get(void)
+{
+    return (alloc_count_t){0};
+}
+
+uint64_t alloc_count_heap_bytes(void)
+{
+    return 0;
+}
+
+#endif
+
+size_t alloc_block_size(void const *ptr)
+{
+#ifdef BLOCK_SIZE
+    return ptr ? BLOCK_SIZE((void *)ptr) : 0;
+#else
+    (void)ptr;
+    return 0;
+#endif
+}
@@ -15,6 +15,7 @@
 
 #include "bitbuffer.h"
 #include "samp_grab.h"
+#include "pulse_detect.h"
 #include "fatal.h"
 
 #include "am_analyze.h"
@@ -33,6 +34,8 @@ am_analyze_t *am_analyze_create(void)
 
 void am_analyze_free(am_analyze_t *a)
 {
+    free(a->signal_pulse_data);
+    free(a->signal_distance_data);
     free(a);
 }
 
@@ -42,67 +45,147 @@ void am_analyze_skip(am_analyze_t *a, unsigned n_samples)
     a->signal_start = 0;
 }
 
+/// Make room for the next pulse, the store grows up to PULSE_DATA_SIZE, returns 0 if there is no room.
+static int reserve_pulse(am_analyze_t *a)
+{
+    if (a->signal_pulse_counter < a->signal_pulse_size)
+        return 1;
+    unsigned size = a->signal_pulse_size ? a->signal_pulse_size * 2 : 256;
+    if (size > PULSE_DATA_SIZE)
+        size = PULSE_DATA_SIZE;
+    if (size <= a->signal_pulse_counter)
+        return 0;
+    unsigned (*data)[3] = realloc(a->signal_pulse_data, size * sizeof(*data));
+    if (!data) {
+        WARN_REALLOC("am_analyze()");
+        return 0;
+    }
+    a->signal_pulse_data = data;
+    unsigned *distance = realloc(a->signal_distance_data, size * sizeof(*distance));
+    if (!distance) {
+        WARN_REALLOC("am_analyze()");
+        return 0;
+    }
+    a->signal_distance_data = distance;
+    a->signal_pulse_size    = size;
+    return 1;
+}
+
+static void pulse_started(am_analyze_t *a, int16_t am_n, int debug_output)
+{
+    a->pulses_found++;
+    a->pulse_start = a->counter;
+    if (reserve_pulse(a)) {
+        a->signal_pulse_data[a->signal_pulse_counter][0] = a->counter;
+        a->signal_pulse_data[a->signal_pulse_counter][1] = -1;
+        a->signal_pulse_data[a->signal_pulse_counter][2] = -1;
+    }
+    if (debug_output) {
+        fprintf(stderr, "pulse_distance %u\n", a->counter - a->pulse_end);
+        fprintf(stderr, "pulse_start distance %u\n", a->pulse_start - a->prev_pulse_start);
+        fprintf(stderr, "pulse_start[%u] found at sample %u, value = %d\n", a->pulses_found, a->counter, am_n);
+    }
+    a->prev_pulse_start = a->pulse_start;
+    a->print = 0;
+    a->print2 = 1;
+}
+
+static void pulse_ended(am_analyze_t *a, int debug_output)
+{
+    a->pulse_avg += a->counter - a->pulse_start;
+    if (debug_output) {
+        fprintf(stderr, "pulse_end  [%u] found at sample %u, pulse length = %u, pulse avg length = %u\n",
+                a->pulses_found, a->counter, a->counter - a->pulse_start, (a->pulses_found) ? (a->pulse_avg / a->pulses_found) : 0);
+    }
+    a->pulse_end = a->counter;
+    a->print2 = 0;
+    if (a->signal_pulse_counter < a->signal_pulse_size) {
+        a->signal_pulse_data[a->signal_pulse_counter][1] = a->counter;
+        a->signal_pulse_data[a->signal_pulse_counter][2] = a->counter - a->pulse_start;
+        a->signal_pulse_counter++;
+    }
+    if (a->signal_pulse_counter >= PULSE_DATA_SIZE) {
+        fprintf(stderr, "*** Classifying a batch of %u pulses, the signal continues\n", a->signal_pulse_counter);
+        am_analyze_classify(a); // clears signal_pulse_data
+    }
+}
+
+/// The signal ended at the current sample, the grab end is counted in samples from the end of the buffer.
+static void signal_ended(am_analyze_t *a, unsigned grab_end, samp_grab_t *g)
+{
+    unsigned padded_start = a->signal_start - FRAME_PAD;
+    unsigned padded_end   = a->counter - FRAME_END_MIN + FRAME_PAD;
+    unsigned padded_len   = padded_end - padded_start;
+    fprintf(stderr, "*** signal_start = %u, signal_end = %u, signal_len = %u, pulses_found = %u\n",
+            padded_start, padded_end, padded_len, a->pulses_found);
+
+    am_analyze_classify(a); // clears signal_pulse_data
+    a->pulses_found = 0;
+
+    if (g) {
+        samp_grab_write(g, padded_len, grab_end);
+    }
+    a->signal_start = 0;
+}
+
 void am_analyze(am_analyze_t *a, int16_t *am_buf, unsigned n_samples, int debug_output, samp_grab_t *g)
 {
-    unsigned int i;
     int threshold = (a->level_limit ? a->level_limit : 8000);  // Does not support auto level. Use old default instead.
 
-    for (i = 0; i < n_samples; i++) {
-        if (am_buf[i] > threshold) {
-            if (!a->signal_start)
-                a->signal_start = a->counter;
-            if (a->print) {
-                a->pulses_found++;
-                a->pulse_start = a->counter;
-                a->signal_pulse_data[a->signal_pulse_counter][0] = a->counter;
-                a->signal_pulse_data[a->signal_pulse_counter][1] = -1;
-                a->signal_pulse_data[a->signal_pulse_counter][2] = -1;
-                if (debug_output) {
-                    fprintf(stderr, "pulse_distance %u\n", a->counter - a->pulse_end);
-                    fprintf(stderr, "pulse_start distance %u\n", a->pulse_start - a->prev_pulse_start);
-                    fprintf(stderr, "pulse_start[%u] found at sample %u, value = %d\n", a->pulses_found, a->counter, am_buf[i]);
-                }
-                a->prev_pulse_start = a->pulse_start;
-                a->print = 0;
-                a->print2 = 1;
-            }
-        }
-        a->counter++;
-        if (am_buf[i] < threshold) {
-            if (a->print2) {
-                a->pulse_avg += a->counter - a->pulse_start;
-                if (debug_output) {
-                    fprintf(stderr, "pulse_end  [%u] found at sample %u, pulse length = %u, pulse avg length = %u\n",
-                            a->pulses_found, a->counter, a->counter - a->pulse_start, (a->pulses_found) ? (a->pulse_avg / a->pulses_found) : 0);
-                }
-                a->pulse_end = a->counter;
-                a->print2 = 0;
-                a->signal_pulse_data[a->signal_pulse_counter][1] = a->counter;
-                a->signal_pulse_data[a->signal_pulse_counter][2] = a->counter - a->pulse_start;
-                a->signal_pulse_counter++;
-                if (a->signal_pulse_counter >= PULSE_DATA_SIZE) {
-                    a->signal_pulse_counter = 0;
-                    fprintf(stderr, "Too many pulses detected, probably bad input data or input parameters\n");
-                    return;
-                }
+    // Samples above the threshold start a pulse, samples below end it, equal samples change nothing.
+    // The runs between the crossings are skipped with the block-wise search of the pulse detector.
+    unsigned i = 0;
+    while (i < n_samples) {
+        int len = (int)(n_samples - i);
+        if (a->print2) {
+            // in a pulse, run to the first sample below the threshold
+            int run = envelope_find_below(&am_buf[i], len, threshold);
+            if (!a->signal_start) {
+                int above = envelope_find_above(&am_buf[i], run, threshold);
+                if (above < run)
+                    a->signal_start = a->counter + above;
             }
+            a->counter += run;
+            i += run;
+            if (i >= n_samples)
+                break;
+            a->counter++;
+            pulse_ended(a, debug_output);
             a->print = 1;
-            if (a->signal_start && (a->pulse_end + FRAME_END_MIN < a->counter)) {
-                unsigned padded_start = a->signal_start - FRAME_PAD;
-                unsigned padded_end   = a->counter - FRAME_END_MIN + FRAME_PAD;
-                unsigned padded_len   = padded_end - padded_start;
-                fprintf(stderr, "*** signal_start = %u, signal_end = %u, signal_len = %u, pulses_found = %u\n",
-                        padded_start, padded_end, padded_len, a->pulses_found);
-
-                am_analyze_classify(a); // clears signal_pulse_data
-                a->pulses_found = 0;
-
-                if (g) {
-                    samp_grab_write(g, padded_len, n_samples - i - 1);
-                }
-                a->signal_start = 0;
+            i++;
+            continue;
+        }
+
+        // in a gap, run to the first sample above the threshold
+        int run = envelope_find_above(&am_buf[i], len, threshold);
+        if (run > 0 && !a->print) {
+            // before the first pulse, a sample below the threshold arms the pulse start
+            if (envelope_find_below(&am_buf[i], run, threshold) < run)
+                a->print = 1;
+        }
+        if (run > 0 && a->signal_start) {
+            // the signal ends at the first sample below the threshold after FRAME_END_MIN samples
+            int64_t wait = (int64_t)a->pulse_end + FRAME_END_MIN - a->counter;
+            int from     = wait < 0 ? 0 : wait < run ? (int)wait : run;
+            int end      = from + envelope_find_below(&am_buf[i + from], run - from, threshold);
+            if (end < run) {
+                a->counter += end + 1;
+                i += end + 1;
+                signal_ended(a, n_samples - i, g);
+                continue;
             }
         }
+        a->counter += run;
+        i += run;
+        if (i >= n_samples)
+            break;
+
+        if (!a->signal_start)
+            a->signal_start = a->counter;
+        if (a->print)
+            pulse_started(a, am_buf[i], debug_output);
+        a->counter++;
+        i++;
     }
 }
 
@@ -112,12 +195,13 @@ void am_analyze_classify(am_analyze_t *aa)
     unsigned int i, k, max = 0, min = 1000000, t;
     unsigned int delta, p_limit;
     unsigned int a[3], b[2], a_cnt[3], a_new[3];
-    unsigned int signal_distance_data[PULSE_DATA_SIZE] = {0};
+    unsigned int *signal_distance_data = aa->signal_distance_data;
     bitbuffer_t bits = {0};
     unsigned int signal_type;
 
-    if (!aa->signal_pulse_data[0][0])
+    if (!aa->signal_pulse_counter || !aa->signal_pulse_data[0][0])
         return;
+    memset(signal_distance_data, 0, aa->signal_pulse_counter * sizeof(*signal_distance_data));
 
     for (i = 0; i < aa->signal_pulse_counter; i++) {
         if (aa->signal_pulse_data[i][0] > 0) {
@@ -0,0 +1,431 @@
+/** @file
+    Arrow IPC file writer, the columnar container of the pulse and event exports.
+
+    The file is the Arrow IPC file format (Feather V2), readable with e.g.
+    `pandas.read_feather()` or `pyarrow.ipc.open_file()`. The flatbuffer metadata is
+    built by hand in front-to-back order, all children follow their parent so the
+    offsets are positive. All values are little-endian, the buffers are 8 byte aligned.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "arrow_ipc.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARROW_MAGIC "ARROW1\0\0"
+#define ARROW_CONTINUATION 0xffffffff
+
+// flatbuffer enum values of the Arrow format
+#define ARROW_METADATA_V5 4
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_FLOATING_POINT 3
+#define ARROW_TYPE_UTF8 5
+#define ARROW_TYPE_LIST 12
+#define ARROW_PRECISION_SINGLE 1
+#define ARROW_PRECISION_DOUBLE 2
+
+/* flatbuffer builder */
+
+/// A flatbuffer, built front-to-back.
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t size;
+} fb_t;
+
+/// Append zeroed bytes at an alignment, returns the position.
+static size_t fb_reserve(fb_t *fb, size_t len, size_t align)
+{
+    size_t pos = (fb->len + align - 1) / align * align;
+    if (pos + len > fb->size) {
+        size_t size = fb->size ? fb->size : 1024;
+        while (pos + len > size)
+            size *= 2;
+        uint8_t *buf = realloc(fb->buf, size);
+        if (!buf)
+            FATAL_REALLOC("fb_reserve()");
+        fb->buf  = buf;
+        fb->size = size;
+    }
+    memset(fb->buf + fb->len, 0, pos + len - fb->len);
+    fb->len = pos + len;
+    return pos;
+}
+
+static void fb_put(fb_t *fb, size_t pos, uint64_t v, unsigned size)
+{
+    arrow_put(fb->buf + pos, v, size);
+}
+
+/// Point the offset at a position to a later object.
+static void fb_offset(fb_t *fb, size_t pos, size_t target)
+{
+    fb_put(fb, pos, target - pos, 4);
+}
+
+/** Append a table, the vtable is placed before it.
+
+    @param fb the flatbuffer
+    @param num_fields the number of fields in the vtable, up to 8
+    @param sizes the size of each field, 0 for absent fields
+    @param[out] field_pos the position of each field, to put the values later
+    @return the position of the table
+*/
+static size_t fb_table(fb_t *fb, unsigned num_fields, uint8_t const *sizes, size_t *field_pos)
+{
+    uint16_t field_off[8] = {0};
+    size_t table_len      = 4; // the soffset to the vtable
+    for (unsigned i = 0; i < num_fields; ++i) {
+        if (!sizes[i])
+            continue;
+        table_len    = (table_len + sizes[i] - 1) / sizes[i] * sizes[i];
+        field_off[i] = (uint16_t)table_len;
+        table_len += sizes[i];
+    }
+    table_len = (table_len + 3) / 4 * 4;
+
+    size_t vtable = fb_reserve(fb, 4 + 2 * num_fields, 2);
+    size_t table  = fb_reserve(fb, table_len, 8);
+    fb_put(fb, vtable, 4 + 2 * num_fields, 2);
+    fb_put(fb, vtable + 2, table_len, 2);
+    for (unsigned i = 0; i < num_fields; ++i) {
+        fb_put(fb, vtable + 4 + 2 * i, field_off[i], 2);
+        field_pos[i] = field_off[i] ? table + field_off[i] : 0;
+    }
+    fb_put(fb, table, table - vtable, 4);
+    return table;
+}
+
+/// Append a vector, the elements follow the length at an alignment, returns the position of the length.
+static size_t fb_vector(fb_t *fb, size_t num_elems, size_t elem_size, size_t align)
+{
+    // pad so that the elements after the 4 byte length are aligned
+    while ((fb->len + 4) % align)
+        fb_reserve(fb, 1, 1);
+    size_t pos = fb_reserve(fb, 4 + num_elems * elem_size, 4);
+    fb_put(fb, pos, num_elems, 4);
+    return pos;
+}
+
+static size_t fb_string(fb_t *fb, char const *s)
+{
+    size_t len = strlen(s);
+    size_t pos = fb_reserve(fb, 4 + len + 1, 4);
+    fb_put(fb, pos, len, 4);
+    memcpy(fb->buf + pos + 4, s, len);
+    return pos;
+}
+
+/// Append a Field table, returns the position.
+static size_t fb_field(fb_t *fb, char const *name, enum arrow_type type, int nullable)
+{
+    // name, nullable, type_type, type, dictionary, children
+    static uint8_t const sizes[] = {4, 1, 1, 4, 0, 4};
+    size_t f[6];
+    size_t field = fb_table(fb, 6, sizes, f);
+
+    fb_offset(fb, f[0], fb_string(fb, name));
+    fb_put(fb, f[1], nullable ? 1 : 0, 1);
+
+    size_t t[2];
+    if (type == ARROW_INT32 || type == ARROW_INT64) {
+        // bitWidth, is_signed
+        static uint8_t const int_sizes[] = {4, 1};
+        fb_put(fb, f[2], ARROW_TYPE_INT, 1);
+        fb_offset(fb, f[3], fb_table(fb, 2, int_sizes, t));
+        fb_put(fb, t[0], type == ARROW_INT64 ? 64 : 32, 4);
+        fb_put(fb, t[1], 1, 1);
+    }
+    else if (type == ARROW_FLOAT32 || type == ARROW_FLOAT64) {
+        // precision
+        static uint8_t const float_sizes[] = {2};
+        fb_put(fb, f[2], ARROW_TYPE_FLOATING_POINT, 1);
+        fb_offset(fb, f[3], fb_table(fb, 1, float_sizes, t));
+        fb_put(fb, t[0], type == ARROW_FLOAT64 ? ARROW_PRECISION_DOUBLE : ARROW_PRECISION_SINGLE, 2);
+    }
+    else {
+        fb_put(fb, f[2], type == ARROW_UTF8 ? ARROW_TYPE_UTF8 : ARROW_TYPE_LIST, 1);
+        fb_offset(fb, f[3], fb_table(fb, 0, NULL, t)); // Utf8 and List have no fields
+    }
+
+    size_t children = fb_vector(fb, type == ARROW_LIST_INT32 ? 1 : 0, 4, 4);
+    fb_offset(fb, f[5], children);
+    if (type == ARROW_LIST_INT32)
+        fb_offset(fb, children + 4, fb_field(fb, "item", ARROW_INT32, 0));
+    return field;
+}
+
+/// Append a Message table with the header type, returns the position of the header offset.
+static size_t fb_message(fb_t *fb, unsigned header_type, uint64_t body_len)
+{
+    // version, header_type, header, bodyLength
+    static uint8_t const sizes[] = {2, 1, 4, 8};
+    size_t m[4];
+    size_t root    = fb_reserve(fb, 4, 4);
+    size_t message = fb_table(fb, 4, sizes, m);
+    fb_offset(fb, root, message);
+    fb_put(fb, m[0], ARROW_METADATA_V5, 2);
+    fb_put(fb, m[1], header_type, 1);
+    fb_put(fb, m[3], body_len, 8);
+    return m[2];
+}
+
+/* writer */
+
+/// The position of a record batch, see the Block struct of the footer.
+typedef struct {
+    uint64_t offset;
+    uint32_t meta_len;
+    uint64_t body_len;
+} arrow_block_t;
+
+struct arrow_ipc {
+    FILE *file;
+    uint64_t pos; ///< the bytes written
+    int failed;   ///< a write failed, the file is incomplete
+    arrow_column_t *columns;
+    unsigned num_columns;
+    arrow_block_t *blocks;
+    unsigned blocks_len;
+    unsigned blocks_size;
+};
+
+/// Append a Schema table, returns the position.
+static size_t fb_schema(fb_t *fb, arrow_ipc_t const *w)
+{
+    // endianness, fields
+    static uint8_t const sizes[] = {2, 4};
+    size_t s[2];
+    size_t schema = fb_table(fb, 2, sizes, s);
+    fb_put(fb, s[0], 0, 2); // little-endian
+    size_t fields = fb_vector(fb, w->num_columns, 4, 4);
+    fb_offset(fb, s[1], fields);
+    for (unsigned i = 0; i < w->num_columns; ++i) {
+        arrow_column_t const *c = &w->columns[i];
+        fb_offset(fb, fields + 4 + 4 * i, fb_field(fb, c->name, c->type, c->nullable));
+    }
+    return schema;
+}
+
+static void arrow_write(arrow_ipc_t *w, void const *buf, size_t len)
+{
+    if (w->failed || !len)
+        return;
+    if (fwrite(buf, 1, len, w->file) != len) {
+        perror("Arrow file output error");
+        w->failed = 1;
+        return;
+    }
+    w->pos += len;
+}
+
+/// Write a message, the metadata is padded so the body starts aligned, returns the metadata length.
+static uint32_t arrow_write_message(arrow_ipc_t *w, fb_t *fb, uint8_t const *body, size_t body_len)
+{
+    while ((8 + fb->len) % 8)
+        fb_reserve(fb, 1, 1);
+    uint8_t prefix[8];
+    arrow_put(prefix, ARROW_CONTINUATION, 4);
+    arrow_put(prefix + 4, fb->len, 4);
+    arrow_write(w, prefix, sizeof(prefix));
+    arrow_write(w, fb->buf, fb->len);
+    arrow_write(w, body, body_len);
+    return (uint32_t)(8 + fb->len);
+}
+
+arrow_ipc_t *arrow_ipc_create(FILE *file, arrow_column_t const *columns, unsigned num_columns)
+{
+    arrow_ipc_t *w = calloc(1, sizeof(*w));
+    if (!w) {
+        WARN_CALLOC("arrow_ipc_create()");
+        return NULL;
+    }
+    size_t names_len = 0;
+    for (unsigned i = 0; i < num_columns; ++i)
+        names_len += strlen(columns[i].name) + 1;
+    // the names are kept after the columns
+    w->columns = malloc(num_columns * sizeof(*w->columns) + names_len + 1);
+    if (!w->columns) {
+        WARN_MALLOC("arrow_ipc_create()");
+        free(w);
+        return NULL;
+    }
+    char *name = (char *)(w->columns + num_columns);
+    for (unsigned i = 0; i < num_columns; ++i) {
+        w->columns[i]      = columns[i];
+        w->columns[i].name = strcpy(name, columns[i].name);
+        name += strlen(name) + 1;
+    }
+    w->num_columns = num_columns;
+    w->file        = file;
+
+    arrow_write(w, ARROW_MAGIC, 8);
+    fb_t fb       = {0};
+    size_t header = fb_message(&fb, ARROW_HEADER_SCHEMA, 0);
+    fb_offset(&fb, header, fb_schema(&fb, w));
+    arrow_write_message(w, &fb, NULL, 0);
+    free(fb.buf);
+    return w;
+}
+
+/// Grow an array of value pairs of the body.
+static int body_grow(arrow_body_t *body, uint64_t **pairs, unsigned *size, unsigned len)
+{
+    if (len < *size)
+        return 0;
+    unsigned new_size = *size ? *size * 2 : 32;
+    uint64_t *p       = realloc(*pairs, 2 * new_size * sizeof(*p));
+    if (!p) {
+        WARN_REALLOC("arrow_body_buffer()");
+        body->failed = 1;
+        return -1;
+    }
+    *pairs = p;
+    *size  = new_size;
+    return 0;
+}
+
+void arrow_body_node(arrow_body_t *body, size_t length, size_t null_count)
+{
+    if (body_grow(body, &body->nodes, &body->nodes_size, body->num_nodes))
+        return;
+    body->nodes[2 * body->num_nodes]     = length;
+    body->nodes[2 * body->num_nodes + 1] = null_count;
+    body->num_nodes++;
+}
+
+uint8_t *arrow_body_buffer(arrow_body_t *body, size_t len)
+{
+    if (body_grow(body, &body->buffers, &body->buffers_size, body->num_buffers))
+        return NULL;
+    size_t padded = (len + 7) / 8 * 8;
+    if (body->len + padded > body->size) {
+        size_t size = body->size ? body->size : 65536;
+        while (body->len + padded > size)
+            size *= 2;
+        uint8_t *buf = realloc(body->buf, size);
+        if (!buf) {
+            WARN_REALLOC("arrow_body_buffer()");
+            body->failed = 1;
+            return NULL;
+        }
+        body->buf  = buf;
+        body->size = size;
+    }
+    body->buffers[2 * body->num_buffers]     = body->len;
+    body->buffers[2 * body->num_buffers + 1] = len;
+    body->num_buffers++;
+    uint8_t *p = body->buf + body->len;
+    memset(p, 0, padded);
+    body->len += padded;
+    return p;
+}
+
+void arrow_body_reset(arrow_body_t *body)
+{
+    body->len         = 0;
+    body->num_nodes   = 0;
+    body->num_buffers = 0;
+    body->failed      = 0;
+}
+
+void arrow_body_free(arrow_body_t *body)
+{
+    free(body->buf);
+    free(body->nodes);
+    free(body->buffers);
+    *body = (arrow_body_t){0};
+}
+
+void arrow_ipc_write_batch(arrow_ipc_t *w, size_t length, arrow_body_t const *body)
+{
+    if (body->failed) {
+        w->failed = 1;
+        return;
+    }
+    fb_t fb       = {0};
+    size_t header = fb_message(&fb, ARROW_HEADER_RECORD_BATCH, body->len);
+    // length, nodes, buffers
+    static uint8_t const sizes[] = {8, 4, 4};
+    size_t r[3];
+    fb_offset(&fb, header, fb_table(&fb, 3, sizes, r));
+    fb_put(&fb, r[0], length, 8);
+    size_t nodes = fb_vector(&fb, body->num_nodes, 16, 8);
+    fb_offset(&fb, r[1], nodes);
+    for (size_t i = 0; i < 2 * body->num_nodes; ++i)
+        fb_put(&fb, nodes + 4 + 8 * i, body->nodes[i], 8);
+    size_t buffers = fb_vector(&fb, body->num_buffers, 16, 8);
+    fb_offset(&fb, r[2], buffers);
+    for (size_t i = 0; i < 2 * body->num_buffers; ++i)
+        fb_put(&fb, buffers + 4 + 8 * i, body->buffers[i], 8);
+
+    arrow_block_t block = {.offset = w->pos, .body_len = body->len};
+    block.meta_len      = arrow_write_message(w, &fb, body->buf, body->len);
+    free(fb.buf);
+
+    if (w->blocks_len == w->blocks_size) {
+        unsigned size         = w->blocks_size ? w->blocks_size * 2 : 64;
+        arrow_block_t *blocks = realloc(w->blocks, size * sizeof(*blocks));
+        if (!blocks) {
+            WARN_REALLOC("arrow_ipc_write_batch()");
+            w->failed = 1;
+            return;
+        }
+        w->blocks      = blocks;
+        w->blocks_size = size;
+    }
+    w->blocks[w->blocks_len++] = block;
+}
+
+int arrow_ipc_close(arrow_ipc_t *w)
+{
+    if (!w)
+        return 0;
+
+    // the end-of-stream marker, then the footer with the schema and the blocks
+    uint8_t eos[8];
+    arrow_put(eos, ARROW_CONTINUATION, 4);
+    arrow_put(eos + 4, 0, 4);
+    arrow_write(w, eos, sizeof(eos));
+
+    fb_t fb = {0};
+    // version, schema, dictionaries, recordBatches
+    static uint8_t const sizes[] = {2, 4, 4, 4};
+    size_t f[4];
+    size_t root   = fb_reserve(&fb, 4, 4);
+    size_t footer = fb_table(&fb, 4, sizes, f);
+    fb_offset(&fb, root, footer);
+    fb_put(&fb, f[0], ARROW_METADATA_V5, 2);
+    fb_offset(&fb, f[1], fb_schema(&fb, w));
+    fb_offset(&fb, f[2], fb_vector(&fb, 0, 24, 8));
+    size_t blocks = fb_vector(&fb, w->blocks_len, 24, 8);
+    fb_offset(&fb, f[3], blocks);
+    for (unsigned i = 0; i < w->blocks_len; ++i) {
+        size_t pos = blocks + 4 + 24 * i;
+        fb_put(&fb, pos, w->blocks[i].offset, 8);
+        fb_put(&fb, pos + 8, w->blocks[i].meta_len, 4);
+        fb_put(&fb, pos + 16, w->blocks[i].body_len, 8);
+    }
+    arrow_write(w, fb.buf, fb.len);
+    uint8_t tail[10];
+    arrow_put(tail, fb.len, 4);
+    memcpy(tail + 4, "ARROW1", 6);
+    arrow_write(w, tail, sizeof(tail));
+    free(fb.buf);
+
+    if (!w->failed && fflush(w->file))
+        w->failed = 1;
+    int ret = w->failed ? -1 : 0;
+    free(w->blocks);
+    free(w->columns);
+    free(w);
+    return ret;
+}
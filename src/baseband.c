@@ -15,24 +15,41 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
+#include <time.h>
 
 #include "r_util.h"
+#include "fileformat.h"
 
-static uint16_t scaled_squares[256];
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASEBAND_HAVE_SSE2
+#define BASEBAND_HAVE_AVX2
+#define BASEBAND_TARGET(x) __attribute__((target(x)))
+#include <immintrin.h>
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BASEBAND_HAVE_SSE2
+#define BASEBAND_TARGET(x)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define BASEBAND_HAVE_NEON
+#include <arm_neon.h>
+#endif
 
-/// precalculate lookup table for envelope detection.
-static void calc_squares(void)
-{
-    if (scaled_squares[0])
-        return; // already initialized
-    int i;
-    for (i = 0; i < 256; i++)
-        scaled_squares[i] = (127 - i) * (127 - i);
-}
+/// lookup table for envelope detection, constant so any number of pipelines can share it.
+#define SQUARE1(i) (uint16_t)((127 - (i)) * (127 - (i)))
+#define SQUARE4(i) SQUARE1(i), SQUARE1(i + 1), SQUARE1(i + 2), SQUARE1(i + 3)
+#define SQUARE16(i) SQUARE4(i), SQUARE4(i + 4), SQUARE4(i + 8), SQUARE4(i + 12)
+#define SQUARE64(i) SQUARE16(i), SQUARE16(i + 16), SQUARE16(i + 32), SQUARE16(i + 48)
+static uint16_t const scaled_squares[256] = {SQUARE64(0), SQUARE64(64), SQUARE64(128), SQUARE64(192)};
+#undef SQUARE64
+#undef SQUARE16
+#undef SQUARE4
+#undef SQUARE1
 
 // This will give a noisy envelope of OOK/ASK signals.
 // Subtract the bias (-128) and get an envelope estimation.
-float envelope_detect(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+// Returns the sum of all envelope samples.
+static uint32_t envelope_detect_sum(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
     unsigned long i;
     uint32_t sum = 0;
@@ -40,7 +57,21 @@ float envelope_detect(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
         y_buf[i] = scaled_squares[iq_buf[2 * i ]] + scaled_squares[iq_buf[2 * i + 1]];
         sum += y_buf[i];
     }
-    return len > 0 && sum >= len ? AMP_TO_DB((float)sum / len) : AMP_TO_DB(1);
+    return sum;
+}
+
+/// Envelope with integer multiplies instead of the LUT, the output is identical.
+static uint32_t envelope_detect_mul_sum(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    unsigned long i;
+    uint32_t sum = 0;
+    for (i = 0; i < len; i++) {
+        int16_t x = 127 - iq_buf[2 * i];
+        int16_t y = 127 - iq_buf[2 * i + 1];
+        y_buf[i]  = x * x + y * y;
+        sum += y_buf[i];
+    }
+    return sum;
 }
 
 /// This will give a noisy envelope of OOK/ASK signals.
@@ -61,7 +92,7 @@ float envelope_detect_nolut(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len
 
 /// 122/128, 51/128 Magnitude Estimator for CU8 (SIMD has min/max).
 /// Note that magnitude emphasizes quiet signals / deemphasizes loud signals.
-float magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+static uint32_t magnitude_est_cu8_sum(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
     unsigned long i;
     uint32_t sum = 0;
@@ -74,7 +105,7 @@ float magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
         y_buf[i] = mag_est; // max 22144, fs 16384
         sum += y_buf[i];
     }
-    return len > 0 && sum >= len ? MAG_TO_DB((float)sum / len) : MAG_TO_DB(1);
+    return sum;
 }
 
 /// True Magnitude for CU8 (sqrt can SIMD but float is slow).
@@ -92,7 +123,7 @@ float magnitude_true_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 }
 
 /// 122/128, 51/128 Magnitude Estimator for CS16 (SIMD has min/max).
-float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+static uint32_t magnitude_est_cs16_sum(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 {
     unsigned long i;
     uint32_t sum = 0;
@@ -105,7 +136,7 @@ float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
         y_buf[i] = mag_est >> 8; // max 5668864, scaled 22144, fs 16384
         sum += y_buf[i];
     }
-    return len > 0 && sum >= len ? MAG_TO_DB((float)sum / len) : MAG_TO_DB(1);
+    return sum;
 }
 
 /// True Magnitude for CS16 (sqrt can SIMD but float is slow).
@@ -122,12 +153,818 @@ float magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
     return len > 0 && sum >= len ? MAG_TO_DB((float)sum / len) : MAG_TO_DB(1);
 }
 
+/// 122/128, 51/128 Magnitude Estimator for CF32, scaled to match the CS16 estimator.
+static uint32_t magnitude_est_cf32_sum(float const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    unsigned long i;
+    uint32_t sum = 0;
+    for (i = 0; i < len; i++) {
+        float x = fabsf(iq_buf[2 * i]);
+        float y = fabsf(iq_buf[2 * i + 1]);
+        float mi = x < y ? x : y;
+        float mx = x > y ? x : y;
+        float mag_est = (122.0f * mx + 51.0f * mi) * 128.0f; // fs 1.0 is Q0.15, i.e. 32768 / 256
+        y_buf[i] = mag_est < UINT16_MAX ? (uint16_t)mag_est : UINT16_MAX; // scaled 22144, fs 16384
+        sum += y_buf[i];
+    }
+    return sum;
+}
+
+/// Flip the sign bit to convert CS8 to CU8, the CU8 kernels then apply.
+static void cs8_to_cu8(int8_t const *cs8_buf, uint8_t *cu8_buf, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        cu8_buf[i] = (uint8_t)cs8_buf[i] ^ 0x80;
+    }
+}
+
+
+/// First order atan(r) approximation for r in [0, 1], max error 0.004 radians.
+#define ATAN_FAST_C1 0.273f
+/// Polynomial atan(r) approximation for r in [0, 1], in r^2, max error 1e-5 radians.
+#define ATAN_POLY_C0 0.99997726f
+#define ATAN_POLY_C1 -0.33262347f
+#define ATAN_POLY_C2 0.19354346f
+#define ATAN_POLY_C3 -0.11643287f
+#define ATAN_POLY_C4 0.05265332f
+#define ATAN_POLY_C5 -0.01172120f
+
+/// Branchless float atan2() approximation, the SIMD kernels follow the same order of operations.
+static float atan2_approx(float y, float x, int precise)
+{
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    float mx = ax > ay ? ax : ay;
+    float mi = ax > ay ? ay : ax;
+    float r  = mi / (mx > FLT_MIN ? mx : FLT_MIN);
+    float a;
+    if (precise) {
+        float s = r * r;
+        a = ATAN_POLY_C5 * s + ATAN_POLY_C4;
+        a = a * s + ATAN_POLY_C3;
+        a = a * s + ATAN_POLY_C2;
+        a = a * s + ATAN_POLY_C1;
+        a = a * s + ATAN_POLY_C0;
+        a = a * r;
+    } else {
+        a = r * ((float)M_PI_4 + ATAN_FAST_C1 * (1.0f - r));
+    }
+    a = ay > ax ? (float)M_PI_2 - a : a;
+    a = x < 0.0f ? (float)M_PI - a : a;
+    return y < 0.0f ? -a : a;
+}
+
+/** FM discriminator, phase difference angle of consecutive samples.
+
+    @param fi real values, len + 1 samples with the previous sample at index 0
+    @param fq imag values, len + 1 samples with the previous sample at index 0
+    @param[out] angle output angles in radians
+    @param len number of angles to output
+    @param precise use the polynomial instead of the first order atan2 approximation
+*/
+static void fm_angle_scalar(float const *fi, float const *fq, float *angle, uint32_t len, int precise)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        // Calculate phase difference vector: x[n] * conj(x[n-1])
+        float pr  = fi[i + 1] * fi[i] + fq[i + 1] * fq[i];
+        float pi  = fq[i + 1] * fi[i] - fi[i + 1] * fq[i];
+        angle[i] = atan2_approx(pi, pr, precise);
+    }
+}
+
+/* SIMD kernels, these need to be bit-identical to the scalar kernels above. */
+
+#ifdef BASEBAND_HAVE_SSE2
+BASEBAND_TARGET("sse2")
+static uint32_t hsum_epi32_sse2(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+/// Envelope detect for CU8, 8 samples per step.
+BASEBAND_TARGET("sse2")
+static uint32_t envelope_detect_sse2(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const bias = _mm_set1_epi16(127);
+    __m128i const flip32 = _mm_set1_epi32(0x8000);
+    __m128i const flip16 = _mm_set1_epi16((short)0x8000);
+    __m128i acc = zero;
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i iq = _mm_loadu_si128((__m128i const *)&iq_buf[2 * i]);
+        __m128i lo = _mm_sub_epi16(bias, _mm_unpacklo_epi8(iq, zero));
+        __m128i hi = _mm_sub_epi16(bias, _mm_unpackhi_epi8(iq, zero));
+        __m128i lo32 = _mm_madd_epi16(lo, lo); // I*I + Q*Q, max 32768
+        __m128i hi32 = _mm_madd_epi16(hi, hi);
+        acc = _mm_add_epi32(acc, _mm_add_epi32(lo32, hi32));
+        // there is no unsigned pack in SSE2, bias to the signed range and back
+        __m128i y = _mm_packs_epi32(_mm_sub_epi32(lo32, flip32), _mm_sub_epi32(hi32, flip32));
+        _mm_storeu_si128((__m128i *)&y_buf[i], _mm_xor_si128(y, flip16));
+    }
+    uint32_t sum = hsum_epi32_sse2(acc);
+    if (i < len)
+        sum += envelope_detect_sum(&iq_buf[2 * i], &y_buf[i], len - i);
+    return sum;
+}
+
+/// Magnitude estimate for CU8, 8 samples per step.
+BASEBAND_TARGET("sse2")
+static uint32_t magnitude_est_cu8_sse2(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const bias = _mm_set1_epi16(128);
+    __m128i const coef = _mm_set1_epi32(51 << 16 | 122); // mx * 122 + mi * 51
+    __m128i const even = _mm_set1_epi32(0xffff);
+    __m128i acc = zero;
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i iq = _mm_loadu_si128((__m128i const *)&iq_buf[2 * i]);
+        __m128i r[2];
+        r[0] = _mm_unpacklo_epi8(iq, zero);
+        r[1] = _mm_unpackhi_epi8(iq, zero);
+        for (int k = 0; k < 2; ++k) {
+            __m128i a = _mm_sub_epi16(r[k], bias);
+            a = _mm_max_epi16(a, _mm_sub_epi16(zero, a)); // abs
+            __m128i b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0xb1), 0xb1); // swap I/Q
+            __m128i mx = _mm_max_epi16(a, b);
+            __m128i mi = _mm_min_epi16(a, b);
+            __m128i mm = _mm_or_si128(_mm_and_si128(even, mx), _mm_andnot_si128(even, mi));
+            r[k] = _mm_madd_epi16(mm, coef); // max 22144
+        }
+        acc = _mm_add_epi32(acc, _mm_add_epi32(r[0], r[1]));
+        _mm_storeu_si128((__m128i *)&y_buf[i], _mm_packs_epi32(r[0], r[1]));
+    }
+    uint32_t sum = hsum_epi32_sse2(acc);
+    if (i < len)
+        sum += magnitude_est_cu8_sum(&iq_buf[2 * i], &y_buf[i], len - i);
+    return sum;
+}
+
+/// Magnitude estimate for CS16, 8 samples per step.
+BASEBAND_TARGET("sse2")
+static uint32_t magnitude_est_cs16_sse2(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    __m128i const flip = _mm_set1_epi16((short)0x8000);
+    __m128i const coef = _mm_set1_epi32(51 << 16 | 122); // mx * 122 + mi * 51
+    __m128i const unflip = _mm_set1_epi32(173 * 32768);
+    __m128i const even = _mm_set1_epi32(0xffff);
+    __m128i acc = _mm_setzero_si128();
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m128i r[2];
+        for (int k = 0; k < 2; ++k) {
+            __m128i v = _mm_loadu_si128((__m128i const *)&iq_buf[2 * i + 8 * k]);
+            __m128i s = _mm_srai_epi16(v, 15);
+            __m128i a = _mm_sub_epi16(_mm_xor_si128(v, s), s); // abs, unsigned 0..32768
+            // bias to signed to compare and multiply, i.e. a - 32768
+            a = _mm_xor_si128(a, flip);
+            __m128i b = _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0xb1), 0xb1); // swap I/Q
+            __m128i mx = _mm_max_epi16(a, b);
+            __m128i mi = _mm_min_epi16(a, b);
+            __m128i mm = _mm_or_si128(_mm_and_si128(even, mx), _mm_andnot_si128(even, mi));
+            r[k] = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(mm, coef), unflip), 8); // max 22144
+        }
+        acc = _mm_add_epi32(acc, _mm_add_epi32(r[0], r[1]));
+        _mm_storeu_si128((__m128i *)&y_buf[i], _mm_packs_epi32(r[0], r[1]));
+    }
+    uint32_t sum = hsum_epi32_sse2(acc);
+    if (i < len)
+        sum += magnitude_est_cs16_sum(&iq_buf[2 * i], &y_buf[i], len - i);
+    return sum;
+}
+/// Float atan2() approximation, 4 lanes, same order of operations as atan2_approx().
+BASEBAND_TARGET("sse2")
+static __m128 atan2_approx_sse2(__m128 y, __m128 x, int precise)
+{
+    __m128 const sign = _mm_set1_ps(-0.0f);
+    __m128 const zero = _mm_setzero_ps();
+    __m128 ax = _mm_andnot_ps(sign, x);
+    __m128 ay = _mm_andnot_ps(sign, y);
+    __m128 mx = _mm_max_ps(ax, ay);
+    __m128 mi = _mm_min_ps(ax, ay);
+    __m128 r  = _mm_div_ps(mi, _mm_max_ps(mx, _mm_set1_ps(FLT_MIN)));
+    __m128 a;
+    if (precise) {
+        __m128 s = _mm_mul_ps(r, r);
+        a = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ATAN_POLY_C5), s), _mm_set1_ps(ATAN_POLY_C4));
+        a = _mm_add_ps(_mm_mul_ps(a, s), _mm_set1_ps(ATAN_POLY_C3));
+        a = _mm_add_ps(_mm_mul_ps(a, s), _mm_set1_ps(ATAN_POLY_C2));
+        a = _mm_add_ps(_mm_mul_ps(a, s), _mm_set1_ps(ATAN_POLY_C1));
+        a = _mm_add_ps(_mm_mul_ps(a, s), _mm_set1_ps(ATAN_POLY_C0));
+        a = _mm_mul_ps(a, r);
+    } else {
+        __m128 t = _mm_mul_ps(_mm_set1_ps(ATAN_FAST_C1), _mm_sub_ps(_mm_set1_ps(1.0f), r));
+        a = _mm_mul_ps(r, _mm_add_ps(_mm_set1_ps((float)M_PI_4), t));
+    }
+    __m128 m = _mm_cmpgt_ps(ay, ax);
+    a = _mm_or_ps(_mm_and_ps(m, _mm_sub_ps(_mm_set1_ps((float)M_PI_2), a)), _mm_andnot_ps(m, a));
+    m = _mm_cmplt_ps(x, zero);
+    a = _mm_or_ps(_mm_and_ps(m, _mm_sub_ps(_mm_set1_ps((float)M_PI), a)), _mm_andnot_ps(m, a));
+    m = _mm_cmplt_ps(y, zero);
+    return _mm_xor_ps(a, _mm_and_ps(m, sign));
+}
+
+/// FM discriminator, 4 samples per step.
+BASEBAND_TARGET("sse2")
+static void fm_angle_sse2(float const *fi, float const *fq, float *angle, uint32_t len, int precise)
+{
+    uint32_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        __m128 x1r = _mm_loadu_ps(&fi[i]);
+        __m128 x1i = _mm_loadu_ps(&fq[i]);
+        __m128 x0r = _mm_loadu_ps(&fi[i + 1]);
+        __m128 x0i = _mm_loadu_ps(&fq[i + 1]);
+        __m128 pr  = _mm_add_ps(_mm_mul_ps(x0r, x1r), _mm_mul_ps(x0i, x1i));
+        __m128 pi  = _mm_sub_ps(_mm_mul_ps(x0i, x1r), _mm_mul_ps(x0r, x1i));
+        _mm_storeu_ps(&angle[i], atan2_approx_sse2(pi, pr, precise));
+    }
+    if (i < len)
+        fm_angle_scalar(&fi[i], &fq[i], &angle[i], len - i, precise);
+}
+#endif /* BASEBAND_HAVE_SSE2 */
+
+#ifdef BASEBAND_HAVE_AVX2
+BASEBAND_TARGET("avx2")
+static uint32_t hsum_epi32_avx2(__m256i v)
+{
+    __m128i x = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(x);
+}
+
+/// Envelope detect for CU8, 16 samples per step.
+/// Note that unpack and pack both work per 128-bit lane, the sample order is retained.
+BASEBAND_TARGET("avx2")
+static uint32_t envelope_detect_avx2(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const bias = _mm256_set1_epi16(127);
+    __m256i acc = zero;
+    uint32_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i iq = _mm256_loadu_si256((__m256i const *)&iq_buf[2 * i]);
+        __m256i lo = _mm256_sub_epi16(bias, _mm256_unpacklo_epi8(iq, zero));
+        __m256i hi = _mm256_sub_epi16(bias, _mm256_unpackhi_epi8(iq, zero));
+        __m256i lo32 = _mm256_madd_epi16(lo, lo); // I*I + Q*Q, max 32768
+        __m256i hi32 = _mm256_madd_epi16(hi, hi);
+        acc = _mm256_add_epi32(acc, _mm256_add_epi32(lo32, hi32));
+        _mm256_storeu_si256((__m256i *)&y_buf[i], _mm256_packus_epi32(lo32, hi32));
+    }
+    uint32_t sum = hsum_epi32_avx2(acc);
+    if (i < len)
+        sum += envelope_detect_sum(&iq_buf[2 * i], &y_buf[i], len - i);
+    return sum;
+}
+
+/// Magnitude estimate for CU8, 16 samples per step.
+BASEBAND_TARGET("avx2")
+static uint32_t magnitude_est_cu8_avx2(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    __m256i const zero = _mm256_setzero_si256();
+    __m256i const bias = _mm256_set1_epi16(128);
+    __m256i const coef = _mm256_set1_epi32(51 << 16 | 122); // mx * 122 + mi * 51
+    __m256i acc = zero;
+    uint32_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i iq = _mm256_loadu_si256((__m256i const *)&iq_buf[2 * i]);
+        __m256i r[2];
+        r[0] = _mm256_unpacklo_epi8(iq, zero);
+        r[1] = _mm256_unpackhi_epi8(iq, zero);
+        for (int k = 0; k < 2; ++k) {
+            __m256i a = _mm256_abs_epi16(_mm256_sub_epi16(r[k], bias));
+            __m256i b = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(a, 0xb1), 0xb1); // swap I/Q
+            __m256i mm = _mm256_blend_epi16(_mm256_max_epi16(a, b), _mm256_min_epi16(a, b), 0xaa);
+            r[k] = _mm256_madd_epi16(mm, coef); // max 22144
+        }
+        acc = _mm256_add_epi32(acc, _mm256_add_epi32(r[0], r[1]));
+        _mm256_storeu_si256((__m256i *)&y_buf[i], _mm256_packs_epi32(r[0], r[1]));
+    }
+    uint32_t sum = hsum_epi32_avx2(acc);
+    if (i < len)
+        sum += magnitude_est_cu8_sum(&iq_buf[2 * i], &y_buf[i], len - i);
+    return sum;
+}
+
+/// Magnitude estimate for CS16, 16 samples per step.
+BASEBAND_TARGET("avx2")
+static uint32_t magnitude_est_cs16_avx2(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    __m256i const flip = _mm256_set1_epi16((short)0x8000);
+    __m256i const coef = _mm256_set1_epi32(51 << 16 | 122); // mx * 122 + mi * 51
+    __m256i const unflip = _mm256_set1_epi32(173 * 32768);
+    __m256i acc = _mm256_setzero_si256();
+    uint32_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m256i r[2];
+        for (int k = 0; k < 2; ++k) {
+            __m256i v = _mm256_loadu_si256((__m256i const *)&iq_buf[2 * i + 16 * k]);
+            // abs, unsigned 0..32768, then bias to signed to compare and multiply, i.e. a - 32768
+            __m256i a = _mm256_xor_si256(_mm256_abs_epi16(v), flip);
+            __m256i b = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(a, 0xb1), 0xb1); // swap I/Q
+            __m256i mm = _mm256_blend_epi16(_mm256_max_epi16(a, b), _mm256_min_epi16(a, b), 0xaa);
+            r[k] = _mm256_srli_epi32(_mm256_add_epi32(_mm256_madd_epi16(mm, coef), unflip), 8); // max 22144
+        }
+        acc = _mm256_add_epi32(acc, _mm256_add_epi32(r[0], r[1]));
+        // pack works per 128-bit lane, restore the sample order
+        __m256i y = _mm256_permute4x64_epi64(_mm256_packs_epi32(r[0], r[1]), _MM_SHUFFLE(3, 1, 2, 0));
+        _mm256_storeu_si256((__m256i *)&y_buf[i], y);
+    }
+    uint32_t sum = hsum_epi32_avx2(acc);
+    if (i < len)
+        sum += magnitude_est_cs16_sum(&iq_buf[2 * i], &y_buf[i], len - i);
+    return sum;
+}
+/// Float atan2() approximation, 8 lanes, same order of operations as atan2_approx().
+BASEBAND_TARGET("avx2")
+static __m256 atan2_approx_avx2(__m256 y, __m256 x, int precise)
+{
+    __m256 const sign = _mm256_set1_ps(-0.0f);
+    __m256 const zero = _mm256_setzero_ps();
+    __m256 ax = _mm256_andnot_ps(sign, x);
+    __m256 ay = _mm256_andnot_ps(sign, y);
+    __m256 mx = _mm256_max_ps(ax, ay);
+    __m256 mi = _mm256_min_ps(ax, ay);
+    __m256 r  = _mm256_div_ps(mi, _mm256_max_ps(mx, _mm256_set1_ps(FLT_MIN)));
+    __m256 a;
+    if (precise) {
+        __m256 s = _mm256_mul_ps(r, r);
+        a = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(ATAN_POLY_C5), s), _mm256_set1_ps(ATAN_POLY_C4));
+        a = _mm256_add_ps(_mm256_mul_ps(a, s), _mm256_set1_ps(ATAN_POLY_C3));
+        a = _mm256_add_ps(_mm256_mul_ps(a, s), _mm256_set1_ps(ATAN_POLY_C2));
+        a = _mm256_add_ps(_mm256_mul_ps(a, s), _mm256_set1_ps(ATAN_POLY_C1));
+        a = _mm256_add_ps(_mm256_mul_ps(a, s), _mm256_set1_ps(ATAN_POLY_C0));
+        a = _mm256_mul_ps(a, r);
+    } else {
+        __m256 t = _mm256_mul_ps(_mm256_set1_ps(ATAN_FAST_C1), _mm256_sub_ps(_mm256_set1_ps(1.0f), r));
+        a = _mm256_mul_ps(r, _mm256_add_ps(_mm256_set1_ps((float)M_PI_4), t));
+    }
+    a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps((float)M_PI_2), a), _mm256_cmp_ps(ay, ax, _CMP_GT_OQ));
+    a = _mm256_blendv_ps(a, _mm256_sub_ps(_mm256_set1_ps((float)M_PI), a), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+    return _mm256_xor_ps(a, _mm256_and_ps(_mm256_cmp_ps(y, zero, _CMP_LT_OQ), sign));
+}
+
+/// FM discriminator, 8 samples per step.
+BASEBAND_TARGET("avx2")
+static void fm_angle_avx2(float const *fi, float const *fq, float *angle, uint32_t len, int precise)
+{
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        __m256 x1r = _mm256_loadu_ps(&fi[i]);
+        __m256 x1i = _mm256_loadu_ps(&fq[i]);
+        __m256 x0r = _mm256_loadu_ps(&fi[i + 1]);
+        __m256 x0i = _mm256_loadu_ps(&fq[i + 1]);
+        __m256 pr  = _mm256_add_ps(_mm256_mul_ps(x0r, x1r), _mm256_mul_ps(x0i, x1i));
+        __m256 pi  = _mm256_sub_ps(_mm256_mul_ps(x0i, x1r), _mm256_mul_ps(x0r, x1i));
+        _mm256_storeu_ps(&angle[i], atan2_approx_avx2(pi, pr, precise));
+    }
+    if (i < len)
+        fm_angle_scalar(&fi[i], &fq[i], &angle[i], len - i, precise);
+}
+#endif /* BASEBAND_HAVE_AVX2 */
+
+#ifdef BASEBAND_HAVE_NEON
+/// Envelope detect for CU8, 8 samples per step.
+static uint32_t envelope_detect_neon(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    int16x8_t const bias = vdupq_n_s16(127);
+    uint32x4_t acc = vdupq_n_u32(0);
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint8x8x2_t iq = vld2_u8(&iq_buf[2 * i]);
+        int16x8_t x = vsubq_s16(bias, vreinterpretq_s16_u16(vmovl_u8(iq.val[0])));
+        int16x8_t y = vsubq_s16(bias, vreinterpretq_s16_u16(vmovl_u8(iq.val[1])));
+        // each square is at most 16384, the sum is at most 32768
+        uint16x8_t e = vaddq_u16(vreinterpretq_u16_s16(vmulq_s16(x, x)), vreinterpretq_u16_s16(vmulq_s16(y, y)));
+        acc = vpadalq_u16(acc, e);
+        vst1q_u16(&y_buf[i], e);
+    }
+    uint32_t lanes[4];
+    vst1q_u32(lanes, acc);
+    uint32_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    if (i < len)
+        sum += envelope_detect_sum(&iq_buf[2 * i], &y_buf[i], len - i);
+    return sum;
+}
+
+/// Magnitude estimate for CU8, 8 samples per step.
+static uint32_t magnitude_est_cu8_neon(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    uint8x8_t const bias = vdup_n_u8(128);
+    uint32x4_t acc = vdupq_n_u32(0);
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint8x8x2_t iq = vld2_u8(&iq_buf[2 * i]);
+        uint16x8_t x = vabdl_u8(iq.val[0], bias);
+        uint16x8_t y = vabdl_u8(iq.val[1], bias);
+        uint16x8_t mx = vmaxq_u16(x, y);
+        uint16x8_t mi = vminq_u16(x, y);
+        uint16x8_t m = vmlaq_n_u16(vmulq_n_u16(mx, 122), mi, 51); // max 22144
+        acc = vpadalq_u16(acc, m);
+        vst1q_u16(&y_buf[i], m);
+    }
+    uint32_t lanes[4];
+    vst1q_u32(lanes, acc);
+    uint32_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    if (i < len)
+        sum += magnitude_est_cu8_sum(&iq_buf[2 * i], &y_buf[i], len - i);
+    return sum;
+}
+
+/// Magnitude estimate for CS16, 8 samples per step.
+static uint32_t magnitude_est_cs16_neon(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    uint32x4_t acc = vdupq_n_u32(0);
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        int16x8x2_t iq = vld2q_s16(&iq_buf[2 * i]);
+        // vabs wraps -32768 to 0x8000, which is the wanted 32768 as unsigned
+        uint16x8_t x = vreinterpretq_u16_s16(vabsq_s16(iq.val[0]));
+        uint16x8_t y = vreinterpretq_u16_s16(vabsq_s16(iq.val[1]));
+        uint16x8_t mx = vmaxq_u16(x, y);
+        uint16x8_t mi = vminq_u16(x, y);
+        uint32x4_t lo = vmlal_n_u16(vmull_n_u16(vget_low_u16(mx), 122), vget_low_u16(mi), 51);
+        uint32x4_t hi = vmlal_n_u16(vmull_n_u16(vget_high_u16(mx), 122), vget_high_u16(mi), 51);
+        uint16x8_t m = vcombine_u16(vshrn_n_u32(lo, 8), vshrn_n_u32(hi, 8)); // max 22144
+        acc = vpadalq_u16(acc, m);
+        vst1q_u16(&y_buf[i], m);
+    }
+    uint32_t lanes[4];
+    vst1q_u32(lanes, acc);
+    uint32_t sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    if (i < len)
+        sum += magnitude_est_cs16_sum(&iq_buf[2 * i], &y_buf[i], len - i);
+    return sum;
+}
+#endif /* BASEBAND_HAVE_NEON */
+
+/* Runtime dispatch */
+
+// kernels return the sum of all output samples
+typedef uint32_t (*envelope_cu8_fn)(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+typedef uint32_t (*envelope_cs16_fn)(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len);
+typedef void (*fm_angle_fn)(float const *fi, float const *fq, float *angle, uint32_t len, int precise);
+
+static envelope_cu8_fn envelope_detect_impl    = envelope_detect_sum;
+static envelope_cu8_fn magnitude_est_cu8_impl  = magnitude_est_cu8_sum;
+static envelope_cs16_fn magnitude_est_cs16_impl = magnitude_est_cs16_sum;
+static fm_angle_fn fm_angle_impl                = fm_angle_scalar;
+static envelope_cu8_fn envelope_detect_simd   = NULL; // the envelope kernel of the SIMD level
+static int baseband_simd_level = BASEBAND_SIMD_NONE;
+static int baseband_envelope   = BASEBAND_ENVELOPE_LUT; // the requested envelope kernel
+static int baseband_envelope_active = BASEBAND_ENVELOPE_LUT; // differs if SIMD is requested but the level is scalar
+
+static float sum_to_amp_db(uint32_t sum, uint32_t len)
+{
+    return len > 0 && sum >= len ? AMP_TO_DB((float)sum / len) : AMP_TO_DB(1);
+}
+
+static float sum_to_mag_db(uint32_t sum, uint32_t len)
+{
+    return len > 0 && sum >= len ? MAG_TO_DB((float)sum / len) : MAG_TO_DB(1);
+}
+
+float envelope_detect(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return sum_to_amp_db(envelope_detect_impl(iq_buf, y_buf, len), len);
+}
+
+float magnitude_est_cu8(uint8_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return sum_to_mag_db(magnitude_est_cu8_impl(iq_buf, y_buf, len), len);
+}
+
+float magnitude_est_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return sum_to_mag_db(magnitude_est_cs16_impl(iq_buf, y_buf, len), len);
+}
+
+float magnitude_est_cf32(float const *iq_buf, uint16_t *y_buf, uint32_t len)
+{
+    return sum_to_mag_db(magnitude_est_cf32_sum(iq_buf, y_buf, len), len);
+}
+
+/// Check if the CPU supports a SIMD level.
+static int baseband_simd_supported(int level)
+{
+    switch (level) {
+    case BASEBAND_SIMD_NONE:
+        return 1;
+#ifdef BASEBAND_HAVE_SSE2
+    case BASEBAND_SIMD_SSE2:
+#if defined(__GNUC__)
+        return __builtin_cpu_supports("sse2");
+#else
+        return 1;
+#endif
+#endif
+#ifdef BASEBAND_HAVE_AVX2
+    case BASEBAND_SIMD_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#ifdef BASEBAND_HAVE_NEON
+    case BASEBAND_SIMD_NEON:
+        return 1; // compile-time only, NEON is mandatory on the targets that define __ARM_NEON
+#endif
+    default:
+        return 0;
+    }
+}
+
+int baseband_set_simd(int level)
+{
+    if (level < 0) {
+        // auto select the best level
+        for (level = BASEBAND_SIMD_END - 1; level > BASEBAND_SIMD_NONE; --level) {
+            if (baseband_simd_supported(level))
+                break;
+        }
+    }
+    if (!baseband_simd_supported(level)) {
+        return -1;
+    }
+
+    envelope_detect_simd    = NULL;
+    magnitude_est_cu8_impl  = magnitude_est_cu8_sum;
+    magnitude_est_cs16_impl = magnitude_est_cs16_sum;
+    fm_angle_impl           = fm_angle_scalar;
+#ifdef BASEBAND_HAVE_SSE2
+    if (level == BASEBAND_SIMD_SSE2) {
+        envelope_detect_simd    = envelope_detect_sse2;
+        magnitude_est_cu8_impl  = magnitude_est_cu8_sse2;
+        magnitude_est_cs16_impl = magnitude_est_cs16_sse2;
+        fm_angle_impl           = fm_angle_sse2;
+    }
+#endif
+#ifdef BASEBAND_HAVE_AVX2
+    if (level == BASEBAND_SIMD_AVX2) {
+        envelope_detect_simd    = envelope_detect_avx2;
+        magnitude_est_cu8_impl  = magnitude_est_cu8_avx2;
+        magnitude_est_cs16_impl = magnitude_est_cs16_avx2;
+        fm_angle_impl           = fm_angle_avx2;
+    }
+#endif
+#ifdef BASEBAND_HAVE_NEON
+    if (level == BASEBAND_SIMD_NEON) {
+        envelope_detect_simd    = envelope_detect_neon;
+        magnitude_est_cu8_impl  = magnitude_est_cu8_neon;
+        magnitude_est_cs16_impl = magnitude_est_cs16_neon;
+    }
+#endif
+    baseband_simd_level = level;
+    if (baseband_set_envelope(baseband_envelope) < 0) {
+        envelope_detect_impl     = envelope_detect_sum;
+        baseband_envelope_active = BASEBAND_ENVELOPE_LUT;
+    }
+    return level;
+}
+
+int baseband_get_simd(void)
+{
+    return baseband_simd_level;
+}
+
+char const *baseband_simd_str(int level)
+{
+    switch (level) {
+    case BASEBAND_SIMD_NONE: return "scalar";
+    case BASEBAND_SIMD_SSE2: return "SSE2";
+    case BASEBAND_SIMD_AVX2: return "AVX2";
+    case BASEBAND_SIMD_NEON: return "NEON";
+    default: return "unknown";
+    }
+}
+
+/// Time each envelope kernel on a small buffer that stays in L1, return the fastest.
+static int baseband_calibrate_envelope(void)
+{
+    enum { N = 4096, REPS = 64 };
+    uint8_t iq_buf[2 * N];
+    uint16_t y_buf[N];
+    uint32_t lcg = 1;
+    for (unsigned i = 0; i < 2 * N; i++) {
+        lcg       = lcg * 1664525 + 1013904223;
+        iq_buf[i] = lcg >> 24;
+    }
+
+    int best         = BASEBAND_ENVELOPE_LUT;
+    clock_t best_clk = -1;
+    // on ties (coarse clocks) prefer the computed kernels
+    for (int kernel = BASEBAND_ENVELOPE_END - 1; kernel >= BASEBAND_ENVELOPE_LUT; --kernel) {
+        if (baseband_set_envelope(kernel) != kernel)
+            continue;
+        envelope_detect_impl(iq_buf, y_buf, N); // warm up
+        clock_t start = clock();
+        for (int r = 0; r < REPS; r++)
+            envelope_detect_impl(iq_buf, y_buf, N);
+        clock_t elapsed = clock() - start;
+        if (best_clk < 0 || elapsed < best_clk) {
+            best     = kernel;
+            best_clk = elapsed;
+        }
+    }
+    return best;
+}
+
+int baseband_set_envelope(int kernel)
+{
+    if (kernel < 0) {
+        kernel = baseband_calibrate_envelope();
+    }
+    if (kernel == BASEBAND_ENVELOPE_LUT) {
+        envelope_detect_impl = envelope_detect_sum;
+    }
+    else if (kernel == BASEBAND_ENVELOPE_MUL) {
+        envelope_detect_impl = envelope_detect_mul_sum;
+    }
+    else if (kernel == BASEBAND_ENVELOPE_SIMD && envelope_detect_simd) {
+        envelope_detect_impl = envelope_detect_simd;
+    }
+    else {
+        return -1;
+    }
+    baseband_envelope        = kernel;
+    baseband_envelope_active = kernel;
+    return kernel;
+}
+
+int baseband_get_envelope(void)
+{
+    return baseband_envelope_active;
+}
+
+char const *baseband_envelope_str(int kernel)
+{
+    switch (kernel) {
+    case BASEBAND_ENVELOPE_LUT: return "lut";
+    case BASEBAND_ENVELOPE_MUL: return "mul";
+    case BASEBAND_ENVELOPE_SIMD: return "simd";
+    default: return "unknown";
+    }
+}
+
+
+/// Correction coeffs fixed-point scale, the gains are limited to keep the products in 32 bit.
+#define IQ_CORRECT_SCALE 20
+/// Samples per tile, the tile sums of squares fit in 32 bit.
+#define IQ_CORRECT_TILE 4096
+
+void baseband_iq_correct_cu8(uint8_t const *iq_buf, uint8_t *out_buf, uint32_t len, iq_correct_state_t *state)
+{
+    if (!len)
+        return;
+
+    // Block statistics of the raw samples, in tiles to keep the accumulators in 32 bit
+    uint64_t sum_i = 0, sum_q = 0, sum_ii = 0, sum_qq = 0, sum_iq = 0;
+    for (uint32_t t = 0; t < len; t += IQ_CORRECT_TILE) {
+        uint32_t end = len - t < IQ_CORRECT_TILE ? len : t + IQ_CORRECT_TILE;
+        uint32_t ti = 0, tq = 0, tii = 0, tqq = 0, tiq = 0;
+        for (uint32_t n = t; n < end; n++) {
+            uint32_t x = iq_buf[2 * n];
+            uint32_t y = iq_buf[2 * n + 1];
+            ti += x;
+            tq += y;
+            tii += x * x;
+            tqq += y * y;
+            tiq += x * y;
+        }
+        sum_i += ti;
+        sum_q += tq;
+        sum_ii += tii;
+        sum_qq += tqq;
+        sum_iq += tiq;
+    }
+    float dc_i   = (float)sum_i / len;
+    float dc_q   = (float)sum_q / len;
+    float pow_i  = (float)sum_ii / len - dc_i * dc_i;
+    float pow_q  = (float)sum_qq / len - dc_q * dc_q;
+    float pow_iq = (float)sum_iq / len - dc_i * dc_q;
+
+    // Running estimates, settle over about 8 buffers
+    if (!state->init) {
+        state->dc_i   = dc_i;
+        state->dc_q   = dc_q;
+        state->pow_i  = pow_i;
+        state->pow_q  = pow_q;
+        state->pow_iq = pow_iq;
+        state->init   = 1;
+    }
+    else {
+        state->dc_i   += (dc_i - state->dc_i) / 8;
+        state->dc_q   += (dc_q - state->dc_q) / 8;
+        state->pow_i  += (pow_i - state->pow_i) / 8;
+        state->pow_q  += (pow_q - state->pow_q) / 8;
+        state->pow_iq += (pow_iq - state->pow_iq) / 8;
+    }
+
+    // Orthogonalize Q against I, then match the Q power to the I power
+    float phase = 0.0f;
+    float gain  = 1.0f;
+    if (state->pow_i > 0.0f) {
+        phase        = state->pow_iq / state->pow_i;
+        float pow_q2 = state->pow_q - phase * state->pow_iq;
+        if (pow_q2 > 0.0f)
+            gain = sqrtf(state->pow_i / pow_q2);
+    }
+    phase = phase < -0.5f ? -0.5f : phase > 0.5f ? 0.5f : phase;
+    gain  = gain < 0.5f ? 0.5f : gain > 2.0f ? 2.0f : gain;
+
+    // out_i = i - dc_i + 128, out_q = gain * ((q - dc_q) - phase * (i - dc_i)) + 128
+    int32_t const one = 1 << IQ_CORRECT_SCALE;
+    int32_t a_q = (int32_t)(gain * one);
+    int32_t b_q = (int32_t)(gain * phase * one);
+    int32_t c_i = (int32_t)((128.0f - state->dc_i) * one) + one / 2;
+    int32_t c_q = (int32_t)((128.0f - gain * (state->dc_q - phase * state->dc_i)) * one) + one / 2;
+    int32_t const max = 255 << IQ_CORRECT_SCALE;
+    for (uint32_t n = 0; n < len; n++) {
+        int32_t x = iq_buf[2 * n];
+        int32_t y = iq_buf[2 * n + 1];
+        int32_t u = x * one + c_i;
+        int32_t v = y * a_q - x * b_q + c_q;
+        u = u < 0 ? 0 : u > max ? max : u;
+        v = v < 0 ? 0 : v > max ? max : v;
+        out_buf[2 * n]     = u >> IQ_CORRECT_SCALE;
+        out_buf[2 * n + 1] = v >> IQ_CORRECT_SCALE;
+    }
+}
+
 
 // Fixed-point arithmetic on Q0.15
 #define F_SCALE 15
 #define S_CONST (1 << F_SCALE)
 #define FIX(x) ((int)(x * S_CONST))
 
+void baseband_low_pass_set_rate(filter_state_t *state, uint32_t samp_rate)
+{
+    if (state->rate == samp_rate)
+        return;
+    state->rate = samp_rate;
+
+    int order = state->order;
+    // order 1 keeps the fixed filter, unless a cutoff is given
+    if (order < 1 || (order == 1 && state->cutoff <= 0.0f)) {
+        state->sections = 0;
+        return;
+    }
+    if (order > 2 * FILTER_MAX_SECTIONS)
+        order = 2 * FILTER_MAX_SECTIONS;
+
+    double cutoff = state->cutoff > 0.0f ? state->cutoff : 0.025 * samp_rate;
+    if (cutoff > 0.45 * samp_rate)
+        cutoff = 0.45 * samp_rate;
+    double w0 = 2.0 * M_PI * cutoff / samp_rate;
+    double cw = cos(w0);
+    int s     = 0;
+    // a pole pair for each biquad, Q = 1 / (2 sin((2k + 1) pi / (2 order)))
+    for (int k = 0; k < order / 2; ++k, ++s) {
+        double q     = 1.0 / (2.0 * sin((2 * k + 1) * M_PI / (2 * order)));
+        double alpha = sin(w0) / (2.0 * q);
+        double a0    = 1.0 + alpha;
+        state->b[s][0] = (1.0 - cw) / 2.0 / a0;
+        state->b[s][1] = (1.0 - cw) / a0;
+        state->b[s][2] = (1.0 - cw) / 2.0 / a0;
+        state->a[s][0] = -2.0 * cw / a0;
+        state->a[s][1] = (1.0 - alpha) / a0;
+    }
+    // odd orders have a real pole, a 1st order section
+    if (order % 2) {
+        double t = tan(w0 / 2.0);
+        state->b[s][0] = t / (1.0 + t);
+        state->b[s][1] = t / (1.0 + t);
+        state->b[s][2] = 0.0f;
+        state->a[s][0] = (t - 1.0) / (t + 1.0);
+        state->a[s][1] = 0.0f;
+        s++;
+    }
+    state->sections = s;
+    fprintf(stderr, "%s: order %d Butterworth low pass filter for %u Hz at cutoff %.0f Hz\n", __func__,
+            order, samp_rate, cutoff);
+}
+
+/// Butterworth biquad cascade, transposed direct form II.
+static void low_pass_biquads(uint16_t const *x_buf, int16_t *y_buf, uint32_t len, filter_state_t *state)
+{
+    int sections = state->sections;
+    float z[FILTER_MAX_SECTIONS][2];
+    memcpy(z, state->z, sizeof(z));
+    for (uint32_t i = 0; i < len; i++) {
+        float v = x_buf[i];
+        for (int s = 0; s < sections; s++) {
+            float const *b = state->b[s];
+            float const *a = state->a[s];
+            float y    = b[0] * v + z[s][0];
+            z[s][0]    = b[1] * v - a[0] * y + z[s][1];
+            z[s][1]    = b[2] * v - a[1] * y;
+            v          = y;
+        }
+        y_buf[i] = v >= INT16_MAX ? INT16_MAX : v <= INT16_MIN ? INT16_MIN : (int16_t)lrintf(v);
+    }
+    memcpy(state->z, z, sizeof(z));
+}
+
 /** Something that might look like a IIR lowpass filter.
 
     [b,a] = butter(1, Wc) # low pass filter with cutoff pi*Wc radians
@@ -139,6 +976,11 @@ float magnitude_true_cs16(int16_t const *iq_buf, uint16_t *y_buf, uint32_t len)
 */
 void baseband_low_pass_filter(uint16_t const *x_buf, int16_t *y_buf, uint32_t len, filter_state_t *state)
 {
+    if (state->sections) {
+        low_pass_biquads(x_buf, y_buf, len, state);
+        return;
+    }
+
     ///  [b,a] = butter(1, 0.01) -> 3x tau (95%) ~100 samples
     //static int const a[FILTER_ORDER + 1] = {FIX(1.00000) >> 1, FIX(0.96907) >> 1};
     //static int const b[FILTER_ORDER + 1] = {FIX(0.015466) >> 1, FIX(0.015466) >> 1};
@@ -159,11 +1001,53 @@ void baseband_low_pass_filter(uint16_t const *x_buf, int16_t *y_buf, uint32_t le
     }
 
     // Save last samples
-    memcpy(state->x, &x_buf[len - FILTER_ORDER], FILTER_ORDER * sizeof (int16_t));
+    memcpy(state->x, &x_buf[len - FILTER_ORDER], FILTER_ORDER * sizeof (uint16_t));
     memcpy(state->y, &y_buf[len - FILTER_ORDER], FILTER_ORDER * sizeof (int16_t));
 }
 
 
+/// The exponent and top 4 mantissa bits of 16.0f less 16, the codes of the levels 16 to 31 are the levels.
+#define ENVELOPE_8BIT_BIAS ((127 + 3) << 4)
+
+void baseband_envelope_8bit(int16_t const *am_buf, uint8_t *am8_buf, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++) {
+        int32_t x = am_buf[i];
+        // the exponent and the top 4 bits of the mantissa, exact as int16 levels are exact floats
+        float f = (float)x;
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        int32_t log  = (int32_t)(bits >> 19) - ENVELOPE_8BIT_BIAS;
+        int32_t lin  = x & ~(x >> 31); // negative levels are 0
+        int32_t mask = -(x >= 16);
+        am8_buf[i]   = (uint8_t)((log & mask) | (lin & ~mask));
+    }
+}
+
+int envelope_8bit_code(int level)
+{
+    int16_t x = level < INT16_MIN ? INT16_MIN : level > INT16_MAX ? INT16_MAX : level;
+    uint8_t code;
+    baseband_envelope_8bit(&x, &code, 1);
+    return code;
+}
+
+int envelope_8bit_min(int code)
+{
+    if (code < 32)
+        return code ? code : INT16_MIN;
+    int shift = code / 16 - 1;
+    return (code - 16 * shift) << shift;
+}
+
+int envelope_8bit_max(int code)
+{
+    if (code < 32)
+        return code;
+    int shift = code / 16 - 1;
+    return ((code - 16 * shift + 1) << shift) - 1;
+}
+
 /** Integer implementation of atan2() with int16_t normalized output.
 
     Returns arc tangent of y/x across all quadrants in radians.
@@ -196,6 +1080,9 @@ static int16_t atan2_int16(int32_t y, int32_t x)
     return angle;
 }
 
+/// Samples per block for the float FM discriminators.
+#define FM_BLOCK_LEN 256
+
 /// Fast Instantaneous frequency and Low Pass filter, CU8 samples
 void baseband_demod_FM(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state)
 {
@@ -229,29 +1116,55 @@ void baseband_demod_FM(uint8_t const *x_buf, int16_t *y_buf, unsigned long num_s
     int16_t x0f = state->xf; // Instantaneous frequency
     int16_t y0f = state->yf; // Instantaneous frequency, low pass filtered
 
-    for (unsigned n = 0; n < num_samples; n++) {
-        int16_t x1r, x1i; // Old IQ sample: x[n-1]
-        int16_t x1f, y1f; // Instantaneous frequency, old sample
-        int32_t pr, pi;   // Phase difference vector
-
-        // delay old sample
-        x1r = x0r;
-        x1i = x0i;
-        y1f = y0f;
-        x1f = x0f;
-        // get new sample
-        x0r = *x_buf++ - 128;
-        x0i = *x_buf++ - 128;
-        // Calculate phase difference vector: x[n] * conj(x[n-1])
-        pr = x0r * x1r + x0i * x1i; // May exactly overflow an int16_t (-128*-128 + -128*-128)
-        pi = x0i * x1r - x0r * x1i;
-        // xlp = (int16_t)((atan2f(pi, pr) / M_PI) * INT16_MAX); // Floating point implementation
-        x0f = atan2_int16(pi, pr); // Integer implementation
-        // xlp = pi; // Cheat and use only imaginary part (works OK, but is amplitude sensitive)
-        // Low pass filter
-        // y0f      = ((alp[1] * y1f >> 1) + (blp[0] * x0f >> 1) + (blp[1] * x1f >> 1)) >> (F_SCALE - 1);
-        y0f      = (alp[1] * y1f + blp[0] * (x0f + x1f)) >> (F_SCALE - 1); // note: prescaled, blp[0]==blp[1]
-        *y_buf++ = y0f;
+    if (state->mode != BASEBAND_FM_INT) {
+        // Block-wise: vectorized discriminator, then the (serial) low pass filter
+        float fi[FM_BLOCK_LEN + 1];
+        float fq[FM_BLOCK_LEN + 1];
+        float angle[FM_BLOCK_LEN];
+        int precise = state->mode == BASEBAND_FM_PRECISE;
+        for (unsigned long pos = 0; pos < num_samples; pos += FM_BLOCK_LEN) {
+            uint32_t len = num_samples - pos < FM_BLOCK_LEN ? num_samples - pos : FM_BLOCK_LEN;
+            fi[0] = x0r;
+            fq[0] = x0i;
+            for (uint32_t k = 0; k < len; k++) {
+                fi[k + 1] = *x_buf++ - 128;
+                fq[k + 1] = *x_buf++ - 128;
+            }
+            x0r = fi[len];
+            x0i = fq[len];
+            fm_angle_impl(fi, fq, angle, len, precise);
+            for (uint32_t k = 0; k < len; k++) {
+                int16_t x1f = x0f;
+                x0f      = (int16_t)(angle[k] * (float)(INT16_MAX / M_PI)); // Pi equals INT16_MAX
+                y0f      = (alp[1] * y0f + blp[0] * (x0f + x1f)) >> (F_SCALE - 1); // note: prescaled, blp[0]==blp[1]
+                *y_buf++ = y0f;
+            }
+        }
+    } else {
+        for (unsigned n = 0; n < num_samples; n++) {
+            int16_t x1r, x1i; // Old IQ sample: x[n-1]
+            int16_t x1f, y1f; // Instantaneous frequency, old sample
+            int32_t pr, pi;   // Phase difference vector
+
+            // delay old sample
+            x1r = x0r;
+            x1i = x0i;
+            y1f = y0f;
+            x1f = x0f;
+            // get new sample
+            x0r = *x_buf++ - 128;
+            x0i = *x_buf++ - 128;
+            // Calculate phase difference vector: x[n] * conj(x[n-1])
+            pr = x0r * x1r + x0i * x1i; // May exactly overflow an int16_t (-128*-128 + -128*-128)
+            pi = x0i * x1r - x0r * x1i;
+            // xlp = (int16_t)((atan2f(pi, pr) / M_PI) * INT16_MAX); // Floating point implementation
+            x0f = atan2_int16(pi, pr); // Integer implementation
+            // xlp = pi; // Cheat and use only imaginary part (works OK, but is amplitude sensitive)
+            // Low pass filter
+            // y0f      = ((alp[1] * y1f >> 1) + (blp[0] * x0f >> 1) + (blp[1] * x1f >> 1)) >> (F_SCALE - 1);
+            y0f      = (alp[1] * y1f + blp[0] * (x0f + x1f)) >> (F_SCALE - 1); // note: prescaled, blp[0]==blp[1]
+            *y_buf++ = y0f;
+        }
     }
 
     // Store newest sample for next run
@@ -289,8 +1202,8 @@ static int32_t atan2_int32(int32_t y, int32_t x)
     return angle;
 }
 
-/// Fast Instantaneous frequency and Low Pass filter, CS16 samples.
-void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state)
+/// Select the 32 bit low pass filter coeffs for the CS16 and CF32 FM demodulators.
+static void demod_FM_coeffs32(demodfm_state_t *state, uint32_t samp_rate, float low_pass, char const *func)
 {
     // Select filter coeffs, [b,a] = butter(1, cutoff)
     // e.g [b,a] = butter(1, 0.1) -> 3x tau (95%) ~10 samples, 250k -> 40us, 1024k -> 10us
@@ -303,7 +1216,7 @@ void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long
         } else if (low_pass >= 1.0f) {
             low_pass = 1e6f / low_pass / samp_rate;
         }
-        fprintf(stderr, "%s: low pass filter for %u Hz at cutoff %.0f Hz, %.1f us\n", __func__,
+        fprintf(stderr, "%s: low pass filter for %u Hz at cutoff %.0f Hz, %.1f us\n", func,
                 samp_rate, samp_rate * low_pass, 1e6 / (samp_rate * low_pass));
         double ita  = 1.0 / tan(M_PI_2 * low_pass);
         double gain = 1.0 / (1.0 + ita);
@@ -313,6 +1226,31 @@ void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long
         state->blp_32[1] = FIX32(gain);
         state->rate      = samp_rate;
     }
+}
+
+/// Convert the discriminator angle to Q0.31 frequency and low pass filter.
+static void demod_FM_filter32(float const *angle, int16_t *y_buf, uint32_t len, int32_t *x0f, int32_t *y0f, demodfm_state_t const *state)
+{
+    int64_t const *alp = state->alp_32;
+    int64_t const *blp = state->blp_32;
+    int32_t xf = *x0f;
+    int32_t yf = *y0f;
+    for (uint32_t k = 0; k < len; k++) {
+        int32_t x1f = xf;
+        // Pi equals INT32_MAX, clamp as float can not represent INT32_MAX
+        float f  = angle[k] * (float)(INT32_MAX / M_PI);
+        xf       = f >= 2147483520.0f ? INT32_MAX : f <= -2147483520.0f ? -INT32_MAX : (int32_t)f;
+        yf       = (alp[1] * yf + blp[0] * ((int64_t)xf + x1f)) >> F_SCALE32; // note: blp[0]==blp[1]
+        *y_buf++ = yf >> 16;
+    }
+    *x0f = xf;
+    *y0f = yf;
+}
+
+/// Fast Instantaneous frequency and Low Pass filter, CS16 samples.
+void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state)
+{
+    demod_FM_coeffs32(state, samp_rate, low_pass, __func__);
     int64_t const *alp = state->alp_32;
     int64_t const *blp = state->blp_32;
 
@@ -322,30 +1260,52 @@ void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long
     int32_t x0f = state->xf; // Instantaneous frequency
     int32_t y0f = state->yf; // Instantaneous frequency, low pass filtered
 
-    for (unsigned n = 0; n < num_samples; n++) {
-        int32_t x1r, x1i; // Old IQ sample: x[n-1]
-        int32_t x1f, y1f; // Instantaneous frequency, old sample
-        int64_t pr, pi;   // Phase difference vector
-
-        // delay old sample
-        x1r = x0r;
-        x1i = x0i;
-        y1f = y0f;
-        x1f = x0f;
-        // get new sample
-        x0r = *x_buf++;
-        x0i = *x_buf++;
-        // Calculate phase difference vector: x[n] * conj(x[n-1])
-        pr = (int64_t)x0r * x1r + (int64_t)x0i * x1i; // May exactly overflow an int32_t (-32768*-32768 + -32768*-32768)
-        pi = (int64_t)x0i * x1r - (int64_t)x0r * x1i;
-        // xlp = (int32_t)((atan2f(pi, pr) / M_PI) * INT32_MAX); // Floating point implementation
-        x0f = atan2_int32(pi, pr); // Integer implementation
-        // xlp = atan2_int16(pi >> 16, pr >> 16) << 16; // Integer implementation, truncated
-        // xlp = pi; // Cheat and use only imaginary part (works OK, but is amplitude sensitive)
-        // Low pass filter
-        // y0f      = (alp[1] * y1f + blp[0] * x0f + blp[1] * x1f) >> F_SCALE32;
-        y0f      = (alp[1] * y1f + blp[0] * ((int64_t)x0f + x1f)) >> F_SCALE32; // note: blp[0]==blp[1]
-        *y_buf++ = y0f >> 16; // not really losing info here, maybe optimize earlier
+    if (state->mode != BASEBAND_FM_INT) {
+        // Block-wise: vectorized discriminator, then the (serial) low pass filter
+        float fi[FM_BLOCK_LEN + 1];
+        float fq[FM_BLOCK_LEN + 1];
+        float angle[FM_BLOCK_LEN];
+        int precise = state->mode == BASEBAND_FM_PRECISE;
+        for (unsigned long pos = 0; pos < num_samples; pos += FM_BLOCK_LEN) {
+            uint32_t len = num_samples - pos < FM_BLOCK_LEN ? num_samples - pos : FM_BLOCK_LEN;
+            fi[0] = x0r;
+            fq[0] = x0i;
+            for (uint32_t k = 0; k < len; k++) {
+                fi[k + 1] = *x_buf++;
+                fq[k + 1] = *x_buf++;
+            }
+            x0r = fi[len];
+            x0i = fq[len];
+            fm_angle_impl(fi, fq, angle, len, precise);
+            demod_FM_filter32(angle, y_buf, len, &x0f, &y0f, state);
+            y_buf += len;
+        }
+    } else {
+        for (unsigned n = 0; n < num_samples; n++) {
+            int32_t x1r, x1i; // Old IQ sample: x[n-1]
+            int32_t x1f, y1f; // Instantaneous frequency, old sample
+            int64_t pr, pi;   // Phase difference vector
+
+            // delay old sample
+            x1r = x0r;
+            x1i = x0i;
+            y1f = y0f;
+            x1f = x0f;
+            // get new sample
+            x0r = *x_buf++;
+            x0i = *x_buf++;
+            // Calculate phase difference vector: x[n] * conj(x[n-1])
+            pr = (int64_t)x0r * x1r + (int64_t)x0i * x1i; // May exactly overflow an int32_t (-32768*-32768 + -32768*-32768)
+            pi = (int64_t)x0i * x1r - (int64_t)x0r * x1i;
+            // xlp = (int32_t)((atan2f(pi, pr) / M_PI) * INT32_MAX); // Floating point implementation
+            x0f = atan2_int32(pi, pr); // Integer implementation
+            // xlp = atan2_int16(pi >> 16, pr >> 16) << 16; // Integer implementation, truncated
+            // xlp = pi; // Cheat and use only imaginary part (works OK, but is amplitude sensitive)
+            // Low pass filter
+            // y0f      = (alp[1] * y1f + blp[0] * x0f + blp[1] * x1f) >> F_SCALE32;
+            y0f      = (alp[1] * y1f + blp[0] * ((int64_t)x0f + x1f)) >> F_SCALE32; // note: blp[0]==blp[1]
+            *y_buf++ = y0f >> 16; // not really losing info here, maybe optimize earlier
+        }
     }
 
     // Store newest sample for next run
@@ -355,7 +1315,411 @@ void baseband_demod_FM_cs16(int16_t const *x_buf, int16_t *y_buf, unsigned long
     state->yf = y0f;
 }
 
+/** Instantaneous frequency and Low Pass filter, CF32 samples.
+
+    The samples are not converted, this always uses the float discriminator,
+    BASEBAND_FM_PRECISE selects the polynomial approximation, other modes the fast one.
+*/
+void baseband_demod_FM_cf32(float const *x_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state)
+{
+    demod_FM_coeffs32(state, samp_rate, low_pass, __func__);
+
+    float fi[FM_BLOCK_LEN + 1];
+    float fq[FM_BLOCK_LEN + 1];
+    float angle[FM_BLOCK_LEN];
+    int precise = state->mode == BASEBAND_FM_PRECISE;
+    fi[0] = state->xr_f;
+    fq[0] = state->xi_f;
+    int32_t x0f = state->xf;
+    int32_t y0f = state->yf;
+    for (unsigned long pos = 0; pos < num_samples; pos += FM_BLOCK_LEN) {
+        uint32_t len = num_samples - pos < FM_BLOCK_LEN ? num_samples - pos : FM_BLOCK_LEN;
+        for (uint32_t k = 0; k < len; k++) {
+            fi[k + 1] = *x_buf++;
+            fq[k + 1] = *x_buf++;
+        }
+        fm_angle_impl(fi, fq, angle, len, precise);
+        demod_FM_filter32(angle, y_buf, len, &x0f, &y0f, state);
+        y_buf += len;
+        fi[0] = fi[len];
+        fq[0] = fq[len];
+    }
+
+    // Store newest sample for next run
+    state->xr_f = fi[0];
+    state->xi_f = fq[0];
+    state->xf   = x0f;
+    state->yf   = y0f;
+}
+
+/// Samples per tile for the fused demodulators, the IQ input and envelope stay in L1 cache.
+#define BASEBAND_TILE_LEN 2048
+
+/* Clipping statistics, counted on the tile the envelope just read. */
+
+#define CLIP_HIGH (BASEBAND_CLIP_FS - BASEBAND_CLIP_FS / 128) // 1/128 below full scale
+#define CLIP_LOW (BASEBAND_CLIP_FS / 128)                     // 1/128 above zero
+
+float baseband_clip_peak_dbfs(baseband_clip_t const *clip)
+{
+    return 20.0f * log10f((clip->peak ? clip->peak : 1) / (float)BASEBAND_CLIP_FS);
+}
+
+static void clip_add(baseband_clip_t *clip, uint32_t len, uint32_t clipped, uint32_t near_zero, uint32_t peak)
+{
+    clip->samples += len;
+    clip->clipped += clipped;
+    clip->near_zero += near_zero;
+    if (peak > clip->peak)
+        clip->peak = peak;
+}
+
+static void clip_count_cu8(uint8_t const *iq_buf, uint32_t len, baseband_clip_t *clip)
+{
+    uint32_t clipped   = 0;
+    uint32_t near_zero = 0;
+    int peak           = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        int x  = abs(iq_buf[2 * i] - 128);
+        int y  = abs(iq_buf[2 * i + 1] - 128);
+        int mx = x > y ? x : y;
+        clipped += mx >= CLIP_HIGH / 256;
+        near_zero += mx <= CLIP_LOW / 256;
+        peak = mx > peak ? mx : peak;
+    }
+    clip_add(clip, len, clipped, near_zero, peak * 256);
+}
+
+static void clip_count_cs16(int16_t const *iq_buf, uint32_t len, baseband_clip_t *clip)
+{
+    uint32_t clipped   = 0;
+    uint32_t near_zero = 0;
+    int32_t peak       = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        int32_t x  = abs(iq_buf[2 * i]);
+        int32_t y  = abs(iq_buf[2 * i + 1]);
+        int32_t mx = x > y ? x : y;
+        clipped += mx >= CLIP_HIGH;
+        near_zero += mx <= CLIP_LOW;
+        peak = mx > peak ? mx : peak;
+    }
+    clip_add(clip, len, clipped, near_zero, peak);
+}
+
+static void clip_count_cf32(float const *iq_buf, uint32_t len, baseband_clip_t *clip)
+{
+    uint32_t clipped   = 0;
+    uint32_t near_zero = 0;
+    float peak         = 0.0f;
+    for (uint32_t i = 0; i < len; i++) {
+        float x  = fabsf(iq_buf[2 * i]) * BASEBAND_CLIP_FS;
+        float y  = fabsf(iq_buf[2 * i + 1]) * BASEBAND_CLIP_FS;
+        float mx = x > y ? x : y;
+        clipped += mx >= CLIP_HIGH;
+        near_zero += mx <= CLIP_LOW;
+        peak = mx > peak ? mx : peak;
+    }
+    clip_add(clip, len, clipped, near_zero, peak < UINT32_MAX ? (uint32_t)peak : UINT32_MAX);
+}
+
+static void clip_count_cs8(int8_t const *iq_buf, uint32_t len, baseband_clip_t *clip)
+{
+    uint8_t cu8_tile[2 * BASEBAND_TILE_LEN];
+
+    for (uint32_t pos = 0; pos < len; pos += BASEBAND_TILE_LEN) {
+        uint32_t n = len - pos < BASEBAND_TILE_LEN ? len - pos : BASEBAND_TILE_LEN;
+        cs8_to_cu8(&iq_buf[2 * pos], cu8_tile, 2 * n);
+        clip_count_cu8(cu8_tile, n, clip);
+    }
+}
+
+/* Fused demodulators */
+
+static float demod_AM_FM_cu8_tiles(uint8_t const *iq_buf, int16_t *am_buf, uint8_t *am8_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state, baseband_clip_t *clip)
+{
+    uint16_t env_buf[BASEBAND_TILE_LEN];
+    envelope_cu8_fn envelope = use_mag_est ? magnitude_est_cu8_impl : envelope_detect_impl;
+    uint32_t sum = 0;
+
+    for (unsigned long pos = 0; pos < num_samples; pos += BASEBAND_TILE_LEN) {
+        uint32_t len = num_samples - pos < BASEBAND_TILE_LEN ? num_samples - pos : BASEBAND_TILE_LEN;
+        uint8_t const *tile = &iq_buf[2 * pos];
+        sum += envelope(tile, env_buf, len);
+        if (clip)
+            clip_count_cu8(tile, len, clip);
+        baseband_low_pass_filter(env_buf, &am_buf[pos], len, lp_state);
+        if (am8_buf)
+            baseband_envelope_8bit(&am_buf[pos], &am8_buf[pos], len);
+        if (fm_buf) {
+            baseband_demod_FM(tile, &fm_buf[pos], len, samp_rate, low_pass, fm_state);
+        }
+    }
+
+    return use_mag_est ? sum_to_mag_db(sum, num_samples) : sum_to_amp_db(sum, num_samples);
+}
+
+float baseband_demod_AM_FM(uint8_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state)
+{
+    return demod_AM_FM_cu8_tiles(iq_buf, am_buf, NULL, fm_buf, num_samples, samp_rate, low_pass, use_mag_est, lp_state, fm_state, NULL);
+}
+
+static float demod_AM_FM_cs16_tiles(int16_t const *iq_buf, int16_t *am_buf, uint8_t *am8_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, filter_state_t *lp_state, demodfm_state_t *fm_state, baseband_clip_t *clip)
+{
+    uint16_t env_buf[BASEBAND_TILE_LEN];
+    uint32_t sum = 0;
+
+    for (unsigned long pos = 0; pos < num_samples; pos += BASEBAND_TILE_LEN) {
+        uint32_t len = num_samples - pos < BASEBAND_TILE_LEN ? num_samples - pos : BASEBAND_TILE_LEN;
+        int16_t const *tile = &iq_buf[2 * pos];
+        sum += magnitude_est_cs16_impl(tile, env_buf, len);
+        if (clip)
+            clip_count_cs16(tile, len, clip);
+        baseband_low_pass_filter(env_buf, &am_buf[pos], len, lp_state);
+        if (am8_buf)
+            baseband_envelope_8bit(&am_buf[pos], &am8_buf[pos], len);
+        if (fm_buf) {
+            baseband_demod_FM_cs16(tile, &fm_buf[pos], len, samp_rate, low_pass, fm_state);
+        }
+    }
+
+    return sum_to_mag_db(sum, num_samples);
+}
+
+float baseband_demod_AM_FM_cs16(int16_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, filter_state_t *lp_state, demodfm_state_t *fm_state)
+{
+    return demod_AM_FM_cs16_tiles(iq_buf, am_buf, NULL, fm_buf, num_samples, samp_rate, low_pass, lp_state, fm_state, NULL);
+}
+
+static float demod_AM_FM_cs8_tiles(int8_t const *iq_buf, int16_t *am_buf, uint8_t *am8_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state, baseband_clip_t *clip)
+{
+    uint8_t cu8_tile[2 * BASEBAND_TILE_LEN];
+    uint16_t env_buf[BASEBAND_TILE_LEN];
+    envelope_cu8_fn envelope = use_mag_est ? magnitude_est_cu8_impl : envelope_detect_impl;
+    uint32_t sum = 0;
+
+    for (unsigned long pos = 0; pos < num_samples; pos += BASEBAND_TILE_LEN) {
+        uint32_t len = num_samples - pos < BASEBAND_TILE_LEN ? num_samples - pos : BASEBAND_TILE_LEN;
+        cs8_to_cu8(&iq_buf[2 * pos], cu8_tile, 2 * len);
+        sum += envelope(cu8_tile, env_buf, len);
+        if (clip)
+            clip_count_cu8(cu8_tile, len, clip);
+        baseband_low_pass_filter(env_buf, &am_buf[pos], len, lp_state);
+        if (am8_buf)
+            baseband_envelope_8bit(&am_buf[pos], &am8_buf[pos], len);
+        if (fm_buf) {
+            baseband_demod_FM(cu8_tile, &fm_buf[pos], len, samp_rate, low_pass, fm_state);
+        }
+    }
+
+    return use_mag_est ? sum_to_mag_db(sum, num_samples) : sum_to_amp_db(sum, num_samples);
+}
+
+float baseband_demod_AM_FM_cs8(int8_t const *iq_buf, int16_t *am_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state)
+{
+    return demod_AM_FM_cs8_tiles(iq_buf, am_buf, NULL, fm_buf, num_samples, samp_rate, low_pass, use_mag_est, lp_state, fm_state, NULL);
+}
+
+static float demod_AM_FM_cf32_tiles(float const *iq_buf, int16_t *am_buf, uint8_t *am8_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, filter_state_t *lp_state, demodfm_state_t *fm_state, baseband_clip_t *clip)
+{
+    uint16_t env_buf[BASEBAND_TILE_LEN];
+    uint32_t sum = 0;
+
+    for (unsigned long pos = 0; pos < num_samples; pos += BASEBAND_TILE_LEN) {
+        uint32_t len = num_samples - pos < BASEBAND_TILE_LEN ? num_samples - pos : BASEBAND_TILE_LEN;
+        float const *tile = &iq_buf[2 * pos];
+        sum += magnitude_est_cf32_sum(tile, env_buf, len);
+        if (clip)
+            clip_count_cf32(tile, len, clip);
+        baseband_low_pass_filter(env_buf, &am_buf[pos], len, lp_state);
+        if (am8_buf)
+            baseband_envelope_8bit(&am_buf[pos], &am8_buf[pos], len);
+        if (fm_buf) {
+            baseband_demod_FM_cf32(tile, &fm_buf[pos], len, samp_rate, low_pass, fm_state);
+        }
+    }
+
+    return sum_to_mag_db(sum, num_samples);
+}
+
+float baseband_demod_AM_FM_cf32(float const *iq_buf, int16_t *am_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, filter_state_t *lp_state, demodfm_state_t *fm_state)
+{
+    return demod_AM_FM_cf32_tiles(iq_buf, am_buf, NULL, fm_buf, num_samples, samp_rate, low_pass, lp_state, fm_state, NULL);
+}
+
+/* Sample format dispatch */
+
+// the envelope kernels count the clipping by tiles, the whole buffer at once otherwise
+
+static float envelope_cu8_kernel(void const *iq_buf, uint16_t *y_buf, uint32_t len, int use_mag_est, baseband_clip_t *clip)
+{
+    if (!clip)
+        return use_mag_est ? magnitude_est_cu8(iq_buf, y_buf, len) : envelope_detect(iq_buf, y_buf, len);
+
+    uint8_t const *cu8_buf   = iq_buf;
+    envelope_cu8_fn envelope = use_mag_est ? magnitude_est_cu8_impl : envelope_detect_impl;
+    uint32_t sum = 0;
+
+    for (uint32_t pos = 0; pos < len; pos += BASEBAND_TILE_LEN) {
+        uint32_t n = len - pos < BASEBAND_TILE_LEN ? len - pos : BASEBAND_TILE_LEN;
+        sum += envelope(&cu8_buf[2 * pos], &y_buf[pos], n);
+        clip_count_cu8(&cu8_buf[2 * pos], n, clip);
+    }
+
+    return use_mag_est ? sum_to_mag_db(sum, len) : sum_to_amp_db(sum, len);
+}
+
+static float envelope_cs8_kernel(void const *iq_buf, uint16_t *y_buf, uint32_t len, int use_mag_est, baseband_clip_t *clip)
+{
+    uint8_t cu8_tile[2 * BASEBAND_TILE_LEN];
+    int8_t const *cs8_buf    = iq_buf;
+    envelope_cu8_fn envelope = use_mag_est ? magnitude_est_cu8_impl : envelope_detect_impl;
+    uint32_t sum = 0;
+
+    for (uint32_t pos = 0; pos < len; pos += BASEBAND_TILE_LEN) {
+        uint32_t n = len - pos < BASEBAND_TILE_LEN ? len - pos : BASEBAND_TILE_LEN;
+        cs8_to_cu8(&cs8_buf[2 * pos], cu8_tile, 2 * n);
+        sum += envelope(cu8_tile, &y_buf[pos], n);
+        if (clip)
+            clip_count_cu8(cu8_tile, n, clip);
+    }
+
+    return use_mag_est ? sum_to_mag_db(sum, len) : sum_to_amp_db(sum, len);
+}
+
+static float envelope_cs16_kernel(void const *iq_buf, uint16_t *y_buf, uint32_t len, int use_mag_est, baseband_clip_t *clip)
+{
+    (void)use_mag_est; // always a magnitude
+    if (!clip)
+        return magnitude_est_cs16(iq_buf, y_buf, len);
+
+    int16_t const *cs16_buf = iq_buf;
+    uint32_t sum = 0;
+
+    for (uint32_t pos = 0; pos < len; pos += BASEBAND_TILE_LEN) {
+        uint32_t n = len - pos < BASEBAND_TILE_LEN ? len - pos : BASEBAND_TILE_LEN;
+        sum += magnitude_est_cs16_impl(&cs16_buf[2 * pos], &y_buf[pos], n);
+        clip_count_cs16(&cs16_buf[2 * pos], n, clip);
+    }
+
+    return sum_to_mag_db(sum, len);
+}
+
+static float envelope_cf32_kernel(void const *iq_buf, uint16_t *y_buf, uint32_t len, int use_mag_est, baseband_clip_t *clip)
+{
+    (void)use_mag_est; // always a magnitude
+    if (!clip)
+        return magnitude_est_cf32(iq_buf, y_buf, len);
+
+    float const *cf32_buf = iq_buf;
+    uint32_t sum = 0;
+
+    for (uint32_t pos = 0; pos < len; pos += BASEBAND_TILE_LEN) {
+        uint32_t n = len - pos < BASEBAND_TILE_LEN ? len - pos : BASEBAND_TILE_LEN;
+        sum += magnitude_est_cf32_sum(&cf32_buf[2 * pos], &y_buf[pos], n);
+        clip_count_cf32(&cf32_buf[2 * pos], n, clip);
+    }
+
+    return sum_to_mag_db(sum, len);
+}
+
+static void demod_FM_cu8_kernel(void const *iq_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state)
+{
+    baseband_demod_FM(iq_buf, y_buf, num_samples, samp_rate, low_pass, state);
+}
+
+static void demod_FM_cs8_kernel(void const *iq_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state)
+{
+    uint8_t cu8_tile[2 * BASEBAND_TILE_LEN];
+    int8_t const *cs8_buf = iq_buf;
+
+    for (unsigned long pos = 0; pos < num_samples; pos += BASEBAND_TILE_LEN) {
+        uint32_t len = num_samples - pos < BASEBAND_TILE_LEN ? num_samples - pos : BASEBAND_TILE_LEN;
+        cs8_to_cu8(&cs8_buf[2 * pos], cu8_tile, 2 * len);
+        baseband_demod_FM(cu8_tile, &y_buf[pos], len, samp_rate, low_pass, state);
+    }
+}
+
+static void demod_FM_cs16_kernel(void const *iq_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state)
+{
+    baseband_demod_FM_cs16(iq_buf, y_buf, num_samples, samp_rate, low_pass, state);
+}
+
+static void demod_FM_cf32_kernel(void const *iq_buf, int16_t *y_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, demodfm_state_t *state)
+{
+    baseband_demod_FM_cf32(iq_buf, y_buf, num_samples, samp_rate, low_pass, state);
+}
+
+static void clip_count_cu8_kernel(void const *iq_buf, uint32_t len, baseband_clip_t *clip)
+{
+    clip_count_cu8(iq_buf, len, clip);
+}
+
+static void clip_count_cs8_kernel(void const *iq_buf, uint32_t len, baseband_clip_t *clip)
+{
+    clip_count_cs8(iq_buf, len, clip);
+}
+
+static void clip_count_cs16_kernel(void const *iq_buf, uint32_t len, baseband_clip_t *clip)
+{
+    clip_count_cs16(iq_buf, len, clip);
+}
+
+static void clip_count_cf32_kernel(void const *iq_buf, uint32_t len, baseband_clip_t *clip)
+{
+    clip_count_cf32(iq_buf, len, clip);
+}
+
+static float demod_AM_FM_cu8_kernel(void const *iq_buf, int16_t *am_buf, uint8_t *am8_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state, baseband_clip_t *clip)
+{
+    return demod_AM_FM_cu8_tiles(iq_buf, am_buf, am8_buf, fm_buf, num_samples, samp_rate, low_pass, use_mag_est, lp_state, fm_state, clip);
+}
+
+static float demod_AM_FM_cs8_kernel(void const *iq_buf, int16_t *am_buf, uint8_t *am8_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state, baseband_clip_t *clip)
+{
+    return demod_AM_FM_cs8_tiles(iq_buf, am_buf, am8_buf, fm_buf, num_samples, samp_rate, low_pass, use_mag_est, lp_state, fm_state, clip);
+}
+
+static float demod_AM_FM_cs16_kernel(void const *iq_buf, int16_t *am_buf, uint8_t *am8_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state, baseband_clip_t *clip)
+{
+    (void)use_mag_est; // always a magnitude
+    return demod_AM_FM_cs16_tiles(iq_buf, am_buf, am8_buf, fm_buf, num_samples, samp_rate, low_pass, lp_state, fm_state, clip);
+}
+
+static float demod_AM_FM_cf32_kernel(void const *iq_buf, int16_t *am_buf, uint8_t *am8_buf, int16_t *fm_buf, unsigned long num_samples, uint32_t samp_rate, float low_pass, int use_mag_est, filter_state_t *lp_state, demodfm_state_t *fm_state, baseband_clip_t *clip)
+{
+    (void)use_mag_est; // always a magnitude
+    return demod_AM_FM_cf32_tiles(iq_buf, am_buf, am8_buf, fm_buf, num_samples, samp_rate, low_pass, lp_state, fm_state, clip);
+}
+
+// The first entry for a sample size is the SDR default for that size.
+static baseband_kernels_t const baseband_kernels_list[] = {
+        {CU8_IQ, 2, envelope_cu8_kernel, demod_FM_cu8_kernel, demod_AM_FM_cu8_kernel, clip_count_cu8_kernel},
+        {CS16_IQ, 4, envelope_cs16_kernel, demod_FM_cs16_kernel, demod_AM_FM_cs16_kernel, clip_count_cs16_kernel},
+        {CS8_IQ, 2, envelope_cs8_kernel, demod_FM_cs8_kernel, demod_AM_FM_cs8_kernel, clip_count_cs8_kernel},
+        {CF32_IQ, 8, envelope_cf32_kernel, demod_FM_cf32_kernel, demod_AM_FM_cf32_kernel, clip_count_cf32_kernel},
+};
+
+baseband_kernels_t const *baseband_get_kernels(uint32_t format, int sample_size)
+{
+    for (size_t i = 0; i < sizeof(baseband_kernels_list) / sizeof(*baseband_kernels_list); ++i) {
+        baseband_kernels_t const *kernels = &baseband_kernels_list[i];
+        if (format ? kernels->format == format : kernels->sample_size == sample_size)
+            return kernels;
+    }
+    return NULL;
+}
+
+#ifndef BASEBAND_ENVELOPE_DEFAULT
+#define BASEBAND_ENVELOPE_DEFAULT -1 // calibrate
+#endif
+
 void baseband_init(void)
 {
-    calc_squares();
+    static int initialized;
+    if (initialized)
+        return; // the kernels are selected once for all configs
+    initialized = 1;
+    baseband_set_simd(-1);
+    if (baseband_set_envelope(BASEBAND_ENVELOPE_DEFAULT) < 0)
+        baseband_set_envelope(BASEBAND_ENVELOPE_LUT); // e.g. SIMD requested but not supported
 }
@@ -10,6 +10,7 @@
 */
 
 #include "bitbuffer.h"
+#include "decode_budget.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,10 +20,56 @@ void bitbuffer_clear(bitbuffer_t *bits)
     memset(bits, 0, sizeof(*bits));
 }
 
+void bitbuffer_init(bitbuffer_t *bits)
+{
+    memset(bits, 0, sizeof(*bits));
+}
+
+/// The rows that may hold data, all rows from there on are zero.
+static inline unsigned bitbuffer_used_rows(bitbuffer_t const *bits)
+{
+    unsigned used = bits->free_row > bits->num_rows ? bits->free_row : bits->num_rows;
+    return used > bits->dirty_rows ? used : bits->dirty_rows;
+}
+
+void bitbuffer_reset(bitbuffer_t *bits)
+{
+    unsigned used = bitbuffer_used_rows(bits);
+    memset(bits->bb, 0, used * BITBUF_COLS);
+    bits->num_rows   = 0;
+    bits->free_row   = 0;
+    bits->dirty_rows = 0;
+    memset(bits->bits_per_row, 0, sizeof(bits->bits_per_row));
+    memset(bits->syncs_before_row, 0, sizeof(bits->syncs_before_row));
+}
+
+void bitbuffer_copy(bitbuffer_t *dst, bitbuffer_t const *src)
+{
+    unsigned used     = bitbuffer_used_rows(src);
+    unsigned dst_used = bitbuffer_used_rows(dst);
+    dst->num_rows   = src->num_rows;
+    dst->free_row   = src->free_row;
+    dst->dirty_rows = used;
+    memcpy(dst->bits_per_row, src->bits_per_row, sizeof(dst->bits_per_row));
+    memcpy(dst->syncs_before_row, src->syncs_before_row, sizeof(dst->syncs_before_row));
+    memcpy(dst->bb, src->bb, used * BITBUF_COLS);
+    if (dst_used > used)
+        memset(dst->bb[used], 0, (dst_used - used) * BITBUF_COLS);
+}
+
+/// Mark the rows up to 'to' (exclusive) as started, they are cleared on reset, see bitbuffer_reset().
+static inline void bitbuffer_start_rows(bitbuffer_t *bits, unsigned to)
+{
+    if (to > bits->dirty_rows)
+        bits->dirty_rows = to;
+}
+
 void bitbuffer_add_bit(bitbuffer_t *bits, int bit)
 {
-    if (bits->num_rows == 0)
+    if (bits->num_rows == 0) {
         bits->free_row = bits->num_rows = 1; // Add first row automatically
+        bitbuffer_start_rows(bits, 1);
+    }
 
     if (bits->bits_per_row[bits->num_rows - 1] == UINT16_MAX) {
         // fprintf(stderr, "%s: Could not add more bits\n", __func__);
@@ -43,6 +90,7 @@ void bitbuffer_add_bit(bitbuffer_t *bits, int bit)
         }
         if (bits->free_row < BITBUF_ROWS) {
             bits->free_row++;
+            bitbuffer_start_rows(bits, bits->free_row);
         }
         else {
             // fprintf(stderr, "%s: Could not add more rows\n", __func__);
@@ -69,11 +117,89 @@ void bitbuffer_add_bit(bitbuffer_t *bits, int bit)
 */
 }
 
+/// Number of the next 'count' bits that can be stored directly, without a row spill or the length limit.
+static unsigned bitbuffer_direct_bits(bitbuffer_t *bits, unsigned count)
+{
+    if (bits->num_rows == 0)
+        return 0;
+    unsigned n        = bits->bits_per_row[bits->num_rows - 1];
+    unsigned row_bits = n % (BITBUF_COLS * 8);
+    if (n > 0 && row_bits == 0)
+        return 0; // spill into next row, see bitbuffer_add_bit()
+    unsigned avail = BITBUF_COLS * 8 - row_bits;
+    if (n + avail > UINT16_MAX - 1)
+        avail = n < UINT16_MAX - 1 ? UINT16_MAX - 1 - n : 0;
+    return count < avail ? count : avail;
+}
+
+/// Store up to 8 bits from the low bits of 'value', the first bit is the highest.
+static void bitbuffer_add_byte_bits(bitbuffer_t *bits, unsigned value, unsigned count)
+{
+    if (bitbuffer_direct_bits(bits, count) < count) {
+        for (unsigned i = count; i > 0; --i) {
+            bitbuffer_add_bit(bits, (value >> (i - 1)) & 1);
+        }
+        return;
+    }
+    unsigned n      = bits->bits_per_row[bits->num_rows - 1];
+    uint8_t *b      = bits->bb[bits->num_rows - 1];
+    unsigned shift  = n % 8;
+    uint8_t aligned = (uint8_t)(value << (8 - count));
+    b[n / 8] |= aligned >> shift;
+    if (shift + count > 8)
+        b[n / 8 + 1] |= (uint8_t)(aligned << (8 - shift));
+    bits->bits_per_row[bits->num_rows - 1] += count;
+}
+
+void bitbuffer_add_bits(bitbuffer_t *bits, uint32_t value, unsigned count)
+{
+    if (count > 32)
+        count = 32;
+    while (count > 0) {
+        unsigned chunk = count < 8 ? count : 8;
+        count -= chunk;
+        bitbuffer_add_byte_bits(bits, (value >> count) & ((1u << chunk) - 1), chunk);
+    }
+}
+
+void bitbuffer_add_run(bitbuffer_t *bits, int bit, unsigned count)
+{
+    while (count > 0) {
+        unsigned chunk = bitbuffer_direct_bits(bits, count);
+        if (!chunk) {
+            unsigned before = bits->num_rows ? bits->bits_per_row[bits->num_rows - 1] : 0;
+            bitbuffer_add_bit(bits, bit);
+            if (bits->bits_per_row[bits->num_rows - 1] == before)
+                return; // the buffer is full, the remaining bits are dropped too
+            count--;
+            continue;
+        }
+        unsigned n = bits->bits_per_row[bits->num_rows - 1];
+        if (bit) {
+            uint8_t *b   = bits->bb[bits->num_rows - 1];
+            unsigned end = n + chunk;
+            for (; n < end && n % 8; ++n)
+                b[n / 8] |= 0x80 >> (n % 8);
+            if (end / 8 > n / 8) {
+                memset(&b[n / 8], 0xff, end / 8 - n / 8);
+                n = end / 8 * 8;
+            }
+            for (; n < end; ++n)
+                b[n / 8] |= 0x80 >> (n % 8);
+        }
+        // zero bits are already cleared, see bitbuffer_clear()
+        bits->bits_per_row[bits->num_rows - 1] += chunk;
+        count -= chunk;
+    }
+}
+
 /// Set the width of the current (last) row by expanding or truncating as needed.
 static void bitbuffer_set_width(bitbuffer_t *bits, uint16_t width)
 {
-    if (bits->num_rows == 0)
+    if (bits->num_rows == 0) {
         bits->free_row = bits->num_rows = 1; // Add first row automatically
+        bitbuffer_start_rows(bits, 1);
+    }
 
     unsigned remaining_rows = BITBUF_ROWS - bits->num_rows + 1;
     unsigned remaining_bits = remaining_rows * BITBUF_COLS * 8;
@@ -96,19 +222,23 @@ static void bitbuffer_set_width(bitbuffer_t *bits, uint16_t width)
     bits->bits_per_row[bits->num_rows - 1] = width;
 
     unsigned extra_rows = width == 0 ? 0 : (width - 1) / (BITBUF_COLS * 8);
+    bitbuffer_start_rows(bits, bits->num_rows + extra_rows);
     bits->free_row = bits->num_rows + extra_rows;
 }
 
 void bitbuffer_add_row(bitbuffer_t *bits)
 {
-    if (bits->num_rows == 0)
+    if (bits->num_rows == 0) {
         bits->free_row = bits->num_rows = 1; // Add first row automatically
+        bitbuffer_start_rows(bits, 1);
+    }
     if (bits->free_row == BITBUF_ROWS - 1) {
         // fprintf(stderr, "%s: Warning: row count limit (%d rows) reached\n", __func__, BITBUF_ROWS);
     }
     if (bits->free_row < BITBUF_ROWS) {
         bits->free_row++;
         bits->num_rows = bits->free_row;
+        bitbuffer_start_rows(bits, bits->free_row);
     }
     else {
         bits->bits_per_row[bits->num_rows - 1] = 0; // Clear last row to handle overflow somewhat gracefully
@@ -118,14 +248,32 @@ void bitbuffer_add_row(bitbuffer_t *bits)
 
 void bitbuffer_add_sync(bitbuffer_t *bits)
 {
-    if (bits->num_rows == 0)
+    if (bits->num_rows == 0) {
         bits->free_row = bits->num_rows = 1; // Add first row automatically
+        bitbuffer_start_rows(bits, 1);
+    }
     if (bits->bits_per_row[bits->num_rows - 1]) {
         bitbuffer_add_row(bits);
     }
     bits->syncs_before_row[bits->num_rows - 1]++;
 }
 
+/// Load 8 bytes as a word, the first byte in the high bits.
+static inline uint64_t load_be64(uint8_t const *b)
+{
+    uint64_t w = 0;
+    for (unsigned i = 0; i < 8; ++i)
+        w = w << 8 | b[i];
+    return w;
+}
+
+/// Store a word as 8 bytes, the high bits in the first byte.
+static inline void store_be64(uint8_t *b, uint64_t w)
+{
+    for (unsigned i = 0; i < 8; ++i)
+        b[i] = (uint8_t)(w >> (56 - 8 * i));
+}
+
 void bitbuffer_invert(bitbuffer_t *bits)
 {
     for (unsigned row = 0; row < bits->num_rows; ++row) {
@@ -134,7 +282,14 @@ void bitbuffer_invert(bitbuffer_t *bits)
 
             const unsigned last_col  = (bits->bits_per_row[row] - 1) / 8;
             const unsigned last_bits = ((bits->bits_per_row[row] - 1) % 8) + 1;
-            for (unsigned col = 0; col <= last_col; ++col) {
+            unsigned col = 0;
+            for (; col + 8 <= last_col + 1; col += 8) {
+                uint64_t w;
+                memcpy(&w, &b[col], sizeof(w));
+                w = ~w; // Invert 8 bytes, the byte order does not matter
+                memcpy(&b[col], &w, sizeof(w));
+            }
+            for (; col <= last_col; ++col) {
                 b[col] = ~b[col]; // Invert
             }
             b[last_col] ^= 0xFF >> last_bits; // Re-invert unused bits in last byte
@@ -142,43 +297,42 @@ void bitbuffer_invert(bitbuffer_t *bits)
     }
 }
 
+/// XOR each bit with the bit before it, the first bit with 0, and invert for NRZ-S, a word at a time.
+static void nrz_decode_row(uint8_t *b, unsigned num_bits, int invert)
+{
+    const unsigned last_col  = (num_bits - 1) / 8;
+    const unsigned last_bits = ((num_bits - 1) % 8) + 1;
+    const uint64_t flip      = invert ? ~(uint64_t)0 : 0;
+
+    unsigned prev = 0; // the last bit of the previous word or byte
+    unsigned col  = 0;
+    for (; col + 8 <= last_col + 1; col += 8) {
+        uint64_t w    = load_be64(&b[col]);
+        uint64_t mask = (uint64_t)prev << 63 | w >> 1;
+        prev          = w & 1;
+        store_be64(&b[col], w ^ mask ^ flip);
+    }
+    for (; col <= last_col; ++col) {
+        unsigned mask = prev << 7 | b[col] >> 1;
+        prev          = b[col] & 1;
+        b[col]        = (uint8_t)(b[col] ^ mask ^ flip);
+    }
+    b[last_col] &= 0xFF << (8 - last_bits); // Clear unused bits in last byte
+}
+
 void bitbuffer_nrzs_decode(bitbuffer_t *bits)
 {
     for (unsigned row = 0; row < bits->num_rows; ++row) {
-        if (bits->bits_per_row[row] > 0) {
-            uint8_t *b = bits->bb[row];
-
-            const unsigned last_col  = (bits->bits_per_row[row] - 1) / 8;
-            const unsigned last_bits = ((bits->bits_per_row[row] - 1) % 8) + 1;
-
-            int prev = 0;
-            for (unsigned col = 0; col <= last_col; ++col) {
-                int mask = (prev << 7) | b[col] >> 1;
-                prev     = b[col];
-                b[col]   = b[col] ^ ~mask;
-            }
-            b[last_col] &= 0xFF << (8 - last_bits); // Clear unused bits in last byte
-        }
+        if (bits->bits_per_row[row] > 0)
+            nrz_decode_row(bits->bb[row], bits->bits_per_row[row], 1);
     }
 }
 
 void bitbuffer_nrzm_decode(bitbuffer_t *bits)
 {
     for (unsigned row = 0; row < bits->num_rows; ++row) {
-        if (bits->bits_per_row[row] > 0) {
-            uint8_t *b = bits->bb[row];
-
-            const unsigned last_col  = (bits->bits_per_row[row] - 1) / 8;
-            const unsigned last_bits = ((bits->bits_per_row[row] - 1) % 8) + 1;
-
-            int prev = 0;
-            for (unsigned col = 0; col <= last_col; ++col) {
-                int mask = (prev << 7) | b[col] >> 1;
-                prev     = b[col];
-                b[col]   = b[col] ^ mask;
-            }
-            b[last_col] &= 0xFF << (8 - last_bits); // Clear unused bits in last byte
-        }
+        if (bits->bits_per_row[row] > 0)
+            nrz_decode_row(bits->bb[row], bits->bits_per_row[row], 0);
     }
 }
 
@@ -198,6 +352,20 @@ void bitbuffer_extract_bytes(bitbuffer_t *bitbuffer, unsigned row,
         uint16_t word;
         pos = pos >> 3; // Convert to bytes
 
+        // 7 bytes at a time from a 64-bit window, reads no further than the bytewise loop
+        unsigned shl = 8 - shift;
+        while (bytes >= 7) {
+            uint64_t wide = 0;
+            for (unsigned i = 0; i < 8; ++i)
+                wide = wide << 8 | bits[pos + i];
+            wide <<= shl;
+            for (unsigned i = 0; i < 7; ++i)
+                p[i] = (uint8_t)(wide >> (56 - 8 * i));
+            p += 7;
+            pos += 7;
+            bytes -= 7;
+        }
+
         word = bits[pos];
 
         while (bytes--) {
@@ -210,6 +378,29 @@ void bitbuffer_extract_bytes(bitbuffer_t *bitbuffer, unsigned row,
         out[(len - 1) / 8] &= 0xff00 >> (len & 7); // mask off bottom bits
 }
 
+uint32_t bitbuffer_extract_u32(bitbuffer_t const *bitbuffer, unsigned row, unsigned pos, unsigned len)
+{
+    uint8_t const *bits = bitbuffer->bb[row];
+    if (len == 0)
+        return 0;
+    unsigned shl   = pos & 7;
+    unsigned bytes = (shl + len + 7) / 8; // at most 5 bytes
+    bits += pos / 8;
+    uint64_t val = 0;
+    for (unsigned i = 0; i < bytes; ++i)
+        val = val << 8 | bits[i];
+    val >>= bytes * 8 - shl - len;
+    return (uint32_t)(val & (UINT32_MAX >> (32 - len)));
+}
+
+uint64_t bitbuffer_extract_u64(bitbuffer_t const *bitbuffer, unsigned row, unsigned pos, unsigned len)
+{
+    if (len <= 32)
+        return bitbuffer_extract_u32(bitbuffer, row, pos, len);
+    uint64_t hi = bitbuffer_extract_u32(bitbuffer, row, pos, len - 32);
+    return hi << 32 | bitbuffer_extract_u32(bitbuffer, row, pos + len - 32, 32);
+}
+
 // If we make this an inline function instead of a macro, it means we don't
 // have to worry about using bit numbers with side-effects (bit++).
 static inline uint8_t bit_at(const uint8_t *bytes, unsigned bit)
@@ -217,11 +408,10 @@ static inline uint8_t bit_at(const uint8_t *bytes, unsigned bit)
     return (uint8_t)(bytes[bit >> 3] >> (7 - (bit & 7)) & 1);
 }
 
-unsigned bitbuffer_search(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+/// Search one bit at a time, for patterns longer than 64 bits.
+static unsigned search_bits(uint8_t const *bits, unsigned len, unsigned start,
         const uint8_t *pattern, unsigned pattern_bits_len)
 {
-    uint8_t *bits = bitbuffer->bb[row];
-    unsigned len  = bitbuffer->bits_per_row[row];
     unsigned ipos = start;
     unsigned ppos = 0; // cursor on init pattern
 
@@ -243,6 +433,96 @@ unsigned bitbuffer_search(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
     return len;
 }
 
+void bitbuffer_pattern_init(bitbuffer_pattern_t *pattern, const uint8_t *pattern_bits, unsigned pattern_bits_len)
+{
+    unsigned word_bits = pattern_bits_len < 64 ? pattern_bits_len : 64;
+
+    pattern->pattern = pattern_bits;
+    pattern->len     = pattern_bits_len;
+    pattern->mask    = word_bits ? ~0ULL << (64 - word_bits) : 0;
+    pattern->bits    = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+        pattern->bits = pattern->bits << 8 | (i * 8 < word_bits ? pattern_bits[i] : 0);
+    }
+    pattern->bits &= pattern->mask;
+}
+
+unsigned bitbuffer_search_pattern(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        bitbuffer_pattern_t const *pattern)
+{
+    uint8_t const *bits = bitbuffer->bb[row];
+    unsigned len        = bitbuffer->bits_per_row[row];
+
+    // a decoder over its time budget finds no more matches, see decode_budget_expired()
+    if (decode_budget_expired())
+        return len;
+    if (pattern->len > 64)
+        return search_bits(bits, len, start, pattern->pattern, pattern->len);
+    if (!pattern->len || start >= len || len - start < pattern->len)
+        return len;
+
+    unsigned last      = len - pattern->len; // last possible match position
+    unsigned num_bytes = (len + 7) / 8;
+    unsigned byte      = start / 8;
+    unsigned shift     = start % 8;
+
+    // the 64 bits from the current byte on, followed by the next byte
+    uint64_t window = 0;
+    for (unsigned i = 0; i < 8; ++i) {
+        window = window << 8 | (byte + i < num_bytes ? bits[byte + i] : 0);
+    }
+    for (; byte * 8 <= last; ++byte) {
+        uint64_t next = byte + 8 < num_bytes ? bits[byte + 8] : 0;
+        for (; shift < 8 && byte * 8 + shift <= last; ++shift) {
+            uint64_t word = shift ? window << shift | next >> (8 - shift) : window;
+            if ((word & pattern->mask) == pattern->bits)
+                return byte * 8 + shift;
+        }
+        shift  = 0;
+        window = window << 8 | next;
+    }
+
+    // Not found
+    return len;
+}
+
+unsigned bitbuffer_search(bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        const uint8_t *pattern, unsigned pattern_bits_len)
+{
+    bitbuffer_pattern_t search;
+    bitbuffer_pattern_init(&search, pattern, pattern_bits_len);
+    return bitbuffer_search_pattern(bitbuffer, row, start, &search);
+}
+
+/// Get the 8 bits at any bit position.
+static inline uint8_t byte_at(const uint8_t *bytes, unsigned bit)
+{
+    unsigned shift = bit & 7;
+    if (!shift)
+        return bytes[bit >> 3];
+    return (uint8_t)(bytes[bit >> 3] << shift | bytes[(bit >> 3) + 1] >> (8 - shift));
+}
+
+// Gather the bits 6, 4, 2, 0 of a byte into a nibble.
+#define LUT_NIBBLE(b) ((((b) >> 3) & 8) | (((b) >> 2) & 4) | (((b) >> 1) & 2) | ((b) & 1))
+// Bits set where a bit equals the next lower bit.
+#define LUT_EQUAL(b) (~((b) ^ ((b) >> 1)) & 0x7f)
+// Manchester: the second bit of each pair is the data, equal bits in a pair are an error.
+#define LUT_MC(b) (LUT_NIBBLE(b) | LUT_NIBBLE(LUT_EQUAL(b) & 0x55) << 4)
+// Differential Manchester: equal bits in a pair are a 1, a missing clock between pairs is an error.
+#define LUT_DMC(b) (LUT_NIBBLE(LUT_EQUAL(b) & 0x55) | ((LUT_EQUAL(b) & 0x2a) ? 0x10 : 0))
+
+#define LUT_ROW4(f, b) f(b), f(b + 1), f(b + 2), f(b + 3)
+#define LUT_ROW16(f, b) LUT_ROW4(f, b), LUT_ROW4(f, b + 4), LUT_ROW4(f, b + 8), LUT_ROW4(f, b + 12)
+#define LUT_ROW64(f, b) LUT_ROW16(f, b), LUT_ROW16(f, b + 16), LUT_ROW16(f, b + 32), LUT_ROW16(f, b + 48)
+#define LUT_256(f) {LUT_ROW64(f, 0), LUT_ROW64(f, 64), LUT_ROW64(f, 128), LUT_ROW64(f, 192)}
+
+/// Manchester decoded nibble of each byte, the high nibble flags invalid pairs.
+static uint8_t const manchester_lut[256] = LUT_256(LUT_MC);
+
+/// Differential Manchester decoded nibble of each byte, the high nibble flags a missing clock.
+static uint8_t const differential_manchester_lut[256] = LUT_256(LUT_DMC);
+
 unsigned bitbuffer_manchester_decode(bitbuffer_t *inbuf, unsigned row, unsigned start,
         bitbuffer_t *outbuf, unsigned max)
 {
@@ -253,6 +533,15 @@ unsigned bitbuffer_manchester_decode(bitbuffer_t *inbuf, unsigned row, unsigned
     if (max && len > start + (max * 2))
         len = start + (max * 2);
 
+    // a byte at a time, the bit loop finds the exact position of an error
+    while (ipos + 8 <= len) {
+        uint8_t nibble = manchester_lut[byte_at(bits, ipos)];
+        if (nibble & 0xf0)
+            break;
+        bitbuffer_add_bits(outbuf, nibble, 4);
+        ipos += 8;
+    }
+
     while (ipos < len) {
         uint8_t bit1, bit2;
 
@@ -268,6 +557,44 @@ unsigned bitbuffer_manchester_decode(bitbuffer_t *inbuf, unsigned row, unsigned
     return ipos;
 }
 
+unsigned bitbuffer_manchester_decode_row(bitbuffer_t *inbuf, unsigned row, unsigned start,
+        uint8_t *out, unsigned max)
+{
+    uint8_t *bits     = inbuf->bb[row];
+    unsigned int len  = inbuf->bits_per_row[row];
+    unsigned int ipos = start;
+    unsigned int opos = 0;
+
+    memset(out, 0, (max + 7) / 8);
+    if (len > start + (max * 2))
+        len = start + (max * 2);
+
+    // a byte at a time, the bit loop finds the exact position of an error
+    while (ipos + 8 <= len) {
+        uint8_t nibble = manchester_lut[byte_at(bits, ipos)];
+        if (nibble & 0xf0)
+            break;
+        out[opos >> 3] |= (uint8_t)(nibble << (4 - (opos & 7))); // the high or the low half of a byte
+        opos += 4;
+        ipos += 8;
+    }
+
+    while (ipos < len) {
+        uint8_t bit1, bit2;
+
+        bit1 = bit_at(bits, ipos++);
+        bit2 = bit_at(bits, ipos++);
+
+        if (bit1 == bit2)
+            break;
+
+        out[opos >> 3] |= (uint8_t)(bit2 << (7 - (opos & 7)));
+        opos++;
+    }
+
+    return opos;
+}
+
 unsigned bitbuffer_differential_manchester_decode(bitbuffer_t *inbuf, unsigned row, unsigned start,
         bitbuffer_t *outbuf, unsigned max)
 {
@@ -303,6 +630,17 @@ unsigned bitbuffer_differential_manchester_decode(bitbuffer_t *inbuf, unsigned r
         }
     }
 
+    // a byte at a time, the bit loop finds the exact position of a missing clock
+    while (ipos + 8 <= len) {
+        uint8_t byte = byte_at(bits, ipos);
+        uint8_t nibble = differential_manchester_lut[byte];
+        if ((byte >> 7) == bit2 || (nibble & 0xf0))
+            break;
+        bitbuffer_add_bits(outbuf, nibble, 4);
+        bit2 = byte & 1;
+        ipos += 8;
+    }
+
     while (ipos < len) {
         bit1 = bit_at(bits, ipos++);
         if (bit1 == bit2)
@@ -447,19 +785,16 @@ void bitbuffer_parse(bitbuffer_t *bits, const char *code)
             bitbuffer_add_row(bits);
             continue;
         }
-        else if (*c >= '0' && *c <= '9') {
-            data = *c - '0';
-        }
-        else if (*c >= 'A' && *c <= 'F') {
-            data = *c - 'A' + 10;
-        }
-        else if (*c >= 'a' && *c <= 'f') {
-            data = *c - 'a' + 10;
+        else {
+            unsigned d = (unsigned)*c - '0';
+            if (d < 10) {
+                data = (int)d;
+            }
+            else if ((d = ((unsigned)*c | 0x20) - 'a') < 6) { // fold to lower case
+                data = (int)d + 10;
+            }
         }
-        bitbuffer_add_bit(bits, data >> 3 & 0x01);
-        bitbuffer_add_bit(bits, data >> 2 & 0x01);
-        bitbuffer_add_bit(bits, data >> 1 & 0x01);
-        bitbuffer_add_bit(bits, data >> 0 & 0x01);
+        bitbuffer_add_bits(bits, (uint32_t)data, 4); // other characters repeat the last digit, as before
     }
     if (width >= 0) {
         bitbuffer_set_width(bits, width);
@@ -496,28 +831,68 @@ unsigned bitbuffer_count_repeats(bitbuffer_t *bits, unsigned row, unsigned max_b
     return cnt;
 }
 
-int bitbuffer_find_repeated_row(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
+/// Hash of a row as compared by bitbuffer_compare_rows(), rows shorter than @p max_bits are hashed in full.
+static uint32_t bitbuffer_row_hash(bitbuffer_t *bits, unsigned row, unsigned max_bits)
 {
-    for (int i = 0; i < bits->num_rows; ++i) {
-        if (bits->bits_per_row[i] >= min_bits &&
-                bitbuffer_count_repeats(bits, i, 0) >= min_repeats) {
-            return i;
-        }
+    unsigned len = bits->bits_per_row[row];
+    if (max_bits && len >= max_bits)
+        len = max_bits;
+    else
+        max_bits = 0; // full compare, the length must match
+
+    uint8_t const *b = bits->bb[row];
+    uint32_t hash    = 2166136261u ^ (max_bits ? 0 : len); // FNV-1a
+    for (unsigned i = 0; i < len / 8; ++i) {
+        hash = (hash ^ b[i]) * 16777619u;
     }
-    return -1;
+    if (len & 7)
+        hash = (hash ^ (b[len / 8] & (0xff00 >> (len & 7)))) * 16777619u;
+    return hash;
 }
 
-int bitbuffer_find_repeated_prefix(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
+/// Find the first row of at least @p min_bits with at least @p min_repeats repeats, see bitbuffer_count_repeats().
+static int bitbuffer_find_repeats(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits, unsigned max_bits)
 {
-    for (int i = 0; i < bits->num_rows; ++i) {
-        if (bits->bits_per_row[i] >= min_bits &&
-                bitbuffer_count_repeats(bits, i, min_bits) >= min_repeats) {
-            return i;
+    // the hashes rule out most rows, equal hashes are confirmed with a compare
+    uint32_t hashes[BITBUF_ROWS];
+    unsigned num_rows = bits->num_rows < BITBUF_ROWS ? bits->num_rows : BITBUF_ROWS;
+    for (unsigned i = 0; i < num_rows; ++i) {
+        hashes[i] = bitbuffer_row_hash(bits, i, max_bits);
+    }
+
+    for (unsigned i = 0; i < num_rows; ++i) {
+        if (bits->bits_per_row[i] < min_bits)
+            continue;
+        // a repeat of an earlier row has the same count, that row was not enough
+        unsigned k = 0;
+        for (; k < i; ++k) {
+            if (hashes[k] == hashes[i] && bits->bits_per_row[k] >= min_bits
+                    && bitbuffer_compare_rows(bits, i, k, max_bits))
+                break;
         }
+        if (k < i)
+            continue;
+        unsigned cnt = 0;
+        for (unsigned j = i; j < num_rows && cnt < min_repeats; ++j) {
+            if (hashes[j] == hashes[i] && bitbuffer_compare_rows(bits, i, j, max_bits))
+                ++cnt;
+        }
+        if (cnt >= min_repeats)
+            return i;
     }
     return -1;
 }
 
+int bitbuffer_find_repeated_row(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
+{
+    return bitbuffer_find_repeats(bits, min_repeats, min_bits, 0);
+}
+
+int bitbuffer_find_repeated_prefix(bitbuffer_t *bits, unsigned min_repeats, unsigned min_bits)
+{
+    return bitbuffer_find_repeats(bits, min_repeats, min_bits, min_bits);
+}
+
 // Unit testing
 #ifdef _TEST
 
@@ -583,6 +958,193 @@ int main(void)
     ASSERT(bits.bb[0][0] == 0xB1);
     ASSERT(bits.bb[0][1] == 0xA0);
 
+    fprintf(stderr, "TEST: bitbuffer:: invert and nrz_decode by word\n");
+    unsigned word_mismatches = 0; // compared to the bytewise decoding
+    for (unsigned len = 1; len <= 200; ++len) {
+        for (unsigned k = 0; k < 3; ++k) {
+            bitbuffer_clear(&bits);
+            bits.num_rows        = 1;
+            bits.bits_per_row[0] = len;
+            uint8_t ref[BITBUF_COLS];
+            for (unsigned i = 0; i < BITBUF_COLS; ++i)
+                bits.bb[0][i] = ref[i] = (uint8_t)(i * 151 + len * 7 + 13);
+            unsigned last_col  = (len - 1) / 8;
+            unsigned last_bits = ((len - 1) % 8) + 1;
+            int prev = 0;
+            for (unsigned col = 0; col <= last_col; ++col) {
+                int mask = (prev << 7) | ref[col] >> 1;
+                prev     = ref[col];
+                ref[col] = k == 0 ? ~ref[col] : k == 1 ? ref[col] ^ ~mask : ref[col] ^ mask;
+            }
+            if (k == 0)
+                ref[last_col] ^= 0xFF >> last_bits;
+            else
+                ref[last_col] &= 0xFF << (8 - last_bits);
+            if (k == 0)
+                bitbuffer_invert(&bits);
+            else if (k == 1)
+                bitbuffer_nrzs_decode(&bits);
+            else
+                bitbuffer_nrzm_decode(&bits);
+            word_mismatches += memcmp(bits.bb[0], ref, last_col + 1) != 0;
+        }
+    }
+    ASSERT(word_mismatches == 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: search\n");
+    bitbuffer_clear(&bits);
+    bitbuffer_parse(&bits, "{80}0123456789abcdef5555");
+    uint8_t const pattern_short[] = {0xAC}; // 011011
+    uint8_t const pattern_word[]  = {0x89, 0xab, 0xcd, 0xef, 0x55, 0x55, 0x00, 0x00};
+    uint8_t const pattern_long[]  = {0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0x55, 0x55};
+    unsigned mismatches = 0; // compared to the bitwise search
+    for (unsigned start = 0; start <= 80; ++start) {
+        for (unsigned plen = 1; plen <= 72; ++plen) {
+            for (unsigned k = 0; k < 3; ++k) {
+                uint8_t const *pattern = k == 0 ? pattern_short : k == 1 ? pattern_word : pattern_long;
+                if (plen > (k == 0 ? 6 : k == 1 ? 64 : 72))
+                    continue;
+                unsigned pos = bitbuffer_search(&bits, 0, start, pattern, plen);
+                if (pos != search_bits(bits.bb[0], 80, start, pattern, plen))
+                    mismatches++;
+            }
+        }
+    }
+    ASSERT(mismatches == 0);
+    ASSERT(bitbuffer_search(&bits, 0, 0, pattern_word, 48) == 32);
+    ASSERT(bitbuffer_search(&bits, 0, 0, pattern_long, 72) == 8);
+    ASSERT(bitbuffer_search(&bits, 0, 9, pattern_long, 72) == 80);
+    ASSERT(bitbuffer_search(&bits, 0, 0, pattern_short, 0) == 80);
+
+    fprintf(stderr, "TEST: bitbuffer:: manchester_decode\n");
+    bitbuffer_t decoded = {0};
+    bitbuffer_parse(&bits, "{24}559900");
+    ASSERT(bitbuffer_manchester_decode(&bits, 0, 0, &decoded, 0) == 18);
+    ASSERT(decoded.bits_per_row[0] == 8 && decoded.bb[0][0] == 0xF5);
+
+    fprintf(stderr, "TEST: bitbuffer:: differential_manchester_decode\n");
+    bitbuffer_clear(&decoded);
+    bitbuffer_parse(&bits, "{32}4acd5530");
+    ASSERT(bitbuffer_differential_manchester_decode(&bits, 0, 0, &decoded, 0) == 31);
+    ASSERT(decoded.bits_per_row[0] == 15 && decoded.bb[0][0] == 0x4E && decoded.bb[0][1] == 0x0E);
+
+    fprintf(stderr, "TEST: bitbuffer:: add_bits and add_run\n");
+    bitbuffer_t single = {0};
+    bitbuffer_clear(&bits);
+    for (unsigned k = 0; k < 300; ++k) {
+        unsigned count = k % 37;
+        if (k % 3) {
+            bitbuffer_add_run(&bits, k & 1, count);
+            for (unsigned i = 0; i < count; ++i)
+                bitbuffer_add_bit(&single, k & 1);
+        }
+        else {
+            uint32_t value = k * 0x9e3779b9;
+            bitbuffer_add_bits(&bits, value, count);
+            for (unsigned i = count < 32 ? count : 32; i > 0; --i)
+                bitbuffer_add_bit(&single, (value >> (i - 1)) & 1);
+        }
+        if (k % 150 == 149) { // rows spill over BITBUF_COLS
+            bitbuffer_add_row(&bits);
+            bitbuffer_add_row(&single);
+        }
+    }
+    ASSERT(memcmp(&bits, &single, sizeof(bits)) == 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: add_run into a full buffer\n");
+    bitbuffer_clear(&bits);
+    bitbuffer_clear(&single);
+    bitbuffer_add_run(&bits, 1, 4000000000u); // the excess is dropped at once
+    for (unsigned i = 0; i < BITBUF_ROWS * BITBUF_COLS * 8 + 10; ++i)
+        bitbuffer_add_bit(&single, 1);
+    ASSERT(memcmp(&bits, &single, sizeof(bits)) == 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: init, reset, and copy\n");
+    memset(&bits, 0xff, sizeof(bits)); // stale data
+    bitbuffer_init(&bits);
+    for (unsigned k = 0; k < 3; ++k) {
+        bitbuffer_clear(&single);
+        for (unsigned i = 0; i < 1500; ++i) {
+            if (i % 1100 == 1099) { // the first row spills
+                bitbuffer_add_row(&bits);
+                bitbuffer_add_row(&single);
+            }
+            bitbuffer_add_bit(&bits, i % 3 == 0);
+            bitbuffer_add_bit(&single, i % 3 == 0);
+        }
+        // the rows past the rows in use are zero as the decoders expect
+        ASSERT(memcmp(bits.bb, single.bb, sizeof(bits.bb)) == 0);
+        ASSERT(bits.num_rows == single.num_rows && bits.free_row == single.free_row
+                && !memcmp(bits.bits_per_row, single.bits_per_row, sizeof(bits.bits_per_row)));
+        bitbuffer_reset(&bits);
+        ASSERT(bits.num_rows == 0 && bits.bb[0][0] == 0 && bits.bb[1][0] == 0);
+        if (k == 1) { // a copy of fewer rows clears the other rows
+            bitbuffer_copy(&bits, &single);
+            bitbuffer_clear(&single);
+            bitbuffer_add_bits(&single, 0xa5, 8);
+            bitbuffer_copy(&bits, &single);
+            ASSERT(memcmp(&bits.bb, &single.bb, sizeof(bits.bb)) == 0);
+            bitbuffer_reset(&bits);
+        }
+    }
+
+    fprintf(stderr, "TEST: bitbuffer:: find_repeated_row and find_repeated_prefix\n");
+    mismatches = 0; // compared to counting the repeats of each row
+    srand(1);
+    for (unsigned k = 0; k < 1000; ++k) {
+        bitbuffer_clear(&bits);
+        unsigned num_rows = 1 + rand() % 12;
+        for (unsigned r = 0; r < num_rows; ++r) {
+            unsigned len = 8 + rand() % 3 * 4;
+            bitbuffer_add_bits(&bits, rand() % 4 * 0x1111 + (r % 3 == 0 ? rand() % 2 : 0), len);
+            if (r + 1 < num_rows)
+                bitbuffer_add_row(&bits);
+        }
+        unsigned min_repeats = 1 + rand() % 4;
+        unsigned min_bits    = rand() % 14;
+        int expect_row = -1, expect_prefix = -1;
+        for (int i = bits.num_rows - 1; i >= 0; --i) {
+            if (bits.bits_per_row[i] >= min_bits && bitbuffer_count_repeats(&bits, i, 0) >= min_repeats)
+                expect_row = i;
+            if (bits.bits_per_row[i] >= min_bits && bitbuffer_count_repeats(&bits, i, min_bits) >= min_repeats)
+                expect_prefix = i;
+        }
+        if (bitbuffer_find_repeated_row(&bits, min_repeats, min_bits) != expect_row
+                || bitbuffer_find_repeated_prefix(&bits, min_repeats, min_bits) != expect_prefix)
+            mismatches++;
+    }
+    ASSERT(mismatches == 0);
+
+    fprintf(stderr, "TEST: bitbuffer:: extract_bytes, extract_u32 and extract_u64\n");
+    mismatches = 0; // compared to extracting bit by bit
+    bitbuffer_clear(&bits);
+    bitbuffer_add_row(&bits);
+    for (unsigned i = 0; i < BITBUF_COLS; ++i) {
+        bits.bb[0][i] = rand();
+    }
+    bits.bits_per_row[0] = BITBUF_COLS * 8;
+    for (unsigned k = 0; k < 10000; ++k) {
+        unsigned len = rand() % 200;
+        unsigned pos = rand() % (BITBUF_COLS * 8 - len - 8);
+        uint8_t out[32] = {0};
+        uint8_t expect[32] = {0};
+        bitbuffer_extract_bytes(&bits, 0, pos, out, len);
+        for (unsigned i = 0; i < len; ++i) {
+            expect[i / 8] |= bit_at(bits.bb[0], pos + i) << (7 - i % 8);
+        }
+        if (memcmp(out, expect, (len + 7) / 8))
+            mismatches++;
+        unsigned count = 1 + len % 64;
+        uint64_t val = 0;
+        for (unsigned i = 0; i < count; ++i) {
+            val = val << 1 | bit_at(bits.bb[0], pos + i);
+        }
+        if (bitbuffer_extract_u64(&bits, 0, pos, count) != val
+                || (count <= 32 && bitbuffer_extract_u32(&bits, 0, pos, count) != val))
+            mismatches++;
+    }
+    ASSERT(mismatches == 0);
+
     fprintf(stderr, "TEST: bitbuffer:: Clear\n");
     bitbuffer_clear(&bits);
     ASSERT(bits.num_rows == 0);
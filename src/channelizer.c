@@ -0,0 +1,305 @@
+/** @file
+    Channelizer, splits one wideband capture into decimated sub-channels.
+
+    Each channel is mixed to baseband with a complex oscillator,
+    then a windowed-sinc low pass filter is evaluated in polyphase form,
+    i.e. only for every decimation-th input sample.
+    The channels are processed on a pool of worker threads, or on an OpenCL device.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "channelizer.h"
+#include "channelizer_cl.h"
+#include "decoder_pool.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+channelizer_t *channelizer_create(void)
+{
+    channelizer_t *chz = calloc(1, sizeof(*chz));
+    if (!chz) {
+        WARN_CALLOC("channelizer_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    return chz;
+}
+
+static void channel_free(channel_t *ch)
+{
+    free(ch->taps);
+    free(ch->mix_buf);
+    free(ch->out_buf);
+    free(ch);
+}
+
+void channelizer_free(channelizer_t *chz)
+{
+    if (!chz)
+        return;
+    decoder_pool_free(chz->pool);
+    list_free_elems(&chz->channels, (list_elem_free_fn)channel_free);
+    channelizer_cl_free(chz->cl);
+    free(chz->in_buf);
+    free(chz);
+}
+
+size_t channelizer_memory(channelizer_t const *chz)
+{
+    if (!chz)
+        return 0;
+    size_t bytes = sizeof(*chz) + chz->in_size * sizeof(*chz->in_buf) + channelizer_cl_memory(chz->cl);
+    for (size_t i = 0; i < chz->channels.len; ++i) {
+        channel_t const *ch = chz->channels.elems[i];
+        bytes += sizeof(*ch) + ch->num_taps * sizeof(*ch->taps) + ch->mix_size * sizeof(*ch->mix_buf) + ch->out_size * sizeof(*ch->out_buf);
+    }
+    return bytes;
+}
+
+int channelizer_set_backend(channelizer_t *chz, channelizer_backend_t backend, char const *device)
+{
+    channelizer_cl_free(chz->cl);
+    chz->cl = NULL;
+    if (backend == CHANNELIZER_OPENCL) {
+        chz->cl = channelizer_cl_create(device);
+        if (!chz->cl)
+            return -1;
+    }
+    chz->samp_rate = 0; // force a setup
+    return 0;
+}
+
+channel_t *channelizer_add(channelizer_t *chz, uint32_t frequency, uint32_t sample_rate)
+{
+    if (!sample_rate) {
+        fprintf(stderr, "%s: channel sample rate must not be zero\n", __func__);
+        return NULL;
+    }
+    if (chz->channels.len >= CHANNELIZER_MAX_CHANNELS) {
+        fprintf(stderr, "%s: max number of channels reached %d\n", __func__, CHANNELIZER_MAX_CHANNELS);
+        return NULL;
+    }
+    channel_t *ch = calloc(1, sizeof(*ch));
+    if (!ch) {
+        WARN_CALLOC("channelizer_add()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    ch->frequency   = frequency;
+    ch->sample_rate = sample_rate;
+    list_push(&chz->channels, ch);
+    chz->samp_rate = 0; // force a setup
+#ifdef THREADS
+    // a worker for each channel but one, the calling thread processes a channel too
+    decoder_pool_free(chz->pool);
+    chz->pool = decoder_pool_create((unsigned)chz->channels.len - 1);
+#endif
+    return ch;
+}
+
+/// Set up the oscillator and the filter for the current input.
+static void channel_setup(channel_t *ch, uint32_t center_frequency, uint32_t samp_rate)
+{
+    unsigned decimation = (samp_rate + ch->sample_rate / 2) / ch->sample_rate;
+    if (decimation < 1)
+        decimation = 1;
+    ch->decimation = 0;
+    ch->out_rate   = samp_rate / decimation;
+    ch->out_len    = 0;
+
+    double offset = (double)ch->frequency - center_frequency;
+    if (fabs(offset) + ch->out_rate / 2.0 > samp_rate / 2.0) {
+        fprintf(stderr, "%s: channel %u Hz is outside of the captured band %u Hz +/- %u Hz\n",
+                __func__, ch->frequency, center_frequency, samp_rate / 2);
+        return;
+    }
+
+    unsigned num_taps = CHANNELIZER_TAPS_PER_STEP * decimation + 1;
+    float *taps = realloc(ch->taps, num_taps * sizeof(*taps));
+    if (!taps) {
+        WARN_REALLOC("channel_setup()");
+        return;
+    }
+    ch->taps     = taps;
+    ch->num_taps = num_taps;
+
+    // windowed-sinc (Hamming) low pass at 0.9 of the output Nyquist
+    double cutoff = 0.45 / decimation;
+    double gain   = 0.0;
+    for (unsigned k = 0; k < num_taps; ++k) {
+        double m = k - (num_taps - 1) / 2.0;
+        double h = m == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * m) / (M_PI * m);
+        h *= 0.54 - 0.46 * cos(2.0 * M_PI * k / (num_taps - 1));
+        taps[k] = h;
+        gain += h;
+    }
+    for (unsigned k = 0; k < num_taps; ++k) {
+        taps[k] /= gain;
+    }
+
+    // the oscillator shifts the channel down to 0 Hz
+    double w    = -2.0 * M_PI * offset / samp_rate;
+    ch->step_re = cos(w);
+    ch->step_im = sin(w);
+    ch->lo_re   = 1.0f;
+    ch->lo_im   = 0.0f;
+
+    ch->skip       = 0;
+    ch->decimation = decimation;
+    ch->mix_size   = 0; // clear the history
+
+    fprintf(stderr, "Channel %u Hz at offset %.0f Hz, %u Hz sample rate, decimation %u, %u taps\n",
+            ch->frequency, offset, ch->out_rate, decimation, num_taps);
+}
+
+/// Mix, filter, and decimate the current input of one channel.
+static void channel_process(channel_t *ch)
+{
+    if (!ch->decimation) {
+        ch->out_len = 0;
+        return;
+    }
+
+    unsigned long n_samples = ch->in_len;
+    unsigned hist = ch->num_taps - 1;
+    if (ch->mix_size < (hist + n_samples) * 2) {
+        int clear      = !ch->mix_size;
+        float *mix_buf = realloc(ch->mix_buf, (hist + n_samples) * 2 * sizeof(*mix_buf));
+        if (!mix_buf) {
+            WARN_REALLOC("channel_process()");
+            ch->out_len = 0;
+            return;
+        }
+        ch->mix_buf  = mix_buf;
+        ch->mix_size = (hist + n_samples) * 2;
+        if (clear)
+            memset(ch->mix_buf, 0, hist * 2 * sizeof(*mix_buf));
+    }
+    unsigned long out_max = n_samples / ch->decimation + 1;
+    if (ch->out_size < out_max * 2) {
+        int16_t *out_buf = realloc(ch->out_buf, out_max * 2 * sizeof(*out_buf));
+        if (!out_buf) {
+            WARN_REALLOC("channel_process()");
+            ch->out_len = 0;
+            return;
+        }
+        ch->out_buf  = out_buf;
+        ch->out_size = out_max * 2;
+    }
+
+    // Mix to baseband
+    float const *x = ch->in_buf;
+    float *y       = &ch->mix_buf[hist * 2];
+    float lo_re    = ch->lo_re;
+    float lo_im    = ch->lo_im;
+    for (unsigned long i = 0; i < n_samples; ++i) {
+        y[2 * i]     = x[2 * i] * lo_re - x[2 * i + 1] * lo_im;
+        y[2 * i + 1] = x[2 * i] * lo_im + x[2 * i + 1] * lo_re;
+        float t = lo_re * ch->step_re - lo_im * ch->step_im;
+        lo_im   = lo_re * ch->step_im + lo_im * ch->step_re;
+        lo_re   = t;
+        if ((i & 1023) == 1023) {
+            // keep the oscillator on the unit circle, first order approximation of 1/sqrt()
+            float g = 1.5f - 0.5f * (lo_re * lo_re + lo_im * lo_im);
+            lo_re *= g;
+            lo_im *= g;
+        }
+    }
+    ch->lo_re = lo_re;
+    ch->lo_im = lo_im;
+
+    // Low pass filter, evaluated only at the decimated output positions
+    float const *taps = ch->taps;
+    unsigned num_taps = ch->num_taps;
+    unsigned long n   = ch->skip;
+    unsigned long len = 0;
+    for (; n < n_samples; n += ch->decimation) {
+        float const *s = &ch->mix_buf[n * 2]; // oldest sample in the filter window
+        float acc_re   = 0.0f;
+        float acc_im   = 0.0f;
+        for (unsigned k = 0; k < num_taps; ++k) {
+            acc_re += taps[k] * s[2 * k];
+            acc_im += taps[k] * s[2 * k + 1];
+        }
+        acc_re = acc_re > INT16_MAX ? INT16_MAX : acc_re < INT16_MIN ? INT16_MIN : acc_re;
+        acc_im = acc_im > INT16_MAX ? INT16_MAX : acc_im < INT16_MIN ? INT16_MIN : acc_im;
+        ch->out_buf[len * 2]     = (int16_t)acc_re;
+        ch->out_buf[len * 2 + 1] = (int16_t)acc_im;
+        len++;
+    }
+    ch->skip    = n - n_samples;
+    ch->out_len = len;
+
+    // Keep the history for the next buffer
+    memmove(ch->mix_buf, &ch->mix_buf[n_samples * 2], hist * 2 * sizeof(*ch->mix_buf));
+}
+
+/// Process one channel of the input, a job of the pool.
+static void channel_job(void *ctx, unsigned job)
+{
+    channelizer_t *chz = ctx;
+    channel_process(chz->channels.elems[job]);
+}
+
+void channelizer_process(channelizer_t *chz, uint8_t const *iq_buf, unsigned long n_samples, int sample_size, uint32_t center_frequency, uint32_t samp_rate)
+{
+    int setup = chz->center_frequency != center_frequency || chz->samp_rate != samp_rate;
+    if (setup) {
+        for (void **iter = chz->channels.elems; iter && *iter; ++iter) {
+            channel_setup(*iter, center_frequency, samp_rate);
+        }
+        chz->center_frequency = center_frequency;
+        chz->samp_rate        = samp_rate;
+    }
+
+    if (chz->cl) {
+        if (!channelizer_cl_process(chz->cl, chz, iq_buf, n_samples, sample_size, setup))
+            return;
+        fprintf(stderr, "%s: OpenCL failed, processing the channels on the CPU\n", __func__);
+        channelizer_cl_free(chz->cl);
+        chz->cl = NULL;
+        for (void **iter = chz->channels.elems; iter && *iter; ++iter) {
+            channel_t *ch = *iter;
+            ch->mix_size  = 0; // clear the history
+        }
+    }
+
+    // Convert the input once for all channels
+    if (chz->in_size < n_samples * 2) {
+        float *in_buf = realloc(chz->in_buf, n_samples * 2 * sizeof(*in_buf));
+        if (!in_buf) {
+            WARN_REALLOC("channelizer_process()");
+            return;
+        }
+        chz->in_buf  = in_buf;
+        chz->in_size = n_samples * 2;
+    }
+    if (sample_size == 2) { // CU8
+        for (unsigned long n = 0; n < n_samples * 2; ++n)
+            chz->in_buf[n] = (iq_buf[n] - 128) * 256; // scale Q0.7 to Q0.15
+    }
+    else { // CS16
+        int16_t const *cs16_buf = (int16_t const *)iq_buf;
+        for (unsigned long n = 0; n < n_samples * 2; ++n)
+            chz->in_buf[n] = cs16_buf[n];
+    }
+
+    for (void **iter = chz->channels.elems; iter && *iter; ++iter) {
+        channel_t *ch = *iter;
+        ch->in_buf    = chz->in_buf;
+        ch->in_len    = n_samples;
+    }
+
+    // without a pool the channels are processed in order on this thread
+    decoder_pool_run(chz->pool, (unsigned)chz->channels.len, channel_job, chz);
+}
@@ -0,0 +1,544 @@
+/** @file
+    OpenCL backend of the channelizer.
+
+    The oscillator of a channel is folded into the filter, the taps are turned
+    by the oscillator step, h[k] e^(iwk), and each output sample is the filtered
+    raw input turned by the oscillator at the start of its window.
+    The device only evaluates the decimated outputs, the oscillator of each
+    output is computed on the host in double precision.
+
+    A buffer is split into blocks, the blocks alternate between two sets of
+    device buffers on two queues, so the upload of a block overlaps the filter
+    of the previous block, and the host copies out the outputs of the block
+    before while both run.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "channelizer_cl.h"
+#include "channelizer.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef OPENCL
+
+#include <math.h>
+
+#define CL_TARGET_OPENCL_VERSION 120
+#ifdef __APPLE__
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define CL_PARAMS 6 ///< per channel: tap offset, taps, decimation, first window, output offset, outputs
+
+static char const cl_source[] =
+        "float2 load(__global const char *in, uint i, uint cu8)\n"
+        "{\n"
+        "    if (cu8)\n"
+        "        return (convert_float2(vload2(i, (__global const uchar *)in)) - 128.0f) * 256.0f;\n"
+        "    return convert_float2(vload2(i, (__global const short *)in));\n"
+        "}\n"
+        "\n"
+        "__kernel void channelize(__global const char *in, uint cu8, __global const float2 *taps,\n"
+        "        __global const uint *param, __global const float2 *lo, __global short2 *out)\n"
+        "{\n"
+        "    uint m = get_global_id(0);\n"
+        "    __global const uint *p = param + get_global_id(1) * 6;\n"
+        "    if (m >= p[5])\n"
+        "        return;\n"
+        "    __global const float2 *g = taps + p[0];\n"
+        "    uint s = p[3] + m * p[2];\n"
+        "    float2 acc = (float2)(0.0f, 0.0f);\n"
+        "    for (uint k = 0; k < p[1]; ++k) {\n"
+        "        float2 x = load(in, s + k, cu8);\n"
+        "        acc += (float2)(g[k].x * x.x - g[k].y * x.y, g[k].x * x.y + g[k].y * x.x);\n"
+        "    }\n"
+        "    float2 l = lo[p[4] + m];\n"
+        "    out[p[4] + m] = convert_short2_sat((float2)(l.x * acc.x - l.y * acc.y, l.x * acc.y + l.y * acc.x));\n"
+        "}\n";
+
+/// A set of device buffers with its queue, the blocks alternate between the sets.
+typedef struct cl_set {
+    cl_command_queue queue;
+    cl_mem in;
+    cl_mem param;
+    cl_mem lo;
+    cl_mem out;
+    size_t in_bytes;
+    size_t lo_bytes;
+    size_t out_bytes;
+    cl_uint param_buf[CHANNELIZER_MAX_CHANNELS * CL_PARAMS];
+    float *lo_buf;    ///< oscillator at each output, I/Q pairs
+    int16_t *out_buf; ///< outputs read back, I/Q pairs
+    size_t host_num;  ///< output samples of lo_buf and out_buf
+    int pending;      ///< a block is enqueued, the outputs are not copied out yet
+} cl_set_t;
+
+struct channelizer_cl {
+    cl_context context;
+    cl_device_id device;
+    cl_program program;
+    cl_kernel kernel;
+    cl_set_t sets[2];
+    cl_mem taps;
+    size_t taps_bytes;
+    unsigned hist;    ///< history samples kept, the longest filter of the channels less one
+    uint8_t *stage;   ///< raw input, the history followed by the current buffer
+    size_t stage_size;
+    int sample_size;  ///< of the staged samples, 0 to set up
+    unsigned tap_offset[CHANNELIZER_MAX_CHANNELS];
+    double step[CHANNELIZER_MAX_CHANNELS];  ///< oscillator step per input sample in radians
+    double phase[CHANNELIZER_MAX_CHANNELS]; ///< oscillator phase at the first sample of the current buffer
+};
+
+static int cl_check(cl_int err, char const *what)
+{
+    if (err == CL_SUCCESS)
+        return 0;
+    fprintf(stderr, "channelizer: OpenCL error %d in %s\n", (int)err, what);
+    return -1;
+}
+
+/// Replace a device buffer with a larger one, the content is not kept.
+static int cl_grow(channelizer_cl_t *cl, cl_mem *mem, size_t *bytes, size_t need, cl_mem_flags flags)
+{
+    if (*bytes >= need)
+        return 0;
+    if (*mem)
+        clReleaseMemObject(*mem);
+    *bytes = 0;
+    cl_int err;
+    *mem = clCreateBuffer(cl->context, flags, need, NULL, &err);
+    if (cl_check(err, "clCreateBuffer()"))
+        return -1;
+    *bytes = need;
+    return 0;
+}
+
+/// Find a device by index, or the first GPU, or else the first device.
+static cl_device_id cl_find_device(char const *device)
+{
+    cl_platform_id platforms[16];
+    cl_uint num_platforms = 0;
+    if (clGetPlatformIDs(16, platforms, &num_platforms) != CL_SUCCESS || !num_platforms) {
+        fprintf(stderr, "channelizer: no OpenCL platform found\n");
+        return NULL;
+    }
+    if (num_platforms > 16)
+        num_platforms = 16;
+
+    cl_device_id devices[16];
+    cl_uint num_devices = 0;
+    if (device) {
+        char *end;
+        unsigned long platform_idx = strtoul(device, &end, 10);
+        unsigned long device_idx   = *end == '.' ? strtoul(end + 1, &end, 10) : 0;
+        if (*end || platform_idx >= num_platforms
+                || clGetDeviceIDs(platforms[platform_idx], CL_DEVICE_TYPE_ALL, 16, devices, &num_devices) != CL_SUCCESS
+                || device_idx >= num_devices || device_idx >= 16) {
+            fprintf(stderr, "channelizer: no OpenCL device \"%s\" of %u platforms\n", device, (unsigned)num_platforms);
+            return NULL;
+        }
+        return devices[device_idx];
+    }
+    for (cl_uint i = 0; i < num_platforms; ++i) {
+        if (clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_GPU, 1, devices, &num_devices) == CL_SUCCESS && num_devices)
+            return devices[0];
+    }
+    for (cl_uint i = 0; i < num_platforms; ++i) {
+        if (clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_ALL, 1, devices, &num_devices) == CL_SUCCESS && num_devices)
+            return devices[0];
+    }
+    fprintf(stderr, "channelizer: no OpenCL device found\n");
+    return NULL;
+}
+
+channelizer_cl_t *channelizer_cl_create(char const *device)
+{
+    cl_device_id dev = cl_find_device(device);
+    if (!dev)
+        return NULL;
+
+    channelizer_cl_t *cl = calloc(1, sizeof(*cl));
+    if (!cl) {
+        WARN_CALLOC("channelizer_cl_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    cl->device = dev;
+
+    cl_int err;
+    cl->context = clCreateContext(NULL, 1, &dev, NULL, NULL, &err);
+    if (cl_check(err, "clCreateContext()")) {
+        channelizer_cl_free(cl);
+        return NULL;
+    }
+    for (unsigned i = 0; i < 2; ++i) {
+        cl_set_t *set = &cl->sets[i];
+        set->queue    = clCreateCommandQueue(cl->context, dev, 0, &err);
+        if (cl_check(err, "clCreateCommandQueue()")) {
+            channelizer_cl_free(cl);
+            return NULL;
+        }
+        set->param = clCreateBuffer(cl->context, CL_MEM_READ_ONLY, sizeof(set->param_buf), NULL, &err);
+        if (cl_check(err, "clCreateBuffer()")) {
+            channelizer_cl_free(cl);
+            return NULL;
+        }
+    }
+
+    char const *source = cl_source;
+    cl->program        = clCreateProgramWithSource(cl->context, 1, &source, NULL, &err);
+    if (cl_check(err, "clCreateProgramWithSource()")) {
+        channelizer_cl_free(cl);
+        return NULL;
+    }
+    err = clBuildProgram(cl->program, 1, &dev, "", NULL, NULL);
+    if (err != CL_SUCCESS) {
+        char log[4096] = {0};
+        clGetProgramBuildInfo(cl->program, dev, CL_PROGRAM_BUILD_LOG, sizeof(log) - 1, log, NULL);
+        fprintf(stderr, "channelizer: OpenCL build failed (%d):\n%s\n", (int)err, log);
+        channelizer_cl_free(cl);
+        return NULL;
+    }
+    cl->kernel = clCreateKernel(cl->program, "channelize", &err);
+    if (cl_check(err, "clCreateKernel()")) {
+        channelizer_cl_free(cl);
+        return NULL;
+    }
+
+    char name[256] = {0};
+    clGetDeviceInfo(dev, CL_DEVICE_NAME, sizeof(name) - 1, name, NULL);
+    fprintf(stderr, "Channelizer on OpenCL device %s\n", name);
+    return cl;
+}
+
+void channelizer_cl_free(channelizer_cl_t *cl)
+{
+    if (!cl)
+        return;
+    for (unsigned i = 0; i < 2; ++i) {
+        cl_set_t *set = &cl->sets[i];
+        if (set->queue)
+            clFinish(set->queue);
+        if (set->in)
+            clReleaseMemObject(set->in);
+        if (set->param)
+            clReleaseMemObject(set->param);
+        if (set->lo)
+            clReleaseMemObject(set->lo);
+        if (set->out)
+            clReleaseMemObject(set->out);
+        if (set->queue)
+            clReleaseCommandQueue(set->queue);
+        free(set->lo_buf);
+        free(set->out_buf);
+    }
+    if (cl->taps)
+        clReleaseMemObject(cl->taps);
+    if (cl->kernel)
+        clReleaseKernel(cl->kernel);
+    if (cl->program)
+        clReleaseProgram(cl->program);
+    if (cl->context)
+        clReleaseContext(cl->context);
+    free(cl->stage);
+    free(cl);
+}
+
+size_t channelizer_cl_memory(channelizer_cl_t const *cl)
+{
+    if (!cl)
+        return 0;
+    size_t bytes = sizeof(*cl) + cl->stage_size;
+    for (unsigned i = 0; i < 2; ++i) {
+        bytes += cl->sets[i].host_num * 2 * (sizeof(*cl->sets[i].lo_buf) + sizeof(*cl->sets[i].out_buf));
+    }
+    return bytes;
+}
+
+/// Upload the turned taps of all channels and clear the history.
+static int cl_setup(channelizer_cl_t *cl, channelizer_t *chz, int sample_size)
+{
+    unsigned total = 0;
+    cl->hist       = 0;
+    for (size_t i = 0; i < chz->channels.len; ++i) {
+        channel_t const *ch = chz->channels.elems[i];
+        cl->tap_offset[i]   = total;
+        cl->step[i]         = -2.0 * M_PI * ((double)ch->frequency - chz->center_frequency) / chz->samp_rate;
+        cl->phase[i]        = 0.0;
+        if (!ch->decimation)
+            continue;
+        total += ch->num_taps;
+        if (cl->hist < ch->num_taps - 1)
+            cl->hist = ch->num_taps - 1;
+    }
+    cl->sample_size = sample_size;
+    free(cl->stage); // the history is cleared
+    cl->stage      = NULL;
+    cl->stage_size = 0;
+    if (!total)
+        return 0;
+
+    float *taps = malloc(total * 2 * sizeof(*taps));
+    if (!taps) {
+        WARN_MALLOC("cl_setup()");
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    for (size_t i = 0; i < chz->channels.len; ++i) {
+        channel_t const *ch = chz->channels.elems[i];
+        float *g            = &taps[cl->tap_offset[i] * 2];
+        for (unsigned k = 0; ch->decimation && k < ch->num_taps; ++k) {
+            g[2 * k]     = (float)(ch->taps[k] * cos(cl->step[i] * k));
+            g[2 * k + 1] = (float)(ch->taps[k] * sin(cl->step[i] * k));
+        }
+    }
+    int r = cl_grow(cl, &cl->taps, &cl->taps_bytes, total * 2 * sizeof(*taps), CL_MEM_READ_ONLY);
+    if (!r)
+        r = cl_check(clEnqueueWriteBuffer(cl->sets[0].queue, cl->taps, CL_TRUE, 0, total * 2 * sizeof(*taps), taps, 0, NULL, NULL), "clEnqueueWriteBuffer()");
+    free(taps);
+    return r;
+}
+
+/// Wait for the block of a set and append its outputs to the channels.
+static int cl_collect(channelizer_t *chz, cl_set_t *set)
+{
+    if (!set->pending)
+        return 0;
+    set->pending = 0;
+    if (cl_check(clFinish(set->queue), "clFinish()"))
+        return -1;
+    for (size_t i = 0; i < chz->channels.len; ++i) {
+        channel_t *ch    = chz->channels.elems[i];
+        cl_uint const *p = &set->param_buf[i * CL_PARAMS];
+        if (!p[5])
+            continue;
+        memcpy(&ch->out_buf[ch->out_len * 2], &set->out_buf[p[4] * 2], p[5] * 2 * sizeof(*ch->out_buf));
+        ch->out_len += p[5];
+    }
+    return 0;
+}
+
+/** Enqueue the outputs of the channels with the window start in a block of the staged input.
+
+    @param begin the first staged sample of the block
+    @param in_len the staged samples of the block, with the history for the last windows
+*/
+static int cl_enqueue(channelizer_cl_t *cl, channelizer_t *chz, cl_set_t *set, unsigned long begin, unsigned long in_len, unsigned long n_samples)
+{
+    unsigned long end = begin + CHANNELIZER_CL_BLOCK;
+
+    // the outputs of each channel in the block
+    size_t outs      = 0;
+    cl_uint max_outs = 0;
+    for (size_t i = 0; i < chz->channels.len; ++i) {
+        channel_t const *ch = chz->channels.elems[i];
+        cl_uint *p          = &set->param_buf[i * CL_PARAMS];
+        memset(p, 0, CL_PARAMS * sizeof(*p));
+        if (!ch->decimation || ch->skip >= n_samples)
+            continue;
+        unsigned dec        = ch->decimation;
+        unsigned long first = cl->hist - (ch->num_taps - 1) + ch->skip; // staged window start of the first output
+        unsigned long num   = (n_samples - ch->skip + dec - 1) / dec;
+        unsigned long m0    = begin > first ? (begin - first + dec - 1) / dec : 0;
+        unsigned long m1    = end > first ? (end - first + dec - 1) / dec : 0;
+        if (m1 > num)
+            m1 = num;
+        if (m0 >= m1)
+            continue;
+        p[0] = cl->tap_offset[i];
+        p[1] = ch->num_taps;
+        p[2] = dec;
+        p[3] = (cl_uint)(first + m0 * dec - begin);
+        p[4] = (cl_uint)outs;
+        p[5] = (cl_uint)(m1 - m0);
+        outs += p[5];
+        if (max_outs < p[5])
+            max_outs = p[5];
+    }
+    if (!outs)
+        return 0;
+
+    if (set->host_num < outs) {
+        float *lo_buf = realloc(set->lo_buf, outs * 2 * sizeof(*lo_buf));
+        if (!lo_buf) {
+            WARN_REALLOC("cl_enqueue()");
+            return -1; // NOTE: returns error on alloc failure.
+        }
+        set->lo_buf      = lo_buf;
+        int16_t *out_buf = realloc(set->out_buf, outs * 2 * sizeof(*out_buf));
+        if (!out_buf) {
+            WARN_REALLOC("cl_enqueue()");
+            return -1; // NOTE: returns error on alloc failure.
+        }
+        set->out_buf  = out_buf;
+        set->host_num = outs;
+    }
+
+    // the oscillator at the window start of each output, relative to the first sample of the current buffer
+    for (size_t i = 0; i < chz->channels.len; ++i) {
+        cl_uint const *p = &set->param_buf[i * CL_PARAMS];
+        if (!p[5])
+            continue;
+        double w     = cl->step[i];
+        double phase = cl->phase[i] + w * ((double)(begin + p[3]) - cl->hist);
+        double re    = cos(phase);
+        double im    = sin(phase);
+        double s_re  = cos(w * p[2]);
+        double s_im  = sin(w * p[2]);
+        float *lo    = &set->lo_buf[p[4] * 2];
+        for (cl_uint m = 0; m < p[5]; ++m) {
+            lo[2 * m]     = (float)re;
+            lo[2 * m + 1] = (float)im;
+            double t = re * s_re - im * s_im;
+            im       = re * s_im + im * s_re;
+            re       = t;
+        }
+    }
+
+    size_t in_bytes = in_len * cl->sample_size;
+    if (cl_grow(cl, &set->in, &set->in_bytes, in_bytes, CL_MEM_READ_ONLY))
+        return -1;
+    if (cl_grow(cl, &set->lo, &set->lo_bytes, outs * 2 * sizeof(float), CL_MEM_READ_ONLY))
+        return -1;
+    if (cl_grow(cl, &set->out, &set->out_bytes, outs * 2 * sizeof(int16_t), CL_MEM_WRITE_ONLY))
+        return -1;
+
+    cl_command_queue queue = set->queue;
+    cl_uint cu8            = cl->sample_size == 2;
+    cl_uint num_channels   = (cl_uint)chz->channels.len;
+    size_t global[2]       = {(max_outs + 63) / 64 * 64, num_channels};
+    if (cl_check(clEnqueueWriteBuffer(queue, set->in, CL_FALSE, 0, in_bytes, &cl->stage[begin * cl->sample_size], 0, NULL, NULL), "clEnqueueWriteBuffer()")
+            || cl_check(clEnqueueWriteBuffer(queue, set->param, CL_FALSE, 0, num_channels * CL_PARAMS * sizeof(cl_uint), set->param_buf, 0, NULL, NULL), "clEnqueueWriteBuffer()")
+            || cl_check(clEnqueueWriteBuffer(queue, set->lo, CL_FALSE, 0, outs * 2 * sizeof(float), set->lo_buf, 0, NULL, NULL), "clEnqueueWriteBuffer()")
+            || cl_check(clSetKernelArg(cl->kernel, 0, sizeof(cl_mem), &set->in), "clSetKernelArg()")
+            || cl_check(clSetKernelArg(cl->kernel, 1, sizeof(cl_uint), &cu8), "clSetKernelArg()")
+            || cl_check(clSetKernelArg(cl->kernel, 2, sizeof(cl_mem), &cl->taps), "clSetKernelArg()")
+            || cl_check(clSetKernelArg(cl->kernel, 3, sizeof(cl_mem), &set->param), "clSetKernelArg()")
+            || cl_check(clSetKernelArg(cl->kernel, 4, sizeof(cl_mem), &set->lo), "clSetKernelArg()")
+            || cl_check(clSetKernelArg(cl->kernel, 5, sizeof(cl_mem), &set->out), "clSetKernelArg()")
+            || cl_check(clEnqueueNDRangeKernel(queue, cl->kernel, 2, NULL, global, NULL, 0, NULL, NULL), "clEnqueueNDRangeKernel()")
+            || cl_check(clEnqueueReadBuffer(queue, set->out, CL_FALSE, 0, outs * 2 * sizeof(int16_t), set->out_buf, 0, NULL, NULL), "clEnqueueReadBuffer()")
+            || cl_check(clFlush(queue), "clFlush()"))
+        return -1;
+    set->pending = 1;
+    return 0;
+}
+
+int channelizer_cl_process(channelizer_cl_t *cl, channelizer_t *chz, uint8_t const *iq_buf, unsigned long n_samples, int sample_size, int setup)
+{
+    if (setup || cl->sample_size != sample_size) {
+        if (cl_setup(cl, chz, sample_size))
+            return -1;
+    }
+
+    // stage the raw input after the history
+    unsigned long total = cl->hist + n_samples;
+    if (cl->stage_size < total * sample_size) {
+        int clear      = !cl->stage;
+        uint8_t *stage = realloc(cl->stage, total * sample_size);
+        if (!stage) {
+            WARN_REALLOC("channelizer_cl_process()");
+            return -1; // NOTE: returns error on alloc failure.
+        }
+        cl->stage      = stage;
+        cl->stage_size = total * sample_size;
+        if (clear)
+            memset(cl->stage, sample_size == 2 ? 128 : 0, cl->hist * sample_size); // zero level
+    }
+    memcpy(&cl->stage[cl->hist * sample_size], iq_buf, n_samples * sample_size);
+
+    for (size_t i = 0; i < chz->channels.len; ++i) {
+        channel_t *ch         = chz->channels.elems[i];
+        ch->out_len           = 0;
+        unsigned long out_max = ch->decimation ? n_samples / ch->decimation + 1 : 0;
+        if (ch->out_size < out_max * 2) {
+            int16_t *out_buf = realloc(ch->out_buf, out_max * 2 * sizeof(*out_buf));
+            if (!out_buf) {
+                WARN_REALLOC("channelizer_cl_process()");
+                return -1; // NOTE: returns error on alloc failure.
+            }
+            ch->out_buf  = out_buf;
+            ch->out_size = out_max * 2;
+        }
+    }
+
+    // double buffered: the block of a set is collected before the set is reused
+    unsigned num_blocks = (unsigned)((total + CHANNELIZER_CL_BLOCK - 1) / CHANNELIZER_CL_BLOCK);
+    int r               = 0;
+    for (unsigned b = 0; !r && b < num_blocks; ++b) {
+        cl_set_t *set       = &cl->sets[b & 1];
+        unsigned long begin = (unsigned long)b * CHANNELIZER_CL_BLOCK;
+        unsigned long end   = begin + CHANNELIZER_CL_BLOCK + cl->hist;
+        r                   = cl_collect(chz, set);
+        if (!r)
+            r = cl_enqueue(cl, chz, set, begin, (end < total ? end : total) - begin, n_samples);
+    }
+    if (!r)
+        r = cl_collect(chz, &cl->sets[num_blocks & 1]);
+    if (!r)
+        r = cl_collect(chz, &cl->sets[(num_blocks + 1) & 1]);
+    if (r) {
+        for (unsigned i = 0; i < 2; ++i) {
+            clFinish(cl->sets[i].queue);
+            cl->sets[i].pending = 0;
+        }
+        return -1;
+    }
+
+    for (size_t i = 0; i < chz->channels.len; ++i) {
+        channel_t *ch = chz->channels.elems[i];
+        if (!ch->decimation)
+            continue;
+        ch->skip     = (unsigned)(ch->skip + ch->out_len * ch->decimation - n_samples);
+        cl->phase[i] = fmod(cl->phase[i] + cl->step[i] * n_samples, 2.0 * M_PI);
+        ch->lo_re    = (float)cos(cl->phase[i]); // the CPU continues from here on a fallback
+        ch->lo_im    = (float)sin(cl->phase[i]);
+    }
+    memmove(cl->stage, &cl->stage[n_samples * sample_size], cl->hist * sample_size);
+    return 0;
+}
+
+#else
+
+channelizer_cl_t *channelizer_cl_create(char const *device)
+{
+    (void)device;
+    fprintf(stderr, "channelizer: this build has no OpenCL support\n");
+    return NULL;
+}
+
+void channelizer_cl_free(channelizer_cl_t *cl)
+{
+    (void)cl;
+}
+
+size_t channelizer_cl_memory(channelizer_cl_t const *cl)
+{
+    (void)cl;
+    return 0;
+}
+
+int channelizer_cl_process(channelizer_cl_t *cl, struct channelizer *chz, uint8_t const *iq_buf, unsigned long n_samples, int sample_size, int setup)
+{
+    (void)cl;
+    (void)chz;
+    (void)iq_buf;
+    (void)n_samples;
+    (void)sample_size;
+    (void)setup;
+    return -1;
+}
+
+#endif
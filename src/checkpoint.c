@@ -0,0 +1,84 @@
+/** @file
+    Checkpoints of an offline run, to resume an interrupted run of the input files.
+
+    A checkpoint is a header with the layout version and the size of the checkpoint,
+    followed by the checkpoint as is. It is written to a temporary file first
+    and renamed over the previous checkpoint.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "checkpoint.h"
+#include "fatal.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECKPOINT_MAGIC "rtl433cp"
+#define CHECKPOINT_VERSION 1
+
+typedef struct checkpoint_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t size;
+} checkpoint_header_t;
+
+int checkpoint_write(char const *path, checkpoint_t const *checkpoint)
+{
+    size_t tmp_size = strlen(path) + 5;
+    char *tmp_path  = malloc(tmp_size);
+    if (!tmp_path) {
+        WARN_MALLOC("checkpoint_write()");
+        return -1;
+    }
+    snprintf(tmp_path, tmp_size, "%s.tmp", path);
+
+    checkpoint_header_t header = {.version = CHECKPOINT_VERSION, .size = sizeof(*checkpoint)};
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Writing checkpoint: %s failed!\n", tmp_path);
+        free(tmp_path);
+        return -1;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(checkpoint, sizeof(*checkpoint), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+#ifdef _WIN32
+    // rename() does not replace an existing file
+    if (ok)
+        remove(path);
+#endif
+    if (!ok || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Writing checkpoint: %s failed!\n", path);
+        remove(tmp_path);
+        free(tmp_path);
+        return -1;
+    }
+    free(tmp_path);
+    return 0;
+}
+
+int checkpoint_read(char const *path, checkpoint_t *checkpoint)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return errno == ENOENT ? 1 : -1;
+
+    checkpoint_header_t header;
+    int ok = fread(&header, sizeof(header), 1, file) == 1
+            && memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) == 0
+            && header.version == CHECKPOINT_VERSION
+            && header.size == sizeof(*checkpoint)
+            && fread(checkpoint, sizeof(*checkpoint), 1, file) == 1;
+    fclose(file);
+    if (!ok)
+        return -1;
+    checkpoint->file_name[CHECKPOINT_NAME_SIZE - 1] = '\0';
+    return 0;
+}
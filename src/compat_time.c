@@ -33,6 +33,58 @@ int gettimeofday(struct timeval *tv, void *tz)
     return 0;
 }
 
+double monotonic_time_us(void)
+{
+    LARGE_INTEGER freq, count;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart * 1e6 / (double)freq.QuadPart;
+}
+
+void monotonic_sleep_until_us(double deadline_us)
+{
+    double delay_us = deadline_us - monotonic_time_us();
+    if (delay_us >= 1000.0)
+        Sleep((DWORD)(delay_us / 1000.0));
+}
+
+#else
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h> // _POSIX_TIMERS
+
+double monotonic_time_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+void monotonic_sleep_until_us(double deadline_us)
+{
+#if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && !defined(__APPLE__)
+    struct timespec ts;
+    ts.tv_sec  = (time_t)(deadline_us / 1e6);
+    ts.tv_nsec = (long)((deadline_us - ts.tv_sec * 1e6) * 1e3);
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec += 1;
+        ts.tv_nsec -= 1000000000L;
+    }
+    // an absolute wake up on the same clock as monotonic_time_us()
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+#else
+    double delay_us = deadline_us - monotonic_time_us();
+    if (delay_us <= 0.0)
+        return;
+    struct timespec ts;
+    ts.tv_sec  = (time_t)(delay_us / 1e6);
+    ts.tv_nsec = (long)((delay_us - ts.tv_sec * 1e6) * 1e3);
+    nanosleep(&ts, NULL);
+#endif
+}
+
 #endif // _WIN32
 
 int timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y)
@@ -0,0 +1,89 @@
+/** @file
+    Compressed sample files, streamed through an external (de)compressor.
+
+    A "gzip" or "zstd" process reads or writes the file, the samples are
+    passed through a pipe. The (de)compression runs on another core and
+    the pipe buffers the samples, no temporary file is needed.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "compress_pipe.h"
+#include "fileformat.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#define PIPE_READ "rb"
+#define PIPE_WRITE "wb"
+#define QUOTE '"'
+#else
+#define PIPE_READ "r"
+#define PIPE_WRITE "w"
+#define QUOTE '\''
+#endif
+
+/// Append the path quoted for the shell.
+static char *append_quoted(char *p, char const *path)
+{
+    *p++ = QUOTE;
+    for (; *path; ++path) {
+#ifndef _WIN32
+        if (*path == '\'') {
+            memcpy(p, "'\\''", 4); // close, escaped quote, reopen
+            p += 4;
+            continue;
+        }
+#endif
+        *p++ = *path;
+    }
+    *p++ = QUOTE;
+    *p   = '\0';
+    return p;
+}
+
+FILE *compress_pipe_open(char const *path, unsigned compression, int write)
+{
+    char const *tool = compression == F_GZIP ? "gzip" : compression == F_ZSTD ? "zstd -q" : NULL;
+    if (!tool) {
+        fprintf(stderr, "%s: unknown compression of %s\n", __func__, path);
+        return NULL;
+    }
+
+    if (!write) {
+        FILE *file = fopen(path, "rb"); // fail early, not in the decompressor
+        if (!file)
+            return NULL;
+        fclose(file);
+    }
+
+    // e.g. zstd -q -d -c 'path' or zstd -q -c >'path'
+    char *cmd = malloc(strlen(tool) + 8 + strlen(path) * 4 + 3);
+    if (!cmd) {
+        WARN_MALLOC("compress_pipe_open()");
+        return NULL;
+    }
+    char *p = cmd;
+    p += sprintf(p, "%s %s", tool, write ? "-c >" : "-d -c ");
+    append_quoted(p, path);
+
+    fflush(NULL); // the child must not inherit unwritten buffers
+    FILE *pipe = popen(cmd, write ? PIPE_WRITE : PIPE_READ);
+    if (!pipe) {
+        fprintf(stderr, "%s: failed to run %s\n", __func__, cmd);
+    }
+    free(cmd);
+    return pipe;
+}
+
+int compress_pipe_close(FILE *pipe)
+{
+    return pclose(pipe) == 0 ? 0 : -1;
+}
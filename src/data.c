@@ -13,14 +13,20 @@
 #include "data.h"
 
 #include "abuf.h"
+#include "format_double.h"
 #include "fatal.h"
+#include "compat_pthread.h"
 
 #include <stdarg.h>
+#include <stdint.h>
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 // Macro to prevent unused variables (passed into a function)
 // from generating a warning.
@@ -54,7 +60,7 @@ typedef struct {
     value_release_fn value_release;
 } data_meta_type_t;
 
-static data_meta_type_t dmt[DATA_COUNT] = {
+static data_meta_type_t const dmt[DATA_COUNT] = {
     //  DATA_DATA
     { .array_element_size       = sizeof(data_t*),
       .array_is_boxed           = true,
@@ -81,7 +87,7 @@ static data_meta_type_t dmt[DATA_COUNT] = {
       .array_is_boxed           = true,
       .array_elementwise_import = (array_elementwise_import_fn) strdup,
       .array_element_release    = (array_element_release_fn) free,
-      .value_release            = (value_release_fn) free },
+      .value_release            = NULL }, // string values are stored in the chunk
 
     //  DATA_ARRAY
     { .array_element_size       = sizeof(data_array_t*),
@@ -151,20 +157,71 @@ alloc_error:
     return NULL;
 }
 
-static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key, va_list ap)
+/// The interned well-known keys, by id.
+static char const *const data_keys[DATA_KEY_COUNT] = {
+        [DATA_KEY_TIME]          = "time",
+        [DATA_KEY_TAG]           = "tag",
+        [DATA_KEY_MODEL]         = "model",
+        [DATA_KEY_TYPE]          = "type",
+        [DATA_KEY_SUBTYPE]       = "subtype",
+        [DATA_KEY_ID]            = "id",
+        [DATA_KEY_CHANNEL]       = "channel",
+        [DATA_KEY_BATTERY_OK]    = "battery_ok",
+        [DATA_KEY_TEMPERATURE_C] = "temperature_C",
+        [DATA_KEY_TEMPERATURE_F] = "temperature_F",
+        [DATA_KEY_HUMIDITY]      = "humidity",
+        [DATA_KEY_MIC]           = "mic",
+        [DATA_KEY_MOD]           = "mod",
+        [DATA_KEY_FREQ]          = "freq",
+        [DATA_KEY_FREQ1]         = "freq1",
+        [DATA_KEY_FREQ2]         = "freq2",
+        [DATA_KEY_RSSI]          = "rssi",
+        [DATA_KEY_SNR]           = "snr",
+        [DATA_KEY_NOISE]         = "noise",
+        [DATA_KEY_MSG]           = "msg",
+        [DATA_KEY_CODES]         = "codes",
+};
+
+R_API int data_key_lookup(char const *key)
 {
-    data_type_t type;
-    data_t *prev = first;
-    while (prev && prev->next)
-        prev = prev->next;
-    char *format = NULL;
+    if (!key || !*key)
+        return DATA_KEY_NONE;
+    for (int id = DATA_KEY_NONE + 1; id < DATA_KEY_COUNT; ++id) {
+        if (data_keys[id][0] == key[0] && !strcmp(data_keys[id] + 1, key + 1))
+            return id;
+    }
+    return DATA_KEY_NONE;
+}
+
+/// Copy a string to the string space of a chunk, advances the string space.
+static char *chunk_strcpy(char **strings, char const *str)
+{
+    size_t len = strlen(str) + 1;
+    char *copy = *strings;
+    memcpy(copy, str, len);
+    *strings += len;
+    return copy;
+}
+
+/** Walks the key-type-values of vdata_make().
+
+    Without @p nodes this counts the elements and the string space needed,
+    with @p nodes this builds the elements into the chunk.
+    If @p release is set the moved values are released instead, e.g. on alloc failure.
+    Values of skipped elements are released when building.
+    @return 0 on success, -1 on a bad argument list
+*/
+static int vdata_walk(const char *key, const char *pretty_key, va_list ap,
+        data_t *nodes, char *strings, unsigned *num_nodes, size_t *strings_len, int release)
+{
+    char const *format = NULL;
     int skip = 0; // skip the data item if this is set
-    type = va_arg(ap, data_type_t);
+    unsigned n = 0;
+    size_t len = 0;
+    data_type_t type = va_arg(ap, data_type_t);
     do {
-        data_t *current;
         data_value_t value = {0};
-        // store explicit release function, CSA checker gets confused without this
-        value_release_fn value_release = NULL; // appease CSA checker
+        char const *str = NULL;
 
         switch (type) {
         case DATA_COND:
@@ -174,20 +231,15 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
         case DATA_FORMAT:
             if (format) {
                 fprintf(stderr, "vdata_make() format type used twice\n");
-                goto alloc_error;
-            }
-            format = strdup(va_arg(ap, char *));
-            if (!format) {
-                WARN_STRDUP("vdata_make()");
-                goto alloc_error;
+                return -1;
             }
+            format = va_arg(ap, char *);
             type = va_arg(ap, data_type_t);
             continue;
         case DATA_COUNT:
             assert(0);
             break;
         case DATA_DATA:
-            value_release = (value_release_fn)data_free; // appease CSA checker
             value.v_ptr = va_arg(ap, data_t *);
             break;
         case DATA_INT:
@@ -197,58 +249,49 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
             value.v_dbl = va_arg(ap, double);
             break;
         case DATA_STRING:
-            value_release = (value_release_fn)free; // appease CSA checker
-            value.v_ptr = strdup(va_arg(ap, char *));
-            if (!value.v_ptr)
-                WARN_STRDUP("vdata_make()");
+            str = va_arg(ap, char *);
             break;
         case DATA_ARRAY:
-            value_release = (value_release_fn)data_array_free; // appease CSA checker
             value.v_ptr = va_arg(ap, data_array_t *);
             break;
         default:
             fprintf(stderr, "vdata_make() bad data type (%d)\n", type);
-            goto alloc_error;
+            return -1;
         }
 
-        if (skip) {
-            if (value_release) // could use dmt[type].value_release
-                value_release(value.v_ptr);
-            free(format);
-            format = NULL;
-            skip = 0;
+        if (release || (skip && nodes)) {
+            if (dmt[type].value_release)
+                dmt[type].value_release(value.v_ptr);
         }
-        else {
-            current = calloc(1, sizeof(*current));
-            if (!current) {
-                WARN_CALLOC("vdata_make()");
-                if (value_release) // could use dmt[type].value_release
-                    value_release(value.v_ptr);
-                goto alloc_error;
-            }
-            current->type   = type;
-            current->format = format;
-            format          = NULL; // consumed
-            current->value  = value;
-            current->next   = NULL;
-
-            if (prev)
-                prev->next = current;
-            prev = current;
-            if (!first)
-                first = current;
-
-            current->key = strdup(key);
-            if (!current->key) {
-                WARN_STRDUP("vdata_make()");
-                goto alloc_error;
-            }
-            current->pretty_key = strdup(pretty_key ? pretty_key : key);
-            if (!current->pretty_key) {
-                WARN_STRDUP("vdata_make()");
-                goto alloc_error;
-            }
+        else if (!skip && !nodes) {
+            int key_id = data_key_lookup(key);
+            len += key_id ? 0 : strlen(key) + 1;
+            len += pretty_key ? strlen(pretty_key) + 1 : 0;
+            len += format ? strlen(format) + 1 : 0;
+            len += str ? strlen(str) + 1 : 0;
+        }
+        else if (!skip) {
+            data_t *current       = &nodes[n];
+            current->key_id       = data_key_lookup(key);
+            // interned keys are never written to or freed
+            current->key          = current->key_id ? (char *)data_keys[current->key_id] : chunk_strcpy(&strings, key);
+            current->pretty_key   = !pretty_key ? current->key : chunk_strcpy(&strings, pretty_key);
+            current->type         = type;
+            current->format       = format ? chunk_strcpy(&strings, format) : NULL;
+            current->value        = value;
+            if (str)
+                current->value.v_ptr = chunk_strcpy(&strings, str);
+            current->retain       = 0;
+            current->heap_strings = 0;
+            current->frozen       = 0;
+            current->chunk        = nodes;
+            current->next         = NULL;
+            if (n)
+                nodes[n - 1].next = current;
         }
+        n += !skip;
+        format = NULL;
+        skip   = 0;
 
         // next args
         key = va_arg(ap, const char *);
@@ -257,18 +300,57 @@ static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key
             type = va_arg(ap, data_type_t);
         }
     } while (key);
-    va_end(ap);
     if (format) {
         fprintf(stderr, "vdata_make() format type without data\n");
-        goto alloc_error;
+        return -1;
     }
 
-    return first;
+    if (num_nodes)
+        *num_nodes = n;
+    if (strings_len)
+        *strings_len = len;
+    return 0;
+}
 
-alloc_error:
-    free(format); // if not consumed
-    data_free(first);
-    return NULL;
+/// Makes the elements in one chunk, the elements and their strings are a single allocation.
+static data_t *vdata_make(data_t *first, const char *key, const char *pretty_key, va_list ap)
+{
+#ifndef NDEBUG
+    if (first && first->frozen)
+        fprintf(stderr, "WARNING: Appending \"%s\" to a frozen event\n", key);
+#endif
+    data_t *prev = first;
+    while (prev && prev->next)
+        prev = prev->next;
+
+    unsigned num_nodes = 0;
+    size_t strings_len = 0;
+    va_list aq;
+    va_copy(aq, ap);
+    int ret = vdata_walk(key, pretty_key, aq, NULL, NULL, &num_nodes, &strings_len, 0);
+    va_end(aq);
+    if (ret < 0) {
+        data_free(first);
+        return NULL;
+    }
+    if (!num_nodes) {
+        // all skipped, release the values
+        vdata_walk(key, pretty_key, ap, NULL, NULL, NULL, NULL, 1);
+        return first;
+    }
+
+    data_t *nodes = malloc(num_nodes * sizeof(*nodes) + strings_len);
+    if (!nodes) {
+        WARN_MALLOC("vdata_make()");
+        vdata_walk(key, pretty_key, ap, NULL, NULL, NULL, NULL, 1);
+        data_free(first);
+        return NULL;
+    }
+    vdata_walk(key, pretty_key, ap, nodes, (char *)&nodes[num_nodes], NULL, NULL, 0);
+
+    if (prev)
+        prev->next = nodes;
+    return first ? first : nodes;
 }
 
 R_API data_t *data_make(const char *key, const char *pretty_key, ...)
@@ -293,6 +375,10 @@ R_API data_t *data_prepend(data_t *first, const char *key, const char *pretty_ke
 {
     va_list ap;
     va_start(ap, pretty_key);
+#ifndef NDEBUG
+    if (first && first->frozen)
+        fprintf(stderr, "WARNING: Prepending \"%s\" to a frozen event\n", key);
+#endif
     data_t *result = vdata_make(NULL, key, pretty_key, ap);
     va_end(ap);
 
@@ -307,6 +393,141 @@ R_API data_t *data_prepend(data_t *first, const char *key, const char *pretty_ke
     return result;
 }
 
+R_API data_record_t *data_record_create(char const *const *keys)
+{
+    data_record_t *record = calloc(1, sizeof(*record));
+    if (!record) {
+        WARN_CALLOC("data_record_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    record->keys = keys;
+    while (keys && keys[record->num_slots])
+        record->num_slots++;
+    if (record->num_slots) {
+        record->key_ids = calloc(record->num_slots, sizeof(*record->key_ids));
+        if (!record->key_ids) {
+            WARN_CALLOC("data_record_create()");
+            data_record_free(record);
+            return NULL; // NOTE: returns NULL on alloc failure.
+        }
+        record->slots = calloc(record->num_slots, sizeof(*record->slots));
+        if (!record->slots) {
+            WARN_CALLOC("data_record_create()");
+            data_record_free(record);
+            return NULL; // NOTE: returns NULL on alloc failure.
+        }
+    }
+    for (unsigned i = 0; i < record->num_slots; ++i) {
+        record->key_ids[i] = data_key_lookup(keys[i]);
+    }
+    data_record_clear(record);
+    return record;
+}
+
+R_API void data_record_clear(data_record_t *record)
+{
+    if (!record)
+        return;
+    for (unsigned i = 0; i < record->num_slots; ++i) {
+        record->slots[i].type = DATA_COUNT;
+    }
+}
+
+/// Get a slot to set, NULL if there is no record or the slot is outside the schema.
+static data_slot_t *record_slot(data_record_t *record, unsigned slot, data_type_t type, char const *pretty_key, char const *format)
+{
+    if (!record || slot >= record->num_slots)
+        return NULL;
+    data_slot_t *s = &record->slots[slot];
+    s->type        = type;
+    s->pretty_key  = pretty_key;
+    s->format      = format;
+    return s;
+}
+
+R_API void data_record_int(data_record_t *record, unsigned slot, char const *pretty_key, char const *format, int value)
+{
+    data_slot_t *s = record_slot(record, slot, DATA_INT, pretty_key, format);
+    if (s)
+        s->value.v_int = value;
+}
+
+R_API void data_record_double(data_record_t *record, unsigned slot, char const *pretty_key, char const *format, double value)
+{
+    data_slot_t *s = record_slot(record, slot, DATA_DOUBLE, pretty_key, format);
+    if (s)
+        s->value.v_dbl = value;
+}
+
+R_API void data_record_string(data_record_t *record, unsigned slot, char const *pretty_key, char const *value)
+{
+    data_slot_t *s = record_slot(record, slot, DATA_STRING, pretty_key, NULL);
+    if (s)
+        s->value.v_ptr = (void *)(value ? value : "");
+}
+
+R_API data_t *data_record_make(data_record_t const *record)
+{
+    if (!record)
+        return NULL;
+
+    // the same layout as vdata_make(), without walking the arguments twice
+    unsigned num_nodes = 0;
+    size_t strings_len = 0;
+    for (unsigned i = 0; i < record->num_slots; ++i) {
+        data_slot_t const *s = &record->slots[i];
+        if (s->type == DATA_COUNT)
+            continue;
+        num_nodes++;
+        strings_len += record->key_ids[i] ? 0 : strlen(record->keys[i]) + 1;
+        strings_len += s->pretty_key ? strlen(s->pretty_key) + 1 : 0;
+        strings_len += s->format ? strlen(s->format) + 1 : 0;
+        strings_len += s->type == DATA_STRING ? strlen(s->value.v_ptr) + 1 : 0;
+    }
+    if (!num_nodes)
+        return NULL;
+
+    data_t *nodes = malloc(num_nodes * sizeof(*nodes) + strings_len);
+    if (!nodes) {
+        WARN_MALLOC("data_record_make()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    char *strings = (char *)&nodes[num_nodes];
+    unsigned n    = 0;
+    for (unsigned i = 0; i < record->num_slots; ++i) {
+        data_slot_t const *s = &record->slots[i];
+        if (s->type == DATA_COUNT)
+            continue;
+        data_t *current       = &nodes[n];
+        current->key_id       = record->key_ids[i];
+        current->key          = current->key_id ? (char *)data_keys[current->key_id] : chunk_strcpy(&strings, record->keys[i]);
+        current->pretty_key   = !s->pretty_key ? current->key : chunk_strcpy(&strings, s->pretty_key);
+        current->type         = s->type;
+        current->format       = s->format ? chunk_strcpy(&strings, s->format) : NULL;
+        current->value        = s->value;
+        if (s->type == DATA_STRING)
+            current->value.v_ptr = chunk_strcpy(&strings, s->value.v_ptr);
+        current->retain       = 0;
+        current->heap_strings = 0;
+        current->frozen       = 0;
+        current->chunk        = nodes;
+        current->next         = NULL;
+        if (n)
+            nodes[n - 1].next = current;
+        n++;
+    }
+    return nodes;
+}
+
+R_API void data_record_free(data_record_t *record)
+{
+    if (!record)
+        return;
+    free(record->key_ids);
+    free(record->slots);
+    free(record);
+}
+
 R_API void data_array_free(data_array_t *array)
 {
     array_element_release_fn release = dmt[array->type].array_element_release;
@@ -319,29 +540,240 @@ R_API void data_array_free(data_array_t *array)
     free(array);
 }
 
+/// Atomically add to the retain count, returns the previous count.
+static unsigned retain_add(unsigned *retain, int n)
+{
+#ifdef _MSC_VER
+    return (unsigned)_InterlockedExchangeAdd((long volatile *)retain, n);
+#else
+    return __atomic_fetch_add(retain, (unsigned)n, __ATOMIC_ACQ_REL);
+#endif
+}
+
 R_API data_t *data_retain(data_t *data)
 {
     if (data)
-        ++data->retain;
+        retain_add(&data->retain, 1);
+    return data;
+}
+
+R_API data_t *data_freeze(data_t *data)
+{
+    if (data)
+        data->frozen = 1;
     return data;
 }
 
 R_API void data_free(data_t *data)
 {
-    if (data && data->retain) {
-        --data->retain;
+    // the last reference frees, the other references may be released on other threads at the same time
+    if (data && retain_add(&data->retain, -1) != 0)
         return;
-    }
+    data_t *chunk = NULL; // the elements of a chunk are consecutive, free it after the last one
     while (data) {
-        data_t *prev_data = data;
+        data_t *next = data->next;
         if (dmt[data->type].value_release)
             dmt[data->type].value_release(data->value.v_ptr);
-        free(data->format);
-        free(data->pretty_key);
+        if (data->heap_strings & DATA_HEAP_KEY)
+            free(data->key);
+        if (data->heap_strings & DATA_HEAP_FORMAT)
+            free(data->format);
+        if (data->chunk != chunk) {
+            free(chunk);
+            chunk = data->chunk;
+        }
+        data = next;
+    }
+    free(chunk);
+}
+
+R_API void data_replace_key(data_t *data, char *key)
+{
+    if (data->heap_strings & DATA_HEAP_KEY)
         free(data->key);
-        data = data->next;
-        free(prev_data);
+    data->key = key;
+    data->key_id = data_key_lookup(key);
+    data->heap_strings |= DATA_HEAP_KEY;
+}
+
+R_API void data_replace_format(data_t *data, char *format)
+{
+    if (data->heap_strings & DATA_HEAP_FORMAT)
+        free(data->format);
+    data->format = format;
+    data->heap_strings |= DATA_HEAP_FORMAT;
+}
+
+/* output projection */
+
+// the well-known keys are a bitmask
+#define PROJECTION_IDS(key_id) ((uint32_t)1 << (key_id))
+
+struct data_projection {
+    int has_fields;       ///< only the listed fields are kept
+    uint32_t field_ids;   ///< the listed well-known fields
+    uint32_t exclude_ids; ///< the excluded well-known fields
+    unsigned num_fields;  ///< the other listed fields are the first keys, then the excluded ones
+    unsigned num_keys;
+    char const **keys;
+    uint32_t *hashes;
+    char *strings;   ///< the keys, split in place
+    data_t *nodes;   ///< the copies of the kept fields of the printed event
+    unsigned size;   ///< number of nodes
+};
+
+static uint32_t projection_hash(char const *key)
+{
+    uint32_t hash = 2166136261u;
+    for (; *key; ++key) {
+        hash = (hash ^ (unsigned char)*key) * 16777619u; // FNV-1a
+    }
+    return hash;
+}
+
+/// Split a list of keys separated by ':', well-known keys are added to the mask.
+static void projection_split(data_projection_t *projection, char *list, uint32_t *ids)
+{
+    for (char *key = strtok(list, ":"); key; key = strtok(NULL, ":")) {
+        int key_id = data_key_lookup(key);
+        if (key_id) {
+            *ids |= PROJECTION_IDS(key_id);
+            continue;
+        }
+        projection->keys[projection->num_keys]   = key;
+        projection->hashes[projection->num_keys] = projection_hash(key);
+        projection->num_keys++;
+    }
+}
+
+R_API data_projection_t *data_projection_create(char const *fields, char const *exclude)
+{
+    fields  = fields ? fields : "";
+    exclude = exclude ? exclude : "";
+    if (!*fields && !*exclude)
+        return NULL;
+
+    size_t fields_len  = strlen(fields);
+    size_t exclude_len = strlen(exclude);
+    size_t max_keys    = (fields_len + exclude_len) / 2 + 2; // at most every other char is a key
+    data_projection_t *projection = calloc(1, sizeof(*projection));
+    if (!projection) {
+        WARN_CALLOC("data_projection_create()");
+        return NULL;
+    }
+    projection->strings = malloc(fields_len + exclude_len + 2);
+    if (!projection->strings) {
+        WARN_MALLOC("data_projection_create()");
+        data_projection_free(projection);
+        return NULL;
+    }
+    projection->keys = calloc(max_keys, sizeof(*projection->keys));
+    if (!projection->keys) {
+        WARN_CALLOC("data_projection_create()");
+        data_projection_free(projection);
+        return NULL;
+    }
+    projection->hashes = calloc(max_keys, sizeof(*projection->hashes));
+    if (!projection->hashes) {
+        WARN_CALLOC("data_projection_create()");
+        data_projection_free(projection);
+        return NULL;
+    }
+    memcpy(projection->strings, fields, fields_len + 1);
+    memcpy(projection->strings + fields_len + 1, exclude, exclude_len + 1);
+
+    projection->has_fields = *fields != '\0';
+    projection_split(projection, projection->strings, &projection->field_ids);
+    projection->num_fields = projection->num_keys;
+    projection_split(projection, projection->strings + fields_len + 1, &projection->exclude_ids);
+    return projection;
+}
+
+R_API void data_projection_free(data_projection_t *projection)
+{
+    if (!projection)
+        return;
+    free(projection->strings);
+    free((void *)projection->keys);
+    free(projection->hashes);
+    free(projection->nodes);
+    free(projection);
+}
+
+/// Check if a key that is not well-known is in a range of the keys.
+static int projection_lists(data_projection_t const *projection, unsigned first, unsigned last, char const *key)
+{
+    if (first == last)
+        return 0;
+    uint32_t hash = projection_hash(key);
+    for (unsigned i = first; i < last; ++i) {
+        if (projection->hashes[i] == hash && !strcmp(projection->keys[i], key))
+            return 1;
+    }
+    return 0;
+}
+
+R_API int data_projection_keeps(data_projection_t const *projection, char const *key, int key_id)
+{
+    if (!projection)
+        return 1;
+    if (key_id) {
+        if (projection->has_fields && !(projection->field_ids & PROJECTION_IDS(key_id)))
+            return 0;
+        return !(projection->exclude_ids & PROJECTION_IDS(key_id));
+    }
+    if (projection->has_fields && !projection_lists(projection, 0, projection->num_fields, key))
+        return 0;
+    return !projection_lists(projection, projection->num_fields, projection->num_keys, key);
+}
+
+R_API void data_output_project(data_output_t *output, data_projection_t *projection)
+{
+    if (!output) {
+        data_projection_free(projection);
+        return;
+    }
+    data_projection_free(output->projection);
+    output->projection = projection;
+}
+
+/// Link copies of the kept fields, returns the event itself if all fields are kept, NULL if none.
+static data_t *data_project(data_projection_t *projection, data_t *data)
+{
+    unsigned num_fields = 0;
+    unsigned num_kept   = 0;
+    for (data_t *d = data; d; d = d->next) {
+        num_fields++;
+        num_kept += data_projection_keeps(projection, d->key, d->key_id);
     }
+    if (num_kept == num_fields)
+        return data; // e.g. the shared JSON serialization can be used
+    if (!num_kept)
+        return NULL;
+
+    if (num_kept > projection->size) {
+        data_t *nodes = realloc(projection->nodes, num_kept * sizeof(*nodes));
+        if (!nodes) {
+            WARN_REALLOC("data_output_print()");
+            return data; // NOTE: prints all fields on alloc failure.
+        }
+        projection->nodes = nodes;
+        projection->size  = num_kept;
+    }
+    data_t *head  = NULL;
+    data_t **tail = &head;
+    data_t *node  = projection->nodes;
+    for (data_t *d = data; d; d = d->next) {
+        if (!data_projection_keeps(projection, d->key, d->key_id))
+            continue;
+        *node        = *d;
+        node->retain = 0;
+        *tail        = node;
+        tail         = &node->next;
+        node++;
+    }
+    *tail = NULL;
+    return head;
 }
 
 /* data output */
@@ -350,10 +782,69 @@ R_API void data_output_print(data_output_t *output, data_t *data)
 {
     if (!output)
         return;
+    if (output->projection) {
+        data = data_project(output->projection, data);
+        if (!data)
+            return; // nothing to print
+    }
     output->print_data(output, data, NULL);
 
     if (output->output_flush)
         output->output_flush(output);
+    if (output->batch)
+        output->batch_events++;
+}
+
+R_API void data_output_print_urgent(data_output_t *output, data_t *data)
+{
+    if (!output)
+        return;
+    if (!output->output_urgent) {
+        // printed outside of the batch and written out now
+        int batch     = output->batch;
+        output->batch = 0;
+        data_output_print(output, data);
+        output->batch = batch;
+        data_output_sync(output, 1);
+        return;
+    }
+    if (output->projection) {
+        data = data_project(output->projection, data);
+        if (!data)
+            return; // nothing to print
+    }
+    output->output_urgent(output, data);
+}
+
+R_API void data_output_batch_begin(struct data_output *output)
+{
+    if (!output)
+        return;
+    output->batch        = 1;
+    output->batch_events = 0;
+}
+
+R_API void data_output_batch_end(struct data_output *output)
+{
+    if (!output || !output->batch)
+        return;
+    output->batch = 0;
+    if (output->batch_events && output->output_batch)
+        output->output_batch(output, output->batch_events);
+}
+
+R_API unsigned data_output_drops(struct data_output *output)
+{
+    if (!output || !output->output_drops)
+        return 0;
+    return output->output_drops(output);
+}
+
+R_API size_t data_output_memory(struct data_output *output)
+{
+    if (!output || !output->output_memory)
+        return 0;
+    return output->output_memory(output);
 }
 
 R_API void data_output_start(struct data_output *output, char const *const *fields, int num_fields)
@@ -363,11 +854,20 @@ R_API void data_output_start(struct data_output *output, char const *const *fiel
     output->output_start(output, fields, num_fields);
 }
 
+R_API void data_output_sync(struct data_output *output, int force)
+{
+    if (!output || !output->output_sync)
+        return;
+    output->output_sync(output, force);
+}
+
 R_API void data_output_free(data_output_t *output)
 {
     if (!output)
         return;
+    data_projection_t *projection = output->projection;
     output->output_free(output);
+    data_projection_free(projection);
 }
 
 /* output helpers */
@@ -413,22 +913,90 @@ R_API void print_array_value(data_output_t *output, data_array_t *array, char co
 
 /* JSON string printer */
 
+R_API int data_buf_reserve(data_buf_t *buf, size_t size)
+{
+    if (size <= buf->size)
+        return 1;
+    size_t new_size = buf->size ? buf->size : 2048;
+    while (new_size < size) {
+        new_size *= 2;
+    }
+    char *new_buf = realloc(buf->buf, new_size);
+    if (!new_buf) {
+        WARN_REALLOC("data_buf_reserve()");
+        return 0;
+    }
+    buf->buf  = new_buf;
+    buf->size = new_size;
+    return 1;
+}
+
+R_API void data_buf_free(data_buf_t *buf)
+{
+    free(buf->buf);
+    buf->buf  = NULL;
+    buf->size = 0;
+}
+
 typedef struct {
     struct data_output output;
-    abuf_t msg;
+    char *buf;
+    size_t size;
+    size_t len;       ///< the length of the JSON, the buffer is always terminated
+    data_buf_t *grow; ///< the buffer to grow, NULL to truncate to a fixed buffer
+    int truncated;    ///< something did not fit the buffer
+    int spaced;       ///< spaces after the separators and 3 decimals, as the JSON file output
 } data_print_jsons_t;
 
+/// The escape of each char in a JSON string, 0 to copy.
+static char const jsons_escapes[256] = {
+        ['\t'] = 't',
+        ['\n'] = 'n',
+        ['\r'] = 'r',
+        ['"']  = '"',
+        ['\\'] = '\\',
+};
+
+/// Make room for @p len chars and the terminator, flags truncated if they do not fit.
+static int jsons_reserve(data_print_jsons_t *jsons, size_t len)
+{
+    if (jsons->len + len < jsons->size)
+        return 1;
+    if (jsons->grow && data_buf_reserve(jsons->grow, jsons->len + len + 1)) {
+        jsons->buf  = jsons->grow->buf;
+        jsons->size = jsons->grow->size;
+        return 1;
+    }
+    jsons->truncated = 1;
+    return 0;
+}
+
+/// Append all or nothing of a text.
+static void jsons_append(data_print_jsons_t *jsons, char const *str, size_t len)
+{
+    if (!jsons_reserve(jsons, len))
+        return;
+    memcpy(jsons->buf + jsons->len, str, len);
+    jsons->len += len;
+    jsons->buf[jsons->len] = '\0';
+}
+
+static void jsons_cat(data_print_jsons_t *jsons, char const *str)
+{
+    jsons_append(jsons, str, strlen(str));
+}
+
 static void R_API_CALLCONV format_jsons_array(data_output_t *output, data_array_t *array, char const *format)
 {
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
 
-    abuf_cat(&jsons->msg, "[");
+    jsons_cat(jsons, "[");
     for (int c = 0; c < array->num_values; ++c) {
         if (c)
-            abuf_cat(&jsons->msg, ",");
+            jsons_cat(jsons, jsons->spaced ? ", " : ",");
         print_array_value(output, array, format, c);
     }
-    abuf_cat(&jsons->msg, "]");
+    jsons_cat(jsons, "]");
 }
 
 static void R_API_CALLCONV format_jsons_object(data_output_t *output, data_t *data, char const *format)
@@ -437,17 +1005,17 @@ static void R_API_CALLCONV format_jsons_object(data_output_t *output, data_t *da
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
 
     bool separator = false;
-    abuf_cat(&jsons->msg, "{");
+    jsons_cat(jsons, "{");
     while (data) {
         if (separator)
-            abuf_cat(&jsons->msg, ",");
+            jsons_cat(jsons, jsons->spaced ? ", " : ",");
         output->print_string(output, data->key, NULL);
-        abuf_cat(&jsons->msg, ":");
+        jsons_cat(jsons, jsons->spaced ? " : " : ":");
         print_value(output, data->type, data->value, data->format);
         separator = true;
         data      = data->next;
     }
-    abuf_cat(&jsons->msg, "}");
+    jsons_cat(jsons, "}");
 }
 
 static void R_API_CALLCONV format_jsons_string(data_output_t *output, const char *str, char const *format)
@@ -455,76 +1023,78 @@ static void R_API_CALLCONV format_jsons_string(data_output_t *output, const char
     UNUSED(format);
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
 
-    char *buf   = jsons->msg.tail;
-    size_t size = jsons->msg.left;
-
     size_t str_len = strlen(str);
-    if (size < str_len + 3) {
-        return;
-    }
-
     if (str[0] == '{' && str[str_len - 1] == '}') {
         // Print embedded JSON object verbatim
-        abuf_cat(&jsons->msg, str);
+        jsons_append(jsons, str, str_len);
         return;
     }
 
-    *buf++ = '"';
-    size--;
-    for (; *str && size >= 3; ++str) {
-        if (*str == '\r') {
-            *buf++ = '\\';
-            size--;
-            *buf++ = 'r';
-            size--;
-            continue;
-        }
-        if (*str == '\n') {
-            *buf++ = '\\';
-            size--;
-            *buf++ = 'n';
-            size--;
-            continue;
-        }
-        if (*str == '\t') {
-            *buf++ = '\\';
-            size--;
-            *buf++ = 't';
-            size--;
-            continue;
-        }
-        if (*str == '"' || *str == '\\') {
-            *buf++ = '\\';
-            size--;
-        }
-        *buf++ = *str;
-        size--;
+    size_t escapes = 0;
+    for (unsigned char const *p = (unsigned char const *)str; *p; ++p) {
+        escapes += jsons_escapes[*p] != 0;
     }
-    if (size >= 2) {
-        *buf++ = '"';
-        size--;
+    if (!jsons_reserve(jsons, str_len + escapes + 2))
+        return;
+
+    char *buf = jsons->buf + jsons->len;
+    *buf++    = '"';
+    if (!escapes) {
+        memcpy(buf, str, str_len);
+        buf += str_len;
     }
-    *buf = '\0';
+    else {
+        for (unsigned char const *p = (unsigned char const *)str; *p; ++p) {
+            char escape = jsons_escapes[*p];
+            if (escape) {
+                *buf++ = '\\';
+                *buf++ = escape;
+            }
+            else {
+                *buf++ = (char)*p;
+            }
+        }
+    }
+    *buf++ = '"';
+    *buf   = '\0';
+    jsons->len = (size_t)(buf - jsons->buf);
+}
 
-    jsons->msg.tail = buf;
-    jsons->msg.left = size;
+/// Append a double with a single double conversion.
+static void jsons_double(data_print_jsons_t *jsons, char const *format, double value)
+{
+    char tmp[FORMAT_DOUBLE_BUFLEN];
+    int len = format_double(tmp, sizeof(tmp), format, value);
+    if (len < 0)
+        return;
+    if (len < (int)sizeof(tmp)) {
+        jsons_append(jsons, tmp, (size_t)len);
+        return;
+    }
+    // a long text, e.g. a huge value with fixed decimals
+    if (!jsons_reserve(jsons, (size_t)len))
+        return;
+    format_double(jsons->buf + jsons->len, jsons->size - jsons->len, format, value);
+    jsons->len += (size_t)len;
 }
 
 static void R_API_CALLCONV format_jsons_double(data_output_t *output, double data, char const *format)
 {
     UNUSED(format);
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
+    if (jsons->spaced) {
+        jsons_double(jsons, "%.3f", data);
+    }
     // use scientific notation for very big/small values
-    if (data > 1e7 || data < 1e-4) {
-        abuf_printf(&jsons->msg, "%g", data);
+    else if (data > 1e7 || data < 1e-4) {
+        jsons_double(jsons, "%g", data);
     }
     else {
-        abuf_printf(&jsons->msg, "%.5f", data);
+        size_t start = jsons->len;
+        jsons_double(jsons, "%.5f", data);
         // remove trailing zeros, always keep one digit after the decimal point
-        while (jsons->msg.left > 0 && *(jsons->msg.tail - 1) == '0' && *(jsons->msg.tail - 2) != '.') {
-            jsons->msg.tail--;
-            jsons->msg.left++;
-            *jsons->msg.tail = '\0';
+        while (jsons->len > start + 2 && jsons->buf[jsons->len - 1] == '0' && jsons->buf[jsons->len - 2] != '.') {
+            jsons->buf[--jsons->len] = '\0';
         }
     }
 }
@@ -533,10 +1103,13 @@ static void R_API_CALLCONV format_jsons_int(data_output_t *output, int data, cha
 {
     UNUSED(format);
     data_print_jsons_t *jsons = (data_print_jsons_t *)output;
-    abuf_printf(&jsons->msg, "%d", data);
+    char tmp[16];
+    int len = snprintf(tmp, sizeof(tmp), "%d", data);
+    jsons_append(jsons, tmp, (size_t)len);
 }
 
-R_API size_t data_print_jsons(data_t *data, char *dst, size_t len)
+/// Serialize to JSON, to a fixed buffer if @p grow is NULL, sets @p truncated if something did not fit.
+static size_t print_jsons(data_t *data, char *dst, size_t len, data_buf_t *grow, int spaced, int *truncated)
 {
     data_print_jsons_t jsons = {
             .output = {
@@ -546,11 +1119,87 @@ R_API size_t data_print_jsons(data_t *data, char *dst, size_t len)
                     .print_double = format_jsons_double,
                     .print_int    = format_jsons_int,
             },
+            .buf    = grow ? grow->buf : dst,
+            .size   = grow ? grow->size : len,
+            .grow   = grow,
+            .spaced = spaced,
     };
-
-    abuf_init(&jsons.msg, dst, len);
+    if (jsons.size)
+        jsons.buf[0] = '\0';
 
     format_jsons_object(&jsons.output, data, NULL);
 
-    return len - jsons.msg.left;
+    if (truncated)
+        *truncated = jsons.truncated;
+    return jsons.len;
+}
+
+/// The compact JSON of the current event, see data_print_jsons_cache(), each thread caches its own.
+static THREAD_LOCAL struct {
+    data_t *data; ///< the event, NULL if not caching
+    int valid;    ///< 1 if the JSON is serialized, -1 if it can't be, 0 if not yet
+    data_buf_t json;
+    size_t len;
+} jsons_cache;
+
+static void jsons_cache_fill(data_t *data)
+{
+    int truncated   = 0;
+    jsons_cache.len = print_jsons(data, NULL, 0, &jsons_cache.json, 0, &truncated);
+    jsons_cache.valid = truncated ? -1 : 1; // NOTE: each output serializes on alloc failure.
+}
+
+R_API void data_print_jsons_cache(data_t *data)
+{
+    jsons_cache.data  = data;
+    jsons_cache.valid = 0;
+}
+
+R_API size_t data_print_jsons(data_t *data, char *dst, size_t len)
+{
+    if (data && data == jsons_cache.data) {
+        if (!jsons_cache.valid)
+            jsons_cache_fill(data);
+        // a complete serialization that fits is what serializing to dst would give
+        if (jsons_cache.valid > 0 && jsons_cache.len < len) {
+            memcpy(dst, jsons_cache.json.buf, jsons_cache.len + 1);
+            return jsons_cache.len;
+        }
+    }
+    return print_jsons(data, dst, len, NULL, 0, NULL);
+}
+
+R_API char const *data_print_jsons_cached(data_t *data, size_t *len)
+{
+    if (!data || data != jsons_cache.data)
+        return NULL;
+    if (!jsons_cache.valid)
+        jsons_cache_fill(data);
+    if (jsons_cache.valid < 0)
+        return NULL;
+    *len = jsons_cache.len;
+    return jsons_cache.json.buf;
+}
+
+R_API char const *data_print_jsons_buf(data_t *data, data_buf_t *buf, size_t *len)
+{
+    size_t json_len;
+    char const *json = data_print_jsons_cached(data, &json_len);
+    if (!json) {
+        int truncated = 0;
+        json_len      = print_jsons(data, NULL, 0, buf, 0, &truncated);
+        json          = truncated ? NULL : buf->buf;
+    }
+    if (len)
+        *len = json ? json_len : 0;
+    return json;
+}
+
+R_API char const *data_print_json_spaced(data_t *data, data_buf_t *buf, size_t *len)
+{
+    int truncated   = 0;
+    size_t json_len = print_jsons(data, NULL, 0, buf, 1, &truncated);
+    if (len)
+        *len = truncated ? 0 : json_len;
+    return truncated ? NULL : buf->buf;
 }
@@ -21,6 +21,18 @@
 #include "optparse.h"
 #include "fileformat.h"
 #include "fatal.h"
+#include "compat_pthread.h"
+
+#define MAX_JSON_TOKENS 128
+#define MAX_TAG_FIELDS 32
+
+/// The included fields of a message, parsed once when the message arrives.
+typedef struct gpsd_fields {
+    unsigned num;
+    char const *keys[MAX_TAG_FIELDS]; ///< the includes, not copied
+    unsigned vals[MAX_TAG_FIELDS];    ///< offsets of the values in the buffer, the fields are copied
+    char buf[1024];
+} gpsd_fields_t;
 
 typedef struct gpsd_client {
     struct mg_connect_opts connect_opts;
@@ -29,7 +41,12 @@ typedef struct gpsd_client {
     char address[253 + 6 + 1]; // dns max + port
     char const *init_str;
     char const *filter_str;
+    char const **includes; ///< the fields to parse from a message, NULL to keep the message string
     char msg[1024]; // GPSd TPV should about 600 bytes
+    gpsd_fields_t fields; ///< the included fields of the msg
+#ifdef THREADS
+    pthread_mutex_t lock; ///< the msg is received on the network thread
+#endif
 } gpsd_client_t;
 
 // GPSd JSON mode
@@ -39,10 +56,68 @@ char const filter_json[] = "{\"class\":\"TPV\",";
 char const watch_nmea[] = "?WATCH={\"enable\":true,\"nmea\":true}\n";
 char const filter_nmea[] = "$GPGGA,";
 
+static char const *find_list_strncmp(char const **list, char const *key, size_t len)
+{
+    for (; list && *list; ++list) {
+        char const *elem = *list;
+        if (elem && strncmp(elem, key, len) == 0) {
+            return elem;
+        }
+    }
+    return NULL;
+}
+
+/// Parse the included fields of a JSON message, the values are copied to the buffer.
+static void parse_filtered_json(gpsd_fields_t *fields, char const *json, char const **includes)
+{
+    fields->num = 0;
+
+    jsmn_parser parser = {0};
+    jsmn_init(&parser);
+    jsmntok_t tok[MAX_JSON_TOKENS] = {{0}}; // make the compiler happy, should be {0}
+
+    int toks = jsmn_parse(&parser, json, strlen(json), tok, MAX_JSON_TOKENS);
+    if (toks < 1 || tok[0].type != JSMN_OBJECT) {
+        fprintf(stderr, "invalid json (%d): %s\n", toks, json);
+        return; // invalid json
+    }
+
+    // check all tokens
+    size_t pos = 0;
+    for (int i = 1; i < toks - 1 && fields->num < MAX_TAG_FIELDS; ++i) {
+        jsmntok_t *k = tok + i;
+        jsmntok_t *v = tok + i + 1;
+        i += k->size + v->size;
+
+        // check all includes
+        char const *key = find_list_strncmp(includes, json + k->start, k->end - k->start);
+        size_t len      = v->end - v->start;
+        if (key && pos + len < sizeof(fields->buf)) {
+            memcpy(fields->buf + pos, json + v->start, len);
+            fields->buf[pos + len]      = '\0';
+            fields->keys[fields->num]   = key;
+            fields->vals[fields->num++] = (unsigned)pos;
+            pos += len + 1;
+        }
+    }
+}
+
 static void gpsd_client_line(gpsd_client_t *ctx, char *line)
 {
     if (!ctx->filter_str || strncmp(line, ctx->filter_str, strlen(ctx->filter_str)) == 0) {
+        // parse once here, not for each event the tag is applied to
+        gpsd_fields_t fields;
+        if (ctx->includes)
+            parse_filtered_json(&fields, line, ctx->includes);
+#ifdef THREADS
+        pthread_mutex_lock(&ctx->lock);
+#endif
         strncpy(ctx->msg, line, sizeof(ctx->msg) - 1);
+        if (ctx->includes)
+            ctx->fields = fields;
+#ifdef THREADS
+        pthread_mutex_unlock(&ctx->lock);
+#endif
     }
 }
 
@@ -116,7 +191,7 @@ static struct mg_connection *gpsd_client_connect(gpsd_client_t *ctx, struct mg_m
     return ctx->conn;
 }
 
-static gpsd_client_t *gpsd_client_init(char const *host, char const *port, char const *init_str, char const *filter_str, struct mg_mgr *mgr)
+static gpsd_client_t *gpsd_client_init(char const *host, char const *port, char const *init_str, char const *filter_str, char const **includes, struct mg_mgr *mgr)
 {
     gpsd_client_t *ctx;
     ctx = calloc(1, sizeof(gpsd_client_t));
@@ -133,7 +208,11 @@ static gpsd_client_t *gpsd_client_init(char const *host, char const *port, char
 
     ctx->init_str = init_str;
     ctx->filter_str = filter_str;
+    ctx->includes = includes;
     ctx->connect_opts.user_data = ctx;
+#ifdef THREADS
+    pthread_mutex_init(&ctx->lock, NULL);
+#endif
 
     if (!gpsd_client_connect(ctx, mgr)) {
         exit(1);
@@ -148,6 +227,10 @@ static void gpsd_client_free(gpsd_client_t *ctx)
         ctx->conn->user_data = NULL;
         ctx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
     }
+#ifdef THREADS
+    if (ctx)
+        pthread_mutex_destroy(&ctx->lock);
+#endif
     free(ctx);
 }
 
@@ -219,7 +302,7 @@ data_tag_t *data_tag_create(char *param, struct mg_mgr *mgr)
 
         fprintf(stderr, "Getting %s data from %s port %s\n", mode, host, port);
 
-        tag->gpsd_client = gpsd_client_init(host, port, init_str, filter_str, mgr);
+        tag->gpsd_client = gpsd_client_init(host, port, init_str, filter_str, tag->includes, mgr);
     }
     else {
         if (!tag->key)
@@ -237,52 +320,14 @@ void data_tag_free(data_tag_t *tag)
     free(tag);
 }
 
-static char const *find_list_strncmp(char const **list, char const *key, size_t len)
+static data_t *append_fields(data_t *data, gpsd_fields_t const *fields)
 {
-    for (; list && *list; ++list) {
-        char const *elem = *list;
-        if (elem && strncmp(elem, key, len) == 0) {
-            return elem;
-        }
-    }
-    return NULL;
-}
-
-#define MAX_JSON_TOKENS 128
-
-static data_t *append_filtered_json(data_t *data, char const *json, char const **includes)
-{
-    jsmn_parser parser = {0};
-    jsmn_init(&parser);
-    jsmntok_t tok[MAX_JSON_TOKENS] = {{0}}; // make the compiler happy, should be {0}
-
-    int toks = jsmn_parse(&parser, json, strlen(json), tok, MAX_JSON_TOKENS);
-    if (toks < 1 || tok[0].type != JSMN_OBJECT) {
-        fprintf(stderr, "invalid json (%d): %s\n", toks, json);
-        return data; // invalid json
+    for (unsigned i = 0; i < fields->num; ++i) {
+        // append json tag
+        data = data_append(data,
+                fields->keys[i], "", DATA_STRING, fields->buf + fields->vals[i],
+                NULL);
     }
-
-    // check all tokens
-    char buf[1024] = {0};
-    for (int i = 1; i < toks - 1; ++i) {
-        jsmntok_t *k = tok + i;
-        jsmntok_t *v = tok + i + 1;
-        i += k->size + v->size;
-        //fprintf(stderr, "TOK (%d %d) %.*s : (%d %d) %.*s\n",
-        //        k->type, k->size, k->end - k->start, json + k->start,
-        //        v->type, v->size, v->end - v->start, json + v->start);
-
-        // check all includes
-        char const *key = find_list_strncmp(includes, json + k->start, k->end - k->start);
-        if (key) {
-            // append json tag
-            strncpy(buf, json + v->start, v->end - v->start);
-            data = data_append(data,
-                    key, "", DATA_STRING, buf,
-                    NULL);
-        }
-    }
-
     return data;
 }
 
@@ -290,11 +335,15 @@ data_t *data_tag_apply(data_tag_t *tag, data_t *data, char const *filename)
 {
     char const *val = tag->val;
     if (tag->gpsd_client) {
-        val = tag->gpsd_client->msg;
+        gpsd_client_t *ctx = tag->gpsd_client;
+#ifdef THREADS
+        pthread_mutex_lock(&ctx->lock);
+#endif
+        // the fields are copied into the event while the message can not change
         if (tag->includes) {
             if (tag->key) {
                 // wrap tag includes
-                data_t *obj = append_filtered_json(NULL, val, tag->includes);
+                data_t *obj = append_fields(NULL, &ctx->fields);
                 // append tag wrapper
                 data = data_append(data,
                         tag->key, "", DATA_DATA, obj,
@@ -302,15 +351,18 @@ data_t *data_tag_apply(data_tag_t *tag, data_t *data, char const *filename)
             }
             else {
                 // append tag includes
-                data = append_filtered_json(data, val, tag->includes);
+                data = append_fields(data, &ctx->fields);
             }
         }
         else {
             // append tag string
             data = data_append(data,
-                    tag->key, "", DATA_STRING, val,
+                    tag->key, "", DATA_STRING, ctx->msg,
                     NULL);
         }
+#ifdef THREADS
+        pthread_mutex_unlock(&ctx->lock);
+#endif
         return data;
     }
     else if (filename && !strcmp("PATH", tag->val)) {
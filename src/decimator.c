@@ -0,0 +1,173 @@
+/** @file
+    Decimator, reduces the sample rate of the I/Q input before demodulation.
+
+    A cascade of half-band FIR filters, each stage decimates by 2.
+    Every other coefficient of a half-band filter is zero and the filter is symmetric,
+    so each output sample costs only 5 multiplies per component.
+    The passband is flat to 0.3 of the output rate, aliases are attenuated by more than 46 dB.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "decimator.h"
+#include "fileformat.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// Filter history length in samples.
+#define DECIMATOR_HIST (DECIMATOR_TAPS - 1)
+
+/// Blackman windowed-sinc half-band coeffs in Q0.15 at offsets 1, 3, 5, 7, 9, the center is 0.5.
+static int32_t const halfband_coeffs[] = {10087, -2559, 864, -238, 38};
+
+decimator_t *decimator_create(uint32_t processing_rate)
+{
+    if (!processing_rate) {
+        fprintf(stderr, "%s: processing rate must not be zero\n", __func__);
+        return NULL;
+    }
+    decimator_t *dec = calloc(1, sizeof(*dec));
+    if (!dec) {
+        WARN_CALLOC("decimator_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    dec->processing_rate = processing_rate;
+    return dec;
+}
+
+void decimator_free(decimator_t *dec)
+{
+    if (!dec)
+        return;
+    free(dec->work_buf);
+    free(dec->out_buf);
+    free(dec);
+}
+
+size_t decimator_memory(decimator_t const *dec)
+{
+    if (!dec)
+        return 0;
+    return sizeof(*dec) + dec->work_size * sizeof(*dec->work_buf) + dec->out_size * sizeof(*dec->out_buf);
+}
+
+unsigned decimator_set_rate(decimator_t *dec, uint32_t samp_rate)
+{
+    if (dec->samp_rate == samp_rate)
+        return 1 << dec->stages;
+
+    unsigned stages = 0;
+    while (stages < DECIMATOR_MAX_STAGES && samp_rate >> (stages + 1) >= dec->processing_rate)
+        stages++;
+
+    dec->samp_rate = samp_rate;
+    dec->out_rate  = samp_rate >> stages;
+    dec->stages    = stages;
+    memset(dec->skip, 0, sizeof(dec->skip));
+    memset(dec->hist, 0, sizeof(dec->hist));
+
+    if (stages)
+        fprintf(stderr, "Decimating %u Hz by %u to a processing rate of %u Hz\n",
+                samp_rate, 1 << stages, dec->out_rate);
+    else
+        fprintf(stderr, "Sample rate %u Hz is below twice the processing rate of %u Hz, not decimating\n",
+                samp_rate, dec->processing_rate);
+    return 1 << stages;
+}
+
+/// Convert the input to CS16, scaled to Q0.15.
+static void convert_input(int16_t *y_buf, void const *iq_buf, unsigned long len, uint32_t format)
+{
+    if (format == CU8_IQ) {
+        uint8_t const *cu8_buf = iq_buf;
+        for (unsigned long n = 0; n < len; ++n)
+            y_buf[n] = (cu8_buf[n] - 128) * 256; // scale Q0.7 to Q0.15
+    }
+    else if (format == CS8_IQ) {
+        int8_t const *cs8_buf = iq_buf;
+        for (unsigned long n = 0; n < len; ++n)
+            y_buf[n] = cs8_buf[n] * 256; // scale Q0.7 to Q0.15
+    }
+    else if (format == CF32_IQ) {
+        float const *cf32_buf = iq_buf;
+        for (unsigned long n = 0; n < len; ++n) {
+            float s = cf32_buf[n] * INT16_MAX;
+            y_buf[n] = s > INT16_MAX ? INT16_MAX : s < -INT16_MAX ? -INT16_MAX : (int16_t)s;
+        }
+    }
+    else { // CS16
+        memcpy(y_buf, iq_buf, len * sizeof(int16_t));
+    }
+}
+
+/// Filter and decimate one stage, the input follows the history in `work_buf`.
+static unsigned long halfband_stage(int16_t const *work_buf, int16_t *y_buf, unsigned long n_samples, unsigned *skip)
+{
+    unsigned long n   = *skip;
+    unsigned long len = 0;
+    for (; n < n_samples; n += 2) {
+        int16_t const *s = &work_buf[n * 2]; // oldest sample in the filter window
+        int32_t acc_re   = s[DECIMATOR_HIST] * 16384 + (1 << 14); // center tap and rounding
+        int32_t acc_im   = s[DECIMATOR_HIST + 1] * 16384 + (1 << 14);
+        for (unsigned k = 0; k < sizeof(halfband_coeffs) / sizeof(*halfband_coeffs); ++k) {
+            unsigned lo = DECIMATOR_HIST - 2 * (2 * k + 1); // offset of -(2k+1) samples
+            unsigned hi = DECIMATOR_HIST + 2 * (2 * k + 1); // offset of +(2k+1) samples
+            acc_re += halfband_coeffs[k] * (s[lo] + s[hi]);
+            acc_im += halfband_coeffs[k] * (s[lo + 1] + s[hi + 1]);
+        }
+        acc_re >>= 15;
+        acc_im >>= 15;
+        y_buf[len * 2]     = acc_re > INT16_MAX ? INT16_MAX : acc_re < INT16_MIN ? INT16_MIN : acc_re;
+        y_buf[len * 2 + 1] = acc_im > INT16_MAX ? INT16_MAX : acc_im < INT16_MIN ? INT16_MIN : acc_im;
+        len++;
+    }
+    *skip = n - n_samples;
+    return len;
+}
+
+unsigned long decimator_process(decimator_t *dec, void const *iq_buf, unsigned long n_samples, uint32_t format)
+{
+    dec->out_len = 0;
+    if (!dec->stages)
+        return 0;
+
+    if (dec->work_size < (DECIMATOR_HIST + n_samples) * 2) {
+        int16_t *work_buf = realloc(dec->work_buf, (DECIMATOR_HIST + n_samples) * 2 * sizeof(*work_buf));
+        if (!work_buf) {
+            WARN_REALLOC("decimator_process()");
+            return 0;
+        }
+        dec->work_buf  = work_buf;
+        dec->work_size = (DECIMATOR_HIST + n_samples) * 2;
+    }
+    unsigned long out_max = n_samples / 2 + 1;
+    if (dec->out_size < out_max * 2) {
+        int16_t *out_buf = realloc(dec->out_buf, out_max * 2 * sizeof(*out_buf));
+        if (!out_buf) {
+            WARN_REALLOC("decimator_process()");
+            return 0;
+        }
+        dec->out_buf  = out_buf;
+        dec->out_size = out_max * 2;
+    }
+
+    int16_t *x_buf = &dec->work_buf[DECIMATOR_HIST * 2];
+    convert_input(x_buf, iq_buf, n_samples * 2, format);
+    unsigned long len = n_samples;
+    for (unsigned s = 0; s < dec->stages; ++s) {
+        if (s > 0)
+            memcpy(x_buf, dec->out_buf, len * 2 * sizeof(*x_buf));
+        memcpy(dec->work_buf, dec->hist[s], sizeof(dec->hist[s]));
+        // keep the history for the next buffer
+        memcpy(dec->hist[s], &dec->work_buf[len * 2], sizeof(dec->hist[s]));
+        len = halfband_stage(dec->work_buf, dec->out_buf, len, &dec->skip[s]);
+    }
+    dec->out_len = len;
+    return len;
+}
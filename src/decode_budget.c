@@ -0,0 +1,49 @@
+/** @file
+    Decoder time budget, a cooperative guard against decoders that take too long on a package.
+
+    The dispatcher starts a budget around each decoder run, the helpers with loops over the bits,
+    e.g. bitbuffer_search(), give up once it is spent. The state is per thread for the decoder pool.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "decode_budget.h"
+#include "compat_pthread.h"
+#include "compat_time.h"
+
+static THREAD_LOCAL struct {
+    double deadline_us; ///< 0 for no budget
+    unsigned checks;    ///< calls since the clock was read
+    int expired;
+} budget;
+
+void decode_budget_start(unsigned budget_us)
+{
+    budget.deadline_us = budget_us ? monotonic_time_us() + budget_us : 0.0;
+    budget.checks      = 0;
+    budget.expired     = 0;
+}
+
+int decode_budget_stop(void)
+{
+    if (!budget.deadline_us)
+        return 0;
+    int over           = budget.expired || monotonic_time_us() > budget.deadline_us;
+    budget.deadline_us = 0.0;
+    budget.expired     = 0;
+    return over;
+}
+
+int decode_budget_expired(void)
+{
+    if (!budget.deadline_us || budget.expired)
+        return budget.expired;
+    if (++budget.checks < DECODE_BUDGET_CHECKS)
+        return 0;
+    budget.checks  = 0;
+    budget.expired = monotonic_time_us() > budget.deadline_us;
+    return budget.expired;
+}
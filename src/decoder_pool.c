@@ -0,0 +1,161 @@
+/** @file
+    Decoder pool, runs independent decoder jobs on worker threads.
+
+    The jobs of a run are handed out one at a time from a shared index,
+    so a thread that finishes early takes over the remaining jobs.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "decoder_pool.h"
+#include "compat_pthread.h"
+#include "thread_pin.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef THREADS
+
+struct decoder_pool {
+    unsigned num_threads;
+    pthread_t threads[DECODER_POOL_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond; ///< signals a new run or the exit
+    pthread_cond_t done_cond; ///< signals the last job of a run is done
+    unsigned generation;      ///< run counter, a change wakes the workers
+    int exit;
+    decoder_pool_fn fn;
+    void *ctx;
+    unsigned num_jobs;
+    unsigned next_job;
+    unsigned done_jobs;
+};
+
+/// Take and run jobs until none are left, the lock is held on entry and on return.
+static void decoder_pool_work(decoder_pool_t *pool)
+{
+    while (pool->next_job < pool->num_jobs) {
+        unsigned job = pool->next_job++;
+        pthread_mutex_unlock(&pool->lock);
+        pool->fn(pool->ctx, job);
+        pthread_mutex_lock(&pool->lock);
+        pool->done_jobs++;
+        if (pool->done_jobs == pool->num_jobs)
+            pthread_cond_broadcast(&pool->done_cond);
+    }
+}
+
+static THREAD_RETURN THREAD_CALL decoder_pool_thread(void *arg)
+{
+    decoder_pool_t *pool = arg;
+    thread_pin_self(THREAD_DECODE);
+    pthread_mutex_lock(&pool->lock);
+    unsigned generation = pool->generation;
+    while (!pool->exit) {
+        if (pool->generation == generation) {
+            pthread_cond_wait(&pool->work_cond, &pool->lock);
+            continue;
+        }
+        generation = pool->generation;
+        decoder_pool_work(pool);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return (THREAD_RETURN)0;
+}
+
+decoder_pool_t *decoder_pool_create(unsigned num_threads)
+{
+    if (num_threads > DECODER_POOL_MAX_THREADS)
+        num_threads = DECODER_POOL_MAX_THREADS;
+    decoder_pool_t *pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        WARN_CALLOC("decoder_pool_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (unsigned i = 0; i < num_threads; ++i) {
+        if (pthread_create(&pool->threads[i], NULL, decoder_pool_thread, pool)) {
+            fprintf(stderr, "%s: failed to start thread %u\n", __func__, i);
+            break;
+        }
+        pool->num_threads++;
+    }
+    if (!pool->num_threads) {
+        decoder_pool_free(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void decoder_pool_free(decoder_pool_t *pool)
+{
+    if (!pool)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->exit = 1;
+    pthread_cond_broadcast(&pool->work_cond);
+    pthread_mutex_unlock(&pool->lock);
+    for (unsigned i = 0; i < pool->num_threads; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->work_cond);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+void decoder_pool_run(decoder_pool_t *pool, unsigned num_jobs, decoder_pool_fn fn, void *ctx)
+{
+    if (!pool || num_jobs < 2) {
+        for (unsigned job = 0; job < num_jobs; ++job) {
+            fn(ctx, job);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->fn        = fn;
+    pool->ctx       = ctx;
+    pool->num_jobs  = num_jobs;
+    pool->next_job  = 0;
+    pool->done_jobs = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_cond);
+
+    decoder_pool_work(pool);
+    while (pool->done_jobs < pool->num_jobs) {
+        pthread_cond_wait(&pool->done_cond, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+#else
+
+decoder_pool_t *decoder_pool_create(unsigned num_threads)
+{
+    (void)num_threads;
+    fprintf(stderr, "%s: built without threads support\n", __func__);
+    return NULL;
+}
+
+void decoder_pool_free(decoder_pool_t *pool)
+{
+    (void)pool;
+}
+
+void decoder_pool_run(decoder_pool_t *pool, unsigned num_jobs, decoder_pool_fn fn, void *ctx)
+{
+    (void)pool;
+    for (unsigned job = 0; job < num_jobs; ++job) {
+        fn(ctx, job);
+    }
+}
+
+#endif
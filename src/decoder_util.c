@@ -12,11 +12,12 @@
 #include "decoder_util.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "fatal.h"
 
 // create decoder functions
 
-r_device *create_device(r_device *dev_template)
+r_device *create_device(r_device const *dev_template)
 {
     r_device *r_dev = malloc(sizeof (*r_dev));
     if (!r_dev) {
@@ -146,6 +147,27 @@ void decoder_output_data(r_device *decoder, data_t *data)
     decoder->output_fn(decoder, data);
 }
 
+data_record_t *decoder_record(r_device *decoder)
+{
+    if (!decoder->record)
+        decoder->record = data_record_create((char const *const *)decoder->fields);
+    data_record_clear(decoder->record);
+    return decoder->record;
+}
+
+void decoder_output_record(r_device *decoder, data_record_t *record)
+{
+    if (!record)
+        return;
+    if (decoder->output_record_fn) {
+        decoder->output_record_fn(decoder, record);
+        return;
+    }
+    data_t *data = data_record_make(record);
+    if (data)
+        decoder_output_data(decoder, data);
+}
+
 void decoder_output_message(r_device *decoder, char const *msg)
 {
     data_t *data = data_make(
@@ -304,3 +326,90 @@ void decoder_output_bitrow(r_device *decoder, uint8_t const *bitrow, unsigned bi
     free(row_code);
     free(row_bits);
 }
+
+unsigned decoder_search_preamble(r_device const *decoder, bitbuffer_t *bitbuffer, unsigned row, unsigned start,
+        uint8_t const *pattern, unsigned pattern_bits_len)
+{
+    preamble_matches_t const *matches = decoder->preamble_matches;
+    if (!matches || matches->overflow || decoder->preamble_bitbuffer != bitbuffer
+            || decoder->preamble_bits != pattern_bits_len)
+        return bitbuffer_search(bitbuffer, row, start, pattern, pattern_bits_len);
+
+    for (unsigned i = 0; i < matches->num; ++i) {
+        struct preamble_match const *match = &matches->match[i];
+        if (match->mask == decoder->preamble_mask && match->row == row && match->pos >= start)
+            return match->pos;
+    }
+    return bitbuffer->bits_per_row[row];
+}
+
+// learned parameter functions
+
+static int decoder_learned_find(decoder_learned_t const *learned, char const *key)
+{
+    for (unsigned i = 0; i < learned->len; ++i) {
+        if (!strcmp(learned->entry[i].key, key))
+            return (int)i;
+    }
+    return -1;
+}
+
+/// Add or change a parameter, return 1 if the value changed.
+static int decoder_learned_put(decoder_learned_t *learned, char const *key, uint32_t value)
+{
+    int i = decoder_learned_find(learned, key);
+    if (i < 0) {
+        if (learned->len >= DECODER_LEARNED_MAX || strlen(key) >= sizeof(learned->entry[0].key))
+            return 0;
+        i = (int)learned->len++;
+        strcpy(learned->entry[i].key, key);
+    }
+    else if (learned->entry[i].value == value) {
+        return 0;
+    }
+    learned->entry[i].value = value;
+    return 1;
+}
+
+unsigned decoder_learned_load(decoder_learned_t *learned, char const *path)
+{
+    snprintf(learned->path, sizeof(learned->path), "%s", path);
+
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return 0;
+
+    unsigned loaded = 0;
+    char key[16];
+    unsigned long value;
+    while (fscanf(file, "%15s %lu", key, &value) == 2) {
+        loaded += decoder_learned_put(learned, key, (uint32_t)value);
+    }
+    fclose(file);
+    return loaded;
+}
+
+int decoder_learned_get(decoder_learned_t const *learned, char const *key, uint32_t *value)
+{
+    int i = decoder_learned_find(learned, key);
+    if (i < 0)
+        return 0;
+    *value = learned->entry[i].value;
+    return 1;
+}
+
+void decoder_learned_set(decoder_learned_t *learned, char const *key, uint32_t value)
+{
+    if (!decoder_learned_put(learned, key, value) || !*learned->path)
+        return;
+
+    FILE *file = fopen(learned->path, "w");
+    if (!file) {
+        fprintf(stderr, "%s: failed to write \"%s\"\n", __func__, learned->path);
+        return;
+    }
+    for (unsigned i = 0; i < learned->len; ++i) {
+        fprintf(file, "%s %lu\n", learned->entry[i].key, (unsigned long)learned->entry[i].value);
+    }
+    fclose(file);
+}
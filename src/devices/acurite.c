@@ -1869,7 +1869,7 @@ static char *acurite_rain_gauge_output_fields[] = {
         NULL,
 };
 
-r_device acurite_rain_896 = {
+r_device const acurite_rain_896 = {
         .name        = "Acurite 896 Rain Gauge",
         .modulation  = OOK_PULSE_PPM,
         .short_width = 1000,
@@ -1892,7 +1892,7 @@ static char *acurite_th_output_fields[] = {
         NULL,
 };
 
-r_device acurite_th = {
+r_device const acurite_th = {
         .name        = "Acurite 609TXC Temperature and Humidity Sensor",
         .modulation  = OOK_PULSE_PPM,
         .short_width = 1000,
@@ -1936,7 +1936,7 @@ static char *acurite_txr_output_fields[] = {
         NULL,
 };
 
-r_device acurite_txr = {
+r_device const acurite_txr = {
         .name        = "Acurite 592TXR Temp/Humidity, 5n1 Weather Station, 6045 Lightning, 899 Rain, 3N1, Atlas",
         .modulation  = OOK_PULSE_PWM,
         .short_width = 220,  // short pulse is 220 us + 392 us gap
@@ -1969,7 +1969,7 @@ static char *acurite_986_output_fields[] = {
         NULL,
 };
 
-r_device acurite_986 = {
+r_device const acurite_986 = {
         .name        = "Acurite 986 Refrigerator / Freezer Thermometer",
         .modulation  = OOK_PULSE_PPM,
         .short_width = 520,
@@ -2013,7 +2013,7 @@ static char *acurite_590_output_fields[] = {
 //.long_width     = 1076,
 //.gap_limit      = 1200,
 //.reset_limit    = 12000,
-r_device acurite_606 = {
+r_device const acurite_606 = {
         .name        = "Acurite 606TX Temperature Sensor",
         .modulation  = OOK_PULSE_PPM,
         .short_width = 2000,
@@ -2038,7 +2038,7 @@ static char *acurite_00275rm_output_fields[] = {
         NULL,
 };
 
-r_device acurite_00275rm = {
+r_device const acurite_00275rm = {
         .name        = "Acurite 00275rm,00276rm Temp/Humidity with optional probe",
         .modulation  = OOK_PULSE_PWM,
         .short_width = 232, // short pulse is 232 us
@@ -2050,7 +2050,7 @@ r_device acurite_00275rm = {
         .fields      = acurite_00275rm_output_fields,
 };
 
-r_device acurite_590tx = {
+r_device const acurite_590tx = {
         .name        = "Acurite 590TX Temperature with optional Humidity",
         .modulation  = OOK_PULSE_PPM, // OOK_PULSE_PWM,
         .short_width = 500,           // short pulse is 232 us
@@ -122,7 +122,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device altronics_7064 = {
+r_device const altronics_7064 = {
         .name        = "Altronics X7064 temperature and humidity sensor",
         .modulation  = FSK_PULSE_PCM,
         .short_width = 90,
@@ -83,8 +83,7 @@ static int archos_tbh_decode(r_device *decoder, bitbuffer_t *bitbuffer)
         return DECODE_ABORT_LENGTH;
     }
 
-    uint8_t len;
-    bitbuffer_extract_bytes(bitbuffer, row, start_pos + sizeof (preamble) * 8, &len, 8);
+    uint8_t len = bitbuffer_extract_u32(bitbuffer, row, start_pos + sizeof (preamble) * 8, 8);
 
     if (len > 60) {
         decoder_logf(decoder, 1, __func__, "packet to large (%d bytes), drop it", len);
@@ -225,7 +224,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device archos_tbh = {
+r_device const archos_tbh = {
         .name        = "TBH weather sensor",
         .modulation  = FSK_PULSE_PCM,
         .short_width = 212,
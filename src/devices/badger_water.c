@@ -151,7 +151,7 @@ static char *badger_output_fields[] = {
 
 // Badger ORION water meter,
 // Frequency 916.45 MHz, Bitrate 100 kbps, Modulation NRZ FSK
-r_device badger_orion = {
+r_device const badger_orion = {
         .name        = "Badger ORION water meter, 100kbps (-f 916450000 -s 1200000)", // Minimum samplerate = 1.2 MHz (12 samples of 100kb/s)
         .modulation  = FSK_PULSE_PCM,
         .short_width = 10,   // Bit rate: 100 kb/s
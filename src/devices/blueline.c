@@ -126,6 +126,11 @@ if there is more than one monitor in range or the messages being received are al
 meter is continuously reporting 0 watts).  If it succeeds, it will start reporting data with the new ID,
 which you should then use as a parameter when you re-run rtl_433 in the future.
 
+To keep an auto-detected ID across restarts use the "learn" parameter with a file name instead,
+the ID is searched once and then loaded from the file on the next start:
+
+    rtl_433 -R 176:learn=blueline_id.txt
+
 Finally, passing a parameter to this decoder requires specifying it explicitly, which normally disables all
 other default decoders.  If you want to pass an option to this decoder without disabling all the other defaults,
 the simplest method is to explicitly exclude this one decoder (which implicitly says to leave all other defaults
@@ -153,6 +158,7 @@ struct blueline_stateful_context {
     unsigned id_guess_hits[MAX_POSSIBLE_BLUELINE_IDS];
     uint16_t current_sensor_id;
     unsigned searching_for_new_id;
+    decoder_learned_t learned; ///< the detected ID, see the "learn" parameter
 };
 
 static uint8_t rev_crc8(uint8_t const message[], unsigned nBytes, uint8_t polynomial, uint8_t remainder)
@@ -287,6 +293,7 @@ static int blueline_decode(r_device *decoder, bitbuffer_t *bitbuffer)
                     decoder_logf(decoder, 1, __func__,"Switching to auto-detected Blueline ID %u", id_guess);
                     context->current_sensor_id = id_guess;
                     context->searching_for_new_id = 0;
+                    decoder_learned_set(&context->learned, "id", id_guess);
                 }
             }
             if (DECODE_FAIL_MIC < most_applicable_failure) {
@@ -310,6 +317,7 @@ static int blueline_decode(r_device *decoder, bitbuffer_t *bitbuffer)
                 decoder_logf(decoder, 1, __func__,"Switching to received Blueline ID %u", received_sensor_id);
                 context->current_sensor_id = received_sensor_id;
                 context->searching_for_new_id = 0;
+                decoder_learned_set(&context->learned, "id", received_sensor_id);
             }
         } else if (message_type == BLUELINE_POWER_MSG) {
             const uint16_t ms_per_pulse = offset_payload_u16;
@@ -396,7 +404,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device blueline;
+extern r_device const blueline;
 
 static r_device *blueline_create(char *arg)
 {
@@ -420,6 +428,15 @@ static r_device *blueline_create(char *arg)
             // Setup for auto identification
             context->searching_for_new_id = 1;
             //fprintf(stderr, "Blueline decoder will try to autodetect ID.\n");
+        } else if (strncmp(arg, "learn=", 6) == 0) {
+            // Auto identification once, the ID is kept in the file
+            uint32_t id = 0;
+            decoder_learned_load(&context->learned, arg + 6);
+            if (decoder_learned_get(&context->learned, "id", &id)) {
+                context->current_sensor_id = (uint16_t)id;
+            } else {
+                context->searching_for_new_id = 1;
+            }
         } else {
             // Assume user is trying to pass in hex ID
             context->current_sensor_id = strtoul(arg, NULL, 0);
@@ -430,7 +447,7 @@ static r_device *blueline_create(char *arg)
     return r_dev;
 }
 
-r_device blueline = {
+r_device const blueline = {
         .name        = "BlueLine Innovations Power Cost Monitor",
         .modulation  = OOK_PULSE_PPM,
         .short_width = 500,
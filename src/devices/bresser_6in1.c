@@ -237,7 +237,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device bresser_6in1 = {
+r_device const bresser_6in1 = {
         .name        = "Bresser Weather Center 6-in-1, 7-in-1 indoor, soil, new 5-in-1, 3-in-1 wind gauge, Froggit WH6000, Ventus C8488A",
         .modulation  = FSK_PULSE_PCM,
         .short_width = 124,
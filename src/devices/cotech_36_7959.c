@@ -145,7 +145,7 @@ static char *cotech_36_7959_output_fields[] = {
         NULL,
 };
 
-r_device cotech_36_7959 = {
+r_device const cotech_36_7959 = {
         .name        = "Cotech 36-7959, SwitchDocLabs FT020T wireless weather station with USB",
         .modulation  = OOK_PULSE_MANCHESTER_ZEROBIT,
         .short_width = 500,
@@ -215,7 +215,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device digitech_xc0324 = {
+r_device const digitech_xc0324 = {
         .name        = "Digitech XC-0324 temperature sensor",
         .modulation  = OOK_PULSE_PPM,
         .short_width = 520,  // = 130 * 4
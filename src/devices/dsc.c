@@ -262,7 +262,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device dsc_security = {
+r_device const dsc_security = {
         .name        = "DSC Security Contact",
         .modulation  = OOK_PULSE_RZ,
         .short_width = 250,  // Pulse length, 250 µs
@@ -270,9 +270,10 @@ r_device dsc_security = {
         .reset_limit = 5000, // Max gap,
         .decode_fn   = &dsc_callback,
         .fields      = output_fields,
+        .urgent      = 1,
 };
 
-r_device dsc_security_ws4945 = {
+r_device const dsc_security_ws4945 = {
         // Used for EV-DW4927, WS4975 and WS4945.
         .name        = "DSC Security Contact (WS4945)",
         .modulation  = OOK_PULSE_RZ,
@@ -281,4 +282,5 @@ r_device dsc_security_ws4945 = {
         .reset_limit = 9000, // Max gap, based on 8 zero bits between sync bit
         .decode_fn   = &dsc_callback,
         .fields      = output_fields,
+        .urgent      = 1,
 };
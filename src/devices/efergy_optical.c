@@ -134,7 +134,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device efergy_optical = {
+r_device const efergy_optical = {
         .name        = "Efergy Optical",
         .modulation  = FSK_PULSE_PWM,
         .short_width = 64,
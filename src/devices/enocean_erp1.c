@@ -97,7 +97,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device enocean_erp1 = {
+r_device const enocean_erp1 = {
         .name        = "EnOcean ERP1",
         .modulation  = OOK_PULSE_PCM,
         .short_width = 8,
@@ -101,12 +101,16 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device esa_energy = {
+r_device const esa_energy = {
         .name        = "ESA1000 / ESA2000 Energy Monitor",
         .modulation  = OOK_PULSE_MANCHESTER_ZEROBIT,
         .short_width = 260,
         .long_width  = 0,
         .reset_limit = 3000,
+        .min_rows    = 1,
+        .max_rows    = 1,
+        .min_bits    = 160,
+        .max_bits    = 160,
         .decode_fn   = &esa_cost_callback,
         .disabled    = 1,
         .fields      = output_fields,
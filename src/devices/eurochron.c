@@ -93,7 +93,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device eurochron = {
+r_device const eurochron = {
         .name        = "Eurochron temperature and humidity sensor",
         .modulation  = OOK_PULSE_PPM,
         .short_width = 1016,
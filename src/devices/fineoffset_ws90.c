@@ -165,7 +165,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device fineoffset_ws90 = {
+r_device const fineoffset_ws90 = {
         .name        = "Fine Offset Electronics WS90 weather station",
         .modulation  = FSK_PULSE_PCM,
         .short_width = 58,
@@ -14,18 +14,26 @@
 #include "fatal.h"
 #include <stdlib.h>
 
+#ifndef NO_FLEX_DECODER
+
 static inline int bit(const uint8_t *bytes, unsigned bit)
 {
     return bytes[bit >> 3] >> (7 - (bit & 7)) & 1;
 }
 
-/// extract all mask bits skipping unmasked bits of a number up to 32/64 bits
-static unsigned long compact_number(uint8_t *data, unsigned bit_offset, unsigned long mask)
+/// highest set bit of a mask plus one, i.e. the number of bits spanned by the mask
+static int mask_top_bit(unsigned long mask)
 {
     // clz (fls) is not worth the trouble
     int top_bit = 0;
     while (mask >> top_bit)
         top_bit++;
+    return top_bit;
+}
+
+/// extract all mask bits skipping unmasked bits of a number up to 32/64 bits
+static unsigned long compact_number(uint8_t *data, unsigned bit_offset, unsigned long mask, int top_bit)
+{
     unsigned long val = 0;
     for (int b = top_bit - 1; b >= 0; --b) {
         if (mask & (1 << b)) {
@@ -69,6 +77,7 @@ struct flex_get {
     unsigned bit_offset;
     unsigned bit_count;
     unsigned long mask;
+    int mask_top;           ///< bits spanned by the mask, precomputed from mask
     const char *name;
     struct flex_map map[GETTER_MAP_SLOTS];
     const char *format;
@@ -92,6 +101,9 @@ struct flex_params {
     uint8_t match_bits[128];
     unsigned preamble_len;
     uint8_t preamble_bits[128];
+    bitbuffer_pattern_t match_pattern;    ///< prepared from match_bits
+    bitbuffer_pattern_t preamble_pattern; ///< prepared from preamble_bits
+    unsigned fit_bits; ///< a row shorter than this can't hold the match and preamble
     uint32_t symbol_zero;
     uint32_t symbol_one;
     uint32_t symbol_sync;
@@ -119,7 +131,7 @@ static void render_getters(data_t *data, uint8_t *bits, struct flex_params *para
         struct flex_get *getter = &params->getter[g];
         unsigned long val;
         if (getter->mask)
-            val = compact_number(bits, getter->bit_offset, getter->mask);
+            val = compact_number(bits, getter->bit_offset, getter->mask, getter->mask_top);
         else
             val = extract_number(bits, getter->bit_offset, getter->bit_count);
         int m;
@@ -179,6 +191,20 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         return DECODE_ABORT_EARLY;
     // TODO: set match_count to count of repeated rows
 
+    // discard early if no row is long enough to match, before any row is modified
+    if (params->fit_bits) {
+        for (i = 0; i < bitbuffer->num_rows; i++) {
+            if (bitbuffer->bits_per_row[i] >= params->fit_bits)
+                break;
+        }
+        if (i == bitbuffer->num_rows)
+            return DECODE_FAIL_SANITY;
+    }
+
+    // a scratch buffer for the row transforms, the rows are cleared when used
+    bitbuffer_t tmp;
+    bitbuffer_init(&tmp);
+
     if (params->invert) {
         bitbuffer_invert(bitbuffer);
     }
@@ -195,7 +221,7 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         r = -1;
         match_count = 0;
         for (i = 0; i < bitbuffer->num_rows; i++) {
-            if (bitbuffer_search(bitbuffer, i, 0, params->match_bits, params->match_len) < bitbuffer->bits_per_row[i]) {
+            if (bitbuffer_search_pattern(bitbuffer, i, 0, &params->match_pattern) < bitbuffer->bits_per_row[i]) {
                 if (r < 0)
                     r = i;
                 match_count++;
@@ -210,7 +236,7 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         r = -1;
         match_count = 0;
         for (i = 0; i < bitbuffer->num_rows; i++) {
-            unsigned pos = bitbuffer_search(bitbuffer, i, 0, params->preamble_bits, params->preamble_len);
+            unsigned pos = bitbuffer_search_pattern(bitbuffer, i, 0, &params->preamble_pattern);
             if (pos < bitbuffer->bits_per_row[i]) {
                 if (r < 0)
                     r = i;
@@ -218,7 +244,6 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
                 pos += params->preamble_len;
                 // TODO: refactor to bitbuffer_shift_row()
                 unsigned len = bitbuffer->bits_per_row[i] - pos;
-                bitbuffer_t tmp = {0};
                 bitbuffer_extract_bytes(bitbuffer, i, pos, tmp.bb[0], len);
                 memcpy(bitbuffer->bb[i], tmp.bb[0], (len + 7) / 8);
                 bitbuffer->bits_per_row[i] = len;
@@ -235,10 +260,10 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 
         for (i = 0; i < bitbuffer->num_rows; i++) {
             // TODO: refactor to bitbuffer_decode_symbol_row()
-            unsigned len    = bitbuffer->bits_per_row[i];
-            bitbuffer_t tmp = {0};
-            len             = extract_bits_symbols(bitbuffer->bb[i], 0, len, zero, one, sync, tmp.bb[0]);
-            memcpy(bitbuffer->bb[i], tmp.bb[0], len); // safe to write over: can only be shorter
+            unsigned len = bitbuffer->bits_per_row[i];
+            memset(tmp.bb[0], 0, (len + 7) / 8); // only set bits are written, the output is shorter
+            len          = extract_bits_symbols(bitbuffer->bb[i], 0, len, zero, one, sync, tmp.bb[0]);
+            memcpy(bitbuffer->bb[i], tmp.bb[0], (len + 7) / 8); // safe to write over: can only be shorter
             bitbuffer->bits_per_row[i] = len;
         }
         // TODO: apply min_bits, max_bits check
@@ -248,7 +273,6 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         for (i = 0; i < bitbuffer->num_rows; i++) {
             // TODO: refactor to bitbuffer_decode_uart_row()
             unsigned len = bitbuffer->bits_per_row[i];
-            bitbuffer_t tmp = {0};
             len = extract_bytes_uart(bitbuffer->bb[i], 0, len, tmp.bb[0]);
             memcpy(bitbuffer->bb[i], tmp.bb[0], len); // safe to write over: can only be shorter
             bitbuffer->bits_per_row[i] = len * 8;
@@ -259,7 +283,7 @@ static int flex_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         for (i = 0; i < bitbuffer->num_rows; i++) {
             // TODO: refactor to bitbuffer_decode_dm_row()
             unsigned len = bitbuffer->bits_per_row[i];
-            bitbuffer_t tmp = {0};
+            bitbuffer_reset(&tmp);
             bitbuffer_differential_manchester_decode(bitbuffer, i, 0, &tmp, len);
             len = tmp.bits_per_row[0];
             memcpy(bitbuffer->bb[i], tmp.bb[0], (len + 7) / 8); // safe to write over: can only be shorter
@@ -708,6 +732,20 @@ r_device *flex_create_device(char *spec)
     if (params->min_bits > 0 && params->min_repeats < 1)
         params->min_repeats = 1;
 
+    // let the dispatcher discard short / unwanted bitbuffers
+    dev->min_rows = params->min_rows;
+    dev->max_rows = params->max_rows;
+    dev->min_bits = params->min_bits;
+    dev->max_bits = params->max_bits;
+
+    // precompute the matcher
+    bitbuffer_pattern_init(&params->match_pattern, params->match_bits, params->match_len);
+    bitbuffer_pattern_init(&params->preamble_pattern, params->preamble_bits, params->preamble_len);
+    params->fit_bits = params->match_len > params->preamble_len ? params->match_len : params->preamble_len;
+    for (int g = 0; g < GETTER_SLOTS; ++g) {
+        params->getter[g].mask_top = mask_top_bit(params->getter[g].mask);
+    }
+
     // add getter fields if unique requested
     if (params->unique) {
         int i = 0;
@@ -783,3 +821,16 @@ r_device *flex_create_device(char *spec)
     free(spec);
     return dev;
 }
+
+#else
+
+r_device *flex_create_device(char *spec);
+
+r_device *flex_create_device(char *spec)
+{
+    (void)spec;
+    fprintf(stderr, "The flex decoder is not available, rebuild with -DENABLE_FLEX=ON\n");
+    exit(1);
+}
+
+#endif
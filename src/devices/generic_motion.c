@@ -68,7 +68,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device generic_motion = {
+r_device const generic_motion = {
         .name        = "Generic wireless motion sensor",
         .modulation  = OOK_PULSE_PWM,
         .short_width = 888,
@@ -78,4 +78,5 @@ r_device generic_motion = {
         .reset_limit = 2724 * 1.5,
         .decode_fn   = &generic_motion_callback,
         .fields      = output_fields,
+        .urgent      = 1,
 };
@@ -19,9 +19,16 @@ Tested devices:
 
 #include "decoder.h"
 
+/// The slots of the record, in the order of the output fields.
+enum {
+    FIELD_MODEL,
+    FIELD_ID,
+    FIELD_CMD,
+    FIELD_TRISTATE,
+};
+
 static int generic_remote_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    data_t *data;
     uint8_t *b = bitbuffer->bb[0];
     char tristate[23];
     char *p = tristate;
@@ -57,16 +64,13 @@ static int generic_remote_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     }
     *p = '\0';
 
-    /* clang-format off */
-    data = data_make(
-            "model",        "",             DATA_STRING, "Generic-Remote",
-            "id",           "House Code",   DATA_INT, id_16b,
-            "cmd",          "Command",      DATA_INT, cmd_8b,
-            "tristate",     "Tri-State",    DATA_STRING, tristate,
-            NULL);
-    /* clang-format on */
+    data_record_t *record = decoder_record(decoder);
+    data_record_string(record, FIELD_MODEL,    "",           "Generic-Remote");
+    data_record_int(record,    FIELD_ID,       "House Code", NULL, id_16b);
+    data_record_int(record,    FIELD_CMD,      "Command",    NULL, cmd_8b);
+    data_record_string(record, FIELD_TRISTATE, "Tri-State",  tristate);
 
-    decoder_output_data(decoder, data);
+    decoder_output_record(decoder, record);
 
     return 1;
 }
@@ -79,7 +83,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device generic_remote = {
+r_device const generic_remote = {
         .name        = "Generic Remote SC226x EV1527",
         .modulation  = OOK_PULSE_PWM,
         .short_width = 464,
@@ -238,7 +238,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device govee = {
+r_device const govee = {
         .name        = "Govee Water Leak Detector H5054, Door Contact Sensor B5023",
         .modulation  = OOK_PULSE_PWM,
         .short_width = 440,  // Threshold between short and long pulse [us]
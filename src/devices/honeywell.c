@@ -139,7 +139,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device honeywell = {
+r_device const honeywell = {
         .name        = "Honeywell Door/Window Sensor, 2Gig DW10/DW11, RE208 repeater",
         .modulation  = OOK_PULSE_MANCHESTER_ZEROBIT,
         .short_width = 156,
@@ -147,4 +147,5 @@ r_device honeywell = {
         .reset_limit = 292,
         .decode_fn   = &honeywell_decode,
         .fields      = output_fields,
+        .urgent      = 1,
 };
@@ -89,12 +89,16 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device ibis_beacon = {
+r_device const ibis_beacon = {
         .name        = "IBIS beacon",
         .modulation  = OOK_PULSE_MANCHESTER_ZEROBIT,
         .short_width = 30,  // Nominal width of clock half period [us]
         .long_width  = 0,   // Not used
         .reset_limit = 100, // Maximum gap size before End Of Message [us].
+        .min_rows    = 1,
+        .max_rows    = 1,
+        .min_bits    = 232,
+        .max_bits    = 250,
         .decode_fn   = &ibis_beacon_callback,
         .fields      = output_fields,
 };
@@ -489,7 +489,7 @@ static char *output_fields[] = {
 
 //     -X 'n=Insteon_F16,m=FSK_PCM,s=110,l=110,t=15,g=20000,r=20000,invert,match={16}0x6666'
 
-r_device insteon = {
+r_device const insteon = {
         .name        = "Insteon",
         .modulation  = FSK_PULSE_PCM,
         .short_width = 110, // short gap is 132 us
@@ -499,4 +499,5 @@ r_device insteon = {
         .reset_limit = 1000, // a bit longer than packet gap
         .decode_fn   = &insteon_callback,
         .fields      = output_fields,
+        .bands       = BAND_915,
 };
@@ -228,7 +228,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device interlogix = {
+r_device const interlogix = {
         .name        = "Interlogix GE UTC Security Devices",
         .modulation  = OOK_PULSE_PPM,
         .short_width = 122,
@@ -236,4 +236,5 @@ r_device interlogix = {
         .reset_limit = 500, // Maximum gap size before End Of Message
         .decode_fn   = &interlogix_decode,
         .fields      = output_fields,
+        .urgent      = 1,
 };
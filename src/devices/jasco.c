@@ -77,7 +77,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device jasco = {
+r_device const jasco = {
         .name        = "Jasco/GE Choice Alert Security Devices",
         .modulation  = OOK_PULSE_PCM,
         .short_width = 250,
@@ -166,7 +166,7 @@ static char *output_fields[] = {
 };
 
 // flex decoder m=FSK_PCM, s=107, l=107, r=5900
-r_device lacrosse_breezepro = {
+r_device const lacrosse_breezepro = {
         .name        = "LaCrosse Technology View LTV-WSDTH01 Breeze Pro Wind Sensor",
         .modulation  = FSK_PULSE_PCM,
         .short_width = 107,
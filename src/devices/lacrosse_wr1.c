@@ -136,12 +136,15 @@ static char *output_fields[] = {
 };
 
 // flex decoder m=FSK_PCM, s=104, l=104, r=9600
-r_device lacrosse_wr1 = {
+r_device const lacrosse_wr1 = {
         .name        = "LaCrosse Technology View LTV-WR1 Multi Sensor",
         .modulation  = FSK_PULSE_PCM,
         .short_width = 104,
         .long_width  = 104,
         .reset_limit = 9600,
+        .min_bits    = 120,
+        .max_bits    = 156,
         .decode_fn   = &lacrosse_wr1_decode,
         .fields      = output_fields,
+        .bands       = BAND_915,
 };
@@ -28,44 +28,55 @@ static unsigned bcd2int(uint8_t bcd)
     return 10*(bcd>>4) + (bcd & 0xF);
 }
 
-// Mapping from 6 bits to 4 bits. "3of6" coding used for Mode T
-static uint8_t m_bus_decode_3of6(uint8_t byte)
+// Mapping from 6 bits to 4 bits, 0xFF for invalid codes. "3of6" coding used for Mode T
+static uint8_t const m_bus_3of6_table[64] = {
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // 0x00
+        0xFF, 0xFF, 0xFF, 0x3,  0xFF, 0x1,  0x2,  0xFF, // 0x08: 0x0B, 0x0D, 0x0E
+        0xFF, 0xFF, 0xFF, 0x7,  0xFF, 0xFF, 0x0,  0xFF, // 0x10: 0x13, 0x16
+        0xFF, 0x5,  0x6,  0xFF, 0x4,  0xFF, 0xFF, 0xFF, // 0x18: 0x19, 0x1A, 0x1C
+        0xFF, 0xFF, 0xFF, 0xB,  0xFF, 0x9,  0xA,  0xFF, // 0x20: 0x23, 0x25, 0x26
+        0xFF, 0xF,  0xFF, 0xFF, 0x8,  0xFF, 0xFF, 0xFF, // 0x28: 0x29, 0x2C
+        0xFF, 0xD,  0xE,  0xFF, 0xC,  0xFF, 0xFF, 0xFF, // 0x30: 0x31, 0x32, 0x34
+        0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, // 0x38
+};
+
+// Decode two 6 bit codes to a byte, an invalid code sets the bits of its nibble (and the high nibble)
+static uint8_t m_bus_decode_3of6(unsigned codes)
 {
-    uint8_t out = 0xFF; // Error
-    //fprintf(stderr,"Decode %0d\n", byte);
-    switch(byte) {
-        case 22:    out = 0x0;  break;  // 0x16
-        case 13:    out = 0x1;  break;  // 0x0D
-        case 14:    out = 0x2;  break;  // 0x0E
-        case 11:    out = 0x3;  break;  // 0x0B
-        case 28:    out = 0x4;  break;  // 0x17
-        case 25:    out = 0x5;  break;  // 0x19
-        case 26:    out = 0x6;  break;  // 0x1A
-        case 19:    out = 0x7;  break;  // 0x13
-        case 44:    out = 0x8;  break;  // 0x2C
-        case 37:    out = 0x9;  break;  // 0x25
-        case 38:    out = 0xA;  break;  // 0x26
-        case 35:    out = 0xB;  break;  // 0x23
-        case 52:    out = 0xC;  break;  // 0x34
-        case 49:    out = 0xD;  break;  // 0x31
-        case 50:    out = 0xE;  break;  // 0x32
-        case 41:    out = 0xF;  break;  // 0x29
-        default:    break;  // Error
-    }
-    return out;
+    uint8_t nibble_h = m_bus_3of6_table[(codes >> 6) & 0x3F];
+    uint8_t nibble_l = m_bus_3of6_table[codes & 0x3F];
+    return (uint8_t)((nibble_h << 4) | nibble_l);
 }
 
-
 // Decode input 6 bit nibbles to output 4 bit nibbles (packed in bytes). "3of6" coding used for Mode T
-// Bad data must be handled with second layer CRC
+// The bits are read as 64-bit windows of five bytes (60 bits), the tail 12 bits at a time.
+// Bad data must be handled with second layer CRC, returns the number of invalid codes
 static int m_bus_decode_3of6_buffer(uint8_t const *bits, unsigned bit_offset, uint8_t* output, unsigned num_bytes)
 {
-    for (unsigned n=0; n<num_bytes; ++n) {
-        uint8_t nibble_h = m_bus_decode_3of6(bitrow_get_byte(bits, n*12+bit_offset) >> 2);
-        uint8_t nibble_l = m_bus_decode_3of6(bitrow_get_byte(bits, n*12+bit_offset+6) >> 2);
-        output[n] = (nibble_h << 4) | nibble_l;
+    int invalid = 0;
+    unsigned n = 0;
+    for (; n + 5 <= num_bytes; n += 5) {
+        unsigned pos = n * 12 + bit_offset;
+        uint8_t const *p = &bits[pos >> 3];
+        uint64_t window = 0;
+        for (unsigned i = 0; i < 8; ++i) {
+            window = window << 8 | p[i];
+        }
+        // align to the first code, the window keeps the 60 bits of five bytes
+        window = window << (pos & 7) | (uint64_t)p[8] >> (8 - (pos & 7));
+        for (unsigned i = 0; i < 5; ++i) {
+            unsigned codes = (unsigned)(window >> (52 - i * 12)) & 0xFFF;
+            output[n + i] = m_bus_decode_3of6(codes);
+            invalid += (m_bus_3of6_table[codes >> 6] == 0xFF) + (m_bus_3of6_table[codes & 0x3F] == 0xFF);
+        }
     }
-    return 0;
+    for (; n < num_bytes; ++n) {
+        unsigned pos   = n * 12 + bit_offset;
+        unsigned codes = (unsigned)bitrow_get_byte(bits, pos) << 4 | bitrow_get_byte(bits, pos + 8) >> 4;
+        output[n] = m_bus_decode_3of6(codes);
+        invalid += (m_bus_3of6_table[codes >> 6] == 0xFF) + (m_bus_3of6_table[codes & 0x3F] == 0xFF);
+    }
+    return invalid;
 }
 
 
@@ -799,6 +810,8 @@ static int m_bus_decode_format_a(r_device *decoder, const m_bus_data_t *in, m_bu
     if ((block1->L < 9) || ((block1->L-9)+num_data_blocks*2 > in->length-BLOCK1A_SIZE)) {   // add CRC bytes for each data block
         decoder_logf(decoder, 1, __func__, "M-Bus: Package (%u) too short for packet Length: %u", in->length, block1->L);
         decoder_logf(decoder, 1, __func__, "M-Bus: %u > %u", (block1->L-9)+num_data_blocks*2, in->length-BLOCK1A_SIZE);
+        if (block1->L >= 9)
+            decoder->stats.truncated += 1;
         return 0;
     }
 
@@ -837,6 +850,8 @@ static int m_bus_decode_format_b(r_device *decoder, const m_bus_data_t *in, m_bu
     // Check length of package is sufficient
     if ((block1->L < 12) || (block1->L+1 > (int)in->length)) {   // L includes all bytes except itself
         decoder_logf(decoder, 1, __func__, "M-Bus: Package too short for Length: %u", block1->L);
+        if (block1->L >= 12)
+            decoder->stats.truncated += 1;
         return 0;
     }
 
@@ -949,15 +964,19 @@ static int m_bus_mode_c_t_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     char *mode = "";
 
     // Validate package length
-    if (bitbuffer->bits_per_row[0] < (32+13*8) || bitbuffer->bits_per_row[0] > (64+256*12)) {  // Min/Max (Preamble + payload)
+    if (bitbuffer->bits_per_row[0] < (32+13*8)) {  // Min (Preamble + payload)
         return DECODE_ABORT_LENGTH;
     }
 
     // Find a Mode T or C data package
-    unsigned bit_offset = bitbuffer_search(bitbuffer, 0, 0, PREAMBLE_T, sizeof(PREAMBLE_T)*8);
+    bitbuffer_pattern_t preamble;
+    bitbuffer_pattern_init(&preamble, PREAMBLE_T, sizeof(PREAMBLE_T)*8);
+    unsigned bit_offset = bitbuffer_search_pattern(bitbuffer, 0, 0, &preamble);
     if (bit_offset + 13*8 >= bitbuffer->bits_per_row[0]) {  // Did not find a big enough package
         return DECODE_ABORT_EARLY;
     }
+    // Long FSK packages run on after the telegram, use at most the bits of a maximum length telegram
+    unsigned row_bits = MIN(bitbuffer->bits_per_row[0], bit_offset + 64+256*12);
 
     decoder_logf_bitbuffer(decoder, 1, __func__, bitbuffer, "PREAMBLE_T: found at: %u", bit_offset);
     bit_offset += sizeof(PREAMBLE_T)*8;     // skip preamble
@@ -973,7 +992,7 @@ static int m_bus_mode_c_t_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         if (next_byte == 0xCD) {
             decoder_log(decoder, 1, __func__, "M-Bus: Mode C, Format A");
             // Extract data
-            data_in.length = (bitbuffer->bits_per_row[0]-bit_offset)/8;
+            data_in.length = (row_bits-bit_offset)/8;
             bitbuffer_extract_bytes(bitbuffer, 0, bit_offset, data_in.data, data_in.length*8);
             // Decode
             if (!m_bus_decode_format_a(decoder, &data_in, &data_out, &block1))    return 0;
@@ -982,7 +1001,7 @@ static int m_bus_mode_c_t_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         else if (next_byte == 0x3D) {
             decoder_log(decoder, 1, __func__, "M-Bus: Mode C, Format B");
             // Extract data
-            data_in.length = (bitbuffer->bits_per_row[0]-bit_offset)/8;
+            data_in.length = (row_bits-bit_offset)/8;
             bitbuffer_extract_bytes(bitbuffer, 0, bit_offset, data_in.data, data_in.length*8);
             // Decode
             if (!m_bus_decode_format_b(decoder, &data_in, &data_out, &block1))    return 0;
@@ -1001,12 +1020,12 @@ static int m_bus_mode_c_t_callback(r_device *decoder, bitbuffer_t *bitbuffer)
         decoder_log(decoder, 1, __func__, "Experimental - Not tested");
         // Extract data
 
-        data_in.length = (bitbuffer->bits_per_row[0]-bit_offset)/12;    // Each byte is encoded into 12 bits
+        data_in.length = (row_bits-bit_offset)/12;    // Each byte is encoded into 12 bits
 
         decoder_logf(decoder, 1, __func__, "MBus telegram length: %u", data_in.length);
-        if (m_bus_decode_3of6_buffer(bitbuffer->bb[0], bit_offset, data_in.data, data_in.length) < 0) {
-            decoder_log(decoder, 1, __func__, "M-Bus: Decoding error");
-            return 0;
+        int invalid = m_bus_decode_3of6_buffer(bitbuffer->bb[0], bit_offset, data_in.data, data_in.length);
+        if (invalid) {
+            decoder_logf(decoder, 2, __func__, "M-Bus: %d invalid 3of6 codes", invalid);
         }
         // Decode
         if (!m_bus_decode_format_a(decoder, &data_in, &data_out, &block1))    return 0;
@@ -1181,7 +1200,7 @@ static char *output_fields[] = {
 
 // Mode C1, C2 (Meter TX), T1, T2 (Meter TX),
 // Frequency 868.95 MHz, Bitrate 100 kbps, Modulation NRZ FSK
-r_device m_bus_mode_c_t = {
+r_device const m_bus_mode_c_t = {
         .name        = "Wireless M-Bus, Mode C&T, 100kbps (-f 868950000 -s 1200000)", // Minimum samplerate = 1.2 MHz (12 samples of 100kb/s)
         .modulation  = FSK_PULSE_PCM,
         .short_width = 10,  // Bit rate: 100 kb/s
@@ -1193,7 +1212,7 @@ r_device m_bus_mode_c_t = {
 
 // Mode S1, S1-m, S2, T2 (Meter RX),    (Meter RX not so interesting)
 // Frequency 868.3 MHz, Bitrate 32.768 kbps, Modulation Manchester FSK
-r_device m_bus_mode_s = {
+r_device const m_bus_mode_s = {
         .name        = "Wireless M-Bus, Mode S, 32.768kbps (-f 868300000 -s 1000000)", // Minimum samplerate = 1 MHz (15 samples of 32kb/s manchester coded)
         .modulation  = FSK_PULSE_PCM,
         .short_width = (1000.0 / 32.768), // ~31 us per bit
@@ -1211,7 +1230,7 @@ r_device m_bus_mode_s = {
 // Frequency 868.33 MHz, Bitrate 4.8 kbps, Modulation Manchester FSK
 //      Preamble {0x55, 0x54, 0x76, 0x96} (Format A) (B not supported)
 // Untested stub!!! (Need samples)
-r_device m_bus_mode_r = {
+r_device const m_bus_mode_r = {
         .name        = "Wireless M-Bus, Mode R, 4.8kbps (-f 868330000)",
         .modulation  = FSK_PULSE_MANCHESTER_ZEROBIT,
         .short_width = (1000.0f / 4.8f / 2),    // ~208 us per bit -> clock half period ~104 us
@@ -1235,7 +1254,7 @@ r_device m_bus_mode_r = {
 //      Preamble {0x55, 0xF6, 0x8D} (Format A)
 //      Preamble {0x55, 0xF6, 0x72} (Format B)
 // Untested stub!!! (Need samples)
-r_device m_bus_mode_f = {
+r_device const m_bus_mode_f = {
         .name        = "Wireless M-Bus, Mode F, 2.4kbps",
         .modulation  = FSK_PULSE_PCM,
         .short_width = 1000.0f / 2.4f, // ~417 us
@@ -58,8 +58,7 @@ static int marlec_solar_decode(r_device *decoder, bitbuffer_t *bitbuffer)
         return DECODE_ABORT_LENGTH;
     }
 
-    uint8_t len;
-    bitbuffer_extract_bytes(bitbuffer, row, start_pos + sizeof (preamble) * 8, &len, 8);
+    uint8_t len = bitbuffer_extract_u32(bitbuffer, row, start_pos + sizeof (preamble) * 8, 8);
 
     if (len > 60) {
         decoder_logf(decoder, 1, __func__, "packet to large (%d bytes), drop it", len);
@@ -105,7 +104,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device marlec_solar = {
+r_device const marlec_solar = {
         .name        = "Marlec Solar iBoost+ sensors",
         .modulation  = FSK_PULSE_PCM,
         .short_width = 20,
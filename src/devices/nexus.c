@@ -39,9 +39,18 @@ The sensors can be bought at Clas Ohlsen (Nexus) and Pearl (infactory/FreeTec).
 // NOTE: this should really not be here
 int rubicson_crc_check(uint8_t *b);
 
+/// The slots of the record, in the order of the output fields.
+enum {
+    FIELD_MODEL,
+    FIELD_ID,
+    FIELD_CHANNEL,
+    FIELD_BATTERY_OK,
+    FIELD_TEMPERATURE_C,
+    FIELD_HUMIDITY,
+};
+
 static int nexus_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    data_t *data;
     uint8_t *b;
     int id, battery, channel, temp_raw, humidity;
     float temp_c;
@@ -74,31 +83,16 @@ static int nexus_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     temp_c   = (temp_raw >> 4) * 0.1f;
     humidity = (((b[3] & 0x0F) << 4) | (b[4] >> 4));
 
-    if (humidity == 0x00) { // Thermo
-        /* clang-format off */
-        data = data_make(
-                "model",         "",            DATA_STRING, "Nexus-T",
-                "id",            "House Code",  DATA_INT,    id,
-                "channel",       "Channel",     DATA_INT,    channel,
-                "battery_ok",    "Battery",     DATA_INT,    !!battery,
-                "temperature_C", "Temperature", DATA_FORMAT, "%.02f C", DATA_DOUBLE, temp_c,
-                NULL);
-        /* clang-format on */
-    }
-    else { // Thermo/Hygro
-        /* clang-format off */
-        data = data_make(
-                "model",         "",            DATA_STRING, "Nexus-TH",
-                "id",            "House Code",  DATA_INT,    id,
-                "channel",       "Channel",     DATA_INT,    channel,
-                "battery_ok",    "Battery",     DATA_INT,    !!battery,
-                "temperature_C", "Temperature", DATA_FORMAT, "%.02f C", DATA_DOUBLE, temp_c,
-                "humidity",      "Humidity",    DATA_FORMAT, "%u %%", DATA_INT, humidity,
-                NULL);
-        /* clang-format on */
-    }
-
-    decoder_output_data(decoder, data);
+    data_record_t *record = decoder_record(decoder);
+    data_record_string(record, FIELD_MODEL,         "",            humidity == 0x00 ? "Nexus-T" : "Nexus-TH");
+    data_record_int(record,    FIELD_ID,            "House Code",  NULL, id);
+    data_record_int(record,    FIELD_CHANNEL,       "Channel",     NULL, channel);
+    data_record_int(record,    FIELD_BATTERY_OK,    "Battery",     NULL, !!battery);
+    data_record_double(record, FIELD_TEMPERATURE_C, "Temperature", "%.02f C", temp_c);
+    if (humidity != 0x00) // Thermo/Hygro
+        data_record_int(record, FIELD_HUMIDITY,     "Humidity",    "%u %%", humidity);
+
+    decoder_output_record(decoder, record);
     return 1;
 }
 
@@ -112,7 +106,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device nexus = {
+r_device const nexus = {
         .name        = "Nexus, FreeTec NC-7345, NX-3980, Solight TE82S, TFA 30.3209 temperature/humidity sensor",
         .modulation  = OOK_PULSE_PPM,
         .short_width = 1000,
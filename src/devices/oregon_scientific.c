@@ -205,6 +205,37 @@ static int validate_os_v2_message(r_device *decoder, unsigned char *msg, int bit
     return 1;
 }
 
+#define OS_V2_MAX_BITS 173 // longest v2.1 message, RTGR328N
+
+/// Check for a v2.1 sensor ID, the message length is checked with the full message.
+static int os_v2_known_id(int sensor_id)
+{
+    switch (sensor_id) {
+    case ID_THGR122N:
+    case ID_THGR968:
+    case ID_WGR968:
+    case ID_BHTR968:
+    case ID_BTHR918:
+    case ID_RGR968:
+    case ID_THR228N: // and ID_THN132N
+    case ID_RTGR328N_1:
+    case ID_RTGR328N_2:
+    case ID_RTGR328N_3:
+    case ID_RTGR328N_4:
+    case ID_RTGR328N_5:
+    case ID_RTGR328N_6:
+    case ID_RTGR328N_7:
+    case ID_THN129:
+    case ID_BTHGN129:
+    case ID_UVR128:
+    case ID_THGR328N:
+        return 1;
+    default:
+        // ID_RTGN129, ID_RTGN318, and ID_RTHN129 match on the low 12 bits
+        return (sensor_id & 0x0fff) == ID_RTGN318 || (sensor_id & 0x0fff) == ID_RTHN129;
+    }
+}
+
 /**
 Various Oregon Scientific protocols.
 
@@ -224,8 +255,8 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
         return DECODE_ABORT_EARLY;
     }
 
-    bitbuffer_t databits = {0};
-    uint8_t *msg = databits.bb[0];
+    uint8_t msg[(OS_V2_MAX_BITS + 7) / 8] = {0};
+    int msg_bits = 0;
 
     // Possible    v2.1 Protocol message
     unsigned int sync_test_val = ((unsigned)b[3] << 24) | (b[4] << 16) | (b[5] << 8) | (b[6]);
@@ -246,13 +277,18 @@ static int oregon_scientific_v2_1_decode(r_device *decoder, bitbuffer_t *bitbuff
         decoder_logf(decoder, 1, __func__, "OS v2.1 Sync test val %08x found, starting decode at bit %d", sync_test_val, pattern_index);
 
         //decoder_log_bitrow(decoder, 0, __func__, b, bitbuffer->bits_per_row[0], "Raw OSv2 bits");
-        bitbuffer_manchester_decode(bitbuffer, 0, pattern_index + 40, &databits, 173);
-        reflect_nibbles(databits.bb[0], (databits.bits_per_row[0]+7)/8);
-        //decoder_logf_bitbuffer(decoder, 0, __func__, &databits, "MC OSv2 bits (from %d+40)", pattern_index);
+        // decode the sensor ID first, other packages exit before the full decode
+        msg_bits = bitbuffer_manchester_decode_row(bitbuffer, 0, pattern_index + 40, msg, 16);
+        reflect_nibbles(msg, 2);
+        if (msg_bits == 16 && !decoder->verbose && !os_v2_known_id((msg[0] << 8) | msg[1]))
+            return 0;
+
+        msg_bits = bitbuffer_manchester_decode_row(bitbuffer, 0, pattern_index + 40, msg, OS_V2_MAX_BITS);
+        reflect_nibbles(msg, (msg_bits + 7) / 8);
+        //decoder_logf_bitrow(decoder, 0, __func__, msg, msg_bits, "MC OSv2 bits (from %d+40)", pattern_index);
 
         break;
     }
-    int msg_bits = databits.bits_per_row[0];
 
     int sensor_id = (msg[0] << 8) | msg[1];
     decoder_logf(decoder, 1, __func__,"Found sensor_id (%08x)",sensor_id);
@@ -875,7 +911,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device oregon_scientific = {
+r_device const oregon_scientific = {
         .name        = "Oregon Scientific Weather Sensor",
         .modulation  = OOK_PULSE_MANCHESTER_ZEROBIT,
         .short_width = 440, // Nominal 1024Hz (488µs), but pulses are shorter than pauses
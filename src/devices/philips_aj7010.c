@@ -121,7 +121,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device philips_aj7010 = {
+r_device const philips_aj7010 = {
         .name        = "Philips outdoor temperature sensor (type AJ7010)",
         .modulation  = OOK_PULSE_PWM,
         .short_width = 2000,
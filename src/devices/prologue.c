@@ -98,7 +98,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device prologue = {
+r_device const prologue = {
         .name        = "Prologue, FreeTec NC-7104, NC-7159-675 temperature sensor",
         .modulation  = OOK_PULSE_PPM,
         .short_width = 2000,
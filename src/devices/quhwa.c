@@ -61,7 +61,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device quhwa = {
+r_device const quhwa = {
         .name        = "Quhwa",
         .modulation  = OOK_PULSE_PWM,
         .short_width = 360,  // Pulse: Short 360µs, Long 1070µs
@@ -97,7 +97,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device rubicson_pool_48942 = {
+r_device const rubicson_pool_48942 = {
         .name        = "Rubicson Pool Thermometer 48942",
         .modulation  = OOK_PULSE_PWM,
         .short_width = 280,
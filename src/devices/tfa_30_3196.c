@@ -114,7 +114,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tfa_303196 = {
+r_device const tfa_303196 = {
         .name        = "TFA Dostmann 30.3196 T/H outdoor sensor",
         .modulation  = FSK_PULSE_MANCHESTER_ZEROBIT,
         .short_width = 245,
@@ -102,7 +102,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tfa_30_3221 = {
+r_device const tfa_30_3221 = {
         .name        = "TFA Dostmann 30.3221.02 T/H Outdoor Sensor",
         .modulation  = OOK_PULSE_PWM,
         .short_width = 235,
@@ -42,7 +42,6 @@ L - lsfr, byte reflected reverse galois with 0x31 key and generator
 
 static int tfa_marbella_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 {
-    unsigned bitpos = 0;
     uint8_t msg[11], ic;
     char serialnr_str[6 * 2 + 1];
 
@@ -51,8 +50,8 @@ static int tfa_marbella_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     unsigned start_pos = bitbuffer_search(bitbuffer, 0, 0,
             preamble_pattern, sizeof (preamble_pattern) * 8);
 
-    if (bitpos == bitbuffer->bits_per_row[0])
-        return DECODE_FAIL_SANITY;
+    if (start_pos + sizeof(msg) * 8 > bitbuffer->bits_per_row[0])
+        return DECODE_ABORT_LENGTH;
 
     bitbuffer_extract_bytes(bitbuffer, 0, start_pos, msg, sizeof(msg) * 8);
 
@@ -96,7 +95,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tfa_marbella = {
+r_device const tfa_marbella = {
         .name        = "TFA Marbella Pool Thermometer",
         .modulation  = FSK_PULSE_PCM,
         .short_width = 105,
@@ -104,4 +103,5 @@ r_device tfa_marbella = {
         .reset_limit = 2000,
         .decode_fn   = &tfa_marbella_callback,
         .fields      = output_fields,
+        .bands       = BAND_868,
 };
@@ -127,7 +127,7 @@ static int tpms_ave_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     for (row = 0; row < bitbuffer->num_rows; ++row) {
         bitpos = 0;
         // Find a preamble with enough bits after it that it could be a complete packet
-        while ((bitpos = bitbuffer_search(bitbuffer, 0, bitpos, preamble_pattern, 32)) + 132 <=
+        while ((bitpos = decoder_search_preamble(decoder, bitbuffer, 0, bitpos, preamble_pattern, 32)) + 132 <=
                 bitbuffer->bits_per_row[0]) {
             ret = tpms_ave_decode(decoder, bitbuffer, row, bitpos + 32);
             if (ret > 0) {
@@ -154,13 +154,17 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_ave = {
-        .name        = "AVE TPMS",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 100,
-        .long_width  = 100,
-        .reset_limit = 400,
-        .tolerance   = 15,
-        .decode_fn   = &tpms_ave_callback,
-        .fields      = output_fields,
+static uint8_t const tpms_ave_preamble[] = {0xcc, 0xcc, 0xcc, 0xcd};
+
+r_device const tpms_ave = {
+        .name          = "AVE TPMS",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 100,
+        .long_width    = 100,
+        .reset_limit   = 400,
+        .tolerance     = 15,
+        .preamble      = tpms_ave_preamble,
+        .preamble_bits = 32,
+        .decode_fn     = &tpms_ave_callback,
+        .fields        = output_fields,
 };
@@ -106,7 +106,7 @@ static int tpms_citroen_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     bitbuffer_invert(bitbuffer);
 
     // Find a preamble with enough bits after it that it could be a complete packet
-    while ((bitpos = bitbuffer_search(bitbuffer, 0, bitpos, preamble_pattern, 16)) + 178 <=
+    while ((bitpos = decoder_search_preamble(decoder, bitbuffer, 0, bitpos, preamble_pattern, 16)) + 178 <=
             bitbuffer->bits_per_row[0]) {
         ret = tpms_citroen_decode(decoder, bitbuffer, 0, bitpos + 16);
         if (ret > 0)
@@ -132,12 +132,17 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_citroen = {
-        .name        = "Citroen TPMS",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 52,  // 12-13 samples @250k
-        .long_width  = 52,  // FSK
-        .reset_limit = 150, // Maximum gap size before End Of Message [us].
-        .decode_fn   = &tpms_citroen_callback,
-        .fields      = output_fields,
+static uint8_t const tpms_citroen_preamble[] = {0x55, 0x56}; // the raw bits, before the invert
+
+r_device const tpms_citroen = {
+        .name          = "Citroen TPMS",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 52,  // 12-13 samples @250k
+        .long_width    = 52,  // FSK
+        .reset_limit   = 150, // Maximum gap size before End Of Message [us].
+        .min_bits      = 178, // a preamble with enough bits after it
+        .preamble      = tpms_citroen_preamble,
+        .preamble_bits = 16,
+        .decode_fn     = &tpms_citroen_callback,
+        .fields        = output_fields,
 };
@@ -121,7 +121,7 @@ static int tpms_elantra2012_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     for (row = 0; row < bitbuffer->num_rows; ++row) {
         bitpos = 0;
         // Find a preamble with enough bits after it that it could be a complete packet
-        while ((bitpos = bitbuffer_search(bitbuffer, row, bitpos,
+        while ((bitpos = decoder_search_preamble(decoder, bitbuffer, row, bitpos,
                         preamble_pattern, 16)) + 128 <=
                 bitbuffer->bits_per_row[row]) {
             ret = tpms_elantra2012_decode(decoder, bitbuffer, row, bitpos + 16);
@@ -148,12 +148,16 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_elantra2012 = {
-        .name        = "Elantra2012 TPMS",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 49,  // 12-13 samples @250k
-        .long_width  = 49,  // FSK
-        .reset_limit = 150, // Maximum gap size before End Of Message [us].
-        .decode_fn   = &tpms_elantra2012_callback,
-        .fields      = output_fields,
+static uint8_t const tpms_elantra2012_preamble[] = {0x71, 0x55};
+
+r_device const tpms_elantra2012 = {
+        .name          = "Elantra2012 TPMS",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 49,  // 12-13 samples @250k
+        .long_width    = 49,  // FSK
+        .reset_limit   = 150, // Maximum gap size before End Of Message [us].
+        .preamble      = tpms_elantra2012_preamble,
+        .preamble_bits = 16,
+        .decode_fn     = &tpms_elantra2012_callback,
+        .fields        = output_fields,
 };
@@ -117,7 +117,7 @@ static int tpms_hyundai_vdo_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     bitbuffer_invert(bitbuffer);
 
     // Find a preamble with enough bits after it that it could be a complete packet
-    while ((bitpos = bitbuffer_search(bitbuffer, 0, bitpos, preamble_pattern, 32)) + 80 <=
+    while ((bitpos = decoder_search_preamble(decoder, bitbuffer, 0, bitpos, preamble_pattern, 32)) + 80 <=
             bitbuffer->bits_per_row[0]) {
         ret = tpms_hyundai_vdo_decode(decoder, bitbuffer, 0, bitpos + 32);
         if (ret > 0)
@@ -142,12 +142,17 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_hyundai_vdo = {
-        .name        = "Hyundai TPMS (VDO)",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 52,  // in the FCC test protocol is actually 42us, but works with 52 also
-        .long_width  = 52,  // FSK
-        .reset_limit = 150, // Maximum gap size before End Of Message [us].
-        .decode_fn   = &tpms_hyundai_vdo_callback,
-        .fields      = output_fields,
+static uint8_t const tpms_hyundai_vdo_preamble[] = {0x55, 0x55, 0x55, 0x56}; // the raw bits, before the invert
+
+r_device const tpms_hyundai_vdo = {
+        .name          = "Hyundai TPMS (VDO)",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 52,  // in the FCC test protocol is actually 42us, but works with 52 also
+        .long_width    = 52,  // FSK
+        .reset_limit   = 150, // Maximum gap size before End Of Message [us].
+        .min_bits      = 80, // a preamble with enough bits after it
+        .preamble      = tpms_hyundai_vdo_preamble,
+        .preamble_bits = 32,
+        .decode_fn     = &tpms_hyundai_vdo_callback,
+        .fields        = output_fields,
 };
@@ -90,7 +90,7 @@ static int tpms_jansite_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     bitbuffer_invert(bitbuffer);
 
     // Find a preamble with enough bits after it that it could be a complete packet
-    while ((bitpos = bitbuffer_search(bitbuffer, 0, bitpos, preamble_pattern, 24)) + 80 <=
+    while ((bitpos = decoder_search_preamble(decoder, bitbuffer, 0, bitpos, preamble_pattern, 24)) + 80 <=
             bitbuffer->bits_per_row[0]) {
         ret = tpms_jansite_decode(decoder, bitbuffer, 0, bitpos + 24);
         if (ret > 0)
@@ -113,13 +113,18 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_jansite = {
-        .name        = "Jansite TPMS Model TY02S",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 52,  // 12-13 samples @250k
-        .long_width  = 52,  // FSK
-        .reset_limit = 150, // Maximum gap size before End Of Message [us].
-        .decode_fn   = &tpms_jansite_callback,
-        .disabled    = 1, // Unknown checksum
-        .fields      = output_fields,
+static uint8_t const tpms_jansite_preamble[] = {0x55, 0x55, 0x56}; // the raw bits, before the invert
+
+r_device const tpms_jansite = {
+        .name          = "Jansite TPMS Model TY02S",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 52,  // 12-13 samples @250k
+        .long_width    = 52,  // FSK
+        .reset_limit   = 150, // Maximum gap size before End Of Message [us].
+        .min_bits      = 80, // a preamble with enough bits after it
+        .preamble      = tpms_jansite_preamble,
+        .preamble_bits = 24,
+        .decode_fn     = &tpms_jansite_callback,
+        .disabled      = 1, // Unknown checksum
+        .fields        = output_fields,
 };
@@ -106,7 +106,7 @@ static int tpms_jansite_solar_callback(r_device *decoder, bitbuffer_t *bitbuffer
     int ret         = 0;
     int events      = 0;
 
-    while ((bitpos = bitbuffer_search(bitbuffer, 0, bitpos, preamble_pattern, 24)) + 80 <=
+    while ((bitpos = decoder_search_preamble(decoder, bitbuffer, 0, bitpos, preamble_pattern, 24)) + 80 <=
             bitbuffer->bits_per_row[0]) {
 
         ret = tpms_jansite_solar_decode(decoder, bitbuffer, 0, bitpos);
@@ -130,12 +130,16 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_jansite_solar = {
-        .name        = "Jansite TPMS Model Solar",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 51,
-        .long_width  = 51,
-        .reset_limit = 5000, // Large enough to merge the 3 duplicate messages
-        .decode_fn   = &tpms_jansite_solar_callback,
-        .fields      = output_fields,
+static uint8_t const tpms_jansite_solar_preamble[] = {0xa6, 0xa6, 0x5a};
+
+r_device const tpms_jansite_solar = {
+        .name          = "Jansite TPMS Model Solar",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 51,
+        .long_width    = 51,
+        .reset_limit   = 5000, // Large enough to merge the 3 duplicate messages
+        .preamble      = tpms_jansite_solar_preamble,
+        .preamble_bits = 24,
+        .decode_fn     = &tpms_jansite_solar_callback,
+        .fields        = output_fields,
 };
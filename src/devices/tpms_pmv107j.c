@@ -97,7 +97,7 @@ static int tpms_pmv107j_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     int events      = 0;
 
     // Find a preamble with enough bits after it that it could be a complete packet
-    while ((bitpos = bitbuffer_search(bitbuffer, 0, bitpos, preamble_pattern, 6)) + 67 * 2 <=
+    while ((bitpos = decoder_search_preamble(decoder, bitbuffer, 0, bitpos, preamble_pattern, 6)) + 67 * 2 <=
             bitbuffer->bits_per_row[0]) {
         ret = tpms_pmv107j_decode(decoder, bitbuffer, 0, bitpos + 6);
         if (ret > 0)
@@ -122,12 +122,17 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_pmv107j = {
-        .name        = "PMV-107J (Toyota) TPMS",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 100, // 25 samples @250k
-        .long_width  = 100, // FSK
-        .reset_limit = 250, // Maximum gap size before End Of Message [us].
-        .decode_fn   = &tpms_pmv107j_callback,
-        .fields      = output_fields,
+static uint8_t const tpms_pmv107j_preamble[] = {0xf8};
+
+r_device const tpms_pmv107j = {
+        .name          = "PMV-107J (Toyota) TPMS",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 100, // 25 samples @250k
+        .long_width    = 100, // FSK
+        .reset_limit   = 250, // Maximum gap size before End Of Message [us].
+        .preamble      = tpms_pmv107j_preamble,
+        .preamble_bits = 6,
+        .decode_fn     = &tpms_pmv107j_callback,
+        .fields        = output_fields,
+        .bands         = BAND_315,
 };
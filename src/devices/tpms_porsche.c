@@ -93,7 +93,7 @@ static int tpms_porsche_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 
     // Find a preamble with enough bits after it that it could be a complete packet
     unsigned bitpos = 0;
-    while ((bitpos = bitbuffer_search(bitbuffer, 0, bitpos, preamble_pattern, 20)) + 100 <=
+    while ((bitpos = decoder_search_preamble(decoder, bitbuffer, 0, bitpos, preamble_pattern, 20)) + 100 <=
             bitbuffer->bits_per_row[0]) {
         events += tpms_porsche_decode(decoder, bitbuffer, 0, bitpos + 20);
         bitpos += 2;
@@ -113,12 +113,17 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_porsche = {
-        .name        = "Porsche Boxster/Cayman TPMS",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 52,  // 12-13 samples @250k
-        .long_width  = 52,  // FSK
-        .reset_limit = 150, // Maximum gap size before End Of Message [us].
-        .decode_fn   = &tpms_porsche_callback,
-        .fields      = output_fields,
+static uint8_t const tpms_porsche_preamble[] = {0x33, 0x33, 0x20};
+
+r_device const tpms_porsche = {
+        .name          = "Porsche Boxster/Cayman TPMS",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 52,  // 12-13 samples @250k
+        .long_width    = 52,  // FSK
+        .reset_limit   = 150, // Maximum gap size before End Of Message [us].
+        .min_bits      = 100, // a preamble with enough bits after it
+        .preamble      = tpms_porsche_preamble,
+        .preamble_bits = 20,
+        .decode_fn     = &tpms_porsche_callback,
+        .fields        = output_fields,
 };
@@ -95,7 +95,7 @@ static int tpms_renault_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     for (row = 0; row < bitbuffer->num_rows; ++row) {
         bitpos = 0;
         // Find a preamble with enough bits after it that it could be a complete packet
-        while ((bitpos = bitbuffer_search(bitbuffer, row, bitpos,
+        while ((bitpos = decoder_search_preamble(decoder, bitbuffer, row, bitpos,
                 preamble_pattern, 16)) + 160 <=
                 bitbuffer->bits_per_row[row]) {
             ret = tpms_renault_decode(decoder, bitbuffer, row, bitpos + 16);
@@ -119,12 +119,17 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_renault = {
-        .name        = "Renault TPMS",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 52,  // 12-13 samples @250k
-        .long_width  = 52,  // FSK
-        .reset_limit = 150, // Maximum gap size before End Of Message [us].
-        .decode_fn   = &tpms_renault_callback,
-        .fields      = output_fields,
+static uint8_t const tpms_renault_preamble[] = {0x55, 0x56}; // the raw bits, before the invert
+
+r_device const tpms_renault = {
+        .name          = "Renault TPMS",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 52,  // 12-13 samples @250k
+        .long_width    = 52,  // FSK
+        .reset_limit   = 150, // Maximum gap size before End Of Message [us].
+        .min_bits      = 160, // a preamble with enough bits after it
+        .preamble      = tpms_renault_preamble,
+        .preamble_bits = 16,
+        .decode_fn     = &tpms_renault_callback,
+        .fields        = output_fields,
 };
@@ -92,7 +92,7 @@ static int tpms_toyota_callback(r_device *decoder, bitbuffer_t *bitbuffer)
     int events      = 0;
 
     // Find a preamble with enough bits after it that it could be a complete packet
-    while ((bitpos = bitbuffer_search(bitbuffer, 0, bitpos, preamble_pattern, 12)) + 156 <=
+    while ((bitpos = decoder_search_preamble(decoder, bitbuffer, 0, bitpos, preamble_pattern, 12)) + 156 <=
             bitbuffer->bits_per_row[0]) {
         ret = tpms_toyota_decode(decoder, bitbuffer, 0, bitpos + 11);
         if (ret > 0)
@@ -114,12 +114,17 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_toyota = {
-        .name        = "Toyota TPMS",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 52,  // 12-13 samples @250k
-        .long_width  = 52,  // FSK
-        .reset_limit = 150, // Maximum gap size before End Of Message [us].
-        .decode_fn   = &tpms_toyota_callback,
-        .fields      = output_fields,
+static uint8_t const tpms_toyota_preamble[] = {0xa9, 0xe0};
+
+r_device const tpms_toyota = {
+        .name          = "Toyota TPMS",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 52,  // 12-13 samples @250k
+        .long_width    = 52,  // FSK
+        .reset_limit   = 150, // Maximum gap size before End Of Message [us].
+        .min_bits      = 156, // a preamble with enough bits after it
+        .preamble      = tpms_toyota_preamble,
+        .preamble_bits = 12,
+        .decode_fn     = &tpms_toyota_callback,
+        .fields        = output_fields,
 };
@@ -105,7 +105,7 @@ static int tpms_truck_callback(r_device *decoder, bitbuffer_t *bitbuffer)
 
     bitbuffer_invert(bitbuffer);
     // Find a preamble with enough bits after it that it could be a complete packet
-    while ((bitpos = bitbuffer_search(bitbuffer, 0, bitpos, preamble_pattern, 24)) + 160 <=
+    while ((bitpos = decoder_search_preamble(decoder, bitbuffer, 0, bitpos, preamble_pattern, 24)) + 160 <=
             bitbuffer->bits_per_row[0]) {
         events += tpms_truck_decode(decoder, bitbuffer, 0, bitpos + 24);
         bitpos += 2;
@@ -127,12 +127,17 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device tpms_truck = {
-        .name        = "Unbranded SolarTPMS for trucks",
-        .modulation  = FSK_PULSE_PCM,
-        .short_width = 52,
-        .long_width  = 52,
-        .reset_limit = 150,
-        .decode_fn   = &tpms_truck_callback,
-        .fields      = output_fields,
+static uint8_t const tpms_truck_preamble[] = {0x55, 0x55, 0x56}; // the raw bits, before the invert
+
+r_device const tpms_truck = {
+        .name          = "Unbranded SolarTPMS for trucks",
+        .modulation    = FSK_PULSE_PCM,
+        .short_width   = 52,
+        .long_width    = 52,
+        .reset_limit   = 150,
+        .min_bits      = 160, // a preamble with enough bits after it
+        .preamble      = tpms_truck_preamble,
+        .preamble_bits = 24,
+        .decode_fn     = &tpms_truck_callback,
+        .fields        = output_fields,
 };
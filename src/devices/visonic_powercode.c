@@ -120,7 +120,7 @@ static char *output_fields[] = {
         NULL,
 };
 
-r_device visonic_powercode = {
+r_device const visonic_powercode = {
         .name        = "Visonic powercode",
         .modulation  = OOK_PULSE_PWM,
         .short_width = 400,
@@ -129,4 +129,5 @@ r_device visonic_powercode = {
         .reset_limit = 5000,
         .decode_fn   = &visonic_powercode_decode,
         .fields      = output_fields,
+        .urgent      = 1,
 };
@@ -0,0 +1,118 @@
+/** @file
+    Event de-duplication, drops events identical to one output within a time window.
+
+    Many sensors send a message several times and decoders output each repeat.
+    The events are keyed by a hash of all fields, e.g. model, id, channel and the readings,
+    an identical event within the window of the last one is dropped.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "event_dedup.h"
+#include "data.h"
+
+#include <string.h>
+
+#define FNV_PRIME 1099511628211ull
+
+static uint64_t hash_bytes(uint64_t hash, void const *bytes, size_t len)
+{
+    unsigned char const *p = bytes;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ p[i]) * FNV_PRIME; // FNV-1a
+    }
+    return hash;
+}
+
+static uint64_t hash_string(uint64_t hash, char const *str)
+{
+    // include the terminator to separate consecutive strings
+    return hash_bytes(hash, str ? str : "", str ? strlen(str) + 1 : 1);
+}
+
+static uint64_t hash_data(uint64_t hash, data_t const *data);
+
+static uint64_t hash_value(uint64_t hash, data_type_t type, data_value_t value)
+{
+    hash = hash_bytes(hash, &type, sizeof(type));
+    switch (type) {
+    case DATA_INT:
+        return hash_bytes(hash, &value.v_int, sizeof(value.v_int));
+    case DATA_DOUBLE:
+        return hash_bytes(hash, &value.v_dbl, sizeof(value.v_dbl));
+    case DATA_STRING:
+        return hash_string(hash, value.v_ptr);
+    case DATA_DATA:
+        return hash_data(hash, value.v_ptr);
+    case DATA_ARRAY: {
+        data_array_t const *array = value.v_ptr;
+        hash = hash_bytes(hash, &array->num_values, sizeof(array->num_values));
+        for (int i = 0; i < array->num_values; ++i) {
+            data_value_t element = {0};
+            if (array->type == DATA_INT)
+                element.v_int = ((int const *)array->values)[i];
+            else if (array->type == DATA_DOUBLE)
+                element.v_dbl = ((double const *)array->values)[i];
+            else
+                element.v_ptr = ((void *const *)array->values)[i];
+            hash = hash_value(hash, array->type, element);
+        }
+        return hash;
+    }
+    default:
+        return hash;
+    }
+}
+
+static uint64_t hash_data(uint64_t hash, data_t const *data)
+{
+    for (; data; data = data->next) {
+        hash = event_dedup_hash_field(hash, data);
+    }
+    return hash;
+}
+
+uint64_t event_dedup_hash_field(uint64_t hash, data_t const *field)
+{
+    hash = hash_string(hash, field->key);
+    return hash_value(hash, field->type, field->value);
+}
+
+uint64_t event_dedup_hash(data_t const *data)
+{
+    uint64_t hash = hash_data(EVENT_DEDUP_HASH_INIT, data);
+    return hash ? hash : 1; // 0 marks a never used slot
+}
+
+int event_dedup_check(event_dedup_t *dedup, data_t const *data, uint64_t now_ms)
+{
+    uint64_t hash = event_dedup_hash(data);
+
+    // reuse the first expired or never used slot, or the oldest probed slot
+    struct event_dedup_slot *victim = NULL;
+    int victim_expired              = 0;
+    for (unsigned i = 0; i < EVENT_DEDUP_PROBES; ++i) {
+        struct event_dedup_slot *slot = &dedup->slot[(hash + i) & (EVENT_DEDUP_SIZE - 1)];
+        // the time may step back, e.g. with a new input file
+        int expired = !slot->hash || now_ms < slot->seen_ms || now_ms - slot->seen_ms > dedup->window_ms;
+        if (slot->hash == hash && !expired) {
+            slot->seen_ms = now_ms;
+            dedup->suppressed++;
+            dedup->suppressed_total++;
+            return 1;
+        }
+        if (!victim || (expired && !victim_expired) || (!expired && !victim_expired && slot->seen_ms < victim->seen_ms)) {
+            victim         = slot;
+            victim_expired = expired;
+        }
+        if (!slot->hash)
+            break; // never used, the event can not be further on
+    }
+
+    victim->hash    = hash;
+    victim->seen_ms = now_ms;
+    return 0;
+}
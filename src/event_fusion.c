@@ -0,0 +1,178 @@
+/** @file
+    Event fusion, merges the events of several receivers into one event.
+
+    With edge receivers sending their packages to a central decoder, see -r pulses,
+    a sensor is often heard by a few receivers. The events are keyed by a hash of
+    the decoded fields, e.g. model, id and the readings, and held for the window.
+    The events with the hash of a held event are fused into it, one event is output
+    with the data of the receiver with the best RSSI and the list of all receivers.
+
+    The held events are a ring in order of the time first heard, the window of the
+    oldest event is over first. The hash table points into the ring, a slot of an
+    event no longer held, or with the window over, is reused.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "event_fusion.h"
+#include "data.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct event_fusion {
+    unsigned window_ms;
+    unsigned fused;       ///< events fused into another, stats counter for the interval
+    uint64_t fused_total; ///< events fused into another, not reset with the stats
+    uint32_t tail;        ///< the sequence number of the oldest held event
+    uint32_t head;        ///< the sequence number of the next event
+    unsigned num_receivers;
+    char receivers[EVENT_FUSION_RECEIVERS][EVENT_FUSION_NAME];
+    struct event_fusion_event {
+        uint64_t hash;
+        uint64_t first_ms; ///< time the event was first heard
+        data_t *data;      ///< the event of the best receiver
+        float rssi;        ///< the RSSI of the best receiver
+        int best;          ///< the index of the best receiver, -1 if not told apart
+        uint64_t heard;    ///< a bit for each receiver index that heard the event
+    } event[EVENT_FUSION_SIZE];
+    struct event_fusion_slot {
+        uint64_t hash; ///< 0 for a never used slot
+        uint32_t seq;  ///< the sequence number of the event
+    } slot[EVENT_FUSION_SLOTS];
+};
+
+event_fusion_t *event_fusion_create(unsigned window_ms)
+{
+    event_fusion_t *fusion = calloc(1, sizeof(*fusion));
+    if (!fusion) {
+        WARN_CALLOC("event_fusion_create()");
+        return NULL;
+    }
+    fusion->window_ms = window_ms;
+    return fusion;
+}
+
+void event_fusion_free(event_fusion_t *fusion)
+{
+    if (!fusion)
+        return;
+    for (uint32_t seq = fusion->tail; seq != fusion->head; ++seq) {
+        data_free(fusion->event[seq & (EVENT_FUSION_SIZE - 1)].data);
+    }
+    free(fusion);
+}
+
+/// Get the index of a receiver, new receivers are added, -1 if there are too many.
+static int receiver_index(event_fusion_t *fusion, char const *receiver)
+{
+    for (unsigned i = 0; i < fusion->num_receivers; ++i) {
+        if (!strcmp(fusion->receivers[i], receiver))
+            return (int)i;
+    }
+    if (fusion->num_receivers >= EVENT_FUSION_RECEIVERS)
+        return -1;
+    snprintf(fusion->receivers[fusion->num_receivers], EVENT_FUSION_NAME, "%s", receiver);
+    return (int)fusion->num_receivers++;
+}
+
+/// Get the held event of a slot, NULL if the event is no longer held or its window is over.
+static struct event_fusion_event *slot_event(event_fusion_t *fusion, struct event_fusion_slot const *slot, uint64_t now_ms)
+{
+    if (!slot->hash || (uint32_t)(slot->seq - fusion->tail) >= (uint32_t)(fusion->head - fusion->tail))
+        return NULL;
+    struct event_fusion_event *event = &fusion->event[slot->seq & (EVENT_FUSION_SIZE - 1)];
+    // the time may step back, e.g. with a new input file
+    if (event->hash != slot->hash || now_ms < event->first_ms || now_ms - event->first_ms >= fusion->window_ms)
+        return NULL;
+    return event;
+}
+
+int event_fusion_add(event_fusion_t *fusion, uint64_t hash, data_t *data, char const *receiver, float rssi, uint64_t now_ms)
+{
+    int index = receiver_index(fusion, receiver);
+
+    struct event_fusion_slot *free_slot = NULL;
+    for (unsigned i = 0; index >= 0 && i < EVENT_FUSION_PROBES; ++i) {
+        struct event_fusion_slot *slot   = &fusion->slot[(hash + i) & (EVENT_FUSION_SLOTS - 1)];
+        struct event_fusion_event *event = slot_event(fusion, slot, now_ms);
+        if (event && slot->hash == hash) {
+            event->heard |= 1ull << index;
+            if (rssi > event->rssi) {
+                data_free(event->data);
+                event->data = data;
+                event->rssi = rssi;
+                event->best = index;
+            }
+            else {
+                data_free(data);
+            }
+            fusion->fused++;
+            fusion->fused_total++;
+            return 1;
+        }
+        if (!event && !free_slot)
+            free_slot = slot;
+        if (!slot->hash)
+            break; // never used, the event can not be further on
+    }
+
+    uint32_t seq = fusion->head++;
+    struct event_fusion_event *event = &fusion->event[seq & (EVENT_FUSION_SIZE - 1)];
+    event->hash     = hash;
+    event->first_ms = now_ms;
+    event->data     = data;
+    event->rssi     = rssi;
+    event->best     = index;
+    event->heard    = index >= 0 ? 1ull << index : 0;
+    if (free_slot) {
+        free_slot->hash = hash;
+        free_slot->seq  = seq;
+    }
+    return 0;
+}
+
+data_t *event_fusion_pop(event_fusion_t *fusion, uint64_t now_ms)
+{
+    if (fusion->tail == fusion->head)
+        return NULL;
+    struct event_fusion_event *event = &fusion->event[fusion->tail & (EVENT_FUSION_SIZE - 1)];
+    int full = fusion->head - fusion->tail >= EVENT_FUSION_SIZE;
+    if (!full && now_ms >= event->first_ms && now_ms - event->first_ms < fusion->window_ms)
+        return NULL;
+    fusion->tail++;
+
+    data_t *data = event->data;
+    event->data  = NULL;
+    if (event->best < 0)
+        return data;
+
+    char const *names[EVENT_FUSION_RECEIVERS];
+    int num_names = 0;
+    for (unsigned i = 0; i < fusion->num_receivers; ++i) {
+        if (event->heard & (1ull << i))
+            names[num_names++] = fusion->receivers[i];
+    }
+    return data_append(data,
+            "receiver",     "Receiver",     DATA_STRING, fusion->receivers[event->best],
+            "receivers",    "Receivers",    DATA_ARRAY, data_array(num_names, DATA_STRING, (void *)names),
+            NULL);
+}
+
+unsigned event_fusion_fused(event_fusion_t *fusion, int reset)
+{
+    unsigned fused = fusion->fused;
+    if (reset)
+        fusion->fused = 0;
+    return fused;
+}
+
+uint64_t event_fusion_fused_total(event_fusion_t const *fusion)
+{
+    return fusion->fused_total;
+}
@@ -50,7 +50,8 @@ void file_info_check_read(file_info_t *info)
             && info->format != CS16_IQ
             && info->format != CF32_IQ
             && info->format != S16_AM
-            && info->format != PULSE_OOK) {
+            && info->format != PULSE_OOK
+            && info->format != PULSE_OOK_BIN) {
         fprintf(stderr, "File type not supported as input (%s).\n", info->spec);
         exit(1);
     }
@@ -90,6 +91,8 @@ char const *file_info_string(file_info_t *info)
     case VCD_LOGIC: return "VCD logic (text)";
     case U8_LOGIC:  return "U8 logic (1ch uint8)";
     case PULSE_OOK: return "OOK pulse data (text)";
+    case PULSE_OOK_BIN: return "OOK pulse data (binary)";
+    case PULSE_ARROW: return "Pulse data (Arrow IPC)";
     default:        return "Unknown";
     }
 }
@@ -120,6 +123,8 @@ static uint32_t file_type_guess_auto_format(uint32_t type)
     else if (type == F_U8) return U8_LOGIC;
     else if (type == F_VCD) return VCD_LOGIC;
     else if (type == F_OOK) return PULSE_OOK;
+    else if (type == F_OOK_BIN) return PULSE_OOK_BIN;
+    else if (type == F_ARROW) return PULSE_ARROW;
     else if (type == F_CS16) return CS16_IQ;
     else if (type == F_CF32) return CF32_IQ;
     else return type;
@@ -198,6 +203,8 @@ static void file_type(char const *filename, file_info_t *info)
             else if (len == 3 && !strncasecmp("f32", t, 3)) file_type_set_format(&info->format, F_F32);
             else if (len == 3 && !strncasecmp("vcd", t, 3)) file_type_set_content(&info->format, F_VCD);
             else if (len == 3 && !strncasecmp("ook", t, 3)) file_type_set_content(&info->format, F_OOK);
+            else if (len == 6 && !strncasecmp("ookbin", t, 6)) file_type_set_content(&info->format, F_OOK_BIN);
+            else if (len == 5 && !strncasecmp("arrow", t, 5)) file_type_set_content(&info->format, F_ARROW);
             else if (len == 4 && !strncasecmp("cs16", t, 4)) file_type_set_format(&info->format, F_CS16);
             else if (len == 4 && !strncasecmp("cs32", t, 4)) file_type_set_format(&info->format, F_CS32);
             else if (len == 4 && !strncasecmp("cf32", t, 4)) file_type_set_format(&info->format, F_CF32);
@@ -213,6 +220,16 @@ static void file_type(char const *filename, file_info_t *info)
     }
 }
 
+static uint32_t file_compression(char const *path)
+{
+    size_t len = strlen(path);
+    if (len > 3 && !strncasecmp(".gz", path + len - 3, 3))
+        return F_GZIP;
+    if (len > 4 && !strncasecmp(".zst", path + len - 4, 4))
+        return F_ZSTD;
+    return F_UNCOMPRESSED;
+}
+
 // return the last colon not followed by a backslash, otherwise NULL
 static char const *last_plain_colon(char const *p)
 {
@@ -237,6 +254,7 @@ Parse "[A-Za-z][0-9A-Za-z]+" as format or content specifier:
 2ch formats: "cu8", "cs8", "cs16", "cs32", "cf32"
 1ch formats: "u8", "s8", "s16", "u16", "s32", "u32", "f32"
 text formats: "vcd", "ook"
+binary pulse formats: "ookbin", "arrow"
 content types: "iq", "i", "q", "am", "fm", "logic"
 
 Parses left to right, with the exception of a prefix up to the last colon ":"
@@ -246,6 +264,7 @@ All matches are case-insensitive.
 
 default detection, e.g.: path/filename.am.s16
 overrides, e.g.: am:s16:path/filename.ext
+compressed files, e.g.: path/filename.cu8.zst, path/filename.cs16.gz
 other styles are detected but discouraged, e.g.:
   am-s16:path/filename.ext, am.s16:path/filename.ext, path/filename.am_s16
 */
@@ -273,6 +292,7 @@ int file_info_parse_filename(file_info_t *info, char const *filename)
     }
     info->raw_format = info->format;
     info->format = file_type_guess_auto_format(info->format);
+    info->compression = file_compression(info->path);
     return info->format;
 }
 
@@ -289,6 +309,17 @@ static void assert_file_type(int check, char const *spec)
     }
 }
 
+static void assert_compression(uint32_t check, char const *spec)
+{
+    file_info_t info = {0};
+    file_info_parse_filename(&info, spec);
+    if (check != info.compression) {
+        fprintf(stderr, "\nTEST failed: file_info_parse_filename(\"%s\").compression = %u == %u\n", spec, info.compression, check);
+    } else {
+        fprintf(stderr, ".");
+    }
+}
+
 static void assert_str_equal(char const *a, char const *b)
 {
     if (a != b && (!a || !b || strcmp(a, b))) {
@@ -351,6 +382,19 @@ int main(void)
     assert_file_type(S16_FM, ".s16_fm");
     assert_file_type(S16_FM, ".s16,fm");
 
+    assert_file_type(PULSE_OOK, ".ook");
+    assert_file_type(PULSE_OOK_BIN, ".ookbin");
+    assert_file_type(PULSE_OOK_BIN, "ookbin:foo.bin");
+    assert_file_type(PULSE_ARROW, ".arrow");
+
+    assert_file_type(CU8_IQ, ".cu8.zst");
+    assert_file_type(CS16_IQ, ".cs16.gz");
+    assert_file_type(CF32_IQ, "cf32:foo.zst");
+    assert_compression(F_ZSTD, "foo.cu8.zst");
+    assert_compression(F_GZIP, "foo.cs16.GZ");
+    assert_compression(F_UNCOMPRESSED, "foo.cu8");
+    assert_compression(F_UNCOMPRESSED, "gz/foo.cu8");
+
     fprintf(stderr, "\nDone!\n");
 }
 #endif /* _TEST */
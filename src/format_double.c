@@ -0,0 +1,319 @@
+/** @file
+    Fast formatting of doubles for the text outputs.
+
+    A double is an exact binary fraction, the decimals are the fraction scaled by a power of ten
+    in 128-bit integer arithmetic and rounded half to even on the exact remainder. This is the
+    same correctly rounded text that snprintf() outputs, without the costly generic conversion.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "format_double.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#define MAX_DECIMALS 9
+#define GENERAL_PRECISION 6
+
+static uint64_t const pow10_table[MAX_DECIMALS + 1] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+/// Write the decimal digits of an unsigned, returns the number of digits.
+static int format_uint(char *out, uint64_t value, int min_digits)
+{
+    char tmp[24];
+    int len = 0;
+    do {
+        tmp[len++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value || len < min_digits);
+    for (int i = 0; i < len; ++i) {
+        out[i] = tmp[len - 1 - i];
+    }
+    return len;
+}
+
+/** Format with a fixed number of decimals like "%.<decimals>f".
+
+    @param out buffer of at least FORMAT_DOUBLE_BUFLEN chars, not terminated
+    @return the length, or -1 if the value is out of range
+*/
+static int format_fixed(char *out, double value, int decimals)
+{
+    if (!isfinite(value))
+        return -1;
+    int len = 0;
+    if (signbit(value))
+        out[len++] = '-'; // also for -0.0 and values that round to zero
+    double abs_value = fabs(value);
+
+    uint64_t int_part = 0;
+    uint64_t frac     = 0; // the fraction is frac / 2^shift
+    int shift         = 0;
+    if (abs_value != 0.0) {
+        int exp;
+        uint64_t mant = (uint64_t)ldexp(frexp(abs_value, &exp), 53); // exact, 53 bits
+        shift         = 53 - exp;
+        if (shift <= 0 || shift > 120)
+            return -1; // at least 2^52 or tiny
+        int_part = shift < 64 ? mant >> shift : 0;
+        frac     = shift < 64 ? mant & ((UINT64_C(1) << shift) - 1) : mant;
+    }
+
+    // the fraction times 10^decimals as 128 bits hi:lo, fits as the fraction is 53 bits
+    uint64_t scale  = pow10_table[decimals];
+    uint64_t lo_mul = (frac & 0xffffffff) * scale;
+    uint64_t hi_mul = (frac >> 32) * scale;
+    uint64_t lo     = lo_mul + (hi_mul << 32);
+    uint64_t hi     = (hi_mul >> 32) + (lo < lo_mul);
+
+    // split into the decimals q and the remainder, compare the remainder to one half
+    uint64_t q = 0;
+    int cmp    = 0; // remainder less, equal, or greater than one half
+    if (shift == 0) {
+        cmp = -1;
+    }
+    else if (shift < 64) {
+        q             = (lo >> shift) | (hi << (64 - shift));
+        uint64_t rem  = lo & ((UINT64_C(1) << shift) - 1);
+        uint64_t half = UINT64_C(1) << (shift - 1);
+        cmp           = rem < half ? -1 : rem > half;
+    }
+    else if (shift == 64) {
+        q             = hi;
+        uint64_t half = UINT64_C(1) << 63;
+        cmp           = lo < half ? -1 : lo > half;
+    }
+    else {
+        q                = hi >> (shift - 64);
+        uint64_t rem_hi  = hi & ((UINT64_C(1) << (shift - 64)) - 1);
+        uint64_t half_hi = UINT64_C(1) << (shift - 65);
+        cmp              = rem_hi < half_hi ? -1 : rem_hi > half_hi || lo;
+    }
+
+    // round half to even
+    uint64_t last = decimals ? q : int_part;
+    if (cmp > 0 || (cmp == 0 && (last & 1)))
+        q++;
+    if (q >= scale) {
+        q -= scale;
+        int_part++;
+    }
+
+    len += format_uint(out + len, int_part, 1);
+    if (decimals) {
+        out[len++] = '.';
+        len += format_uint(out + len, q, decimals);
+    }
+    return len;
+}
+
+/** Format with six significant digits like "%g".
+
+    @param out buffer of at least FORMAT_DOUBLE_BUFLEN chars, not terminated
+    @return the length, or -1 if the value is out of range or needs an exponent
+*/
+static int format_general(char *out, double value)
+{
+    if (!isfinite(value))
+        return -1;
+    if (value == 0.0) {
+        int len = 0;
+        if (signbit(value))
+            out[len++] = '-';
+        out[len++] = '0';
+        return len;
+    }
+
+    // the exponent of the value rounded to the precision, estimate and then check the digits
+    int exp = (int)floor(log10(fabs(value)));
+    int len = -1;
+    for (int tries = 0; tries < 3; ++tries) {
+        int decimals = GENERAL_PRECISION - 1 - exp;
+        if (decimals < 0 || decimals > MAX_DECIMALS)
+            return -1; // "%g" uses an exponent
+        len = format_fixed(out, value, decimals);
+        if (len < 0)
+            return -1;
+
+        // find the first significant digit
+        int sign    = out[0] == '-';
+        int int_len = len - sign - (decimals ? decimals + 1 : 0);
+        int rounded_exp;
+        if (int_len > 1 || out[sign] != '0') {
+            rounded_exp = int_len - 1;
+        }
+        else {
+            int zeros = 0;
+            while (zeros < decimals && out[sign + 2 + zeros] == '0') {
+                zeros++;
+            }
+            rounded_exp = -zeros - 1;
+        }
+        if (rounded_exp < -4 || rounded_exp >= GENERAL_PRECISION)
+            return -1; // "%g" uses an exponent
+        if (rounded_exp == exp)
+            break;
+        exp = rounded_exp;
+        len = -1;
+    }
+    if (len < 0)
+        return -1;
+
+    // strip trailing zeros and the point
+    if (memchr(out, '.', len)) {
+        while (out[len - 1] == '0') {
+            len--;
+        }
+        if (out[len - 1] == '.')
+            len--;
+    }
+    return len;
+}
+
+int format_double(char *buf, size_t size, char const *format, double value)
+{
+    // parse "%f", "%.<n>f", or "%g" and the text after it
+    char const *p = format;
+    int decimals  = 6;
+    int general   = 0;
+    if (*p++ != '%')
+        return snprintf(buf, size, format, value);
+    if (*p == '.') {
+        decimals = 0;
+        for (++p; *p >= '0' && *p <= '9' && decimals <= MAX_DECIMALS; ++p) {
+            decimals = decimals * 10 + *p - '0';
+        }
+        if (decimals > MAX_DECIMALS || *p != 'f')
+            return snprintf(buf, size, format, value);
+    }
+    else if (*p == 'g') {
+        general = 1;
+    }
+    else if (*p != 'f') {
+        return snprintf(buf, size, format, value);
+    }
+    char const *suffix = p + 1;
+    for (char const *s = suffix; *s; ++s) {
+        if (*s == '%' && *++s != '%')
+            return snprintf(buf, size, format, value);
+    }
+
+    char tmp[FORMAT_DOUBLE_BUFLEN];
+    int len = general ? format_general(tmp, value) : format_fixed(tmp, value, decimals);
+    if (len < 0)
+        return snprintf(buf, size, format, value);
+
+    // append the text, a "%%" is a single '%'
+    for (char const *s = suffix; *s && len < (int)sizeof(tmp); ++s) {
+        if (*s == '%')
+            ++s;
+        tmp[len++] = *s;
+    }
+    if (len >= (int)sizeof(tmp))
+        return snprintf(buf, size, format, value); // long text
+
+    if (size) {
+        size_t n = (size_t)len < size ? (size_t)len : size - 1;
+        memcpy(buf, tmp, n);
+        buf[n] = '\0';
+    }
+    return len;
+}
+
+#ifdef _TEST
+#include <stdlib.h>
+
+/// Compare to snprintf(), returns 1 on a mismatch.
+static int check_format(char const *format, double value, size_t size)
+{
+    char buf[FORMAT_DOUBLE_BUFLEN + 16];
+    char ref[FORMAT_DOUBLE_BUFLEN + 16];
+    memset(buf, 'x', sizeof(buf));
+    memset(ref, 'x', sizeof(ref));
+    int len     = format_double(buf, size, format, value);
+    int ref_len = snprintf(ref, size, format, value);
+    if (len == ref_len && !memcmp(buf, ref, sizeof(buf)))
+        return 0;
+    fprintf(stderr, "FAIL: \"%s\" of %.17g (size %u): \"%s\" (%d) <> \"%s\" (%d)\n",
+            format, value, (unsigned)size, size ? buf : "", len, size ? ref : "", ref_len);
+    return 1;
+}
+
+int main(void)
+{
+    unsigned passed = 0;
+    unsigned failed = 0;
+
+    char const *formats[] = {
+            "%f", "%.0f", "%.1f", "%.2f", "%.3f", "%.4f", "%.5f", "%.6f", "%.7f", "%.8f", "%.9f",
+            "%.1f C", "%.3f %%", "%.10f", "%g", "%g dB", "%e", "%5.1f",
+    };
+    unsigned num_formats = sizeof(formats) / sizeof(*formats);
+
+    double const values[] = {
+            0.0, -0.0, 1.0, -1.0, 0.1, 0.2, 0.3, 1e-10, -1e-10, 123.456, -273.15, 1013.25, 433.92e6,
+            // ties, exact in binary, round half to even
+            0.5, 1.5, 2.5, 3.5, -0.5, -2.5, 0.25, 0.75, 0.125, 0.375, -0.625, 1.0625, 2.03125,
+            0.0009765625, 0.00048828125, 1023.5, 999.5, 99.95, 9.9999995,
+            // near 2^52 and 2^53, the last values with a fraction and the fallback
+            4503599627370495.5, -4503599627370495.5, 4503599627370495.0, 4503599627370496.0,
+            4503599627370497.0, 2251799813685247.75, 2251799813685248.5, 9007199254740991.0,
+            9007199254740992.0, 1e16, 1e20, -1e300, 1e-300, 5e-324,
+            // the exponent boundaries of "%g"
+            1e-5, 1e-4, -1e-4, 9.99999e-5, 9.999995e-5, 9.9999949e-5, 0.000099999951, 0.00010000005,
+            999999.0, 999999.4, 999999.5, -999999.5, 999999.50000001, 1e6, 1e7, 123456.5, 12345.65,
+            100000.0, 99999.95, 0.00012345675,
+    };
+    unsigned num_values = sizeof(values) / sizeof(*values);
+
+    fprintf(stderr, "format_double:: values\n");
+    for (unsigned f = 0; f < num_formats; ++f) {
+        for (unsigned v = 0; v < num_values; ++v) {
+            if (check_format(formats[f], values[v], FORMAT_DOUBLE_BUFLEN + 16))
+                ++failed;
+            else
+                ++passed;
+        }
+    }
+
+    fprintf(stderr, "format_double:: special values and truncation\n");
+    double const special[] = {INFINITY, -INFINITY, NAN, 1234.5678};
+    for (unsigned f = 0; f < num_formats; ++f) {
+        for (unsigned v = 0; v < sizeof(special) / sizeof(*special); ++v) {
+            for (size_t size = 0; size < 8; size += 3) {
+                if (check_format(formats[f], special[v], size))
+                    ++failed;
+                else
+                    ++passed;
+            }
+        }
+    }
+
+    fprintf(stderr, "format_double:: random values\n");
+    unsigned mismatches = 0;
+    srand(1);
+    for (unsigned k = 0; k < 200000; ++k) {
+        double value;
+        if (k % 2) // any bits over the range of the integer arithmetic
+            value = ldexp((double)rand() / RAND_MAX + 0.5, rand() % 100 - 45);
+        else // a few decimals, as the decoders compute, often a tie
+            value = (double)(rand() % 2000001 - 1000000) / pow10_table[rand() % 7];
+        mismatches += check_format(formats[k % num_formats], value, FORMAT_DOUBLE_BUFLEN + 16);
+    }
+    if (mismatches)
+        ++failed;
+    else
+        ++passed;
+
+    fprintf(stderr, "format_double:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
+
+    return failed;
+}
+#endif /* _TEST */
@@ -0,0 +1,136 @@
+/** @file
+    Hop scheduler, chooses the dwell time on each hop frequency.
+
+    Without adaption the configured dwell time of each frequency is used.
+    With adaption each visit measures the rate of events, undecoded packages
+    count as a fraction of an event, and the rates are smoothed over the visits.
+    The total configured dwell time of a hop cycle is then shared in proportion
+    to the rates, within bounds so that quiet frequencies are still visited.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "hop_sched.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HOP_PACKAGE_WEIGHT 0.125 // an undecoded package counts as this many events
+#define HOP_RATE_SMOOTHING 4     // a visit moves the rate by a quarter
+
+hop_sched_t *hop_sched_create(unsigned frequencies, int const *hop_time, unsigned hop_times)
+{
+    if (!frequencies || !hop_times)
+        return NULL;
+
+    hop_sched_t *sched = calloc(1, sizeof(*sched) + frequencies * sizeof(sched->slot[0]));
+    if (!sched) {
+        WARN_CALLOC("hop_sched_create()");
+        return NULL;
+    }
+    sched->len = frequencies;
+    for (unsigned i = 0; i < frequencies; ++i) {
+        sched->slot[i].base_dwell = hop_time[i < hop_times ? i : hop_times - 1];
+        sched->slot[i].rate       = -1.0;
+    }
+    return sched;
+}
+
+void hop_sched_free(hop_sched_t *sched)
+{
+    free(sched);
+}
+
+void hop_sched_observe(hop_sched_t *sched, unsigned index, unsigned long n_samples, uint32_t samp_rate, unsigned packages, unsigned events)
+{
+    if (index >= sched->len)
+        return;
+    hop_slot_t *slot = &sched->slot[index];
+    slot->packages += packages;
+    slot->events += events;
+
+    if (sched->samp_rate != samp_rate) {
+        sched->samp_rate     = samp_rate;
+        sched->quiet_samples = 0;
+    }
+    sched->quiet_samples = packages ? 0 : sched->quiet_samples + n_samples;
+}
+
+void hop_sched_tuned(hop_sched_t *sched)
+{
+    sched->quiet_samples = 0;
+}
+
+/// Lower bound of an adapted dwell, at least a second as the dwell is measured in whole seconds.
+static double hop_min_dwell(hop_sched_t const *sched, hop_slot_t const *slot)
+{
+    double min_dwell = sched->min_dwell > 0.0 ? sched->min_dwell : slot->base_dwell / 4;
+    return min_dwell < 1.0 ? 1.0 : min_dwell;
+}
+
+double hop_sched_dwell(hop_sched_t const *sched, unsigned index)
+{
+    hop_slot_t const *slot = &sched->slot[index];
+    if (!sched->adapt)
+        return slot->base_dwell;
+
+    double total  = 0.0;
+    double weight = 0.0;
+    for (unsigned i = 0; i < sched->len; ++i) {
+        if (sched->slot[i].rate < 0.0)
+            return slot->base_dwell; // not all visited yet
+        total += sched->slot[i].base_dwell;
+    }
+    double prior = 1.0 / total; // one event per hop cycle
+    for (unsigned i = 0; i < sched->len; ++i) {
+        weight += sched->slot[i].rate + prior;
+    }
+
+    double dwell     = total * (slot->rate + prior) / weight;
+    double min_dwell = hop_min_dwell(sched, slot);
+    double max_dwell = sched->max_dwell > 0.0 ? sched->max_dwell : slot->base_dwell * 4;
+    if (dwell > max_dwell)
+        dwell = max_dwell;
+    if (dwell < min_dwell)
+        dwell = min_dwell;
+    return dwell;
+}
+
+int hop_sched_due(hop_sched_t const *sched, unsigned index, double secs)
+{
+    if (index >= sched->len)
+        return 1;
+    double dwell = hop_sched_dwell(sched, index);
+    if (secs >= dwell)
+        return 1;
+
+    if (!sched->idle_ms || !sched->samp_rate)
+        return 0;
+    // an adapted dwell is not cut below the lower bound
+    if (sched->adapt) {
+        if (secs < hop_min_dwell(sched, &sched->slot[index]))
+            return 0;
+    }
+    return sched->quiet_samples * 1000 >= (uint64_t)sched->idle_ms * sched->samp_rate;
+}
+
+void hop_sched_leave(hop_sched_t *sched, unsigned index, double secs, float noise_level)
+{
+    if (index >= sched->len)
+        return;
+    hop_slot_t *slot  = &sched->slot[index];
+    slot->noise_level = noise_level;
+    if (secs < 1.0)
+        secs = 1.0; // the dwell is measured in whole seconds
+    double rate = (slot->events + slot->packages * HOP_PACKAGE_WEIGHT) / secs;
+    if (slot->rate < 0.0)
+        slot->rate = rate;
+    else
+        slot->rate += (rate - slot->rate) / HOP_RATE_SMOOTHING;
+    slot->events   = 0;
+    slot->packages = 0;
+}
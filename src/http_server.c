@@ -17,11 +17,23 @@ A choice of endpoints are available:
     (also serves "/favicon.ico", "/app.css", "/app.js", "/vendor.css", "/vendor.js")
 - "/jsonrpc": JSON-RPC API
 - "/cmd": simple JSON command API
-- "/events": HTTP (chunked) streaming API, streams JSON events
+- "/events": HTTP (chunked) streaming API, streams JSON events,
+    or with `since=<seq>` a query of the events after a sequence number
 - "/stream": HTTP (plain) streaming API, streams JSON events
+- "/metrics": Prometheus metrics, counters and stage time histograms
 - "/api": RESTful API (not implemented)
 - "ws:": Websocket API (similar to cmd/events API)
 
+## Compression
+
+With zlib the replies and the unfiltered "/events" and "/stream" streams are
+gzip compressed for clients that send `Accept-Encoding: gzip`, and websocket
+clients can negotiate permessage-deflate. Each event is deflated once on a
+stream shared by all gzip clients, and once on a stream shared by all websockets,
+only the gzip trailer (CRC and length) is kept per client. A shared stream is
+reset when a client joins, and a client that can not keep up is closed, it can
+not skip an event. Turn it off with the `compress=0` option.
+
 ## JSON-RPC API
 
 S.a. https://www.jsonrpc.org/specification
@@ -32,6 +44,10 @@ Examples:
     {"jsonrpc": "2.0", "result": "Ok", "id": 0}
     {"jsonrpc": "2.0", "error": {"code": -32600, "message": "Invalid Request"}, "id": null}
 
+A batch is an array of requests, the reply is the array of the responses in order:
+
+    [{"jsonrpc": "2.0", "method": "get_meta", "id": 1}, {"jsonrpc": "2.0", "method": "get_gain", "id": 2}]
+
 ## JSON command / Websocket API
 
 Simplified JSON command and query.
@@ -42,12 +58,34 @@ Examples:
     {"result": "Ok"}
     {"error": "Invalid Request"}}
 
+The replies of getters on "/cmd" have an ETag, a request with a matching
+If-None-Match header is answered with 304 Not Modified and no body.
+
+A websocket client subscribes to config changes with
+
+    {"cmd": "subscribe", "arg": "config"}
+
+and then gets `{"config": {...}}` with the settings at once and whenever
+a command changed them, `{"cmd": "unsubscribe", "arg": "config"}` ends it.
+
 ## HTTP events / streaming / Websocket API
 
 You will receive JSON events, one per line terminated with CRLF.
 On Events and Stream endpoints a keep-alive of CRLF will be send every 60 seconds.
 Use e.g. httpie with `http --stream --timeout=70 :8433/events`
 or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
+Filter the events with e.g. `/events?model=Acurite-Tower&id=1234`.
+
+## HTTP events query API
+
+Every event gets a sequence number and the last events are kept in a history.
+Poll with `/events?since=<seq>` (and the model and id filters) to get the
+events after that sequence number as
+
+    {"seq": 1234, "missed": 0, "events": [...]}
+
+and poll again with the returned seq, start with `since=0`.
+The missed count is the number of events that were dropped from the history.
 
 ## Queries
 
@@ -106,7 +144,22 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
 #include "jsmn.h"
 #include "mongoose.h"
 #include "fatal.h"
+#include "metrics.h"
+#include "load_shed.h"
+#include "output_queue.h"
+#include "output_filter.h"
+#include "net_thread.h"
+#include "sdr.h"
+#include "watchdog.h"
+#include "agc.h"
+#include "spectrum.h"
+#include "pulse_recorder.h"
+#include "profiler.h"
+#include <stdarg.h>
 #include <stdbool.h>
+#ifdef ZLIB
+#include <zlib.h>
+#endif
 
 // embed index.html so browsers allow access as local
 #define INDEX_HTML \
@@ -127,100 +180,145 @@ or `(echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433`
     "<script src=\"https://triq.org/rxui/js/chunk-vendors.js\"></script>" \
     "<script src=\"https://triq.org/rxui/js/app.js\"></script>"
 
-// generic ring list
+// history ring of serialized events
 
-#define DEFAULT_HISTORY_SIZE 100
+#define DEFAULT_HISTORY_SIZE (256 * 1024) /* bytes */
+#define HISTORY_KEY_MAX 255
 
+/// A preallocated byte ring of records, the oldest records are overwritten.
+/// Positions count the bytes ever written.
+typedef struct {
+    char *buf;
+    size_t size;   ///< a power of two
+    uint64_t head; ///< start of the oldest record
+    uint64_t tail; ///< end of the newest record
+    uint64_t seq;  ///< sequence number of the newest record, the first record is 1
+} history_ring_t;
+
+/// Header of a history record, followed by the model, the id, and the message.
+typedef struct {
+    uint64_t seq;
+    uint32_t len;      ///< length of the message
+    uint8_t model_len; ///< length of the model key, 0 if none
+    uint8_t id_len;    ///< length of the id key, 0 if none
+    uint16_t reserved;
+} history_record_t;
+
+/// Filter on the model and id keys, an empty key matches any record.
 typedef struct {
-    unsigned size;
-    void **data;
-    void **head;
-    void **tail;
-} ring_list_t;
+    char model[HISTORY_KEY_MAX + 1];
+    char id[HISTORY_KEY_MAX + 1];
+} history_filter_t;
 
-static ring_list_t *ring_list_new(unsigned size)
+static int history_init(history_ring_t *ring, size_t size)
 {
-    ring_list_t *ring = calloc(1, sizeof(ring_list_t));
-    if (!ring) {
-        WARN_CALLOC("ring_list_new()");
-        return NULL;
-    }
-
-    ring->data = calloc(size, sizeof(void *));
-    if (!ring->data) {
-        WARN_CALLOC("ring_list_new()");
-        free(ring);
-        return NULL;
-    }
-
-    ring->size = size;
-    ring->tail = ring->data;
-
-    return ring;
+    size_t ring_size = 4096;
+    while (ring_size < size)
+        ring_size *= 2;
+
+    ring->buf = malloc(ring_size);
+    if (!ring->buf) {
+        WARN_MALLOC("history_init()");
+        return -1; // NOTE: no history on alloc failure.
+    }
+    ring->size = ring_size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->seq  = 0;
+    return 0;
 }
 
-// the ring needs to be empty before calling this
-static void ring_list_free(ring_list_t *ring)
+static void history_free(history_ring_t *ring)
 {
-    if (ring) {
-        if (ring->data)
-            free(ring->data);
-        free(ring);
-    }
+    free(ring->buf);
+    ring->buf = NULL;
 }
 
-// free the data returned
-static void *ring_list_shift(ring_list_t *ring)
+static void history_copy_in(history_ring_t *ring, uint64_t pos, void const *src, size_t len)
 {
-    if (!ring->head)
-        return NULL;
-
-    void *ret = *ring->head;
-
-    ++ring->head;
-    if (ring->head >= ring->data + ring->size)
-        ring->head -= ring->size;
-    if (ring->head == ring->tail)
-        ring->head = NULL;
-
-    return ret;
+    size_t off  = pos & (ring->size - 1);
+    size_t part = ring->size - off < len ? ring->size - off : len;
+    memcpy(ring->buf + off, src, part);
+    memcpy(ring->buf, (char const *)src + part, len - part);
 }
 
-// retain data before passing in and free the data returned.
-static void *ring_list_push(ring_list_t *ring, void *data)
+static void history_copy_out(history_ring_t *ring, uint64_t pos, void *dst, size_t len)
 {
-    *ring->tail = data;
-
-    if (!ring->head)
-        ring->head = ring->tail;
-
-    ++ring->tail;
-    if (ring->tail >= ring->data + ring->size)
-        ring->tail -= ring->size;
-
-    if (ring->tail == ring->head)
-        return ring_list_shift(ring);
-
-    return NULL;
+    size_t off  = pos & (ring->size - 1);
+    size_t part = ring->size - off < len ? ring->size - off : len;
+    memcpy(dst, ring->buf + off, part);
+    memcpy((char *)dst + part, ring->buf, len - part);
 }
 
-static void **ring_list_iter(ring_list_t *ring)
+static uint64_t history_record_size(history_record_t const *rec)
 {
-    return ring->head;
+    return sizeof(*rec) + rec->model_len + rec->id_len + rec->len;
 }
 
-static void **ring_list_next(ring_list_t *ring, void **iter)
+/// Get the message of a record as up to two slices of the ring.
+static int history_slices(history_ring_t *ring, uint64_t pos, history_record_t const *rec, struct mg_str slice[2])
 {
-    if (!iter)
-        return NULL;
+    size_t off  = (pos + sizeof(*rec) + rec->model_len + rec->id_len) & (ring->size - 1);
+    size_t part = ring->size - off < rec->len ? ring->size - off : rec->len;
+    slice[0]    = mg_mk_str_n(ring->buf + off, part);
+    slice[1]    = mg_mk_str_n(ring->buf, rec->len - part);
+    return part < rec->len ? 2 : 1;
+}
 
-    ++iter;
-    if (iter >= ring->data + ring->size)
-        iter -= ring->size;
-    if (iter == ring->tail)
-        iter = NULL;
+static int history_match(history_ring_t *ring, uint64_t pos, history_record_t const *rec, history_filter_t const *filter)
+{
+    char key[HISTORY_KEY_MAX];
+    size_t model_len = strlen(filter->model);
+    size_t id_len    = strlen(filter->id);
+    if (model_len) {
+        if (rec->model_len != model_len)
+            return 0;
+        history_copy_out(ring, pos + sizeof(*rec), key, model_len);
+        if (memcmp(key, filter->model, model_len))
+            return 0;
+    }
+    if (id_len) {
+        if (rec->id_len != id_len)
+            return 0;
+        history_copy_out(ring, pos + sizeof(*rec) + rec->model_len, key, id_len);
+        if (memcmp(key, filter->id, id_len))
+            return 0;
+    }
+    return 1;
+}
 
-    return iter;
+/// Append a message with its model and id keys, returns the sequence number.
+static uint64_t history_push(history_ring_t *ring, char const *msg, size_t len, char const *model, char const *id)
+{
+    size_t model_len = model ? strlen(model) : 0;
+    size_t id_len    = id ? strlen(id) : 0;
+    history_record_t rec = {
+            .seq       = ++ring->seq,
+            .len       = (uint32_t)len,
+            .model_len = model_len <= HISTORY_KEY_MAX ? (uint8_t)model_len : 0,
+            .id_len    = id_len <= HISTORY_KEY_MAX ? (uint8_t)id_len : 0,
+    };
+    uint64_t rec_size = history_record_size(&rec);
+    if (!ring->buf || rec_size > ring->size)
+        return rec.seq; // no history or the message is too large to keep
+
+    while (ring->tail + rec_size - ring->head > ring->size) {
+        history_record_t old;
+        history_copy_out(ring, ring->head, &old, sizeof(old));
+        ring->head += history_record_size(&old);
+    }
+    uint64_t pos = ring->tail;
+    history_copy_in(ring, pos, &rec, sizeof(rec));
+    pos += sizeof(rec);
+    if (rec.model_len)
+        history_copy_in(ring, pos, model, rec.model_len);
+    pos += rec.model_len;
+    if (rec.id_len)
+        history_copy_in(ring, pos, id, rec.id_len);
+    pos += rec.id_len;
+    history_copy_in(ring, pos, msg, len);
+    ring->tail = pos + len;
+    return rec.seq;
 }
 
 // data helpers that could go into r_api
@@ -248,6 +346,25 @@ static data_t *meta_data(r_cfg_t *cfg)
             NULL);
 }
 
+/// Append the statistics of a registered decoder.
+static void append_decoder_stats(data_t *data, r_device *r_dev)
+{
+    data_append(data,
+            "events", "", DATA_INT, r_dev->stats.events,
+            "ok", "", DATA_INT, r_dev->stats.ok,
+            "messages", "", DATA_INT, r_dev->stats.messages,
+            NULL);
+    if (r_dev->stats.truncated)
+        data_append(data,
+                "truncated", "", DATA_INT, r_dev->stats.truncated,
+                NULL);
+    if (r_dev->profile)
+        data_append(data,
+                "slicer_us", "", DATA_DOUBLE, r_dev->stats.slicer_time,
+                "decode_us", "", DATA_DOUBLE, r_dev->stats.decode_time,
+                NULL);
+}
+
 static data_t *protocols_data(r_cfg_t *cfg)
 {
     list_t devs = {0};
@@ -256,11 +373,11 @@ static data_t *protocols_data(r_cfg_t *cfg)
     for (int i = 0; i < cfg->num_r_devices; ++i) {
         r_device *dev = &cfg->devices[i];
 
-        int enabled = 0;
+        r_device *enabled = NULL;
         for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
             r_device *r_dev = *iter;
             if (r_dev->protocol_num == dev->protocol_num) {
-                enabled = 1;
+                enabled = r_dev;
                 break;
             }
         }
@@ -280,10 +397,12 @@ static data_t *protocols_data(r_cfg_t *cfg)
                 "tolerance", "", DATA_DOUBLE, dev->tolerance,
                 "fields", "", DATA_ARRAY, data_array(fields_len, DATA_STRING, dev->fields),
                 "def", "", DATA_INT, dev->disabled == 0,
-                "en", "", DATA_INT, enabled,
+                "en", "", DATA_INT, enabled != NULL,
                 "verbose", "", DATA_INT, dev->verbose,
                 "verbose_bits", "", DATA_INT, dev->verbose_bits,
                 NULL);
+        if (enabled)
+            append_decoder_stats(data, enabled);
         list_push(&devs, data);
     }
 
@@ -310,6 +429,7 @@ static data_t *protocols_data(r_cfg_t *cfg)
                 "verbose", "", DATA_INT, dev->verbose,
                 "verbose_bits", "", DATA_INT, dev->verbose_bits,
                 NULL);
+        append_decoder_stats(data, dev);
         list_push(&devs, data);
     }
 
@@ -328,6 +448,7 @@ typedef void (*rpc_response_fn)(rpc_t *rpc, int error_code, char const *message,
 
 struct rpc {
     struct mg_connection *nc;
+    struct mbuf *reply; ///< the reply of an HTTP request, sent once complete
     rpc_response_fn response;
     int ver;
     char *method;
@@ -556,26 +677,45 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         rpc->response(rpc, 2, NULL, cfg->conversion_mode);
     }
     else if (!strcmp(rpc->method, "get_stats")) {
-        char buf[20480]; // we expect the stats string to be around 15k bytes.
         data_t *data = create_report_data(cfg, 2/*report active devices*/);
         // flush_report_data(cfg); // snapshot, do not flush
-        data_print_jsons(data, buf, sizeof(buf));
-        rpc->response(rpc, 1, buf, 0);
+        data_buf_t buf = {0};
+        char const *json = data_print_jsons_buf(data, &buf, NULL);
+        rpc->response(rpc, json ? 1 : -1, json ? json : "Out of memory", 0);
         data_free(data);
+        data_buf_free(&buf);
     }
     else if (!strcmp(rpc->method, "get_meta")) {
-        char buf[2048]; // we expect the meta string to be around 500 bytes.
         data_t *data = meta_data(cfg);
-        data_print_jsons(data, buf, sizeof(buf));
-        rpc->response(rpc, 1, buf, 0);
+        data_buf_t buf = {0};
+        char const *json = data_print_jsons_buf(data, &buf, NULL);
+        rpc->response(rpc, json ? 1 : -1, json ? json : "Out of memory", 0);
+        data_free(data);
+        data_buf_free(&buf);
+    }
+    else if (!strcmp(rpc->method, "get_spectrum")) {
+        data_t *data = cfg->spectrum ? spectrum_data(cfg->spectrum) : NULL;
+        data_buf_t buf = {0};
+        char const *json = data ? data_print_jsons_buf(data, &buf, NULL) : NULL;
+        rpc->response(rpc, json ? 1 : -1, json ? json : cfg->spectrum ? "Out of memory" : "Spectrum monitor not enabled, see -Y spectrum", 0);
+        data_free(data);
+        data_buf_free(&buf);
+    }
+    else if (!strcmp(rpc->method, "get_pulses")) {
+        data_t *data = cfg->pulse_recorder ? pulse_recorder_data(cfg->pulse_recorder) : NULL;
+        data_buf_t buf = {0};
+        char const *json = data ? data_print_jsons_buf(data, &buf, NULL) : NULL;
+        rpc->response(rpc, json ? 1 : -1, json ? json : cfg->pulse_recorder ? "Out of memory" : "Pulse recorder not enabled, see -Y recorder", 0);
         data_free(data);
+        data_buf_free(&buf);
     }
     else if (!strcmp(rpc->method, "get_protocols")) {
-        char buf[65536]; // we expect the protocol string to be around 60k bytes.
         data_t *data = protocols_data(cfg);
-        data_print_jsons(data, buf, sizeof(buf));
-        rpc->response(rpc, 1, buf, 0);
+        data_buf_t buf = {0};
+        char const *json = data_print_jsons_buf(data, &buf, NULL);
+        rpc->response(rpc, json ? 1 : -1, json ? json : "Out of memory", 0);
         data_free(data);
+        data_buf_free(&buf);
     }
 
     // Setter
@@ -630,6 +770,33 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
     }
 
     // Apply
+    else if (!strcmp(rpc->method, "reload")) {
+        cfg->reload_now = 1; // applied between buffers
+        rpc->response(rpc, 0, "Ok", 0);
+    }
+    else if (!strcmp(rpc->method, "dump_pulses")) {
+        char path[64];
+        if (!cfg->pulse_recorder)
+            rpc->response(rpc, -1, "Pulse recorder not enabled, see -Y recorder", 0);
+        else if (pulse_recorder_dump_file(cfg->pulse_recorder, cfg->samp_rate, path) < 0)
+            rpc->response(rpc, -1, "Failed to write the file", 0);
+        else
+            rpc->response(rpc, 0, path, 0);
+    }
+    else if (!strcmp(rpc->method, "profile_start")) {
+        if (!profiler_available())
+            rpc->response(rpc, -1, "CPU profiler not available, see ENABLE_PROFILER", 0);
+        else if (profiler_start(rpc->arg, rpc->val ? rpc->val : PROFILER_DEFAULT_SECONDS) < 0)
+            rpc->response(rpc, -1, "Failed to start the CPU profile", 0);
+        else
+            rpc->response(rpc, 0, profiler_path(), 0);
+    }
+    else if (!strcmp(rpc->method, "profile_stop")) {
+        if (profiler_stop() < 0)
+            rpc->response(rpc, -1, "No CPU profile running", 0);
+        else
+            rpc->response(rpc, 0, profiler_path(), 0);
+    }
     else if (!strcmp(rpc->method, "device")) {
         if (!rpc->arg)
             rpc->response(rpc, -1, "Missing arg", 0);
@@ -647,6 +814,8 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
         if (!rpc->arg)
             rpc->response(rpc, -1, "Missing arg", 0);
         set_gain_str(cfg, rpc->arg);
+        if (cfg->agc)
+            agc_set_gain(cfg->agc, rpc->arg);
         rpc->response(rpc, 0, "Ok", 0);
     }
     else if (!strcmp(rpc->method, "center_frequency")) {
@@ -671,19 +840,372 @@ static void rpc_exec(rpc_t *rpc, r_cfg_t *cfg)
 // http server
 
 #define KEEP_ALIVE 60 /* seconds */
+#define DEFAULT_QUEUE_LIMIT (1024 * 1024) /* bytes per client */
+
+#ifdef ZLIB
+/// A deflate stream shared by the clients that get all events, reset when a client joins.
+typedef struct {
+    z_stream zs;
+    int init;        ///< the stream is allocated on the first join
+    int join;        ///< a client joined, reset before the next event
+    int state;       ///< the event is 0 not yet deflated, 1 deflated, -1 failed
+    struct mbuf out; ///< the event deflated
+} shared_deflate_t;
+#endif
 
 struct http_server_context {
     struct mg_connection *conn;
     struct mg_serve_http_opts server_opts;
     r_cfg_t *cfg;
     struct data_output *output;
-    ring_list_t *history;
+    history_ring_t history;
+    size_t queue_limit; ///< high-water mark of a client send queue
+    int evict;          ///< close a slow client instead of dropping events
+    unsigned dropped;   ///< events not sent to a slow client, in total
+    unsigned config_subscribers; ///< websockets subscribed to config changes
+    uint64_t config_hash;        ///< hash of the config last sent to the subscribers
+    int compress;                ///< gzip and websocket deflate are offered
+#ifdef ZLIB
+    z_stream deflate;            ///< raw deflate of the replies, reset for each
+    z_stream inflate;            ///< raw inflate of the websocket messages, reset for each message
+    shared_deflate_t ws;         ///< the events of the websockets
+    shared_deflate_t gz;         ///< the events of the unfiltered gzip streams, with CRLF
+    uint32_t crlf_crc;
+#endif
 };
 
+/// What a client connection is subscribed to, websockets are marked by mongoose.
+enum nc_kind {
+    NC_REQUEST, ///< plain requests, no events
+    NC_EVENTS,  ///< chunked /events stream
+    NC_STREAM,  ///< plain /stream
+};
+
+/// Context of a client connection, the listening connection has the server context.
 struct nc_context {
-    int is_chunked;
+    struct http_server_context *server; ///< NULL once the server is stopped
+    enum nc_kind kind;
+    struct mbuf chunk; ///< events coalesced into the next chunk
+    unsigned sent;
+    unsigned dropped;
+    int evicted;
+    int config_subscribed;   ///< the websocket gets the config changes
+    history_filter_t filter; ///< events streamed to the client
+    int gzip;                ///< the stream is gzip compressed
+    uint32_t gzip_crc;       ///< CRC of the stream data for the gzip trailer
+    uint32_t gzip_len;       ///< length of the stream data for the gzip trailer, modulo 2^32
+    int ws_deflate;          ///< the websocket negotiated permessage-deflate
 };
 
+#define GZIP_MIN_SIZE 256  /* bytes, smaller replies are not compressed */
+#define WS_INFLATE_MAX (64 * 1024) /* bytes, larger websocket messages are refused */
+
+#ifdef ZLIB
+
+/// A gzip header with no name and no time, for an unknown OS.
+static char const gzip_header[10] = {0x1f, (char)0x8b, 8, 0, 0, 0, 0, 0, 0, (char)0xff};
+
+/// An empty stored block, adds no data, keeps a compressed stream alive.
+static char const empty_block[4] = {0x00, 0x00, (char)0xff, (char)0xff};
+
+/// Append the data deflated, with a sync flush the output is byte aligned and not final.
+static int deflate_data(z_stream *zs, void const *buf, size_t len, int flush, struct mbuf *out)
+{
+    zs->next_in  = (Bytef *)buf;
+    zs->avail_in = (uInt)len;
+    do {
+        size_t room = deflateBound(zs, zs->avail_in) + 16;
+        mbuf_resize(out, out->len + room);
+        if (out->size < out->len + room)
+            return -1; // alloc failure
+        zs->next_out  = (Bytef *)out->buf + out->len;
+        zs->avail_out = (uInt)room;
+        if (deflate(zs, flush) == Z_STREAM_ERROR)
+            return -1;
+        out->len += room - zs->avail_out;
+    } while (zs->avail_out == 0);
+    return 0;
+}
+
+/// Append the data deflated with no prior data, ending with a sync flush.
+static int deflate_block(struct http_server_context *ctx, void const *buf, size_t len, struct mbuf *out)
+{
+    deflateReset(&ctx->deflate);
+    return deflate_data(&ctx->deflate, buf, len, Z_SYNC_FLUSH, out);
+}
+
+static void shared_free(shared_deflate_t *sh)
+{
+    if (sh->init)
+        deflateEnd(&sh->zs);
+    mbuf_free(&sh->out);
+}
+
+static void compress_free(struct http_server_context *ctx)
+{
+    deflateEnd(&ctx->deflate);
+    inflateEnd(&ctx->inflate);
+    shared_free(&ctx->ws);
+    shared_free(&ctx->gz);
+}
+
+static int compress_init(struct http_server_context *ctx)
+{
+    if (deflateInit2(&ctx->deflate, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return -1;
+    if (inflateInit2(&ctx->inflate, -MAX_WBITS) != Z_OK) {
+        deflateEnd(&ctx->deflate);
+        return -1;
+    }
+    mbuf_init(&ctx->ws.out, 0);
+    mbuf_init(&ctx->gz.out, 0);
+    ctx->crlf_crc = (uint32_t)crc32(0L, (Bytef const *)"\r\n", 2);
+    return 0;
+}
+
+/// Join a client to a shared stream, the stream is reset before the next event, returns 0 on success.
+static int shared_join(shared_deflate_t *sh)
+{
+    if (!sh->init) {
+        if (deflateInit2(&sh->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            return -1;
+        sh->init = 1;
+    }
+    sh->join = 1;
+    return 0;
+}
+
+/// Deflate the event once on a shared stream, with a CRLF for the gzip streams, returns 0 on success.
+static int shared_event(shared_deflate_t *sh, char const *msg, size_t len, int crlf)
+{
+    if (!sh->state) {
+        sh->out.len = 0;
+        if (sh->join)
+            deflateReset(&sh->zs); // the joining clients have no prior data
+        sh->join = 0;
+        int ret  = crlf ? deflate_data(&sh->zs, msg, len, Z_NO_FLUSH, &sh->out)
+                          || deflate_data(&sh->zs, "\r\n", 2, Z_SYNC_FLUSH, &sh->out)
+                        : deflate_data(&sh->zs, msg, len, Z_SYNC_FLUSH, &sh->out);
+        sh->state = ret ? -1 : 1;
+        if (ret)
+            sh->join = 1; // the stream is broken, the clients are closed
+    }
+    return sh->state > 0 ? 0 : -1;
+}
+
+/// Append the final empty block and the gzip trailer.
+static void gzip_trailer(struct mbuf *out, uint32_t crc, uint32_t len)
+{
+    unsigned char trailer[10] = {0x03, 0x00,
+            (unsigned char)crc, (unsigned char)(crc >> 8), (unsigned char)(crc >> 16), (unsigned char)(crc >> 24),
+            (unsigned char)len, (unsigned char)(len >> 8), (unsigned char)(len >> 16), (unsigned char)(len >> 24)};
+    mbuf_append(out, trailer, sizeof(trailer));
+}
+
+/// Add the data of a stream to the gzip trailer.
+static void gzip_update(struct nc_context *cctx, uint32_t crc, size_t len)
+{
+    cctx->gzip_crc = (uint32_t)crc32_combine(cctx->gzip_crc, crc, (z_off_t)len);
+    cctx->gzip_len += (uint32_t)len;
+}
+
+/// Append the event deflated on the shared stream to a gzip stream, see shared_event().
+static void gzip_event(struct http_server_context *ctx, struct nc_context *cctx, struct mbuf *out, uint32_t crc, size_t len)
+{
+    mbuf_append(out, ctx->gz.out.buf, ctx->gz.out.len);
+    gzip_update(cctx, (uint32_t)crc32_combine(crc, ctx->crlf_crc, 2), len + 2);
+}
+
+/// Check if a list header has a token, ignores a token with a q-value of zero.
+static int header_has_token(struct mg_str const *header, char const *token)
+{
+    size_t token_len = strlen(token);
+    char const *p    = header->p;
+    char const *end  = header->p + header->len;
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ','))
+            p++;
+        char const *item = p;
+        while (p < end && *p != ',')
+            p++;
+        size_t len = (size_t)(p - item);
+        if (len >= token_len && !mg_ncasecmp(item, token, token_len)
+                && (len == token_len || item[token_len] == ';' || item[token_len] == ' ')) {
+            struct mg_str params = {item + token_len, len - token_len};
+            char const *q        = mg_strstr(params, mg_mk_str("q="));
+            return !q || strtod(q + 2, NULL) > 0.0;
+        }
+    }
+    return 0;
+}
+
+/// Check if the client accepts a gzip compressed reply.
+static int accepts_gzip(struct mg_connection *nc, struct http_message *hm)
+{
+    struct nc_context *cctx = nc->user_data;
+    struct mg_str *accept   = mg_get_http_header(hm, "Accept-Encoding");
+    return cctx->server->compress && accept && header_has_token(accept, "gzip");
+}
+
+/// Check if a websocket client offers permessage-deflate that we can accept.
+static int offers_deflate(struct http_message *hm)
+{
+    struct mg_str *ext = mg_get_http_header(hm, "Sec-WebSocket-Extensions");
+    if (!ext || !header_has_token(ext, "permessage-deflate"))
+        return 0;
+    // the events are deflated with the full window
+    char const *bits = mg_strstr(*ext, mg_mk_str("server_max_window_bits="));
+    return !bits || atoi(bits + 23) >= MAX_WBITS;
+}
+
+/// Inflate a websocket message, NOTE: the output is empty on error.
+static void ws_inflate(struct http_server_context *ctx, unsigned char const *buf, size_t len, struct mbuf *out)
+{
+    z_stream *zs = &ctx->inflate;
+    inflateReset(zs);
+    for (int i = 0; i < 2; ++i) {
+        zs->next_in  = i ? (Bytef *)empty_block : (Bytef *)buf;
+        zs->avail_in = i ? sizeof(empty_block) : (uInt)len;
+        while (zs->avail_in) {
+            mbuf_resize(out, out->len + 4096);
+            if (out->size < out->len + 4096 || out->len >= WS_INFLATE_MAX) {
+                out->len = 0;
+                return;
+            }
+            zs->next_out  = (Bytef *)out->buf + out->len;
+            zs->avail_out = 4096;
+            int ret       = inflate(zs, Z_SYNC_FLUSH);
+            out->len += 4096 - zs->avail_out;
+            if (ret == Z_STREAM_END)
+                break;
+            if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                out->len = 0;
+                return;
+            }
+        }
+    }
+}
+
+/// Start a gzip compressed stream if the client accepts it and gets all events, it joins the shared stream.
+static int gzip_start(struct mg_connection *nc, struct http_message *hm, struct nc_context *cctx, struct mbuf *out)
+{
+    // a few events deflated each on their own would not get smaller
+    if (*cctx->filter.model || *cctx->filter.id || !accepts_gzip(nc, hm) || shared_join(&cctx->server->gz))
+        return 0;
+    cctx->gzip     = 1;
+    cctx->gzip_crc = (uint32_t)crc32(0L, Z_NULL, 0);
+    cctx->gzip_len = 0;
+    mbuf_append(out, gzip_header, sizeof(gzip_header));
+    return 1;
+}
+
+#else
+
+static int accepts_gzip(struct mg_connection *nc, struct http_message *hm)
+{
+    UNUSED(nc);
+    UNUSED(hm);
+    return 0;
+}
+
+static int gzip_start(struct mg_connection *nc, struct http_message *hm, struct nc_context *cctx, struct mbuf *out)
+{
+    UNUSED(nc);
+    UNUSED(hm);
+    UNUSED(cctx);
+    UNUSED(out);
+    return 0;
+}
+
+#endif
+
+/// Send a reply with a body, gzip compressed if the client accepts it, the status and headers end with CRLF.
+static void send_body(struct mg_connection *nc, struct http_message *hm, char const *head, char const *body, size_t len)
+{
+#ifdef ZLIB
+    if (len >= GZIP_MIN_SIZE && accepts_gzip(nc, hm)) {
+        struct nc_context *cctx = nc->user_data;
+        struct mbuf gz;
+        mbuf_init(&gz, len / 4 + 64);
+        mbuf_append(&gz, gzip_header, sizeof(gzip_header));
+        if (!deflate_block(cctx->server, body, len, &gz)) {
+            gzip_trailer(&gz, (uint32_t)crc32(0L, (Bytef const *)body, (uInt)len), (uint32_t)len);
+            mg_printf(nc,
+                    "%s"
+                    "Content-Encoding: gzip\r\n"
+                    "Vary: Accept-Encoding\r\n"
+                    "Content-Length: %u\r\n"
+                    "\r\n", head, (unsigned)gz.len);
+            mg_send(nc, gz.buf, gz.len);
+            mbuf_free(&gz);
+            return;
+        }
+        mbuf_free(&gz); // send uncompressed on error
+    }
+#else
+    UNUSED(hm);
+#endif
+    mg_printf(nc,
+            "%s"
+            "Content-Length: %u\r\n"
+            "\r\n", head, (unsigned)len);
+    mg_send(nc, body, len);
+}
+
+/// Parse the model and id filters of a query.
+static void parse_filter(struct http_message *hm, history_filter_t *filter)
+{
+    mg_get_http_var(&hm->query_string, "model", filter->model, sizeof(filter->model));
+    mg_get_http_var(&hm->query_string, "id", filter->id, sizeof(filter->id));
+}
+
+static int filter_match(history_filter_t const *filter, char const *model, char const *id)
+{
+    return (!*filter->model || (model && !strcmp(filter->model, model)))
+            && (!*filter->id || (id && !strcmp(filter->id, id)));
+}
+
+/// Reply with the matching events after a sequence number, the client polls again with the returned seq.
+static void handle_history_query(struct mg_connection *nc, struct http_message *hm, history_ring_t *ring, uint64_t since, history_filter_t const *filter)
+{
+    uint64_t first = ring->seq + 1; // sequence number of the oldest record
+    if (ring->head != ring->tail) {
+        history_record_t rec;
+        history_copy_out(ring, ring->head, &rec, sizeof(rec));
+        first = rec.seq;
+    }
+    uint64_t missed = first > since + 1 ? first - since - 1 : 0;
+
+    struct mbuf body;
+    mbuf_init(&body, 0);
+    char head[80];
+    int head_len = snprintf(head, sizeof(head), "{\"seq\":%llu,\"missed\":%llu,\"events\":[",
+            (unsigned long long)ring->seq, (unsigned long long)missed);
+    mbuf_append(&body, head, (size_t)head_len);
+
+    int num_events = 0;
+    for (uint64_t pos = ring->head; since < ring->seq && pos != ring->tail;) {
+        history_record_t rec;
+        history_copy_out(ring, pos, &rec, sizeof(rec));
+        if (rec.seq > since && history_match(ring, pos, &rec, filter)) {
+            struct mg_str slice[2];
+            int num_slices = history_slices(ring, pos, &rec, slice);
+            if (num_events++)
+                mbuf_append(&body, ",", 1);
+            for (int i = 0; i < num_slices; ++i)
+                mbuf_append(&body, slice[i].p, slice[i].len);
+        }
+        pos += history_record_size(&rec);
+    }
+    mbuf_append(&body, "]}", 2);
+
+    send_body(nc, hm,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\n"
+            "Access-Control-Allow-Origin: *\r\n", body.buf, body.len);
+    mbuf_free(&body);
+}
+
 static void handle_options(struct mg_connection *nc, struct http_message *hm)
 {
     UNUSED(hm);
@@ -764,95 +1286,427 @@ static void rpc_response_ws(rpc_t *rpc, int ret_code, char const *message, int a
     }
 }
 
+/// Append a formatted part to the reply of an HTTP request.
+static void rpc_printf(rpc_t *rpc, char const *fmt, ...)
+{
+    char mem[256];
+    char *buf = mem;
+    va_list ap;
+    va_start(ap, fmt);
+    int len = mg_avprintf(&buf, sizeof(mem), fmt, ap);
+    va_end(ap);
+    if (len > 0)
+        mbuf_append(rpc->reply, buf, (size_t)len);
+    if (buf != mem)
+        free(buf);
+}
+
 // reply to jsonrpc command
 static void rpc_response_jsonrpc(rpc_t *rpc, int ret_code, char const *message, int arg)
 {
     char const *id = rpc->id ? rpc->id : "null";
     if (ret_code < 0) {
-        mg_printf_http_chunk(rpc->nc,
+        rpc_printf(rpc,
                 "{\"jsonrpc\": \"2.0\", \"error\": {\"code\": %d, \"message\": \"%s\"}, \"id\": %s}",
                 ret_code, message, id);
     }
     else if (ret_code == 0 && message) {
-        mg_printf_http_chunk(rpc->nc,
+        rpc_printf(rpc,
                 "{\"jsonrpc\": \"2.0\", \"result\": \"%s\", \"id\": %s}",
                 message, id);
     }
     else if (ret_code == 0) {
-        mg_printf_http_chunk(rpc->nc,
+        rpc_printf(rpc,
                 "{\"jsonrpc\": \"2.0\", \"result\": null, \"id\": %s}",
                 id);
     }
     else if (ret_code == 1) {
-        mg_printf_http_chunk(rpc->nc,
-                "{\"jsonrpc\": \"2.0\", \"result\": %s, \"id\": %s}",
-                message, id);
+        rpc_printf(rpc, "{\"jsonrpc\": \"2.0\", \"result\": ");
+        mbuf_append(rpc->reply, message, strlen(message));
+        rpc_printf(rpc, ", \"id\": %s}", id);
     }
     else if (ret_code == 2) {
-        mg_printf_http_chunk(rpc->nc,
+        rpc_printf(rpc,
                 "{\"jsonrpc\": \"2.0\", \"result\": %d, \"id\": %s}",
                 arg, id);
     }
     else /* if (ret_code == 3) */ {
-        mg_printf_http_chunk(rpc->nc,
+        rpc_printf(rpc,
                 "{\"jsonrpc\": \"2.0\", \"result\": %u, \"id\": %s}",
                 (unsigned)arg, id);
     }
-    mg_send_http_chunk(rpc->nc, "", 0); /* Send empty chunk, the end of response */
 }
 
 // reply to json command
 static void rpc_response_jsoncmd(rpc_t *rpc, int ret_code, char const *message, int arg)
 {
     if (ret_code < 0) {
-        mg_printf_http_chunk(rpc->nc,
+        rpc_printf(rpc,
                 "{\"error\": {\"code\": %d, \"message\": \"%s\"}}",
                 ret_code, message);
     }
-    else if (ret_code == 0 &&message) {
-        mg_printf_http_chunk(rpc->nc,
+    else if (ret_code == 0 && message) {
+        rpc_printf(rpc,
                 "{\"result\": \"%s\"}",
                 message);
     }
     else if (ret_code == 0) {
-        mg_printf_http_chunk(rpc->nc,
+        rpc_printf(rpc,
                 "{\"result\": null}");
     }
     else if (ret_code == 1) {
-        mg_printf_http_chunk(rpc->nc,
-                "{\"result\": %s}",
-                message);
+        rpc_printf(rpc, "{\"result\": ");
+        mbuf_append(rpc->reply, message, strlen(message));
+        rpc_printf(rpc, "}");
     }
     else if (ret_code == 2) {
-        mg_printf_http_chunk(rpc->nc,
+        rpc_printf(rpc,
                 "{\"result\": %d}",
                 arg);
     }
     else /* if (ret_code == 3) */ {
-        mg_printf_http_chunk(rpc->nc,
+        rpc_printf(rpc,
                 "{\"result\": %u}",
                 (unsigned)arg);
     }
-    mg_send_http_chunk(rpc->nc, "", 0); /* Send empty chunk, the end of response */
+}
+
+// Prometheus text exposition, formatted only when scraped
+
+static void metrics_printf(struct mbuf *buf, char const *fmt, ...)
+{
+    char line[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (len > 0)
+        mbuf_append(buf, line, (size_t)len < sizeof(line) ? (size_t)len : sizeof(line) - 1);
+}
+
+static void metrics_header(struct mbuf *buf, char const *name, char const *type, char const *help)
+{
+    metrics_printf(buf, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/// Escape a label value, backslash, quote, and newline need escaping.
+static char const *metrics_label(char *dst, size_t size, char const *src)
+{
+    size_t i = 0;
+    for (; *src && i + 2 < size; ++src) {
+        if (*src == '\\' || *src == '"' || *src == '\n') {
+            dst[i++] = '\\';
+            dst[i++] = *src == '\n' ? 'n' : *src;
+        }
+        else {
+            dst[i++] = *src;
+        }
+    }
+    dst[i] = '\0';
+    return dst;
+}
+
+static void metrics_histogram(struct mbuf *buf, char const *name, char const *labels, metrics_histogram_t const *hist)
+{
+    char const *sep = *labels ? "," : "";
+    uint64_t count  = 0;
+    for (unsigned i = 0; i < METRICS_BUCKETS - 1; ++i) {
+        count += hist->buckets[i];
+        metrics_printf(buf, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep, metrics_bucket_us[i] * 1e-6, (unsigned long long)count);
+    }
+    metrics_printf(buf, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, (unsigned long long)hist->count);
+    char const *open  = *labels ? "{" : "";
+    char const *close = *labels ? "}" : "";
+    metrics_printf(buf, "%s_sum%s%s%s %.6f\n", name, open, labels, close, hist->sum_us * 1e-6);
+    metrics_printf(buf, "%s_count%s%s%s %llu\n", name, open, labels, close, (unsigned long long)hist->count);
+}
+
+static void stage_loss_labels(char *labels, size_t size, pipeline_loss_t const *loss)
+{
+    if (loss->output >= 0)
+        snprintf(labels, size, "stage=\"%s\",output=\"%d\",unit=\"%s\"", loss->stage, loss->output, loss->unit);
+    else
+        snprintf(labels, size, "stage=\"%s\",unit=\"%s\"", loss->stage, loss->unit);
+}
+
+// curl http://127.0.0.1:8433/metrics
+static void handle_metrics(struct mg_connection *nc, struct http_message *hm, struct http_server_context *ctx)
+{
+    r_cfg_t *cfg       = ctx->cfg;
+    metrics_t *metrics = cfg->metrics;
+    struct dm_state *demod = cfg->demod;
+    // summed over all SDR devices
+    unsigned overflows = sdr_get_overflows(cfg->dev);
+    uint64_t lost      = sdr_get_lost_samples(cfg->dev);
+    uint64_t dropped   = sdr_get_dropped_samples(cfg->dev);
+    for (size_t i = 0; i < cfg->sdr_inputs.len; ++i) {
+        sdr_input_t *input = cfg->sdr_inputs.elems[i];
+        overflows += sdr_get_overflows(input->dev);
+        lost += sdr_get_lost_samples(input->dev);
+        dropped += sdr_get_dropped_samples(input->dev);
+    }
+
+    struct mbuf buf;
+    mbuf_init(&buf, 16384);
+
+    metrics_header(&buf, "rtl433_buffers_total", "counter", "Sample buffers processed.");
+    metrics_printf(&buf, "rtl433_buffers_total %llu\n", (unsigned long long)metrics->buffers);
+    metrics_header(&buf, "rtl433_buffers_quiet_total", "counter", "Sample buffers with noise only, not searched for pulses.");
+    metrics_printf(&buf, "rtl433_buffers_quiet_total %llu\n", (unsigned long long)metrics->buffers_quiet);
+    metrics_header(&buf, "rtl433_buffers_dropped_total", "counter", "Sample buffers dropped by the SDR device.");
+    metrics_printf(&buf, "rtl433_buffers_dropped_total %u\n", overflows);
+    metrics_header(&buf, "rtl433_samples_dropped_total", "counter", "Samples dropped by the SDR device, where the stream has the time.");
+    metrics_printf(&buf, "rtl433_samples_dropped_total %llu\n", (unsigned long long)dropped);
+    metrics_header(&buf, "rtl433_samples_lost_total", "counter", "Samples lost because processing fell behind the acquisition thread.");
+    metrics_printf(&buf, "rtl433_samples_lost_total %llu\n", (unsigned long long)lost);
+    metrics_header(&buf, "rtl433_samples_total", "counter", "Samples processed.");
+    metrics_printf(&buf, "rtl433_samples_total %llu\n", (unsigned long long)metrics->samples);
+    metrics_header(&buf, "rtl433_samples_clipped_total", "counter", "Input samples at the full scale of the SDR.");
+    metrics_printf(&buf, "rtl433_samples_clipped_total %llu\n", (unsigned long long)metrics->samples_clipped);
+    metrics_header(&buf, "rtl433_samples_near_zero_total", "counter", "Input samples with next to no signal, the gain might be too low.");
+    metrics_printf(&buf, "rtl433_samples_near_zero_total %llu\n", (unsigned long long)metrics->samples_near_zero);
+    metrics_header(&buf, "rtl433_frames_total", "counter", "Frames (packages of pulses) detected.");
+    metrics_printf(&buf, "rtl433_frames_total{modulation=\"ook\"} %llu\n", (unsigned long long)metrics->frames_ook);
+    metrics_printf(&buf, "rtl433_frames_total{modulation=\"fsk\"} %llu\n", (unsigned long long)metrics->frames_fsk);
+    metrics_header(&buf, "rtl433_frames_events_total", "counter", "Frames that decoded to events.");
+    metrics_printf(&buf, "rtl433_frames_events_total %llu\n", (unsigned long long)metrics->frames_events);
+    if (cfg->demod->dedup_ms) {
+        metrics_header(&buf, "rtl433_frames_deduplicated_total", "counter", "Frames identical to a recent one, dropped or run only through its decoders with -Y dedup.");
+        metrics_printf(&buf, "rtl433_frames_deduplicated_total %llu\n", (unsigned long long)metrics->frames_dedup);
+    }
+    metrics_header(&buf, "rtl433_events_total", "counter", "Events and reports printed to the outputs.");
+    metrics_printf(&buf, "rtl433_events_total %llu\n", (unsigned long long)metrics->events);
+    if (cfg->output_filters.len)
+        metrics_header(&buf, "rtl433_output_filtered_total", "counter", "Events dropped by the filter options of an output.");
+    for (void **iter = cfg->output_filters.elems; iter && *iter; ++iter) {
+        metrics_printf(&buf, "rtl433_output_filtered_total{output=\"%u\"} %u\n", output_filter_index(*iter), output_filter_drops(*iter));
+    }
+    if (cfg->event_dedup.window_ms) {
+        metrics_header(&buf, "rtl433_events_duplicate_total", "counter", "Repeated events dropped with -Y eventdedup.");
+        metrics_printf(&buf, "rtl433_events_duplicate_total %llu\n", (unsigned long long)cfg->event_dedup.suppressed_total);
+    }
+    if (cfg->event_fusion) {
+        metrics_header(&buf, "rtl433_events_fused_total", "counter", "Events of further receivers fused with -Y fusion.");
+        metrics_printf(&buf, "rtl433_events_fused_total %llu\n", (unsigned long long)event_fusion_fused_total(cfg->event_fusion));
+    }
+
+    if (demod->samp_grab) {
+        metrics_header(&buf, "rtl433_grabs_total", "counter", "Signals grabbed with -S, written or queued.");
+        metrics_printf(&buf, "rtl433_grabs_total %u\n", demod->samp_grab->grabs);
+        metrics_header(&buf, "rtl433_grabs_dropped_total", "counter", "Signals not grabbed because the write queue was full.");
+        metrics_printf(&buf, "rtl433_grabs_dropped_total %u\n", demod->samp_grab->drops);
+        metrics_header(&buf, "rtl433_grab_queue_depth", "gauge", "Grabbed signals waiting to be written.");
+        metrics_printf(&buf, "rtl433_grab_queue_depth %u\n", samp_grab_queue_depth(demod->samp_grab));
+    }
+
+    if (demod->sample_dump) {
+        metrics_header(&buf, "rtl433_dump_buffers_total", "counter", "Sample buffers of the -w dumpers, written or queued.");
+        metrics_printf(&buf, "rtl433_dump_buffers_total %u\n", demod->sample_dump->buffers);
+        metrics_header(&buf, "rtl433_dump_stalls_total", "counter", "Sample buffers of a file input that waited for the dump writer.");
+        metrics_printf(&buf, "rtl433_dump_stalls_total %u\n", demod->sample_dump->stalls);
+        metrics_header(&buf, "rtl433_dump_dropped_total", "counter", "Sample buffers of a live input not dumped because the write queue was full.");
+        metrics_printf(&buf, "rtl433_dump_dropped_total %u\n", demod->sample_dump->drops);
+        metrics_header(&buf, "rtl433_dump_queue_depth", "gauge", "Sample buffers waiting to be written by the dump writer.");
+        metrics_printf(&buf, "rtl433_dump_queue_depth %u\n", sample_dump_queue_depth(demod->sample_dump));
+    }
+
+    if (cfg->load_shed) {
+        load_shed_t const *shed = cfg->load_shed;
+        unsigned decoder_runs   = 0;
+        for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+            r_device *r_dev = *iter;
+            decoder_runs += r_dev->prior.shed + r_dev->stats.shed;
+        }
+        metrics_header(&buf, "rtl433_shed_level", "gauge", "Load shedding level, 0 for normal processing, see -Y shed.");
+        metrics_printf(&buf, "rtl433_shed_level %d\n", shed->level);
+        metrics_header(&buf, "rtl433_shed_load", "gauge", "Processing time over sample time of the last load window.");
+        metrics_printf(&buf, "rtl433_shed_load %.3f\n", shed->load);
+        metrics_header(&buf, "rtl433_shed_buffers_total", "counter", "Buffers processed at each load shedding level.");
+        for (int i = 0; i < LOAD_SHED_LEVELS; ++i)
+            metrics_printf(&buf, "rtl433_shed_buffers_total{level=\"%d\"} %llu\n", i, (unsigned long long)shed->buffers[i]);
+        metrics_header(&buf, "rtl433_shed_skipped_total", "counter", "Work skipped to shed load: decoder runs, FM demodulations, and analyzed or dumped buffers.");
+        metrics_printf(&buf, "rtl433_shed_skipped_total{work=\"decoders\"} %u\n", decoder_runs);
+        metrics_printf(&buf, "rtl433_shed_skipped_total{work=\"fm\"} %llu\n", (unsigned long long)shed->fm_skipped);
+        metrics_printf(&buf, "rtl433_shed_skipped_total{work=\"outputs\"} %llu\n", (unsigned long long)shed->outputs_skipped);
+    }
+
+    metrics_header(&buf, "rtl433_sample_rate_hz", "gauge", "Sample rate.");
+    metrics_printf(&buf, "rtl433_sample_rate_hz %u\n", cfg->samp_rate);
+    metrics_header(&buf, "rtl433_center_frequency_hz", "gauge", "Center frequency.");
+    metrics_printf(&buf, "rtl433_center_frequency_hz %u\n", cfg->center_frequency);
+    metrics_header(&buf, "rtl433_noise_level_db", "gauge", "Estimated noise level.");
+    metrics_printf(&buf, "rtl433_noise_level_db %.2f\n", demod->noise_level);
+    metrics_header(&buf, "rtl433_min_level_db", "gauge", "Minimum detection level.");
+    metrics_printf(&buf, "rtl433_min_level_db %.2f\n", demod->min_level_auto);
+    metrics_header(&buf, "rtl433_input_peak_dbfs", "gauge", "Peak of the last input buffer, in dB full scale.");
+    metrics_printf(&buf, "rtl433_input_peak_dbfs %.2f\n", metrics->input_peak_dbfs);
+    if (cfg->agc) {
+        metrics_header(&buf, "rtl433_agc_gain_db", "gauge", "Tuner gain set by -Y agc.");
+        metrics_printf(&buf, "rtl433_agc_gain_db %.1f\n", cfg->agc->gain);
+        metrics_header(&buf, "rtl433_agc_steps_total", "counter", "Tuner gain steps of -Y agc.");
+        metrics_printf(&buf, "rtl433_agc_steps_total{direction=\"up\"} %u\n", cfg->agc->steps_up);
+        metrics_printf(&buf, "rtl433_agc_steps_total{direction=\"down\"} %u\n", cfg->agc->steps_down);
+    }
+
+    static char const *const stage_names[METRICS_STAGES] = {"baseband", "pulse_detect", "decode", "output"};
+    metrics_header(&buf, "rtl433_stage_duration_seconds", "histogram", "Time spent in each stage per sample buffer, decoding excludes the outputs.");
+    for (unsigned i = 0; i < METRICS_STAGES; ++i) {
+        char labels[40];
+        snprintf(labels, sizeof(labels), "stage=\"%s\"", stage_names[i]);
+        metrics_histogram(&buf, "rtl433_stage_duration_seconds", labels, &metrics->stage[i]);
+    }
+    if (alloc_count_enabled()) {
+        metrics_header(&buf, "rtl433_stage_allocations_total", "counter", "Heap allocations in each stage, decoding excludes the outputs.");
+        for (unsigned i = 0; i < METRICS_STAGES; ++i)
+            metrics_printf(&buf, "rtl433_stage_allocations_total{stage=\"%s\"} %llu\n", stage_names[i], (unsigned long long)metrics->allocs[i].allocs);
+        metrics_header(&buf, "rtl433_stage_frees_total", "counter", "Heap frees in each stage, decoding excludes the outputs.");
+        for (unsigned i = 0; i < METRICS_STAGES; ++i)
+            metrics_printf(&buf, "rtl433_stage_frees_total{stage=\"%s\"} %llu\n", stage_names[i], (unsigned long long)metrics->allocs[i].frees);
+        metrics_header(&buf, "rtl433_idle_buffer_allocations_total", "counter", "Heap allocations of the sample buffers without events, 0 in the steady state.");
+        metrics_printf(&buf, "rtl433_idle_buffer_allocations_total %llu\n", (unsigned long long)metrics->idle_allocs);
+        metrics_header(&buf, "rtl433_idle_buffers_allocating_total", "counter", "Sample buffers without events that allocated.");
+        metrics_printf(&buf, "rtl433_idle_buffers_allocating_total %llu\n", (unsigned long long)metrics->idle_alloc_buffers);
+    }
+    metrics_header(&buf, "rtl433_buffer_duration_seconds", "histogram", "Time spent processing each sample buffer.");
+    metrics_histogram(&buf, "rtl433_buffer_duration_seconds", "", &metrics->buffer);
+    metrics_header(&buf, "rtl433_acquire_latency_seconds", "histogram", "Time sample buffers waited in the acquisition ring.");
+    metrics_histogram(&buf, "rtl433_acquire_latency_seconds", "", &metrics->acquire_latency);
+    metrics_header(&buf, "rtl433_callback_interval_seconds", "histogram", "Time between the sample callbacks of the SDR.");
+    metrics_histogram(&buf, "rtl433_callback_interval_seconds", "", &metrics->callback_interval);
+    metrics_header(&buf, "rtl433_callback_duration_seconds", "histogram", "Time spent in each sample callback of the SDR, including the outputs.");
+    metrics_histogram(&buf, "rtl433_callback_duration_seconds", "", &metrics->callback_duration);
+    if (cfg->watchdog) {
+        metrics_header(&buf, "rtl433_watchdog_stalls_total", "counter", "Stalls of the sample callback, each resets the SDR.");
+        metrics_printf(&buf, "rtl433_watchdog_stalls_total %u\n", watchdog_stalls(cfg->watchdog));
+        metrics_header(&buf, "rtl433_watchdog_near_stalls_total", "counter", "Sample callback intervals or durations above the near stall time.");
+        metrics_printf(&buf, "rtl433_watchdog_near_stalls_total %u\n", watchdog_near_stalls(cfg->watchdog));
+    }
+    metrics_header(&buf, "rtl433_event_latency_seconds", "histogram", "Time from the end of a package on air to its event given to the outputs.");
+    metrics_histogram(&buf, "rtl433_event_latency_seconds", "", &metrics->event_latency);
+    metrics_header(&buf, "rtl433_event_latency_quantile_seconds", "gauge", "Percentiles of the event latency, estimated from the histogram.");
+    static double const quantiles[] = {0.5, 0.9, 0.99};
+    for (unsigned i = 0; i < sizeof(quantiles) / sizeof(*quantiles); ++i) {
+        metrics_printf(&buf, "rtl433_event_latency_quantile_seconds{quantile=\"%g\"} %.6f\n", quantiles[i], metrics_percentile(&metrics->event_latency, quantiles[i]) * 1e-6);
+    }
+    metrics_header(&buf, "rtl433_urgent_event_latency_seconds", "histogram", "Event latency of the alarms, output ahead of the other events.");
+    metrics_histogram(&buf, "rtl433_urgent_event_latency_seconds", "", &metrics->urgent_latency);
+
+    int queues = 0;
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) {
+        data_output_t *output = cfg->output_handler.elems[i];
+        if (!data_output_queue_check(output))
+            continue;
+        if (!queues++) {
+            metrics_header(&buf, "rtl433_output_queue_depth", "gauge", "Events waiting in an output queue.");
+            metrics_header(&buf, "rtl433_output_queue_dropped_total", "counter", "Events dropped by an output queue.");
+        }
+        metrics_printf(&buf, "rtl433_output_queue_depth{output=\"%u\"} %u\n", (unsigned)i, data_output_queue_depth(output));
+        metrics_printf(&buf, "rtl433_output_queue_dropped_total{output=\"%u\"} %u\n", (unsigned)i, data_output_queue_drops(output));
+    }
+
+    // the drops of each stage since the start, a stage without drops is lossless
+    unsigned loss_size    = PIPELINE_LOSS_STAGES + (unsigned)cfg->output_handler.len;
+    pipeline_loss_t *loss = calloc(loss_size, sizeof(*loss));
+    if (!loss)
+        WARN_CALLOC("handle_metrics()"); // NOTE: skip the losses on alloc failure.
+    unsigned loss_num = loss ? get_pipeline_loss(cfg, loss, loss_size) : 0;
+    metrics_header(&buf, "rtl433_stage_dropped_total", "counter", "Items dropped at a queue of the pipeline: acquisition, grabber, dumpers, retry, and each output.");
+    for (unsigned i = 0; i < loss_num; ++i) {
+        char labels[80];
+        stage_loss_labels(labels, sizeof(labels), &loss[i]);
+        metrics_printf(&buf, "rtl433_stage_dropped_total{%s} %llu\n", labels, (unsigned long long)loss[i].dropped);
+    }
+    metrics_header(&buf, "rtl433_stage_lossless", "gauge", "1 if a stage of the pipeline did not drop anything yet.");
+    for (unsigned i = 0; i < loss_num; ++i) {
+        char labels[80];
+        stage_loss_labels(labels, sizeof(labels), &loss[i]);
+        metrics_printf(&buf, "rtl433_stage_lossless{%s} %d\n", labels, loss[i].dropped == 0);
+    }
+    free(loss);
+
+    // the bytes of each subsystem, to attribute the growth of the process
+    unsigned mem_size   = MEMORY_SUBSYSTEMS + 2 * (unsigned)cfg->output_handler.len;
+    memory_usage_t *mem = calloc(mem_size, sizeof(*mem));
+    if (!mem)
+        WARN_CALLOC("handle_metrics()"); // NOTE: skip the memory on alloc failure.
+    unsigned mem_num = mem ? get_memory_usage(cfg, mem, mem_size) : 0;
+    metrics_header(&buf, "rtl433_memory_bytes", "gauge", "Bytes held by each subsystem: buffers, pulses, decoders, pools, each output and output queue, and the live heap if counted.");
+    for (unsigned i = 0; i < mem_num; ++i) {
+        if (mem[i].output >= 0)
+            metrics_printf(&buf, "rtl433_memory_bytes{subsystem=\"%s\",output=\"%d\"} %llu\n", mem[i].subsystem, mem[i].output, (unsigned long long)mem[i].bytes);
+        else
+            metrics_printf(&buf, "rtl433_memory_bytes{subsystem=\"%s\"} %llu\n", mem[i].subsystem, (unsigned long long)mem[i].bytes);
+    }
+    free(mem);
+
+    // decoders that ran at least once, the counters are the sum over all stats intervals
+    static char const *const fail_names[6] = {"other", "abort_length", "abort_early", "fail_mic", "fail_sanity", "fail_budget"};
+    metrics_header(&buf, "rtl433_decoder_runs_total", "counter", "Decoder runs.");
+    metrics_header(&buf, "rtl433_decoder_ok_total", "counter", "Decoder runs with events.");
+    metrics_header(&buf, "rtl433_decoder_messages_total", "counter", "Events from a decoder.");
+    metrics_header(&buf, "rtl433_decoder_fails_total", "counter", "Decoder runs without events, by reason.");
+    metrics_header(&buf, "rtl433_decoder_truncated_total", "counter", "Packages cut short of the length they announce.");
+    if (cfg->report_profile) {
+        metrics_header(&buf, "rtl433_decoder_slicer_seconds_total", "counter", "Time spent slicing for a decoder.");
+        metrics_header(&buf, "rtl433_decoder_decode_seconds_total", "counter", "Time spent in a decoder.");
+    }
+    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        unsigned runs   = r_dev->prior.events + r_dev->stats.events;
+        if (!runs)
+            continue;
+        char name[256];
+        char labels[300];
+        snprintf(labels, sizeof(labels), "protocol=\"%u\",name=\"%s\"", r_dev->protocol_num, metrics_label(name, sizeof(name), r_dev->name));
+        metrics_printf(&buf, "rtl433_decoder_runs_total{%s} %u\n", labels, runs);
+        metrics_printf(&buf, "rtl433_decoder_ok_total{%s} %u\n", labels, r_dev->prior.ok + r_dev->stats.ok);
+        metrics_printf(&buf, "rtl433_decoder_messages_total{%s} %u\n", labels, r_dev->prior.messages + r_dev->stats.messages);
+        for (int i = 0; i < 6; ++i) {
+            unsigned fails = r_dev->prior.fails[i] + r_dev->stats.fails[i];
+            if (fails)
+                metrics_printf(&buf, "rtl433_decoder_fails_total{%s,reason=\"%s\"} %u\n", labels, fail_names[i], fails);
+        }
+        unsigned truncated = r_dev->prior.truncated + r_dev->stats.truncated;
+        if (truncated)
+            metrics_printf(&buf, "rtl433_decoder_truncated_total{%s} %u\n", labels, truncated);
+        if (r_dev->profile) {
+            metrics_printf(&buf, "rtl433_decoder_slicer_seconds_total{%s} %.6f\n", labels, (r_dev->prior.slicer_time + r_dev->stats.slicer_time) * 1e-6);
+            metrics_printf(&buf, "rtl433_decoder_decode_seconds_total{%s} %.6f\n", labels, (r_dev->prior.decode_time + r_dev->stats.decode_time) * 1e-6);
+        }
+    }
+
+    send_body(nc, hm,
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n", buf.buf, buf.len);
+    mbuf_free(&buf);
 }
 
 // {"cmd":"sample_rate","val":1024000}
 // http --stream --timeout=70 :8433/events
 //s.a. https://developer.twitter.com/en/docs/tutorials/consuming-streaming-data.html
+// http :8433/events since==0 model==Acurite-Tower id==1234
 static void handle_json_events(struct mg_connection *nc, struct http_message *hm)
 {
-    UNUSED(hm);
-    /* Send headers */
-    mg_printf(nc, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+    struct nc_context *cctx = nc->user_data;
+    parse_filter(hm, &cctx->filter);
 
-    /* Mark connection */
-    struct nc_context *ctx = calloc(1, sizeof(*ctx));
-    if (!ctx) {
-        WARN_CALLOC("handle_json_events()");
+    /* Poll for events after a sequence number */
+    char since[24];
+    if (mg_get_http_var(&hm->query_string, "since", since, sizeof(since)) >= 0) {
+        handle_history_query(nc, hm, &cctx->server->history, strtoull(since, NULL, 10), &cctx->filter);
         return;
     }
-    ctx->is_chunked = 1;
-    nc->user_data   = ctx;
+
+    /* Send headers */
+    if (gzip_start(nc, hm, cctx, &cctx->chunk)) {
+        mg_printf(nc, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nContent-Encoding: gzip\r\nVary: Accept-Encoding\r\n\r\n");
+    }
+    else {
+        mg_printf(nc, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
+    }
+
+    /* Mark connection */
+    cctx->kind = NC_EVENTS;
 
     mg_set_timer(nc, mg_time() + KEEP_ALIVE); // set keep alive timer
 }
@@ -860,20 +1714,107 @@ static void handle_json_events(struct mg_connection *nc, struct http_message *hm
 // (echo "GET /stream HTTP/1.0\n"; sleep 600) | socat - tcp:127.0.0.1:8433
 static void handle_json_stream(struct mg_connection *nc, struct http_message *hm)
 {
-    UNUSED(hm);
+    struct nc_context *cctx = nc->user_data;
+    parse_filter(hm, &cctx->filter);
+
     /* Send headers */
-    mg_printf(nc, "HTTP/1.1 200 OK\r\n\r\n");
+    struct mbuf head;
+    mbuf_init(&head, 0);
+    if (gzip_start(nc, hm, cctx, &head)) {
+        mg_printf(nc, "HTTP/1.1 200 OK\r\nContent-Encoding: gzip\r\nVary: Accept-Encoding\r\n\r\n");
+        mg_send(nc, head.buf, head.len);
+    }
+    else {
+        mg_printf(nc, "HTTP/1.1 200 OK\r\n\r\n");
+    }
+    mbuf_free(&head);
 
     /* Mark connection */
-    struct nc_context *ctx = calloc(1, sizeof(*ctx));
-    if (!ctx) {
-        WARN_CALLOC("handle_json_stream()");
+    cctx->kind = NC_STREAM;
+
+    mg_set_timer(nc, mg_time() + KEEP_ALIVE); // set keep alive timer
+}
+
+/// FNV-1a hash of a reply, the ETag of getters and the change check of the config.
+static uint64_t reply_hash(char const *buf, size_t len)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ (unsigned char)buf[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+/// Send the reply of an RPC request, with an ETag if cacheable, a matching If-None-Match gets 304.
+static void send_rpc_reply(struct mg_connection *nc, struct http_message *hm, struct mbuf const *reply, int cacheable)
+{
+    if (!cacheable) {
+        send_body(nc, hm,
+                "HTTP/1.1 200 OK\r\n"
+                "Content-Type: application/json\r\n", reply->buf, reply->len);
         return;
     }
-    ctx->is_chunked = 0;
-    nc->user_data   = ctx;
 
-    mg_set_timer(nc, mg_time() + KEEP_ALIVE); // set keep alive timer
+    // the gzip compressed reply is a different representation, with its own ETag
+    char etag[24];
+    int gz = reply->len >= GZIP_MIN_SIZE && accepts_gzip(nc, hm);
+    snprintf(etag, sizeof(etag), "\"%016llx%s\"", (unsigned long long)reply_hash(reply->buf, reply->len), gz ? "-gz" : "");
+    struct mg_str *match = mg_get_http_header(hm, "If-None-Match");
+    if (match && mg_vcmp(match, etag) == 0) {
+        mg_printf(nc,
+                "HTTP/1.1 304 Not Modified\r\n"
+                "ETag: %s\r\n"
+                "\r\n", etag);
+        return;
+    }
+    char head[100];
+    snprintf(head, sizeof(head),
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/json\r\n"
+            "ETag: %s\r\n", etag);
+    send_body(nc, hm, head, reply->buf, reply->len);
+}
+
+/// The settings the commands change, sent to the config subscribers.
+static char const *config_json(r_cfg_t *cfg, data_buf_t *buf)
+{
+    data_t *config = data_append(meta_data(cfg),
+            "gain", "", DATA_STRING, cfg->gain_str ? cfg->gain_str : "",
+            "ppm_error", "", DATA_INT, cfg->ppm_error,
+            "raw_mode", "", DATA_INT, cfg->raw_mode,
+            "verbosity", "", DATA_INT, cfg->verbosity,
+            "verbose_bits", "", DATA_INT, cfg->verbose_bits,
+            NULL);
+    data_t *data = data_make(
+            "config", "", DATA_DATA, config,
+            NULL);
+    char const *json = data_print_jsons_buf(data, buf, NULL);
+    data_free(data);
+    return json;
+}
+
+static void ev_handler(struct mg_connection *nc, int ev, void *ev_data);
+
+/// Send the config to the subscribed websockets if a command changed it.
+static void http_config_notify(struct http_server_context *ctx)
+{
+    if (!ctx->config_subscribers)
+        return;
+
+    data_buf_t buf   = {0};
+    char const *json = config_json(ctx->cfg, &buf);
+    size_t len       = json ? strlen(json) : 0;
+    uint64_t hash    = reply_hash(json, len);
+    if (json && hash != ctx->config_hash) {
+        ctx->config_hash = hash;
+        struct mg_mgr *mgr = ctx->conn->mgr;
+        for (struct mg_connection *nc = mg_next(mgr, NULL); nc != NULL; nc = mg_next(mgr, nc)) {
+            struct nc_context *cctx = nc->handler == ev_handler && nc->listener ? nc->user_data : NULL;
+            if (cctx && cctx->config_subscribed && !(nc->flags & MG_F_CLOSE_IMMEDIATELY))
+                mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, json, len);
+        }
+    }
+    data_buf_free(&buf);
 }
 
 // Handles GET with query string and POST with form-encoded body
@@ -883,20 +1824,21 @@ static void handle_json_stream(struct mg_connection *nc, struct http_message *hm
 // http --form POST :8433/cmd cmd=report_meta arg=level val=1
 static void handle_cmd_rpc(struct mg_connection *nc, struct http_message *hm)
 {
-    struct http_server_context *ctx = nc->user_data;
+    struct nc_context *cctx = nc->user_data;
     char cmd[100], arg[100], val[100];
+    struct mbuf reply;
+    mbuf_init(&reply, 0);
     rpc_t rpc = {
             .nc = nc,
+            .reply = &reply,
             .response = rpc_response_jsoncmd,
             .method = cmd,
             .arg = arg,
     };
 
-    /* Send headers */
-    mg_printf(nc, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
-
     /* Get URL variables */
-    if (mg_vcmp(&hm->method, "GET") == 0) {
+    int is_get = mg_vcmp(&hm->method, "GET") == 0;
+    if (is_get) {
         mg_get_http_var(&hm->query_string, "cmd", cmd, sizeof(cmd));
         mg_get_http_var(&hm->query_string, "arg", arg, sizeof(arg));
         mg_get_http_var(&hm->query_string, "val", val, sizeof(val));
@@ -911,31 +1853,34 @@ static void handle_cmd_rpc(struct mg_connection *nc, struct http_message *hm)
     rpc.val = strtol(val, &endptr, 10);
     fprintf(stderr, "POST Got %s, arg %s, val %s (%u)\n", cmd, arg, val, rpc.val);
 
-    rpc_exec(&rpc, ctx->cfg);
+    rpc_exec(&rpc, cctx->server->cfg);
+
+    send_rpc_reply(nc, hm, &reply, is_get && !strncmp(cmd, "get_", 4));
+    mbuf_free(&reply);
+    http_config_notify(cctx->server);
 }
 
-// Handles POST with JSONRPC command
-// http POST :8433/jsonrpc jsonrpc=2.0 method=sample_rate params:='[1024000]'
-static void handle_json_rpc(struct mg_connection *nc, struct http_message *hm)
-{
-    struct http_server_context *ctx = nc->user_data;
+#define JSONRPC_INVALID "{\"jsonrpc\": \"2.0\", \"error\": {\"code\": -32600, \"message\": \"Invalid Request\"}, \"id\": null}"
+
+/// Requests of a JSON-RPC batch, further requests get an error.
+#define JSONRPC_BATCH_MAX 64
 
+/// Run one JSON-RPC request, the response is appended to the reply.
+static void jsonrpc_call(struct mg_connection *nc, r_cfg_t *cfg, struct mbuf *reply, struct mg_str const *json)
+{
     rpc_t rpc = {
             .nc       = nc,
+            .reply    = reply,
             .response = rpc_response_jsonrpc,
     };
 
-    /* Send headers */
-    mg_printf(nc, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n");
-
     /* Parse JSON */
-    int ret = jsonrpc_parse(&rpc, &hm->body);
+    int ret = jsonrpc_parse(&rpc, json);
     if (!ret) {
-        rpc_exec(&rpc, ctx->cfg);
+        rpc_exec(&rpc, cfg);
     }
     else {
-        char *error = "{\"error\":\"Invalid command\"}";
-        mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, error, strlen(error));
+        mbuf_append(reply, JSONRPC_INVALID, sizeof(JSONRPC_INVALID) - 1);
     }
 
     free(rpc.method);
@@ -943,10 +1888,107 @@ static void handle_json_rpc(struct mg_connection *nc, struct http_message *hm)
     free(rpc.arg);
 }
 
+/// Run a JSON-RPC batch, the responses are appended to the reply as an array in request order.
+static void jsonrpc_batch(struct mg_connection *nc, r_cfg_t *cfg, struct mbuf *reply, struct mg_str const *json)
+{
+    jsmn_parser p;
+    jsmn_init(&p);
+    int r = jsmn_parse(&p, json->p, json->len, NULL, 0);
+    if (r < 1) {
+        mbuf_append(reply, JSONRPC_INVALID, sizeof(JSONRPC_INVALID) - 1);
+        return;
+    }
+    jsmntok_t *t = calloc((size_t)r, sizeof(*t));
+    if (!t) {
+        WARN_CALLOC("jsonrpc_batch()");
+        mbuf_append(reply, JSONRPC_INVALID, sizeof(JSONRPC_INVALID) - 1);
+        return;
+    }
+    jsmn_init(&p);
+    r = jsmn_parse(&p, json->p, json->len, t, (unsigned)r);
+    if (r < 1 || t[0].type != JSMN_ARRAY || t[0].size < 1) {
+        mbuf_append(reply, JSONRPC_INVALID, sizeof(JSONRPC_INVALID) - 1);
+        free(t);
+        return;
+    }
+
+    mbuf_append(reply, "[", 1);
+    int k = 1; // the token of the next request
+    for (int n = 0; n < t[0].size && k < r; ++n) {
+        if (n)
+            mbuf_append(reply, ", ", 2);
+        struct mg_str request = {json->p + t[k].start, (size_t)(t[k].end - t[k].start)};
+        if (t[k].type == JSMN_OBJECT && n < JSONRPC_BATCH_MAX)
+            jsonrpc_call(nc, cfg, reply, &request);
+        else
+            mbuf_append(reply, JSONRPC_INVALID, sizeof(JSONRPC_INVALID) - 1);
+        // skip the tokens of the request
+        int end = t[k].end;
+        for (++k; k < r && t[k].start < end; ++k) {
+        }
+    }
+    mbuf_append(reply, "]", 1);
+    free(t);
+}
+
+// Handles POST with JSONRPC command or batch
+// http POST :8433/jsonrpc jsonrpc=2.0 method=sample_rate params:='[1024000]'
+static void handle_json_rpc(struct mg_connection *nc, struct http_message *hm)
+{
+    struct nc_context *cctx = nc->user_data;
+    struct mbuf reply;
+    mbuf_init(&reply, 0);
+
+    struct mg_str body = hm->body;
+    while (body.len && (*body.p == ' ' || *body.p == '\t' || *body.p == '\r' || *body.p == '\n')) {
+        body.p++;
+        body.len--;
+    }
+    if (body.len && *body.p == '[')
+        jsonrpc_batch(nc, cctx->server->cfg, &reply, &body);
+    else
+        jsonrpc_call(nc, cctx->server->cfg, &reply, &body);
+
+    send_rpc_reply(nc, hm, &reply, 0);
+    mbuf_free(&reply);
+    http_config_notify(cctx->server);
+}
+
+/// Subscribe a websocket to the config changes, or end the subscription.
+static void ws_subscribe(struct mg_connection *nc, rpc_t *rpc, int subscribe)
+{
+    struct nc_context *cctx         = nc->user_data;
+    struct http_server_context *ctx = cctx->server;
+    if (!rpc->arg || strcmp(rpc->arg, "config")) {
+        rpc->response(rpc, -1, "Unknown subscription", 0);
+        return;
+    }
+    if (subscribe && !cctx->config_subscribed) {
+        cctx->config_subscribed = 1;
+        ctx->config_subscribers++;
+    }
+    else if (!subscribe && cctx->config_subscribed) {
+        cctx->config_subscribed = 0;
+        ctx->config_subscribers--;
+    }
+    rpc->response(rpc, 0, "Ok", 0);
+    if (!subscribe)
+        return;
+
+    // the current config, later changes are compared to it
+    data_buf_t buf   = {0};
+    char const *json = config_json(ctx->cfg, &buf);
+    if (json) {
+        ctx->config_hash = reply_hash(json, strlen(json));
+        mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, json, strlen(json));
+    }
+    data_buf_free(&buf);
+}
+
 // Handles WS with JSON command
 static void handle_ws_rpc(struct mg_connection *nc, struct websocket_message *wm)
 {
-    struct http_server_context *ctx = nc->user_data;
+    struct nc_context *cctx = nc->user_data;
 
     rpc_t rpc = {
             .nc       = nc,
@@ -954,11 +1996,23 @@ static void handle_ws_rpc(struct mg_connection *nc, struct websocket_message *wm
     };
 
     struct mg_str d = {(char *)wm->data, wm->size};
+#ifdef ZLIB
+    struct mbuf inflated;
+    mbuf_init(&inflated, 0);
+    if (cctx->ws_deflate && wm->flags & 0x40) { // RSV1, a compressed message
+        ws_inflate(cctx->server, wm->data, wm->size, &inflated);
+        d = mg_mk_str_n(inflated.buf, inflated.len);
+    }
+#endif
 
     /* Parse JSON */
-    int ret = json_parse(&rpc, &d);
-    if (!ret) {
-        rpc_exec(&rpc, ctx->cfg);
+    int ret = d.len ? json_parse(&rpc, &d) : -1;
+    if (!ret && (!strcmp(rpc.method, "subscribe") || !strcmp(rpc.method, "unsubscribe"))) {
+        ws_subscribe(nc, &rpc, !strcmp(rpc.method, "subscribe"));
+    }
+    else if (!ret) {
+        rpc_exec(&rpc, cctx->server->cfg);
+        http_config_notify(cctx->server);
     }
     else {
         char *error = "{\"error\":\"Invalid command\"}";
@@ -968,43 +2022,130 @@ static void handle_ws_rpc(struct mg_connection *nc, struct websocket_message *wm
     free(rpc.method);
     free(rpc.id);
     free(rpc.arg);
+#ifdef ZLIB
+    mbuf_free(&inflated);
+#endif
 }
 
-static void ev_handler(struct mg_connection *nc, int ev, void *ev_data);
-
-static void send_keep_alive(struct mg_connection *nc)
+/// Send the coalesced events of a chunked client as one chunk.
+static void send_chunk(struct mg_connection *nc, struct nc_context *cctx)
 {
-    if (nc->handler != ev_handler)
-        return; // this should not happen
-
-    struct nc_context *ctx = nc->user_data;
-    if (!ctx)
-        return; // this should not happen
+    if (cctx->chunk.len) {
+        mg_send_http_chunk(nc, cctx->chunk.buf, cctx->chunk.len);
+        mbuf_remove(&cctx->chunk, cctx->chunk.len);
+    }
+}
 
-    if (ctx->is_chunked) {
+static void send_keep_alive(struct mg_connection *nc, struct nc_context *cctx)
+{
+#ifdef ZLIB
+    if (cctx->gzip) {
+        // a CRLF would desync the shared stream, an empty block keeps the connection alive
+        mbuf_append(cctx->kind == NC_EVENTS ? &cctx->chunk : &nc->send_mbuf, empty_block, sizeof(empty_block));
+        send_chunk(nc, cctx);
+        mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
+        return;
+    }
+#endif
+    if (cctx->kind == NC_EVENTS) {
+        send_chunk(nc, cctx);
         mg_send_http_chunk(nc, "\r\n", 2);
     }
-    else {
+    else if (cctx->kind == NC_STREAM) {
         mg_send(nc, "\r\n", 2);
     }
     mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
 }
 
+static void client_accept(struct mg_connection *nc)
+{
+    struct nc_context *cctx = calloc(1, sizeof(*cctx));
+    if (!cctx) {
+        WARN_CALLOC("client_accept()");
+        nc->user_data = NULL;
+        nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+        return;
+    }
+    cctx->server  = nc->user_data; // inherited from the listening connection
+    cctx->kind    = NC_REQUEST;
+    mbuf_init(&cctx->chunk, 0);
+    nc->user_data = cctx;
+}
+
+static void client_close(struct mg_connection *nc, struct nc_context *cctx)
+{
+    if (cctx->dropped || cctx->evicted) {
+        char addr[64];
+        mg_sock_addr_to_str(&nc->sa, addr, sizeof(addr), MG_SOCK_STRINGIFY_IP | MG_SOCK_STRINGIFY_PORT);
+        fprintf(stderr, "HTTP client %s %s, %u events sent, %u dropped\n", addr,
+                cctx->evicted ? "evicted" : "closed", cctx->sent, cctx->dropped);
+    }
+    if (cctx->config_subscribed && cctx->server)
+        cctx->server->config_subscribers--;
+    mbuf_free(&cctx->chunk);
+    free(cctx);
+    nc->user_data = NULL;
+}
+
 static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
 {
+    if (!nc->listener)
+        return; // the listening connection
+    if (ev == MG_EV_ACCEPT) {
+        client_accept(nc);
+        return;
+    }
+    struct nc_context *cctx = nc->user_data;
+    if (!cctx)
+        return; // failed to accept
+    if (ev == MG_EV_CLOSE) {
+        //fprintf(stderr, "MG_EV_CLOSE %p %p %p\n", ev_data, nc, nc->user_data);
+        client_close(nc, cctx);
+        return;
+    }
+    if (!cctx->server)
+        return; // the server is stopped
+
+    // the requests use the config, wait while a buffer is decoded
+    net_thread_t *net = cctx->server->cfg->net_thread;
+    int uses_cfg      = ev == MG_EV_HTTP_REQUEST || ev == MG_EV_WEBSOCKET_FRAME || ev == MG_EV_WEBSOCKET_HANDSHAKE_DONE;
+    if (uses_cfg)
+        net_thread_lock(net);
+
     switch (ev) {
+    case MG_EV_POLL:
+        send_chunk(nc, cctx);
+        break;
     case MG_EV_TIMER:
-        send_keep_alive(nc);
+        send_keep_alive(nc, cctx);
+        break;
+#ifdef ZLIB
+    case MG_EV_WEBSOCKET_HANDSHAKE_REQUEST: {
+        struct http_message *hm = (struct http_message *)ev_data;
+        // the client messages are inflated without context
+        if (cctx->server->compress && offers_deflate(hm) && !shared_join(&cctx->server->ws)) {
+            cctx->ws_deflate = 1;
+            mg_send_websocket_handshake_reply(nc, hm,
+                    "Sec-WebSocket-Extensions: permessage-deflate; client_no_context_takeover\r\n");
+        }
         break;
+    }
+#endif
     case MG_EV_WEBSOCKET_HANDSHAKE_DONE: {
-        struct http_server_context *ctx = nc->user_data;
+        struct http_server_context *ctx = cctx->server;
         /* New websocket connection. Send meta. */
         data_t *meta = meta_data(ctx->cfg);
         data_output_print(ctx->output, meta);
         data_free(meta);
         /* Send history */
-        for (void **iter = ring_list_iter(ctx->history); iter; iter = ring_list_next(ctx->history, iter))
-            mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, (char *)*iter, strlen((char *)*iter));
+        for (uint64_t pos = ctx->history.head; pos != ctx->history.tail;) {
+            history_record_t rec;
+            history_copy_out(&ctx->history, pos, &rec, sizeof(rec));
+            struct mg_str slice[2];
+            int num_slices = history_slices(&ctx->history, pos, &rec, slice);
+            mg_send_websocket_framev(nc, WEBSOCKET_OP_TEXT, slice, num_slices);
+            pos += history_record_size(&rec);
+        }
         break;
     }
     case MG_EV_WEBSOCKET_FRAME: {
@@ -1038,23 +2179,25 @@ static void ev_handler(struct mg_connection *nc, int ev, void *ev_data)
         else if (mg_vcmp(&hm->uri, "/stream") == 0) {
             handle_json_stream(nc, hm);
         }
+        else if (mg_vcmp(&hm->uri, "/metrics") == 0) {
+            handle_metrics(nc, hm, cctx->server);
+        }
         else if (mg_vcmp(&hm->uri, "/api") == 0) {
             //handle_api_query(nc, hm);
         }
 #ifdef SERVE_STATIC
         else {
-            struct http_server_context *ctx = nc->user_data;
-            mg_serve_http(nc, hm, ctx->server_opts); /* Serve static content */
+            mg_serve_http(nc, hm, cctx->server->server_opts); /* Serve static content */
         }
 #endif
         break;
     }
-    case MG_EV_CLOSE:
-        //fprintf(stderr, "MG_EV_CLOSE %p %p %p\n", ev_data, nc, nc->user_data);
-        break;
     default:
         break;
     }
+
+    if (uses_cfg)
+        net_thread_unlock(net);
 }
 
 static int is_websocket(const struct mg_connection *nc)
@@ -1063,33 +2206,75 @@ static int is_websocket(const struct mg_connection *nc)
 }
 
 // event handler to broadcast to all our sockets
-static void http_broadcast_send(struct http_server_context *ctx, char const *msg, size_t len)
+static void http_broadcast_send(struct http_server_context *ctx, char const *msg, size_t len, char const *model, char const *id)
 {
     struct mg_connection *nc;
     struct mg_mgr *mgr = ctx->conn->mgr;
+#ifdef ZLIB
+    ctx->ws.state = 0;
+    ctx->gz.state = 0;
+    uint32_t crc  = ctx->compress ? (uint32_t)crc32(0L, (Bytef const *)msg, (uInt)len) : 0;
+#endif
 
-    char *dup = strdup(msg);
-    if (!dup) {
-        WARN_STRDUP("http_broadcast_send()");
-    }
-    else {
-        free(ring_list_push(ctx->history, dup));
-    }
+    history_push(&ctx->history, msg, len, model, id);
 
     for (nc = mg_next(mgr, NULL); nc != NULL; nc = mg_next(mgr, nc)) {
-        if (nc->handler != ev_handler)
+        if (nc->handler != ev_handler || !nc->listener)
+            continue;
+
+        struct nc_context *cctx = nc->user_data;
+        if (!cctx || (cctx->kind == NC_REQUEST && !is_websocket(nc)) || nc->flags & MG_F_CLOSE_IMMEDIATELY)
+            continue; // not subscribed or closing
+        if (!filter_match(&cctx->filter, model, id))
+            continue;
+
+        // the send queue of a stalled client only grows, cap it
+        if (nc->send_mbuf.len + cctx->chunk.len + len > ctx->queue_limit) {
+            cctx->dropped++;
+            ctx->dropped++;
+            if (ctx->evict || cctx->gzip || cctx->ws_deflate) { // the shared stream can not skip an event
+                cctx->evicted = 1;
+                nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+            }
             continue;
+        }
+        cctx->sent++;
 
-        struct nc_context *cctx = nc->user_data; // might not be valid
+#ifdef ZLIB
+        if (cctx->ws_deflate) {
+            if (shared_event(&ctx->ws, msg, len, 0) == 0) {
+                // the trailing empty block of the sync flush is implied
+                mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT | WEBSOCKET_RSV1, ctx->ws.out.buf, ctx->ws.out.len - sizeof(empty_block));
+            }
+            else {
+                cctx->evicted = 1; // the shared stream is broken
+                nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+            }
+            continue;
+        }
+        if (cctx->gzip) {
+            struct mbuf *out = cctx->kind == NC_EVENTS ? &cctx->chunk : &nc->send_mbuf;
+            if (shared_event(&ctx->gz, msg, len, 1) == 0) {
+                gzip_event(ctx, cctx, out, crc, len);
+                mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
+            }
+            else {
+                cctx->evicted = 1; // the shared stream is broken
+                nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+            }
+            continue;
+        }
+#endif
         if (is_websocket(nc)) {
             mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, msg, len);
         }
-        else if (cctx && cctx->is_chunked) {
-            mg_send_http_chunk(nc, msg, len);
-            mg_send_http_chunk(nc, "\r\n", 2);
+        else if (cctx->kind == NC_EVENTS) {
+            // coalesced into one chunk per poll
+            mbuf_append(&cctx->chunk, msg, len);
+            mbuf_append(&cctx->chunk, "\r\n", 2);
             mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
         }
-        else if (cctx && !cctx->is_chunked) {
+        else {
             mg_send(nc, msg, len);
             mg_send(nc, "\r\n", 2);
             mg_set_timer(nc, mg_time() + KEEP_ALIVE); // reset keep alive timer
@@ -1097,7 +2282,7 @@ static void http_broadcast_send(struct http_server_context *ctx, char const *msg
     }
 }
 
-static struct http_server_context *http_server_start(struct mg_mgr *mgr, char const *host, char const *port, r_cfg_t *cfg, struct data_output *output)
+static struct http_server_context *http_server_start(struct mg_mgr *mgr, char const *host, char const *port, r_cfg_t *cfg, struct data_output *output, size_t queue_limit, int evict, size_t history_size, int compress)
 {
     struct mg_bind_opts bind_opts;
     const char *err_str;
@@ -1109,9 +2294,16 @@ static struct http_server_context *http_server_start(struct mg_mgr *mgr, char co
         return NULL;
     }
 
-    ctx->cfg     = cfg;
-    ctx->output  = output;
-    ctx->history = ring_list_new(DEFAULT_HISTORY_SIZE);
+    ctx->cfg         = cfg;
+    ctx->output      = output;
+    history_init(&ctx->history, history_size ? history_size : DEFAULT_HISTORY_SIZE);
+    ctx->queue_limit = queue_limit ? queue_limit : DEFAULT_QUEUE_LIMIT;
+    ctx->evict       = evict;
+#ifdef ZLIB
+    ctx->compress = compress && !compress_init(ctx);
+#else
+    UNUSED(compress);
+#endif
 
     char address[253 + 6 + 1]; // dns max + port
     // if the host is an IPv6 address it needs quoting
@@ -1129,6 +2321,11 @@ static struct http_server_context *http_server_start(struct mg_mgr *mgr, char co
     if (ctx->conn == NULL) {
         fprintf(stderr, "Error starting server on address %s: %s\n", address,
                 *bind_opts.error_string);
+#ifdef ZLIB
+        if (ctx->compress)
+            compress_free(ctx);
+#endif
+        history_free(&ctx->history);
         free(ctx);
         return NULL;
     }
@@ -1156,28 +2353,52 @@ static int http_server_stop(struct http_server_context *ctx)
 
     // close connections with a goodbye
     struct mg_mgr *mgr = ctx->conn->mgr;
+#ifdef ZLIB
+    ctx->gz.state = 0;
+    uint32_t crc  = ctx->compress ? (uint32_t)crc32(0L, (Bytef const *)SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1) : 0;
+#endif
     for (struct mg_connection *nc = mg_next(mgr, NULL); nc != NULL; nc = mg_next(mgr, nc)) {
-        if (nc->handler != ev_handler)
+        if (nc->handler != ev_handler || !nc->listener)
             continue;
 
-        struct nc_context *cctx = nc->user_data; // might not be valid
+        struct nc_context *cctx = nc->user_data;
+        if (!cctx)
+            continue;
+        cctx->server = NULL;
+#ifdef ZLIB
+        if (cctx->gzip) {
+            // end the gzip stream, the goodbye is not sent if it can not be deflated
+            struct mbuf *out = cctx->kind == NC_EVENTS ? &cctx->chunk : &nc->send_mbuf;
+            if (shared_event(&ctx->gz, SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1, 1) == 0)
+                gzip_event(ctx, cctx, out, crc, sizeof(SHUTDOWN_JSON) - 1);
+            gzip_trailer(out, cctx->gzip_crc, cctx->gzip_len);
+            if (cctx->kind == NC_EVENTS) {
+                send_chunk(nc, cctx);
+                mg_send_http_chunk(nc, "", 0); /* Send empty chunk, the end of response */
+            }
+            continue;
+        }
+#endif
         if (is_websocket(nc)) {
             mg_send_websocket_frame(nc, WEBSOCKET_OP_TEXT, SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1);
         }
-        else if (cctx && cctx->is_chunked) {
-            mg_send_http_chunk(nc, SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1);
-            mg_send_http_chunk(nc, "\r\n", 2);
+        else if (cctx->kind == NC_EVENTS) {
+            send_chunk(nc, cctx);
+            mg_send_http_chunk(nc, SHUTDOWN_JSON "\r\n", sizeof(SHUTDOWN_JSON) + 1);
             mg_send_http_chunk(nc, "", 0);            /* Send empty chunk, the end of response */
         }
-        else if (cctx && !cctx->is_chunked) {
+        else if (cctx->kind == NC_STREAM) {
             mg_send(nc, SHUTDOWN_JSON, sizeof(SHUTDOWN_JSON) - 1);
             mg_send(nc, "\r\n", 2);
         }
     }
 
-    for (void **iter = ring_list_iter(ctx->history); iter; iter = ring_list_next(ctx->history, iter))
-        free((data_t *)*iter);
-    ring_list_free(ctx->history);
+    history_free(&ctx->history);
+#ifdef ZLIB
+    if (ctx->compress)
+        compress_free(ctx);
+#endif
+    free(ctx);
 
     return 0;
 }
@@ -1187,6 +2408,7 @@ static int http_server_stop(struct http_server_context *ctx)
 typedef struct {
     struct data_output output;
     struct http_server_context *server;
+    data_buf_t buf; ///< serialization buffer, grows to the largest event
 } data_output_http_t;
 
 static void R_API_CALLCONV print_http_data(data_output_t *output, data_t *data, char const *format)
@@ -1196,29 +2418,57 @@ static void R_API_CALLCONV print_http_data(data_output_t *output, data_t *data,
 
     // collect well-known top level keys
     data_t *data_model = NULL;
+    data_t *data_id    = NULL;
     for (data_t *d = data; d; d = d->next) {
         if (!strcmp(d->key, "model"))
             data_model = d;
+        else if (!strcmp(d->key, "id"))
+            data_id = d;
     }
 
-    if (data_model) {
-        // "events"
-        char buf[2048]; // we expect the biggest strings to be around 500 bytes.
-        size_t len = data_print_jsons(data, buf, sizeof(buf));
-        http_broadcast_send(http->server, buf, len);
+    // the keys for history queries and stream filters
+    char const *model = data_model && data_model->type == DATA_STRING ? data_model->value.v_ptr : NULL;
+    char id_buf[24];
+    char const *id = NULL;
+    if (data_id && data_id->type == DATA_STRING) {
+        id = data_id->value.v_ptr;
     }
-    else {
-        // "states"
-        size_t buf_size = 20000; // state message need a large buffer
-        char *buf       = malloc(buf_size);
-        if (!buf) {
-            WARN_MALLOC("print_http_data()");
-            return; // NOTE: skip output on alloc failure.
-        }
-        size_t len = data_print_jsons(data, buf, buf_size);
-        http_broadcast_send(http->server, buf, len);
-        free(buf);
+    else if (data_id && data_id->type == DATA_INT) {
+        snprintf(id_buf, sizeof(id_buf), "%d", data_id->value.v_int);
+        id = id_buf;
+    }
+
+    size_t len;
+    char const *json = data_print_jsons_buf(data, &http->buf, &len);
+    if (!json)
+        return; // NOTE: skip output on alloc failure.
+    http_broadcast_send(http->server, json, len, model, id);
+    if (!model)
+        http_config_notify(http->server); // e.g. the SDR applied a setting of a command
+}
+
+static unsigned R_API_CALLCONV data_output_http_drops(data_output_t *output)
+{
+    data_output_http_t *http = (data_output_http_t *)output;
+
+    return http->server->dropped;
+}
+
+/// The bytes of the history ring, the clients queues, and the serialization buffer.
+static size_t R_API_CALLCONV data_output_http_memory(data_output_t *output)
+{
+    data_output_http_t *http           = (data_output_http_t *)output;
+    struct http_server_context *server = http->server;
+
+    size_t bytes = sizeof(*http) + http->buf.size + sizeof(*server) + server->history.size;
+    struct mg_mgr *mgr = server->conn->mgr;
+    for (struct mg_connection *nc = mg_next(mgr, NULL); nc != NULL; nc = mg_next(mgr, nc)) {
+        struct nc_context *cctx = nc->user_data;
+        if (nc->handler != ev_handler || !nc->listener || !cctx || cctx->server != server)
+            continue;
+        bytes += sizeof(*cctx) + cctx->chunk.size + nc->send_mbuf.size + nc->recv_mbuf.size;
     }
+    return bytes;
 }
 
 static void R_API_CALLCONV data_output_http_free(data_output_t *output)
@@ -1230,10 +2480,11 @@ static void R_API_CALLCONV data_output_http_free(data_output_t *output)
 
     http_server_stop(http->server);
 
+    data_buf_free(&http->buf);
     free(http);
 }
 
-struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host, char const *port, r_cfg_t *cfg)
+struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host, char const *port, r_cfg_t *cfg, unsigned queue_limit, int evict, unsigned history_size, int compress)
 {
     data_output_http_t *http = calloc(1, sizeof(data_output_http_t));
     if (!http) {
@@ -1241,10 +2492,12 @@ struct data_output *data_output_http_create(struct mg_mgr *mgr, char const *host
         return NULL;
     }
 
-    http->output.print_data   = print_http_data;
-    http->output.output_free  = data_output_http_free;
+    http->output.print_data    = print_http_data;
+    http->output.output_drops  = data_output_http_drops;
+    http->output.output_memory = data_output_http_memory;
+    http->output.output_free   = data_output_http_free;
 
-    http->server = http_server_start(mgr, host, port, cfg, &http->output);
+    http->server = http_server_start(mgr, host, port, cfg, &http->output, queue_limit, evict, history_size, compress);
     if (!http->server) {
         exit(1);
     }
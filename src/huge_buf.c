@@ -0,0 +1,119 @@
+/** @file
+    Large sample buffers, backed by huge pages if enabled.
+
+    A buffer at full block size spans a thousand normal pages, with huge pages the
+    demodulation touches a few TLB entries only. Each buffer starts after a header
+    of a cache line that keeps the length of the mapping, 0 for a normal allocation.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "huge_buf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#ifdef MAP_ANONYMOUS
+#define HUGE_BUF_MAP
+#endif
+#endif
+
+#define HUGE_BUF_HEADER 64 // keeps the buffer aligned to a cache line
+
+static int huge_enabled;
+static size_t huge_page_size;
+
+size_t huge_buf_page_size(void)
+{
+#ifdef HUGE_BUF_MAP
+    size_t size = 0;
+    FILE *file  = fopen("/proc/meminfo", "r");
+    if (file) {
+        char line[128];
+        unsigned long kb;
+        while (fgets(line, sizeof(line), file)) {
+            if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+                size = kb * 1024;
+                break;
+            }
+        }
+        fclose(file);
+    }
+    return size ? size : 2 * 1024 * 1024; // THP uses the PMD size, 2 MB on most platforms
+#else
+    return 0;
+#endif
+}
+
+void huge_buf_enable(int enable)
+{
+    huge_page_size = enable ? huge_buf_page_size() : 0;
+    huge_enabled   = enable && huge_page_size;
+    if (enable && !huge_enabled)
+        fprintf(stderr, "huge_buf: not supported, no huge pages on this platform\n");
+}
+
+int huge_buf_enabled(void)
+{
+    return huge_enabled;
+}
+
+#ifdef HUGE_BUF_MAP
+/// Map huge pages, or normal pages with the transparent huge pages hint.
+static char *huge_map(size_t len)
+{
+    void *map;
+#ifdef MAP_HUGETLB
+    map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (map != MAP_FAILED)
+        return map;
+#endif
+    map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    madvise(map, len, MADV_HUGEPAGE); // only a hint, THP might be disabled
+#endif
+    return map;
+}
+#endif
+
+void *huge_buf_create(size_t size)
+{
+    char *base = NULL;
+    size_t len = 0;
+#ifdef HUGE_BUF_MAP
+    if (huge_enabled) {
+        len  = (size + HUGE_BUF_HEADER + huge_page_size - 1) / huge_page_size * huge_page_size;
+        base = huge_map(len);
+    }
+#endif
+    if (!base) {
+        len  = 0;
+        base = calloc(1, size + HUGE_BUF_HEADER);
+        if (!base)
+            return NULL;
+    }
+    *(size_t *)base = len;
+    return base + HUGE_BUF_HEADER;
+}
+
+void huge_buf_free(void *buf)
+{
+    if (!buf)
+        return;
+    char *base = (char *)buf - HUGE_BUF_HEADER;
+#ifdef HUGE_BUF_MAP
+    size_t len = *(size_t *)base;
+    if (len) {
+        munmap(base, len);
+        return;
+    }
+#endif
+    free(base);
+}
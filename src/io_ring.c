@@ -0,0 +1,315 @@
+/** @file
+    Queued file I/O with io_uring on Linux, a thin wrapper of the system calls.
+
+    The requests are queued in the submission ring and submitted with one system
+    call when waiting for a completion, the completions are read from the shared
+    completion ring. The tail of the submission ring is published on submit, the
+    last queued request can still be unlinked. A ring is used by one thread only.
+
+    Without io_uring support (not Linux, or the headers are missing) a ring can
+    not be created and the callers use stdio.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "io_ring.h"
+
+#include <stdio.h>
+
+static io_ring_mode_t ring_mode;
+
+void io_ring_set_mode(io_ring_mode_t mode)
+{
+    ring_mode = mode;
+#ifndef IO_URING
+    if (mode != IO_RING_OFF)
+        fprintf(stderr, "io_ring: not supported, this build has no io_uring support\n");
+#endif
+}
+
+io_ring_mode_t io_ring_get_mode(void)
+{
+    return ring_mode;
+}
+
+#ifdef IO_URING
+
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/// The features needed: reads at the file position, no dropped completions, and stable submissions.
+#define IO_RING_FEATURES (IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_SUBMIT_STABLE | IORING_FEAT_RW_CUR_POS)
+
+struct io_ring {
+    int fd;
+    unsigned depth;
+    unsigned queued;   ///< requests queued, not yet submitted
+    unsigned inflight; ///< requests submitted, not yet completed
+    void *ring_map;    ///< the submission and completion rings, one mapping
+    size_t ring_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned sq_local_tail; ///< the tail including the queued requests
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+};
+
+static int ring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int ring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+io_ring_t *io_ring_create(unsigned depth)
+{
+    if (ring_mode == IO_RING_OFF || !depth)
+        return NULL;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = ring_setup(depth, &p);
+    if (fd < 0)
+        return NULL; // e.g. ENOSYS on an old kernel or EPERM from a seccomp filter
+    if ((p.features & IO_RING_FEATURES) != IO_RING_FEATURES) {
+        close(fd);
+        return NULL;
+    }
+
+    io_ring_t *ring = calloc(1, sizeof(*ring));
+    if (!ring) {
+        WARN_CALLOC("io_ring_create()");
+        close(fd);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    ring->fd    = fd;
+    ring->depth = depth < p.sq_entries ? depth : p.sq_entries;
+
+    size_t sq_size  = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    size_t cq_size  = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->ring_map  = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->ring_map == MAP_FAILED) {
+        close(fd);
+        free(ring);
+        return NULL;
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes      = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        munmap(ring->ring_map, ring->ring_size);
+        close(fd);
+        free(ring);
+        return NULL;
+    }
+
+    char *map           = ring->ring_map;
+    ring->sq_tail       = (unsigned *)(map + p.sq_off.tail);
+    ring->sq_mask       = (unsigned *)(map + p.sq_off.ring_mask);
+    ring->sq_array      = (unsigned *)(map + p.sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head       = (unsigned *)(map + p.cq_off.head);
+    ring->cq_tail       = (unsigned *)(map + p.cq_off.tail);
+    ring->cq_mask       = (unsigned *)(map + p.cq_off.ring_mask);
+    ring->cqes          = (struct io_uring_cqe *)(map + p.cq_off.cqes);
+    return ring;
+}
+
+void io_ring_free(io_ring_t *ring)
+{
+    if (!ring)
+        return;
+    // the buffers of the requests in flight belong to the caller, wait for them
+    ring->queued = 0;
+    uint64_t user;
+    int res;
+    while (ring->inflight && !io_ring_wait(ring, &user, &res)) {
+    }
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->ring_map, ring->ring_size);
+    close(ring->fd);
+    free(ring);
+}
+
+int io_ring_register(io_ring_t *ring, void *buf, size_t len, unsigned count)
+{
+    struct iovec *iov = calloc(count, sizeof(*iov));
+    if (!iov) {
+        WARN_CALLOC("io_ring_register()");
+        return -1;
+    }
+    for (unsigned i = 0; i < count; ++i) {
+        iov[i].iov_base = (char *)buf + i * len;
+        iov[i].iov_len  = len;
+    }
+    int ret = (int)syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, iov, count);
+    free(iov);
+    return ret < 0 ? -1 : 0;
+}
+
+unsigned io_ring_space(io_ring_t const *ring)
+{
+    return ring->depth - ring->queued - ring->inflight;
+}
+
+unsigned io_ring_pending(io_ring_t const *ring)
+{
+    return ring->queued + ring->inflight;
+}
+
+static struct io_uring_sqe *ring_queue(io_ring_t *ring, int op, int fd, void const *buf, unsigned len, int64_t offset, uint64_t user)
+{
+    if (!io_ring_space(ring))
+        return NULL;
+    unsigned index           = ring->sq_local_tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = (uint8_t)op;
+    sqe->fd        = fd;
+    sqe->addr      = (uint64_t)(uintptr_t)buf;
+    sqe->len       = len;
+    sqe->off       = (uint64_t)offset;
+    sqe->user_data = user;
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    ring->queued++;
+    return sqe;
+}
+
+int io_ring_read(io_ring_t *ring, int fd, void *buf, unsigned len, int64_t offset, int buf_index, uint64_t user)
+{
+    struct io_uring_sqe *sqe = ring_queue(ring, buf_index < 0 ? IORING_OP_READ : IORING_OP_READ_FIXED, fd, buf, len, offset, user);
+    if (!sqe)
+        return -1;
+    if (buf_index >= 0)
+        sqe->buf_index = (uint16_t)buf_index;
+    return 0;
+}
+
+int io_ring_write(io_ring_t *ring, int fd, void const *buf, unsigned len, int64_t offset, int link, uint64_t user)
+{
+    struct io_uring_sqe *sqe = ring_queue(ring, IORING_OP_WRITE, fd, buf, len, offset, user);
+    if (!sqe)
+        return -1;
+    if (link)
+        sqe->flags |= IOSQE_IO_LINK;
+    return 0;
+}
+
+int io_ring_wait(io_ring_t *ring, uint64_t *user, int *res)
+{
+    if (ring->queued) {
+        // a link past the last queued request would join the next submission
+        ring->sqes[(ring->sq_local_tail - 1) & *ring->sq_mask].flags &= (uint8_t)~IOSQE_IO_LINK;
+        __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    }
+    for (;;) {
+        unsigned head = *ring->cq_head;
+        if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            *user                    = cqe->user_data;
+            *res                     = cqe->res;
+            __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+            ring->inflight--;
+            return 0;
+        }
+        if (!ring->queued && !ring->inflight)
+            return -1;
+        int ret = ring_enter(ring->fd, ring->queued, 1, IORING_ENTER_GETEVENTS);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret < 0) {
+            fprintf(stderr, "io_ring: %s\n", strerror(errno));
+            return -1;
+        }
+        ring->queued -= (unsigned)ret;
+        ring->inflight += (unsigned)ret;
+    }
+}
+
+#else
+
+io_ring_t *io_ring_create(unsigned depth)
+{
+    (void)depth;
+    return NULL;
+}
+
+void io_ring_free(io_ring_t *ring)
+{
+    (void)ring;
+}
+
+int io_ring_register(io_ring_t *ring, void *buf, size_t len, unsigned count)
+{
+    (void)ring;
+    (void)buf;
+    (void)len;
+    (void)count;
+    return -1;
+}
+
+unsigned io_ring_space(io_ring_t const *ring)
+{
+    (void)ring;
+    return 0;
+}
+
+unsigned io_ring_pending(io_ring_t const *ring)
+{
+    (void)ring;
+    return 0;
+}
+
+int io_ring_read(io_ring_t *ring, int fd, void *buf, unsigned len, int64_t offset, int buf_index, uint64_t user)
+{
+    (void)ring;
+    (void)fd;
+    (void)buf;
+    (void)len;
+    (void)offset;
+    (void)buf_index;
+    (void)user;
+    return -1;
+}
+
+int io_ring_write(io_ring_t *ring, int fd, void const *buf, unsigned len, int64_t offset, int link, uint64_t user)
+{
+    (void)ring;
+    (void)fd;
+    (void)buf;
+    (void)len;
+    (void)offset;
+    (void)link;
+    (void)user;
+    return -1;
+}
+
+int io_ring_wait(io_ring_t *ring, uint64_t *user, int *res)
+{
+    (void)ring;
+    (void)user;
+    (void)res;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,190 @@
+/** @file
+    Pool of refcounted IQ sample buffers, owned by the acquisition.
+
+    The acquisition fills a free buffer and hands it back after processing.
+    Consumers that need the samples later, e.g. the sample dump writer and the
+    rtl_tcp server, retain the buffer instead of copying it. A buffer is reused
+    once the acquisition handed it back and the last consumer released it.
+    The references are counted under the pool lock, a few per buffer.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "iq_pool.h"
+#include "huge_buf.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct iq_pool {
+    uint8_t *mem;          ///< the data of all buffers
+    iq_buf_t *bufs;
+    iq_buf_t **free_bufs;  ///< stack of the free buffers
+    unsigned num;
+    unsigned free_len;
+    unsigned spare;        ///< buffers the consumers may retain
+    unsigned retained;     ///< buffers retained by the consumers
+    int closed;            ///< freed by the owner, the last release frees the pool
+#ifdef THREADS
+    pthread_mutex_t lock;
+#endif
+};
+
+static void pool_lock(iq_pool_t *pool)
+{
+#ifdef THREADS
+    pthread_mutex_lock(&pool->lock);
+#else
+    (void)pool;
+#endif
+}
+
+static void pool_unlock(iq_pool_t *pool)
+{
+#ifdef THREADS
+    pthread_mutex_unlock(&pool->lock);
+#else
+    (void)pool;
+#endif
+}
+
+static void pool_destroy(iq_pool_t *pool)
+{
+#ifdef THREADS
+    pthread_mutex_destroy(&pool->lock);
+#endif
+    huge_buf_free(pool->mem);
+    free(pool->free_bufs);
+    free(pool->bufs);
+    free(pool);
+}
+
+iq_pool_t *iq_pool_create(unsigned num, size_t size, unsigned spare)
+{
+    iq_pool_t *pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        WARN_CALLOC("iq_pool_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    pool->bufs = calloc(num, sizeof(*pool->bufs));
+    if (!pool->bufs) {
+        WARN_CALLOC("iq_pool_create()");
+        free(pool);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    pool->free_bufs = calloc(num, sizeof(*pool->free_bufs));
+    if (!pool->free_bufs) {
+        WARN_CALLOC("iq_pool_create()");
+        free(pool->bufs);
+        free(pool);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    pool->mem = huge_buf_create((size_t)num * size);
+    if (!pool->mem) {
+        WARN_MALLOC("iq_pool_create()");
+        free(pool->free_bufs);
+        free(pool->bufs);
+        free(pool);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+#ifdef THREADS
+    pthread_mutex_init(&pool->lock, NULL);
+#endif
+    pool->num   = num;
+    pool->spare = spare < num ? spare : num;
+    for (unsigned i = 0; i < num; ++i) {
+        iq_buf_t *buf = &pool->bufs[i];
+        buf->data     = pool->mem + (size_t)i * size;
+        buf->size     = size;
+        buf->pool     = pool;
+        // the first buffers are taken first
+        pool->free_bufs[num - 1 - i] = buf;
+    }
+    pool->free_len = num;
+    return pool;
+}
+
+void iq_pool_free(iq_pool_t *pool)
+{
+    if (!pool)
+        return;
+    pool_lock(pool);
+    pool->closed = 1;
+    int idle     = pool->free_len == pool->num;
+    pool_unlock(pool);
+    if (idle)
+        pool_destroy(pool);
+}
+
+size_t iq_pool_memory(iq_pool_t const *pool)
+{
+    if (!pool || !pool->num)
+        return 0;
+    return sizeof(*pool) + pool->num * (pool->bufs[0].size + sizeof(*pool->bufs) + sizeof(*pool->free_bufs));
+}
+
+iq_buf_t *iq_pool_get(iq_pool_t *pool)
+{
+    pool_lock(pool);
+    iq_buf_t *buf = pool->free_len ? pool->free_bufs[--pool->free_len] : NULL;
+    if (buf)
+        buf->owned = 1;
+    pool_unlock(pool);
+    return buf;
+}
+
+/// Return a buffer to the free stack if it is not held, with the lock, returns 1 if the closed pool is idle.
+static int pool_recycle(iq_pool_t *pool, iq_buf_t *buf)
+{
+    if (buf->owned || buf->retained)
+        return 0;
+    pool->free_bufs[pool->free_len++] = buf;
+    return pool->closed && pool->free_len == pool->num;
+}
+
+void iq_pool_put(iq_buf_t *buf)
+{
+    if (!buf)
+        return;
+    iq_pool_t *pool = buf->pool;
+    pool_lock(pool);
+    buf->owned = 0;
+    int idle   = pool_recycle(pool, buf);
+    pool_unlock(pool);
+    if (idle)
+        pool_destroy(pool);
+}
+
+int iq_buf_retain(iq_buf_t *buf)
+{
+    if (!buf)
+        return -1;
+    iq_pool_t *pool = buf->pool;
+    pool_lock(pool);
+    int ok = buf->retained || pool->retained < pool->spare;
+    if (ok && !buf->retained++)
+        pool->retained++;
+    pool_unlock(pool);
+    return ok ? 0 : -1;
+}
+
+void iq_buf_release(iq_buf_t *buf)
+{
+    if (!buf)
+        return;
+    iq_pool_t *pool = buf->pool;
+    pool_lock(pool);
+    int idle = 0;
+    if (buf->retained && !--buf->retained) {
+        pool->retained--;
+        idle = pool_recycle(pool, buf);
+    }
+    pool_unlock(pool);
+    if (idle)
+        pool_destroy(pool);
+}
@@ -0,0 +1,86 @@
+/** @file
+    Load shedding, degrades the processing in steps when it falls behind real time.
+
+    The processing time of the buffers is compared to their sample time over
+    windows of half a second. Each window above the high load, or with lost
+    buffers, sheds one more level. Shedding lowers the load, so a level is only
+    restored after a few calm windows below half the high load.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "load_shed.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LOAD_SHED_WINDOW_US 500000.0 // sample time of a window
+#define LOAD_SHED_CALM      4        // windows below the low load to restore a level
+
+load_shed_t *load_shed_create(double high)
+{
+    load_shed_t *shed = calloc(1, sizeof(*shed));
+    if (!shed) {
+        WARN_CALLOC("load_shed_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    shed->high = high;
+    shed->low  = high / 2;
+    return shed;
+}
+
+void load_shed_free(load_shed_t *shed)
+{
+    free(shed);
+}
+
+int load_shed_update(load_shed_t *shed, double busy_us, double real_us, uint64_t lost)
+{
+    shed->buffers[shed->level]++;
+    shed->busy_us += busy_us;
+    shed->real_us += real_us;
+    if (shed->real_us < LOAD_SHED_WINDOW_US)
+        return 0;
+
+    shed->load    = shed->busy_us / shed->real_us;
+    shed->busy_us = 0.0;
+    shed->real_us = 0.0;
+    int behind    = lost > shed->lost || shed->load > shed->high;
+    shed->lost    = lost;
+
+    shed->calm = behind || shed->load >= shed->low ? 0 : shed->calm + 1;
+    if (behind && shed->level < LOAD_SHED_OUTPUTS) {
+        shed->level++;
+        shed->changes++;
+        return 1;
+    }
+    if (shed->calm >= LOAD_SHED_CALM && shed->level > LOAD_SHED_NONE) {
+        shed->level--;
+        shed->changes++;
+        shed->calm = 0;
+        return -1;
+    }
+    return 0;
+}
+
+char const *load_shed_name(int level)
+{
+    switch (level) {
+    case LOAD_SHED_NONE:
+        return "normal processing";
+    case LOAD_SHED_PRIORITY:
+        return "skipping the decoders with a priority";
+    case LOAD_SHED_UNUSED:
+        return "skipping the decoders without events";
+    case LOAD_SHED_FM:
+        return "skipping FM on quiet buffers";
+    case LOAD_SHED_OUTPUTS:
+        return "stopping the analyzers and dumpers";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,115 @@
+/** @file
+    Pipeline metrics, counters and histograms of the time spent in each stage.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "metrics.h"
+#include "compat_time.h"
+#include "r_util.h"
+
+double const metrics_bucket_us[METRICS_BUCKETS - 1] = {
+        10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000,
+};
+
+void metrics_observe(metrics_histogram_t *hist, double us)
+{
+    unsigned i = 0;
+    while (i < METRICS_BUCKETS - 1 && us > metrics_bucket_us[i])
+        ++i;
+    hist->buckets[i]++;
+    hist->count++;
+    hist->sum_us += us;
+    if (hist->max_us < us)
+        hist->max_us = us;
+}
+
+double metrics_percentile(metrics_histogram_t const *hist, double q)
+{
+    if (!hist->count)
+        return 0.0;
+
+    double rank   = q * hist->count;
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < METRICS_BUCKETS; ++i) {
+        uint64_t n = hist->buckets[i];
+        if (n && seen + n >= rank) {
+            double lower = i ? metrics_bucket_us[i - 1] : 0.0;
+            double upper = i < METRICS_BUCKETS - 1 && metrics_bucket_us[i] < hist->max_us ? metrics_bucket_us[i] : hist->max_us;
+            return lower + (upper - lower) * (rank - seen) / n;
+        }
+        seen += n;
+    }
+    return hist->max_us;
+}
+
+double metrics_wall_time_us(void)
+{
+    struct timeval now;
+    get_time_now(&now);
+    return (double)now.tv_sec * 1e6 + now.tv_usec;
+}
+
+double metrics_begin(metrics_t *metrics)
+{
+    // outputs during the stage advance the output time and allocations, which cancel out in metrics_end()
+    if (metrics->alloc_depth < METRICS_NESTING) {
+        alloc_count_t count = alloc_count_get();
+        count.allocs -= metrics->stage_allocs[METRICS_OUTPUT].allocs;
+        count.frees -= metrics->stage_allocs[METRICS_OUTPUT].frees;
+        metrics->alloc_mark[metrics->alloc_depth] = count;
+    }
+    metrics->alloc_depth++;
+    return monotonic_time_us() - metrics->stage_us[METRICS_OUTPUT];
+}
+
+void metrics_end(metrics_t *metrics, metrics_stage_t stage, double begin)
+{
+    metrics->stage_us[stage] += monotonic_time_us() - metrics->stage_us[METRICS_OUTPUT] - begin;
+    metrics->stage_ran |= 1u << stage;
+
+    if (metrics->alloc_depth && --metrics->alloc_depth < METRICS_NESTING) {
+        alloc_count_t count       = alloc_count_get();
+        alloc_count_t const *mark = &metrics->alloc_mark[metrics->alloc_depth];
+        alloc_count_t const *out  = &metrics->stage_allocs[METRICS_OUTPUT];
+        alloc_count_t *allocs     = &metrics->stage_allocs[stage];
+        allocs->allocs += count.allocs - out->allocs - mark->allocs;
+        allocs->frees += count.frees - out->frees - mark->frees;
+    }
+}
+
+void metrics_buffer_seq(metrics_t *metrics, uint64_t *last_seq, uint64_t seq)
+{
+    if (!seq)
+        return;
+    if (seq > *last_seq + 1)
+        metrics->buffers_lost += seq - *last_seq - 1;
+    *last_seq = seq;
+}
+
+void metrics_end_buffer(metrics_t *metrics, double begin, unsigned n_samples, int events)
+{
+    metrics_observe(&metrics->buffer, monotonic_time_us() - begin);
+    uint64_t allocs = 0;
+    for (unsigned i = 0; i < METRICS_STAGES; ++i) {
+        if (metrics->stage_ran & (1u << i))
+            metrics_observe(&metrics->stage[i], metrics->stage_us[i]);
+        metrics->stage_us[i] = 0;
+        metrics->allocs[i].allocs += metrics->stage_allocs[i].allocs;
+        metrics->allocs[i].frees += metrics->stage_allocs[i].frees;
+        if (i != METRICS_OUTPUT)
+            allocs += metrics->stage_allocs[i].allocs;
+        metrics->stage_allocs[i] = (alloc_count_t){0};
+    }
+    if (!events) {
+        metrics->buffers_idle++;
+        metrics->idle_allocs += allocs;
+        metrics->idle_alloc_buffers += allocs > 0;
+    }
+    metrics->stage_ran = 0;
+    metrics->buffers++;
+    metrics->samples += n_samples;
+}
@@ -150,7 +150,8 @@ MG_INTERNAL void mg_ws_handler(struct mg_connection *nc, int ev,
                                void *ev_data MG_UD_ARG(void *user_data));
 MG_INTERNAL void mg_ws_handshake(struct mg_connection *nc,
                                  const struct mg_str *key,
-                                 struct http_message *);
+                                 struct http_message *,
+                                 const char *extra_headers);
 #endif
 #endif /* MG_ENABLE_HTTP */
 
@@ -3309,6 +3310,7 @@ struct mg_connection *mg_connect_opt(struct mg_mgr *mgr, const char *address,
     params.cipher_suites = opts.ssl_cipher_suites;
     params.psk_identity = opts.ssl_psk_identity;
     params.psk_key = opts.ssl_psk_key;
+    params.session = opts.ssl_session;
     if (opts.ssl_ca_cert != NULL) {
       if (opts.ssl_server_name != NULL) {
         if (strcmp(opts.ssl_server_name, "*") != 0) {
@@ -4715,6 +4717,17 @@ static enum mg_ssl_if_result mg_ssl_if_ossl_set_psk(struct mg_ssl_if_ctx *ctx,
                                                     const char *identity,
                                                     const char *key_str);
 
+#ifndef KR_VERSION
+/* Keeps the newest session, with TLS 1.3 the tickets come after the handshake. */
+static int mg_ssl_if_ossl_new_session(SSL *ssl, SSL_SESSION *sess) {
+  struct mg_ssl_session **store = (struct mg_ssl_session **) SSL_get_app_data(ssl);
+  if (store == NULL) return 0;
+  if (*store != NULL) SSL_SESSION_free((SSL_SESSION *) *store);
+  *store = (struct mg_ssl_session *) sess;
+  return 1; /* the reference is kept */
+}
+#endif
+
 enum mg_ssl_if_result mg_ssl_if_conn_init(
     struct mg_connection *nc, const struct mg_ssl_if_conn_params *params,
     const char **err_msg) {
@@ -4791,6 +4804,18 @@ enum mg_ssl_if_result mg_ssl_if_conn_init(
 #endif
   }
 
+#ifndef KR_VERSION
+  if (!(nc->flags & MG_F_LISTENING) && params->session != NULL) {
+    SSL_CTX_set_session_cache_mode(
+        ctx->ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(ctx->ssl_ctx, mg_ssl_if_ossl_new_session);
+    SSL_set_app_data(ctx->ssl, params->session);
+    if (*params->session != NULL) {
+      SSL_set_session(ctx->ssl, (SSL_SESSION *) *params->session);
+    }
+  }
+#endif
+
   nc->flags |= MG_F_SSL;
 
   return MG_SSL_OK;
@@ -4854,6 +4879,19 @@ void mg_ssl_if_conn_free(struct mg_connection *nc) {
   MG_FREE(ctx);
 }
 
+void mg_ssl_session_free(struct mg_ssl_session *session) {
+#ifndef KR_VERSION
+  if (session != NULL) SSL_SESSION_free((SSL_SESSION *) session);
+#else
+  (void) session;
+#endif
+}
+
+void mg_ssl_session_detach(struct mg_connection *nc) {
+  struct mg_ssl_if_ctx *ctx = (struct mg_ssl_if_ctx *) nc->ssl_if_data;
+  if (ctx != NULL && ctx->ssl != NULL) SSL_set_app_data(ctx->ssl, NULL);
+}
+
 /*
  * Cipher suite options used for TLS negotiation.
  * https://wiki.mozilla.org/Security/Server_Side_TLS#Recommended_configurations
@@ -5390,6 +5428,15 @@ void mg_ssl_if_conn_free(struct mg_connection *nc) {
   MG_FREE(ctx);
 }
 
+void mg_ssl_session_free(struct mg_ssl_session *session) {
+  /* Session resumption is not supported, nothing is stored. */
+  (void) session;
+}
+
+void mg_ssl_session_detach(struct mg_connection *nc) {
+  (void) nc;
+}
+
 static enum mg_ssl_if_result mg_use_ca_cert(struct mg_ssl_if_ctx *ctx,
                                             const char *ca_cert) {
   if (ca_cert == NULL || strcmp(ca_cert, "*") == 0) {
@@ -6731,7 +6778,7 @@ void mg_http_handler(struct mg_connection *nc, int ev,
               hm);
       if (!(nc->flags & (MG_F_CLOSE_IMMEDIATELY | MG_F_SEND_AND_CLOSE))) {
         if (nc->send_mbuf.len == 0) {
-          mg_ws_handshake(nc, vec, hm);
+          mg_ws_handshake(nc, vec, hm, NULL);
         }
         mg_call(nc, nc->handler, nc->user_data, MG_EV_WEBSOCKET_HANDSHAKE_DONE,
                 hm);
@@ -10210,7 +10257,8 @@ static void mg_send_ws_header(struct mg_connection *nc, int op, size_t len,
   unsigned char header[10];
 
   header[0] =
-      (op & WEBSOCKET_DONT_FIN ? 0x0 : FLAGS_MASK_FIN) | (op & FLAGS_MASK_OP);
+      (op & WEBSOCKET_DONT_FIN ? 0x0 : FLAGS_MASK_FIN) |
+      (op & WEBSOCKET_RSV1 ? 0x40 : 0x0) | (op & FLAGS_MASK_OP);
   if (len < 126) {
     header[1] = (unsigned char) len;
     header_len = 2;
@@ -10348,7 +10396,8 @@ extern void mg_hash_sha1_v(size_t num_msgs, const uint8_t *msgs[],
 
 MG_INTERNAL void mg_ws_handshake(struct mg_connection *nc,
                                  const struct mg_str *key,
-                                 struct http_message *hm) {
+                                 struct http_message *hm,
+                                 const char *extra_headers) {
   static const char *magic = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
   const uint8_t *msgs[2] = {(const uint8_t *) key->p, (const uint8_t *) magic};
   const size_t msg_lens[2] = {key->len, 36};
@@ -10367,11 +10416,21 @@ MG_INTERNAL void mg_ws_handshake(struct mg_connection *nc,
   if (s != NULL) {
     mg_printf(nc, "Sec-WebSocket-Protocol: %.*s\r\n", (int) s->len, s->p);
   }
-  mg_printf(nc, "Sec-WebSocket-Accept: %s%s", b64_sha, "\r\n\r\n");
+  mg_printf(nc, "Sec-WebSocket-Accept: %s\r\n%s\r\n", b64_sha,
+            extra_headers != NULL ? extra_headers : "");
 
   DBG(("%p %.*s %s", nc, (int) key->len, key->p, b64_sha));
 }
 
+void mg_send_websocket_handshake_reply(struct mg_connection *nc,
+                                       struct http_message *hm,
+                                       const char *extra_headers) {
+  struct mg_str *key = mg_get_http_header(hm, "Sec-WebSocket-Key");
+  if (key != NULL) {
+    mg_ws_handshake(nc, key, hm, extra_headers);
+  }
+}
+
 void mg_send_websocket_handshake2(struct mg_connection *nc, const char *path,
                                   const char *host, const char *protocol,
                                   const char *extra_headers) {
@@ -15006,6 +15065,15 @@ void mg_ssl_if_conn_free(struct mg_connection *nc) {
   MG_FREE(ctx);
 }
 
+void mg_ssl_session_free(struct mg_ssl_session *session) {
+  /* Session resumption is not supported, nothing is stored. */
+  (void) session;
+}
+
+void mg_ssl_session_detach(struct mg_connection *nc) {
+  (void) nc;
+}
+
 bool pem_to_der(const char *pem_file, const char *der_file) {
   bool ret = false;
   FILE *pf = NULL, *df = NULL;
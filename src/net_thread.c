@@ -0,0 +1,306 @@
+/** @file
+    Network thread, polls the mongoose manager off the SDR thread.
+
+    The thread runs all connection handlers and prints the network outputs,
+    these are fed through polled output queues. Each queued event wakes the poll
+    with a byte on a socket pair, at most one wake byte is pending.
+    To save power the wakes can be coalesced, the queued events then wait
+    for a flush or the next poll timeout.
+    The handlers that use the config take a decode lock, the SDR thread
+    holds it while a buffer is decoded.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "net_thread.h"
+#include "output_queue.h"
+#include "mongoose.h"
+#include "list.h"
+#include "compat_pthread.h"
+#include "thread_pin.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#ifdef THREADS
+
+#define NET_POLL_MS 100 // the poll timeout, timers are checked at least this often
+
+struct net_thread {
+    struct mg_mgr *mgr;
+    pthread_t thread;
+    pthread_mutex_t lock;      ///< the decode lock
+    pthread_mutex_t wake_lock; ///< guards the flags below
+    pthread_cond_t start_cond; ///< signals the start or the exit
+    int started;
+    int exit;
+    int wake_pending;          ///< a wake byte is in the socket pair
+    int wake_deferred;         ///< events are queued since the last flush, with coalesced wakes
+    unsigned coalesce_ms;      ///< the poll timeout with coalesced wakes, 0 to wake for each event
+    sock_t wake_sock[2];       ///< a byte is written to the first, the second is polled
+    list_t outputs;            ///< the polled output queues
+};
+
+static void net_wake_handler(struct mg_connection *nc, int ev, void *ev_data)
+{
+    (void)ev_data;
+    net_thread_t *net = nc->user_data;
+    if (net && ev == MG_EV_RECV) {
+        mbuf_remove(&nc->recv_mbuf, nc->recv_mbuf.len);
+        pthread_mutex_lock(&net->wake_lock);
+        net->wake_pending = 0;
+        pthread_mutex_unlock(&net->wake_lock);
+    }
+}
+
+/// Send the wake byte unless pending, the wake lock must be held.
+static void net_wake_locked(net_thread_t *net)
+{
+    net->wake_deferred = 0;
+    if (!net->wake_pending) {
+        net->wake_pending = 1;
+        // never blocks, the socket pair holds at most one byte
+        if (send(net->wake_sock[0], "w", 1, 0) != 1)
+            net->wake_pending = 0;
+    }
+}
+
+static void net_wake(void *ctx)
+{
+    net_thread_t *net = ctx;
+    pthread_mutex_lock(&net->wake_lock);
+    if (net->coalesce_ms && !net->exit)
+        net->wake_deferred = 1;
+    else
+        net_wake_locked(net);
+    pthread_mutex_unlock(&net->wake_lock);
+}
+
+static THREAD_RETURN THREAD_CALL net_thread_run(void *arg)
+{
+    net_thread_t *net = arg;
+    thread_pin_self(THREAD_NET);
+
+    pthread_mutex_lock(&net->wake_lock);
+    while (!net->started && !net->exit) {
+        pthread_cond_wait(&net->start_cond, &net->wake_lock);
+    }
+    pthread_mutex_unlock(&net->wake_lock);
+
+    for (;;) {
+        pthread_mutex_lock(&net->wake_lock);
+        int exit    = net->exit;
+        int poll_ms = net->coalesce_ms ? (int)net->coalesce_ms : NET_POLL_MS;
+        pthread_mutex_unlock(&net->wake_lock);
+        if (exit)
+            break;
+
+        mg_mgr_poll(net->mgr, poll_ms);
+        for (void **iter = net->outputs.elems; iter && *iter; ++iter) {
+            data_output_queue_poll(*iter);
+        }
+    }
+    return (THREAD_RETURN)0;
+}
+
+net_thread_t *net_thread_create(struct mg_mgr *mgr)
+{
+    if (!mgr)
+        return NULL;
+
+    net_thread_t *net = calloc(1, sizeof(*net));
+    if (!net) {
+        WARN_CALLOC("net_thread_create()");
+        return NULL;
+    }
+    net->mgr = mgr;
+
+    if (mg_socketpair(net->wake_sock, SOCK_STREAM) != 1) {
+        fprintf(stderr, "%s: failed to create the wake socket pair\n", __func__);
+        free(net);
+        return NULL;
+    }
+    struct mg_connection *nc = mg_add_sock(mgr, net->wake_sock[1], net_wake_handler);
+    if (!nc) {
+        fprintf(stderr, "%s: failed to add the wake socket\n", __func__);
+        closesocket(net->wake_sock[0]);
+        closesocket(net->wake_sock[1]);
+        free(net);
+        return NULL;
+    }
+    nc->user_data = net;
+
+    pthread_mutex_init(&net->lock, NULL);
+    pthread_mutex_init(&net->wake_lock, NULL);
+    pthread_cond_init(&net->start_cond, NULL);
+
+#ifndef _WIN32
+    // only the main thread receives the signals
+    sigset_t sigset;
+    sigset_t oldset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+    int r = pthread_create(&net->thread, NULL, net_thread_run, net);
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+    if (r) {
+        fprintf(stderr, "%s: failed to start thread\n", __func__);
+        nc->user_data = NULL;
+        nc->handler   = NULL;
+        nc->flags |= MG_F_CLOSE_IMMEDIATELY; // closes the second socket
+        closesocket(net->wake_sock[0]);
+        pthread_cond_destroy(&net->start_cond);
+        pthread_mutex_destroy(&net->wake_lock);
+        pthread_mutex_destroy(&net->lock);
+        free(net);
+        return NULL;
+    }
+    return net;
+}
+
+struct data_output *net_thread_queue_output(net_thread_t *net, struct data_output *output, unsigned size, int drop_newest)
+{
+    if (!net || !output)
+        return output;
+
+    // blocking could deadlock, the network thread might wait for the decode lock
+    output_queue_policy_t policy = drop_newest ? OUTPUT_QUEUE_DROP_NEWEST : OUTPUT_QUEUE_DROP_OLDEST;
+    struct data_output *queue    = data_output_queue_create_polled(output, size, policy, net_wake, net);
+    if (queue == output)
+        return output;
+    list_push(&net->outputs, queue);
+    return queue;
+}
+
+void net_thread_start(net_thread_t *net)
+{
+    if (!net)
+        return;
+
+    pthread_mutex_lock(&net->wake_lock);
+    net->started = 1;
+    pthread_cond_signal(&net->start_cond);
+    pthread_mutex_unlock(&net->wake_lock);
+}
+
+void net_thread_coalesce(net_thread_t *net, unsigned poll_ms)
+{
+    if (!net)
+        return;
+
+    pthread_mutex_lock(&net->wake_lock);
+    net->coalesce_ms = poll_ms;
+    if (!poll_ms && net->wake_deferred)
+        net_wake_locked(net);
+    pthread_mutex_unlock(&net->wake_lock);
+}
+
+void net_thread_flush(net_thread_t *net)
+{
+    if (!net)
+        return;
+
+    pthread_mutex_lock(&net->wake_lock);
+    if (net->wake_deferred)
+        net_wake_locked(net);
+    pthread_mutex_unlock(&net->wake_lock);
+}
+
+void net_thread_free(net_thread_t *net)
+{
+    if (!net)
+        return;
+
+    pthread_mutex_lock(&net->wake_lock);
+    net->exit = 1;
+    pthread_cond_signal(&net->start_cond);
+    net_wake_locked(net);
+    pthread_mutex_unlock(&net->wake_lock);
+    pthread_join(net->thread, NULL);
+
+    // the manager closes the second socket
+    for (struct mg_connection *nc = mg_next(net->mgr, NULL); nc; nc = mg_next(net->mgr, nc)) {
+        if (nc->handler == net_wake_handler) {
+            nc->user_data = NULL;
+            nc->handler   = NULL;
+            nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+        }
+    }
+    closesocket(net->wake_sock[0]);
+
+    list_free_elems(&net->outputs, NULL); // the queues are freed with the outputs
+    pthread_cond_destroy(&net->start_cond);
+    pthread_mutex_destroy(&net->wake_lock);
+    pthread_mutex_destroy(&net->lock);
+    free(net);
+}
+
+void net_thread_lock(net_thread_t *net)
+{
+    if (net)
+        pthread_mutex_lock(&net->lock);
+}
+
+void net_thread_unlock(net_thread_t *net)
+{
+    if (net)
+        pthread_mutex_unlock(&net->lock);
+}
+
+#else
+
+net_thread_t *net_thread_create(struct mg_mgr *mgr)
+{
+    (void)mgr;
+    return NULL;
+}
+
+struct data_output *net_thread_queue_output(net_thread_t *net, struct data_output *output, unsigned size, int drop_newest)
+{
+    (void)net;
+    (void)size;
+    (void)drop_newest;
+    return output;
+}
+
+void net_thread_start(net_thread_t *net)
+{
+    (void)net;
+}
+
+void net_thread_coalesce(net_thread_t *net, unsigned poll_ms)
+{
+    (void)net;
+    (void)poll_ms;
+}
+
+void net_thread_flush(net_thread_t *net)
+{
+    (void)net;
+}
+
+void net_thread_free(net_thread_t *net)
+{
+    (void)net;
+}
+
+void net_thread_lock(net_thread_t *net)
+{
+    (void)net;
+}
+
+void net_thread_unlock(net_thread_t *net)
+{
+    (void)net;
+}
+
+#endif
@@ -0,0 +1,445 @@
+/** @file
+    Arrow IPC file output for rtl_433 events, a columnar archive per model.
+
+    The events are grouped by model, each model has its own file and schema,
+    see arrow_ipc.h for the file format. The values of an event are copied into
+    the columns of its model, a full batch is typed, encoded, and written.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_arrow.h"
+#include "arrow_ipc.h"
+#include "list.h"
+#include "optparse.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// A value of a column, the string is owned.
+typedef struct {
+    data_type_t type; ///< DATA_INT, DATA_DOUBLE, or DATA_STRING, DATA_COUNT if null
+    data_value_t value;
+} arrow_cell_t;
+
+typedef struct {
+    char *key;
+    int order;            ///< the index in the declared fields, sorts the schema
+    enum arrow_type type; ///< fixed with the first batch
+    arrow_cell_t *cells;  ///< the values of the batch rows
+} arrow_column_state_t;
+
+/// The file and columns of a model.
+typedef struct {
+    char *model;
+    FILE *file;
+    arrow_ipc_t *ipc; ///< NULL until the first batch fixes the schema
+    int failed;       ///< the file could not be started, the events are dropped
+    arrow_column_state_t *columns;
+    unsigned num_columns;
+    unsigned rows;
+} arrow_model_t;
+
+typedef struct {
+    struct data_output output;
+    char *stem; ///< the path without the ".arrow" extension
+    unsigned batch_rows;
+    char const **fields; ///< the declared fields, NULL to keep all
+    int num_fields;
+    list_t models;
+    arrow_body_t body;
+    data_buf_t json; ///< the JSON text of nested values
+} data_output_arrow_t;
+
+static void cell_clear(arrow_cell_t *cell)
+{
+    if (cell->type == DATA_STRING)
+        free(cell->value.v_ptr);
+    cell->type = DATA_COUNT;
+}
+
+static arrow_model_t *arrow_model_find(data_output_arrow_t *arrow, char const *model)
+{
+    for (void **iter = arrow->models.elems; iter && *iter; ++iter) {
+        arrow_model_t *m = *iter;
+        if (!strcmp(m->model, model))
+            return m;
+    }
+    arrow_model_t *m = calloc(1, sizeof(*m));
+    if (!m) {
+        WARN_CALLOC("arrow_model_find()");
+        return NULL;
+    }
+    m->model = strdup(model);
+    if (!m->model) {
+        WARN_STRDUP("arrow_model_find()");
+        free(m);
+        return NULL;
+    }
+    list_push(&arrow->models, m);
+    return m;
+}
+
+static arrow_column_state_t *arrow_column_find(data_output_arrow_t *arrow, arrow_model_t *m, char const *key)
+{
+    for (unsigned i = 0; i < m->num_columns; ++i) {
+        if (!strcmp(m->columns[i].key, key))
+            return &m->columns[i];
+    }
+    if (m->ipc)
+        return NULL; // the schema is fixed
+    int order = 0;
+    if (arrow->fields) {
+        while (order < arrow->num_fields && strcmp(arrow->fields[order], key))
+            order++;
+        if (order == arrow->num_fields)
+            return NULL; // not a declared field
+    }
+    else {
+        order = (int)m->num_columns;
+    }
+
+    arrow_column_state_t *columns = realloc(m->columns, (m->num_columns + 1) * sizeof(*columns));
+    if (!columns) {
+        WARN_REALLOC("arrow_column_find()");
+        return NULL;
+    }
+    m->columns              = columns;
+    arrow_column_state_t *c = &columns[m->num_columns];
+    c->key                  = strdup(key);
+    if (!c->key) {
+        WARN_STRDUP("arrow_column_find()");
+        return NULL;
+    }
+    c->cells = malloc(arrow->batch_rows * sizeof(*c->cells));
+    if (!c->cells) {
+        WARN_MALLOC("arrow_column_find()");
+        free(c->key);
+        return NULL;
+    }
+    for (unsigned i = 0; i < arrow->batch_rows; ++i)
+        c->cells[i].type = DATA_COUNT;
+    c->order = order;
+    m->num_columns++;
+    return c;
+}
+
+static int compare_columns(void const *a, void const *b)
+{
+    arrow_column_state_t const *ca = a;
+    arrow_column_state_t const *cb = b;
+    return ca->order - cb->order;
+}
+
+/// Sort the columns, infer the types from the batch, and start the file of a model.
+static int arrow_model_open(data_output_arrow_t *arrow, arrow_model_t *m)
+{
+    qsort(m->columns, m->num_columns, sizeof(*m->columns), compare_columns);
+
+    arrow_column_t *schema = calloc(m->num_columns + 1, sizeof(*schema));
+    if (!schema) {
+        WARN_CALLOC("arrow_model_open()");
+        return -1;
+    }
+    for (unsigned i = 0; i < m->num_columns; ++i) {
+        arrow_column_state_t *c = &m->columns[i];
+        int ints = 0, dbls = 0, strs = 0;
+        for (unsigned j = 0; j < m->rows; ++j) {
+            ints += c->cells[j].type == DATA_INT;
+            dbls += c->cells[j].type == DATA_DOUBLE;
+            strs += c->cells[j].type == DATA_STRING;
+        }
+        c->type   = strs || (!ints && !dbls) ? ARROW_UTF8 : dbls ? ARROW_FLOAT64 : ARROW_INT32;
+        schema[i] = (arrow_column_t){.name = c->key, .type = c->type, .nullable = 1};
+    }
+
+    // the model as file name part, the characters of a path are replaced
+    size_t len = strlen(arrow->stem) + strlen(m->model) + 8;
+    char *path = malloc(len);
+    if (!path) {
+        WARN_MALLOC("arrow_model_open()");
+        free(schema);
+        return -1;
+    }
+    if (*m->model) {
+        int pos = snprintf(path, len, "%s.", arrow->stem);
+        for (char const *p = m->model; *p; ++p)
+            path[pos++] = (*p >= '0' && *p <= '9') || (*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z') || *p == '-' ? *p : '_';
+        path[pos] = '\0';
+        strcat(path, ".arrow");
+    }
+    else {
+        snprintf(path, len, "%s.arrow", arrow->stem);
+    }
+
+    m->file = fopen(path, "wb");
+    if (!m->file) {
+        fprintf(stderr, "rtl_433: failed to open Arrow output file %s\n", path);
+        free(path);
+        free(schema);
+        return -1;
+    }
+    free(path);
+    m->ipc = arrow_ipc_create(m->file, schema, m->num_columns);
+    free(schema);
+    return m->ipc ? 0 : -1;
+}
+
+/// Convert a value to the column type, returns 0 if the value is null in the column.
+static int cell_convert(arrow_cell_t const *cell, enum arrow_type type, data_value_t *v, char *buf, size_t size)
+{
+    if (cell->type == DATA_COUNT)
+        return 0;
+    if (type == ARROW_INT32) {
+        if (cell->type == DATA_INT)
+            *v = cell->value;
+        else if (cell->type == DATA_DOUBLE && cell->value.v_dbl == (int)cell->value.v_dbl)
+            v->v_int = (int)cell->value.v_dbl;
+        else
+            return 0;
+    }
+    else if (type == ARROW_FLOAT64) {
+        if (cell->type == DATA_DOUBLE)
+            *v = cell->value;
+        else if (cell->type == DATA_INT)
+            v->v_dbl = cell->value.v_int;
+        else
+            return 0;
+    }
+    else {
+        if (cell->type == DATA_STRING)
+            *v = cell->value;
+        else if (cell->type == DATA_INT)
+            snprintf(buf, size, "%d", cell->value.v_int);
+        else
+            snprintf(buf, size, "%.15g", cell->value.v_dbl);
+        if (cell->type != DATA_STRING)
+            v->v_ptr = buf;
+    }
+    return 1;
+}
+
+/// Encode and write the batch of a model, the cells are cleared.
+static void arrow_model_flush(data_output_arrow_t *arrow, arrow_model_t *m)
+{
+    if (!m->rows)
+        return;
+    if (!m->ipc && !m->failed && arrow_model_open(arrow, m)) {
+        m->failed = 1;
+        fprintf(stderr, "rtl_433: dropping the Arrow output of %s\n", *m->model ? m->model : "events");
+    }
+
+    unsigned n         = m->rows;
+    arrow_body_t *body = &arrow->body;
+    arrow_body_reset(body);
+    for (unsigned i = 0; m->ipc && i < m->num_columns; ++i) {
+        arrow_column_state_t *c = &m->columns[i];
+        char buf[32];
+        data_value_t v;
+        unsigned nulls = 0;
+        size_t text    = 0;
+        for (unsigned j = 0; j < n; ++j) {
+            if (!cell_convert(&c->cells[j], c->type, &v, buf, sizeof(buf)))
+                nulls++;
+            else if (c->type == ARROW_UTF8)
+                text += strlen(v.v_ptr);
+        }
+
+        arrow_body_node(body, n, nulls);
+        uint8_t *validity = arrow_body_buffer(body, nulls ? (n + 7) / 8 : 0);
+        if (validity && nulls)
+            for (unsigned j = 0; j < n; ++j)
+                if (cell_convert(&c->cells[j], c->type, &v, buf, sizeof(buf)))
+                    validity[j / 8] |= 1 << (j % 8);
+
+        if (c->type == ARROW_UTF8) {
+            uint8_t *offsets = arrow_body_buffer(body, (n + 1) * 4);
+            if (offsets) {
+                uint32_t pos = 0;
+                arrow_put(offsets, 0, 4);
+                for (unsigned j = 0; j < n; ++j) {
+                    if (cell_convert(&c->cells[j], c->type, &v, buf, sizeof(buf)))
+                        pos += (uint32_t)strlen(v.v_ptr);
+                    arrow_put(offsets + 4 * (j + 1), pos, 4);
+                }
+            }
+            uint8_t *p = arrow_body_buffer(body, text);
+            for (unsigned j = 0; p && j < n; ++j) {
+                if (cell_convert(&c->cells[j], c->type, &v, buf, sizeof(buf))) {
+                    size_t len = strlen(v.v_ptr);
+                    memcpy(p, v.v_ptr, len);
+                    p += len;
+                }
+            }
+        }
+        else {
+            unsigned size = c->type == ARROW_FLOAT64 ? 8 : 4;
+            uint8_t *p    = arrow_body_buffer(body, n * size);
+            for (unsigned j = 0; p && j < n; ++j) {
+                if (!cell_convert(&c->cells[j], c->type, &v, buf, sizeof(buf)))
+                    continue;
+                if (c->type == ARROW_FLOAT64) {
+                    uint64_t bits;
+                    memcpy(&bits, &v.v_dbl, sizeof(bits));
+                    arrow_put(p + 8 * j, bits, 8);
+                }
+                else {
+                    arrow_put(p + 4 * j, (uint32_t)v.v_int, 4);
+                }
+            }
+        }
+    }
+    if (m->ipc)
+        arrow_ipc_write_batch(m->ipc, n, body);
+
+    for (unsigned i = 0; i < m->num_columns; ++i)
+        for (unsigned j = 0; j < n; ++j)
+            cell_clear(&m->columns[i].cells[j]);
+    m->rows = 0;
+}
+
+/// Copy a value into a cell, nested data and arrays as JSON text.
+static void cell_set(data_output_arrow_t *arrow, arrow_cell_t *cell, data_t const *d)
+{
+    cell_clear(cell);
+    if (d->type == DATA_INT || d->type == DATA_DOUBLE) {
+        cell->type  = d->type;
+        cell->value = d->value;
+        return;
+    }
+    char const *str = d->value.v_ptr;
+    size_t len      = str ? strlen(str) : 0;
+    if (d->type == DATA_DATA || d->type == DATA_ARRAY) {
+        // the value of a single element `{"":<value>}`
+        data_t node = {.key = "", .type = d->type, .value = d->value};
+        str         = data_print_jsons_buf(&node, &arrow->json, &len);
+        if (!str || len < 5)
+            return;
+        str += 4;
+        len -= 5;
+    }
+    else if (d->type != DATA_STRING || !str) {
+        return;
+    }
+    char *copy = malloc(len + 1);
+    if (!copy) {
+        WARN_MALLOC("cell_set()");
+        return;
+    }
+    memcpy(copy, str, len);
+    copy[len]         = '\0';
+    cell->type        = DATA_STRING;
+    cell->value.v_ptr = copy;
+}
+
+static void R_API_CALLCONV print_arrow_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    data_output_arrow_t *arrow = (data_output_arrow_t *)output;
+
+    char const *model = "";
+    for (data_t *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL && d->type == DATA_STRING)
+            model = d->value.v_ptr;
+    }
+    arrow_model_t *m = arrow_model_find(arrow, model);
+    if (!m)
+        return;
+
+    for (data_t *d = data; d; d = d->next) {
+        arrow_column_state_t *c = arrow_column_find(arrow, m, d->key);
+        if (c)
+            cell_set(arrow, &c->cells[m->rows], d);
+    }
+    m->rows++;
+    if (m->rows >= arrow->batch_rows)
+        arrow_model_flush(arrow, m);
+}
+
+static void R_API_CALLCONV data_output_arrow_start(struct data_output *output, char const *const *fields, int num_fields)
+{
+    data_output_arrow_t *arrow = (data_output_arrow_t *)output;
+
+    if (num_fields <= 0)
+        return; // keep all fields
+    arrow->fields = malloc(num_fields * sizeof(*arrow->fields));
+    if (!arrow->fields) {
+        WARN_MALLOC("data_output_arrow_start()");
+        return; // NOTE: keeps all fields on alloc failure.
+    }
+    memcpy((void *)arrow->fields, fields, num_fields * sizeof(*arrow->fields));
+    arrow->num_fields = num_fields;
+}
+
+static void R_API_CALLCONV data_output_arrow_sync(struct data_output *output, int force)
+{
+    data_output_arrow_t *arrow = (data_output_arrow_t *)output;
+
+    if (!force)
+        return; // batches are written when full
+    for (void **iter = arrow->models.elems; iter && *iter; ++iter) {
+        arrow_model_t *m = *iter;
+        arrow_model_flush(arrow, m);
+        if (m->file)
+            fflush(m->file);
+    }
+}
+
+static void R_API_CALLCONV data_output_arrow_free(data_output_t *output)
+{
+    data_output_arrow_t *arrow = (data_output_arrow_t *)output;
+
+    for (void **iter = arrow->models.elems; iter && *iter; ++iter) {
+        arrow_model_t *m = *iter;
+        arrow_model_flush(arrow, m);
+        if (m->ipc && arrow_ipc_close(m->ipc))
+            fprintf(stderr, "rtl_433: writing the Arrow output of %s failed\n", *m->model ? m->model : "events");
+        if (m->file)
+            fclose(m->file);
+        for (unsigned i = 0; i < m->num_columns; ++i) {
+            free(m->columns[i].key);
+            free(m->columns[i].cells);
+        }
+        free(m->columns);
+        free(m->model);
+        free(m);
+    }
+    list_free_elems(&arrow->models, NULL);
+    arrow_body_free(&arrow->body);
+    data_buf_free(&arrow->json);
+    free((void *)arrow->fields);
+    free(arrow->stem);
+    free(arrow);
+}
+
+struct data_output *data_output_arrow_create(char const *path, unsigned batch_rows)
+{
+    data_output_arrow_t *arrow = calloc(1, sizeof(*arrow));
+    if (!arrow) {
+        WARN_CALLOC("data_output_arrow_create()");
+        return NULL;
+    }
+    arrow->stem = strdup(path);
+    if (!arrow->stem) {
+        WARN_STRDUP("data_output_arrow_create()");
+        free(arrow);
+        return NULL;
+    }
+    size_t len = strlen(arrow->stem);
+    if (len > 6 && !strcasecmp(arrow->stem + len - 6, ".arrow"))
+        arrow->stem[len - 6] = '\0';
+    arrow->batch_rows = batch_rows ? batch_rows : OUTPUT_ARROW_BATCH_ROWS;
+
+    arrow->output.print_data   = print_arrow_data;
+    arrow->output.output_start = data_output_arrow_start;
+    arrow->output.output_sync  = data_output_arrow_sync;
+    arrow->output.output_free  = data_output_arrow_free;
+
+    return &arrow->output;
+}
@@ -0,0 +1,164 @@
+/** @file
+    CBOR encoding of rtl_433 events.
+
+    Encodes the data structure directly, without the text formatting of the
+    JSON printer. An event is a map of text keys, nested data are maps and
+    arrays are arrays.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_cbor.h"
+#include "r_util.h"
+
+#include <string.h>
+
+/// CBOR major types.
+enum cbor_major {
+    CBOR_UINT   = 0,
+    CBOR_NINT   = 1,
+    CBOR_TEXT   = 3,
+    CBOR_ARRAY  = 4,
+    CBOR_MAP    = 5,
+    CBOR_SIMPLE = 7,
+};
+
+typedef struct {
+    struct data_output output;
+    uint8_t *buf;
+    size_t size;
+    size_t len; ///< length of the encoding, also counts the bytes that did not fit
+} data_print_cbor_t;
+
+static void cbor_bytes(data_print_cbor_t *cbor, void const *src, size_t len)
+{
+    if (cbor->len < cbor->size)
+        memcpy(cbor->buf + cbor->len, src, cbor->size - cbor->len < len ? cbor->size - cbor->len : len);
+    cbor->len += len;
+}
+
+/// Encode a major type and argument, big endian in the shortest form.
+static void cbor_head(data_print_cbor_t *cbor, unsigned major, uint64_t val)
+{
+    uint8_t head[9];
+    size_t len;
+    if (val < 24) {
+        head[0] = (uint8_t)(major << 5 | val);
+        len     = 1;
+    }
+    else if (val <= UINT8_MAX) {
+        head[0] = (uint8_t)(major << 5 | 24);
+        len     = 2;
+    }
+    else if (val <= UINT16_MAX) {
+        head[0] = (uint8_t)(major << 5 | 25);
+        len     = 3;
+    }
+    else if (val <= UINT32_MAX) {
+        head[0] = (uint8_t)(major << 5 | 26);
+        len     = 5;
+    }
+    else {
+        head[0] = (uint8_t)(major << 5 | 27);
+        len     = 9;
+    }
+    for (size_t i = len - 1; i > 0; --i) {
+        head[i] = (uint8_t)val;
+        val >>= 8;
+    }
+    cbor_bytes(cbor, head, len);
+}
+
+static void cbor_text(data_print_cbor_t *cbor, char const *str)
+{
+    size_t len = strlen(str);
+    cbor_head(cbor, CBOR_TEXT, len);
+    cbor_bytes(cbor, str, len);
+}
+
+static void R_API_CALLCONV print_cbor_array(data_output_t *output, data_array_t *array, char const *format)
+{
+    data_print_cbor_t *cbor = (data_print_cbor_t *)output;
+
+    cbor_head(cbor, CBOR_ARRAY, array->num_values > 0 ? (uint64_t)array->num_values : 0);
+    for (int c = 0; c < array->num_values; ++c) {
+        print_array_value(output, array, format, c);
+    }
+}
+
+static void R_API_CALLCONV print_cbor_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    data_print_cbor_t *cbor = (data_print_cbor_t *)output;
+
+    uint64_t num = 0;
+    for (data_t *d = data; d; d = d->next) {
+        num++;
+    }
+    cbor_head(cbor, CBOR_MAP, num);
+    for (; data; data = data->next) {
+        cbor_text(cbor, data->key);
+        print_value(output, data->type, data->value, data->format);
+    }
+}
+
+static void R_API_CALLCONV print_cbor_string(data_output_t *output, char const *str, char const *format)
+{
+    UNUSED(format);
+    data_print_cbor_t *cbor = (data_print_cbor_t *)output;
+
+    cbor_text(cbor, str);
+}
+
+static void R_API_CALLCONV print_cbor_double(data_output_t *output, double data, char const *format)
+{
+    UNUSED(format);
+    data_print_cbor_t *cbor = (data_print_cbor_t *)output;
+
+    float f = (float)data;
+    if ((double)f == data || data != data) {
+        uint32_t bits;
+        memcpy(&bits, &f, sizeof(bits));
+        uint8_t buf[5] = {CBOR_SIMPLE << 5 | 26, bits >> 24, bits >> 16, bits >> 8, bits};
+        cbor_bytes(cbor, buf, sizeof(buf));
+    }
+    else {
+        uint64_t bits;
+        memcpy(&bits, &data, sizeof(bits));
+        uint8_t buf[9] = {CBOR_SIMPLE << 5 | 27, bits >> 56, bits >> 48, bits >> 40, bits >> 32, bits >> 24, bits >> 16, bits >> 8, bits};
+        cbor_bytes(cbor, buf, sizeof(buf));
+    }
+}
+
+static void R_API_CALLCONV print_cbor_int(data_output_t *output, int data, char const *format)
+{
+    UNUSED(format);
+    data_print_cbor_t *cbor = (data_print_cbor_t *)output;
+
+    if (data < 0)
+        cbor_head(cbor, CBOR_NINT, (uint64_t)(-1 - (int64_t)data));
+    else
+        cbor_head(cbor, CBOR_UINT, (uint64_t)data);
+}
+
+R_API size_t data_print_cbor(data_t *data, uint8_t *dst, size_t len)
+{
+    data_print_cbor_t cbor = {
+            .output = {
+                    .print_data   = print_cbor_data,
+                    .print_array  = print_cbor_array,
+                    .print_string = print_cbor_string,
+                    .print_double = print_cbor_double,
+                    .print_int    = print_cbor_int,
+            },
+            .buf  = dst,
+            .size = dst ? len : 0,
+    };
+
+    print_cbor_data(&cbor.output, data, NULL);
+
+    return cbor.len;
+}
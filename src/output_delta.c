@@ -0,0 +1,564 @@
+/** @file
+    Compact delta encoded frames of the sensor values, for uplinks of a few hundred bytes a minute.
+
+    The last values of each sensor are kept in a table keyed by model, id, and channel.
+    A frame carries the changes since the last frame, a sensor is sent with the bitmask
+    of its changed fields and the change of each value, quantized to the decimals of its format.
+    A sensor is defined with its model and fields when first sent and again after a few updates,
+    so a receiver that missed a frame is in sync again after the next definition of a sensor.
+
+    A frame, all numbers are unsigned LEB128 varints:
+
+        version (1), frame sequence, unix time,
+        then records to the end of the frame:
+        sensor index * 2 + 1, model, number of fields, per field: key, kind (byte),
+            then the values of all fields (a definition)
+        sensor index * 2, bitmask of the changed fields, the values of the changed fields (an update)
+
+    A text is a varint length and the bytes. A kind is 0 for an integer, 1 for a string,
+    and 2 + n for a double with n decimals. A value is the zigzag encoded change of the
+    integer or the quantized double (from 0 in a definition), or the text of a string.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_delta.h"
+#include "list.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DELTA_VERSION 1
+/// Decimals of a double without a format.
+#define DELTA_DECIMALS 2
+/// Decimals of a double at most.
+#define DELTA_DECIMALS_MAX 6
+
+enum delta_kind {
+    DELTA_KIND_INT    = 0,
+    DELTA_KIND_STRING = 1,
+    DELTA_KIND_DOUBLE = 2, ///< plus the decimals
+};
+
+typedef struct delta_field {
+    char *key;
+    int schema_index; ///< the position in the schema, the fields of a sensor are in schema order
+    int kind;
+    int64_t value; ///< the last value, quantized
+    int64_t sent;  ///< the value the receiver has
+    char *str;     ///< the last value of a string
+} delta_field_t;
+
+typedef struct delta_sensor {
+    char *key; ///< model, id, and channel
+    char *model;
+    unsigned num_fields;
+    delta_field_t fields[DELTA_FIELDS_MAX];
+    uint64_t changed; ///< the fields to send
+    int defined;      ///< the receiver has the definition
+    unsigned updates; ///< the updates sent since the definition
+    int oversize;     ///< the record is larger than a frame, warned once
+} delta_sensor_t;
+
+struct delta_encoder {
+    char **schema;
+    int num_schema;
+    list_t sensors;
+    unsigned key_updates;
+    unsigned frames; ///< the frames sent, the sequence of the next frame
+    unsigned next;   ///< the sensor to start the next frame with
+    int full;        ///< the table is full, warned once
+};
+
+delta_encoder_t *delta_encoder_create(unsigned key_updates)
+{
+    delta_encoder_t *enc = calloc(1, sizeof(*enc));
+    if (!enc) {
+        WARN_CALLOC("delta_encoder_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    enc->key_updates = key_updates ? key_updates : DELTA_KEY_UPDATES;
+    return enc;
+}
+
+static void delta_sensor_free(delta_sensor_t *sensor)
+{
+    for (unsigned i = 0; i < sensor->num_fields; ++i) {
+        free(sensor->fields[i].key);
+        free(sensor->fields[i].str);
+    }
+    free(sensor->key);
+    free(sensor->model);
+    free(sensor);
+}
+
+static void delta_schema_free(delta_encoder_t *enc)
+{
+    for (int i = 0; i < enc->num_schema; ++i)
+        free(enc->schema[i]);
+    free(enc->schema);
+    enc->schema     = NULL;
+    enc->num_schema = 0;
+}
+
+void delta_encoder_free(delta_encoder_t *enc)
+{
+    if (!enc)
+        return;
+    list_free_elems(&enc->sensors, (list_elem_free_fn)delta_sensor_free);
+    delta_schema_free(enc);
+    free(enc);
+}
+
+void delta_encoder_schema(delta_encoder_t *enc, char const *const *fields, int num_fields)
+{
+    delta_schema_free(enc);
+    if (!fields || num_fields <= 0)
+        return;
+    enc->schema = calloc((size_t)num_fields, sizeof(*enc->schema));
+    if (!enc->schema) {
+        WARN_CALLOC("delta_encoder_schema()");
+        return; // NOTE: all fields are sent on alloc failure.
+    }
+    for (int i = 0; i < num_fields; ++i) {
+        enc->schema[i] = strdup(fields[i]);
+        if (!enc->schema[i]) {
+            WARN_STRDUP("delta_encoder_schema()");
+            delta_schema_free(enc);
+            return; // NOTE: all fields are sent on alloc failure.
+        }
+        enc->num_schema++;
+    }
+}
+
+/// The position of a field in the schema, -1 if it is not sent.
+static int delta_schema_index(delta_encoder_t const *enc, char const *key)
+{
+    if (!enc->schema)
+        return INT32_MAX; // without a schema the fields are appended
+    for (int i = 0; i < enc->num_schema; ++i) {
+        if (!strcmp(enc->schema[i], key))
+            return i;
+    }
+    return -1;
+}
+
+/// The decimals of a "%.<n>f" format, the fixed default otherwise.
+static int format_decimals(char const *format)
+{
+    char const *p = format ? strchr(format, '%') : NULL;
+    if (!p)
+        return DELTA_DECIMALS;
+    p += 1 + strspn(p + 1, "-+ #0123456789");
+    if (*p != '.')
+        return DELTA_DECIMALS;
+    int decimals = atoi(p + 1);
+    return decimals > DELTA_DECIMALS_MAX ? DELTA_DECIMALS_MAX : decimals;
+}
+
+/// The text of a key value, an integer, double, or string, empty if missing.
+static void key_value_text(char *buf, size_t size, data_t const *d)
+{
+    if (d && d->type == DATA_INT)
+        snprintf(buf, size, "%d", d->value.v_int);
+    else if (d && d->type == DATA_DOUBLE)
+        snprintf(buf, size, "%g", d->value.v_dbl);
+    else if (d && d->type == DATA_STRING)
+        snprintf(buf, size, "%s", (char const *)d->value.v_ptr);
+    else
+        snprintf(buf, size, "%s", "");
+}
+
+/// Find or add the sensor of a key, NULL if the table is full.
+static delta_sensor_t *delta_sensor_get(delta_encoder_t *enc, char const *key, char const *model)
+{
+    for (void **iter = enc->sensors.elems; iter && *iter; ++iter) {
+        delta_sensor_t *sensor = *iter;
+        if (!strcmp(sensor->key, key))
+            return sensor;
+    }
+    if (enc->sensors.len >= DELTA_SENSORS_MAX) {
+        if (!enc->full)
+            fprintf(stderr, "Delta output: more than %d sensors, the events of new sensors are dropped.\n", DELTA_SENSORS_MAX);
+        enc->full = 1;
+        return NULL;
+    }
+
+    delta_sensor_t *sensor = calloc(1, sizeof(*sensor));
+    if (!sensor) {
+        WARN_CALLOC("delta_sensor_get()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    sensor->key = strdup(key);
+    if (!sensor->key) {
+        WARN_STRDUP("delta_sensor_get()");
+        delta_sensor_free(sensor);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    sensor->model = strdup(model);
+    if (!sensor->model) {
+        WARN_STRDUP("delta_sensor_get()");
+        delta_sensor_free(sensor);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    list_push(&enc->sensors, sensor);
+    return sensor;
+}
+
+/// Find or add the field of a sensor in schema order, NULL if it is not sent.
+static delta_field_t *delta_field_get(delta_encoder_t const *enc, delta_sensor_t *sensor, char const *key)
+{
+    for (unsigned i = 0; i < sensor->num_fields; ++i) {
+        if (!strcmp(sensor->fields[i].key, key))
+            return &sensor->fields[i];
+    }
+    int schema_index = delta_schema_index(enc, key);
+    if (schema_index < 0 || sensor->num_fields >= DELTA_FIELDS_MAX)
+        return NULL;
+
+    char *field_key = strdup(key);
+    if (!field_key) {
+        WARN_STRDUP("delta_field_get()");
+        return NULL; // NOTE: the field is dropped on alloc failure.
+    }
+    unsigned pos = sensor->num_fields;
+    while (pos > 0 && sensor->fields[pos - 1].schema_index > schema_index)
+        pos--;
+    memmove(&sensor->fields[pos + 1], &sensor->fields[pos], (sensor->num_fields - pos) * sizeof(*sensor->fields));
+    sensor->num_fields++;
+    sensor->fields[pos] = (delta_field_t){.key = field_key, .schema_index = schema_index};
+    // the bits of the fields moved, the receiver needs the new definition
+    sensor->defined = 0;
+    return &sensor->fields[pos];
+}
+
+void delta_encoder_add(delta_encoder_t *enc, data_t *data)
+{
+    char const *model     = NULL;
+    data_t const *id      = NULL;
+    data_t const *channel = NULL;
+    for (data_t const *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL && d->type == DATA_STRING)
+            model = d->value.v_ptr;
+        else if (d->key_id == DATA_KEY_ID)
+            id = d;
+        else if (d->key_id == DATA_KEY_CHANNEL)
+            channel = d;
+    }
+    if (!model)
+        return;
+
+    char id_text[64];
+    char channel_text[64];
+    char key[256];
+    key_value_text(id_text, sizeof(id_text), id);
+    key_value_text(channel_text, sizeof(channel_text), channel);
+    snprintf(key, sizeof(key), "%s\t%s\t%s", model, id_text, channel_text);
+    delta_sensor_t *sensor = delta_sensor_get(enc, key, model);
+    if (!sensor)
+        return;
+
+    for (data_t const *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL || d->key_id == DATA_KEY_TIME
+                || (d->type != DATA_INT && d->type != DATA_DOUBLE && d->type != DATA_STRING))
+            continue;
+        delta_field_t *field = delta_field_get(enc, sensor, d->key);
+        if (!field)
+            continue;
+        uint64_t bit = (uint64_t)1 << (field - sensor->fields);
+
+        int kind = d->type == DATA_INT ? DELTA_KIND_INT
+                : d->type == DATA_STRING ? DELTA_KIND_STRING
+                : DELTA_KIND_DOUBLE + format_decimals(d->format);
+        if (field->kind != kind) {
+            field->kind     = kind;
+            sensor->defined = 0;
+        }
+        if (kind == DELTA_KIND_STRING) {
+            char const *str = d->value.v_ptr;
+            if (field->str && !strcmp(field->str, str))
+                continue;
+            char *copy = strdup(str);
+            if (!copy) {
+                WARN_STRDUP("delta_encoder_add()");
+                continue; // NOTE: the change is dropped on alloc failure.
+            }
+            free(field->str);
+            field->str = copy;
+            sensor->changed |= bit;
+            continue;
+        }
+        if (kind == DELTA_KIND_INT)
+            field->value = d->value.v_int;
+        else
+            field->value = llround(d->value.v_dbl * pow(10.0, kind - DELTA_KIND_DOUBLE));
+        if (field->value != field->sent)
+            sensor->changed |= bit;
+        else
+            sensor->changed &= ~bit; // changed back
+    }
+}
+
+/* Frame encoding */
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len; ///< length of the encoding, also counts the bytes that did not fit
+} delta_writer_t;
+
+static void delta_varint(delta_writer_t *w, uint64_t val)
+{
+    do {
+        uint8_t byte = val & 0x7f;
+        val >>= 7;
+        if (w->len < w->size)
+            w->buf[w->len] = val ? byte | 0x80 : byte;
+        w->len++;
+    } while (val);
+}
+
+static void delta_text(delta_writer_t *w, char const *str)
+{
+    size_t len = str ? strlen(str) : 0;
+    delta_varint(w, len);
+    if (len && w->len < w->size)
+        memcpy(w->buf + w->len, str, w->size - w->len < len ? w->size - w->len : len);
+    w->len += len;
+}
+
+/// Encode the record of a sensor, returns the length or 0 if it does not fit.
+static size_t delta_sensor_encode(delta_sensor_t const *sensor, unsigned index, uint8_t *buf, size_t size)
+{
+    delta_writer_t w = {.buf = buf, .size = size};
+    uint64_t all     = sensor->num_fields < 64 ? ((uint64_t)1 << sensor->num_fields) - 1 : UINT64_MAX;
+    uint64_t mask    = sensor->defined ? sensor->changed : all;
+
+    delta_varint(&w, (uint64_t)index << 1 | !sensor->defined);
+    if (!sensor->defined) {
+        delta_text(&w, sensor->model);
+        delta_varint(&w, sensor->num_fields);
+        for (unsigned i = 0; i < sensor->num_fields; ++i) {
+            delta_text(&w, sensor->fields[i].key);
+            delta_varint(&w, (uint64_t)sensor->fields[i].kind);
+        }
+    }
+    else {
+        delta_varint(&w, mask);
+    }
+    for (unsigned i = 0; i < sensor->num_fields; ++i) {
+        delta_field_t const *field = &sensor->fields[i];
+        if (!(mask & ((uint64_t)1 << i)))
+            continue;
+        if (field->kind == DELTA_KIND_STRING) {
+            delta_text(&w, field->str);
+            continue;
+        }
+        int64_t delta = field->value - (sensor->defined ? field->sent : 0);
+        delta_varint(&w, (uint64_t)delta << 1 ^ (uint64_t)(delta >> 63)); // zigzag
+    }
+    return w.len <= size ? w.len : 0;
+}
+
+size_t delta_encoder_frame(delta_encoder_t *enc, uint8_t *buf, size_t size, time_t now)
+{
+    delta_writer_t w = {.buf = buf, .size = size};
+    delta_varint(&w, DELTA_VERSION);
+    delta_varint(&w, enc->frames);
+    delta_varint(&w, (uint64_t)now);
+    if (w.len > size)
+        return 0;
+    size_t header = w.len;
+    size_t pos    = header;
+
+    unsigned num_sensors = (unsigned)enc->sensors.len;
+    for (unsigned k = 0; k < num_sensors; ++k) {
+        unsigned index         = (enc->next + k) % num_sensors;
+        delta_sensor_t *sensor = enc->sensors.elems[index];
+        if (sensor->defined && !sensor->changed)
+            continue;
+        size_t len = delta_sensor_encode(sensor, index, buf + pos, size - pos);
+        if (!len && pos == header) {
+            if (!sensor->oversize)
+                fprintf(stderr, "Delta output: the fields of %s do not fit a frame of %zu bytes, the sensor is not sent.\n", sensor->model, size);
+            sensor->oversize = 1;
+            continue;
+        }
+        if (!len) {
+            enc->next = index; // the next frame continues with this sensor
+            break;
+        }
+        pos += len;
+        for (unsigned i = 0; i < sensor->num_fields; ++i)
+            sensor->fields[i].sent = sensor->fields[i].value;
+        sensor->updates = sensor->defined ? sensor->updates + 1 : 0;
+        sensor->changed = 0;
+        // define the sensor again with the next frame after a few updates
+        sensor->defined = sensor->updates + 1 < enc->key_updates;
+    }
+    if (pos == header)
+        return 0;
+    enc->frames++;
+    return pos;
+}
+
+size_t delta_encoder_memory(delta_encoder_t const *enc)
+{
+    if (!enc)
+        return 0;
+    size_t size = sizeof(*enc) + enc->sensors.size * sizeof(*enc->sensors.elems);
+    for (int i = 0; i < enc->num_schema; ++i)
+        size += sizeof(*enc->schema) + strlen(enc->schema[i]) + 1;
+    for (void **iter = enc->sensors.elems; iter && *iter; ++iter) {
+        delta_sensor_t const *sensor = *iter;
+        size += sizeof(*sensor) + strlen(sensor->key) + strlen(sensor->model) + 2;
+        for (unsigned i = 0; i < sensor->num_fields; ++i) {
+            size += strlen(sensor->fields[i].key) + 1;
+            if (sensor->fields[i].str)
+                size += strlen(sensor->fields[i].str) + 1;
+        }
+    }
+    return size;
+}
+
+/* Delta printer */
+
+typedef struct {
+    struct data_output output;
+    delta_encoder_t *enc;
+    delta_sink_fn sink;
+    delta_sink_free_fn sink_free;
+    void *ctx;
+    unsigned interval;
+    size_t mtu;
+    time_t next_frame; ///< the time of the next frame
+    uint8_t *buf;
+} data_output_delta_t;
+
+static void R_API_CALLCONV print_delta_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    data_output_delta_t *delta = (data_output_delta_t *)output;
+
+    delta_encoder_add(delta->enc, data);
+}
+
+static void R_API_CALLCONV data_output_delta_start(data_output_t *output, char const *const *fields, int num_fields)
+{
+    data_output_delta_t *delta = (data_output_delta_t *)output;
+
+    delta_encoder_schema(delta->enc, fields, num_fields);
+}
+
+/// Encode and send a frame of the changes, if any.
+static void data_output_delta_send(data_output_delta_t *delta, time_t now)
+{
+    size_t len = delta_encoder_frame(delta->enc, delta->buf, delta->mtu, now);
+    if (len)
+        delta->sink(delta->ctx, delta->buf, len);
+}
+
+static void R_API_CALLCONV data_output_delta_sync(data_output_t *output, int force)
+{
+    // a forced sync does not send early, the frames keep to the budget of the uplink
+    UNUSED(force);
+    data_output_delta_t *delta = (data_output_delta_t *)output;
+
+    time_t now = time(NULL);
+    if (now < delta->next_frame)
+        return;
+    delta->next_frame = now + delta->interval;
+    data_output_delta_send(delta, now);
+}
+
+static size_t R_API_CALLCONV data_output_delta_memory(data_output_t *output)
+{
+    data_output_delta_t *delta = (data_output_delta_t *)output;
+
+    return sizeof(*delta) + delta->mtu + delta_encoder_memory(delta->enc);
+}
+
+static void R_API_CALLCONV data_output_delta_free(data_output_t *output)
+{
+    data_output_delta_t *delta = (data_output_delta_t *)output;
+
+    if (!delta)
+        return;
+
+    // the last changes are sent at exit
+    data_output_delta_send(delta, time(NULL));
+    if (delta->sink_free)
+        delta->sink_free(delta->ctx);
+    delta_encoder_free(delta->enc);
+    free(delta->buf);
+    free(delta);
+}
+
+struct data_output *data_output_delta_create(delta_output_opts_t const *opts, delta_sink_fn sink, delta_sink_free_fn sink_free, void *ctx)
+{
+    data_output_delta_t *delta = calloc(1, sizeof(data_output_delta_t));
+    if (!delta) {
+        WARN_CALLOC("data_output_delta_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    delta->mtu = opts->mtu ? opts->mtu : DELTA_MTU;
+    delta->buf = malloc(delta->mtu);
+    if (!delta->buf) {
+        WARN_MALLOC("data_output_delta_create()");
+        free(delta);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    delta->enc = delta_encoder_create(opts->key_updates);
+    if (!delta->enc) {
+        free(delta->buf);
+        free(delta);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+
+    delta->output.print_data    = print_delta_data;
+    delta->output.output_start  = data_output_delta_start;
+    delta->output.output_sync   = data_output_delta_sync;
+    delta->output.output_memory = data_output_delta_memory;
+    delta->output.output_free   = data_output_delta_free;
+    delta->sink                 = sink;
+    delta->sink_free            = sink_free;
+    delta->ctx                  = ctx;
+    delta->interval             = opts->interval ? opts->interval : DELTA_INTERVAL;
+    delta->next_frame           = time(NULL) + delta->interval;
+
+    return &delta->output;
+}
+
+/* File and serial port sink */
+
+static void delta_file_write(void *ctx, uint8_t const *frame, size_t len)
+{
+    FILE *file = ctx;
+
+    // a stream is framed by the length of each frame
+    uint8_t prefix[10];
+    delta_writer_t w = {.buf = prefix, .size = sizeof(prefix)};
+    delta_varint(&w, len);
+    fwrite(prefix, 1, w.len, file);
+    fwrite(frame, 1, len, file);
+    fflush(file);
+}
+
+static void delta_file_close(void *ctx)
+{
+    FILE *file = ctx;
+
+    if (file && file != stdout && file != stderr)
+        fclose(file);
+}
+
+struct data_output *data_output_delta_file_create(FILE *file, delta_output_opts_t const *opts)
+{
+    return data_output_delta_create(opts, delta_file_write, delta_file_close, file);
+}
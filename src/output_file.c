@@ -12,6 +12,8 @@
 #include "output_file.h"
 
 #include "data.h"
+#include "output_cbor.h"
+#include "format_double.h"
 #include "term_ctl.h"
 #include "r_util.h"
 #include "fatal.h"
@@ -20,94 +22,208 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
 
-/* JSON printer */
+#ifdef _WIN32
+#include <io.h>
+#define fsync(fd) _commit(fd)
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
+
+/* Batched file writes */
 
+/// Flush state of a file output, batches the writes of several events.
 typedef struct {
-    struct data_output output;
-    FILE *file;
-} data_output_json_t;
+    file_flush_policy_t policy;
+    char *buf;       ///< file buffer of policy.bytes size, NULL for the default buffer
+    unsigned events; ///< events written since the last flush
+    time_t last;     ///< time of the last flush
+} file_flush_t;
 
-static void R_API_CALLCONV print_json_array(data_output_t *output, data_array_t *array, char const *format)
+static void file_flush_write(FILE *file, file_flush_t *flush, time_t now)
 {
-    data_output_json_t *json = (data_output_json_t *)output;
+    fflush(file);
+    if (flush->policy.sync)
+        fsync(fileno(file));
+    flush->events = 0;
+    flush->last   = now;
+}
 
-    fprintf(json->file, "[");
-    for (int c = 0; c < array->num_values; ++c) {
-        if (c)
-            fprintf(json->file, ", ");
-        print_array_value(output, array, format, c);
+static int file_flush_due(file_flush_t const *flush, time_t now)
+{
+    file_flush_policy_t const *policy = &flush->policy;
+    if (!policy->events && !policy->secs)
+        return !policy->bytes; // a full buffer is written out by stdio
+    return (policy->events && flush->events >= policy->events)
+            || (policy->secs && now - flush->last >= (time_t)policy->secs);
+}
+
+/// Events were written, flush the file if the policy is due.
+static void file_flush_check(FILE *file, file_flush_t *flush)
+{
+    if (!flush->policy.events && !flush->policy.secs && !flush->policy.bytes) {
+        file_flush_write(file, flush, 0); // no batching, skip the clock
+        return;
     }
-    fprintf(json->file, "]");
+    time_t now = time(NULL);
+    if (file_flush_due(flush, now))
+        file_flush_write(file, flush, now);
 }
 
-static void R_API_CALLCONV print_json_data(data_output_t *output, data_t *data, char const *format)
+/// An event was written, flush the file if the policy is due, in a batch only at the end, see file_flush_check().
+static void file_flush_event(FILE *file, file_flush_t *flush, int batch)
 {
-    UNUSED(format);
-    data_output_json_t *json = (data_output_json_t *)output;
+    flush->events++;
+    if (!batch)
+        file_flush_check(file, flush);
+}
 
-    bool separator = false;
-    fputc('{', json->file);
-    while (data) {
-        if (separator)
-            fprintf(json->file, ", ");
-        output->print_string(output, data->key, NULL);
-        fprintf(json->file, " : ");
-        print_value(output, data->type, data->value, data->format);
-        separator = true;
-        data = data->next;
+static void file_flush_sync(FILE *file, file_flush_t *flush, int force)
+{
+    time_t now = time(NULL);
+    if (file && flush->events && (force || file_flush_due(flush, now)))
+        file_flush_write(file, flush, now);
+}
+
+static void file_flush_setup(FILE *file, file_flush_t *flush, file_flush_policy_t const *policy)
+{
+    flush->policy = *policy;
+    flush->last   = time(NULL);
+    if (!file || (!policy->events && !policy->secs && !policy->bytes))
+        return;
+
+    if (policy->bytes && file != stdout && file != stderr) {
+        flush->buf = malloc(policy->bytes);
+        if (!flush->buf)
+            WARN_MALLOC("data_output_file_policy()");
     }
-    fputc('}', json->file);
+    // full buffering, a tty would be line buffered
+    setvbuf(file, flush->buf, _IOFBF, flush->buf ? policy->bytes : BUFSIZ);
 }
 
-static void R_API_CALLCONV print_json_string(data_output_t *output, const char *str, char const *format)
+/// Write out the pending events and close the file, the buffer must not outlive the file.
+static void file_flush_close(FILE *file, file_flush_t *flush)
 {
-    UNUSED(format);
-    data_output_json_t *json = (data_output_json_t *)output;
+    if (file) {
+        file_flush_sync(file, flush, 1);
+        if (file != stdout && file != stderr)
+            fclose(file);
+    }
+    free(flush->buf);
+}
 
-    size_t str_len = strlen(str);
-    if (str[0] == '{' && str[str_len - 1] == '}') {
-        // Print embedded JSON object verbatim
-        fprintf(json->file, "%s", str);
-        return;
+/* Row buffers */
+
+/// A text buffer that grows to the longest row, a row is assembled and then written with one call.
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t size;
+} row_buf_t;
+
+/// Make room for len more chars and a terminator.
+static int row_reserve(row_buf_t *row, size_t len)
+{
+    if (row->len + len < row->size)
+        return 1;
+    size_t size = row->size ? row->size : 256;
+    while (row->len + len >= size) {
+        size *= 2;
+    }
+    char *buf = realloc(row->buf, size);
+    if (!buf) {
+        WARN_REALLOC("row_reserve()");
+        return 0; // NOTE: truncates the row on alloc failure.
     }
+    row->buf  = buf;
+    row->size = size;
+    return 1;
+}
 
-    fprintf(json->file, "\"");
-    for (; *str; ++str) {
-        if (*str == '\r') {
-            fprintf(json->file, "\\r");
-        }
-        else if (*str == '\n') {
-            fprintf(json->file, "\\n");
-        }
-        else if (*str == '\t') {
-            fprintf(json->file, "\\t");
-        }
-        else if (*str == '"' || *str == '\\') {
-            fputc('\\', json->file);
-            fputc(*str, json->file);
-        }
-        else {
-            fputc(*str, json->file);
-        }
+static void row_append(row_buf_t *row, char const *str, size_t len)
+{
+    if (!row_reserve(row, len))
+        return;
+    memcpy(row->buf + row->len, str, len);
+    row->len += len;
+}
+
+/// Append the text of a format, returns the length.
+static int row_printf(row_buf_t *row, char const *format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+        __attribute__((format(printf, 2, 3)))
+#endif
+        ;
+
+static int row_printf(row_buf_t *row, char const *format, ...)
+{
+    char buf[64];
+    va_list ap;
+    va_start(ap, format);
+    int len = vsnprintf(buf, sizeof(buf), format, ap);
+    va_end(ap);
+    if (len < 0)
+        return 0;
+    if ((size_t)len < sizeof(buf)) {
+        row_append(row, buf, (size_t)len);
+        return len;
     }
-    fprintf(json->file, "\"");
+    if (!row_reserve(row, (size_t)len))
+        return 0;
+    va_start(ap, format);
+    vsnprintf(row->buf + row->len, (size_t)len + 1, format, ap);
+    va_end(ap);
+    row->len += (size_t)len;
+    return len;
 }
 
-static void R_API_CALLCONV print_json_double(data_output_t *output, double data, char const *format)
+/// Append a double with a single double conversion, returns the length.
+static int row_double(row_buf_t *row, char const *format, double value)
 {
-    UNUSED(format);
-    data_output_json_t *json = (data_output_json_t *)output;
+    if (!row_reserve(row, FORMAT_DOUBLE_BUFLEN))
+        return 0;
+    int len = format_double(row->buf + row->len, row->size - row->len, format, value);
+    if (len < 0)
+        return 0;
+    if ((size_t)len >= row->size - row->len) {
+        if (!row_reserve(row, (size_t)len))
+            return 0;
+        format_double(row->buf + row->len, row->size - row->len, format, value);
+    }
+    row->len += (size_t)len;
+    return len;
+}
 
-    fprintf(json->file, "%.3f", data);
+/// Write the row with one call and clear it.
+static void row_write(row_buf_t *row, FILE *file)
+{
+    fwrite(row->buf, 1, row->len, file);
+    row->len = 0;
 }
 
-static void R_API_CALLCONV print_json_int(data_output_t *output, int data, char const *format)
+/* JSON printer */
+
+typedef struct {
+    struct data_output output;
+    FILE *file;
+    file_flush_t flush;
+    data_buf_t buf; ///< serialization buffer, grows to the largest event
+} data_output_json_t;
+
+static void R_API_CALLCONV print_json_data(data_output_t *output, data_t *data, char const *format)
 {
     UNUSED(format);
     data_output_json_t *json = (data_output_json_t *)output;
 
-    fprintf(json->file, "%d", data);
+    size_t len;
+    if (data_print_json_spaced(data, &json->buf, &len) && data_buf_reserve(&json->buf, len + 2)) {
+        json->buf.buf[len++] = '\n';
+        fwrite(json->buf.buf, 1, len, json->file); // one write for the event
+    }
 }
 
 static void R_API_CALLCONV print_json_flush(data_output_t *output)
@@ -115,16 +231,35 @@ static void R_API_CALLCONV print_json_flush(data_output_t *output)
     data_output_json_t *json = (data_output_json_t *)output;
 
     if (json && json->file) {
-        fputc('\n', json->file);
-        fflush(json->file);
+        file_flush_event(json->file, &json->flush, output->batch);
     }
 }
 
+static void R_API_CALLCONV print_json_sync(data_output_t *output, int force)
+{
+    data_output_json_t *json = (data_output_json_t *)output;
+
+    file_flush_sync(json->file, &json->flush, force);
+}
+
+static void R_API_CALLCONV print_json_batch(data_output_t *output, unsigned num_events)
+{
+    UNUSED(num_events);
+    data_output_json_t *json = (data_output_json_t *)output;
+
+    if (json->file)
+        file_flush_check(json->file, &json->flush);
+}
+
 static void R_API_CALLCONV data_output_json_free(data_output_t *output)
 {
+    data_output_json_t *json = (data_output_json_t *)output;
+
     if (!output)
         return;
 
+    file_flush_close(json->file, &json->flush);
+    data_buf_free(&json->buf);
     free(output);
 }
 
@@ -137,11 +272,9 @@ struct data_output *data_output_json_create(FILE *file)
     }
 
     json->output.print_data   = print_json_data;
-    json->output.print_array  = print_json_array;
-    json->output.print_string = print_json_string;
-    json->output.print_double = print_json_double;
-    json->output.print_int    = print_json_int;
     json->output.output_flush = print_json_flush;
+    json->output.output_sync  = print_json_sync;
+    json->output.output_batch = print_json_batch;
     json->output.output_free  = data_output_json_free;
     json->file                = file;
 
@@ -150,40 +283,35 @@ struct data_output *data_output_json_create(FILE *file)
 
 /* Pretty Key-Value printer */
 
-static int kv_color_for_key(char const *key)
-{
-    if (!key || !*key)
-        return TERM_COLOR_RESET;
-    if (!strcmp(key, "tag") || !strcmp(key, "time"))
-        return TERM_COLOR_BLUE;
-    if (!strcmp(key, "model") || !strcmp(key, "type") || !strcmp(key, "id"))
-        return TERM_COLOR_RED;
-    if (!strcmp(key, "mic"))
-        return TERM_COLOR_CYAN;
-    if (!strcmp(key, "mod") || !strcmp(key, "freq") || !strcmp(key, "freq1") || !strcmp(key, "freq2"))
-        return TERM_COLOR_MAGENTA;
-    if (!strcmp(key, "rssi") || !strcmp(key, "snr") || !strcmp(key, "noise"))
-        return TERM_COLOR_YELLOW;
-    return TERM_COLOR_GREEN;
-}
-
-static int kv_break_before_key(char const *key)
-{
-    if (!key || !*key)
-        return 0;
-    if (!strcmp(key, "model") || !strcmp(key, "mod") || !strcmp(key, "rssi") || !strcmp(key, "codes"))
-        return 1;
-    return 0;
-}
-
-static int kv_break_after_key(char const *key)
-{
-    if (!key || !*key)
-        return 0;
-    if (!strcmp(key, "id") || !strcmp(key, "mic"))
-        return 1;
-    return 0;
-}
+/// The layout of a well-known key.
+static struct kv_key_layout {
+    term_color_t color;
+    char break_before; ///< break the line before the key
+    char break_after;  ///< force a break after the key
+} const kv_key_layouts[DATA_KEY_COUNT] = {
+        [DATA_KEY_NONE]          = {TERM_COLOR_GREEN, 0, 0},
+        [DATA_KEY_TIME]          = {TERM_COLOR_BLUE, 0, 0},
+        [DATA_KEY_TAG]           = {TERM_COLOR_BLUE, 0, 0},
+        [DATA_KEY_MODEL]         = {TERM_COLOR_RED, 1, 0},
+        [DATA_KEY_TYPE]          = {TERM_COLOR_RED, 0, 0},
+        [DATA_KEY_SUBTYPE]       = {TERM_COLOR_GREEN, 0, 0},
+        [DATA_KEY_ID]            = {TERM_COLOR_RED, 0, 1},
+        [DATA_KEY_CHANNEL]       = {TERM_COLOR_GREEN, 0, 0},
+        [DATA_KEY_BATTERY_OK]    = {TERM_COLOR_GREEN, 0, 0},
+        [DATA_KEY_TEMPERATURE_C] = {TERM_COLOR_GREEN, 0, 0},
+        [DATA_KEY_TEMPERATURE_F] = {TERM_COLOR_GREEN, 0, 0},
+        [DATA_KEY_HUMIDITY]      = {TERM_COLOR_GREEN, 0, 0},
+        [DATA_KEY_MIC]           = {TERM_COLOR_CYAN, 0, 1},
+        [DATA_KEY_MOD]           = {TERM_COLOR_MAGENTA, 1, 0},
+        [DATA_KEY_FREQ]          = {TERM_COLOR_MAGENTA, 0, 0},
+        [DATA_KEY_FREQ1]         = {TERM_COLOR_MAGENTA, 0, 0},
+        [DATA_KEY_FREQ2]         = {TERM_COLOR_MAGENTA, 0, 0},
+        [DATA_KEY_RSSI]          = {TERM_COLOR_YELLOW, 1, 0},
+        [DATA_KEY_SNR]           = {TERM_COLOR_YELLOW, 0, 0},
+        [DATA_KEY_NOISE]         = {TERM_COLOR_YELLOW, 0, 0},
+        [DATA_KEY_MSG]           = {TERM_COLOR_GREEN, 0, 0},
+        [DATA_KEY_CODES]         = {TERM_COLOR_GREEN, 1, 0},
+};
 
 typedef struct {
     struct data_output output;
@@ -192,11 +320,28 @@ typedef struct {
     int color;
     int ring_bell;
     int term_width;
+    time_t width_time; ///< time the term width was last queried
     int data_recursion;
     int column;
+    row_buf_t row; ///< the event, written with one call
+    file_flush_t flush;
 } data_output_kv_t;
 
 #define KV_SEP "_ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ _ "
+#define KV_PAD "                          "
+
+static void kv_set_fg(data_output_kv_t *kv, term_color_t color)
+{
+    char escape[TERM_ESCAPE_MAX];
+    int len = term_fg_escape(color, escape);
+    if (len) {
+        row_append(&kv->row, escape, (size_t)len);
+        return;
+    }
+    // the console sets colors with calls, write out the text so far
+    row_write(&kv->row, kv->file);
+    term_set_fg(kv->term, color);
+}
 
 static void R_API_CALLCONV print_kv_data(data_output_t *output, data_t *data, char const *format)
 {
@@ -208,55 +353,70 @@ static void R_API_CALLCONV print_kv_data(data_output_t *output, data_t *data, ch
 
     // top-level: update width and print separator
     if (!kv->data_recursion) {
-        kv->term_width = term_get_columns(kv->term); // update current term width
-        if (color)
-            term_set_fg(kv->term, TERM_COLOR_BLACK);
+        time_t now = time(NULL);
+        if (now != kv->width_time) {
+            kv->term_width = term_get_columns(kv->term); // update current term width
+            kv->width_time = now;
+        }
         if (ring_bell)
             term_ring_bell(kv->term);
-        char sep[] = KV_SEP KV_SEP KV_SEP KV_SEP;
+        if (color)
+            kv_set_fg(kv, TERM_COLOR_BLACK);
+        char const sep[] = KV_SEP KV_SEP KV_SEP KV_SEP;
+        size_t sep_len   = sizeof(sep) - 1;
         if (kv->term_width < (int)sizeof(sep))
-            sep[kv->term_width > 0 ? kv->term_width - 1 : 40] = '\0';
-        fprintf(kv->file, "%s\n", sep);
+            sep_len = kv->term_width > 0 ? (size_t)kv->term_width - 1 : 40;
+        row_append(&kv->row, sep, sep_len);
+        row_append(&kv->row, "\n", 1);
         if (color)
-            term_set_fg(kv->term, TERM_COLOR_RESET);
+            kv_set_fg(kv, TERM_COLOR_RESET);
     }
     // nested data object: break before
     else {
         if (color)
-            term_set_fg(kv->term, TERM_COLOR_RESET);
-        fprintf(kv->file, "\n");
+            kv_set_fg(kv, TERM_COLOR_RESET);
+        row_append(&kv->row, "\n", 1);
         kv->column = 0;
     }
 
     ++kv->data_recursion;
     while (data) {
+        struct kv_key_layout const *layout = &kv_key_layouts[data->key_id];
         // break before some known keys
-        if (kv->column > 0 && kv_break_before_key(data->key)) {
-            fprintf(kv->file, "\n");
+        if (kv->column > 0 && layout->break_before) {
+            row_append(&kv->row, "\n", 1);
             kv->column = 0;
         }
         // break if not enough width left
         else if (kv->column >= kv->term_width - 26) {
-            fprintf(kv->file, "\n");
+            row_append(&kv->row, "\n", 1);
             kv->column = 0;
         }
         // pad to next alignment if there is enough width left
         else if (kv->column > 0 && kv->column < kv->term_width - 26) {
-            kv->column += fprintf(kv->file, "%*s", 25 - kv->column % 26, " ");
+            int pad = 25 - kv->column % 26;
+            pad     = pad > 0 ? pad : 1;
+            row_append(&kv->row, KV_PAD, (size_t)pad);
+            kv->column += pad;
         }
 
-        // print key
-        char *key = *data->pretty_key ? data->pretty_key : data->key;
-        kv->column += fprintf(kv->file, "%-10s: ", key);
+        // print key, padded to 10 chars
+        char const *key = *data->pretty_key ? data->pretty_key : data->key;
+        size_t key_len  = strlen(key);
+        row_append(&kv->row, key, key_len);
+        if (key_len < 10)
+            row_append(&kv->row, KV_PAD, 10 - key_len);
+        row_append(&kv->row, ": ", 2);
+        kv->column += (int)(key_len < 10 ? 10 : key_len) + 2;
         // print value
         if (color)
-            term_set_fg(kv->term, kv_color_for_key(data->key));
+            kv_set_fg(kv, *data->key ? layout->color : TERM_COLOR_RESET);
         print_value(output, data->type, data->value, data->format);
         if (color)
-            term_set_fg(kv->term, TERM_COLOR_RESET);
+            kv_set_fg(kv, TERM_COLOR_RESET);
 
         // force break after some known keys
-        if (kv->column > 0 && kv_break_after_key(data->key)) {
+        if (kv->column > 0 && layout->break_after) {
             kv->column = kv->term_width; // force break;
         }
 
@@ -278,7 +438,7 @@ static void R_API_CALLCONV print_kv_array(data_output_t *output, data_array_t *a
     //fprintf(kv->file, "[ ");
     for (int c = 0; c < array->num_values; ++c) {
         if (c)
-            fprintf(kv->file, ", ");
+            row_append(&kv->row, ", ", 2);
         print_array_value(output, array, format, c);
     }
     //fprintf(kv->file, " ]");
@@ -288,21 +448,27 @@ static void R_API_CALLCONV print_kv_double(data_output_t *output, double data, c
 {
     data_output_kv_t *kv = (data_output_kv_t *)output;
 
-    kv->column += fprintf(kv->file, format ? format : "%.3f", data);
+    kv->column += row_double(&kv->row, format ? format : "%.3f", data);
 }
 
 static void R_API_CALLCONV print_kv_int(data_output_t *output, int data, char const *format)
 {
     data_output_kv_t *kv = (data_output_kv_t *)output;
 
-    kv->column += fprintf(kv->file, format ? format : "%d", data);
+    kv->column += row_printf(&kv->row, format ? format : "%d", data);
 }
 
 static void R_API_CALLCONV print_kv_string(data_output_t *output, const char *data, char const *format)
 {
     data_output_kv_t *kv = (data_output_kv_t *)output;
 
-    kv->column += fprintf(kv->file, format ? format : "%s", data);
+    if (!format) {
+        size_t len = strlen(data);
+        row_append(&kv->row, data, len);
+        kv->column += (int)len;
+        return;
+    }
+    kv->column += row_printf(&kv->row, format, data);
 }
 
 static void R_API_CALLCONV print_kv_flush(data_output_t *output)
@@ -310,11 +476,28 @@ static void R_API_CALLCONV print_kv_flush(data_output_t *output)
     data_output_kv_t *kv = (data_output_kv_t *)output;
 
     if (kv && kv->file) {
-        fputc('\n', kv->file);
-        fflush(kv->file);
+        row_append(&kv->row, "\n", 1);
+        row_write(&kv->row, kv->file); // one write for the event
+        file_flush_event(kv->file, &kv->flush, output->batch);
     }
 }
 
+static void R_API_CALLCONV print_kv_sync(data_output_t *output, int force)
+{
+    data_output_kv_t *kv = (data_output_kv_t *)output;
+
+    file_flush_sync(kv->file, &kv->flush, force);
+}
+
+static void R_API_CALLCONV print_kv_batch(data_output_t *output, unsigned num_events)
+{
+    UNUSED(num_events);
+    data_output_kv_t *kv = (data_output_kv_t *)output;
+
+    if (kv->file)
+        file_flush_check(kv->file, &kv->flush);
+}
+
 static void R_API_CALLCONV data_output_kv_free(data_output_t *output)
 {
     data_output_kv_t *kv = (data_output_kv_t *)output;
@@ -325,6 +508,8 @@ static void R_API_CALLCONV data_output_kv_free(data_output_t *output)
     if (kv->color)
         term_free(kv->term);
 
+    file_flush_close(kv->file, &kv->flush);
+    free(kv->row.buf);
     free(output);
 }
 struct data_output *data_output_kv_create(FILE *file)
@@ -341,6 +526,8 @@ struct data_output *data_output_kv_create(FILE *file)
     kv->output.print_double = print_kv_double;
     kv->output.print_int    = print_kv_int;
     kv->output.output_flush = print_kv_flush;
+    kv->output.output_sync  = print_kv_sync;
+    kv->output.output_batch = print_kv_batch;
     kv->output.output_free  = data_output_kv_free;
     kv->file                = file;
 
@@ -354,28 +541,63 @@ struct data_output *data_output_kv_create(FILE *file)
 
 /* CSV printer; doesn't really support recursive data objects yet */
 
+/// A column of a field that is not a well-known key.
+struct csv_column {
+    char const *key; ///< NULL for a free slot
+    uint32_t hash;
+    int index;
+};
+
 typedef struct {
     struct data_output output;
     FILE *file;
     const char **fields;
+    int num_fields;
+    int key_columns[DATA_KEY_COUNT]; ///< the column of each well-known key, -1 for none
+    unsigned mask;                   ///< number of slots minus one, a power of two minus one
+    struct csv_column *columns;      ///< the columns of the other keys, an open addressing hash set
+    data_t const **cells;            ///< the field of each column in the current row
+    row_buf_t row;
     int data_recursion;
     const char *separator;
+    file_flush_t flush;
 } data_output_csv_t;
 
+static uint32_t csv_hash_key(char const *key)
+{
+    uint32_t hash = 2166136261u;
+    for (; *key; ++key) {
+        hash = (hash ^ (unsigned char)*key) * 16777619u; // FNV-1a
+    }
+    return hash;
+}
+
+/// The column of a field, -1 if the field is not output.
+static int csv_column(data_output_csv_t const *csv, data_t const *d)
+{
+    if (d->key_id)
+        return csv->key_columns[d->key_id];
+    uint32_t hash = csv_hash_key(d->key);
+    for (unsigned i = hash & csv->mask;; i = (i + 1) & csv->mask) {
+        struct csv_column const *column = &csv->columns[i];
+        if (!column->key)
+            return -1;
+        if (column->hash == hash && !strcmp(column->key, d->key))
+            return column->index;
+    }
+}
+
 static void R_API_CALLCONV print_csv_data(data_output_t *output, data_t *data, char const *format)
 {
     UNUSED(format);
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
-    const char **fields = csv->fields;
-    int i;
-
-    if (csv->data_recursion)
+    if (csv->data_recursion || !csv->cells)
         return;
 
     int regular = 0; // skip "states" output
     for (data_t *d = data; d; d = d->next) {
-        if (!strcmp(d->key, "msg") || !strcmp(d->key, "codes") || !strcmp(d->key, "model")) {
+        if (d->key_id == DATA_KEY_MSG || d->key_id == DATA_KEY_CODES || d->key_id == DATA_KEY_MODEL) {
             regular = 1;
             break;
         }
@@ -383,18 +605,26 @@ static void R_API_CALLCONV print_csv_data(data_output_t *output, data_t *data, c
     if (!regular)
         return;
 
+    // place each field in its column, the first of duplicate keys wins
+    int last = -1;
+    for (data_t *d = data; d; d = d->next) {
+        int i = csv_column(csv, d);
+        if (i >= 0 && !csv->cells[i]) {
+            csv->cells[i] = d;
+            last = i > last ? i : last;
+        }
+    }
+
+    size_t sep_len = strlen(csv->separator);
     ++csv->data_recursion;
-    for (i = 0; fields[i]; ++i) {
-        const char *key = fields[i];
-        data_t *found = NULL;
+    for (int i = 0; i < csv->num_fields; ++i) {
         if (i)
-            fprintf(csv->file, "%s", csv->separator);
-        for (data_t *iter = data; !found && iter; iter = iter->next)
-            if (strcmp(iter->key, key) == 0)
-                found = iter;
-
-        if (found)
+            row_append(&csv->row, csv->separator, sep_len);
+        data_t const *found = i <= last ? csv->cells[i] : NULL;
+        if (found) {
             print_value(output, found->type, found->value, found->format);
+            csv->cells[i] = NULL;
+        }
     }
     --csv->data_recursion;
 }
@@ -405,7 +635,7 @@ static void R_API_CALLCONV print_csv_array(data_output_t *output, data_array_t *
 
     for (int c = 0; c < array->num_values; ++c) {
         if (c)
-            fprintf(csv->file, ";");
+            row_append(&csv->row, ";", 1);
         print_array_value(output, array, format, c);
     }
 }
@@ -416,10 +646,14 @@ static void R_API_CALLCONV print_csv_string(data_output_t *output, const char *s
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
     while (*str) {
-        if (strncmp(str, csv->separator, strlen(csv->separator)) == 0)
-            fputc('\\', csv->file);
-        fputc(*str, csv->file);
-        ++str;
+        char const *next = strstr(str, csv->separator);
+        size_t len       = next ? (size_t)(next - str) : strlen(str);
+        row_append(&csv->row, str, len);
+        if (!next)
+            break;
+        row_append(&csv->row, "\\", 1);
+        row_append(&csv->row, next, 1);
+        str = next + 1;
     }
 }
 
@@ -428,6 +662,48 @@ static int compare_strings(const void *a, const void *b)
     return strcmp(*(char **)a, *(char **)b);
 }
 
+/// Index the column of each field and allocate the cells of a row.
+static int data_output_csv_index(data_output_csv_t *csv)
+{
+    unsigned size = 8;
+    while (size < 2 * (unsigned)csv->num_fields) {
+        size *= 2;
+    }
+    csv->mask    = size - 1;
+    csv->columns = calloc(size, sizeof(*csv->columns));
+    if (!csv->columns) {
+        WARN_CALLOC("data_output_csv_start()");
+        return 0;
+    }
+    csv->cells = calloc(csv->num_fields + 1, sizeof(*csv->cells)); // '+ 1' so we never alloc size 0
+    if (!csv->cells) {
+        WARN_CALLOC("data_output_csv_start()");
+        free(csv->columns);
+        csv->columns = NULL;
+        return 0;
+    }
+
+    for (int i = 0; i < DATA_KEY_COUNT; ++i) {
+        csv->key_columns[i] = -1;
+    }
+    for (int i = 0; i < csv->num_fields; ++i) {
+        int key_id = data_key_lookup(csv->fields[i]);
+        if (key_id) {
+            csv->key_columns[key_id] = i;
+            continue;
+        }
+        uint32_t hash             = csv_hash_key(csv->fields[i]);
+        struct csv_column *column = &csv->columns[hash & csv->mask];
+        while (column->key) {
+            column = &csv->columns[(column - csv->columns + 1) & csv->mask];
+        }
+        column->key   = csv->fields[i];
+        column->hash  = hash;
+        column->index = i;
+    }
+    return 1;
+}
+
 static void R_API_CALLCONV data_output_csv_start(struct data_output *output, char const *const *fields, int num_fields)
 {
     data_output_csv_t *csv = (data_output_csv_t *)output;
@@ -493,6 +769,14 @@ static void R_API_CALLCONV data_output_csv_start(struct data_output *output, cha
     free((void *)allowed);
     free(use_count);
 
+    csv->num_fields = csv_fields;
+    if (!data_output_csv_index(csv)) {
+        free((void *)csv->fields);
+        csv->fields     = NULL;
+        csv->num_fields = 0;
+        return; // NOTE: outputs nothing on alloc failure.
+    }
+
     // Output the CSV header
     for (i = 0; csv->fields[i]; ++i) {
         fprintf(csv->file, "%s%s", i > 0 ? csv->separator : "", csv->fields[i]);
@@ -513,7 +797,7 @@ static void R_API_CALLCONV print_csv_double(data_output_t *output, double data,
     UNUSED(format);
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
-    fprintf(csv->file, "%.3f", data);
+    row_double(&csv->row, "%.3f", data);
 }
 
 static void R_API_CALLCONV print_csv_int(data_output_t *output, int data, char const *format)
@@ -521,7 +805,7 @@ static void R_API_CALLCONV print_csv_int(data_output_t *output, int data, char c
     UNUSED(format);
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
-    fprintf(csv->file, "%d", data);
+    row_printf(&csv->row, "%d", data);
 }
 
 static void R_API_CALLCONV print_csv_flush(data_output_t *output)
@@ -529,16 +813,37 @@ static void R_API_CALLCONV print_csv_flush(data_output_t *output)
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
     if (csv && csv->file) {
-        fputc('\n', csv->file);
-        fflush(csv->file);
+        row_append(&csv->row, "\n", 1);
+        row_write(&csv->row, csv->file);
+        file_flush_event(csv->file, &csv->flush, output->batch);
     }
 }
 
+static void R_API_CALLCONV print_csv_sync(data_output_t *output, int force)
+{
+    data_output_csv_t *csv = (data_output_csv_t *)output;
+
+    file_flush_sync(csv->file, &csv->flush, force);
+}
+
+static void R_API_CALLCONV print_csv_batch(data_output_t *output, unsigned num_events)
+{
+    UNUSED(num_events);
+    data_output_csv_t *csv = (data_output_csv_t *)output;
+
+    if (csv->file)
+        file_flush_check(csv->file, &csv->flush);
+}
+
 static void R_API_CALLCONV data_output_csv_free(data_output_t *output)
 {
     data_output_csv_t *csv = (data_output_csv_t *)output;
 
+    file_flush_close(csv->file, &csv->flush);
     free((void *)csv->fields);
+    free(csv->columns);
+    free((void *)csv->cells);
+    free(csv->row.buf);
     free(csv);
 }
 
@@ -557,8 +862,116 @@ struct data_output *data_output_csv_create(FILE *file)
     csv->output.print_int    = print_csv_int;
     csv->output.output_start = data_output_csv_start;
     csv->output.output_flush = print_csv_flush;
+    csv->output.output_sync  = print_csv_sync;
+    csv->output.output_batch = print_csv_batch;
     csv->output.output_free  = data_output_csv_free;
     csv->file                = file;
 
     return &csv->output;
 }
+
+/* CBOR printer */
+
+typedef struct {
+    struct data_output output;
+    FILE *file;
+    file_flush_t flush;
+    uint8_t *buf; ///< encoding buffer, grows to the largest event
+    size_t size;
+} data_output_cbor_t;
+
+static void R_API_CALLCONV print_cbor_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    data_output_cbor_t *cbor = (data_output_cbor_t *)output;
+
+    size_t len = data_print_cbor(data, cbor->buf, cbor->size);
+    if (len > cbor->size) {
+        uint8_t *buf = realloc(cbor->buf, len);
+        if (!buf) {
+            WARN_REALLOC("print_cbor_data()");
+            return; // NOTE: skip output on alloc failure.
+        }
+        cbor->buf  = buf;
+        cbor->size = len;
+        data_print_cbor(data, cbor->buf, cbor->size);
+    }
+    fwrite(cbor->buf, 1, len, cbor->file);
+}
+
+static void R_API_CALLCONV print_cbor_flush(data_output_t *output)
+{
+    data_output_cbor_t *cbor = (data_output_cbor_t *)output;
+
+    if (cbor && cbor->file) {
+        file_flush_event(cbor->file, &cbor->flush, output->batch);
+    }
+}
+
+static void R_API_CALLCONV print_cbor_sync(data_output_t *output, int force)
+{
+    data_output_cbor_t *cbor = (data_output_cbor_t *)output;
+
+    file_flush_sync(cbor->file, &cbor->flush, force);
+}
+
+static void R_API_CALLCONV print_cbor_batch(data_output_t *output, unsigned num_events)
+{
+    UNUSED(num_events);
+    data_output_cbor_t *cbor = (data_output_cbor_t *)output;
+
+    if (cbor->file)
+        file_flush_check(cbor->file, &cbor->flush);
+}
+
+static void R_API_CALLCONV data_output_cbor_free(data_output_t *output)
+{
+    data_output_cbor_t *cbor = (data_output_cbor_t *)output;
+
+    if (!output)
+        return;
+
+    file_flush_close(cbor->file, &cbor->flush);
+    free(cbor->buf);
+    free(cbor);
+}
+
+struct data_output *data_output_cbor_create(FILE *file)
+{
+    data_output_cbor_t *cbor = calloc(1, sizeof(data_output_cbor_t));
+    if (!cbor) {
+        WARN_CALLOC("data_output_cbor_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+
+    cbor->output.print_data   = print_cbor_data;
+    cbor->output.output_flush = print_cbor_flush;
+    cbor->output.output_sync  = print_cbor_sync;
+    cbor->output.output_batch = print_cbor_batch;
+    cbor->output.output_free  = data_output_cbor_free;
+    cbor->file                = file;
+
+    return &cbor->output;
+}
+
+void data_output_file_policy(struct data_output *output, file_flush_policy_t const *policy)
+{
+    if (!output || !policy)
+        return;
+    if (output->output_flush == print_json_flush) {
+        data_output_json_t *json = (data_output_json_t *)output;
+        file_flush_setup(json->file, &json->flush, policy);
+    }
+    else if (output->output_flush == print_kv_flush) {
+        data_output_kv_t *kv = (data_output_kv_t *)output;
+        file_flush_setup(kv->file, &kv->flush, policy);
+    }
+    else if (output->output_flush == print_csv_flush) {
+        data_output_csv_t *csv = (data_output_csv_t *)output;
+        file_flush_setup(csv->file, &csv->flush, policy);
+    }
+    else if (output->output_flush == print_cbor_flush) {
+        data_output_cbor_t *cbor = (data_output_cbor_t *)output;
+        file_flush_setup(cbor->file, &cbor->flush, policy);
+    }
+}
@@ -0,0 +1,277 @@
+/** @file
+    Output filter, passes only changed events of each sensor or limits the rate per sensor.
+
+    The list of models is checked for each event, the lists of fields are compiled into
+    a projection that the output applies, see data_output_project().
+
+    Each sensor keeps the numbers and a hash of the other fields of the last passed event
+    in an open addressing hash table with linear probing.
+    The numbers are compared with the tolerance, the other fields must be equal.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_filter.h"
+#include "event_dedup.h"
+#include "data.h"
+#include "optparse.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/// The last passed event of a sensor.
+struct output_filter_slot {
+    uint64_t key;       ///< hash of the model, id, and channel, 0 for a never used slot
+    uint64_t shape;     ///< hash of the keys, the strings, and the numbers past the compared ones
+    uint64_t passed_ms; ///< time the last event was passed
+    unsigned num_values;
+    float values[OUTPUT_FILTER_VALUES];
+};
+
+struct output_filter {
+    unsigned index;
+    output_filter_opts_t opts;
+    unsigned drops;
+    uint64_t iq_ms;     ///< time of the last IQ capture
+    int iq_captured;    ///< an IQ capture was made
+    struct output_filter_slot slot[OUTPUT_FILTER_SIZE];
+};
+
+int output_filter_strip(char *arg, output_filter_opts_t *opts)
+{
+    int found = 0;
+    char *p   = arg ? strchr(arg, ',') : NULL;
+    while (p) {
+        char *next = strchr(p + 1, ',');
+        size_t len = next ? (size_t)(next - p - 1) : strlen(p + 1);
+        char token[OUTPUT_FILTER_LIST + 16];
+        if (len >= sizeof(token)) {
+            p = next;
+            continue;
+        }
+        memcpy(token, p + 1, len);
+        token[len] = '\0';
+
+        char const *val = NULL;
+        if (kwargs_match(token, "changes", &val)) {
+            opts->changes   = 1;
+            opts->tolerance = val ? arg_float(val, "-F changes: ") : 0.0;
+        }
+        else if (kwargs_match(token, "every", &val)) {
+            opts->every_ms = (unsigned)atoi_time(val, "-F every: ") * 1000;
+        }
+        else if (kwargs_match(token, "limit", &val)) {
+            opts->limit_ms = (unsigned)atoi_time(val, "-F limit: ") * 1000;
+        }
+        else if (kwargs_match(token, "fields", &val)) {
+            snprintf(opts->fields, sizeof(opts->fields), "%s", val ? val : "");
+        }
+        else if (kwargs_match(token, "exclude", &val)) {
+            snprintf(opts->exclude, sizeof(opts->exclude), "%s", val ? val : "");
+        }
+        else if (kwargs_match(token, "models", &val)) {
+            snprintf(opts->models, sizeof(opts->models), "%s", val ? val : "");
+        }
+        else if (kwargs_match(token, "raw", &val)) {
+            opts->raw = val && !strcmp(val, "only") ? 2 : 1;
+        }
+        else if (kwargs_match(token, "iq", &val)) {
+            opts->iq    = 1;
+            opts->iq_ms = val ? (unsigned)atoi_time(val, "-F iq: ") * 1000 : OUTPUT_FILTER_IQ_MS;
+        }
+        else {
+            p = next;
+            continue;
+        }
+        found = 1;
+        // remove the option and its comma, the next option then starts at p
+        memmove(p, p + 1 + len, strlen(p + 1 + len) + 1);
+        p = *p ? p : NULL;
+    }
+    return found;
+}
+
+output_filter_t *output_filter_create(unsigned index, output_filter_opts_t const *opts)
+{
+    output_filter_t *filter = calloc(1, sizeof(*filter));
+    if (!filter) {
+        WARN_CALLOC("output_filter_create()");
+        return NULL;
+    }
+    filter->index = index;
+    filter->opts  = *opts;
+    return filter;
+}
+
+void output_filter_free(output_filter_t *filter)
+{
+    free(filter);
+}
+
+unsigned output_filter_index(output_filter_t const *filter)
+{
+    return filter->index;
+}
+
+unsigned output_filter_drops(output_filter_t const *filter)
+{
+    return filter->drops;
+}
+
+int output_filter_raw(output_filter_t const *filter)
+{
+    return filter->opts.raw;
+}
+
+char const *output_filter_models(output_filter_t const *filter)
+{
+    return filter->opts.models;
+}
+
+int output_filter_per_event(output_filter_t const *filter)
+{
+    return filter->opts.changes || filter->opts.limit_ms;
+}
+
+void output_filter_drop(output_filter_t *filter)
+{
+    filter->drops++;
+}
+
+data_projection_t *output_filter_projection(output_filter_t const *filter)
+{
+    return data_projection_create(filter->opts.fields, filter->opts.exclude);
+}
+
+int output_filter_model_listed(char const *list, char const *model)
+{
+    while (*list) {
+        char const *end = strchr(list, ':');
+        size_t len      = end ? (size_t)(end - list) : strlen(list);
+        if (len && list[len - 1] == '*') {
+            if (!strncmp(list, model, len - 1))
+                return 1;
+        }
+        else if (len && !strncmp(list, model, len) && !model[len]) {
+            return 1;
+        }
+        list += len + (end != NULL);
+    }
+    return 0;
+}
+
+/// Check if a field is meta data that changes with each reception.
+static int is_meta_key(int key_id)
+{
+    switch (key_id) {
+    case DATA_KEY_TIME:
+    case DATA_KEY_MOD:
+    case DATA_KEY_FREQ:
+    case DATA_KEY_FREQ1:
+    case DATA_KEY_FREQ2:
+    case DATA_KEY_RSSI:
+    case DATA_KEY_SNR:
+    case DATA_KEY_NOISE:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int output_filter_pass(output_filter_t *filter, data_t const *data, uint64_t now_ms)
+{
+    // the sensor key and the fields to compare
+    int has_model       = 0;
+    uint64_t key        = EVENT_DEDUP_HASH_INIT;
+    uint64_t shape      = EVENT_DEDUP_HASH_INIT;
+    unsigned num_values = 0;
+    float values[OUTPUT_FILTER_VALUES];
+    for (data_t const *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL && filter->opts.models[0] && d->type == DATA_STRING
+                && !output_filter_model_listed(filter->opts.models, d->value.v_ptr)) {
+            filter->drops++;
+            return 0;
+        }
+        if (!filter->opts.changes && !filter->opts.limit_ms)
+            continue; // only the model is checked
+        if (d->key_id == DATA_KEY_MODEL || d->key_id == DATA_KEY_ID || d->key_id == DATA_KEY_CHANNEL) {
+            has_model |= d->key_id == DATA_KEY_MODEL;
+            key = event_dedup_hash_field(key, d);
+            continue;
+        }
+        if (is_meta_key(d->key_id))
+            continue;
+        if ((d->type == DATA_INT || d->type == DATA_DOUBLE) && num_values < OUTPUT_FILTER_VALUES) {
+            values[num_values++] = d->type == DATA_INT ? (float)d->value.v_int : (float)d->value.v_dbl;
+            data_t key_only      = {.key = d->key, .type = DATA_COUNT}; // the number is compared with the tolerance
+            shape                = event_dedup_hash_field(shape, &key_only);
+        }
+        else {
+            shape = event_dedup_hash_field(shape, d);
+        }
+    }
+    if (!has_model)
+        return 1;
+    key = key ? key : 1; // 0 marks a never used slot
+
+    // find the sensor, or the slot to replace
+    struct output_filter_slot *slot   = NULL;
+    struct output_filter_slot *victim = NULL;
+    for (unsigned i = 0; i < OUTPUT_FILTER_PROBES; ++i) {
+        struct output_filter_slot *s = &filter->slot[(key + i) & (OUTPUT_FILTER_SIZE - 1)];
+        if (s->key == key) {
+            slot = s;
+            break;
+        }
+        if (!victim || (victim->key && (!s->key || s->passed_ms < victim->passed_ms)))
+            victim = s;
+        if (!s->key)
+            break; // never used, the sensor can not be further on
+    }
+
+    if (slot && now_ms >= slot->passed_ms) {
+        uint64_t elapsed = now_ms - slot->passed_ms;
+        int unchanged    = slot->shape == shape && slot->num_values == num_values;
+        for (unsigned i = 0; unchanged && i < num_values; ++i) {
+            unchanged = fabsf(values[i] - slot->values[i]) <= filter->opts.tolerance;
+        }
+        int limited = filter->opts.limit_ms && elapsed < filter->opts.limit_ms;
+        int skipped = filter->opts.changes && unchanged && !(filter->opts.every_ms && elapsed >= filter->opts.every_ms);
+        if (limited || skipped) {
+            filter->drops++;
+            return 0;
+        }
+    }
+    slot = slot ? slot : victim;
+
+    slot->key        = key;
+    slot->shape      = shape;
+    slot->passed_ms  = now_ms;
+    slot->num_values = num_values;
+    memcpy(slot->values, values, num_values * sizeof(*values));
+    return 1;
+}
+
+int output_filter_iq(output_filter_t *filter, data_t const *data, uint64_t now_ms)
+{
+    if (!filter->opts.iq)
+        return 0;
+    if (filter->iq_captured && now_ms >= filter->iq_ms && now_ms - filter->iq_ms < filter->opts.iq_ms)
+        return 0;
+    for (data_t const *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL && d->type == DATA_STRING) {
+            if (filter->opts.models[0] && !output_filter_model_listed(filter->opts.models, d->value.v_ptr))
+                return 0;
+            filter->iq_ms       = now_ms;
+            filter->iq_captured = 1;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -17,6 +17,7 @@
 #include "util.h"
 #include "fatal.h"
 #include "r_util.h"
+#include "format_double.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -36,12 +37,122 @@ typedef struct {
     char hostname[64];
     char url[400];
     char extra_headers[150];
-    int databufidxfill;
-    struct mbuf databufs[2];
-
+    char request_host[260];  ///< the Host header, with the port
+    char request_path[400];  ///< the path and query of the requests
+    double idle_time;       ///< time the kept-alive connection went idle, 0 while a request is in flight
+    int reused;             ///< the request in flight went on a kept-alive connection
+    struct mg_ssl_session *tls_session; ///< the TLS session to resume on a new connection
+    struct mbuf databuf;    ///< pending lines, new lines are appended
+    struct mbuf sendbuf;    ///< lines of the request in flight
+    unsigned pending_lines; ///< number of lines in databuf
+    unsigned sending_lines; ///< number of lines in sendbuf
+    unsigned dropped_lines;
+    unsigned batch_lines;   ///< send once this many lines are pending, at most this many per request
+    unsigned batch_bytes;   ///< send once this many bytes are pending, at most this many per request
+    int batch_secs;         ///< send once the oldest pending line waited this long
+    unsigned spool_bytes;   ///< pending bytes to hold while InfluxDB is unreachable, the oldest lines are dropped
+    double first_time;      ///< time the oldest pending line was added
+    double retry_time;      ///< no new request before this time after a failed request
+    double retry_delay;     ///< backoff after a failed request, doubled up to INFLUX_RETRY_MAX
+    int spool_full;         ///< lines were dropped since the last successful request
+    data_buf_t jsonbuf;     ///< serialization buffer of nested data, grows to the largest
 } influx_client_t;
 
-static void influx_client_send(influx_client_t *ctx);
+/// Maximum backoff in seconds after failed requests.
+#define INFLUX_RETRY_MAX 60.0
+
+/// A connection idle for longer is not reused, e.g. NAT mappings of mobile links time out.
+#define INFLUX_KEEPALIVE_SECS 30.0
+
+static void influx_client_send(influx_client_t *ctx, int force);
+
+/// Drop the oldest pending lines until the spool limit is met.
+static void influx_client_limit(influx_client_t *ctx)
+{
+    struct mbuf *buf = &ctx->databuf;
+    while (buf->len > ctx->spool_bytes && ctx->pending_lines) {
+        char *eol  = memchr(buf->buf, '\n', buf->len);
+        size_t len = eol ? (size_t)(eol - buf->buf) + 1 : buf->len;
+        mbuf_remove(buf, len);
+        ctx->pending_lines--;
+        ctx->dropped_lines++;
+        if (!ctx->spool_full)
+            fprintf(stderr, "InfluxDB spool is full, dropping the oldest lines\n");
+        ctx->spool_full = 1;
+    }
+}
+
+/// Put the lines of a failed request back in front of the pending lines and back off.
+static void influx_client_requeue(influx_client_t *ctx, int backoff)
+{
+    mbuf_insert(&ctx->databuf, 0, ctx->sendbuf.buf, ctx->sendbuf.len);
+    ctx->pending_lines += ctx->sending_lines;
+    ctx->sending_lines = 0;
+    ctx->sendbuf.len   = 0;
+    influx_client_limit(ctx);
+    if (!backoff)
+        return; // e.g. the server closed a kept-alive connection, retry on a new one
+
+    ctx->retry_delay = ctx->retry_delay ? ctx->retry_delay * 2 : 1.0;
+    if (ctx->retry_delay > INFLUX_RETRY_MAX)
+        ctx->retry_delay = INFLUX_RETRY_MAX;
+    ctx->retry_time = mg_time() + ctx->retry_delay;
+}
+
+/// The request in flight is done, successful or rejected.
+static void influx_client_sent(influx_client_t *ctx, int ok)
+{
+    if (!ok)
+        ctx->dropped_lines += ctx->sending_lines;
+    else if (ctx->retry_delay)
+        fprintf(stderr, "InfluxDB is reachable again, %u lines pending, %u lines dropped\n",
+                ctx->pending_lines, ctx->dropped_lines);
+    ctx->sending_lines = 0;
+    ctx->sendbuf.len   = 0;
+    if (ok) {
+        ctx->retry_delay = 0;
+        ctx->retry_time  = 0;
+        ctx->spool_full  = 0;
+    }
+}
+
+/// Handle the reply to the request in flight, returns true if the connection is kept alive.
+static int influx_client_reply(struct mg_connection *nc, influx_client_t *ctx, struct http_message *hm, int can_keep)
+{
+    if (ctx && !ctx->sending_lines)
+        ctx = NULL; // already handled, e.g. the reply is delivered again on close
+    if (ctx)
+        ctx->reused = 0; // the server did take the request
+
+    int done = 0;
+    if (hm->resp_code / 100 == 2) {
+        done = 1;
+        if (ctx)
+            influx_client_sent(ctx, 1);
+    }
+    else {
+        if (ctx && ctx->prev_resp_code != hm->resp_code)
+            fprintf(stderr, "InfluxDB replied HTTP code: %d with message:\n%.*s\n", hm->resp_code, (int)hm->body.len, hm->body.p);
+        // client errors will not go away with a retry, except timeouts and rate limits
+        if (hm->resp_code / 100 == 4 && hm->resp_code != 408 && hm->resp_code != 429) {
+            done = 1;
+            if (ctx)
+                influx_client_sent(ctx, 0);
+        }
+    }
+    if (ctx)
+        ctx->prev_resp_code = hm->resp_code;
+
+    // a retry closes the connection and backs off, the lines are requeued on close
+    struct mg_str *conn_hdr = mg_get_http_header(hm, "Connection");
+    int keep = ctx && done && can_keep && mg_vcasecmp(&hm->proto, "HTTP/1.1") == 0
+            && !(conn_hdr && mg_vcasecmp(conn_hdr, "close") == 0);
+    if (!keep)
+        nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+    else
+        ctx->idle_time = mg_time();
+    return keep;
+}
 
 static void influx_client_event(struct mg_connection *nc, int ev, void *ev_data)
 {
@@ -54,34 +165,31 @@ static void influx_client_event(struct mg_connection *nc, int ev, void *ev_data)
         int connect_status = *(int *)ev_data;
         if (connect_status != 0) {
             // Error, print only once
-            if (ctx) {
-                if (ctx->prev_status != connect_status)
-                    fprintf(stderr, "InfluxDB connect error: %s\n", strerror(connect_status));
-                ctx->conn = NULL;
-            }
+            if (ctx && ctx->prev_status != connect_status)
+                fprintf(stderr, "InfluxDB connect error: %s\n", strerror(connect_status));
+            // the close follows, the lines are requeued then
         }
         if (ctx)
             ctx->prev_status = connect_status;
         break;
     }
-    case MG_EV_HTTP_CHUNK: // response is normally empty (so mongoose thinks we received a chunk only)
+    case MG_EV_HTTP_CHUNK:
+        if (hm->message.len != (size_t)~0)
+            break; // the reply follows once the body is in
+        // no Content-Length, e.g. 204 No Content, the body is empty or ends with the connection
+        if (influx_client_reply(nc, ctx, hm, hm->resp_code == 204))
+            mbuf_clear(&nc->recv_mbuf); // the reply is done, the next one starts fresh
+        break;
     case MG_EV_HTTP_REPLY:
-        nc->flags |= MG_F_CLOSE_IMMEDIATELY;
-        if (hm->resp_code == 204) {
-            // mark influx data as sent
-        }
-        else {
-            if (ctx && ctx->prev_resp_code != hm->resp_code)
-                fprintf(stderr, "InfluxDB replied HTTP code: %d with message:\n%s\n", hm->resp_code, hm->body.p);
-        }
-        if (ctx) {
-            ctx->prev_resp_code = hm->resp_code;
-        }
+        influx_client_reply(nc, ctx, hm, 1);
         break;
     case MG_EV_CLOSE:
-        if (ctx) {
-            ctx->conn = NULL;
-            influx_client_send(ctx);
+        if (ctx && ctx->conn == nc) {
+            ctx->conn      = NULL;
+            ctx->idle_time = 0;
+            if (ctx->sending_lines)
+                influx_client_requeue(ctx, !ctx->reused); // no reply, or a reply worth a retry
+            influx_client_send(ctx, 0);
         }
         break;
     }
@@ -93,28 +201,83 @@ static influx_client_t *influx_client_init(influx_client_t *ctx, char const *url
     ctx->url[sizeof(ctx->url) - 1] = '\0';
     snprintf(ctx->extra_headers, sizeof (ctx->extra_headers), "Authorization: Token %s\r\n", token);
 
+    // the requests on a kept-alive connection, as mg_connect_http_opt() writes the first one
+    struct mg_str host, path, query;
+    mg_parse_uri(mg_mk_str(ctx->url), NULL, NULL, &host, NULL, &path, &query, NULL);
+    snprintf(ctx->request_host, sizeof(ctx->request_host), "%.*s", (int)(path.p - host.p), host.p);
+    snprintf(ctx->request_path, sizeof(ctx->request_path), "%.*s", (int)(path.len + query.len + 1), path.p);
+
     return ctx;
 }
 
-static void influx_client_send(influx_client_t *ctx)
+static void influx_client_send(influx_client_t *ctx, int force)
 {
-    struct mbuf *buf = &ctx->databufs[ctx->databufidxfill];
+    struct mbuf *buf = &ctx->databuf;
 
-    /*fprintf(stderr, "Influx %p msg: \"%s\" with %lu/%lu %s\n",
-            (void*)ctx, buf->buf, buf->len, buf->size,
-            ctx->conn ? "buffering" : "to be sent");*/
+    if (ctx->sending_lines || !ctx->pending_lines)
+        return;
+
+    double now = mg_time();
+    if (!force && now < ctx->retry_time)
+        return;
+    int due = (!ctx->batch_lines && !ctx->batch_secs)
+            || (ctx->batch_lines && ctx->pending_lines >= ctx->batch_lines)
+            || buf->len >= ctx->batch_bytes
+            || (ctx->batch_secs && now - ctx->first_time >= ctx->batch_secs);
+    if (!force && !due)
+        return;
+
+    // take whole lines up to the batch limits, at least one line
+    size_t len     = 0;
+    unsigned lines = 0;
+    while (lines < ctx->pending_lines && (!ctx->batch_lines || lines < ctx->batch_lines)) {
+        char *eol = memchr(buf->buf + len, '\n', buf->len - len);
+        if (!eol)
+            break;
+        size_t end = (size_t)(eol - buf->buf) + 1;
+        if (lines && end > ctx->batch_bytes)
+            break;
+        len = end;
+        lines++;
+    }
+    if (!lines)
+        return;
 
-    if (ctx->conn || !buf->len)
+    // the request body is a string
+    ctx->sendbuf.len = 0;
+    mbuf_append(&ctx->sendbuf, buf->buf, len);
+    mbuf_append(&ctx->sendbuf, "", 1);
+    ctx->sendbuf.len--;
+    mbuf_remove(buf, len);
+    ctx->pending_lines -= lines;
+    ctx->sending_lines = lines;
+    ctx->first_time    = now;
+
+    // a kept-alive connection idle for too long might be gone without notice
+    if (ctx->conn && now - ctx->idle_time > INFLUX_KEEPALIVE_SECS) {
+        ctx->conn->user_data = NULL;
+        ctx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
+#if MG_ENABLE_SSL
+        mg_ssl_session_detach(ctx->conn);
+#endif
+        ctx->conn = NULL;
+    }
+    ctx->reused    = ctx->conn != NULL;
+    ctx->idle_time = 0;
+    if (ctx->conn) {
+        mg_printf(ctx->conn, "POST %s HTTP/1.1\r\nHost: %s\r\nContent-Length: %zu\r\n%s\r\n",
+                ctx->request_path, ctx->request_host, ctx->sendbuf.len, ctx->extra_headers);
+        mg_send(ctx->conn, ctx->sendbuf.buf, ctx->sendbuf.len);
         return;
+    }
 
     struct mg_connect_opts opts = {.user_data = ctx};
-    if ((ctx->conn = mg_connect_http_opt(ctx->mgr, influx_client_event, opts, ctx->url, ctx->extra_headers, buf->buf)) == NULL) {
+#if MG_ENABLE_SSL
+    opts.ssl_session = &ctx->tls_session;
+#endif
+    if ((ctx->conn = mg_connect_http_opt(ctx->mgr, influx_client_event, opts, ctx->url, ctx->extra_headers, ctx->sendbuf.buf)) == NULL) {
         fprintf(stderr, "Connect to InfluxDB (%s) failed\n", ctx->url);
-    }
-    else {
-        ctx->databufidxfill ^= 1;
-        buf->len = 0;
-        *buf->buf = '\0';
+        influx_client_requeue(ctx, 1);
     }
 }
 
@@ -172,6 +335,19 @@ static char *mbuf_snprintf(struct mbuf *a, char const *format, ...)
     return str;
 }
 
+/// Append a double like mbuf_snprintf() with a single double conversion.
+static char *mbuf_double(struct mbuf *a, char const *format, double value)
+{
+    char *str = &a->buf[a->len];
+    int size  = format_double(str, a->size - a->len, format, value);
+    if (size > 0 && a->len < a->size) {
+        // the text might be truncated
+        size_t len = strlen(str);
+        a->len += len;
+    }
+    return str;
+}
+
 static void mbuf_remove_part(struct mbuf *a, char *pos, size_t len)
 {
     if (pos >= a->buf && pos < &a->buf[a->len] && &pos[len] <= &a->buf[a->len]) {
@@ -185,22 +361,23 @@ static void R_API_CALLCONV print_influx_array(data_output_t *output, data_array_
     UNUSED(array);
     UNUSED(format);
     influx_client_t *influx = (influx_client_t *)output;
-    struct mbuf *buf = &influx->databufs[influx->databufidxfill];
+    struct mbuf *buf = &influx->databuf;
     mbuf_snprintf(buf, "\"array\""); // TODO
 }
 
 static void R_API_CALLCONV print_influx_data_escaped(data_output_t *output, data_t *data, char const *format)
 {
-    char str[1000];
-    data_print_jsons(data, str, sizeof (str));
-    output->print_string(output, str, format);
+    influx_client_t *influx = (influx_client_t *)output;
+    char const *str = data_print_jsons_buf(data, &influx->jsonbuf, NULL);
+    if (str)
+        output->print_string(output, str, format);
 }
 
 static void R_API_CALLCONV print_influx_string_escaped(data_output_t *output, char const *str, char const *format)
 {
     UNUSED(format);
     influx_client_t *influx = (influx_client_t *)output;
-    struct mbuf *databuf = &influx->databufs[influx->databufidxfill];
+    struct mbuf *databuf = &influx->databuf;
     size_t size = databuf->size - databuf->len;
     char *buf = &databuf->buf[databuf->len];
 
@@ -252,7 +429,7 @@ static void R_API_CALLCONV print_influx_string(data_output_t *output, char const
 {
     UNUSED(format);
     influx_client_t *influx = (influx_client_t *)output;
-    struct mbuf *buf = &influx->databufs[influx->databufidxfill];
+    struct mbuf *buf = &influx->databuf;
     mbuf_snprintf(buf, "%s", str);
 }
 
@@ -263,7 +440,7 @@ static void R_API_CALLCONV print_influx_data(data_output_t *output, data_t *data
     influx_client_t *influx = (influx_client_t *)output;
     char *str;
     char *end;
-    struct mbuf *buf = &influx->databufs[influx->databufidxfill];
+    struct mbuf *buf = &influx->databuf;
     bool comma = false;
 
     data_t *data_org = data;
@@ -373,25 +550,53 @@ static void R_API_CALLCONV print_influx_data(data_output_t *output, data_t *data
     }
     mbuf_snprintf(buf, "\n");
 
-    influx_client_send(influx);
+    if (!influx->pending_lines)
+        influx->first_time = mg_time();
+    influx->pending_lines++;
+    influx_client_limit(influx);
+    influx_client_send(influx, 0);
 }
 
 static void R_API_CALLCONV print_influx_double(data_output_t *output, double data, char const *format)
 {
     UNUSED(format);
     influx_client_t *influx = (influx_client_t *)output;
-    struct mbuf *buf = &influx->databufs[influx->databufidxfill];
-    mbuf_snprintf(buf, "%f", data);
+    struct mbuf *buf = &influx->databuf;
+    mbuf_double(buf, "%f", data);
 }
 
 static void R_API_CALLCONV print_influx_int(data_output_t *output, int data, char const *format)
 {
     UNUSED(format);
     influx_client_t *influx = (influx_client_t *)output;
-    struct mbuf *buf = &influx->databufs[influx->databufidxfill];
+    struct mbuf *buf = &influx->databuf;
     mbuf_snprintf(buf, "%d", data);
 }
 
+static void R_API_CALLCONV data_output_influx_sync(data_output_t *output, int force)
+{
+    influx_client_t *influx = (influx_client_t *)output;
+
+    // checks the batch latency, a forced sync sends the pending lines now
+    influx_client_send(influx, force);
+}
+
+static unsigned R_API_CALLCONV data_output_influx_drops(data_output_t *output)
+{
+    influx_client_t *influx = (influx_client_t *)output;
+
+    return influx->dropped_lines;
+}
+
+/// The bytes of the pending lines, the request in flight, and the serialization buffer.
+static size_t R_API_CALLCONV data_output_influx_memory(data_output_t *output)
+{
+    influx_client_t *influx = (influx_client_t *)output;
+
+    return sizeof(*influx) + influx->databuf.size + influx->sendbuf.size + influx->jsonbuf.size
+            + (influx->conn ? influx->conn->send_mbuf.size : 0);
+}
+
 static void R_API_CALLCONV data_output_influx_free(data_output_t *output)
 {
     influx_client_t *influx = (influx_client_t *)output;
@@ -403,8 +608,21 @@ static void R_API_CALLCONV data_output_influx_free(data_output_t *output)
     if (influx->conn) {
         influx->conn->user_data = NULL;
         influx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
+#if MG_ENABLE_SSL
+        mg_ssl_session_detach(influx->conn);
+#endif
     }
+#if MG_ENABLE_SSL
+    mg_ssl_session_free(influx->tls_session);
+#endif
 
+    if (influx->pending_lines || influx->sending_lines || influx->dropped_lines)
+        fprintf(stderr, "InfluxDB output: %u lines not sent, %u lines dropped\n",
+                influx->pending_lines + influx->sending_lines, influx->dropped_lines);
+
+    mbuf_free(&influx->sendbuf);
+    mbuf_free(&influx->databuf);
+    data_buf_free(&influx->jsonbuf);
     free(influx);
 }
 
@@ -424,6 +642,8 @@ struct data_output *data_output_influx_create(struct mg_mgr *mgr, char *opts)
     influx_sanitize_tag(influx->hostname, NULL);
 
     char *token = NULL;
+    influx->batch_bytes = 256 * 1024;
+    influx->spool_bytes = 1024 * 1024;
 
     // param/opts starts with URL
     char *url = opts;
@@ -459,18 +679,38 @@ struct data_output *data_output_influx_create(struct mg_mgr *mgr, char *opts)
             continue;
         else if (!strcasecmp(key, "t") || !strcasecmp(key, "token"))
             token = val;
+        else if (!strcasecmp(key, "flush")) {
+            if (val && strpbrk(val, "smhSMH:"))
+                influx->batch_secs = atoi_time(val, "-F influx flush: ");
+            else
+                influx->batch_lines = atouint32_metric(val, "-F influx flush: ");
+        }
+        else if (!strcasecmp(key, "batch"))
+            influx->batch_bytes = atouint32_metric(val, "-F influx batch: ");
+        else if (!strcasecmp(key, "spool"))
+            influx->spool_bytes = atouint32_metric(val, "-F influx spool: ");
         else {
             fprintf(stderr, "Invalid key \"%s\" option.\n", key);
             exit(1);
         }
     }
 
-    influx->output.print_data   = print_influx_data;
-    influx->output.print_array  = print_influx_array;
-    influx->output.print_string = print_influx_string;
-    influx->output.print_double = print_influx_double;
-    influx->output.print_int    = print_influx_int;
-    influx->output.output_free  = data_output_influx_free;
+    influx->output.print_data    = print_influx_data;
+    influx->output.print_array   = print_influx_array;
+    influx->output.print_string  = print_influx_string;
+    influx->output.print_double  = print_influx_double;
+    influx->output.print_int     = print_influx_int;
+    influx->output.output_sync   = data_output_influx_sync;
+    influx->output.output_drops  = data_output_influx_drops;
+    influx->output.output_memory = data_output_influx_memory;
+    influx->output.output_free   = data_output_influx_free;
+
+    if (influx->batch_lines && !influx->batch_secs)
+        influx->batch_secs = 10; // don't hold a partial batch forever
+    if (!influx->batch_bytes)
+        influx->batch_bytes = 1;
+    if (influx->spool_bytes < influx->batch_bytes)
+        influx->spool_bytes = influx->batch_bytes;
 
     fprintf(stderr, "Publishing data to InfluxDB (%s)\n", url);
 
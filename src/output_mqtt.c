@@ -11,10 +11,12 @@
 
 // note: our unit header includes unistd.h for gethostname() via data.h
 #include "output_mqtt.h"
+#include "output_cbor.h"
 #include "optparse.h"
 #include "util.h"
 #include "fatal.h"
 #include "r_util.h"
+#include "format_double.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -24,6 +26,9 @@
 
 /* MQTT client abstraction */
 
+/// Default bytes of messages held while the broker is not connected.
+#define MQTT_QUEUE_DEFAULT (256 * 1024)
+
 typedef struct mqtt_client {
     struct mg_connect_opts connect_opts;
     struct mg_send_mqtt_handshake_opts mqtt_opts;
@@ -33,8 +38,64 @@ typedef struct mqtt_client {
     char client_id[256];
     uint16_t message_id;
     int publish_flags; // MG_MQTT_RETAIN | MG_MQTT_QOS(0)
+    int connected;     ///< the broker accepted the connection
+    struct mbuf queue; ///< messages held while not connected, each the topic and payload lengths then both
+    size_t queue_size; ///< bytes to hold, the oldest messages are dropped
+    unsigned queue_drops;
+    unsigned drops; ///< messages dropped in total
+    struct mg_ssl_session *tls_session; ///< the TLS session to resume on reconnect
 } mqtt_client_t;
 
+/// The head of a held message, stored unaligned.
+typedef struct {
+    uint32_t topic_len;
+    uint32_t len;
+} mqtt_queue_head_t;
+
+/// Publish the held messages, oldest first.
+static void mqtt_client_flush(mqtt_client_t *ctx)
+{
+    size_t pos = 0;
+    while (pos + sizeof(mqtt_queue_head_t) <= ctx->queue.len) {
+        mqtt_queue_head_t head;
+        memcpy(&head, ctx->queue.buf + pos, sizeof(head));
+        char const *topic = ctx->queue.buf + pos + sizeof(head);
+        ctx->message_id++;
+        // the topic is stored with the terminating zero
+        mg_mqtt_publish(ctx->conn, topic, ctx->message_id, ctx->publish_flags, topic + head.topic_len, head.len);
+        pos += sizeof(head) + head.topic_len + head.len;
+    }
+    if (pos)
+        fprintf(stderr, "MQTT published %zu bytes held while not connected%s\n", pos,
+                ctx->queue_drops ? ", the oldest messages were dropped" : "");
+    ctx->queue.len   = 0;
+    ctx->queue_drops = 0;
+}
+
+/// Hold a message while not connected, the oldest messages make room.
+static void mqtt_client_hold(mqtt_client_t *ctx, char const *topic, void const *msg, size_t len)
+{
+    mqtt_queue_head_t head = {(uint32_t)strlen(topic) + 1, (uint32_t)len};
+    size_t need            = sizeof(head) + head.topic_len + head.len;
+    if (need > ctx->queue_size) {
+        ctx->queue_drops++;
+        ctx->drops++;
+        return;
+    }
+    size_t drop = 0;
+    while (ctx->queue.len - drop + need > ctx->queue_size) {
+        mqtt_queue_head_t old;
+        memcpy(&old, ctx->queue.buf + drop, sizeof(old));
+        drop += sizeof(old) + old.topic_len + old.len;
+        ctx->queue_drops++;
+        ctx->drops++;
+    }
+    mbuf_remove(&ctx->queue, drop);
+    mbuf_append(&ctx->queue, &head, sizeof(head));
+    mbuf_append(&ctx->queue, topic, head.topic_len);
+    mbuf_append(&ctx->queue, msg, len);
+}
+
 static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
 {
     // note that while shutting down the ctx is NULL
@@ -70,6 +131,10 @@ static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
         }
         else {
             fprintf(stderr, "MQTT Connection established.\n");
+            if (ctx) {
+                ctx->connected = 1;
+                mqtt_client_flush(ctx);
+            }
         }
         break;
     case MG_EV_MQTT_PUBACK:
@@ -86,6 +151,7 @@ static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
     case MG_EV_CLOSE:
         if (!ctx)
             break; // shuttig down
+        ctx->connected = 0;
         if (ctx->prev_status == 0)
             fprintf(stderr, "MQTT Connection failed...\n");
         // reconnect
@@ -101,11 +167,12 @@ static void mqtt_client_event(struct mg_connection *nc, int ev, void *ev_data)
     }
 }
 
-static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts, char const *host, char const *port, char const *user, char const *pass, char const *client_id, int retain, int qos)
+static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts, char const *host, char const *port, char const *user, char const *pass, char const *client_id, int retain, int qos, size_t queue_size)
 {
     mqtt_client_t *ctx = calloc(1, sizeof(*ctx));
     if (!ctx)
         FATAL_CALLOC("mqtt_client_init()");
+    ctx->queue_size = queue_size;
 
     ctx->mqtt_opts.user_name = user;
     ctx->mqtt_opts.password  = pass;
@@ -133,6 +200,7 @@ static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts,
         ctx->connect_opts.ssl_server_name   = tls_opts->tls_server_name;
         ctx->connect_opts.ssl_psk_identity  = tls_opts->tls_psk_identity;
         ctx->connect_opts.ssl_psk_key       = tls_opts->tls_psk_key;
+        ctx->connect_opts.ssl_session       = &ctx->tls_session; // reconnects resume the session
 #else
         fprintf(stderr, "mqtts (TLS) not available\n");
         exit(1);
@@ -151,21 +219,39 @@ static mqtt_client_t *mqtt_client_init(struct mg_mgr *mgr, tls_opts_t *tls_opts,
     return ctx;
 }
 
-static void mqtt_client_publish(mqtt_client_t *ctx, char const *topic, char const *str)
+static void mqtt_client_publish_len(mqtt_client_t *ctx, char const *topic, void const *msg, size_t len)
 {
-    if (!ctx->conn || !ctx->conn->proto_handler)
+    if (!ctx->conn || !ctx->connected) {
+        mqtt_client_hold(ctx, topic, msg, len);
         return;
+    }
 
     ctx->message_id++;
-    mg_mqtt_publish(ctx->conn, topic, ctx->message_id, ctx->publish_flags, str, strlen(str));
+    mg_mqtt_publish(ctx->conn, topic, ctx->message_id, ctx->publish_flags, msg, len);
+}
+
+static void mqtt_client_publish(mqtt_client_t *ctx, char const *topic, char const *str)
+{
+    mqtt_client_publish_len(ctx, topic, str, strlen(str));
 }
 
 static void mqtt_client_free(mqtt_client_t *ctx)
 {
-    if (ctx && ctx->conn) {
+    if (!ctx)
+        return;
+    if (ctx->conn) {
         ctx->conn->user_data = NULL;
         ctx->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
+#if MG_ENABLE_SSL
+        mg_ssl_session_detach(ctx->conn);
+#endif
     }
+    if (ctx->queue.len || ctx->queue_drops)
+        fprintf(stderr, "MQTT output: %zu bytes held not published\n", ctx->queue.len);
+#if MG_ENABLE_SSL
+    mg_ssl_session_free(ctx->tls_session);
+#endif
+    mbuf_free(&ctx->queue);
     free(ctx);
 }
 
@@ -181,104 +267,105 @@ static char *mqtt_sanitize_topic(char *topic)
     return topic;
 }
 
-/* MQTT printer */
-
+/* MQTT topic templates */
+
+/// Tokens of a topic format string.
+enum mqtt_token {
+    MQTT_TOKEN_NONE, ///< no token, trailing text only
+    MQTT_TOKEN_HOSTNAME,
+    MQTT_TOKEN_TYPE,
+    MQTT_TOKEN_MODEL,
+    MQTT_TOKEN_SUBTYPE,
+    MQTT_TOKEN_CHANNEL,
+    MQTT_TOKEN_ID,
+    MQTT_TOKEN_PROTOCOL,
+    MQTT_TOKEN_COUNT, ///< number of tokens
+};
+
+/// Literal text followed by an optional token, e.g. "devices" and "[/model:unknown]".
 typedef struct {
-    struct data_output output;
-    mqtt_client_t *mqc;
+    char const *text;
+    int text_len;
+    int token;       ///< enum mqtt_token
+    char sep;        ///< separator to put before the token value, or 0
+    char const *def; ///< default if the token value is missing, or NULL
+    int def_len;
+} mqtt_topic_part_t;
+
+/// Number of cached topics per template.
+#define MQTT_TOPIC_CACHE 64
+
+/// A cached topic, the key holds the token values it was expanded from.
+typedef struct {
+    size_t key_len;
+    char key[64];
     char topic[256];
-    char hostname[64];
-    char *devices;
-    char *events;
-    char *states;
-    //char *homie;
-    //char *hass;
-} data_output_mqtt_t;
+} mqtt_topic_entry_t;
 
-static void R_API_CALLCONV print_mqtt_array(data_output_t *output, data_array_t *array, char const *format)
-{
-    data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
-
-    char *orig = mqtt->topic + strlen(mqtt->topic); // save current topic
-
-    for (int c = 0; c < array->num_values; ++c) {
-        sprintf(orig, "/%d", c);
-        print_array_value(output, array, format, c);
-    }
-    *orig = '\0'; // restore topic
-}
-
-static char *append_topic(char *topic, data_t *data)
+/// A topic format string compiled once, with a cache of expanded topics.
+typedef struct {
+    char *format;   ///< the format string, the parts point into it
+    mqtt_topic_part_t *parts;
+    int num_parts;
+    unsigned uses;  ///< bit mask of the tokens used
+    mqtt_topic_entry_t cache[MQTT_TOPIC_CACHE];
+} mqtt_topic_t;
+
+static void mqtt_topic_free(mqtt_topic_t *t)
 {
-    if (data->type == DATA_STRING) {
-        strcpy(topic, data->value.v_ptr);
-        mqtt_sanitize_topic(topic);
-        topic += strlen(data->value.v_ptr);
-    }
-    else if (data->type == DATA_INT) {
-        topic += sprintf(topic, "%d", data->value.v_int);
-    }
-    else {
-        fprintf(stderr, "Can't append data type %d to topic\n", data->type);
-    }
-
-    return topic;
+    if (!t)
+        return;
+    free(t->parts);
+    free(t->format);
+    free(t);
 }
 
-static char *expand_topic(char *topic, char const *format, data_t *data, char const *hostname)
+/// Compile a topic format string, takes ownership of the string.
+static mqtt_topic_t *mqtt_topic_compile(char *format)
 {
-    // collect well-known top level keys
-    data_t *data_type    = NULL;
-    data_t *data_model   = NULL;
-    data_t *data_subtype = NULL;
-    data_t *data_channel = NULL;
-    data_t *data_id      = NULL;
-    data_t *data_protocol = NULL;
-    for (data_t *d = data; d; d = d->next) {
-        if (!strcmp(d->key, "type"))
-            data_type = d;
-        else if (!strcmp(d->key, "model"))
-            data_model = d;
-        else if (!strcmp(d->key, "subtype"))
-            data_subtype = d;
-        else if (!strcmp(d->key, "channel"))
-            data_channel = d;
-        else if (!strcmp(d->key, "id"))
-            data_id = d;
-        else if (!strcmp(d->key, "protocol")) // NOTE: needs "-M protocol"
-            data_protocol = d;
-    }
+    if (!format)
+        return NULL;
+    mqtt_topic_t *t = calloc(1, sizeof(*t));
+    if (!t)
+        FATAL_CALLOC("mqtt_topic_compile()");
+    t->format = format;
+    // at most one part per '[' plus the trailing text
+    int size = 1;
+    for (char const *p = format; *p; ++p)
+        size += *p == '[';
+    t->parts = calloc(size, sizeof(*t->parts));
+    if (!t->parts)
+        FATAL_CALLOC("mqtt_topic_compile()");
 
     // consume entire format string
-    while (format && *format) {
-        data_t *data_token  = NULL;
-        char const *string_token = NULL;
-        int leading_slash   = 0;
-        char const *t_start = NULL;
-        char const *t_end   = NULL;
-        char const *d_start = NULL;
-        char const *d_end   = NULL;
+    while (*format) {
+        mqtt_topic_part_t *part = &t->parts[t->num_parts++];
         // copy until '['
+        part->text = format;
         while (*format && *format != '[')
-            *topic++ = *format++;
+            ++format;
+        part->text_len = format - part->text;
         // skip '['
         if (!*format)
             break;
         ++format;
         // read slash
-        if (!leading_slash && (*format < 'a' || *format > 'z')) {
-            leading_slash = *format;
+        if (*format < 'a' || *format > 'z') {
+            part->sep = *format;
             format++;
         }
         // read key until : or ]
-        t_start = t_end = format;
+        char const *t_start = format;
+        char const *t_end   = format;
         while (*format && *format != ':' && *format != ']' && *format != '[')
             t_end = ++format;
         // read default until ]
         if (*format == ':') {
-            d_start = d_end = ++format;
+            char const *d_start = ++format;
             while (*format && *format != ']' && *format != '[')
-                d_end = ++format;
+                ++format;
+            part->def     = d_start;
+            part->def_len = format - d_start;
         }
         // check for proper closing
         if (*format != ']') {
@@ -289,41 +376,213 @@ static char *expand_topic(char *topic, char const *format, data_t *data, char co
 
         // resolve token
         if (!strncmp(t_start, "hostname", t_end - t_start))
-            string_token = hostname;
+            part->token = MQTT_TOKEN_HOSTNAME;
         else if (!strncmp(t_start, "type", t_end - t_start))
-            data_token = data_type;
+            part->token = MQTT_TOKEN_TYPE;
         else if (!strncmp(t_start, "model", t_end - t_start))
-            data_token = data_model;
+            part->token = MQTT_TOKEN_MODEL;
         else if (!strncmp(t_start, "subtype", t_end - t_start))
-            data_token = data_subtype;
+            part->token = MQTT_TOKEN_SUBTYPE;
         else if (!strncmp(t_start, "channel", t_end - t_start))
-            data_token = data_channel;
+            part->token = MQTT_TOKEN_CHANNEL;
         else if (!strncmp(t_start, "id", t_end - t_start))
-            data_token = data_id;
+            part->token = MQTT_TOKEN_ID;
         else if (!strncmp(t_start, "protocol", t_end - t_start))
-            data_token = data_protocol;
+            part->token = MQTT_TOKEN_PROTOCOL;
         else {
             fprintf(stderr, "%s: unknown token \"%.*s\"\n", __func__, (int)(t_end - t_start), t_start);
             exit(1);
         }
+        t->uses |= 1u << part->token;
+    }
+
+    return t;
+}
+
+/// Append a string to the topic, truncated at the end of the buffer.
+static char *append_topic_str(char *topic, char const *end, char const *str, size_t len)
+{
+    if (len > (size_t)(end - topic))
+        len = end - topic;
+    memcpy(topic, str, len);
+    return topic + len;
+}
 
+static char *append_topic(char *topic, char const *end, data_t *data)
+{
+    if (data->type == DATA_STRING) {
+        char const *str = data->value.v_ptr;
+        char *start     = topic;
+        topic           = append_topic_str(topic, end, str, strlen(str));
+        *topic          = '\0';
+        mqtt_sanitize_topic(start);
+    }
+    else if (data->type == DATA_INT) {
+        char str[12];
+        int len = snprintf(str, sizeof(str), "%d", data->value.v_int);
+        topic   = append_topic_str(topic, end, str, len);
+    }
+    else {
+        fprintf(stderr, "Can't append data type %d to topic\n", data->type);
+    }
+
+    return topic;
+}
+
+/// Build the cache key from the token values, returns 0 if the values can't be cached.
+static size_t mqtt_topic_key(mqtt_topic_t *t, data_t **tokens, char *key, size_t size)
+{
+    size_t len = 0;
+    for (int i = MQTT_TOKEN_TYPE; i < MQTT_TOKEN_COUNT; ++i) {
+        if (!(t->uses & (1u << i)))
+            continue;
+        data_t *d = tokens[i];
+        if (!d) {
+            if (len + 1 > size)
+                return 0;
+            key[len++] = 'n';
+        }
+        else if (d->type == DATA_STRING) {
+            size_t str_len = strlen(d->value.v_ptr) + 1;
+            if (len + 1 + str_len > size)
+                return 0;
+            key[len++] = 's';
+            memcpy(&key[len], d->value.v_ptr, str_len);
+            len += str_len;
+        }
+        else if (d->type == DATA_INT) {
+            if (len + 1 + sizeof(int) > size)
+                return 0;
+            key[len++] = 'i';
+            memcpy(&key[len], &d->value.v_int, sizeof(int));
+            len += sizeof(int);
+        }
+        else {
+            return 0; // not a topic value, warn on each expansion
+        }
+    }
+    return len ? len : 1; // a template without data tokens has a single topic
+}
+
+/// Expand a compiled topic into a buffer of the given size, returns the end of the topic.
+static char *expand_topic(char *topic, size_t size, mqtt_topic_t *t, data_t *data, char const *hostname)
+{
+    // collect well-known top level keys
+    data_t *tokens[MQTT_TOKEN_COUNT] = {0};
+    for (data_t *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_TYPE)
+            tokens[MQTT_TOKEN_TYPE] = d;
+        else if (d->key_id == DATA_KEY_MODEL)
+            tokens[MQTT_TOKEN_MODEL] = d;
+        else if (d->key_id == DATA_KEY_SUBTYPE)
+            tokens[MQTT_TOKEN_SUBTYPE] = d;
+        else if (d->key_id == DATA_KEY_CHANNEL)
+            tokens[MQTT_TOKEN_CHANNEL] = d;
+        else if (d->key_id == DATA_KEY_ID)
+            tokens[MQTT_TOKEN_ID] = d;
+        else if (!d->key_id && !strcmp(d->key, "protocol")) // NOTE: needs "-M protocol"
+            tokens[MQTT_TOKEN_PROTOCOL] = d;
+    }
+
+    // look up the topic in the cache
+    char key[sizeof(t->cache[0].key)];
+    size_t key_len            = mqtt_topic_key(t, tokens, key, sizeof(key));
+    mqtt_topic_entry_t *entry = NULL;
+    if (key_len) {
+        uint32_t hash = 2166136261u; // FNV-1a
+        for (size_t i = 0; i < key_len; ++i)
+            hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+        entry = &t->cache[hash % MQTT_TOPIC_CACHE];
+        if (entry->key_len == key_len && !memcmp(entry->key, key, key_len)) {
+            size_t len = strlen(entry->topic);
+            if (len >= size)
+                len = size - 1;
+            memcpy(topic, entry->topic, len);
+            topic[len] = '\0';
+            return topic + len;
+        }
+    }
+
+    char *start     = topic;
+    char const *end = topic + size - 1;
+    for (int i = 0; i < t->num_parts; ++i) {
+        mqtt_topic_part_t *part = &t->parts[i];
+        topic = append_topic_str(topic, end, part->text, part->text_len);
+
+        data_t *data_token       = tokens[part->token];
+        char const *string_token = part->token == MQTT_TOKEN_HOSTNAME ? hostname : NULL;
         // append token or default
-        if (!data_token && !string_token && !d_start)
+        if (!part->token || (!data_token && !string_token && !part->def))
             continue;
-        if (leading_slash)
-            *topic++ = leading_slash;
+        if (part->sep)
+            topic = append_topic_str(topic, end, &part->sep, 1);
         if (data_token)
-            topic = append_topic(topic, data_token);
+            topic = append_topic(topic, end, data_token);
         else if (string_token)
-            topic += sprintf(topic, "%s", string_token);
+            topic = append_topic_str(topic, end, string_token, strlen(string_token));
         else
-            topic += sprintf(topic, "%.*s", (int)(d_end - d_start), d_start);
+            topic = append_topic_str(topic, end, part->def, part->def_len);
     }
-
     *topic = '\0';
+
+    if (entry && (size_t)(topic - start) < sizeof(entry->topic)) {
+        entry->key_len = key_len;
+        memcpy(entry->key, key, key_len);
+        memcpy(entry->topic, start, topic - start + 1);
+    }
     return topic;
 }
 
+/* MQTT printer */
+
+typedef struct {
+    struct data_output output;
+    mqtt_client_t *mqc;
+    char topic[256];
+    char hostname[64];
+    mqtt_topic_t *devices;
+    mqtt_topic_t *events;
+    mqtt_topic_t *states;
+    int cbor;       ///< publish events and states as CBOR instead of JSON
+    int batch;      ///< publish one message per event to the devices topic instead of one per field
+    data_buf_t buf; ///< serialization buffer, grows to the largest event
+    //char *homie;
+    //char *hass;
+} data_output_mqtt_t;
+
+static void R_API_CALLCONV print_mqtt_array(data_output_t *output, data_array_t *array, char const *format)
+{
+    data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
+
+    char *orig = mqtt->topic + strlen(mqtt->topic); // save current topic
+
+    for (int c = 0; c < array->num_values; ++c) {
+        sprintf(orig, "/%d", c);
+        print_array_value(output, array, format, c);
+    }
+    *orig = '\0'; // restore topic
+}
+
+/// Publish an event as a single JSON or CBOR message.
+static void mqtt_publish_event(data_output_mqtt_t *mqtt, data_t *data)
+{
+    if (mqtt->cbor) {
+        size_t len = data_print_cbor(data, (uint8_t *)mqtt->buf.buf, mqtt->buf.size);
+        if (len > mqtt->buf.size) {
+            if (!data_buf_reserve(&mqtt->buf, len))
+                return; // NOTE: skip output on alloc failure.
+            len = data_print_cbor(data, (uint8_t *)mqtt->buf.buf, mqtt->buf.size);
+        }
+        mqtt_client_publish_len(mqtt->mqc, mqtt->topic, mqtt->buf.buf, len);
+    }
+    else {
+        size_t len;
+        char const *json = data_print_jsons_buf(data, &mqtt->buf, &len);
+        if (json)
+            mqtt_client_publish_len(mqtt->mqc, mqtt->topic, json, len);
+    }
+}
+
 // <prefix>[/type][/model][/subtype][/channel][/id]/battery: "OK"|"LOW"
 static void R_API_CALLCONV print_mqtt_data(data_output_t *output, data_t *data, char const *format)
 {
@@ -338,34 +597,24 @@ static void R_API_CALLCONV print_mqtt_data(data_output_t *output, data_t *data,
         // collect well-known top level keys
         data_t *data_model = NULL;
         for (data_t *d = data; d; d = d->next) {
-            if (!strcmp(d->key, "model"))
+            if (d->key_id == DATA_KEY_MODEL)
                 data_model = d;
         }
 
         // "states" topic
         if (!data_model) {
             if (mqtt->states) {
-                size_t message_size = 20000; // state message need a large buffer
-                char *message       = malloc(message_size);
-                if (!message) {
-                    WARN_MALLOC("print_mqtt_data()");
-                    return; // NOTE: skip output on alloc failure.
-                }
-                data_print_jsons(data, message, message_size);
-                expand_topic(mqtt->topic, mqtt->states, data, mqtt->hostname);
-                mqtt_client_publish(mqtt->mqc, mqtt->topic, message);
+                expand_topic(mqtt->topic, sizeof(mqtt->topic), mqtt->states, data, mqtt->hostname);
+                mqtt_publish_event(mqtt, data);
                 *mqtt->topic = '\0'; // clear topic
-                free(message);
             }
             return;
         }
 
         // "events" topic
         if (mqtt->events) {
-            char message[2048]; // we expect the biggest strings to be around 500 bytes.
-            data_print_jsons(data, message, sizeof(message));
-            expand_topic(mqtt->topic, mqtt->events, data, mqtt->hostname);
-            mqtt_client_publish(mqtt->mqc, mqtt->topic, message);
+            expand_topic(mqtt->topic, sizeof(mqtt->topic), mqtt->events, data, mqtt->hostname);
+            mqtt_publish_event(mqtt, data);
             *mqtt->topic = '\0'; // clear topic
         }
 
@@ -374,7 +623,14 @@ static void R_API_CALLCONV print_mqtt_data(data_output_t *output, data_t *data,
             return;
         }
 
-        end = expand_topic(mqtt->topic, mqtt->devices, data, mqtt->hostname);
+        end = expand_topic(mqtt->topic, sizeof(mqtt->topic), mqtt->devices, data, mqtt->hostname);
+
+        // the whole event in one message instead of one message per field
+        if (mqtt->batch) {
+            mqtt_publish_event(mqtt, data);
+            *mqtt->topic = '\0'; // clear topic
+            return;
+        }
     }
 
     while (data) {
@@ -407,10 +663,10 @@ static void R_API_CALLCONV print_mqtt_double(data_output_t *output, double data,
     char str[20];
     // use scientific notation for very big/small values
     if (data > 1e7 || data < 1e-4) {
-        snprintf(str, 20, "%g", data);
+        format_double(str, 20, "%g", data);
     }
     else {
-        int ret = snprintf(str, 20, "%.5f", data);
+        int ret = format_double(str, 20, "%.5f", data);
         // remove trailing zeros, always keep one digit after the decimal point
         char *p = str + ret - 1;
         while (*p == '0' && p[-1] != '.') {
@@ -428,6 +684,23 @@ static void R_API_CALLCONV print_mqtt_int(data_output_t *output, int data, char
     print_mqtt_string(output, str, format);
 }
 
+static unsigned R_API_CALLCONV data_output_mqtt_drops(data_output_t *output)
+{
+    data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
+
+    return mqtt->mqc->drops;
+}
+
+/// The bytes of the backlog held while not connected, the send buffer, and the serialization buffer.
+static size_t R_API_CALLCONV data_output_mqtt_memory(data_output_t *output)
+{
+    data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
+    mqtt_client_t *mqc       = mqtt->mqc;
+
+    return sizeof(*mqtt) + sizeof(*mqc) + mqtt->buf.size + mqc->queue.size
+            + (mqc->conn ? mqc->conn->send_mbuf.size : 0);
+}
+
 static void R_API_CALLCONV data_output_mqtt_free(data_output_t *output)
 {
     data_output_mqtt_t *mqtt = (data_output_mqtt_t *)output;
@@ -435,14 +708,15 @@ static void R_API_CALLCONV data_output_mqtt_free(data_output_t *output)
     if (!mqtt)
         return;
 
-    free(mqtt->devices);
-    free(mqtt->events);
-    free(mqtt->states);
+    mqtt_topic_free(mqtt->devices);
+    mqtt_topic_free(mqtt->events);
+    mqtt_topic_free(mqtt->states);
     //free(mqtt->homie);
     //free(mqtt->hass);
 
     mqtt_client_free(mqtt->mqc);
 
+    data_buf_free(&mqtt->buf);
     free(mqtt);
 }
 
@@ -500,6 +774,7 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
     char *pass = NULL;
     int retain = 0;
     int qos = 0;
+    size_t queue_size = MQTT_QUEUE_DEFAULT;
 
     // parse host and port
     tls_opts_t tls_opts = {0};
@@ -525,11 +800,17 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
             pass = val;
         else if (!strcasecmp(key, "r") || !strcasecmp(key, "retain"))
             retain = atobv(val, 1);
+        else if (!strcasecmp(key, "cbor"))
+            mqtt->cbor = atobv(val, 1);
+        else if (!strcasecmp(key, "b") || !strcasecmp(key, "batch"))
+            mqtt->batch = atobv(val, 1);
         else if (!strcasecmp(key, "q") || !strcasecmp(key, "qos"))
             qos = atoiv(val, 1);
+        else if (!strcasecmp(key, "queue"))
+            queue_size = atouint32_metric(val, "-F mqtt queue: ");
         // Simple key-topic mapping
         else if (!strcasecmp(key, "d") || !strcasecmp(key, "devices"))
-            mqtt->devices = mqtt_topic_default(val, base_topic, path_devices);
+            mqtt->devices = mqtt_topic_compile(mqtt_topic_default(val, base_topic, path_devices));
         // deprecated, remove this
         else if (!strcasecmp(key, "c") || !strcasecmp(key, "usechannel")) {
             fprintf(stderr, "\"usechannel=...\" has been removed. Use a topic format string:\n");
@@ -541,10 +822,10 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
         }
         // JSON events to single topic
         else if (!strcasecmp(key, "e") || !strcasecmp(key, "events"))
-            mqtt->events = mqtt_topic_default(val, base_topic, path_events);
+            mqtt->events = mqtt_topic_compile(mqtt_topic_default(val, base_topic, path_events));
         // JSON states to single topic
         else if (!strcasecmp(key, "s") || !strcasecmp(key, "states"))
-            mqtt->states = mqtt_topic_default(val, base_topic, path_states);
+            mqtt->states = mqtt_topic_compile(mqtt_topic_default(val, base_topic, path_states));
         // TODO: Homie Convention https://homieiot.github.io/
         //else if (!strcasecmp(key, "o") || !strcasecmp(key, "homie"))
         //    mqtt->homie = mqtt_topic_default(val, NULL, "homie"); // base topic
@@ -562,25 +843,27 @@ struct data_output *data_output_mqtt_create(struct mg_mgr *mgr, char *param, cha
 
     // Default is to use all formats
     if (!mqtt->devices && !mqtt->events && !mqtt->states) {
-        mqtt->devices = mqtt_topic_default(NULL, base_topic, path_devices);
-        mqtt->events  = mqtt_topic_default(NULL, base_topic, path_events);
-        mqtt->states  = mqtt_topic_default(NULL, base_topic, path_states);
+        mqtt->devices = mqtt_topic_compile(mqtt_topic_default(NULL, base_topic, path_devices));
+        mqtt->events  = mqtt_topic_compile(mqtt_topic_default(NULL, base_topic, path_events));
+        mqtt->states  = mqtt_topic_compile(mqtt_topic_default(NULL, base_topic, path_states));
     }
     if (mqtt->devices)
-        fprintf(stderr, "Publishing device info to MQTT topic \"%s\".\n", mqtt->devices);
+        fprintf(stderr, "Publishing device info to MQTT topic \"%s\".\n", mqtt->devices->format);
     if (mqtt->events)
-        fprintf(stderr, "Publishing events info to MQTT topic \"%s\".\n", mqtt->events);
+        fprintf(stderr, "Publishing events info to MQTT topic \"%s\".\n", mqtt->events->format);
     if (mqtt->states)
-        fprintf(stderr, "Publishing states info to MQTT topic \"%s\".\n", mqtt->states);
-
-    mqtt->output.print_data   = print_mqtt_data;
-    mqtt->output.print_array  = print_mqtt_array;
-    mqtt->output.print_string = print_mqtt_string;
-    mqtt->output.print_double = print_mqtt_double;
-    mqtt->output.print_int    = print_mqtt_int;
-    mqtt->output.output_free  = data_output_mqtt_free;
-
-    mqtt->mqc = mqtt_client_init(mgr, &tls_opts, host, port, user, pass, client_id, retain, qos);
+        fprintf(stderr, "Publishing states info to MQTT topic \"%s\".\n", mqtt->states->format);
+
+    mqtt->output.print_data    = print_mqtt_data;
+    mqtt->output.print_array   = print_mqtt_array;
+    mqtt->output.print_string  = print_mqtt_string;
+    mqtt->output.print_double  = print_mqtt_double;
+    mqtt->output.print_int     = print_mqtt_int;
+    mqtt->output.output_drops  = data_output_mqtt_drops;
+    mqtt->output.output_memory = data_output_mqtt_memory;
+    mqtt->output.output_free   = data_output_mqtt_free;
+
+    mqtt->mqc = mqtt_client_init(mgr, &tls_opts, host, port, user, pass, client_id, retain, qos, queue_size);
 
     return &mqtt->output;
 }
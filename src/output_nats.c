@@ -0,0 +1,518 @@
+/** @file
+    NATS output for rtl_433 events.
+
+    Events are published with the NATS text protocol on a TCP connection.
+    New messages are appended to the pending buffer, a batch of whole messages is sent
+    followed by a PING, and the PONG acknowledges the batch as the server processes the
+    commands of a connection in order. Only one batch is in flight, a batch that is not
+    acknowledged when the connection closes is sent again after reconnecting.
+    While the server is unreachable the pending messages are held up to the spool size,
+    the oldest messages are dropped.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_nats.h"
+#include "output_cbor.h"
+#include "optparse.h"
+#include "abuf.h"
+#include "fatal.h"
+#include "r_util.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mongoose.h"
+
+/// Maximum bytes of a batch, at least one message is sent.
+#define NATS_BATCH_BYTES (256 * 1024)
+/// Maximum length of a server command line, e.g. the INFO.
+#define NATS_LINE_MAX (64 * 1024)
+/// Maximum backoff in seconds after a failed connection.
+#define NATS_RETRY_MAX 60.0
+
+/* NATS client */
+
+typedef struct {
+    struct data_output output;
+    struct mg_mgr *mgr;
+    struct mg_connection *conn;
+    int ready;              ///< the CONNECT is sent, messages can be published
+    int ping_out;           ///< a PING is not answered yet
+    int established;        ///< the server answered a PING on this connection
+    int prev_status;
+    char address[253 + 6 + 1]; // dns max + port
+    char connect[768];      ///< the CONNECT and the first PING
+    char subject[200];
+    int cbor;               ///< publish events as CBOR instead of JSON
+    data_buf_t buf;         ///< serialization buffer, grows to the largest
+    struct mbuf pending;    ///< PUB commands not yet sent
+    struct mbuf sending;    ///< PUB commands of the batch in flight
+    unsigned pending_msgs;
+    unsigned sending_msgs;
+    unsigned acked_msgs;
+    unsigned dropped_msgs;
+    unsigned batch_msgs;    ///< send once this many messages are pending, at most this many per batch, 0 for any
+    unsigned linger_ms;     ///< send once the oldest pending message waited this long, 0 for no wait
+    unsigned spool_bytes;   ///< pending bytes to hold while the server is unreachable
+    size_t max_payload;     ///< from the server INFO, 0 for unknown
+    double first_time;      ///< time the oldest pending message was added
+    double retry_time;      ///< no reconnect before this time after a failed connection
+    double retry_delay;     ///< backoff after a failed connection, doubled up to NATS_RETRY_MAX
+    int spool_full;         ///< messages were dropped since the last acknowledged batch
+} nats_client_t;
+
+static void nats_client_send(nats_client_t *ctx, int force);
+
+/// Size of the first PUB command in a buffer, the header line, the payload, and the CRLF.
+static size_t nats_message_size(char const *buf, size_t len)
+{
+    char const *eol = memchr(buf, '\n', len);
+    if (!eol)
+        return len;
+    char const *num = eol;
+    while (num > buf && num[-1] != ' ') {
+        num--;
+    }
+    size_t size = (size_t)(eol - buf) + 1 + strtoul(num, NULL, 10) + 2;
+    return size < len ? size : len;
+}
+
+/// Drop the oldest pending messages until the spool limit is met.
+static void nats_client_limit(nats_client_t *ctx)
+{
+    struct mbuf *buf = &ctx->pending;
+    while (buf->len > ctx->spool_bytes && ctx->pending_msgs) {
+        mbuf_remove(buf, nats_message_size(buf->buf, buf->len));
+        ctx->pending_msgs--;
+        ctx->dropped_msgs++;
+        if (!ctx->spool_full)
+            fprintf(stderr, "NATS spool is full, dropping the oldest messages\n");
+        ctx->spool_full = 1;
+    }
+}
+
+/// The connection is gone, put the batch in flight back in front of the pending messages and back off.
+static void nats_client_closed(nats_client_t *ctx)
+{
+    if (ctx->established)
+        fprintf(stderr, "NATS connection lost, %u messages pending\n", ctx->pending_msgs + ctx->sending_msgs);
+    ctx->conn        = NULL;
+    ctx->ready       = 0;
+    ctx->ping_out    = 0;
+    ctx->established = 0;
+    if (ctx->sending_msgs) {
+        mbuf_insert(&ctx->pending, 0, ctx->sending.buf, ctx->sending.len);
+        ctx->pending_msgs += ctx->sending_msgs;
+        ctx->sending_msgs = 0;
+        ctx->sending.len  = 0;
+        nats_client_limit(ctx);
+    }
+
+    ctx->retry_delay = ctx->retry_delay ? ctx->retry_delay * 2 : 1.0;
+    if (ctx->retry_delay > NATS_RETRY_MAX)
+        ctx->retry_delay = NATS_RETRY_MAX;
+    ctx->retry_time = mg_time() + ctx->retry_delay;
+}
+
+/// The server answered the PING, the batch in flight is delivered.
+static void nats_client_acked(nats_client_t *ctx)
+{
+    if (!ctx->established)
+        fprintf(stderr, "NATS connection established%s\n", ctx->retry_delay ? " again" : "");
+    if (ctx->spool_full)
+        fprintf(stderr, "NATS is reachable again, %u messages pending, %u messages dropped\n",
+                ctx->pending_msgs, ctx->dropped_msgs);
+    ctx->acked_msgs += ctx->sending_msgs;
+    ctx->sending_msgs = 0;
+    ctx->sending.len  = 0;
+    ctx->ping_out     = 0;
+    ctx->established  = 1;
+    ctx->retry_delay  = 0;
+    ctx->retry_time   = 0;
+    ctx->spool_full   = 0;
+}
+
+/// Find a JSON key with its colon in a line that is not terminated, returns the text after it or NULL.
+static char const *nats_info_find(char const *line, size_t len, char const *key)
+{
+    size_t key_len = strlen(key);
+    for (size_t i = 0; i + key_len < len; ++i) {
+        if (!memcmp(line + i, key, key_len))
+            return line + i + key_len;
+    }
+    return NULL;
+}
+
+/// The server INFO, the first command on a connection.
+static void nats_client_info(nats_client_t *ctx, struct mg_connection *nc, char const *line, size_t len)
+{
+    char const *max_payload = nats_info_find(line, len, "\"max_payload\":");
+    if (max_payload)
+        ctx->max_payload = strtoul(max_payload, NULL, 10);
+    char const *tls = nats_info_find(line, len, "\"tls_required\":");
+    if (tls && !strncmp(tls, "true", 4)) {
+        if (ctx->prev_status != -1)
+            fprintf(stderr, "NATS server (%s) requires TLS, which is not supported\n", ctx->address);
+        ctx->prev_status = -1;
+        nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+        return;
+    }
+    if (ctx->ready)
+        return; // an update of the cluster info
+    mg_send(nc, ctx->connect, (int)strlen(ctx->connect));
+    ctx->ready    = 1;
+    ctx->ping_out = 1; // the CONNECT is checked with a PING
+}
+
+/// Handle the complete command lines received from the server.
+static void nats_client_recv(nats_client_t *ctx, struct mg_connection *nc)
+{
+    struct mbuf *io = &nc->recv_mbuf;
+    char *eol;
+    while ((eol = memchr(io->buf, '\n', io->len))) {
+        size_t len = (size_t)(eol - io->buf) + 1;
+        char *line = io->buf;
+        if (!strncmp(line, "PING", 4)) {
+            mg_send(nc, "PONG\r\n", 6);
+        }
+        else if (!strncmp(line, "PONG", 4)) {
+            nats_client_acked(ctx);
+        }
+        else if (!strncmp(line, "INFO", 4)) {
+            nats_client_info(ctx, nc, line, len);
+        }
+        else if (!strncmp(line, "-ERR", 4)) {
+            int text_len = (int)len - 5;
+            while (text_len > 0 && (line[4 + text_len] == '\r' || line[4 + text_len] == '\n')) {
+                text_len--;
+            }
+            fprintf(stderr, "NATS server error:%.*s\n", text_len, line + 4);
+        }
+        mbuf_remove(io, len); // "+OK" and other commands are ignored
+    }
+    if (io->len > NATS_LINE_MAX) {
+        fprintf(stderr, "NATS server sent an overlong command\n");
+        nc->flags |= MG_F_CLOSE_IMMEDIATELY;
+    }
+}
+
+static void nats_client_event(struct mg_connection *nc, int ev, void *ev_data)
+{
+    // note that while shutting down the ctx is NULL
+    nats_client_t *ctx = (nats_client_t *)nc->user_data;
+
+    switch (ev) {
+    case MG_EV_CONNECT: {
+        int connect_status = *(int *)ev_data;
+        if (connect_status != 0) {
+            // Error, print only once
+            if (ctx && ctx->prev_status != connect_status)
+                fprintf(stderr, "NATS connect error: %s\n", strerror(connect_status));
+        }
+        if (ctx)
+            ctx->prev_status = connect_status;
+        break;
+    }
+    case MG_EV_RECV:
+        if (!ctx)
+            break; // shutting down
+        nats_client_recv(ctx, nc);
+        nats_client_send(ctx, 0);
+        break;
+    case MG_EV_POLL:
+        if (ctx)
+            nats_client_send(ctx, 0); // checks the linger time
+        break;
+    case MG_EV_CLOSE:
+        if (ctx && ctx->conn == nc)
+            nats_client_closed(ctx);
+        break;
+    }
+}
+
+static void nats_client_connect(nats_client_t *ctx)
+{
+    struct mg_connect_opts opts = {.user_data = ctx};
+    char const *error_string    = NULL;
+    opts.error_string           = &error_string;
+    ctx->conn = mg_connect_opt(ctx->mgr, ctx->address, nats_client_event, opts);
+    if (!ctx->conn) {
+        fprintf(stderr, "NATS connect (%s) failed%s%s\n", ctx->address,
+                error_string ? ": " : "", error_string ? error_string : "");
+        nats_client_closed(ctx);
+    }
+}
+
+static void nats_client_send(nats_client_t *ctx, int force)
+{
+    struct mbuf *buf = &ctx->pending;
+    double now       = mg_time();
+
+    if (!ctx->conn) {
+        if (now >= ctx->retry_time)
+            nats_client_connect(ctx);
+        return;
+    }
+    if (!ctx->ready || ctx->ping_out || !ctx->pending_msgs)
+        return;
+    int due = (!ctx->batch_msgs && !ctx->linger_ms)
+            || (ctx->batch_msgs && ctx->pending_msgs >= ctx->batch_msgs)
+            || buf->len >= NATS_BATCH_BYTES
+            || (ctx->linger_ms && (now - ctx->first_time) * 1000.0 >= ctx->linger_ms);
+    if (!force && !due)
+        return;
+
+    // take whole messages up to the batch limits, at least one message
+    size_t len    = 0;
+    unsigned msgs = 0;
+    while (msgs < ctx->pending_msgs && (!ctx->batch_msgs || msgs < ctx->batch_msgs)) {
+        size_t size = nats_message_size(buf->buf + len, buf->len - len);
+        if (msgs && len + size > NATS_BATCH_BYTES)
+            break;
+        len += size;
+        msgs++;
+    }
+
+    ctx->sending.len = 0;
+    mbuf_append(&ctx->sending, buf->buf, len);
+    mbuf_remove(buf, len);
+    ctx->pending_msgs -= msgs;
+    ctx->sending_msgs = msgs;
+    ctx->first_time   = now;
+
+    mg_send(ctx->conn, ctx->sending.buf, (int)ctx->sending.len);
+    mg_send(ctx->conn, "PING\r\n", 6);
+    ctx->ping_out = 1;
+}
+
+/* Helper */
+
+/// Append a JSON string field to the CONNECT, quotes and backslashes escaped.
+static void nats_connect_field(abuf_t *buf, char const *key, char const *val, size_t len)
+{
+    abuf_printf(buf, ",\"%s\":\"", key);
+    for (size_t i = 0; i < len; ++i) {
+        if (val[i] == '"' || val[i] == '\\')
+            abuf_printf(buf, "\\%c", val[i]);
+        else if ((unsigned char)val[i] >= ' ')
+            abuf_printf(buf, "%c", val[i]);
+    }
+    abuf_cat(buf, "\"");
+}
+
+/// clean the subject token inplace to [-_A-Za-z0-9], esp. not whitespace, ., *, >
+static char *nats_sanitize_token(char *token)
+{
+    for (char *p = token; *p; ++p)
+        if (*p != '-' && *p != '_' && (*p < 'A' || *p > 'Z') && (*p < 'a' || *p > 'z') && (*p < '0' || *p > '9'))
+            *p = '_';
+
+    return token;
+}
+
+/* NATS printer */
+
+static void R_API_CALLCONV print_nats_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    nats_client_t *nats = (nats_client_t *)output;
+
+    // "<subject>.<model>", or "<subject>" without a model
+    char header[sizeof(nats->subject) + 128];
+    int len = snprintf(header, sizeof(nats->subject) + 8, "PUB %s", nats->subject);
+    for (data_t *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL && d->type == DATA_STRING) {
+            header[len++] = '.';
+            snprintf(header + len, 64, "%s", (char const *)d->value.v_ptr);
+            nats_sanitize_token(header + len);
+            len += (int)strlen(header + len);
+            break;
+        }
+    }
+
+    char const *payload;
+    size_t payload_len;
+    if (nats->cbor) {
+        payload_len = data_print_cbor(data, (uint8_t *)nats->buf.buf, nats->buf.size);
+        if (payload_len > nats->buf.size) {
+            if (!data_buf_reserve(&nats->buf, payload_len))
+                return; // NOTE: skip output on alloc failure.
+            payload_len = data_print_cbor(data, (uint8_t *)nats->buf.buf, nats->buf.size);
+        }
+        payload = nats->buf.buf;
+    }
+    else {
+        payload = data_print_jsons_buf(data, &nats->buf, &payload_len);
+        if (!payload)
+            return; // NOTE: skip output on alloc failure.
+    }
+    if (nats->max_payload && payload_len > nats->max_payload) {
+        nats->dropped_msgs++;
+        return;
+    }
+    len += snprintf(header + len, 32, " %u\r\n", (unsigned)payload_len);
+
+    struct mbuf *buf = &nats->pending;
+    mbuf_append(buf, header, (size_t)len);
+    mbuf_append(buf, payload, payload_len);
+    mbuf_append(buf, "\r\n", 2);
+    if (!nats->pending_msgs)
+        nats->first_time = mg_time();
+    nats->pending_msgs++;
+    nats_client_limit(nats);
+    nats_client_send(nats, 0);
+}
+
+static void R_API_CALLCONV data_output_nats_sync(data_output_t *output, int force)
+{
+    nats_client_t *nats = (nats_client_t *)output;
+
+    // reconnects, a forced sync sends the pending messages now
+    nats_client_send(nats, force);
+}
+
+static unsigned R_API_CALLCONV data_output_nats_drops(data_output_t *output)
+{
+    nats_client_t *nats = (nats_client_t *)output;
+
+    return nats->dropped_msgs;
+}
+
+/// The bytes of the pending messages, the batch in flight, and the serialization buffer.
+static size_t R_API_CALLCONV data_output_nats_memory(data_output_t *output)
+{
+    nats_client_t *nats = (nats_client_t *)output;
+
+    return sizeof(*nats) + nats->pending.size + nats->sending.size + nats->buf.size
+            + (nats->conn ? nats->conn->send_mbuf.size : 0);
+}
+
+static void R_API_CALLCONV data_output_nats_free(data_output_t *output)
+{
+    nats_client_t *nats = (nats_client_t *)output;
+
+    if (!nats)
+        return;
+
+    // remove ctx from our connections
+    if (nats->conn) {
+        nats->conn->user_data = NULL;
+        nats->conn->flags |= MG_F_CLOSE_IMMEDIATELY;
+    }
+
+    fprintf(stderr, "NATS output: %u messages acknowledged, %u messages not acknowledged, %u messages dropped\n",
+            nats->acked_msgs, nats->pending_msgs + nats->sending_msgs, nats->dropped_msgs);
+
+    mbuf_free(&nats->sending);
+    mbuf_free(&nats->pending);
+    data_buf_free(&nats->buf);
+    free(nats);
+}
+
+struct data_output *data_output_nats_create(struct mg_mgr *mgr, char *opts)
+{
+    nats_client_t *nats = calloc(1, sizeof(nats_client_t));
+    if (!nats) {
+        FATAL_CALLOC("data_output_nats_create()");
+    }
+
+    char const *subject = "rtl_433";
+    nats->spool_bytes   = 1024 * 1024;
+
+    // param/opts starts with URL
+    char *url = opts;
+    opts      = strchr(opts, ',');
+    if (opts) {
+        *opts = '\0';
+        opts++;
+    }
+
+    // check if valid URL has been provided
+    struct mg_str user_info, host;
+    unsigned port = 0;
+    if (mg_parse_uri(mg_mk_str(url), NULL, &user_info, &host, &port, NULL, NULL, NULL) != 0 || !host.len || host.len > 253) {
+        fprintf(stderr, "Invalid URL to NATS specified.\n"
+                        "Something like \"nats://[<user>:<pass>@]<host>[:<port>]\" required at least.\n");
+        exit(1);
+    }
+    // if the host is an IPv6 address it needs quoting
+    if (memchr(host.p, ':', host.len))
+        snprintf(nats->address, sizeof(nats->address), "[%.*s]:%u", (int)host.len, host.p, port ? port : 4222);
+    else
+        snprintf(nats->address, sizeof(nats->address), "%.*s:%u", (int)host.len, host.p, port ? port : 4222);
+
+    char const *token = NULL;
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "s") || !strcasecmp(key, "subject"))
+            subject = val;
+        else if (!strcasecmp(key, "t") || !strcasecmp(key, "token"))
+            token = val;
+        else if (!strcasecmp(key, "batch"))
+            nats->batch_msgs = atouint32_metric(val, "-F nats batch: ");
+        else if (!strcasecmp(key, "linger"))
+            nats->linger_ms = atouint32_metric(val, "-F nats linger: ");
+        else if (!strcasecmp(key, "spool"))
+            nats->spool_bytes = atouint32_metric(val, "-F nats spool: ");
+        else if (!strcasecmp(key, "cbor"))
+            nats->cbor = atobv(val, 1);
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
+    if (!subject || !*subject || strpbrk(subject, " \t\r\n") || strlen(subject) >= sizeof(nats->subject)) {
+        fprintf(stderr, "Invalid NATS subject \"%s\".\n", subject ? subject : "");
+        exit(1);
+    }
+    snprintf(nats->subject, sizeof(nats->subject), "%s", subject);
+
+    // the CONNECT with the credentials of the URL, or a token
+    abuf_t connect;
+    abuf_init(&connect, nats->connect, sizeof(nats->connect));
+    abuf_cat(&connect, "CONNECT {\"verbose\":false,\"pedantic\":false,\"lang\":\"C\",\"version\":\"1\",\"name\":\"rtl_433\"");
+    char const *colon = user_info.len ? memchr(user_info.p, ':', user_info.len) : NULL;
+    if (colon) {
+        nats_connect_field(&connect, "user", user_info.p, (size_t)(colon - user_info.p));
+        nats_connect_field(&connect, "pass", colon + 1, user_info.len - (size_t)(colon - user_info.p) - 1);
+    }
+    else if (user_info.len) {
+        nats_connect_field(&connect, "auth_token", user_info.p, user_info.len);
+    }
+    if (token)
+        nats_connect_field(&connect, "auth_token", token, strlen(token));
+    abuf_cat(&connect, "}\r\nPING\r\n");
+    if (!str_endswith(nats->connect, "PING\r\n")) {
+        fprintf(stderr, "NATS credentials are too long.\n");
+        exit(1);
+    }
+
+    nats->output.print_data    = print_nats_data;
+    nats->output.output_sync   = data_output_nats_sync;
+    nats->output.output_drops  = data_output_nats_drops;
+    nats->output.output_memory = data_output_nats_memory;
+    nats->output.output_free   = data_output_nats_free;
+
+    if (nats->batch_msgs && !nats->linger_ms)
+        nats->linger_ms = 1000; // don't hold a partial batch forever
+    if (nats->spool_bytes < NATS_BATCH_BYTES)
+        nats->spool_bytes = NATS_BATCH_BYTES;
+
+    fprintf(stderr, "Publishing data to NATS (%s) subject \"%s\"\n", nats->address, nats->subject);
+
+    nats->mgr = mgr;
+    mbuf_init(&nats->pending, 0);
+    mbuf_init(&nats->sending, 0);
+    nats_client_connect(nats);
+
+    return &nats->output;
+}
@@ -0,0 +1,468 @@
+/** @file
+    Output queue, prints events to a slow output on a writer thread.
+
+    The frozen events are retained and queued in a bounded ring, the writer
+    thread prints and flushes them on the inner output and frees them, the
+    retain count is atomic. Sync requests are passed on once the queued events
+    are printed.
+    The events of a batch wake the writer once, the writer prints the queued
+    events as a batch of the inner output.
+    Urgent events go to a short lane that the writer prints first and writes
+    out at once, if the lane is full they queue with the other events.
+    A polled queue has no writer thread, another thread prints the events
+    with data_output_queue_poll() and is woken for each queued event, or batch.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_queue.h"
+#include "data.h"
+#include "compat_pthread.h"
+#include "thread_pin.h"
+#include "r_util.h"
+#include "fatal.h"
+#include "alloc_count.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef THREADS
+
+#define OUTPUT_QUEUE_URGENT 16 // capacity of the urgent lane
+
+typedef struct {
+    struct data_output output;
+    struct data_output *inner;
+    output_queue_policy_t policy;
+    pthread_t thread;          ///< the writer thread, unless polled
+    void (*wake)(void *ctx);   ///< wakes the polling thread, NULL if there is a writer thread
+    void *wake_ctx;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;  ///< signals a queued event or the exit
+    pthread_cond_t space_cond; ///< signals the writer took an event
+    int exit;
+    int sync;                  ///< a data_output_sync() request, 1 if due, 2 if forced
+    unsigned drops;
+    unsigned size;             ///< capacity of the queue ring
+    data_t **queue;            ///< ring of events waiting to be printed
+    unsigned queue_first;
+    unsigned queue_len;
+    data_t *urgent[OUTPUT_QUEUE_URGENT]; ///< ring of urgent events, printed first
+    unsigned urgent_first;
+    unsigned urgent_len;
+} data_output_queue_t;
+
+/// Print the next queued event or pass on a sync request, the lock is held but released while printing.
+static int output_queue_work(data_output_queue_t *q)
+{
+    if (q->urgent_len) {
+        data_t *data    = q->urgent[q->urgent_first];
+        q->urgent_first = (q->urgent_first + 1) % OUTPUT_QUEUE_URGENT;
+        q->urgent_len--;
+        pthread_mutex_unlock(&q->lock);
+
+        data_output_print_urgent(q->inner, data);
+        data_free(data);
+
+        pthread_mutex_lock(&q->lock);
+        return 1;
+    }
+    if (q->queue_len) {
+        data_t *data   = q->queue[q->queue_first];
+        q->queue_first = (q->queue_first + 1) % q->size;
+        q->queue_len--;
+        pthread_cond_signal(&q->space_cond);
+        pthread_mutex_unlock(&q->lock);
+
+        if (!q->inner->batch)
+            data_output_batch_begin(q->inner); // ends once the queue is drained
+        data_output_print(q->inner, data);
+        data_free(data);
+
+        pthread_mutex_lock(&q->lock);
+        return 1;
+    }
+    if (q->inner->batch) {
+        pthread_mutex_unlock(&q->lock);
+        data_output_batch_end(q->inner);
+        pthread_mutex_lock(&q->lock);
+        return 1;
+    }
+    if (q->sync) {
+        int force = q->sync > 1;
+        q->sync   = 0;
+        pthread_mutex_unlock(&q->lock);
+        data_output_sync(q->inner, force);
+        pthread_mutex_lock(&q->lock);
+        return 1;
+    }
+    return 0;
+}
+
+static THREAD_RETURN THREAD_CALL output_queue_thread(void *arg)
+{
+    data_output_queue_t *q = arg;
+    thread_pin_self(THREAD_OUTPUT);
+    pthread_mutex_lock(&q->lock);
+    for (;;) {
+        if (output_queue_work(q))
+            continue;
+        if (q->exit)
+            break; // exit with all events printed
+        pthread_cond_wait(&q->work_cond, &q->lock);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return (THREAD_RETURN)0;
+}
+
+static void R_API_CALLCONV print_queue_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->queue_len == q->size) {
+        if (q->policy == OUTPUT_QUEUE_DROP_NEWEST) {
+            q->drops++;
+            pthread_mutex_unlock(&q->lock);
+            return;
+        }
+        else if (q->policy == OUTPUT_QUEUE_DROP_OLDEST) {
+            data_free(q->queue[q->queue_first]);
+            q->queue_first = (q->queue_first + 1) % q->size;
+            q->queue_len--;
+            q->drops++;
+        }
+        else {
+            while (q->queue_len == q->size) {
+                pthread_cond_wait(&q->space_cond, &q->lock);
+            }
+        }
+    }
+    q->queue[(q->queue_first + q->queue_len) % q->size] = data_retain(data);
+    q->queue_len++;
+    // in a batch the writer is woken at the end, or early if the queue fills up
+    int wake = !output->batch || q->queue_len >= q->size / 2;
+    if (wake)
+        pthread_cond_signal(&q->work_cond);
+    pthread_mutex_unlock(&q->lock);
+    if (wake && q->wake)
+        q->wake(q->wake_ctx);
+}
+
+static void R_API_CALLCONV print_queue_urgent(data_output_t *output, data_t *data)
+{
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->urgent_len == OUTPUT_QUEUE_URGENT) {
+        pthread_mutex_unlock(&q->lock);
+        print_queue_data(output, data, NULL); // the lane is full, queue with the other events
+        return;
+    }
+    q->urgent[(q->urgent_first + q->urgent_len) % OUTPUT_QUEUE_URGENT] = data_retain(data);
+    q->urgent_len++;
+    pthread_cond_signal(&q->work_cond);
+    pthread_mutex_unlock(&q->lock);
+    if (q->wake)
+        q->wake(q->wake_ctx);
+}
+
+static void R_API_CALLCONV data_output_queue_batch(data_output_t *output, unsigned num_events)
+{
+    UNUSED(num_events);
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    pthread_mutex_lock(&q->lock);
+    pthread_cond_signal(&q->work_cond);
+    pthread_mutex_unlock(&q->lock);
+    if (q->wake)
+        q->wake(q->wake_ctx);
+}
+
+/// The events dropped by the queue and those the inner output dropped itself.
+static unsigned R_API_CALLCONV data_output_queue_total_drops(data_output_t *output)
+{
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    return q->drops + data_output_drops(q->inner);
+}
+
+static size_t event_memory(data_t const *data);
+
+/// The heap bytes of an array with its values.
+static size_t array_memory(data_array_t const *array)
+{
+    size_t bytes = alloc_block_size(array) + alloc_block_size(array->values);
+    for (int i = 0; i < array->num_values; ++i) {
+        if (array->type == DATA_DATA)
+            bytes += event_memory(((data_t **)array->values)[i]);
+        else if (array->type == DATA_ARRAY)
+            bytes += array_memory(((data_array_t **)array->values)[i]);
+    }
+    return bytes;
+}
+
+/// The heap bytes of an event with its nested objects and arrays, the chunks with their usable size if known.
+static size_t event_memory(data_t const *data)
+{
+    size_t bytes = 0;
+    for (; data; data = data->next) {
+        if (data->chunk == data) {
+            size_t block = alloc_block_size(data);
+            bytes += block ? block : sizeof(*data);
+        }
+        else if (!data->chunk || !alloc_block_size(data->chunk)) {
+            bytes += sizeof(*data);
+        }
+        if (data->type == DATA_DATA)
+            bytes += event_memory(data->value.v_ptr);
+        else if (data->type == DATA_ARRAY)
+            bytes += array_memory(data->value.v_ptr);
+    }
+    return bytes;
+}
+
+/// The bytes of the queue and those the inner output holds.
+static size_t R_API_CALLCONV data_output_queue_total_memory(data_output_t *output)
+{
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    return data_output_queue_memory(output) + data_output_memory(q->inner);
+}
+
+static void R_API_CALLCONV data_output_queue_start(struct data_output *output, char const *const *fields, int num_fields)
+{
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    // the outputs are started before the first event is queued
+    data_output_start(q->inner, fields, num_fields);
+}
+
+static void R_API_CALLCONV data_output_queue_sync(data_output_t *output, int force)
+{
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    pthread_mutex_lock(&q->lock);
+    if (q->sync < 1 + !!force)
+        q->sync = 1 + !!force;
+    pthread_cond_signal(&q->work_cond);
+    pthread_mutex_unlock(&q->lock);
+    if (q->wake)
+        q->wake(q->wake_ctx);
+}
+
+static void R_API_CALLCONV data_output_queue_free(data_output_t *output)
+{
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    pthread_mutex_lock(&q->lock);
+    q->exit = 1;
+    if (q->wake) {
+        while (output_queue_work(q)) {
+            // the polling thread is stopped, print the rest here
+        }
+    }
+    pthread_cond_signal(&q->work_cond);
+    pthread_mutex_unlock(&q->lock);
+    if (!q->wake)
+        pthread_join(q->thread, NULL);
+
+    if (q->drops)
+        fprintf(stderr, "Output queue dropped %u events\n", q->drops);
+
+    data_output_free(q->inner);
+    pthread_cond_destroy(&q->space_cond);
+    pthread_cond_destroy(&q->work_cond);
+    pthread_mutex_destroy(&q->lock);
+    free(q->queue);
+    free(q);
+}
+
+static data_output_queue_t *output_queue_new(struct data_output *inner, unsigned size, output_queue_policy_t policy)
+{
+    data_output_queue_t *q = calloc(1, sizeof(data_output_queue_t));
+    if (!q) {
+        WARN_CALLOC("data_output_queue_create()");
+        return NULL;
+    }
+    q->queue = calloc(size, sizeof(*q->queue));
+    if (!q->queue) {
+        WARN_CALLOC("data_output_queue_create()");
+        free(q);
+        return NULL;
+    }
+
+    q->output.print_data    = print_queue_data;
+    q->output.output_start  = data_output_queue_start;
+    q->output.output_sync   = data_output_queue_sync;
+    q->output.output_batch  = data_output_queue_batch;
+    q->output.output_drops  = data_output_queue_total_drops;
+    q->output.output_memory = data_output_queue_total_memory;
+    q->output.output_urgent = print_queue_urgent;
+    q->output.output_free   = data_output_queue_free;
+    q->inner                = inner;
+    q->size                 = size;
+    q->policy               = policy;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->work_cond, NULL);
+    pthread_cond_init(&q->space_cond, NULL);
+    return q;
+}
+
+struct data_output *data_output_queue_create(struct data_output *inner, unsigned size, output_queue_policy_t policy)
+{
+    if (!inner || !size)
+        return inner;
+
+    data_output_queue_t *q = output_queue_new(inner, size, policy);
+    if (!q)
+        return inner; // NOTE: returns the unqueued output on alloc failure.
+
+    if (pthread_create(&q->thread, NULL, output_queue_thread, q)) {
+        fprintf(stderr, "%s: failed to start thread\n", __func__);
+        pthread_cond_destroy(&q->space_cond);
+        pthread_cond_destroy(&q->work_cond);
+        pthread_mutex_destroy(&q->lock);
+        free(q->queue);
+        free(q);
+        return inner;
+    }
+    return &q->output;
+}
+
+struct data_output *data_output_queue_create_polled(struct data_output *inner, unsigned size, output_queue_policy_t policy, void (*wake)(void *ctx), void *wake_ctx)
+{
+    if (!inner || !size || !wake)
+        return inner;
+
+    data_output_queue_t *q = output_queue_new(inner, size, policy);
+    if (!q)
+        return inner; // NOTE: returns the unqueued output on alloc failure.
+
+    q->wake     = wake;
+    q->wake_ctx = wake_ctx;
+    return &q->output;
+}
+
+void data_output_queue_poll(struct data_output *output)
+{
+    if (!output || output->print_data != print_queue_data)
+        return;
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->wake && output_queue_work(q)) {
+        // print all queued events
+    }
+    pthread_mutex_unlock(&q->lock);
+}
+
+unsigned data_output_queue_drops(struct data_output *output)
+{
+    if (!output || output->print_data != print_queue_data)
+        return 0;
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    return q->drops; // only changed on the feeding thread
+}
+
+unsigned data_output_queue_depth(struct data_output *output)
+{
+    if (!output || output->print_data != print_queue_data)
+        return 0;
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    pthread_mutex_lock(&q->lock);
+    unsigned depth = q->queue_len + q->urgent_len;
+    pthread_mutex_unlock(&q->lock);
+    return depth;
+}
+
+size_t data_output_queue_memory(struct data_output *output)
+{
+    if (!output || output->print_data != print_queue_data)
+        return 0;
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    pthread_mutex_lock(&q->lock);
+    size_t bytes = sizeof(*q) + q->size * sizeof(*q->queue);
+    for (unsigned i = 0; i < q->queue_len; ++i)
+        bytes += event_memory(q->queue[(q->queue_first + i) % q->size]);
+    for (unsigned i = 0; i < q->urgent_len; ++i)
+        bytes += event_memory(q->urgent[(q->urgent_first + i) % OUTPUT_QUEUE_URGENT]);
+    pthread_mutex_unlock(&q->lock);
+    return bytes;
+}
+
+int data_output_queue_check(struct data_output *output)
+{
+    return output && output->print_data == print_queue_data;
+}
+
+struct data_output *data_output_queue_inner(struct data_output *output)
+{
+    if (!output || output->print_data != print_queue_data)
+        return output;
+    data_output_queue_t *q = (data_output_queue_t *)output;
+
+    return q->inner; // never changed after creation
+}
+
+#else
+
+struct data_output *data_output_queue_create(struct data_output *inner, unsigned size, output_queue_policy_t policy)
+{
+    (void)policy;
+    if (size)
+        fprintf(stderr, "%s: built without threads support, printing synchronously\n", __func__);
+    return inner;
+}
+
+struct data_output *data_output_queue_create_polled(struct data_output *inner, unsigned size, output_queue_policy_t policy, void (*wake)(void *ctx), void *wake_ctx)
+{
+    (void)size;
+    (void)policy;
+    (void)wake;
+    (void)wake_ctx;
+    return inner;
+}
+
+void data_output_queue_poll(struct data_output *output)
+{
+    (void)output;
+}
+
+unsigned data_output_queue_drops(struct data_output *output)
+{
+    (void)output;
+    return 0;
+}
+
+unsigned data_output_queue_depth(struct data_output *output)
+{
+    (void)output;
+    return 0;
+}
+
+size_t data_output_queue_memory(struct data_output *output)
+{
+    (void)output;
+    return 0;
+}
+
+int data_output_queue_check(struct data_output *output)
+{
+    (void)output;
+    return 0;
+}
+
+struct data_output *data_output_queue_inner(struct data_output *output)
+{
+    return output;
+}
+
+#endif
@@ -0,0 +1,186 @@
+/** @file
+    Output routing table, the outputs of an event by model as a bitmask.
+
+    The raw options of the filters are compiled into a mask of the outputs for
+    the raw packages and one for the other events. The outputs that pass a model
+    are computed from the models options on the first event of the model and kept
+    in an open addressing hash table with linear probing, a lookup is then a hash
+    of the model and a few word operations instead of a walk over all filters.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_route.h"
+#include "output_filter.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct output_route {
+    unsigned num_outputs;
+    unsigned words;                     ///< words of 64 bits in a mask
+    unsigned num_models;                ///< models in the table
+    output_filter_t **filters;          ///< the filter of each output, or NULL
+    uint64_t *base;                     ///< outputs of the events that are not raw packages
+    uint64_t *base_raw;                 ///< outputs of the raw packages
+    uint64_t *models_mask;              ///< outputs with a models option
+    uint64_t *per_event;                ///< outputs with a filter that needs to see each event
+    uint64_t *out;                      ///< the result of the last lookup
+    uint64_t *scratch;                  ///< the outputs of a model that is not kept in the table
+    uint64_t *pass;                     ///< the outputs that pass the model of each slot
+    uint32_t hash[OUTPUT_ROUTE_MODELS]; ///< hash of the model of each slot
+    char *model[OUTPUT_ROUTE_MODELS];   ///< the model of each slot, NULL for a never used slot
+};
+
+static uint32_t route_hash(char const *model)
+{
+    uint32_t hash = 2166136261u;
+    for (; *model; ++model) {
+        hash = (hash ^ (unsigned char)*model) * 16777619u; // FNV-1a
+    }
+    return hash;
+}
+
+static void mask_set(uint64_t *mask, unsigned index)
+{
+    mask[index / 64] |= 1ull << (index % 64);
+}
+
+output_route_t *output_route_create(unsigned num_outputs, output_filter_t *const *filters)
+{
+    output_route_t *route = calloc(1, sizeof(*route));
+    if (!route) {
+        WARN_CALLOC("output_route_create()");
+        return NULL; // NOTE: the filters are then checked for each output.
+    }
+    route->num_outputs = num_outputs;
+    route->words       = (num_outputs + 63) / 64;
+    unsigned words     = route->words ? route->words : 1;
+    route->filters     = calloc(num_outputs ? num_outputs : 1, sizeof(*route->filters));
+    if (!route->filters) {
+        WARN_CALLOC("output_route_create()");
+        free(route);
+        return NULL; // NOTE: the filters are then checked for each output.
+    }
+    // the masks of the outputs and of each slot of the table in one block
+    uint64_t *masks = calloc((size_t)words * (6 + OUTPUT_ROUTE_MODELS), sizeof(*masks));
+    if (!masks) {
+        WARN_CALLOC("output_route_create()");
+        free(route->filters);
+        free(route);
+        return NULL; // NOTE: the filters are then checked for each output.
+    }
+    route->base        = masks;
+    route->base_raw    = masks + words;
+    route->models_mask = masks + words * 2;
+    route->per_event   = masks + words * 3;
+    route->out         = masks + words * 4;
+    route->scratch     = masks + words * 5;
+    route->pass        = masks + words * 6;
+
+    // raw packages go only to the outputs with the raw option, if there are any
+    int raw_outputs = 0;
+    for (unsigned i = 0; i < num_outputs; ++i) {
+        raw_outputs |= filters[i] && output_filter_raw(filters[i]);
+    }
+    for (unsigned i = 0; i < num_outputs; ++i) {
+        output_filter_t *filter = filters[i];
+        int raw                 = filter ? output_filter_raw(filter) : 0;
+        route->filters[i]       = filter;
+        if (raw != 2)
+            mask_set(route->base, i);
+        if (!raw_outputs || raw)
+            mask_set(route->base_raw, i);
+        if (filter && output_filter_models(filter)[0])
+            mask_set(route->models_mask, i);
+        if (filter && output_filter_per_event(filter))
+            mask_set(route->per_event, i);
+    }
+    return route;
+}
+
+void output_route_free(output_route_t *route)
+{
+    if (!route)
+        return;
+    for (unsigned i = 0; i < OUTPUT_ROUTE_MODELS; ++i) {
+        free(route->model[i]);
+    }
+    free(route->base); // all masks are in one block
+    free(route->filters);
+    free(route);
+}
+
+unsigned output_route_outputs(output_route_t const *route)
+{
+    return route ? route->num_outputs : 0;
+}
+
+/// Compute the outputs that pass a model, all outputs without a models option and those that list it.
+static void route_model_pass(output_route_t const *route, char const *model, uint64_t *pass)
+{
+    for (unsigned w = 0; w < route->words; ++w) {
+        pass[w] = ~route->models_mask[w];
+    }
+    for (unsigned i = 0; i < route->num_outputs; ++i) {
+        output_filter_t *filter = route->filters[i];
+        if (filter && output_filter_models(filter)[0] && output_filter_model_listed(output_filter_models(filter), model))
+            mask_set(pass, i);
+    }
+}
+
+/// Find the outputs that pass a model, the model is added to the table if it is not full.
+static uint64_t const *route_model_lookup(output_route_t *route, char const *model)
+{
+    uint32_t hash = route_hash(model);
+    unsigned slot = hash & (OUTPUT_ROUTE_MODELS - 1);
+    while (route->model[slot]) {
+        if (route->hash[slot] == hash && !strcmp(route->model[slot], model))
+            return &route->pass[(size_t)slot * route->words];
+        slot = (slot + 1) & (OUTPUT_ROUTE_MODELS - 1);
+    }
+
+    // keep the table at most three quarters full, the probes stay short
+    char *copy = route->num_models < OUTPUT_ROUTE_MODELS * 3 / 4 ? strdup(model) : NULL;
+    if (!copy && route->num_models < OUTPUT_ROUTE_MODELS * 3 / 4)
+        WARN_STRDUP("output_route_lookup()"); // NOTE: the model is then not kept.
+    uint64_t *pass = copy ? &route->pass[(size_t)slot * route->words] : route->scratch;
+    route_model_pass(route, model, pass);
+    if (copy) {
+        route->hash[slot]  = hash;
+        route->model[slot] = copy;
+        route->num_models++;
+    }
+    return pass;
+}
+
+uint64_t const *output_route_lookup(output_route_t *route, char const *model, int raw_event)
+{
+    uint64_t const *base = raw_event ? route->base_raw : route->base;
+    if (!model) {
+        memcpy(route->out, base, route->words * sizeof(*route->out));
+        return route->out;
+    }
+
+    uint64_t const *pass = route_model_lookup(route, model);
+    for (unsigned w = 0; w < route->words; ++w) {
+        route->out[w] = base[w] & pass[w];
+        // the outputs that drop the model count the drop
+        uint64_t drops = base[w] & route->models_mask[w] & ~pass[w];
+        for (unsigned bit = 0; drops; ++bit, drops >>= 1) {
+            if (drops & 1)
+                output_filter_drop(route->filters[w * 64 + bit]);
+        }
+    }
+    return route->out;
+}
+
+int output_route_per_event(output_route_t const *route, unsigned index)
+{
+    return index < route->num_outputs && (route->per_event[index / 64] >> (index % 64) & 1);
+}
@@ -13,15 +13,21 @@
 
 #include "rtl_433.h"
 #include "r_api.h"
+#include "r_private.h"
+#include "channelizer.h"
+#include "iq_pool.h"
 #include "r_util.h"
 #include "fatal.h"
 #include "compat_pthread.h"
+#include "thread_pin.h"
+#include "list.h"
 
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <errno.h>
 
 #include <limits.h>
 // gethostname() needs _XOPEN_SOURCE 500 on unistd.h
@@ -45,6 +51,7 @@
     #include <sys/types.h>
     #include <sys/socket.h>
     #include <sys/select.h>
+    #include <fcntl.h>
     #include <netdb.h>
     #include <netinet/in.h>
 
@@ -85,46 +92,125 @@ typedef SSIZE_T ssize_t;
 /* rtl_tcp server */
 
 // Only available if Threads are enabled.
-// Currently serves a maximum of 1 client connection.
-// The data backing from the SDR is assumed to be persistent, which is the case
-// since we never restart the SDR with different parameters or close it while active.
+// Serves any number of clients from one server thread, each client has a ring
+// of frames waiting to be sent. A client that falls behind loses whole frames
+// instead of stalling the SDR or the other clients.
+// With decimation, a sub-channel, or another sample format the frames are queued
+// as read and processed once on the server thread for all clients, a frame in
+// a pooled acquisition buffer is retained instead of copied.
 // Should use shared memory for sendfile() someday.
 
 #ifdef THREADS
 
+#define DEFAULT_CLIENT_BUFFER (4 * 1024 * 1024)
+
+typedef struct rtltcp_client {
+    SOCKET sock;
+    char host[INET6_ADDRSTRLEN];
+    char port[NI_MAXSERV];
+    uint8_t *buf;      ///< ring of data waiting to be sent
+    size_t size;       ///< ring size in bytes
+    size_t head;       ///< write position, changed by the feeding thread
+    size_t tail;       ///< send position, changed by the server thread
+    unsigned frames;   ///< frames queued
+    unsigned drops;    ///< frames dropped because the ring was full
+    uint8_t cmd[128];  ///< partial command bytes
+    int cmd_len;
+} rtltcp_client_t;
+
+/// The head of a frame queued for processing, followed by the samples unless the pooled buffer is retained.
+typedef struct frame_head {
+    uint32_t len;
+    uint32_t sample_size;
+    uint32_t center_frequency;
+    uint32_t samp_rate;
+    iq_buf_t *ref;       ///< the retained buffer holding the samples, NULL if they follow
+    uint8_t const *data; ///< the samples in the retained buffer
+} frame_head_t;
+
 typedef struct rtltcp_server {
     struct sockaddr_storage addr;
     socklen_t addr_len;
     SOCKET sock;
-    int client_count; ///< number of connected clients
-
-    uint8_t const *data_buf; ///< data buffer with most recent data, NULL otherwise
-    uint32_t data_len;       ///< data buffer length in bytes, 0 otherwise
-    unsigned data_cnt;       ///< data buffer update counter
+    size_t client_buffer; ///< ring size for each client
+    list_t clients;       ///< the connected clients, changed by the server thread
+    rtltcp_output_opts_t opts;
+    int process;          ///< the frames are processed on the server thread
+    uint8_t *in_buf;      ///< ring of frames waiting to be processed
+    size_t in_size;       ///< ring size in bytes
+    size_t in_head;       ///< write position, changed by the feeding thread
+    size_t in_tail;       ///< read position, changed by the server thread
+    size_t in_ref_bytes;  ///< bytes of the queued frames in retained buffers, counted against the ring size
+    unsigned in_drops;    ///< frames dropped because the server thread fell behind
+    channelizer_t *chz;   ///< the decimation and sub-channel filter, NULL to keep the input rate
+    channel_t *ch;
+    uint8_t *work_buf;    ///< the frame being processed
+    size_t work_size;
+    uint8_t *out_buf;     ///< the requantized samples
+    size_t out_size;
+    int exit;
+#ifndef _WIN32
+    int wake[2];          ///< pipe to wake the server thread on new data
+#endif
 
     pthread_t thread;
-    pthread_mutex_t lock; ///< lock for data buffer
-    pthread_cond_t cond;  ///< wait for data buffer
+    pthread_mutex_t lock; ///< lock for the client list and ring positions
     r_cfg_t *cfg;
     struct raw_output *output;
 } rtltcp_server_t;
 
-static ssize_t send_all(int sockfd, void const *buf, size_t len, int flags)
+static int set_nonblocking(SOCKET sock)
 {
-    size_t sent = 0;
-    while (sent < len) {
-        ssize_t ret = send(sockfd, (uint8_t *)buf + sent, len - sent, flags);
-        if (ret < 0)
-            return ret;
-        sent += (size_t)ret;
-    }
-    return sent;
+#ifdef _WIN32
+    u_long mode = 1;
+    return ioctlsocket(sock, FIONBIO, &mode);
+#else
+    int flags = fcntl(sock, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+static int would_block(void)
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+/// Copy to a ring at a position, the caller checked there is room.
+static void ring_copy_in(uint8_t *buf, size_t size, size_t pos, void const *data, size_t len)
+{
+    size_t off  = pos % size;
+    size_t part = size - off < len ? size - off : len;
+    memcpy(buf + off, data, part);
+    memcpy(buf, (uint8_t const *)data + part, len - part);
+}
+
+/// Copy from a ring at a position.
+static void ring_copy_out(uint8_t const *buf, size_t size, size_t pos, void *data, size_t len)
+{
+    size_t off  = pos % size;
+    size_t part = size - off < len ? size - off : len;
+    memcpy(data, buf + off, part);
+    memcpy((uint8_t *)data + part, buf, len - part);
 }
 
-static void send_header(SOCKET sock)
+/// Append to a client ring, the caller checked there is room.
+static void client_copy_in(rtltcp_client_t *client, void const *data, size_t len)
 {
-    uint8_t msg[] = {'R', 'T', 'L', '0', 0, 0, 0, 0, 0, 0, 0, 0};
-    send_all(sock, msg, sizeof(msg), MSG_NOSIGNAL); // ignore SIGPIPE
+    ring_copy_in(client->buf, client->size, client->head, data, len);
+    client->head += len;
+}
+
+static void client_free(void *arg)
+{
+    rtltcp_client_t *client = arg;
+
+    closesocket(client->sock);
+    free(client->buf);
+    free(client);
 }
 
 #define RTLTCP_SET_FREQ 0x01
@@ -221,138 +307,353 @@ static int parse_command(r_cfg_t *cfg, uint8_t const *buf, int len)
     return 5;
 }
 
-// event handler to broadcast to all our sockets
-static void rtltcp_broadcast_send(rtltcp_server_t *srv, uint8_t const *data, uint32_t len)
+/// Queue a frame to all clients, returns true if there are clients.
+static int queue_clients(rtltcp_server_t *srv, uint8_t const *data, size_t len)
 {
-    // fprintf(stderr, "%s: %d byte frame\n", __func__, len);
     pthread_mutex_lock(&srv->lock);
+    for (void **iter = srv->clients.elems; iter && *iter; ++iter) {
+        rtltcp_client_t *client = *iter;
+        if (client->size - (client->head - client->tail) < len) {
+            client->drops++; // drop whole frames to keep the samples aligned
+            continue;
+        }
+        client_copy_in(client, data, len);
+        client->frames++;
+    }
+    int wake = srv->clients.len > 0;
+    pthread_mutex_unlock(&srv->lock);
+    return wake;
+}
 
-    // update the data buffer reference
-    srv->data_buf = data;
-    srv->data_len = len;
-    srv->data_cnt += 1;
+static void wake_server(rtltcp_server_t *srv, int wake)
+{
+#ifndef _WIN32
+    if (wake) {
+        char c = 0;
+        if (write(srv->wake[1], &c, 1) < 0) {
+            // the pipe is full, the server thread is woken anyway
+        }
+    }
+#else
+    (void)srv;
+    (void)wake; // the server thread polls
+#endif
+}
 
+// queue a frame to all clients, never blocks on a client
+static void rtltcp_broadcast_send(rtltcp_server_t *srv, uint8_t const *data, uint32_t len)
+{
+    wake_server(srv, queue_clients(srv, data, len));
+}
+
+// queue a frame for the server thread to process, retains the pooled buffer if possible, never blocks
+static void rtltcp_input_send(rtltcp_server_t *srv, iq_buf_t *ref, uint8_t const *data, uint32_t len, frame_head_t head)
+{
+    head.len = len;
+    pthread_mutex_lock(&srv->lock);
+    int wake = srv->clients.len > 0;
+    if (wake && srv->in_size - (srv->in_head - srv->in_tail) - srv->in_ref_bytes < sizeof(head) + len) {
+        srv->in_drops++; // drop whole frames to keep the samples aligned
+        wake = 0;
+    }
+    else if (wake) {
+        head.ref  = iq_buf_retain(ref) == 0 ? ref : NULL; // otherwise the samples are copied
+        head.data = head.ref ? data : NULL;
+        ring_copy_in(srv->in_buf, srv->in_size, srv->in_head, &head, sizeof(head));
+        if (!head.ref)
+            ring_copy_in(srv->in_buf, srv->in_size, srv->in_head + sizeof(head), data, len);
+        srv->in_head += sizeof(head) + (head.ref ? 0 : len);
+        srv->in_ref_bytes += head.ref ? len : 0;
+    }
     pthread_mutex_unlock(&srv->lock);
-    pthread_cond_signal(&srv->cond);
-    // perhaps broadcast if we want to support multiple clients
-    //int pthread_cond_broadcast(&srv->cond);
+
+    wake_server(srv, wake);
 }
 
-static THREAD_RETURN THREAD_CALL accept_thread(void *arg)
+/// Grow a buffer to at least the size, returns -1 on alloc failure.
+static int grow_buf(uint8_t **buf, size_t *size, size_t len)
 {
-    rtltcp_server_t *srv = arg;
+    if (*size >= len)
+        return 0;
+    uint8_t *new_buf = realloc(*buf, len);
+    if (!new_buf) {
+        WARN_REALLOC("grow_buf()");
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    *buf  = new_buf;
+    *size = len;
+    return 0;
+}
 
-    // Start listening for clients, waits for an incoming connection
-    listen(srv->sock, 1);
-    //fprintf(stderr, "rtl_tcp listening...\n");
+/// Decimate or select the sub-channel, requantize, and queue the samples of a frame to all clients.
+static void process_frame(rtltcp_server_t *srv, frame_head_t const *head, uint8_t const *data)
+{
+    int in_size = (int)head->sample_size;
+    if (in_size != 2 && in_size != 4)
+        return; // only CU8 and CS16 are served processed
+
+    uint8_t const *buf = data;
+    size_t n_samples   = head->len / in_size;
+    if (srv->chz) {
+        if (!srv->opts.frequency)
+            srv->ch->frequency = head->center_frequency; // the channel follows the tuned frequency
+        channelizer_process(srv->chz, data, n_samples, in_size, head->center_frequency, head->samp_rate);
+        buf       = (uint8_t const *)srv->ch->out_buf;
+        n_samples = srv->ch->out_len;
+        in_size   = 4; // CS16
+    }
+    if (!n_samples)
+        return;
 
-    for (;;) {
-        // Accept actual connection from the client
-        struct sockaddr_storage addr = {0};
-        unsigned addr_len = sizeof(addr);
-        int sock = accept(srv->sock, (struct sockaddr *)&addr, &addr_len);
+    int out_size = srv->opts.sample_size ? srv->opts.sample_size : (int)head->sample_size;
+    if (out_size != in_size) {
+        if (grow_buf(&srv->out_buf, &srv->out_size, n_samples * out_size) < 0)
+            return;
+        if (out_size == 2) {
+            int16_t const *cs16 = (int16_t const *)buf;
+            for (size_t i = 0; i < n_samples * 2; ++i)
+                srv->out_buf[i] = (uint8_t)((cs16[i] + 32768) >> 8);
+        }
+        else {
+            int16_t *cs16 = (int16_t *)srv->out_buf;
+            for (size_t i = 0; i < n_samples * 2; ++i)
+                cs16[i] = (int16_t)((buf[i] - 128) * 256);
+        }
+        buf = srv->out_buf;
+    }
+    queue_clients(srv, buf, n_samples * out_size);
+}
 
-        if (sock < 0) {
-            perror("ERROR on accept");
-            continue;
+/// Process the queued frames, on the server thread.
+static void process_input(rtltcp_server_t *srv)
+{
+    pthread_mutex_lock(&srv->lock);
+    size_t head = srv->in_head;
+    pthread_mutex_unlock(&srv->lock);
+
+    // the feeding thread only writes to the free part of the ring
+    while (srv->in_tail != head) {
+        frame_head_t frame;
+        ring_copy_out(srv->in_buf, srv->in_size, srv->in_tail, &frame, sizeof(frame));
+        int ok = frame.ref || grow_buf(&srv->work_buf, &srv->work_size, frame.len) == 0;
+        if (ok && !frame.ref)
+            ring_copy_out(srv->in_buf, srv->in_size, srv->in_tail + sizeof(frame), srv->work_buf, frame.len);
+
+        pthread_mutex_lock(&srv->lock);
+        srv->in_tail += sizeof(frame) + (frame.ref ? 0 : frame.len);
+        pthread_mutex_unlock(&srv->lock);
+        if (ok)
+            process_frame(srv, &frame, frame.ref ? frame.data : srv->work_buf);
+        if (frame.ref) {
+            iq_buf_release(frame.ref);
+            pthread_mutex_lock(&srv->lock);
+            srv->in_ref_bytes -= frame.len;
+            pthread_mutex_unlock(&srv->lock);
         }
+    }
+}
+
+/// Release the buffers of the frames left unprocessed, after the server thread ended.
+static void release_input(rtltcp_server_t *srv)
+{
+    while (srv->in_buf && srv->in_tail != srv->in_head) {
+        frame_head_t frame;
+        ring_copy_out(srv->in_buf, srv->in_size, srv->in_tail, &frame, sizeof(frame));
+        iq_buf_release(frame.ref);
+        srv->in_tail += sizeof(frame) + (frame.ref ? 0 : frame.len);
+    }
+}
+
+static void accept_client(rtltcp_server_t *srv)
+{
+    struct sockaddr_storage addr = {0};
+    socklen_t addr_len = sizeof(addr);
+    SOCKET sock = accept(srv->sock, (struct sockaddr *)&addr, &addr_len);
+    if (sock == INVALID_SOCKET) {
+        if (!would_block())
+            perror("ERROR on accept");
+        return;
+    }
 
-        // Prevent SIGPIPE per file descriptor, supported on MacOS and most BSDs
+    // Prevent SIGPIPE per file descriptor, supported on MacOS and most BSDs
 #ifdef SO_NOSIGPIPE
-        int opt = 1;
-        if (setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt)) == -1) {
-            perror("setsockopt");
-            continue;
-        }
+    int opt = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &opt, sizeof(opt)) == -1) {
+        perror("setsockopt");
+        closesocket(sock);
+        return;
+    }
 #endif
+#ifndef _WIN32
+    if (sock >= FD_SETSIZE) {
+        fprintf(stderr, "rtl_tcp too many clients\n");
+        closesocket(sock);
+        return;
+    }
+#endif
+    if (set_nonblocking(sock) < 0) {
+        perror("set_nonblocking");
+        closesocket(sock);
+        return;
+    }
 
-        char host[INET6_ADDRSTRLEN] = {0};
-        char port[NI_MAXSERV]       = {0};
+    rtltcp_client_t *client = calloc(1, sizeof(*client));
+    if (!client) {
+        WARN_CALLOC("accept_client()");
+        closesocket(sock);
+        return;
+    }
+    client->sock = sock;
+    client->size = srv->client_buffer;
+    client->buf  = malloc(client->size);
+    if (!client->buf) {
+        WARN_MALLOC("accept_client()");
+        client_free(client);
+        return;
+    }
 
-        int err = getnameinfo((struct sockaddr *)&addr, addr_len,
-                host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV);
-        if (err != 0) {
-            fprintf(stderr, "failed to convert address to string (code=%d)\n", err);
-            continue;
-        }
-        fprintf(stderr, "rtl_tcp client connected from %s port %s\n", host, port);
+    int err = getnameinfo((struct sockaddr *)&addr, addr_len,
+            client->host, sizeof(client->host), client->port, sizeof(client->port), NI_NUMERICHOST | NI_NUMERICSERV);
+    if (err != 0) {
+        fprintf(stderr, "failed to convert address to string (code=%d)\n", err);
+        client_free(client);
+        return;
+    }
+    fprintf(stderr, "rtl_tcp client connected from %s port %s\n", client->host, client->port);
 
-        pthread_mutex_lock(&srv->lock);
-        srv->client_count += 1;
-        unsigned prev_cnt = srv->data_cnt + 9; // data sent in previous loop, random value to get the current buffer
-        pthread_mutex_unlock(&srv->lock);
+    uint8_t header[] = {'R', 'T', 'L', '0', 0, 0, 0, 0, 0, 0, 0, 0};
+    client_copy_in(client, header, sizeof(header));
 
-        send_header(sock);
-
-        // Client loop
-        for (;;) {
-            // Read available commands
-            int abort = 0;
-            for (;;) {
-                fd_set fds;
-                FD_ZERO(&fds);
-                FD_SET(sock, &fds);
-                struct timeval timeout = {0};
-
-                int ready = select(sock + 1, &fds, NULL, NULL, &timeout);
-                if (ready <= 0)
-                    break;
-
-                uint8_t buf[128] = {0};
-                ssize_t len = recv(sock, buf, sizeof(buf), 0);
-                //fprintf(stderr, "rtl_tcp recv %zd bytes (%d)\n", len, ready);
-                if (len <= 0) {
-                    abort = 1;
-                    break;
-                }
-                int pos = 0;
-                while (pos + 5 <= len) {
-                    pos += parse_command(srv->cfg, &buf[pos], (int)len - pos);
-                }
-            }
-            if (abort) {
-                break;
-            }
+    pthread_mutex_lock(&srv->lock);
+    list_push(&srv->clients, client);
+    pthread_mutex_unlock(&srv->lock);
+}
 
-            // Send frames
-            fd_set fds;
-            FD_ZERO(&fds);
-            FD_SET(sock, &fds);
-            struct timeval timeout = {0};
+/// Read available commands, returns -1 if the client disconnected.
+static int client_recv(rtltcp_server_t *srv, rtltcp_client_t *client)
+{
+    ssize_t len = recv(client->sock, (char *)client->cmd + client->cmd_len, sizeof(client->cmd) - client->cmd_len, 0);
+    if (len < 0 && would_block())
+        return 0;
+    if (len <= 0)
+        return -1;
+    client->cmd_len += (int)len;
 
-            int ready = select(sock + 1, NULL, &fds, NULL, &timeout);
-            if (ready <= 0) {
-                fprintf(stderr, "rtl_tcp send not ready for write?\n");
-                break;
-            }
+    int pos = 0;
+    while (pos + 5 <= client->cmd_len) {
+        pos += parse_command(srv->cfg, &client->cmd[pos], client->cmd_len - pos);
+    }
+    client->cmd_len -= pos;
+    memmove(client->cmd, &client->cmd[pos], client->cmd_len);
+    return 0;
+}
 
-            pthread_mutex_lock(&srv->lock);
-            while (srv->data_cnt == prev_cnt || srv->data_buf == NULL)
-                pthread_cond_wait(&srv->cond, &srv->lock);
-            // Maybe timeout to check recv()
-            // pthread_cond_timedwait(&srv->cond, &srv->lock, const struct timespec *abstime);
+/// Send queued data as far as the socket takes it, returns -1 on error.
+static int client_send(rtltcp_server_t *srv, rtltcp_client_t *client)
+{
+    pthread_mutex_lock(&srv->lock);
+    size_t head = client->head;
+    pthread_mutex_unlock(&srv->lock);
 
-            // Get data buffer reference
-            void const *data = srv->data_buf;
-            int data_len     = srv->data_len;
-            prev_cnt         = srv->data_cnt;
+    // the feeding thread only writes to the free part of the ring
+    while (client->tail != head) {
+        size_t off  = client->tail % client->size;
+        size_t part = client->size - off < head - client->tail ? client->size - off : head - client->tail;
+        ssize_t ret = send(client->sock, (char const *)client->buf + off, part, MSG_NOSIGNAL); // ignore SIGPIPE
+        if (ret < 0)
+            return would_block() ? 0 : -1;
 
-            pthread_mutex_unlock(&srv->lock);
+        pthread_mutex_lock(&srv->lock);
+        client->tail += (size_t)ret;
+        pthread_mutex_unlock(&srv->lock);
+        if ((size_t)ret < part)
+            break; // the socket buffer is full
+    }
+    return 0;
+}
 
-            send_all(sock, data, data_len, MSG_NOSIGNAL); // ignore SIGPIPE
-        }
+static THREAD_RETURN THREAD_CALL server_thread(void *arg)
+{
+    rtltcp_server_t *srv = arg;
+    thread_pin_self(THREAD_NET);
+
+    // Start listening for clients
+    listen(srv->sock, 8);
+
+    for (;;) {
+        fd_set rfds, wfds;
+        FD_ZERO(&rfds);
+        FD_ZERO(&wfds);
+        FD_SET(srv->sock, &rfds);
+        SOCKET max_fd = srv->sock;
+#ifndef _WIN32
+        FD_SET(srv->wake[0], &rfds);
+        if (srv->wake[0] > max_fd)
+            max_fd = srv->wake[0];
+        struct timeval timeout = {1, 0};
+#else
+        struct timeval timeout = {0, 10000}; // no wake pipe, poll for new data
+#endif
 
         pthread_mutex_lock(&srv->lock);
-        srv->client_count -= 1;
+        int exit_loop = srv->exit;
+        for (void **iter = srv->clients.elems; iter && *iter; ++iter) {
+            rtltcp_client_t *client = *iter;
+            FD_SET(client->sock, &rfds);
+            if (client->head != client->tail)
+                FD_SET(client->sock, &wfds);
+            if (client->sock > max_fd)
+                max_fd = client->sock;
+        }
         pthread_mutex_unlock(&srv->lock);
+        if (exit_loop)
+            break;
 
-        fprintf(stderr, "rtl_tcp client disconnected from %s port %s\n", host, port);
-        closesocket(sock);
+        int ready = select((int)max_fd + 1, &rfds, &wfds, NULL, &timeout);
+        if (ready < 0 && !would_block()) {
+            perror("select");
+            break;
+        }
+        if (ready <= 0)
+            continue;
+
+#ifndef _WIN32
+        if (FD_ISSET(srv->wake[0], &rfds)) {
+            char buf[64];
+            while (read(srv->wake[0], buf, sizeof(buf)) > 0) {
+                // drain the wake pipe
+            }
+        }
+#endif
+        if (FD_ISSET(srv->sock, &rfds))
+            accept_client(srv);
+        if (srv->process)
+            process_input(srv); // the new data is sent on the next round
+
+        // only this thread removes clients, new clients are at the end
+        for (size_t i = 0; i < srv->clients.len;) {
+            rtltcp_client_t *client = srv->clients.elems[i];
+            int err = 0;
+            if (FD_ISSET(client->sock, &rfds))
+                err = client_recv(srv, client);
+            if (!err && FD_ISSET(client->sock, &wfds))
+                err = client_send(srv, client);
+            if (!err) {
+                i++;
+                continue;
+            }
+
+            pthread_mutex_lock(&srv->lock);
+            fprintf(stderr, "rtl_tcp client disconnected from %s port %s, %u frames queued, %u dropped\n",
+                    client->host, client->port, client->frames, client->drops);
+            list_remove(&srv->clients, i, client_free);
+            pthread_mutex_unlock(&srv->lock);
+        }
     }
     return 0;
 }
 
-static int rtltcp_server_start(rtltcp_server_t *srv, char const *host, char const *port, r_cfg_t *cfg, struct raw_output *output)
+static int rtltcp_server_start(rtltcp_server_t *srv, char const *host, char const *port, r_cfg_t *cfg, struct raw_output *output, rtltcp_output_opts_t const *opts)
 {
     if (!host || !port)
         return -1;
@@ -391,9 +692,33 @@ static int rtltcp_server_start(rtltcp_server_t *srv, char const *host, char cons
         perror("error on binding");
         return -1;
     }
+    if (set_nonblocking(sock) < 0) {
+        perror("set_nonblocking");
+        return -1;
+    }
 
-    srv->cfg     = cfg;
-    srv->output  = output;
+    srv->cfg           = cfg;
+    srv->output        = output;
+    srv->opts          = *opts;
+    srv->client_buffer = opts->client_buffer ? opts->client_buffer : DEFAULT_CLIENT_BUFFER;
+
+    if (opts->sample_rate || opts->frequency || opts->sample_size) {
+        srv->process = 1;
+        srv->in_size = srv->client_buffer;
+        srv->in_buf  = malloc(srv->in_size);
+        if (!srv->in_buf) {
+            WARN_MALLOC("rtltcp_server_start()");
+            return -1; // NOTE: returns error on alloc failure.
+        }
+    }
+    if (opts->sample_rate) {
+        srv->chz = channelizer_create();
+        if (!srv->chz)
+            return -1; // NOTE: returns error on alloc failure.
+        srv->ch = channelizer_add(srv->chz, opts->frequency, opts->sample_rate);
+        if (!srv->ch)
+            return -1;
+    }
 
     char address[INET6_ADDRSTRLEN] = {0};
     char portstr[NI_MAXSERV] = {0};
@@ -406,8 +731,15 @@ static int rtltcp_server_start(rtltcp_server_t *srv, char const *host, char cons
     }
     fprintf(stderr, "Starting rtl_tcp server on address %s %s\n", address, portstr);
 
+#ifndef _WIN32
+    if (pipe(srv->wake) < 0) {
+        perror("pipe");
+        return -1;
+    }
+    set_nonblocking(srv->wake[0]);
+    set_nonblocking(srv->wake[1]);
+#endif
     pthread_mutex_init(&srv->lock, NULL);
-    pthread_cond_init(&srv->cond, NULL);
 
 #ifndef _WIN32
     // Block all signals from the worker thread
@@ -416,7 +748,7 @@ static int rtltcp_server_start(rtltcp_server_t *srv, char const *host, char cons
     sigfillset(&sigset);
     pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
 #endif
-    int r = pthread_create(&srv->thread, NULL, accept_thread, srv);
+    int r = pthread_create(&srv->thread, NULL, server_thread, srv);
 #ifndef _WIN32
     pthread_sigmask(SIG_SETMASK, &oldset, NULL);
 #endif
@@ -433,15 +765,38 @@ static int rtltcp_server_stop(rtltcp_server_t *srv)
         return 0;
 
     fprintf(stderr, "Stopping rtl_tcp server...\n");
-    // thread is likely blocking in accept, recv, or send
-    int r = pthread_cancel(srv->thread);
+    pthread_mutex_lock(&srv->lock);
+    srv->exit = 1;
+    pthread_mutex_unlock(&srv->lock);
+#ifndef _WIN32
+    char c = 0;
+    if (write(srv->wake[1], &c, 1) < 0) {
+        perror("write");
+    }
+#endif
+    int r = pthread_join(srv->thread, NULL);
     if (r) {
-        fprintf(stderr, "%s: error in pthread_cancel, rc: %d\n", __func__, r);
+        fprintf(stderr, "%s: error in pthread_join, rc: %d\n", __func__, r);
     }
     pthread_mutex_destroy(&srv->lock);
-    pthread_cond_destroy(&srv->cond);
 
-    srv->client_count = 0;
+    for (void **iter = srv->clients.elems; iter && *iter; ++iter) {
+        rtltcp_client_t *client = *iter;
+        fprintf(stderr, "rtl_tcp client at %s port %s, %u frames queued, %u dropped\n",
+                client->host, client->port, client->frames, client->drops);
+    }
+    list_free_elems(&srv->clients, client_free);
+    if (srv->in_drops)
+        fprintf(stderr, "rtl_tcp server dropped %u frames before processing\n", srv->in_drops);
+    release_input(srv);
+    channelizer_free(srv->chz);
+    free(srv->in_buf);
+    free(srv->work_buf);
+    free(srv->out_buf);
+#ifndef _WIN32
+    close(srv->wake[0]);
+    close(srv->wake[1]);
+#endif
 
     // close server socket
     int ret = 0;
@@ -464,11 +819,27 @@ typedef struct raw_output_rtltcp {
     rtltcp_server_t server;
 } raw_output_rtltcp_t;
 
-static void raw_output_rtltcp_frame(raw_output_t *output, uint8_t const *data, uint32_t len)
+static void raw_output_rtltcp_frame_ref(raw_output_t *output, iq_buf_t *ref, uint8_t const *data, uint32_t len)
 {
     raw_output_rtltcp_t *rtltcp = (raw_output_rtltcp_t *)output;
+    rtltcp_server_t *srv        = &rtltcp->server;
 
-    rtltcp_broadcast_send(&rtltcp->server, data, len);
+    if (!srv->process) {
+        rtltcp_broadcast_send(srv, data, len);
+        return;
+    }
+    // the current input, on the thread feeding the frames
+    frame_head_t head = {
+            .sample_size      = (uint32_t)srv->cfg->demod->sample_size,
+            .center_frequency = srv->cfg->center_frequency,
+            .samp_rate        = srv->cfg->samp_rate,
+    };
+    rtltcp_input_send(srv, ref, data, len, head);
+}
+
+static void raw_output_rtltcp_frame(raw_output_t *output, uint8_t const *data, uint32_t len)
+{
+    raw_output_rtltcp_frame_ref(output, NULL, data, len);
 }
 
 static void raw_output_rtltcp_free(raw_output_t *output)
@@ -483,7 +854,7 @@ static void raw_output_rtltcp_free(raw_output_t *output)
     free(rtltcp);
 }
 
-struct raw_output *raw_output_rtltcp_create(const char *host, const char *port, r_cfg_t *cfg)
+struct raw_output *raw_output_rtltcp_create(const char *host, const char *port, r_cfg_t *cfg, rtltcp_output_opts_t const *opts)
 {
     raw_output_rtltcp_t *rtltcp = calloc(1, sizeof(raw_output_rtltcp_t));
     if (!rtltcp) {
@@ -500,10 +871,11 @@ struct raw_output *raw_output_rtltcp_create(const char *host, const char *port,
     }
 #endif
 
-    rtltcp->output.output_frame  = raw_output_rtltcp_frame;
-    rtltcp->output.output_free   = raw_output_rtltcp_free;
+    rtltcp->output.output_frame     = raw_output_rtltcp_frame;
+    rtltcp->output.output_frame_ref = raw_output_rtltcp_frame_ref;
+    rtltcp->output.output_free      = raw_output_rtltcp_free;
 
-    int ret = rtltcp_server_start(&rtltcp->server, host, port, cfg, &rtltcp->output);
+    int ret = rtltcp_server_start(&rtltcp->server, host, port, cfg, &rtltcp->output, opts);
     if (ret != 0) {
         exit(1);
     }
@@ -513,11 +885,12 @@ struct raw_output *raw_output_rtltcp_create(const char *host, const char *port,
 
 #else
 
-struct raw_output *raw_output_rtltcp_create(const char *host, const char *port, r_cfg_t *cfg)
+struct raw_output *raw_output_rtltcp_create(const char *host, const char *port, r_cfg_t *cfg, rtltcp_output_opts_t const *opts)
 {
     UNUSED(host);
     UNUSED(port);
     UNUSED(cfg);
+    UNUSED(opts);
     fprintf(stderr, "\nWARNING: rtl_tcp not available in this build!\n\n");
     return NULL;
 }
@@ -0,0 +1,111 @@
+/** @file
+    Shared memory ring output for rtl_433 events.
+
+    Each event is serialized once and appended to the ring, local readers
+    follow the ring without a syscall per event.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_shm.h"
+#include "output_cbor.h"
+#include "shm_ring.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/// Largest serialized event, larger events are dropped.
+#define SHM_EVENT_MAX (1024 * 1024)
+
+typedef struct {
+    struct data_output output;
+    shm_ring_t *ring;
+    unsigned format;
+    char *buf; ///< serialization buffer, grows to the largest event
+    size_t size;
+    unsigned drops;
+} data_output_shm_t;
+
+/// Serialize the event, returns the length or the buffer size if it does not fit.
+static size_t shm_serialize(data_output_shm_t *shm, data_t *data)
+{
+    if (shm->format == SHM_RING_CBOR)
+        return data_print_cbor(data, (uint8_t *)shm->buf, shm->size);
+    size_t len = data_print_jsons(data, shm->buf, shm->size);
+    return len + 1 < shm->size ? len : shm->size; // the JSON needs room for the terminator
+}
+
+static void R_API_CALLCONV print_shm_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    data_output_shm_t *shm = (data_output_shm_t *)output;
+
+    size_t len = shm_serialize(shm, data);
+    while (len >= shm->size && shm->size < SHM_EVENT_MAX) {
+        char *buf = realloc(shm->buf, shm->size * 2);
+        if (!buf) {
+            WARN_REALLOC("print_shm_data()");
+            break;
+        }
+        shm->buf  = buf;
+        shm->size = shm->size * 2;
+        len       = shm_serialize(shm, data);
+    }
+    if (len >= shm->size || shm_ring_write(shm->ring, shm->buf, len) < 0)
+        shm->drops++;
+}
+
+static unsigned R_API_CALLCONV data_output_shm_drops(data_output_t *output)
+{
+    data_output_shm_t *shm = (data_output_shm_t *)output;
+
+    return shm->drops;
+}
+
+static void R_API_CALLCONV data_output_shm_free(data_output_t *output)
+{
+    data_output_shm_t *shm = (data_output_shm_t *)output;
+
+    if (!shm)
+        return;
+
+    if (shm->drops)
+        fprintf(stderr, "Shared memory output dropped %u events too large for the ring\n", shm->drops);
+    shm_ring_free(shm->ring);
+    free(shm->buf);
+    free(shm);
+}
+
+struct data_output *data_output_shm_create(char const *name, size_t size, unsigned format)
+{
+    data_output_shm_t *shm = calloc(1, sizeof(data_output_shm_t));
+    if (!shm) {
+        WARN_CALLOC("data_output_shm_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    shm->size = 2048;
+    shm->buf  = malloc(shm->size);
+    if (!shm->buf) {
+        WARN_MALLOC("data_output_shm_create()");
+        free(shm);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    shm->ring = shm_ring_create(name, size, format);
+    if (!shm->ring) {
+        free(shm->buf);
+        free(shm);
+        return NULL;
+    }
+
+    shm->output.print_data   = print_shm_data;
+    shm->output.output_drops = data_output_shm_drops;
+    shm->output.output_free  = data_output_shm_free;
+    shm->format              = format;
+
+    return &shm->output;
+}
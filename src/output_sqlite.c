@@ -0,0 +1,486 @@
+/** @file
+    SQLite output for rtl_433 events, a table per model.
+
+    The events are grouped by model, each model has its own table with a column
+    per key, tables and columns are added as the events come in. The inserts use
+    a prepared statement per table, with the values bound by type, and are batched
+    into transactions, a commit per event would be a disk sync per event.
+    The database is in WAL mode, readers do not block the inserts.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "output_sqlite.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef SQLITE3
+
+#include "list.h"
+
+#include <time.h>
+#include <sqlite3.h>
+
+/// Wait this long for a lock held by a reader or another writer, in ms.
+#define OUTPUT_SQLITE_BUSY_MS 2000
+
+/// A growing SQL text.
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t size;
+    int failed; ///< an append failed, the text is incomplete
+} sql_text_t;
+
+typedef struct {
+    char *key;
+    int order; ///< the index in the declared fields, sorts the columns of a new table
+} sqlite_column_t;
+
+/// The table of a model.
+typedef struct {
+    char *model;
+    char *name;           ///< the quoted table name
+    sqlite3_stmt *insert; ///< NULL until prepared, and again after a column is added
+    int created;
+    int failed;           ///< the table could not be created, the events are dropped
+    sqlite_column_t *columns;
+    unsigned num_columns;
+} sqlite_table_t;
+
+typedef struct {
+    struct data_output output;
+    sqlite3 *db;
+    unsigned batch_rows;
+    unsigned batch_secs;
+    char const **fields; ///< the declared fields, NULL to keep all
+    int num_fields;
+    list_t tables;
+    int in_transaction;
+    unsigned rows;       ///< events in the open transaction
+    time_t begin_time;   ///< the time the open transaction began
+    unsigned errors;     ///< events that failed to insert
+    data_buf_t json;     ///< the JSON text of nested values
+    sql_text_t sql;
+} data_output_sqlite_t;
+
+static void sql_append(sql_text_t *sql, char const *str, size_t len)
+{
+    if (sql->len + len + 1 > sql->size) {
+        size_t size = sql->size ? sql->size : 256;
+        while (sql->len + len + 1 > size)
+            size *= 2;
+        char *buf = realloc(sql->buf, size);
+        if (!buf) {
+            WARN_REALLOC("sql_append()");
+            sql->failed = 1;
+            return;
+        }
+        sql->buf  = buf;
+        sql->size = size;
+    }
+    memcpy(sql->buf + sql->len, str, len);
+    sql->len += len;
+    sql->buf[sql->len] = '\0';
+}
+
+static void sql_append_str(sql_text_t *sql, char const *str)
+{
+    sql_append(sql, str, strlen(str));
+}
+
+/// Append a quoted identifier, embedded quotes are doubled.
+static void sql_append_ident(sql_text_t *sql, char const *name)
+{
+    sql_append(sql, "\"", 1);
+    for (char const *p = name; *p; ++p) {
+        sql_append(sql, p, 1);
+        if (*p == '"')
+            sql_append(sql, p, 1);
+    }
+    sql_append(sql, "\"", 1);
+}
+
+static void sql_reset(sql_text_t *sql)
+{
+    sql->len    = 0;
+    sql->failed = 0;
+    if (sql->buf)
+        sql->buf[0] = '\0';
+}
+
+static int sqlite_exec(data_output_sqlite_t *sq, char const *sql)
+{
+    char *err = NULL;
+    if (sqlite3_exec(sq->db, sql, NULL, NULL, &err) != SQLITE_OK) {
+        fprintf(stderr, "rtl_433: SQLite: %s\n", err ? err : sqlite3_errmsg(sq->db));
+        sqlite3_free(err);
+        return -1;
+    }
+    return 0;
+}
+
+static void sqlite_commit(data_output_sqlite_t *sq)
+{
+    if (!sq->in_transaction)
+        return;
+    sqlite_exec(sq, "COMMIT");
+    // a busy database keeps the transaction open, the commit is tried again
+    sq->in_transaction = !sqlite3_get_autocommit(sq->db);
+    if (!sq->in_transaction)
+        sq->rows = 0;
+}
+
+static int field_order(data_output_sqlite_t *sq, char const *key)
+{
+    if (!sq->fields)
+        return 0;
+    for (int i = 0; i < sq->num_fields; ++i) {
+        if (!strcmp(sq->fields[i], key))
+            return i;
+    }
+    return -1; // not a declared field
+}
+
+static char const *column_type(data_t const *d)
+{
+    return d->type == DATA_INT ? "INTEGER" : d->type == DATA_DOUBLE ? "REAL" : "TEXT";
+}
+
+static sqlite_table_t *sqlite_table_find(data_output_sqlite_t *sq, char const *model)
+{
+    for (void **iter = sq->tables.elems; iter && *iter; ++iter) {
+        sqlite_table_t *t = *iter;
+        if (!strcmp(t->model, model))
+            return t;
+    }
+    sqlite_table_t *t = calloc(1, sizeof(*t));
+    if (!t) {
+        WARN_CALLOC("sqlite_table_find()");
+        return NULL;
+    }
+    t->model = strdup(model);
+    if (!t->model) {
+        WARN_STRDUP("sqlite_table_find()");
+        free(t);
+        return NULL;
+    }
+    sql_reset(&sq->sql);
+    sql_append_ident(&sq->sql, *model ? model : "events");
+    if (sq->sql.failed) {
+        free(t->model);
+        free(t);
+        return NULL;
+    }
+    t->name = strdup(sq->sql.buf);
+    if (!t->name) {
+        WARN_STRDUP("sqlite_table_find()");
+        free(t->model);
+        free(t);
+        return NULL;
+    }
+    list_push(&sq->tables, t);
+    return t;
+}
+
+static int sqlite_column_index(sqlite_table_t *t, char const *key)
+{
+    for (unsigned i = 0; i < t->num_columns; ++i) {
+        if (!strcmp(t->columns[i].key, key))
+            return (int)i;
+    }
+    return -1;
+}
+
+static int sqlite_column_push(sqlite_table_t *t, char const *key, int order)
+{
+    sqlite_column_t *columns = realloc(t->columns, (t->num_columns + 1) * sizeof(*columns));
+    if (!columns) {
+        WARN_REALLOC("sqlite_column_push()");
+        return -1;
+    }
+    t->columns = columns;
+    char *copy = strdup(key);
+    if (!copy) {
+        WARN_STRDUP("sqlite_column_push()");
+        return -1;
+    }
+    columns[t->num_columns].key   = copy;
+    columns[t->num_columns].order = order;
+    t->num_columns++;
+    return 0;
+}
+
+static int compare_columns(void const *a, void const *b)
+{
+    sqlite_column_t const *ca = a;
+    sqlite_column_t const *cb = b;
+    return ca->order - cb->order;
+}
+
+/// Create the table if needed, with the keys of the first event, and read the columns of the table.
+static int sqlite_table_create(data_output_sqlite_t *sq, sqlite_table_t *t, data_t *data)
+{
+    for (data_t *d = data; d; d = d->next) {
+        int order = field_order(sq, d->key);
+        if (order >= 0 && sqlite_column_index(t, d->key) < 0 && sqlite_column_push(t, d->key, sq->fields ? order : (int)t->num_columns))
+            return -1;
+    }
+    if (!t->num_columns)
+        return -1;
+    qsort(t->columns, t->num_columns, sizeof(*t->columns), compare_columns);
+
+    sql_reset(&sq->sql);
+    sql_append_str(&sq->sql, "CREATE TABLE IF NOT EXISTS ");
+    sql_append_str(&sq->sql, t->name);
+    for (unsigned i = 0; i < t->num_columns; ++i) {
+        data_t *d = data;
+        while (strcmp(d->key, t->columns[i].key))
+            d = d->next;
+        sql_append_str(&sq->sql, i ? ", " : " (");
+        sql_append_ident(&sq->sql, d->key);
+        sql_append_str(&sq->sql, " ");
+        sql_append_str(&sq->sql, column_type(d));
+    }
+    sql_append_str(&sq->sql, ")");
+    if (sq->sql.failed || sqlite_exec(sq, sq->sql.buf))
+        return -1;
+
+    // an existing table may have other columns, e.g. from an earlier run
+    for (unsigned i = 0; i < t->num_columns; ++i)
+        free(t->columns[i].key);
+    t->num_columns = 0;
+    sql_reset(&sq->sql);
+    sql_append_str(&sq->sql, "PRAGMA table_info(");
+    sql_append_str(&sq->sql, t->name);
+    sql_append_str(&sq->sql, ")");
+    sqlite3_stmt *stmt;
+    if (sq->sql.failed || sqlite3_prepare_v2(sq->db, sq->sql.buf, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "rtl_433: SQLite: %s\n", sqlite3_errmsg(sq->db));
+        return -1;
+    }
+    int ret = 0;
+    while (!ret && sqlite3_step(stmt) == SQLITE_ROW) {
+        char const *key = (char const *)sqlite3_column_text(stmt, 1);
+        if (key)
+            ret = sqlite_column_push(t, key, 0);
+    }
+    sqlite3_finalize(stmt);
+    return ret;
+}
+
+/// Add a column for a key not yet in the table.
+static int sqlite_column_add(data_output_sqlite_t *sq, sqlite_table_t *t, data_t const *d)
+{
+    sql_reset(&sq->sql);
+    sql_append_str(&sq->sql, "ALTER TABLE ");
+    sql_append_str(&sq->sql, t->name);
+    sql_append_str(&sq->sql, " ADD COLUMN ");
+    sql_append_ident(&sq->sql, d->key);
+    sql_append_str(&sq->sql, " ");
+    sql_append_str(&sq->sql, column_type(d));
+    if (sq->sql.failed || sqlite_exec(sq, sq->sql.buf))
+        return -1;
+    sqlite3_finalize(t->insert);
+    t->insert = NULL;
+    return sqlite_column_push(t, d->key, 0);
+}
+
+static int sqlite_insert_prepare(data_output_sqlite_t *sq, sqlite_table_t *t)
+{
+    sql_reset(&sq->sql);
+    sql_append_str(&sq->sql, "INSERT INTO ");
+    sql_append_str(&sq->sql, t->name);
+    for (unsigned i = 0; i < t->num_columns; ++i) {
+        sql_append_str(&sq->sql, i ? ", " : " (");
+        sql_append_ident(&sq->sql, t->columns[i].key);
+    }
+    sql_append_str(&sq->sql, ") VALUES (");
+    for (unsigned i = 0; i < t->num_columns; ++i) {
+        sql_append_str(&sq->sql, i ? ", ?" : "?");
+    }
+    sql_append_str(&sq->sql, ")");
+    if (sq->sql.failed || sqlite3_prepare_v2(sq->db, sq->sql.buf, -1, &t->insert, NULL) != SQLITE_OK) {
+        fprintf(stderr, "rtl_433: SQLite: %s\n", sqlite3_errmsg(sq->db));
+        sqlite3_finalize(t->insert);
+        t->insert = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/// Bind a value, nested data and arrays as JSON text.
+static void sqlite_bind(data_output_sqlite_t *sq, sqlite3_stmt *stmt, int index, data_t const *d)
+{
+    if (d->type == DATA_INT) {
+        sqlite3_bind_int(stmt, index, d->value.v_int);
+    }
+    else if (d->type == DATA_DOUBLE) {
+        sqlite3_bind_double(stmt, index, d->value.v_dbl);
+    }
+    else if (d->type == DATA_STRING && d->value.v_ptr) {
+        // the event outlives the step
+        sqlite3_bind_text(stmt, index, d->value.v_ptr, -1, SQLITE_STATIC);
+    }
+    else if (d->type == DATA_DATA || d->type == DATA_ARRAY) {
+        // the value of a single element `{"":<value>}`
+        data_t node     = {.key = "", .type = d->type, .value = d->value};
+        size_t len      = 0;
+        char const *str = data_print_jsons_buf(&node, &sq->json, &len);
+        if (str && len >= 5)
+            sqlite3_bind_text(stmt, index, str + 4, (int)len - 5, SQLITE_TRANSIENT);
+    }
+}
+
+static void R_API_CALLCONV print_sqlite_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    data_output_sqlite_t *sq = (data_output_sqlite_t *)output;
+
+    char const *model = "";
+    for (data_t *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL && d->type == DATA_STRING)
+            model = d->value.v_ptr;
+    }
+    sqlite_table_t *t = sqlite_table_find(sq, model);
+    if (!t || t->failed)
+        return;
+
+    if (!sq->in_transaction) {
+        if (sqlite_exec(sq, "BEGIN"))
+            return;
+        sq->in_transaction = 1;
+        sq->begin_time     = time(NULL);
+    }
+
+    if (!t->created) {
+        t->created = 1;
+        t->failed  = sqlite_table_create(sq, t, data);
+        if (t->failed) {
+            fprintf(stderr, "rtl_433: SQLite: the table %s can not be created, the events are dropped\n", t->name);
+            return;
+        }
+    }
+    for (data_t *d = data; d; d = d->next) {
+        if (field_order(sq, d->key) >= 0 && sqlite_column_index(t, d->key) < 0 && sqlite_column_add(sq, t, d))
+            return;
+    }
+    if (!t->insert && sqlite_insert_prepare(sq, t))
+        return;
+
+    for (data_t *d = data; d; d = d->next) {
+        int index = field_order(sq, d->key) >= 0 ? sqlite_column_index(t, d->key) : -1;
+        if (index >= 0)
+            sqlite_bind(sq, t->insert, index + 1, d);
+    }
+    if (sqlite3_step(t->insert) != SQLITE_DONE) {
+        if (!sq->errors)
+            fprintf(stderr, "rtl_433: SQLite: %s\n", sqlite3_errmsg(sq->db));
+        sq->errors++;
+    }
+    sqlite3_reset(t->insert);
+    sqlite3_clear_bindings(t->insert);
+
+    sq->rows++;
+    if (sq->rows >= sq->batch_rows)
+        sqlite_commit(sq);
+}
+
+static void R_API_CALLCONV data_output_sqlite_start(struct data_output *output, char const *const *fields, int num_fields)
+{
+    data_output_sqlite_t *sq = (data_output_sqlite_t *)output;
+
+    if (num_fields <= 0)
+        return; // keep all fields
+    sq->fields = malloc(num_fields * sizeof(*sq->fields));
+    if (!sq->fields) {
+        WARN_MALLOC("data_output_sqlite_start()");
+        return; // NOTE: keeps all fields on alloc failure.
+    }
+    memcpy((void *)sq->fields, fields, num_fields * sizeof(*sq->fields));
+    sq->num_fields = num_fields;
+}
+
+static void R_API_CALLCONV data_output_sqlite_sync(struct data_output *output, int force)
+{
+    data_output_sqlite_t *sq = (data_output_sqlite_t *)output;
+
+    if (sq->in_transaction && (force || time(NULL) - sq->begin_time >= (time_t)sq->batch_secs))
+        sqlite_commit(sq);
+}
+
+static void R_API_CALLCONV data_output_sqlite_free(data_output_t *output)
+{
+    data_output_sqlite_t *sq = (data_output_sqlite_t *)output;
+
+    sqlite_commit(sq);
+    if (sq->errors)
+        fprintf(stderr, "rtl_433: SQLite: %u events failed to insert\n", sq->errors);
+    for (void **iter = sq->tables.elems; iter && *iter; ++iter) {
+        sqlite_table_t *t = *iter;
+        sqlite3_finalize(t->insert);
+        for (unsigned i = 0; i < t->num_columns; ++i)
+            free(t->columns[i].key);
+        free(t->columns);
+        free(t->name);
+        free(t->model);
+        free(t);
+    }
+    list_free_elems(&sq->tables, NULL);
+    sqlite3_close(sq->db);
+    data_buf_free(&sq->json);
+    free(sq->sql.buf);
+    free((void *)sq->fields);
+    free(sq);
+}
+
+struct data_output *data_output_sqlite_create(char const *path, unsigned batch_rows, unsigned batch_secs)
+{
+    data_output_sqlite_t *sq = calloc(1, sizeof(*sq));
+    if (!sq) {
+        WARN_CALLOC("data_output_sqlite_create()");
+        return NULL;
+    }
+    if (sqlite3_open_v2(path, &sq->db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK) {
+        fprintf(stderr, "rtl_433: SQLite: can not open %s: %s\n", path, sq->db ? sqlite3_errmsg(sq->db) : "out of memory");
+        sqlite3_close(sq->db);
+        free(sq);
+        return NULL;
+    }
+    sqlite3_busy_timeout(sq->db, OUTPUT_SQLITE_BUSY_MS);
+    // a commit only syncs the WAL, and the readers do not block the writer
+    if (sqlite_exec(sq, "PRAGMA journal_mode=WAL; PRAGMA synchronous=NORMAL")) {
+        sqlite3_close(sq->db);
+        free(sq);
+        return NULL;
+    }
+    sq->batch_rows = batch_rows ? batch_rows : OUTPUT_SQLITE_BATCH_ROWS;
+    sq->batch_secs = batch_secs ? batch_secs : OUTPUT_SQLITE_BATCH_SECS;
+
+    sq->output.print_data   = print_sqlite_data;
+    sq->output.output_start = data_output_sqlite_start;
+    sq->output.output_sync  = data_output_sqlite_sync;
+    sq->output.output_free  = data_output_sqlite_free;
+
+    return &sq->output;
+}
+
+#else
+
+struct data_output *data_output_sqlite_create(char const *path, unsigned batch_rows, unsigned batch_secs)
+{
+    UNUSED(path);
+    UNUSED(batch_rows);
+    UNUSED(batch_secs);
+    fprintf(stderr, "rtl_433: SQLite output is not available, rebuild with SQLite (libsqlite3-dev)\n");
+    return NULL;
+}
+
+#endif
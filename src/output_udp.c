@@ -12,6 +12,8 @@
 #include "output_udp.h"
 
 #include "data.h"
+#include "output_cbor.h"
+#include "output_delta.h"
 #include "abuf.h"
 #include "r_util.h"
 #include "fatal.h"
@@ -41,6 +43,7 @@
 #else
     #include <sys/types.h>
     #include <sys/socket.h>
+    #include <sys/uio.h>
     #include <netdb.h>
     #include <netinet/in.h>
 
@@ -68,12 +71,29 @@
     #define gai_strerror strerror
 #endif
 
+// sendmmsg() is a GNU extension
+#if defined(__linux__) && defined(_GNU_SOURCE)
+#define HAVE_SENDMMSG
+#endif
+
 /* Datagram (UDP) client */
 
+/// Maximum number of datagrams to send at once.
+#define DATAGRAM_BATCH_MAX 64
+
 typedef struct {
     struct sockaddr_storage addr;
     socklen_t addr_len;
     SOCKET sock;
+    size_t mtu;     ///< maximum datagram size, the size of a slot
+    unsigned batch; ///< number of slots, datagrams are sent when all are queued
+    unsigned count; ///< number of queued datagrams
+    char *slots;    ///< batch slots of mtu bytes each
+    size_t *lens;   ///< length of each queued datagram
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr *msgs;
+    struct iovec *iovs;
+#endif
 } datagram_client_t;
 
 static int datagram_client_open(datagram_client_t *client, const char *host, const char *port)
@@ -117,29 +137,116 @@ static int datagram_client_open(datagram_client_t *client, const char *host, con
     return 0;
 }
 
+/// Allocate the datagram slots, returns -1 on alloc failure.
+static int datagram_client_slots(datagram_client_t *client, size_t mtu, unsigned batch)
+{
+    if (batch < 1)
+        batch = 1;
+    if (batch > DATAGRAM_BATCH_MAX)
+        batch = DATAGRAM_BATCH_MAX;
+    client->mtu   = mtu;
+    client->batch = batch;
+    client->slots = malloc(mtu * batch);
+    if (!client->slots) {
+        WARN_MALLOC("datagram_client_slots()");
+        return -1; // NOTE: returns -1 on alloc failure.
+    }
+    client->lens = calloc(batch, sizeof(*client->lens));
+    if (!client->lens) {
+        WARN_CALLOC("datagram_client_slots()");
+        return -1; // NOTE: returns -1 on alloc failure.
+    }
+#ifdef HAVE_SENDMMSG
+    client->msgs = calloc(batch, sizeof(*client->msgs));
+    if (!client->msgs) {
+        WARN_CALLOC("datagram_client_slots()");
+        return -1; // NOTE: returns -1 on alloc failure.
+    }
+    client->iovs = calloc(batch, sizeof(*client->iovs));
+    if (!client->iovs) {
+        WARN_CALLOC("datagram_client_slots()");
+        return -1; // NOTE: returns -1 on alloc failure.
+    }
+    for (unsigned i = 0; i < batch; ++i) {
+        client->iovs[i].iov_base           = client->slots + i * mtu;
+        client->msgs[i].msg_hdr.msg_iov    = &client->iovs[i];
+        client->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+#endif
+    return 0;
+}
+
+/// The free slot for the next datagram, mtu bytes.
+static char *datagram_client_slot(datagram_client_t *client)
+{
+    return client->slots + client->count * client->mtu;
+}
+
+/// Send the queued datagrams.
+static void datagram_client_flush(datagram_client_t *client)
+{
+    if (!client->count || client->sock == INVALID_SOCKET) {
+        client->count = 0;
+        return;
+    }
+#ifdef HAVE_SENDMMSG
+    for (unsigned i = 0; i < client->count; ++i) {
+        client->iovs[i].iov_len             = client->lens[i];
+        client->msgs[i].msg_hdr.msg_name    = &client->addr;
+        client->msgs[i].msg_hdr.msg_namelen = client->addr_len;
+    }
+    unsigned sent = 0;
+    while (sent < client->count) {
+        int r = sendmmsg(client->sock, client->msgs + sent, client->count - sent, 0);
+        if (r <= 0) {
+            perror("sendmmsg");
+            break;
+        }
+        sent += r;
+    }
+#else
+    for (unsigned i = 0; i < client->count; ++i) {
+        int r = sendto(client->sock, client->slots + i * client->mtu, client->lens[i], 0, (struct sockaddr *)&client->addr, client->addr_len);
+        if (r == -1) {
+            perror("sendto");
+        }
+    }
+#endif
+    client->count = 0;
+}
+
+/// Queue the datagram written to the free slot, sends when the batch is full.
+static void datagram_client_queue(datagram_client_t *client, size_t len)
+{
+    client->lens[client->count++] = len;
+    if (client->count >= client->batch)
+        datagram_client_flush(client);
+}
+
 static void datagram_client_close(datagram_client_t *client)
 {
     if (!client)
         return;
 
+    datagram_client_flush(client);
+
     if (client->sock != INVALID_SOCKET) {
         closesocket(client->sock);
         client->sock = INVALID_SOCKET;
     }
 
+#ifdef HAVE_SENDMMSG
+    free(client->iovs);
+    free(client->msgs);
+#endif
+    free(client->lens);
+    free(client->slots);
+
 #ifdef _WIN32
     WSACleanup();
 #endif
 }
 
-static void datagram_client_send(datagram_client_t *client, const char *message, size_t message_len)
-{
-    int r =  sendto(client->sock, message, message_len, 0, (struct sockaddr *)&client->addr, client->addr_len);
-    if (r == -1) {
-        perror("sendto");
-    }
-}
-
 /* Syslog UDP printer, RFC 5424 (IETF-syslog protocol) */
 
 typedef struct {
@@ -147,6 +254,7 @@ typedef struct {
     datagram_client_t client;
     int pri;
     char hostname[_POSIX_HOST_NAME_MAX + 1];
+    data_buf_t buf; ///< serialization buffer, grows to the largest event
 } data_output_syslog_t;
 
 static void R_API_CALLCONV print_syslog_data(data_output_t *output, data_t *data, char const *format)
@@ -156,9 +264,9 @@ static void R_API_CALLCONV print_syslog_data(data_output_t *output, data_t *data
 
     // we expect a normal message around 500 bytes
     // full stats report would be 12k and we want a max of MTU anyway
-    char message[1024];
-    abuf_t msg = {0};
-    abuf_init(&msg, message, sizeof(message));
+    char *message = datagram_client_slot(&syslog->client);
+    abuf_t msg    = {0};
+    abuf_init(&msg, message, syslog->client.mtu);
 
     time_t now;
     struct tm tm_info;
@@ -173,12 +281,36 @@ static void R_API_CALLCONV print_syslog_data(data_output_t *output, data_t *data
 
     abuf_printf(&msg, "<%d>1 %s %s rtl_433 - - - ", syslog->pri, timestamp, syslog->hostname);
 
-    msg.tail += data_print_jsons(data, msg.tail, msg.left);
-    if (msg.tail >= msg.head + sizeof(message))
+    // reuse the JSON serialized once for all outputs
+    size_t json_len;
+    char const *json = data_print_jsons_buf(data, &syslog->buf, &json_len);
+    if (!json || json_len >= msg.left)
+        return; // abort on overflow, we don't actually want to send more than fits the MTU
+    memcpy(msg.tail, json, json_len + 1);
+    msg.tail += json_len;
+    if (msg.tail >= msg.head + syslog->client.mtu)
         return; // abort on overflow, we don't actually want to send more than fits the MTU
 
     size_t abuf_len = msg.tail - msg.head;
-    datagram_client_send(&syslog->client, message, abuf_len);
+    datagram_client_queue(&syslog->client, abuf_len);
+}
+
+static void R_API_CALLCONV data_output_syslog_sync(data_output_t *output, int force)
+{
+    UNUSED(force);
+    data_output_syslog_t *syslog = (data_output_syslog_t *)output;
+
+    // batched datagrams wait at most until the next sync
+    datagram_client_flush(&syslog->client);
+}
+
+static void R_API_CALLCONV data_output_syslog_batch(data_output_t *output, unsigned num_events)
+{
+    UNUSED(num_events);
+    data_output_syslog_t *syslog = (data_output_syslog_t *)output;
+
+    // the datagrams of a batch of events are sent with one call
+    datagram_client_flush(&syslog->client);
 }
 
 static void R_API_CALLCONV data_output_syslog_free(data_output_t *output)
@@ -190,16 +322,18 @@ static void R_API_CALLCONV data_output_syslog_free(data_output_t *output)
 
     datagram_client_close(&syslog->client);
 
+    data_buf_free(&syslog->buf);
     free(syslog);
 }
 
-struct data_output *data_output_syslog_create(const char *host, const char *port)
+struct data_output *data_output_syslog_create(const char *host, const char *port, unsigned mtu, unsigned batch)
 {
     data_output_syslog_t *syslog = calloc(1, sizeof(data_output_syslog_t));
     if (!syslog) {
         WARN_CALLOC("data_output_syslog_create()");
         return NULL; // NOTE: returns NULL on alloc failure.
     }
+    syslog->client.sock = INVALID_SOCKET;
 #ifdef _WIN32
     WSADATA wsa;
 
@@ -209,8 +343,15 @@ struct data_output *data_output_syslog_create(const char *host, const char *port
         return NULL;
     }
 #endif
+    if (datagram_client_slots(&syslog->client, mtu ? mtu : 1024, batch) < 0) {
+        datagram_client_close(&syslog->client);
+        free(syslog);
+        return NULL;
+    }
 
     syslog->output.print_data   = print_syslog_data;
+    syslog->output.output_sync  = data_output_syslog_sync;
+    syslog->output.output_batch = data_output_syslog_batch;
     syslog->output.output_free  = data_output_syslog_free;
     // Severity 5 "Notice", Facility 20 "local use 4"
     syslog->pri = 20 * 8 + 5;
@@ -231,3 +372,134 @@ struct data_output *data_output_syslog_create(const char *host, const char *port
 
     return &syslog->output;
 }
+
+/* CBOR UDP printer, one event per datagram */
+
+typedef struct {
+    struct data_output output;
+    datagram_client_t client;
+} data_output_cbor_udp_t;
+
+static void R_API_CALLCONV print_cbor_udp_data(data_output_t *output, data_t *data, char const *format)
+{
+    UNUSED(format);
+    data_output_cbor_udp_t *cbor = (data_output_cbor_udp_t *)output;
+
+    uint8_t *message = (uint8_t *)datagram_client_slot(&cbor->client);
+    size_t len       = data_print_cbor(data, message, cbor->client.mtu);
+    if (len > cbor->client.mtu)
+        return; // abort on overflow, we don't want to send more than fits the MTU
+
+    datagram_client_queue(&cbor->client, len);
+}
+
+static void R_API_CALLCONV data_output_cbor_udp_sync(data_output_t *output, int force)
+{
+    UNUSED(force);
+    data_output_cbor_udp_t *cbor = (data_output_cbor_udp_t *)output;
+
+    // batched datagrams wait at most until the next sync
+    datagram_client_flush(&cbor->client);
+}
+
+static void R_API_CALLCONV data_output_cbor_udp_batch(data_output_t *output, unsigned num_events)
+{
+    UNUSED(num_events);
+    data_output_cbor_udp_t *cbor = (data_output_cbor_udp_t *)output;
+
+    // the datagrams of a batch of events are sent with one call
+    datagram_client_flush(&cbor->client);
+}
+
+static void R_API_CALLCONV data_output_cbor_udp_free(data_output_t *output)
+{
+    data_output_cbor_udp_t *cbor = (data_output_cbor_udp_t *)output;
+
+    if (!cbor)
+        return;
+
+    datagram_client_close(&cbor->client);
+
+    free(cbor);
+}
+
+struct data_output *data_output_cbor_udp_create(const char *host, const char *port, unsigned mtu, unsigned batch)
+{
+    data_output_cbor_udp_t *cbor = calloc(1, sizeof(data_output_cbor_udp_t));
+    if (!cbor) {
+        WARN_CALLOC("data_output_cbor_udp_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    cbor->client.sock = INVALID_SOCKET;
+#ifdef _WIN32
+    WSADATA wsa;
+
+    if (WSAStartup(MAKEWORD(2,2),&wsa) != 0) {
+        perror("WSAStartup()");
+        free(cbor);
+        return NULL;
+    }
+#endif
+    // the payload of a datagram in a 1500 byte MTU
+    if (datagram_client_slots(&cbor->client, mtu ? mtu : 1472, batch) < 0) {
+        datagram_client_close(&cbor->client);
+        free(cbor);
+        return NULL;
+    }
+
+    cbor->output.print_data   = print_cbor_udp_data;
+    cbor->output.output_sync  = data_output_cbor_udp_sync;
+    cbor->output.output_batch = data_output_cbor_udp_batch;
+    cbor->output.output_free  = data_output_cbor_udp_free;
+    datagram_client_open(&cbor->client, host, port);
+
+    return &cbor->output;
+}
+
+/* Delta frames UDP sink, one frame per datagram */
+
+static void delta_udp_send(void *ctx, uint8_t const *frame, size_t len)
+{
+    datagram_client_t *client = ctx;
+
+    memcpy(datagram_client_slot(client), frame, len);
+    datagram_client_queue(client, len);
+    datagram_client_flush(client);
+}
+
+static void delta_udp_close(void *ctx)
+{
+    datagram_client_t *client = ctx;
+
+    datagram_client_close(client);
+    free(client);
+}
+
+struct data_output *data_output_delta_udp_create(const char *host, const char *port, delta_output_opts_t const *opts)
+{
+    datagram_client_t *client = calloc(1, sizeof(*client));
+    if (!client) {
+        WARN_CALLOC("data_output_delta_udp_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    client->sock = INVALID_SOCKET;
+#ifdef _WIN32
+    WSADATA wsa;
+
+    if (WSAStartup(MAKEWORD(2,2),&wsa) != 0) {
+        perror("WSAStartup()");
+        free(client);
+        return NULL;
+    }
+#endif
+    if (datagram_client_slots(client, opts->mtu ? opts->mtu : DELTA_MTU, 1) < 0) {
+        delta_udp_close(client);
+        return NULL;
+    }
+    datagram_client_open(client, host, port);
+
+    data_output_t *output = data_output_delta_create(opts, delta_udp_send, delta_udp_close, client);
+    if (!output)
+        delta_udp_close(client);
+    return output;
+}
@@ -0,0 +1,137 @@
+/** @file
+    Runtime control of the CPU profiler, starts and stops a profile of a running instance.
+
+    With GPERFTOOLS the gperftools CPU profiler is started and stopped on request,
+    e.g. by the profile_start RPC or SIGRTMIN+1, otherwise all requests fail.
+    The profiler samples all threads, the control may be called from any thread.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "profiler.h"
+#include "r_util.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef GPERFTOOLS
+
+#include <gperftools/profiler.h>
+
+#if defined(THREADS) && !defined(_WIN32)
+#include <pthread.h>
+static pthread_mutex_t profiler_lock = PTHREAD_MUTEX_INITIALIZER; ///< guards the state below
+#define PROFILER_LOCK()   pthread_mutex_lock(&profiler_lock)
+#define PROFILER_UNLOCK() pthread_mutex_unlock(&profiler_lock)
+#else
+#define PROFILER_LOCK()
+#define PROFILER_UNLOCK()
+#endif
+
+static int running;
+static time_t stop_time; ///< 0 to run until stopped
+static char profile_path[256];
+
+int profiler_available(void)
+{
+    return 1;
+}
+
+int profiler_start(char const *path, unsigned seconds)
+{
+    PROFILER_LOCK();
+    if (running) {
+        PROFILER_UNLOCK();
+        fprintf(stderr, "CPU profile to %s already running\n", profile_path);
+        return -1;
+    }
+    if (path && *path) {
+        snprintf(profile_path, sizeof(profile_path), "%s", path);
+    }
+    else {
+        char time_str[LOCAL_TIME_BUFLEN];
+        format_time_str(time_str, "%Y%m%d_%H%M%S", 0, 0);
+        snprintf(profile_path, sizeof(profile_path), "rtl_433_%s.prof", time_str);
+    }
+    if (!ProfilerStart(profile_path)) {
+        PROFILER_UNLOCK();
+        fprintf(stderr, "Failed to start the CPU profile to %s\n", profile_path);
+        return -1;
+    }
+    running   = 1;
+    stop_time = seconds ? time(NULL) + seconds : 0;
+    PROFILER_UNLOCK();
+    fprintf(stderr, "CPU profile to %s started\n", profile_path);
+    return 0;
+}
+
+int profiler_stop(void)
+{
+    PROFILER_LOCK();
+    if (!running) {
+        PROFILER_UNLOCK();
+        return -1;
+    }
+    ProfilerStop(); // writes out the file
+    running = 0;
+    PROFILER_UNLOCK();
+    fprintf(stderr, "CPU profile written to %s\n", profile_path);
+    return 0;
+}
+
+void profiler_poll(void)
+{
+    // the unlocked read only skips or delays a stop by one poll
+    if (running && stop_time && time(NULL) >= stop_time)
+        profiler_stop();
+}
+
+int profiler_running(void)
+{
+    return running;
+}
+
+char const *profiler_path(void)
+{
+    return profile_path;
+}
+
+#else
+
+int profiler_available(void)
+{
+    return 0;
+}
+
+int profiler_start(char const *path, unsigned seconds)
+{
+    (void)path;
+    (void)seconds;
+    fprintf(stderr, "CPU profiler not available, see ENABLE_PROFILER\n");
+    return -1;
+}
+
+int profiler_stop(void)
+{
+    return -1;
+}
+
+void profiler_poll(void)
+{
+}
+
+int profiler_running(void)
+{
+    return 0;
+}
+
+char const *profiler_path(void)
+{
+    return "";
+}
+
+#endif
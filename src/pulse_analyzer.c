@@ -12,6 +12,7 @@
 #include "pulse_analyzer.h"
 #include "pulse_slicer.h"
 #include "util.h"
+#include "fatal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -34,35 +35,57 @@ typedef struct {
     hist_bin_t bins[MAX_HIST_BINS];
 } histogram_t;
 
-/// Generate a histogram (unsorted)
-static void histogram_sum(histogram_t *hist, int const *data, unsigned len, float tolerance)
+/// Compare widths for qsort().
+static int cmp_width(void const *a, void const *b)
 {
-    unsigned bin;    // Iterator will be used outside for!
+    int x = *(int const *)a;
+    int y = *(int const *)b;
+    return (x > y) - (x < y);
+}
+
+/// Sort a copy of the widths in ascending order.
+static int *sort_widths(int *dst, int const *data, unsigned len)
+{
+    memcpy(dst, data, len * sizeof(*dst));
+    qsort(dst, len, sizeof(*dst), cmp_width);
+    return dst;
+}
+
+/// Merge two sorted runs of widths, dst has room for both.
+static int *merge_widths(int *dst, int const *a, unsigned a_len, int const *b, unsigned b_len)
+{
+    unsigned i = 0, j = 0, k = 0;
+    while (i < a_len && j < b_len)
+        dst[k++] = a[i] <= b[j] ? a[i++] : b[j++];
+    while (i < a_len)
+        dst[k++] = a[i++];
+    while (j < b_len)
+        dst[k++] = b[j++];
+    return dst;
+}
 
+/// Generate a histogram from sorted widths, a sweep merges each width into the last bin (sorted by mean).
+static void histogram_sum(histogram_t *hist, int const *sorted, unsigned len, float tolerance)
+{
     for (unsigned n = 0; n < len; ++n) {
-        // Search for match in existing bins
-        for (bin = 0; bin < hist->bins_count; ++bin) {
-            int bn = data[n];
-            int bm = hist->bins[bin].mean;
-            if (abs(bn - bm) < (tolerance * MAX(bn, bm))) {
-                hist->bins[bin].count++;
-                hist->bins[bin].sum += data[n];
-                hist->bins[bin].mean = hist->bins[bin].sum / hist->bins[bin].count;
-                hist->bins[bin].min    = MIN(data[n], hist->bins[bin].min);
-                hist->bins[bin].max    = MAX(data[n], hist->bins[bin].max);
-                break;    // Match found! Data added to existing bin
-            }
+        int bn = sorted[n];
+        hist_bin_t *bin = hist->bins_count ? &hist->bins[hist->bins_count - 1] : NULL;
+        if (bin && abs(bn - bin->mean) < (tolerance * MAX(bn, bin->mean))) {
+            bin->count++;
+            bin->sum += bn;
+            bin->mean = bin->sum / bin->count;
+            bin->max  = bn; // widths are ascending
+        }
+        // No match found? Add new bin, widths beyond the last bin are dropped
+        else if (hist->bins_count < MAX_HIST_BINS) {
+            bin = &hist->bins[hist->bins_count++];
+            bin->count = 1;
+            bin->sum   = bn;
+            bin->mean  = bn;
+            bin->min   = bn;
+            bin->max   = bn;
         }
-        // No match found? Add new bin
-        if (bin == hist->bins_count && bin < MAX_HIST_BINS) {
-            hist->bins[bin].count    = 1;
-            hist->bins[bin].sum        = data[n];
-            hist->bins[bin].mean    = data[n];
-            hist->bins[bin].min        = data[n];
-            hist->bins[bin].max        = data[n];
-            hist->bins_count++;
-        } // for bin
-    } // for data
+    }
 }
 
 /// Delete bin from histogram
@@ -79,29 +102,16 @@ static void histogram_delete_bin(histogram_t *hist, unsigned index)
 }
 
 
-/// Swap two bins in histogram
-static void histogram_swap_bins(histogram_t *hist, unsigned index1, unsigned index2)
-{
-    hist_bin_t    tempbin;
-    if ((index1 < hist->bins_count) && (index2 < hist->bins_count)) {        // Avoid out of bounds
-        tempbin = hist->bins[index1];
-        hist->bins[index1] = hist->bins[index2];
-        hist->bins[index2] = tempbin;
-    }
-}
-
-
-/// Sort histogram with mean value (order lowest to highest)
+/// Sort histogram with mean value (order lowest to highest), the bins are mostly sorted already
 static void histogram_sort_mean(histogram_t *hist)
 {
-    if (hist->bins_count < 2) return;        // Avoid underflow
-    // Compare all bins (bubble sort)
-    for (unsigned n = 0; n < hist->bins_count-1; ++n) {
-        for (unsigned m = n+1; m < hist->bins_count; ++m) {
-            if (hist->bins[m].mean < hist->bins[n].mean) {
-                histogram_swap_bins(hist, m, n);
-            }
-        }
+    // Insertion sort, stable and linear on sorted bins
+    for (unsigned n = 1; n < hist->bins_count; ++n) {
+        hist_bin_t bin = hist->bins[n];
+        unsigned m     = n;
+        for (; m > 0 && bin.mean < hist->bins[m - 1].mean; --m)
+            hist->bins[m] = hist->bins[m - 1];
+        hist->bins[m] = bin;
     }
 }
 
@@ -109,14 +119,13 @@ static void histogram_sort_mean(histogram_t *hist)
 /// Sort histogram with count value (order lowest to highest)
 static void histogram_sort_count(histogram_t *hist)
 {
-    if (hist->bins_count < 2) return;        // Avoid underflow
-    // Compare all bins (bubble sort)
-    for (unsigned n = 0; n < hist->bins_count-1; ++n) {
-        for (unsigned m = n+1; m < hist->bins_count; ++m) {
-            if (hist->bins[m].count < hist->bins[n].count) {
-                histogram_swap_bins(hist, m, n);
-            }
-        }
+    // Insertion sort, stable
+    for (unsigned n = 1; n < hist->bins_count; ++n) {
+        hist_bin_t bin = hist->bins[n];
+        unsigned m     = n;
+        for (; m > 0 && bin.count < hist->bins[m - 1].count; --m)
+            hist->bins[m] = hist->bins[m - 1];
+        hist->bins[m] = bin;
     }
 }
 
@@ -201,6 +210,203 @@ static void hexstr_print(hexstr_t *h, FILE *out)
 
 #define TOLERANCE (0.2f) // 20% tolerance should still discern between the pulse widths: 0.33, 0.66, 1.0
 
+/// The histograms of a package
+typedef struct {
+    histogram_t pulses;
+    histogram_t gaps;
+    histogram_t periods;
+    histogram_t timings;
+    int total_period;
+} pulse_histograms_t;
+
+/// Generate the statistics of a package, the widths are sorted once and binned in a sweep, returns -1 on alloc failure.
+static int pulse_histograms(pulse_histograms_t *h, pulse_data_t const *data)
+{
+    unsigned num = data->num_pulses;
+    // sorted pulses, gaps, periods, and the merged timings
+    int *pulses = malloc(5 * num * sizeof(*pulses));
+    if (!pulses) {
+        WARN_MALLOC("pulse_analyzer()");
+        return -1;
+    }
+    int *gaps    = pulses + num;
+    int *periods = gaps + num;
+    int *timings = periods + num;
+
+    // Generate pulse period data
+    h->total_period = 0;
+    for (unsigned n = 0; n < num; ++n) {
+        periods[n] = data->pulse[n] + data->gap[n];
+        h->total_period += data->pulse[n] + data->gap[n];
+    }
+    h->total_period -= data->gap[num - 1];
+
+    sort_widths(pulses, data->pulse, num);
+    sort_widths(gaps, data->gap, num - 1);                // Leave out last gap (end)
+    qsort(periods, num - 1, sizeof(*periods), cmp_width); // Leave out last gap (end)
+    // The timings are all pulses and gaps, insert the last gap into the merged runs
+    merge_widths(timings, pulses, num, gaps, num - 1);
+    unsigned k = 2 * num - 1;
+    for (; k > 0 && timings[k - 1] > data->gap[num - 1]; --k)
+        timings[k] = timings[k - 1];
+    timings[k] = data->gap[num - 1];
+
+    // Generate statistics
+    histogram_sum(&h->pulses, pulses, num, TOLERANCE);
+    histogram_sum(&h->gaps, gaps, num - 1, TOLERANCE);
+    histogram_sum(&h->periods, periods, num - 1, TOLERANCE);
+    histogram_sum(&h->timings, timings, 2 * num, TOLERANCE);
+    free(pulses);
+
+    // Fuse overlapping bins
+    histogram_fuse_bins(&h->pulses, TOLERANCE);
+    histogram_fuse_bins(&h->gaps, TOLERANCE);
+    histogram_fuse_bins(&h->periods, TOLERANCE);
+    histogram_fuse_bins(&h->timings, TOLERANCE);
+    return 0;
+}
+
+/// Guess the modulation of a package, the pulse and gap histograms are sorted by mean.
+static pulse_class_t guess_modulation(pulse_histograms_t *h, unsigned num_pulses, int package_type, double to_us, r_device *device)
+{
+    histogram_t *hist_pulses = &h->pulses;
+    histogram_t *hist_gaps   = &h->gaps;
+
+    // Attempt to find a matching modulation
+    if (num_pulses == 1) {
+        return PULSE_CLASS_SINGLE;
+    }
+    else if (hist_pulses->bins_count == 1 && hist_gaps->bins_count == 1) {
+        return PULSE_CLASS_UNMODULATED;
+    }
+    else if (hist_pulses->bins_count == 1 && hist_gaps->bins_count > 1) {
+        device->modulation  = OOK_PULSE_PPM; // TODO: there is not FSK_PULSE_PPM
+        device->short_width = to_us * hist_gaps->bins[0].mean;
+        device->long_width  = to_us * hist_gaps->bins[1].mean;
+        device->gap_limit   = to_us * (hist_gaps->bins[1].max + 1);                         // Set limit above next lower gap
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+        return PULSE_CLASS_PPM;
+    }
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count == 1) {
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
+        device->short_width = to_us * hist_pulses->bins[0].mean;
+        device->long_width  = to_us * hist_pulses->bins[1].mean;
+        device->tolerance   = (device->long_width - device->short_width) * 0.4;
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+        return PULSE_CLASS_PWM_FIXED_GAP;
+    }
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count == 2 && h->periods.bins_count == 1) {
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
+        device->short_width = to_us * hist_pulses->bins[0].mean;
+        device->long_width  = to_us * hist_pulses->bins[1].mean;
+        device->tolerance   = (device->long_width - device->short_width) * 0.4;
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+        return PULSE_CLASS_PWM_FIXED_PERIOD;
+    }
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count == 2 && h->periods.bins_count == 3) {
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_MANCHESTER_ZEROBIT : OOK_PULSE_MANCHESTER_ZEROBIT;
+        device->short_width = to_us * MIN(hist_pulses->bins[0].mean, hist_pulses->bins[1].mean); // Assume shortest pulse is half period
+        device->long_width  = 0;                                                                 // Not used
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1);      // Set limit above biggest gap
+        return PULSE_CLASS_MANCHESTER;
+    }
+    else if (hist_pulses->bins_count == 2 && hist_gaps->bins_count >= 3) {
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
+        device->short_width = to_us * hist_pulses->bins[0].mean;
+        device->long_width  = to_us * hist_pulses->bins[1].mean;
+        device->gap_limit   = to_us * (hist_gaps->bins[1].max + 1); // Set limit above second gap
+        device->tolerance   = (device->long_width - device->short_width) * 0.4;
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+        return PULSE_CLASS_PWM_PACKETS;
+    }
+    else if ((hist_pulses->bins_count >= 3 && hist_gaps->bins_count >= 3)
+            && (abs(hist_pulses->bins[1].mean - 2*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)    // Pulses are multiples of shortest pulse
+            && (abs(hist_pulses->bins[2].mean - 3*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)
+            && (abs(hist_gaps->bins[0].mean   -   hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)    // Gaps are multiples of shortest pulse
+            && (abs(hist_gaps->bins[1].mean   - 2*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)
+            && (abs(hist_gaps->bins[2].mean   - 3*hist_pulses->bins[0].mean) <= hist_pulses->bins[0].mean/8)) {
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PCM : OOK_PULSE_PCM;
+        device->short_width = to_us * hist_pulses->bins[0].mean;        // Shortest pulse is bit width
+        device->long_width  = to_us * hist_pulses->bins[0].mean;        // Bit period equal to pulse length (NRZ)
+        device->reset_limit = to_us * hist_pulses->bins[0].mean * 1024; // No limit to run of zeros...
+        return PULSE_CLASS_PCM;
+    }
+    else if (hist_pulses->bins_count == 3) {
+        // Re-sort to find lowest pulse count index (is probably delimiter)
+        histogram_sort_count(hist_pulses);
+        int p1 = hist_pulses->bins[1].mean;
+        int p2 = hist_pulses->bins[2].mean;
+        device->modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
+        device->short_width = to_us * (p1 < p2 ? p1 : p2);                                  // Set to shorter pulse width
+        device->long_width  = to_us * (p1 < p2 ? p2 : p1);                                  // Set to longer pulse width
+        device->sync_width  = to_us * hist_pulses->bins[0].mean;                            // Set to lowest count pulse width
+        device->reset_limit = to_us * (hist_gaps->bins[hist_gaps->bins_count - 1].max + 1); // Set limit above biggest gap
+        return PULSE_CLASS_PWM_SYNC;
+    }
+    return PULSE_CLASS_UNKNOWN;
+}
+
+/// The guessed modulation as printed by the analyzer.
+static char const *const pulse_class_text[PULSE_CLASS_COUNT] = {
+        [PULSE_CLASS_UNKNOWN]          = "No clue...",
+        [PULSE_CLASS_SINGLE]           = "Single pulse detected. Probably Frequency Shift Keying or just noise...",
+        [PULSE_CLASS_UNMODULATED]      = "Un-modulated signal. Maybe a preamble...",
+        [PULSE_CLASS_PPM]              = "Pulse Position Modulation with fixed pulse width",
+        [PULSE_CLASS_PWM_FIXED_GAP]    = "Pulse Width Modulation with fixed gap",
+        [PULSE_CLASS_PWM_FIXED_PERIOD] = "Pulse Width Modulation with fixed period",
+        [PULSE_CLASS_MANCHESTER]       = "Manchester coding",
+        [PULSE_CLASS_PWM_PACKETS]      = "Pulse Width Modulation with multiple packets",
+        [PULSE_CLASS_PCM]              = "Non Return to Zero coding (Pulse Code)",
+        [PULSE_CLASS_PWM_SYNC]         = "Pulse Width Modulation with sync/delimiter",
+};
+
+/// The guessed modulation in the batch summary.
+static char const *const pulse_class_name[PULSE_CLASS_COUNT] = {
+        [PULSE_CLASS_UNKNOWN]          = "unknown",
+        [PULSE_CLASS_SINGLE]           = "single pulse",
+        [PULSE_CLASS_UNMODULATED]      = "un-modulated",
+        [PULSE_CLASS_PPM]              = "PPM",
+        [PULSE_CLASS_PWM_FIXED_GAP]    = "PWM fixed gap",
+        [PULSE_CLASS_PWM_FIXED_PERIOD] = "PWM fixed period",
+        [PULSE_CLASS_MANCHESTER]       = "Manchester",
+        [PULSE_CLASS_PWM_PACKETS]      = "PWM packets",
+        [PULSE_CLASS_PCM]              = "PCM (NRZ)",
+        [PULSE_CLASS_PWM_SYNC]         = "PWM sync",
+};
+
+/// Format the flex decoder spec of a guessed modulation, spec is empty if flex has no such modulation.
+static void flex_spec(char *spec, size_t size, char const *name, r_device const *device)
+{
+    switch (device->modulation) {
+    case OOK_PULSE_PCM:
+    case FSK_PULSE_PCM:
+        snprintf(spec, size, "n=%s,m=%s,s=%.0f,l=%.0f,r=%.0f", name,
+                device->modulation == FSK_PULSE_PCM ? "FSK_PCM" : "OOK_PCM",
+                device->short_width, device->long_width, device->reset_limit);
+        break;
+    case OOK_PULSE_PPM:
+        snprintf(spec, size, "n=%s,m=OOK_PPM,s=%.0f,l=%.0f,g=%.0f,r=%.0f", name,
+                device->short_width, device->long_width,
+                device->gap_limit, device->reset_limit);
+        break;
+    case OOK_PULSE_PWM:
+    case FSK_PULSE_PWM:
+        snprintf(spec, size, "n=%s,m=%s,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f", name,
+                device->modulation == FSK_PULSE_PWM ? "FSK_PWM" : "OOK_PWM",
+                device->short_width, device->long_width, device->reset_limit,
+                device->gap_limit, device->tolerance, device->sync_width);
+        break;
+    case OOK_PULSE_MANCHESTER_ZEROBIT:
+    case FSK_PULSE_MANCHESTER_ZEROBIT:
+        snprintf(spec, size, "n=%s,m=%s,s=%.0f,l=%.0f,r=%.0f", name,
+                device->modulation == FSK_PULSE_MANCHESTER_ZEROBIT ? "FSK_MC_ZEROBIT" : "OOK_MC_ZEROBIT",
+                device->short_width, device->long_width, device->reset_limit);
+        break;
+    default:
+        spec[0] = '\0';
+    }
+}
+
 /// Analyze the statistics of a pulse data structure and print result
 void pulse_analyzer(pulse_data_t *data, int package_type)
 {
@@ -211,45 +417,24 @@ void pulse_analyzer(pulse_data_t *data, int package_type)
 
     double to_ms = 1e3 / data->sample_rate;
     double to_us = 1e6 / data->sample_rate;
-    // Generate pulse period data
-    int pulse_total_period = 0;
-    pulse_data_t pulse_periods = {0};
-    pulse_periods.num_pulses = data->num_pulses;
-    for (unsigned n = 0; n < pulse_periods.num_pulses; ++n) {
-        pulse_periods.pulse[n] = data->pulse[n] + data->gap[n];
-        pulse_total_period += data->pulse[n] + data->gap[n];
+    pulse_histograms_t h = {0};
+    if (pulse_histograms(&h, data)) {
+        return;
     }
-    pulse_total_period -= data->gap[pulse_periods.num_pulses - 1];
-
-    histogram_t hist_pulses  = {0};
-    histogram_t hist_gaps    = {0};
-    histogram_t hist_periods = {0};
-    histogram_t hist_timings = {0};
-
-    // Generate statistics
-    histogram_sum(&hist_pulses, data->pulse, data->num_pulses, TOLERANCE);
-    histogram_sum(&hist_gaps, data->gap, data->num_pulses - 1, TOLERANCE);                      // Leave out last gap (end)
-    histogram_sum(&hist_periods, pulse_periods.pulse, pulse_periods.num_pulses - 1, TOLERANCE); // Leave out last gap (end)
-    histogram_sum(&hist_timings, data->pulse, data->num_pulses, TOLERANCE);
-    histogram_sum(&hist_timings, data->gap, data->num_pulses, TOLERANCE);
-
-    // Fuse overlapping bins
-    histogram_fuse_bins(&hist_pulses, TOLERANCE);
-    histogram_fuse_bins(&hist_gaps, TOLERANCE);
-    histogram_fuse_bins(&hist_periods, TOLERANCE);
-    histogram_fuse_bins(&hist_timings, TOLERANCE);
+    histogram_t const *hist_gaps    = &h.gaps;
+    histogram_t const *hist_timings = &h.timings;
 
     fprintf(stderr, "Analyzing pulses...\n");
     fprintf(stderr, "Total count: %4u,  width: %4.2f ms\t\t(%5i S)\n",
-            data->num_pulses, pulse_total_period * to_ms, pulse_total_period);
+            data->num_pulses, h.total_period * to_ms, h.total_period);
     fprintf(stderr, "Pulse width distribution:\n");
-    histogram_print(&hist_pulses, data->sample_rate);
+    histogram_print(&h.pulses, data->sample_rate);
     fprintf(stderr, "Gap width distribution:\n");
-    histogram_print(&hist_gaps, data->sample_rate);
+    histogram_print(&h.gaps, data->sample_rate);
     fprintf(stderr, "Pulse period distribution:\n");
-    histogram_print(&hist_periods, data->sample_rate);
+    histogram_print(&h.periods, data->sample_rate);
     fprintf(stderr, "Pulse timing distribution:\n");
-    histogram_print(&hist_timings, data->sample_rate);
+    histogram_print(&h.timings, data->sample_rate);
     fprintf(stderr, "Level estimates [high, low]: %6i, %6i\n",
             data->ook_high_estimate, data->ook_low_estimate);
     fprintf(stderr, "RSSI: %.1f dB SNR: %.1f dB Noise: %.1f dB\n",
@@ -259,104 +444,30 @@ void pulse_analyzer(pulse_data_t *data, int package_type)
             (float)data->fsk_f1_est / INT16_MAX * data->sample_rate / 2.0 / 1000.0,
             (float)data->fsk_f2_est / INT16_MAX * data->sample_rate / 2.0 / 1000.0);
 
-    fprintf(stderr, "Guessing modulation: ");
     r_device device = {.name = "Analyzer Device", 0};
-    histogram_sort_mean(&hist_pulses); // Easier to work with sorted data
-    histogram_sort_mean(&hist_gaps);
-    if (hist_pulses.bins[0].mean == 0) {
-        histogram_delete_bin(&hist_pulses, 0);
+    histogram_sort_mean(&h.pulses); // Easier to work with sorted data
+    histogram_sort_mean(&h.gaps);
+    if (h.pulses.bins[0].mean == 0) {
+        histogram_delete_bin(&h.pulses, 0);
     } // Remove FSK initial zero-bin
-
-    // Attempt to find a matching modulation
-    if (data->num_pulses == 1) {
-        fprintf(stderr, "Single pulse detected. Probably Frequency Shift Keying or just noise...\n");
-    }
-    else if (hist_pulses.bins_count == 1 && hist_gaps.bins_count == 1) {
-        fprintf(stderr, "Un-modulated signal. Maybe a preamble...\n");
-    }
-    else if (hist_pulses.bins_count == 1 && hist_gaps.bins_count > 1) {
-        fprintf(stderr, "Pulse Position Modulation with fixed pulse width\n");
-        device.modulation  = OOK_PULSE_PPM; // TODO: there is not FSK_PULSE_PPM
-        device.short_width = to_us * hist_gaps.bins[0].mean;
-        device.long_width  = to_us * hist_gaps.bins[1].mean;
-        device.gap_limit   = to_us * (hist_gaps.bins[1].max + 1);                        // Set limit above next lower gap
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count == 1) {
-        fprintf(stderr, "Pulse Width Modulation with fixed gap\n");
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device.short_width = to_us * hist_pulses.bins[0].mean;
-        device.long_width  = to_us * hist_pulses.bins[1].mean;
-        device.tolerance   = (device.long_width - device.short_width) * 0.4;
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count == 2 && hist_periods.bins_count == 1) {
-        fprintf(stderr, "Pulse Width Modulation with fixed period\n");
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device.short_width = to_us * hist_pulses.bins[0].mean;
-        device.long_width  = to_us * hist_pulses.bins[1].mean;
-        device.tolerance   = (device.long_width - device.short_width) * 0.4;
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count == 2 && hist_periods.bins_count == 3) {
-        fprintf(stderr, "Manchester coding\n");
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_MANCHESTER_ZEROBIT : OOK_PULSE_MANCHESTER_ZEROBIT;
-        device.short_width = to_us * MIN(hist_pulses.bins[0].mean, hist_pulses.bins[1].mean); // Assume shortest pulse is half period
-        device.long_width  = 0;                                                               // Not used
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1);      // Set limit above biggest gap
-    }
-    else if (hist_pulses.bins_count == 2 && hist_gaps.bins_count >= 3) {
-        fprintf(stderr, "Pulse Width Modulation with multiple packets\n");
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device.short_width = to_us * hist_pulses.bins[0].mean;
-        device.long_width  = to_us * hist_pulses.bins[1].mean;
-        device.gap_limit   = to_us * (hist_gaps.bins[1].max + 1); // Set limit above second gap
-        device.tolerance   = (device.long_width - device.short_width) * 0.4;
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else if ((hist_pulses.bins_count >= 3 && hist_gaps.bins_count >= 3)
-            && (abs(hist_pulses.bins[1].mean - 2*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)    // Pulses are multiples of shortest pulse
-            && (abs(hist_pulses.bins[2].mean - 3*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)
-            && (abs(hist_gaps.bins[0].mean   -   hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)    // Gaps are multiples of shortest pulse
-            && (abs(hist_gaps.bins[1].mean   - 2*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)
-            && (abs(hist_gaps.bins[2].mean   - 3*hist_pulses.bins[0].mean) <= hist_pulses.bins[0].mean/8)) {
-        fprintf(stderr, "Non Return to Zero coding (Pulse Code)\n");
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PCM : OOK_PULSE_PCM;
-        device.short_width = to_us * hist_pulses.bins[0].mean;        // Shortest pulse is bit width
-        device.long_width  = to_us * hist_pulses.bins[0].mean;        // Bit period equal to pulse length (NRZ)
-        device.reset_limit = to_us * hist_pulses.bins[0].mean * 1024; // No limit to run of zeros...
-    }
-    else if (hist_pulses.bins_count == 3) {
-        fprintf(stderr, "Pulse Width Modulation with sync/delimiter\n");
-        // Re-sort to find lowest pulse count index (is probably delimiter)
-        histogram_sort_count(&hist_pulses);
-        int p1 = hist_pulses.bins[1].mean;
-        int p2 = hist_pulses.bins[2].mean;
-        device.modulation  = (package_type == PULSE_DATA_FSK) ? FSK_PULSE_PWM : OOK_PULSE_PWM;
-        device.short_width = to_us * (p1 < p2 ? p1 : p2);                                // Set to shorter pulse width
-        device.long_width  = to_us * (p1 < p2 ? p2 : p1);                                // Set to longer pulse width
-        device.sync_width  = to_us * hist_pulses.bins[0].mean;                           // Set to lowest count pulse width
-        device.reset_limit = to_us * (hist_gaps.bins[hist_gaps.bins_count - 1].max + 1); // Set limit above biggest gap
-    }
-    else {
-        fprintf(stderr, "No clue...\n");
-    }
+    pulse_class_t guess = guess_modulation(&h, data->num_pulses, package_type, to_us, &device);
+    fprintf(stderr, "Guessing modulation: %s\n", pulse_class_text[guess]);
 
     // Output RfRaw line (if possible)
-    if (hist_timings.bins_count <= 8) {
+    if (hist_timings->bins_count <= 8) {
         // if there is no 3rd gap length output one long B1 code
-        if (hist_gaps.bins_count <= 2) {
+        if (hist_gaps->bins_count <= 2) {
             hexstr_t hexstr = {.p = {0}};
             hexstr_push_byte(&hexstr, 0xaa);
             hexstr_push_byte(&hexstr, 0xb1);
-            hexstr_push_byte(&hexstr, hist_timings.bins_count);
-            for (unsigned b = 0; b < hist_timings.bins_count; ++b) {
-                double w = hist_timings.bins[b].mean * to_us;
+            hexstr_push_byte(&hexstr, hist_timings->bins_count);
+            for (unsigned b = 0; b < hist_timings->bins_count; ++b) {
+                double w = hist_timings->bins[b].mean * to_us;
                 hexstr_push_word(&hexstr, w < USHRT_MAX ? w : USHRT_MAX);
             }
             for (unsigned i = 0; i < data->num_pulses; ++i) {
-                int p = histogram_find_bin_index(&hist_timings, data->pulse[i]);
-                int g = histogram_find_bin_index(&hist_timings, data->gap[i]);
+                int p = histogram_find_bin_index(hist_timings, data->pulse[i]);
+                int g = histogram_find_bin_index(hist_timings, data->gap[i]);
                 if (p < 0 || g < 0) {
                     fprintf(stderr, "%s: this can't happen\n", __func__);
                     exit(1);
@@ -371,8 +482,8 @@ void pulse_analyzer(pulse_data_t *data, int package_type)
         // otherwise try to group as B0 codes
         else {
             // pick last gap length but a most the 4th
-            int limit_bin = MIN(3, hist_gaps.bins_count - 1);
-            int limit = hist_gaps.bins[limit_bin].min;
+            int limit_bin = MIN(3, hist_gaps->bins_count - 1);
+            int limit = hist_gaps->bins[limit_bin].min;
             hexstr_t hexstrs[HEXSTR_MAX_COUNT] = {{.p = {0}}};
             unsigned hexstr_cnt = 0;
             unsigned i = 0;
@@ -381,15 +492,15 @@ void pulse_analyzer(pulse_data_t *data, int package_type)
                 hexstr_push_byte(hexstr, 0xaa);
                 hexstr_push_byte(hexstr, 0xb0);
                 hexstr_push_byte(hexstr, 0); // len
-                hexstr_push_byte(hexstr, hist_timings.bins_count);
+                hexstr_push_byte(hexstr, hist_timings->bins_count);
                 hexstr_push_byte(hexstr, 1); // repeats
-                for (unsigned b = 0; b < hist_timings.bins_count; ++b) {
-                    double w =hist_timings.bins[b].mean * to_us;
+                for (unsigned b = 0; b < hist_timings->bins_count; ++b) {
+                    double w =hist_timings->bins[b].mean * to_us;
                     hexstr_push_word(hexstr, w < USHRT_MAX ? w : USHRT_MAX);
                 }
                 for (; i < data->num_pulses; ++i) {
-                    int p = histogram_find_bin_index(&hist_timings, data->pulse[i]);
-                    int g = histogram_find_bin_index(&hist_timings, data->gap[i]);
+                    int p = histogram_find_bin_index(hist_timings, data->pulse[i]);
+                    int g = histogram_find_bin_index(hist_timings, data->gap[i]);
                     if (p < 0 || g < 0) {
                         fprintf(stderr, "%s: this can't happen\n", __func__);
                         exit(1);
@@ -429,36 +540,30 @@ void pulse_analyzer(pulse_data_t *data, int package_type)
         fprintf(stderr, "Attempting demodulation... short_width: %.0f, long_width: %.0f, reset_limit: %.0f, sync_width: %.0f\n",
                 device.short_width, device.long_width,
                 device.reset_limit, device.sync_width);
+        char spec[FLEX_SPEC_SIZE];
+        flex_spec(spec, sizeof(spec), "name", &device);
         switch (device.modulation) {
         case FSK_PULSE_PCM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=FSK_PCM,s=%.0f,l=%.0f,r=%.0f'\n",
-                    device.short_width, device.long_width, device.reset_limit);
+            fprintf(stderr, "Use a flex decoder with -X '%s'\n", spec);
             pulse_slicer_pcm(data, &device);
             break;
         case OOK_PULSE_PPM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=OOK_PPM,s=%.0f,l=%.0f,g=%.0f,r=%.0f'\n",
-                    device.short_width, device.long_width,
-                    device.gap_limit, device.reset_limit);
+            fprintf(stderr, "Use a flex decoder with -X '%s'\n", spec);
             data->gap[data->num_pulses - 1] = device.reset_limit / to_us + 1; // Be sure to terminate package
             pulse_slicer_ppm(data, &device);
             break;
         case OOK_PULSE_PWM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=OOK_PWM,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f'\n",
-                    device.short_width, device.long_width, device.reset_limit,
-                    device.gap_limit, device.tolerance, device.sync_width);
+            fprintf(stderr, "Use a flex decoder with -X '%s'\n", spec);
             data->gap[data->num_pulses - 1] = device.reset_limit / to_us + 1; // Be sure to terminate package
             pulse_slicer_pwm(data, &device);
             break;
         case FSK_PULSE_PWM:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=FSK_PWM,s=%.0f,l=%.0f,r=%.0f,g=%.0f,t=%.0f,y=%.0f'\n",
-                    device.short_width, device.long_width, device.reset_limit,
-                    device.gap_limit, device.tolerance, device.sync_width);
+            fprintf(stderr, "Use a flex decoder with -X '%s'\n", spec);
             data->gap[data->num_pulses - 1] = device.reset_limit / to_us + 1; // Be sure to terminate package
             pulse_slicer_pwm(data, &device);
             break;
         case OOK_PULSE_MANCHESTER_ZEROBIT:
-            fprintf(stderr, "Use a flex decoder with -X 'n=name,m=OOK_MC_ZEROBIT,s=%.0f,l=%.0f,r=%.0f'\n",
-                    device.short_width, device.long_width, device.reset_limit);
+            fprintf(stderr, "Use a flex decoder with -X '%s'\n", spec);
             data->gap[data->num_pulses - 1] = device.reset_limit / to_us + 1; // Be sure to terminate package
             pulse_slicer_manchester_zerobit(data, &device);
             break;
@@ -469,3 +574,96 @@ void pulse_analyzer(pulse_data_t *data, int package_type)
 
     fprintf(stderr, "\n");
 }
+
+/// Guess the modulation without output, the package must have pulses.
+static pulse_class_t guess_quietly(pulse_data_t const *data, int package_type, r_device *device)
+{
+    pulse_histograms_t h = {0};
+    if (pulse_histograms(&h, data))
+        return PULSE_CLASS_UNKNOWN;
+    histogram_sort_mean(&h.pulses);
+    histogram_sort_mean(&h.gaps);
+    if (h.pulses.bins[0].mean == 0) {
+        histogram_delete_bin(&h.pulses, 0);
+    } // Remove FSK initial zero-bin
+    return guess_modulation(&h, data->num_pulses, package_type, 1e6 / data->sample_rate, device);
+}
+
+pulse_analyzer_stats_t *pulse_analyzer_stats_create(unsigned interval)
+{
+    pulse_analyzer_stats_t *stats = calloc(1, sizeof(*stats));
+    if (!stats) {
+        WARN_CALLOC("pulse_analyzer_stats_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    stats->interval = interval;
+    return stats;
+}
+
+void pulse_analyzer_stats_free(pulse_analyzer_stats_t *stats)
+{
+    if (!stats)
+        return;
+    pulse_analyzer_stats_print(stats);
+    free(stats);
+}
+
+void pulse_analyzer_batch(pulse_analyzer_stats_t *stats, pulse_data_t const *data, int package_type)
+{
+    if (data->num_pulses == 0)
+        return;
+
+    r_device device = {0};
+    pulse_class_t guess = guess_quietly(data, package_type, &device);
+
+    pulse_class_stats_t *cs = &stats->classes[package_type == PULSE_DATA_FSK][guess];
+    cs->packages++;
+    cs->pulses += data->num_pulses;
+    cs->short_us += device.short_width;
+    cs->long_us += device.long_width;
+    cs->reset_us += device.reset_limit;
+    stats->packages++;
+    stats->total++;
+
+    if (stats->interval && stats->packages >= stats->interval)
+        pulse_analyzer_stats_print(stats);
+}
+
+pulse_class_t pulse_analyzer_suggest(pulse_data_t const *data, int package_type, char const *name, char *spec, size_t size)
+{
+    spec[0] = '\0';
+    if (data->num_pulses == 0)
+        return PULSE_CLASS_UNKNOWN;
+
+    r_device device = {0};
+    pulse_class_t guess = guess_quietly(data, package_type, &device);
+    flex_spec(spec, size, name, &device);
+    return guess;
+}
+
+char const *pulse_class_str(pulse_class_t guess)
+{
+    return guess < PULSE_CLASS_COUNT ? pulse_class_name[guess] : "unknown";
+}
+
+void pulse_analyzer_stats_print(pulse_analyzer_stats_t *stats)
+{
+    if (!stats->packages)
+        return;
+    fprintf(stderr, "Pulse analyzer summary of %u packages (%u total):\n", stats->packages, stats->total);
+    for (unsigned t = 0; t < 2; ++t) {
+        for (unsigned c = 0; c < PULSE_CLASS_COUNT; ++c) {
+            pulse_class_stats_t const *cs = &stats->classes[t][c];
+            if (!cs->packages)
+                continue;
+            fprintf(stderr, " %s %-16s: %5u packages, %5u pulses avg",
+                    t ? "FSK" : "OOK", pulse_class_name[c], cs->packages, cs->pulses / cs->packages);
+            if (cs->reset_us > 0.0)
+                fprintf(stderr, ", short %.0f us, long %.0f us, reset %.0f us",
+                        cs->short_us / cs->packages, cs->long_us / cs->packages, cs->reset_us / cs->packages);
+            fprintf(stderr, "\n");
+        }
+    }
+    memset(stats->classes, 0, sizeof(stats->classes));
+    stats->packages = 0;
+}
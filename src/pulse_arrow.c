@@ -0,0 +1,331 @@
+/** @file
+    Arrow IPC pulse data export, a columnar file of the packages for offline analysis.
+
+    The packages are collected into record batches of columns, see arrow_ipc.h for
+    the file format. No value is null.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "pulse_arrow.h"
+#include "arrow_ipc.h"
+#include "compat_pthread.h"
+#include "thread_pin.h"
+#include "fatal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static arrow_column_t const columns[] = {
+        {"offset", ARROW_INT64, 0},
+        {"rate_Hz", ARROW_INT32, 0},
+        {"mod", ARROW_UTF8, 0},
+        {"freq_Hz", ARROW_FLOAT32, 0},
+        {"freq1_Hz", ARROW_FLOAT32, 0},
+        {"freq2_Hz", ARROW_FLOAT32, 0},
+        {"rssi_dB", ARROW_FLOAT32, 0},
+        {"snr_dB", ARROW_FLOAT32, 0},
+        {"noise_dB", ARROW_FLOAT32, 0},
+        {"events", ARROW_INT32, 0},
+        {"pulses", ARROW_LIST_INT32, 0},
+        {"gaps", ARROW_LIST_INT32, 0},
+};
+#define NUM_COLUMNS (sizeof(columns) / sizeof(*columns))
+
+/* record batches */
+
+/// The meta data of a package, the widths are kept in the batch.
+typedef struct {
+    uint64_t offset;
+    uint32_t sample_rate;
+    int fsk;
+    float freq, freq1, freq2, rssi, snr, noise;
+    int events;
+    unsigned num_pulses;
+} arrow_row_t;
+
+typedef struct {
+    arrow_row_t *rows;
+    unsigned rows_len;
+    unsigned rows_size;
+    int32_t *pulses; ///< the pulse widths of all rows
+    int32_t *gaps;   ///< the gap widths of all rows
+    size_t pulses_len;
+    size_t pulses_size;
+} arrow_batch_t;
+
+struct pulse_arrow {
+    arrow_ipc_t *ipc;
+    arrow_body_t body;   ///< the encoded batch, reused
+    arrow_batch_t *fill; ///< the batch being filled
+#ifdef THREADS
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;    ///< signals a pending batch, a written batch, or the exit
+    int started;
+    int exit;
+    arrow_batch_t *pending; ///< the batch handed to the writer thread
+    arrow_batch_t *spare;   ///< a written batch to fill again
+#endif
+};
+
+/// Put the list offsets of the widths of all rows.
+static void put_offsets(uint8_t *p, arrow_batch_t const *batch)
+{
+    uint32_t pos = 0;
+    arrow_put(p, 0, 4);
+    for (unsigned i = 0; i < batch->rows_len; ++i) {
+        pos += batch->rows[i].num_pulses;
+        arrow_put(p + 4 * (i + 1), pos, 4);
+    }
+}
+
+/// Encode and write a record batch.
+static void arrow_write_batch(pulse_arrow_t *w, arrow_batch_t const *batch)
+{
+    unsigned n         = batch->rows_len;
+    size_t m           = batch->pulses_len;
+    arrow_body_t *body = &w->body;
+    arrow_body_reset(body);
+
+    // the buffers of the columns in schema order, no validity bitmaps
+    for (unsigned c = 0; c < NUM_COLUMNS; ++c) {
+        arrow_body_node(body, n, 0);
+        arrow_body_buffer(body, 0); // validity
+        uint8_t *p;
+        switch (columns[c].type) {
+        case ARROW_INT64:
+            if ((p = arrow_body_buffer(body, n * 8)))
+                for (unsigned i = 0; i < n; ++i)
+                    arrow_put(p + 8 * i, batch->rows[i].offset, 8);
+            break;
+        case ARROW_INT32:
+            if ((p = arrow_body_buffer(body, n * 4)))
+                for (unsigned i = 0; i < n; ++i)
+                    arrow_put(p + 4 * i, c == 1 ? batch->rows[i].sample_rate : (uint32_t)batch->rows[i].events, 4);
+            break;
+        case ARROW_FLOAT32:
+            if ((p = arrow_body_buffer(body, n * 4)))
+                for (unsigned i = 0; i < n; ++i) {
+                    arrow_row_t const *r = &batch->rows[i];
+                    float const v[]      = {r->freq, r->freq1, r->freq2, r->rssi, r->snr, r->noise};
+                    uint32_t bits;
+                    memcpy(&bits, &v[c - 3], sizeof(bits));
+                    arrow_put(p + 4 * i, bits, 4);
+                }
+            break;
+        case ARROW_UTF8:
+            if ((p = arrow_body_buffer(body, (n + 1) * 4)))
+                for (unsigned i = 0; i <= n; ++i)
+                    arrow_put(p + 4 * i, 3 * i, 4);
+            if ((p = arrow_body_buffer(body, n * 3)))
+                for (unsigned i = 0; i < n; ++i)
+                    memcpy(p + 3 * i, batch->rows[i].fsk ? "FSK" : "OOK", 3);
+            break;
+        case ARROW_LIST_INT32: {
+            int32_t const *widths = c == NUM_COLUMNS - 2 ? batch->pulses : batch->gaps;
+            if ((p = arrow_body_buffer(body, (n + 1) * 4)))
+                put_offsets(p, batch);
+            arrow_body_node(body, m, 0);
+            arrow_body_buffer(body, 0); // validity of the items
+            if ((p = arrow_body_buffer(body, m * 4)))
+                for (size_t i = 0; i < m; ++i)
+                    arrow_put(p + 4 * i, (uint32_t)widths[i], 4);
+        } break;
+        default:
+            break;
+        }
+    }
+
+    arrow_ipc_write_batch(w->ipc, n, body);
+}
+
+static arrow_batch_t *arrow_batch_create(void)
+{
+    arrow_batch_t *batch = calloc(1, sizeof(*batch));
+    if (!batch) {
+        WARN_CALLOC("arrow_batch_create()");
+        return NULL;
+    }
+    batch->rows = malloc(PULSE_ARROW_BATCH_ROWS * sizeof(*batch->rows));
+    if (!batch->rows) {
+        WARN_MALLOC("arrow_batch_create()");
+        free(batch);
+        return NULL;
+    }
+    batch->rows_size = PULSE_ARROW_BATCH_ROWS;
+    return batch;
+}
+
+static void arrow_batch_free(arrow_batch_t *batch)
+{
+    if (!batch)
+        return;
+    free(batch->rows);
+    free(batch->pulses);
+    free(batch->gaps);
+    free(batch);
+}
+
+/* writer thread */
+
+#ifdef THREADS
+static THREAD_RETURN THREAD_CALL arrow_thread(void *arg)
+{
+    pulse_arrow_t *w = arg;
+    thread_pin_self(THREAD_OUTPUT);
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->pending && !w->exit) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (!w->pending)
+            break; // exit with all batches written
+        arrow_batch_t *batch = w->pending;
+        pthread_mutex_unlock(&w->lock);
+
+        arrow_write_batch(w, batch);
+        batch->rows_len   = 0;
+        batch->pulses_len = 0;
+
+        pthread_mutex_lock(&w->lock);
+        w->pending = NULL;
+        w->spare   = batch;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return (THREAD_RETURN)0;
+}
+#endif
+
+/// Hand the filled batch to the writer, waits while the previous batch is written.
+static void arrow_submit(pulse_arrow_t *w)
+{
+    if (!w->fill || !w->fill->rows_len)
+        return;
+#ifdef THREADS
+    if (w->started) {
+        pthread_mutex_lock(&w->lock);
+        while (w->pending) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        w->pending = w->fill;
+        w->fill    = w->spare;
+        w->spare   = NULL;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+        if (!w->fill)
+            w->fill = arrow_batch_create();
+        return;
+    }
+#endif
+    arrow_write_batch(w, w->fill);
+    w->fill->rows_len   = 0;
+    w->fill->pulses_len = 0;
+}
+
+pulse_arrow_t *pulse_arrow_create(FILE *file)
+{
+    pulse_arrow_t *w = calloc(1, sizeof(*w));
+    if (!w) {
+        WARN_CALLOC("pulse_arrow_create()");
+        return NULL;
+    }
+    w->fill = arrow_batch_create();
+    if (!w->fill) {
+        free(w);
+        return NULL;
+    }
+    w->ipc = arrow_ipc_create(file, columns, NUM_COLUMNS);
+    if (!w->ipc) {
+        arrow_batch_free(w->fill);
+        free(w);
+        return NULL;
+    }
+
+#ifdef THREADS
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    w->started = !pthread_create(&w->thread, NULL, arrow_thread, w);
+    if (!w->started)
+        fprintf(stderr, "%s: failed to start thread, writing the batches in turn\n", __func__);
+#endif
+    return w;
+}
+
+void pulse_arrow_add(pulse_arrow_t *w, pulse_data_t const *data, int events)
+{
+    arrow_batch_t *b = w->fill;
+    if (!b)
+        return;
+    if (b->pulses_len + data->num_pulses > b->pulses_size) {
+        size_t size = b->pulses_size ? b->pulses_size : PULSE_ARROW_BATCH_PULSES / 16;
+        while (b->pulses_len + data->num_pulses > size)
+            size *= 2;
+        int32_t *pulses = realloc(b->pulses, size * sizeof(*pulses));
+        if (!pulses) {
+            WARN_REALLOC("pulse_arrow_add()");
+            return;
+        }
+        b->pulses = pulses;
+        int32_t *gaps = realloc(b->gaps, size * sizeof(*gaps));
+        if (!gaps) {
+            WARN_REALLOC("pulse_arrow_add()");
+            return;
+        }
+        b->gaps        = gaps;
+        b->pulses_size = size;
+    }
+
+    b->rows[b->rows_len++] = (arrow_row_t){
+            .offset      = data->offset,
+            .sample_rate = data->sample_rate,
+            .fsk         = data->fsk_f2_est != 0,
+            .freq        = data->centerfreq_hz,
+            .freq1       = data->freq1_hz,
+            .freq2       = data->fsk_f2_est ? data->freq2_hz : 0.0f,
+            .rssi        = data->rssi_db,
+            .snr         = data->snr_db,
+            .noise       = data->noise_db,
+            .events      = events,
+            .num_pulses  = data->num_pulses,
+    };
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        b->pulses[b->pulses_len + i] = data->pulse[i];
+        b->gaps[b->pulses_len + i]   = data->gap[i];
+    }
+    b->pulses_len += data->num_pulses;
+
+    if (b->rows_len >= b->rows_size || b->pulses_len >= PULSE_ARROW_BATCH_PULSES)
+        arrow_submit(w);
+}
+
+int pulse_arrow_close(pulse_arrow_t *w)
+{
+    if (!w)
+        return 0;
+    arrow_submit(w);
+#ifdef THREADS
+    if (w->started) {
+        pthread_mutex_lock(&w->lock);
+        w->exit = 1;
+        pthread_cond_broadcast(&w->cond);
+        pthread_mutex_unlock(&w->lock);
+        pthread_join(w->thread, NULL);
+    }
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+    arrow_batch_free(w->pending);
+    arrow_batch_free(w->spare);
+#endif
+
+    int ret = arrow_ipc_close(w->ipc);
+    arrow_body_free(&w->body);
+    arrow_batch_free(w->fill);
+    free(w);
+    return ret;
+}
@@ -0,0 +1,321 @@
+/** @file
+    Binary pulse data format, a compact and fast to parse container of pulse_data_t.
+
+    The file starts with the magic "rtl433pb", a version, and the sample rate.
+    Each package is then the number of pulses, the sample rate,
+    the offset, the depth bits, the level and frequency estimates, the float stats
+    as little-endian IEEE 754 bits, and the pulse and gap widths in samples.
+    All integers are LEB128 varints, signed integers are zig-zag encoded.
+    Unlike the OOK text format the widths are kept in samples, nothing is rounded.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "pulse_bin.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define PULSE_BIN_MAGIC "rtl433pb"
+#define PULSE_BIN_VERSION 1
+
+/// Longest encoded header.
+#define PULSE_BIN_MAX_HEADER (8 + 2 * 10)
+/// Longest encoded package head, all varints at their maximum length.
+#define PULSE_BIN_MAX_HEAD (9 * 10 + 7 * 4)
+
+static void put_varint(uint8_t **p, uint64_t val)
+{
+    while (val >= 0x80) {
+        *(*p)++ = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    *(*p)++ = (uint8_t)val;
+}
+
+static void put_svarint(uint8_t **p, int64_t val)
+{
+    put_varint(p, ((uint64_t)val << 1) ^ (uint64_t)(val >> 63)); // zig-zag
+}
+
+static void put_float(uint8_t **p, float val)
+{
+    uint32_t bits;
+    memcpy(&bits, &val, sizeof(bits));
+    for (int i = 0; i < 4; ++i) {
+        *(*p)++ = (uint8_t)(bits >> (i * 8));
+    }
+}
+
+/// A parse position, a truncated value sets the error flag.
+typedef struct {
+    uint8_t const *p;
+    uint8_t const *end;
+    int truncated;
+} cursor_t;
+
+static uint64_t get_varint(cursor_t *c)
+{
+    uint64_t val = 0;
+    for (unsigned shift = 0; c->p < c->end && shift < 64; shift += 7) {
+        uint8_t b = *c->p++;
+        val |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+            return val;
+    }
+    c->truncated = 1;
+    return 0;
+}
+
+static int64_t get_svarint(cursor_t *c)
+{
+    uint64_t val = get_varint(c);
+    return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+static float get_float(cursor_t *c)
+{
+    if (c->end - c->p < 4) {
+        c->truncated = 1;
+        return 0.0f;
+    }
+    uint32_t bits = 0;
+    for (int i = 0; i < 4; ++i) {
+        bits |= (uint32_t)*c->p++ << (i * 8);
+    }
+    float val;
+    memcpy(&val, &bits, sizeof(val));
+    return val;
+}
+
+static void write_bytes(FILE *file, uint8_t const *buf, size_t len)
+{
+    if (fwrite(buf, 1, len, file) != len) {
+        perror("File output error");
+        exit(1);
+    }
+}
+
+static void put_header(uint8_t **p, uint32_t sample_rate)
+{
+    memcpy(*p, PULSE_BIN_MAGIC, 8);
+    *p += 8;
+    put_varint(p, PULSE_BIN_VERSION);
+    put_varint(p, sample_rate);
+}
+
+/// Put the package head, everything but the pulse and gap widths.
+static void put_head(uint8_t **p, pulse_data_t const *data)
+{
+    put_varint(p, data->num_pulses);
+    put_varint(p, data->sample_rate);
+    put_varint(p, data->offset);
+    put_varint(p, data->depth_bits);
+    put_svarint(p, data->ook_low_estimate);
+    put_svarint(p, data->ook_high_estimate);
+    put_svarint(p, data->fsk_f1_est);
+    put_svarint(p, data->fsk_f2_est);
+    put_float(p, data->freq1_hz);
+    put_float(p, data->freq2_hz);
+    put_float(p, data->centerfreq_hz);
+    put_float(p, data->range_db);
+    put_float(p, data->rssi_db);
+    put_float(p, data->snr_db);
+    put_float(p, data->noise_db);
+}
+
+void pulse_bin_print_header(FILE *file, uint32_t sample_rate)
+{
+    uint8_t buf[PULSE_BIN_MAX_HEADER];
+    uint8_t *p = buf;
+    put_header(&p, sample_rate);
+    write_bytes(file, buf, p - buf);
+}
+
+void pulse_bin_dump(FILE *file, pulse_data_t const *data)
+{
+    if (!data->num_pulses)
+        return; // a zero count is the end of the file
+
+    uint8_t head[PULSE_BIN_MAX_HEAD];
+    uint8_t *p = head;
+    put_head(&p, data);
+    write_bytes(file, head, p - head);
+
+    uint8_t buf[256];
+    p = buf;
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        if (p - buf > (int)sizeof(buf) - 2 * 10) {
+            write_bytes(file, buf, p - buf);
+            p = buf;
+        }
+        put_svarint(&p, data->pulse[i]);
+        put_svarint(&p, data->gap[i]);
+    }
+    write_bytes(file, buf, p - buf);
+}
+
+size_t pulse_bin_encode(uint8_t *buf, size_t size, uint32_t sample_rate, pulse_data_t const *data)
+{
+    if (!data->num_pulses || size < PULSE_BIN_MAX_HEADER + PULSE_BIN_MAX_HEAD)
+        return 0;
+
+    uint8_t *p = buf;
+    put_header(&p, sample_rate);
+    size_t len = pulse_bin_encode_package(p, buf + size - p, data);
+    return len ? p - buf + len : 0;
+}
+
+size_t pulse_bin_encode_package(uint8_t *buf, size_t size, pulse_data_t const *data)
+{
+    if (!data->num_pulses || size < PULSE_BIN_MAX_HEAD)
+        return 0;
+
+    uint8_t *p = buf;
+    put_head(&p, data);
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        if (buf + size - p < 2 * 10)
+            return 0; // does not fit
+        put_svarint(&p, data->pulse[i]);
+        put_svarint(&p, data->gap[i]);
+    }
+    return p - buf;
+}
+
+/// Parse a package, the sample rate is the default for a package without one.
+static int get_package(cursor_t *c, pulse_data_t *data, uint32_t sample_rate)
+{
+    uint64_t num_pulses = get_varint(c);
+    if (num_pulses == 0 || num_pulses > PD_MAX_PULSES || pulse_data_reserve(data, (unsigned)num_pulses))
+        return -1;
+    data->sample_rate       = (uint32_t)get_varint(c);
+    data->offset            = get_varint(c);
+    data->depth_bits        = (unsigned)get_varint(c);
+    data->ook_low_estimate  = (int)get_svarint(c);
+    data->ook_high_estimate = (int)get_svarint(c);
+    data->fsk_f1_est        = (int)get_svarint(c);
+    data->fsk_f2_est        = (int)get_svarint(c);
+    data->freq1_hz          = get_float(c);
+    data->freq2_hz          = get_float(c);
+    data->centerfreq_hz     = get_float(c);
+    data->range_db          = get_float(c);
+    data->rssi_db           = get_float(c);
+    data->snr_db            = get_float(c);
+    data->noise_db          = get_float(c);
+    for (unsigned i = 0; i < num_pulses; ++i) {
+        data->pulse[i] = (int)get_svarint(c);
+        data->gap[i]   = (int)get_svarint(c);
+    }
+    if (c->truncated)
+        return -1;
+    if (!data->sample_rate)
+        data->sample_rate = sample_rate;
+    data->num_pulses = (unsigned)num_pulses;
+    return 1;
+}
+
+/// Parse the header, returns the version or 0 if not a binary pulse data header.
+static uint64_t get_header(cursor_t *c, uint32_t *sample_rate)
+{
+    if (c->end - c->p < 8 || memcmp(c->p, PULSE_BIN_MAGIC, 8))
+        return 0;
+    c->p += 8;
+    uint64_t version = get_varint(c);
+    *sample_rate     = (uint32_t)get_varint(c);
+    return c->truncated ? 0 : version;
+}
+
+int pulse_bin_decode(uint8_t const *buf, size_t len, pulse_data_t *data)
+{
+    pulse_data_clear(data);
+    cursor_t c           = {buf, buf + len, 0};
+    uint32_t sample_rate = 0;
+    if (get_header(&c, &sample_rate) != PULSE_BIN_VERSION)
+        return -1;
+    if (get_package(&c, data, sample_rate) < 0 || c.p != c.end) {
+        pulse_data_clear(data);
+        return -1;
+    }
+    return 0;
+}
+
+int pulse_bin_decode_package(uint8_t const *buf, size_t len, uint32_t sample_rate, pulse_data_t *data)
+{
+    pulse_data_clear(data);
+    cursor_t c = {buf, buf + len, 0};
+    if (get_package(&c, data, sample_rate) < 0 || c.p != c.end) {
+        pulse_data_clear(data);
+        return -1;
+    }
+    return 0;
+}
+
+/// Keep at least a full package in the read buffer, if the file is not mapped.
+static void pulse_bin_fill(pulse_bin_reader_t *reader)
+{
+    if (reader->reader.map)
+        return;
+    size_t left = reader->end - reader->pos;
+    if (left >= PULSE_BIN_MAX_PACKAGE)
+        return;
+    memmove(reader->buf, reader->pos, left);
+    size_t n = fread(reader->buf + left, 1, 2 * PULSE_BIN_MAX_PACKAGE - left, reader->reader.file);
+    reader->pos = reader->buf;
+    reader->end = reader->buf + left + n;
+}
+
+int pulse_bin_reader_open(pulse_bin_reader_t *reader, FILE *file)
+{
+    memset(reader, 0, sizeof(*reader));
+    sample_reader_open(&reader->reader, file);
+    if (reader->reader.map) {
+        reader->pos = reader->reader.map + reader->reader.map_pos;
+        reader->end = reader->reader.map + reader->reader.map_size;
+    }
+    else {
+        reader->buf = malloc(2 * PULSE_BIN_MAX_PACKAGE);
+        if (!reader->buf) {
+            WARN_MALLOC("pulse_bin_reader_open()");
+            return -1;
+        }
+        reader->pos = reader->end = reader->buf;
+        pulse_bin_fill(reader);
+    }
+
+    if (reader->end - reader->pos < 8 || memcmp(reader->pos, PULSE_BIN_MAGIC, 8)) {
+        fprintf(stderr, "Not a binary pulse data file\n");
+        return -1;
+    }
+    cursor_t c = {reader->pos, reader->end, 0};
+    if (get_header(&c, &reader->sample_rate) != PULSE_BIN_VERSION) {
+        fprintf(stderr, "Unsupported binary pulse data version\n");
+        return -1;
+    }
+    reader->pos = c.p;
+    return 0;
+}
+
+int pulse_bin_load(pulse_bin_reader_t *reader, pulse_data_t *data)
+{
+    pulse_data_clear(data);
+    pulse_bin_fill(reader);
+    if (reader->pos >= reader->end)
+        return 0; // end of the file
+
+    cursor_t c = {reader->pos, reader->end, 0};
+    if (get_package(&c, data, reader->sample_rate) < 0)
+        return -1;
+    reader->pos = c.p;
+    return 1;
+}
+
+void pulse_bin_reader_close(pulse_bin_reader_t *reader)
+{
+    sample_reader_close(&reader->reader);
+    free(reader->buf);
+    reader->buf = NULL;
+}
@@ -13,20 +13,102 @@
 #include "pulse_data.h"
 #include "rfraw.h"
 #include "r_util.h"
+#include "fatal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 void pulse_data_clear(pulse_data_t *data)
 {
+    int *pulse          = data->pulse;
+    int *gap            = data->gap;
+    unsigned max_pulses = data->max_pulses;
+
+    // zero the used part of the storage, the state machines expect e.g. an initial zero pulse
+    unsigned used = data->num_pulses + 2 < max_pulses ? data->num_pulses + 2 : max_pulses;
+    if (used) {
+        memset(pulse, 0, used * sizeof(*pulse));
+        memset(gap, 0, used * sizeof(*gap));
+    }
+
+    *data = (pulse_data_t const){0};
+
+    data->pulse      = pulse;
+    data->gap        = gap;
+    data->max_pulses = max_pulses;
+}
+
+void pulse_data_free(pulse_data_t *data)
+{
+    free(data->pulse);
+    free(data->gap);
     *data = (pulse_data_t const){0};
 }
 
+size_t pulse_data_memory(pulse_data_t const *data)
+{
+    return data->max_pulses * (sizeof(*data->pulse) + sizeof(*data->gap));
+}
+
+int pulse_data_reserve(pulse_data_t *data, unsigned num_pulses)
+{
+    if (num_pulses <= data->max_pulses)
+        return 0;
+    if (num_pulses > PD_MAX_PULSES)
+        return -1;
+
+    unsigned size = data->max_pulses ? data->max_pulses : PD_INIT_PULSES;
+    while (size < num_pulses)
+        size *= 2;
+    if (size > PD_MAX_PULSES)
+        size = PD_MAX_PULSES;
+
+    int *pulse = realloc(data->pulse, size * sizeof(*data->pulse));
+    if (!pulse) {
+        WARN_REALLOC("pulse_data_reserve()");
+        return -1;
+    }
+    data->pulse = pulse;
+    int *gap = realloc(data->gap, size * sizeof(*data->gap));
+    if (!gap) {
+        WARN_REALLOC("pulse_data_reserve()");
+        return -1;
+    }
+    data->gap = gap;
+    // new storage is zeroed, as if cleared
+    memset(&data->pulse[data->max_pulses], 0, (size - data->max_pulses) * sizeof(*data->pulse));
+    memset(&data->gap[data->max_pulses], 0, (size - data->max_pulses) * sizeof(*data->gap));
+    data->max_pulses = size;
+    return 0;
+}
+
+/// Quantize a width to its 4 leading bits.
+static uint32_t quantize_width(int width)
+{
+    uint32_t w = width > 0 ? width : 0;
+    unsigned shift = 0;
+    while (w >> shift > 15)
+        shift++;
+    return (w >> shift) | shift << 4;
+}
+
+uint32_t pulse_data_fingerprint(pulse_data_t const *data)
+{
+    uint32_t hash = 2166136261u; // FNV-1a
+    hash = (hash ^ data->num_pulses) * 16777619u;
+    for (unsigned n = 0; n < data->num_pulses; ++n) {
+        hash = (hash ^ quantize_width(data->pulse[n])) * 16777619u;
+        if (n + 1 < data->num_pulses)
+            hash = (hash ^ quantize_width(data->gap[n])) * 16777619u;
+    }
+    return hash;
+}
+
 void pulse_data_shift(pulse_data_t *data)
 {
-    int offs = PD_MAX_PULSES / 2; // shift out half the data
-    memmove(data->pulse, &data->pulse[offs], (PD_MAX_PULSES - offs) * sizeof(*data->pulse));
-    memmove(data->gap, &data->gap[offs], (PD_MAX_PULSES - offs) * sizeof(*data->gap));
+    int offs = data->num_pulses / 2; // shift out half the data
+    memmove(data->pulse, &data->pulse[offs], (data->num_pulses - offs) * sizeof(*data->pulse));
+    memmove(data->gap, &data->gap[offs], (data->num_pulses - offs) * sizeof(*data->gap));
     data->num_pulses -= offs;
     data->offset += offs;
 }
@@ -93,38 +175,87 @@ void pulse_data_print_vcd_header(FILE *file, uint32_t sample_rate)
     chk_ret(fprintf(file, "#0 0/ 0' 0\"\n"));
 }
 
+/// Append a decimal number, without a formatted print.
+static char *vcd_put_uint(char *p, uint64_t v)
+{
+    char tmp[20];
+    unsigned n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (n)
+        *p++ = tmp[--n];
+    return p;
+}
+
+/// Append a line of value changes "#<time> <value><id>[ <value><id>]".
+static char *vcd_put_change(char *p, uint64_t time, char v1, int id1, char v2, int id2)
+{
+    *p++ = '#';
+    p    = vcd_put_uint(p, time);
+    *p++ = ' ';
+    *p++ = v1;
+    *p++ = (char)id1;
+    if (id2) {
+        *p++ = ' ';
+        *p++ = v2;
+        *p++ = (char)id2;
+    }
+    *p++ = '\n';
+    return p;
+}
+
+static void vcd_write(FILE *file, char const *buf, size_t len)
+{
+    if (len && fwrite(buf, 1, len, file) != len) {
+        perror("File output error");
+        exit(1);
+    }
+}
+
 void pulse_data_print_vcd(FILE *file, pulse_data_t const *data, int ch_id)
 {
-    float scale;
+    // the scale is a whole number of time units per sample
+    uint64_t scale;
     if (data->sample_rate <= 500000)
         scale = 1000000 / data->sample_rate; // unit: 1 us
     else
         scale = 10000000 / data->sample_rate; // unit: 100 ns
+
+    // format into blocks, a line is at most 30 chars
+    char buf[VCD_BLOCK_SIZE];
+    char *end    = buf + sizeof(buf) - 2 * 32;
+    char *p      = buf;
     uint64_t pos = data->offset;
     for (unsigned n = 0; n < data->num_pulses; ++n) {
         if (n == 0)
-            chk_ret(fprintf(file, "#%.f 1/ 1%c\n", pos * scale, ch_id));
+            p = vcd_put_change(p, pos * scale, '1', '/', '1', ch_id);
         else
-            chk_ret(fprintf(file, "#%.f 1%c\n", pos * scale, ch_id));
+            p = vcd_put_change(p, pos * scale, '1', ch_id, 0, 0);
         pos += data->pulse[n];
-        chk_ret(fprintf(file, "#%.f 0%c\n", pos * scale, ch_id));
+        p = vcd_put_change(p, pos * scale, '0', ch_id, 0, 0);
         pos += data->gap[n];
+        if (p >= end) {
+            vcd_write(file, buf, (size_t)(p - buf));
+            p = buf;
+        }
     }
     if (data->num_pulses > 0)
-        chk_ret(fprintf(file, "#%.f 0/\n", pos * scale));
+        p = vcd_put_change(p, pos * scale, '0', '/', 0, 0);
+    vcd_write(file, buf, (size_t)(p - buf));
 }
 
 void pulse_data_load(FILE *file, pulse_data_t *data, uint32_t sample_rate)
 {
     char s[1024];
-    int i    = 0;
-    int size = sizeof(data->pulse) / sizeof(*data->pulse);
+    unsigned i = 0;
 
     pulse_data_clear(data);
     data->sample_rate = sample_rate;
     double to_sample  = sample_rate / 1e6;
     // read line-by-line
-    while (i < size && fgets(s, sizeof(s), file)) {
+    while (fgets(s, sizeof(s), file)) {
         // TODO: we should parse sample rate and timescale
         if (!strncmp(s, ";freq1", 6)) {
             data->freq1_hz = strtol(s + 6, NULL, 10);
@@ -152,6 +283,9 @@ void pulse_data_load(FILE *file, pulse_data_t *data, uint32_t sample_rate)
         p          = endptr + 1;
         long space = strtol(p, &endptr, 10);
         // fprintf(stderr, "read: mark %ld space %ld\n", mark, space);
+        if (pulse_data_reserve(data, i + 1)) {
+            break; // too many pulses
+        }
         data->pulse[i] = (int)(to_sample * mark);
         data->gap[i++] = (int)(to_sample * space);
     }
@@ -199,20 +333,11 @@ void pulse_data_dump(FILE *file, pulse_data_t *data)
     chk_ret(fprintf(file, ";end\n"));
 }
 
-data_t *pulse_data_print_data(pulse_data_t *data)
+/// The meta data of the raw pulse outputs.
+static data_t *pulse_data_meta(pulse_data_t const *data)
 {
-    int pulses[2 * PD_MAX_PULSES];
-    double to_us = 1e6 / data->sample_rate;
-    for (unsigned i = 0; i < data->num_pulses; ++i) {
-        pulses[i * 2 + 0] = data->pulse[i] * to_us;
-        pulses[i * 2 + 1] = data->gap[i] * to_us;
-    }
-
     /* clang-format off */
     return data_make(
-            "mod",              "", DATA_STRING, (data->fsk_f2_est) ? "FSK" : "OOK",
-            "count",            "", DATA_INT,    data->num_pulses,
-            "pulses",           "", DATA_ARRAY,  data_array(2 * data->num_pulses, DATA_INT, pulses),
             "freq1_Hz",         "", DATA_FORMAT, "%u Hz", DATA_INT, (unsigned)data->freq1_hz,
             "freq2_Hz",         "", DATA_COND,   data->fsk_f2_est, DATA_FORMAT, "%u Hz", DATA_INT, (unsigned)data->freq2_hz,
             "freq_Hz",          "", DATA_INT,    (unsigned)data->centerfreq_hz,
@@ -225,3 +350,48 @@ data_t *pulse_data_print_data(pulse_data_t *data)
             NULL);
     /* clang-format on */
 }
+
+data_t *pulse_data_print_data(pulse_data_t *data)
+{
+    int *pulses = malloc(2 * data->num_pulses * sizeof(*pulses) + 1); // never zero size
+    if (!pulses) {
+        WARN_MALLOC("pulse_data_print_data()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    double to_us = 1e6 / data->sample_rate;
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        pulses[i * 2 + 0] = data->pulse[i] * to_us;
+        pulses[i * 2 + 1] = data->gap[i] * to_us;
+    }
+
+    /* clang-format off */
+    data_t *out = data_prepend(pulse_data_meta(data),
+            "mod",              "", DATA_STRING, (data->fsk_f2_est) ? "FSK" : "OOK",
+            "count",            "", DATA_INT,    data->num_pulses,
+            "pulses",           "", DATA_ARRAY,  data_array(2 * data->num_pulses, DATA_INT, pulses),
+            NULL);
+    /* clang-format on */
+    free(pulses);
+    return out;
+}
+
+data_t *pulse_data_print_rfraw(pulse_data_t const *data)
+{
+    size_t size = RFRAW_FORMAT_SIZE(data->num_pulses);
+    char *rfraw = malloc(size);
+    if (!rfraw) {
+        WARN_MALLOC("pulse_data_print_rfraw()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    rfraw_format(data, rfraw, size);
+
+    /* clang-format off */
+    data_t *out = data_prepend(pulse_data_meta(data),
+            "mod",              "", DATA_STRING, (data->fsk_f2_est) ? "FSK" : "OOK",
+            "count",            "", DATA_INT,    data->num_pulses,
+            "rfraw",            "", DATA_STRING, rfraw,
+            NULL);
+    /* clang-format on */
+    free(rfraw);
+    return out;
+}
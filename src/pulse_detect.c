@@ -24,6 +24,9 @@
 #define OOK_MAX_LOW_LEVEL   DB_TO_AMP(-15) // Maximum estimate for low level
 #define OOK_EST_HIGH_RATIO  64          // Constant for slowness of OOK high level estimator
 #define OOK_EST_LOW_RATIO   1024        // Constant for slowness of OOK low level (noise) estimator (very slow)
+#define OOK_GATE_BLOCK      4096        // Block size for skipping silent blocks while idle
+#define OOK_GATE_STRIDE     8           // Noise estimator decimation on skipped blocks
+#define OOK_SEARCH_BLOCK_8  32          // Block size for the search on the 8-bit envelope
 
 /// Internal state data for pulse_pulse_package()
 struct pulse_detect {
@@ -31,6 +34,8 @@ struct pulse_detect {
     int ook_fixed_high_level; ///< Manual detection level override, 0 = auto.
     int ook_min_high_level;   ///< Minimum estimate of high level (-12 dB: 1000 amp, 4000 mag).
     int ook_high_low_ratio;   ///< Default ratio between high and low (noise) level (9 dB: x8 amp, 11 dB: x3.6 mag).
+    float min_high_level_db;  ///< The minimum high level as set, for the extra detectors.
+    float high_low_ratio_db;  ///< The ratio as set, for the extra detectors.
 
     enum {
         PD_OOK_STATE_IDLE      = 0,
@@ -49,7 +54,19 @@ struct pulse_detect {
 
     int verbosity; ///< Debug output verbosity, 0=None, 1=Levels, 2=Histograms
 
+    uint8_t const *envelope_8bit; ///< The 8-bit envelope of the samples, NULL to search the envelope.
+
     pulse_detect_fsk_t pulse_detect_fsk;
+
+    int fsk_alt;                          ///< Also run the other FSK detector on the same FM data.
+    pulse_detect_fsk_t pulse_detect_fsk_alt; ///< State of the other FSK detector.
+    pulse_data_t fsk_alt_pulses;          ///< Pulse train from the other FSK detector.
+
+    unsigned extra_count;                                  ///< Detectors at extra fixed levels, see -Y levels.
+    float extra_level[PULSE_DETECT_EXTRA_LEVELS];          ///< The extra levels in dB.
+    pulse_detect_t *extra[PULSE_DETECT_EXTRA_LEVELS];      ///< The detectors at the extra levels.
+    pulse_data_t extra_pulses[PULSE_DETECT_EXTRA_LEVELS];  ///< OOK pulse trains at the extra levels.
+    pulse_data_t extra_fsk_pulses[PULSE_DETECT_EXTRA_LEVELS]; ///< FSK pulse trains at the extra levels.
 };
 
 pulse_detect_t *pulse_detect_create(void)
@@ -67,9 +84,30 @@ pulse_detect_t *pulse_detect_create(void)
 
 void pulse_detect_free(pulse_detect_t *pulse_detect)
 {
+    if (!pulse_detect)
+        return;
+    pulse_data_free(&pulse_detect->fsk_alt_pulses);
+    for (unsigned i = 0; i < PULSE_DETECT_EXTRA_LEVELS; ++i) {
+        pulse_detect_free(pulse_detect->extra[i]);
+        pulse_data_free(&pulse_detect->extra_pulses[i]);
+        pulse_data_free(&pulse_detect->extra_fsk_pulses[i]);
+    }
     free(pulse_detect);
 }
 
+size_t pulse_detect_memory(pulse_detect_t const *pulse_detect)
+{
+    if (!pulse_detect)
+        return 0;
+    size_t bytes = sizeof(*pulse_detect) + pulse_data_memory(&pulse_detect->fsk_alt_pulses);
+    for (unsigned i = 0; i < PULSE_DETECT_EXTRA_LEVELS; ++i) {
+        bytes += pulse_detect_memory(pulse_detect->extra[i]);
+        bytes += pulse_data_memory(&pulse_detect->extra_pulses[i]);
+        bytes += pulse_data_memory(&pulse_detect->extra_fsk_pulses[i]);
+    }
+    return bytes;
+}
+
 void pulse_detect_set_levels(pulse_detect_t *pulse_detect, int use_mag_est, float fixed_high_level, float min_high_level, float high_low_ratio, int verbosity)
 {
     pulse_detect->use_mag_est = use_mag_est;
@@ -84,13 +122,141 @@ void pulse_detect_set_levels(pulse_detect_t *pulse_detect, int use_mag_est, floa
         pulse_detect->ook_high_low_ratio = DB_TO_AMP_F(high_low_ratio);
     }
     pulse_detect->verbosity = verbosity;
+    pulse_detect->min_high_level_db = min_high_level;
+    pulse_detect->high_low_ratio_db = high_low_ratio;
 
+    // the extra detectors follow the settings, with their own fixed level and no debug output
+    for (unsigned i = 0; i < pulse_detect->extra_count; ++i) {
+        pulse_detect_set_levels(pulse_detect->extra[i], use_mag_est, pulse_detect->extra_level[i], min_high_level, high_low_ratio, 0);
+    }
     //fprintf(stderr, "fixed_high_level %.1f (%d), min_high_level %.1f (%d), high_low_ratio %.1f (%d)\n",
     //        fixed_high_level, pulse_detect->ook_fixed_high_level,
     //        min_high_level, pulse_detect->ook_min_high_level,
     //        high_low_ratio, pulse_detect->ook_high_low_ratio);
 }
 
+void pulse_detect_reset(pulse_detect_t *pulse_detect)
+{
+    pulse_detect->ook_state    = PD_OOK_STATE_IDLE;
+    pulse_detect->pulse_length = 0;
+    pulse_detect->max_pulse    = 0;
+    pulse_detect->data_counter = 0;
+    pulse_data_clear(&pulse_detect->fsk_alt_pulses);
+    for (unsigned i = 0; i < pulse_detect->extra_count; ++i) {
+        pulse_detect_reset(pulse_detect->extra[i]);
+        pulse_data_clear(&pulse_detect->extra_pulses[i]);
+        pulse_data_clear(&pulse_detect->extra_fsk_pulses[i]);
+    }
+}
+
+int pulse_detect_get_state(pulse_detect_t const *pulse_detect, pulse_detect_state_t *state)
+{
+    pulse_detect_t const *detectors[1 + PULSE_DETECT_EXTRA_LEVELS] = {pulse_detect};
+    for (unsigned i = 0; i < pulse_detect->extra_count; ++i)
+        detectors[1 + i] = pulse_detect->extra[i];
+
+    *state = (pulse_detect_state_t){0};
+    for (unsigned i = 0; i < 1 + pulse_detect->extra_count; ++i) {
+        pulse_detect_t const *s = detectors[i];
+        if (s->ook_state != PD_OOK_STATE_IDLE || s->data_counter)
+            return -1; // a package in progress or a buffer not fully processed
+        pulse_detect_levels_t *levels = i ? &state->extra[i - 1] : &state->levels;
+        levels->ook_low_estimate      = s->ook_low_estimate;
+        levels->ook_high_estimate     = s->ook_high_estimate;
+        levels->lead_in_counter       = s->lead_in_counter;
+    }
+    state->fsk     = pulse_detect->pulse_detect_fsk;
+    state->fsk_alt = pulse_detect->pulse_detect_fsk_alt;
+    return 0;
+}
+
+void pulse_detect_set_state(pulse_detect_t *pulse_detect, pulse_detect_state_t const *state)
+{
+    pulse_detect_reset(pulse_detect);
+    for (unsigned i = 0; i < 1 + pulse_detect->extra_count; ++i) {
+        pulse_detect_t *s                   = i ? pulse_detect->extra[i - 1] : pulse_detect;
+        pulse_detect_levels_t const *levels = i ? &state->extra[i - 1] : &state->levels;
+        s->ook_low_estimate                 = levels->ook_low_estimate;
+        s->ook_high_estimate                = levels->ook_high_estimate;
+        s->lead_in_counter                  = levels->lead_in_counter;
+    }
+    pulse_detect->pulse_detect_fsk     = state->fsk;
+    pulse_detect->pulse_detect_fsk_alt = state->fsk_alt;
+}
+
+void pulse_detect_set_fsk_alt(pulse_detect_t *pulse_detect, int enable)
+{
+    pulse_detect->fsk_alt = enable;
+}
+
+pulse_data_t *pulse_detect_fsk_alt_pulses(pulse_detect_t *pulse_detect)
+{
+    return pulse_detect->fsk_alt ? &pulse_detect->fsk_alt_pulses : NULL;
+}
+
+int pulse_detect_set_extra_levels(pulse_detect_t *pulse_detect, float const *levels, unsigned num)
+{
+    if (num > PULSE_DETECT_EXTRA_LEVELS)
+        num = PULSE_DETECT_EXTRA_LEVELS;
+    for (unsigned i = 0; i < num; ++i) {
+        if (!pulse_detect->extra[i]) {
+            pulse_detect->extra[i] = pulse_detect_create();
+            if (!pulse_detect->extra[i]) {
+                pulse_detect->extra_count = i;
+                return -1; // NOTE: the levels set so far are kept on alloc failure.
+            }
+        }
+        pulse_detect->extra_level[i] = levels[i];
+        pulse_detect_reset(pulse_detect->extra[i]);
+        pulse_detect_set_levels(pulse_detect->extra[i], pulse_detect->use_mag_est, levels[i],
+                pulse_detect->min_high_level_db, pulse_detect->high_low_ratio_db, 0);
+    }
+    pulse_detect->extra_count = num;
+    return 0;
+}
+
+unsigned pulse_detect_extra_levels(pulse_detect_t const *pulse_detect)
+{
+    return pulse_detect->extra_count;
+}
+
+int pulse_detect_extra_package(pulse_detect_t *pulse_detect, unsigned index, int16_t const *envelope_data, int16_t const *fm_data, int len, uint32_t samp_rate, uint64_t sample_offset, unsigned fpdm, pulse_data_t **pulses, pulse_data_t **fsk_pulses)
+{
+    if (index >= pulse_detect->extra_count)
+        return 0;
+    *pulses     = &pulse_detect->extra_pulses[index];
+    *fsk_pulses = &pulse_detect->extra_fsk_pulses[index];
+    return pulse_detect_package(pulse_detect->extra[index], envelope_data, fm_data, len, samp_rate, sample_offset, *pulses, *fsk_pulses, fpdm);
+}
+
+/// Feed one FM sample to the selected FSK detector, and to the other one if enabled.
+static void pulse_detect_fsk_sample(pulse_detect_t *s, int16_t fm_n, pulse_data_t *fsk_pulses, unsigned fpdm)
+{
+    if (fpdm == FSK_PULSE_DETECT_OLD) {
+        pulse_detect_fsk_classic(&s->pulse_detect_fsk, fm_n, fsk_pulses);
+        if (s->fsk_alt)
+            pulse_detect_fsk_minmax(&s->pulse_detect_fsk_alt, fm_n, &s->fsk_alt_pulses);
+    } else {
+        pulse_detect_fsk_minmax(&s->pulse_detect_fsk, fm_n, fsk_pulses);
+        if (s->fsk_alt)
+            pulse_detect_fsk_classic(&s->pulse_detect_fsk_alt, fm_n, &s->fsk_alt_pulses);
+    }
+}
+
+/// Feed a block of FM samples to the selected FSK detector, and to the other one if enabled.
+static void pulse_detect_fsk_block(pulse_detect_t *s, int16_t const *fm, unsigned len, pulse_data_t *fsk_pulses, unsigned fpdm)
+{
+    if (fpdm == FSK_PULSE_DETECT_OLD) {
+        pulse_detect_fsk_classic_block(&s->pulse_detect_fsk, fm, len, fsk_pulses);
+        if (s->fsk_alt)
+            pulse_detect_fsk_minmax_block(&s->pulse_detect_fsk_alt, fm, len, &s->fsk_alt_pulses);
+    } else {
+        pulse_detect_fsk_minmax_block(&s->pulse_detect_fsk, fm, len, fsk_pulses);
+        if (s->fsk_alt)
+            pulse_detect_fsk_classic_block(&s->pulse_detect_fsk_alt, fm, len, &s->fsk_alt_pulses);
+    }
+}
+
 /// convert amplitude (16384 FS) to attenuation in (integer) dB, offset by 3.
 static inline int amp_to_att(int a)
 {
@@ -182,6 +348,185 @@ static void print_att_hist(char const *s, int att_hist[])
     }
 }
 
+/// Get the min and max of an envelope block.
+static void envelope_block_range(int16_t const *envelope_data, int len, int *min_out, int *max_out)
+{
+    int16_t mn = INT16_MAX;
+    int16_t mx = INT16_MIN;
+    for (int n = 0; n < len; ++n) {
+        mn = envelope_data[n] < mn ? envelope_data[n] : mn;
+        mx = envelope_data[n] > mx ? envelope_data[n] : mx;
+    }
+    *min_out = mn;
+    *max_out = mx;
+}
+
+int envelope_find_above(int16_t const *envelope_data, int len, int level)
+{
+    int n = 0;
+    for (; n + 16 <= len; n += 16) {
+        int above = 0;
+        for (int k = 0; k < 16; ++k) {
+            above |= envelope_data[n + k] > level;
+        }
+        if (above)
+            break;
+    }
+    for (; n < len; ++n) {
+        if (envelope_data[n] > level)
+            break;
+    }
+    return n;
+}
+
+int envelope_find_below(int16_t const *envelope_data, int len, int level)
+{
+    int n = 0;
+    for (; n + 16 <= len; n += 16) {
+        int below = 0;
+        for (int k = 0; k < 16; ++k) {
+            below |= envelope_data[n + k] < level;
+        }
+        if (below)
+            break;
+    }
+    for (; n < len; ++n) {
+        if (envelope_data[n] < level)
+            break;
+    }
+    return n;
+}
+
+/// Get the min and max of an 8-bit envelope block.
+static void envelope_8bit_block_range(uint8_t const *envelope_8bit, int len, int *min_out, int *max_out)
+{
+    uint8_t mn = UINT8_MAX;
+    uint8_t mx = 0;
+    for (int n = 0; n < len; ++n) {
+        mn = envelope_8bit[n] < mn ? envelope_8bit[n] : mn;
+        mx = envelope_8bit[n] > mx ? envelope_8bit[n] : mx;
+    }
+    *min_out = mn;
+    *max_out = mx;
+}
+
+int envelope_find_above_8bit(uint8_t const *envelope_8bit, int16_t const *envelope_data, int len, int level)
+{
+    if (level >= INT16_MAX)
+        return len;
+    // a sample above the level has at least this code
+    int const code = envelope_8bit_code(level + 1);
+    int n = 0;
+    for (; n + OOK_SEARCH_BLOCK_8 <= len; n += OOK_SEARCH_BLOCK_8) {
+        int above = 0;
+        for (int k = 0; k < OOK_SEARCH_BLOCK_8; ++k) {
+            above |= envelope_8bit[n + k] >= code;
+        }
+        if (!above)
+            continue;
+        int found = envelope_find_above(&envelope_data[n], OOK_SEARCH_BLOCK_8, level);
+        if (found < OOK_SEARCH_BLOCK_8)
+            return n + found;
+    }
+    return n + envelope_find_above(&envelope_data[n], len - n, level);
+}
+
+int envelope_find_below_8bit(uint8_t const *envelope_8bit, int16_t const *envelope_data, int len, int level)
+{
+    if (level <= INT16_MIN)
+        return len;
+    // a sample below the level has at most this code
+    int const code = envelope_8bit_code(level - 1);
+    int n = 0;
+    for (; n + OOK_SEARCH_BLOCK_8 <= len; n += OOK_SEARCH_BLOCK_8) {
+        int below = 0;
+        for (int k = 0; k < OOK_SEARCH_BLOCK_8; ++k) {
+            below |= envelope_8bit[n + k] <= code;
+        }
+        if (!below)
+            continue;
+        int found = envelope_find_below(&envelope_data[n], OOK_SEARCH_BLOCK_8, level);
+        if (found < OOK_SEARCH_BLOCK_8)
+            return n + found;
+    }
+    return n + envelope_find_below(&envelope_data[n], len - n, level);
+}
+
+/// Get the lower bound of the detection threshold over an idle block with a given minimum.
+static int pulse_detect_threshold_lb(pulse_detect_t const *s, int block_min)
+{
+    if (s->ook_fixed_high_level != 0)
+        return s->ook_fixed_high_level;
+    int low_lb  = MIN(s->ook_low_estimate, block_min) - OOK_GATE_STRIDE;
+    int high_lb = s->ook_high_low_ratio * low_lb;
+    high_lb     = MAX(high_lb, s->ook_min_high_level);
+    high_lb     = MIN(high_lb, OOK_MAX_HIGH_LEVEL);
+    return (low_lb + high_lb) / 2;
+}
+
+/// Try to skip an idle block that can not contain a pulse start.
+///
+/// The low estimate only moves towards the samples (and overshoots by at most one step),
+/// this bounds the threshold over the block from below. If the block peak stays below
+/// that bound no sample can start a pulse and only the noise estimator needs to run.
+/// The estimator then steps on every OOK_GATE_STRIDE-th sample with a matching gain,
+/// the time constant and slew rate are kept, the envelope is low pass filtered anyway.
+///
+/// @return the number of samples skipped, 0 if the block needs the full state machine
+static int pulse_detect_skip_block(pulse_detect_t *s, int16_t const *envelope_data, uint8_t const *envelope_8bit, int len)
+{
+    int block_min, block_max;
+    // The bounds of the codes bound the threshold and the peak, if that already allows the skip
+    // the exact range would too, otherwise the exact range decides
+    int skip = 0;
+    if (envelope_8bit) {
+        envelope_8bit_block_range(envelope_8bit, len, &block_min, &block_max);
+        int threshold_lb = block_min ? pulse_detect_threshold_lb(s, envelope_8bit_min(block_min)) : 0;
+        skip             = block_min && envelope_8bit_max(block_max) <= threshold_lb + threshold_lb / 8;
+    }
+    if (!skip) {
+        envelope_block_range(envelope_data, len, &block_min, &block_max);
+        int threshold_lb = pulse_detect_threshold_lb(s, block_min);
+        if (block_max > threshold_lb + threshold_lb / 8)
+            return 0;
+    }
+
+    // Run only the noise estimator
+    int low = s->ook_low_estimate;
+    for (int n = OOK_GATE_STRIDE - 1; n < len; n += OOK_GATE_STRIDE) {
+        int const ook_low_delta = envelope_data[n] - low;
+        low += ook_low_delta / (OOK_EST_LOW_RATIO / OOK_GATE_STRIDE);
+        low += ((ook_low_delta > 0) ? OOK_GATE_STRIDE : -OOK_GATE_STRIDE);
+    }
+    s->ook_low_estimate  = low;
+    s->ook_high_estimate = s->ook_high_low_ratio * s->ook_low_estimate;
+    s->ook_high_estimate = MAX(s->ook_high_estimate, s->ook_min_high_level);
+    s->ook_high_estimate = MIN(s->ook_high_estimate, OOK_MAX_HIGH_LEVEL);
+    if (s->lead_in_counter <= OOK_EST_LOW_RATIO)
+        s->lead_in_counter = MIN(s->lead_in_counter + len, OOK_EST_LOW_RATIO + 1);
+    return len;
+}
+
+int pulse_detect_fm_level(pulse_detect_t const *pulse_detect)
+{
+    // The low estimate overshoots zero by at most one step
+    int threshold_lb = pulse_detect->ook_fixed_high_level != 0 ? pulse_detect->ook_fixed_high_level : (pulse_detect->ook_min_high_level - 1) / 2;
+    int level = threshold_lb - threshold_lb / 8 - 1;
+    // the extra detectors read the FM samples too
+    for (unsigned i = 0; i < pulse_detect->extra_count; ++i) {
+        level = MIN(level, pulse_detect_fm_level(pulse_detect->extra[i]));
+    }
+    return level;
+}
+
+void pulse_detect_set_envelope_8bit(pulse_detect_t *pulse_detect, uint8_t const *envelope_8bit)
+{
+    pulse_detect->envelope_8bit = envelope_8bit;
+    for (unsigned i = 0; i < pulse_detect->extra_count; ++i) {
+        pulse_detect_set_envelope_8bit(pulse_detect->extra[i], envelope_8bit);
+    }
+}
+
 /// Demodulate On/Off Keying (OOK) and Frequency Shift Keying (FSK) from an envelope signal
 int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_data, int16_t const *fm_data, int len, uint32_t samp_rate, uint64_t sample_offset, pulse_data_t *pulses, pulse_data_t *fsk_pulses, unsigned fpdm)
 {
@@ -194,11 +539,63 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
         // age the pulse_data if this is a fresh buffer
         pulses->start_ago += len;
         fsk_pulses->start_ago += len;
+        s->fsk_alt_pulses.start_ago += len;
     }
 
     int eop_on_spurious = 0;
     // Process all new samples
     while (s->data_counter < len) {
+        // In a gap the levels are constant, search for the next pulse but stop before the gap gets too long
+        if (s->ook_state == PD_OOK_STATE_GAP && !eop_on_spurious && !pulse_detect->verbosity) {
+            int16_t ook_threshold = (s->ook_low_estimate + s->ook_high_estimate) / 2;
+            if (pulse_detect->ook_fixed_high_level != 0) {
+                ook_threshold = pulse_detect->ook_fixed_high_level; // Manual override
+            }
+            int16_t const ook_hysteresis = ook_threshold / 8; // +-12%
+            // The EOP check below is true for any gap longer than this
+            int max_gap = MIN(MAX(PD_MAX_GAP_RATIO * s->max_pulse, PD_MIN_GAP_MS * samples_per_ms), PD_MAX_GAP_MS * samples_per_ms);
+            int run_len = MIN(max_gap - s->pulse_length, len - s->data_counter);
+            if (run_len > 0) {
+                int run = s->envelope_8bit
+                        ? envelope_find_above_8bit(&s->envelope_8bit[s->data_counter], &envelope_data[s->data_counter], run_len, ook_threshold + ook_hysteresis)
+                        : envelope_find_above(&envelope_data[s->data_counter], run_len, ook_threshold + ook_hysteresis);
+                s->pulse_length += run;
+                s->data_counter += run;
+                if (s->data_counter >= len)
+                    break;
+            }
+        }
+        // In a pulse only the high level estimate changes, run the pulse without the state machine,
+        // in the first pulse the FSK detectors then run over the samples of the pulse at once
+        if (s->ook_state == PD_OOK_STATE_PULSE && !pulse_detect->verbosity) {
+            int pulse_start = s->data_counter;
+            for (; s->data_counter < len; s->data_counter++) {
+                int16_t const am_n    = envelope_data[s->data_counter];
+                int16_t ook_threshold = (s->ook_low_estimate + s->ook_high_estimate) / 2;
+                if (pulse_detect->ook_fixed_high_level != 0) {
+                    ook_threshold = pulse_detect->ook_fixed_high_level; // Manual override
+                }
+                if (am_n < (ook_threshold - ook_threshold / 8))
+                    break; // Gap, handled by the state machine
+                s->pulse_length += 1;
+                s->ook_high_estimate += am_n / OOK_EST_HIGH_RATIO - s->ook_high_estimate / OOK_EST_HIGH_RATIO;
+                s->ook_high_estimate = MAX(s->ook_high_estimate, pulse_detect->ook_min_high_level);
+                s->ook_high_estimate = MIN(s->ook_high_estimate, OOK_MAX_HIGH_LEVEL);
+                pulses->fsk_f1_est += fm_data[s->data_counter] / OOK_EST_HIGH_RATIO - pulses->fsk_f1_est / OOK_EST_HIGH_RATIO;
+            }
+            if (pulses->num_pulses == 0)
+                pulse_detect_fsk_block(s, &fm_data[pulse_start], (unsigned)(s->data_counter - pulse_start), fsk_pulses, fpdm);
+            if (s->data_counter >= len)
+                break;
+        }
+        // Fast-forward across silent blocks while idle (not with histograms, which need every sample)
+        if (s->ook_state == PD_OOK_STATE_IDLE && s->data_counter % OOK_GATE_BLOCK == 0 && !pulse_detect->verbosity) {
+            int block_len = MIN(OOK_GATE_BLOCK, len - s->data_counter);
+            int skipped   = pulse_detect_skip_block(s, &envelope_data[s->data_counter], s->envelope_8bit ? &s->envelope_8bit[s->data_counter] : NULL, block_len);
+            s->data_counter += skipped;
+            if (skipped)
+                continue;
+        }
         // Calculate OOK detection threshold and hysteresis
         int16_t const am_n    = envelope_data[s->data_counter];
         if (pulse_detect->verbosity) {
@@ -219,6 +616,9 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                     // Initialize all data
                     pulse_data_clear(pulses);
                     pulse_data_clear(fsk_pulses);
+                    if (pulse_data_reserve(pulses, 1) || pulse_data_reserve(fsk_pulses, 1)) {
+                        break; // out of memory, stay idle
+                    }
                     pulses->sample_rate = samp_rate;
                     fsk_pulses->sample_rate = samp_rate;
                     pulses->offset = sample_offset + s->data_counter;
@@ -228,6 +628,17 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                     s->pulse_length = 0;
                     s->max_pulse = 0;
                     pulse_detect_fsk_init(&s->pulse_detect_fsk);
+                    if (s->fsk_alt) {
+                        pulse_data_t *alt = &s->fsk_alt_pulses;
+                        pulse_data_clear(alt);
+                        if (pulse_data_reserve(alt, 1)) {
+                            break; // out of memory, stay idle
+                        }
+                        alt->sample_rate = samp_rate;
+                        alt->offset = fsk_pulses->offset;
+                        alt->start_ago = fsk_pulses->start_ago;
+                        pulse_detect_fsk_init(&s->pulse_detect_fsk_alt);
+                    }
                     s->ook_state = PD_OOK_STATE_PULSE;
                 }
                 else {    // We are still idle..
@@ -276,11 +687,7 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                 }
                 // FSK Demodulation
                 if (pulses->num_pulses == 0) {    // Only during first pulse
-                    if (fpdm == FSK_PULSE_DETECT_OLD) {
-                        pulse_detect_fsk_classic(&s->pulse_detect_fsk, fm_data[s->data_counter], fsk_pulses);
-                    } else {
-                        pulse_detect_fsk_minmax(&s->pulse_detect_fsk, fm_data[s->data_counter], fsk_pulses);
-                    }
+                    pulse_detect_fsk_sample(s, fm_data[s->data_counter], fsk_pulses, fpdm);
                 }
                 break;
             case PD_OOK_STATE_GAP_START:    // Beginning of gap - it might be a spurious gap
@@ -293,7 +700,7 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                 // Or this gap is for real?
                 else if (s->pulse_length >= PD_MIN_PULSE_SAMPLES) {
                     s->ook_state = PD_OOK_STATE_GAP;
-                    // Determine if FSK modulation is detected
+                    // Determine if FSK modulation is detected, only the primary detector ends the package
                     if (fsk_pulses->num_pulses > PD_MIN_PULSES) {
                         // Store last pulse/gap
                         if (fpdm == FSK_PULSE_DETECT_OLD)
@@ -305,6 +712,16 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                         fsk_pulses->ook_high_estimate = s->ook_high_estimate;
                         pulses->end_ago = len - s->data_counter;
                         fsk_pulses->end_ago = len - s->data_counter;
+                        if (s->fsk_alt) {
+                            pulse_data_t *alt = &s->fsk_alt_pulses;
+                            if (fpdm != FSK_PULSE_DETECT_OLD)
+                                pulse_detect_fsk_wrap_up(&s->pulse_detect_fsk_alt, alt);
+                            alt->fsk_f1_est = s->pulse_detect_fsk_alt.fm_f1_est;
+                            alt->fsk_f2_est = s->pulse_detect_fsk_alt.fm_f2_est;
+                            alt->ook_low_estimate = s->ook_low_estimate;
+                            alt->ook_high_estimate = s->ook_high_estimate;
+                            alt->end_ago = len - s->data_counter;
+                        }
                         s->ook_state = PD_OOK_STATE_IDLE;    // Ensure everything is reset
                         if (pulse_detect->verbosity > 1) {
                             print_att_hist("PULSE_DATA_FSK", att_hist);
@@ -321,11 +738,7 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                 } // if
                 // FSK Demodulation (continue during short gap - we might return...)
                 if (pulses->num_pulses == 0) {    // Only during first pulse
-                    if (fpdm == FSK_PULSE_DETECT_OLD) {
-                        pulse_detect_fsk_classic(&s->pulse_detect_fsk, fm_data[s->data_counter], fsk_pulses);
-                    } else {
-                        pulse_detect_fsk_minmax(&s->pulse_detect_fsk, fm_data[s->data_counter], fsk_pulses);
-                    }
+                    pulse_detect_fsk_sample(s, fm_data[s->data_counter], fsk_pulses, fpdm);
                 }
                 break;
             case PD_OOK_STATE_GAP:
@@ -336,7 +749,7 @@ int pulse_detect_package(pulse_detect_t *pulse_detect, int16_t const *envelope_d
                     pulses->num_pulses += 1;    // Next pulse
 
                     // EOP if too many pulses
-                    if (pulses->num_pulses >= PD_MAX_PULSES) {
+                    if (pulse_data_reserve(pulses, pulses->num_pulses + 1)) {
                         s->ook_state = PD_OOK_STATE_IDLE;
                         // Store estimates
                         pulses->ook_low_estimate = s->ook_low_estimate;
@@ -31,7 +31,8 @@ void pulse_detect_fsk_init(pulse_detect_fsk_t *s)
     s->skip_samples = 40;
 }
 
-void pulse_detect_fsk_classic(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
+/// One sample of the classic detector, inlined into the sample and the block functions.
+static inline void fsk_classic_step(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
 {
     int const fm_f1_delta = abs(fm_n - s->fm_f1_est); // Get delta from F1 frequency estimate
     int const fm_f2_delta = abs(fm_n - s->fm_f2_est); // Get delta from F2 frequency estimate
@@ -107,7 +108,7 @@ void pulse_detect_fsk_classic(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t
                     fsk_pulses->num_pulses += 1;    // Go to next pulse
                     s->fsk_pulse_length = 0;
                     // When pulse buffer is full go to error state
-                    if (fsk_pulses->num_pulses >= PD_MAX_PULSES) {
+                    if (pulse_data_reserve(fsk_pulses, fsk_pulses->num_pulses + 1)) {
                         //fprintf(stderr, "pulse_detect_fsk_classic(): Maximum number of pulses reached!\n");
                         //s->fsk_state = PD_FSK_STATE_ERROR;
                         // TODO: workaround, specifically for the Inkbird-ITH20R: free some of the buffer
@@ -140,9 +141,23 @@ void pulse_detect_fsk_classic(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t
     } // switch(s->fsk_state)
 }
 
+void pulse_detect_fsk_classic(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
+{
+    fsk_classic_step(s, fm_n, fsk_pulses);
+}
+
+void pulse_detect_fsk_classic_block(pulse_detect_fsk_t *s, int16_t const *fm, unsigned len, pulse_data_t *fsk_pulses)
+{
+    pulse_detect_fsk_t st = *s; // a local copy, the estimates and the state stay in registers
+    for (unsigned i = 0; i < len; ++i) {
+        fsk_classic_step(&st, fm[i], fsk_pulses);
+    }
+    *s = st;
+}
+
 void pulse_detect_fsk_wrap_up(pulse_detect_fsk_t *s, pulse_data_t *fsk_pulses)
 {
-    if (fsk_pulses->num_pulses < PD_MAX_PULSES) { // Avoid overflow
+    if (!pulse_data_reserve(fsk_pulses, fsk_pulses->num_pulses + 1)) { // Avoid overflow
         s->fsk_pulse_length += 1;
         if (s->fsk_state == PD_FSK_STATE_FH) {
             fsk_pulses->pulse[fsk_pulses->num_pulses] = s->fsk_pulse_length; // Store last pulse
@@ -155,7 +170,8 @@ void pulse_detect_fsk_wrap_up(pulse_detect_fsk_t *s, pulse_data_t *fsk_pulses)
     }
 }
 
-void pulse_detect_fsk_minmax(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
+/// One sample of the min/max detector, inlined into the sample and the block functions.
+static inline void fsk_minmax_step(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
 {
     int16_t mid = 0;
 
@@ -198,7 +214,7 @@ void pulse_detect_fsk_minmax(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *
                     fsk_pulses->num_pulses += 1;
                     s->fsk_pulse_length = 0;
                     // When pulse buffer is full go to error state
-                    if (fsk_pulses->num_pulses >= PD_MAX_PULSES) {
+                    if (pulse_data_reserve(fsk_pulses, fsk_pulses->num_pulses + 1)) {
                         //fprintf(stderr, "pulse_detect_fsk_minmax(): Maximum number of pulses reached!\n");
                         //s->fsk_state = PD_FSK_STATE_ERROR;
                         // TODO: workaround, specifically for the Inkbird-ITH20R: free some of the buffer
@@ -219,3 +235,22 @@ void pulse_detect_fsk_minmax(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *
         s->skip_samples -= 1;
     }
 }
+
+void pulse_detect_fsk_minmax(pulse_detect_fsk_t *s, int16_t fm_n, pulse_data_t *fsk_pulses)
+{
+    fsk_minmax_step(s, fm_n, fsk_pulses);
+}
+
+void pulse_detect_fsk_minmax_block(pulse_detect_fsk_t *s, int16_t const *fm, unsigned len, pulse_data_t *fsk_pulses)
+{
+    // the samples skipped for framing only count down
+    unsigned skip = s->skip_samples > 0 ? MIN((unsigned)s->skip_samples, len) : 0;
+    s->skip_samples -= (int)skip;
+
+    // the trackers are a recurrence over the samples, a local copy keeps them in registers
+    pulse_detect_fsk_t st = *s;
+    for (unsigned i = skip; i < len; ++i) {
+        fsk_minmax_step(&st, fm[i], fsk_pulses);
+    }
+    *s = st;
+}
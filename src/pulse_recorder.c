@@ -0,0 +1,263 @@
+/** @file
+    Pulse flight recorder, keeps the recent packages in a ring to dump on demand.
+
+    Each package is encoded as in the binary pulse data format, the varint widths
+    and the levels, and kept in a ring allocated once. A record is the wall time,
+    the encoded length, and the encoded package, records do not wrap around the end
+    of the ring. The packages older than the time kept are dropped, and the oldest
+    packages make room if the ring is full.
+
+    A dump copies the records out under the lock, the file or the data is written
+    without holding up the demodulation.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "pulse_recorder.h"
+#include "pulse_bin.h"
+#include "pulse_data.h"
+#include "r_util.h"
+#include "list.h"
+#include "data.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/// The record head, stored unaligned.
+typedef struct {
+    uint64_t time_ms;
+    uint32_t len; ///< length of the encoded package
+} record_head_t;
+
+struct pulse_recorder {
+    uint64_t window_ms;
+    size_t size;
+    uint8_t *ring;
+    size_t tail;    ///< the oldest record
+    size_t head;    ///< the end of the newest record
+    size_t wrap;    ///< the end of the records before the head wrapped, 0 if not wrapped
+    unsigned count; ///< records kept
+#ifdef THREADS
+    pthread_mutex_t lock; ///< guards the ring, packages are added and dumped on different threads
+#endif
+};
+
+static void recorder_lock(pulse_recorder_t *rec)
+{
+#ifdef THREADS
+    pthread_mutex_lock(&rec->lock);
+#else
+    (void)rec;
+#endif
+}
+
+static void recorder_unlock(pulse_recorder_t *rec)
+{
+#ifdef THREADS
+    pthread_mutex_unlock(&rec->lock);
+#else
+    (void)rec;
+#endif
+}
+
+pulse_recorder_t *pulse_recorder_create(unsigned minutes, size_t size)
+{
+    pulse_recorder_t *rec = calloc(1, sizeof(*rec));
+    if (!rec) {
+        WARN_CALLOC("pulse_recorder_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    rec->ring = malloc(size);
+    if (!rec->ring) {
+        WARN_MALLOC("pulse_recorder_create()");
+        free(rec);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    rec->window_ms = (uint64_t)minutes * 60 * 1000;
+    rec->size      = size;
+#ifdef THREADS
+    pthread_mutex_init(&rec->lock, NULL);
+#endif
+    return rec;
+}
+
+void pulse_recorder_free(pulse_recorder_t *rec)
+{
+    if (!rec)
+        return;
+#ifdef THREADS
+    pthread_mutex_destroy(&rec->lock);
+#endif
+    free(rec->ring);
+    free(rec);
+}
+
+static record_head_t read_head(pulse_recorder_t const *rec, size_t pos)
+{
+    record_head_t head;
+    memcpy(&head, &rec->ring[pos], sizeof(head));
+    return head;
+}
+
+/// Drop the oldest record.
+static void drop_oldest(pulse_recorder_t *rec)
+{
+    record_head_t head = read_head(rec, rec->tail);
+    rec->tail += sizeof(head) + head.len;
+    rec->count--;
+    if (rec->wrap && rec->tail == rec->wrap) {
+        rec->tail = 0; // the rest of the records are at the start
+        rec->wrap = 0;
+    }
+    if (!rec->count) {
+        rec->tail = 0;
+        rec->head = 0;
+        rec->wrap = 0;
+    }
+}
+
+/// Make room for a record at the head, the oldest records are dropped, returns the position.
+static size_t make_room(pulse_recorder_t *rec, size_t need)
+{
+    for (;;) {
+        if (!rec->wrap) {
+            if (rec->size - rec->head >= need)
+                return rec->head;
+            if (!rec->count) {
+                rec->head = 0;
+                continue; // the ring is empty, can not wrap
+            }
+            rec->wrap = rec->head; // continue at the start
+            rec->head = 0;
+        }
+        if (rec->tail - rec->head >= need)
+            return rec->head;
+        drop_oldest(rec);
+    }
+}
+
+size_t pulse_recorder_memory(pulse_recorder_t const *rec)
+{
+    if (!rec)
+        return 0;
+    return sizeof(*rec) + rec->size;
+}
+
+void pulse_recorder_add(pulse_recorder_t *rec, pulse_data_t const *data, uint64_t time_ms)
+{
+    size_t need = sizeof(record_head_t) + PULSE_BIN_PACKAGE_SIZE(data->num_pulses);
+    if (!data->num_pulses || need > rec->size)
+        return;
+
+    recorder_lock(rec);
+    while (rec->count && read_head(rec, rec->tail).time_ms + rec->window_ms < time_ms) {
+        drop_oldest(rec);
+    }
+    size_t pos         = make_room(rec, need);
+    record_head_t head = {time_ms, 0};
+    head.len           = (uint32_t)pulse_bin_encode_package(&rec->ring[pos + sizeof(head)], need - sizeof(head), data);
+    if (head.len) {
+        memcpy(&rec->ring[pos], &head, sizeof(head));
+        rec->head = pos + sizeof(head) + head.len;
+        rec->count++;
+    }
+    recorder_unlock(rec);
+}
+
+/// Copy the records out in order, oldest first, returns the length, NOTE: the buffer is NULL on alloc failure.
+static size_t copy_records(pulse_recorder_t *rec, uint8_t **buf)
+{
+    recorder_lock(rec);
+    size_t first = rec->wrap ? rec->wrap - rec->tail : rec->head - rec->tail;
+    size_t len   = rec->wrap ? first + rec->head : first;
+    *buf         = malloc(len ? len : 1);
+    if (!*buf) {
+        WARN_MALLOC("copy_records()");
+        recorder_unlock(rec);
+        return 0;
+    }
+    memcpy(*buf, &rec->ring[rec->tail], first);
+    if (rec->wrap)
+        memcpy(*buf + first, rec->ring, rec->head);
+    recorder_unlock(rec);
+    return len;
+}
+
+unsigned pulse_recorder_dump(pulse_recorder_t *rec, FILE *file, uint32_t sample_rate)
+{
+    uint8_t *buf;
+    size_t len = copy_records(rec, &buf);
+    if (!buf)
+        return 0;
+
+    pulse_bin_print_header(file, sample_rate);
+    unsigned count = 0;
+    for (size_t pos = 0; pos < len; ++count) {
+        record_head_t head;
+        memcpy(&head, &buf[pos], sizeof(head));
+        pos += sizeof(head);
+        if (fwrite(&buf[pos], 1, head.len, file) != head.len) {
+            perror("File output error");
+            break;
+        }
+        pos += head.len;
+    }
+    free(buf);
+    return count;
+}
+
+int pulse_recorder_dump_file(pulse_recorder_t *rec, uint32_t sample_rate, char *path)
+{
+    char time_str[LOCAL_TIME_BUFLEN];
+    format_time_str(time_str, "%Y%m%d_%H%M%S", 0, 0);
+    snprintf(path, 64, "rtl_433_pulses_%s.ookbin", time_str);
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    unsigned count = pulse_recorder_dump(rec, file, sample_rate);
+    fclose(file);
+    return (int)count;
+}
+
+data_t *pulse_recorder_data(pulse_recorder_t *rec)
+{
+    uint8_t *buf;
+    size_t len = copy_records(rec, &buf);
+    if (!buf)
+        return NULL; // NOTE: returns NULL on alloc failure.
+
+    list_t packages = {0};
+    pulse_data_t data = {0};
+    for (size_t pos = 0; pos < len;) {
+        record_head_t head;
+        memcpy(&head, &buf[pos], sizeof(head));
+        pos += sizeof(head);
+        if (!pulse_bin_decode_package(&buf[pos], head.len, 0, &data)) {
+            char time_str[LOCAL_TIME_BUFLEN];
+            struct timeval tv = {(time_t)(head.time_ms / 1000), (long)(head.time_ms % 1000) * 1000};
+            usecs_time_str(time_str, NULL, 0, &tv);
+            data_t *package = pulse_data_print_rfraw(&data);
+            if (package)
+                list_push(&packages, data_prepend(package,
+                        "time",     "", DATA_STRING, time_str,
+                        NULL));
+        }
+        pos += head.len;
+    }
+    pulse_data_free(&data);
+    free(buf);
+
+    data_t *out = data_make(
+            "packages",         "", DATA_INT, (int)packages.len,
+            "pulses",           "", DATA_ARRAY, data_array(packages.len, DATA_DATA, packages.elems),
+            NULL);
+    list_free_elems(&packages, NULL);
+    return out;
+}
@@ -14,28 +14,279 @@
 #include "pulse_slicer.h"
 #include "bitbuffer.h"
 #include "util.h"
+#include "fatal.h"
+#include "compat_time.h"
+#include "decode_budget.h"
+#include "alloc_count.h"
+#include "usdt.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <math.h>
 #include <limits.h>
+#include <string.h>
+
+/// A recorded event of a slicer.
+struct slice_cache_entry {
+    char const *demod_name;
+    unsigned preamble_hits; ///< bits of the cache patterns found in any row
+    preamble_matches_t matches;
+    bitbuffer_t bits;
+};
+
+/// Record an event into the slice cache, returns -1 on allocation failure.
+static int slice_cache_record(slice_cache_t *cache, bitbuffer_t const *bits, char const *demod_name)
+{
+    if (cache->num_entries >= cache->max_entries) {
+        unsigned max_entries = cache->max_entries ? cache->max_entries * 2 : 4;
+        struct slice_cache_entry *entries = realloc(cache->entries, max_entries * sizeof(*entries));
+        if (!entries) {
+            WARN_REALLOC("slice_cache_record()");
+            return -1;
+        }
+        for (unsigned i = cache->max_entries; i < max_entries; ++i) {
+            bitbuffer_init(&entries[i].bits); // copies then clear only the rows in use
+        }
+        cache->entries     = entries;
+        cache->max_entries = max_entries;
+    }
+    struct slice_cache_entry *entry = &cache->entries[cache->num_entries++];
+    entry->demod_name    = demod_name;
+    entry->preamble_hits = 0;
+    entry->matches.num   = 0;
+    bitbuffer_copy(&entry->bits, bits);
+    return 0;
+}
 
-static int account_event(r_device *device, bitbuffer_t *bits, char const *demod_name)
+/// Find all patterns of the slice cache in one pass over each row, the positions are recorded with the entry.
+/// A window of the next 64 bits is compared to each pattern at every bit position.
+static void slice_cache_match(slice_cache_t const *cache, struct slice_cache_entry *entry)
 {
-    // run decoder
-    int ret = 0;
-    if (device->decode_fn) {
-        ret = device->decode_fn(device, bits);
+    bitbuffer_t const *bits     = &entry->bits;
+    preamble_matches_t *matches = &entry->matches;
+    matches->num      = 0;
+    matches->overflow = 0;
+    entry->preamble_hits = 0;
+    for (unsigned row = 0; row < bits->num_rows; ++row) {
+        uint8_t const *b = bits->bb[row];
+        unsigned len     = bits->bits_per_row[row];
+        uint64_t window  = 0;
+        for (unsigned i = 0; i < 64; ++i) {
+            window = window << 1 | (i < len ? bitrow_get_bit(b, i) : 0);
+        }
+        for (unsigned pos = 0; pos < len; ++pos) {
+            for (unsigned k = 0; k < cache->num_patterns; ++k) {
+                bitbuffer_pattern_t const *pattern = &cache->patterns[k];
+                if (pos + pattern->len > len || (window & pattern->mask) != pattern->bits)
+                    continue;
+                entry->preamble_hits |= 1u << k;
+                if (matches->num < PREAMBLE_MATCHES_MAX) {
+                    struct preamble_match *match = &matches->match[matches->num++];
+                    match->mask = 1u << k;
+                    match->row  = row;
+                    match->pos  = pos;
+                }
+                else {
+                    matches->overflow = 1;
+                }
+            }
+            unsigned next = pos + 64;
+            window = window << 1 | (next < len ? bitrow_get_bit(b, next) : 0);
+        }
+    }
+}
+
+/// Add the preamble of a decoder to the patterns of the slice cache, identical preambles share a pattern.
+static void slice_cache_add_preamble(slice_cache_t *cache, r_device *device)
+{
+    device->preamble_mask = 0;
+    if (!device->preamble || !device->preamble_bits || device->preamble_bits > 64)
+        return;
+    bitbuffer_pattern_t pattern;
+    bitbuffer_pattern_init(&pattern, device->preamble, device->preamble_bits);
+    unsigned k = 0;
+    while (k < cache->num_patterns
+            && (cache->patterns[k].len != pattern.len || cache->patterns[k].bits != pattern.bits))
+        ++k;
+    if (k == SLICE_CACHE_PATTERNS)
+        return; // too many preambles, the decoder always runs
+    if (k == cache->num_patterns)
+        cache->patterns[cache->num_patterns++] = pattern;
+    device->preamble_mask = 1u << k;
+}
+
+/// Check the declared row count and row length limits of a decoder, see r_device.
+static int decoder_length_match(r_device const *device, bitbuffer_t const *bits)
+{
+    if (bits->num_rows < device->min_rows
+            || (device->max_rows && bits->num_rows > device->max_rows))
+        return 0;
+    if (!device->min_bits && !device->max_bits)
+        return 1;
+    for (unsigned i = 0; i < bits->num_rows; ++i) {
+        if (bits->bits_per_row[i] >= device->min_bits
+                && (!device->max_bits || bits->bits_per_row[i] <= device->max_bits))
+            return 1;
+    }
+    return 0;
+}
+
+/// Fixed-point 1.0 of the 32.32 reciprocals.
+#define SLICE_ONE ((uint64_t)1 << 32)
+
+/// Returns the reciprocal of the mean width of count symbols, 32.32 fixed-point rounded up.
+static uint64_t slice_reciprocal(int count, int width)
+{
+    if (count <= 0 || width <= 0)
+        return 0;
+    return (((uint64_t)count << 32) + (unsigned)width - 1) / (unsigned)width;
+}
+
+/// Returns the number of symbols in a width, rounded half up, 0 for a negative width.
+static inline int slice_count(int width, uint64_t reciprocal)
+{
+    if (width <= 0)
+        return 0;
+    return (int)(((uint64_t)width * reciprocal + SLICE_ONE / 2) >> 32);
+}
+
+/// Get the bounds of the PPM gaps, short=0, long=1.
+static void slice_bounds_ppm(struct slice_plan *plan)
+{
+    struct slice_bounds *b = &plan->ppm;
+    memset(b, 0, sizeof(*b));
+
+    if (plan->s_tolerance > 0) {
+        // precise
+        b->zero_l = plan->s_short - plan->s_tolerance;
+        b->zero_u = plan->s_short + plan->s_tolerance;
+        b->one_l  = plan->s_long - plan->s_tolerance;
+        b->one_u  = plan->s_long + plan->s_tolerance;
+        if (plan->s_sync > 0) {
+            b->sync_l = plan->s_sync - plan->s_tolerance;
+            b->sync_u = plan->s_sync + plan->s_tolerance;
+        }
+    }
+    else {
+        // no sync, short=0, long=1
+        b->zero_l = 0;
+        b->zero_u = (plan->s_short + plan->s_long) / 2 + 1;
+        b->one_l  = b->zero_u - 1;
+        b->one_u  = plan->s_gap ? plan->s_gap : plan->s_reset;
+    }
+}
+
+/// Get the bounds of the PWM pulses, short=1, long=0, the sync may be short, middle, or long.
+static void slice_bounds_pwm(struct slice_plan *plan)
+{
+    struct slice_bounds *b = &plan->pwm;
+    memset(b, 0, sizeof(*b));
+    int s_short = plan->s_short;
+    int s_long  = plan->s_long;
+    int s_sync  = plan->s_sync;
+    int s_tolerance = plan->s_tolerance;
+
+    if (s_tolerance > 0) {
+        // precise
+        b->one_l  = s_short - s_tolerance;
+        b->one_u  = s_short + s_tolerance;
+        b->zero_l = s_long - s_tolerance;
+        b->zero_u = s_long + s_tolerance;
+        if (s_sync > 0) {
+            b->sync_l = s_sync - s_tolerance;
+            b->sync_u = s_sync + s_tolerance;
+        }
+    }
+    else if (s_sync <= 0) {
+        // no sync, short=1, long=0
+        b->one_l  = 0;
+        b->one_u  = (s_short + s_long) / 2 + 1;
+        b->zero_l = b->one_u - 1;
+        b->zero_u = INT_MAX;
+    }
+    else if (s_sync < s_short) {
+        // short=sync, middle=1, long=0
+        b->sync_l = 0;
+        b->sync_u = (s_sync + s_short) / 2 + 1;
+        b->one_l  = b->sync_u - 1;
+        b->one_u  = (s_short + s_long) / 2 + 1;
+        b->zero_l = b->one_u - 1;
+        b->zero_u = INT_MAX;
+    }
+    else if (s_sync < s_long) {
+        // short=1, middle=sync, long=0
+        b->one_l  = 0;
+        b->one_u  = (s_short + s_sync) / 2 + 1;
+        b->sync_l = b->one_u - 1;
+        b->sync_u = (s_sync + s_long) / 2 + 1;
+        b->zero_l = b->sync_u - 1;
+        b->zero_u = INT_MAX;
     }
+    else {
+        // short=1, middle=0, long=sync
+        b->one_l  = 0;
+        b->one_u  = (s_short + s_long) / 2 + 1;
+        b->zero_l = b->one_u - 1;
+        b->zero_u = (s_long + s_sync) / 2 + 1;
+        b->sync_l = b->zero_u - 1;
+        b->sync_u = INT_MAX;
+    }
+}
+
+/// Get the timings of a decoder in samples, the plan is only recomputed if the sample rate changed.
+/// Returns NULL if the sample rate is too low for the decoder.
+static struct slice_plan const *slice_plan_get(const pulse_data_t *pulses, r_device *device)
+{
+    struct slice_plan *plan = &device->slice_plan;
+    if (plan->sample_rate != pulses->sample_rate || !plan->sample_rate) {
+        float samples_per_us = pulses->sample_rate / 1.0e6;
+
+        plan->sample_rate = pulses->sample_rate;
+        plan->s_short     = device->short_width * samples_per_us;
+        plan->s_long      = device->long_width * samples_per_us;
+        plan->s_reset     = device->reset_limit * samples_per_us;
+        plan->s_gap       = device->gap_limit * samples_per_us;
+        plan->s_sync      = device->sync_width * samples_per_us;
+        plan->s_tolerance = device->tolerance * samples_per_us;
+
+        // check for rounding to zero
+        plan->too_low = (device->short_width > 0 && plan->s_short <= 0)
+                || (device->long_width > 0 && plan->s_long <= 0)
+                || (device->reset_limit > 0 && plan->s_reset <= 0)
+                || (device->gap_limit > 0 && plan->s_gap <= 0)
+                || (device->sync_width > 0 && plan->s_sync <= 0)
+                || (device->tolerance > 0 && plan->s_tolerance <= 0);
+
+        // precision reciprocals, of the exact widths
+        double w_short = device->short_width * samples_per_us;
+        double w_long  = device->long_width * samples_per_us;
+        plan->r_short  = w_short > 0.0 ? (uint64_t)ceil(SLICE_ONE / w_short) : 0;
+        plan->r_long   = w_long > 0.0 ? (uint64_t)ceil(SLICE_ONE / w_long) : 0;
+
+        int gap_limit   = plan->s_gap ? plan->s_gap : plan->s_reset;
+        plan->max_zeros = plan->s_long > 0 ? gap_limit / plan->s_long : 0;
+
+        slice_bounds_ppm(plan);
+        slice_bounds_pwm(plan);
+    }
+    if (plan->too_low) {
+        fprintf(stderr, "sample rate too low for protocol %u \"%s\"\n", device->protocol_num, device->name);
+        return NULL;
+    }
+    return plan;
+}
 
+/// Count the result of a decoder run, or of a skipped run, and print the debug output.
+static int account_result(r_device *device, bitbuffer_t *bits, char const *demod_name, int ret)
+{
     // statistics accounting
-    device->decode_events += 1;
+    device->stats.events += 1;
     if (ret > 0) {
-        device->decode_ok += 1;
-        device->decode_messages += ret;
+        device->stats.ok += 1;
+        device->stats.messages += ret;
     }
-    else if (ret >= DECODE_FAIL_SANITY) {
-        device->decode_fails[-ret] += 1;
+    else if (ret >= DECODE_FAIL_BUDGET) {
+        device->stats.fails[-ret] += 1;
         ret = 0;
     }
     else {
@@ -52,36 +303,92 @@ static int account_event(r_device *device, bitbuffer_t *bits, char const *demod_
     return ret;
 }
 
-int pulse_slicer_pcm(const pulse_data_t *pulses, r_device *device)
+static int account_event(r_device *device, bitbuffer_t *bits, char const *demod_name)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        fprintf(stderr, "sample rate too low for protocol %u \"%s\"\n", device->protocol_num, device->name);
+    // record only, see pulse_slicer_shared()
+    if (device->slice_cache && device->slice_cache->recording) {
+        if (slice_cache_record(device->slice_cache, bits, demod_name))
+            device->slice_cache->valid = -1; // out of memory, slice again for each decoder
         return 0;
     }
 
-    // precision reciprocals
-    float f_short = device->short_width > 0.0 ? 1.0 / (device->short_width * samples_per_us) : 0;
-    float f_long  = device->long_width > 0.0 ? 1.0 / (device->long_width * samples_per_us) : 0;
+    // run decoder
+    int ret = 0;
+    if (device->decode_fn && !decoder_length_match(device, bits)) {
+        ret = DECODE_ABORT_LENGTH;
+    }
+    else if (device->decode_fn && device->profile) {
+        decode_budget_start(device->time_budget);
+        uint64_t allocs = alloc_count_get().allocs;
+        double start    = monotonic_time_us();
+        USDT_PROBE1(decoder_start, device->protocol_num);
+        ret = device->decode_fn(device, bits);
+        USDT_PROBE2(decoder_end, device->protocol_num, ret);
+        device->stats.decode_time += monotonic_time_us() - start;
+        device->stats.decode_allocs += alloc_count_get().allocs - allocs;
+    }
+    else if (device->decode_fn) {
+        decode_budget_start(device->time_budget);
+        USDT_PROBE1(decoder_start, device->protocol_num);
+        ret = device->decode_fn(device, bits);
+        USDT_PROBE2(decoder_end, device->protocol_num, ret);
+    }
+
+    // over the budget without a message, demote the decoder as if it had no events
+    if (device->decode_fn && decode_budget_stop() && ret <= 0) {
+        ret = DECODE_FAIL_BUDGET;
+        if (!device->sample_every) {
+            device->sample_every = ADAPT_SAMPLING;
+            device->sample_count = 0;
+            if (device->verbose)
+                fprintf(stderr, "Decoder [%u] \"%s\" is over its time budget of %u us, sampling every %u packages\n", device->protocol_num, device->name, device->time_budget, ADAPT_SAMPLING);
+        }
+    }
+
+    return account_result(device, bits, demod_name, ret);
+}
+
+/// Returns the row limit to stop slicing a message at, 0 to always slice the full message.
+/// The rows only grow until the end of the message, a message over max_rows can not match the decoder.
+static unsigned slice_reject_rows(r_device const *device)
+{
+    // a shared slicer records the bits for all its decoders, the debug output prints the full bits
+    if (!device->decode_fn || (device->slice_cache && device->slice_cache->recording) || device->verbose > 1)
+        return 0;
+    return device->max_rows;
+}
+
+/// Returns the last pulse of the message at pulse n, a gap of at least the reset limit or the last pulse.
+static unsigned slice_message_end(const pulse_data_t *pulses, unsigned n, int reset_limit)
+{
+    while (n < pulses->num_pulses - 1 && pulses->gap[n] < reset_limit)
+        ++n;
+    return n;
+}
+
+int pulse_slicer_pcm(const pulse_data_t *pulses, r_device *device)
+{
+    struct slice_plan const *plan = slice_plan_get(pulses, device);
+    if (!plan)
+        return 0;
+    int s_short = plan->s_short;
+    int s_long  = plan->s_long;
+    int s_reset = plan->s_reset;
+    int s_gap   = plan->s_gap;
+    int s_tolerance = plan->s_tolerance;
+
+    // precision reciprocals, 32.32 fixed-point
+    uint64_t r_short = plan->r_short;
+    uint64_t r_long  = plan->r_long;
 
     int events = 0;
-    bitbuffer_t bits = {0};
+    bitbuffer_t bits;
+    bitbuffer_init(&bits);
 
     int const gap_limit = s_gap ? s_gap : s_reset;
-    int const max_zeros = gap_limit / s_long;
+    int const max_zeros = plan->max_zeros;
+    // the RZ coding clears the bits on a corrupt pulse, the rows may shrink
+    unsigned const reject_rows = s_short == s_long ? slice_reject_rows(device) : 0;
     if (s_tolerance <= 0)
         s_tolerance = s_long / 4; // default tolerance is +-25% of a bit period
 
@@ -105,15 +412,15 @@ int pulse_slicer_pcm(const pulse_data_t *pulses, r_device *device)
         }
         // require at least min_count bits preamble
         if (count >= min_count) {
-            f_long  = (float)count / lwidth;
-            f_short = (float)count / swidth;
+            r_long  = slice_reciprocal(count, lwidth);
+            r_short = slice_reciprocal(count, swidth);
             min_count = count;
             preamble_len = count;
             if (device->verbose > 1) {
                 float to_us = 1e6 / pulses->sample_rate;
                 fprintf(stderr, "Exact bit width (in us) is %.2f vs %.2f (pulse width %.2f vs %.2f), %d bit preamble\n",
-                        to_us / f_long, to_us * s_long,
-                        to_us / f_short, to_us * s_short, count);
+                        to_us * lwidth / count, to_us * s_long,
+                        to_us * swidth / count, to_us * s_short, count);
             }
         }
     }
@@ -133,13 +440,13 @@ int pulse_slicer_pcm(const pulse_data_t *pulses, r_device *device)
     }
     // require at least 8 bits measured
     if (rz_count > 8) {
-        f_long  = (float)rz_count / rzl_width;
-        f_short = (float)rz_count / rzs_width;
+        r_long  = slice_reciprocal(rz_count, rzl_width);
+        r_short = slice_reciprocal(rz_count, rzs_width);
         if (device->verbose > 1) {
             float to_us = 1e6 / pulses->sample_rate;
             fprintf(stderr, "Exact bit width (in us) is %.2f vs %.2f (pulse width %.2f vs %.2f), %d bit measured\n",
-                    to_us / f_long, to_us * s_long,
-                    to_us / f_short, to_us * s_short, rz_count);
+                    to_us * rzl_width / rz_count, to_us * s_long,
+                    to_us * rzs_width / rz_count, to_us * s_short, rz_count);
         }
     }
     // NRZ
@@ -147,21 +454,21 @@ int pulse_slicer_pcm(const pulse_data_t *pulses, r_device *device)
         int width = 0;
         int count = 0;
         while (n < pulses->num_pulses
-                && (int)(pulses->pulse[n] * f_short + 0.5) == 1
-                && (int)(pulses->gap[n] * f_long + 0.5) == 1) {
+                && slice_count(pulses->pulse[n], r_short) == 1
+                && slice_count(pulses->gap[n], r_long) == 1) {
             width += pulses->pulse[n] + pulses->gap[n];
             count += 2;
             n++;
         }
         // require at least min_count full bits preamble
         if (count >= min_count) {
-            f_short = f_long = (float)count / width;
+            r_short = r_long = slice_reciprocal(count, width);
             min_count = count;
             preamble_len = count;
             if (device->verbose > 1) {
                 float to_us = 1e6 / pulses->sample_rate;
                 fprintf(stderr, "Exact bit width (in us) is %.2f vs %.2f, %d bit preamble\n",
-                        to_us / f_short, to_us * s_short, count);
+                        to_us * width / count, to_us * s_short, count);
             }
         }
     }
@@ -192,30 +499,28 @@ int pulse_slicer_pcm(const pulse_data_t *pulses, r_device *device)
     }
     // require at least 10 bits measured
     if (nrz_count > 20) {
-        f_short = f_long = (float)nrz_count / nrz_width;
+        r_short = r_long = slice_reciprocal(nrz_count, nrz_width);
         if (device->verbose > 1) {
             float to_us = 1e6 / pulses->sample_rate;
             fprintf(stderr, "%s: Exact bit width (in us) is %.2f vs %.2f, %d bit measured\n", device->name,
-                    to_us / f_short, to_us * s_short, nrz_count);
+                    to_us * nrz_width / nrz_count, to_us * s_short, nrz_count);
         }
     }
 
     for (unsigned n = 0; n < pulses->num_pulses; ++n) {
         // Determine number of high bit periods for NRZ coding, where bits may not be separated
-        int highs = (pulses->pulse[n]) * f_short + 0.5;
+        int highs = slice_count(pulses->pulse[n], r_short);
         // Determine number of low bit periods in current gap length (rounded)
         // for RZ subtract the nominal bit-gap
-        int lows = (pulses->gap[n] + s_short - s_long) * f_long + 0.5;
+        int lows = slice_count(pulses->gap[n] + s_short - s_long, r_long);
 
         // Add run of ones (1 for RZ, many for NRZ)
-        for (int i = 0; i < highs; ++i) {
-            bitbuffer_add_bit(&bits, 1);
-        }
+        if (highs > 0)
+            bitbuffer_add_run(&bits, 1, highs);
         // Add run of zeros, handle possibly negative "lows" gracefully
         lows = MIN(lows, max_zeros); // Don't overflow at end of message
-        for (int i = 0; i < lows; ++i) {
-            bitbuffer_add_bit(&bits, 0);
-        }
+        if (lows > 0)
+            bitbuffer_add_run(&bits, 0, lows);
 
         // Validate data
         if ((s_short != s_long)                                       // Only for RZ coding
@@ -227,20 +532,23 @@ int pulse_slicer_pcm(const pulse_data_t *pulses, r_device *device)
                         n, pulses->pulse[n], pulses->gap[n],
                         pulses->pulse[n] + pulses->gap[n]);
             }
-            bitbuffer_clear(&bits);
+            bitbuffer_reset(&bits);
         }
 
         // Check for new packet in multipacket
         else if (pulses->gap[n] > gap_limit && pulses->gap[n] <= s_reset) {
             bitbuffer_add_row(&bits);
         }
+        // More rows than the decoder takes, skip the rest of the message
+        if (reject_rows && bits.num_rows > reject_rows)
+            n = slice_message_end(pulses, n, s_reset + 1);
         // End of Message?
         if (((n == pulses->num_pulses - 1)                            // No more pulses? (FSK)
                     || (pulses->gap[n] > s_reset))      // Long silence (OOK)
                 && (bits.bits_per_row[0] > 0 || bits.num_rows > 1)) { // Only if data has been accumulated
 
             events += account_event(device, &bits, __func__);
-            bitbuffer_clear(&bits);
+            bitbuffer_reset(&bits);
         }
     } // for
     return events;
@@ -248,52 +556,20 @@ int pulse_slicer_pcm(const pulse_data_t *pulses, r_device *device)
 
 int pulse_slicer_ppm(const pulse_data_t *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        fprintf(stderr, "sample rate too low for protocol %u \"%s\"\n", device->protocol_num, device->name);
+    struct slice_plan const *plan = slice_plan_get(pulses, device);
+    if (!plan)
         return 0;
-    }
+    int s_reset = plan->s_reset;
 
     int events = 0;
-    bitbuffer_t bits = {0};
+    bitbuffer_t bits;
+    bitbuffer_init(&bits);
 
     // lower and upper bounds (non inclusive)
-    int zero_l, zero_u;
-    int one_l, one_u;
-    int sync_l = 0, sync_u = 0;
-
-    if (s_tolerance > 0) {
-        // precise
-        zero_l = s_short - s_tolerance;
-        zero_u = s_short + s_tolerance;
-        one_l  = s_long - s_tolerance;
-        one_u  = s_long + s_tolerance;
-        if (s_sync > 0) {
-            sync_l = s_sync - s_tolerance;
-            sync_u = s_sync + s_tolerance;
-        }
-    }
-    else {
-        // no sync, short=0, long=1
-        zero_l = 0;
-        zero_u = (s_short + s_long) / 2 + 1;
-        one_l  = zero_u - 1;
-        one_u  = s_gap ? s_gap : s_reset;
-    }
+    int const zero_l = plan->ppm.zero_l, zero_u = plan->ppm.zero_u;
+    int const one_l  = plan->ppm.one_l, one_u = plan->ppm.one_u;
+    int const sync_l = plan->ppm.sync_l, sync_u = plan->ppm.sync_u;
+    unsigned const reject_rows = slice_reject_rows(device);
 
     for (unsigned n = 0; n < pulses->num_pulses; ++n) {
         if (pulses->gap[n] > zero_l && pulses->gap[n] < zero_u) {
@@ -313,13 +589,16 @@ int pulse_slicer_ppm(const pulse_data_t *pulses, r_device *device)
         else if (pulses->gap[n] < s_reset) {
             bitbuffer_add_row(&bits);
         }
+        // More rows than the decoder takes, skip the rest of the message
+        if (reject_rows && bits.num_rows > reject_rows)
+            n = slice_message_end(pulses, n, s_reset);
         // End of Message?
         if (((n == pulses->num_pulses - 1)                            // No more pulses? (FSK)
                     || (pulses->gap[n] >= s_reset))     // Long silence (OOK)
                 && (bits.bits_per_row[0] > 0 || bits.num_rows > 1)) { // Only if data has been accumulated
 
             events += account_event(device, &bits, __func__);
-            bitbuffer_clear(&bits);
+            bitbuffer_reset(&bits);
         }
     } // for pulses
     return events;
@@ -327,78 +606,47 @@ int pulse_slicer_ppm(const pulse_data_t *pulses, r_device *device)
 
 int pulse_slicer_pwm(const pulse_data_t *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        fprintf(stderr, "sample rate too low for protocol %u \"%s\"\n", device->protocol_num, device->name);
+    struct slice_plan const *plan = slice_plan_get(pulses, device);
+    if (!plan)
         return 0;
-    }
+    int s_reset = plan->s_reset;
+    int s_gap   = plan->s_gap;
+    int s_sync  = plan->s_sync;
+    int s_tolerance = plan->s_tolerance;
 
     int events = 0;
-    bitbuffer_t bits = {0};
+    bitbuffer_t bits;
+    bitbuffer_init(&bits);
 
     // lower and upper bounds (non inclusive)
-    int one_l, one_u;
-    int zero_l, zero_u;
-    int sync_l = 0, sync_u = 0;
-
-    if (s_tolerance > 0) {
-        // precise
-        one_l  = s_short - s_tolerance;
-        one_u  = s_short + s_tolerance;
-        zero_l = s_long - s_tolerance;
-        zero_u = s_long + s_tolerance;
-        if (s_sync > 0) {
-            sync_l = s_sync - s_tolerance;
-            sync_u = s_sync + s_tolerance;
+    int const one_l  = plan->pwm.one_l, one_u = plan->pwm.one_u;
+    int const zero_l = plan->pwm.zero_l, zero_u = plan->pwm.zero_u;
+    int const sync_l = plan->pwm.sync_l, sync_u = plan->pwm.sync_u;
+    unsigned const reject_rows = slice_reject_rows(device);
+
+    if (s_tolerance <= 0 && s_sync <= 0 && s_gap <= 0) {
+        // the common case without sync and gap limit: short=1, long=0
+        for (unsigned n = 0; n < pulses->num_pulses; ++n) {
+            int pulse = pulses->pulse[n];
+            if (pulse >= one_u && pulse < INT_MAX)
+                bitbuffer_add_bit(&bits, 0);
+            else if (pulse > 0 && pulse < one_u)
+                bitbuffer_add_bit(&bits, 1);
+            else if (pulse > 0)
+                bitbuffer_add_row(&bits); // Pulse outside specified timing
+
+            // More rows than the decoder takes, skip the rest of the message
+            if (reject_rows && bits.num_rows > reject_rows)
+                n = slice_message_end(pulses, n, s_reset + 1);
+
+            // End of Message?
+            if (((n == pulses->num_pulses - 1) || (pulses->gap[n] > s_reset))
+                    && (bits.num_rows > 0)) {
+                events += account_event(device, &bits, __func__);
+                bitbuffer_reset(&bits);
+            }
         }
-    }
-    else if (s_sync <= 0) {
-        // no sync, short=1, long=0
-        one_l  = 0;
-        one_u  = (s_short + s_long) / 2 + 1;
-        zero_l = one_u - 1;
-        zero_u = INT_MAX;
-    }
-    else if (s_sync < s_short) {
-        // short=sync, middle=1, long=0
-        sync_l = 0;
-        sync_u = (s_sync + s_short) / 2 + 1;
-        one_l  = sync_u - 1;
-        one_u  = (s_short + s_long) / 2 + 1;
-        zero_l = one_u - 1;
-        zero_u = INT_MAX;
-    }
-    else if (s_sync < s_long) {
-        // short=1, middle=sync, long=0
-        one_l  = 0;
-        one_u  = (s_short + s_sync) / 2 + 1;
-        sync_l = one_u - 1;
-        sync_u = (s_sync + s_long) / 2 + 1;
-        zero_l = sync_u - 1;
-        zero_u = INT_MAX;
-    }
-    else {
-        // short=1, middle=0, long=sync
-        one_l  = 0;
-        one_u  = (s_short + s_long) / 2 + 1;
-        zero_l = one_u - 1;
-        zero_u = (s_long + s_sync) / 2 + 1;
-        sync_l = zero_u - 1;
-        sync_u = INT_MAX;
+        return events;
     }
 
     for (unsigned n = 0; n < pulses->num_pulses; ++n) {
@@ -422,12 +670,16 @@ int pulse_slicer_pwm(const pulse_data_t *pulses, r_device *device)
             bitbuffer_add_row(&bits);
         }
 
+        // More rows than the decoder takes, skip the rest of the message
+        if (reject_rows && bits.num_rows > reject_rows)
+            n = slice_message_end(pulses, n, s_reset + 1);
+
         // End of Message?
         if (((n == pulses->num_pulses - 1)                       // No more pulses? (FSK)
                     || (pulses->gap[n] > s_reset)) // Long silence (OOK)
                 && (bits.num_rows > 0)) {                        // Only if data has been accumulated
             events += account_event(device, &bits, __func__);
-            bitbuffer_clear(&bits);
+            bitbuffer_reset(&bits);
         }
         else if (s_gap > 0 && pulses->gap[n] > s_gap
                 && bits.num_rows > 0 && bits.bits_per_row[bits.num_rows - 1] > 0) {
@@ -440,29 +692,18 @@ int pulse_slicer_pwm(const pulse_data_t *pulses, r_device *device)
 
 int pulse_slicer_manchester_zerobit(const pulse_data_t *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        fprintf(stderr, "sample rate too low for protocol %u \"%s\"\n", device->protocol_num, device->name);
+    struct slice_plan const *plan = slice_plan_get(pulses, device);
+    if (!plan)
         return 0;
-    }
+    int s_short = plan->s_short;
+    int s_reset = plan->s_reset;
+    int s_tolerance = plan->s_tolerance;
+    unsigned const reject_rows = slice_reject_rows(device);
 
     int events = 0;
     int time_since_last = 0;
-    bitbuffer_t bits = {0};
+    bitbuffer_t bits;
+    bitbuffer_init(&bits);
 
     // First rising edge is always counted as a zero (Seems to be hardcoded policy for the Oregon Scientific sensors...)
     bitbuffer_add_bit(&bits, 0);
@@ -494,12 +735,16 @@ int pulse_slicer_manchester_zerobit(const pulse_data_t *pulses, r_device *device
             time_since_last += pulses->pulse[n];
         }
 
+        // More rows than the decoder takes, skip the rest of the message
+        if (reject_rows && bits.num_rows > reject_rows)
+            n = slice_message_end(pulses, n, s_reset + 1);
+
         // End of Message?
         if (((n == pulses->num_pulses - 1)                       // No more pulses? (FSK)
                     || (pulses->gap[n] > s_reset)) // Long silence (OOK)
                 && (bits.num_rows > 0)) {                        // Only if data has been accumulated
             events += account_event(device, &bits, __func__);
-            bitbuffer_clear(&bits);
+            bitbuffer_reset(&bits);
             bitbuffer_add_bit(&bits, 0); // Prepare for new message with hardcoded 0
             time_since_last = 0;
         }
@@ -527,27 +772,16 @@ static inline int pulse_slicer_get_symbol(const pulse_data_t *pulses, unsigned i
 
 int pulse_slicer_dmc(const pulse_data_t *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        fprintf(stderr, "sample rate too low for protocol %u \"%s\"\n", device->protocol_num, device->name);
+    struct slice_plan const *plan = slice_plan_get(pulses, device);
+    if (!plan)
         return 0;
-    }
+    int s_short = plan->s_short;
+    int s_long  = plan->s_long;
+    int s_reset = plan->s_reset;
+    int s_tolerance = plan->s_tolerance;
 
-    bitbuffer_t bits = {0};
+    bitbuffer_t bits;
+    bitbuffer_init(&bits);
     int events = 0;
 
     for (unsigned int n = 0; n < pulses->num_pulses * 2; ++n) {
@@ -587,44 +821,33 @@ int pulse_slicer_dmc(const pulse_data_t *pulses, r_device *device)
 
 int pulse_slicer_piwm_raw(const pulse_data_t *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        fprintf(stderr, "sample rate too low for protocol %u \"%s\"\n", device->protocol_num, device->name);
+    struct slice_plan const *plan = slice_plan_get(pulses, device);
+    if (!plan)
         return 0;
-    }
+    int s_short = plan->s_short;
+    int s_long  = plan->s_long;
+    int s_reset = plan->s_reset;
+    int s_tolerance = plan->s_tolerance;
 
-    // precision reciprocal
-    float f_short = device->short_width > 0.0 ? 1.0 / (device->short_width * samples_per_us) : 0;
+    // precision reciprocal, 32.32 fixed-point
+    uint64_t r_short = plan->r_short;
 
     int w;
 
-    bitbuffer_t bits = {0};
+    bitbuffer_t bits;
+    bitbuffer_init(&bits);
     int events = 0;
 
     for (unsigned int n = 0; n < pulses->num_pulses * 2; ++n) {
         int symbol = pulse_slicer_get_symbol(pulses, n);
-        w = symbol * f_short + 0.5;
+        w = slice_count(symbol, r_short);
         if (symbol > s_long) {
             bitbuffer_add_row(&bits);
         }
         else if (abs(symbol - w * s_short) < s_tolerance) {
             // Add w symbols
-            for (; w > 0; --w)
-                bitbuffer_add_bit(&bits, 1 - n % 2);
+            if (w > 0)
+                bitbuffer_add_run(&bits, 1 - n % 2, w);
         }
         else if (symbol < s_reset
                 && bits.num_rows > 0
@@ -649,27 +872,16 @@ int pulse_slicer_piwm_raw(const pulse_data_t *pulses, r_device *device)
 
 int pulse_slicer_piwm_dc(const pulse_data_t *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        fprintf(stderr, "sample rate too low for protocol %u \"%s\"\n", device->protocol_num, device->name);
+    struct slice_plan const *plan = slice_plan_get(pulses, device);
+    if (!plan)
         return 0;
-    }
+    int s_short = plan->s_short;
+    int s_long  = plan->s_long;
+    int s_reset = plan->s_reset;
+    int s_tolerance = plan->s_tolerance;
 
-    bitbuffer_t bits = {0};
+    bitbuffer_t bits;
+    bitbuffer_init(&bits);
     int events = 0;
 
     for (unsigned int n = 0; n < pulses->num_pulses * 2; ++n) {
@@ -705,35 +917,20 @@ int pulse_slicer_piwm_dc(const pulse_data_t *pulses, r_device *device)
 
 int pulse_slicer_nrzs(const pulse_data_t *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        fprintf(stderr, "sample rate too low for protocol %u \"%s\"\n", device->protocol_num, device->name);
+    struct slice_plan const *plan = slice_plan_get(pulses, device);
+    if (!plan)
         return 0;
-    }
+    int s_short = plan->s_short;
+    int s_reset = plan->s_reset;
 
     int events = 0;
-    bitbuffer_t bits = {0};
+    bitbuffer_t bits;
+    bitbuffer_init(&bits);
     int limit = s_short;
 
     for (unsigned n = 0; n < pulses->num_pulses; ++n) {
         if (pulses->pulse[n] > limit) {
-            for (int i = 0 ; i < (pulses->pulse[n]/limit) ; i++) {
-                bitbuffer_add_bit(&bits, 1);
-            }
+            bitbuffer_add_run(&bits, 1, pulses->pulse[n] / limit);
             bitbuffer_add_bit(&bits, 0);
         } else if (pulses->pulse[n] < limit) {
             bitbuffer_add_bit(&bits, 0);
@@ -765,31 +962,18 @@ int pulse_slicer_nrzs(const pulse_data_t *pulses, r_device *device)
 
 int pulse_slicer_osv1(const pulse_data_t *pulses, r_device *device)
 {
-    float samples_per_us = pulses->sample_rate / 1.0e6;
-
-    int s_short = device->short_width * samples_per_us;
-    int s_long  = device->long_width * samples_per_us;
-    int s_reset = device->reset_limit * samples_per_us;
-    int s_gap   = device->gap_limit * samples_per_us;
-    int s_sync  = device->sync_width * samples_per_us;
-    int s_tolerance = device->tolerance * samples_per_us;
-
-    // check for rounding to zero
-    if ((device->short_width > 0 && s_short <= 0)
-            || (device->long_width > 0 && s_long <= 0)
-            || (device->reset_limit > 0 && s_reset <= 0)
-            || (device->gap_limit > 0 && s_gap <= 0)
-            || (device->sync_width > 0 && s_sync <= 0)
-            || (device->tolerance > 0 && s_tolerance <= 0)) {
-        fprintf(stderr, "sample rate too low for protocol %u \"%s\"\n", device->protocol_num, device->name);
+    struct slice_plan const *plan = slice_plan_get(pulses, device);
+    if (!plan)
         return 0;
-    }
+    int s_short = plan->s_short;
+    int s_reset = plan->s_reset;
 
     unsigned int n;
     int preamble = 0;
     int events = 0;
     int manbit = 0;
-    bitbuffer_t bits = {0};
+    bitbuffer_t bits;
+    bitbuffer_init(&bits);
     int halfbit_min = s_short / 2;
     int halfbit_max = s_short * 3 / 2;
     int sync_min = 2 * halfbit_max;
@@ -865,3 +1049,101 @@ int pulse_slicer_string(const char *code, r_device *device)
 
     return events;
 }
+
+int pulse_slicer_share(r_device *device, r_device *other)
+{
+    if (!other->slice_cache) {
+        other->slice_cache = calloc(1, sizeof(*other->slice_cache));
+        if (!other->slice_cache) {
+            WARN_CALLOC("pulse_slicer_share()");
+            return -1;
+        }
+        other->slice_cache->refs = 1;
+        slice_cache_add_preamble(other->slice_cache, other);
+    }
+    device->slice_cache = other->slice_cache;
+    device->slice_cache->refs++;
+    slice_cache_add_preamble(device->slice_cache, device);
+    return 0;
+}
+
+void pulse_slicer_release(r_device *device)
+{
+    slice_cache_t *cache = device->slice_cache;
+    device->slice_cache = NULL;
+    if (cache && --cache->refs == 0) {
+        free(cache->entries);
+        free(cache);
+    }
+}
+
+void pulse_slicer_invalidate(r_device *device)
+{
+    if (device->slice_cache)
+        device->slice_cache->valid = 0;
+}
+
+static int slice_shared(const pulse_data_t *pulses, r_device *device, pulse_slicer_fn slicer)
+{
+    slice_cache_t *cache = device->slice_cache;
+    if (!cache || cache->valid < 0)
+        return slicer(pulses, device);
+
+    if (!cache->valid) {
+        cache->num_entries = 0;
+        cache->valid       = 1;
+        cache->recording   = 1;
+        slicer(pulses, device);
+        cache->recording = 0;
+        if (cache->valid < 0)
+            return slicer(pulses, device);
+        for (unsigned i = 0; cache->num_patterns && i < cache->num_entries; ++i) {
+            slice_cache_match(cache, &cache->entries[i]);
+        }
+    }
+
+    // decoders may modify the bits, each decoder that runs gets a copy of the rows in use
+    int events = 0;
+    bitbuffer_t bits;
+    int bits_init = 0;
+    for (unsigned i = 0; i < cache->num_entries; ++i) {
+        bitbuffer_t *cached = &cache->entries[i].bits;
+        if (device->decode_fn && !decoder_length_match(device, cached)) {
+            events += account_event(device, cached, cache->entries[i].demod_name); // only counted
+            continue;
+        }
+        if (device->decode_fn && device->preamble_mask && !(cache->entries[i].preamble_hits & device->preamble_mask)) {
+            events += account_result(device, cached, cache->entries[i].demod_name, DECODE_ABORT_EARLY); // no preamble
+            continue;
+        }
+        if (!bits_init) {
+            bitbuffer_init(&bits);
+            bits_init = 1;
+        }
+        bitbuffer_copy(&bits, cached);
+        if (device->preamble_mask) {
+            device->preamble_matches   = &cache->entries[i].matches;
+            device->preamble_bitbuffer = &bits;
+        }
+        events += account_event(device, &bits, cache->entries[i].demod_name);
+        device->preamble_matches   = NULL;
+        device->preamble_bitbuffer = NULL;
+    }
+    return events;
+}
+
+int pulse_slicer_shared(const pulse_data_t *pulses, r_device *device, pulse_slicer_fn slicer)
+{
+    if (!device->profile)
+        return slice_shared(pulses, device, slicer);
+
+    // the decoder time is accounted separately, see account_event()
+    uint64_t allocs        = alloc_count_get().allocs;
+    uint64_t decode_allocs = device->stats.decode_allocs;
+    double start           = monotonic_time_us();
+    double decode_time     = device->stats.decode_time;
+    int events             = slice_shared(pulses, device, slicer);
+    device->stats.slicer_time += monotonic_time_us() - start - (device->stats.decode_time - decode_time);
+    device->stats.slicer_allocs += alloc_count_get().allocs - allocs - (device->stats.decode_allocs - decode_allocs);
+    return events;
+}
@@ -0,0 +1,190 @@
+/** @file
+    UDP transport of pulse trains, from edge receivers to a central decoder.
+
+    An edge receiver only demodulates and detects the packages, each package is
+    sent as one datagram in the binary pulse data format, a header and the package,
+    see pulse_bin_encode(). The central decoder runs the decoders on the packages
+    of all edges. A package is a few hundred bytes, much less than the samples.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "pulse_udp.h"
+#include "pulse_bin.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+    #if !defined(_WIN32_WINNT) || (_WIN32_WINNT < 0x0600)
+    #undef _WIN32_WINNT
+    #define _WIN32_WINNT 0x0600   /* Needed to pull in 'struct sockaddr_storage' */
+    #endif
+
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <sys/select.h>
+    #include <netdb.h>
+    #include <netinet/in.h>
+
+    #define SOCKET          int
+    #define INVALID_SOCKET  (-1)
+    #define closesocket(x)  close(x)
+#endif
+
+#ifdef ESP32
+    #define gai_strerror strerror
+#endif
+
+/// Largest UDP payload.
+#define PULSE_UDP_MAX_DATAGRAM 65507
+
+struct pulse_udp {
+    SOCKET sock;
+    struct sockaddr_storage addr; ///< the central decoder of a sender
+    socklen_t addr_len;
+    unsigned packages; ///< packages sent or received
+    unsigned dropped;  ///< packages too large to send, or invalid datagrams received
+    uint8_t *buf;      ///< a datagram
+    char peer[PULSE_UDP_PEER]; ///< the numeric host of the sender of the last datagram received
+};
+
+/// Open a datagram socket for the address, bound for the receiver.
+static pulse_udp_t *pulse_udp_open(char const *host, char const *port, int bind_addr)
+{
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) {
+        fprintf(stderr, "pulse_udp: WSAStartup failed\n");
+        return NULL;
+    }
+#endif
+    pulse_udp_t *udp = calloc(1, sizeof(*udp));
+    if (!udp) {
+        WARN_CALLOC("pulse_udp_open()");
+        return NULL;
+    }
+    udp->sock = INVALID_SOCKET;
+    udp->buf  = malloc(PULSE_UDP_MAX_DATAGRAM);
+    if (!udp->buf) {
+        WARN_MALLOC("pulse_udp_open()");
+        pulse_udp_free(udp);
+        return NULL;
+    }
+
+    struct addrinfo hints, *res0;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = PF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags    = bind_addr ? AI_PASSIVE : AI_ADDRCONFIG;
+    int error         = getaddrinfo(host, port, &hints, &res0);
+    if (error) {
+        fprintf(stderr, "pulse_udp: %s\n", gai_strerror(error));
+        pulse_udp_free(udp);
+        return NULL;
+    }
+    for (struct addrinfo *res = res0; res; res = res->ai_next) {
+        SOCKET sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        if (sock == INVALID_SOCKET)
+            continue;
+        if (bind_addr && bind(sock, res->ai_addr, res->ai_addrlen) != 0) {
+            closesocket(sock);
+            continue;
+        }
+        udp->sock = sock;
+        memcpy(&udp->addr, res->ai_addr, res->ai_addrlen);
+        udp->addr_len = res->ai_addrlen;
+        break;
+    }
+    freeaddrinfo(res0);
+    if (udp->sock == INVALID_SOCKET) {
+        fprintf(stderr, "pulse_udp: can not %s %s port %s\n", bind_addr ? "bind" : "open a socket for", host ? host : "*", port);
+        pulse_udp_free(udp);
+        return NULL;
+    }
+    return udp;
+}
+
+pulse_udp_t *pulse_udp_sender_create(char const *host, char const *port)
+{
+    return pulse_udp_open(host, port, 0);
+}
+
+pulse_udp_t *pulse_udp_receiver_create(char const *host, char const *port)
+{
+    return pulse_udp_open(host, port, 1);
+}
+
+void pulse_udp_send(pulse_udp_t *udp, pulse_data_t const *data)
+{
+    size_t len = pulse_bin_encode(udp->buf, PULSE_UDP_MAX_DATAGRAM, data->sample_rate, data);
+    if (!len) {
+        if (data->num_pulses && !udp->dropped++)
+            fprintf(stderr, "pulse_udp: dropped a package of %u pulses, too large for a datagram\n", data->num_pulses);
+        return;
+    }
+    if (sendto(udp->sock, (char const *)udp->buf, len, 0, (struct sockaddr *)&udp->addr, udp->addr_len) < 0) {
+        udp->dropped++;
+        return; // e.g. the central decoder is not up yet, nothing is queued
+    }
+    udp->packages++;
+}
+
+int pulse_udp_receive(pulse_udp_t *udp, pulse_data_t *data, int timeout_ms)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(udp->sock, &fds);
+    struct timeval timeout = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    int ready = select((int)udp->sock + 1, &fds, NULL, NULL, &timeout);
+    if (ready <= 0)
+        return ready; // timeout, or interrupted
+
+    struct sockaddr_storage peer;
+    socklen_t peer_len = sizeof(peer);
+    int len = recvfrom(udp->sock, (char *)udp->buf, PULSE_UDP_MAX_DATAGRAM, 0, (struct sockaddr *)&peer, &peer_len);
+    if (len <= 0 || pulse_bin_decode(udp->buf, len, data) < 0) {
+        udp->dropped++;
+        return -1;
+    }
+    if (getnameinfo((struct sockaddr *)&peer, peer_len, udp->peer, sizeof(udp->peer), NULL, 0, NI_NUMERICHOST) != 0)
+        snprintf(udp->peer, sizeof(udp->peer), "unknown");
+    udp->packages++;
+    return 1;
+}
+
+char const *pulse_udp_peer(pulse_udp_t const *udp)
+{
+    return udp->peer;
+}
+
+void pulse_udp_counts(pulse_udp_t const *udp, unsigned *packages, unsigned *dropped)
+{
+    *packages = udp->packages;
+    *dropped  = udp->dropped;
+}
+
+void pulse_udp_free(pulse_udp_t *udp)
+{
+    if (!udp)
+        return;
+    if (udp->sock != INVALID_SOCKET)
+        closesocket(udp->sock);
+    free(udp->buf);
+    free(udp);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
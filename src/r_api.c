@@ -25,21 +25,50 @@
 #include "pulse_slicer.h"
 #include "pulse_detect_fsk.h"
 #include "sdr.h"
+#include "channelizer.h"
+#include "decimator.h"
+#include "huge_buf.h"
+#include "hop_sched.h"
+#include "load_shed.h"
+#include "agc.h"
+#include "spectrum.h"
+#include "pulse_recorder.h"
+#include "watchdog.h"
+#include "decoder_pool.h"
 #include "data.h"
 #include "data_tag.h"
 #include "list.h"
 #include "optparse.h"
 #include "output_file.h"
+#include "output_arrow.h"
+#include "output_sqlite.h"
 #include "output_udp.h"
 #include "output_mqtt.h"
 #include "output_influx.h"
+#include "output_nats.h"
 #include "output_trigger.h"
 #include "output_rtltcp.h"
+#include "output_queue.h"
+#include "output_filter.h"
+#include "output_route.h"
+#include "unit_convert.h"
+#include "net_thread.h"
+#include "output_shm.h"
+#include "shm_ring.h"
 #include "write_sigrok.h"
+#include "compress_pipe.h"
+#include "pulse_bin.h"
+#include "pulse_udp.h"
+#include "pulse_arrow.h"
+#include "sample_index.h"
 #include "mongoose.h"
 #include "compat_time.h"
 #include "fatal.h"
 #include "http_server.h"
+#include "metrics.h"
+#include "trace_event.h"
+#include "alloc_count.h"
+#include "usdt.h"
 
 #ifdef _WIN32
 #include <io.h>
@@ -145,15 +174,19 @@ void r_init_cfg(r_cfg_t *cfg)
     cfg->out_block_size  = DEFAULT_BUF_LENGTH;
     cfg->samp_rate       = DEFAULT_SAMPLE_RATE;
     cfg->conversion_mode = CONVERT_NATIVE;
+    cfg->async_buf_number      = DEFAULT_ASYNC_BUF_NUMBER;
     cfg->fsk_pulse_detect_mode = FSK_PULSE_DETECT_AUTO;
 
     list_ensure_size(&cfg->in_files, 100);
     list_ensure_size(&cfg->output_handler, 16);
 
     // collect devices list, this should be a module
+    // a decoder not built keeps its protocol number, as a hidden entry
     r_device r_devices[] = {
 #define DECL(name) name,
+#define OMIT(decoder) {.name = #decoder " (not built)", .disabled = 3},
             DEVICES
+#undef OMIT
 #undef DECL
     };
 
@@ -171,9 +204,17 @@ void r_init_cfg(r_cfg_t *cfg)
     if (!cfg->demod)
         FATAL_CALLOC("r_init_cfg()");
 
+    cfg->metrics = calloc(1, sizeof(*cfg->metrics));
+    if (!cfg->metrics)
+        FATAL_CALLOC("r_init_cfg()");
+
     cfg->demod->level_limit = 0.0;
     cfg->demod->min_level = -12.1442;
     cfg->demod->min_snr = 9.0;
+    cfg->demod->bands = 1;
+    cfg->settle_ms = -1; // the default if hopping
+    cfg->watchdog_ms      = WATCHDOG_STALL_MS;
+    cfg->watchdog_warn_ms = WATCHDOG_WARN_MS;
 
     // note: this should be optional
     cfg->demod->pulse_detect = pulse_detect_create();
@@ -197,6 +238,84 @@ r_cfg_t *r_create_cfg(void)
     return cfg;
 }
 
+static void free_demod_buffers(struct dm_state *demod)
+{
+    huge_buf_free(demod->am_buf);
+    huge_buf_free(demod->fm_buf);
+    huge_buf_free(demod->temp_buf);
+    huge_buf_free(demod->f32_buf);
+    huge_buf_free(demod->iq_buf);
+    huge_buf_free(demod->am8_buf);
+    demod->am_buf   = NULL;
+    demod->fm_buf   = NULL;
+    demod->temp_buf = NULL;
+    demod->f32_buf  = NULL;
+    demod->iq_buf   = NULL;
+    demod->am8_buf  = NULL;
+    demod->buf_len  = 0;
+}
+
+/// Allocate a zeroed sample buffer if there is none yet.
+static void *sample_buffer(void *buf, unsigned long n_samples, size_t sample_bytes)
+{
+    if (buf)
+        return buf;
+    buf = huge_buf_create(n_samples * sample_bytes);
+    if (!buf)
+        FATAL_CALLOC("reserve_demod_buffers()");
+    return buf;
+}
+
+void reserve_demod_buffers(r_cfg_t *cfg, struct dm_state *demod, unsigned long n_samples)
+{
+    if (n_samples > demod->buf_len) {
+        free_demod_buffers(demod);
+        demod->buf_len = (n_samples + 4095) & ~4095UL; // avoid regrowing for slightly varying lengths
+    }
+    unsigned long len = demod->buf_len;
+    int grown         = !demod->am_buf;
+
+    demod->am_buf   = sample_buffer(demod->am_buf, len, sizeof(*demod->am_buf));
+    demod->fm_buf   = sample_buffer(demod->fm_buf, len, sizeof(*demod->fm_buf)); // the pulse detector reads zeros without FM
+    demod->temp_buf = sample_buffer(demod->temp_buf, len, sizeof(*demod->temp_buf));
+    if (demod->iq_correct_state.enabled && !demod->iq_buf)
+        demod->iq_buf = sample_buffer(NULL, len, 2 * sizeof(*demod->iq_buf));
+    if (demod->env8 && !demod->am8_buf)
+        demod->am8_buf = sample_buffer(NULL, len, sizeof(*demod->am8_buf));
+    if (cfg->bench_passes && !demod->f32_buf)
+        demod->f32_buf = sample_buffer(NULL, len, 2 * sizeof(*demod->f32_buf)); // used as scratch
+
+    if (grown && cfg->verbosity) {
+        unsigned long bytes = len * (sizeof(*demod->am_buf) + sizeof(*demod->fm_buf) + sizeof(*demod->temp_buf)
+                + (demod->iq_buf ? 2 * sizeof(*demod->iq_buf) : 0)
+                + (demod->am8_buf ? sizeof(*demod->am8_buf) : 0)
+                + (demod->f32_buf ? 2 * sizeof(*demod->f32_buf) : 0));
+        fprintf(stderr, "Sample buffers for %lu samples use %lu kB%s.\n", len, bytes / 1024,
+                huge_buf_enabled() ? " with huge pages" : "");
+    }
+}
+
+static void free_channel_demod(struct dm_state *demod)
+{
+    pulse_analyzer_stats_free(demod->analyzer_stats);
+    free_demod_buffers(demod);
+    pulse_detect_free(demod->pulse_detect);
+    pulse_data_free(&demod->pulse_data);
+    pulse_data_free(&demod->fsk_pulse_data);
+    free(demod);
+}
+
+static void free_sdr_input(sdr_input_t *input)
+{
+    if (input->dev) {
+        sdr_deactivate(input->dev);
+        sdr_close(input->dev);
+    }
+    if (input->demod)
+        free_channel_demod(input->demod);
+    free(input);
+}
+
 void r_free_cfg(r_cfg_t *cfg)
 {
     if (cfg->dev) {
@@ -206,27 +325,83 @@ void r_free_cfg(r_cfg_t *cfg)
 
     free(cfg->gain_str);
 
+    second_chance_free(cfg->second_chance, NULL); // the worker uses clones of the decoders
+    cfg->second_chance = NULL;
+
+    sample_dump_free(cfg->demod->sample_dump); // writes the queued buffers
+    cfg->demod->sample_dump = NULL;
     for (void **iter = cfg->demod->dumper.elems; iter && *iter; ++iter) {
-        file_info_t const *dumper = *iter;
+        file_info_t *dumper = *iter;
+        pulse_arrow_close(dumper->arrow); // writes the footer
+        dumper->arrow = NULL;
         if (dumper->file && (dumper->file != stdout))
             fclose(dumper->file);
     }
     list_free_elems(&cfg->demod->dumper, free);
 
     list_free_elems(&cfg->demod->r_devs, (list_elem_free_fn)free_protocol);
+    decoder_dispatch_free(&cfg->demod->dispatch);
+    for (unsigned i = 0; i < BAND_COUNT; ++i)
+        decoder_dispatch_free(&cfg->demod->band_dispatch[i]);
 
     if (cfg->demod->am_analyze)
         am_analyze_free(cfg->demod->am_analyze);
 
+    pulse_analyzer_stats_free(cfg->demod->analyzer_stats); // prints the remaining summary
+
+    if (cfg->demod->samp_grab)
+        samp_grab_free(cfg->demod->samp_grab);
+
+    decoder_pool_free(cfg->demod->decoder_pool);
+    decoder_pool_free(cfg->demod->demod_pool);
+    for (unsigned i = 0; i < cfg->demod->hop_states_len; ++i) {
+        if (i != cfg->demod->hop_index) // the current one is in use
+            pulse_detect_free(cfg->demod->hop_states[i].pulse_detect);
+    }
+    free(cfg->demod->hop_states);
     pulse_detect_free(cfg->demod->pulse_detect);
+    pulse_data_free(&cfg->demod->pulse_data);
+    pulse_data_free(&cfg->demod->fsk_pulse_data);
+    free_demod_buffers(cfg->demod);
 
     free(cfg->demod);
 
+    hop_sched_free(cfg->hop_sched);
+    load_shed_free(cfg->load_shed);
+    free(cfg->urgent_models);
+    event_fusion_free(cfg->event_fusion);
+    agc_free(cfg->agc);
+    spectrum_free(cfg->spectrum);
+    pulse_recorder_free(cfg->pulse_recorder);
+    trace_event_close(cfg->trace);
+    free(cfg->metrics);
+
+    list_free_elems(&cfg->channel_demods, (list_elem_free_fn)free_channel_demod);
+    list_free_elems(&cfg->sdr_inputs, (list_elem_free_fn)free_sdr_input);
+    channelizer_free(cfg->channelizer);
+    free(cfg->channelizer_device);
+    free(cfg->checkpoint_path);
+    decimator_free(cfg->decimator);
+
     free(cfg->devices);
 
     list_free_elems(&cfg->raw_handler, (list_elem_free_fn)raw_output_free);
+    list_free_elems(&cfg->pulse_handler, (list_elem_free_fn)pulse_udp_free);
+
+    list_free_elems(&cfg->file_outputs, NULL);
+    list_free_elems(&cfg->flush_outputs, NULL);
+
+    // the network outputs are printed here from now on
+    net_thread_free(cfg->net_thread);
+    cfg->net_thread = NULL;
+    list_free_elems(&cfg->net_outputs, NULL);
+    watchdog_free(cfg->watchdog); // after the network thread, it reports the counts
+    cfg->watchdog = NULL;
 
     list_free_elems(&cfg->output_handler, (list_elem_free_fn)data_output_free);
+    output_route_free(cfg->output_route);
+    cfg->output_route = NULL;
+    list_free_elems(&cfg->output_filters, (list_elem_free_fn)output_filter_free);
 
     list_free_elems(&cfg->data_tags, (list_elem_free_fn)data_tag_free);
 
@@ -240,6 +415,110 @@ void r_free_cfg(r_cfg_t *cfg)
 
 /* device decoder protocols */
 
+/// Width bin of a duration in half octaves, twice the log2 in us, all above 2^15.5 us are in bin 31.
+static unsigned width_bin_us(uint64_t us)
+{
+    if (us >= 46341)
+        return 31;
+    unsigned bin = 0;
+    while (bin < 30 && us >> (bin / 2 + 1))
+        bin += 2;
+    // upper half of the octave if above sqrt(2) times the octave start, i.e. us^2 >= 2 * 4^(bin/2)
+    if (bin < 31 && us * us >= 2ull << bin)
+        bin++;
+    return bin;
+}
+
+/// Mask of the width bins a decoder's timing can match, from half the shortest to twice the longest timing.
+static uint32_t decoder_timing_bins(r_device const *r_dev)
+{
+    float timings[] = {r_dev->short_width, r_dev->long_width, r_dev->sync_width};
+    float lo = 0.0f;
+    float hi = 0.0f;
+    for (unsigned i = 0; i < sizeof(timings) / sizeof(*timings); ++i) {
+        if (timings[i] > 0.0f && (lo == 0.0f || timings[i] < lo))
+            lo = timings[i];
+        if (timings[i] > hi)
+            hi = timings[i];
+    }
+    if (lo == 0.0f)
+        return 0; // no timing, always run
+    unsigned lo_bin = width_bin_us(lo / 2);
+    unsigned hi_bin = width_bin_us(hi * 2);
+    // NRZ runs of equal bits are any multiple of the bit width, only short widths can't match
+    if (r_dev->modulation == OOK_PULSE_PCM || r_dev->modulation == FSK_PULSE_PCM || r_dev->modulation == OOK_PULSE_NRZS)
+        hi_bin = 31;
+    uint32_t bins = 0;
+    for (unsigned bin = lo_bin; bin <= hi_bin; ++bin)
+        bins |= 1u << bin;
+    return bins;
+}
+
+/// Histogram of the package widths in bins of width_bin_us(), the final gap is not included.
+static unsigned pulse_data_width_hist(pulse_data_t const *pulse_data, unsigned hist[32])
+{
+    unsigned total = 0;
+    for (unsigned n = 0; n < pulse_data->num_pulses; ++n) {
+        hist[width_bin_us((uint64_t)pulse_data->pulse[n] * 1000000 / pulse_data->sample_rate)]++;
+        total++;
+        if (n + 1 < pulse_data->num_pulses) {
+            hist[width_bin_us((uint64_t)pulse_data->gap[n] * 1000000 / pulse_data->sample_rate)]++;
+            total++;
+        }
+    }
+    return total;
+}
+
+/// Check if at least a quarter of the package widths are within the timing bins of a decoder.
+static int decoder_timing_match(r_device const *r_dev, unsigned const hist[32], unsigned total)
+{
+    if (!r_dev->timing_bins || !total)
+        return 1;
+    unsigned count = 0;
+    for (unsigned bin = 0; bin < 32; ++bin) {
+        if (r_dev->timing_bins >> bin & 1)
+            count += hist[bin];
+    }
+    return count * 4 >= total;
+}
+
+/// Check if two decoders slice a package into the same bits.
+static int same_slicing(r_device const *a, r_device const *b)
+{
+    return a->modulation == b->modulation
+            && a->short_width == b->short_width
+            && a->long_width == b->long_width
+            && a->reset_limit == b->reset_limit
+            && a->gap_limit == b->gap_limit
+            && a->sync_width == b->sync_width
+            && a->tolerance == b->tolerance;
+}
+
+/// Add a decoder to the decoders of the demod state, the output goes to the config.
+static void push_protocol(r_cfg_t *cfg, r_device *p)
+{
+    p->output_fn        = data_acquired_handler;
+    p->output_record_fn = record_acquired_handler;
+    p->output_ctx       = cfg;
+
+    // index the timing to skip packages that can not match, see -Y timingskip
+    p->timing_bins = decoder_timing_bins(p);
+
+    // share the sliced bits with a decoder of the same slicing parameters, unless the slicer is verbose
+    for (void **iter = cfg->demod->r_devs.elems; p->verbose <= 1 && iter && *iter; ++iter) {
+        r_device *r_dev_i = *iter;
+        if (r_dev_i->verbose <= 1 && same_slicing(r_dev_i, p)) {
+            pulse_slicer_share(p, r_dev_i);
+            break;
+        }
+    }
+
+    list_push(&cfg->demod->r_devs, p);
+    decoder_dispatch_invalidate(cfg->demod);
+    if (p->modulation >= FSK_DEMOD_MIN_VAL)
+        cfg->demod->enable_FM_demod = 1; // FSK decoders need the FM demodulation
+}
+
 void register_protocol(r_cfg_t *cfg, r_device *r_dev, char *arg)
 {
     // use arg of 'v', 'vv', 'vvv' as device verbosity
@@ -255,45 +534,114 @@ void register_protocol(r_cfg_t *cfg, r_device *r_dev, char *arg)
 
     // use any other arg as device parameter
     r_device *p;
+    if (!r_dev->create_fn && arg && *arg) {
+        fprintf(stderr, "Protocol [%u] \"%s\" does not take arguments \"%s\"!\n", r_dev->protocol_num, r_dev->name, arg);
+    }
     if (r_dev->create_fn) {
         p = r_dev->create_fn(arg);
+        if (!p)
+            FATAL("register_protocol() could not create the decoder");
+        p->protocol_num = r_dev->protocol_num; // the template is not numbered
+    }
+    else if (!r_dev->in_table && r_dev >= cfg->devices && r_dev < cfg->devices + cfg->num_r_devices) {
+        // the devices table is a copy for this config, the first registration uses the entry in place
+        p           = r_dev;
+        p->in_table = 1;
     }
     else {
-        if (arg && *arg) {
-            fprintf(stderr, "Protocol [%u] \"%s\" does not take arguments \"%s\"!\n", r_dev->protocol_num, r_dev->name, arg);
-        }
         p  = malloc(sizeof(*p));
         if (!p)
             FATAL_CALLOC("register_protocol()");
         *p = *r_dev; // copy
+        p->in_table    = 0;
+        p->slice_cache = NULL; // the entry might be registered already
+        p->record      = NULL;
     }
 
     p->verbose      = dev_verbose ? dev_verbose : (cfg->verbosity > 0 ? cfg->verbosity - 1 : 0);
     p->verbose_bits = cfg->verbose_bits;
+    p->profile      = cfg->report_profile;
+    p->time_budget  = cfg->decode_budget;
+    p->unit_fields  = unit_fields_create((char const *const *)p->fields);
+
+    p->create_args = NULL;
+    if (r_dev->create_fn && arg) {
+        p->create_args = strdup(arg);
+        if (!p->create_args)
+            FATAL_STRDUP("register_protocol()");
+    }
 
-    p->output_fn  = data_acquired_handler;
-    p->output_ctx = cfg;
-
-    list_push(&cfg->demod->r_devs, p);
+    push_protocol(cfg, p);
 
     if (cfg->verbosity) {
         fprintf(stderr, "Registering protocol [%u] \"%s\"\n", r_dev->protocol_num, r_dev->name);
     }
 }
 
+/// Create a registered decoder again in place, a decoder from create_fn() gets its own context, others share it.
+static void clone_protocol(r_device *p, r_device const *r_dev)
+{
+    if (r_dev->create_fn) {
+        r_device *created = r_dev->create_fn(r_dev->create_args);
+        if (!created)
+            FATAL("clone_protocol() could not create the decoder");
+        *p = *created; // keep the context, the decoder moves to the block
+        free(created);
+        p->create_args = NULL;
+        if (r_dev->create_args) {
+            p->create_args = strdup(r_dev->create_args);
+            if (!p->create_args)
+                FATAL_STRDUP("clone_protocol()");
+        }
+    }
+    else {
+        *p = *r_dev; // copy
+    }
+
+    p->in_table     = 0;
+    p->protocol_num = r_dev->protocol_num;
+    p->verbose      = r_dev->verbose;
+    p->verbose_bits = r_dev->verbose_bits;
+    p->profile      = r_dev->profile;
+    p->time_budget  = r_dev->time_budget;
+    p->unit_fields  = r_dev->unit_fields;
+    p->slice_cache  = NULL;
+    p->record       = NULL;
+}
+
 void free_protocol(r_device *r_dev)
 {
+    pulse_slicer_release(r_dev);
+    data_record_free(r_dev->record);
+    r_dev->record = NULL;
+    if (r_dev->in_table) {
+        r_dev->in_table = 0; // the entry is owned by the devices table
+        return;
+    }
     // free(r_dev->name);
+    unit_fields_free(r_dev->unit_fields);
     free(r_dev->decode_ctx);
+    free(r_dev->create_args);
     free(r_dev);
 }
 
+/// Release a decoder from clone_protocol(), the block of the decoders is freed by the caller.
+static void release_cloned_protocol(r_device *r_dev)
+{
+    pulse_slicer_release(r_dev);
+    data_record_free(r_dev->record);
+    if (r_dev->create_fn)
+        free(r_dev->decode_ctx); // otherwise shared with the registered decoder
+    free(r_dev->create_args);
+}
+
 void unregister_protocol(r_cfg_t *cfg, r_device *r_dev)
 {
     for (size_t i = 0; i < cfg->demod->r_devs.len; ++i) { // list might contain NULLs
         r_device *p = cfg->demod->r_devs.elems[i];
         if (!strcmp(p->name, r_dev->name)) {
             list_remove(&cfg->demod->r_devs, i, (list_elem_free_fn)free_protocol);
+            decoder_dispatch_invalidate(cfg->demod);
             i--; // so we don't skip the next elem now shifted down
         }
     }
@@ -338,6 +686,13 @@ void calc_rssi_snr(r_cfg_t *cfg, pulse_data_t *pulse_data)
         pulse_data->noise_db = 20.0f * log10f(ook_low_estimate) - 84.2884f; // 20*log10f(16384.0f)
         pulse_data->snr_db   = 20.0f * log10f(asnr);
     }
+    pulse_data->levels_due = 0;
+}
+
+void ensure_rssi_snr(r_cfg_t *cfg, pulse_data_t *pulse_data)
+{
+    if (pulse_data->levels_due)
+        calc_rssi_snr(cfg, pulse_data);
 }
 
 char *time_pos_str(r_cfg_t *cfg, unsigned samples_ago, char *buf)
@@ -372,6 +727,7 @@ char *time_pos_str(r_cfg_t *cfg, unsigned samples_ago, char *buf)
 // well-known fields "time", "msg" and "codes" are used to output general decoder messages
 // well-known field "bits" is only used when verbose bits (-M bits) is requested
 // well-known field "tag" is only used when output tagging is requested
+// well-known field "retried" is only used when retrying the unclaimed packages is requested
 // well-known field "protocol" is only used when model protocol is requested
 // well-known field "description" is only used when model description is requested
 // well-known fields "mod", "freq", "freq1", "freq2", "rssi", "snr", "noise" are used by meta report option
@@ -410,6 +766,9 @@ char const **well_known_output_fields(r_cfg_t *cfg)
         list_push(&field_list, "snr");
         list_push(&field_list, "noise");
     }
+    if (cfg->retry_packages) {
+        list_push(&field_list, "retried");
+    }
 
     return (char const **)field_list.elems;
 }
@@ -470,118 +829,487 @@ char const **determine_csv_fields(r_cfg_t *cfg, char const *const *well_known, i
     return (char const **)field_list.elems;
 }
 
-int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data)
+/// Get the slicer of the modulation of a decoder, NULL if the modulation is unknown.
+static pulse_slicer_fn decoder_slicer(unsigned modulation)
 {
-    int p_events = 0;
+    switch (modulation) {
+    case OOK_PULSE_PCM:
+    // case OOK_PULSE_RZ:
+        return pulse_slicer_pcm;
+    case OOK_PULSE_PPM:
+        return pulse_slicer_ppm;
+    case OOK_PULSE_PWM:
+        return pulse_slicer_pwm;
+    case OOK_PULSE_MANCHESTER_ZEROBIT:
+        return pulse_slicer_manchester_zerobit;
+    case OOK_PULSE_PIWM_RAW:
+        return pulse_slicer_piwm_raw;
+    case OOK_PULSE_PIWM_DC:
+        return pulse_slicer_piwm_dc;
+    case OOK_PULSE_DMC:
+        return pulse_slicer_dmc;
+    case OOK_PULSE_PWM_OSV1:
+        return pulse_slicer_osv1;
+    case OOK_PULSE_NRZS:
+        return pulse_slicer_nrzs;
+    // FSK decoders
+    case FSK_PULSE_PCM:
+        return pulse_slicer_pcm;
+    case FSK_PULSE_PWM:
+        return pulse_slicer_pwm;
+    case FSK_PULSE_MANCHESTER_ZEROBIT:
+        return pulse_slicer_manchester_zerobit;
+    default:
+        return NULL;
+    }
+}
 
-    unsigned next_priority = 0; // next smallest on each loop through decoders
-    // run all decoders of each priority, stop if an event is produced
-    for (unsigned priority = 0; !p_events && priority < UINT_MAX; priority = next_priority) {
-        next_priority = UINT_MAX;
-        for (void **iter = r_devs->elems; iter && *iter; ++iter) {
-            r_device *r_dev = *iter;
-
-            // Find next smallest priority
-            if (r_dev->priority > priority && r_dev->priority < next_priority)
-                next_priority = r_dev->priority;
-            // Run only current priority
-            if (r_dev->priority != priority)
-                continue;
+/// Build the dispatch of the decoders, each priority keeps the list order.
+static void decoder_dispatch_build(decoder_dispatch_t *dispatch, list_t *r_devs)
+{
+    unsigned band = dispatch->band;
+    int timing    = dispatch->timing;
+    decoder_dispatch_free(dispatch);
+    dispatch->band   = band;
+    dispatch->timing = timing;
+    size_t size   = r_devs->len ? r_devs->len : 1;
+    dispatch->ook = calloc(size, sizeof(*dispatch->ook));
+    if (!dispatch->ook)
+        FATAL_CALLOC("decoder_dispatch_build()");
+    dispatch->fsk = calloc(size, sizeof(*dispatch->fsk));
+    if (!dispatch->fsk)
+        FATAL_CALLOC("decoder_dispatch_build()");
 
-            switch (r_dev->modulation) {
-            case OOK_PULSE_PCM:
-            // case OOK_PULSE_RZ:
-                p_events += pulse_slicer_pcm(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_PPM:
-                p_events += pulse_slicer_ppm(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_PWM:
-                p_events += pulse_slicer_pwm(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_MANCHESTER_ZEROBIT:
-                p_events += pulse_slicer_manchester_zerobit(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_PIWM_RAW:
-                p_events += pulse_slicer_piwm_raw(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_PIWM_DC:
-                p_events += pulse_slicer_piwm_dc(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_DMC:
-                p_events += pulse_slicer_dmc(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_PWM_OSV1:
-                p_events += pulse_slicer_osv1(pulse_data, r_dev);
-                break;
-            case OOK_PULSE_NRZS:
-                p_events += pulse_slicer_nrzs(pulse_data, r_dev);
-                break;
-            // FSK decoders
-            case FSK_PULSE_PCM:
-            case FSK_PULSE_PWM:
-            case FSK_PULSE_MANCHESTER_ZEROBIT:
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev        = *iter;
+        pulse_slicer_fn slicer = decoder_slicer(r_dev->modulation);
+        if (!slicer) {
+            fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
+            continue;
+        }
+        if (band && r_dev->bands && !(r_dev->bands & band))
+            continue; // meant for another band
+        int fsk                  = r_dev->modulation >= FSK_DEMOD_MIN_VAL;
+        decoder_entry_t *entries = fsk ? dispatch->fsk : dispatch->ook;
+        unsigned *len            = fsk ? &dispatch->fsk_len : &dispatch->ook_len;
+        // insert after the decoders of the same or a lower priority
+        unsigned i = *len;
+        for (; i > 0 && entries[i - 1].r_dev->priority > r_dev->priority; --i) {
+            entries[i] = entries[i - 1];
+        }
+        entries[i] = (decoder_entry_t){.r_dev = r_dev, .slicer = slicer};
+        (*len)++;
+    }
+    dispatch->valid = 1;
+}
+
+void decoder_dispatch_free(decoder_dispatch_t *dispatch)
+{
+    free(dispatch->ook);
+    free(dispatch->fsk);
+    *dispatch = (decoder_dispatch_t){0};
+}
+
+void decoder_dispatch_invalidate(struct dm_state *demod)
+{
+    demod->dispatch.valid = 0;
+    for (unsigned i = 0; i < BAND_COUNT; ++i)
+        demod->band_dispatch[i].valid = 0;
+    // the cached packages refer to the decoders
+    memset(demod->package_cache, 0, sizeof(demod->package_cache));
+}
+
+/// Get the index of the band of a frequency, -1 if outside the bands.
+static int frequency_band(uint32_t frequency)
+{
+    static struct {
+        uint32_t low;
+        uint32_t high;
+    } const bands[BAND_COUNT] = {
+            {300000000, 350000000}, // BAND_315
+            {420000000, 450000000}, // BAND_433
+            {860000000, 880000000}, // BAND_868
+            {900000000, 930000000}, // BAND_915
+    };
+    for (int i = 0; i < BAND_COUNT; ++i) {
+        if (frequency >= bands[i].low && frequency <= bands[i].high)
+            return i;
+    }
+    return -1;
+}
+
+decoder_dispatch_t *select_dispatch(r_cfg_t *cfg, struct dm_state *decoders, uint32_t frequency)
+{
+    int band                     = decoders->bands && cfg->frequencies > 1 ? frequency_band(frequency) : -1;
+    decoder_dispatch_t *dispatch = band < 0 ? &decoders->dispatch : &decoders->band_dispatch[band];
+    dispatch->band               = band < 0 ? 0 : 1u << band;
+    dispatch->timing             = decoders->timing_skip;
+    return dispatch;
+}
+
+/// Count a run with events, a demoted decoder is promoted again.
+static int account_hits(r_device *r_dev, int events)
+{
+    r_dev->cover_packages += r_dev->coverage;
+    r_dev->cover_hit = r_dev->coverage && events > 0;
+    if (events > 0) {
+        r_dev->hits++;
+        r_dev->sample_every = 0;
+    }
+    return events;
+}
+
+/// Remember a decoder with events of a run of the dispatch, see -Y dedup.
+static void dispatch_hit(decoder_dispatch_t *dispatch, r_device *r_dev, pulse_slicer_fn slicer, int events)
+{
+    if (!dispatch || events <= 0)
+        return;
+    if (dispatch->num_hits < DISPATCH_HITS)
+        dispatch->hits[dispatch->num_hits] = (decoder_entry_t){.r_dev = r_dev, .slicer = slicer};
+    dispatch->num_hits++;
+}
+
+/// A decoder of a batch.
+typedef struct demod_slot {
+    r_device *r_dev;
+    pulse_slicer_fn slicer;
+    unsigned next;        ///< next decoder of the same job, decoders sharing a slice cache are one job
+    unsigned job;         ///< first decoder of the job with this index
+    int events;
+    list_t outputs;       ///< data of the decoder, collected while running
+} demod_slot_t;
+
+/// Decoders of one priority to run in parallel.
+typedef struct demod_batch {
+    pulse_data_t const *pulse_data;
+    unsigned num_slots;
+    unsigned num_jobs;
+    demod_slot_t *slots;  ///< decoders in list order
+} demod_batch_t;
+
+/// Collect the output of a decoder, the output is passed on after the batch is done.
+static void demod_batch_collect(r_device *r_dev, data_t *data)
+{
+    list_push(r_dev->output_ctx, data);
+}
+
+static void demod_batch_job(void *ctx, unsigned job)
+{
+    demod_batch_t *batch = ctx;
+    for (unsigned i = batch->slots[job].job; i < batch->num_slots; i = batch->slots[i].next) {
+        batch->slots[i].events = pulse_slicer_shared(batch->pulse_data, batch->slots[i].r_dev, batch->slots[i].slicer);
+    }
+}
+
+/// Run the candidate decoders of one priority on the pool, the output is passed on in list order.
+static int run_demod_batch(decoder_pool_t *pool, demod_batch_t *batch, decoder_dispatch_t *dispatch)
+{
+    demod_slot_t *slots = batch->slots;
+
+    // decoders sharing a slice cache go into one job, the cache is not thread-safe
+    batch->num_jobs = 0;
+    for (unsigned i = 0; i < batch->num_slots; ++i) {
+        slots[i].next = batch->num_slots;
+        unsigned j = 0;
+        for (; slots[i].r_dev->slice_cache && j < batch->num_jobs; ++j) {
+            if (slots[slots[j].job].r_dev->slice_cache == slots[i].r_dev->slice_cache)
                 break;
-            default:
-                fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
-            }
+        }
+        if (slots[i].r_dev->slice_cache && j < batch->num_jobs) {
+            unsigned last = slots[j].job;
+            while (slots[last].next < batch->num_slots)
+                last = slots[last].next;
+            slots[last].next = i;
+        }
+        else {
+            slots[batch->num_jobs++].job = i;
         }
     }
 
+    // all decoders share the same output handler, see register_protocol()
+    void (*output_fn)(r_device *decoder, data_t *data) = slots[0].r_dev->output_fn;
+    void *output_ctx = slots[0].r_dev->output_ctx;
+    // the records are made on the pool threads, the collected data is output here
+    void (*output_record_fn)(r_device *decoder, data_record_t *record) = slots[0].r_dev->output_record_fn;
+    for (unsigned i = 0; i < batch->num_slots; ++i) {
+        slots[i].outputs                 = (list_t){0};
+        slots[i].r_dev->output_fn        = demod_batch_collect;
+        slots[i].r_dev->output_record_fn = NULL;
+        slots[i].r_dev->output_ctx       = &slots[i].outputs;
+    }
+
+    decoder_pool_run(pool, batch->num_jobs, demod_batch_job, batch);
+
+    int p_events = 0;
+    for (unsigned i = 0; i < batch->num_slots; ++i) {
+        r_device *r_dev         = slots[i].r_dev;
+        r_dev->output_fn        = output_fn;
+        r_dev->output_record_fn = output_record_fn;
+        r_dev->output_ctx       = output_ctx;
+        for (size_t k = 0; k < slots[i].outputs.len; ++k) {
+            r_dev->output_fn(r_dev, slots[i].outputs.elems[k]);
+        }
+        list_free_elems(&slots[i].outputs, NULL);
+        dispatch_hit(dispatch, r_dev, slots[i].slicer, slots[i].events);
+        p_events += account_hits(r_dev, slots[i].events);
+    }
     return p_events;
 }
 
-int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data)
+/// Count the decoders with events of a package for the coverage report, the hits are cleared.
+static void account_overlaps(decoder_entry_t const *entries, unsigned len)
+{
+    unsigned decoders = 0;
+    r_device *first   = NULL;
+    for (unsigned i = 0; i < len; ++i) {
+        r_device *r_dev = entries[i].r_dev;
+        if (!r_dev->cover_hit)
+            continue;
+        decoders++;
+        if (!first || r_dev->priority < first->priority)
+            first = r_dev;
+    }
+    for (unsigned i = 0; i < len; ++i) {
+        r_device *r_dev = entries[i].r_dev;
+        if (!r_dev->cover_hit)
+            continue;
+        r_dev->cover_decoded++;
+        r_dev->cover_overlaps += decoders > 1;
+        r_dev->cover_first += r_dev == first;
+        r_dev->cover_hit = 0;
+    }
+}
+
+/// Run all decoders of each priority, stop if an event is produced, unless for the coverage report.
+/// The decoders with events are remembered in the dispatch, if any.
+static int run_demods(decoder_pool_t *pool, decoder_dispatch_t *dispatch, decoder_entry_t const *entries, unsigned len, pulse_data_t *pulse_data)
 {
     int p_events = 0;
+    int coverage = 0;
+    int timing   = dispatch ? dispatch->timing : 0;
+    if (dispatch)
+        dispatch->num_hits = 0;
+    unsigned width_hist[32] = {0};
+    unsigned width_total = timing && pulse_data->sample_rate ? pulse_data_width_hist(pulse_data, width_hist) : 0;
+    for (unsigned i = 0; i < len; ++i) {
+        pulse_slicer_invalidate(entries[i].r_dev);
+        coverage |= entries[i].r_dev->coverage;
+    }
+
+    demod_batch_t batch = {0};
+    if (pool && len > 1) {
+        batch.pulse_data = pulse_data;
+        batch.slots      = malloc(len * sizeof(*batch.slots));
+        if (!batch.slots) {
+            WARN_MALLOC("run_demods()");
+            pool = NULL; // run on this thread
+        }
+    }
+    else {
+        pool = NULL;
+    }
 
-    unsigned next_priority = 0; // next smallest on each loop through decoders
-    // run all decoders of each priority, stop if an event is produced
-    for (unsigned priority = 0; !p_events && priority < UINT_MAX; priority = next_priority) {
-        next_priority = UINT_MAX;
-        for (void **iter = r_devs->elems; iter && *iter; ++iter) {
-            r_device *r_dev = *iter;
-
-            // Find next smallest priority
-            if (r_dev->priority > priority && r_dev->priority < next_priority)
-                next_priority = r_dev->priority;
-            // Run only current priority
-            if (r_dev->priority != priority)
+    // the entries are sorted by priority, each run covers the decoders of one priority
+    for (unsigned i = 0; i < len && (!p_events || coverage);) {
+        unsigned priority = entries[i].r_dev->priority;
+        batch.num_slots   = 0;
+        for (; i < len && entries[i].r_dev->priority == priority; ++i) {
+            r_device *r_dev = entries[i].r_dev;
+
+            // Skip decoders that need more pulses than the package has
+            if (pulse_data->num_pulses < r_dev->min_pulses)
+                continue;
+            // Skip decoders whose timing is nowhere near the package widths
+            if (!decoder_timing_match(r_dev, width_hist, width_total))
+                continue;
+            // Skip the decoders shed while behind real time
+            if (r_dev->shed) {
+                r_dev->stats.shed++;
+                continue;
+            }
+            // Run demoted decoders only on every n-th package
+            if (r_dev->sample_every && ++r_dev->sample_count < r_dev->sample_every)
                 continue;
+            r_dev->sample_count = 0;
 
-            switch (r_dev->modulation) {
-            // OOK decoders
-            case OOK_PULSE_PCM:
-            // case OOK_PULSE_RZ:
-            case OOK_PULSE_PPM:
-            case OOK_PULSE_PWM:
-            case OOK_PULSE_MANCHESTER_ZEROBIT:
-            case OOK_PULSE_PIWM_RAW:
-            case OOK_PULSE_PIWM_DC:
-            case OOK_PULSE_DMC:
-            case OOK_PULSE_PWM_OSV1:
-            case OOK_PULSE_NRZS:
-                break;
-            case FSK_PULSE_PCM:
-                p_events += pulse_slicer_pcm(fsk_pulse_data, r_dev);
-                break;
-            case FSK_PULSE_PWM:
-                p_events += pulse_slicer_pwm(fsk_pulse_data, r_dev);
-                break;
-            case FSK_PULSE_MANCHESTER_ZEROBIT:
-                p_events += pulse_slicer_manchester_zerobit(fsk_pulse_data, r_dev);
-                break;
-            default:
-                fprintf(stderr, "Unknown modulation %u in protocol!\n", r_dev->modulation);
+            if (pool) {
+                batch.slots[batch.num_slots].r_dev    = r_dev;
+                batch.slots[batch.num_slots++].slicer = entries[i].slicer;
+            }
+            else {
+                int events = pulse_slicer_shared(pulse_data, r_dev, entries[i].slicer);
+                dispatch_hit(dispatch, r_dev, entries[i].slicer, events);
+                p_events += account_hits(r_dev, events);
             }
         }
+        if (pool && batch.num_slots)
+            p_events += run_demod_batch(pool, &batch, dispatch);
     }
+    if (coverage && p_events > 0)
+        account_overlaps(entries, len);
+
+    free(batch.slots);
+    return p_events;
+}
+
+int run_ook_dispatch(decoder_pool_t *pool, decoder_dispatch_t *dispatch, list_t *r_devs, pulse_data_t *pulse_data)
+{
+    if (!dispatch->valid)
+        decoder_dispatch_build(dispatch, r_devs);
+    return run_demods(pool, dispatch, dispatch->ook, dispatch->ook_len, pulse_data);
+}
+
+int run_fsk_dispatch(decoder_pool_t *pool, decoder_dispatch_t *dispatch, list_t *r_devs, pulse_data_t *fsk_pulse_data)
+{
+    if (!dispatch->valid)
+        decoder_dispatch_build(dispatch, r_devs);
+    return run_demods(pool, dispatch, dispatch->fsk, dispatch->fsk_len, fsk_pulse_data);
+}
+
+int run_decoder_entries(decoder_entry_t const *entries, unsigned len, pulse_data_t *pulse_data)
+{
+    return run_demods(NULL, NULL, entries, len, pulse_data);
+}
+
+int run_ook_demods(list_t *r_devs, pulse_data_t *pulse_data)
+{
+    decoder_dispatch_t dispatch = {0};
+    int p_events = run_ook_dispatch(NULL, &dispatch, r_devs, pulse_data);
+    decoder_dispatch_free(&dispatch);
+    return p_events;
+}
 
+int run_fsk_demods(list_t *r_devs, pulse_data_t *fsk_pulse_data)
+{
+    decoder_dispatch_t dispatch = {0};
+    int p_events = run_fsk_dispatch(NULL, &dispatch, r_devs, fsk_pulse_data);
+    decoder_dispatch_free(&dispatch);
     return p_events;
 }
 
 /* handlers */
 
+/// Check an event with the filters of an output, see output_filter_pass().
+static int output_filters_pass(r_cfg_t *cfg, size_t index, data_t const *data, uint64_t now_ms)
+{
+    // raw packages go only to the outputs with the raw option, if there are any
+    int raw = 0;
+    for (void **iter = cfg->output_filters.elems; cfg->raw_outputs && iter && *iter; ++iter) {
+        if (output_filter_index(*iter) == index)
+            raw |= output_filter_raw(*iter);
+    }
+    if (cfg->raw_event ? cfg->raw_outputs && !raw : raw == 2)
+        return 0;
+
+    for (void **iter = cfg->output_filters.elems; iter && *iter; ++iter) {
+        output_filter_t *filter = *iter;
+        if (output_filter_index(filter) == index && !output_filter_pass(filter, data, now_ms))
+            return 0;
+    }
+    return 1;
+}
+
+/// Capture the IQ samples of the package of an event if an output asks for it, the event then references the file.
+static data_t *capture_event_iq(r_cfg_t *cfg, data_t *data, uint64_t now_ms)
+{
+    struct dm_state *demod = cfg->demod;
+    if (!demod->samp_grab || !demod->package_start_ago || cfg->raw_event)
+        return data; // not from a package
+
+    int capture = 0;
+    for (void **iter = cfg->output_filters.elems; iter && *iter; ++iter) {
+        capture |= output_filter_iq(*iter, data, now_ms);
+    }
+    if (!capture)
+        return data;
+
+    unsigned pad   = cfg->samp_rate / 1000; // 1 ms before and after the package
+    unsigned end   = demod->package_end_ago > pad ? demod->package_end_ago - pad : 0;
+    unsigned start = demod->package_start_ago + pad;
+    char name[64];
+    if (samp_grab_snippet(demod->samp_grab, start - end, end, name, sizeof(name)))
+        return data; // dropped
+    return data_append(data,
+            "iq_file", "IQ file", DATA_STRING, name,
+            NULL);
+}
+
+/// Get the model of an event, NULL if there is none.
+static char const *event_model(data_t const *data)
+{
+    for (data_t const *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL && d->type == DATA_STRING)
+            return d->value.v_ptr;
+    }
+    return NULL;
+}
+
+void output_event(r_cfg_t *cfg, data_t *data)
+{
+    uint64_t offset = cfg->demod->pulse_data.offset;
+    if (offset < cfg->output_start || (cfg->output_end && offset >= cfg->output_end)) {
+        data_free(data); // the package is output by the chunk it starts in, or is outside the -r range, see -Y chunk
+        return;
+    }
+    if (cfg->batch_events) {
+        list_push(cfg->batch_events, data); // printed in file order, see -Y jobs
+        return;
+    }
+
+    metrics_t *metrics = cfg->metrics;
+    double wall_us     = cfg->trace ? metrics_wall_time_us() : 0.0;
+    double begin       = metrics_begin(metrics);
+    uint64_t now_ms    = cfg->output_filters.len && cfg->samp_rate ? cfg->input_pos * 1000 / cfg->samp_rate : 0;
+    if (cfg->iq_outputs)
+        data = capture_event_iq(cfg, data, now_ms);
+    if (cfg->report_seq) {
+        data = data_append(data,
+                "seq", "Seq", DATA_INT, (int)(metrics->events + 1), // the events printed are numbered from 1
+                NULL);
+    }
+    // the event is finished, the outputs on any thread may share it from here
+    data_freeze(data);
+    data_print_jsons_cache(data); // serialize once for all JSON outputs
+    if (cfg->event_cb)
+        cfg->event_cb(cfg->event_ctx, data);
+    output_route_t *route = cfg->output_route;
+    uint64_t const *mask  = NULL;
+    if (output_route_outputs(route) == cfg->output_handler.len)
+        mask = output_route_lookup(route, event_model(data), cfg->raw_event);
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        if (mask && !(mask[i / 64] >> (i % 64) & 1))
+            continue;
+        int routed = mask && !output_route_per_event(route, (unsigned)i); // only the model and raw options apply
+        if (!routed && !output_filters_pass(cfg, i, data, now_ms))
+            continue;
+        if (cfg->urgent_event)
+            data_output_print_urgent(cfg->output_handler.elems[i], data); // ahead of the batches and queues
+        else
+            data_output_print(cfg->output_handler.elems[i], data);
+    }
+    data_print_jsons_cache(NULL);
+    data_free(data);
+    metrics_end(metrics, METRICS_OUTPUT, begin);
+    metrics->events++;
+
+    // the latency from the end of the package on air, queued outputs count when queued
+    if (metrics->package_end_us > 0.0 || cfg->trace) {
+        double end_us     = metrics_wall_time_us();
+        double latency_us = metrics->package_end_us > 0.0 ? end_us - metrics->package_end_us : 0.0;
+        if (metrics->package_end_us > 0.0)
+            metrics_observe(&metrics->event_latency, latency_us);
+        if (metrics->package_end_us > 0.0 && cfg->urgent_event)
+            metrics_observe(&metrics->urgent_latency, latency_us);
+        trace_event_complete(cfg->trace, "output", TRACE_OUTPUTS, wall_us, end_us - wall_us, "latency_us", latency_us);
+    }
+}
+
+void r_set_event_callback(r_cfg_t *cfg, r_event_callback_fn cb, void *ctx)
+{
+    cfg->event_cb  = cb;
+    cfg->event_ctx = ctx;
+}
+
 /** Pass the data structure to all output handlers. Frees data afterwards. */
 void event_occurred_handler(r_cfg_t *cfg, data_t *data)
 {
@@ -594,10 +1322,72 @@ void event_occurred_handler(r_cfg_t *cfg, data_t *data)
                 NULL);
     }
 
+    USDT_PROBE1(event_out, cfg->raw_event);
+    output_event(cfg, data);
+}
+
+void raw_event_handler(r_cfg_t *cfg, data_t *data)
+{
+    cfg->raw_event = 1;
+    event_occurred_handler(cfg, data);
+    cfg->raw_event = 0;
+}
+
+void begin_event_batch(r_cfg_t *cfg)
+{
+    if (cfg->batch_events)
+        return; // collected by a batch worker, printed on the main thread
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_output_batch_begin(cfg->output_handler.elems[i]);
+    }
+}
+
+void end_event_batch(r_cfg_t *cfg)
+{
     for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
-        data_output_print(cfg->output_handler.elems[i], data);
+        data_output_batch_end(cfg->output_handler.elems[i]);
     }
-    data_free(data);
+}
+
+/// The time of the input in ms, for the time windows of the events.
+static uint64_t input_time_ms(r_cfg_t *cfg)
+{
+    return cfg->samp_rate ? cfg->input_pos * 1000 / cfg->samp_rate : 0;
+}
+
+void flush_fused_events(r_cfg_t *cfg, int all)
+{
+    if (!cfg->event_fusion)
+        return;
+    uint64_t now_ms = all ? UINT64_MAX : input_time_ms(cfg);
+    data_t *data;
+    while ((data = event_fusion_pop(cfg->event_fusion, now_ms))) {
+        output_event(cfg, data);
+    }
+}
+
+/// Hold an event to fuse it with the same event of other receivers.
+static void fuse_event(r_cfg_t *cfg, uint64_t hash, data_t *data)
+{
+    flush_fused_events(cfg, 0); // makes room for the event
+    pulse_data_t *pulse_data       = cfg->demod->fsk_pulse_data.fsk_f2_est ? &cfg->demod->fsk_pulse_data : &cfg->demod->pulse_data;
+    char const *receiver           = cfg->pulse_receiver ? cfg->pulse_receiver : "local";
+    ensure_rssi_snr(cfg, pulse_data);
+    event_fusion_add(cfg->event_fusion, hash, data, receiver, pulse_data->rssi_db, input_time_ms(cfg));
+}
+
+/// Check if an event is an alarm, from an urgent decoder or with a model listed by -Y urgent.
+static int event_urgent(r_cfg_t *cfg, r_device *r_dev, data_t const *data)
+{
+    if (r_dev->urgent)
+        return 1;
+    if (!cfg->urgent_models)
+        return 0;
+    for (data_t const *d = data; d; d = d->next) {
+        if (d->key_id == DATA_KEY_MODEL && d->type == DATA_STRING)
+            return output_filter_model_listed(cfg->urgent_models, d->value.v_ptr);
+    }
+    return 0;
 }
 
 /** Pass the data structure to all output handlers. Frees data afterwards. */
@@ -605,171 +1395,32 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
 {
     r_cfg_t *cfg = r_dev->output_ctx;
 
+    // fuse the events of several receivers, keyed by the fields of the decoder before any are added
+    uint64_t fusion_hash = cfg->event_fusion ? event_dedup_hash(data) : 0;
+
+    // drop repeats of an event, keyed by the fields of the decoder before any are added, fusion merges the repeats
+    if (!cfg->event_fusion && cfg->event_dedup.window_ms && cfg->samp_rate) {
+        uint64_t now_ms = input_time_ms(cfg);
+        if (event_dedup_check(&cfg->event_dedup, data, now_ms)) {
+            data_free(data);
+            return;
+        }
+    }
+
 #ifndef NDEBUG
     // check for undeclared csv fields
     for (data_t *d = data; d; d = d->next) {
-        int found = 0;
-        for (char **p = r_dev->fields; *p; ++p) {
-            if (!strcmp(d->key, *p)) {
-                found = 1;
-                break;
-            }
-        }
-        if (!found) {
+        if (!unit_fields_declared(r_dev->unit_fields, d->key)) {
             fprintf(stderr, "WARNING: Undeclared field \"%s\" in [%u] \"%s\"\n", d->key, r_dev->protocol_num, r_dev->name);
         }
     }
 #endif
 
-    if (cfg->conversion_mode == CONVERT_SI) {
-        for (data_t *d = data; d; d = d->next) {
-            // Convert double type fields ending in _F to _C
-            if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_F")) {
-                d->value.v_dbl = fahrenheit2celsius(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_F", "_C");
-                free(d->key);
-                d->key = new_label;
-                char *pos;
-                if (d->format && (pos = strrchr(d->format, 'F'))) {
-                    *pos = 'C';
-                }
-            }
-            // Convert double type fields ending in _mph to _kph
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mph")) {
-                d->value.v_dbl = mph2kmph(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mph", "_kph");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mi/h", "km/h");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _mi_h to _km_h
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mi_h")) {
-                d->value.v_dbl = mph2kmph(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mi_h", "_km_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mi/h", "km/h");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _in to _mm
-            else if ((d->type == DATA_DOUBLE) &&
-                     (str_endswith(d->key, "_in") || str_endswith(d->key, "_inch"))) {
-                d->value.v_dbl = inch2mm(d->value.v_dbl);
-                char *new_label = str_replace(str_replace(d->key, "_inch", "_in"), "_in", "_mm");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "in", "mm");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _in_h to _mm_h
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_in_h")) {
-                d->value.v_dbl = inch2mm(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_in_h", "_mm_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "in/h", "mm/h");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _inHg to _hPa
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_inHg")) {
-                d->value.v_dbl = inhg2hpa(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_inHg", "_hPa");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "inHg", "hPa");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _PSI to _kPa
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_PSI")) {
-                d->value.v_dbl = psi2kpa(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_PSI", "_kPa");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "PSI", "kPa");
-                free(d->format);
-                d->format = new_format_label;
-            }
-        }
-    }
-    if (cfg->conversion_mode == CONVERT_CUSTOMARY) {
+    // convert the units of the fields, the keys and formats are replaced
+    if (cfg->conversion_mode == CONVERT_SI || cfg->conversion_mode == CONVERT_CUSTOMARY) {
+        unit_system_t to = cfg->conversion_mode == CONVERT_SI ? UNIT_SI : UNIT_CUSTOMARY;
         for (data_t *d = data; d; d = d->next) {
-            // Convert double type fields ending in _C to _F
-            if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_C")) {
-                d->value.v_dbl = celsius2fahrenheit(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_C", "_F");
-                free(d->key);
-                d->key = new_label;
-                char *pos;
-                if (d->format && (pos = strrchr(d->format, 'C'))) {
-                    *pos = 'F';
-                }
-            }
-            // Convert double type fields ending in _kph to _mph
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_kph")) {
-                d->value.v_dbl = kmph2mph(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_kph", "_mph");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "km/h", "mi/h");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _km_h to _mi_h
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_km_h")) {
-                d->value.v_dbl = kmph2mph(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_km_h", "_mi_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "km/h", "mi/h");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _mm to _inch
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mm")) {
-                d->value.v_dbl = mm2inch(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mm", "_in");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mm", "in");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _mm_h to _in_h
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_mm_h")) {
-                d->value.v_dbl = mm2inch(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_mm_h", "_in_h");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "mm/h", "in/h");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _hPa to _inHg
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_hPa")) {
-                d->value.v_dbl = hpa2inhg(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_hPa", "_inHg");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "hPa", "inHg");
-                free(d->format);
-                d->format = new_format_label;
-            }
-            // Convert double type fields ending in _kPa to _PSI
-            else if ((d->type == DATA_DOUBLE) && str_endswith(d->key, "_kPa")) {
-                d->value.v_dbl = kpa2psi(d->value.v_dbl);
-                char *new_label = str_replace(d->key, "_kPa", "_PSI");
-                free(d->key);
-                d->key = new_label;
-                char *new_format_label = str_replace(d->format, "kPa", "PSI");
-                free(d->format);
-                d->format = new_format_label;
-            }
+            unit_convert_field(r_dev->unit_fields, to, d);
         }
     }
 
@@ -788,6 +1439,7 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
     }
 
     if (cfg->report_meta && cfg->demod->fsk_pulse_data.fsk_f2_est) {
+        ensure_rssi_snr(cfg, &cfg->demod->fsk_pulse_data);
         data_append(data,
                 "mod",   "Modulation",  DATA_STRING, "FSK",
                 "freq1", "Freq1",       DATA_FORMAT, "%.1f MHz", DATA_DOUBLE, cfg->demod->fsk_pulse_data.freq1_hz / 1000000.0,
@@ -798,6 +1450,7 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
                 NULL);
     }
     else if (cfg->report_meta) {
+        ensure_rssi_snr(cfg, &cfg->demod->pulse_data);
         data_append(data,
                 "mod",   "Modulation",  DATA_STRING, "ASK",
                 "freq",  "Freq",        DATA_FORMAT, "%.1f MHz", DATA_DOUBLE, cfg->demod->pulse_data.freq1_hz / 1000000.0,
@@ -822,10 +1475,149 @@ void data_acquired_handler(r_device *r_dev, data_t *data)
         data            = data_tag_apply(tag, data, cfg->in_filename);
     }
 
+    // alarms are not held for fusion, see -Y urgent
+    int urgent = event_urgent(cfg, r_dev, data);
+    if (cfg->event_fusion && !urgent) {
+        fuse_event(cfg, fusion_hash, data);
+        return;
+    }
+    cfg->urgent_event = urgent;
+    output_event(cfg, data);
+    cfg->urgent_event = 0;
+}
+
+/// Check if the events are used, otherwise they are only counted, e.g. with -F null for a survey.
+static int events_used(r_cfg_t *cfg)
+{
+    if (cfg->event_cb || cfg->batch_events || cfg->iq_outputs || cfg->event_fusion || cfg->event_dedup.window_ms)
+        return 1;
     for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
-        data_output_print(cfg->output_handler.elems[i], data);
+        if (cfg->output_handler.elems[i])
+            return 1;
     }
-    data_free(data);
+    return 0;
+}
+
+/** Pass a record of the decoder fields on, the data is only made if the event is used. */
+void record_acquired_handler(r_device *r_dev, data_record_t *record)
+{
+    r_cfg_t *cfg = r_dev->output_ctx;
+
+    uint64_t offset = cfg->demod->pulse_data.offset;
+    if (!events_used(cfg) && offset >= cfg->output_start && (!cfg->output_end || offset < cfg->output_end)) {
+        cfg->metrics->events++; // as counted by output_event()
+        return;
+    }
+
+    data_t *data = data_record_make(record);
+    if (data)
+        data_acquired_handler(r_dev, data);
+}
+
+static unsigned add_pipeline_loss(pipeline_loss_t *loss, unsigned n, unsigned size, char const *stage, char const *unit, int output, uint64_t dropped)
+{
+    if (n < size)
+        loss[n] = (pipeline_loss_t){.stage = stage, .unit = unit, .output = output, .dropped = dropped};
+    return n < size ? n + 1 : n;
+}
+
+unsigned get_pipeline_loss(r_cfg_t *cfg, pipeline_loss_t *loss, unsigned size)
+{
+    // buffers the devices overflowed and gaps in the sequence numbers of the acquisition ring
+    uint64_t overflows = sdr_get_overflows(cfg->dev);
+    for (size_t i = 0; i < cfg->sdr_inputs.len; ++i) {
+        sdr_input_t *input = cfg->sdr_inputs.elems[i];
+        overflows += sdr_get_overflows(input->dev);
+    }
+    unsigned n = add_pipeline_loss(loss, 0, size, "acquire", "buffers", -1, overflows + cfg->metrics->buffers_lost);
+
+    if (cfg->demod->samp_grab)
+        n = add_pipeline_loss(loss, n, size, "grab", "signals", -1, cfg->demod->samp_grab->drops);
+    if (cfg->demod->sample_dump)
+        n = add_pipeline_loss(loss, n, size, "dump", "buffers", -1, cfg->demod->sample_dump->drops);
+    if (cfg->second_chance) {
+        unsigned queued = 0, dropped = 0, events = 0;
+        second_chance_counts(cfg->second_chance, &queued, &dropped, &events);
+        n = add_pipeline_loss(loss, n, size, "retry", "packages", -1, dropped);
+    }
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        if (cfg->output_handler.elems[i])
+            n = add_pipeline_loss(loss, n, size, "output", "events", (int)i, data_output_drops(cfg->output_handler.elems[i]));
+    }
+    return n;
+}
+
+static unsigned add_memory_usage(memory_usage_t *mem, unsigned n, unsigned size, char const *subsystem, int output, uint64_t bytes)
+{
+    if (n < size)
+        mem[n] = (memory_usage_t){.subsystem = subsystem, .output = output, .bytes = bytes};
+    return n < size ? n + 1 : n;
+}
+
+/// The sample buffers of a demod, see reserve_demod_buffers().
+static size_t demod_buffer_memory(struct dm_state const *demod)
+{
+    return demod->buf_len * (sizeof(*demod->am_buf) + sizeof(*demod->fm_buf) + sizeof(*demod->temp_buf)
+            + (demod->iq_buf ? 2 * sizeof(*demod->iq_buf) : 0)
+            + (demod->am8_buf ? sizeof(*demod->am8_buf) : 0)
+            + (demod->f32_buf ? 2 * sizeof(*demod->f32_buf) : 0));
+}
+
+/// The pulse storage of a demod, the detectors of the hop frequencies included.
+static size_t demod_pulse_memory(struct dm_state const *demod)
+{
+    size_t bytes = pulse_data_memory(&demod->pulse_data) + pulse_data_memory(&demod->fsk_pulse_data)
+            + pulse_detect_memory(demod->pulse_detect);
+    for (unsigned i = 0; demod->hop_states && i < demod->hop_states_len; ++i) {
+        if (i != demod->hop_index) // the current one is in use
+            bytes += pulse_detect_memory(demod->hop_states[i].pulse_detect);
+    }
+    return bytes;
+}
+
+unsigned get_memory_usage(r_cfg_t *cfg, memory_usage_t *mem, unsigned size)
+{
+    struct dm_state *demod = cfg->demod;
+
+    size_t buffers = demod_buffer_memory(demod) + channelizer_memory(cfg->channelizer) + decimator_memory(cfg->decimator);
+    size_t pulses  = demod_pulse_memory(demod) + pulse_recorder_memory(cfg->pulse_recorder);
+    size_t pools   = sdr_get_memory(cfg->dev) + (demod->samp_grab ? demod->samp_grab->sg_size : 0);
+    for (size_t i = 0; i < cfg->sdr_inputs.len; ++i) {
+        sdr_input_t *input = cfg->sdr_inputs.elems[i];
+        pools += sdr_get_memory(input->dev);
+        if (input->demod) {
+            buffers += demod_buffer_memory(input->demod);
+            pulses += demod_pulse_memory(input->demod);
+        }
+    }
+    for (size_t i = 0; i < cfg->channel_demods.len; ++i) {
+        buffers += demod_buffer_memory(cfg->channel_demods.elems[i]);
+        pulses += demod_pulse_memory(cfg->channel_demods.elems[i]);
+    }
+    size_t decoders = 0;
+    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        decoders += sizeof(*r_dev) + alloc_block_size(r_dev->decode_ctx);
+    }
+
+    unsigned n = add_memory_usage(mem, 0, size, "buffers", -1, buffers);
+    n = add_memory_usage(mem, n, size, "pulses", -1, pulses);
+    n = add_memory_usage(mem, n, size, "decoders", -1, decoders);
+    n = add_memory_usage(mem, n, size, "pools", -1, pools);
+    uint64_t heap = alloc_count_heap_bytes();
+    if (heap)
+        n = add_memory_usage(mem, n, size, "heap", -1, heap);
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_output_t *output = cfg->output_handler.elems[i];
+        if (!output)
+            continue;
+        if (data_output_queue_check(output)) {
+            n      = add_memory_usage(mem, n, size, "output_queue", (int)i, data_output_queue_memory(output));
+            output = data_output_queue_inner(output);
+        }
+        n = add_memory_usage(mem, n, size, "output", (int)i, data_output_memory(output));
+    }
+    return n;
 }
 
 // level 0: do not report (don't call this), 1: report successful devices, 2: report active devices, 3: report all
@@ -838,42 +1630,33 @@ data_t *create_report_data(r_cfg_t *cfg, int level)
 
     for (void **iter = r_devs->elems; iter && *iter; ++iter) {
         r_device *r_dev = *iter;
-        if (level <= 2 && r_dev->decode_events == 0)
+        if (level <= 2 && r_dev->stats.events == 0)
             continue;
-        if (level <= 1 && r_dev->decode_ok == 0)
+        if (level <= 1 && r_dev->stats.ok == 0)
             continue;
         if (level <= 0)
             continue;
 
+        // a single allocation for each reported decoder, the fail counters only if any
+        decoder_stats_t const *stats = &r_dev->stats;
         data = data_make(
                 "device",       "", DATA_INT, r_dev->protocol_num,
                 "name",         "", DATA_STRING, r_dev->name,
-                "events",       "", DATA_INT, r_dev->decode_events,
-                "ok",           "", DATA_INT, r_dev->decode_ok,
-                "messages",     "", DATA_INT, r_dev->decode_messages,
+                "events",       "", DATA_INT, stats->events,
+                "ok",           "", DATA_INT, stats->ok,
+                "messages",     "", DATA_INT, stats->messages,
+                "fail_other",   "", DATA_COND, stats->fails[-DECODE_FAIL_OTHER] != 0, DATA_INT, stats->fails[-DECODE_FAIL_OTHER],
+                "abort_length", "", DATA_COND, stats->fails[-DECODE_ABORT_LENGTH] != 0, DATA_INT, stats->fails[-DECODE_ABORT_LENGTH],
+                "abort_early",  "", DATA_COND, stats->fails[-DECODE_ABORT_EARLY] != 0, DATA_INT, stats->fails[-DECODE_ABORT_EARLY],
+                "fail_mic",     "", DATA_COND, stats->fails[-DECODE_FAIL_MIC] != 0, DATA_INT, stats->fails[-DECODE_FAIL_MIC],
+                "fail_sanity",  "", DATA_COND, stats->fails[-DECODE_FAIL_SANITY] != 0, DATA_INT, stats->fails[-DECODE_FAIL_SANITY],
+                "fail_budget",  "", DATA_COND, stats->fails[-DECODE_FAIL_BUDGET] != 0, DATA_INT, stats->fails[-DECODE_FAIL_BUDGET],
+                "truncated",    "", DATA_COND, stats->truncated != 0, DATA_INT, stats->truncated,
+                "shed",         "", DATA_COND, stats->shed != 0, DATA_INT, stats->shed,
+                "slicer_us",    "", DATA_COND, r_dev->profile, DATA_DOUBLE, stats->slicer_time,
+                "decode_us",    "", DATA_COND, r_dev->profile, DATA_DOUBLE, stats->decode_time,
                 NULL);
 
-        if (r_dev->decode_fails[-DECODE_FAIL_OTHER])
-            data_append(data,
-                    "fail_other",   "", DATA_INT, r_dev->decode_fails[-DECODE_FAIL_OTHER],
-                    NULL);
-        if (r_dev->decode_fails[-DECODE_ABORT_LENGTH])
-            data_append(data,
-                    "abort_length", "", DATA_INT, r_dev->decode_fails[-DECODE_ABORT_LENGTH],
-                    NULL);
-        if (r_dev->decode_fails[-DECODE_ABORT_EARLY])
-            data_append(data,
-                    "abort_early",  "", DATA_INT, r_dev->decode_fails[-DECODE_ABORT_EARLY],
-                    NULL);
-        if (r_dev->decode_fails[-DECODE_FAIL_MIC])
-            data_append(data,
-                    "fail_mic",     "", DATA_INT, r_dev->decode_fails[-DECODE_FAIL_MIC],
-                    NULL);
-        if (r_dev->decode_fails[-DECODE_FAIL_SANITY])
-            data_append(data,
-                    "fail_sanity",  "", DATA_INT, r_dev->decode_fails[-DECODE_FAIL_SANITY],
-                    NULL);
-
         list_push(&dev_data_list, data);
     }
 
@@ -881,18 +1664,133 @@ data_t *create_report_data(r_cfg_t *cfg, int level)
             "count",            "", DATA_INT, cfg->frames_count,
             "fsk",              "", DATA_INT, cfg->frames_fsk,
             "events",           "", DATA_INT, cfg->frames_events,
+            "dedup",            "", DATA_COND, cfg->demod->dedup_ms > 0, DATA_INT, cfg->frames_dedup,
+            "duplicates",       "", DATA_COND, cfg->event_dedup.window_ms > 0, DATA_INT, (int)cfg->event_dedup.suppressed,
+            "fused",            "", DATA_COND, cfg->event_fusion != NULL, DATA_INT, cfg->event_fusion ? (int)event_fusion_fused(cfg->event_fusion, 0) : 0,
             NULL);
 
     char since_str[LOCAL_TIME_BUFLEN];
     format_time_str(since_str, "%Y-%m-%dT%H:%M:%S", cfg->report_time_tz, cfg->frames_since);
 
+    metrics_histogram_t const *latency = &cfg->metrics->event_latency;
+    data_t *latency_data = !latency->count ? NULL : data_make(
+            "count",            "", DATA_INT, (int)latency->count,
+            "p50_ms",           "", DATA_DOUBLE, metrics_percentile(latency, 0.50) * 1e-3,
+            "p90_ms",           "", DATA_DOUBLE, metrics_percentile(latency, 0.90) * 1e-3,
+            "p99_ms",           "", DATA_DOUBLE, metrics_percentile(latency, 0.99) * 1e-3,
+            "max_ms",           "", DATA_DOUBLE, latency->max_us * 1e-3,
+            NULL);
+
+    metrics_histogram_t const *urgent = &cfg->metrics->urgent_latency;
+    data_t *urgent_data = !urgent->count ? NULL : data_make(
+            "count",            "", DATA_INT, (int)urgent->count,
+            "p50_ms",           "", DATA_DOUBLE, metrics_percentile(urgent, 0.50) * 1e-3,
+            "p99_ms",           "", DATA_DOUBLE, metrics_percentile(urgent, 0.99) * 1e-3,
+            "max_ms",           "", DATA_DOUBLE, urgent->max_us * 1e-3,
+            NULL);
+
+    samp_grab_t *grab = cfg->demod->samp_grab;
+    data_t *grab_data = !grab ? NULL : data_make(
+            "grabs",            "", DATA_INT, (int)grab->grabs,
+            "queued",           "", DATA_INT, (int)samp_grab_queue_depth(grab),
+            "dropped",          "", DATA_INT, (int)grab->drops,
+            NULL);
+
+    sample_dump_t *dump = cfg->demod->sample_dump;
+    data_t *dump_data = !dump ? NULL : data_make(
+            "buffers",          "", DATA_INT, (int)dump->buffers,
+            "queued",           "", DATA_INT, (int)sample_dump_queue_depth(dump),
+            "stalls",           "", DATA_INT, (int)dump->stalls,
+            "dropped",          "", DATA_INT, (int)dump->drops,
+            NULL);
+
+    unsigned retry_queued = 0, retry_dropped = 0, retry_events = 0;
+    if (cfg->second_chance)
+        second_chance_counts(cfg->second_chance, &retry_queued, &retry_dropped, &retry_events);
+    data_t *retry_data = !cfg->second_chance ? NULL : data_make(
+            "queued",           "", DATA_INT, (int)retry_queued,
+            "dropped",          "", DATA_INT, (int)retry_dropped,
+            "events",           "", DATA_INT, (int)retry_events,
+            NULL);
+
+    // the work shed since the start, the decoder runs are in the stats of each decoder
+    load_shed_t const *shed = cfg->load_shed;
+    data_t *shed_data = !shed ? NULL : data_make(
+            "level",            "", DATA_INT, shed->level,
+            "load",             "", DATA_FORMAT, "%.3f", DATA_DOUBLE, shed->load,
+            "changes",          "", DATA_INT, (int)shed->changes,
+            "shed_buffers",     "", DATA_INT, (int)(shed->buffers[LOAD_SHED_PRIORITY] + shed->buffers[LOAD_SHED_UNUSED] + shed->buffers[LOAD_SHED_FM] + shed->buffers[LOAD_SHED_OUTPUTS]),
+            "fm_skipped",       "", DATA_INT, (int)shed->fm_skipped,
+            "outputs_skipped",  "", DATA_INT, (int)shed->outputs_skipped,
+            NULL);
+
+    // the last sequence numbers, and the drops of each stage since the start
+    metrics_t const *metrics = cfg->metrics;
+    data_t *seq_data = data_make(
+            "buffer",           "", DATA_INT, (int)metrics->buffers,
+            "package",          "", DATA_INT, (int)(metrics->frames_ook + metrics->frames_fsk),
+            "event",            "", DATA_INT, (int)metrics->events,
+            NULL);
+
+    unsigned loss_size    = PIPELINE_LOSS_STAGES + (unsigned)cfg->output_handler.len;
+    pipeline_loss_t *loss = calloc(loss_size, sizeof(*loss));
+    if (!loss)
+        WARN_CALLOC("create_report_data()"); // NOTE: skip the losses on alloc failure.
+    unsigned loss_num     = loss ? get_pipeline_loss(cfg, loss, loss_size) : 0;
+    list_t loss_data_list = {0};
+    for (unsigned i = 0; i < loss_num; ++i) {
+        list_push(&loss_data_list, data_make(
+                "stage",            "", DATA_STRING, loss[i].stage,
+                "output",           "", DATA_COND, loss[i].output >= 0, DATA_INT, loss[i].output,
+                "dropped",          "", DATA_INT, (int)loss[i].dropped,
+                "unit",             "", DATA_STRING, loss[i].unit,
+                "lossless",         "", DATA_INT, loss[i].dropped == 0,
+                NULL));
+    }
+    free(loss);
+
+    signal_cluster_t const *sc = &cfg->signal_cluster;
+    data_t *suggest_data = !sc->repeats ? NULL : data_make(
+            "packages",         "", DATA_INT, (int)sc->packages,
+            "clusters",         "", DATA_INT, (int)sc->clusters,
+            "suggested",        "", DATA_INT, (int)sc->suggested,
+            "evicted",          "", DATA_INT, (int)sc->evicted,
+            NULL);
+
+    // the activity and dwell time of each hop frequency
+    list_t hop_data_list = {0};
+    hop_sched_t const *sched = cfg->hop_sched;
+    for (unsigned i = 0; sched && i < sched->len; ++i) {
+        hop_slot_t const *slot = &sched->slot[i];
+        double occupancy       = cfg->spectrum ? spectrum_occupancy(cfg->spectrum, i) : -1.0;
+        list_push(&hop_data_list, data_make(
+                "frequency",        "", DATA_INT, cfg->frequency[i],
+                "dwell_s",          "", DATA_DOUBLE, hop_sched_dwell(sched, i),
+                "rate",             "", DATA_COND, slot->rate >= 0.0, DATA_FORMAT, "%.4f", DATA_DOUBLE, slot->rate,
+                "noise_db",         "", DATA_COND, slot->rate >= 0.0, DATA_FORMAT, "%.1f", DATA_DOUBLE, slot->noise_level,
+                "occupancy",        "", DATA_COND, occupancy >= 0.0, DATA_FORMAT, "%.3f", DATA_DOUBLE, occupancy,
+                NULL));
+    }
+
     data = data_make(
             "enabled",          "", DATA_INT, r_devs->len,
             "since",            "", DATA_STRING, since_str,
             "frames",           "", DATA_DATA, data,
+            "latency",          "", DATA_COND, latency_data != NULL, DATA_DATA, latency_data,
+            "urgent_latency",   "", DATA_COND, urgent_data != NULL, DATA_DATA, urgent_data,
+            "grab",             "", DATA_COND, grab_data != NULL, DATA_DATA, grab_data,
+            "dump",             "", DATA_COND, dump_data != NULL, DATA_DATA, dump_data,
+            "retry",            "", DATA_COND, retry_data != NULL, DATA_DATA, retry_data,
+            "suggest",          "", DATA_COND, suggest_data != NULL, DATA_DATA, suggest_data,
+            "shed",             "", DATA_COND, shed_data != NULL, DATA_DATA, shed_data,
+            "seq",              "", DATA_DATA, seq_data,
+            "loss",             "", DATA_ARRAY, data_array(loss_data_list.len, DATA_DATA, loss_data_list.elems),
+            "hop",              "", DATA_COND, hop_data_list.len > 0, DATA_ARRAY, data_array(hop_data_list.len, DATA_DATA, hop_data_list.elems),
             "stats",            "", DATA_ARRAY, data_array(dev_data_list.len, DATA_DATA, dev_data_list.elems),
             NULL);
 
+    list_free_elems(&loss_data_list, NULL);
+    list_free_elems(&hop_data_list, NULL);
     list_free_elems(&dev_data_list, NULL);
     return data;
 }
@@ -905,26 +1803,68 @@ void flush_report_data(r_cfg_t *cfg)
     cfg->frames_count = 0;
     cfg->frames_fsk = 0;
     cfg->frames_events = 0;
+    cfg->frames_dedup = 0;
+    cfg->event_dedup.suppressed = 0;
+    if (cfg->event_fusion)
+        event_fusion_fused(cfg->event_fusion, 1);
 
     for (void **iter = r_devs->elems; iter && *iter; ++iter) {
         r_device *r_dev = *iter;
 
-        r_dev->decode_events = 0;
-        r_dev->decode_ok = 0;
-        r_dev->decode_messages = 0;
-        r_dev->decode_fails[0] = 0;
-        r_dev->decode_fails[1] = 0;
-        r_dev->decode_fails[2] = 0;
-        r_dev->decode_fails[3] = 0;
-        r_dev->decode_fails[4] = 0;
+        // keep the totals for the metrics
+        decoder_stats_t *prior       = &r_dev->prior;
+        decoder_stats_t const *stats = &r_dev->stats;
+        prior->events   += stats->events;
+        prior->ok       += stats->ok;
+        prior->messages += stats->messages;
+        for (int i = 0; i < 6; ++i)
+            prior->fails[i] += stats->fails[i];
+        prior->truncated   += stats->truncated;
+        prior->shed        += stats->shed;
+        prior->decode_time += stats->decode_time;
+        prior->slicer_time += stats->slicer_time;
+        prior->decode_allocs += stats->decode_allocs;
+        prior->slicer_allocs += stats->slicer_allocs;
+
+        r_dev->stats = (decoder_stats_t){0};
     }
 }
 
 /* setup */
 
-static FILE *fopen_output(char *param)
+/// Parse the `,flush=<n> | <time>,buffer=<size>,fsync` options of a file output.
+static void file_flush_param(char *opts, file_flush_policy_t *policy)
+{
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "flush")) {
+            if (val && strpbrk(val, "smhSMH:"))
+                policy->secs = atoi_time(val, "-F flush: ");
+            else
+                policy->events = atouint32_metric(val, "-F flush: ");
+        }
+        else if (!strcasecmp(key, "buffer"))
+            policy->bytes = atouint32_metric(val, "-F buffer: ");
+        else if (!strcasecmp(key, "fsync"))
+            policy->sync = atobv(val, 1);
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
+}
+
+static FILE *fopen_output(char *param, file_flush_policy_t *policy)
 {
     FILE *file;
+    char *opts = param ? strchr(param, ',') : NULL;
+    if (opts)
+        *opts++ = '\0';
+    file_flush_param(opts, policy);
     if (!param || !*param) {
         return stdout;
     }
@@ -936,66 +1876,485 @@ static FILE *fopen_output(char *param)
     return file;
 }
 
+/// Add an output that prints to a file, these are queued with -O and flushed less often with -B throughput.
+static void add_file_output(r_cfg_t *cfg, data_output_t *output, file_flush_policy_t const *policy)
+{
+    list_push(&cfg->output_handler, output);
+    list_push(&cfg->file_outputs, output);
+    if (!policy->events && !policy->secs && !policy->bytes && !policy->sync)
+        list_push(&cfg->flush_outputs, output);
+}
+
+/// Add an output that uses the network, these are printed on the network thread.
+static void add_net_output(r_cfg_t *cfg, data_output_t *output)
+{
+    list_push(&cfg->output_handler, output);
+    if (output)
+        list_push(&cfg->net_outputs, output);
+}
+
 void add_json_output(r_cfg_t *cfg, char *param)
 {
-    list_push(&cfg->output_handler, data_output_json_create(fopen_output(param)));
+    file_flush_policy_t policy = {0};
+    FILE *file                 = fopen_output(param, &policy);
+    data_output_t *output      = data_output_json_create(file);
+    data_output_file_policy(output, &policy);
+    add_file_output(cfg, output, &policy);
 }
 
 void add_csv_output(r_cfg_t *cfg, char *param)
 {
-    list_push(&cfg->output_handler, data_output_csv_create(fopen_output(param)));
+    file_flush_policy_t policy = {0};
+    FILE *file                 = fopen_output(param, &policy);
+    data_output_t *output      = data_output_csv_create(file);
+    data_output_file_policy(output, &policy);
+    add_file_output(cfg, output, &policy);
+}
+
+/// Parse the datagram options mtu=<size> and batch=<n>.
+static void datagram_param(char *opts, unsigned *mtu, unsigned *batch)
+{
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "mtu"))
+            *mtu = atouint32_metric(val, "-F mtu: ");
+        else if (!strcasecmp(key, "batch"))
+            *batch = atouint32_metric(val, "-F batch: ");
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
+    if (*mtu > 65507) {
+        fprintf(stderr, "rtl_433: the datagram mtu can't be more than 65507 bytes\n");
+        exit(1);
+    }
+}
+
+void add_cbor_output(r_cfg_t *cfg, char *param)
+{
+    if (param && !strncmp(param, "udp:", 4)) {
+        char *host     = "localhost";
+        char *port     = NULL;
+        unsigned mtu   = 0;
+        unsigned batch = 1;
+        char *opts     = hostport_param(param + 4, &host, &port);
+        datagram_param(opts, &mtu, &batch);
+        if (!port) {
+            fprintf(stderr, "rtl_433: CBOR UDP output needs a port, e.g. -F cbor:udp://127.0.0.1:5140\n");
+            exit(1);
+        }
+        fprintf(stderr, "CBOR UDP datagrams to %s port %s\n", host, port);
+        list_push(&cfg->output_handler, data_output_cbor_udp_create(host, port, mtu, batch));
+        return;
+    }
+
+    file_flush_policy_t policy = {0};
+    FILE *file                 = fopen_output(param, &policy);
+#ifdef _WIN32
+    _setmode(_fileno(file), _O_BINARY);
+#endif
+    data_output_t *output = data_output_cbor_create(file);
+    data_output_file_policy(output, &policy);
+    add_file_output(cfg, output, &policy);
+}
+
+/// Parse the options of a delta output.
+static void delta_param(char *opts, delta_output_opts_t *delta_opts)
+{
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "interval"))
+            delta_opts->interval = atouint32_metric(val, "-F delta interval: ");
+        else if (!strcasecmp(key, "mtu"))
+            delta_opts->mtu = atouint32_metric(val, "-F delta mtu: ");
+        else if (!strcasecmp(key, "key"))
+            delta_opts->key_updates = atouint32_metric(val, "-F delta key: ");
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
+    if (delta_opts->mtu && (delta_opts->mtu < 32 || delta_opts->mtu > 65507)) {
+        fprintf(stderr, "rtl_433: the delta mtu needs to be 32 to 65507 bytes\n");
+        exit(1);
+    }
+}
+
+void add_delta_output(r_cfg_t *cfg, char *param)
+{
+    delta_output_opts_t opts = {0};
+    data_output_t *output;
+    if (param && !strncmp(param, "udp:", 4)) {
+        char *host   = "localhost";
+        char *port   = NULL;
+        char *kwargs = hostport_param(param + 4, &host, &port);
+        delta_param(kwargs, &opts);
+        if (!port) {
+            fprintf(stderr, "rtl_433: delta UDP output needs a port, e.g. -F delta:udp://127.0.0.1:5140\n");
+            exit(1);
+        }
+        fprintf(stderr, "Delta frames as UDP datagrams to %s port %s\n", host, port);
+        output = data_output_delta_udp_create(host, port, &opts);
+    }
+    else {
+        char *kwargs = param ? strchr(param, ',') : NULL;
+        if (kwargs)
+            *kwargs++ = '\0';
+        delta_param(kwargs, &opts);
+        file_flush_policy_t policy = {0}; // each frame is flushed
+        FILE *file                 = fopen_output(param, &policy);
+#ifdef _WIN32
+        _setmode(_fileno(file), _O_BINARY);
+#endif
+        output = data_output_delta_file_create(file, &opts);
+    }
+    // the frames are encoded and sent on the writer thread with -O, as the file outputs
+    list_push(&cfg->output_handler, output);
+    if (output)
+        list_push(&cfg->file_outputs, output);
+}
+
+void add_arrow_output(r_cfg_t *cfg, char *param)
+{
+    char *opts = param ? strchr(param, ',') : NULL;
+    if (opts)
+        *opts++ = '\0';
+    unsigned rows = 0;
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "rows"))
+            rows = atouint32_metric(val, "-F arrow rows: ");
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
+    if (!param || !*param) {
+        fprintf(stderr, "rtl_433: Arrow output needs a file name, e.g. -F arrow:events.arrow\n");
+        exit(1);
+    }
+
+    data_output_t *output = data_output_arrow_create(param, rows);
+    if (!output)
+        exit(1);
+    list_push(&cfg->output_handler, output);
+    list_push(&cfg->file_outputs, output);
+}
+
+void add_sqlite_output(r_cfg_t *cfg, char *param)
+{
+    char *opts = param ? strchr(param, ',') : NULL;
+    if (opts)
+        *opts++ = '\0';
+    unsigned rows = 0;
+    unsigned secs = 0;
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "rows"))
+            rows = atouint32_metric(val, "-F sqlite rows: ");
+        else if (!strcasecmp(key, "secs"))
+            secs = atouint32_metric(val, "-F sqlite secs: ");
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
+    if (!param || !*param) {
+        fprintf(stderr, "rtl_433: SQLite output needs a file name, e.g. -F sqlite:events.db\n");
+        exit(1);
+    }
+
+    data_output_t *output = data_output_sqlite_create(param, rows, secs);
+    if (!output)
+        exit(1);
+    list_push(&cfg->output_handler, output);
+    list_push(&cfg->file_outputs, output);
 }
 
 void start_outputs(r_cfg_t *cfg, char const *const *well_known)
 {
+    for (size_t i = 0; cfg->output_queue_size && i < cfg->output_handler.len; ++i) {
+        for (size_t j = 0; j < cfg->file_outputs.len; ++j) {
+            if (cfg->output_handler.elems[i] && cfg->output_handler.elems[i] == cfg->file_outputs.elems[j]) {
+                cfg->output_handler.elems[i] = data_output_queue_create(cfg->output_handler.elems[i],
+                        cfg->output_queue_size, (output_queue_policy_t)cfg->output_queue_policy);
+                break;
+            }
+        }
+    }
+    list_free_elems(&cfg->file_outputs, NULL);
+
+    // without flush options the files are written once a second or when the buffer is full
+    file_flush_policy_t throughput_policy = {.secs = 1, .bytes = BUFFER_PROFILE_FILE_BUFFER};
+    for (size_t i = 0; cfg->buffer_profile == BUFFER_PROFILE_THROUGHPUT && i < cfg->flush_outputs.len; ++i) {
+        data_output_file_policy(cfg->flush_outputs.elems[i], &throughput_policy);
+    }
+    list_free_elems(&cfg->flush_outputs, NULL);
+
+    // the fields options are applied by the output, a queue passes on all fields
+    for (void **iter = cfg->output_filters.elems; iter && *iter; ++iter) {
+        output_filter_t *filter        = *iter;
+        data_projection_t *projection = output_filter_projection(filter);
+        if (projection)
+            data_output_project(data_output_queue_inner(cfg->output_handler.elems[output_filter_index(filter)]), projection);
+    }
+
     int num_output_fields;
     char const **output_fields = determine_csv_fields(cfg, well_known, &num_output_fields);
+    char const **kept_fields   = calloc((size_t)num_output_fields + 1, sizeof(*kept_fields));
+    if (!kept_fields)
+        WARN_CALLOC("start_outputs()"); // NOTE: the CSV columns are then not projected.
 
     for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
-        data_output_start(cfg->output_handler.elems[i], output_fields, num_output_fields);
+        data_output_t *inner = data_output_queue_inner(cfg->output_handler.elems[i]);
+        if (!inner || !inner->projection || !kept_fields) {
+            data_output_start(cfg->output_handler.elems[i], output_fields, num_output_fields);
+            continue;
+        }
+        int num_kept = 0;
+        for (int j = 0; j < num_output_fields; ++j) {
+            if (data_projection_keeps(inner->projection, output_fields[j], data_key_lookup(output_fields[j])))
+                kept_fields[num_kept++] = output_fields[j];
+        }
+        data_output_start(cfg->output_handler.elems[i], kept_fields, num_kept);
     }
 
+    free((void *)kept_fields);
     free((void *)output_fields);
+
+    // the filters are compiled into the routing table, with at most one filter for each output
+    output_filter_t **filters = calloc(cfg->output_handler.len + 1, sizeof(*filters));
+    if (!filters) {
+        WARN_CALLOC("start_outputs()");
+        return; // NOTE: the filters are then checked for each output.
+    }
+    int single = 1;
+    for (void **iter = cfg->output_filters.elems; iter && *iter; ++iter) {
+        unsigned index = output_filter_index(*iter);
+        single &= index < cfg->output_handler.len && !filters[index];
+        if (single)
+            filters[index] = *iter;
+    }
+    output_route_free(cfg->output_route);
+    cfg->output_route = NULL;
+    if (single && cfg->output_handler.len)
+        cfg->output_route = output_route_create((unsigned)cfg->output_handler.len, filters);
+    free(filters);
+}
+
+/// Round a buffer size to whole 16k blocks, or to 512 bytes below that, within the limits.
+static uint32_t buffer_profile_round(double len)
+{
+    uint32_t align = len > 16384 ? 16384 : MINIMAL_BUF_LENGTH;
+    uint32_t size  = (uint32_t)(len / align + 0.5) * align;
+    if (size < MINIMAL_BUF_LENGTH)
+        size = MINIMAL_BUF_LENGTH;
+    if (size > MAXIMAL_BUF_LENGTH)
+        size = MAXIMAL_BUF_LENGTH;
+    return size;
+}
+
+void apply_buffer_profile(r_cfg_t *cfg, int sample_size)
+{
+    char const *name;
+    double bytes_per_ms = cfg->samp_rate * (double)sample_size / 1000.0;
+    if (cfg->buffer_profile == BUFFER_PROFILE_LOW_LATENCY) {
+        name = "low-latency";
+        if (!cfg->out_block_size_set)
+            cfg->out_block_size = buffer_profile_round(bytes_per_ms * BUFFER_PROFILE_LOW_LATENCY_MS);
+        cfg->async_buf_number = BUFFER_PROFILE_LOW_LATENCY_NUM;
+    }
+    else if (cfg->buffer_profile == BUFFER_PROFILE_THROUGHPUT) {
+        name = "throughput";
+        if (!cfg->out_block_size_set) {
+            cfg->out_block_size = buffer_profile_round(bytes_per_ms * BUFFER_PROFILE_THROUGHPUT_MS);
+            if (cfg->out_block_size < DEFAULT_BUF_LENGTH)
+                cfg->out_block_size = DEFAULT_BUF_LENGTH;
+        }
+        cfg->async_buf_number = BUFFER_PROFILE_THROUGHPUT_NUM;
+    }
+    else {
+        return;
+    }
+
+    fprintf(stderr, "Buffer profile %s: %u transfers of %u bytes (%.1f ms at %u Hz)\n",
+            name, cfg->async_buf_number, cfg->out_block_size,
+            bytes_per_ms > 0.0 ? cfg->out_block_size / bytes_per_ms : 0.0, cfg->samp_rate);
+}
+
+void report_buffer_latency(r_cfg_t *cfg)
+{
+    if (cfg->buffer_profile == BUFFER_PROFILE_DEFAULT && !cfg->verbosity)
+        return;
+
+    metrics_histogram_t const *latency = &cfg->metrics->event_latency;
+    if (!latency->count) {
+        fprintf(stderr, "Event latency not measured, no events\n");
+        return;
+    }
+    fprintf(stderr, "Event latency p50 %.1f ms, p99 %.1f ms, max %.1f ms of %u events\n",
+            metrics_percentile(latency, 0.50) * 1e-3, metrics_percentile(latency, 0.99) * 1e-3,
+            latency->max_us * 1e-3, (unsigned)latency->count);
+    metrics_histogram_t const *urgent = &cfg->metrics->urgent_latency;
+    if (urgent->count)
+        fprintf(stderr, "Urgent event latency p50 %.1f ms, p99 %.1f ms, max %.1f ms of %u alarms\n",
+                metrics_percentile(urgent, 0.50) * 1e-3, metrics_percentile(urgent, 0.99) * 1e-3,
+                urgent->max_us * 1e-3, (unsigned)urgent->count);
+}
+
+void start_net_thread(r_cfg_t *cfg)
+{
+    cfg->net_thread = net_thread_create(cfg->mgr);
+    unsigned size   = cfg->output_queue_size ? cfg->output_queue_size : NET_THREAD_QUEUE_SIZE;
+    int drop_newest = cfg->output_queue_policy == OUTPUT_QUEUE_DROP_NEWEST;
+    for (size_t i = 0; cfg->net_thread && i < cfg->output_handler.len; ++i) {
+        for (size_t j = 0; j < cfg->net_outputs.len; ++j) {
+            if (cfg->output_handler.elems[i] == cfg->net_outputs.elems[j]) {
+                cfg->output_handler.elems[i] = net_thread_queue_output(cfg->net_thread, cfg->output_handler.elems[i], size, drop_newest);
+                break;
+            }
+        }
+    }
+    list_free_elems(&cfg->net_outputs, NULL);
+    net_thread_start(cfg->net_thread);
 }
 
 void add_kv_output(r_cfg_t *cfg, char *param)
 {
-    list_push(&cfg->output_handler, data_output_kv_create(fopen_output(param)));
+    file_flush_policy_t policy = {0};
+    FILE *file                 = fopen_output(param, &policy);
+    data_output_t *output      = data_output_kv_create(file);
+    data_output_file_policy(output, &policy);
+    add_file_output(cfg, output, &policy);
 }
 
 void add_mqtt_output(r_cfg_t *cfg, char *param)
 {
-    list_push(&cfg->output_handler, data_output_mqtt_create(get_mgr(cfg), param, cfg->dev_query));
+    add_net_output(cfg, data_output_mqtt_create(get_mgr(cfg), param, cfg->dev_query));
 }
 
 void add_influx_output(r_cfg_t *cfg, char *param)
 {
-    list_push(&cfg->output_handler, data_output_influx_create(get_mgr(cfg), param));
+    add_net_output(cfg, data_output_influx_create(get_mgr(cfg), param));
+}
+
+void add_nats_output(r_cfg_t *cfg, char *param)
+{
+    add_net_output(cfg, data_output_nats_create(get_mgr(cfg), param));
 }
 
 void add_syslog_output(r_cfg_t *cfg, char *param)
 {
-    char *host = "localhost";
-    char *port = "514";
-    hostport_param(param, &host, &port);
+    char *host     = "localhost";
+    char *port     = "514";
+    unsigned mtu   = 0;
+    unsigned batch = 1;
+    char *opts     = hostport_param(param, &host, &port);
+    datagram_param(opts, &mtu, &batch);
     fprintf(stderr, "Syslog UDP datagrams to %s port %s\n", host, port);
 
-    list_push(&cfg->output_handler, data_output_syslog_create(host, port));
+    list_push(&cfg->output_handler, data_output_syslog_create(host, port, mtu, batch));
+}
+
+void add_shm_output(r_cfg_t *cfg, char *param)
+{
+    char *name      = param;
+    char *opts      = param ? strchr(param, ',') : NULL;
+    uint32_t size   = 1024 * 1024;
+    unsigned format = SHM_RING_JSON;
+    if (opts)
+        *opts++ = '\0';
+    if (!name || !*name) {
+        fprintf(stderr, "rtl_433: shared memory output needs a name, e.g. -F shm:rtl_433\n");
+        exit(1);
+    }
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "size"))
+            size = atouint32_metric(val, "-F shm size: ");
+        else if (!strcasecmp(key, "cbor"))
+            format = atobv(val, 1) ? SHM_RING_CBOR : SHM_RING_JSON;
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
+
+    data_output_t *output = data_output_shm_create(name, size, format);
+    if (!output)
+        exit(1);
+    fprintf(stderr, "Writing %s events to shared memory ring \"%s\"\n", format == SHM_RING_CBOR ? "CBOR" : "JSON", name);
+    list_push(&cfg->output_handler, output);
 }
 
 void add_http_output(r_cfg_t *cfg, char *param)
 {
-    char *host = "0.0.0.0";
-    char *port = "8433";
-    hostport_param(param, &host, &port);
+    char *host           = "0.0.0.0";
+    char *port           = "8433";
+    unsigned queue_limit = 0;
+    int evict            = 0;
+    unsigned history     = 0;
+    int compress         = 1;
+    char *opts           = hostport_param(param, &host, &port);
+
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "queue"))
+            queue_limit = atouint32_metric(val, "-F http queue: ");
+        else if (!strcasecmp(key, "history"))
+            history = atouint32_metric(val, "-F http history: ");
+        else if (!strcasecmp(key, "compress"))
+            compress = atobv(val, 1);
+        else if (!strcasecmp(key, "slow")) {
+            if (val && !strcasecmp(val, "drop"))
+                evict = 0;
+            else if (val && !strcasecmp(val, "close"))
+                evict = 1;
+            else {
+                fprintf(stderr, "rtl_433: -F http slow=drop or slow=close expected\n");
+                exit(1);
+            }
+        }
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
     fprintf(stderr, "HTTP server at %s port %s\n", host, port);
 
-    list_push(&cfg->output_handler, data_output_http_create(get_mgr(cfg), host, port, cfg));
+    add_net_output(cfg, data_output_http_create(get_mgr(cfg), host, port, cfg, queue_limit, evict, history, compress));
 }
 
 void add_trigger_output(r_cfg_t *cfg, char *param)
 {
-    list_push(&cfg->output_handler, data_output_trigger_create(fopen_output(param)));
+    file_flush_policy_t policy = {0}; // the trigger output flushes every event
+    list_push(&cfg->output_handler, data_output_trigger_create(fopen_output(param, &policy)));
 }
 
 void add_null_output(r_cfg_t *cfg, char *param)
@@ -1004,50 +2363,98 @@ void add_null_output(r_cfg_t *cfg, char *param)
     list_push(&cfg->output_handler, NULL);
 }
 
+void add_output_filter(r_cfg_t *cfg, output_filter_opts_t const *opts)
+{
+    if (!cfg->output_handler.len)
+        return;
+    output_filter_t *filter = output_filter_create(cfg->output_handler.len - 1, opts);
+    if (filter)
+        list_push(&cfg->output_filters, filter);
+    if (filter && opts->raw)
+        cfg->raw_outputs++;
+    if (filter && opts->iq) {
+        // the events are captured from the ring of the signal grabber
+        if (!cfg->demod->samp_grab)
+            cfg->demod->samp_grab = samp_grab_create(SIGNAL_GRABBER_BUFFER);
+        cfg->iq_outputs++;
+    }
+}
+
 void add_rtltcp_output(r_cfg_t *cfg, char *param)
 {
-    char *host = "localhost";
-    char *port = "1234";
-    hostport_param(param, &host, &port);
+    char *host                = "localhost";
+    char *port                = "1234";
+    rtltcp_output_opts_t opts = {0};
+    char *kwargs              = hostport_param(param, &host, &port);
+
+    char *key, *val;
+    while (getkwargs(&kwargs, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "buffer"))
+            opts.client_buffer = atouint32_metric(val, "-F rtl_tcp buffer: ");
+        else if (!strcasecmp(key, "rate"))
+            opts.sample_rate = atouint32_metric(val, "-F rtl_tcp rate: ");
+        else if (!strcasecmp(key, "freq"))
+            opts.frequency = atouint32_metric(val, "-F rtl_tcp freq: ");
+        else if (!strcasecmp(key, "format") && val && !strcasecmp(val, "cu8"))
+            opts.sample_size = 2;
+        else if (!strcasecmp(key, "format") && val && !strcasecmp(val, "cs16"))
+            opts.sample_size = 4;
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            exit(1);
+        }
+    }
+    if (opts.frequency && !opts.sample_rate) {
+        fprintf(stderr, "-F rtl_tcp freq needs the rate of the sub-channel.\n");
+        exit(1);
+    }
     fprintf(stderr, "rtl_tcp server at %s port %s\n", host, port);
 
-    list_push(&cfg->raw_handler, raw_output_rtltcp_create(host, port, cfg));
+    list_push(&cfg->raw_handler, raw_output_rtltcp_create(host, port, cfg, &opts));
 }
 
-void add_sr_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
+void add_pulses_output(r_cfg_t *cfg, char *param)
 {
-    // create channels
-    add_dumper(cfg, "U8:LOGIC:logic-1-1", overwrite);
-    add_dumper(cfg, "F32:I:analog-1-4-1", overwrite);
-    add_dumper(cfg, "F32:Q:analog-1-5-1", overwrite);
-    add_dumper(cfg, "F32:AM:analog-1-6-1", overwrite);
-    add_dumper(cfg, "F32:FM:analog-1-7-1", overwrite);
-    cfg->sr_filename = spec;
-    cfg->sr_execopen = overwrite;
+    char *host = "localhost";
+    char *port = PULSE_UDP_PORT;
+    hostport_param(param, &host, &port);
+    fprintf(stderr, "Pulse datagrams to %s port %s\n", host, port);
+
+    pulse_udp_t *udp = pulse_udp_sender_create(host, port);
+    if (!udp)
+        exit(1);
+    list_push(&cfg->pulse_handler, udp);
+    cfg->demod->enable_FM_demod = 1; // the central decoder might have FSK decoders
 }
 
 void close_dumpers(struct r_cfg *cfg)
 {
+    sample_dump_free(cfg->demod->sample_dump); // writes the queued buffers
+    cfg->demod->sample_dump = NULL;
     for (void **iter = cfg->demod->dumper.elems; iter && *iter; ++iter) {
         file_info_t *dumper = *iter;
+        if (dumper->arrow && pulse_arrow_close(dumper->arrow))
+            fprintf(stderr, "Writing %s failed\n", dumper->spec);
+        dumper->arrow = NULL;
         if (dumper->file && (dumper->file != stdout)) {
-            fclose(dumper->file);
+            if (!dumper->compression)
+                fclose(dumper->file);
+            else if (compress_pipe_close(dumper->file))
+                fprintf(stderr, "Compressing %s failed\n", dumper->spec);
             dumper->file = NULL;
         }
+        sample_index_free(dumper->index);
+        dumper->index = NULL;
+        if (!dumper->file) {
+            free(dumper->file_buffer);
+            dumper->file_buffer = NULL;
+        }
     }
 
-    char const *labels[] = {
-            "FRAME", // probe1
-            "ASK", // probe2
-            "FSK", // probe3
-            "I", // analog4
-            "Q", // analog5
-            "AM", // analog6
-            "FM", // analog7
-    };
-    if (cfg->sr_filename) {
-        write_sigrok(cfg->sr_filename, cfg->samp_rate, 3, 4, labels);
-    }
     if (cfg->sr_execopen) {
         open_pulseview(cfg->sr_filename);
     }
@@ -1056,8 +2463,9 @@ void close_dumpers(struct r_cfg *cfg)
 void add_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
 {
     size_t spec_len = strlen(spec);
-    if (spec_len >= 3 && !strcmp(&spec[spec_len - 3], ".sr")) {
-        add_sr_dumper(cfg, spec, overwrite);
+    int sigrok      = spec_len >= 3 && !strcmp(&spec[spec_len - 3], ".sr");
+    if (sigrok && cfg->sr_filename) {
+        fprintf(stderr, "Only one Sigrok output is supported, ignoring %s\n", spec);
         return;
     }
 
@@ -1065,8 +2473,17 @@ void add_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
     if (!dumper)
         FATAL_CALLOC("add_dumper()");
     list_push(&cfg->demod->dumper, dumper);
+    if (!cfg->demod->sample_dump)
+        cfg->demod->sample_dump = sample_dump_create(&cfg->demod->dumper);
+    if (!cfg->demod->sample_dump)
+        FATAL_CALLOC("add_dumper()");
 
     file_info_parse_filename(dumper, spec);
+    if (sigrok) {
+        dumper->format   = SIGROK_SR;
+        cfg->sr_filename = spec;
+        cfg->sr_execopen = overwrite;
+    }
     if (strcmp(dumper->path, "-") == 0) { /* Write samples to stdout */
         dumper->file = stdout;
 #ifdef _WIN32
@@ -1078,25 +2495,362 @@ void add_dumper(r_cfg_t *cfg, char const *spec, int overwrite)
             fprintf(stderr, "Output file %s already exists, exiting\n", spec);
             exit(1);
         }
-        dumper->file = fopen(dumper->path, "wb");
+        if (dumper->compression) // compress on a helper process
+            dumper->file = compress_pipe_open(dumper->path, dumper->compression, 1);
+        else
+            dumper->file = fopen(dumper->path, "wb");
         if (!dumper->file) {
             fprintf(stderr, "Failed to open %s\n", spec);
             exit(1);
         }
     }
     if (dumper->format == VCD_LOGIC) {
+        // a large buffer, the formatted blocks of the packages are flushed in few writes
+        if (dumper->file != stdout) {
+            dumper->file_buffer = malloc(VCD_FILE_BUFFER);
+            if (!dumper->file_buffer)
+                WARN_MALLOC("add_dumper()");
+            else
+                setvbuf(dumper->file, dumper->file_buffer, _IOFBF, VCD_FILE_BUFFER);
+        }
         pulse_data_print_vcd_header(dumper->file, cfg->samp_rate);
     }
     if (dumper->format == PULSE_OOK) {
         pulse_data_print_pulse_header(dumper->file);
     }
+    if (dumper->format == PULSE_OOK_BIN) {
+        pulse_bin_print_header(dumper->file, cfg->samp_rate);
+    }
+    if (dumper->format == PULSE_ARROW) {
+        dumper->arrow = pulse_arrow_create(dumper->file);
+        if (!dumper->arrow)
+            FATAL_CALLOC("add_dumper()");
+    }
 }
 
 void add_infile(r_cfg_t *cfg, char *in_file)
 {
+    if (!strncmp(in_file, "pulses:", 7)) {
+        cfg->pulse_input = in_file + 7;
+        return;
+    }
     list_push(&cfg->in_files, in_file);
 }
 
+void add_channel(r_cfg_t *cfg, char const *spec)
+{
+    char *buf = strdup(spec);
+    if (!buf)
+        FATAL_STRDUP("add_channel()");
+    char *p = buf;
+    char *freq_str = asepc(&p, ':');
+    uint32_t frequency   = atouint32_metric(freq_str, "-j: ");
+    uint32_t sample_rate = p ? atouint32_metric(p, "-j: ") : DEFAULT_CHANNEL_RATE;
+    free(buf);
+
+    if (!cfg->channelizer) {
+        cfg->channelizer = channelizer_create();
+        if (!cfg->channelizer)
+            FATAL_CALLOC("add_channel()");
+    }
+    if (!channelizer_add(cfg->channelizer, frequency, sample_rate))
+        exit(1);
+}
+
+/// Create a demod state with the same settings as the main demod.
+static struct dm_state *create_demod_like(r_cfg_t *cfg)
+{
+    struct dm_state *demod = cfg->demod;
+    struct dm_state *sub   = calloc(1, sizeof(*sub));
+    if (!sub)
+        FATAL_CALLOC("create_demod_like()");
+
+    sub->auto_level       = demod->auto_level;
+    sub->squelch_offset   = demod->squelch_offset;
+    sub->level_limit      = demod->level_limit;
+    sub->min_level        = demod->min_level;
+    sub->min_snr          = demod->min_snr;
+    memcpy(sub->extra_levels, demod->extra_levels, sizeof(sub->extra_levels));
+    sub->extra_level_count = demod->extra_level_count;
+    sub->low_pass         = demod->low_pass;
+    sub->use_mag_est      = demod->use_mag_est;
+    sub->detect_verbosity = demod->detect_verbosity;
+    sub->enable_FM_demod  = demod->enable_FM_demod;
+    sub->demod_threads    = demod->demod_threads;
+    sub->fm_full          = demod->fm_full;
+    sub->env8             = demod->env8;
+    sub->dedup_ms         = demod->dedup_ms;
+    sub->dedup_reuse      = demod->dedup_reuse;
+    sub->decoder_pool     = demod->decoder_pool; // shared, the demods are decoded in turn
+    sub->demod_pool       = demod->demod_pool; // shared, the demods are demodulated in turn
+    sub->analyze_pulses   = demod->analyze_pulses;
+    if (demod->analyzer_stats)
+        sub->analyzer_stats = pulse_analyzer_stats_create(demod->analyzer_stats->interval);
+    sub->demod_FM_state.mode = demod->demod_FM_state.mode;
+    sub->lowpass_filter_state.order  = demod->lowpass_filter_state.order;
+    sub->lowpass_filter_state.cutoff = demod->lowpass_filter_state.cutoff;
+
+    sub->pulse_detect = pulse_detect_create();
+    return sub;
+}
+
+void start_channels(r_cfg_t *cfg)
+{
+    if (!cfg->channelizer)
+        return;
+
+    if (cfg->channelizer_opencl && !cfg->channelizer->cl) {
+        if (channelizer_set_backend(cfg->channelizer, CHANNELIZER_OPENCL, cfg->channelizer_device) < 0)
+            fprintf(stderr, "The OpenCL channelizer is not available, processing the channels on the CPU.\n");
+    }
+
+    struct dm_state *demod = cfg->demod;
+    for (size_t i = cfg->channel_demods.len; i < cfg->channelizer->channels.len; ++i) {
+        // same settings as the main demod, channels are always CS16 (magnitude)
+        struct dm_state *ch_demod = create_demod_like(cfg);
+        ch_demod->use_mag_est     = 1;
+        ch_demod->sample_size     = 4;
+        ch_demod->kernels         = baseband_get_kernels(CS16_IQ, 0);
+
+        pulse_detect_set_levels(ch_demod->pulse_detect, ch_demod->use_mag_est, ch_demod->level_limit, ch_demod->min_level, ch_demod->min_snr, ch_demod->detect_verbosity);
+        pulse_detect_set_fsk_alt(ch_demod->pulse_detect, cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_BOTH);
+        if (pulse_detect_set_extra_levels(ch_demod->pulse_detect, ch_demod->extra_levels, ch_demod->extra_level_count))
+            FATAL_CALLOC("start_channels()");
+
+        list_push(&cfg->channel_demods, ch_demod);
+    }
+
+    if (demod->dumper.len || demod->samp_grab || demod->am_analyze) {
+        fprintf(stderr, "Dumpers, signal grabber, and analyzer are not available with channels.\n");
+    }
+}
+
+sdr_input_t *insert_sdr_input(r_cfg_t *cfg, size_t idx, char const *dev_query)
+{
+    if (cfg->sdr_inputs.len >= SDR_MAX_DEVICES - 1) {
+        fprintf(stderr, "Max number of devices reached %d\n", SDR_MAX_DEVICES);
+        exit(1);
+    }
+    sdr_input_t *input = calloc(1, sizeof(*input));
+    if (!input)
+        FATAL_CALLOC("insert_sdr_input()");
+    input->cfg       = cfg;
+    input->dev_query = dev_query;
+
+    list_push(&cfg->sdr_inputs, input);
+    if (idx > cfg->sdr_inputs.len - 1)
+        idx = cfg->sdr_inputs.len - 1;
+    for (size_t i = cfg->sdr_inputs.len - 1; i > idx; --i) {
+        cfg->sdr_inputs.elems[i] = cfg->sdr_inputs.elems[i - 1];
+    }
+    cfg->sdr_inputs.elems[idx] = input;
+    return input;
+}
+
+void add_sdr_input(r_cfg_t *cfg, char const *dev_query)
+{
+    insert_sdr_input(cfg, cfg->sdr_inputs.len, dev_query);
+}
+
+void start_sdr_inputs(r_cfg_t *cfg)
+{
+    if (!cfg->sdr_inputs.len)
+        return;
+
+    // the n-th device is tuned to the n-th frequency
+    for (size_t i = 0; i < cfg->sdr_inputs.len; ++i) {
+        sdr_input_t *input = cfg->sdr_inputs.elems[i];
+        input->frequency   = (int)i + 1 < cfg->frequencies ? cfg->frequency[i + 1] : DEFAULT_FREQUENCY;
+        if (input->demod)
+            continue;
+        input->demod       = create_demod_like(cfg);
+        input->demod->iq_correct_state.enabled = cfg->demod->iq_correct_state.enabled;
+
+        pulse_detect_set_levels(input->demod->pulse_detect, input->demod->use_mag_est, input->demod->level_limit, input->demod->min_level, input->demod->min_snr, input->demod->detect_verbosity);
+        pulse_detect_set_fsk_alt(input->demod->pulse_detect, cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_BOTH);
+        if (pulse_detect_set_extra_levels(input->demod->pulse_detect, input->demod->extra_levels, input->demod->extra_level_count))
+            FATAL_CALLOC("start_sdr_inputs()");
+    }
+    if (cfg->frequencies > (int)cfg->sdr_inputs.len + 1) {
+        fprintf(stderr, "Frequency hopping is not available with several devices, ignoring the extra frequencies.\n");
+    }
+    if (cfg->frequencies > 1)
+        cfg->frequencies = 1;
+
+    struct dm_state *demod = cfg->demod;
+    if (demod->dumper.len || demod->samp_grab || demod->am_analyze || cfg->channelizer || cfg->decimator || cfg->raw_handler.len) {
+        fprintf(stderr, "Dumpers, signal grabber, analyzer, channels, processing rate, and raw outputs only use the first device.\n");
+    }
+}
+
+/// Create the demod state and decoders of a batch worker.
+static void start_batch_demod(r_cfg_t *batch, r_cfg_t *cfg)
+{
+    batch->demod = create_demod_like(cfg);
+    batch->demod->decoder_pool = NULL;
+    batch->demod->demod_pool   = NULL;
+    batch->demod->iq_correct_state.enabled = cfg->demod->iq_correct_state.enabled;
+    batch->demod->adapt_secs   = cfg->demod->adapt_secs;
+    pulse_detect_set_levels(batch->demod->pulse_detect, batch->demod->use_mag_est, batch->demod->level_limit, batch->demod->min_level, batch->demod->min_snr, batch->demod->detect_verbosity);
+    pulse_detect_set_fsk_alt(batch->demod->pulse_detect, cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_BOTH);
+    if (pulse_detect_set_extra_levels(batch->demod->pulse_detect, batch->demod->extra_levels, batch->demod->extra_level_count))
+        FATAL_CALLOC("start_batch_demod()");
+
+    // the decoders in one block, the dispatch walks them in order
+    size_t len = cfg->demod->r_devs.len;
+    r_device *block = calloc(len ? len : 1, sizeof(*block));
+    if (!block)
+        FATAL_CALLOC("start_batch_demod()");
+    batch->demod->r_devs_block = block;
+    list_ensure_size(&batch->demod->r_devs, len);
+    for (size_t i = 0; i < len; ++i) {
+        clone_protocol(&block[i], cfg->demod->r_devs.elems[i]);
+        push_protocol(batch, &block[i]);
+    }
+    batch->input_pos = cfg->input_pos;
+}
+
+static void free_batch_demod(r_cfg_t *batch)
+{
+    list_free_elems(&batch->demod->r_devs, (list_elem_free_fn)release_cloned_protocol);
+    decoder_dispatch_free(&batch->demod->dispatch);
+    for (unsigned i = 0; i < BAND_COUNT; ++i)
+        decoder_dispatch_free(&batch->demod->band_dispatch[i]);
+    free(batch->demod->r_devs_block);
+    free_channel_demod(batch->demod);
+    batch->demod = NULL;
+}
+
+r_cfg_t *r_create_batch_cfg(r_cfg_t *cfg)
+{
+    r_cfg_t *batch = malloc(sizeof(*batch));
+    if (!batch)
+        FATAL_MALLOC("r_create_batch_cfg()");
+    *batch = *cfg; // the settings, tags, and decoder list are shared
+
+    // the worker has its own demod state and decoders, and no device, channels, or outputs
+    batch->metrics = calloc(1, sizeof(*batch->metrics));
+    if (!batch->metrics)
+        FATAL_CALLOC("r_create_batch_cfg()");
+
+    batch->dev            = NULL;
+    batch->sdr_inputs     = (list_t){0};
+    batch->channelizer    = NULL;
+    batch->channel_demods = (list_t){0};
+    batch->decimator      = NULL;
+    batch->raw_handler    = (list_t){0};
+    batch->pulse_handler  = (list_t){0};
+    batch->output_handler = (list_t){0};
+    batch->file_outputs   = (list_t){0};
+    batch->net_outputs    = (list_t){0};
+    batch->net_thread     = NULL;
+    batch->batch_events   = NULL;
+    batch->output_start   = 0;
+    batch->output_end     = 0;
+    batch->mgr            = NULL;
+    batch->event_fusion   = NULL;
+    batch->second_chance  = NULL;
+    batch->pulse_recorder = NULL;
+
+    start_batch_demod(batch, cfg);
+    return batch;
+}
+
+void r_reset_batch_cfg(r_cfg_t *batch, r_cfg_t *cfg)
+{
+    free_batch_demod(batch);
+    start_batch_demod(batch, cfg);
+}
+
+void r_free_batch_cfg(r_cfg_t *batch)
+{
+    free_batch_demod(batch);
+    free(batch->metrics);
+    free(batch);
+}
+
+void start_decimator(r_cfg_t *cfg)
+{
+    if (!cfg->processing_rate)
+        return;
+    if (cfg->channelizer) {
+        fprintf(stderr, "Sub-channels are decimated to their own rate, ignoring the processing rate.\n");
+        return;
+    }
+
+    cfg->decimator = decimator_create(cfg->processing_rate);
+    if (!cfg->decimator)
+        exit(1);
+    // the decimated samples are CS16, which always use the magnitude estimate
+    cfg->demod->use_mag_est = 1;
+}
+
+void start_hop_states(r_cfg_t *cfg)
+{
+    struct dm_state *demod = cfg->demod;
+    if (cfg->frequencies < 2 || demod->hop_states)
+        return;
+
+    demod->hop_states = calloc(cfg->frequencies, sizeof(*demod->hop_states));
+    if (!demod->hop_states)
+        FATAL_CALLOC("start_hop_states()");
+    demod->hop_states_len = cfg->frequencies;
+    demod->hop_index      = 0;
+
+    // all frequencies start with the settings of the main demod
+    for (unsigned i = 0; i < demod->hop_states_len; ++i) {
+        hop_state_t *state          = &demod->hop_states[i];
+        state->lowpass_filter_state = demod->lowpass_filter_state;
+        state->demod_FM_state       = demod->demod_FM_state;
+        state->iq_correct_state     = demod->iq_correct_state;
+        state->noise_level          = demod->noise_level;
+        state->min_level_auto       = demod->min_level_auto;
+        if (i == demod->hop_index) {
+            state->pulse_detect = demod->pulse_detect;
+            continue;
+        }
+        state->pulse_detect = pulse_detect_create();
+        if (!state->pulse_detect)
+            FATAL_CALLOC("start_hop_states()");
+        pulse_detect_set_levels(state->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level, demod->min_snr, demod->detect_verbosity);
+        pulse_detect_set_fsk_alt(state->pulse_detect, cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_BOTH);
+        if (pulse_detect_set_extra_levels(state->pulse_detect, demod->extra_levels, demod->extra_level_count))
+            FATAL_CALLOC("start_hop_states()");
+    }
+}
+
+void select_hop_state(r_cfg_t *cfg, unsigned index)
+{
+    struct dm_state *demod = cfg->demod;
+    if (index == demod->hop_index)
+        return;
+    if (!demod->hop_states || index >= demod->hop_states_len) {
+        demod->hop_index = index;
+        return;
+    }
+
+    // the package in progress is cut by the retune, resume the detector idle when it is tuned again
+    pulse_detect_reset(demod->pulse_detect);
+    pulse_data_clear(&demod->pulse_data);
+    pulse_data_clear(&demod->fsk_pulse_data);
+
+    hop_state_t *old          = &demod->hop_states[demod->hop_index];
+    old->lowpass_filter_state = demod->lowpass_filter_state;
+    old->demod_FM_state       = demod->demod_FM_state;
+    old->iq_correct_state     = demod->iq_correct_state;
+    old->noise_level          = demod->noise_level;
+    old->min_level_auto       = demod->min_level_auto;
+
+    hop_state_t const *state    = &demod->hop_states[index];
+    demod->pulse_detect         = state->pulse_detect;
+    demod->lowpass_filter_state = state->lowpass_filter_state;
+    demod->demod_FM_state       = state->demod_FM_state;
+    demod->iq_correct_state     = state->iq_correct_state;
+    demod->noise_level          = state->noise_level;
+    demod->min_level_auto       = state->min_level_auto;
+    demod->hop_index            = index;
+}
+
 void add_data_tag(struct r_cfg *cfg, char *param)
 {
     list_push(&cfg->data_tags, data_tag_create(param, get_mgr(cfg)));
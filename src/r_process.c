@@ -0,0 +1,943 @@
+/** @file
+    The demodulation pipeline, sample buffers and pulse data in, events out.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "r_api.h"
+#include "r_private.h"
+#include "r_device.h"
+#include "r_util.h"
+#include "rtl_433.h"
+#include "baseband.h"
+#include "channelizer.h"
+#include "decimator.h"
+#include "hop_sched.h"
+#include "load_shed.h"
+#include "spectrum.h"
+#include "pulse_analyzer.h"
+#include "pulse_detect.h"
+#include "pulse_detect_fsk.h"
+#include "pulse_slicer.h"
+#include "rfraw.h"
+#include "data.h"
+#include "fileformat.h"
+#include "samp_grab.h"
+#include "sample_dump.h"
+#include "pulse_bin.h"
+#include "pulse_udp.h"
+#include "pulse_recorder.h"
+#include "pulse_arrow.h"
+#include "am_analyze.h"
+#include "metrics.h"
+#include "trace_event.h"
+#include "usdt.h"
+#include "compat_time.h"
+#include "decoder_pool.h"
+#include "fatal.h"
+
+/// AM and FM demodulation of one buffer as two jobs, FM runs on the demod worker.
+typedef struct demod_am_fm_job {
+    struct dm_state *demod;
+    void const *iq_buf;
+    int16_t *fm_buf;
+    unsigned long n_samples;
+    uint32_t samp_rate;
+    float low_pass;
+    baseband_clip_t *clip;
+    float avg_db;
+} demod_am_fm_job_t;
+
+static void demod_am_fm_job(void *ctx, unsigned job)
+{
+    demod_am_fm_job_t *j   = ctx;
+    struct dm_state *demod = j->demod;
+    baseband_kernels_t const *kernels = demod->kernels;
+    if (job == 0) {
+        j->avg_db = kernels->envelope(j->iq_buf, demod->temp_buf, j->n_samples, demod->use_mag_est, j->clip);
+        baseband_low_pass_filter(demod->temp_buf, demod->am_buf, j->n_samples, &demod->lowpass_filter_state);
+        if (demod->am8_buf)
+            baseband_envelope_8bit(demod->am_buf, demod->am8_buf, j->n_samples);
+    }
+    else {
+        kernels->demod_FM(j->iq_buf, j->fm_buf, j->n_samples, j->samp_rate, j->low_pass, &demod->demod_FM_state);
+    }
+}
+
+/// Find a package identical to one seen within the dedup time, refreshes the time of a match.
+static package_cache_entry_t *package_cache_lookup(struct dm_state *demod, int package_type, pulse_data_t const *pulses, uint32_t fingerprint)
+{
+    uint64_t window = (uint64_t)demod->dedup_ms * pulses->sample_rate / 1000;
+    for (unsigned i = 0; i < PACKAGE_CACHE_SIZE; ++i) {
+        package_cache_entry_t *entry = &demod->package_cache[i];
+        if (entry->package_type == package_type
+                && entry->fingerprint == fingerprint
+                && entry->num_pulses == pulses->num_pulses
+                && pulses->offset >= entry->offset
+                && pulses->offset - entry->offset <= window) {
+            entry->offset = pulses->offset;
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/// Remember a decoded package and the decoders with events of the dispatch, replaces the oldest entry.
+static void package_cache_store(struct dm_state *demod, int package_type, pulse_data_t const *pulses, uint32_t fingerprint, decoder_dispatch_t const *dispatch, int fsk_alt)
+{
+    if (dispatch->num_hits > DISPATCH_HITS)
+        return; // too many decoders to run again, e.g. for the coverage report
+    package_cache_entry_t *entry = &demod->package_cache[demod->package_cache_next];
+    demod->package_cache_next = (demod->package_cache_next + 1) % PACKAGE_CACHE_SIZE;
+
+    entry->fingerprint  = fingerprint;
+    entry->num_pulses   = pulses->num_pulses;
+    entry->package_type = package_type;
+    entry->offset       = pulses->offset;
+    entry->num_decoders = dispatch->num_hits;
+    entry->fsk_alt      = fsk_alt;
+    memcpy(entry->decoders, dispatch->hits, dispatch->num_hits * sizeof(*entry->decoders));
+}
+
+/// Demote decoders without events since the last adaptation, uses the main demod for the timing.
+static void adapt_decoders(r_cfg_t *cfg, list_t *r_devs, pulse_data_t const *pulses)
+{
+    struct dm_state *demod = cfg->demod;
+    if (!pulses->sample_rate)
+        return;
+    double now = (double)pulses->offset / pulses->sample_rate;
+    // the first package, or the input restarted
+    if (!demod->adapt_time || now + demod->adapt_secs < demod->adapt_time) {
+        demod->adapt_time = now + demod->adapt_secs;
+        return;
+    }
+    if (now < demod->adapt_time)
+        return;
+    demod->adapt_time = now + demod->adapt_secs;
+
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (r_dev->hits == r_dev->adapt_hits && !r_dev->sample_every) {
+            r_dev->sample_every = ADAPT_SAMPLING;
+            r_dev->sample_count = 0;
+            if (cfg->verbosity > 1)
+                fprintf(stderr, "Decoder [%u] \"%s\" had no events, sampling every %u packages\n", r_dev->protocol_num, r_dev->name, ADAPT_SAMPLING);
+        }
+        r_dev->adapt_hits = r_dev->hits;
+    }
+}
+
+/// Note a package on air for the latency of its events, the package ended some samples before the buffer arrived.
+static void package_on_air(r_cfg_t *cfg, pulse_data_t const *pulses)
+{
+    metrics_t *metrics = cfg->metrics;
+    if (!metrics->buffer_us || !pulses->sample_rate) {
+        metrics->package_end_us = 0.0;
+        return; // not received live
+    }
+    double us_per_sample    = 1e6 / pulses->sample_rate;
+    double start_us         = metrics->buffer_us - pulses->start_ago * us_per_sample;
+    metrics->package_end_us = metrics->buffer_us - pulses->end_ago * us_per_sample;
+    trace_event_complete(cfg->trace, "package", TRACE_PACKAGES, start_us, metrics->package_end_us - start_us, "pulses", pulses->num_pulses);
+}
+
+/// Remember the samples of a package with events, the extra detection levels skip packages overlapping them.
+static void decoded_span_add(struct dm_state *demod, pulse_data_t const *pulses, uint64_t buf_end)
+{
+    decoded_span_t *span     = &demod->decoded_spans[demod->decoded_span_next];
+    demod->decoded_span_next = (demod->decoded_span_next + 1) % DECODED_SPANS;
+    span->start              = pulses->offset;
+    span->end                = buf_end - pulses->end_ago;
+}
+
+/// Check if a package overlaps a recent package with events.
+static int decoded_span_overlaps(struct dm_state const *demod, pulse_data_t const *pulses, uint64_t buf_end)
+{
+    uint64_t end = buf_end - pulses->end_ago;
+    for (unsigned i = 0; i < DECODED_SPANS; ++i) {
+        decoded_span_t const *span = &demod->decoded_spans[i];
+        if (span->start < end && span->end > pulses->offset)
+            return 1;
+    }
+    return 0;
+}
+
+/// Swap the contents of two pulse trains, the storage moves along.
+static void pulse_data_swap(pulse_data_t *a, pulse_data_t *b)
+{
+    pulse_data_t t = *a;
+    *a             = *b;
+    *b             = t;
+}
+
+/// Detect the packages at the extra levels in the same envelope and decode those no package with events overlaps, see -Y levels.
+static int run_extra_levels(r_cfg_t *cfg, struct dm_state *demod, decoder_dispatch_t *dispatch, list_t *r_devs, unsigned long n_samples, unsigned fpdm)
+{
+    metrics_t *metrics = cfg->metrics;
+    uint64_t buf_end   = cfg->input_pos + n_samples;
+    int events         = 0;
+    for (unsigned i = 0; i < pulse_detect_extra_levels(demod->pulse_detect); ++i) {
+        for (;;) {
+            pulse_data_t *pulses;
+            pulse_data_t *fsk_pulses;
+            double begin     = metrics_begin(metrics);
+            int package_type = pulse_detect_extra_package(demod->pulse_detect, i, demod->am_buf, demod->fm_buf, n_samples, cfg->samp_rate, cfg->input_pos, fpdm, &pulses, &fsk_pulses);
+            metrics_end(metrics, METRICS_PULSE_DETECT, begin);
+            if (!package_type)
+                break;
+            pulse_data_t *package = package_type == PULSE_DATA_OOK ? pulses : fsk_pulses;
+            if (decoded_span_overlaps(demod, package, buf_end))
+                continue; // the same signal as decoded, or one drowned by it
+
+            // the meta data of the events is read from the current package, swap the package of the level in
+            pulse_data_swap(&demod->pulse_data, pulses);
+            pulse_data_swap(&demod->fsk_pulse_data, fsk_pulses);
+            package = package_type == PULSE_DATA_OOK ? &demod->pulse_data : &demod->fsk_pulse_data;
+            package->levels_due = 1;
+            package_on_air(cfg, package);
+            demod->package_start_ago = package->start_ago;
+            demod->package_end_ago   = package->end_ago;
+            begin = metrics_begin(metrics);
+            int p_events = package_type == PULSE_DATA_OOK
+                    ? run_ook_dispatch(demod->decoder_pool, dispatch, r_devs, package)
+                    : run_fsk_dispatch(demod->decoder_pool, dispatch, r_devs, package);
+            metrics_end(metrics, METRICS_DECODE, begin);
+            if (p_events)
+                decoded_span_add(demod, package, buf_end);
+            events += p_events;
+            pulse_data_swap(&demod->pulse_data, pulses);
+            pulse_data_swap(&demod->fsk_pulse_data, fsk_pulses);
+        }
+    }
+    return events;
+}
+
+/// Queue an unclaimed package with the samples from before its start to after its end for a second chance, see -Y retry.
+static void retry_package(r_cfg_t *cfg, struct dm_state *demod, unsigned char const *iq_buf, unsigned long n_samples, uint32_t frequency, pulse_data_t const *pulses, int fsk)
+{
+    if (pulses->start_ago > n_samples || pulses->end_ago > pulses->start_ago)
+        return; // the package started in an earlier buffer
+    if (demod->load_info.format == S16_AM || demod->load_info.format == S16_FM)
+        return; // no IQ samples to detect again
+    unsigned long lead  = (unsigned long)cfg->samp_rate * SECOND_CHANCE_LEAD_MS / 1000;
+    unsigned long start = n_samples - pulses->start_ago;
+    unsigned long end   = n_samples - pulses->end_ago;
+    unsigned long first = start > lead ? start - lead : 0;
+    unsigned long last  = n_samples - end > lead ? end + lead : n_samples;
+
+    // the span ends before the buffer, the time and file position of its end are earlier
+    double cut_secs     = (double)(n_samples - last) / cfg->samp_rate;
+    struct timeval now  = demod->now;
+    long cut_us         = (long)(cut_secs * 1e6);
+    now.tv_sec         -= cut_us / 1000000;
+    now.tv_usec        -= cut_us % 1000000;
+    if (now.tv_usec < 0) {
+        now.tv_sec  -= 1;
+        now.tv_usec += 1000000;
+    }
+
+    second_chance_span_t span = {
+            .iq_buf          = iq_buf + first * demod->sample_size,
+            .len             = (uint32_t)((last - first) * demod->sample_size),
+            .format          = demod->kernels->format,
+            .samp_rate       = cfg->samp_rate,
+            .frequency       = frequency,
+            .input_pos       = cfg->input_pos + first,
+            .now             = now,
+            .sample_file_pos = demod->sample_file_pos - (float)cut_secs,
+            .fsk             = fsk,
+    };
+    second_chance_push(cfg->second_chance, &span);
+}
+
+/// Keep a copy of a package in the pulse flight recorder, with the wall time of its end, see -Y recorder.
+static void record_package(r_cfg_t *cfg, struct dm_state *demod, pulse_data_t const *pulses)
+{
+    uint64_t now_ms = (uint64_t)demod->now.tv_sec * 1000 + demod->now.tv_usec / 1000;
+    uint64_t ago_ms = pulses->sample_rate ? (uint64_t)pulses->end_ago * 1000 / pulses->sample_rate : 0;
+    pulse_recorder_add(cfg->pulse_recorder, pulses, now_ms - ago_ms);
+}
+
+/// Time the baseband kernels one by one on copies of the states, the results are discarded, see -Y bench.
+static void bench_baseband_kernels(struct dm_state *demod, metrics_t *metrics, void const *demod_buf, unsigned long n_samples, uint32_t samp_rate, float low_pass)
+{
+    baseband_kernels_t const *kernels = demod->kernels;
+    filter_state_t lp_state           = demod->lowpass_filter_state;
+    demodfm_state_t fm_state          = demod->demod_FM_state;
+    int16_t *scratch                  = (int16_t *)demod->f32_buf; // allocated for the bench, and large enough for the samples
+
+    double begin = monotonic_time_us();
+    kernels->envelope(demod_buf, demod->temp_buf, n_samples, demod->use_mag_est, NULL);
+    double end = monotonic_time_us();
+    metrics->kernel_us[METRICS_ENVELOPE] += end - begin;
+
+    begin = end;
+    baseband_low_pass_filter(demod->temp_buf, scratch, n_samples, &lp_state);
+    end = monotonic_time_us();
+    metrics->kernel_us[METRICS_LOW_PASS] += end - begin;
+
+    if (demod->enable_FM_demod) {
+        begin = end;
+        kernels->demod_FM(demod_buf, scratch, n_samples, samp_rate, low_pass, &fm_state);
+        metrics->kernel_us[METRICS_DEMOD_FM] += monotonic_time_us() - begin;
+    }
+}
+
+/// Add the clipping of an input buffer to the metrics.
+static void clip_to_metrics(metrics_t *metrics, baseband_clip_t const *clip)
+{
+    metrics->samples_clipped += clip->clipped;
+    metrics->samples_near_zero += clip->near_zero;
+    metrics->input_peak_dbfs = baseband_clip_peak_dbfs(clip);
+}
+
+/// FM samples demodulated around an envelope span, for the filters to settle and the pulse detector to see the gap start.
+#define FM_GATE_GUARD 256
+
+/// FM demodulation of the spans where the envelope is above a level, zeros elsewhere.
+///
+/// The tail of the buffer is always demodulated, the discriminator and filter state
+/// then continue into the next buffer. Within a buffer the guard ahead of a span
+/// settles the state after the skipped samples.
+static void demod_fm_gated(baseband_kernels_t const *kernels, uint8_t const *iq_buf, int16_t const *am_buf, uint8_t const *am8_buf, int16_t *fm_buf, unsigned long n_samples,
+        uint32_t samp_rate, float low_pass, demodfm_state_t *fm_state, int level)
+{
+    int const len   = (int)n_samples;
+    int const tail  = len > FM_GATE_GUARD ? len - FM_GATE_GUARD : 0;
+    int done        = 0; // FM is demodulated or zeroed up to here
+    int pos         = 0;
+    while (done < len) {
+        pos += am8_buf ? envelope_find_above_8bit(&am8_buf[pos], &am_buf[pos], len - pos, level)
+                       : envelope_find_above(&am_buf[pos], len - pos, level);
+        int start = pos < tail ? pos - FM_GATE_GUARD : tail;
+        start     = start > done ? start : done;
+        int below = am8_buf ? envelope_find_below_8bit(&am8_buf[pos], &am_buf[pos], len - pos, level)
+                            : envelope_find_below(&am_buf[pos], len - pos, level);
+        int end   = pos < tail ? pos + below + FM_GATE_GUARD : len;
+        end       = end < len ? end : len;
+        if (start > done)
+            memset(&fm_buf[done], 0, (start - done) * sizeof(*fm_buf));
+        kernels->demod_FM(iq_buf + (size_t)start * kernels->sample_size, &fm_buf[start], end - start, samp_rate, low_pass, fm_state);
+        done = end;
+        pos  = end;
+    }
+}
+
+int demod_buffer(r_cfg_t *cfg, struct dm_state *demod, struct dm_state *decoders, unsigned char *iq_buf, uint32_t len, unsigned long n_samples, uint32_t frequency, time_t last_frame_sec, baseband_clip_t *clip)
+{
+    char time_str[LOCAL_TIME_BUFLEN];
+    list_t *r_devs = &decoders->r_devs;
+    decoder_dispatch_t *dispatch = select_dispatch(cfg, decoders, frequency);
+    int shed                     = load_shed_level(cfg->load_shed);
+    // the analyzers and dumpers stop while shedding load
+    int shed_outputs             = shed >= LOAD_SHED_OUTPUTS;
+    int analyze_pulses           = demod->analyze_pulses && !shed_outputs;
+    list_t dumpers               = shed_outputs ? (list_t){0} : demod->dumper;
+
+    // age the frame position if there is one
+    if (demod->frame_start_ago)
+        demod->frame_start_ago += n_samples;
+    if (demod->frame_end_ago)
+        demod->frame_end_ago += n_samples;
+
+    if (demod->samp_grab) {
+        samp_grab_push(demod->samp_grab, iq_buf, len);
+    }
+
+    reserve_demod_buffers(cfg, demod, n_samples);
+
+    metrics_t *metrics = cfg->metrics;
+    double begin       = metrics_begin(metrics);
+
+    // DC offset and IQ imbalance correction for CU8, grabbed and dumped samples are not corrected
+    unsigned char *demod_buf     = iq_buf;
+    baseband_clip_t *kernel_clip = clip; // counted in the demodulation pass
+    if (clip)
+        *clip = (baseband_clip_t){0};
+    if (demod->iq_correct_state.enabled && demod->kernels->format == CU8_IQ) {
+        if (clip)
+            demod->kernels->clip_count(iq_buf, n_samples, clip); // the clipping of the SDR, not of the correction
+        kernel_clip = NULL;
+        baseband_iq_correct_cu8(iq_buf, demod->iq_buf, n_samples, &demod->iq_correct_state);
+        demod_buf = demod->iq_buf;
+    }
+
+    // Select the correct fsk pulse detector
+    unsigned fpdm = cfg->fsk_pulse_detect_mode;
+    if (cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_AUTO || cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_BOTH) {
+        if (frequency > FSK_PULSE_DETECTOR_LIMIT)
+            fpdm = FSK_PULSE_DETECT_NEW;
+        else
+            fpdm = FSK_PULSE_DETECT_OLD;
+    }
+    float low_pass = demod->low_pass != 0.0f ? demod->low_pass : fpdm ? 0.2f : 0.1f;
+    int16_t *fm_buf = demod->enable_FM_demod ? demod->fm_buf : NULL;
+    // FM only where the pulse detector reads it, unless dumped or demodulated on a thread
+    int fm_gated = fm_buf && !demod->fm_full && !demod->demod_threads && !dumpers.len;
+    // FM only if the envelope shows more than noise, while shedding load
+    int fm_shed = fm_buf && shed >= LOAD_SHED_FM;
+
+    // AM and FM demodulation
+    // With squelch we need the level before deciding to demodulate, otherwise use the fused single pass.
+    int fused = demod->squelch_offset <= 0;
+    float avg_db;
+    baseband_kernels_t const *kernels = demod->kernels;
+    baseband_low_pass_set_rate(&demod->lowpass_filter_state, cfg->samp_rate);
+    if (fused && fm_buf && demod->demod_pool && !fm_shed) {
+        // FM on the demod worker while AM is demodulated here, the output matches the fused pass
+        demod_am_fm_job_t job = {demod, demod_buf, fm_buf, n_samples, cfg->samp_rate, low_pass, kernel_clip, 0.0f};
+        decoder_pool_run(demod->demod_pool, 2, demod_am_fm_job, &job);
+        avg_db = job.avg_db;
+    }
+    else
+    if (fused) {
+        avg_db = kernels->demod_AM_FM(demod_buf, demod->am_buf, demod->am8_buf, fm_gated || fm_shed ? NULL : fm_buf, n_samples, cfg->samp_rate, low_pass, demod->use_mag_est, &demod->lowpass_filter_state, &demod->demod_FM_state, kernel_clip);
+        if (fm_gated && !fm_shed)
+            demod_fm_gated(kernels, demod_buf, demod->am_buf, demod->am8_buf, fm_buf, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state, pulse_detect_fm_level(demod->pulse_detect));
+    }
+    else {
+        avg_db = kernels->envelope(demod_buf, demod->temp_buf, n_samples, demod->use_mag_est, kernel_clip);
+    }
+
+    //fprintf(stderr, "noise level: %.1f dB current: %.1f dB min level: %.1f dB\n", demod->noise_level, avg_db, demod->min_level_auto);
+    if (demod->min_level_auto == 0.0f) {
+        demod->min_level_auto = demod->min_level;
+    }
+    if (demod->noise_level == 0.0f) {
+        demod->noise_level = demod->min_level_auto - 3.0f;
+    }
+    int noise_only = avg_db < demod->noise_level + 3.0f; // or demod->min_level_auto?
+    // always process frames if loader, dumper, or analyzers are in use, otherwise skip silent frames
+    int process_frame = demod->squelch_offset <= 0 || !noise_only || demod->load_info.format || analyze_pulses || cfg->signal_cluster.repeats || cfg->raw_mode || dumpers.len || cfg->grab_mode;
+    if (noise_only) {
+        demod->noise_level = (demod->noise_level * 7 + avg_db) / 8; // fast fall over 8 frames
+        // If auto_level and noise level well below min_level and significant change in noise level
+        if (demod->auto_level > 0 && demod->noise_level < demod->min_level - 3.0f
+                && fabsf(demod->min_level_auto - demod->noise_level - 3.0f) > 1.0f) {
+            demod->min_level_auto = demod->noise_level + 3.0f;
+            fprintf(stderr, "Estimated noise level is %.1f dB, adjusting minimum detection level to %.1f dB\n", demod->noise_level, demod->min_level_auto);
+            pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level_auto, demod->min_snr, demod->detect_verbosity);
+        }
+    } else {
+        demod->noise_level = (demod->noise_level * 31 + avg_db) / 32; // slow rise over 32 frames
+    }
+    // Report noise every report_noise seconds, but only for the first frame that second
+    if (cfg->report_noise && last_frame_sec != demod->now.tv_sec && demod->now.tv_sec % cfg->report_noise == 0) {
+        fprintf(stderr, "Current %s level %.1f dB, estimated noise %.1f dB\n",
+                noise_only ? "noise" : "signal", avg_db, demod->noise_level);
+    }
+
+    if (!fused && process_frame) {
+        baseband_low_pass_filter(demod->temp_buf, demod->am_buf, n_samples, &demod->lowpass_filter_state);
+        if (demod->am8_buf)
+            baseband_envelope_8bit(demod->am_buf, demod->am8_buf, n_samples);
+
+        if (fm_gated && !fm_shed) {
+            demod_fm_gated(kernels, demod_buf, demod->am_buf, demod->am8_buf, fm_buf, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state, pulse_detect_fm_level(demod->pulse_detect));
+        }
+        else if (fm_buf && !fm_shed) {
+            kernels->demod_FM(demod_buf, fm_buf, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state);
+        }
+    }
+    // while shedding load FM is gated to the envelope, buffers with noise only get none
+    if (fm_shed && (fused || process_frame)) {
+        if (noise_only) {
+            memset(fm_buf, 0, n_samples * sizeof(*fm_buf));
+            cfg->load_shed->fm_skipped++;
+        }
+        else {
+            demod_fm_gated(kernels, demod_buf, demod->am_buf, demod->am8_buf, fm_buf, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state, pulse_detect_fm_level(demod->pulse_detect));
+        }
+    }
+    metrics_end(metrics, METRICS_BASEBAND, begin);
+    USDT_PROBE2(baseband_done, n_samples, process_frame);
+    if (clip)
+        clip_to_metrics(metrics, clip);
+    if (!process_frame)
+        metrics->buffers_quiet++;
+    if (cfg->bench_passes)
+        bench_baseband_kernels(demod, metrics, demod_buf, n_samples, cfg->samp_rate, low_pass);
+
+    // Handle special input formats
+    if (demod->load_info.format == S16_AM) { // The IQ buffer is really AM demodulated data
+        if (len > demod->buf_len * sizeof(*demod->am_buf))
+            FATAL("Buffer too small");
+        memcpy(demod->am_buf, iq_buf, len);
+        if (demod->am8_buf)
+            baseband_envelope_8bit(demod->am_buf, demod->am8_buf, n_samples);
+    } else if (demod->load_info.format == S16_FM) { // The IQ buffer is really FM demodulated data
+        // we would need AM for the envelope too
+        if (len > demod->buf_len * sizeof(*demod->fm_buf))
+            FATAL("Buffer too small");
+        memcpy(demod->fm_buf, iq_buf, len);
+    }
+
+    int d_events = 0; // Sensor events successfully detected
+    if (r_devs->len || analyze_pulses || cfg->signal_cluster.repeats || cfg->raw_mode || dumpers.len || cfg->grab_mode || cfg->pulse_handler.len) {
+        // Detect a package and loop through demodulators with pulse data
+        int package_type = PULSE_DATA_OOK;  // Just to get us started
+        int dump_logic   = 0;
+        for (void **iter = dumpers.elems; iter && *iter; ++iter) {
+            file_info_t const *dumper = *iter;
+            dump_logic |= dumper->format == U8_LOGIC || dumper->format == SIGROK_SR;
+        }
+        // the levels are computed for each package only if dumped, sent, recorded, or analyzed, else on first use by an event
+        int package_levels = dumpers.len || cfg->pulse_handler.len || cfg->pulse_recorder || cfg->raw_mode || analyze_pulses;
+        pulse_detect_set_envelope_8bit(demod->pulse_detect, demod->am8_buf);
+        while (package_type && process_frame) {
+            int p_events       = 0; // Sensor events successfully detected per package
+            int deduped        = 0; // a repeat of a recent package, dropped, see -Y dedup
+            int repeat_decoded = 0; // the dropped repeat decoded to events the first time
+            begin              = metrics_begin(metrics);
+            package_type       = pulse_detect_package(demod->pulse_detect, demod->am_buf, demod->fm_buf, n_samples, cfg->samp_rate, cfg->input_pos, &demod->pulse_data, &demod->fsk_pulse_data, fpdm);
+            metrics_end(metrics, METRICS_PULSE_DETECT, begin);
+            if (package_type) {
+                pulse_data_t const *package = package_type == PULSE_DATA_OOK ? &demod->pulse_data : &demod->fsk_pulse_data;
+                USDT_PROBE2(package, package_type, package->num_pulses);
+                package_on_air(cfg, package);
+                demod->package_start_ago = package->start_ago;
+                demod->package_end_ago   = package->end_ago;
+            }
+            if (package_type) {
+                // new package: set a first frame start if we are not tracking one already
+                if (!demod->frame_start_ago)
+                    demod->frame_start_ago = demod->pulse_data.start_ago;
+                // always update the last frame end
+                demod->frame_end_ago = demod->pulse_data.end_ago;
+            }
+            if (package_type == PULSE_DATA_OOK) {
+                demod->pulse_data.levels_due = 1;
+                if (package_levels)
+                    calc_rssi_snr(cfg, &demod->pulse_data);
+                if (analyze_pulses && !demod->analyzer_stats) fprintf(stderr, "Detected OOK package\t%s\n", time_pos_str(cfg, demod->pulse_data.start_ago, time_str));
+
+                // Repeated transmissions are dropped, or only the decoders with events of the first one run
+                uint32_t fingerprint = demod->dedup_ms ? pulse_data_fingerprint(&demod->pulse_data) : 0;
+                package_cache_entry_t const *cached = demod->dedup_ms ? package_cache_lookup(demod, package_type, &demod->pulse_data, fingerprint) : NULL;
+                deduped        = cached && !demod->dedup_reuse;
+                repeat_decoded = deduped && cached->num_decoders;
+                if (cached) {
+                    cfg->frames_dedup++;
+                    metrics->frames_dedup++;
+                }
+                if (!deduped) {
+                    double wall_us = cfg->trace ? metrics_wall_time_us() : 0.0;
+                    begin          = metrics_begin(metrics);
+                    if (cached)
+                        p_events += run_decoder_entries(cached->decoders, cached->num_decoders, &demod->pulse_data);
+                    else
+                        p_events += run_ook_dispatch(demod->decoder_pool, dispatch, r_devs, &demod->pulse_data);
+                    metrics_end(metrics, METRICS_DECODE, begin);
+                    if (cfg->trace)
+                        trace_event_complete(cfg->trace, "decode OOK", TRACE_DECODE, wall_us, metrics_wall_time_us() - wall_us, "events", p_events);
+                    if (demod->dedup_ms && !cached)
+                        package_cache_store(demod, package_type, &demod->pulse_data, fingerprint, dispatch, 0);
+                }
+                cfg->frames_count++;
+                cfg->frames_events += p_events > 0;
+                metrics->frames_ook++;
+                metrics->frames_events += p_events > 0;
+
+                if (dump_logic)
+                    sample_dump_logic(demod->sample_dump, n_samples, cfg->input_pos, &demod->pulse_data, 0x02);
+                for (void **iter = dumpers.elems; iter && *iter; ++iter) {
+                    file_info_t const *dumper = *iter;
+                    if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
+                    if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->pulse_data);
+                    if (dumper->format == PULSE_OOK_BIN) pulse_bin_dump(dumper->file, &demod->pulse_data);
+                    if (dumper->format == PULSE_ARROW) pulse_arrow_add(dumper->arrow, &demod->pulse_data, p_events);
+                }
+                for (void **iter = cfg->pulse_handler.elems; iter && *iter; ++iter)
+                    pulse_udp_send(*iter, &demod->pulse_data);
+                if (cfg->pulse_recorder)
+                    record_package(cfg, demod, &demod->pulse_data);
+
+                if (cfg->verbosity > 2) pulse_data_print(&demod->pulse_data);
+                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0 && !deduped) || (cfg->raw_mode == 3 && p_events > 0)) {
+                    data_t *data = cfg->raw_rfraw ? pulse_data_print_rfraw(&demod->pulse_data) : pulse_data_print_data(&demod->pulse_data);
+                    raw_event_handler(cfg, data);
+                }
+                if (!p_events && !deduped && cfg->signal_cluster.repeats)
+                    signal_cluster_add(&cfg->signal_cluster, &demod->pulse_data, package_type);
+                if (!p_events && !cached && cfg->second_chance && demod == cfg->demod && decoders == demod)
+                    retry_package(cfg, demod, demod_buf, n_samples, frequency, &demod->pulse_data, 0);
+                if (analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0 && !deduped) || (cfg->grab_mode == 3 && p_events > 0)) ) {
+                    if (demod->analyzer_stats)
+                        pulse_analyzer_batch(demod->analyzer_stats, &demod->pulse_data, package_type);
+                    else
+                        pulse_analyzer(&demod->pulse_data, package_type);
+                }
+
+            } else if (package_type == PULSE_DATA_FSK) {
+                demod->fsk_pulse_data.levels_due = 1;
+                if (package_levels)
+                    calc_rssi_snr(cfg, &demod->fsk_pulse_data);
+                if (analyze_pulses && !demod->analyzer_stats) fprintf(stderr, "Detected FSK package\t%s\n", time_pos_str(cfg, demod->fsk_pulse_data.start_ago, time_str));
+
+                // Repeated transmissions are dropped, or only the decoders with events of the first one run
+                uint32_t fingerprint = demod->dedup_ms ? pulse_data_fingerprint(&demod->fsk_pulse_data) : 0;
+                package_cache_entry_t const *cached = demod->dedup_ms ? package_cache_lookup(demod, package_type, &demod->fsk_pulse_data, fingerprint) : NULL;
+                deduped        = cached && !demod->dedup_reuse;
+                repeat_decoded = deduped && cached->num_decoders;
+                if (cached) {
+                    cfg->frames_dedup++;
+                    metrics->frames_dedup++;
+                }
+                if (!deduped) {
+                    double wall_us = cfg->trace ? metrics_wall_time_us() : 0.0;
+                    begin          = metrics_begin(metrics);
+                    pulse_data_t *fsk_alt_pulses = pulse_detect_fsk_alt_pulses(demod->pulse_detect);
+                    int fsk_alt = 0;
+                    if (cached) {
+                        pulse_data_t *pulses = cached->fsk_alt ? fsk_alt_pulses : &demod->fsk_pulse_data;
+                        if (pulses)
+                            p_events += run_decoder_entries(cached->decoders, cached->num_decoders, pulses);
+                    }
+                    else {
+                        p_events += run_fsk_dispatch(demod->decoder_pool, dispatch, r_devs, &demod->fsk_pulse_data);
+                        // Try the other FSK detector only if the selected one produced no events
+                        if (!p_events && fsk_alt_pulses && fsk_alt_pulses->num_pulses > PD_MIN_PULSES) {
+                            p_events += run_fsk_dispatch(demod->decoder_pool, dispatch, r_devs, fsk_alt_pulses);
+                            fsk_alt = 1;
+                        }
+                    }
+                    metrics_end(metrics, METRICS_DECODE, begin);
+                    if (cfg->trace)
+                        trace_event_complete(cfg->trace, "decode FSK", TRACE_DECODE, wall_us, metrics_wall_time_us() - wall_us, "events", p_events);
+                    if (demod->dedup_ms && !cached)
+                        package_cache_store(demod, package_type, &demod->fsk_pulse_data, fingerprint, dispatch, fsk_alt);
+                }
+                cfg->frames_fsk++;
+                cfg->frames_events += p_events > 0;
+                metrics->frames_fsk++;
+                metrics->frames_events += p_events > 0;
+
+                if (dump_logic)
+                    sample_dump_logic(demod->sample_dump, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04);
+                for (void **iter = dumpers.elems; iter && *iter; ++iter) {
+                    file_info_t const *dumper = *iter;
+                    if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, &demod->fsk_pulse_data, '"');
+                    if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->fsk_pulse_data);
+                    if (dumper->format == PULSE_OOK_BIN) pulse_bin_dump(dumper->file, &demod->fsk_pulse_data);
+                    if (dumper->format == PULSE_ARROW) pulse_arrow_add(dumper->arrow, &demod->fsk_pulse_data, p_events);
+                }
+                for (void **iter = cfg->pulse_handler.elems; iter && *iter; ++iter)
+                    pulse_udp_send(*iter, &demod->fsk_pulse_data);
+                if (cfg->pulse_recorder)
+                    record_package(cfg, demod, &demod->fsk_pulse_data);
+
+                if (cfg->verbosity > 2) pulse_data_print(&demod->fsk_pulse_data);
+                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0 && !deduped) || (cfg->raw_mode == 3 && p_events > 0)) {
+                    data_t *data = cfg->raw_rfraw ? pulse_data_print_rfraw(&demod->fsk_pulse_data) : pulse_data_print_data(&demod->fsk_pulse_data);
+                    raw_event_handler(cfg, data);
+                }
+                if (!p_events && !deduped && cfg->signal_cluster.repeats)
+                    signal_cluster_add(&cfg->signal_cluster, &demod->fsk_pulse_data, package_type);
+                if (!p_events && !cached && cfg->second_chance && demod == cfg->demod && decoders == demod)
+                    retry_package(cfg, demod, demod_buf, n_samples, frequency, &demod->fsk_pulse_data, 1);
+                if (analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0 && !deduped) || (cfg->grab_mode == 3 && p_events > 0))) {
+                    if (demod->analyzer_stats)
+                        pulse_analyzer_batch(demod->analyzer_stats, &demod->fsk_pulse_data, package_type);
+                    else
+                        pulse_analyzer(&demod->fsk_pulse_data, package_type);
+                }
+            } // if (package_type == ...
+            if (package_type && cfg->demod->adapt_secs)
+                adapt_decoders(cfg, r_devs, package_type == PULSE_DATA_FSK ? &demod->fsk_pulse_data : &demod->pulse_data);
+            if ((p_events || repeat_decoded) && demod->extra_level_count)
+                decoded_span_add(demod, package_type == PULSE_DATA_FSK ? &demod->fsk_pulse_data : &demod->pulse_data, cfg->input_pos + n_samples);
+            d_events += p_events;
+        } // while (package_type)...
+        if (process_frame && r_devs->len && demod->extra_level_count)
+            d_events += run_extra_levels(cfg, demod, dispatch, r_devs, n_samples, fpdm);
+        metrics->package_end_us  = 0.0; // later events are not from a package
+        demod->package_start_ago = 0;
+
+        // add event counter to the frames currently tracked
+        demod->frame_event_count += d_events;
+
+        // end frame tracking if older than a whole buffer
+        if (demod->frame_start_ago && demod->frame_end_ago > n_samples) {
+            if (demod->samp_grab) {
+                if (cfg->grab_mode == 1
+                        || (cfg->grab_mode == 2 && demod->frame_event_count == 0)
+                        || (cfg->grab_mode == 3 && demod->frame_event_count > 0)) {
+                    unsigned frame_pad = n_samples / 8; // this could also be a fixed value, e.g. 10000 samples
+                    unsigned start_padded = demod->frame_start_ago + frame_pad;
+                    unsigned end_padded = demod->frame_end_ago - frame_pad;
+                    unsigned len_padded = start_padded - end_padded;
+                    samp_grab_write(demod->samp_grab, len_padded, end_padded);
+                }
+            }
+            demod->frame_start_ago = 0;
+            demod->frame_event_count = 0;
+        }
+
+        // dump partial pulse_data for this buffer
+        if (dump_logic) {
+            sample_dump_logic(demod->sample_dump, n_samples, cfg->input_pos, &demod->pulse_data, 0x02);
+            sample_dump_logic(demod->sample_dump, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04);
+        }
+    }
+
+    if (shed_outputs && (demod->analyze_pulses || demod->dumper.len || demod->am_analyze))
+        cfg->load_shed->outputs_skipped++;
+
+    if (demod->am_analyze && !shed_outputs) {
+        am_analyze(demod->am_analyze, demod->am_buf, n_samples, cfg->verbosity > 1, NULL);
+    }
+
+    if (demod->sample_dump && !shed_outputs) {
+        sample_dump_input_t dump = {
+                .iq_buf           = iq_buf,
+                .am_buf           = demod->am_buf,
+                .fm_buf           = demod->fm_buf,
+                .n_samples        = n_samples,
+                .sample_size      = demod->sample_size,
+                .samp_rate        = cfg->samp_rate,
+                .center_frequency = cfg->center_frequency,
+                .now              = demod->now,
+                .avg_db           = avg_db,
+                .live             = metrics->buffer_us != 0.0, // file inputs wait for the writer
+                .iq_ref           = cfg->iq_ref,
+        };
+        if (sample_dump_write(demod->sample_dump, &dump) < 0)
+            cfg->exit_async = 1;
+    }
+
+    return d_events;
+}
+
+/** Demodulate and decode the sub-channels of a wideband buffer, returns the number of events.
+
+    The output helpers use the cfg demod state, sample rate, center frequency, and input position,
+    these are swapped to the channel for processing.
+*/
+static int demod_channels(r_cfg_t *cfg, unsigned char *iq_buf, unsigned long n_samples, time_t last_frame_sec)
+{
+    struct dm_state *demod = cfg->demod;
+    channelizer_t *chz     = cfg->channelizer;
+
+    demod->clip = (baseband_clip_t){0};
+    demod->kernels->clip_count(iq_buf, n_samples, &demod->clip);
+    clip_to_metrics(cfg->metrics, &demod->clip);
+
+    channelizer_process(chz, iq_buf, n_samples, demod->sample_size, cfg->center_frequency, cfg->samp_rate);
+
+    uint32_t samp_rate        = cfg->samp_rate;
+    uint32_t center_frequency = cfg->center_frequency;
+    uint64_t input_pos        = cfg->input_pos;
+    int d_events              = 0;
+    for (size_t i = 0; i < chz->channels.len && i < cfg->channel_demods.len; ++i) {
+        channel_t *ch             = chz->channels.elems[i];
+        struct dm_state *ch_demod = cfg->channel_demods.elems[i];
+        if (!ch->out_len)
+            continue;
+        ch_demod->now             = demod->now;
+        ch_demod->sample_file_pos = demod->sample_file_pos;
+        cfg->demod                = ch_demod;
+        cfg->samp_rate            = ch->out_rate;
+        cfg->center_frequency     = ch->frequency;
+        cfg->input_pos            = ch->out_pos;
+        d_events += demod_buffer(cfg, ch_demod, demod, (unsigned char *)ch->out_buf, ch->out_len * ch_demod->sample_size, ch->out_len, ch->frequency, last_frame_sec, NULL);
+        ch->out_pos += ch->out_len;
+    }
+    cfg->demod            = demod;
+    cfg->samp_rate        = samp_rate;
+    cfg->center_frequency = center_frequency;
+    cfg->input_pos        = input_pos;
+
+    return d_events;
+}
+
+/** Decimate a buffer to the processing rate, then demodulate and decode, returns the number of events.
+
+    The output helpers use the cfg sample rate and input position, and the demod sample format,
+    these are swapped to the decimated CS16 samples for processing.
+*/
+static int demod_decimated(r_cfg_t *cfg, unsigned char *iq_buf, uint32_t len, unsigned long n_samples, time_t last_frame_sec)
+{
+    struct dm_state *demod = cfg->demod;
+    decimator_t *dec       = cfg->decimator;
+    uint32_t frequency     = cfg->frequency[demod->hop_index];
+
+    if (decimator_set_rate(dec, cfg->samp_rate) <= 1)
+        return demod_buffer(cfg, demod, demod, iq_buf, len, n_samples, frequency, last_frame_sec, &demod->clip);
+
+    // the clipping of the SDR, the decimated samples have more bits
+    demod->clip = (baseband_clip_t){0};
+    demod->kernels->clip_count(iq_buf, n_samples, &demod->clip);
+    clip_to_metrics(cfg->metrics, &demod->clip);
+
+    unsigned long out_len = decimator_process(dec, iq_buf, n_samples, demod->kernels->format);
+    if (!out_len)
+        return 0;
+
+    uint32_t samp_rate                = cfg->samp_rate;
+    uint64_t input_pos                = cfg->input_pos;
+    int sample_size                   = demod->sample_size;
+    baseband_kernels_t const *kernels = demod->kernels;
+    cfg->samp_rate     = dec->out_rate;
+    cfg->input_pos     = dec->out_pos;
+    demod->sample_size = sizeof(int16_t) * 2; // CS16
+    demod->kernels     = baseband_get_kernels(CS16_IQ, 0);
+
+    int d_events = demod_buffer(cfg, demod, demod, (unsigned char *)dec->out_buf, out_len * demod->sample_size, out_len, frequency, last_frame_sec, NULL);
+    dec->out_pos += out_len;
+
+    cfg->samp_rate     = samp_rate;
+    cfg->input_pos     = input_pos;
+    demod->sample_size = sample_size;
+    demod->kernels     = kernels;
+
+    return d_events;
+}
+
+
+/// Mark the decoders to skip at a load shedding level.
+static void shed_decoders(list_t *r_devs, int level)
+{
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        r_dev->shed     = (level >= LOAD_SHED_PRIORITY && r_dev->priority > 0)
+                || (level >= LOAD_SHED_UNUSED && (!r_dev->hits || r_dev->sample_every));
+    }
+}
+
+/// Print the bytes of each subsystem, see get_memory_usage().
+static void print_memory_usage(r_cfg_t *cfg)
+{
+    memory_usage_t mem[MEMORY_SUBSYSTEMS + 16];
+    unsigned num = get_memory_usage(cfg, mem, sizeof(mem) / sizeof(*mem));
+    fprintf(stderr, "Memory:");
+    for (unsigned i = 0; i < num; ++i) {
+        if (mem[i].output >= 0)
+            fprintf(stderr, "%s %s %d %llu kB", i ? "," : "", mem[i].subsystem, mem[i].output, (unsigned long long)(mem[i].bytes + 1023) / 1024);
+        else
+            fprintf(stderr, "%s %s %llu kB", i ? "," : "", mem[i].subsystem, (unsigned long long)(mem[i].bytes + 1023) / 1024);
+    }
+    fprintf(stderr, "\n");
+}
+
+void shed_load(r_cfg_t *cfg, double busy_us, unsigned long n_samples, uint32_t samp_rate)
+{
+    load_shed_t *shed = cfg->load_shed;
+    if (!shed || !samp_rate)
+        return;
+    // the buffers of all inputs are processed on this thread, each input has a share of the time
+    double real_us = n_samples * 1e6 / samp_rate / (1 + cfg->sdr_inputs.len);
+    int change     = load_shed_update(shed, busy_us, real_us, cfg->metrics->buffers_lost);
+    if (!change)
+        return;
+    shed_decoders(&cfg->demod->r_devs, shed->level);
+    fprintf(stderr, "Processing load %.0f%% of real time, %s level %d: %s\n",
+            shed->load * 100.0, change > 0 ? "shedding to" : "restoring to", shed->level, load_shed_name(shed->level));
+}
+
+int r_process_iq(r_cfg_t *cfg, unsigned char *iq_buf, uint32_t len, uint32_t format, struct timeval const *read_time)
+{
+    struct dm_state *demod = cfg->demod;
+
+    if (format && (!demod->kernels || demod->kernels->format != format)) {
+        demod->kernels = baseband_get_kernels(format, 0);
+        if (demod->kernels)
+            demod->sample_size = demod->kernels->sample_size;
+    }
+    if (!demod->kernels) {
+        fprintf(stderr, "%s: unsupported sample format\n", __func__);
+        return -1;
+    }
+
+    // save last frame time to see if a new second started
+    time_t last_frame_sec = demod->now.tv_sec;
+    if (read_time)
+        demod->now = *read_time; // the buffer waited in the acquisition ring
+    else
+        get_time_now(&demod->now);
+
+    unsigned long n_samples = len / demod->sample_size;
+    if (n_samples * demod->sample_size != len) {
+        fprintf(stderr, "Sample buffer length not aligned to sample size!\n");
+    }
+    if (!n_samples) {
+        fprintf(stderr, "Sample buffer too short!\n");
+        return 0;
+    }
+
+    // the events of the buffer are written out at once
+    begin_event_batch(cfg);
+    USDT_PROBE2(buffer_in, n_samples, cfg->input_pos);
+
+    double wall_us  = cfg->trace ? metrics_wall_time_us() : 0.0;
+    double begin    = monotonic_time_us();
+    uint64_t frames = cfg->metrics->frames_ook + cfg->metrics->frames_fsk;
+    int iq_input    = demod->load_info.format != S16_AM && demod->load_info.format != S16_FM;
+    if (cfg->spectrum && iq_input)
+        spectrum_push(cfg->spectrum, demod->hop_index, iq_buf, n_samples, demod->kernels->format, cfg->center_frequency, cfg->samp_rate);
+    int d_events;
+    if (cfg->channelizer && iq_input) {
+        d_events = demod_channels(cfg, iq_buf, n_samples, last_frame_sec);
+    }
+    else if (cfg->decimator && iq_input) {
+        d_events = demod_decimated(cfg, iq_buf, len, n_samples, last_frame_sec);
+    }
+    else {
+        d_events = demod_buffer(cfg, demod, demod, iq_buf, len, n_samples, cfg->frequency[demod->hop_index], last_frame_sec, &demod->clip);
+    }
+    metrics_end_buffer(cfg->metrics, begin, n_samples, d_events > 0);
+    if (cfg->metrics->buffer_us) // live
+        shed_load(cfg, monotonic_time_us() - begin, n_samples, cfg->samp_rate);
+    if (cfg->hop_sched) {
+        frames = cfg->metrics->frames_ook + cfg->metrics->frames_fsk - frames;
+        hop_sched_observe(cfg->hop_sched, demod->hop_index, n_samples, cfg->samp_rate, (unsigned)frames, d_events > 0 ? d_events : 0);
+    }
+    if (cfg->trace)
+        trace_event_complete(cfg->trace, "buffer", TRACE_BUFFERS, wall_us, metrics_wall_time_us() - wall_us, "samples", n_samples);
+    // the footprint once the first buffer sized the buffers
+    if (cfg->verbosity && cfg->metrics->buffers == 1)
+        print_memory_usage(cfg);
+
+    cfg->input_pos += n_samples;
+    flush_fused_events(cfg, 0);
+    if (cfg->second_chance)
+        second_chance_output(cfg->second_chance, cfg);
+    end_event_batch(cfg);
+    USDT_PROBE2(buffer_done, n_samples, d_events);
+    return d_events;
+}
+
+int r_process_pulses(r_cfg_t *cfg, pulse_data_t *pulse_data)
+{
+    struct dm_state *demod = cfg->demod;
+    int p_events;
+    if (pulse_data->fsk_f2_est) {
+        p_events = run_fsk_dispatch(NULL, select_dispatch(cfg, demod, 0), &demod->r_devs, pulse_data);
+        cfg->metrics->frames_fsk++;
+        cfg->metrics->frames_events += p_events > 0;
+    }
+    else {
+        p_events = run_ook_dispatch(NULL, select_dispatch(cfg, demod, 0), &demod->r_devs, pulse_data);
+        cfg->metrics->frames_ook++;
+        cfg->metrics->frames_events += p_events > 0;
+        if (cfg->verbosity > 2)
+            pulse_data_print(pulse_data);
+        if (!p_events && cfg->signal_cluster.repeats)
+            signal_cluster_add(&cfg->signal_cluster, pulse_data, PULSE_DATA_OOK);
+        if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
+            if (demod->analyzer_stats)
+                pulse_analyzer_batch(demod->analyzer_stats, pulse_data, PULSE_DATA_OOK);
+            else
+                pulse_analyzer(pulse_data, PULSE_DATA_OOK);
+        }
+    }
+    return p_events;
+}
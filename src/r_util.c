@@ -10,6 +10,8 @@
 */
 
 #include "r_util.h"
+#include "format_double.h"
+#include "compat_pthread.h"
 #include "fatal.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -22,10 +24,57 @@ void get_time_now(struct timeval *tv)
         perror("gettimeofday");
 }
 
+/// The last formatted second, each thread caches its own.
+static THREAD_LOCAL struct {
+    time_t secs;
+    int with_tz;
+    char format[32];             ///< the format, empty if nothing is cached
+    char str[LOCAL_TIME_BUFLEN]; ///< the formatted seconds
+    size_t len;
+    char tz[8];                  ///< the time offset, "+hhmm" or "Z"
+} time_cache;
+
+/// Format the seconds and the time offset, only if the second or the format changed.
+static void time_cache_update(char const *format, int with_tz, time_t secs)
+{
+    if (time_cache.format[0] && time_cache.secs == secs && time_cache.with_tz == with_tz
+            && !strcmp(time_cache.format, format))
+        return;
+
+    struct tm tm_info;
+#ifdef _WIN32 /* MinGW might have localtime_r but apparently not MinGW64 */
+    localtime_s(&tm_info, &secs); // win32 doesn't have localtime_r()
+#else
+    localtime_r(&secs, &tm_info); // thread-safe
+#endif
+
+    time_cache.len    = strftime(time_cache.str, LOCAL_TIME_BUFLEN, format, &tm_info);
+    time_cache.tz[0]  = '\0';
+    if (with_tz) {
+        strftime(time_cache.tz, sizeof(time_cache.tz), "%z", &tm_info);
+        if (!strcmp(time_cache.tz, "+0000"))
+            strcpy(time_cache.tz, "Z");
+    }
+    time_cache.secs    = secs;
+    time_cache.with_tz = with_tz;
+    if (strlen(format) < sizeof(time_cache.format))
+        strcpy(time_cache.format, format);
+    else
+        time_cache.format[0] = '\0'; // not cached
+}
+
+/// Append the cached time offset at a position of the buffer.
+static char *time_cache_tz(char *buf, size_t len)
+{
+    size_t tz_len = strlen(time_cache.tz);
+    if (len + tz_len < LOCAL_TIME_BUFLEN)
+        memcpy(buf + len, time_cache.tz, tz_len + 1);
+    return buf;
+}
+
 char *format_time_str(char *buf, char const *format, int with_tz, time_t time_secs)
 {
     time_t etime;
-    struct tm tm_info;
 
     if (time_secs == 0) {
         time(&etime);
@@ -34,57 +83,50 @@ char *format_time_str(char *buf, char const *format, int with_tz, time_t time_se
         etime = time_secs;
     }
 
-#ifdef _WIN32 /* MinGW might have localtime_r but apparently not MinGW64 */
-    localtime_s(&tm_info, &etime); // win32 doesn't have localtime_r()
-#else
-    localtime_r(&etime, &tm_info); // thread-safe
-#endif
-
     if (!format || !*format)
         format = "%Y-%m-%d %H:%M:%S";
 
-    size_t l = strftime(buf, LOCAL_TIME_BUFLEN, format, &tm_info);
-    if (with_tz) {
-        strftime(buf + l, LOCAL_TIME_BUFLEN - l, "%z", &tm_info);
-        if (!strcmp(buf + l, "+0000"))
-            strcpy(buf + l, "Z");
-    }
-    return buf;
+    time_cache_update(format, with_tz, etime);
+    memcpy(buf, time_cache.str, time_cache.len + 1);
+    return time_cache_tz(buf, time_cache.len);
 }
 
 char *usecs_time_str(char *buf, char const *format, int with_tz, struct timeval *tv)
 {
     struct timeval now;
-    struct tm tm_info;
 
     if (!tv) {
         tv = &now;
         get_time_now(tv);
     }
 
-    time_t t_secs = tv->tv_sec;
-#ifdef _WIN32 /* MinGW might have localtime_r but apparently not MinGW64 */
-    localtime_s(&tm_info, &t_secs); // win32 doesn't have localtime_r()
-#else
-    localtime_r(&t_secs, &tm_info); // thread-safe
-#endif
-
     if (!format || !*format)
         format = "%Y-%m-%d %H:%M:%S";
 
-    size_t l = strftime(buf, LOCAL_TIME_BUFLEN, format, &tm_info);
-    l += snprintf(buf + l, LOCAL_TIME_BUFLEN - l, ".%06ld", (long)tv->tv_usec);
-    if (with_tz) {
-        strftime(buf + l, LOCAL_TIME_BUFLEN - l, "%z", &tm_info);
-        if (!strcmp(buf + l, "+0000"))
-            strcpy(buf + l, "Z");
+    time_cache_update(format, with_tz, tv->tv_sec);
+    size_t l = time_cache.len;
+    memcpy(buf, time_cache.str, l + 1);
+    if (tv->tv_usec < 0 || tv->tv_usec > 999999) {
+        l += snprintf(buf + l, LOCAL_TIME_BUFLEN - l, ".%06ld", (long)tv->tv_usec);
     }
-    return buf;
+    else if (l + 7 < LOCAL_TIME_BUFLEN) {
+        // only the microseconds are formatted for each call
+        unsigned long usecs = (unsigned long)tv->tv_usec;
+        buf[l++] = '.';
+        for (int i = 6; i > 0; --i) {
+            buf[l + i - 1] = (char)('0' + usecs % 10);
+            usecs /= 10;
+        }
+        l += 6;
+        buf[l] = '\0';
+    }
+    return time_cache_tz(buf, l);
 }
 
 char *sample_pos_str(float sample_file_pos, char *buf)
 {
-    snprintf(buf, LOCAL_TIME_BUFLEN, "@%fs", sample_file_pos);
+    buf[0] = '@';
+    format_double(buf + 1, LOCAL_TIME_BUFLEN - 1, "%fs", sample_file_pos);
     return buf;
 }
 
@@ -208,7 +250,7 @@ char *str_replace(char const *orig, char const *rep, char const *with)
 // Make a more readable string for a frequency.
 char const *nice_freq (double freq)
 {
-  static char buf[30];
+  static THREAD_LOCAL char buf[30]; // each thread formats its own
 
   if (freq >= 1E9)
      snprintf (buf, sizeof(buf), "%.3fGHz", freq/1E9);
@@ -22,6 +22,16 @@ void raw_output_frame(struct raw_output *output, uint8_t const *data, uint32_t l
     output->output_frame(output, data, len);
 }
 
+void raw_output_frame_ref(struct raw_output *output, struct iq_buf *ref, uint8_t const *data, uint32_t len)
+{
+    if (!output)
+        return;
+    if (ref && output->output_frame_ref)
+        output->output_frame_ref(output, ref, data, len);
+    else
+        output->output_frame(output, data, len);
+}
+
 void raw_output_free(struct raw_output *output)
 {
     if (!output)
@@ -12,27 +12,29 @@
 #include "rfraw.h"
 #include "fatal.h"
 #include <string.h>
+#include <limits.h>
+
+/// Value of a hex digit, -1 if not a hex digit, without a compare for each range.
+static int hex_digit(int c)
+{
+    unsigned d = (unsigned)c - '0';
+    if (d < 10)
+        return (int)d;
+    d = ((unsigned)c | 0x20) - 'a'; // fold to lower case
+    if (d < 6)
+        return (int)d + 10;
+    return -1;
+}
 
 static int hexstr_get_nibble(char const **p)
 {
     if (!p || !*p || !**p) return -1;
     while (**p == ' ' || **p == '\t' || **p == '-' || **p == ':') ++*p;
 
-    int c = **p;
-    if (c >= '0' && c <= '9') {
+    int d = hex_digit(**p);
+    if (d >= 0)
         ++*p;
-        return c - '0';
-    }
-    if (c >= 'A' && c <= 'F') {
-        ++*p;
-        return c - 'A' + 10;
-    }
-    if (c >= 'a' && c <= 'f') {
-        ++*p;
-        return c - 'a' + 10;
-    }
-
-    return -1;
+    return d;
 }
 
 static int hexstr_get_byte(char const **p)
@@ -148,10 +150,12 @@ static bool parse_rfraw(pulse_data_t *data, char const **p)
                 data->gap[data->num_pulses] = 0;
                 data->num_pulses++;
             }
+            if (pulse_data_reserve(data, data->num_pulses + 1)) return false;
             data->pulse[data->num_pulses] = bins[w & 7];
             pulse_needed = false;
         }
         else { // gap
+            if (pulse_data_reserve(data, data->num_pulses + 1)) return false;
             if (pulse_needed) {
                 data->pulse[data->num_pulses] = 0;
             }
@@ -163,7 +167,7 @@ static bool parse_rfraw(pulse_data_t *data, char const **p)
     //data->gap[data->num_pulses - 1] = 3000; // TODO: extend last gap?
 
     unsigned pkt_pulses = data->num_pulses - prev_pulses;
-    for (int i = 1; i < repeats && data->num_pulses + pkt_pulses <= PD_MAX_PULSES; ++i) {
+    for (int i = 1; i < repeats && !pulse_data_reserve(data, data->num_pulses + pkt_pulses); ++i) {
         memcpy(&data->pulse[data->num_pulses], &data->pulse[prev_pulses], pkt_pulses * sizeof (*data->pulse));
         memcpy(&data->gap[data->num_pulses], &data->gap[prev_pulses], pkt_pulses * sizeof (*data->pulse));
         data->num_pulses += pkt_pulses;
@@ -193,3 +197,86 @@ bool rfraw_parse(pulse_data_t *data, char const *p)
     //pulse_data_print(data);
     return true;
 }
+
+/// Add a width to the bins within tolerance, or to a new bin, returns 0 if all bins are used.
+static int rfraw_bin_add(unsigned *sum, unsigned *count, unsigned *bins_len, unsigned width)
+{
+    for (unsigned b = 0; b < *bins_len; ++b) {
+        unsigned mean = sum[b] / count[b];
+        unsigned diff = width > mean ? width - mean : mean - width;
+        if (diff * 5 < (width > mean ? width : mean)) { // within 20%
+            sum[b] += width;
+            count[b]++;
+            return 1;
+        }
+    }
+    if (*bins_len >= RFRAW_BINS)
+        return 0;
+    sum[*bins_len]   = width;
+    count[*bins_len] = 1;
+    (*bins_len)++;
+    return 1;
+}
+
+/// Find the nearest bin of a width.
+static unsigned rfraw_bin_find(unsigned const *bins, unsigned bins_len, unsigned width)
+{
+    unsigned best = 0;
+    unsigned best_diff = UINT_MAX;
+    for (unsigned b = 0; b < bins_len; ++b) {
+        unsigned diff = width > bins[b] ? width - bins[b] : bins[b] - width;
+        if (diff < best_diff) {
+            best      = b;
+            best_diff = diff;
+        }
+    }
+    return best;
+}
+
+static char *rfraw_put_byte(char *p, unsigned v)
+{
+    static char const hex[] = "0123456789ABCDEF";
+    *p++ = hex[(v >> 4) & 0xf];
+    *p++ = hex[v & 0xf];
+    return p;
+}
+
+size_t rfraw_format(pulse_data_t const *data, char *buf, size_t size)
+{
+    if (size < RFRAW_FORMAT_SIZE(data->num_pulses))
+        return 0;
+
+    double to_us = 1e6 / data->sample_rate;
+    unsigned sum[RFRAW_BINS]   = {0};
+    unsigned count[RFRAW_BINS] = {0};
+    unsigned bins_len          = 0;
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        double p = data->pulse[i] * to_us;
+        double g = data->gap[i] * to_us;
+        rfraw_bin_add(sum, count, &bins_len, p < USHRT_MAX ? (unsigned)p : USHRT_MAX);
+        rfraw_bin_add(sum, count, &bins_len, g < USHRT_MAX ? (unsigned)g : USHRT_MAX);
+    }
+    unsigned bins[RFRAW_BINS];
+    for (unsigned b = 0; b < bins_len; ++b) {
+        bins[b] = sum[b] / count[b];
+    }
+
+    char *p = buf;
+    p = rfraw_put_byte(p, 0xaa);
+    p = rfraw_put_byte(p, 0xb1);
+    p = rfraw_put_byte(p, bins_len);
+    for (unsigned b = 0; b < bins_len; ++b) {
+        p = rfraw_put_byte(p, bins[b] >> 8);
+        p = rfraw_put_byte(p, bins[b]);
+    }
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        double pw = data->pulse[i] * to_us;
+        double gw = data->gap[i] * to_us;
+        unsigned pb = rfraw_bin_find(bins, bins_len, pw < USHRT_MAX ? (unsigned)pw : USHRT_MAX);
+        unsigned gb = rfraw_bin_find(bins, bins_len, gw < USHRT_MAX ? (unsigned)gw : USHRT_MAX);
+        p = rfraw_put_byte(p, 0x80 | (pb << 4) | gb);
+    }
+    p = rfraw_put_byte(p, 0x55);
+    *p = '\0';
+    return (size_t)(p - buf);
+}
@@ -34,6 +34,10 @@
 #include "r_api.h"
 #include "sdr.h"
 #include "baseband.h"
+#include "channelizer.h"
+#include "decimator.h"
+#include "hop_sched.h"
+#include "load_shed.h"
 #include "pulse_analyzer.h"
 #include "pulse_detect.h"
 #include "pulse_detect_fsk.h"
@@ -46,6 +50,12 @@
 #include "abuf.h"
 #include "fileformat.h"
 #include "samp_grab.h"
+#include "sample_reader.h"
+#include "pulse_bin.h"
+#include "pulse_udp.h"
+#include "pulse_arrow.h"
+#include "sample_index.h"
+#include "compress_pipe.h"
 #include "am_analyze.h"
 #include "confparse.h"
 #include "term_ctl.h"
@@ -54,6 +64,24 @@
 #include "fatal.h"
 #include "write_sigrok.h"
 #include "mongoose.h"
+#include "compat_pthread.h"
+#include "decoder_pool.h"
+#include "output_queue.h"
+#include "output_filter.h"
+#include "net_thread.h"
+#include "metrics.h"
+#include "alloc_count.h"
+#include "output_file.h"
+#include "trace_event.h"
+#include "watchdog.h"
+#include "thread_pin.h"
+#include "huge_buf.h"
+#include "io_ring.h"
+#include "agc.h"
+#include "spectrum.h"
+#include "pulse_recorder.h"
+#include "profiler.h"
+#include "checkpoint.h"
 
 #ifdef _WIN32
 #include <io.h>
@@ -65,6 +93,9 @@
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
 
 #ifndef _MSC_VER
 #include <getopt.h>
@@ -91,35 +122,28 @@
 
 #ifdef _WIN32
 #include <windows.h>
-#define usleep(us) Sleep((us) / 1000)
 #endif
 
-typedef struct timeval delay_timer_t;
+/// Replay pacing, the deadlines are absolute on the monotonic clock so the per block delays do not add up to a drift.
+typedef struct delay_timer {
+    double start_us; ///< monotonic time of the start
+    double slept_us; ///< monotonic time of the last wake up
+} delay_timer_t;
 
 static void delay_timer_init(delay_timer_t *delay_timer)
 {
-    // set to current wall clock
-    get_time_now(delay_timer);
+    delay_timer->start_us = monotonic_time_us();
+    delay_timer->slept_us = delay_timer->start_us;
 }
 
-static void delay_timer_wait(delay_timer_t *delay_timer, unsigned delay_us)
+/// Wait until a time after the start, deadlines closer than the granularity to the last wake up do not sleep.
+static void delay_timer_wait(delay_timer_t *delay_timer, double due_us, unsigned granularity_us)
 {
-    // sync to wall clock
-    struct timeval now_tv;
-    get_time_now(&now_tv);
-
-    time_t elapsed_s  = now_tv.tv_sec - delay_timer->tv_sec;
-    time_t elapsed_us = 1000000 * elapsed_s + now_tv.tv_usec - delay_timer->tv_usec;
-
-    // set next wanted start time
-    delay_timer->tv_usec += delay_us;
-    while (delay_timer->tv_usec > 1000000) {
-        delay_timer->tv_usec -= 1000000;
-        delay_timer->tv_sec += 1;
-    }
-
-    if ((time_t)delay_us > elapsed_us)
-        usleep(delay_us - elapsed_us);
+    double deadline_us = delay_timer->start_us + due_us;
+    if (deadline_us < delay_timer->slept_us + granularity_us)
+        return; // too early for another sleep, the block is delivered ahead
+    monotonic_sleep_until_us(deadline_us);
+    delay_timer->slept_us = deadline_us;
 }
 
 r_device *flex_create_device(char *spec); // maybe put this in some header file?
@@ -148,34 +172,106 @@ static void usage(int exit_code)
             "       e.g. -t \"antenna=A,bandwidth=4.5M,rfnotch_ctrl=false\"\n"
             "  [-f <frequency>] Receive frequency(s) (default: %i Hz)\n"
             "  [-H <seconds>] Hop interval for polling of multiple frequencies (default: %i seconds)\n"
+            "  [-j <frequency>[:<sample rate>]] Add a sub-channel of the captured band (can be used multiple times)\n"
+            "       All channels are decoded at once, use a high sample rate, e.g. -s 2400k (default channel rate: %i Hz)\n"
             "  [-p <ppm_error>] Correct rtl-sdr tuner frequency offset error (default: 0)\n"
             "  [-s <sample rate>] Set sample rate (default: %i Hz)\n"
+            "  [-P <processing rate>] Decimate high sample rates to at least this rate for demodulation, e.g. -s 2048k -P 250k\n"
+            "  [-B low-latency | throughput | default] Size the SDR buffers and USB transfers, and the file output flushing, for latency or throughput.\n"
+            "       Buffers of about 10 ms, or at least 250 ms with file outputs flushed each second, an explicit -b keeps its size. The event latency is reported on exit.\n",
+            DEFAULT_FREQUENCY, DEFAULT_HOP_TIME, DEFAULT_CHANNEL_RATE, DEFAULT_SAMPLE_RATE);
+    term_help_printf(
             "\t\t= Demodulator options =\n"
             "  [-R <device> | help] Enable only the specified device decoding protocol (can be used multiple times)\n"
             "       Specify a negative number to disable a device decoding protocol (can be used multiple times)\n"
             "  [-X <spec> | help] Add a general purpose decoder (prepend -R 0 to disable all decoders)\n"
-            "  [-Y auto | classic | minmax] FSK pulse detector mode.\n"
+            "       SIGHUP or the \"reload\" RPC rebuilds the -R and -X decoders of the config files and options while running.\n"
+            "  [-Y auto | classic | minmax | both] FSK pulse detector mode.\n"
             "  [-Y level=<dB level>] Manual detection level used to determine pulses (-1.0 to -30.0) (0=auto).\n"
             "  [-Y minlevel=<dB level>] Manual minimum detection level used to determine pulses (-1.0 to -99.0).\n"
+            "  [-Y levels=<dB level>[:<dB level>]] Also detect pulses at one or two fixed levels, e.g. a weak signal next to a strong one.\n"
             "  [-Y minsnr=<dB level>] Minimum SNR to determine pulses (1.0 to 99.0).\n"
             "  [-Y autolevel] Set minlevel automatically based on average estimated noise.\n"
             "  [-Y squelch] Skip frames below estimated noise level to reduce cpu load.\n"
+            "  [-Y dedup[=<ms>[:drop|reuse]]] Skip decoding packages identical to one seen within the time (default: 1000 ms),\n"
+            "       drop them (default) or run only the decoders that had events on the first one.\n"
+            "  [-Y eventdedup[=<ms>]] Drop events identical to one output within the time (default: 2000 ms).\n"
+            "  [-Y fusion[=<ms>]] Fuse the events of the edge receivers of -r pulses within the time, output with the best and all receivers (default: 1000 ms).\n"
+            "  [-Y urgent=<model>[:<model>]] Also output the events of the models as alarms, ahead of batched and queued events.\n"
+            "  [-Y adaptive[=<secs>]] Run decoders without events for the time (default: 3600 s) only on every 16th package.\n"
+            "  [-Y budget[=<us>]] Demote decoders that take longer than the time on a package (default: 10000 us).\n"
+            "  [-Y shed[=<load>]] Shed work in steps while the processing is behind real time, above the load (default: 0.8).\n"
             "  [-Y ampest | magest] Choose amplitude or magnitude level estimator.\n"
+            "  [-Y fmint | fmfast | fmprecise] Choose integer (default), fast or precise FM discriminator.\n"
+            "  [-Y fmfull] Demodulate FM of all samples, by default only where the envelope can hold a pulse.\n"
+            "  [-Y env8] Search the pulses on an 8-bit log envelope, checked on the full envelope near the level.\n"
+            "  [-Y bands=0] Run all decoders on every hop frequency, by default only those for its band.\n"
+            "  [-Y timingskip] Skip the decoders whose timing does not fit the pulse widths of a package, this may lose events.\n"
+            "  [-Y retry] Retry unclaimed packages with lower levels on an idle thread, see \"retried\".\n"
+            "  [-Y amfilter=<order>[:<cutoff>]] AM low pass filter order (1 to 8, default: 1), a cutoff in Hz (default: 0.025 of the sample rate).\n"
+            "  [-Y iqcorrect] Correct DC offset and IQ imbalance of CU8 input.\n"
+            "  [-Y spectrum[=<bins>[:<n>]]] Monitor the occupancy of FFT bins (default: 256) of every n-th buffer (default: 1), see the get_spectrum RPC.\n"
+            "  [-Y recorder[=<minutes>[:<MB>]]] Keep the packages of the last minutes (default: 10) in a ring (default: 4 MB), SIGUSR2 or the dump_pulses RPC writes them out.\n"
+            "  [-Y agc[=<dB headroom>]] Step the tuner gain down on clipped samples, and up while the peak stays below the headroom (default: 12 dB).\n"
+            "  [-Y hopadapt] Share the hop cycle time (-H) by the recent event rate of each frequency.\n"
+            "  [-Y hopmin=<secs>] [-Y hopmax=<secs>] Bounds of an adapted dwell time (default: 1/4 and 4 times the -H time).\n"
+            "  [-Y hopidle[=<ms>]] Hop early after the time without packages (default: 1000 ms).\n"
+            "  [-Y settle[=<ms>]] Discard the samples for the time after a retune (default: 10 ms when hopping).\n"
+            "  [-Y watchdog[=<ms>[:<ms>]]] Reset the SDR if the sample callback stalls for the time (default: 3000 ms, 0 to never),\n"
+            "       exit after 3 resets in a row, and log callback intervals and durations above the second time (default: 1000 ms, 0 for none).\n");
+    term_help_printf(
+            "  [-Y threads] Demodulate AM and FM on separate threads.\n"
+            "  [-Y decthreads=<n>] Run the decoders of a package on n threads.\n"
+            "  [-Y channelizer=cpu | opencl[:<platform>[.<device>]]] Process the -j sub-channels on the CPU (default) or on an OpenCL device.\n"
+            "  [-Y acquire[=<n>]] Read the SDR on a separate thread with a ring of n buffers (default: 32), reports lost samples.\n"
+            "  [-Y lowpower[=<ms>]] Process the SDR buffers in bursts, at most the time late (default: 2000 ms), skip the silent buffers,\n"
+            "       and coalesce the network polls into the bursts, for battery and solar powered receivers.\n"
+            "  [-Y pin=<role>:<cpus>] Pin the threads of a role to CPUs, repeat for each role, the role is one of acquire, demod,\n"
+            "       decode, output, net, the cpus are numbers or ranges separated by colons, e.g. pin=demod:2-3.\n"
+            "  [-Y realtime[=<prio>]] Run the -Y acquire threads with realtime priority (SCHED_FIFO, default: 50).\n"
+            "  [-Y hugepages] Back the large sample buffers with huge pages.\n"
+            "  [-Y io=auto | uring | stdio] File I/O with io_uring on Linux: auto batches the -w sample writes and reads ahead the -r files\n"
+            "       that can not be mapped, uring reads all -r files ahead, stdio never uses io_uring (default: auto).\n"
+            "  [-Y jobs=<n>] Read the -r input files, or the -y @<file> codes, on n threads, the events are output in input order.\n"
+            "  [-Y chunk=<size>] Split larger -r input files into chunks of size bytes read in parallel with -Y jobs.\n"
+            "  [-Y overlap=<ms>] Overlap of the chunks (default: 10 times the longest end of package gap of the decoders).\n"
+            "  [-Y checkpoint=<file>[:<secs>]] Write the position and the detector state of reading the -r input files to a file,\n"
+            "       after a block while no package is in progress, at most every secs seconds (default: 0, after each block).\n"
+            "  [-Y resume] Continue reading the -r input files at the last -Y checkpoint, the events since are output again.\n"
+            "  [-Y index] Write a sidecar '.idx' index of wall time and level for each -w sample file.\n"
+            "  [-Y bench[=<n>]] Read the -r input files n times (default: 1) without the default output,\n"
+            "       then print the throughput and heap allocations of each stage and the startup time as JSON.\n"
+            "  [-Y coverage] Read the -r input files through all decoders, also the disabled ones, without the default output,\n"
+            "       then print the results and time of each decoder, the overlaps, and a recommended -R set as JSON.\n"
+            "  [-Y analyze[=<n>]] Quiet pulse analyzer, count the guessed modulation and timings of the packages,\n"
+            "       then print a summary every n packages (default: 100, 0 for only at exit).\n"
+            "  [-Y suggest[=<n>]] Group the packages without decoder by timing, analyze a group once it was seen n times\n"
+            "       (default: 5) and print a suggested flex decoder (-X) for it.\n"
+            "  [-Y raw[=all | unknown | known]] Print the pulses of the packages as events, all, of the packages without decoder, or with a decoder\n"
+            "       (default: all), send them to some outputs only with the -F option raw.\n"
+            "  [-Y rfraw] Print the raw pulses as one compact RfRaw string (the -y format) of at most 8 timing bins.\n");
+    term_help_printf(
             "\t\t= Analyze/Debug options =\n"
             "  [-a] Analyze mode. Print a textual description of the signal.\n"
             "  [-A] Pulse Analyzer. Enable pulse analysis and decode attempt.\n"
             "       Disable all decoders with -R 0 if you want analyzer output only.\n"
-            "  [-y <code>] Verify decoding of demodulated test data (e.g. \"{25}fb2dd58\") with enabled devices\n"
+            "       Use -Y analyze for a periodic summary instead of the output per package.\n"
+            "  [-y <code>] Verify decoding of demodulated test data (e.g. \"{25}fb2dd58\") with enabled devices, a code per line with -y @<file> or -y -\n"
             "\t\t= File I/O options =\n"
-            "  [-S none | all | unknown | known] Signal auto save. Creates one file per signal.\n"
+            "  [-S none | all | unknown | known[:<prefix>[:<max size>]]] Signal auto save. Creates one file per signal.\n"
             "       Note: Saves raw I/Q samples (uint8 pcm, 2 channel). Preferred mode for generating test files.\n"
-            "  [-r <filename> | help] Read data from input file instead of a receiver\n"
+            "       Append to container files \"<prefix>NNN_<freq>M_<rate>k.cu8\" instead with \":<prefix>[:<max size>]\",\n"
+            "       the \".idx\" index has the start, time and level of each signal.\n"
+            "  [-r <filename> | pulses:[<host>][:<port>] | help] Read data from input file instead of a receiver\n"
             "  [-w <filename> | help] Save data stream to output file (a '-' dumps samples to stdout)\n"
             "  [-W <filename> | help] Save data stream to output file, overwrite existing file\n"
             "\t\t= Data output options =\n"
-            "  [-F kv | json | csv | mqtt | influx | syslog | trigger | null | help] Produce decoded output in given format.\n"
+            "  [-F kv | json | csv | cbor | delta | arrow | sqlite | shm | mqtt | influx | nats | syslog | trigger | null | pulses | help] Produce decoded output in given format.\n"
             "       Append output to file with :<filename> (e.g. -F csv:log.csv), defaults to stdout.\n"
             "       Specify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n"
+            "  [-O <size>[:block | oldest | newest]] Print kv, json, csv, cbor, delta, arrow, and sqlite file outputs from a queue on a writer thread.\n"
+            "       If the queue is full wait (default), or drop the oldest or the newest event.\n"
+            "       MQTT, InfluxDB, and HTTP outputs are printed on the network thread from a queue of this size (default 1024), never waiting.\n"
             "  [-M time[:<options>] | protocol | level | noise[:<secs>] | stats | bits | help] Add various meta data to each output.\n"
             "  [-K FILE | PATH | <tag> | <key>=<tag>] Add an expanded token or fixed tag to every output line.\n"
             "  [-C native | si | customary] Convert units in decoded output.\n"
@@ -183,8 +279,7 @@ static void usage(int exit_code)
             "  [-T <seconds>] Specify number of seconds to run, also 12:34 or 1h23m45s\n"
             "  [-E hop | quit] Hop/Quit after outputting successful event(s)\n"
             "  [-h] Output this usage help and exit\n"
-            "       Use -d, -g, -R, -X, -F, -M, -r, -w, or -W without argument for more help\n\n",
-            DEFAULT_FREQUENCY, DEFAULT_HOP_TIME, DEFAULT_SAMPLE_RATE);
+            "       Use -d, -g, -R, -X, -F, -M, -r, -w, or -W without argument for more help\n\n");
     exit(exit_code);
 }
 
@@ -227,8 +322,11 @@ static void help_device(void)
             "  [-d \"\"] Open default SoapySDR device\n"
             "  [-d driver=rtlsdr] Open e.g. specific SoapySDR device\n"
             "\tTo set gain for SoapySDR use -g ELEM=val,ELEM=val,... e.g. -g LNA=20,TIA=8,PGA=2 (for LimeSDR).\n"
+            "\tAdd channels=<n> to read n RX channels of e.g. a LimeSDR in one stream, the other channels take the next -f frequencies.\n"
             "  [-d rtl_tcp[:[//]host[:port]] (default: localhost:1234)\n"
-            "\tSpecify host/port to connect to with e.g. -d rtl_tcp:127.0.0.1:1234\n");
+            "\tSpecify host/port to connect to with e.g. -d rtl_tcp:127.0.0.1:1234\n"
+            "\tOptions are: rcvbuf=<size> (socket receive buffer), readahead=<n> (buffers read ahead on a separate thread, default 32, 0 to read inline)\n"
+            "\tUse -d several times to read several devices at once, the n-th device is tuned to the n-th -f frequency.\n");
     exit(0);
 }
 
@@ -249,16 +347,18 @@ static void help_output(void)
 {
     term_help_printf(
             "\t\t= Output format option =\n"
-            "  [-F kv|json|csv|mqtt|influx|syslog|trigger|null] Produce decoded output in given format.\n"
+            "  [-F kv|json|csv|cbor|delta|arrow|sqlite|shm|mqtt|influx|nats|syslog|trigger|null|pulses] Produce decoded output in given format.\n"
             "\tWithout this option the default is KV output. Use \"-F null\" to remove the default.\n"
             "\tAppend output to file with :<filename> (e.g. -F csv:log.csv), defaults to stdout.\n"
+            "\tBatch file and stdout writes with e.g. -F json:log.json,flush=1s\n"
+            "\tFile options are: flush=<events> | <time>, buffer=<size>, fsync[=0|1], SIGUSR1 writes out all batched output.\n"
             "\tSpecify MQTT server with e.g. -F mqtt://localhost:1883\n"
             "\tAdd MQTT options with e.g. -F \"mqtt://host:1883,opt=arg\"\n"
-            "\tMQTT options are: user=foo, pass=bar, retain[=0|1], <format>[=topic]\n"
+            "\tMQTT options are: user=foo, pass=bar, retain[=0|1], cbor[=0|1], batch[=0|1], queue=<size>, <format>[=topic]\n"
             "\tSupported MQTT formats: (default is all)\n"
             "\t  events: posts JSON event data\n"
             "\t  states: posts JSON state data\n"
-            "\t  devices: posts device and sensor info in nested topics\n"
+            "\t  devices: posts device and sensor info in nested topics, with batch the JSON event data to the device topic\n"
             "\tThe topic string will expand keys like [/model]\n"
             "\tE.g. -F \"mqtt://localhost:1883,user=USERNAME,pass=PASSWORD,retain=0,devices=rtl_433[/id]\"\n"
             "\tWith MQTT each rtl_433 instance needs a distinct driver selection. The MQTT Client-ID is computed from the driver string.\n"
@@ -266,7 +366,28 @@ static void help_output(void)
             "\tSpecify InfluxDB 2.0 server with e.g. -F \"influx://localhost:9999/api/v2/write?org=<org>&bucket=<bucket>,token=<authtoken>\"\n"
             "\tSpecify InfluxDB 1.x server with e.g. -F \"influx://localhost:8086/write?db=<db>&p=<password>&u=<user>\"\n"
             "\t  Additional parameter -M time:unix:usec:utc for correct timestamps in InfluxDB recommended\n"
-            "\tSpecify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n");
+            "\tInfluxDB options are: token=<authtoken>, flush=<lines> | <time> (batching), batch=<size> (max request), spool=<size> (held while unreachable)\n"
+            "\tPublish to NATS with e.g. -F \"nats://<user>:<pass>@localhost:4222,subject=rtl_433\", events go to the subject <subject>.<model>\n"
+            "\tNATS options are: subject=<subject> (default rtl_433), token=<token>, batch=<n> (messages per batch), linger=<ms> (wait for a full batch), spool=<size> (held while unreachable, default 1M), cbor (publish CBOR instead of JSON)\n"
+            "\tSpecify host/port for syslog with e.g. -F syslog:127.0.0.1:1514\n"
+            "\tSend CBOR datagrams, one event each, with e.g. -F cbor:udp://127.0.0.1:5140\n"
+            "\tWrite columnar Arrow IPC files, a file and schema per model, with e.g. -F arrow:events.arrow[,rows=<n>] (events per batch, default 1024)\n"
+            "\tInsert into an SQLite database, a table per model, with e.g. -F sqlite:events.db[,rows=<n>][,secs=<n>] (events and seconds per transaction, default 1000 and 1)\n"
+            "\tSyslog and CBOR datagram options are: mtu=<size> (max datagram, default 1024 and 1472), batch=<n> (datagrams sent per call, up to 64)\n"
+            "\tHTTP server options are: queue=<size> (per client send queue, default 1M), slow=drop | close (for clients over the queue size), history=<size> (events kept for new clients, default 256k), compress=0 (no gzip or websocket deflate)\n"
+            "\tSend the packages to a central decoder (-r pulses) with e.g. -F pulses:host:1433\n"
+            "\tServe the raw samples to rtl_tcp clients with e.g. -F rtl_tcp:0.0.0.0:1234, options are: buffer=<size> (per client, frames are dropped for clients that fall behind, default 4M)\n"
+            "\trtl_tcp processing options, done once for the clients of a port: rate=<Hz> (decimate), freq=<Hz> (sub-channel, needs rate), format=cu8 | cs16\n");
+    term_help_printf(
+            "\tSend compact delta frames of the changed sensor values with e.g. -F delta:uplink.bin or -F delta:udp://127.0.0.1:5140, see include/output_delta.h\n"
+            "\tDelta options are: interval=<secs> (between frames, default 60), mtu=<size> (max frame, default 222), key=<n> (define a sensor again after n updates, default 10)\n"
+            "\tPublish to a shared memory ring for local readers with e.g. -F shm:rtl_433,size=1M[,cbor], see include/shm_ring.h\n"
+            "\tFilter the events of any output per sensor (model, id, channel) with e.g. -F \"mqtt://host:1883,changes=0.1,every=10m\"\n"
+            "\tFilter options are: changes[=<tolerance>] (only events that differ from the last one), every=<time> (unchanged events too after the time), limit=<time> (at most one event per sensor within the time)\n"
+            "\tSelect the models and fields of any output with e.g. -F \"json,models=Acurite-*:LaCrosse-TX141THBv2,exclude=mic:raw_msg\"\n"
+            "\tSelect options are: models=<list> (only events of these models, a trailing * matches a prefix), fields=<list> (only these top-level fields), exclude=<list> (not these fields), the lists are separated by :\n"
+            "\tRaw options are: raw (also the raw packages of -Y raw), raw=only (only the raw packages), if any output has one the others get no raw packages\n"
+            "\tCapture options are: iq[=<time>] (write the IQ samples of the events of the selected models to iqNNNNNN files, at most one within the time, default 1s), all outputs get the file name as iq_file\n");
     exit(0);
 }
 
@@ -307,12 +428,17 @@ static void help_meta(void)
             "\tUse \"time:utc\" to output time in UTC.\n"
             "\t\t(this may also be accomplished by invocation with TZ environment variable set).\n"
             "\t\t\"usec\" and \"utc\" can be combined with other options, eg. \"time:iso:utc\" or \"time:unix:usec\".\n"
-            "\tUse \"replay[:N]\" to replay file inputs at (N-times) realtime.\n"
+            "\tUse \"replay[:N[:<ms>]]\" to replay file inputs at (N-times, e.g. 0.5 or 50) realtime,\n"
+            "\t\tpaced at most every <ms> milliseconds (default: every block).\n"
             "\tUse \"protocol\" / \"noprotocol\" to output the decoder protocol number meta data.\n"
             "\tUse \"level\" to add Modulation, Frequency, RSSI, SNR, and Noise meta data.\n"
             "\tUse \"noise[:<secs>]\" to report estimated noise level at intervals (default: 10 seconds).\n"
             "\tUse \"stats[:[<level>][:<interval>]]\" to report statistics (default: 600 seconds).\n"
             "\t  level 0: no report, 1: report successful devices, 2: report active devices, 3: report all\n"
+            "\t  the statistics also have the last buffer, package, and event numbers and the drops of each pipeline stage.\n"
+            "\tUse \"seq\" to number the events and reports printed, a gap in the numbers is an event an output dropped.\n"
+            "\tUse \"profile\" to add the time spent in each slicer and decoder to the statistics.\n"
+            "\tUse \"trace:<file>\" to write a timeline of the buffers, packages, decoders, and outputs in Chrome trace event format.\n"
             "\tUse \"bits\" to add bit representation to code outputs (for debug).\n");
     exit(0);
 }
@@ -329,13 +455,22 @@ static void help_read(void)
             "\tA sample rate is detected as (fractional) number suffixed with 'k',\n"
             "\t'sps', 'ksps', 'Msps', or 'Gsps'.\n\n"
             "\tFile content and format are detected as parameters, possible options are:\n"
-            "\t'cu8', 'cs16', 'cf32' ('IQ' implied), and 'am.s16'.\n\n"
+            "\t'cu8', 'cs16', 'cf32' ('IQ' implied), and 'am.s16'.\n"
+            "\tPulse data is read from 'ook' text or 'ookbin' binary files.\n\n"
+            "\tReceive the packages of edge receivers (-F pulses) with e.g. -r pulses::1433,\n"
+            "\tthe decoders run on the central node only, default port 1433.\n\n"
             "\tParameters must be separated by non-alphanumeric chars and are case-insensitive.\n"
             "\tOverrides can be prefixed, separated by colon (':')\n\n"
             "\tE.g. default detection by extension: path/filename.am.s16\n"
             "\tforced overrides: am:s16:path/filename.ext\n\n"
             "\tReading from pipes also support format options.\n"
-            "\tE.g reading complex 32-bit float: CU32:-\n");
+            "\tE.g reading complex 32-bit float: CU32:-\n\n"
+            "\tFiles are read in blocks of -b <size> bytes (default 262144),\n"
+            "\tregular files are memory-mapped, pipes are read.\n"
+            "\tThe sample buffers are sized for the block size, -v reports their memory use.\n\n"
+            "\tFiles with a '.gz' or '.zst' extension are decompressed with gzip or zstd.\n\n"
+            "\tAppend ',start=<time>' and ',end=<time>' to read a range, e.g. file.cu8,start=90,end=2m,\n"
+            "\ta time of day (HH:MM[:SS]) is found with the '.idx' index written by -Y index.\n");
     exit(0);
 }
 
@@ -350,25 +485,98 @@ static void help_write(void)
             "\tFile content and format are detected as parameters, possible options are:\n"
             "\t'cu8', 'cs8', 'cs16', 'cf32' ('IQ' implied),\n"
             "\t'am.s16', 'am.f32', 'fm.s16', 'fm.f32',\n"
-            "\t'i.f32', 'q.f32', 'logic.u8', 'ook', and 'vcd'.\n\n"
+            "\t'i.f32', 'q.f32', 'logic.u8', 'ook', 'ookbin', 'arrow', and 'vcd'.\n\n"
             "\tParameters must be separated by non-alphanumeric chars and are case-insensitive.\n"
             "\tOverrides can be prefixed, separated by colon (':')\n\n"
             "\tE.g. default detection by extension: path/filename.am.s16\n"
-            "\tforced overrides: am:s16:path/filename.ext\n");
+            "\tforced overrides: am:s16:path/filename.ext\n\n"
+            "\tFiles with a '.gz' or '.zst' extension are compressed with gzip or zstd.\n\n"
+            "\tAn 'arrow' file has a row of levels, events, and pulse widths per package,\n"
+            "\tin the Arrow IPC (Feather V2) format, e.g. for pandas.read_feather().\n\n"
+            "\tSamples are converted and written on a writer thread. If it falls behind\n"
+            "\ta file input waits for it, a live input drops sample buffers.\n");
     exit(0);
 }
 
-static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
+/// Retune to the next hop frequency, the retune is applied by the read loop or the acquisition thread.
+static void hop_frequency(r_cfg_t *cfg)
+{
+    time_t now;
+    time(&now);
+    if (cfg->hop_sched)
+        hop_sched_leave(cfg->hop_sched, cfg->frequency_index, difftime(now, cfg->hop_start_time), cfg->demod->noise_level);
+    cfg->hop_now        = 0;
+    cfg->hop_start_time = now;
+    cfg->frequency_index = (cfg->frequency_index + 1) % cfg->frequencies;
+    sdr_set_center_freq(cfg->dev, cfg->frequency[cfg->frequency_index], 0);
+}
+
+/// Require the next sample callback within the stall time, see -Y watchdog.
+static void watchdog_arm(r_cfg_t *cfg)
+{
+    if (!cfg->watchdog) {
+        if (cfg->watchdog_ms)
+            alarm((cfg->watchdog_ms + 999) / 1000); // require callback to run, abort otherwise
+        return;
+    }
+    double interval_us = watchdog_feed(cfg->watchdog);
+    if (interval_us > 0.0)
+        metrics_observe(&cfg->metrics->callback_interval, interval_us);
+}
+
+/// Pause the watchdog until armed again, e.g. if the next callback is late for a retune.
+static void watchdog_cancel(r_cfg_t *cfg)
+{
+    if (cfg->watchdog)
+        watchdog_pause(cfg->watchdog);
+    else
+        alarm(0); // cancel the watchdog timer
+}
+
+/// The sample callback stalled, reset the SDR, exit if it stays stalled. Runs on the watchdog thread.
+static void watchdog_stall(void *ctx, unsigned stalls, double stalled_us)
+{
+    r_cfg_t *cfg = ctx;
+    if (cfg->exit_async)
+        return;
+    if (stalls > WATCHDOG_RESETS) {
+        fprintf(stderr, "Async read stalled, exiting!\n");
+        cfg->exit_code  = 3;
+        cfg->exit_async = 1;
+        sdr_stop(cfg->dev);
+        return;
+    }
+    fprintf(stderr, "Async read stalled for %.0f ms, resetting the SDR (%u of %u)\n", stalled_us / 1000.0, stalls, WATCHDOG_RESETS);
+    sdr_reset(cfg->dev, 1);
+}
+
+static void reload_decoders(r_cfg_t *cfg);
+
+/// Write out the pulse flight recorder to a new file, see SIGUSR2.
+static void dump_pulse_recorder(r_cfg_t *cfg)
+{
+    char path[64];
+    int count = pulse_recorder_dump_file(cfg->pulse_recorder, cfg->samp_rate, path);
+    if (count >= 0)
+        fprintf(stderr, "Wrote %d recorded packages to %s\n", count, path);
+}
+
+static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx, struct timeval const *read_time)
 {
     r_cfg_t *cfg = ctx;
     struct dm_state *demod = cfg->demod;
-    char time_str[LOCAL_TIME_BUFLEN];
     unsigned long n_samples;
 
+    // between buffers no decoder is running
+    if (cfg->reload_now) {
+        cfg->reload_now = 0;
+        reload_decoders(cfg);
+    }
+
     // do this here and not in sdr_handler so realtime replay can use rtl_tcp output
     for (void **iter = cfg->raw_handler.elems; iter && *iter; ++iter) {
         raw_output_t *output = *iter;
-        raw_output_frame(output, iq_buf, len);
+        raw_output_frame_ref(output, cfg->iq_ref, iq_buf, len);
     }
 
     if ((cfg->bytes_to_read > 0) && (cfg->bytes_to_read <= len)) {
@@ -376,359 +584,1254 @@ static void sdr_callback(unsigned char *iq_buf, uint32_t len, void *ctx)
         cfg->exit_async = 1;
     }
 
-    // save last frame time to see if a new second started
-    time_t last_frame_sec = demod->now.tv_sec;
-    get_time_now(&demod->now);
-
     n_samples = len / demod->sample_size;
-    if (n_samples * demod->sample_size != len) {
-        fprintf(stderr, "Sample buffer length not aligned to sample size!\n");
-    }
     if (!n_samples) {
         fprintf(stderr, "Sample buffer too short!\n");
         return; // keep the watchdog timer running
     }
 
-    // age the frame position if there is one
-    if (demod->frame_start_ago)
-        demod->frame_start_ago += n_samples;
-    if (demod->frame_end_ago)
-        demod->frame_end_ago += n_samples;
+    if (cfg->settle_samples) {
+        // discard the samples while the tuner settles after a retune
+        unsigned long settle = MIN(n_samples, cfg->settle_samples);
+        cfg->settle_samples -= settle;
+        cfg->input_pos += settle;
+        if (cfg->bytes_to_read > 0)
+            cfg->bytes_to_read -= settle * demod->sample_size;
+        iq_buf += settle * demod->sample_size;
+        len -= settle * demod->sample_size;
+        n_samples -= settle;
+        if (!n_samples)
+            return;
+    }
+
+    time_t rawtime;
+    time(&rawtime);
+    int hopped = 0;
+    if (cfg->hop_sched && !cfg->exit_async
+            && hop_sched_due(cfg->hop_sched, cfg->frequency_index, difftime(rawtime, cfg->hop_start_time))) {
+        // retune now, an acquisition thread applies it while this buffer is demodulated
+        hop_frequency(cfg);
+        hopped = 1;
+    }
+
+    watchdog_arm(cfg);
 
-    alarm(3); // require callback to run every 3 second, abort otherwise
+    int d_events = r_process_iq(cfg, iq_buf, len, 0, read_time);
+    if (cfg->bytes_to_read > 0)
+        cfg->bytes_to_read -= len;
 
-    if (demod->samp_grab) {
-        samp_grab_push(demod->samp_grab, iq_buf, len);
+    if (cfg->agc && agc_update(cfg->agc, &demod->clip, cfg->samp_rate)) {
+        // the acquisition applies the gain, the clipping of the next buffers still has the old gain
+        char gain_str[16];
+        snprintf(gain_str, sizeof(gain_str), "%.1f", cfg->agc->gain);
+        set_gain_str(cfg, gain_str);
+        if (cfg->verbosity)
+            fprintf(stderr, "agc: tuner gain %s dB, peak %.1f dBFS, %u of %u samples clipped\n",
+                    gain_str, baseband_clip_peak_dbfs(&demod->clip), demod->clip.clipped, demod->clip.samples);
     }
 
-    // AM demodulation
-    float avg_db;
-    if (demod->sample_size == 2) { // CU8
-        if (demod->use_mag_est) {
-            //magnitude_true_cu8(iq_buf, demod->buf.temp, n_samples);
-            avg_db = magnitude_est_cu8(iq_buf, demod->buf.temp, n_samples);
+    if (cfg->after_successful_events_flag && (d_events > 0)) {
+        watchdog_cancel(cfg);
+        if (cfg->after_successful_events_flag == 1) {
+            cfg->exit_async = 1;
         }
-        else { // amp est
-            avg_db = envelope_detect(iq_buf, demod->buf.temp, n_samples);
+        else {
+            cfg->hop_now = 1;
         }
-    } else { // CS16
-        //magnitude_true_cs16((int16_t *)iq_buf, demod->buf.temp, n_samples);
-        avg_db = magnitude_est_cs16((int16_t *)iq_buf, demod->buf.temp, n_samples);
     }
 
-    //fprintf(stderr, "noise level: %.1f dB current: %.1f dB min level: %.1f dB\n", demod->noise_level, avg_db, demod->min_level_auto);
-    if (demod->min_level_auto == 0.0f) {
-        demod->min_level_auto = demod->min_level;
+    if (hopped) {
+        watchdog_cancel(cfg);
     }
-    if (demod->noise_level == 0.0f) {
-        demod->noise_level = demod->min_level_auto - 3.0f;
+    if (cfg->duration > 0 && rawtime >= cfg->stop_time) {
+        watchdog_cancel(cfg);
+        cfg->exit_async = 1;
+        fprintf(stderr, "Time expired, exiting!\n");
     }
-    int noise_only = avg_db < demod->noise_level + 3.0f; // or demod->min_level_auto?
-    // always process frames if loader, dumper, or analyzers are in use, otherwise skip silent frames
-    int process_frame = demod->squelch_offset <= 0 || !noise_only || demod->load_info.format || demod->analyze_pulses || demod->dumper.len || demod->samp_grab;
-    if (noise_only) {
-        demod->noise_level = (demod->noise_level * 7 + avg_db) / 8; // fast fall over 8 frames
-        // If auto_level and noise level well below min_level and significant change in noise level
-        if (demod->auto_level > 0 && demod->noise_level < demod->min_level - 3.0f
-                && fabsf(demod->min_level_auto - demod->noise_level - 3.0f) > 1.0f) {
-            demod->min_level_auto = demod->noise_level + 3.0f;
-            fprintf(stderr, "Estimated noise level is %.1f dB, adjusting minimum detection level to %.1f dB\n", demod->noise_level, demod->min_level_auto);
-            pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level_auto, demod->min_snr, demod->detect_verbosity);
+    if (cfg->sync_now || rawtime != cfg->sync_time) {
+        // write out batched output at least once a second, all of it on request
+        for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+            data_output_sync(cfg->output_handler.elems[i], cfg->sync_now);
         }
-    } else {
-        demod->noise_level = (demod->noise_level * 31 + avg_db) / 32; // slow rise over 32 frames
+        cfg->sync_now  = 0;
+        cfg->sync_time = rawtime;
     }
-    // Report noise every report_noise seconds, but only for the first frame that second
-    if (cfg->report_noise && last_frame_sec != demod->now.tv_sec && demod->now.tv_sec % cfg->report_noise == 0) {
-        fprintf(stderr, "Current %s level %.1f dB, estimated noise %.1f dB\n",
-                noise_only ? "noise" : "signal", avg_db, demod->noise_level);
+    if (cfg->stats_now || (cfg->report_stats && cfg->stats_interval && rawtime >= cfg->stats_time)) {
+        event_occurred_handler(cfg, create_report_data(cfg, cfg->stats_now ? 3 : cfg->report_stats));
+        flush_report_data(cfg);
+        if (rawtime >= cfg->stats_time)
+            cfg->stats_time += cfg->stats_interval;
+        if (cfg->stats_now)
+            cfg->stats_now--;
     }
 
-    if (process_frame)
-    baseband_low_pass_filter(demod->buf.temp, demod->am_buf, n_samples, &demod->lowpass_filter_state);
+    if (cfg->dump_pulses_now) {
+        cfg->dump_pulses_now = 0;
+        if (cfg->pulse_recorder)
+            dump_pulse_recorder(cfg);
+        else
+            fprintf(stderr, "Pulse recorder not enabled, see -Y recorder\n");
+    }
 
-    // FM demodulation
-    // Select the correct fsk pulse detector
-    unsigned fpdm = cfg->fsk_pulse_detect_mode;
-    if (cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_AUTO) {
-        if (cfg->frequency[cfg->frequency_index] > FSK_PULSE_DETECTOR_LIMIT)
-            fpdm = FSK_PULSE_DETECT_NEW;
+    if (cfg->profile_now) {
+        cfg->profile_now = 0;
+        if (profiler_running())
+            profiler_stop();
         else
-            fpdm = FSK_PULSE_DETECT_OLD;
-    }
-
-    if (demod->enable_FM_demod && process_frame) {
-        float low_pass = demod->low_pass != 0.0f ? demod->low_pass : fpdm ? 0.2f : 0.1f;
-        if (demod->sample_size == 2) { // CU8
-            baseband_demod_FM(iq_buf, demod->buf.fm, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state);
-        } else { // CS16
-            baseband_demod_FM_cs16((int16_t *)iq_buf, demod->buf.fm, n_samples, cfg->samp_rate, low_pass, &demod->demod_FM_state);
-        }
-    }
-
-    // Handle special input formats
-    if (demod->load_info.format == S16_AM) { // The IQ buffer is really AM demodulated data
-        if (len > sizeof(demod->am_buf))
-            FATAL("Buffer too small");
-        memcpy(demod->am_buf, iq_buf, len);
-    } else if (demod->load_info.format == S16_FM) { // The IQ buffer is really FM demodulated data
-        // we would need AM for the envelope too
-        if (len > sizeof(demod->buf.fm))
-            FATAL("Buffer too small");
-        memcpy(demod->buf.fm, iq_buf, len);
-    }
-
-    int d_events = 0; // Sensor events successfully detected
-    if (demod->r_devs.len || demod->analyze_pulses || demod->dumper.len || demod->samp_grab) {
-        // Detect a package and loop through demodulators with pulse data
-        int package_type = PULSE_DATA_OOK;  // Just to get us started
-        for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-            file_info_t const *dumper = *iter;
-            if (dumper->format == U8_LOGIC) {
-                memset(demod->u8_buf, 0, n_samples);
-                break;
-            }
-        }
-        while (package_type && process_frame) {
-            int p_events = 0; // Sensor events successfully detected per package
-            package_type = pulse_detect_package(demod->pulse_detect, demod->am_buf, demod->buf.fm, n_samples, cfg->samp_rate, cfg->input_pos, &demod->pulse_data, &demod->fsk_pulse_data, fpdm);
-            if (package_type) {
-                // new package: set a first frame start if we are not tracking one already
-                if (!demod->frame_start_ago)
-                    demod->frame_start_ago = demod->pulse_data.start_ago;
-                // always update the last frame end
-                demod->frame_end_ago = demod->pulse_data.end_ago;
-            }
-            if (package_type == PULSE_DATA_OOK) {
-                calc_rssi_snr(cfg, &demod->pulse_data);
-                if (demod->analyze_pulses) fprintf(stderr, "Detected OOK package\t%s\n", time_pos_str(cfg, demod->pulse_data.start_ago, time_str));
-
-                p_events += run_ook_demods(&demod->r_devs, &demod->pulse_data);
-                cfg->frames_count++;
-                cfg->frames_events += p_events > 0;
-
-                for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-                    file_info_t const *dumper = *iter;
-                    if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
-                    if (dumper->format == U8_LOGIC) pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->pulse_data, 0x02);
-                    if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->pulse_data);
-                }
+            profiler_start(NULL, PROFILER_DEFAULT_SECONDS);
+    }
+    profiler_poll();
 
-                if (cfg->verbosity > 2) pulse_data_print(&demod->pulse_data);
-                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
-                    data_t *data = pulse_data_print_data(&demod->pulse_data);
-                    event_occurred_handler(cfg, data);
-                }
-                if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0)) ) {
-                    pulse_analyzer(&demod->pulse_data, package_type);
-                }
+    if (cfg->hop_now && !cfg->exit_async) {
+        watchdog_cancel(cfg);
+        hop_frequency(cfg);
+    }
 
-            } else if (package_type == PULSE_DATA_FSK) {
-                calc_rssi_snr(cfg, &demod->fsk_pulse_data);
-                if (demod->analyze_pulses) fprintf(stderr, "Detected FSK package\t%s\n", time_pos_str(cfg, demod->fsk_pulse_data.start_ago, time_str));
+    if (cfg->watchdog) {
+        double duration_us = watchdog_done(cfg->watchdog);
+        if (duration_us > 0.0)
+            metrics_observe(&cfg->metrics->callback_duration, duration_us);
+    }
+}
+
+static void fclose_input(file_info_t const *info, FILE *in_file)
+{
+    if (in_file == stdin)
+        return;
+    if (info->compression)
+        compress_pipe_close(in_file);
+    else
+        fclose(in_file);
+}
 
-                p_events += run_fsk_demods(&demod->r_devs, &demod->fsk_pulse_data);
-                cfg->frames_fsk++;
-                cfg->frames_events += p_events > 0;
+/** Write a checkpoint after a block if one is due and no package is in progress, see -Y checkpoint.
 
-                for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-                    file_info_t const *dumper = *iter;
-                    if (dumper->format == VCD_LOGIC) pulse_data_print_vcd(dumper->file, &demod->fsk_pulse_data, '"');
-                    if (dumper->format == U8_LOGIC) pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04);
-                    if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->fsk_pulse_data);
-                }
+    The events so far are written out first, none are lost if the run is interrupted after the checkpoint.
+    @param cfg the config, checkpoint_index is the input file to continue with
+    @param file_sample the samples of the input file that are processed
+    @param force write the checkpoint even if it is not due, e.g. at the end of a file
+*/
+static void write_checkpoint(r_cfg_t *cfg, uint64_t file_sample, int force)
+{
+    struct dm_state *demod = cfg->demod;
+    double now_us          = monotonic_time_us();
+    if (!cfg->checkpoint_reading || (!force && now_us < cfg->checkpoint_due_us))
+        return;
+
+    checkpoint_t checkpoint = {0};
+    if (pulse_detect_get_state(demod->pulse_detect, &checkpoint.pulse_detect) < 0)
+        return; // a package in progress, try again after the next block
+    if (cfg->second_chance) {
+        unsigned queued, dropped, events;
+        second_chance_counts(cfg->second_chance, &queued, &dropped, &events);
+        if (queued)
+            return; // packages held for a retry
+    }
+
+    for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+        data_output_sync(cfg->output_handler.elems[i], 1);
+    }
+    checkpoint.file_index           = cfg->checkpoint_index;
+    checkpoint.file_sample          = file_sample;
+    checkpoint.input_pos            = cfg->input_pos;
+    checkpoint.events               = cfg->metrics->events;
+    checkpoint.noise_level          = demod->noise_level;
+    checkpoint.min_level_auto       = demod->min_level_auto;
+    checkpoint.lowpass_filter_state = demod->lowpass_filter_state;
+    checkpoint.demod_FM_state       = demod->demod_FM_state;
+    checkpoint.iq_correct_state     = demod->iq_correct_state;
+    if (cfg->checkpoint_index < cfg->in_files.len)
+        snprintf(checkpoint.file_name, sizeof(checkpoint.file_name), "%s", (char const *)cfg->in_files.elems[cfg->checkpoint_index]);
+    if (checkpoint_write(cfg->checkpoint_path, &checkpoint) == 0)
+        cfg->checkpoint_due_us = now_us + cfg->checkpoint_secs * 1e6;
+}
+
+/** Restore the position and the demod state of the last checkpoint, see -Y resume.
+
+    @param cfg the config
+    @param[out] file_index the input file to continue with
+    @param[out] file_sample the samples of the input file to skip
+    @return 0 on success or if there is no checkpoint yet, -1 if the checkpoint does not fit the input files
+*/
+static int resume_checkpoint(r_cfg_t *cfg, unsigned *file_index, uint64_t *file_sample)
+{
+    struct dm_state *demod = cfg->demod;
+    checkpoint_t checkpoint;
+    int ret = checkpoint_read(cfg->checkpoint_path, &checkpoint);
+    if (ret > 0) {
+        fprintf(stderr, "No checkpoint in %s, reading the input files from the start.\n", cfg->checkpoint_path);
+        return 0;
+    }
+    if (ret < 0) {
+        fprintf(stderr, "Reading checkpoint: %s failed, not a checkpoint of this build!\n", cfg->checkpoint_path);
+        return -1;
+    }
+    if (checkpoint.file_index > cfg->in_files.len
+            || (checkpoint.file_index < cfg->in_files.len
+                    && strcmp(checkpoint.file_name, cfg->in_files.elems[checkpoint.file_index]) != 0)) {
+        fprintf(stderr, "Checkpoint %s is for other input files!\n", cfg->checkpoint_path);
+        return -1;
+    }
+
+    pulse_detect_set_state(demod->pulse_detect, &checkpoint.pulse_detect);
+    demod->noise_level          = checkpoint.noise_level;
+    demod->min_level_auto       = checkpoint.min_level_auto;
+    demod->lowpass_filter_state = checkpoint.lowpass_filter_state;
+    demod->demod_FM_state       = checkpoint.demod_FM_state;
+    demod->iq_correct_state     = checkpoint.iq_correct_state;
+    if (demod->min_level_auto != 0.0f)
+        pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level_auto, demod->min_snr, demod->detect_verbosity);
+    // the file is read from the sample, which adds it to the input position again
+    cfg->input_pos       = checkpoint.input_pos - checkpoint.file_sample;
+    cfg->metrics->events = checkpoint.events;
+    *file_index          = checkpoint.file_index;
+    *file_sample         = checkpoint.file_sample;
+    if (checkpoint.file_index == cfg->in_files.len)
+        fprintf(stderr, "All input files are done at checkpoint %s.\n", cfg->checkpoint_path);
+    else
+        fprintf(stderr, "Resuming at input file %u of %zu, sample %llu, after %llu events.\n",
+                checkpoint.file_index + 1, cfg->in_files.len, (unsigned long long)checkpoint.file_sample, (unsigned long long)checkpoint.events);
+    return 0;
+}
 
-                if (cfg->verbosity > 2) pulse_data_print(&demod->fsk_pulse_data);
-                if (cfg->raw_mode == 1 || (cfg->raw_mode == 2 && p_events == 0) || (cfg->raw_mode == 3 && p_events > 0)) {
-                    data_t *data = pulse_data_print_data(&demod->fsk_pulse_data);
-                    event_occurred_handler(cfg, data);
+/// Read and demodulate one input file with a parsed spec, see read_sample_file().
+static int read_sample_range(r_cfg_t *cfg, char const *filename, char const *spec,
+        uint32_t sample_rate_0, uint32_t block_size, uint64_t first_sample, uint64_t end_sample, unsigned char *test_mode_buf, float *test_mode_float_buf)
+{
+    struct dm_state *demod = cfg->demod;
+    cfg->in_filename = filename;
+
+    file_info_clear(&demod->load_info); // reset all info
+    file_info_parse_filename(&demod->load_info, spec);
+    // apply file info or default
+    cfg->samp_rate        = demod->load_info.sample_rate ? demod->load_info.sample_rate : sample_rate_0;
+    cfg->center_frequency = demod->load_info.center_frequency ? demod->load_info.center_frequency : cfg->frequency[0];
+
+    FILE *in_file;
+    if (strcmp(demod->load_info.path, "-") == 0) { // read samples from stdin
+        in_file = stdin;
+        cfg->in_filename = "<stdin>";
+    } else if (demod->load_info.compression) { // decompress on a helper process
+        in_file = compress_pipe_open(demod->load_info.path, demod->load_info.compression, 0);
+        if (!in_file) {
+            fprintf(stderr, "Opening file: %s failed!\n", cfg->in_filename);
+            return -1;
+        }
+    } else {
+        in_file = fopen(demod->load_info.path, "rb");
+        if (!in_file) {
+            fprintf(stderr, "Opening file: %s failed!\n", cfg->in_filename);
+            return -1;
+        }
+    }
+    if (!first_sample || !cfg->batch_events) // once for all chunks of a file
+        fprintf(stderr, "Test mode active. Reading samples from file: %s\n", cfg->in_filename);  // Essential information (not quiet)
+    // CS8 and CF32 are demodulated natively, unless raw samples are passed on as CU8 or CS16
+    int convert = demod->dumper.len || demod->samp_grab || cfg->raw_handler.len || cfg->channelizer;
+    if (!convert && (demod->load_info.format == CS8_IQ
+            || demod->load_info.format == CF32_IQ)) {
+        demod->kernels     = baseband_get_kernels(demod->load_info.format, 0);
+        demod->sample_size = demod->kernels->sample_size; // CS8, CF32
+    } else if (demod->load_info.format == CU8_IQ
+            || demod->load_info.format == CS8_IQ
+            || demod->load_info.format == S16_AM
+            || demod->load_info.format == S16_FM) {
+        demod->sample_size = sizeof(uint8_t) * 2; // CU8, AM, FM
+        demod->kernels     = baseband_get_kernels(CU8_IQ, 0);
+    } else if (demod->load_info.format == CS16_IQ
+            || demod->load_info.format == CF32_IQ) {
+        demod->sample_size = sizeof(int16_t) * 2; // CS16, CF32 (after conversion)
+        demod->kernels     = baseband_get_kernels(CS16_IQ, 0);
+    } else if (demod->load_info.format == PULSE_OOK
+            || demod->load_info.format == PULSE_OOK_BIN) {
+        // ignore
+    } else {
+        fprintf(stderr, "Input format invalid: %s\n", file_info_string(&demod->load_info));
+        fclose_input(&demod->load_info, in_file);
+        return -1;
+    }
+    if (cfg->verbosity) {
+        fprintf(stderr, "Input format: %s\n", file_info_string(&demod->load_info));
+    }
+    demod->sample_file_pos = 0.0;
+
+    // special case for pulse data file-inputs
+    if (demod->load_info.format == PULSE_OOK
+            || demod->load_info.format == PULSE_OOK_BIN) {
+        int binary = demod->load_info.format == PULSE_OOK_BIN;
+        pulse_bin_reader_t bin_reader;
+        if (binary && pulse_bin_reader_open(&bin_reader, in_file)) {
+            fprintf(stderr, "Reading file: %s failed!\n", cfg->in_filename);
+            pulse_bin_reader_close(&bin_reader);
+            fclose_input(&demod->load_info, in_file);
+            return -1;
+        }
+        while (!cfg->exit_async) {
+            if (binary) {
+                int ret = pulse_bin_load(&bin_reader, &demod->pulse_data);
+                if (ret < 0)
+                    fprintf(stderr, "Truncated or invalid package in file: %s\n", cfg->in_filename);
+                if (ret <= 0)
+                    break;
+                // the package start, the source offset is kept in the binary format
+                demod->sample_file_pos = (float)demod->pulse_data.offset / demod->pulse_data.sample_rate;
+            }
+            else {
+                pulse_data_load(in_file, &demod->pulse_data, cfg->samp_rate);
+            }
+            if (!demod->pulse_data.num_pulses)
+                break;
+
+            for (void **iter2 = demod->dumper.elems; iter2 && *iter2; ++iter2) {
+                file_info_t const *dumper = *iter2;
+                if (dumper->format == VCD_LOGIC) {
+                    pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
+                } else if (dumper->format == PULSE_OOK) {
+                    pulse_data_dump(dumper->file, &demod->pulse_data);
+                } else if (dumper->format == PULSE_OOK_BIN) {
+                    pulse_bin_dump(dumper->file, &demod->pulse_data);
+                } else if (dumper->format == PULSE_ARROW) {
+                    // added after the decode, with the events
+                } else {
+                    fprintf(stderr, "Dumper (%s) not supported on OOK input\n", dumper->spec);
+                    exit(1);
                 }
-                if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
-                    pulse_analyzer(&demod->fsk_pulse_data, package_type);
+            }
+            for (void **iter2 = cfg->pulse_handler.elems; iter2 && *iter2; ++iter2)
+                pulse_udp_send(*iter2, &demod->pulse_data);
+
+            int p_events = r_process_pulses(cfg, &demod->pulse_data);
+            for (void **iter2 = demod->dumper.elems; iter2 && *iter2; ++iter2) {
+                file_info_t const *dumper = *iter2;
+                if (dumper->format == PULSE_ARROW)
+                    pulse_arrow_add(dumper->arrow, &demod->pulse_data, p_events);
+            }
+        }
+
+        if (binary)
+            pulse_bin_reader_close(&bin_reader);
+        fclose_input(&demod->load_info, in_file);
+        return 0;
+    }
+
+    // default case for file-inputs
+    // the position is counted in converted samples, CF32 is read as twice the bytes
+    int convert_cf32   = demod->load_info.format == CF32_IQ && demod->kernels->format != CF32_IQ;
+    unsigned file_size = convert_cf32 ? demod->sample_size * 2 : demod->sample_size;
+    if (first_sample) {
+        if (fseeko(in_file, (off_t)(first_sample * file_size), SEEK_SET) < 0) {
+            // e.g. stdin or a compressed file, skip the samples
+            for (uint64_t skip = first_sample * file_size; skip;) {
+                size_t len = skip < block_size ? (size_t)skip : block_size;
+                if (fread(test_mode_buf, 1, len, in_file) != len) {
+                    fprintf(stderr, "Seeking file: %s failed!\n", cfg->in_filename);
+                    fclose_input(&demod->load_info, in_file);
+                    return -1;
                 }
-            } // if (package_type == ...
-            d_events += p_events;
-        } // while (package_type)...
-
-        // add event counter to the frames currently tracked
-        demod->frame_event_count += d_events;
-
-        // end frame tracking if older than a whole buffer
-        if (demod->frame_start_ago && demod->frame_end_ago > n_samples) {
-            if (demod->samp_grab) {
-                if (cfg->grab_mode == 1
-                        || (cfg->grab_mode == 2 && demod->frame_event_count == 0)
-                        || (cfg->grab_mode == 3 && demod->frame_event_count > 0)) {
-                    unsigned frame_pad = n_samples / 8; // this could also be a fixed value, e.g. 10000 samples
-                    unsigned start_padded = demod->frame_start_ago + frame_pad;
-                    unsigned end_padded = demod->frame_end_ago - frame_pad;
-                    unsigned len_padded = start_padded - end_padded;
-                    samp_grab_write(demod->samp_grab, len_padded, end_padded);
+                skip -= len;
+            }
+        }
+        cfg->input_pos += first_sample;
+    }
+    uint64_t n_samples = 0; // samples read
+    int n_blocks = 0;
+    unsigned long n_read;
+    sample_reader_t reader;
+    sample_reader_open(&reader, in_file);
+    delay_timer_t delay_timer;
+    delay_timer_init(&delay_timer);
+    do {
+        uint8_t const *block;
+        unsigned char *samples = test_mode_buf;
+        size_t max_read        = block_size;
+        if (end_sample && (end_sample - first_sample - n_samples) * demod->sample_size < max_read)
+            max_read = (end_sample - first_sample - n_samples) * demod->sample_size; // the end of the range
+        // Replay in realtime if requested, a block is due once its last sample would have been received
+        if (cfg->in_replay > 0.0f) {
+            double due_us = (double)(n_samples + max_read / demod->sample_size) * 1e6 / cfg->samp_rate / cfg->in_replay;
+            delay_timer_wait(&delay_timer, due_us, cfg->in_replay_ms * 1000);
+        }
+        // Convert CF32 file to CS16 buffer
+        if (convert_cf32) {
+            n_read = sample_reader_next(&reader, &block, (uint8_t *)test_mode_float_buf, max_read / sizeof(int16_t) * sizeof(float));
+            n_read /= sizeof(float);
+            float const *in_buf = (float const *)block;
+            // clamp float to [-1,1] and scale to Q0.15
+            for (unsigned long n = 0; n < n_read; n++) {
+                int s_tmp = in_buf[n] * INT16_MAX;
+                if (s_tmp < -INT16_MAX)
+                    s_tmp = -INT16_MAX;
+                else if (s_tmp > INT16_MAX)
+                    s_tmp = INT16_MAX;
+                ((int16_t *)test_mode_buf)[n] = s_tmp;
+            }
+            n_read *= 2; // convert to byte count
+        } else {
+            n_read = sample_reader_next(&reader, &block, test_mode_buf, max_read);
+
+            // Convert CS8 file to CU8 buffer
+            if (demod->load_info.format == CS8_IQ && demod->kernels->format != CS8_IQ) {
+                for (unsigned long n = 0; n < n_read; n++) {
+                    test_mode_buf[n] = ((int8_t)block[n]) + 128;
                 }
             }
-            demod->frame_start_ago = 0;
-            demod->frame_event_count = 0;
+            else {
+                samples = (unsigned char *)block; // the demodulation only reads the samples
+            }
         }
+        if (n_read == 0) break;  // sdr_callback() will Segmentation Fault with len=0
+        demod->sample_file_pos = ((float)((first_sample + n_samples) * demod->sample_size) + n_read) / cfg->samp_rate / demod->sample_size;
+        n_samples += n_read / demod->sample_size;
+        n_blocks++;
+        sdr_callback(samples, n_read, cfg, NULL);
+        if (spec == filename) // a file read with a range is only continued from the start
+            write_checkpoint(cfg, first_sample + n_samples, 0);
+    } while (n_read != 0 && !cfg->exit_async && (!end_sample || first_sample + n_samples < end_sample));
+    sample_reader_close(&reader);
+
+    // Call a last time with cleared samples to ensure EOP detection
+    if (demod->kernels->format == CU8_IQ) { // CU8
+        memset(test_mode_buf, 128, block_size); // 128 is 0 in unsigned data
+        // or is 127.5 a better 0 in cu8 data?
+        //for (unsigned long n = 0; n < block_size/2; n++)
+        //    ((uint16_t *)test_mode_buf)[n] = 0x807f;
+    }
+    else { // CS8, CS16, CF32
+            memset(test_mode_buf, 0, block_size);
+    }
+    demod->sample_file_pos = ((float)(first_sample * demod->sample_size) + (float)(n_blocks + 1) * block_size) / cfg->samp_rate / demod->sample_size;
+    sdr_callback(test_mode_buf, block_size, cfg, NULL);
+    watchdog_cancel(cfg);
+
+    //Always classify a signal at the end of the file
+    if (demod->am_analyze)
+        am_analyze_classify(demod->am_analyze);
+    if (cfg->verbosity) {
+        fprintf(stderr, "Test mode file issued %d packets\n", n_blocks);
+    }
 
-        // dump partial pulse_data for this buffer
-        for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-            file_info_t const *dumper = *iter;
-            if (dumper->format == U8_LOGIC) {
-                pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->pulse_data, 0x02);
-                pulse_data_dump_raw(demod->u8_buf, n_samples, cfg->input_pos, &demod->fsk_pulse_data, 0x04);
-                break;
+    fclose_input(&demod->load_info, in_file);
+    return 0;
+}
+
+/// Decode the packages of edge receivers, until the duration is over or a signal, see -r pulses.
+static int read_pulse_input(r_cfg_t *cfg)
+{
+    struct dm_state *demod = cfg->demod;
+    char *host = NULL;
+    char *port = PULSE_UDP_PORT;
+    hostport_param(cfg->pulse_input, &host, &port);
+    pulse_udp_t *udp = pulse_udp_receiver_create(host, port);
+    if (!udp)
+        return -1;
+    fprintf(stderr, "Receiving pulse datagrams on %s port %s\n", host ? host : "*", port);
+
+    double start_us = monotonic_time_us();
+    while (!cfg->exit_async) {
+        int ret = pulse_udp_receive(udp, &demod->pulse_data, 1000);
+        // the input position follows the wall time, for the time windows of the events
+        cfg->input_pos = (uint64_t)((monotonic_time_us() - start_us) * cfg->samp_rate / 1e6);
+        if (ret > 0) {
+            cfg->pulse_receiver = pulse_udp_peer(udp);
+            for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+                file_info_t const *dumper = *iter;
+                if (dumper->format == PULSE_OOK) pulse_data_dump(dumper->file, &demod->pulse_data);
+                if (dumper->format == PULSE_OOK_BIN) pulse_bin_dump(dumper->file, &demod->pulse_data);
             }
+            int p_events = r_process_pulses(cfg, &demod->pulse_data);
+            for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
+                file_info_t const *dumper = *iter;
+                if (dumper->format == PULSE_ARROW)
+                    pulse_arrow_add(dumper->arrow, &demod->pulse_data, p_events);
+            }
+            cfg->pulse_receiver = NULL;
+        }
+        flush_fused_events(cfg, 0);
+
+        time_t rawtime;
+        time(&rawtime);
+        if (cfg->duration > 0 && rawtime >= cfg->stop_time) {
+            cfg->exit_async = 1;
+            fprintf(stderr, "Time expired, exiting!\n");
+        }
+        if (cfg->sync_now || rawtime != cfg->sync_time) {
+            for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
+                data_output_sync(cfg->output_handler.elems[i], cfg->sync_now);
+            }
+            cfg->sync_now  = 0;
+            cfg->sync_time = rawtime;
+        }
+        if (cfg->stats_now || (cfg->report_stats && cfg->stats_interval && rawtime >= cfg->stats_time)) {
+            event_occurred_handler(cfg, create_report_data(cfg, cfg->stats_now ? 3 : cfg->report_stats));
+            flush_report_data(cfg);
+            if (rawtime >= cfg->stats_time)
+                cfg->stats_time += cfg->stats_interval;
+            if (cfg->stats_now)
+                cfg->stats_now--;
         }
     }
 
-    if (demod->am_analyze) {
-        am_analyze(demod->am_analyze, demod->am_buf, n_samples, cfg->verbosity > 1, NULL);
+    unsigned packages, invalid;
+    pulse_udp_counts(udp, &packages, &invalid);
+    fprintf(stderr, "Received %u pulse datagrams, %u invalid\n", packages, invalid);
+    pulse_udp_free(udp);
+    return 0;
+}
+
+/// Chunks and ranges of a file overlap by a package, which is assumed shorter than this many of its longest gap, see -Y chunk.
+#define CHUNK_PACKAGE_GAPS 10
+
+/// Overlap of the chunks and ranges in ms, a package and the longest end of package gap of the registered decoders.
+static unsigned package_overlap_ms(r_cfg_t *cfg)
+{
+    if (cfg->batch_overlap_ms)
+        return cfg->batch_overlap_ms;
+
+    float gap_us = PD_MAX_GAP_MS * 1000.0f;
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (r_dev->reset_limit > gap_us)
+            gap_us = r_dev->reset_limit;
+    }
+    return (unsigned)(gap_us * CHUNK_PACKAGE_GAPS / 1000.0f);
+}
+
+/// Split the ",start=<time>,end=<time>" options off an input file, see -r.
+static void split_input_range(char *spec, char const **range_start, char const **range_end)
+{
+    *range_start = NULL;
+    *range_end   = NULL;
+    for (;;) {
+        char *start = strstr(spec, ",start=");
+        char *end   = strstr(spec, ",end=");
+        char *opt   = start && (!end || start > end) ? start : end;
+        if (!opt)
+            break;
+        *opt = '\0'; // the last option ends the path
+        if (opt == start)
+            *range_start = opt + 7;
+        else
+            *range_end = opt + 5;
+    }
+}
+
+/** Read and demodulate one input file from the first sample to the end sample (0 for the end of the file), returns -1 if the file can not be read.
+
+    A ",start=<time>,end=<time>" range is read with the overlap of a package before and after it,
+    so the levels settle and the last package completes, only the packages starting in the range are output.
+*/
+static int read_sample_file(r_cfg_t *cfg, char const *filename, uint32_t sample_rate_0, uint32_t block_size, uint64_t first_sample, uint64_t end_sample, unsigned char *test_mode_buf, float *test_mode_float_buf)
+{
+    if (!strstr(filename, ",start=") && !strstr(filename, ",end="))
+        return read_sample_range(cfg, filename, filename, sample_rate_0, block_size, first_sample, end_sample, test_mode_buf, test_mode_float_buf);
+
+    char *spec = strdup(filename);
+    if (!spec)
+        FATAL_STRDUP("read_sample_file()");
+    char const *range_start;
+    char const *range_end;
+    split_input_range(spec, &range_start, &range_end);
+
+    file_info_t info = {0};
+    file_info_parse_filename(&info, spec);
+    uint32_t sample_rate = info.sample_rate ? info.sample_rate : sample_rate_0;
+    uint64_t start       = 0;
+    uint64_t end         = 0;
+    if ((range_start && sample_index_find(info.path, sample_rate, range_start, &start))
+            || (range_end && sample_index_find(info.path, sample_rate, range_end, &end))) {
+        free(spec);
+        return -1;
+    }
+    if (end && end <= start) {
+        fprintf(stderr, "Empty range in file: %s\n", filename);
+        free(spec);
+        return -1;
+    }
+
+    uint64_t overlap      = (uint64_t)package_overlap_ms(cfg) * sample_rate / 1000;
+    uint64_t output_start = cfg->output_start;
+    uint64_t output_end   = cfg->output_end;
+    cfg->output_start     = cfg->input_pos + start;
+    cfg->output_end       = end ? cfg->input_pos + end : 0;
+    int ret = read_sample_range(cfg, filename, spec, sample_rate_0, block_size,
+            start > overlap ? start - overlap : 0, end ? end + overlap : 0, test_mode_buf, test_mode_float_buf);
+    cfg->output_start = output_start;
+    cfg->output_end   = output_end;
+    free(spec);
+    return ret;
+}
+
+/// Time and heap allocations of a stage over all samples as data for the -Y bench report, allocs is negative if not counted.
+static data_t *bench_stage_data(char const *stage, double us, uint64_t samples, int64_t allocs)
+{
+    return data_make(
+            "stage",            "", DATA_STRING, stage,
+            "seconds",          "", DATA_DOUBLE, us * 1e-6,
+            "ns_per_sample",    "", DATA_DOUBLE, samples ? us * 1e3 / samples : 0.0,
+            "msps",             "", DATA_DOUBLE, us > 0.0 ? samples / us : 0.0,
+            "allocs",           "", DATA_COND, allocs >= 0, DATA_INT, (int)allocs,
+            NULL);
+}
+
+/** Read the input files a number of times and print the throughput of each stage as JSON, see -Y bench.
+
+    The files are mapped, after the first pass the samples are read from the page cache.
+    The pipeline stages are timed as they run, the baseband kernels again one by one
+    and the slicers and decoders with the decoder profiling.
+    The startup time is from the start of main() to the first pass.
+*/
+static int bench_sample_files(r_cfg_t *cfg, uint32_t sample_rate_0, uint32_t block_size, unsigned char *test_mode_buf, float *test_mode_float_buf)
+{
+    metrics_t *metrics = cfg->metrics;
+    list_t *r_devs     = &cfg->demod->r_devs;
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        r_dev->profile  = 1;
+    }
+
+    double begin = monotonic_time_us();
+    double startup_us = begin - cfg->start_us;
+    unsigned passes;
+    for (passes = 0; passes < cfg->bench_passes && !cfg->exit_async; ++passes) {
+        for (void **iter = cfg->in_files.elems; iter && *iter; ++iter) {
+            if (read_sample_file(cfg, *iter, sample_rate_0, block_size, 0, 0, test_mode_buf, test_mode_float_buf) < 0)
+                return -1;
+        }
+    }
+    double wall_us = monotonic_time_us() - begin;
+
+    double slicer_us      = 0.0;
+    double decode_us      = 0.0;
+    int64_t slicer_allocs = 0;
+    int64_t decode_allocs = 0;
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        slicer_us += r_dev->stats.slicer_time;
+        decode_us += r_dev->stats.decode_time;
+        slicer_allocs += (int64_t)r_dev->stats.slicer_allocs;
+        decode_allocs += (int64_t)r_dev->stats.decode_allocs;
+    }
+
+    // the baseband stage runs the kernels fused, the decoders time includes printing their events
+    uint64_t samples            = metrics->samples;
+    int counted                 = alloc_count_enabled();
+    alloc_count_t const *allocs = metrics->allocs;
+    data_t *stages[] = {
+            bench_stage_data("envelope_detect", metrics->kernel_us[METRICS_ENVELOPE], samples, -1),
+            bench_stage_data("low_pass", metrics->kernel_us[METRICS_LOW_PASS], samples, -1),
+            bench_stage_data("demod_fm", metrics->kernel_us[METRICS_DEMOD_FM], samples, -1),
+            bench_stage_data("baseband", metrics->stage[METRICS_BASEBAND].sum_us, samples, counted ? (int64_t)allocs[METRICS_BASEBAND].allocs : -1),
+            bench_stage_data("pulse_detect_package", metrics->stage[METRICS_PULSE_DETECT].sum_us, samples, counted ? (int64_t)allocs[METRICS_PULSE_DETECT].allocs : -1),
+            bench_stage_data("slicers", slicer_us, samples, counted ? slicer_allocs : -1),
+            bench_stage_data("decoders", decode_us, samples, counted ? decode_allocs : -1),
+            bench_stage_data("decode", metrics->stage[METRICS_DECODE].sum_us, samples, counted ? (int64_t)allocs[METRICS_DECODE].allocs : -1),
+            bench_stage_data("outputs", metrics->stage[METRICS_OUTPUT].sum_us, samples, counted ? (int64_t)allocs[METRICS_OUTPUT].allocs : -1),
+            bench_stage_data("total", wall_us, samples, -1),
+    };
+    data_t *data = data_make(
+            "passes",           "", DATA_INT, passes,
+            "files",            "", DATA_INT, cfg->in_files.len,
+            "sample_rate",      "", DATA_INT, cfg->samp_rate,
+            "msamples",         "", DATA_DOUBLE, samples * 1e-6,
+            "realtime",         "", DATA_DOUBLE, wall_us > 0.0 ? samples * 1e6 / cfg->samp_rate / wall_us : 0.0,
+            "events",           "", DATA_INT, (int)metrics->events,
+            "startup_ms",       "", DATA_DOUBLE, startup_us * 1e-3,
+            "config_ms",        "", DATA_DOUBLE, cfg->config_us * 1e-3,
+            "register_ms",      "", DATA_DOUBLE, cfg->register_us * 1e-3,
+            "decoders",         "", DATA_INT, (int)r_devs->len,
+            "idle_buffers",     "", DATA_COND, counted, DATA_INT, (int)metrics->buffers_idle,
+            "idle_allocs",      "", DATA_COND, counted, DATA_INT, (int)metrics->idle_allocs,
+            "idle_alloc_buffers", "", DATA_COND, counted, DATA_INT, (int)metrics->idle_alloc_buffers,
+            "stages",           "", DATA_ARRAY, data_array(sizeof(stages) / sizeof(*stages), DATA_DATA, stages),
+            NULL);
+
+    struct data_output *output = data_output_json_create(stdout);
+    if (output) {
+        data_output_print(output, data);
+        data_output_free(output);
+    }
+    data_free(data);
+    return 0;
+}
+
+/** Read the input files through all decoders and print the packages each decoder covers as JSON, see -Y coverage.
+
+    All priorities run on every package to find the overlaps, packages are not skipped as repeats
+    and decoders are not demoted. A package counts for the first decoder with events by priority,
+    the decoders that are first on any package are the recommended -R set, flex decoders are kept as configured.
+*/
+static int coverage_sample_files(r_cfg_t *cfg, uint32_t sample_rate_0, uint32_t block_size, unsigned char *test_mode_buf, float *test_mode_float_buf)
+{
+    list_t *r_devs          = &cfg->demod->r_devs;
+    cfg->demod->dedup_ms    = 0;
+    cfg->demod->adapt_secs  = 0;
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        r_dev->profile  = 1;
+        r_dev->coverage = 1;
+    }
+
+    for (void **iter = cfg->in_files.elems; iter && *iter && !cfg->exit_async; ++iter) {
+        if (read_sample_file(cfg, *iter, sample_rate_0, block_size, 0, 0, test_mode_buf, test_mode_float_buf) < 0)
+            return -1;
     }
 
-    for (void **iter = demod->dumper.elems; iter && *iter; ++iter) {
-        file_info_t const *dumper = *iter;
-        if (!dumper->file
-                || dumper->format == VCD_LOGIC
-                || dumper->format == PULSE_OOK)
+    list_t dev_data_list = {0};
+    char recommended[1024] = "";
+    size_t len = 0;
+    int unused = 0;
+    for (void **iter = r_devs->elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (r_dev->cover_first && r_dev->protocol_num && len < sizeof(recommended))
+            len += snprintf(recommended + len, sizeof(recommended) - len, "%s-R %u", len ? " " : "", r_dev->protocol_num);
+        if (!r_dev->cover_first)
+            unused++;
+        if (!r_dev->cover_packages)
             continue;
-        uint8_t *out_buf = iq_buf;  // Default is to dump IQ samples
-        unsigned long out_len = n_samples * demod->sample_size;
-
-        if (dumper->format == CU8_IQ) {
-            if (demod->sample_size == 4) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((uint8_t *)demod->buf.temp)[n] = (((int16_t *)iq_buf)[n] / 256) + 128; // scale Q0.15 to Q0.7
-                out_buf = (uint8_t *)demod->buf.temp;
-                out_len = n_samples * 2 * sizeof(uint8_t);
-            }
+
+        data_t *data = data_make(
+                "device",       "", DATA_INT, r_dev->protocol_num,
+                "name",         "", DATA_STRING, r_dev->name,
+                "disabled",     "", DATA_INT, r_dev->disabled,
+                "packages",     "", DATA_INT, r_dev->cover_packages,
+                "events",       "", DATA_INT, r_dev->prior.events + r_dev->stats.events,
+                "ok",           "", DATA_INT, r_dev->prior.ok + r_dev->stats.ok,
+                "messages",     "", DATA_INT, r_dev->prior.messages + r_dev->stats.messages,
+                "abort_length", "", DATA_INT, r_dev->prior.fails[-DECODE_ABORT_LENGTH] + r_dev->stats.fails[-DECODE_ABORT_LENGTH],
+                "abort_early",  "", DATA_INT, r_dev->prior.fails[-DECODE_ABORT_EARLY] + r_dev->stats.fails[-DECODE_ABORT_EARLY],
+                "fail_mic",     "", DATA_INT, r_dev->prior.fails[-DECODE_FAIL_MIC] + r_dev->stats.fails[-DECODE_FAIL_MIC],
+                "fail_sanity",  "", DATA_INT, r_dev->prior.fails[-DECODE_FAIL_SANITY] + r_dev->stats.fails[-DECODE_FAIL_SANITY],
+                "fail_other",   "", DATA_INT, r_dev->prior.fails[-DECODE_FAIL_OTHER] + r_dev->stats.fails[-DECODE_FAIL_OTHER],
+                "decoded",      "", DATA_INT, r_dev->cover_decoded,
+                "overlaps",     "", DATA_INT, r_dev->cover_overlaps,
+                "first",        "", DATA_INT, r_dev->cover_first,
+                "slicer_us",    "", DATA_INT, (int)(r_dev->prior.slicer_time + r_dev->stats.slicer_time),
+                "decode_us",    "", DATA_INT, (int)(r_dev->prior.decode_time + r_dev->stats.decode_time),
+                NULL);
+        list_push(&dev_data_list, data);
+    }
+
+    data_t *data = data_make(
+            "files",            "", DATA_INT, cfg->in_files.len,
+            "packages",         "", DATA_INT, (int)(cfg->metrics->frames_ook + cfg->metrics->frames_fsk),
+            "decoded",          "", DATA_INT, (int)cfg->metrics->frames_events,
+            "decoders",         "", DATA_INT, (int)r_devs->len,
+            "unused",           "", DATA_INT, unused,
+            "recommended",      "", DATA_STRING, recommended,
+            "coverage",         "", DATA_ARRAY, data_array(dev_data_list.len, DATA_DATA, dev_data_list.elems),
+            NULL);
+    list_free_elems(&dev_data_list, NULL);
+
+    struct data_output *output = data_output_json_create(stdout);
+    if (output) {
+        data_output_print(output, data);
+        data_output_free(output);
+    }
+    data_free(data);
+    return 0;
+}
+
+#ifdef THREADS
+/// An input file or a chunk of an input file of a batch, the events are kept until it is printed in order.
+typedef struct batch_item {
+    char const *filename;
+    uint64_t read_start;   ///< first sample to read
+    uint64_t read_end;     ///< sample to stop reading at, 0 for the end of the file
+    uint64_t start_sample; ///< only keep the events of packages starting from this sample
+    uint64_t end_sample;   ///< only keep the events of packages starting before this sample, 0 for no limit
+    list_t events;
+    int done;
+    int ret; ///< result of read_sample_file()
+} batch_item_t;
+
+/// Input files read on worker threads, see -Y jobs.
+typedef struct batch {
+    r_cfg_t *cfg;
+    uint32_t sample_rate_0;
+    uint32_t block_size;
+    pthread_mutex_t lock;
+    pthread_cond_t cond; ///< signals a read item, a printed item, or the stop
+    int stop;
+    list_t items;      ///< the files and chunks in order, a batch_item_t each
+    size_t next_item;  ///< the next item to read
+    size_t next_print; ///< the next item to print
+    size_t window;     ///< items read ahead of the printed item at most
+} batch_t;
+
+/// A worker thread with its own demod state and decoders.
+typedef struct batch_worker {
+    batch_t *batch;
+    r_cfg_t *cfg;
+    pthread_t thread;
+} batch_worker_t;
+
+static THREAD_RETURN THREAD_CALL batch_thread(void *arg)
+{
+    batch_worker_t *worker = arg;
+    batch_t *batch         = worker->batch;
+
+    unsigned char *test_mode_buf = malloc(batch->block_size * sizeof(unsigned char));
+    if (!test_mode_buf)
+        FATAL_MALLOC("batch_thread()");
+    float *test_mode_float_buf = malloc(batch->block_size / sizeof(int16_t) * sizeof(float));
+    if (!test_mode_float_buf)
+        FATAL_MALLOC("batch_thread()");
+
+    pthread_mutex_lock(&batch->lock);
+    for (;;) {
+        while (!batch->stop && batch->next_item < batch->items.len
+                && batch->next_item >= batch->next_print + batch->window) {
+            pthread_cond_wait(&batch->cond, &batch->lock);
+        }
+        if (batch->stop || batch->next_item >= batch->items.len)
+            break;
+        batch_item_t *item = batch->items.elems[batch->next_item];
+        batch->next_item++;
+        pthread_mutex_unlock(&batch->lock);
+
+        // each item starts over, the events do not depend on the items read before on this worker
+        r_reset_batch_cfg(worker->cfg, batch->cfg);
+        worker->cfg->batch_events = &item->events;
+        uint64_t base             = worker->cfg->input_pos;
+        worker->cfg->output_start = base + item->start_sample;
+        worker->cfg->output_end   = item->end_sample ? base + item->end_sample : 0;
+        int ret = read_sample_file(worker->cfg, item->filename, batch->sample_rate_0, batch->block_size,
+                item->read_start, item->read_end, test_mode_buf, test_mode_float_buf);
+        worker->cfg->batch_events = NULL;
+
+        pthread_mutex_lock(&batch->lock);
+        item->ret  = ret;
+        item->done = 1;
+        pthread_cond_broadcast(&batch->cond);
+    }
+    pthread_mutex_unlock(&batch->lock);
+
+    free(test_mode_float_buf);
+    free(test_mode_buf);
+    return (THREAD_RETURN)0;
+}
+
+/// Check if the input files can be read on worker threads, all batch options need the files in turn.
+static int batch_supported(r_cfg_t *cfg)
+{
+    struct dm_state *demod = cfg->demod;
+    if (demod->dumper.len || demod->samp_grab || demod->am_analyze || demod->analyze_pulses || cfg->signal_cluster.repeats
+            || cfg->raw_mode || cfg->raw_handler.len || cfg->pulse_handler.len || cfg->event_fusion || cfg->channelizer || cfg->decimator
+            || cfg->second_chance) {
+        fprintf(stderr, "Dumpers, signal grabber, analyzers, raw pulses, fusion, retry, channels, processing rate, raw and pulse outputs are not available with -Y jobs, reading the files in turn.\n");
+        return 0;
+    }
+    if (cfg->in_replay || cfg->bytes_to_read || cfg->duration > 0 || cfg->after_successful_events_flag
+            || (cfg->report_stats && cfg->stats_interval) || cfg->checkpoint_path) {
+        fprintf(stderr, "Replay, samples to read, duration, stop after events, stats intervals, and checkpoints are not available with -Y jobs, reading the files in turn.\n");
+        return 0;
+    }
+    return 1;
+}
+
+/// Bytes per sample of a file format as read in a batch, 0 if the format can not be split into chunks.
+static unsigned batch_sample_bytes(unsigned format)
+{
+    if (format == CU8_IQ || format == CS8_IQ || format == S16_AM || format == S16_FM)
+        return 2;
+    if (format == CS16_IQ)
+        return 4;
+    if (format == CF32_IQ)
+        return 8; // demodulated natively in a batch
+    return 0;
+}
+
+/// Size of a regular file, 0 if the file can not be split into chunks.
+static uint64_t batch_file_size(char const *path)
+{
+#ifndef _WIN32
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        return (uint64_t)st.st_size;
+#else
+    (void)path;
+#endif
+    return 0;
+}
+
+/// Add an input file to the batch, split into overlapping chunks if requested.
+static void batch_add_file(batch_t *batch, char const *filename, unsigned overlap_ms)
+{
+    r_cfg_t *cfg        = batch->cfg;
+    uint32_t block_size = batch->block_size;
+
+    uint64_t num_blocks     = 0;
+    uint64_t chunk_blocks   = 0;
+    uint64_t overlap_blocks = 0;
+    unsigned sample_bytes   = 0;
+    if (cfg->batch_chunk) {
+        file_info_t info = {0};
+        file_info_parse_filename(&info, filename);
+        sample_bytes  = batch_sample_bytes(info.format);
+        uint64_t size = sample_bytes && !info.compression && strcmp(info.path, "-") ? batch_file_size(info.path) : 0;
+        uint32_t rate = info.sample_rate ? info.sample_rate : batch->sample_rate_0;
+
+        num_blocks     = (size + block_size - 1) / block_size;
+        chunk_blocks   = (cfg->batch_chunk + block_size - 1) / block_size;
+        overlap_blocks = ((uint64_t)overlap_ms * rate / 1000 * sample_bytes + block_size - 1) / block_size;
+        if (num_blocks <= chunk_blocks)
+            num_blocks = 0; // read as a whole
+    }
+
+    uint64_t first = 0;
+    do {
+        batch_item_t *item = calloc(1, sizeof(*item));
+        if (!item)
+            FATAL_CALLOC("batch_add_file()");
+        item->filename = filename;
+        if (num_blocks) {
+            // read the overlap before and after the chunk, keep the packages starting in the chunk
+            uint64_t last      = first + chunk_blocks < num_blocks ? first + chunk_blocks : num_blocks;
+            item->read_start   = (first > overlap_blocks ? first - overlap_blocks : 0) * block_size / sample_bytes;
+            item->read_end     = last + overlap_blocks < num_blocks ? (last + overlap_blocks) * block_size / sample_bytes : 0;
+            item->start_sample = first * block_size / sample_bytes;
+            item->end_sample   = last < num_blocks ? last * block_size / sample_bytes : 0;
+            first              = last;
+        }
+        list_push(&batch->items, item);
+    } while (num_blocks && first < num_blocks);
+}
+
+static void batch_item_free(batch_item_t *item)
+{
+    list_free_elems(&item->events, (list_elem_free_fn)data_free);
+    free(item);
+}
+
+/// Read the input files on worker threads and print the events in order, returns -1 if no worker started.
+static int read_sample_files_batch(r_cfg_t *cfg, uint32_t sample_rate_0, uint32_t block_size)
+{
+    batch_t batch       = {0};
+    batch.cfg           = cfg;
+    batch.sample_rate_0 = sample_rate_0;
+    batch.block_size    = block_size;
+    unsigned overlap_ms = package_overlap_ms(cfg);
+    for (void **iter = cfg->in_files.elems; iter && *iter; ++iter) {
+        batch_add_file(&batch, *iter, overlap_ms);
+    }
+
+    unsigned num_workers = cfg->batch_jobs < batch.items.len ? cfg->batch_jobs : (unsigned)batch.items.len;
+    batch.window         = num_workers * 4;
+    batch_worker_t *workers = calloc(num_workers, sizeof(*workers));
+    if (!workers)
+        FATAL_CALLOC("read_sample_files_batch()");
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.cond, NULL);
+
+    unsigned started = 0;
+    for (; started < num_workers; ++started) {
+        workers[started].batch = &batch;
+        workers[started].cfg   = r_create_batch_cfg(cfg);
+        if (pthread_create(&workers[started].thread, NULL, batch_thread, &workers[started])) {
+            fprintf(stderr, "%s: failed to start thread\n", __func__);
+            r_free_batch_cfg(workers[started].cfg);
+            break;
         }
-        else if (dumper->format == CS16_IQ) {
-            if (demod->sample_size == 2) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((int16_t *)demod->buf.temp)[n] = (iq_buf[n] * 256) - 32768; // scale Q0.7 to Q0.15
-                out_buf = (uint8_t *)demod->buf.temp; // this buffer is too small if out_block_size is large
-                out_len = n_samples * 2 * sizeof(int16_t);
-            }
+    }
+    if (started && cfg->verbosity) {
+        fprintf(stderr, "Reading %zu files in %zu parts on %u threads, the chunks overlap by %u ms\n",
+                cfg->in_files.len, batch.items.len, started, overlap_ms);
+    }
+
+    for (size_t i = 0; started && i < batch.items.len; ++i) {
+        batch_item_t *item = batch.items.elems[i];
+        pthread_mutex_lock(&batch.lock);
+        while (!item->done) {
+            pthread_cond_wait(&batch.cond, &batch.lock);
         }
-        else if (dumper->format == CS8_IQ) {
-            if (demod->sample_size == 2) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((int8_t *)demod->buf.temp)[n] = (iq_buf[n] - 128);
-            }
-            else if (demod->sample_size == 4) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((int8_t *)demod->buf.temp)[n] = ((int16_t *)iq_buf)[n] >> 8;
-            }
-            out_buf = (uint8_t *)demod->buf.temp;
-            out_len = n_samples * 2 * sizeof(int8_t);
+        pthread_mutex_unlock(&batch.lock);
+
+        begin_event_batch(cfg);
+        for (size_t k = 0; k < item->events.len; ++k) {
+            output_event(cfg, item->events.elems[k]);
         }
-        else if (dumper->format == CF32_IQ) {
-            if (demod->sample_size == 2) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((float *)demod->buf.temp)[n] = (iq_buf[n] - 128) / 128.0f;
-            }
-            else if (demod->sample_size == 4) {
-                for (unsigned long n = 0; n < n_samples * 2; ++n)
-                    ((float *)demod->buf.temp)[n] = ((int16_t *)iq_buf)[n] / 32768.0f;
+        end_event_batch(cfg);
+        list_free_elems(&item->events, NULL);
+
+        time_t rawtime;
+        time(&rawtime);
+        if (rawtime != cfg->sync_time) {
+            // write out batched output at least once a second
+            for (size_t j = 0; j < cfg->output_handler.len; ++j) { // list might contain NULLs
+                data_output_sync(cfg->output_handler.elems[j], 0);
             }
-            out_buf = (uint8_t *)demod->buf.temp; // this buffer is too small if out_block_size is large
-            out_len = n_samples * 2 * sizeof(float);
-        }
-        else if (dumper->format == S16_AM) {
-            out_buf = (uint8_t *)demod->am_buf;
-            out_len = n_samples * sizeof(int16_t);
-        }
-        else if (dumper->format == S16_FM) {
-            out_buf = (uint8_t *)demod->buf.fm;
-            out_len = n_samples * sizeof(int16_t);
-        }
-        else if (dumper->format == F32_AM) {
-            for (unsigned long n = 0; n < n_samples; ++n)
-                demod->f32_buf[n] = demod->am_buf[n] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == F32_FM) {
-            for (unsigned long n = 0; n < n_samples; ++n)
-                demod->f32_buf[n] = demod->buf.fm[n] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == F32_I) {
-            if (demod->sample_size == 2)
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = (iq_buf[n * 2] - 128) * (1.0f / 0x80); // scale from Q0.7
-            else
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = ((int16_t *)iq_buf)[n * 2] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == F32_Q) {
-            if (demod->sample_size == 2)
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = (iq_buf[n * 2 + 1] - 128) * (1.0f / 0x80); // scale from Q0.7
-            else
-                for (unsigned long n = 0; n < n_samples; ++n)
-                    demod->f32_buf[n] = ((int16_t *)iq_buf)[n * 2 + 1] * (1.0f / 0x8000); // scale from Q0.15
-            out_buf = (uint8_t *)demod->f32_buf;
-            out_len = n_samples * sizeof(float);
-        }
-        else if (dumper->format == U8_LOGIC) { // state data
-            out_buf = demod->u8_buf;
-            out_len = n_samples;
+            cfg->sync_time = rawtime;
         }
 
-        if (fwrite(out_buf, 1, out_len, dumper->file) != out_len) {
-            fprintf(stderr, "Short write, samples lost, exiting!\n");
-            cfg->exit_async = 1;
+        pthread_mutex_lock(&batch.lock);
+        batch.next_print = i + 1;
+        if (item->ret < 0)
+            batch.stop = 1; // stop at the first unreadable file, as when reading in turn
+        pthread_cond_broadcast(&batch.cond);
+        pthread_mutex_unlock(&batch.lock);
+        if (item->ret < 0)
+            break;
+    }
+
+    for (unsigned i = 0; i < started; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        r_free_batch_cfg(workers[i].cfg);
+    }
+    list_free_elems(&batch.items, (list_elem_free_fn)batch_item_free);
+    pthread_cond_destroy(&batch.cond);
+    pthread_mutex_destroy(&batch.lock);
+    free(workers);
+
+    return started ? 0 : -1;
+}
+#endif
+
+/// Counts of the test codes verified from a file, see -y @file.
+typedef struct verify_stats {
+    unsigned codes;
+    unsigned rfraw; ///< codes in RfRaw format, the others are bitbuffer codes
+    unsigned events;
+    int last; ///< events of the last code
+} verify_stats_t;
+
+/// Verify a line of test data with all decoders, or with a single decoder if prefixed with "[<protocol>]".
+static void verify_test_line(r_cfg_t *cfg, char *line, verify_stats_t *stats)
+{
+    struct dm_state *demod = cfg->demod;
+    if (cfg->verbosity)
+        fprintf(stderr, "Processing test data \"%s\"...\n", line);
+    int r = 0;
+    // test a single decoder?
+    if (*line == '[') {
+        char *e = NULL;
+        unsigned d = (unsigned)strtol(&line[1], &e, 10);
+        if (!e || *e != ']') {
+            fprintf(stderr, "Bad protocol number %.5s.\n", line);
+            exit(1);
+        }
+        e++;
+        r_device *r_dev = NULL;
+        for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+            r_device *r_dev_i = *iter;
+            if (r_dev_i->protocol_num == d) {
+                r_dev = r_dev_i;
+                break;
+            }
+        }
+        if (!r_dev) {
+            fprintf(stderr, "Unknown protocol number %u.\n", d);
+            exit(1);
         }
+        if (cfg->verbosity)
+            fprintf(stderr, "Verifying test data with device %s.\n", r_dev->name);
+        if (rfraw_check(e)) {
+            pulse_data_t pulse_data = {0};
+            rfraw_parse(&pulse_data, e);
+            list_t single_dev = {0};
+            list_push(&single_dev, r_dev);
+            if (!pulse_data.fsk_f2_est)
+                r += run_ook_demods(&single_dev, &pulse_data);
+            else
+                r += run_fsk_demods(&single_dev, &pulse_data);
+            pulse_data_free(&pulse_data);
+            list_free_elems(&single_dev, NULL);
+            stats->rfraw++;
+        } else
+        r += pulse_slicer_string(e, r_dev);
+    }
+    // otherwise test all decoders
+    else if (rfraw_check(line)) {
+        pulse_data_t pulse_data = {0};
+        rfraw_parse(&pulse_data, line);
+        if (!pulse_data.fsk_f2_est)
+            r += run_ook_demods(&demod->r_devs, &pulse_data);
+        else
+            r += run_fsk_demods(&demod->r_devs, &pulse_data);
+        pulse_data_free(&pulse_data);
+        stats->rfraw++;
+    } else
+    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (cfg->verbosity)
+            fprintf(stderr, "Verifying test data with device %s.\n", r_dev->name);
+        r += pulse_slicer_string(line, r_dev);
     }
+    stats->codes++;
+    stats->events += r > 0 ? (unsigned)r : 0;
+    stats->last = r;
+}
 
-    cfg->input_pos += n_samples;
-    if (cfg->bytes_to_read > 0)
-        cfg->bytes_to_read -= len;
+#ifdef THREADS
+/// Lines of test data verified as one block on a worker thread.
+#define VERIFY_BLOCK_CODES 256
+/// Size of a block of test data, a block is ended if less than a line would fit.
+#define VERIFY_BLOCK_SIZE (16 * INPUT_LINE_MAX)
+
+/// A block of test data lines, the events are kept until it is printed in order.
+typedef struct verify_item {
+    char *lines; ///< the lines, each terminated
+    size_t size; ///< the size of the lines
+    verify_stats_t stats;
+    list_t events;
+    int done;
+} verify_item_t;
+
+/// Test data verified on worker threads, see -y @file with -Y jobs.
+typedef struct verify_batch {
+    r_cfg_t *cfg;
+    pthread_mutex_t lock;
+    pthread_cond_t cond; ///< signals an added block, a verified block, or the end of the input
+    int eof;             ///< no more blocks are added
+    list_t items;        ///< the blocks in order, a verify_item_t each, NULL once printed
+    size_t next_item;    ///< the next block to verify
+} verify_batch_t;
+
+typedef struct verify_worker {
+    verify_batch_t *batch;
+    r_cfg_t *cfg;
+    pthread_t thread;
+} verify_worker_t;
+
+static THREAD_RETURN THREAD_CALL verify_thread(void *arg)
+{
+    verify_worker_t *worker = arg;
+    verify_batch_t *batch   = worker->batch;
 
-    if (cfg->after_successful_events_flag && (d_events > 0)) {
-        alarm(0); // cancel the watchdog timer
-        if (cfg->after_successful_events_flag == 1) {
-            cfg->exit_async = 1;
+    pthread_mutex_lock(&batch->lock);
+    for (;;) {
+        while (!batch->eof && batch->next_item >= batch->items.len) {
+            pthread_cond_wait(&batch->cond, &batch->lock);
         }
-        else {
-            cfg->hop_now = 1;
+        if (batch->next_item >= batch->items.len)
+            break;
+        verify_item_t *item = batch->items.elems[batch->next_item];
+        batch->next_item++;
+        pthread_mutex_unlock(&batch->lock);
+
+        // each block starts over, the events do not depend on the blocks verified before on this worker
+        r_reset_batch_cfg(worker->cfg, worker->batch->cfg);
+        worker->cfg->batch_events = &item->events;
+        for (char *line = item->lines; line < item->lines + item->size; line += strlen(line) + 1) {
+            verify_test_line(worker->cfg, line, &item->stats);
         }
+        worker->cfg->batch_events = NULL;
+
+        pthread_mutex_lock(&batch->lock);
+        item->done = 1;
+        pthread_cond_broadcast(&batch->cond);
     }
+    pthread_mutex_unlock(&batch->lock);
+    return (THREAD_RETURN)0;
+}
 
-    time_t rawtime;
-    time(&rawtime);
-    // choose hop_index as frequency_index, if there are too few hop_times use the last one
-    int hop_index = cfg->hop_times > cfg->frequency_index ? cfg->frequency_index : cfg->hop_times - 1;
-    if (cfg->hop_times > 0 && cfg->frequencies > 1
-            && difftime(rawtime, cfg->hop_start_time) >= cfg->hop_time[hop_index]) {
-        alarm(0); // cancel the watchdog timer
-        cfg->hop_now = 1;
+/// Read a block of test data lines, returns NULL at the end of the input.
+static verify_item_t *verify_read_block(FILE *fp)
+{
+    verify_item_t *item = calloc(1, sizeof(*item));
+    if (!item)
+        FATAL_CALLOC("verify_read_block()");
+    item->lines = malloc(VERIFY_BLOCK_SIZE);
+    if (!item->lines)
+        FATAL_MALLOC("verify_read_block()");
+    // lines are read as with a single buffer of INPUT_LINE_MAX, longer lines are split
+    for (unsigned n = 0; n < VERIFY_BLOCK_CODES && VERIFY_BLOCK_SIZE - item->size >= INPUT_LINE_MAX; ++n) {
+        char *line = item->lines + item->size;
+        if (!fgets(line, INPUT_LINE_MAX, fp))
+            break;
+        item->size += strlen(line) + 1;
     }
-    if (cfg->duration > 0 && rawtime >= cfg->stop_time) {
-        alarm(0); // cancel the watchdog timer
-        cfg->exit_async = 1;
-        fprintf(stderr, "Time expired, exiting!\n");
+    if (!item->size) {
+        free(item->lines);
+        free(item);
+        return NULL;
     }
-    if (cfg->stats_now || (cfg->report_stats && cfg->stats_interval && rawtime >= cfg->stats_time)) {
-        event_occurred_handler(cfg, create_report_data(cfg, cfg->stats_now ? 3 : cfg->report_stats));
-        flush_report_data(cfg);
-        if (rawtime >= cfg->stats_time)
-            cfg->stats_time += cfg->stats_interval;
-        if (cfg->stats_now)
-            cfg->stats_now--;
+    return item;
+}
+
+static void verify_item_free(verify_item_t *item)
+{
+    if (!item)
+        return;
+    list_free_elems(&item->events, (list_elem_free_fn)data_free);
+    free(item->lines);
+    free(item);
+}
+
+/// Verify the test data lines on worker threads and print the events in order, returns -1 if no worker started.
+static int verify_test_lines_batch(r_cfg_t *cfg, FILE *fp, verify_stats_t *stats)
+{
+    verify_batch_t batch = {0};
+    batch.cfg            = cfg;
+    unsigned num_workers = cfg->batch_jobs;
+    size_t window        = num_workers * 4; // blocks read ahead of the printed block at most
+    verify_worker_t *workers = calloc(num_workers, sizeof(*workers));
+    if (!workers)
+        FATAL_CALLOC("verify_test_lines_batch()");
+    pthread_mutex_init(&batch.lock, NULL);
+    pthread_cond_init(&batch.cond, NULL);
+
+    unsigned started = 0;
+    for (; started < num_workers; ++started) {
+        workers[started].batch = &batch;
+        workers[started].cfg   = r_create_batch_cfg(cfg);
+        if (pthread_create(&workers[started].thread, NULL, verify_thread, &workers[started])) {
+            fprintf(stderr, "%s: failed to start thread\n", __func__);
+            r_free_batch_cfg(workers[started].cfg);
+            break;
+        }
     }
+    if (started && cfg->verbosity)
+        fprintf(stderr, "Verifying test data in blocks of %d lines on %u threads\n", VERIFY_BLOCK_CODES, started);
 
-    if (cfg->hop_now && !cfg->exit_async) {
-        cfg->hop_now = 0;
-        time(&cfg->hop_start_time);
-        cfg->frequency_index = (cfg->frequency_index + 1) % cfg->frequencies;
-        sdr_set_center_freq(cfg->dev, cfg->frequency[cfg->frequency_index], 0);
+    size_t next_print = 0;
+    int eof           = !started;
+    while (started && (!eof || next_print < batch.items.len)) {
+        // read ahead, then print the oldest block once verified
+        verify_item_t *item = NULL;
+        if (!eof && batch.items.len < next_print + window) {
+            item = verify_read_block(fp);
+            pthread_mutex_lock(&batch.lock);
+            if (item)
+                list_push(&batch.items, item);
+            else
+                batch.eof = eof = 1;
+            pthread_cond_broadcast(&batch.cond);
+            pthread_mutex_unlock(&batch.lock);
+            continue;
+        }
+
+        item = batch.items.elems[next_print];
+        pthread_mutex_lock(&batch.lock);
+        while (!item->done) {
+            pthread_cond_wait(&batch.cond, &batch.lock);
+        }
+        batch.items.elems[next_print] = NULL;
+        pthread_mutex_unlock(&batch.lock);
+        next_print++;
+
+        for (size_t k = 0; k < item->events.len; ++k) {
+            output_event(cfg, item->events.elems[k]);
+        }
+        list_free_elems(&item->events, NULL);
+        stats->codes += item->stats.codes;
+        stats->rfraw += item->stats.rfraw;
+        stats->events += item->stats.events;
+        stats->last = item->stats.last;
+        verify_item_free(item);
     }
+
+    for (unsigned i = 0; i < started; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        r_free_batch_cfg(workers[i].cfg);
+    }
+    list_free_elems(&batch.items, (list_elem_free_fn)verify_item_free);
+    pthread_cond_destroy(&batch.cond);
+    pthread_mutex_destroy(&batch.lock);
+    free(workers);
+
+    return started ? 0 : -1;
 }
+#endif
 
 static int hasopt(int test, int argc, char *argv[], char const *optstring)
 {
@@ -744,7 +1847,7 @@ static int hasopt(int test, int argc, char *argv[], char const *optstring)
 
 static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg);
 
-#define OPTSTRING "hVvqDc:x:z:p:a:AI:S:m:M:r:w:W:l:d:t:f:H:g:s:b:n:R:X:F:K:C:T:UGy:E:Y:"
+#define OPTSTRING "hVvqDc:x:z:p:a:AI:S:m:M:r:w:W:l:d:t:f:H:j:g:s:P:B:b:n:R:X:F:O:K:C:T:UGy:E:Y:"
 
 // these should match the short options exactly
 static struct conf_keywords const conf_keywords[] = {
@@ -758,11 +1861,14 @@ static struct conf_keywords const conf_keywords[] = {
         {"gain", 'g'},
         {"frequency", 'f'},
         {"hop_interval", 'H'},
+        {"channel", 'j'},
         {"ppm_error", 'p'},
         {"sample_rate", 's'},
+        {"processing_rate", 'P'},
         {"protocol", 'R'},
         {"decoder", 'X'},
         {"register_all", 'G'},
+        {"buffer_profile", 'B'},
         {"out_block_size", 'b'},
         {"level_limit", 'l'},
         {"samples_to_read", 'n'},
@@ -777,6 +1883,7 @@ static struct conf_keywords const conf_keywords[] = {
         {"override_long", 'x'},
         {"pulse_detect", 'Y'},
         {"output", 'F'},
+        {"output_queue", 'O'},
         {"output_tag", 'K'},
         {"convert", 'C'},
         {"duration", 'T'},
@@ -833,6 +1940,14 @@ static void parse_conf_args(r_cfg_t *cfg, int argc, char *argv[])
     }
 }
 
+/// Enable the quiet batch mode of the pulse analyzer, the interval in packages defaults to 100.
+static void enable_analyzer_batch(r_cfg_t *cfg, char const *interval)
+{
+    pulse_analyzer_stats_free(cfg->demod->analyzer_stats);
+    cfg->demod->analyzer_stats = pulse_analyzer_stats_create(atouint32_metric(interval ? interval : "100", "-Y analyze: "));
+    cfg->demod->analyze_pulses = cfg->demod->analyzer_stats != NULL;
+}
+
 static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
 {
     int n;
@@ -842,11 +1957,17 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         arg = NULL; // remove the arg if it's a request for the usage help
     }
 
+    // a reload only rebuilds the decoders, see reload_decoders()
+    if (cfg->reload_only && opt != 'c' && opt != 'R' && opt != 'X')
+        return;
+
     switch (opt) {
     case 'h':
         usage(0);
         break;
     case 'V':
+        fprintf(stderr, "Baseband kernels: %s, envelope %s\n",
+                baseband_simd_str(baseband_get_simd()), baseband_envelope_str(baseband_get_envelope()));
         exit(0); // we already printed the version
         break;
     case 'v':
@@ -862,7 +1983,10 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         if (!arg)
             help_device();
 
-        cfg->dev_query = arg;
+        if (cfg->dev_query)
+            add_sdr_input(cfg, arg); // read several devices
+        else
+            cfg->dev_query = arg;
         break;
     case 't':
         // this option changed, check and warn if old meaning is used
@@ -890,6 +2014,11 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         else
             fprintf(stderr, "Max number of hop times reached %d\n", MAX_FREQS);
         break;
+    case 'j':
+        if (!arg)
+            usage(1);
+        add_channel(cfg, arg);
+        break;
     case 'g':
         if (!arg)
             help_gain();
@@ -909,8 +2038,26 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
     case 's':
         cfg->samp_rate = atouint32_metric(arg, "-s: ");
         break;
+    case 'P':
+        cfg->processing_rate = atouint32_metric(arg, "-P: ");
+        break;
+    case 'B':
+        if (!arg)
+            usage(1);
+        if (!strcasecmp(arg, "low-latency"))
+            cfg->buffer_profile = BUFFER_PROFILE_LOW_LATENCY;
+        else if (!strcasecmp(arg, "throughput"))
+            cfg->buffer_profile = BUFFER_PROFILE_THROUGHPUT;
+        else if (!strcasecmp(arg, "default"))
+            cfg->buffer_profile = BUFFER_PROFILE_DEFAULT;
+        else {
+            fprintf(stderr, "Invalid buffer profile \"%s\", use low-latency, throughput, or default.\n", arg);
+            usage(1);
+        }
+        break;
     case 'b':
-        cfg->out_block_size = atouint32_metric(arg, "-b: ");
+        cfg->out_block_size     = atouint32_metric(arg, "-b: ");
+        cfg->out_block_size_set = 1;
         break;
     case 'l':
         n = 1000;
@@ -932,7 +2079,13 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         }
         break;
     case 'A':
-        cfg->demod->analyze_pulses = atobv(arg, 1);
+        if (arg && kwargs_match(arg, "batch", NULL)) {
+            char const *interval = strchr(arg, '=');
+            enable_analyzer_batch(cfg, interval ? interval + 1 : NULL);
+        }
+        else {
+            cfg->demod->analyze_pulses = atobv(arg, 1);
+        }
         break;
     case 'I':
         fprintf(stderr, "include_only (-I) is deprecated. Use -S none|all|unknown|known\n");
@@ -960,16 +2113,36 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
     case 'S':
         if (!arg)
             usage(1);
-        if (strcasecmp(arg, "all") == 0)
-            cfg->grab_mode = 1;
-        else if (strcasecmp(arg, "unknown") == 0)
-            cfg->grab_mode = 2;
-        else if (strcasecmp(arg, "known") == 0)
-            cfg->grab_mode = 3;
-        else
-            cfg->grab_mode = atobv(arg, 1);
-        if (cfg->grab_mode && !cfg->demod->samp_grab)
-            cfg->demod->samp_grab = samp_grab_create(SIGNAL_GRABBER_BUFFER);
+        {
+            // the mode, then an optional container file prefix and size limit
+            char *prefix = strdup(arg);
+            if (!prefix)
+                FATAL_STRDUP("parse_conf_option()");
+            char *container = arg_param(prefix);
+            if (container && container[-1] == ':')
+                container[-1] = '\0';
+            else
+                container = NULL;
+            if (strcasecmp(prefix, "all") == 0)
+                cfg->grab_mode = 1;
+            else if (strcasecmp(prefix, "unknown") == 0)
+                cfg->grab_mode = 2;
+            else if (strcasecmp(prefix, "known") == 0)
+                cfg->grab_mode = 3;
+            else
+                cfg->grab_mode = atobv(prefix, 1);
+            if (cfg->grab_mode && !cfg->demod->samp_grab)
+                cfg->demod->samp_grab = samp_grab_create(SIGNAL_GRABBER_BUFFER);
+            if (cfg->grab_mode && container && *container && cfg->demod->samp_grab && !cfg->demod->samp_grab->container) {
+                char *size = arg_param(container);
+                if (size && size[-1] == ':')
+                    size[-1] = '\0';
+                else
+                    size = NULL;
+                samp_grab_set_container(cfg->demod->samp_grab, container, size ? atouint32_metric(size, "-S: ") : 0);
+            }
+            free(prefix);
+        }
         break;
     case 'm':
         fprintf(stderr, "sample mode option is deprecated.\n");
@@ -1046,6 +2219,8 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
             cfg->verbose_bits = 1;
         else if (!strcasecmp(arg, "description"))
             cfg->report_description = 1;
+        else if (!strcasecmp(arg, "seq"))
+            cfg->report_seq = 1;
         else if (!strcasecmp(arg, "newmodel"))
             fprintf(stderr, "newmodel option (-M) is deprecated.\n");
         else if (!strcasecmp(arg, "oldmodel"))
@@ -1058,8 +2233,29 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
             time(&cfg->stats_time);
             cfg->stats_time += cfg->stats_interval;
         }
-        else if (!strncasecmp(arg, "replay", 6))
-            cfg->in_replay = atobv(arg_param(arg), 1);
+        else if (!strcasecmp(arg, "profile")) {
+            cfg->report_profile = 1;
+            for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+                r_device *r_dev = *iter;
+                r_dev->profile  = 1;
+            }
+        }
+        else if (!strncasecmp(arg, "trace", 5)) {
+            char *p = arg_param(arg);
+            if (!p || !*p)
+                usage(1);
+            trace_event_close(cfg->trace);
+            cfg->trace = trace_event_open(p);
+            if (!cfg->trace)
+                exit(1);
+        }
+        else if (!strncasecmp(arg, "replay", 6)) {
+            char *p = arg_param(arg);
+            cfg->in_replay = p ? (float)atof(p) : 1.0f;
+            if (cfg->in_replay < 0.0f)
+                usage(1);
+            cfg->in_replay_ms = atoiv(arg_param(p), 0);
+        }
         else
             cfg->report_meta = atobv(arg, 1);
         break;
@@ -1100,6 +2296,7 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         else {
             fprintf(stderr, "Disabling all device decoders.\n");
             list_clear(&cfg->demod->r_devs, (list_elem_free_fn)free_protocol);
+            decoder_dispatch_invalidate(cfg->demod);
         }
         break;
     case 'X':
@@ -1108,6 +2305,7 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
 
         flex_device = flex_create_device(arg);
         register_protocol(cfg, flex_device, "");
+        free(flex_device); // registered as a copy, a reload would leak it
         break;
     case 'q':
         fprintf(stderr, "quiet option (-q) is default and deprecated. See -v to increase verbosity\n");
@@ -1116,6 +2314,10 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         if (!arg)
             help_output();
 
+        output_filter_opts_t filter_opts = {0};
+        size_t num_outputs               = cfg->output_handler.len;
+        int filtered                     = output_filter_strip(arg, &filter_opts);
+
         if (strncmp(arg, "json", 4) == 0) {
             add_json_output(cfg, arg_param(arg));
         }
@@ -1125,15 +2327,33 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         else if (strncmp(arg, "kv", 2) == 0) {
             add_kv_output(cfg, arg_param(arg));
         }
+        else if (strncmp(arg, "cbor", 4) == 0) {
+            add_cbor_output(cfg, arg_param(arg));
+        }
+        else if (strncmp(arg, "delta", 5) == 0) {
+            add_delta_output(cfg, arg_param(arg));
+        }
+        else if (strncmp(arg, "arrow", 5) == 0) {
+            add_arrow_output(cfg, arg_param(arg));
+        }
+        else if (strncmp(arg, "sqlite", 6) == 0) {
+            add_sqlite_output(cfg, arg_param(arg));
+        }
         else if (strncmp(arg, "mqtt", 4) == 0) {
             add_mqtt_output(cfg, arg);
         }
         else if (strncmp(arg, "influx", 6) == 0) {
             add_influx_output(cfg, arg);
         }
+        else if (strncmp(arg, "nats", 4) == 0) {
+            add_nats_output(cfg, arg);
+        }
         else if (strncmp(arg, "syslog", 6) == 0) {
             add_syslog_output(cfg, arg_param(arg));
         }
+        else if (strncmp(arg, "shm", 3) == 0) {
+            add_shm_output(cfg, arg_param(arg));
+        }
         else if (strncmp(arg, "http", 4) == 0) {
             add_http_output(cfg, arg_param(arg));
         }
@@ -1146,10 +2366,42 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
         else if (strncmp(arg, "rtl_tcp", 7) == 0) {
             add_rtltcp_output(cfg, arg_param(arg));
         }
+        else if (strncmp(arg, "pulses", 6) == 0) {
+            add_pulses_output(cfg, arg_param(arg));
+        }
         else {
             fprintf(stderr, "Invalid output format %s\n", arg);
             usage(1);
         }
+        if (filtered && cfg->output_handler.len > num_outputs)
+            add_output_filter(cfg, &filter_opts);
+        break;
+    case 'O':
+        if (!arg)
+            usage(1);
+        {
+            char *policy = strchr(arg, ':');
+            if (policy)
+                *policy++ = '\0';
+            cfg->output_queue_size = atouint32_metric(arg, "-O: ");
+            if (!cfg->output_queue_size) {
+                fprintf(stderr, "-O: queue size must be at least 1\n");
+                usage(1);
+            }
+            if (!policy || !strcmp(policy, "block")) {
+                cfg->output_queue_policy = OUTPUT_QUEUE_BLOCK;
+            }
+            else if (!strcmp(policy, "oldest")) {
+                cfg->output_queue_policy = OUTPUT_QUEUE_DROP_OLDEST;
+            }
+            else if (!strcmp(policy, "newest")) {
+                cfg->output_queue_policy = OUTPUT_QUEUE_DROP_NEWEST;
+            }
+            else {
+                fprintf(stderr, "-O: invalid queue policy %s\n", policy);
+                usage(1);
+            }
+        }
         break;
     case 'K':
         if (!arg)
@@ -1202,20 +2454,299 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
                 cfg->fsk_pulse_detect_mode = FSK_PULSE_DETECT_OLD;
             else if (kwargs_match(p, "minmax", &val))
                 cfg->fsk_pulse_detect_mode = FSK_PULSE_DETECT_NEW;
+            else if (kwargs_match(p, "both", &val))
+                cfg->fsk_pulse_detect_mode = FSK_PULSE_DETECT_BOTH;
             else if (kwargs_match(p, "ampest", &val))
                 cfg->demod->use_mag_est = 0;
             else if (kwargs_match(p, "verbose", &val))
                 cfg->demod->detect_verbosity++;
             else if (kwargs_match(p, "magest", &val))
                 cfg->demod->use_mag_est = 1;
+            else if (kwargs_match(p, "fmint", &val))
+                cfg->demod->demod_FM_state.mode = BASEBAND_FM_INT;
+            else if (kwargs_match(p, "fmfast", &val))
+                cfg->demod->demod_FM_state.mode = BASEBAND_FM_FAST;
+            else if (kwargs_match(p, "fmprecise", &val))
+                cfg->demod->demod_FM_state.mode = BASEBAND_FM_PRECISE;
+            else if (kwargs_match(p, "fmfull", &val))
+                cfg->demod->fm_full = atobv(val, 1);
+            else if (kwargs_match(p, "env8", &val))
+                cfg->demod->env8 = atobv(val, 1);
+            else if (kwargs_match(p, "bands", &val))
+                cfg->demod->bands = atobv(val, 1);
+            else if (kwargs_match(p, "timingskip", &val))
+                cfg->demod->timing_skip = atobv(val, 1);
+            else if (kwargs_match(p, "retry", &val))
+                cfg->retry_packages = atobv(val, 1);
             else if (kwargs_match(p, "level", &val))
                 cfg->demod->level_limit = arg_float(val, "-Y level: ");
             else if (kwargs_match(p, "minlevel", &val))
                 cfg->demod->min_level = arg_float(val, "-Y minlevel: ");
+            else if (kwargs_match(p, "levels", &val)) {
+                // fixed levels separated by colons, the kwargs are separated by commas
+                cfg->demod->extra_level_count = 0;
+                for (char const *v = val; v && cfg->demod->extra_level_count < PULSE_DETECT_EXTRA_LEVELS;) {
+                    float level = arg_float(v, "-Y levels: ");
+                    if (level >= 0.0f) {
+                        fprintf(stderr, "-Y levels: the levels need to be below 0 dB (%s)\n", v);
+                        exit(1);
+                    }
+                    cfg->demod->extra_levels[cfg->demod->extra_level_count++] = level;
+                    v = strpbrk(v, ":,");
+                    v = v && *v == ':' ? v + 1 : NULL;
+                }
+            }
             else if (kwargs_match(p, "minsnr", &val))
                 cfg->demod->min_snr = arg_float(val, "-Y minsnr: ");
             else if (kwargs_match(p, "filter", &val))
                 cfg->demod->low_pass = arg_float(val, "-Y filter: ");
+            else if (kwargs_match(p, "amfilter", &val)) {
+                char *end = NULL;
+                cfg->demod->lowpass_filter_state.order = val ? strtol(val, &end, 10) : 0;
+                if (!val || end == val || cfg->demod->lowpass_filter_state.order < 1
+                        || cfg->demod->lowpass_filter_state.order > 2 * FILTER_MAX_SECTIONS) {
+                    fprintf(stderr, "-Y amfilter: order must be 1 to %d\n", 2 * FILTER_MAX_SECTIONS);
+                    usage(1);
+                }
+                if (*end == ':')
+                    cfg->demod->lowpass_filter_state.cutoff = atouint32_metric(end + 1, "-Y amfilter: ");
+            }
+            else if (kwargs_match(p, "dedup", &val)) {
+                char *policy = val ? strchr(val, ':') : NULL;
+                if (policy)
+                    *policy++ = '\0';
+                cfg->demod->dedup_ms    = val && *val ? atouint32_metric(val, "-Y dedup: ") : 1000;
+                cfg->demod->dedup_reuse = policy && !strcasecmp(policy, "reuse");
+                if (policy && !cfg->demod->dedup_reuse && strcasecmp(policy, "drop")) {
+                    fprintf(stderr, "-Y dedup: the policy must be drop or reuse (%s)\n", policy);
+                    exit(1);
+                }
+            }
+            else if (kwargs_match(p, "eventdedup", &val))
+                cfg->event_dedup.window_ms = val ? atouint32_metric(val, "-Y eventdedup: ") : 2000;
+            else if (kwargs_match(p, "fusion", &val))
+                cfg->fusion_ms = val ? atouint32_metric(val, "-Y fusion: ") : 1000;
+            else if (kwargs_match(p, "urgent", &val)) {
+                if (!val || !*val) {
+                    fprintf(stderr, "-Y urgent: a model is needed\n");
+                    exit(1);
+                }
+                free(cfg->urgent_models);
+                cfg->urgent_models = strdup(val);
+                if (!cfg->urgent_models)
+                    FATAL_STRDUP("parse_conf_option()");
+            }
+            else if (kwargs_match(p, "adaptive", &val))
+                cfg->demod->adapt_secs = val ? atoi_time(val, "-Y adaptive: ") : 3600;
+            else if (kwargs_match(p, "budget", &val)) {
+                cfg->decode_budget = val ? atouint32_metric(val, "-Y budget: ") : 10000;
+                for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+                    r_device *r_dev    = *iter;
+                    r_dev->time_budget = cfg->decode_budget;
+                }
+            }
+            else if (kwargs_match(p, "shed", &val)) {
+                float load = val ? arg_float(val, "-Y shed: ") : 0.8f;
+                if (load <= 0.0f) {
+                    fprintf(stderr, "-Y shed: the load needs to be above 0 (%s)\n", val);
+                    exit(1);
+                }
+                load_shed_free(cfg->load_shed);
+                cfg->load_shed = load_shed_create(load);
+                if (!cfg->load_shed)
+                    FATAL_CALLOC("parse_conf_option()");
+            }
+            else if (kwargs_match(p, "iqcorrect", &val))
+                cfg->demod->iq_correct_state.enabled = atobv(val, 1);
+            else if (kwargs_match(p, "hopadapt", &val))
+                cfg->hop_adapt = atobv(val, 1);
+            else if (kwargs_match(p, "hopmin", &val))
+                cfg->hop_min_dwell = atoi_time(val, "-Y hopmin: ");
+            else if (kwargs_match(p, "hopmax", &val))
+                cfg->hop_max_dwell = atoi_time(val, "-Y hopmax: ");
+            else if (kwargs_match(p, "hopidle", &val))
+                cfg->hop_idle_ms = atouint32_metric(val ? val : "1000", "-Y hopidle: ");
+            else if (kwargs_match(p, "settle", &val))
+                cfg->settle_ms = val ? (int)atouint32_metric(val, "-Y settle: ") : DEFAULT_SETTLE_MS;
+            else if (kwargs_match(p, "watchdog", &val)) {
+                char *end = NULL;
+                cfg->watchdog_ms = val ? (unsigned)strtoul(val, &end, 10) : WATCHDOG_STALL_MS;
+                if (val && (end == val || (*end && *end != ':'))) {
+                    fprintf(stderr, "-Y watchdog: invalid time in ms \"%s\"\n", val);
+                    usage(1);
+                }
+                if (end && *end == ':')
+                    cfg->watchdog_warn_ms = atouint32_metric(end + 1, "-Y watchdog: ");
+            }
+            else if (kwargs_match(p, "threads", &val)) {
+#ifdef THREADS
+                cfg->demod->demod_threads = atobv(val, 1);
+#else
+                fprintf(stderr, "-Y threads: not supported, this build has no threads support\n");
+#endif
+            }
+            else if (kwargs_match(p, "acquire", &val)) {
+#ifdef THREADS
+                cfg->acquire_buffers = val ? atouint32_metric(val, "-Y acquire: ") : 32;
+#else
+                fprintf(stderr, "-Y acquire: not supported, this build has no threads support\n");
+#endif
+            }
+            else if (kwargs_match(p, "channelizer", &val)) {
+                char const *device = NULL;
+                if (val && !strncasecmp(val, "opencl", 6) && (!val[6] || val[6] == ':')) {
+                    cfg->channelizer_opencl = 1;
+                    device                  = val[6] ? val + 7 : NULL;
+                }
+                else if (val && !strcasecmp(val, "cpu")) {
+                    cfg->channelizer_opencl = 0;
+                }
+                else {
+                    fprintf(stderr, "-Y channelizer: expected cpu or opencl[:<platform>[.<device>]]\n");
+                    usage(1);
+                }
+                free(cfg->channelizer_device);
+                cfg->channelizer_device = NULL;
+                if (device) {
+                    cfg->channelizer_device = strdup(device);
+                    if (!cfg->channelizer_device)
+                        FATAL_STRDUP("parse_conf_option()");
+                }
+            }
+            else if (kwargs_match(p, "lowpower", &val)) {
+#ifdef THREADS
+                cfg->lowpower_ms = val ? atouint32_metric(val, "-Y lowpower: ") : 2000;
+#else
+                fprintf(stderr, "-Y lowpower: not supported, this build has no threads support\n");
+#endif
+            }
+            else if (kwargs_match(p, "pin", &val)) {
+#ifdef THREADS
+                if (!val || thread_pin_parse(val))
+                    usage(1);
+#else
+                fprintf(stderr, "-Y pin: not supported, this build has no threads support\n");
+#endif
+            }
+            else if (kwargs_match(p, "realtime", &val)) {
+#ifdef THREADS
+                thread_pin_realtime(val ? (int)atouint32_metric(val, "-Y realtime: ") : THREAD_PIN_REALTIME_PRIO);
+#else
+                fprintf(stderr, "-Y realtime: not supported, this build has no threads support\n");
+#endif
+            }
+            else if (kwargs_match(p, "spectrum", &val)) {
+                char *end = NULL;
+                cfg->spectrum_bins     = val ? strtol(val, &end, 10) : SPECTRUM_BINS;
+                cfg->spectrum_interval = 1;
+                if (val && end == val) {
+                    fprintf(stderr, "-Y spectrum: invalid bins \"%s\"\n", val);
+                    usage(1);
+                }
+                if (val && *end == ':')
+                    cfg->spectrum_interval = atouint32_metric(end + 1, "-Y spectrum: ");
+            }
+            else if (kwargs_match(p, "recorder", &val)) {
+                char *end = NULL;
+                cfg->recorder_minutes = val ? strtol(val, &end, 10) : PULSE_RECORDER_MINUTES;
+                cfg->recorder_mb      = PULSE_RECORDER_MB;
+                if (val && end == val) {
+                    fprintf(stderr, "-Y recorder: invalid minutes \"%s\"\n", val);
+                    usage(1);
+                }
+                if (val && *end == ':')
+                    cfg->recorder_mb = atouint32_metric(end + 1, "-Y recorder: ");
+            }
+            else if (kwargs_match(p, "agc", &val)) {
+                cfg->agc_headroom = val ? arg_float(val, "-Y agc: ") : AGC_HEADROOM_DB;
+            }
+            else if (kwargs_match(p, "hugepages", &val)) {
+                huge_buf_enable(atobv(val, 1));
+            }
+            else if (kwargs_match(p, "io", &val)) {
+                if (!val || !strcasecmp(val, "auto"))
+                    io_ring_set_mode(IO_RING_AUTO);
+                else if (!strcasecmp(val, "uring"))
+                    io_ring_set_mode(IO_RING_ALWAYS);
+                else if (!strcasecmp(val, "stdio"))
+                    io_ring_set_mode(IO_RING_OFF);
+                else {
+                    fprintf(stderr, "Invalid io option: %s\n", val);
+                    usage(1);
+                }
+            }
+            else if (kwargs_match(p, "decthreads", &val)) {
+#ifdef THREADS
+                cfg->demod->decoder_threads = atouint32_metric(val, "-Y decthreads: ");
+#else
+                fprintf(stderr, "-Y decthreads: not supported, this build has no threads support\n");
+#endif
+            }
+            else if (kwargs_match(p, "jobs", &val)) {
+#ifdef THREADS
+                cfg->batch_jobs = atouint32_metric(val, "-Y jobs: ");
+#else
+                fprintf(stderr, "-Y jobs: not supported, this build has no threads support\n");
+#endif
+            }
+            else if (kwargs_match(p, "chunk", &val)) {
+#ifdef THREADS
+                cfg->batch_chunk = atouint32_metric(val, "-Y chunk: ");
+#else
+                fprintf(stderr, "-Y chunk: not supported, this build has no threads support\n");
+#endif
+            }
+            else if (kwargs_match(p, "overlap", &val)) {
+                cfg->batch_overlap_ms = atouint32_metric(val, "-Y overlap: ");
+            }
+            else if (kwargs_match(p, "checkpoint", &val)) {
+                if (!val || !*val) {
+                    fprintf(stderr, "-Y checkpoint: expected <file>[:<secs>]\n");
+                    usage(1);
+                }
+                free(cfg->checkpoint_path);
+                cfg->checkpoint_path = strdup(val);
+                if (!cfg->checkpoint_path)
+                    FATAL_STRDUP("parse_conf_option()");
+                // a trailing number is the interval, a path may contain colons too
+                char *secs = strrchr(cfg->checkpoint_path, ':');
+                cfg->checkpoint_secs = 0;
+                if (secs && secs[1] && strspn(secs + 1, "0123456789") == strlen(secs + 1)) {
+                    *secs++              = '\0';
+                    cfg->checkpoint_secs = atouint32_metric(secs, "-Y checkpoint: ");
+                }
+            }
+            else if (kwargs_match(p, "resume", &val)) {
+                cfg->checkpoint_resume = atobv(val, 1);
+            }
+            else if (kwargs_match(p, "index", &val)) {
+                cfg->dump_index = atobv(val, 1);
+            }
+            else if (kwargs_match(p, "bench", &val)) {
+                cfg->bench_passes = atouint32_metric(val ? val : "1", "-Y bench: ");
+            }
+            else if (kwargs_match(p, "suggest", &val)) {
+                cfg->signal_cluster.repeats = atouint32_metric(val ? val : "5", "-Y suggest: ");
+            }
+            else if (kwargs_match(p, "raw", &val)) {
+                if (!val || strcasecmp(val, "all") == 0)
+                    cfg->raw_mode = 1;
+                else if (strcasecmp(val, "unknown") == 0)
+                    cfg->raw_mode = 2;
+                else if (strcasecmp(val, "known") == 0)
+                    cfg->raw_mode = 3;
+                else
+                    cfg->raw_mode = atobv(val, 1);
+            }
+            else if (kwargs_match(p, "rfraw", &val)) {
+                cfg->raw_rfraw = atobv(val, 1);
+            }
+            else if (kwargs_match(p, "analyze", &val)) {
+                enable_analyzer_batch(cfg, val);
+            }
+            else if (kwargs_match(p, "coverage", &val)) {
+                cfg->coverage_report = atobv(val, 1);
+            }
             else {
                 fprintf(stderr, "Unknown pulse detector setting: %s\n", p);
                 usage(1);
@@ -1240,6 +2771,53 @@ static void parse_conf_option(r_cfg_t *cfg, int opt, char *arg)
     }
 }
 
+/// Rebuild the decoders from the config files and options, the input, demod state, and outputs are kept.
+static void reload_decoders(r_cfg_t *cfg)
+{
+    double begin = monotonic_time_us();
+
+    r_cfg_t *scratch        = r_create_cfg();
+    scratch->verbosity      = cfg->verbosity;
+    scratch->verbose_bits   = cfg->verbose_bits;
+    scratch->report_profile = cfg->report_profile;
+    scratch->decode_budget  = cfg->decode_budget;
+    scratch->reload_only    = 1;
+
+    // same as the startup in main()
+    if (!hasopt('c', cfg->argc, cfg->argv, OPTSTRING)) {
+        parse_conf_try_default_files(scratch);
+    }
+    parse_conf_args(scratch, cfg->argc, cfg->argv);
+    if (!scratch->no_default_devices) {
+        register_all_protocols(scratch, 0); // register all defaults
+    }
+
+    for (void **iter = scratch->demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        r_dev->output_ctx = cfg;
+        if (r_dev->modulation >= FSK_DEMOD_MIN_VAL)
+            cfg->demod->enable_FM_demod = 1;
+    }
+
+    // swap the decoders and the table they may point into, the old ones are freed with the scratch config
+    list_t r_devs             = cfg->demod->r_devs;
+    cfg->demod->r_devs        = scratch->demod->r_devs;
+    scratch->demod->r_devs    = r_devs;
+    struct r_device *devices  = cfg->devices;
+    cfg->devices              = scratch->devices;
+    scratch->devices          = devices;
+    cfg->no_default_devices   = scratch->no_default_devices;
+    decoder_dispatch_invalidate(cfg->demod);
+    if (cfg->second_chance)
+        second_chance_reset(cfg->second_chance, cfg);
+
+    r_free_cfg(scratch);
+    free(scratch);
+
+    fprintf(stderr, "Reloaded %zu out of %u device decoding protocols in %.1f ms\n",
+            cfg->demod->r_devs.len, cfg->num_r_devices, (monotonic_time_us() - begin) * 1e-3);
+}
+
 static r_cfg_t g_cfg;
 
 // TODO: SIGINFO is not in POSIX...
@@ -1294,9 +2872,24 @@ static void sighandler(int signum)
         return;
     }
     else if (signum == SIGUSR1) {
-        g_cfg.hop_now = 1;
+        g_cfg.hop_now  = 1;
+        g_cfg.sync_now = 1;
+        return;
+    }
+    else if (signum == SIGHUP) {
+        g_cfg.reload_now = 1;
+        return;
+    }
+    else if (signum == SIGUSR2) {
+        g_cfg.dump_pulses_now = 1;
+        return;
+    }
+#ifdef SIGRTMIN
+    else if (signum == SIGRTMIN + 1) {
+        g_cfg.profile_now = 1;
         return;
     }
+#endif
     else if (signum == SIGALRM) {
         write_err("Async read stalled, exiting!\n");
         g_cfg.exit_code = 3;
@@ -1328,6 +2921,17 @@ static void sdr_handler(sdr_event_t *ev, void *ctx)
     }
     if (ev->ev & SDR_EV_FREQ) {
         cfg->center_frequency = ev->center_frequency;
+        // the following buffers are at the new frequency, prefer the requested hop for repeated frequencies
+        int index = cfg->frequency_index;
+        if (cfg->frequency[index] != ev->center_frequency) {
+            for (index = 0; index < cfg->frequencies && cfg->frequency[index] != ev->center_frequency;)
+                index++;
+        }
+        if (index < cfg->frequencies)
+            select_hop_state(cfg, (unsigned)index);
+        if (cfg->hop_sched)
+            hop_sched_tuned(cfg->hop_sched);
+        cfg->settle_samples = (unsigned long)cfg->settle_ms * cfg->samp_rate / 1000;
         data = data_append(data,
                 "center_frequency", "", DATA_INT, ev->center_frequency,
                 "frequencies", "", DATA_COND, cfg->frequencies > 1, DATA_ARRAY, data_array(cfg->frequencies, DATA_INT, cfg->frequency),
@@ -1340,50 +2944,229 @@ static void sdr_handler(sdr_event_t *ev, void *ctx)
                 NULL);
     }
     if (data) {
+        data_print_jsons_cache(data); // serialize once for all JSON outputs
         for (size_t i = 0; i < cfg->output_handler.len; ++i) { // list might contain NULLs
             data_output_print(cfg->output_handler.elems[i], data);
         }
+        data_print_jsons_cache(NULL);
         data_free(data);
     }
 
     if (ev->ev == SDR_EV_DATA) {
-        if (cfg->mgr) {
+        if (cfg->mgr && !cfg->net_thread && (!cfg->lowpower_ms || !ev->queued)) {
             int max_polls = 16;
             while (max_polls-- && mg_mgr_poll(cfg->mgr, 0));
         }
 
-        if (!cfg->exit_async)
-            sdr_callback((unsigned char *)ev->buf, ev->len, ctx);
+        metrics_buffer_seq(cfg->metrics, &cfg->metrics->buffer_seq, ev->seq);
+        if (ev->lost) {
+            // keep the sample positions continuous over the dropped buffers
+            cfg->input_pos += ev->lost;
+            fprintf(stderr, "Lost %u samples, the SDR overflowed or processing fell behind\n", ev->lost);
+        }
+
+        struct timeval read_time = {
+                .tv_sec  = (time_t)(ev->time_us / 1000000),
+                .tv_usec = (long)(ev->time_us % 1000000),
+        };
+        if (ev->time_us) {
+            struct timeval now;
+            get_time_now(&now);
+            metrics_observe(&cfg->metrics->acquire_latency, (double)now.tv_sec * 1e6 + now.tv_usec - (double)ev->time_us);
+        }
+        // the arrival of the buffer, for the latency of the events
+        cfg->metrics->buffer_us = ev->time_us ? (double)ev->time_us : metrics_wall_time_us();
+        if (!cfg->exit_async) {
+            // the network handlers wait while the buffer is decoded
+            net_thread_lock(cfg->net_thread);
+            cfg->iq_ref = ev->iq; // the raw outputs and dumpers retain it instead of copying
+            sdr_callback((unsigned char *)ev->buf, ev->len, ctx, ev->time_us ? &read_time : NULL);
+            cfg->iq_ref = NULL;
+            net_thread_unlock(cfg->net_thread);
+        }
     }
+    if (cfg->lowpower_ms && !ev->queued)
+        net_thread_flush(cfg->net_thread); // the end of a burst
 
     if (cfg->exit_async)
         sdr_stop(cfg->dev);
 }
 
+/// Demodulate a buffer of an additional SDR device and decode with the shared decoders.
+static void sdr_input_handler(sdr_event_t *ev, void *ctx)
+{
+    sdr_input_t *input     = ctx;
+    r_cfg_t *cfg           = input->cfg;
+    struct dm_state *demod = input->demod;
+
+    if (ev->ev & SDR_EV_RATE)
+        input->samp_rate = ev->sample_rate;
+    if (ev->ev & SDR_EV_FREQ)
+        input->center_frequency = ev->center_frequency;
+
+    if (ev->ev == SDR_EV_DATA && !cfg->exit_async) {
+        metrics_buffer_seq(cfg->metrics, &input->buffer_seq, ev->seq);
+        if (ev->lost) {
+            // keep the sample positions continuous over the dropped buffers
+            input->input_pos += ev->lost;
+            fprintf(stderr, "Lost %u samples from device %s, the SDR overflowed or processing fell behind\n", ev->lost, input->dev_query);
+        }
+
+        time_t last_frame_sec = demod->now.tv_sec;
+        demod->now.tv_sec     = (time_t)(ev->time_us / 1000000);
+        demod->now.tv_usec    = (long)(ev->time_us % 1000000);
+        struct timeval now;
+        get_time_now(&now);
+        metrics_observe(&cfg->metrics->acquire_latency, (double)now.tv_sec * 1e6 + now.tv_usec - (double)ev->time_us);
+
+        unsigned long n_samples = ev->len / demod->sample_size;
+        if (n_samples) {
+            net_thread_lock(cfg->net_thread);
+            // the output helpers use the cfg demod state, sample rate, center frequency, and input position
+            struct dm_state *main_demod = cfg->demod;
+            uint32_t samp_rate          = cfg->samp_rate;
+            uint32_t center_frequency   = cfg->center_frequency;
+            uint64_t input_pos          = cfg->input_pos;
+            cfg->demod                  = demod;
+            cfg->samp_rate              = input->samp_rate;
+            cfg->center_frequency       = input->center_frequency;
+            cfg->input_pos              = input->input_pos;
+
+            double wall_us          = cfg->trace ? metrics_wall_time_us() : 0.0;
+            double begin            = monotonic_time_us();
+            cfg->metrics->buffer_us = (double)ev->time_us;
+            int d_events = demod_buffer(cfg, demod, main_demod, (unsigned char *)ev->buf, ev->len, n_samples, input->frequency, last_frame_sec, &demod->clip);
+            metrics_end_buffer(cfg->metrics, begin, n_samples, d_events > 0);
+            shed_load(cfg, monotonic_time_us() - begin, n_samples, input->samp_rate);
+            if (cfg->trace)
+                trace_event_complete(cfg->trace, "buffer", TRACE_BUFFERS, wall_us, metrics_wall_time_us() - wall_us, "samples", n_samples);
+
+            cfg->demod            = main_demod;
+            cfg->samp_rate        = samp_rate;
+            cfg->center_frequency = center_frequency;
+            cfg->input_pos        = input_pos;
+            net_thread_unlock(cfg->net_thread);
+            input->input_pos += n_samples;
+
+            if (cfg->after_successful_events_flag == 1 && d_events > 0)
+                cfg->exit_async = 1;
+        }
+    }
+    if (cfg->lowpower_ms && !ev->queued)
+        net_thread_flush(cfg->net_thread); // the end of a burst
+
+    if (cfg->exit_async)
+        sdr_stop(cfg->dev);
+}
+
+/// Open all additional SDR devices, the other channels of a device are added right after the device.
+static int open_sdr_inputs(r_cfg_t *cfg)
+{
+    sdr_dev_t *dev        = cfg->dev;
+    char const *dev_query = cfg->dev_query;
+    size_t next           = 0;
+    for (;;) {
+        unsigned channel_num = sdr_get_channel_num(dev);
+        for (unsigned c = 1; c < channel_num; ++c) {
+            sdr_input_t *input = insert_sdr_input(cfg, next++, dev_query);
+            if (sdr_open_channel(&input->dev, dev, c) < 0)
+                return -1;
+        }
+        if (next >= cfg->sdr_inputs.len)
+            return 0;
+        sdr_input_t *input = cfg->sdr_inputs.elems[next++];
+        int r = sdr_open(&input->dev, input->dev_query, cfg->verbosity);
+        if (r < 0)
+            return r;
+        dev       = input->dev;
+        dev_query = input->dev_query;
+    }
+}
+
+/// Process the buffers of the acquisition ring in bursts, gated by the noise level, and coalesce the network wakes.
+static void setup_lowpower(r_cfg_t *cfg)
+{
+    // the ring holds twice the buffers of the delay, the burst is handed over early at half full
+    uint32_t buf_len   = cfg->out_block_size ? cfg->out_block_size : SDR_DEFAULT_BUF_LENGTH;
+    double delay_bytes = (double)cfg->lowpower_ms * cfg->samp_rate * 4 / 1000; // up to CS16
+    unsigned ring_num  = (unsigned)(2 * delay_bytes / buf_len) + 2;
+    unsigned acquire   = cfg->sdr_inputs.len && !cfg->acquire_buffers ? 32 : cfg->acquire_buffers;
+    if (ring_num < acquire)
+        ring_num = acquire;
+    if (sdr_set_acquire(cfg->dev, ring_num) < 0 || sdr_set_batch(cfg->dev, cfg->lowpower_ms) < 0) {
+        fprintf(stderr, "-Y lowpower: not supported with this device, processing each buffer\n");
+        cfg->lowpower_ms = 0;
+        return;
+    }
+    if (cfg->demod->squelch_offset <= 0)
+        cfg->demod->squelch_offset = 1; // skip the silent buffers
+    net_thread_coalesce(cfg->net_thread, cfg->lowpower_ms);
+    // a burst is a long callback interval, not a stall
+    if (cfg->watchdog_ms)
+        cfg->watchdog_ms += cfg->lowpower_ms;
+    if (cfg->watchdog_warn_ms)
+        cfg->watchdog_warn_ms += cfg->lowpower_ms;
+    if (cfg->verbosity)
+        fprintf(stderr, "Low power: bursts at most %u ms late, ring of %u buffers\n", cfg->lowpower_ms, ring_num);
+}
+
+/// Set up an additional SDR device with the settings of the first device and read it into the acquisition ring.
+static int setup_sdr_input(r_cfg_t *cfg, sdr_input_t *input)
+{
+    input->dev_info           = sdr_get_dev_info(input->dev);
+    input->demod->sample_size = sdr_get_sample_size(input->dev);
+    input->demod->kernels     = baseband_get_kernels(0, input->demod->sample_size);
+    if (!input->demod->kernels) {
+        fprintf(stderr, "Unsupported sample size %d from SDR\n", input->demod->sample_size);
+        return -1;
+    }
+
+    sdr_set_sample_rate(input->dev, cfg->samp_rate, 1); // always verbose
+    sdr_apply_settings(input->dev, cfg->settings_str, 1); // always verbose for soapy
+    sdr_set_tuner_gain(input->dev, cfg->gain_str, 1); // always verbose
+    if (cfg->ppm_error)
+        sdr_set_freq_correction(input->dev, cfg->ppm_error, 1); // always verbose
+    if (sdr_reset(input->dev, cfg->verbosity) < 0)
+        fprintf(stderr, "WARNING: Failed to reset buffers.\n");
+    sdr_activate(input->dev);
+    sdr_set_center_freq(input->dev, input->frequency, 1); // always verbose
+    input->samp_rate        = cfg->samp_rate;
+    input->center_frequency = input->frequency;
+
+    return sdr_add_acquire(cfg->dev, input->dev, sdr_input_handler, input);
+}
+
 int main(int argc, char **argv) {
 #ifndef _WIN32
     struct sigaction sigact;
 #endif
-    FILE *in_file;
     int r = 0;
     struct dm_state *demod;
     r_cfg_t *cfg = &g_cfg;
 
+    double start_us = monotonic_time_us();
     print_version(); // always print the version info
 
     r_init_cfg(cfg);
+    cfg->start_us = start_us;
+    cfg->argc     = argc;
+    cfg->argv     = argv;
 
     setbuf(stdout, NULL);
     setbuf(stderr, NULL);
 
     demod = cfg->demod;
 
+    double config_begin = monotonic_time_us();
     // if there is no explicit conf file option look for default conf files
     if (!hasopt('c', argc, argv, OPTSTRING)) {
         parse_conf_try_default_files(cfg);
     }
 
     parse_conf_args(cfg, argc, argv);
+    cfg->config_us = monotonic_time_us() - config_begin;
+    // the processing thread, the threads started from here on inherit its CPUs
+    thread_pin_self(THREAD_DEMOD);
     // apply hop defaults and set first frequency
     if (cfg->frequencies == 0) {
         cfg->frequency[0] = DEFAULT_FREQUENCY;
@@ -1393,6 +3176,28 @@ int main(int argc, char **argv) {
     if (cfg->frequencies > 1 && cfg->hop_times == 0) {
         cfg->hop_time[cfg->hop_times++] = DEFAULT_HOP_TIME;
     }
+    if (cfg->settle_ms < 0) {
+        cfg->settle_ms = cfg->frequencies > 1 ? DEFAULT_SETTLE_MS : 0;
+    }
+    if (cfg->frequencies > 1) {
+        cfg->hop_sched = hop_sched_create(cfg->frequencies, cfg->hop_time, cfg->hop_times);
+        if (!cfg->hop_sched)
+            exit(1);
+        cfg->hop_sched->adapt     = cfg->hop_adapt;
+        cfg->hop_sched->min_dwell = cfg->hop_min_dwell;
+        cfg->hop_sched->max_dwell = cfg->hop_max_dwell;
+        cfg->hop_sched->idle_ms   = cfg->hop_idle_ms;
+    }
+    if (cfg->spectrum_bins) {
+        cfg->spectrum = spectrum_create(cfg->spectrum_bins, cfg->spectrum_interval, cfg->frequencies);
+        if (!cfg->spectrum)
+            exit(1);
+    }
+    if (cfg->recorder_minutes && cfg->recorder_mb) {
+        cfg->pulse_recorder = pulse_recorder_create(cfg->recorder_minutes, (size_t)cfg->recorder_mb * 1024 * 1024);
+        if (!cfg->pulse_recorder)
+            exit(1);
+    }
     // save sample rate, this should be a hop config too
     uint32_t sample_rate_0 = cfg->samp_rate;
 
@@ -1401,7 +3206,19 @@ int main(int argc, char **argv) {
         add_infile(cfg, argv[optind++]);
     }
 
+    start_decimator(cfg);
+
     pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, demod->level_limit, demod->min_level, demod->min_snr, demod->detect_verbosity);
+    pulse_detect_set_fsk_alt(demod->pulse_detect, cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_BOTH);
+    if (pulse_detect_set_extra_levels(demod->pulse_detect, demod->extra_levels, demod->extra_level_count))
+        FATAL_CALLOC("main()");
+    start_hop_states(cfg);
+    if (demod->decoder_threads > 1) {
+        demod->decoder_pool = decoder_pool_create(demod->decoder_threads - 1); // this thread also decodes
+    }
+    if (demod->demod_threads) {
+        demod->demod_pool = decoder_pool_create(1); // this thread demodulates AM
+    }
 
     if (demod->am_analyze) {
         demod->am_analyze->level_limit = DB_TO_AMP(demod->level_limit);
@@ -1414,6 +3231,19 @@ int main(int argc, char **argv) {
         demod->samp_grab->frequency   = &cfg->center_frequency;
         demod->samp_grab->samp_rate   = &cfg->samp_rate;
         demod->samp_grab->sample_size = &demod->sample_size;
+        demod->samp_grab->now         = cfg->in_files.len ? NULL : &demod->now; // no wall time for file inputs
+        samp_grab_start_writer(demod->samp_grab); // file writes must not stall the demodulation
+    }
+
+    if (cfg->fusion_ms) {
+        cfg->event_fusion = event_fusion_create(cfg->fusion_ms);
+        if (!cfg->event_fusion)
+            exit(1);
+    }
+
+    if (demod->sample_dump) {
+        demod->sample_dump->dump_index = cfg->dump_index;
+        sample_dump_start_writer(demod->sample_dump); // slow storage must not stall the demodulation
     }
 
     if (cfg->report_time == REPORT_TIME_DEFAULT) {
@@ -1433,23 +3263,18 @@ int main(int argc, char **argv) {
 #endif
     }
 
-    if (!cfg->output_handler.len) {
+    if (!cfg->output_handler.len && !cfg->bench_passes && !cfg->coverage_report) {
         add_kv_output(cfg, NULL);
     }
 
-    // register default decoders if nothing is configured
+    // register default decoders if nothing is configured, the coverage report also tries the disabled ones
     if (!cfg->no_default_devices) {
-        register_all_protocols(cfg, 0); // register all defaults
+        double register_begin = monotonic_time_us();
+        register_all_protocols(cfg, cfg->coverage_report ? 2 : 0); // register all defaults
+        cfg->register_us = monotonic_time_us() - register_begin;
     }
 
-    // check if we need FM demod
-    for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
-        r_device *r_dev = *iter;
-        if (r_dev->modulation >= FSK_DEMOD_MIN_VAL) {
-          demod->enable_FM_demod = 1;
-          break;
-        }
-    }
+    start_channels(cfg);
 
     {
         char decoders_str[1024];
@@ -1482,6 +3307,9 @@ int main(int argc, char **argv) {
     start_outputs(cfg, well_known);
     free((void *)well_known);
 
+    if (cfg->retry_packages)
+        cfg->second_chance = second_chance_create(cfg);
+
     if (cfg->out_block_size < MINIMAL_BUF_LENGTH ||
             cfg->out_block_size > MAXIMAL_BUF_LENGTH) {
         fprintf(stderr,
@@ -1510,63 +3338,21 @@ int main(int argc, char **argv) {
             exit(1);
         }
 
-        while (fgets(line, INPUT_LINE_MAX, fp)) {
-            if (cfg->verbosity)
-                fprintf(stderr, "Processing test data \"%s\"...\n", line);
-            r = 0;
-            // test a single decoder?
-            if (*line == '[') {
-                char *e = NULL;
-                unsigned d = (unsigned)strtol(&line[1], &e, 10);
-                if (!e || *e != ']') {
-                    fprintf(stderr, "Bad protocol number %.5s.\n", line);
-                    exit(1);
-                }
-                e++;
-                r_device *r_dev = NULL;
-                for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
-                    r_device *r_dev_i = *iter;
-                    if (r_dev_i->protocol_num == d) {
-                        r_dev = r_dev_i;
-                        break;
-                    }
-                }
-                if (!r_dev) {
-                    fprintf(stderr, "Unknown protocol number %u.\n", d);
-                    exit(1);
-                }
-                if (cfg->verbosity)
-                    fprintf(stderr, "Verifying test data with device %s.\n", r_dev->name);
-                if (rfraw_check(e)) {
-                    pulse_data_t pulse_data = {0};
-                    rfraw_parse(&pulse_data, e);
-                    list_t single_dev = {0};
-                    list_push(&single_dev, r_dev);
-                    if (!pulse_data.fsk_f2_est)
-                        r += run_ook_demods(&single_dev, &pulse_data);
-                    else
-                        r += run_fsk_demods(&single_dev, &pulse_data);
-                    list_free_elems(&single_dev, NULL);
-                } else
-                r += pulse_slicer_string(e, r_dev);
-                continue;
-            }
-            // otherwise test all decoders
-            if (rfraw_check(line)) {
-                pulse_data_t pulse_data = {0};
-                rfraw_parse(&pulse_data, line);
-                if (!pulse_data.fsk_f2_est)
-                    r += run_ook_demods(&demod->r_devs, &pulse_data);
-                else
-                    r += run_fsk_demods(&demod->r_devs, &pulse_data);
-            } else
-            for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
-                r_device *r_dev = *iter;
-                if (cfg->verbosity)
-                    fprintf(stderr, "Verifying test data with device %s.\n", r_dev->name);
-                r += pulse_slicer_string(line, r_dev);
-            }
+        verify_stats_t stats = {0};
+        double verify_us     = metrics_wall_time_us();
+        unsigned threads     = 1;
+#ifdef THREADS
+        if (cfg->batch_jobs > 1 && verify_test_lines_batch(cfg, fp, &stats) == 0)
+            threads = cfg->batch_jobs;
+#endif
+        while (threads == 1 && fgets(line, INPUT_LINE_MAX, fp)) {
+            verify_test_line(cfg, line, &stats);
         }
+        r = stats.last;
+
+        double elapsed_s = (metrics_wall_time_us() - verify_us) * 1e-6;
+        fprintf(stderr, "Verified %u codes (%u RfRaw) on %u threads in %.3f s, %.0f codes/s, %u events\n",
+                stats.codes, stats.rfraw, threads, elapsed_s, elapsed_s > 0.0 ? stats.codes / elapsed_s : 0.0, stats.events);
 
         if (*cfg->test_data == '@') {
             fclose(fp);
@@ -1585,6 +3371,7 @@ int main(int argc, char **argv) {
                 r += run_ook_demods(&demod->r_devs, &pulse_data);
             else
                 r += run_fsk_demods(&demod->r_devs, &pulse_data);
+            pulse_data_free(&pulse_data);
         } else
         for (void **iter = demod->r_devs.elems; iter && *iter; ++iter) {
             r_device *r_dev = *iter;
@@ -1598,10 +3385,12 @@ int main(int argc, char **argv) {
 
     // Special case for in files
     if (cfg->in_files.len) {
-        unsigned char *test_mode_buf = malloc(DEFAULT_BUF_LENGTH * sizeof(unsigned char));
+        // regular files are mapped, the blocks are only copied to be converted or if read from a pipe
+        uint32_t block_size = cfg->out_block_size;
+        unsigned char *test_mode_buf = malloc(block_size * sizeof(unsigned char));
         if (!test_mode_buf)
             FATAL_MALLOC("test_mode_buf");
-        float *test_mode_float_buf = malloc(DEFAULT_BUF_LENGTH / sizeof(int16_t) * sizeof(float));
+        float *test_mode_float_buf = malloc(block_size / sizeof(int16_t) * sizeof(float));
         if (!test_mode_float_buf)
             FATAL_MALLOC("test_mode_float_buf");
 
@@ -1610,150 +3399,39 @@ int main(int argc, char **argv) {
             cfg->stop_time += cfg->duration;
         }
 
-        for (void **iter = cfg->in_files.elems; iter && *iter; ++iter) {
-            cfg->in_filename = *iter;
-
-            file_info_clear(&demod->load_info); // reset all info
-            file_info_parse_filename(&demod->load_info, cfg->in_filename);
-            // apply file info or default
-            cfg->samp_rate        = demod->load_info.sample_rate ? demod->load_info.sample_rate : sample_rate_0;
-            cfg->center_frequency = demod->load_info.center_frequency ? demod->load_info.center_frequency : cfg->frequency[0];
-
-            if (strcmp(demod->load_info.path, "-") == 0) { // read samples from stdin
-                in_file = stdin;
-                cfg->in_filename = "<stdin>";
-            } else {
-                in_file = fopen(demod->load_info.path, "rb");
-                if (!in_file) {
-                    fprintf(stderr, "Opening file: %s failed!\n", cfg->in_filename);
-                    break;
-                }
-            }
-            fprintf(stderr, "Test mode active. Reading samples from file: %s\n", cfg->in_filename);  // Essential information (not quiet)
-            if (demod->load_info.format == CU8_IQ
-                    || demod->load_info.format == CS8_IQ
-                    || demod->load_info.format == S16_AM
-                    || demod->load_info.format == S16_FM) {
-                demod->sample_size = sizeof(uint8_t) * 2; // CU8, AM, FM
-            } else if (demod->load_info.format == CS16_IQ
-                    || demod->load_info.format == CF32_IQ) {
-                demod->sample_size = sizeof(int16_t) * 2; // CS16, CF32 (after conversion)
-            } else if (demod->load_info.format == PULSE_OOK) {
-                // ignore
-            } else {
-                fprintf(stderr, "Input format invalid: %s\n", file_info_string(&demod->load_info));
+        int batched = 0;
+        if (cfg->coverage_report)
+            batched = coverage_sample_files(cfg, sample_rate_0, block_size, test_mode_buf, test_mode_float_buf) == 0;
+        else if (cfg->bench_passes)
+            batched = bench_sample_files(cfg, sample_rate_0, block_size, test_mode_buf, test_mode_float_buf) == 0;
+#ifdef THREADS
+        if (!batched && cfg->batch_jobs > 1 && (cfg->in_files.len > 1 || cfg->batch_chunk) && batch_supported(cfg))
+            batched = read_sample_files_batch(cfg, sample_rate_0, block_size) == 0;
+#endif
+        unsigned first_file   = 0;
+        uint64_t first_sample = 0;
+        if (!batched && cfg->checkpoint_path && cfg->event_fusion) {
+            fprintf(stderr, "-Y checkpoint: not available with -Y fusion, the held events would be lost.\n");
+        }
+        else if (!batched && cfg->checkpoint_path) {
+            if (cfg->checkpoint_resume && resume_checkpoint(cfg, &first_file, &first_sample) < 0)
+                exit(1);
+            cfg->checkpoint_reading = 1;
+        }
+        for (unsigned i = first_file; !batched && i < cfg->in_files.len; ++i) {
+            cfg->checkpoint_index = i;
+            if (read_sample_file(cfg, cfg->in_files.elems[i], sample_rate_0, block_size, i == first_file ? first_sample : 0, 0, test_mode_buf, test_mode_float_buf) < 0)
                 break;
-            }
-            if (cfg->verbosity) {
-                fprintf(stderr, "Input format: %s\n", file_info_string(&demod->load_info));
-            }
-            demod->sample_file_pos = 0.0;
-
-            // special case for pulse data file-inputs
-            if (demod->load_info.format == PULSE_OOK) {
-                while (!cfg->exit_async) {
-                    pulse_data_load(in_file, &demod->pulse_data, cfg->samp_rate);
-                    if (!demod->pulse_data.num_pulses)
-                        break;
-
-                    for (void **iter2 = demod->dumper.elems; iter2 && *iter2; ++iter2) {
-                        file_info_t const *dumper = *iter2;
-                        if (dumper->format == VCD_LOGIC) {
-                            pulse_data_print_vcd(dumper->file, &demod->pulse_data, '\'');
-                        } else if (dumper->format == PULSE_OOK) {
-                            pulse_data_dump(dumper->file, &demod->pulse_data);
-                        } else {
-                            fprintf(stderr, "Dumper (%s) not supported on OOK input\n", dumper->spec);
-                            exit(1);
-                        }
-                    }
-
-                    if (demod->pulse_data.fsk_f2_est) {
-                        run_fsk_demods(&demod->r_devs, &demod->pulse_data);
-                    }
-                    else {
-                        int p_events = run_ook_demods(&demod->r_devs, &demod->pulse_data);
-                        if (cfg->verbosity > 2)
-                            pulse_data_print(&demod->pulse_data);
-                        if (demod->analyze_pulses && (cfg->grab_mode <= 1 || (cfg->grab_mode == 2 && p_events == 0) || (cfg->grab_mode == 3 && p_events > 0))) {
-                            pulse_analyzer(&demod->pulse_data, PULSE_DATA_OOK);
-                        }
-                    }
-                }
-
-                if (in_file != stdin)
-                    fclose(in_file = stdin);
-
-                continue;
-            }
-
-            // default case for file-inputs
-            int n_blocks = 0;
-            unsigned long n_read;
-            delay_timer_t delay_timer;
-            delay_timer_init(&delay_timer);
-            do {
-                // Replay in realtime if requested
-                if (cfg->in_replay) {
-                    // per block delay
-                    unsigned delay_us = (unsigned)(1000000llu * DEFAULT_BUF_LENGTH / cfg->samp_rate / demod->sample_size / cfg->in_replay);
-                    if (demod->load_info.format == CF32_IQ)
-                        delay_us /= 2; // adjust for float only reading half as many samples
-                    delay_timer_wait(&delay_timer, delay_us);
-                }
-                // Convert CF32 file to CS16 buffer
-                if (demod->load_info.format == CF32_IQ) {
-                    n_read = fread(test_mode_float_buf, sizeof(float), DEFAULT_BUF_LENGTH / 2, in_file);
-                    // clamp float to [-1,1] and scale to Q0.15
-                    for (unsigned long n = 0; n < n_read; n++) {
-                        int s_tmp = test_mode_float_buf[n] * INT16_MAX;
-                        if (s_tmp < -INT16_MAX)
-                            s_tmp = -INT16_MAX;
-                        else if (s_tmp > INT16_MAX)
-                            s_tmp = INT16_MAX;
-                        ((int16_t *)test_mode_buf)[n] = s_tmp;
-                    }
-                    n_read *= 2; // convert to byte count
-                } else {
-                    n_read = fread(test_mode_buf, 1, DEFAULT_BUF_LENGTH, in_file);
-
-                    // Convert CS8 file to CU8 buffer
-                    if (demod->load_info.format == CS8_IQ) {
-                        for (unsigned long n = 0; n < n_read; n++) {
-                            test_mode_buf[n] = ((int8_t)test_mode_buf[n]) + 128;
-                        }
-                    }
-                }
-                if (n_read == 0) break;  // sdr_callback() will Segmentation Fault with len=0
-                demod->sample_file_pos = ((float)n_blocks * DEFAULT_BUF_LENGTH + n_read) / cfg->samp_rate / demod->sample_size;
-                n_blocks++; // this assumes n_read == DEFAULT_BUF_LENGTH
-                sdr_callback(test_mode_buf, n_read, cfg);
-            } while (n_read != 0 && !cfg->exit_async);
-
-            // Call a last time with cleared samples to ensure EOP detection
-            if (demod->sample_size == 2) { // CU8
-                memset(test_mode_buf, 128, DEFAULT_BUF_LENGTH); // 128 is 0 in unsigned data
-                // or is 127.5 a better 0 in cu8 data?
-                //for (unsigned long n = 0; n < DEFAULT_BUF_LENGTH/2; n++)
-                //    ((uint16_t *)test_mode_buf)[n] = 0x807f;
-            }
-            else { // CF32, CS16
-                    memset(test_mode_buf, 0, DEFAULT_BUF_LENGTH);
-            }
-            demod->sample_file_pos = ((float)n_blocks + 1) * DEFAULT_BUF_LENGTH / cfg->samp_rate / demod->sample_size;
-            sdr_callback(test_mode_buf, DEFAULT_BUF_LENGTH, cfg);
-            alarm(0); // cancel the watchdog timer
-
-            //Always classify a signal at the end of the file
-            if (demod->am_analyze)
-                am_analyze_classify(demod->am_analyze);
-            if (cfg->verbosity) {
-                fprintf(stderr, "Test mode file issued %d packets\n", n_blocks);
-            }
-
-            if (in_file != stdin)
-                fclose(in_file = stdin);
+            if (cfg->exit_async)
+                break;
+            // the file is done, continue with the next one
+            cfg->checkpoint_index = i + 1;
+            write_checkpoint(cfg, 0, 1);
         }
+        cfg->checkpoint_reading = 0;
+        second_chance_free(cfg->second_chance, cfg);
+        cfg->second_chance = NULL;
+        flush_fused_events(cfg, 1);
 
         close_dumpers(cfg);
         free(test_mode_buf);
@@ -1762,9 +3440,30 @@ int main(int argc, char **argv) {
         exit(0);
     }
 
-    if (cfg->sr_filename) {
-        fprintf(stderr, "SR writing not recommended for live input\n");
-        exit(1);
+    // Central decoder, the packages are detected by edge receivers
+    if (cfg->pulse_input) {
+        if (cfg->duration > 0) {
+            time(&cfg->stop_time);
+            cfg->stop_time += cfg->duration;
+        }
+#ifndef _WIN32
+        signal(SIGINT, sighandler);
+        signal(SIGTERM, sighandler);
+        signal(SIGPIPE, sighandler);
+        signal(SIGINFO, sighandler);
+#else
+        SetConsoleCtrlHandler((PHANDLER_ROUTINE)console_handler, TRUE);
+#endif
+        start_net_thread(cfg);
+        r = read_pulse_input(cfg);
+        flush_fused_events(cfg, 1);
+        if (cfg->report_stats > 0) {
+            event_occurred_handler(cfg, create_report_data(cfg, cfg->report_stats));
+            flush_report_data(cfg);
+        }
+        close_dumpers(cfg);
+        r_free_cfg(cfg);
+        exit(r < 0 ? 2 : 0);
     }
 
     // Normal case, no test data, no in files
@@ -1774,7 +3473,20 @@ int main(int argc, char **argv) {
     }
     cfg->dev_info = sdr_get_dev_info(cfg->dev);
     demod->sample_size = sdr_get_sample_size(cfg->dev);
+    demod->kernels     = baseband_get_kernels(0, demod->sample_size);
+    if (!demod->kernels) {
+        fprintf(stderr, "Unsupported sample size %d from SDR\n", demod->sample_size);
+        exit(1);
+    }
     //demod->sample_signed = sdr_get_sample_signed(cfg->dev);
+    apply_buffer_profile(cfg, demod->sample_size);
+
+    // open all devices first, the other channels of a device take the next frequencies
+    r = open_sdr_inputs(cfg);
+    if (r < 0) {
+        exit(2);
+    }
+    start_sdr_inputs(cfg);
 
 #ifndef _WIN32
     sigact.sa_handler = sighandler;
@@ -1786,6 +3498,11 @@ int main(int argc, char **argv) {
     sigaction(SIGPIPE, &sigact, NULL);
     sigaction(SIGUSR1, &sigact, NULL);
     sigaction(SIGINFO, &sigact, NULL);
+    sigaction(SIGHUP, &sigact, NULL);
+    sigaction(SIGUSR2, &sigact, NULL);
+#ifdef SIGRTMIN
+    sigaction(SIGRTMIN + 1, &sigact, NULL);
+#endif
 #else
     SetConsoleCtrlHandler((PHANDLER_ROUTINE)console_handler, TRUE);
 #endif
@@ -1797,6 +3514,22 @@ int main(int argc, char **argv) {
 
     r = sdr_apply_settings(cfg->dev, cfg->settings_str, 1); // always verbose for soapy
 
+    // the gain control starts from the -g gain, or a fixed gain if that is auto
+    if (cfg->agc_headroom > 0.0f && cfg->gain_str && strchr(cfg->gain_str, '=')) {
+        fprintf(stderr, "-Y agc: not supported with the named gains of -g, the gain is not controlled\n");
+    }
+    else if (cfg->agc_headroom > 0.0f) {
+        cfg->agc = agc_create(cfg->gain_str, cfg->agc_headroom);
+        if (!cfg->agc)
+            exit(1);
+        char gain_str[16];
+        snprintf(gain_str, sizeof(gain_str), "%.1f", cfg->agc->gain);
+        free(cfg->gain_str);
+        cfg->gain_str = strdup(gain_str);
+        if (!cfg->gain_str)
+            FATAL_STRDUP("main()");
+    }
+
     /* Enable automatic gain if gain_str empty (or 0 for RTL-SDR), set manual gain otherwise */
     r = sdr_set_tuner_gain(cfg->dev, cfg->gain_str, 1); // always verbose
 
@@ -1809,6 +3542,9 @@ int main(int argc, char **argv) {
         fprintf(stderr, "WARNING: Failed to reset buffers.\n");
     r = sdr_activate(cfg->dev);
 
+    // from here on the network is polled on its own thread
+    start_net_thread(cfg);
+
     if (cfg->verbosity) {
         fprintf(stderr, "Reading samples in async mode...\n");
     }
@@ -1819,17 +3555,32 @@ int main(int argc, char **argv) {
 
     r = sdr_set_center_freq(cfg->dev, cfg->center_frequency, 1); // always verbose
 
+    // several devices are always read on acquisition threads
+    sdr_set_acquire(cfg->dev, cfg->sdr_inputs.len && !cfg->acquire_buffers ? 32 : cfg->acquire_buffers);
+    if (cfg->lowpower_ms)
+        setup_lowpower(cfg);
+    for (size_t i = 0; i < cfg->sdr_inputs.len; ++i) {
+        if (setup_sdr_input(cfg, cfg->sdr_inputs.elems[i]) < 0)
+            exit(2);
+    }
+
         time(&cfg->hop_start_time);
         signal(SIGALRM, sighandler);
-        alarm(3); // require callback to run every 3 second, abort otherwise
+        if (cfg->watchdog_ms)
+            cfg->watchdog = watchdog_create(cfg->watchdog_ms, cfg->watchdog_warn_ms, watchdog_stall, cfg);
+        watchdog_arm(cfg);
 
         r = sdr_start(cfg->dev, sdr_handler, (void *)cfg,
-                DEFAULT_ASYNC_BUF_NUMBER, cfg->out_block_size);
+                cfg->async_buf_number, cfg->out_block_size);
         if (r < 0) {
             fprintf(stderr, "WARNING: async read failed (%i).\n", r);
         }
+        report_buffer_latency(cfg);
 
-        alarm(0); // cancel the watchdog timer
+        watchdog_cancel(cfg);
+    second_chance_free(cfg->second_chance, cfg);
+    cfg->second_chance = NULL;
+    flush_fused_events(cfg, 1);
 
     if (cfg->report_stats > 0) {
         event_occurred_handler(cfg, create_report_data(cfg, cfg->report_stats));
@@ -3,6 +3,11 @@
 
     Copyright (C) 2018 Christian Zuckschwerdt
 
+    With a writer thread the grabbed region of the ring is copied to a pooled
+    buffer and queued, the file is named, written and closed on the thread.
+    The queue is bounded and never blocks the demodulation, a grab is dropped
+    if the queue is full.
+
     This program is free software; you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
     the Free Software Foundation; either version 2 of the License, or
@@ -12,6 +17,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 
 #ifdef _WIN32
 #include <io.h>
@@ -23,10 +29,92 @@
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 #include "samp_grab.h"
+#include "sample_index.h"
+#include "huge_buf.h"
+#include "thread_pin.h"
+#include "compat_pthread.h"
 #include "fatal.h"
 
+/// A grabbed region with the input settings at the time of the grab.
+typedef struct grab_job {
+    char *buf;         ///< the copied samples, pooled
+    unsigned buf_size; ///< capacity of the buffer
+    unsigned len;      ///< bytes in the buffer
+    unsigned samples;  ///< the requested grab length in samples
+    uint32_t frequency;
+    uint32_t samp_rate;
+    int sample_size;
+    struct timeval time; ///< wall time of the start of the grab
+    char name[64];       ///< the file name of a snippet, empty for a grab
+} grab_job_t;
+
+/// All grabs appended to a container file, only used by the writer.
+struct samp_grab_container {
+    char *prefix;
+    unsigned long max_size;
+    unsigned counter;
+    FILE *file;
+    sample_index_t *index;
+    unsigned long size; ///< bytes written to the current file
+    uint32_t frequency;
+    uint32_t samp_rate;
+    int sample_size;
+};
+
+/// Map the ring twice in a row, a region starting in the ring can then be used without wrapping.
+static char *mirror_map(unsigned size, int huge)
+{
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    size_t align = 0;
+    int fd       = -1;
+#ifdef MFD_HUGETLB
+    // the huge pages need a ring of whole pages, mapped at a page boundary
+    size_t page_size = huge ? huge_buf_page_size() : 0;
+    if (page_size && size % page_size == 0) {
+        fd    = memfd_create("samp_grab", MFD_CLOEXEC | MFD_HUGETLB);
+        align = fd < 0 ? 0 : page_size;
+    }
+#else
+    (void)huge;
+#endif
+    if (fd < 0)
+        fd = memfd_create("samp_grab", MFD_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    char *base = NULL;
+    if (ftruncate(fd, size) == 0) {
+        size_t len = 2 * (size_t)size + align;
+        char *map  = mmap(NULL, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map != MAP_FAILED) {
+            base = align ? (char *)(((uintptr_t)map + align - 1) / align * align) : map;
+            // keep only the mirror of the reserved range
+            if (base > map)
+                munmap(map, base - map);
+            if (map + len > base + 2 * (size_t)size)
+                munmap(base + 2 * (size_t)size, map + len - (base + 2 * (size_t)size));
+        }
+        if (base && (mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+                || mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+            munmap(base, 2 * (size_t)size);
+            base = NULL;
+        }
+    }
+    close(fd);
+    if (!base && align)
+        return mirror_map(size, 0); // no huge pages reserved
+    return base;
+#else
+    (void)size;
+    (void)huge;
+    return NULL;
+#endif
+}
+
 samp_grab_t *samp_grab_create(unsigned size)
 {
     samp_grab_t *g;
@@ -36,10 +124,19 @@ samp_grab_t *samp_grab_create(unsigned size)
         return NULL; // NOTE: returns NULL on alloc failure.
     }
 
-    g->sg_size = size;
+    // round up to a power of two, this is also a multiple of the page size
+    unsigned pow2 = 65536;
+    while (pow2 < size)
+        pow2 <<= 1;
+    g->sg_size = pow2;
     g->sg_counter = 1;
 
-    g->sg_buf = malloc(size);
+    g->sg_buf = mirror_map(g->sg_size, huge_buf_enabled());
+    if (g->sg_buf) {
+        g->sg_mirror = 1;
+        return g;
+    }
+    g->sg_buf = huge_buf_create(g->sg_size);
     if (!g->sg_buf) {
         WARN_MALLOC("samp_grab_create()");
         free(g);
@@ -49,10 +146,314 @@ samp_grab_t *samp_grab_create(unsigned size)
     return g;
 }
 
+void samp_grab_set_container(samp_grab_t *g, char const *prefix, unsigned long max_size)
+{
+    struct samp_grab_container *c = calloc(1, sizeof(*c));
+    if (!c)
+        FATAL_CALLOC("samp_grab_set_container()");
+    c->prefix = strdup(prefix);
+    if (!c->prefix)
+        FATAL_STRDUP("samp_grab_set_container()");
+    c->max_size = max_size;
+    c->counter  = 1;
+    g->container = c;
+}
+
+static void container_close(struct samp_grab_container *c)
+{
+    if (c->file)
+        fclose(c->file);
+    sample_index_free(c->index);
+    c->file  = NULL;
+    c->index = NULL;
+    c->size  = 0;
+}
+
+/// Sum of the sample powers relative to full scale, adds the number of samples to n.
+static double grab_power(unsigned char const *buf, unsigned len, int sample_size, unsigned *n)
+{
+    double sum = 0.0;
+    if (sample_size == 2) {
+        for (unsigned i = 0; i < len; ++i) {
+            double v = buf[i] - 127.5;
+            sum += v * v;
+        }
+        *n += len / 2;
+        return sum / (127.5 * 127.5);
+    }
+    if (sample_size == 4) {
+        for (unsigned i = 0; i + 1 < len; i += 2) {
+            double v = (int16_t)(buf[i] | buf[i + 1] << 8);
+            sum += v * v;
+        }
+        *n += len / 4;
+        return sum / (32768.0 * 32768.0);
+    }
+    return 0.0;
+}
+
+/// Write a grab in up to two parts of the ring, on the writer thread if there is one.
+static void grab_write_file(samp_grab_t *g, grab_job_t const *job, char const *part1, unsigned len1, char const *part2, unsigned len2)
+{
+    char f_name[256] = {0};
+    FILE *fp;
+
+    char *format = job->sample_size == 2 ? "cu8" : "cs16";
+    double freq_mhz = job->frequency / 1000000.0;
+    double rate_khz = job->samp_rate / 1000.0;
+
+    if (job->name[0]) {
+        // a snippet is named when queued, the event already references it
+        fp = fopen(job->name, "wb");
+        if (!fp) {
+            fprintf(stderr, "Failed to open %s\n", job->name);
+            return;
+        }
+        fwrite(part1, 1, len1, fp);
+        if (len2)
+            fwrite(part2, 1, len2, fp);
+        fclose(fp);
+        return;
+    }
+
+    struct samp_grab_container *c = g->container;
+    if (c && c->file && (c->frequency != job->frequency || c->samp_rate != job->samp_rate || c->sample_size != job->sample_size
+            || (c->max_size && c->size + len1 + len2 > c->max_size))) {
+        container_close(c);
+    }
+    if (c && !c->file) {
+        while (1) {
+            snprintf(f_name, sizeof(f_name), "%s%03u_%gM_%gk.%s", c->prefix, c->counter, freq_mhz, rate_khz, format);
+            c->counter++;
+            if (access(f_name, F_OK) == -1) {
+                break;
+            }
+        }
+        c->file = fopen(f_name, "wb");
+        if (!c->file) {
+            fprintf(stderr, "Failed to open %s\n", f_name);
+            return;
+        }
+        c->index       = sample_index_create(f_name, job->samp_rate, job->frequency);
+        c->frequency   = job->frequency;
+        c->samp_rate   = job->samp_rate;
+        c->sample_size = job->sample_size;
+        fprintf(stderr, "*** Saving signals to container %s\n", f_name);
+    }
+    if (c) {
+        fwrite(part1, 1, len1, c->file);
+        if (len2)
+            fwrite(part2, 1, len2, c->file);
+        fflush(c->file);
+        c->size += len1 + len2;
+        if (c->index) {
+            // the average level of the grab in dB full scale
+            unsigned n = 0;
+            double sum = grab_power((unsigned char const *)part1, len1, job->sample_size, &n)
+                    + grab_power((unsigned char const *)part2, len2, job->sample_size, &n);
+            float level = n && sum > 0.0 ? (float)(10.0 * log10(sum / n)) : -99.0f;
+            sample_index_add(c->index, (len1 + len2) / job->sample_size, &job->time, level);
+        }
+        return;
+    }
+
+    while (1) {
+        snprintf(f_name, sizeof(f_name), "g%03u_%gM_%gk.%s", g->sg_counter, freq_mhz, rate_khz, format);
+        g->sg_counter++;
+        if (access(f_name, F_OK) == -1) {
+            break;
+        }
+    }
+
+    fprintf(stderr, "*** Saving signal to file %s (%u samples, %u bytes)\n", f_name, job->samples, len1 + len2);
+    fp = fopen(f_name, "wb");
+    if (!fp) {
+        fprintf(stderr, "Failed to open %s\n", f_name);
+        return;
+    }
+
+    //fprintf(stderr, "*** Writing data len %d\n", len1);
+    fwrite(part1, 1, len1, fp);
+
+    if (len2) {
+        //fprintf(stderr, "*** Writing data len %d\n", len2);
+        fwrite(part2, 1, len2, fp);
+    }
+
+    fclose(fp);
+}
+
+#ifdef THREADS
+
+struct samp_grab_writer {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond; ///< signals a queued grab or the exit
+    int exit;
+    unsigned first;           ///< the grab being written or next to write
+    unsigned len;             ///< grabs queued, including the one being written
+    grab_job_t jobs[SAMP_GRAB_QUEUE_SIZE];
+};
+
+static THREAD_RETURN THREAD_CALL samp_grab_thread(void *arg)
+{
+    samp_grab_t *g             = arg;
+    struct samp_grab_writer *w = g->writer;
+    thread_pin_self(THREAD_OUTPUT);
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->len && !w->exit) {
+            pthread_cond_wait(&w->work_cond, &w->lock);
+        }
+        if (!w->len)
+            break; // exit with all grabs written
+        grab_job_t *job = &w->jobs[w->first];
+        pthread_mutex_unlock(&w->lock);
+
+        grab_write_file(g, job, job->buf, job->len, NULL, 0);
+
+        pthread_mutex_lock(&w->lock);
+        w->first = (w->first + 1) % SAMP_GRAB_QUEUE_SIZE;
+        w->len--;
+    }
+    pthread_mutex_unlock(&w->lock);
+    return (THREAD_RETURN)0;
+}
+
+void samp_grab_start_writer(samp_grab_t *g)
+{
+    if (g->writer)
+        return;
+    struct samp_grab_writer *w = calloc(1, sizeof(*w));
+    if (!w) {
+        WARN_CALLOC("samp_grab_start_writer()");
+        return; // NOTE: writes synchronously on alloc failure.
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->work_cond, NULL);
+    g->writer = w;
+    if (pthread_create(&w->thread, NULL, samp_grab_thread, g)) {
+        fprintf(stderr, "%s: failed to start thread\n", __func__);
+        pthread_cond_destroy(&w->work_cond);
+        pthread_mutex_destroy(&w->lock);
+        free(w);
+        g->writer = NULL;
+    }
+}
+
+static void samp_grab_stop_writer(samp_grab_t *g)
+{
+    struct samp_grab_writer *w = g->writer;
+    if (!w)
+        return;
+    pthread_mutex_lock(&w->lock);
+    w->exit = 1;
+    pthread_cond_signal(&w->work_cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+
+    for (unsigned i = 0; i < SAMP_GRAB_QUEUE_SIZE; ++i) {
+        free(w->jobs[i].buf);
+    }
+    pthread_cond_destroy(&w->work_cond);
+    pthread_mutex_destroy(&w->lock);
+    free(w);
+    g->writer = NULL;
+}
+
+unsigned samp_grab_queue_depth(samp_grab_t *g)
+{
+    struct samp_grab_writer *w = g->writer;
+    if (!w)
+        return 0;
+    pthread_mutex_lock(&w->lock);
+    unsigned depth = w->len;
+    pthread_mutex_unlock(&w->lock);
+    return depth;
+}
+
+/// Copy the grab to a free pooled job and queue it, returns 0 on success.
+static int samp_grab_queue(samp_grab_t *g, grab_job_t const *meta, char const *part1, unsigned len1, char const *part2, unsigned len2)
+{
+    struct samp_grab_writer *w = g->writer;
+    pthread_mutex_lock(&w->lock);
+    unsigned len  = w->len;
+    unsigned slot = (w->first + w->len) % SAMP_GRAB_QUEUE_SIZE;
+    pthread_mutex_unlock(&w->lock);
+    if (len == SAMP_GRAB_QUEUE_SIZE)
+        return -1;
+
+    // the free slots are only touched by this thread
+    grab_job_t *job = &w->jobs[slot];
+    if (job->buf_size < len1 + len2) {
+        char *buf = realloc(job->buf, len1 + len2);
+        if (!buf) {
+            WARN_REALLOC("samp_grab_queue()");
+            return -1;
+        }
+        job->buf      = buf;
+        job->buf_size = len1 + len2;
+    }
+    memcpy(job->buf, part1, len1);
+    if (len2)
+        memcpy(job->buf + len1, part2, len2);
+    job->len         = len1 + len2;
+    job->samples     = meta->samples;
+    job->frequency   = meta->frequency;
+    job->samp_rate   = meta->samp_rate;
+    job->sample_size = meta->sample_size;
+    job->time        = meta->time;
+    memcpy(job->name, meta->name, sizeof(job->name));
+
+    pthread_mutex_lock(&w->lock);
+    w->len++;
+    pthread_cond_signal(&w->work_cond);
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+#else
+
+void samp_grab_start_writer(samp_grab_t *g)
+{
+    (void)g;
+}
+
+static void samp_grab_stop_writer(samp_grab_t *g)
+{
+    (void)g;
+}
+
+unsigned samp_grab_queue_depth(samp_grab_t *g)
+{
+    (void)g;
+    return 0;
+}
+
+static int samp_grab_queue(samp_grab_t *g, grab_job_t const *meta, char const *part1, unsigned len1, char const *part2, unsigned len2)
+{
+    grab_write_file(g, meta, part1, len1, part2, len2);
+    return 0;
+}
+
+#endif
+
 void samp_grab_free(samp_grab_t *g)
 {
-    if (g->sg_buf)
-        free(g->sg_buf);
+    samp_grab_stop_writer(g);
+    if (g->drops)
+        fprintf(stderr, "Signal grabber dropped %u grabs\n", g->drops);
+    if (g->container) {
+        container_close(g->container);
+        free(g->container->prefix);
+        free(g->container);
+    }
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    if (g->sg_mirror)
+        munmap(g->sg_buf, 2 * (size_t)g->sg_size);
+    else
+#endif
+    huge_buf_free(g->sg_buf);
     free(g);
 }
 
@@ -60,24 +461,30 @@ void samp_grab_push(samp_grab_t *g, unsigned char *iq_buf, uint32_t len)
 {
     //fprintf(stderr, "sg_index %d + len %d (size %d ", g->sg_index, len, g->sg_len);
 
+    if (len > g->sg_size) {
+        // only the tail is kept
+        iq_buf += len - g->sg_size;
+        len = g->sg_size;
+    }
+
     g->sg_len += len;
     if (g->sg_len > g->sg_size)
         g->sg_len = g->sg_size;
 
     //fprintf(stderr, "-> %d)\n", g->sg_len);
 
-    while (len) {
+    unsigned mask = g->sg_size - 1;
+    if (g->sg_mirror) {
+        memcpy(&g->sg_buf[g->sg_index], iq_buf, len);
+    }
+    else {
         unsigned chunk_len = len;
         if (g->sg_index + chunk_len > g->sg_size)
             chunk_len = g->sg_size - g->sg_index;
-
         memcpy(&g->sg_buf[g->sg_index], iq_buf, chunk_len);
-        iq_buf += chunk_len;
-        len -= chunk_len;
-        g->sg_index += chunk_len;
-        if (g->sg_index >= g->sg_size)
-            g->sg_index = 0;
+        memcpy(&g->sg_buf[0], iq_buf + chunk_len, len - chunk_len);
     }
+    g->sg_index = (g->sg_index + len) & mask;
 }
 
 void samp_grab_reset(samp_grab_t *g)
@@ -86,6 +493,22 @@ void samp_grab_reset(samp_grab_t *g)
     g->sg_index = 0;
 }
 
+/// Set the input settings of a grab and the wall time of its start, start_ago samples before the end of the ring.
+static void grab_meta(samp_grab_t *g, grab_job_t *meta, unsigned grab_len, unsigned start_ago)
+{
+    memset(meta, 0, sizeof(*meta));
+    meta->samples     = grab_len;
+    meta->frequency   = *g->frequency;
+    meta->samp_rate   = *g->samp_rate;
+    meta->sample_size = *g->sample_size;
+    if (g->now && meta->samp_rate) {
+        double ago_us = (double)start_ago * 1e6 / meta->samp_rate;
+        long long us  = (long long)g->now->tv_sec * 1000000 + g->now->tv_usec - (long long)ago_us;
+        meta->time.tv_sec  = (time_t)(us / 1000000);
+        meta->time.tv_usec = (long)(us % 1000000);
+    }
+}
+
 #define BLOCK_SIZE (128 * 1024) /* bytes */
 
 void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end)
@@ -94,19 +517,6 @@ void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end)
         return;
 
     unsigned end_pos, start_pos, signal_bsize, wlen, wrest;
-    char f_name[64] = {0};
-    FILE *fp;
-
-    char *format = *g->sample_size == 2 ? "cu8" : "cs16";
-    double freq_mhz = *g->frequency / 1000000.0;
-    double rate_khz = *g->samp_rate / 1000.0;
-    while (1) {
-        sprintf(f_name, "g%03u_%gM_%gk.%s", g->sg_counter, freq_mhz, rate_khz, format);
-        g->sg_counter++;
-        if (access(f_name, F_OK) == -1) {
-            break;
-        }
-    }
 
     signal_bsize = *g->sample_size * grab_len;
     signal_bsize += BLOCK_SIZE - (signal_bsize % BLOCK_SIZE);
@@ -116,42 +526,74 @@ void samp_grab_write(samp_grab_t *g, unsigned grab_len, unsigned grab_end)
         signal_bsize = g->sg_len;
     }
 
-    // relative end in bytes from current sg_index down
-    end_pos = *g->sample_size * grab_end;
-    if (g->sg_index >= end_pos)
-        end_pos = g->sg_index - end_pos;
-    else
-        end_pos = g->sg_size - end_pos + g->sg_index;
+    // relative end in bytes from current sg_index down, the size is a power of two
+    unsigned mask = g->sg_size - 1;
+    end_pos = (g->sg_index - *g->sample_size * grab_end) & mask;
     // end_pos is now absolute in sg_buf
-
-    if (end_pos >= signal_bsize)
-        start_pos = end_pos - signal_bsize;
-    else
-        start_pos = g->sg_size - signal_bsize + end_pos;
+    start_pos = (end_pos - signal_bsize) & mask;
 
     //fprintf(stderr, "signal_bsize = %d  -      sg_index = %d\n", signal_bsize, g->sg_index);
     //fprintf(stderr, "start_pos    = %d  -   buffer_size = %d\n", start_pos, g->sg_size);
 
-    fprintf(stderr, "*** Saving signal to file %s (%u samples, %u bytes)\n", f_name, grab_len, signal_bsize);
-    fp = fopen(f_name, "wb");
-    if (!fp) {
-        fprintf(stderr, "Failed to open %s\n", f_name);
-        return;
-    }
-
     wlen = signal_bsize;
     wrest = 0;
-    if (start_pos + signal_bsize > g->sg_size) {
+    if (!g->sg_mirror && start_pos + signal_bsize > g->sg_size) {
         wlen  = g->sg_size - start_pos;
         wrest = signal_bsize - wlen;
     }
-    //fprintf(stderr, "*** Writing data from %d, len %d\n", start_pos, wlen);
-    fwrite(&g->sg_buf[start_pos], 1, wlen, fp);
 
-    if (wrest) {
-        //fprintf(stderr, "*** Writing data from %d, len %d\n", 0, wrest);
-        fwrite(&g->sg_buf[0], 1, wrest, fp);
+    grab_job_t meta;
+    grab_meta(g, &meta, grab_len, grab_end + signal_bsize / *g->sample_size);
+
+    if (!g->writer) {
+        grab_write_file(g, &meta, &g->sg_buf[start_pos], wlen, &g->sg_buf[0], wrest);
+    }
+    else if (samp_grab_queue(g, &meta, &g->sg_buf[start_pos], wlen, &g->sg_buf[0], wrest)) {
+        g->drops++;
+        return;
     }
+    g->grabs++;
+}
 
-    fclose(fp);
+int samp_grab_snippet(samp_grab_t *g, unsigned grab_len, unsigned grab_end, char *name, size_t name_size)
+{
+    if (!g->sg_buf || !grab_len)
+        return -1;
+
+    unsigned sample_size = *g->sample_size;
+    if ((uint64_t)(grab_len + grab_end) * sample_size > g->sg_len) {
+        g->drops++;
+        return -1; // the start is already overwritten
+    }
+    unsigned bsize = grab_len * sample_size;
+
+    unsigned mask      = g->sg_size - 1;
+    unsigned end_pos   = (g->sg_index - sample_size * grab_end) & mask;
+    unsigned start_pos = (end_pos - bsize) & mask;
+
+    unsigned wlen  = bsize;
+    unsigned wrest = 0;
+    if (!g->sg_mirror && start_pos + bsize > g->sg_size) {
+        wlen  = g->sg_size - start_pos;
+        wrest = bsize - wlen;
+    }
+
+    grab_job_t meta;
+    grab_meta(g, &meta, grab_len, grab_end + grab_len);
+    char *format = sample_size == 2 ? "cu8" : "cs16";
+    do {
+        snprintf(meta.name, sizeof(meta.name), "iq%06u_%gM_%gk.%s", ++g->snippets,
+                meta.frequency / 1000000.0, meta.samp_rate / 1000.0, format);
+    } while (access(meta.name, F_OK) == 0);
+
+    if (!g->writer) {
+        grab_write_file(g, &meta, &g->sg_buf[start_pos], wlen, &g->sg_buf[0], wrest);
+    }
+    else if (samp_grab_queue(g, &meta, &g->sg_buf[start_pos], wlen, &g->sg_buf[0], wrest)) {
+        g->drops++;
+        return -1;
+    }
+    g->grabs++;
+    snprintf(name, name_size, "%s", meta.name);
+    return 0;
 }
@@ -0,0 +1,616 @@
+/** @file
+    Sample dumper writer, the sample formats of -w written on a thread.
+
+    With a writer thread the samples a dumper needs (IQ, AM, FM) are copied to
+    a pooled buffer and queued, the format conversion, logic rasterization and
+    the writes happen on the thread. The queue is bounded: a file input waits
+    for a free buffer (a stall), a live input drops the buffer instead.
+
+    With io_uring (see -Y io) the writer thread takes all queued buffers at once,
+    the writes of the samples are linked in order and submitted together, one
+    system call for the batch instead of a write() per buffer and dumper.
+
+    A Sigrok dumper gets the logic states and the F32 I, Q, AM, and FM samples
+    as the channels of a streamed .sr file.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sample_dump.h"
+#include "io_ring.h"
+#include "iq_pool.h"
+#include "sample_index.h"
+#include "fileformat.h"
+#include "write_sigrok.h"
+#include "compat_pthread.h"
+#include "thread_pin.h"
+#include "fatal.h"
+
+#ifdef _WIN32
+#define fileno _fileno
+#endif
+
+/// A run of equal logic states, relative to the start of the buffer.
+struct sample_dump_run {
+    int64_t pos;
+    uint32_t len;
+    uint8_t state;
+};
+
+/// A write queued on the ring, the buffer stays valid until the batch is written.
+struct sample_dump_ring_write {
+    file_info_t *dumper;
+    uint8_t const *buf;
+    unsigned long len;
+    int res; ///< the length written, or a negative errno
+};
+
+/// The sources the dumpers read.
+enum dump_sources {
+    DUMP_IQ = 1,
+    DUMP_AM = 2,
+    DUMP_FM = 4,
+};
+
+/// The channels of a Sigrok dumper, the logic probes are the FRAME, ASK, and FSK bits of U8_LOGIC.
+static uint32_t const sigrok_formats[] = {U8_LOGIC, F32_I, F32_Q, F32_AM, F32_FM};
+static char const *sigrok_labels[] = {"FRAME", "ASK", "FSK", "I", "Q", "AM", "FM"};
+
+/// Check if the format is written by the demodulation and not here.
+static int is_text_format(uint32_t format)
+{
+    return format == VCD_LOGIC || format == PULSE_OOK || format == PULSE_OOK_BIN
+            || format == PULSE_ARROW;
+}
+
+static unsigned dump_sources(list_t const *dumpers)
+{
+    unsigned sources = 0;
+    for (void **iter = dumpers->elems; iter && *iter; ++iter) {
+        file_info_t const *dumper = *iter;
+        if (!dumper->file || is_text_format(dumper->format) || dumper->format == U8_LOGIC)
+            continue;
+        if (dumper->format == SIGROK_SR)
+            sources |= DUMP_IQ | DUMP_AM | DUMP_FM;
+        else if (dumper->format == S16_AM || dumper->format == F32_AM)
+            sources |= DUMP_AM;
+        else if (dumper->format == S16_FM || dumper->format == F32_FM)
+            sources |= DUMP_FM;
+        else
+            sources |= DUMP_IQ; // the default is to dump IQ samples
+    }
+    return sources;
+}
+
+sample_dump_t *sample_dump_create(list_t *dumpers)
+{
+    sample_dump_t *d = calloc(1, sizeof(*d));
+    if (!d) {
+        WARN_CALLOC("sample_dump_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    d->dumpers = dumpers;
+    return d;
+}
+
+void sample_dump_logic(sample_dump_t *d, unsigned long n_samples, uint64_t buf_offset, pulse_data_t const *pulses, uint8_t bits)
+{
+    unsigned need = d->runs_len + 2 * pulses->num_pulses;
+    if (need > d->runs_size) {
+        unsigned size = d->runs_size ? d->runs_size : 1024;
+        while (size < need)
+            size *= 2;
+        struct sample_dump_run *runs = realloc(d->runs, size * sizeof(*runs));
+        if (!runs) {
+            WARN_REALLOC("sample_dump_logic()");
+            return; // NOTE: the logic states are missing on alloc failure.
+        }
+        d->runs      = runs;
+        d->runs_size = size;
+    }
+
+    int64_t len = (int64_t)n_samples;
+    int64_t pos = (int64_t)(pulses->offset - buf_offset);
+    for (unsigned n = 0; n < pulses->num_pulses && pos < len; ++n) {
+        if (pos + pulses->pulse[n] > 0)
+            d->runs[d->runs_len++] = (struct sample_dump_run){pos, (uint32_t)pulses->pulse[n], 0x01 | bits};
+        pos += pulses->pulse[n];
+        if (pos + pulses->gap[n] > 0 && pos < len)
+            d->runs[d->runs_len++] = (struct sample_dump_run){pos, (uint32_t)pulses->gap[n], 0x01};
+        pos += pulses->gap[n];
+    }
+}
+
+static void rasterize_logic(uint8_t *buf, unsigned long n_samples, struct sample_dump_run const *runs, unsigned runs_len)
+{
+    int64_t size = (int64_t)n_samples;
+    memset(buf, 0, n_samples);
+    for (unsigned i = 0; i < runs_len; ++i) {
+        int64_t pos = runs[i].pos;
+        int64_t len = runs[i].len;
+        if (pos < 0) {
+            len += pos;
+            pos = 0;
+        }
+        if (pos + len > size)
+            len = size - pos;
+        if (len > 0)
+            memset(buf + pos, runs[i].state, (size_t)len);
+    }
+}
+
+/// Convert the samples to the format of a dumper, returns the bytes to write.
+static uint8_t const *dump_convert(sample_dump_t *d, uint32_t format, sample_dump_input_t const *in,
+        struct sample_dump_run const *runs, unsigned runs_len, unsigned long *out_len)
+{
+    unsigned long n_samples = in->n_samples;
+    uint8_t const *iq_buf   = in->iq_buf;
+    int16_t const *iq16     = (int16_t const *)in->iq_buf;
+    int sample_size         = in->sample_size;
+    uint8_t *u8_buf         = d->scratch;
+    int8_t *s8_buf          = (int8_t *)d->scratch;
+    int16_t *s16_buf        = (int16_t *)d->scratch;
+    float *f32_buf          = (float *)d->scratch;
+
+    if (format == CU8_IQ) {
+        if (sample_size == 4) {
+            for (unsigned long n = 0; n < n_samples * 2; ++n)
+                u8_buf[n] = (iq16[n] / 256) + 128; // scale Q0.15 to Q0.7
+            *out_len = n_samples * 2 * sizeof(uint8_t);
+            return u8_buf;
+        }
+    }
+    else if (format == CS16_IQ) {
+        if (sample_size == 2) {
+            for (unsigned long n = 0; n < n_samples * 2; ++n)
+                s16_buf[n] = (iq_buf[n] * 256) - 32768; // scale Q0.7 to Q0.15
+            *out_len = n_samples * 2 * sizeof(int16_t);
+            return u8_buf;
+        }
+    }
+    else if (format == CS8_IQ) {
+        if (sample_size == 2) {
+            for (unsigned long n = 0; n < n_samples * 2; ++n)
+                s8_buf[n] = (iq_buf[n] - 128);
+        }
+        else if (sample_size == 4) {
+            for (unsigned long n = 0; n < n_samples * 2; ++n)
+                s8_buf[n] = iq16[n] >> 8;
+        }
+        *out_len = n_samples * 2 * sizeof(int8_t);
+        return u8_buf;
+    }
+    else if (format == CF32_IQ) {
+        if (sample_size == 2) {
+            for (unsigned long n = 0; n < n_samples * 2; ++n)
+                f32_buf[n] = (iq_buf[n] - 128) / 128.0f;
+        }
+        else if (sample_size == 4) {
+            for (unsigned long n = 0; n < n_samples * 2; ++n)
+                f32_buf[n] = iq16[n] / 32768.0f;
+        }
+        *out_len = n_samples * 2 * sizeof(float);
+        return u8_buf;
+    }
+    else if (format == S16_AM) {
+        *out_len = n_samples * sizeof(int16_t);
+        return (uint8_t const *)in->am_buf;
+    }
+    else if (format == S16_FM) {
+        *out_len = n_samples * sizeof(int16_t);
+        return (uint8_t const *)in->fm_buf;
+    }
+    else if (format == F32_AM || format == F32_FM) {
+        int16_t const *src = format == F32_AM ? in->am_buf : in->fm_buf;
+        for (unsigned long n = 0; n < n_samples; ++n)
+            f32_buf[n] = src[n] * (1.0f / 0x8000); // scale from Q0.15
+        *out_len = n_samples * sizeof(float);
+        return u8_buf;
+    }
+    else if (format == F32_I || format == F32_Q) {
+        unsigned long q = format == F32_Q;
+        if (sample_size == 2)
+            for (unsigned long n = 0; n < n_samples; ++n)
+                f32_buf[n] = (iq_buf[n * 2 + q] - 128) * (1.0f / 0x80); // scale from Q0.7
+        else
+            for (unsigned long n = 0; n < n_samples; ++n)
+                f32_buf[n] = iq16[n * 2 + q] * (1.0f / 0x8000); // scale from Q0.15
+        *out_len = n_samples * sizeof(float);
+        return u8_buf;
+    }
+    else if (format == U8_LOGIC) { // state data
+        rasterize_logic(u8_buf, n_samples, runs, runs_len);
+        *out_len = n_samples;
+        return u8_buf;
+    }
+
+    *out_len = n_samples * sample_size; // Default is to dump IQ samples
+    return iq_buf;
+}
+
+/// Wait for the writes queued on the ring, a short or cancelled write is completed with stdio, returns -1 on a failed write.
+static int dump_ring_flush(sample_dump_t *d)
+{
+    int failed = 0;
+    while (io_ring_pending(d->ring)) {
+        uint64_t user;
+        int res;
+        if (io_ring_wait(d->ring, &user, &res)) {
+            fprintf(stderr, "Writing the samples failed, samples lost, exiting!\n");
+            d->ring_len = 0;
+            return -1;
+        }
+        d->ring_writes[user].res = res;
+    }
+    // the writes are linked, everything after a short write is cancelled and is written here in order
+    for (unsigned i = 0; i < d->ring_len && !failed; ++i) {
+        struct sample_dump_ring_write *w = &d->ring_writes[i];
+        if (w->res >= 0 && (unsigned long)w->res == w->len)
+            continue;
+        if (w->res < 0 && w->res != -ECANCELED) {
+            fprintf(stderr, "Writing %s failed: %s, samples lost, exiting!\n", w->dumper->spec, strerror(-w->res));
+            failed = -1;
+            break;
+        }
+        unsigned long done = w->res > 0 ? (unsigned long)w->res : 0;
+        if (fwrite(w->buf + done, 1, w->len - done, w->dumper->file) != w->len - done || fflush(w->dumper->file)) {
+            fprintf(stderr, "Short write, samples lost, exiting!\n");
+            failed = -1;
+        }
+    }
+    d->ring_len = 0;
+    return failed;
+}
+
+/// Write the samples of a dumper, on the ring if the buffer outlives the batch, returns -1 on a failed write.
+static int dump_write_out(sample_dump_t *d, file_info_t *dumper, uint8_t const *buf, unsigned long len)
+{
+    if (d->ring && buf == d->scratch && d->ring_len && dump_ring_flush(d))
+        return -1; // the conversion buffer is reused, keep the order with the writes queued
+    if (d->ring && buf != d->scratch) {
+        if (!io_ring_space(d->ring) && dump_ring_flush(d))
+            return -1;
+        fflush(dumper->file); // anything buffered by stdio goes first
+        d->ring_writes[d->ring_len] = (struct sample_dump_ring_write){dumper, buf, len, 0};
+        if (!io_ring_write(d->ring, fileno(dumper->file), buf, (unsigned)len, -1, 1, d->ring_len)) {
+            d->ring_len++;
+            return 0;
+        }
+    }
+    if (fwrite(buf, 1, len, dumper->file) != len) {
+        fprintf(stderr, "Short write, samples lost, exiting!\n");
+        return -1;
+    }
+    return 0;
+}
+
+/// Convert and add a buffer to the channels of a Sigrok dumper, returns -1 on a failed write.
+static int dump_write_sigrok(sample_dump_t *d, file_info_t *dumper, sample_dump_input_t const *in,
+        struct sample_dump_run const *runs, unsigned runs_len)
+{
+    if (!d->sigrok) {
+        d->sigrok = sigrok_writer_create(dumper->file, 3, 4, sigrok_labels);
+        if (!d->sigrok)
+            return -1;
+    }
+    d->sigrok_rate = in->samp_rate;
+    for (unsigned ch = 0; ch < sizeof(sigrok_formats) / sizeof(*sigrok_formats); ++ch) {
+        unsigned long out_len;
+        uint8_t const *out_buf = dump_convert(d, sigrok_formats[ch], in, runs, runs_len, &out_len);
+        if (sigrok_writer_add(d->sigrok, ch, out_buf, out_len) < 0) {
+            fprintf(stderr, "Writing %s failed, samples lost, exiting!\n", dumper->spec);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/// Convert and write a buffer to all sample dumpers, returns -1 on a failed write.
+static int dump_write_buffer(sample_dump_t *d, sample_dump_input_t const *in, struct sample_dump_run const *runs, unsigned runs_len)
+{
+    unsigned long scratch_size = in->n_samples * 2 * sizeof(float); // the largest conversion
+    if (d->scratch_size < scratch_size) {
+        free(d->scratch);
+        d->scratch_size = 0;
+        d->scratch      = malloc(scratch_size);
+        if (!d->scratch) {
+            WARN_MALLOC("sample_dump_write()");
+            return -1;
+        }
+        d->scratch_size = scratch_size;
+    }
+
+    for (void **iter = d->dumpers->elems; iter && *iter; ++iter) {
+        file_info_t *dumper = *iter;
+        if (!dumper->file || is_text_format(dumper->format))
+            continue;
+        if (dumper->format == SIGROK_SR) {
+            if (dump_write_sigrok(d, dumper, in, runs, runs_len) < 0)
+                return -1;
+            continue;
+        }
+        unsigned long out_len;
+        uint8_t const *out_buf = dump_convert(d, dumper->format, in, runs, runs_len, &out_len);
+
+        if (dump_write_out(d, dumper, out_buf, out_len) < 0)
+            return -1;
+
+        if (d->dump_index && dumper->file != stdout) {
+            if (!dumper->index) // once the sample rate is known
+                dumper->index = sample_index_create(dumper->path, in->samp_rate, in->center_frequency);
+            if (!dumper->index)
+                return -1;
+            sample_index_add(dumper->index, in->n_samples, &in->now, in->avg_db);
+        }
+    }
+    return 0;
+}
+
+#ifdef THREADS
+
+/// A queued buffer, the samples are copied to the pooled buffer, the IQ samples may be retained instead.
+typedef struct dump_job {
+    sample_dump_input_t in;
+    iq_buf_t *iq_ref;      ///< the retained buffer holding the IQ samples, NULL if copied
+    uint8_t *buf;          ///< the copied samples, pooled
+    unsigned long buf_size; ///< capacity of the buffer
+    struct sample_dump_run *runs; ///< swapped with the runs of the demodulation
+    unsigned runs_len;
+    unsigned runs_size;
+} dump_job_t;
+
+struct sample_dump_writer {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond; ///< signals a queued buffer or the exit
+    pthread_cond_t free_cond; ///< signals a written buffer
+    int exit;
+    int failed; ///< a write failed, later buffers are discarded
+    unsigned first; ///< the buffer being written or next to write
+    unsigned len;   ///< buffers queued, including the one being written
+    dump_job_t jobs[SAMPLE_DUMP_QUEUE_SIZE];
+};
+
+static THREAD_RETURN THREAD_CALL sample_dump_thread(void *arg)
+{
+    sample_dump_t *d              = arg;
+    struct sample_dump_writer *w = d->writer;
+    thread_pin_self(THREAD_OUTPUT);
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->len && !w->exit) {
+            pthread_cond_wait(&w->work_cond, &w->lock);
+        }
+        if (!w->len)
+            break; // exit with all buffers written
+        unsigned first = w->first;
+        unsigned batch = d->ring ? w->len : 1; // with the ring the queued buffers are written together
+        int failed     = w->failed;
+        pthread_mutex_unlock(&w->lock);
+
+        for (unsigned i = 0; i < batch && !failed; ++i) {
+            dump_job_t *job = &w->jobs[(first + i) % SAMPLE_DUMP_QUEUE_SIZE];
+            failed          = dump_write_buffer(d, &job->in, job->runs, job->runs_len);
+        }
+        if (d->ring && dump_ring_flush(d))
+            failed = -1;
+        for (unsigned i = 0; i < batch; ++i) {
+            dump_job_t *job = &w->jobs[(first + i) % SAMPLE_DUMP_QUEUE_SIZE];
+            iq_buf_release(job->iq_ref); // the writes are done
+            job->iq_ref = NULL;
+        }
+
+        pthread_mutex_lock(&w->lock);
+        w->failed = failed;
+        w->first  = (w->first + batch) % SAMPLE_DUMP_QUEUE_SIZE;
+        w->len -= batch;
+        pthread_cond_signal(&w->free_cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return (THREAD_RETURN)0;
+}
+
+void sample_dump_start_writer(sample_dump_t *d)
+{
+    if (d->writer)
+        return;
+    struct sample_dump_writer *w = calloc(1, sizeof(*w));
+    if (!w) {
+        WARN_CALLOC("sample_dump_start_writer()");
+        return; // NOTE: writes synchronously on alloc failure.
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->work_cond, NULL);
+    pthread_cond_init(&w->free_cond, NULL);
+    d->writer = w;
+    d->ring   = io_ring_create(SAMPLE_DUMP_RING_DEPTH);
+    if (d->ring) {
+        d->ring_writes = calloc(SAMPLE_DUMP_RING_DEPTH, sizeof(*d->ring_writes));
+        if (!d->ring_writes) {
+            WARN_CALLOC("sample_dump_start_writer()");
+            io_ring_free(d->ring);
+            d->ring = NULL; // NOTE: writes with stdio on alloc failure.
+        }
+    }
+    if (pthread_create(&w->thread, NULL, sample_dump_thread, d)) {
+        fprintf(stderr, "%s: failed to start thread\n", __func__);
+        pthread_cond_destroy(&w->free_cond);
+        pthread_cond_destroy(&w->work_cond);
+        pthread_mutex_destroy(&w->lock);
+        free(w);
+        d->writer = NULL;
+        io_ring_free(d->ring);
+        d->ring = NULL;
+    }
+}
+
+static void sample_dump_stop_writer(sample_dump_t *d)
+{
+    struct sample_dump_writer *w = d->writer;
+    if (!w)
+        return;
+    pthread_mutex_lock(&w->lock);
+    w->exit = 1;
+    pthread_cond_signal(&w->work_cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+
+    for (unsigned i = 0; i < SAMPLE_DUMP_QUEUE_SIZE; ++i) {
+        free(w->jobs[i].buf);
+        free(w->jobs[i].runs);
+    }
+    pthread_cond_destroy(&w->free_cond);
+    pthread_cond_destroy(&w->work_cond);
+    pthread_mutex_destroy(&w->lock);
+    free(w);
+    d->writer = NULL;
+    io_ring_free(d->ring);
+    d->ring = NULL;
+}
+
+unsigned sample_dump_queue_depth(sample_dump_t *d)
+{
+    struct sample_dump_writer *w = d->writer;
+    if (!w)
+        return 0;
+    pthread_mutex_lock(&w->lock);
+    unsigned depth = w->len;
+    pthread_mutex_unlock(&w->lock);
+    return depth;
+}
+
+/// Copy the buffer to a free pooled job and queue it, returns -1 if a write failed.
+static int sample_dump_queue(sample_dump_t *d, sample_dump_input_t const *in)
+{
+    struct sample_dump_writer *w = d->writer;
+    pthread_mutex_lock(&w->lock);
+    if (w->len == SAMPLE_DUMP_QUEUE_SIZE && in->live) {
+        pthread_mutex_unlock(&w->lock);
+        if (!d->drops)
+            fprintf(stderr, "Sample dump writer is too slow, dropping buffers\n");
+        d->drops++;
+        d->runs_len = 0;
+        return 0;
+    }
+    if (w->len == SAMPLE_DUMP_QUEUE_SIZE)
+        d->stalls++;
+    while (w->len == SAMPLE_DUMP_QUEUE_SIZE) {
+        pthread_cond_wait(&w->free_cond, &w->lock);
+    }
+    int failed    = w->failed;
+    unsigned slot = (w->first + w->len) % SAMPLE_DUMP_QUEUE_SIZE;
+    pthread_mutex_unlock(&w->lock);
+    if (failed)
+        return -1;
+
+    // the free slots are only touched by this thread
+    dump_job_t *job         = &w->jobs[slot];
+    unsigned sources        = dump_sources(d->dumpers);
+    unsigned long n_samples = in->n_samples;
+    unsigned long iq_len    = sources & DUMP_IQ ? n_samples * in->sample_size : 0;
+    job->iq_ref             = NULL;
+    if (iq_len && iq_buf_holds(in->iq_ref, in->iq_buf, iq_len) && iq_buf_retain(in->iq_ref) == 0) {
+        job->iq_ref = in->iq_ref;
+        iq_len      = 0; // not copied
+    }
+    unsigned long am_len    = sources & DUMP_AM ? n_samples * sizeof(int16_t) : 0;
+    unsigned long fm_len    = sources & DUMP_FM ? n_samples * sizeof(int16_t) : 0;
+    if (job->buf_size < iq_len + am_len + fm_len) {
+        uint8_t *buf = realloc(job->buf, iq_len + am_len + fm_len);
+        if (!buf) {
+            WARN_REALLOC("sample_dump_queue()");
+            iq_buf_release(job->iq_ref);
+            job->iq_ref = NULL;
+            return -1;
+        }
+        job->buf      = buf;
+        job->buf_size = iq_len + am_len + fm_len;
+    }
+    job->in        = *in;
+    job->in.iq_buf = job->iq_ref ? in->iq_buf : job->buf;
+    job->in.am_buf = (int16_t const *)(job->buf + iq_len);
+    job->in.fm_buf = (int16_t const *)(job->buf + iq_len + am_len);
+    if (iq_len)
+        memcpy(job->buf, in->iq_buf, iq_len);
+    if (am_len)
+        memcpy(job->buf + iq_len, in->am_buf, am_len);
+    if (fm_len)
+        memcpy(job->buf + iq_len + am_len, in->fm_buf, fm_len);
+
+    struct sample_dump_run *runs = job->runs;
+    unsigned runs_size           = job->runs_size;
+    job->runs                    = d->runs;
+    job->runs_len                = d->runs_len;
+    job->runs_size               = d->runs_size;
+    d->runs                      = runs;
+    d->runs_len                  = 0;
+    d->runs_size                 = runs_size;
+    d->buffers++;
+
+    pthread_mutex_lock(&w->lock);
+    w->len++;
+    pthread_cond_signal(&w->work_cond);
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+#else
+
+void sample_dump_start_writer(sample_dump_t *d)
+{
+    (void)d;
+}
+
+static void sample_dump_stop_writer(sample_dump_t *d)
+{
+    (void)d;
+}
+
+unsigned sample_dump_queue_depth(sample_dump_t *d)
+{
+    (void)d;
+    return 0;
+}
+
+static int sample_dump_queue(sample_dump_t *d, sample_dump_input_t const *in)
+{
+    (void)d;
+    (void)in;
+    return -1; // never called without a writer
+}
+
+#endif
+
+int sample_dump_write(sample_dump_t *d, sample_dump_input_t const *in)
+{
+    if (d->writer)
+        return sample_dump_queue(d, in);
+
+    int ret     = dump_write_buffer(d, in, d->runs, d->runs_len);
+    d->runs_len = 0;
+    d->buffers++;
+    return ret;
+}
+
+void sample_dump_free(sample_dump_t *d)
+{
+    if (!d)
+        return;
+    sample_dump_stop_writer(d);
+    if (sigrok_writer_close(d->sigrok, d->sigrok_rate) < 0)
+        fprintf(stderr, "Writing the Sigrok file failed\n");
+    if (d->drops)
+        fprintf(stderr, "Sample dump writer dropped %u buffers\n", d->drops);
+    free(d->runs);
+    free(d->scratch);
+    free(d->ring_writes);
+    free(d);
+}
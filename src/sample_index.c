@@ -0,0 +1,141 @@
+/** @file
+    Sample index, a sidecar file mapping sample offsets to wall time and level.
+
+    The index is text, a header of ";" lines, then one line per block with
+    the sample offset, the wall time in seconds since the epoch, and the
+    average level in dB, e.g. "131072 1760450602.647000 -41.9".
+    A time of day is then found by the block received last before it,
+    the samples after the block start are counted at the sample rate.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "sample_index.h"
+#include "optparse.h"
+#include "fatal.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct sample_index {
+    FILE *file;
+    uint64_t samples; ///< samples written to the sample file
+};
+
+/// Open the "<path>.idx" file of a sample file.
+static FILE *index_open(char const *path, char const *mode)
+{
+    size_t len = strlen(path);
+    char *idx_path = malloc(len + 5);
+    if (!idx_path) {
+        WARN_MALLOC("index_open()");
+        return NULL;
+    }
+    memcpy(idx_path, path, len);
+    memcpy(idx_path + len, ".idx", 5);
+    FILE *file = fopen(idx_path, mode);
+    if (!file)
+        fprintf(stderr, "Failed to open index %s\n", idx_path);
+    free(idx_path);
+    return file;
+}
+
+sample_index_t *sample_index_create(char const *path, uint32_t sample_rate, uint32_t center_frequency)
+{
+    sample_index_t *index = calloc(1, sizeof(*index));
+    if (!index) {
+        WARN_CALLOC("sample_index_create()");
+        return NULL;
+    }
+    index->file = index_open(path, "w");
+    if (!index->file) {
+        free(index);
+        return NULL;
+    }
+    fprintf(index->file, ";sample index\n");
+    fprintf(index->file, ";version 1\n");
+    fprintf(index->file, ";samplerate %u Hz\n", sample_rate);
+    fprintf(index->file, ";centerfreq %u Hz\n", center_frequency);
+    fprintf(index->file, ";offset time level\n");
+    return index;
+}
+
+void sample_index_add(sample_index_t *index, unsigned long n_samples, struct timeval const *time, float level_db)
+{
+    fprintf(index->file, "%" PRIu64 " %lld.%06ld %.1f\n", index->samples,
+            (long long)time->tv_sec, (long)time->tv_usec, level_db);
+    index->samples += n_samples;
+}
+
+void sample_index_free(sample_index_t *index)
+{
+    if (!index)
+        return;
+    fclose(index->file);
+    free(index);
+}
+
+/// Get the local midnight before a time.
+static double local_midnight(double secs)
+{
+    time_t t = (time_t)secs;
+    struct tm tm_info;
+#ifdef _WIN32 /* MinGW might have localtime_r but apparently not MinGW64 */
+    localtime_s(&tm_info, &t); // win32 doesn't have localtime_r()
+#else
+    localtime_r(&t, &tm_info); // thread-safe
+#endif
+    tm_info.tm_hour = 0;
+    tm_info.tm_min  = 0;
+    tm_info.tm_sec  = 0;
+    return (double)mktime(&tm_info);
+}
+
+int sample_index_find(char const *path, uint32_t sample_rate, char const *pos, uint64_t *offset)
+{
+    if (!strchr(pos, ':')) {
+        int secs = atoi_time(pos, "-r start/end: ");
+        if (secs < 0)
+            return -1;
+        *offset = (uint64_t)secs * sample_rate;
+        return 0;
+    }
+
+    FILE *file = index_open(path, "r");
+    if (!file)
+        return -1;
+
+    double target = -1.0;
+    int found     = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        if (*line == ';')
+            continue;
+        uint64_t entry_offset;
+        double entry_time;
+        if (sscanf(line, "%" SCNu64 " %lf", &entry_offset, &entry_time) != 2)
+            continue;
+        if (target < 0.0) {
+            // the first time of day at or after the start of the recording
+            target = local_midnight(entry_time) + atoi_time(pos, "-r start/end: ");
+            if (target < entry_time)
+                target += 24 * 60 * 60;
+        }
+        if (entry_time > target)
+            break;
+        *offset = entry_offset + (uint64_t)((target - entry_time) * sample_rate);
+        found   = 1;
+    }
+    fclose(file);
+    if (!found) {
+        fprintf(stderr, "Time %s not found in the index of %s\n", pos, path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,186 @@
+/** @file
+    Sample file reader, maps regular files or reads them ahead with io_uring, and reads pipes in blocks.
+
+    Mapping a capture saves a copy and a read() per block, the pages are
+    read ahead by the kernel as the blocks are demodulated in order.
+
+    A regular file that can not be mapped, or any regular file with -Y io=uring,
+    is read ahead with io_uring: a few blocks are read at their file offsets while
+    the current block is demodulated, into buffers registered with the ring if the
+    locked memory limit allows. A block is read again once the caller is done with it.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "sample_reader.h"
+#include "io_ring.h"
+#include "huge_buf.h"
+
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+void sample_reader_open(sample_reader_t *reader, FILE *file)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->file = file;
+
+#ifndef _WIN32
+    int fd = fileno(file);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0
+            || (uint64_t)st.st_size > SIZE_MAX) {
+        return; // not a regular file, read it
+    }
+    off_t pos = ftello(file);
+    if (pos < 0 || pos > st.st_size)
+        return;
+    reader->ring_offset = (int64_t)pos;
+    if (io_ring_get_mode() == IO_RING_ALWAYS) {
+        reader->ring_file = 1;
+        return;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        reader->ring_file = io_ring_get_mode() != IO_RING_OFF;
+        return; // e.g. a file larger than the address space, read it
+    }
+#ifdef MADV_SEQUENTIAL
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+    reader->map      = map;
+    reader->map_size = (size_t)st.st_size;
+    reader->map_pos  = (size_t)pos;
+#endif
+}
+
+/// Queue the read of a block, or of the rest of a block after a short read.
+static int ring_queue_block(sample_reader_t *reader, unsigned slot)
+{
+    size_t fill  = reader->ring_reads[slot].fill;
+    uint8_t *buf = reader->ring_buf + slot * reader->ring_block;
+    return io_ring_read(reader->ring, fileno(reader->file), buf + fill, (unsigned)(reader->ring_block - fill),
+            reader->ring_reads[slot].offset + (int64_t)fill, reader->ring_fixed ? (int)slot : -1, slot);
+}
+
+/// Set up the ring and the blocks, returns -1 to read with fread() instead.
+static int ring_start(sample_reader_t *reader, size_t len)
+{
+    reader->ring = io_ring_create(SAMPLE_READER_DEPTH);
+    if (!reader->ring)
+        return -1;
+    reader->ring_buf = huge_buf_create(SAMPLE_READER_DEPTH * len);
+    if (!reader->ring_buf) {
+        io_ring_free(reader->ring);
+        reader->ring = NULL;
+        return -1;
+    }
+    reader->ring_block = len;
+    reader->ring_fixed = !io_ring_register(reader->ring, reader->ring_buf, len, SAMPLE_READER_DEPTH);
+    return 0;
+}
+
+/// Queue the free blocks, wait for the next block, returns -1 on a failed read.
+static int ring_fill(sample_reader_t *reader)
+{
+    while (!reader->ring_eof && reader->ring_queued < SAMPLE_READER_DEPTH) {
+        unsigned slot = (reader->ring_next + reader->ring_queued) % SAMPLE_READER_DEPTH;
+        reader->ring_reads[slot].offset = reader->ring_offset;
+        reader->ring_reads[slot].fill   = 0;
+        reader->ring_reads[slot].done   = 0;
+        if (ring_queue_block(reader, slot))
+            return -1;
+        reader->ring_offset += (int64_t)reader->ring_block;
+        reader->ring_queued++;
+    }
+
+    while (!reader->ring_reads[reader->ring_next].done) {
+        uint64_t user;
+        int res;
+        if (io_ring_wait(reader->ring, &user, &res))
+            return -1;
+        unsigned slot = (unsigned)user;
+        if (res < 0) {
+            fprintf(stderr, "Reading the input failed: %s\n", strerror(-res));
+            return -1;
+        }
+        reader->ring_reads[slot].fill += (size_t)res;
+        if (res == 0) {
+            reader->ring_eof              = 1; // the blocks queued further on read nothing too
+            reader->ring_reads[slot].done = 1;
+        }
+        else if (reader->ring_reads[slot].fill == reader->ring_block) {
+            reader->ring_reads[slot].done = 1;
+        }
+        else if (ring_queue_block(reader, slot)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static size_t ring_next_block(sample_reader_t *reader, uint8_t const **block, size_t len)
+{
+    if (!reader->ring_queued && reader->ring_eof)
+        return 0;
+    if (ring_fill(reader)) {
+        reader->ring_eof    = 1;
+        reader->ring_queued = 0;
+        return 0;
+    }
+    unsigned slot = reader->ring_next;
+    size_t left   = reader->ring_reads[slot].fill - reader->ring_pos;
+    if (len > left)
+        len = left;
+    *block = reader->ring_buf + slot * reader->ring_block + reader->ring_pos;
+    reader->ring_pos += len;
+    if (reader->ring_pos == reader->ring_reads[slot].fill) {
+        // the block is read again with the next call, the caller is done with it then
+        reader->ring_next = (slot + 1) % SAMPLE_READER_DEPTH;
+        reader->ring_queued--;
+        reader->ring_pos = 0;
+    }
+    return len;
+}
+
+size_t sample_reader_next(sample_reader_t *reader, uint8_t const **block, uint8_t *buf, size_t len)
+{
+    if (reader->ring_file && !reader->ring) {
+        reader->ring_file = 0;
+        if (len && !ring_start(reader, len))
+            reader->ring_file = 1;
+    }
+    if (reader->ring)
+        return ring_next_block(reader, block, len);
+
+    if (!reader->map) {
+        *block = buf;
+        return fread(buf, 1, len, reader->file);
+    }
+
+    size_t left = reader->map_size - reader->map_pos;
+    if (len > left)
+        len = left;
+    *block = reader->map + reader->map_pos;
+    reader->map_pos += len;
+    return len;
+}
+
+void sample_reader_close(sample_reader_t *reader)
+{
+#ifndef _WIN32
+    if (reader->map)
+        munmap((void *)reader->map, reader->map_size);
+#endif
+    reader->map = NULL;
+    io_ring_free(reader->ring); // waits for the reads in flight
+    reader->ring = NULL;
+    huge_buf_free(reader->ring_buf);
+    reader->ring_buf = NULL;
+}
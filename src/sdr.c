@@ -16,10 +16,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <limits.h>
 #include "sdr.h"
 #include "r_util.h"
 #include "optparse.h"
 #include "fatal.h"
+#include "compat_pthread.h"
+#include "huge_buf.h"
+#include "iq_pool.h"
+#include "thread_pin.h"
 #ifdef RTLSDR
 #include <rtl-sdr.h>
 #if defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
@@ -74,6 +80,16 @@ int __attribute__((weak)) rtlsdr_set_bias_tee(rtlsdr_dev_t *dev, int on);
 
 #define GAIN_STR_MAX_SIZE 64
 
+#ifdef THREADS
+/// A slot of the acquisition ring, the data is in a pooled buffer, handed back once processed.
+typedef struct sdr_ring_slot {
+    sdr_event_t ev;
+    sdr_dev_t *src; ///< the device the event is from
+    int ready;      ///< the event is copied in, slots are reserved in order but may be filled out of order
+    char gain_str[GAIN_STR_MAX_SIZE];
+} sdr_ring_slot_t;
+#endif
+
 struct sdr_dev {
     SOCKET rtl_tcp;
     uint32_t rtl_tcp_freq; ///< last known center frequency, rtl_tcp only.
@@ -83,6 +99,13 @@ struct sdr_dev {
     SoapySDRDevice *soapy_dev;
     SoapySDRStream *soapy_stream;
     double fullScale;
+    size_t soapy_channel;       ///< the RX channel of this handle
+    int soapy_is_channel;       ///< a handle of another channel from sdr_open_channel(), the stream belongs to the device
+    unsigned soapy_channel_num; ///< channels in the stream, read together
+    sdr_dev_t *soapy_channels[SDR_MAX_DEVICES]; ///< handles of the other channels, index 0 is unused
+    int soapy_native;           ///< the stream format is the native format at full scale, the driver buffers can be read directly
+    int soapy_overflow;         ///< an overflow was reported, the next stream time tells the samples dropped
+    long long soapy_next_ns;    ///< the expected stream time of the next buffer, 0 if unknown
 #endif
 
 #ifdef RTLSDR
@@ -95,6 +118,8 @@ struct sdr_dev {
 
     int running;
     int polling;
+    unsigned overflows; ///< buffers dropped by the device
+    uint64_t dropped_samples; ///< samples dropped by the device, if the stream has the time
     uint8_t *buffer; ///< sdr data buffer current and past frames
     size_t buffer_size; ///< sdr data buffer overall size (num * len)
     size_t buffer_pos; ///< sdr data buffer next write position
@@ -110,45 +135,144 @@ struct sdr_dev {
     int freq_correction;
     uint32_t center_frequency;
     char *gain_str;
+
+#ifdef THREADS
+    unsigned ring_num;          ///< buffers in the acquisition ring, 0 to read on the calling thread
+    int ring_running;           ///< the acquisition thread is started
+    int ring_stop;              ///< a read loop returned, the others are stopped
+    int ring_ret;               ///< return value of the first read loop to return
+    unsigned ring_active;       ///< read loops still running on acquisition threads
+    uint32_t ring_buf_num;      ///< buffers for the read loop
+    uint32_t ring_len;          ///< bytes per ring buffer
+    iq_pool_t *ring_pool;       ///< the buffers of the ring slots and those retained by the consumers
+    sdr_ring_slot_t *ring_slots;
+    unsigned ring_size;         ///< slots in the ring, ring_num for each device reading into it
+    unsigned ring_first;
+    unsigned ring_reserved;     ///< slots taken, queued or being filled
+    unsigned ring_count;        ///< slots queued, in order
+    int ring_fed;               ///< the events are pushed by the read loop of another device, no acquisition thread
+    sdr_dev_t *ring_owner;      ///< the device whose ring this device reads into, NULL for its own ring
+    sdr_event_cb_t ring_cb;     ///< callback for the events of this device if it reads into another ring
+    void *ring_ctx;
+    unsigned ring_member_num;
+    sdr_dev_t *ring_members[SDR_MAX_DEVICES - 1]; ///< other devices reading into this ring
+    unsigned ring_batch_ms;     ///< hand the queued slots over in bursts at most this late, 0 for each slot
+    int ring_block;             ///< wait for a free slot instead of dropping the data, for a source that can be slowed down
+    int64_t ring_due_us;        ///< wall clock time the burst of the queued slots is due
+    int ring_draining;          ///< a burst is handed over until the ring is empty
+    unsigned lost_pending;      ///< samples lost since the last queued buffer
+    uint64_t lost_samples;      ///< samples lost in total
+    uint64_t buffer_seq;        ///< sequence number of the last buffer read, queued or dropped
+    pthread_t ring_thread;
+    pthread_mutex_t ring_lock;  ///< lock for the ring and the pending changes
+    pthread_cond_t work_cond;   ///< signals a queued slot or the end of the read loop
+    pthread_cond_t space_cond;  ///< signals a free slot
+#endif
 };
 
 /* internal helpers */
 
+uint64_t sdr_get_dropped_samples(sdr_dev_t *dev)
+{
+    if (!dev)
+        return 0;
+
+    return dev->dropped_samples;
+}
+
+size_t sdr_get_memory(sdr_dev_t *dev)
+{
+    if (!dev)
+        return 0;
+
+    return dev->buffer_size + iq_pool_memory(dev->ring_pool) + (dev->ring_slots ? dev->ring_size * sizeof(*dev->ring_slots) : 0);
+}
+
+static int set_center_freq(sdr_dev_t *dev, uint32_t freq, int verbose);
+static int set_freq_correction(sdr_dev_t *dev, int ppm, int verbose);
+static int set_tuner_gain(sdr_dev_t *dev, char const *gain_str, int verbose);
+static int set_sample_rate(sdr_dev_t *dev, uint32_t rate, int verbose);
+
+#ifdef THREADS
+static void ring_push(sdr_event_t *ev, void *ctx);
+#endif
+
+/// Changes are deferred to the read loop while it runs the callback, or always with an acquisition thread.
+static int defer_changes(sdr_dev_t *dev)
+{
+#ifdef THREADS
+    if (dev->ring_running)
+        return 1;
+#endif
+    return dev->polling;
+}
+
+/// Guard the pending changes, only needed with an acquisition thread.
+static void lock_changes(sdr_dev_t *dev)
+{
+#ifdef THREADS
+    if (dev->ring_num)
+        pthread_mutex_lock(&dev->ring_lock);
+#else
+    (void)dev;
+#endif
+}
+
+static void unlock_changes(sdr_dev_t *dev)
+{
+#ifdef THREADS
+    if (dev->ring_num)
+        pthread_mutex_unlock(&dev->ring_lock);
+#else
+    (void)dev;
+#endif
+}
+
 static int apply_changes(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx)
 {
+    lock_changes(dev);
+    int apply_rate            = dev->apply_rate;
+    int apply_corr            = dev->apply_corr;
+    int apply_freq            = dev->apply_freq;
+    int apply_gain            = dev->apply_gain;
+    uint32_t sample_rate      = dev->sample_rate;
+    int freq_correction       = dev->freq_correction;
+    uint32_t center_frequency = dev->center_frequency;
+    char *gain_str            = dev->gain_str;
+    dev->apply_rate           = 0;
+    dev->apply_corr           = 0;
+    dev->apply_freq           = 0;
+    dev->apply_gain           = 0;
+    dev->gain_str             = NULL;
+    unlock_changes(dev);
+
     int r = 0;
     sdr_event_flags_t flags = 0;
-    if (dev->apply_rate) {
-        r = sdr_set_sample_rate(dev, dev->sample_rate, 1); // always verbose
-        dev->apply_rate = 0;
+    if (apply_rate) {
+        r = set_sample_rate(dev, sample_rate, 1); // always verbose
         flags |= SDR_EV_RATE;
     }
 
-    if (dev->apply_corr) {
-        r = sdr_set_freq_correction(dev, dev->freq_correction, 1); // always verbose
-        dev->apply_corr = 0;
+    if (apply_corr) {
+        r = set_freq_correction(dev, freq_correction, 1); // always verbose
         flags |= SDR_EV_CORR;
     }
 
-    if (dev->apply_freq) {
-        r = sdr_set_center_freq(dev, dev->center_frequency, 1); // always verbose
-        dev->apply_freq = 0;
+    if (apply_freq) {
+        r = set_center_freq(dev, center_frequency, 1); // always verbose
         flags |= SDR_EV_FREQ;
     }
 
-    char *gain_str = dev->gain_str;
-    dev->gain_str = NULL;
-    if (dev->apply_gain) {
-        r = sdr_set_tuner_gain(dev, gain_str, 1); // always verbose
-        dev->apply_gain = 0;
+    if (apply_gain) {
+        r = set_tuner_gain(dev, gain_str, 1); // always verbose
         flags |= SDR_EV_GAIN;
     }
     if (flags) {
         sdr_event_t ev = {
                 .ev               = flags,
-                .sample_rate      = dev->sample_rate,
-                .freq_correction  = dev->freq_correction,
-                .center_frequency = dev->center_frequency,
+                .sample_rate      = sample_rate,
+                .freq_correction  = freq_correction,
+                .center_frequency = center_frequency,
                 .gain_str         = gain_str,
         };
         if (cb)
@@ -180,7 +304,25 @@ static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     if (param)
         strncpy(hostport, param, sizeof(hostport) - 1);
     hostport[sizeof(hostport) - 1] = '\0';
-    hostport_param(hostport, &host, &port);
+    char *opts = hostport_param(hostport, &host, &port);
+
+    int rcvbuf         = 0;
+    unsigned readahead = 32;
+    char *key, *val;
+    while (getkwargs(&opts, &key, &val)) {
+        key = remove_ws(key);
+        val = trim_ws(val);
+        if (!key || !*key)
+            continue;
+        else if (!strcasecmp(key, "rcvbuf"))
+            rcvbuf = (int)atouint32_metric(val, "-d rtl_tcp rcvbuf: ");
+        else if (!strcasecmp(key, "readahead"))
+            readahead = atouint32_metric(val, "-d rtl_tcp readahead: ");
+        else {
+            fprintf(stderr, "Invalid key \"%s\" option.\n", key);
+            return -1;
+        }
+    }
 
     fprintf(stderr, "rtl_tcp input from %s port %s\n", host, port);
 
@@ -211,6 +353,9 @@ static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     sock = INVALID_SOCKET;
     for (res = res0; res; res = res->ai_next) {
         sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+        // set the receive buffer before connecting, the TCP window scale is negotiated on connect
+        if (sock >= 0 && rcvbuf > 0 && setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char const *)&rcvbuf, sizeof(rcvbuf)) < 0)
+            perror("rtl_tcp SO_RCVBUF");
         if (sock >= 0) {
             ret = connect(sock, res->ai_addr, res->ai_addrlen);
             if (ret == -1) {
@@ -251,6 +396,12 @@ static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     char const *tuner_name = tuner_number > sizeof (tuner_names) ? "Invalid" : tuner_names[tuner_number];
 
     fprintf(stderr, "rtl_tcp connected to %s:%s (Tuner: %s)\n", host, port, tuner_name);
+    if (rcvbuf > 0) {
+        int applied = 0;
+        socklen_t optlen = sizeof(applied);
+        if (getsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char *)&applied, &optlen) == 0)
+            fprintf(stderr, "rtl_tcp receive buffer %d bytes.\n", applied);
+    }
 
     sdr_dev_t *dev = calloc(1, sizeof(sdr_dev_t));
     if (!dev) {
@@ -261,6 +412,13 @@ static int rtltcp_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     dev->rtl_tcp = sock;
     dev->sample_size = sizeof(uint8_t) * 2; // CU8
     dev->sample_signed = 0;
+#ifdef THREADS
+    // read ahead so network jitter does not stall processing, a full ring slows down the server
+    dev->ring_block = 1;
+    sdr_set_acquire(dev, readahead);
+#else
+    UNUSED(readahead);
+#endif
 
     *out_dev = dev;
     return 0;
@@ -287,8 +445,8 @@ static int rtltcp_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32
 {
     size_t buffer_size = buf_num * buf_len;
     if (dev->buffer_size != buffer_size) {
-        free(dev->buffer);
-        dev->buffer = malloc(buffer_size);
+        huge_buf_free(dev->buffer);
+        dev->buffer = huge_buf_create(buffer_size);
         if (!dev->buffer) {
             WARN_MALLOC("rtltcp_read_loop()");
             return -1; // NOTE: returns error on alloc failure.
@@ -500,17 +658,11 @@ static void rtlsdr_read_cb(unsigned char *iq_buf, uint32_t len, void *ctx)
 {
     sdr_dev_t *dev = ctx;
 
-    if (dev->buffer_pos + len > dev->buffer_size)
-        dev->buffer_pos = 0;
-    uint8_t *buffer = &dev->buffer[dev->buffer_pos];
-    dev->buffer_pos += len;
-
-    // NOTE: we need to copy the buffer, it might go away on cancel_async
-    memcpy(buffer, iq_buf, len);
-
+    // NOTE: the transfer buffer is used in place, it is valid until the callback returns,
+    // librtlsdr only frees the buffers after rtlsdr_read_async() returns, even on cancel_async
     sdr_event_t ev = {
             .ev  = SDR_EV_DATA,
-            .buf = buffer,
+            .buf = iq_buf,
             .len = len,
     };
     if (len > 0) // prevent a crash in callback
@@ -519,18 +671,6 @@ static void rtlsdr_read_cb(unsigned char *iq_buf, uint32_t len, void *ctx)
 
 static int rtlsdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
 {
-    size_t buffer_size = buf_num * buf_len;
-    if (dev->buffer_size != buffer_size) {
-        free(dev->buffer);
-        dev->buffer = malloc(buffer_size);
-        if (!dev->buffer) {
-            WARN_MALLOC("rtlsdr_read_loop()");
-            return -1; // NOTE: returns error on alloc failure.
-        }
-        dev->buffer_size = buffer_size;
-        dev->buffer_pos = 0;
-    }
-
     int r = 0;
 
     dev->rtlsdr_cb = cb;
@@ -574,16 +714,16 @@ static int rtlsdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32
 
 #ifdef SOAPYSDR
 
-static int soapysdr_set_bandwidth(SoapySDRDevice *dev, uint32_t bandwidth)
+static int soapysdr_set_bandwidth(SoapySDRDevice *dev, size_t channel, uint32_t bandwidth)
 {
     int r;
-    r = (int)SoapySDRDevice_setBandwidth(dev, SOAPY_SDR_RX, 0, (double)bandwidth);
+    r = (int)SoapySDRDevice_setBandwidth(dev, SOAPY_SDR_RX, channel, (double)bandwidth);
     uint32_t applied_bw = 0;
     if (r != 0) {
         fprintf(stderr, "WARNING: Failed to set bandwidth.\n");
     }
     else if (bandwidth > 0) {
-        applied_bw = (uint32_t)SoapySDRDevice_getBandwidth(dev, SOAPY_SDR_RX, 0);
+        applied_bw = (uint32_t)SoapySDRDevice_getBandwidth(dev, SOAPY_SDR_RX, channel);
         if (applied_bw)
             fprintf(stderr, "Bandwidth parameter %u Hz resulted in %u Hz.\n", bandwidth, applied_bw);
         else
@@ -650,13 +790,13 @@ static int soapysdr_offset_tuning(SoapySDRDevice *dev)
     return r;
 }
 
-static int soapysdr_auto_gain(SoapySDRDevice *dev, int verbose)
+static int soapysdr_auto_gain(SoapySDRDevice *dev, size_t channel, int verbose)
 {
     int r = 0;
 
-    r = SoapySDRDevice_hasGainMode(dev, SOAPY_SDR_RX, 0);
+    r = SoapySDRDevice_hasGainMode(dev, SOAPY_SDR_RX, channel);
     if (r) {
-        r = SoapySDRDevice_setGainMode(dev, SOAPY_SDR_RX, 0, 1);
+        r = SoapySDRDevice_setGainMode(dev, SOAPY_SDR_RX, channel, 1);
         if (r != 0) {
             fprintf(stderr, "WARNING: Failed to enable automatic gain.\n");
         }
@@ -673,15 +813,15 @@ static int soapysdr_auto_gain(SoapySDRDevice *dev, int verbose)
         // even though it logs HACKRF_ERROR_INVALID_PARAM? https://github.com/rxseger/rx_tools/issues/9
         // Total gain is distributed amongst all gains, 116 = 37,65,1; the LNA is OK (<40) but VGA is out of range (65 > 62)
         // TODO: generic means to set all gains, of any SDR? string parsing LNA=#,VGA=#,AMP=#?
-        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, 0, "LNA", 40.); // max 40
+        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, channel, "LNA", 40.); // max 40
         if (r != 0) {
             fprintf(stderr, "WARNING: Failed to set LNA tuner gain.\n");
         }
-        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, 0, "VGA", 20.); // max 65
+        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, channel, "VGA", 20.); // max 65
         if (r != 0) {
             fprintf(stderr, "WARNING: Failed to set VGA tuner gain.\n");
         }
-        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, 0, "AMP", 0.); // on or off
+        r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, channel, "AMP", 0.); // on or off
         if (r != 0) {
             fprintf(stderr, "WARNING: Failed to set AMP tuner gain.\n");
         }
@@ -693,7 +833,7 @@ static int soapysdr_auto_gain(SoapySDRDevice *dev, int verbose)
     return r;
 }
 
-static int soapysdr_gain_str_set(SoapySDRDevice *dev, char const *gain_str, int verbose)
+static int soapysdr_gain_str_set(SoapySDRDevice *dev, size_t channel, char const *gain_str, int verbose)
 {
     if (!gain_str || !*gain_str || strlen(gain_str) >= GAIN_STR_MAX_SIZE)
         return -1;
@@ -701,9 +841,9 @@ static int soapysdr_gain_str_set(SoapySDRDevice *dev, char const *gain_str, int
     int r = 0;
 
     // Disable automatic gain
-    r = SoapySDRDevice_hasGainMode(dev, SOAPY_SDR_RX, 0);
+    r = SoapySDRDevice_hasGainMode(dev, SOAPY_SDR_RX, channel);
     if (r) {
-        r = SoapySDRDevice_setGainMode(dev, SOAPY_SDR_RX, 0, 0);
+        r = SoapySDRDevice_setGainMode(dev, SOAPY_SDR_RX, channel, 0);
         if (r != 0) {
             fprintf(stderr, "WARNING: Failed to disable automatic gain.\n");
         }
@@ -725,7 +865,7 @@ static int soapysdr_gain_str_set(SoapySDRDevice *dev, char const *gain_str, int
             double num = atof(value);
             if (verbose)
                 fprintf(stderr, "Setting gain element %s: %f dB\n", name, num);
-            r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, 0, name, num);
+            r = SoapySDRDevice_setGainElement(dev, SOAPY_SDR_RX, channel, name, num);
             if (r != 0) {
                 fprintf(stderr, "WARNING: setGainElement(%s, %f) failed: %d\n", name, num, r);
             }
@@ -734,7 +874,7 @@ static int soapysdr_gain_str_set(SoapySDRDevice *dev, char const *gain_str, int
     else {
         // Set overall gain and let SoapySDR distribute amongst components
         double value = atof(gain_str);
-        r = SoapySDRDevice_setGain(dev, SOAPY_SDR_RX, 0, value);
+        r = SoapySDRDevice_setGain(dev, SOAPY_SDR_RX, channel, value);
         if (r != 0) {
             fprintf(stderr, "WARNING: Failed to set tuner gain.\n");
         }
@@ -745,10 +885,10 @@ static int soapysdr_gain_str_set(SoapySDRDevice *dev, char const *gain_str, int
         // read back and print each individual gain element
         if (verbose) {
             size_t len = 0;
-            char **gains = SoapySDRDevice_listGains(dev, SOAPY_SDR_RX, 0, &len);
+            char **gains = SoapySDRDevice_listGains(dev, SOAPY_SDR_RX, channel, &len);
             fprintf(stderr, "Gain elements: ");
             for (size_t i = 0; i < len; ++i) {
-                double gain = SoapySDRDevice_getGain(dev, SOAPY_SDR_RX, 0);
+                double gain = SoapySDRDevice_getGain(dev, SOAPY_SDR_RX, channel);
                 fprintf(stderr, "%s=%g ", gains[i], gain);
             }
             fprintf(stderr, "\n");
@@ -867,7 +1007,34 @@ static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbos
         return -1; // NOTE: returns error on alloc failure.
     }
 
-    dev->soapy_dev = SoapySDRDevice_makeStrArgs(dev_query);
+    // the channels=<n> option is ours, the other arguments are passed to SoapySDR
+    SoapySDRKwargs query_args = SoapySDRKwargs_fromString(dev_query);
+    SoapySDRKwargs dev_args   = {0};
+    unsigned channel_num      = 1;
+    for (size_t i = 0; i < query_args.size; ++i) {
+        if (!strcmp(query_args.keys[i], "channels"))
+            channel_num = atouint32_metric(query_args.vals[i], "-d channels: ");
+        else
+            SoapySDRKwargs_set(&dev_args, query_args.keys[i], query_args.vals[i]);
+    }
+    SoapySDRKwargs_clear(&query_args);
+    if (channel_num < 1 || channel_num > SDR_MAX_DEVICES) {
+        fprintf(stderr, "%s: channels must be 1 to %d\n", __func__, SDR_MAX_DEVICES);
+        SoapySDRKwargs_clear(&dev_args);
+        free(dev);
+        return -1;
+    }
+#ifndef THREADS
+    if (channel_num > 1) {
+        fprintf(stderr, "%s: built without threads support, can not read several channels\n", __func__);
+        SoapySDRKwargs_clear(&dev_args);
+        free(dev);
+        return -1;
+    }
+#endif
+
+    dev->soapy_dev = SoapySDRDevice_make(&dev_args);
+    SoapySDRKwargs_clear(&dev_args);
     if (!dev->soapy_dev) {
         if (verbose)
             fprintf(stderr, "Failed to open sdr device matching '%s'.\n", dev_query);
@@ -887,6 +1054,7 @@ static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbos
         selected_format = SOAPY_SDR_CU8;
         dev->sample_size = sizeof(uint8_t); // CU8
         dev->sample_signed = 0;
+        dev->soapy_native  = 1;
     }
 //    else if (!strcmp(SOAPY_SDR_CS8, native_format)) {
 //        // TODO: CS8 needs conversion to CU8
@@ -901,6 +1069,7 @@ static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbos
         selected_format = SOAPY_SDR_CS16;
         dev->sample_size = sizeof(int16_t) * 2; // CS16
         dev->sample_signed = 1;
+        dev->soapy_native  = dev->fullScale >= 32767.0; // no rescale needed
     }
     else {
         // force CS16
@@ -925,16 +1094,33 @@ static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbos
     sprintf(p, "}");
     SoapySDRKwargs_clear(&args);
 
+    size_t num_channels = SoapySDRDevice_getNumChannels(dev->soapy_dev, SOAPY_SDR_RX);
+    if (channel_num > num_channels) {
+        fprintf(stderr, "%s: the device has only %zu RX channels\n", __func__, num_channels);
+        SoapySDRDevice_unmake(dev->soapy_dev);
+        free(dev->dev_info);
+        free(dev);
+        return -1;
+    }
+    size_t channels[SDR_MAX_DEVICES];
+    for (unsigned i = 0; i < channel_num; ++i) {
+        channels[i] = i;
+    }
+    dev->soapy_channel_num = channel_num;
+
+    // a single channel keeps the default stream setup
+    size_t const *stream_channels = channel_num > 1 ? channels : NULL;
+    size_t stream_channel_num     = channel_num > 1 ? channel_num : 0;
     SoapySDRKwargs stream_args = {0};
     int r;
 #if SOAPY_SDR_API_VERSION >= 0x00080000
     // API version 0.8
 #undef SoapySDRDevice_setupStream
-    dev->soapy_stream = SoapySDRDevice_setupStream(dev->soapy_dev, SOAPY_SDR_RX, selected_format, NULL, 0, &stream_args);
+    dev->soapy_stream = SoapySDRDevice_setupStream(dev->soapy_dev, SOAPY_SDR_RX, selected_format, stream_channels, stream_channel_num, &stream_args);
     r = dev->soapy_stream == NULL;
 #else
     // API version 0.7
-    r = SoapySDRDevice_setupStream(dev->soapy_dev, &dev->soapy_stream, SOAPY_SDR_RX, selected_format, NULL, 0, &stream_args);
+    r = SoapySDRDevice_setupStream(dev->soapy_dev, &dev->soapy_stream, SOAPY_SDR_RX, selected_format, stream_channels, stream_channel_num, &stream_args);
 #endif
     if (r != 0) {
         if (verbose)
@@ -942,22 +1128,132 @@ static int sdr_open_soapy(sdr_dev_t **out_dev, char const *dev_query, int verbos
         free(dev);
         return -3;
     }
+    if (channel_num > 1)
+        fprintf(stderr, "Reading %u RX channels in one stream.\n", channel_num);
 
     *out_dev = dev;
     return 0;
 }
 
+/// Pass the events of another channel on to the ring the channel handle reads into.
+static void soapysdr_channel_push(sdr_dev_t *ch, sdr_event_t *ev)
+{
+#ifdef THREADS
+    if (ch && ch->ring_owner && ch->ring_running) {
+        if (ev)
+            ring_push(ev, ch);
+        apply_changes(ch, ring_push, ch);
+        return;
+    }
+#else
+    (void)ev;
+#endif
+    if (ch)
+        apply_changes(ch, NULL, NULL); // not read, the changes are still applied
+}
+
+/// Count an overflow of the device, the samples dropped are told by the time of the next buffer.
+static void soapysdr_overflow(sdr_dev_t *dev)
+{
+    dev->overflows++;
+    dev->soapy_overflow = 1;
+    fprintf(stderr, "O");
+    fflush(stderr);
+}
+
+/// Track the stream time of a buffer, returns the samples dropped right before the buffer after an overflow.
+static unsigned soapysdr_track_time(sdr_dev_t *dev, int flags, long long time_ns, size_t n_elems)
+{
+    int overflow        = dev->soapy_overflow;
+    dev->soapy_overflow = 0;
+    if (!(flags & SOAPY_SDR_HAS_TIME) || !dev->sample_rate) {
+        dev->soapy_next_ns = 0;
+        return 0; // the samples dropped are unknown
+    }
+    long long gap = 0;
+    if (overflow && dev->soapy_next_ns && time_ns > dev->soapy_next_ns)
+        gap = (time_ns - dev->soapy_next_ns) * dev->sample_rate / 1000000000;
+    dev->soapy_next_ns = time_ns + (long long)n_elems * 1000000000 / dev->sample_rate;
+    if (gap > UINT_MAX)
+        gap = UINT_MAX;
+    dev->dropped_samples += gap;
+    return (unsigned)gap;
+}
+
+/** Read with direct access to the buffers of the driver, the samples are not copied by SoapySDR.
+
+    The blocks are as the driver has them, up to the stream MTU, and are passed on in pieces of at most
+    buf_len while the buffer is held. Only used with an acquisition thread, the ring copies the samples.
+*/
+static int soapysdr_read_direct(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_len)
+{
+    long timeoutUs = 1000000; // 1 second
+
+    dev->running = 1;
+    do {
+        size_t handle;
+        void const *buffs[1];
+        int flags        = 0;
+        long long timeNs = 0;
+        int r = SoapySDRDevice_acquireReadBuffer(dev->soapy_dev, dev->soapy_stream, &handle, buffs, &flags, &timeNs, timeoutUs);
+        if (r < 0) {
+            if (r == SOAPY_SDR_OVERFLOW)
+                soapysdr_overflow(dev);
+            else if (r != SOAPY_SDR_TIMEOUT)
+                fprintf(stderr, "WARNING: sync read failed. %d\n", r);
+            apply_changes(dev, cb, ctx);
+            continue;
+        }
+
+        unsigned lost   = soapysdr_track_time(dev, flags, timeNs, (size_t)r);
+        uint8_t const *p = buffs[0];
+        size_t len       = (size_t)r * dev->sample_size;
+        dev->polling     = 1;
+        while (len > 0) {
+            size_t n = len < buf_len ? len : buf_len;
+            sdr_event_t ev = {
+                    .ev   = SDR_EV_DATA,
+                    .buf  = (void *)p,
+                    .len  = (int)n,
+                    .lost = lost,
+            };
+            cb(&ev, ctx);
+            lost = 0;
+            p += n;
+            len -= n;
+        }
+        dev->polling = 0;
+        SoapySDRDevice_releaseReadBuffer(dev->soapy_dev, dev->soapy_stream, handle);
+        apply_changes(dev, cb, ctx);
+
+    } while (dev->running);
+
+    return 0;
+}
+
 static int soapysdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
 {
-    size_t buffer_size = buf_num * buf_len;
-    if (dev->buffer_size != buffer_size) {
-        free(dev->buffer);
-        dev->buffer = malloc(buffer_size);
+    unsigned channel_num = dev->soapy_channel_num ? dev->soapy_channel_num : 1;
+
+#ifdef THREADS
+    // the driver buffers are held only while the ring copies them, a single channel in the native format
+    if (dev->ring_running && channel_num == 1 && dev->soapy_native
+            && SoapySDRDevice_getNumDirectAccessBuffers(dev->soapy_dev, dev->soapy_stream) > 0) {
+        fprintf(stderr, "Reading the driver buffers directly, MTU %zu samples.\n",
+                SoapySDRDevice_getStreamMTU(dev->soapy_dev, dev->soapy_stream));
+        return soapysdr_read_direct(dev, cb, ctx, buf_len);
+    }
+#endif
+
+    size_t buffer_size   = buf_num * buf_len;
+    if (dev->buffer_size != buffer_size * channel_num) {
+        huge_buf_free(dev->buffer);
+        dev->buffer = huge_buf_create(buffer_size * channel_num);
         if (!dev->buffer) {
             WARN_MALLOC("soapysdr_read_loop()");
             return -1; // NOTE: returns error on alloc failure.
         }
-        dev->buffer_size = buffer_size;
+        dev->buffer_size = buffer_size * channel_num;
         dev->buffer_pos = 0;
     }
 
@@ -967,33 +1263,45 @@ static int soapysdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint
     do {
         if (dev->buffer_pos + buf_len > buffer_size)
             dev->buffer_pos = 0;
-        int16_t *buffer = (void *)&dev->buffer[dev->buffer_pos];
+        // each channel has a region of the buffer
+        int16_t *buffer[SDR_MAX_DEVICES];
+        for (unsigned c = 0; c < channel_num; ++c) {
+            buffer[c] = (void *)&dev->buffer[c * buffer_size + dev->buffer_pos];
+        }
         dev->buffer_pos += buf_len;
 
-        void *buffs[]    = {buffer};
+        void *buffs[SDR_MAX_DEVICES];
         int flags        = 0;
         long long timeNs = 0;
         long timeoutUs   = 1000000; // 1 second
         unsigned n_read  = 0, i;
+        int buf_flags    = 0; // flags and time of the first samples of the buffer
+        long long buf_ns = 0;
         int r;
 
         do {
-            buffs[0] = &buffer[n_read * 2];
+            for (unsigned c = 0; c < channel_num; ++c) {
+                buffs[c] = &buffer[c][n_read * 2];
+            }
             r  = SoapySDRDevice_readStream(dev->soapy_dev, dev->soapy_stream, buffs, buf_elems - n_read, &flags, &timeNs, timeoutUs);
             if (r < 0)
                 break;
+            if (!n_read) {
+                buf_flags = flags;
+                buf_ns    = timeNs;
+            }
             n_read += r; // r is number of elements read, elements=complex pairs, so buffer length is twice
             //fprintf(stderr, "readStream ret=%d, flags=%d, timeNs=%lld (%zu - %u)\n", r, flags, timeNs, buf_elems, n_read);
         } while (n_read < buf_elems);
         //fprintf(stderr, "readStream ret=%u (%u), flags=%d, timeNs=%lld\n", n_read, buf_len, flags, timeNs);
         if (r < 0) {
             if (r == SOAPY_SDR_OVERFLOW) {
-                fprintf(stderr, "O");
-                fflush(stderr);
+                soapysdr_overflow(dev);
                 continue;
             }
             fprintf(stderr, "WARNING: sync read failed. %d\n", r);
         }
+        unsigned lost = n_read > 0 ? soapysdr_track_time(dev, buf_flags, buf_ns, n_read) : 0;
 
         // convert to CS16 or CU8 if needed
         // if converting CS8 to CU8 -- vectorized with -O3
@@ -1002,20 +1310,23 @@ static int soapysdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint
 
         // TODO: SoapyRemote doesn't scale properly when reading (local) CS16 from (remote) CS8
         // rescale cs16 buffer
-        if (dev->fullScale >= 2047.0 && dev->fullScale <= 2048.0) {
-            for (i = 0; i < n_read * 2; ++i)
-                buffer[i] *= 16; // prevent left shift of negative value
-        }
-        else if (dev->fullScale < 32767.0) {
-            int upscale = 32768 / dev->fullScale;
-            for (i = 0; i < n_read * 2; ++i)
-                buffer[i] *= upscale;
+        for (unsigned c = 0; c < channel_num; ++c) {
+            if (dev->fullScale >= 2047.0 && dev->fullScale <= 2048.0) {
+                for (i = 0; i < n_read * 2; ++i)
+                    buffer[c][i] *= 16; // prevent left shift of negative value
+            }
+            else if (dev->fullScale < 32767.0) {
+                int upscale = 32768 / dev->fullScale;
+                for (i = 0; i < n_read * 2; ++i)
+                    buffer[c][i] *= upscale;
+            }
         }
 
         sdr_event_t ev = {
                 .ev  = SDR_EV_DATA,
-                .buf = buffer,
-                .len = n_read * dev->sample_size,
+                .buf  = buffer[0],
+                .len  = n_read * dev->sample_size,
+                .lost = lost,
         };
         dev->polling = 1;
         if (n_read > 0) // prevent a crash in callback
@@ -1023,6 +1334,16 @@ static int soapysdr_read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint
         dev->polling = 0;
         apply_changes(dev, cb, ctx);
 
+        // the other channels go to the rings their handles read into
+        for (unsigned c = 1; c < channel_num; ++c) {
+            sdr_event_t ch_ev = {
+                    .ev  = SDR_EV_DATA,
+                    .buf = buffer[c],
+                    .len = n_read * dev->sample_size,
+            };
+            soapysdr_channel_push(dev->soapy_channels[c], n_read > 0 ? &ch_ev : NULL);
+        }
+
     } while (dev->running);
 
     return 0;
@@ -1066,6 +1387,52 @@ int sdr_open(sdr_dev_t **out_dev, char const *dev_query, int verbose)
     return -1;
 }
 
+unsigned sdr_get_channel_num(sdr_dev_t *dev)
+{
+#ifdef SOAPYSDR
+    if (dev && dev->soapy_channel_num)
+        return dev->soapy_channel_num;
+#endif
+    (void)dev;
+    return 1;
+}
+
+int sdr_open_channel(sdr_dev_t **out_dev, sdr_dev_t *dev, unsigned channel)
+{
+#if defined(SOAPYSDR) && defined(THREADS)
+    if (!dev || dev->soapy_is_channel || channel < 1 || channel >= dev->soapy_channel_num || dev->soapy_channels[channel])
+        return -1;
+
+    sdr_dev_t *ch = calloc(1, sizeof(sdr_dev_t));
+    if (!ch) {
+        WARN_CALLOC("sdr_open_channel()");
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    ch->dev_info = strdup(dev->dev_info);
+    if (!ch->dev_info) {
+        WARN_STRDUP("sdr_open_channel()");
+        free(ch);
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    ch->soapy_dev        = dev->soapy_dev;
+    ch->fullScale        = dev->fullScale;
+    ch->soapy_channel    = channel;
+    ch->soapy_is_channel = 1;
+    ch->sample_size      = dev->sample_size;
+    ch->sample_signed    = dev->sample_signed;
+    ch->ring_fed         = 1;
+
+    dev->soapy_channels[channel] = ch;
+    *out_dev = ch;
+    return 0;
+#else
+    (void)out_dev;
+    (void)dev;
+    (void)channel;
+    return -1;
+#endif
+}
+
 int sdr_close(sdr_dev_t *dev)
 {
     if (!dev)
@@ -1077,7 +1444,9 @@ int sdr_close(sdr_dev_t *dev)
         ret = rtltcp_close(dev->rtl_tcp);
 
 #ifdef SOAPYSDR
-    if (dev->soapy_dev)
+    if (dev->soapy_is_channel)
+        ret = 0; // the device is closed with the first channel
+    else if (dev->soapy_dev)
         ret = SoapySDRDevice_unmake(dev->soapy_dev);
 #endif
 
@@ -1086,8 +1455,16 @@ int sdr_close(sdr_dev_t *dev)
         ret = rtlsdr_close(dev->rtlsdr_dev);
 #endif
 
+#ifdef THREADS
+    if (dev->ring_num) {
+        pthread_cond_destroy(&dev->space_cond);
+        pthread_cond_destroy(&dev->work_cond);
+        pthread_mutex_destroy(&dev->ring_lock);
+    }
+#endif
+
     free(dev->dev_info);
-    free(dev->buffer);
+    huge_buf_free(dev->buffer);
     free(dev);
     return ret;
 }
@@ -1116,21 +1493,16 @@ int sdr_get_sample_signed(sdr_dev_t *dev)
     return dev->sample_signed;
 }
 
-int sdr_set_center_freq(sdr_dev_t *dev, uint32_t freq, int verbose)
+unsigned sdr_get_overflows(sdr_dev_t *dev)
 {
     if (!dev)
-        return -1;
-
-    if (dev->polling) {
-        dev->center_frequency = freq;
-        dev->apply_freq       = 1;
-#ifdef RTLSDR
-        if (dev->rtlsdr_dev)
-            rtlsdr_cancel_async(dev->rtlsdr_dev);
-#endif
         return 0;
-    }
 
+    return dev->overflows;
+}
+
+static int set_center_freq(sdr_dev_t *dev, uint32_t freq, int verbose)
+{
     int r = -1;
 
     if (dev->rtl_tcp) {
@@ -1141,7 +1513,7 @@ int sdr_set_center_freq(sdr_dev_t *dev, uint32_t freq, int verbose)
 #ifdef SOAPYSDR
     SoapySDRKwargs args = {0};
     if (dev->soapy_dev) {
-        r = SoapySDRDevice_setFrequency(dev->soapy_dev, SOAPY_SDR_RX, 0, (double)freq, &args);
+        r = SoapySDRDevice_setFrequency(dev->soapy_dev, SOAPY_SDR_RX, dev->soapy_channel, (double)freq, &args);
     }
 #endif
 
@@ -1159,6 +1531,26 @@ int sdr_set_center_freq(sdr_dev_t *dev, uint32_t freq, int verbose)
     return r;
 }
 
+int sdr_set_center_freq(sdr_dev_t *dev, uint32_t freq, int verbose)
+{
+    if (!dev)
+        return -1;
+
+    if (defer_changes(dev)) {
+        lock_changes(dev);
+        dev->center_frequency = freq;
+        dev->apply_freq       = 1;
+        unlock_changes(dev);
+#ifdef RTLSDR
+        if (dev->rtlsdr_dev)
+            rtlsdr_cancel_async(dev->rtlsdr_dev);
+#endif
+        return 0;
+    }
+
+    return set_center_freq(dev, freq, verbose);
+}
+
 uint32_t sdr_get_center_freq(sdr_dev_t *dev)
 {
     if (!dev)
@@ -1169,7 +1561,7 @@ uint32_t sdr_get_center_freq(sdr_dev_t *dev)
 
 #ifdef SOAPYSDR
     if (dev->soapy_dev)
-        return (uint32_t)SoapySDRDevice_getFrequency(dev->soapy_dev, SOAPY_SDR_RX, 0);
+        return (uint32_t)SoapySDRDevice_getFrequency(dev->soapy_dev, SOAPY_SDR_RX, dev->soapy_channel);
 #endif
 
 #ifdef RTLSDR
@@ -1180,21 +1572,8 @@ uint32_t sdr_get_center_freq(sdr_dev_t *dev)
     return 0;
 }
 
-int sdr_set_freq_correction(sdr_dev_t *dev, int ppm, int verbose)
+static int set_freq_correction(sdr_dev_t *dev, int ppm, int verbose)
 {
-    if (!dev)
-        return -1;
-
-    if (dev->polling) {
-        dev->freq_correction = ppm;
-        dev->apply_corr      = 1;
-#ifdef RTLSDR
-        if (dev->rtlsdr_dev)
-            rtlsdr_cancel_async(dev->rtlsdr_dev);
-#endif
-        return 0;
-    }
-
     int r = -1;
 
     if (dev->rtl_tcp)
@@ -1202,7 +1581,7 @@ int sdr_set_freq_correction(sdr_dev_t *dev, int ppm, int verbose)
 
 #ifdef SOAPYSDR
     if (dev->soapy_dev)
-        r = SoapySDRDevice_setFrequencyComponent(dev->soapy_dev, SOAPY_SDR_RX, 0, "CORR", (double)ppm, NULL);
+        r = SoapySDRDevice_setFrequencyComponent(dev->soapy_dev, SOAPY_SDR_RX, dev->soapy_channel, "CORR", (double)ppm, NULL);
 #endif
 
 #ifdef RTLSDR
@@ -1222,15 +1601,16 @@ int sdr_set_freq_correction(sdr_dev_t *dev, int ppm, int verbose)
     return r;
 }
 
-int sdr_set_auto_gain(sdr_dev_t *dev, int verbose)
+int sdr_set_freq_correction(sdr_dev_t *dev, int ppm, int verbose)
 {
     if (!dev)
         return -1;
 
-    if (dev->polling) {
-        free(dev->gain_str);
-        dev->gain_str   = NULL; // auto gain
-        dev->apply_gain = 1;
+    if (defer_changes(dev)) {
+        lock_changes(dev);
+        dev->freq_correction = ppm;
+        dev->apply_corr      = 1;
+        unlock_changes(dev);
 #ifdef RTLSDR
         if (dev->rtlsdr_dev)
             rtlsdr_cancel_async(dev->rtlsdr_dev);
@@ -1238,6 +1618,11 @@ int sdr_set_auto_gain(sdr_dev_t *dev, int verbose)
         return 0;
     }
 
+    return set_freq_correction(dev, ppm, verbose);
+}
+
+static int set_auto_gain(sdr_dev_t *dev, int verbose)
+{
     int r = -1;
 
     if (dev->rtl_tcp)
@@ -1245,7 +1630,7 @@ int sdr_set_auto_gain(sdr_dev_t *dev, int verbose)
 
 #ifdef SOAPYSDR
     if (dev->soapy_dev)
-        r = soapysdr_auto_gain(dev->soapy_dev, verbose);
+        r = soapysdr_auto_gain(dev->soapy_dev, dev->soapy_channel, verbose);
 #endif
 
 #ifdef RTLSDR
@@ -1262,22 +1647,17 @@ int sdr_set_auto_gain(sdr_dev_t *dev, int verbose)
     return r;
 }
 
-int sdr_set_tuner_gain(sdr_dev_t *dev, char const *gain_str, int verbose)
+int sdr_set_auto_gain(sdr_dev_t *dev, int verbose)
 {
     if (!dev)
         return -1;
 
-    if (dev->polling) {
+    if (defer_changes(dev)) {
+        lock_changes(dev);
         free(dev->gain_str);
-        if (!gain_str) {
-            dev->gain_str = NULL; // auto gain
-        }
-        else {
-            dev->gain_str = strdup(gain_str);
-            if (!dev->gain_str)
-                WARN_STRDUP("set_gain_str()");
-        }
+        dev->gain_str   = NULL; // auto gain
         dev->apply_gain = 1;
+        unlock_changes(dev);
 #ifdef RTLSDR
         if (dev->rtlsdr_dev)
             rtlsdr_cancel_async(dev->rtlsdr_dev);
@@ -1285,23 +1665,28 @@ int sdr_set_tuner_gain(sdr_dev_t *dev, char const *gain_str, int verbose)
         return 0;
     }
 
+    return set_auto_gain(dev, verbose);
+}
+
+static int set_tuner_gain(sdr_dev_t *dev, char const *gain_str, int verbose)
+{
     int r = -1;
 
     if (!gain_str || !*gain_str) {
         /* Enable automatic gain */
-        return sdr_set_auto_gain(dev, verbose);
+        return set_auto_gain(dev, verbose);
     }
 
 #ifdef SOAPYSDR
     /* Enable manual gain */
     if (dev->soapy_dev)
-        return soapysdr_gain_str_set(dev->soapy_dev, gain_str, verbose);
+        return soapysdr_gain_str_set(dev->soapy_dev, dev->soapy_channel, gain_str, verbose);
 #endif
 
     int gain = (int)(atof(gain_str) * 10); /* tenths of a dB */
     if (gain == 0) {
         /* Enable automatic gain */
-        return sdr_set_auto_gain(dev, verbose);
+        return set_auto_gain(dev, verbose);
     }
 
     if (dev->rtl_tcp) {
@@ -1330,6 +1715,34 @@ int sdr_set_tuner_gain(sdr_dev_t *dev, char const *gain_str, int verbose)
     return r;
 }
 
+int sdr_set_tuner_gain(sdr_dev_t *dev, char const *gain_str, int verbose)
+{
+    if (!dev)
+        return -1;
+
+    if (defer_changes(dev)) {
+        lock_changes(dev);
+        free(dev->gain_str);
+        if (!gain_str) {
+            dev->gain_str = NULL; // auto gain
+        }
+        else {
+            dev->gain_str = strdup(gain_str);
+            if (!dev->gain_str)
+                WARN_STRDUP("set_gain_str()");
+        }
+        dev->apply_gain = 1;
+        unlock_changes(dev);
+#ifdef RTLSDR
+        if (dev->rtlsdr_dev)
+            rtlsdr_cancel_async(dev->rtlsdr_dev);
+#endif
+        return 0;
+    }
+
+    return set_tuner_gain(dev, gain_str, verbose);
+}
+
 int sdr_set_antenna(sdr_dev_t *dev, char const *antenna_str, int verbose)
 {
     if (!dev)
@@ -1343,14 +1756,14 @@ int sdr_set_antenna(sdr_dev_t *dev, char const *antenna_str, int verbose)
 
 #ifdef SOAPYSDR
     if (dev->soapy_dev) {
-        r = SoapySDRDevice_setAntenna(dev->soapy_dev, SOAPY_SDR_RX, 0, antenna_str);
+        r = SoapySDRDevice_setAntenna(dev->soapy_dev, SOAPY_SDR_RX, dev->soapy_channel, antenna_str);
 
         if (verbose) {
             if (r < 0)
                 fprintf(stderr, "WARNING: Failed to set antenna.\n");
 
             // report the antenna that is actually used
-            char *antenna = SoapySDRDevice_getAntenna(dev->soapy_dev, SOAPY_SDR_RX, 0);
+            char *antenna = SoapySDRDevice_getAntenna(dev->soapy_dev, SOAPY_SDR_RX, dev->soapy_channel);
             fprintf(stderr, "Antenna set to '%s'.\n", antenna);
             free(antenna);
         }
@@ -1364,21 +1777,8 @@ int sdr_set_antenna(sdr_dev_t *dev, char const *antenna_str, int verbose)
   return r;
 }
 
-int sdr_set_sample_rate(sdr_dev_t *dev, uint32_t rate, int verbose)
+static int set_sample_rate(sdr_dev_t *dev, uint32_t rate, int verbose)
 {
-    if (!dev)
-        return -1;
-
-    if (dev->polling) {
-        dev->sample_rate = rate;
-        dev->apply_rate  = 1;
-#ifdef RTLSDR
-        if (dev->rtlsdr_dev)
-            rtlsdr_cancel_async(dev->rtlsdr_dev);
-#endif
-        return 0;
-    }
-
     int r = -1;
 
     if (dev->rtl_tcp) {
@@ -1388,7 +1788,7 @@ int sdr_set_sample_rate(sdr_dev_t *dev, uint32_t rate, int verbose)
 
 #ifdef SOAPYSDR
     if (dev->soapy_dev)
-        r = SoapySDRDevice_setSampleRate(dev->soapy_dev, SOAPY_SDR_RX, 0, (double)rate);
+        r = SoapySDRDevice_setSampleRate(dev->soapy_dev, SOAPY_SDR_RX, dev->soapy_channel, (double)rate);
 #endif
 
 #ifdef RTLSDR
@@ -1405,6 +1805,26 @@ int sdr_set_sample_rate(sdr_dev_t *dev, uint32_t rate, int verbose)
     return r;
 }
 
+int sdr_set_sample_rate(sdr_dev_t *dev, uint32_t rate, int verbose)
+{
+    if (!dev)
+        return -1;
+
+    if (defer_changes(dev)) {
+        lock_changes(dev);
+        dev->sample_rate = rate;
+        dev->apply_rate  = 1;
+        unlock_changes(dev);
+#ifdef RTLSDR
+        if (dev->rtlsdr_dev)
+            rtlsdr_cancel_async(dev->rtlsdr_dev);
+#endif
+        return 0;
+    }
+
+    return set_sample_rate(dev, rate, verbose);
+}
+
 uint32_t sdr_get_sample_rate(sdr_dev_t *dev)
 {
     if (!dev)
@@ -1415,7 +1835,7 @@ uint32_t sdr_get_sample_rate(sdr_dev_t *dev)
 
 #ifdef SOAPYSDR
     if (dev->soapy_dev)
-        return (uint32_t)SoapySDRDevice_getSampleRate(dev->soapy_dev, SOAPY_SDR_RX, 0);
+        return (uint32_t)SoapySDRDevice_getSampleRate(dev->soapy_dev, SOAPY_SDR_RX, dev->soapy_channel);
 #endif
 
 #ifdef RTLSDR
@@ -1475,14 +1895,14 @@ int sdr_apply_settings(sdr_dev_t *dev, char const *sdr_settings, int verbose)
             if (verbose)
                 fprintf(stderr, "Setting %s to %s\n", key, value);
             if (!strcmp(key, "antenna")) {
-                if (SoapySDRDevice_setAntenna(dev->soapy_dev, SOAPY_SDR_RX, 0, value) != 0) {
+                if (SoapySDRDevice_setAntenna(dev->soapy_dev, SOAPY_SDR_RX, dev->soapy_channel, value) != 0) {
                     r = -1;
                     fprintf(stderr, "WARNING: Antenna setting failed: %s\n", SoapySDRDevice_lastError());
                 }
             }
             else if (!strcmp(key, "bandwidth")) {
                 uint32_t f_value = atouint32_metric(value, "-t bandwidth= ");
-                if (SoapySDRDevice_setBandwidth(dev->soapy_dev, SOAPY_SDR_RX, 0, (double)f_value) != 0) {
+                if (SoapySDRDevice_setBandwidth(dev->soapy_dev, SOAPY_SDR_RX, dev->soapy_channel, (double)f_value) != 0) {
                     r = -1;
                     fprintf(stderr, "WARNING: Bandwidth setting failed: %s\n", SoapySDRDevice_lastError());
                 }
@@ -1548,7 +1968,7 @@ int sdr_activate(sdr_dev_t *dev)
         return -1;
 
 #ifdef SOAPYSDR
-    if (dev->soapy_dev) {
+    if (dev->soapy_dev && !dev->soapy_is_channel) {
         if (SoapySDRDevice_activateStream(dev->soapy_dev, dev->soapy_stream, 0, 0, 0) != 0) {
             fprintf(stderr, "Failed to activate stream\n");
             exit(1);
@@ -1565,7 +1985,7 @@ int sdr_deactivate(sdr_dev_t *dev)
         return -1;
 
 #ifdef SOAPYSDR
-    if (dev->soapy_dev) {
+    if (dev->soapy_dev && !dev->soapy_is_channel) {
         SoapySDRDevice_deactivateStream(dev->soapy_dev, dev->soapy_stream, 0, 0);
         SoapySDRDevice_closeStream(dev->soapy_dev, dev->soapy_stream);
     }
@@ -1593,6 +2013,277 @@ int sdr_reset(sdr_dev_t *dev, int verbose)
     return r;
 }
 
+static int read_loop(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
+{
+    if (dev->rtl_tcp)
+        return rtltcp_read_loop(dev, cb, ctx, buf_num, buf_len);
+
+#ifdef SOAPYSDR
+    if (dev->soapy_dev)
+        return soapysdr_read_loop(dev, cb, ctx, buf_num, buf_len);
+#endif
+
+#ifdef RTLSDR
+    if (dev->rtlsdr_dev)
+        return rtlsdr_read_loop(dev, cb, ctx, buf_num, buf_len);
+#endif
+
+    return -1;
+}
+
+#ifdef THREADS
+
+/// Queue an event from the read loop, data is dropped if the ring is full unless the source blocks, changes wait for a free slot.
+static void ring_push(sdr_event_t *ev, void *ctx)
+{
+    sdr_dev_t *src = ctx;
+    sdr_dev_t *dev = src->ring_owner ? src->ring_owner : src;
+
+    pthread_mutex_lock(&dev->ring_lock);
+    iq_buf_t *iq = NULL;
+    if (ev->ev == SDR_EV_DATA)
+        src->buffer_seq++; // a dropped buffer skips its number
+    while (ev->ev == SDR_EV_DATA && src->ring_block && dev->ring_reserved == dev->ring_size) {
+        pthread_cond_wait(&dev->space_cond, &dev->ring_lock); // the source is throttled, e.g. by TCP back-pressure
+    }
+    if (ev->ev == SDR_EV_DATA && dev->ring_reserved < dev->ring_size && (uint32_t)ev->len <= dev->ring_len)
+        iq = iq_pool_get(dev->ring_pool); // free unless the consumers retain more than the spare buffers
+    if (ev->ev == SDR_EV_DATA && !iq) {
+        unsigned lost = src->sample_size ? ev->len / src->sample_size : 0;
+        src->lost_pending += lost;
+        src->lost_samples += lost;
+        pthread_mutex_unlock(&dev->ring_lock);
+        return;
+    }
+    while (dev->ring_reserved == dev->ring_size) {
+        pthread_cond_wait(&dev->space_cond, &dev->ring_lock);
+    }
+    unsigned idx          = (dev->ring_first + dev->ring_reserved) % dev->ring_size;
+    sdr_ring_slot_t *slot = &dev->ring_slots[idx];
+    dev->ring_reserved++;
+    slot->ev  = *ev;
+    slot->src = src;
+    if (ev->ev == SDR_EV_DATA) {
+        slot->ev.lost     = ev->lost + src->lost_pending;
+        slot->ev.seq      = src->buffer_seq;
+        src->lost_pending = 0;
+    }
+    pthread_mutex_unlock(&dev->ring_lock);
+
+    // the slot is not queued yet, copy without holding the lock
+    if (ev->ev == SDR_EV_DATA) {
+        struct timeval now;
+        get_time_now(&now);
+        slot->ev.time_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+        slot->ev.buf     = iq->data;
+        slot->ev.iq      = iq;
+        memcpy(slot->ev.buf, ev->buf, ev->len);
+    }
+    if (ev->gain_str) {
+        snprintf(slot->gain_str, sizeof(slot->gain_str), "%s", ev->gain_str);
+        slot->ev.gain_str = slot->gain_str;
+    }
+
+    pthread_mutex_lock(&dev->ring_lock);
+    slot->ready = 1;
+    // other devices may have filled later slots meanwhile, queue all that are ready in order
+    unsigned queued = dev->ring_count;
+    while (dev->ring_count < dev->ring_reserved && dev->ring_slots[(dev->ring_first + dev->ring_count) % dev->ring_size].ready) {
+        dev->ring_count++;
+    }
+    if (!dev->ring_batch_ms) {
+        pthread_cond_signal(&dev->work_cond);
+    }
+    else if (!queued && dev->ring_count) {
+        struct timeval now;
+        get_time_now(&now);
+        dev->ring_due_us = (int64_t)now.tv_sec * 1000000 + now.tv_usec + (int64_t)dev->ring_batch_ms * 1000;
+        pthread_cond_signal(&dev->work_cond); // the consumer starts to wait for the due time
+    }
+    else if (dev->ring_count * 2 >= dev->ring_size) {
+        pthread_cond_signal(&dev->work_cond); // hand over early, before the ring fills
+    }
+    pthread_mutex_unlock(&dev->ring_lock);
+}
+
+/// Check if the queued slots are handed over, wait for the due time of a burst otherwise.
+static int ring_ready(sdr_dev_t *dev)
+{
+    if (!dev->ring_count)
+        return 0;
+    if (!dev->ring_batch_ms || dev->ring_draining || !dev->ring_active || dev->ring_count * 2 >= dev->ring_size)
+        return 1;
+
+    struct timeval now;
+    get_time_now(&now);
+    int64_t wait_us = dev->ring_due_us - ((int64_t)now.tv_sec * 1000000 + now.tv_usec);
+    if (wait_us <= 0)
+        return 1;
+#ifdef _MSC_VER
+    SleepConditionVariableCS(&dev->work_cond, dev->ring_lock, (DWORD)(wait_us / 1000 + 1));
+#else
+    struct timespec due = {
+            .tv_sec  = (time_t)(dev->ring_due_us / 1000000),
+            .tv_nsec = (long)(dev->ring_due_us % 1000000) * 1000,
+    };
+    pthread_cond_timedwait(&dev->work_cond, &dev->ring_lock, &due);
+#endif
+    return 0;
+}
+
+static THREAD_RETURN THREAD_CALL ring_thread(void *arg)
+{
+    sdr_dev_t *src = arg;
+    sdr_dev_t *dev = src->ring_owner ? src->ring_owner : src;
+
+    thread_pin_self(THREAD_ACQUIRE);
+    int r = read_loop(src, ring_push, src, dev->ring_buf_num, dev->ring_len);
+
+    pthread_mutex_lock(&dev->ring_lock);
+    int first = !dev->ring_stop;
+    if (first) {
+        dev->ring_stop = 1;
+        dev->ring_ret  = r;
+    }
+    dev->ring_active--;
+    pthread_cond_signal(&dev->work_cond);
+    pthread_mutex_unlock(&dev->ring_lock);
+
+    // the devices are read together, stop the others if one read loop returned
+    if (first && dev->ring_member_num) {
+        sdr_stop(dev);
+        for (unsigned i = 0; i < dev->ring_member_num; ++i) {
+            sdr_stop(dev->ring_members[i]);
+        }
+    }
+    return (THREAD_RETURN)0;
+}
+
+/// Read on the acquisition threads and run the callbacks for the queued events on this thread.
+static int ring_start(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
+{
+    dev->ring_size = dev->ring_num * (1 + dev->ring_member_num);
+    dev->ring_pool = iq_pool_create(dev->ring_size + SDR_RING_SPARE, buf_len, SDR_RING_SPARE);
+    if (!dev->ring_pool) {
+        WARN_MALLOC("ring_start()");
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    dev->ring_slots = calloc(dev->ring_size, sizeof(*dev->ring_slots));
+    if (!dev->ring_slots) {
+        WARN_CALLOC("ring_start()");
+        iq_pool_free(dev->ring_pool);
+        dev->ring_pool = NULL;
+        return -1; // NOTE: returns error on alloc failure.
+    }
+    dev->ring_buf_num  = buf_num;
+    dev->ring_len      = buf_len;
+    dev->ring_first    = 0;
+    dev->ring_reserved = 0;
+    dev->ring_count    = 0;
+    dev->ring_stop     = 0;
+    dev->ring_ret      = 0;
+    dev->ring_draining = 0;
+    dev->ring_active   = 1 + dev->ring_member_num;
+
+    // the owner is read on the first thread, the members on the others
+    sdr_dev_t *devs[SDR_MAX_DEVICES] = {dev};
+    for (unsigned i = 0; i < dev->ring_member_num; ++i) {
+        devs[i + 1] = dev->ring_members[i];
+    }
+    unsigned num_devs            = 1 + dev->ring_member_num;
+    int started[SDR_MAX_DEVICES] = {0};
+    for (unsigned i = 0; i < num_devs; ++i) {
+        devs[i]->lost_pending = 0;
+        devs[i]->ring_running = 1;
+        if (devs[i]->ring_fed)
+            dev->ring_active--; // read by the read loop of another device
+    }
+
+#ifndef _WIN32
+    // Block all signals from the acquisition thread
+    sigset_t sigset;
+    sigset_t oldset;
+    sigfillset(&sigset);
+    pthread_sigmask(SIG_SETMASK, &sigset, &oldset);
+#endif
+    for (unsigned i = 0; i < num_devs; ++i) {
+        if (devs[i]->ring_fed)
+            continue;
+        int r = pthread_create(&devs[i]->ring_thread, NULL, ring_thread, devs[i]);
+        if (!r) {
+            started[i] = 1;
+            continue;
+        }
+        fprintf(stderr, "%s: error in pthread_create, rc: %d\n", __func__, r);
+        devs[i]->ring_running = 0;
+        pthread_mutex_lock(&dev->ring_lock);
+        if (!dev->ring_stop) {
+            dev->ring_stop = 1;
+            dev->ring_ret  = -1;
+        }
+        dev->ring_active--;
+        pthread_mutex_unlock(&dev->ring_lock);
+    }
+#ifndef _WIN32
+    pthread_sigmask(SIG_SETMASK, &oldset, NULL);
+#endif
+    if (dev->ring_ret < 0) {
+        for (unsigned i = 0; i < num_devs; ++i) {
+            if (started[i])
+                sdr_stop(devs[i]);
+        }
+    }
+
+    for (;;) {
+        pthread_mutex_lock(&dev->ring_lock);
+        while (!ring_ready(dev) && (dev->ring_count || dev->ring_active)) {
+            if (!dev->ring_count)
+                pthread_cond_wait(&dev->work_cond, &dev->ring_lock);
+        }
+        if (!dev->ring_count) {
+            pthread_mutex_unlock(&dev->ring_lock);
+            break; // the read loops returned and all events are handled
+        }
+        sdr_ring_slot_t *slot = &dev->ring_slots[dev->ring_first];
+        sdr_event_t ev        = slot->ev;
+        sdr_dev_t *src        = slot->src;
+        ev.queued             = dev->ring_count - 1;
+        dev->ring_draining    = dev->ring_count > 1;
+        pthread_mutex_unlock(&dev->ring_lock);
+
+        // the slot is only reused after it is released
+        if (src == dev)
+            cb(&ev, ctx);
+        else
+            src->ring_cb(&ev, src->ring_ctx);
+
+        // the buffer is reused once the consumers that retained it release it
+        iq_pool_put(ev.iq);
+
+        pthread_mutex_lock(&dev->ring_lock);
+        slot->ready     = 0;
+        dev->ring_first = (dev->ring_first + 1) % dev->ring_size;
+        dev->ring_count--;
+        dev->ring_reserved--;
+        pthread_cond_signal(&dev->space_cond);
+        pthread_mutex_unlock(&dev->ring_lock);
+    }
+
+    for (unsigned i = 0; i < num_devs; ++i) {
+        if (started[i])
+            pthread_join(devs[i]->ring_thread, NULL);
+        devs[i]->ring_running = 0;
+    }
+    free(dev->ring_slots);
+    dev->ring_slots = NULL;
+    iq_pool_free(dev->ring_pool); // freed once the consumers release the buffers they retain
+    dev->ring_pool = NULL;
+
+    return dev->ring_ret;
+}
+
+#endif
+
 int sdr_start(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, uint32_t buf_len)
 {
     if (!dev)
@@ -1603,20 +2294,91 @@ int sdr_start(sdr_dev_t *dev, sdr_event_cb_t cb, void *ctx, uint32_t buf_num, ui
     if (buf_len == 0)
         buf_len = SDR_DEFAULT_BUF_LENGTH;
 
-    if (dev->rtl_tcp)
-        return rtltcp_read_loop(dev, cb, ctx, buf_num, buf_len);
+#ifdef THREADS
+    if (dev->ring_num)
+        return ring_start(dev, cb, ctx, buf_num, buf_len);
+#endif
 
-#ifdef SOAPYSDR
-    if (dev->soapy_dev)
-        return soapysdr_read_loop(dev, cb, ctx, buf_num, buf_len);
+    return read_loop(dev, cb, ctx, buf_num, buf_len);
+}
+
+int sdr_set_acquire(sdr_dev_t *dev, unsigned ring_num)
+{
+    if (!dev)
+        return -1;
+
+#ifdef THREADS
+    if (ring_num && !dev->ring_num) {
+        pthread_mutex_init(&dev->ring_lock, NULL);
+        pthread_cond_init(&dev->work_cond, NULL);
+        pthread_cond_init(&dev->space_cond, NULL);
+    }
+    if (ring_num)
+        dev->ring_num = ring_num; // the lock stays initialized until sdr_close()
+    return 0;
+#else
+    if (ring_num)
+        fprintf(stderr, "%s: built without threads support, reading on the processing thread\n", __func__);
+    return ring_num ? -1 : 0;
 #endif
+}
 
-#ifdef RTLSDR
-    if (dev->rtlsdr_dev)
-        return rtlsdr_read_loop(dev, cb, ctx, buf_num, buf_len);
+int sdr_set_batch(sdr_dev_t *dev, unsigned delay_ms)
+{
+    if (!dev)
+        return -1;
+
+#ifdef THREADS
+    dev->ring_batch_ms = delay_ms;
+    return dev->ring_num ? 0 : -1;
+#else
+    (void)delay_ms;
+    return -1;
 #endif
+}
+
+int sdr_add_acquire(sdr_dev_t *dev, sdr_dev_t *other, sdr_event_cb_t cb, void *ctx)
+{
+    if (!dev || !other || !cb || dev == other)
+        return -1;
 
+#ifdef THREADS
+    if (!dev->ring_num || dev->ring_owner || other->ring_owner || other->ring_member_num) {
+        fprintf(stderr, "%s: the acquisition ring must be set and the devices not already grouped\n", __func__);
+        return -1;
+    }
+    if (dev->ring_member_num >= SDR_MAX_DEVICES - 1) {
+        fprintf(stderr, "%s: max number of devices reached %d\n", __func__, SDR_MAX_DEVICES);
+        return -1;
+    }
+    sdr_set_acquire(other, dev->ring_num); // the lock guards the pending changes of the other device
+    other->ring_owner = dev;
+    other->ring_cb    = cb;
+    other->ring_ctx   = ctx;
+    dev->ring_members[dev->ring_member_num++] = other;
+    return 0;
+#else
+    (void)ctx;
+    fprintf(stderr, "%s: built without threads support, can not read several devices\n", __func__);
     return -1;
+#endif
+}
+
+uint64_t sdr_get_lost_samples(sdr_dev_t *dev)
+{
+    if (!dev)
+        return 0;
+
+#ifdef THREADS
+    if (dev->ring_num) {
+        sdr_dev_t *owner = dev->ring_owner ? dev->ring_owner : dev; // counted under the lock of the ring
+        pthread_mutex_lock(&owner->ring_lock);
+        uint64_t lost = dev->lost_samples;
+        pthread_mutex_unlock(&owner->ring_lock);
+        return lost;
+    }
+#endif
+    return 0;
 }
 
 int sdr_stop(sdr_dev_t *dev)
@@ -0,0 +1,311 @@
+/** @file
+    Second-chance decoding, retries the unclaimed packages on an idle worker.
+
+    A package no decoder claims is queued with its samples, from a few ms before
+    its start to a few ms after its end. The worker detects the pulses again with
+    lower detection levels, and for an FSK package with both FSK detectors, and runs
+    its own clones of the decoders. The worker never blocks the demodulation, a
+    package is dropped if the queue is full, and the thread runs at the idle priority.
+
+    The events are collected by the worker, as with -Y jobs, and output on the
+    thread of the outputs with "retried" set, see second_chance_output().
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "second_chance.h"
+#include "r_api.h"
+#include "r_private.h"
+#include "rtl_433.h"
+#include "pulse_detect.h"
+#include "data.h"
+#include "list.h"
+#include "thread_pin.h"
+#include "compat_pthread.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef THREADS
+
+/// Lower the detection levels by this much for the retry.
+#define SECOND_CHANCE_LEVEL_DB 6.0f
+/// Lower the minimum SNR by this much for the retry, not below SECOND_CHANCE_MIN_SNR.
+#define SECOND_CHANCE_SNR_DB 3.0f
+#define SECOND_CHANCE_MIN_SNR 3.0f
+
+struct second_chance_job {
+    second_chance_span_t span;
+    unsigned char *buf; ///< the copy of the samples, reused
+    uint32_t buf_size;
+};
+
+struct second_chance {
+    r_cfg_t *cfg;              ///< the config of the worker, with its own demod state and decoders
+    unsigned fsk_mode;         ///< the FSK detector of the main config
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t work_cond;  ///< signals a queued package or the exit
+    pthread_cond_t idle_cond;  ///< signals a package done
+    int exit;
+    int busy;                  ///< a package is being retried
+    unsigned first;            ///< the package being retried or next to retry
+    unsigned len;              ///< packages queued, including the one being retried
+    struct second_chance_job jobs[SECOND_CHANCE_QUEUE_SIZE];
+    list_t events;             ///< the events decoded, not yet output
+    unsigned queued;
+    unsigned dropped;
+    unsigned decoded;
+};
+
+/// Turn off everything of the worker config that is shared with the main config or is not needed.
+static void setup_worker(second_chance_t *sc)
+{
+    r_cfg_t *cfg                = sc->cfg;
+    cfg->second_chance          = NULL;
+    cfg->spectrum               = NULL;
+    cfg->hop_sched              = NULL;
+    cfg->trace                  = NULL;
+    cfg->raw_mode               = 0;
+    cfg->report_noise           = 0;
+    cfg->bench_passes           = 0;
+    cfg->frequencies            = 1;
+    cfg->event_dedup.window_ms  = 0;
+    cfg->signal_cluster.repeats = 0;
+    cfg->demod->adapt_secs      = 0;
+    cfg->demod->analyze_pulses  = 0;
+    cfg->demod->demod_threads   = 0;
+    cfg->demod->dedup_ms        = 0;
+    cfg->demod->iq_correct_state.enabled = 0; // the samples queued are corrected
+}
+
+/// Detect and decode the package again, first with lower levels, then with both FSK detectors.
+static void retry_span(second_chance_t *sc, second_chance_span_t const *span, unsigned char *buf, list_t *events)
+{
+    r_cfg_t *cfg           = sc->cfg;
+    struct dm_state *demod = cfg->demod;
+    cfg->samp_rate         = span->samp_rate;
+    cfg->center_frequency  = span->frequency;
+    cfg->frequency[0]      = span->frequency;
+
+    int attempts = span->fsk && sc->fsk_mode != FSK_PULSE_DETECT_BOTH ? 2 : 1;
+    for (int i = 0; i < attempts && !events->len; ++i) {
+        float min_snr = demod->min_snr - SECOND_CHANCE_SNR_DB;
+        pulse_detect_reset(demod->pulse_detect);
+        pulse_data_clear(&demod->pulse_data);
+        pulse_data_clear(&demod->fsk_pulse_data);
+        pulse_detect_set_levels(demod->pulse_detect, demod->use_mag_est, 0.0f, demod->min_level - SECOND_CHANCE_LEVEL_DB,
+                min_snr > SECOND_CHANCE_MIN_SNR ? min_snr : SECOND_CHANCE_MIN_SNR, 0);
+        cfg->fsk_pulse_detect_mode = i ? FSK_PULSE_DETECT_BOTH : sc->fsk_mode;
+        pulse_detect_set_fsk_alt(demod->pulse_detect, cfg->fsk_pulse_detect_mode == FSK_PULSE_DETECT_BOTH);
+
+        cfg->input_pos         = span->input_pos;
+        demod->sample_file_pos = span->sample_file_pos;
+        cfg->batch_events      = events;
+        r_process_iq(cfg, buf, span->len, span->format, &span->now);
+        cfg->batch_events = NULL;
+    }
+}
+
+static THREAD_RETURN THREAD_CALL second_chance_thread(void *arg)
+{
+    second_chance_t *sc = arg;
+    thread_pin_self(THREAD_DECODE);
+    thread_pin_idle();
+    pthread_mutex_lock(&sc->lock);
+    for (;;) {
+        while (!sc->len && !sc->exit) {
+            pthread_cond_wait(&sc->work_cond, &sc->lock);
+        }
+        if (!sc->len)
+            break; // exit with all packages retried
+        struct second_chance_job *job = &sc->jobs[sc->first];
+        sc->busy                      = 1;
+        pthread_mutex_unlock(&sc->lock);
+
+        list_t events = {0};
+        retry_span(sc, &job->span, job->buf, &events);
+
+        pthread_mutex_lock(&sc->lock);
+        for (size_t i = 0; i < events.len; ++i) {
+            list_push(&sc->events, events.elems[i]);
+        }
+        sc->decoded += events.len;
+        list_free_elems(&events, NULL);
+        sc->first = (sc->first + 1) % SECOND_CHANCE_QUEUE_SIZE;
+        sc->len--;
+        sc->busy = 0;
+        pthread_cond_broadcast(&sc->idle_cond);
+    }
+    pthread_mutex_unlock(&sc->lock);
+    return (THREAD_RETURN)0;
+}
+
+second_chance_t *second_chance_create(r_cfg_t *cfg)
+{
+    second_chance_t *sc = calloc(1, sizeof(*sc));
+    if (!sc) {
+        WARN_CALLOC("second_chance_create()");
+        return NULL;
+    }
+    sc->cfg      = r_create_batch_cfg(cfg);
+    sc->fsk_mode = cfg->fsk_pulse_detect_mode;
+    setup_worker(sc);
+    pthread_mutex_init(&sc->lock, NULL);
+    pthread_cond_init(&sc->work_cond, NULL);
+    pthread_cond_init(&sc->idle_cond, NULL);
+    if (pthread_create(&sc->thread, NULL, second_chance_thread, sc)) {
+        fprintf(stderr, "%s: failed to start thread\n", __func__);
+        pthread_cond_destroy(&sc->idle_cond);
+        pthread_cond_destroy(&sc->work_cond);
+        pthread_mutex_destroy(&sc->lock);
+        r_free_batch_cfg(sc->cfg);
+        free(sc);
+        return NULL;
+    }
+    return sc;
+}
+
+void second_chance_free(second_chance_t *sc, r_cfg_t *cfg)
+{
+    if (!sc)
+        return;
+    pthread_mutex_lock(&sc->lock);
+    sc->exit = 1;
+    pthread_cond_signal(&sc->work_cond);
+    pthread_mutex_unlock(&sc->lock);
+    pthread_join(sc->thread, NULL);
+
+    if (cfg)
+        second_chance_output(sc, cfg);
+    list_free_elems(&sc->events, (list_elem_free_fn)data_free);
+    for (unsigned i = 0; i < SECOND_CHANCE_QUEUE_SIZE; ++i) {
+        free(sc->jobs[i].buf);
+    }
+    pthread_cond_destroy(&sc->idle_cond);
+    pthread_cond_destroy(&sc->work_cond);
+    pthread_mutex_destroy(&sc->lock);
+    r_free_batch_cfg(sc->cfg);
+    free(sc);
+}
+
+int second_chance_push(second_chance_t *sc, second_chance_span_t const *span)
+{
+    pthread_mutex_lock(&sc->lock);
+    unsigned len  = sc->len;
+    unsigned slot = (sc->first + sc->len) % SECOND_CHANCE_QUEUE_SIZE;
+    if (len == SECOND_CHANCE_QUEUE_SIZE)
+        sc->dropped++;
+    pthread_mutex_unlock(&sc->lock);
+    if (len == SECOND_CHANCE_QUEUE_SIZE)
+        return -1;
+
+    // the free slots are only touched by this thread
+    struct second_chance_job *job = &sc->jobs[slot];
+    if (job->buf_size < span->len) {
+        unsigned char *buf = realloc(job->buf, span->len);
+        if (!buf) {
+            WARN_REALLOC("second_chance_push()");
+            return -1;
+        }
+        job->buf      = buf;
+        job->buf_size = span->len;
+    }
+    memcpy(job->buf, span->iq_buf, span->len);
+    job->span        = *span;
+    job->span.iq_buf = NULL; // the copy is job->buf
+
+    pthread_mutex_lock(&sc->lock);
+    sc->len++;
+    sc->queued++;
+    pthread_cond_signal(&sc->work_cond);
+    pthread_mutex_unlock(&sc->lock);
+    return 0;
+}
+
+void second_chance_output(second_chance_t *sc, r_cfg_t *cfg)
+{
+    pthread_mutex_lock(&sc->lock);
+    list_t events = sc->events;
+    sc->events    = (list_t){0};
+    pthread_mutex_unlock(&sc->lock);
+
+    for (size_t i = 0; i < events.len; ++i) {
+        data_t *data = data_append(events.elems[i],
+                "retried",  "Retried",  DATA_INT, 1,
+                NULL);
+        output_event(cfg, data);
+    }
+    list_free_elems(&events, NULL);
+}
+
+void second_chance_reset(second_chance_t *sc, r_cfg_t *cfg)
+{
+    pthread_mutex_lock(&sc->lock);
+    // keep the package being retried, it is done with the old decoders
+    sc->len = sc->busy ? 1 : 0;
+    while (sc->busy) {
+        pthread_cond_wait(&sc->idle_cond, &sc->lock);
+    }
+    r_reset_batch_cfg(sc->cfg, cfg);
+    setup_worker(sc);
+    pthread_mutex_unlock(&sc->lock);
+}
+
+void second_chance_counts(second_chance_t *sc, unsigned *queued, unsigned *dropped, unsigned *events)
+{
+    pthread_mutex_lock(&sc->lock);
+    *queued  = sc->queued;
+    *dropped = sc->dropped;
+    *events  = sc->decoded;
+    pthread_mutex_unlock(&sc->lock);
+}
+
+#else
+
+second_chance_t *second_chance_create(r_cfg_t *cfg)
+{
+    (void)cfg;
+    fprintf(stderr, "second_chance: not supported, retrying packages needs threads\n");
+    return NULL;
+}
+
+void second_chance_free(second_chance_t *sc, r_cfg_t *cfg)
+{
+    (void)sc;
+    (void)cfg;
+}
+
+int second_chance_push(second_chance_t *sc, second_chance_span_t const *span)
+{
+    (void)sc;
+    (void)span;
+    return -1;
+}
+
+void second_chance_output(second_chance_t *sc, r_cfg_t *cfg)
+{
+    (void)sc;
+    (void)cfg;
+}
+
+void second_chance_reset(second_chance_t *sc, r_cfg_t *cfg)
+{
+    (void)sc;
+    (void)cfg;
+}
+
+void second_chance_counts(second_chance_t *sc, unsigned *queued, unsigned *dropped, unsigned *events)
+{
+    (void)sc;
+    *queued  = 0;
+    *dropped = 0;
+    *events  = 0;
+}
+
+#endif
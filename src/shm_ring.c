@@ -0,0 +1,309 @@
+/** @file
+    Shared memory ring of serialized events, one writer and any number of readers.
+
+    The writer moves the tail past the records it is about to overwrite before
+    writing and publishes the new head after writing. A reader copies a record
+    out and then checks the tail, if the tail moved past the record it was
+    overwritten meanwhile and the reader continues at the tail.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "shm_ring.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LOAD_ACQUIRE(p)     __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define LOAD_RELAXED(p)     __atomic_load_n(p, __ATOMIC_RELAXED)
+#define STORE_RELEASE(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#define STORE_RELAXED(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+
+struct shm_ring {
+    shm_ring_header_t *hdr;
+    uint8_t *data;    ///< the data area
+    size_t map_size;
+    char *name;       ///< the object name with leading slash, set for the writer only
+    uint64_t pos;     ///< read position
+    uint64_t seq;     ///< sequence number of the last record read
+    uint64_t lost;    ///< records lost by the reader
+};
+
+/// Size of a record in the data area, padded to 8 bytes.
+static uint64_t record_size(uint32_t len)
+{
+    return (sizeof(shm_ring_record_t) + (uint64_t)len + 7) & ~(uint64_t)7;
+}
+
+static void ring_copy_in(shm_ring_t *ring, uint64_t pos, void const *src, size_t len)
+{
+    size_t size = ring->hdr->size;
+    size_t off  = pos & (size - 1);
+    size_t part = size - off < len ? size - off : len;
+    memcpy(ring->data + off, src, part);
+    memcpy(ring->data, (uint8_t const *)src + part, len - part);
+}
+
+static void ring_copy_out(shm_ring_t *ring, uint64_t pos, void *dst, size_t len)
+{
+    size_t size = ring->hdr->size;
+    size_t off  = pos & (size - 1);
+    size_t part = size - off < len ? size - off : len;
+    memcpy(dst, ring->data + off, part);
+    memcpy((uint8_t *)dst + part, ring->data, len - part);
+}
+
+static char *shm_ring_name(char const *name)
+{
+    char *path = malloc(strlen(name) + 2);
+    if (!path) {
+        WARN_MALLOC("shm_ring_name()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    path[0] = '/';
+    strcpy(path + 1, name);
+    return path;
+}
+
+shm_ring_t *shm_ring_create(char const *name, size_t size, unsigned format)
+{
+    size_t ring_size = 4096;
+    while (ring_size < size)
+        ring_size *= 2;
+
+    shm_ring_t *ring = calloc(1, sizeof(*ring));
+    if (!ring) {
+        WARN_CALLOC("shm_ring_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    ring->name = shm_ring_name(name);
+    if (!ring->name) {
+        free(ring);
+        return NULL;
+    }
+
+    shm_unlink(ring->name); // readers of an old ring keep their mapping
+    int fd = shm_open(ring->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("shm_open");
+        free(ring->name);
+        free(ring);
+        return NULL;
+    }
+    ring->map_size = sizeof(shm_ring_header_t) + ring_size;
+    if (ftruncate(fd, ring->map_size) < 0) {
+        perror("ftruncate");
+        close(fd);
+        shm_ring_free(ring);
+        return NULL;
+    }
+    void *map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        shm_ring_free(ring);
+        return NULL;
+    }
+    ring->hdr  = map;
+    ring->data = (uint8_t *)map + sizeof(shm_ring_header_t);
+
+    ring->hdr->version = SHM_RING_VERSION;
+    ring->hdr->format  = format;
+    ring->hdr->size    = ring_size;
+    STORE_RELEASE(&ring->hdr->magic, SHM_RING_MAGIC);
+
+    return ring;
+}
+
+int shm_ring_write(shm_ring_t *ring, void const *buf, size_t len)
+{
+    shm_ring_header_t *hdr = ring->hdr;
+    uint64_t rec_size      = record_size((uint32_t)len);
+    if (len > UINT32_MAX || rec_size > hdr->size)
+        return -1;
+
+    uint64_t head = hdr->head; // only the writer changes head and tail
+    uint64_t tail = hdr->tail;
+    if (head + rec_size - tail > hdr->size) {
+        while (head + rec_size - tail > hdr->size) {
+            shm_ring_record_t old;
+            ring_copy_out(ring, tail, &old, sizeof(old));
+            tail += record_size(old.len);
+        }
+        STORE_RELAXED(&hdr->tail, tail);
+        __atomic_thread_fence(__ATOMIC_RELEASE); // the tail moves before the old records are overwritten
+    }
+
+    shm_ring_record_t rec = {.len = (uint32_t)len, .seq = hdr->seq + 1};
+    ring_copy_in(ring, head, &rec, sizeof(rec));
+    ring_copy_in(ring, head + sizeof(rec), buf, len);
+    STORE_RELAXED(&hdr->seq, rec.seq);
+    STORE_RELEASE(&hdr->head, head + rec_size);
+    return 0;
+}
+
+shm_ring_t *shm_ring_open(char const *name)
+{
+    char *path = shm_ring_name(name);
+    if (!path)
+        return NULL;
+    int fd = shm_open(path, O_RDONLY, 0);
+    free(path);
+    if (fd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+
+    struct stat st;
+    shm_ring_header_t hdr = {0};
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(hdr)
+            || pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)
+            || hdr.magic != SHM_RING_MAGIC || hdr.version != SHM_RING_VERSION
+            || hdr.size & (hdr.size - 1) || (uint64_t)st.st_size < sizeof(hdr) + hdr.size) {
+        fprintf(stderr, "%s: not a ring of version %d\n", __func__, SHM_RING_VERSION);
+        close(fd);
+        return NULL;
+    }
+
+    shm_ring_t *ring = calloc(1, sizeof(*ring));
+    if (!ring) {
+        WARN_CALLOC("shm_ring_open()");
+        close(fd);
+        return NULL; // NOTE: returns NULL on alloc failure.
+    }
+    ring->map_size = sizeof(hdr) + hdr.size;
+    void *map      = mmap(NULL, ring->map_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        free(ring);
+        return NULL;
+    }
+    ring->hdr  = map;
+    ring->data = (uint8_t *)map + sizeof(hdr);
+    ring->pos  = LOAD_ACQUIRE(&ring->hdr->head);
+    ring->seq  = LOAD_RELAXED(&ring->hdr->seq);
+    return ring;
+}
+
+int shm_ring_read(shm_ring_t *ring, void *buf, size_t len, uint64_t *seq)
+{
+    shm_ring_header_t *hdr = ring->hdr;
+    for (;;) {
+        uint64_t head = LOAD_ACQUIRE(&hdr->head);
+        if (ring->pos == head)
+            return 0;
+        uint64_t tail = LOAD_ACQUIRE(&hdr->tail);
+        if (ring->pos < tail)
+            ring->pos = tail; // overwritten, continue with the oldest record
+
+        shm_ring_record_t rec;
+        ring_copy_out(ring, ring->pos, &rec, sizeof(rec));
+        int ret = -1;
+        if (rec.len <= len && rec.len <= hdr->size) {
+            ring_copy_out(ring, ring->pos + sizeof(rec), buf, rec.len);
+            ret = (int)rec.len;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE); // the copy is done before the tail is checked
+        if (LOAD_RELAXED(&hdr->tail) > ring->pos)
+            continue; // overwritten while copying
+
+        ring->pos += record_size(rec.len);
+        if (ring->seq && rec.seq > ring->seq + 1)
+            ring->lost += rec.seq - ring->seq - 1;
+        ring->seq = rec.seq;
+        if (ret < 0)
+            ring->lost++;
+        if (seq)
+            *seq = rec.seq;
+        return ret;
+    }
+}
+
+unsigned shm_ring_format(shm_ring_t *ring)
+{
+    return ring->hdr->format;
+}
+
+uint64_t shm_ring_lost(shm_ring_t *ring)
+{
+    return ring->lost;
+}
+
+void shm_ring_free(shm_ring_t *ring)
+{
+    if (!ring)
+        return;
+    if (ring->hdr)
+        munmap(ring->hdr, ring->map_size);
+    if (ring->name)
+        shm_unlink(ring->name);
+    free(ring->name);
+    free(ring);
+}
+
+#else
+
+shm_ring_t *shm_ring_create(char const *name, size_t size, unsigned format)
+{
+    (void)name;
+    (void)size;
+    (void)format;
+    fprintf(stderr, "%s: shared memory rings are not supported on this platform\n", __func__);
+    return NULL;
+}
+
+int shm_ring_write(shm_ring_t *ring, void const *buf, size_t len)
+{
+    (void)ring;
+    (void)buf;
+    (void)len;
+    return -1;
+}
+
+shm_ring_t *shm_ring_open(char const *name)
+{
+    (void)name;
+    fprintf(stderr, "%s: shared memory rings are not supported on this platform\n", __func__);
+    return NULL;
+}
+
+int shm_ring_read(shm_ring_t *ring, void *buf, size_t len, uint64_t *seq)
+{
+    (void)ring;
+    (void)buf;
+    (void)len;
+    (void)seq;
+    return 0;
+}
+
+unsigned shm_ring_format(shm_ring_t *ring)
+{
+    (void)ring;
+    return 0;
+}
+
+uint64_t shm_ring_lost(shm_ring_t *ring)
+{
+    (void)ring;
+    return 0;
+}
+
+void shm_ring_free(shm_ring_t *ring)
+{
+    (void)ring;
+}
+
+#endif
@@ -0,0 +1,114 @@
+/** @file
+    Signal clustering, suggests flex decoder specs for recurring packages no decoder claimed.
+
+    Each unclaimed package is keyed by a coarse fingerprint of its timings, packages of the same
+    device share the pulse and gap widths and only differ in their order.
+    The full pulse analyzer runs once per cluster when it recurs, not for each package.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "signal_cluster.h"
+#include "pulse_analyzer.h"
+
+#include <stdio.h>
+
+#define FNV_PRIME 16777619u
+
+/// Quantize a width to a step of 4 per octave (about 19%), 0 to 123.
+static unsigned width_step(int width)
+{
+    if (width < 4)
+        return width > 0 ? width : 0;
+    unsigned msb = 0;
+    for (unsigned w = width; w > 1; w >>= 1)
+        ++msb;
+    return msb * 4 + ((width >> (msb - 2)) & 3);
+}
+
+static uint32_t hash_word(uint32_t hash, uint64_t word)
+{
+    for (unsigned i = 0; i < 8; ++i) {
+        hash = (hash ^ (uint8_t)(word >> (i * 8))) * FNV_PRIME; // FNV-1a
+    }
+    return hash;
+}
+
+uint32_t signal_cluster_fingerprint(pulse_data_t const *data, int package_type)
+{
+    // the sets of quantized pulse and gap widths, the last gap is the end of the package
+    uint64_t pulses[2] = {0};
+    uint64_t gaps[2]   = {0};
+    for (unsigned n = 0; n < data->num_pulses; ++n) {
+        unsigned p = width_step(data->pulse[n]);
+        pulses[p >> 6] |= 1ull << (p & 63);
+        if (n + 1 < data->num_pulses) {
+            unsigned g = width_step(data->gap[n]);
+            gaps[g >> 6] |= 1ull << (g & 63);
+        }
+    }
+
+    uint32_t hash = 2166136261u;
+    hash = hash_word(hash, (uint64_t)package_type);
+    hash = hash_word(hash, width_step(data->num_pulses) / 4); // the octave of the pulse count
+    hash = hash_word(hash, pulses[0]);
+    hash = hash_word(hash, pulses[1]);
+    hash = hash_word(hash, gaps[0]);
+    hash = hash_word(hash, gaps[1]);
+    return hash ? hash : 1; // 0 marks a never used slot
+}
+
+int signal_cluster_add(signal_cluster_t *sc, pulse_data_t const *data, int package_type)
+{
+    if (data->num_pulses < PD_MIN_PULSES)
+        return 0;
+    sc->packages++;
+    uint32_t fingerprint = signal_cluster_fingerprint(data, package_type);
+
+    // find the cluster, or reuse the first never used slot or the least recently seen probed slot
+    struct signal_cluster_slot *cluster = NULL;
+    struct signal_cluster_slot *victim  = NULL;
+    for (unsigned i = 0; i < SIGNAL_CLUSTER_PROBES; ++i) {
+        struct signal_cluster_slot *slot = &sc->slot[(fingerprint + i) & (SIGNAL_CLUSTER_SIZE - 1)];
+        if (slot->fingerprint == fingerprint) {
+            cluster = slot;
+            break;
+        }
+        if (!victim || !slot->fingerprint || slot->seen < victim->seen)
+            victim = slot;
+        if (!slot->fingerprint)
+            break; // never used, the cluster can not be further on
+    }
+    if (!cluster) {
+        if (victim->fingerprint)
+            sc->evicted++;
+        cluster              = victim;
+        *cluster             = (struct signal_cluster_slot){0};
+        cluster->fingerprint = fingerprint;
+        cluster->id          = ++sc->clusters;
+    }
+    cluster->count++;
+    cluster->seen = sc->packages;
+
+    if (cluster->suggested || cluster->count < sc->repeats)
+        return 0;
+    cluster->suggested = 1;
+
+    char name[32];
+    snprintf(name, sizeof(name), "unknown-%u", cluster->id);
+    char spec[FLEX_SPEC_SIZE];
+    pulse_class_t guess = pulse_analyzer_suggest(data, package_type, name, spec, sizeof(spec));
+    char const *type    = package_type == PULSE_DATA_FSK ? "FSK" : "OOK";
+    if (!*spec) {
+        fprintf(stderr, "Recurring %s signal without decoder seen %u times (%s, %u pulses), no flex decoder for the modulation\n",
+                type, cluster->count, pulse_class_str(guess), data->num_pulses);
+        return 0;
+    }
+    fprintf(stderr, "Recurring %s signal without decoder seen %u times (%s, %u pulses), try a flex decoder with -X '%s'\n",
+            type, cluster->count, pulse_class_str(guess), data->num_pulses, spec);
+    sc->suggested++;
+    return 1;
+}
@@ -0,0 +1,467 @@
+/** @file
+    Spectrum monitor, the occupancy and noise floor of FFT bins of the input band.
+
+    Every few buffers a snapshot of the samples is copied and transformed with a
+    Hann windowed FFT, averaged over a few frames. For each bin the monitor keeps
+    the mean power, a noise floor that falls fast and rises slowly, and the
+    fraction of snapshots with the power well above the noise floor. The
+    averages run over the recent snapshots, the first ones are a plain mean.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "spectrum.h"
+#include "fileformat.h"
+#include "data.h"
+#include "list.h"
+#include "compat_pthread.h"
+#include "thread_pin.h"
+#include "fatal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define SPECTRUM_FRAMES 8      // FFT frames averaged for each snapshot
+#define SPECTRUM_AVERAGE 256   // snapshots of the running averages
+#define SPECTRUM_NOISE_FALL 0.25f // fraction of a lower power the noise floor falls by
+#define SPECTRUM_NOISE_RISE 0.02f // dB the noise floor rises by for each snapshot above it
+
+/// The statistics of a band.
+typedef struct spectrum_band {
+    uint32_t center_frequency;
+    uint32_t samp_rate;
+    unsigned snapshots;
+    double *power;    ///< mean power of each bin, relative to full scale
+    float *noise_db;  ///< noise floor of each bin
+    float *occupancy; ///< fraction of snapshots the bin was occupied
+} spectrum_band_t;
+
+/// A snapshot waiting for the transform.
+typedef struct spectrum_snap {
+    float *iq; ///< the converted samples, up to SPECTRUM_FRAMES frames of bins samples
+    unsigned frames;
+    unsigned band;
+    uint32_t center_frequency;
+    uint32_t samp_rate;
+} spectrum_snap_t;
+
+struct spectrum {
+    unsigned bins;
+    unsigned interval;
+    unsigned countdown;
+    unsigned bands_len;
+    spectrum_band_t *bands;
+    float *window;
+    float *twiddle;       ///< exp(-2 pi i k / bins) for k < bins / 2
+    unsigned *bitrev;
+    float *fft_buf;       ///< one frame of complex samples
+    double *snap_power;   ///< the power of each bin of a snapshot
+    spectrum_snap_t snap; ///< filled by the demodulation, or transformed by the side thread
+    unsigned snapshots;
+    unsigned skipped;
+#ifdef THREADS
+    spectrum_snap_t pending; ///< swapped with the snapshot to transform
+    int has_pending;
+    int exit;
+    int started;
+    pthread_t thread;
+    pthread_mutex_t lock; ///< guards the bands and the pending snapshot
+    pthread_cond_t cond;  ///< signals a pending snapshot or the exit
+#endif
+};
+
+static void spectrum_lock(spectrum_t *spec)
+{
+#ifdef THREADS
+    pthread_mutex_lock(&spec->lock);
+#else
+    (void)spec;
+#endif
+}
+
+static void spectrum_unlock(spectrum_t *spec)
+{
+#ifdef THREADS
+    pthread_mutex_unlock(&spec->lock);
+#else
+    (void)spec;
+#endif
+}
+
+/// In-place radix-2 FFT of complex interleaved samples.
+static void fft_radix2(spectrum_t const *spec, float *x)
+{
+    unsigned n = spec->bins;
+    for (unsigned i = 0; i < n; ++i) {
+        unsigned j = spec->bitrev[i];
+        if (j > i) {
+            float re     = x[2 * i];
+            float im     = x[2 * i + 1];
+            x[2 * i]     = x[2 * j];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j]     = re;
+            x[2 * j + 1] = im;
+        }
+    }
+    for (unsigned len = 2; len <= n; len <<= 1) {
+        unsigned half = len / 2;
+        unsigned step = n / len;
+        for (unsigned i = 0; i < n; i += len) {
+            for (unsigned k = 0; k < half; ++k) {
+                float wr = spec->twiddle[2 * k * step];
+                float wi = spec->twiddle[2 * k * step + 1];
+                float *a = &x[2 * (i + k)];
+                float *b = &x[2 * (i + k + half)];
+                float tr = b[0] * wr - b[1] * wi;
+                float ti = b[0] * wi + b[1] * wr;
+                b[0]     = a[0] - tr;
+                b[1]     = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+/// Transform a snapshot and add it to the statistics of its band.
+static void spectrum_transform(spectrum_t *spec, spectrum_snap_t const *snap)
+{
+    unsigned n = spec->bins;
+    float wsum = 0.0f;
+    for (unsigned k = 0; k < n; ++k) {
+        wsum += spec->window[k];
+    }
+    double scale = 1.0 / ((double)wsum * wsum * snap->frames); // a full scale tone is 0 dB
+
+    memset(spec->snap_power, 0, sizeof(*spec->snap_power) * n);
+    for (unsigned f = 0; f < snap->frames; ++f) {
+        float const *iq = &snap->iq[2 * n * f];
+        for (unsigned k = 0; k < n; ++k) {
+            spec->fft_buf[2 * k]     = iq[2 * k] * spec->window[k];
+            spec->fft_buf[2 * k + 1] = iq[2 * k + 1] * spec->window[k];
+        }
+        fft_radix2(spec, spec->fft_buf);
+        for (unsigned k = 0; k < n; ++k) {
+            float re   = spec->fft_buf[2 * k];
+            float im   = spec->fft_buf[2 * k + 1];
+            unsigned b = (k + n / 2) % n; // from the lowest to the highest frequency
+            spec->snap_power[b] += (re * re + im * im) * scale;
+        }
+    }
+
+    spectrum_lock(spec);
+    spectrum_band_t *band = &spec->bands[snap->band];
+    if (band->center_frequency != snap->center_frequency || band->samp_rate != snap->samp_rate) {
+        band->center_frequency = snap->center_frequency;
+        band->samp_rate        = snap->samp_rate;
+        band->snapshots        = 0;
+    }
+    band->snapshots++;
+    double alpha = 1.0 / (band->snapshots < SPECTRUM_AVERAGE ? band->snapshots : SPECTRUM_AVERAGE);
+    for (unsigned k = 0; k < n; ++k) {
+        double p = spec->snap_power[k];
+        float db = 10.0f * log10f((float)p + 1e-20f);
+        if (band->snapshots == 1) {
+            band->power[k]     = p;
+            band->noise_db[k]  = db;
+            band->occupancy[k] = 0.0f;
+            continue;
+        }
+        band->power[k] += (p - band->power[k]) * alpha;
+        if (db < band->noise_db[k])
+            band->noise_db[k] += (db - band->noise_db[k]) * SPECTRUM_NOISE_FALL;
+        else
+            band->noise_db[k] += fminf(db - band->noise_db[k], SPECTRUM_NOISE_RISE);
+        float occupied = db > band->noise_db[k] + SPECTRUM_OCCUPIED_DB ? 1.0f : 0.0f;
+        band->occupancy[k] += (occupied - band->occupancy[k]) * (float)alpha;
+    }
+    spec->snapshots++;
+    spectrum_unlock(spec);
+}
+
+/// Convert the samples of a snapshot to float, full scale is 1.
+static void snap_convert(float *out, void const *iq_buf, unsigned long len, uint32_t format)
+{
+    if (format == CU8_IQ) {
+        uint8_t const *in = iq_buf;
+        for (unsigned long i = 0; i < len; ++i)
+            out[i] = (in[i] - 127.5f) / 128.0f;
+    }
+    else if (format == CS8_IQ) {
+        int8_t const *in = iq_buf;
+        for (unsigned long i = 0; i < len; ++i)
+            out[i] = in[i] / 128.0f;
+    }
+    else if (format == CS16_IQ) {
+        int16_t const *in = iq_buf;
+        for (unsigned long i = 0; i < len; ++i)
+            out[i] = in[i] / 32768.0f;
+    }
+    else {
+        memcpy(out, iq_buf, sizeof(float) * len);
+    }
+}
+
+#ifdef THREADS
+static THREAD_RETURN THREAD_CALL spectrum_thread(void *arg)
+{
+    spectrum_t *spec = arg;
+    thread_pin_self(THREAD_DEMOD);
+    spectrum_snap_t snap = {0};
+    pthread_mutex_lock(&spec->lock);
+    for (;;) {
+        while (!spec->has_pending && !spec->exit) {
+            pthread_cond_wait(&spec->cond, &spec->lock);
+        }
+        if (spec->exit)
+            break;
+        // take the pending snapshot, its buffer is refilled while this one is transformed
+        snap              = spec->pending;
+        spec->pending.iq  = spec->snap.iq;
+        spec->snap        = snap;
+        spec->has_pending = 0;
+        pthread_mutex_unlock(&spec->lock);
+
+        spectrum_transform(spec, &snap); // locks for the statistics
+
+        pthread_mutex_lock(&spec->lock);
+    }
+    pthread_mutex_unlock(&spec->lock);
+    return (THREAD_RETURN)0;
+}
+#endif
+
+spectrum_t *spectrum_create(unsigned bins, unsigned interval, unsigned bands)
+{
+    if (bins < 16 || bins > 4096 || (bins & (bins - 1))) {
+        fprintf(stderr, "spectrum: bins must be a power of 2 from 16 to 4096\n");
+        return NULL;
+    }
+
+    spectrum_t *spec = calloc(1, sizeof(*spec));
+    if (!spec) {
+        WARN_CALLOC("spectrum_create()");
+        return NULL;
+    }
+    spec->bins      = bins;
+    spec->interval  = interval ? interval : 1;
+    spec->bands_len = bands ? bands : 1;
+
+    // the tables, the per-snapshot buffers and the band statistics in a single block
+    size_t snap_len = 2 * bins * SPECTRUM_FRAMES;
+    size_t floats   = bins + bins + 2 * bins + 2 * snap_len + spec->bands_len * 2 * bins;
+    size_t doubles  = bins + spec->bands_len * bins;
+    size_t size     = sizeof(double) * doubles + sizeof(float) * floats + sizeof(unsigned) * bins;
+    double *block   = calloc(1, size);
+    if (!block) {
+        WARN_CALLOC("spectrum_create()");
+        free(spec);
+        return NULL;
+    }
+    spec->bands = calloc(spec->bands_len, sizeof(*spec->bands));
+    if (!spec->bands) {
+        WARN_CALLOC("spectrum_create()");
+        free(block);
+        free(spec);
+        return NULL;
+    }
+    spec->snap_power = block;
+    double *dp       = block + bins;
+    float *fp        = (float *)(block + doubles);
+    for (unsigned i = 0; i < spec->bands_len; ++i) {
+        spec->bands[i].power = dp;
+        dp += bins;
+        spec->bands[i].noise_db = fp;
+        fp += bins;
+        spec->bands[i].occupancy = fp;
+        fp += bins;
+    }
+    spec->window = fp;
+    fp += bins;
+    spec->twiddle = fp;
+    fp += bins;
+    spec->fft_buf = fp;
+    fp += 2 * bins;
+    spec->snap.iq = fp;
+    fp += snap_len;
+#ifdef THREADS
+    spec->pending.iq = fp;
+#endif
+    fp += snap_len;
+    spec->bitrev = (unsigned *)fp;
+
+    unsigned bits = 0;
+    while ((1u << bits) < bins)
+        bits++;
+    for (unsigned k = 0; k < bins; ++k) {
+        spec->window[k] = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * k / bins);
+        unsigned r      = 0;
+        for (unsigned b = 0; b < bits; ++b)
+            r |= ((k >> b) & 1) << (bits - 1 - b);
+        spec->bitrev[k] = r;
+    }
+    for (unsigned k = 0; k < bins / 2; ++k) {
+        spec->twiddle[2 * k]     = cosf(2.0f * (float)M_PI * k / bins);
+        spec->twiddle[2 * k + 1] = -sinf(2.0f * (float)M_PI * k / bins);
+    }
+
+#ifdef THREADS
+    pthread_mutex_init(&spec->lock, NULL);
+    pthread_cond_init(&spec->cond, NULL);
+    spec->started = !pthread_create(&spec->thread, NULL, spectrum_thread, spec);
+    if (!spec->started)
+        fprintf(stderr, "%s: failed to start thread, transforming in the demodulation\n", __func__);
+#endif
+    return spec;
+}
+
+void spectrum_free(spectrum_t *spec)
+{
+    if (!spec)
+        return;
+#ifdef THREADS
+    if (spec->started) {
+        pthread_mutex_lock(&spec->lock);
+        spec->exit = 1;
+        pthread_cond_signal(&spec->cond);
+        pthread_mutex_unlock(&spec->lock);
+        pthread_join(spec->thread, NULL);
+    }
+    pthread_cond_destroy(&spec->cond);
+    pthread_mutex_destroy(&spec->lock);
+#endif
+    free(spec->snap_power); // the block
+    free(spec->bands);
+    free(spec);
+}
+
+void spectrum_push(spectrum_t *spec, unsigned band, void const *iq_buf, unsigned long n_samples, uint32_t format, uint32_t center_frequency, uint32_t samp_rate)
+{
+    if (spec->countdown) {
+        spec->countdown--;
+        return;
+    }
+    unsigned frames = n_samples / spec->bins;
+    if (!frames || band >= spec->bands_len)
+        return;
+    spec->countdown = spec->interval - 1;
+    frames          = frames < SPECTRUM_FRAMES ? frames : SPECTRUM_FRAMES;
+
+#ifdef THREADS
+    if (spec->started) {
+        pthread_mutex_lock(&spec->lock);
+        int busy = spec->has_pending;
+        if (busy)
+            spec->skipped++;
+        pthread_mutex_unlock(&spec->lock);
+        if (busy)
+            return;
+        // only this thread writes the pending snapshot while none is pending
+        snap_convert(spec->pending.iq, iq_buf, 2UL * spec->bins * frames, format);
+        pthread_mutex_lock(&spec->lock);
+        spec->pending.frames           = frames;
+        spec->pending.band             = band;
+        spec->pending.center_frequency = center_frequency;
+        spec->pending.samp_rate        = samp_rate;
+        spec->has_pending              = 1;
+        pthread_cond_signal(&spec->cond);
+        pthread_mutex_unlock(&spec->lock);
+        return;
+    }
+#endif
+    snap_convert(spec->snap.iq, iq_buf, 2UL * spec->bins * frames, format);
+    spec->snap.frames           = frames;
+    spec->snap.band             = band;
+    spec->snap.center_frequency = center_frequency;
+    spec->snap.samp_rate        = samp_rate;
+    spectrum_transform(spec, &spec->snap);
+}
+
+/// Mean occupancy of a band, the lock is held.
+static double band_occupancy(spectrum_t const *spec, spectrum_band_t const *band)
+{
+    if (!band->snapshots)
+        return -1.0;
+    double sum = 0.0;
+    for (unsigned k = 0; k < spec->bins; ++k)
+        sum += band->occupancy[k];
+    return sum / spec->bins;
+}
+
+double spectrum_occupancy(spectrum_t *spec, unsigned band)
+{
+    if (band >= spec->bands_len)
+        return -1.0;
+    spectrum_lock(spec);
+    double occupancy = band_occupancy(spec, &spec->bands[band]);
+    spectrum_unlock(spec);
+    return occupancy;
+}
+
+/// Round to a tenth, the JSON output prints the short form.
+static double round_tenth(double x)
+{
+    return round(x * 10.0) / 10.0;
+}
+
+data_t *spectrum_data(spectrum_t *spec)
+{
+    unsigned n     = spec->bins;
+    double *values = calloc(3 * n, sizeof(*values));
+    if (!values) {
+        WARN_CALLOC("spectrum_data()");
+        return NULL;
+    }
+    double *power_db  = values;
+    double *noise_db  = values + n;
+    double *occupancy = values + 2 * n;
+
+    list_t band_list = {0};
+    spectrum_lock(spec);
+    for (unsigned i = 0; i < spec->bands_len; ++i) {
+        spectrum_band_t const *band = &spec->bands[i];
+        if (!band->snapshots)
+            continue;
+        for (unsigned k = 0; k < n; ++k) {
+            power_db[k]  = round_tenth(10.0 * log10(band->power[k] + 1e-20));
+            noise_db[k]  = round_tenth(band->noise_db[k]);
+            occupancy[k] = round(band->occupancy[k] * 1000.0) / 1000.0;
+        }
+        double bin_hz = (double)band->samp_rate / n;
+        list_push(&band_list, data_make(
+                "band",             "", DATA_INT, i,
+                "center_frequency", "", DATA_INT, band->center_frequency,
+                "sample_rate",      "", DATA_INT, band->samp_rate,
+                "start_frequency",  "", DATA_INT, (int)(band->center_frequency - band->samp_rate / 2),
+                "bin_hz",           "", DATA_DOUBLE, bin_hz,
+                "snapshots",        "", DATA_INT, band->snapshots,
+                "occupancy_mean",   "", DATA_FORMAT, "%.3f", DATA_DOUBLE, band_occupancy(spec, band),
+                "power_db",         "", DATA_ARRAY, data_array(n, DATA_DOUBLE, power_db),
+                "noise_db",         "", DATA_ARRAY, data_array(n, DATA_DOUBLE, noise_db),
+                "occupancy",        "", DATA_ARRAY, data_array(n, DATA_DOUBLE, occupancy),
+                NULL));
+    }
+    unsigned snapshots = spec->snapshots;
+    unsigned skipped   = spec->skipped;
+    spectrum_unlock(spec);
+    free(values);
+
+    data_t *data = data_make(
+            "bins",             "", DATA_INT, n,
+            "interval",         "", DATA_INT, spec->interval,
+            "snapshots",        "", DATA_INT, snapshots,
+            "skipped",          "", DATA_INT, skipped,
+            "bands",            "", DATA_COND, band_list.len > 0, DATA_ARRAY, data_array(band_list.len, DATA_DATA, band_list.elems),
+            NULL);
+    list_free_elems(&band_list, NULL);
+    return data;
+}
@@ -184,8 +184,9 @@ int term_get_columns(void *ctx)
     return (c_info.srWindow.Right - c_info.srWindow.Left + 1);
 #else
     FILE *fp = (FILE *)ctx;
-    struct winsize w;
-    ioctl(fileno(fp), TIOCGWINSZ, &w);
+    struct winsize w = {0};
+    if (ioctl(fileno(fp), TIOCGWINSZ, &w) != 0 || !w.ws_col)
+        return 80; // not a terminal, e.g. a pipe or a file
     return w.ws_col;
 #endif
 }
@@ -246,6 +247,27 @@ void term_set_fg(void *ctx, term_color_t color)
 #endif
 }
 
+int term_fg_escape(term_color_t color, char *buf)
+{
+#ifdef _WIN32
+    UNUSED(color);
+    UNUSED(buf);
+    return 0;
+#else
+    if (color == TERM_COLOR_RESET) {
+        memcpy(buf, "\033[0m", 4);
+        return 4;
+    }
+    // the colors are two digits, "\033[%d;1m"
+    buf[0] = '\033';
+    buf[1] = '[';
+    buf[2] = (char)('0' + color / 10 % 10);
+    buf[3] = (char)('0' + color % 10);
+    memcpy(buf + 4, ";1m", 3);
+    return 7;
+#endif
+}
+
 void term_set_bg(void *ctx, term_color_t color)
 {
 #ifdef _WIN32
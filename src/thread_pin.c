@@ -0,0 +1,179 @@
+/** @file
+    Thread placement, pins the pipeline threads to CPUs and sets a realtime priority.
+
+    Each pipeline thread pins itself when it starts, the CPUs of the roles are kept
+    process wide as the placement of threads is process wide too. Affinity and
+    priority use the Linux calls, other platforms only accept the settings.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "thread_pin.h"
+#include "compat_pthread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(THREADS) && defined(__linux__) && defined(_GNU_SOURCE)
+#define THREAD_PIN_SUPPORTED
+#include <sched.h>
+#include <errno.h>
+#endif
+
+static char const *const role_names[THREAD_ROLES] = {"acquire", "demod", "decode", "output", "net"};
+
+/// Parse a role name followed by a colon, returns the role or -1.
+static int parse_role(char const *arg, char const **end)
+{
+    for (int i = 0; i < THREAD_ROLES; ++i) {
+        size_t len = strlen(role_names[i]);
+        if (!strncmp(arg, role_names[i], len) && arg[len] == ':') {
+            *end = arg + len + 1;
+            return i;
+        }
+    }
+    return -1;
+}
+
+#ifdef THREAD_PIN_SUPPORTED
+
+static pthread_mutex_t pin_lock = PTHREAD_MUTEX_INITIALIZER; ///< guards the settings below
+static int pin_set;            ///< any role has CPUs
+static cpu_set_t process_cpus; ///< the CPUs of the process at the first setting
+static cpu_set_t role_cpus[THREAD_ROLES];
+static int role_has_cpus[THREAD_ROLES];
+static int role_warned[THREAD_ROLES];
+static int realtime_prio;
+
+int thread_pin_parse(char const *arg)
+{
+    char const *p;
+    int role = arg ? parse_role(arg, &p) : -1;
+    if (role < 0) {
+        fprintf(stderr, "thread_pin: unknown role in \"%s\", use acquire, demod, decode, output, or net\n", arg ? arg : "");
+        return -1;
+    }
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for (;;) {
+        char *end;
+        unsigned long first = strtoul(p, &end, 10);
+        unsigned long last  = first;
+        if (end != p && *end == '-') {
+            p    = end + 1;
+            last = strtoul(p, &end, 10);
+        }
+        if (end == p || (*end && *end != ':') || last < first || last >= CPU_SETSIZE) {
+            fprintf(stderr, "thread_pin: invalid CPUs in \"%s\"\n", arg);
+            return -1;
+        }
+        for (unsigned long cpu = first; cpu <= last; ++cpu) {
+            CPU_SET(cpu, &cpus);
+        }
+        if (!*end)
+            break;
+        p = end + 1;
+    }
+
+    pthread_mutex_lock(&pin_lock);
+    if (!pin_set && sched_getaffinity(0, sizeof(process_cpus), &process_cpus)) {
+        CPU_ZERO(&process_cpus); // keep the CPUs of threads without a role
+    }
+    pin_set             = 1;
+    role_cpus[role]     = cpus;
+    role_has_cpus[role] = 1;
+    role_warned[role]   = 0;
+    pthread_mutex_unlock(&pin_lock);
+    return 0;
+}
+
+void thread_pin_realtime(int prio)
+{
+    pthread_mutex_lock(&pin_lock);
+    realtime_prio               = prio;
+    role_warned[THREAD_ACQUIRE] = 0;
+    pthread_mutex_unlock(&pin_lock);
+}
+
+void thread_pin_self(thread_role_t role)
+{
+    if ((unsigned)role >= THREAD_ROLES)
+        return;
+
+    pthread_mutex_lock(&pin_lock);
+    int set        = pin_set;
+    cpu_set_t cpus = role_has_cpus[role] ? role_cpus[role] : process_cpus;
+    int prio       = role == THREAD_ACQUIRE ? realtime_prio : 0;
+    int warned     = role_warned[role];
+    pthread_mutex_unlock(&pin_lock);
+
+    int r = 0;
+    if (set && CPU_COUNT(&cpus)) {
+        r = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (r && !warned)
+            fprintf(stderr, "thread_pin: can't pin the %s thread: %s\n", role_names[role], strerror(r));
+    }
+    if (prio > 0) {
+        struct sched_param param = {0};
+        int min                  = sched_get_priority_min(SCHED_FIFO);
+        int max                  = sched_get_priority_max(SCHED_FIFO);
+        param.sched_priority     = prio < min ? min : prio > max ? max : prio;
+        int rp                   = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (rp && !warned)
+            fprintf(stderr, "thread_pin: can't set realtime priority %d for the %s thread: %s%s\n",
+                    param.sched_priority, role_names[role], strerror(rp),
+                    rp == EPERM ? " (needs CAP_SYS_NICE or an rtprio limit)" : "");
+        r |= rp;
+    }
+
+    if (r && !warned) {
+        pthread_mutex_lock(&pin_lock);
+        role_warned[role] = 1;
+        pthread_mutex_unlock(&pin_lock);
+    }
+}
+
+void thread_pin_idle(void)
+{
+#ifdef SCHED_IDLE
+    struct sched_param param = {0};
+    int r                    = pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+    if (r)
+        fprintf(stderr, "thread_pin: can't set the idle priority: %s\n", strerror(r));
+#endif
+}
+
+#else
+
+int thread_pin_parse(char const *arg)
+{
+    char const *p;
+    if (!arg || parse_role(arg, &p) < 0) {
+        fprintf(stderr, "thread_pin: unknown role in \"%s\", use acquire, demod, decode, output, or net\n", arg ? arg : "");
+        return -1;
+    }
+    fprintf(stderr, "thread_pin: not supported, the threads are not pinned on this platform\n");
+    return 0;
+}
+
+void thread_pin_realtime(int prio)
+{
+    if (prio)
+        fprintf(stderr, "thread_pin: not supported, no realtime priority on this platform\n");
+}
+
+void thread_pin_self(thread_role_t role)
+{
+    (void)role;
+}
+
+void thread_pin_idle(void)
+{
+}
+
+#endif
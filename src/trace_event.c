@@ -0,0 +1,73 @@
+/** @file
+    Trace event file, a timeline of the processing in the Chrome trace event format.
+
+    The events are written as a JSON array of complete ("X") events with
+    microsecond timestamps, each timeline row is a named thread of one process.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "trace_event.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+struct trace_event {
+    FILE *file;
+};
+
+static char const *const trace_row_names[] = {
+        [TRACE_BUFFERS]  = "buffers",
+        [TRACE_PACKAGES] = "packages",
+        [TRACE_DECODE]   = "decode",
+        [TRACE_OUTPUTS]  = "outputs",
+};
+
+trace_event_t *trace_event_open(char const *path)
+{
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open trace file %s\n", path);
+        return NULL;
+    }
+    trace_event_t *trace = calloc(1, sizeof(*trace));
+    if (!trace) {
+        WARN_CALLOC("trace_event_open()");
+        fclose(file);
+        return NULL;
+    }
+    trace->file = file;
+
+    fprintf(file, "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"rtl_433\"}}");
+    for (unsigned row = TRACE_BUFFERS; row <= TRACE_OUTPUTS; ++row) {
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                row, trace_row_names[row]);
+    }
+    return trace;
+}
+
+void trace_event_complete(trace_event_t *trace, char const *name, unsigned row, double ts_us, double dur_us, char const *arg_name, double arg)
+{
+    if (!trace)
+        return;
+
+    fprintf(trace->file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.0f,\"dur\":%.0f",
+            name, row, ts_us, dur_us > 0.0 ? dur_us : 0.0);
+    if (arg_name)
+        fprintf(trace->file, ",\"args\":{\"%s\":%.0f}", arg_name, arg);
+    fputc('}', trace->file);
+}
+
+void trace_event_close(trace_event_t *trace)
+{
+    if (!trace)
+        return;
+
+    fprintf(trace->file, "\n]\n");
+    fclose(trace->file);
+    free(trace);
+}
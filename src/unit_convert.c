@@ -0,0 +1,282 @@
+/** @file
+    Unit conversion of event fields to SI or customary units, see -C.
+
+    A field converts by the suffix of its key, e.g. "_F" to "_C". The conversion of each declared
+    field of a decoder is looked up once when the decoder is registered, an event field then only
+    needs a hash lookup, keys that are not declared are matched by their suffix for each event.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "unit_convert.h"
+#include "data.h"
+#include "list.h"
+#include "r_util.h"
+#include "fatal.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// The conversion of a unit, in the order the suffixes are matched.
+typedef struct unit_rule {
+    char const *suffix;     ///< the key suffix of the unit
+    char const *alt_suffix; ///< another key suffix of the unit, replaced with the suffix first, or NULL
+    char const *to_suffix;  ///< the key suffix of the converted unit
+    char const *unit;       ///< the unit in the format, a single char is only replaced as the last one
+    char const *to_unit;    ///< the converted unit in the format
+    float (*convert)(float value);
+} unit_rule_t;
+
+#define UNIT_RULES 7
+
+static unit_rule_t const unit_rules[UNIT_SYSTEMS][UNIT_RULES] = {
+        [UNIT_SI] = {
+                {"_F", NULL, "_C", "F", "C", fahrenheit2celsius},
+                {"_mph", NULL, "_kph", "mi/h", "km/h", mph2kmph},
+                {"_mi_h", NULL, "_km_h", "mi/h", "km/h", mph2kmph},
+                {"_in", "_inch", "_mm", "in", "mm", inch2mm},
+                {"_in_h", NULL, "_mm_h", "in/h", "mm/h", inch2mm},
+                {"_inHg", NULL, "_hPa", "inHg", "hPa", inhg2hpa},
+                {"_PSI", NULL, "_kPa", "PSI", "kPa", psi2kpa},
+        },
+        [UNIT_CUSTOMARY] = {
+                {"_C", NULL, "_F", "C", "F", celsius2fahrenheit},
+                {"_kph", NULL, "_mph", "km/h", "mi/h", kmph2mph},
+                {"_km_h", NULL, "_mi_h", "km/h", "mi/h", kmph2mph},
+                {"_mm", NULL, "_in", "mm", "in", mm2inch},
+                {"_mm_h", NULL, "_in_h", "mm/h", "in/h", mm2inch},
+                {"_hPa", NULL, "_inHg", "hPa", "inHg", hpa2inhg},
+                {"_kPa", NULL, "_PSI", "kPa", "PSI", kpa2psi},
+        },
+};
+
+/// The conversions of the well-known keys, these are looked up by the key id.
+static struct {
+    int key_id;
+    unit_system_t to;
+    int rule;
+    char const *to_key;
+    int to_key_id;
+} const well_known[] = {
+        {DATA_KEY_TEMPERATURE_F, UNIT_SI, 0, "temperature_C", DATA_KEY_TEMPERATURE_C},
+        {DATA_KEY_TEMPERATURE_C, UNIT_CUSTOMARY, 0, "temperature_F", DATA_KEY_TEMPERATURE_F},
+};
+
+/// A declared field and its conversion into each unit system.
+struct unit_field {
+    char const *key;                  ///< the declared field, NULL for a free slot
+    uint32_t hash;
+    int rule[UNIT_SYSTEMS];           ///< the matching rule, -1 for none
+    char const *to_key[UNIT_SYSTEMS]; ///< the converted key, interned
+    int to_key_id[UNIT_SYSTEMS];
+};
+
+struct unit_fields {
+    unsigned mask; ///< number of slots minus one, a power of two minus one
+    struct unit_field slot[];
+};
+
+/// The converted keys, kept for the process lifetime.
+static list_t interned_keys;
+
+static uint32_t hash_key(char const *key)
+{
+    uint32_t hash = 2166136261u;
+    for (; *key; ++key) {
+        hash = (hash ^ (unsigned char)*key) * 16777619u; // FNV-1a
+    }
+    return hash;
+}
+
+/// Find the first rule that matches the key suffix, -1 for none.
+static int find_rule(unit_system_t to, char const *key)
+{
+    for (int i = 0; i < UNIT_RULES; ++i) {
+        unit_rule_t const *rule = &unit_rules[to][i];
+        if (str_endswith(key, rule->suffix) || (rule->alt_suffix && str_endswith(key, rule->alt_suffix)))
+            return i;
+    }
+    return -1;
+}
+
+/// Make the converted key, the caller frees it.
+static char *convert_key(unit_rule_t const *rule, char const *key)
+{
+    if (!rule->alt_suffix)
+        return str_replace(key, rule->suffix, rule->to_suffix);
+    char *tmp = str_replace(key, rule->alt_suffix, rule->suffix);
+    if (!tmp)
+        return NULL;
+    char *converted = str_replace(tmp, rule->suffix, rule->to_suffix);
+    free(tmp);
+    return converted;
+}
+
+/// Intern a converted key, only called when registering the decoders.
+static char const *intern_key(char const *key)
+{
+    for (void **iter = interned_keys.elems; iter && *iter; ++iter) {
+        if (!strcmp(*iter, key))
+            return *iter;
+    }
+    char *copy = strdup(key);
+    if (!copy) {
+        WARN_STRDUP("intern_key()");
+        return NULL;
+    }
+    list_push(&interned_keys, copy);
+    return copy;
+}
+
+unit_fields_t *unit_fields_create(char const *const *fields)
+{
+    unsigned num_fields = 0;
+    for (char const *const *p = fields; p && *p; ++p) {
+        num_fields++;
+    }
+    if (!num_fields)
+        return NULL;
+
+    unsigned size = 8;
+    while (size < 2 * num_fields) {
+        size *= 2;
+    }
+    unit_fields_t *set = calloc(1, sizeof(*set) + size * sizeof(*set->slot));
+    if (!set) {
+        WARN_CALLOC("unit_fields_create()");
+        return NULL;
+    }
+    set->mask = size - 1;
+
+    for (char const *const *p = fields; *p; ++p) {
+        uint32_t hash = hash_key(*p);
+        struct unit_field *field = &set->slot[hash & set->mask];
+        while (field->key && strcmp(field->key, *p)) {
+            field = &set->slot[(field - set->slot + 1) & set->mask];
+        }
+        if (field->key)
+            continue; // declared twice
+        field->key  = *p;
+        field->hash = hash;
+        for (int to = 0; to < UNIT_SYSTEMS; ++to) {
+            field->rule[to] = find_rule(to, *p);
+            if (field->rule[to] < 0)
+                continue;
+            char *converted = convert_key(&unit_rules[to][field->rule[to]], *p);
+            field->to_key[to] = converted ? intern_key(converted) : NULL;
+            field->to_key_id[to] = data_key_lookup(field->to_key[to]);
+            free(converted);
+            if (!field->to_key[to])
+                field->rule[to] = -1; // out of memory, convert as an undeclared field
+        }
+    }
+    return set;
+}
+
+void unit_fields_free(unit_fields_t *set)
+{
+    free(set);
+}
+
+static struct unit_field const *find_field(unit_fields_t const *set, char const *key)
+{
+    if (!set)
+        return NULL;
+    uint32_t hash = hash_key(key);
+    for (unsigned i = hash & set->mask;; i = (i + 1) & set->mask) {
+        struct unit_field const *field = &set->slot[i];
+        if (!field->key)
+            return NULL;
+        if (field->hash == hash && !strcmp(field->key, key))
+            return field;
+    }
+}
+
+int unit_fields_declared(unit_fields_t const *set, char const *key)
+{
+    return find_field(set, key) != NULL;
+}
+
+/// Replace all units in the format in place, if the converted unit is not longer.
+static int replace_unit(char *format, char const *unit, char const *to_unit)
+{
+    size_t len    = strlen(unit);
+    size_t to_len = strlen(to_unit);
+    if (to_len > len)
+        return 0;
+    char *dst = format;
+    for (char const *src = format; *src;) {
+        if (!strncmp(src, unit, len)) {
+            memcpy(dst, to_unit, to_len);
+            dst += to_len;
+            src += len;
+        }
+        else {
+            *dst++ = *src++;
+        }
+    }
+    *dst = '\0';
+    return 1;
+}
+
+static void convert_format(data_t *field, unit_rule_t const *rule)
+{
+    if (!field->format)
+        return;
+    if (!rule->unit[1]) {
+        char *pos = strrchr(field->format, rule->unit[0]);
+        if (pos)
+            *pos = rule->to_unit[0];
+    }
+    else if (!replace_unit(field->format, rule->unit, rule->to_unit)) {
+        data_replace_format(field, str_replace(field->format, rule->unit, rule->to_unit));
+    }
+}
+
+void unit_convert_field(unit_fields_t const *set, unit_system_t to, data_t *field)
+{
+    if (field->type != DATA_DOUBLE)
+        return;
+
+    if (field->key_id) {
+        for (size_t i = 0; i < sizeof(well_known) / sizeof(*well_known); ++i) {
+            if (well_known[i].key_id == field->key_id && well_known[i].to == to) {
+                unit_rule_t const *rule = &unit_rules[to][well_known[i].rule];
+                field->value.v_dbl      = rule->convert(field->value.v_dbl);
+                field->key              = (char *)well_known[i].to_key; // interned keys are never written to or freed
+                field->key_id           = well_known[i].to_key_id;
+                convert_format(field, rule);
+                return;
+            }
+        }
+        return; // the other well-known keys have no unit
+    }
+
+    struct unit_field const *declared = find_field(set, field->key);
+    if (declared && declared->rule[to] < 0)
+        return;
+    if (declared) {
+        unit_rule_t const *rule = &unit_rules[to][declared->rule[to]];
+        field->value.v_dbl      = rule->convert(field->value.v_dbl);
+        if (field->heap_strings & DATA_HEAP_KEY)
+            free(field->key);
+        field->heap_strings &= ~DATA_HEAP_KEY;
+        field->key    = (char *)declared->to_key[to];
+        field->key_id = declared->to_key_id[to];
+        convert_format(field, rule);
+        return;
+    }
+
+    int i = find_rule(to, field->key);
+    if (i < 0)
+        return;
+    unit_rule_t const *rule = &unit_rules[to][i];
+    field->value.v_dbl      = rule->convert(field->value.v_dbl);
+    data_replace_key(field, convert_key(rule, field->key));
+    convert_format(field, rule);
+}
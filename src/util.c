@@ -14,13 +14,37 @@
 #include <stdio.h>
 #include <string.h>
 
-uint8_t reverse8(uint8_t x)
+/// Bit reversed bytes, constant so any number of threads can share it.
+#define REVERSE2(i) (i), (i) + 0x80, (i) + 0x40, (i) + 0xC0
+#define REVERSE4(i) REVERSE2(i), REVERSE2((i) + 0x20), REVERSE2((i) + 0x10), REVERSE2((i) + 0x30)
+#define REVERSE6(i) REVERSE4(i), REVERSE4((i) + 0x08), REVERSE4((i) + 0x04), REVERSE4((i) + 0x0C)
+static uint8_t const reverse8_table[256] = {REVERSE6(0), REVERSE6(0x02), REVERSE6(0x01), REVERSE6(0x03)};
+#undef REVERSE6
+#undef REVERSE4
+#undef REVERSE2
+
+// reverse the bits of a whole register where the CPU has an instruction for it (rbit on ARM), x86 has none
+#if defined(__GNUC__) && defined(__aarch64__)
+#define UTIL_HAVE_RBIT64
+static inline uint64_t rbit64(uint64_t x)
 {
-    x = (x & 0xF0) >> 4 | (x & 0x0F) << 4;
-    x = (x & 0xCC) >> 2 | (x & 0x33) << 2;
-    x = (x & 0xAA) >> 1 | (x & 0x55) << 1;
+    __asm__("rbit %0, %1" : "=r"(x) : "r"(x));
     return x;
 }
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTIL_HAVE_SSE2
+#include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+#define UTIL_HAVE_NEON // vrbitq_u8 is A64 only
+#include <arm_neon.h>
+#endif
+
+uint8_t reverse8(uint8_t x)
+{
+    return reverse8_table[x];
+}
 
 uint32_t reverse32(uint32_t x)
 {
@@ -30,40 +54,124 @@ uint32_t reverse32(uint32_t x)
     return ret;
 }
 
+/// Swap the halves of each bit pair and each 2-bit pair of the bytes of a word, this reflects the nibbles.
+static inline uint64_t reflect_nibbles_word(uint64_t x)
+{
+    x = (x & 0xCCCCCCCCCCCCCCCCull) >> 2 | (x & 0x3333333333333333ull) << 2;
+    x = (x & 0xAAAAAAAAAAAAAAAAull) >> 1 | (x & 0x5555555555555555ull) << 1;
+    return x;
+}
+
+/// Reverse the bits of each byte of a word, the order of the bytes does not matter.
+static inline uint64_t reflect_bytes_word(uint64_t x)
+{
+#ifdef UTIL_HAVE_RBIT64
+    return __builtin_bswap64(rbit64(x)); // the bytes come back in order
+#else
+    x = (x & 0xF0F0F0F0F0F0F0F0ull) >> 4 | (x & 0x0F0F0F0F0F0F0F0Full) << 4;
+    return reflect_nibbles_word(x);
+#endif
+}
+
+#ifdef UTIL_HAVE_SSE2
+/// Apply one swap step of the masks to 16 bytes, the masks keep the bits within each byte.
+#define SWAP_BITS_SSE2(v, mask, n) _mm_or_si128(_mm_srli_epi16(_mm_and_si128(v, _mm_set1_epi8((char)(mask))), n), \
+        _mm_slli_epi16(_mm_andnot_si128(_mm_set1_epi8((char)(mask)), v), n))
+#endif
+
 void reflect_bytes(uint8_t message[], unsigned num_bytes)
 {
-    for (unsigned i = 0; i < num_bytes; ++i) {
-        message[i] = reverse8(message[i]);
+    unsigned i = 0;
+#if defined(UTIL_HAVE_NEON)
+    for (; i + 16 <= num_bytes; i += 16) {
+        vst1q_u8(&message[i], vrbitq_u8(vld1q_u8(&message[i])));
+    }
+#elif defined(UTIL_HAVE_SSE2)
+    for (; i + 16 <= num_bytes; i += 16) {
+        __m128i v = _mm_loadu_si128((__m128i const *)&message[i]);
+        v         = SWAP_BITS_SSE2(v, 0xF0, 4);
+        v         = SWAP_BITS_SSE2(v, 0xCC, 2);
+        v         = SWAP_BITS_SSE2(v, 0xAA, 1);
+        _mm_storeu_si128((__m128i *)&message[i], v);
+    }
+#endif
+    for (; i + 8 <= num_bytes; i += 8) {
+        uint64_t w;
+        memcpy(&w, &message[i], sizeof(w));
+        w = reflect_bytes_word(w);
+        memcpy(&message[i], &w, sizeof(w));
+    }
+    for (; i < num_bytes; ++i) {
+        message[i] = reverse8_table[message[i]];
     }
 }
 
 uint8_t reflect4(uint8_t x)
 {
-    x = (x & 0xCC) >> 2 | (x & 0x33) << 2;
-    x = (x & 0xAA) >> 1 | (x & 0x55) << 1;
-    return x;
+    return reverse8_table[(uint8_t)(x << 4 | x >> 4)]; // reversing the swapped nibbles keeps the nibble order
 }
 
 void reflect_nibbles(uint8_t message[], unsigned num_bytes)
 {
-    for (unsigned i = 0; i < num_bytes; ++i) {
+    unsigned i = 0;
+#if defined(UTIL_HAVE_NEON)
+    for (; i + 16 <= num_bytes; i += 16) {
+        uint8x16_t v = vrbitq_u8(vld1q_u8(&message[i]));
+        vst1q_u8(&message[i], vorrq_u8(vshrq_n_u8(v, 4), vshlq_n_u8(v, 4)));
+    }
+#elif defined(UTIL_HAVE_SSE2)
+    for (; i + 16 <= num_bytes; i += 16) {
+        __m128i v = _mm_loadu_si128((__m128i const *)&message[i]);
+        v         = SWAP_BITS_SSE2(v, 0xCC, 2);
+        v         = SWAP_BITS_SSE2(v, 0xAA, 1);
+        _mm_storeu_si128((__m128i *)&message[i], v);
+    }
+#endif
+    for (; i + 8 <= num_bytes; i += 8) {
+        uint64_t w;
+        memcpy(&w, &message[i], sizeof(w));
+        w = reflect_nibbles_word(w);
+        memcpy(&message[i], &w, sizeof(w));
+    }
+    for (; i < num_bytes; ++i) {
         message[i] = reflect4(message[i]);
     }
 }
 
+/// Get the bits from a bit offset in the top of a word, at least 57 bits, the bits from the end byte on read as zero.
+static inline uint64_t peek_bits(uint8_t const *message, unsigned end_byte, unsigned offset_bits)
+{
+    unsigned byte = offset_bits / 8;
+    uint64_t w    = 0;
+    if (byte + 8 <= end_byte) {
+        for (unsigned i = 0; i < 8; ++i)
+            w = w << 8 | message[byte + i];
+    }
+    else {
+        for (unsigned i = 0; i < 8; ++i)
+            w = w << 8 | (byte + i < end_byte ? message[byte + i] : 0);
+    }
+    return w << (offset_bits % 8);
+}
+
 unsigned extract_nibbles_4b1s(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint8_t *dst)
 {
-    unsigned ret = 0;
+    unsigned ret      = 0;
+    unsigned end_byte = (offset_bits + num_bits + 7) / 8;
 
     while (num_bits >= 5) {
-        uint16_t bits = (message[offset_bits / 8] << 8) | message[(offset_bits / 8) + 1];
-        bits >>= 11 - (offset_bits % 8); // align 5 bits to LSB
-        if ((bits & 1) != 1)
-            break; // stuff-bit error
-        *dst++ = (bits >> 1) & 0xf;
-        ret += 1;
-        offset_bits += 5;
-        num_bits -= 5;
+        // 11 groups of 5 bits from one word
+        uint64_t w = peek_bits(message, end_byte, offset_bits);
+        for (unsigned k = 0; k < 11 && num_bits >= 5; ++k) {
+            unsigned bits = (unsigned)(w >> 59); // 5 bits
+            if ((bits & 1) != 1)
+                return ret; // stuff-bit error
+            *dst++ = (bits >> 1) & 0xf;
+            ret += 1;
+            offset_bits += 5;
+            num_bits -= 5;
+            w <<= 5;
+        }
     }
 
     return ret;
@@ -71,83 +179,85 @@ unsigned extract_nibbles_4b1s(uint8_t *message, unsigned offset_bits, unsigned n
 
 unsigned extract_bytes_uart(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint8_t *dst)
 {
-    unsigned ret = 0;
+    unsigned ret      = 0;
+    unsigned end_byte = (offset_bits + num_bits + 7) / 8;
 
     while (num_bits >= 10) {
-        int startb = message[offset_bits / 8] >> (7 - (offset_bits % 8));
-        offset_bits += 1;
-        int datab = message[offset_bits / 8];
-        if (offset_bits % 8) {
-            datab = (message[offset_bits / 8] << 8) | message[offset_bits / 8 + 1];
-            datab >>= 8 - (offset_bits % 8);
+        // 5 frames of 10 bits from one word
+        uint64_t w = peek_bits(message, end_byte, offset_bits);
+        for (unsigned k = 0; k < 5 && num_bits >= 10; ++k) {
+            unsigned startb = (unsigned)(w >> 63);
+            unsigned datab  = (unsigned)(w >> 55) & 0xff;
+            unsigned stopb  = (unsigned)(w >> 54) & 1;
+            if (startb != 0)
+                return ret; // start-bit error
+            if (stopb != 1)
+                return ret; // stop-bit error
+            *dst++ = reverse8(datab);
+            ret += 1;
+            offset_bits += 10;
+            num_bits -= 10;
+            w <<= 10;
         }
-        offset_bits += 8;
-        int stopb = message[offset_bits / 8] >> (7 - (offset_bits % 8));
-        offset_bits += 1;
-        if ((startb & 1) != 0)
-            break; // start-bit error
-        if ((stopb & 1) != 1)
-            break; // stop-bit error
-        *dst++ = reverse8(datab & 0xff);
-        ret += 1;
-        num_bits -= 10;
     }
 
     return ret;
 }
 
-static unsigned symbol_match(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint32_t symbol)
+/// A symbol of extract_bits_symbols() as a mask and the masked bits, the top bits of a word are compared.
+typedef struct {
+    uint32_t mask;
+    uint32_t bits;
+    unsigned len;
+} symbol_t;
+
+static symbol_t symbol_compile(uint32_t symbol)
 {
-    unsigned symbol_len = symbol & 0x1f;
+    symbol_t s;
+    s.len  = symbol & 0x1f;
+    s.mask = s.len ? ~0u << (32 - s.len) : 0;
+    s.bits = symbol & s.mask;
+    return s;
+}
 
-    // check required len
-    if (num_bits < symbol_len) {
+/// Match a symbol on the bits at the top of the window, returns the symbol length or 0.
+static inline unsigned symbol_match(symbol_t const *s, uint32_t window, unsigned num_bits)
+{
+    // check required len, an empty symbol never matches
+    if (!s->len || num_bits < s->len)
         return 0;
-    }
-
-    // match each bit otherwise abort
-    for (unsigned pos = 0; pos < symbol_len; ++pos) {
-        unsigned m_pos = offset_bits + pos;
-        unsigned m_bit = message[m_pos / 8] >> (7 - (m_pos % 8));
-        unsigned s_bit = symbol >> (31 - pos);
-        if ((m_bit & 1) != (s_bit & 1)) {
-            return 0;
-        }
-    }
-
-    return symbol_len;
+    return (window & s->mask) == s->bits ? s->len : 0;
 }
 
 unsigned extract_bits_symbols(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint32_t zero, uint32_t one, uint32_t sync, uint8_t *dst)
 {
-    unsigned zero_len = zero & 0x1f;
-    unsigned one_len  = one & 0x1f;
-    unsigned sync_len = sync & 0x1f;
+    symbol_t const zero_sym = symbol_compile(zero);
+    symbol_t const one_sym  = symbol_compile(one);
+    symbol_t const sync_sym = symbol_compile(sync);
+    unsigned end_byte       = (offset_bits + num_bits + 7) / 8;
 
     unsigned dst_len = 0;
 
     while (num_bits >= 1) {
+        uint32_t window = (uint32_t)(peek_bits(message, end_byte, offset_bits) >> 32);
+        unsigned len;
         // TODO: match the longest symbol first
-        if (symbol_match(message, offset_bits, num_bits, sync)) {
-            offset_bits += sync_len;
-            num_bits -= sync_len;
+        if ((len = symbol_match(&sync_sym, window, num_bits))) {
             // just skip
         }
-        else if (symbol_match(message, offset_bits, num_bits, zero)) {
-            offset_bits += zero_len;
-            num_bits -= zero_len;
+        else if ((len = symbol_match(&zero_sym, window, num_bits))) {
             // no need to set a zero
             dst_len += 1;
         }
-        else if (symbol_match(message, offset_bits, num_bits, one)) {
-            offset_bits += one_len;
-            num_bits -= one_len;
+        else if ((len = symbol_match(&one_sym, window, num_bits))) {
             dst[dst_len / 8] |= 0x80 >> (dst_len % 8);
             dst_len += 1;
         }
         else {
             break;
         }
+        offset_bits += len;
+        num_bits -= len;
     }
 
     // fprintf(stderr, "extract_bits_symbols: %x %x %x : %u (%u)\n", zero, one, sync, dst_len, num_bits);
@@ -192,7 +302,194 @@ uint8_t crc7(uint8_t const message[], unsigned nBytes, uint8_t polynomial, uint8
     return remainder >> 1 & 0x7f; // discard the LSB
 }
 
-uint8_t crc8(uint8_t const message[], unsigned nBytes, uint8_t polynomial, uint8_t init)
+// Lookup tables for the most used polynomials, other polynomials use the bitwise loop.
+// Each entry is the remainder after shifting one message byte through.
+
+/// crc8() table for polynomial 0x31.
+static uint8_t const crc8_table_31[256] = {
+        0x00, 0x31, 0x62, 0x53, 0xc4, 0xf5, 0xa6, 0x97, 0xb9, 0x88, 0xdb, 0xea, 0x7d, 0x4c, 0x1f, 0x2e,
+        0x43, 0x72, 0x21, 0x10, 0x87, 0xb6, 0xe5, 0xd4, 0xfa, 0xcb, 0x98, 0xa9, 0x3e, 0x0f, 0x5c, 0x6d,
+        0x86, 0xb7, 0xe4, 0xd5, 0x42, 0x73, 0x20, 0x11, 0x3f, 0x0e, 0x5d, 0x6c, 0xfb, 0xca, 0x99, 0xa8,
+        0xc5, 0xf4, 0xa7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7c, 0x4d, 0x1e, 0x2f, 0xb8, 0x89, 0xda, 0xeb,
+        0x3d, 0x0c, 0x5f, 0x6e, 0xf9, 0xc8, 0x9b, 0xaa, 0x84, 0xb5, 0xe6, 0xd7, 0x40, 0x71, 0x22, 0x13,
+        0x7e, 0x4f, 0x1c, 0x2d, 0xba, 0x8b, 0xd8, 0xe9, 0xc7, 0xf6, 0xa5, 0x94, 0x03, 0x32, 0x61, 0x50,
+        0xbb, 0x8a, 0xd9, 0xe8, 0x7f, 0x4e, 0x1d, 0x2c, 0x02, 0x33, 0x60, 0x51, 0xc6, 0xf7, 0xa4, 0x95,
+        0xf8, 0xc9, 0x9a, 0xab, 0x3c, 0x0d, 0x5e, 0x6f, 0x41, 0x70, 0x23, 0x12, 0x85, 0xb4, 0xe7, 0xd6,
+        0x7a, 0x4b, 0x18, 0x29, 0xbe, 0x8f, 0xdc, 0xed, 0xc3, 0xf2, 0xa1, 0x90, 0x07, 0x36, 0x65, 0x54,
+        0x39, 0x08, 0x5b, 0x6a, 0xfd, 0xcc, 0x9f, 0xae, 0x80, 0xb1, 0xe2, 0xd3, 0x44, 0x75, 0x26, 0x17,
+        0xfc, 0xcd, 0x9e, 0xaf, 0x38, 0x09, 0x5a, 0x6b, 0x45, 0x74, 0x27, 0x16, 0x81, 0xb0, 0xe3, 0xd2,
+        0xbf, 0x8e, 0xdd, 0xec, 0x7b, 0x4a, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xc2, 0xf3, 0xa0, 0x91,
+        0x47, 0x76, 0x25, 0x14, 0x83, 0xb2, 0xe1, 0xd0, 0xfe, 0xcf, 0x9c, 0xad, 0x3a, 0x0b, 0x58, 0x69,
+        0x04, 0x35, 0x66, 0x57, 0xc0, 0xf1, 0xa2, 0x93, 0xbd, 0x8c, 0xdf, 0xee, 0x79, 0x48, 0x1b, 0x2a,
+        0xc1, 0xf0, 0xa3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1a, 0x2b, 0xbc, 0x8d, 0xde, 0xef,
+        0x82, 0xb3, 0xe0, 0xd1, 0x46, 0x77, 0x24, 0x15, 0x3b, 0x0a, 0x59, 0x68, 0xff, 0xce, 0x9d, 0xac,
+};
+
+/// crc8() table for polynomial 0x07.
+static uint8_t const crc8_table_07[256] = {
+        0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15, 0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d,
+        0x70, 0x77, 0x7e, 0x79, 0x6c, 0x6b, 0x62, 0x65, 0x48, 0x4f, 0x46, 0x41, 0x54, 0x53, 0x5a, 0x5d,
+        0xe0, 0xe7, 0xee, 0xe9, 0xfc, 0xfb, 0xf2, 0xf5, 0xd8, 0xdf, 0xd6, 0xd1, 0xc4, 0xc3, 0xca, 0xcd,
+        0x90, 0x97, 0x9e, 0x99, 0x8c, 0x8b, 0x82, 0x85, 0xa8, 0xaf, 0xa6, 0xa1, 0xb4, 0xb3, 0xba, 0xbd,
+        0xc7, 0xc0, 0xc9, 0xce, 0xdb, 0xdc, 0xd5, 0xd2, 0xff, 0xf8, 0xf1, 0xf6, 0xe3, 0xe4, 0xed, 0xea,
+        0xb7, 0xb0, 0xb9, 0xbe, 0xab, 0xac, 0xa5, 0xa2, 0x8f, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9d, 0x9a,
+        0x27, 0x20, 0x29, 0x2e, 0x3b, 0x3c, 0x35, 0x32, 0x1f, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0d, 0x0a,
+        0x57, 0x50, 0x59, 0x5e, 0x4b, 0x4c, 0x45, 0x42, 0x6f, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7d, 0x7a,
+        0x89, 0x8e, 0x87, 0x80, 0x95, 0x92, 0x9b, 0x9c, 0xb1, 0xb6, 0xbf, 0xb8, 0xad, 0xaa, 0xa3, 0xa4,
+        0xf9, 0xfe, 0xf7, 0xf0, 0xe5, 0xe2, 0xeb, 0xec, 0xc1, 0xc6, 0xcf, 0xc8, 0xdd, 0xda, 0xd3, 0xd4,
+        0x69, 0x6e, 0x67, 0x60, 0x75, 0x72, 0x7b, 0x7c, 0x51, 0x56, 0x5f, 0x58, 0x4d, 0x4a, 0x43, 0x44,
+        0x19, 0x1e, 0x17, 0x10, 0x05, 0x02, 0x0b, 0x0c, 0x21, 0x26, 0x2f, 0x28, 0x3d, 0x3a, 0x33, 0x34,
+        0x4e, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5c, 0x5b, 0x76, 0x71, 0x78, 0x7f, 0x6a, 0x6d, 0x64, 0x63,
+        0x3e, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2c, 0x2b, 0x06, 0x01, 0x08, 0x0f, 0x1a, 0x1d, 0x14, 0x13,
+        0xae, 0xa9, 0xa0, 0xa7, 0xb2, 0xb5, 0xbc, 0xbb, 0x96, 0x91, 0x98, 0x9f, 0x8a, 0x8d, 0x84, 0x83,
+        0xde, 0xd9, 0xd0, 0xd7, 0xc2, 0xc5, 0xcc, 0xcb, 0xe6, 0xe1, 0xe8, 0xef, 0xfa, 0xfd, 0xf4, 0xf3,
+};
+
+/// crc16() table for polynomial 0x1021.
+static uint16_t const crc16_table_1021[256] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+        0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+        0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+        0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+        0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+        0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+        0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+        0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+        0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+        0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+        0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+        0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+        0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+        0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+        0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+        0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+        0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+        0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+        0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+        0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+        0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+        0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+        0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+        0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+        0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+        0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+        0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+        0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+        0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+        0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+        0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+        0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0,
+};
+
+/// crc16() table for polynomial 0x8005.
+static uint16_t const crc16_table_8005[256] = {
+        0x0000, 0x8005, 0x800f, 0x000a, 0x801b, 0x001e, 0x0014, 0x8011,
+        0x8033, 0x0036, 0x003c, 0x8039, 0x0028, 0x802d, 0x8027, 0x0022,
+        0x8063, 0x0066, 0x006c, 0x8069, 0x0078, 0x807d, 0x8077, 0x0072,
+        0x0050, 0x8055, 0x805f, 0x005a, 0x804b, 0x004e, 0x0044, 0x8041,
+        0x80c3, 0x00c6, 0x00cc, 0x80c9, 0x00d8, 0x80dd, 0x80d7, 0x00d2,
+        0x00f0, 0x80f5, 0x80ff, 0x00fa, 0x80eb, 0x00ee, 0x00e4, 0x80e1,
+        0x00a0, 0x80a5, 0x80af, 0x00aa, 0x80bb, 0x00be, 0x00b4, 0x80b1,
+        0x8093, 0x0096, 0x009c, 0x8099, 0x0088, 0x808d, 0x8087, 0x0082,
+        0x8183, 0x0186, 0x018c, 0x8189, 0x0198, 0x819d, 0x8197, 0x0192,
+        0x01b0, 0x81b5, 0x81bf, 0x01ba, 0x81ab, 0x01ae, 0x01a4, 0x81a1,
+        0x01e0, 0x81e5, 0x81ef, 0x01ea, 0x81fb, 0x01fe, 0x01f4, 0x81f1,
+        0x81d3, 0x01d6, 0x01dc, 0x81d9, 0x01c8, 0x81cd, 0x81c7, 0x01c2,
+        0x0140, 0x8145, 0x814f, 0x014a, 0x815b, 0x015e, 0x0154, 0x8151,
+        0x8173, 0x0176, 0x017c, 0x8179, 0x0168, 0x816d, 0x8167, 0x0162,
+        0x8123, 0x0126, 0x012c, 0x8129, 0x0138, 0x813d, 0x8137, 0x0132,
+        0x0110, 0x8115, 0x811f, 0x011a, 0x810b, 0x010e, 0x0104, 0x8101,
+        0x8303, 0x0306, 0x030c, 0x8309, 0x0318, 0x831d, 0x8317, 0x0312,
+        0x0330, 0x8335, 0x833f, 0x033a, 0x832b, 0x032e, 0x0324, 0x8321,
+        0x0360, 0x8365, 0x836f, 0x036a, 0x837b, 0x037e, 0x0374, 0x8371,
+        0x8353, 0x0356, 0x035c, 0x8359, 0x0348, 0x834d, 0x8347, 0x0342,
+        0x03c0, 0x83c5, 0x83cf, 0x03ca, 0x83db, 0x03de, 0x03d4, 0x83d1,
+        0x83f3, 0x03f6, 0x03fc, 0x83f9, 0x03e8, 0x83ed, 0x83e7, 0x03e2,
+        0x83a3, 0x03a6, 0x03ac, 0x83a9, 0x03b8, 0x83bd, 0x83b7, 0x03b2,
+        0x0390, 0x8395, 0x839f, 0x039a, 0x838b, 0x038e, 0x0384, 0x8381,
+        0x0280, 0x8285, 0x828f, 0x028a, 0x829b, 0x029e, 0x0294, 0x8291,
+        0x82b3, 0x02b6, 0x02bc, 0x82b9, 0x02a8, 0x82ad, 0x82a7, 0x02a2,
+        0x82e3, 0x02e6, 0x02ec, 0x82e9, 0x02f8, 0x82fd, 0x82f7, 0x02f2,
+        0x02d0, 0x82d5, 0x82df, 0x02da, 0x82cb, 0x02ce, 0x02c4, 0x82c1,
+        0x8243, 0x0246, 0x024c, 0x8249, 0x0258, 0x825d, 0x8257, 0x0252,
+        0x0270, 0x8275, 0x827f, 0x027a, 0x826b, 0x026e, 0x0264, 0x8261,
+        0x0220, 0x8225, 0x822f, 0x022a, 0x823b, 0x023e, 0x0234, 0x8231,
+        0x8213, 0x0216, 0x021c, 0x8219, 0x0208, 0x820d, 0x8207, 0x0202,
+};
+
+/// crc16lsb() table for polynomial 0x8408.
+static uint16_t const crc16lsb_table_8408[256] = {
+        0x0000, 0x1189, 0x2312, 0x329b, 0x4624, 0x57ad, 0x6536, 0x74bf,
+        0x8c48, 0x9dc1, 0xaf5a, 0xbed3, 0xca6c, 0xdbe5, 0xe97e, 0xf8f7,
+        0x1081, 0x0108, 0x3393, 0x221a, 0x56a5, 0x472c, 0x75b7, 0x643e,
+        0x9cc9, 0x8d40, 0xbfdb, 0xae52, 0xdaed, 0xcb64, 0xf9ff, 0xe876,
+        0x2102, 0x308b, 0x0210, 0x1399, 0x6726, 0x76af, 0x4434, 0x55bd,
+        0xad4a, 0xbcc3, 0x8e58, 0x9fd1, 0xeb6e, 0xfae7, 0xc87c, 0xd9f5,
+        0x3183, 0x200a, 0x1291, 0x0318, 0x77a7, 0x662e, 0x54b5, 0x453c,
+        0xbdcb, 0xac42, 0x9ed9, 0x8f50, 0xfbef, 0xea66, 0xd8fd, 0xc974,
+        0x4204, 0x538d, 0x6116, 0x709f, 0x0420, 0x15a9, 0x2732, 0x36bb,
+        0xce4c, 0xdfc5, 0xed5e, 0xfcd7, 0x8868, 0x99e1, 0xab7a, 0xbaf3,
+        0x5285, 0x430c, 0x7197, 0x601e, 0x14a1, 0x0528, 0x37b3, 0x263a,
+        0xdecd, 0xcf44, 0xfddf, 0xec56, 0x98e9, 0x8960, 0xbbfb, 0xaa72,
+        0x6306, 0x728f, 0x4014, 0x519d, 0x2522, 0x34ab, 0x0630, 0x17b9,
+        0xef4e, 0xfec7, 0xcc5c, 0xddd5, 0xa96a, 0xb8e3, 0x8a78, 0x9bf1,
+        0x7387, 0x620e, 0x5095, 0x411c, 0x35a3, 0x242a, 0x16b1, 0x0738,
+        0xffcf, 0xee46, 0xdcdd, 0xcd54, 0xb9eb, 0xa862, 0x9af9, 0x8b70,
+        0x8408, 0x9581, 0xa71a, 0xb693, 0xc22c, 0xd3a5, 0xe13e, 0xf0b7,
+        0x0840, 0x19c9, 0x2b52, 0x3adb, 0x4e64, 0x5fed, 0x6d76, 0x7cff,
+        0x9489, 0x8500, 0xb79b, 0xa612, 0xd2ad, 0xc324, 0xf1bf, 0xe036,
+        0x18c1, 0x0948, 0x3bd3, 0x2a5a, 0x5ee5, 0x4f6c, 0x7df7, 0x6c7e,
+        0xa50a, 0xb483, 0x8618, 0x9791, 0xe32e, 0xf2a7, 0xc03c, 0xd1b5,
+        0x2942, 0x38cb, 0x0a50, 0x1bd9, 0x6f66, 0x7eef, 0x4c74, 0x5dfd,
+        0xb58b, 0xa402, 0x9699, 0x8710, 0xf3af, 0xe226, 0xd0bd, 0xc134,
+        0x39c3, 0x284a, 0x1ad1, 0x0b58, 0x7fe7, 0x6e6e, 0x5cf5, 0x4d7c,
+        0xc60c, 0xd785, 0xe51e, 0xf497, 0x8028, 0x91a1, 0xa33a, 0xb2b3,
+        0x4a44, 0x5bcd, 0x6956, 0x78df, 0x0c60, 0x1de9, 0x2f72, 0x3efb,
+        0xd68d, 0xc704, 0xf59f, 0xe416, 0x90a9, 0x8120, 0xb3bb, 0xa232,
+        0x5ac5, 0x4b4c, 0x79d7, 0x685e, 0x1ce1, 0x0d68, 0x3ff3, 0x2e7a,
+        0xe70e, 0xf687, 0xc41c, 0xd595, 0xa12a, 0xb0a3, 0x8238, 0x93b1,
+        0x6b46, 0x7acf, 0x4854, 0x59dd, 0x2d62, 0x3ceb, 0x0e70, 0x1ff9,
+        0xf78f, 0xe606, 0xd49d, 0xc514, 0xb1ab, 0xa022, 0x92b9, 0x8330,
+        0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78,
+};
+
+/// crc16lsb() table for polynomial 0xa001.
+static uint16_t const crc16lsb_table_a001[256] = {
+        0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241,
+        0xc601, 0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1, 0xc481, 0x0440,
+        0xcc01, 0x0cc0, 0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40,
+        0x0a00, 0xcac1, 0xcb81, 0x0b40, 0xc901, 0x09c0, 0x0880, 0xc841,
+        0xd801, 0x18c0, 0x1980, 0xd941, 0x1b00, 0xdbc1, 0xda81, 0x1a40,
+        0x1e00, 0xdec1, 0xdf81, 0x1f40, 0xdd01, 0x1dc0, 0x1c80, 0xdc41,
+        0x1400, 0xd4c1, 0xd581, 0x1540, 0xd701, 0x17c0, 0x1680, 0xd641,
+        0xd201, 0x12c0, 0x1380, 0xd341, 0x1100, 0xd1c1, 0xd081, 0x1040,
+        0xf001, 0x30c0, 0x3180, 0xf141, 0x3300, 0xf3c1, 0xf281, 0x3240,
+        0x3600, 0xf6c1, 0xf781, 0x3740, 0xf501, 0x35c0, 0x3480, 0xf441,
+        0x3c00, 0xfcc1, 0xfd81, 0x3d40, 0xff01, 0x3fc0, 0x3e80, 0xfe41,
+        0xfa01, 0x3ac0, 0x3b80, 0xfb41, 0x3900, 0xf9c1, 0xf881, 0x3840,
+        0x2800, 0xe8c1, 0xe981, 0x2940, 0xeb01, 0x2bc0, 0x2a80, 0xea41,
+        0xee01, 0x2ec0, 0x2f80, 0xef41, 0x2d00, 0xedc1, 0xec81, 0x2c40,
+        0xe401, 0x24c0, 0x2580, 0xe541, 0x2700, 0xe7c1, 0xe681, 0x2640,
+        0x2200, 0xe2c1, 0xe381, 0x2340, 0xe101, 0x21c0, 0x2080, 0xe041,
+        0xa001, 0x60c0, 0x6180, 0xa141, 0x6300, 0xa3c1, 0xa281, 0x6240,
+        0x6600, 0xa6c1, 0xa781, 0x6740, 0xa501, 0x65c0, 0x6480, 0xa441,
+        0x6c00, 0xacc1, 0xad81, 0x6d40, 0xaf01, 0x6fc0, 0x6e80, 0xae41,
+        0xaa01, 0x6ac0, 0x6b80, 0xab41, 0x6900, 0xa9c1, 0xa881, 0x6840,
+        0x7800, 0xb8c1, 0xb981, 0x7940, 0xbb01, 0x7bc0, 0x7a80, 0xba41,
+        0xbe01, 0x7ec0, 0x7f80, 0xbf41, 0x7d00, 0xbdc1, 0xbc81, 0x7c40,
+        0xb401, 0x74c0, 0x7580, 0xb541, 0x7700, 0xb7c1, 0xb681, 0x7640,
+        0x7200, 0xb2c1, 0xb381, 0x7340, 0xb101, 0x71c0, 0x7080, 0xb041,
+        0x5000, 0x90c1, 0x9181, 0x5140, 0x9301, 0x53c0, 0x5280, 0x9241,
+        0x9601, 0x56c0, 0x5780, 0x9741, 0x5500, 0x95c1, 0x9481, 0x5440,
+        0x9c01, 0x5cc0, 0x5d80, 0x9d41, 0x5f00, 0x9fc1, 0x9e81, 0x5e40,
+        0x5a00, 0x9ac1, 0x9b81, 0x5b40, 0x9901, 0x59c0, 0x5880, 0x9841,
+        0x8801, 0x48c0, 0x4980, 0x8941, 0x4b00, 0x8bc1, 0x8a81, 0x4a40,
+        0x4e00, 0x8ec1, 0x8f81, 0x4f40, 0x8d01, 0x4dc0, 0x4c80, 0x8c41,
+        0x4400, 0x84c1, 0x8581, 0x4540, 0x8701, 0x47c0, 0x4680, 0x8641,
+        0x8201, 0x42c0, 0x4380, 0x8341, 0x4100, 0x81c1, 0x8081, 0x4040,
+};
+
+static uint8_t crc8_bitwise(uint8_t const message[], unsigned nBytes, uint8_t polynomial, uint8_t init)
 {
     uint8_t remainder = init;
     unsigned byte, bit;
@@ -229,7 +526,7 @@ uint8_t crc8le(uint8_t const message[], unsigned nBytes, uint8_t polynomial, uin
     return remainder;
 }
 
-uint16_t crc16lsb(uint8_t const message[], unsigned nBytes, uint16_t polynomial, uint16_t init)
+static uint16_t crc16lsb_bitwise(uint8_t const message[], unsigned nBytes, uint16_t polynomial, uint16_t init)
 {
     uint16_t remainder = init;
     unsigned byte, bit;
@@ -248,7 +545,7 @@ uint16_t crc16lsb(uint8_t const message[], unsigned nBytes, uint16_t polynomial,
     return remainder;
 }
 
-uint16_t crc16(uint8_t const message[], unsigned nBytes, uint16_t polynomial, uint16_t init)
+static uint16_t crc16_bitwise(uint8_t const message[], unsigned nBytes, uint16_t polynomial, uint16_t init)
 {
     uint16_t remainder = init;
     unsigned byte, bit;
@@ -267,6 +564,48 @@ uint16_t crc16(uint8_t const message[], unsigned nBytes, uint16_t polynomial, ui
     return remainder;
 }
 
+uint8_t crc8(uint8_t const message[], unsigned nBytes, uint8_t polynomial, uint8_t init)
+{
+    uint8_t const *table = polynomial == 0x31 ? crc8_table_31
+            : polynomial == 0x07 ? crc8_table_07 : NULL;
+    if (!table)
+        return crc8_bitwise(message, nBytes, polynomial, init);
+
+    uint8_t remainder = init;
+    for (unsigned byte = 0; byte < nBytes; ++byte) {
+        remainder = table[remainder ^ message[byte]];
+    }
+    return remainder;
+}
+
+uint16_t crc16lsb(uint8_t const message[], unsigned nBytes, uint16_t polynomial, uint16_t init)
+{
+    uint16_t const *table = polynomial == 0x8408 ? crc16lsb_table_8408
+            : polynomial == 0xa001 ? crc16lsb_table_a001 : NULL;
+    if (!table)
+        return crc16lsb_bitwise(message, nBytes, polynomial, init);
+
+    uint16_t remainder = init;
+    for (unsigned byte = 0; byte < nBytes; ++byte) {
+        remainder = (remainder >> 8) ^ table[(remainder ^ message[byte]) & 0xff];
+    }
+    return remainder;
+}
+
+uint16_t crc16(uint8_t const message[], unsigned nBytes, uint16_t polynomial, uint16_t init)
+{
+    uint16_t const *table = polynomial == 0x1021 ? crc16_table_1021
+            : polynomial == 0x8005 ? crc16_table_8005 : NULL;
+    if (!table)
+        return crc16_bitwise(message, nBytes, polynomial, init);
+
+    uint16_t remainder = init;
+    for (unsigned byte = 0; byte < nBytes; ++byte) {
+        remainder = (uint16_t)(remainder << 8) ^ table[(remainder >> 8) ^ message[byte]];
+    }
+    return remainder;
+}
+
 uint8_t lfsr_digest8(uint8_t const message[], unsigned bytes, uint8_t gen, uint8_t key)
 {
     uint8_t sum = 0;
@@ -422,6 +761,109 @@ int add_nibbles(uint8_t const message[], unsigned num_bytes)
         } \
     } while (0)
 
+// the bit at a time extraction, to compare the word at a time extraction to
+static unsigned extract_nibbles_4b1s_bitwise(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint8_t *dst)
+{
+    unsigned ret = 0;
+
+    while (num_bits >= 5) {
+        uint16_t bits = (message[offset_bits / 8] << 8) | message[(offset_bits / 8) + 1];
+        bits >>= 11 - (offset_bits % 8); // align 5 bits to LSB
+        if ((bits & 1) != 1)
+            break; // stuff-bit error
+        *dst++ = (bits >> 1) & 0xf;
+        ret += 1;
+        offset_bits += 5;
+        num_bits -= 5;
+    }
+
+    return ret;
+}
+
+static unsigned extract_bytes_uart_bitwise(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint8_t *dst)
+{
+    unsigned ret = 0;
+
+    while (num_bits >= 10) {
+        int startb = message[offset_bits / 8] >> (7 - (offset_bits % 8));
+        offset_bits += 1;
+        int datab = message[offset_bits / 8];
+        if (offset_bits % 8) {
+            datab = (message[offset_bits / 8] << 8) | message[offset_bits / 8 + 1];
+            datab >>= 8 - (offset_bits % 8);
+        }
+        offset_bits += 8;
+        int stopb = message[offset_bits / 8] >> (7 - (offset_bits % 8));
+        offset_bits += 1;
+        if ((startb & 1) != 0)
+            break; // start-bit error
+        if ((stopb & 1) != 1)
+            break; // stop-bit error
+        *dst++ = reverse8(datab & 0xff);
+        ret += 1;
+        num_bits -= 10;
+    }
+
+    return ret;
+}
+
+static unsigned symbol_match_bitwise(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint32_t symbol)
+{
+    unsigned symbol_len = symbol & 0x1f;
+
+    // check required len
+    if (num_bits < symbol_len) {
+        return 0;
+    }
+
+    // match each bit otherwise abort
+    for (unsigned pos = 0; pos < symbol_len; ++pos) {
+        unsigned m_pos = offset_bits + pos;
+        unsigned m_bit = message[m_pos / 8] >> (7 - (m_pos % 8));
+        unsigned s_bit = symbol >> (31 - pos);
+        if ((m_bit & 1) != (s_bit & 1)) {
+            return 0;
+        }
+    }
+
+    return symbol_len;
+}
+
+static unsigned extract_bits_symbols_bitwise(uint8_t *message, unsigned offset_bits, unsigned num_bits, uint32_t zero, uint32_t one, uint32_t sync, uint8_t *dst)
+{
+    unsigned zero_len = zero & 0x1f;
+    unsigned one_len  = one & 0x1f;
+    unsigned sync_len = sync & 0x1f;
+
+    unsigned dst_len = 0;
+
+    while (num_bits >= 1) {
+        // TODO: match the longest symbol first
+        if (symbol_match_bitwise(message, offset_bits, num_bits, sync)) {
+            offset_bits += sync_len;
+            num_bits -= sync_len;
+            // just skip
+        }
+        else if (symbol_match_bitwise(message, offset_bits, num_bits, zero)) {
+            offset_bits += zero_len;
+            num_bits -= zero_len;
+            // no need to set a zero
+            dst_len += 1;
+        }
+        else if (symbol_match_bitwise(message, offset_bits, num_bits, one)) {
+            offset_bits += one_len;
+            num_bits -= one_len;
+            dst[dst_len / 8] |= 0x80 >> (dst_len % 8);
+            dst_len += 1;
+        }
+        else {
+            break;
+        }
+    }
+
+    return dst_len;
+}
+
 int main(void) {
     unsigned passed = 0;
     unsigned failed = 0;
@@ -455,6 +897,84 @@ int main(void) {
     ASSERT_EQUALS(bytes[3], 0x02);
     ASSERT_EQUALS(bytes[4], 0x03);
 
+    fprintf(stderr, "util::crc8(), crc16(), crc16lsb(): tables\n");
+    unsigned mismatches = 0; // compared to the bitwise loops
+    uint8_t random_msg[32];
+    srand(1);
+    for (unsigned k = 0; k < 1000; ++k) {
+        unsigned len = rand() % sizeof(random_msg);
+        for (unsigned i = 0; i < len; ++i)
+            random_msg[i] = rand();
+        uint16_t init = rand();
+        mismatches += crc8(random_msg, len, 0x31, init) != crc8_bitwise(random_msg, len, 0x31, init);
+        mismatches += crc8(random_msg, len, 0x07, init) != crc8_bitwise(random_msg, len, 0x07, init);
+        mismatches += crc16(random_msg, len, 0x1021, init) != crc16_bitwise(random_msg, len, 0x1021, init);
+        mismatches += crc16(random_msg, len, 0x8005, init) != crc16_bitwise(random_msg, len, 0x8005, init);
+        mismatches += crc16lsb(random_msg, len, 0x8408, init) != crc16lsb_bitwise(random_msg, len, 0x8408, init);
+        mismatches += crc16lsb(random_msg, len, 0xa001, init) != crc16lsb_bitwise(random_msg, len, 0xa001, init);
+    }
+    ASSERT_EQUALS(mismatches, 0);
+
+    fprintf(stderr, "util::reverse8(), reflect4(), reflect_bytes(), reflect_nibbles(): tables and words\n");
+    mismatches = 0; // compared to reversing bit by bit
+    for (unsigned x = 0; x < 256; ++x) {
+        unsigned rev = 0;
+        for (unsigned bit = 0; bit < 8; ++bit)
+            rev |= ((x >> bit) & 1) << (7 - bit);
+        mismatches += reverse8(x) != rev;
+        mismatches += reflect4(x) != ((rev >> 4) | (rev << 4 & 0xf0));
+    }
+    for (unsigned len = 0; len < sizeof(random_msg); ++len) {
+        uint8_t reflected[sizeof(random_msg)];
+        uint8_t nibbles[sizeof(random_msg)];
+        for (unsigned i = 0; i < len; ++i)
+            random_msg[i] = reflected[i] = nibbles[i] = rand();
+        reflect_bytes(reflected, len);
+        reflect_nibbles(nibbles, len);
+        for (unsigned i = 0; i < len; ++i) {
+            mismatches += reflected[i] != reverse8(random_msg[i]);
+            mismatches += nibbles[i] != reflect4(random_msg[i]);
+        }
+    }
+    ASSERT_EQUALS(mismatches, 0);
+
+    fprintf(stderr, "util::extract_nibbles_4b1s(), extract_bytes_uart(), extract_bits_symbols(): words\n");
+    mismatches = 0; // compared to extracting bit by bit
+    uint32_t const symbols[][3] = {
+            {0x40000002, 0xc0000002, 0x00000000}, // 01 / 11
+            {0x80000003, 0xe0000003, 0x00000004}, // 100 / 111 / 0000
+            {0x8000001f, 0x7fffffff - 0x0f, 0xa0000003},
+            {0x00000001, 0x80000001, 0x00000000},
+    };
+    for (unsigned k = 0; k < 2000; ++k) {
+        for (unsigned i = 0; i < sizeof(random_msg); ++i)
+            random_msg[i] = k % 3 ? rand() | 0x21 : rand(); // more stuff and stop bits
+        unsigned offset = rand() % 64;
+        if (k % 4 == 3) {
+            // valid frames from the offset, the frames of 10 bits are 0 <8 bits> 1, groups of 5 bits end in 1
+            for (unsigned pos = offset; pos + 10 <= sizeof(random_msg) * 8; pos += 10) {
+                unsigned frame = (rand() & 0xff) << 1 | 1 | (k & 8 ? 0x20 : 0); // with k & 8 also 4b1s groups
+                for (unsigned b = 0; b < 10; ++b) {
+                    unsigned bit = frame >> (9 - b) & 1;
+                    random_msg[(pos + b) / 8] = (uint8_t)((random_msg[(pos + b) / 8] & ~(0x80 >> ((pos + b) % 8))) | bit << (7 - (pos + b) % 8));
+                }
+            }
+        }
+        unsigned len    = rand() % (sizeof(random_msg) * 8 - offset);
+        uint8_t out[sizeof(random_msg)] = {0};
+        uint8_t ref[sizeof(random_msg)] = {0};
+        mismatches += extract_nibbles_4b1s(random_msg, offset, len, out) != extract_nibbles_4b1s_bitwise(random_msg, offset, len, ref);
+        mismatches += memcmp(out, ref, sizeof(out)) != 0;
+        mismatches += extract_bytes_uart(random_msg, offset, len, out) != extract_bytes_uart_bitwise(random_msg, offset, len, ref);
+        mismatches += memcmp(out, ref, sizeof(out)) != 0;
+        uint32_t const *sym = symbols[k % 4];
+        memset(out, 0, sizeof(out));
+        memset(ref, 0, sizeof(ref));
+        mismatches += extract_bits_symbols(random_msg, offset, len, sym[0], sym[1], sym[2], out) != extract_bits_symbols_bitwise(random_msg, offset, len, sym[0], sym[1], sym[2], ref);
+        mismatches += memcmp(out, ref, sizeof(out)) != 0;
+    }
+    ASSERT_EQUALS(mismatches, 0);
+
     fprintf(stderr, "util:: test (%u/%u) passed, (%u) failed.\n", passed, passed + failed, failed);
 
     return failed;
@@ -0,0 +1,212 @@
+/** @file
+    Watchdog thread, measures the stalls of the sample callback and recovers from them.
+
+    The callback feeds the watchdog with each buffer, the watchdog thread checks
+    the time since the last feed and calls the stall handler once the stall time
+    is exceeded, then again for each further stall time. A callback interval or
+    duration above the near stall time is logged by the callback.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include "watchdog.h"
+#include "compat_pthread.h"
+#include "compat_time.h"
+#include "fatal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef THREADS
+
+#define WATCHDOG_POLL_MS 100 // the stall time is checked this often, or 30 times for longer stall times
+
+struct watchdog {
+    double stall_us;
+    double warn_us;
+    double poll_us;
+    watchdog_stall_fn stall_fn;
+    void *ctx;
+    pthread_t thread;
+    pthread_mutex_t lock; ///< guards the state below
+    int exit;
+    int armed;        ///< fed and not paused
+    int busy;         ///< fed and not done
+    double fed_us;    ///< monotonic time of the last feed
+    double due_us;    ///< monotonic time the next stall is due
+    unsigned stalls_in_row;
+    unsigned stalls;
+    unsigned near_stalls;
+};
+
+static THREAD_RETURN THREAD_CALL watchdog_thread(void *arg)
+{
+    watchdog_t *w  = arg;
+    double next_us = monotonic_time_us();
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        if (w->exit) {
+            pthread_mutex_unlock(&w->lock);
+            break;
+        }
+        double now_us          = monotonic_time_us();
+        unsigned stalls_in_row = 0;
+        if (w->armed && now_us >= w->due_us) {
+            w->due_us = now_us + w->stall_us; // once more for each stall time
+            w->stalls++;
+            stalls_in_row = ++w->stalls_in_row;
+        }
+        double stalled_us = now_us - w->fed_us;
+        pthread_mutex_unlock(&w->lock);
+
+        if (stalls_in_row)
+            w->stall_fn(w->ctx, stalls_in_row, stalled_us);
+        next_us += w->poll_us;
+        monotonic_sleep_until_us(next_us);
+    }
+    return (THREAD_RETURN)0;
+}
+
+watchdog_t *watchdog_create(unsigned stall_ms, unsigned warn_ms, watchdog_stall_fn stall_fn, void *ctx)
+{
+    watchdog_t *w = calloc(1, sizeof(*w));
+    if (!w) {
+        WARN_CALLOC("watchdog_create()");
+        return NULL;
+    }
+    w->stall_us = stall_ms * 1000.0;
+    w->warn_us  = warn_ms * 1000.0;
+    w->poll_us  = w->stall_us / 30 > WATCHDOG_POLL_MS * 1000.0 ? w->stall_us / 30 : WATCHDOG_POLL_MS * 1000.0;
+    w->stall_fn = stall_fn;
+    w->ctx      = ctx;
+
+    pthread_mutex_init(&w->lock, NULL);
+    if (pthread_create(&w->thread, NULL, watchdog_thread, w)) {
+        fprintf(stderr, "%s: failed to start thread\n", __func__);
+        pthread_mutex_destroy(&w->lock);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+double watchdog_feed(watchdog_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+    double now_us      = monotonic_time_us();
+    double interval_us = w->armed ? now_us - w->fed_us : 0.0;
+    unsigned stalls    = w->stalls_in_row;
+    int near_stall     = w->warn_us > 0.0 && interval_us >= w->warn_us;
+    w->near_stalls += near_stall;
+    w->armed         = 1;
+    w->busy          = 1;
+    w->fed_us        = now_us;
+    w->due_us        = now_us + w->stall_us;
+    w->stalls_in_row = 0;
+    pthread_mutex_unlock(&w->lock);
+
+    if (stalls)
+        fprintf(stderr, "Sample callback recovered after %.0f ms\n", interval_us / 1000.0);
+    else if (near_stall)
+        fprintf(stderr, "Sample callback late, %.0f ms since the last buffer\n", interval_us / 1000.0);
+    return interval_us;
+}
+
+double watchdog_done(watchdog_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+    double duration_us = w->busy ? monotonic_time_us() - w->fed_us : 0.0;
+    int near_stall     = w->warn_us > 0.0 && duration_us >= w->warn_us;
+    w->near_stalls += near_stall;
+    w->busy = 0;
+    pthread_mutex_unlock(&w->lock);
+
+    if (near_stall)
+        fprintf(stderr, "Sample callback slow, %.0f ms to process the buffer\n", duration_us / 1000.0);
+    return duration_us;
+}
+
+void watchdog_pause(watchdog_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+    w->armed = 0;
+    pthread_mutex_unlock(&w->lock);
+}
+
+unsigned watchdog_stalls(watchdog_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+    unsigned stalls = w->stalls;
+    pthread_mutex_unlock(&w->lock);
+    return stalls;
+}
+
+unsigned watchdog_near_stalls(watchdog_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+    unsigned near_stalls = w->near_stalls;
+    pthread_mutex_unlock(&w->lock);
+    return near_stalls;
+}
+
+void watchdog_free(watchdog_t *w)
+{
+    if (!w)
+        return;
+    pthread_mutex_lock(&w->lock);
+    w->exit = 1;
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    pthread_mutex_destroy(&w->lock);
+    free(w);
+}
+
+#else
+
+watchdog_t *watchdog_create(unsigned stall_ms, unsigned warn_ms, watchdog_stall_fn stall_fn, void *ctx)
+{
+    (void)stall_ms;
+    (void)warn_ms;
+    (void)stall_fn;
+    (void)ctx;
+    return NULL;
+}
+
+double watchdog_feed(watchdog_t *w)
+{
+    (void)w;
+    return 0.0;
+}
+
+double watchdog_done(watchdog_t *w)
+{
+    (void)w;
+    return 0.0;
+}
+
+void watchdog_pause(watchdog_t *w)
+{
+    (void)w;
+}
+
+unsigned watchdog_stalls(watchdog_t *w)
+{
+    (void)w;
+    return 0;
+}
+
+unsigned watchdog_near_stalls(watchdog_t *w)
+{
+    (void)w;
+    return 0;
+}
+
+void watchdog_free(watchdog_t *w)
+{
+    (void)w;
+}
+
+#endif
@@ -3,6 +3,12 @@
 
     Copyright (C) 2020 by Christian Zuckschwerdt <zany@triq.net>
 
+    The .sr file is a zip archive of a "version" and "metadata" entry and the
+    channel data in chunks, "logic-1-<chunk>" and "analog-1-<channel>-<chunk>".
+    The entries are deflated with zlib, or stored without it, and written as
+    the chunks fill up, a capture of any length needs a chunk buffer per
+    channel and the central directory only.
+
     This program is free software; you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
     the Free Software Foundation; either version 2 of the License, or
@@ -11,7 +17,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
@@ -22,198 +30,369 @@
 #ifdef _WIN32
 #include <windows.h>
 #endif
+#ifdef ZLIB
+#include <zlib.h>
+#endif
 
+#include "alloc_count.h"
 #include "fatal.h"
 #include "write_sigrok.h"
 
-void write_sigrok(char const *filename, unsigned samplerate, unsigned probes, unsigned analogs, char const *labels[])
-{
-    // e.g. uses channels
-    // U8:LOGIC:logic-1-1
-    // F32:I:analog-1-4-1
-    // F32:Q:analog-1-5-1
-    // F32:AM:analog-1-6-1
-    // F32:FM:analog-1-7-1
+/// A zip entry written, for the central directory.
+struct sigrok_entry {
+    char name[24];
+    unsigned method; ///< 0: stored, 8: deflated
+    uint32_t crc;
+    uint32_t csize; ///< compressed size
+    uint32_t size;
+    uint64_t offset; ///< position of the local header
+};
 
-    // probe1=FRAME
-    // probe2=ASK
-    // probe3=FSK
-    // analog4=I
-    // analog5=Q
-    // analog6=AM
-    // analog7=FM
+/// The buffered samples of a channel, written as the next chunk entry when full.
+struct sigrok_chunk {
+    uint8_t *buf;
+    size_t len;
+    unsigned count; ///< chunks written
+};
 
-    // create version tag
-    FILE *fp = fopen("version", "w");
-    if (!fp) {
-        perror("creating Sigrok \"version\" file");
-        return;
-    }
-    fprintf(fp, "2");
-    fclose(fp);
+struct sigrok_writer {
+    FILE *file;
+    uint64_t pos; ///< bytes written to the file
+    int failed;
+    unsigned probes;
+    unsigned analogs;
+    char const **labels;
+    uint16_t dos_time;
+    uint16_t dos_date;
+    struct sigrok_chunk *chunks; ///< the logic chunk then one for each analog channel
+    struct sigrok_entry *entries;
+    unsigned entries_len;
+    unsigned entries_size;
+#ifdef ZLIB
+    z_stream zs;
+    int zs_init;
+    uint8_t *zbuf; ///< the deflated chunk
+    size_t zbuf_size;
+#endif
+};
 
-    // create meta data
-    fp = fopen("metadata", "w");
-    if (!fp) {
-        perror("creating Sigrok \"metadata\" file");
-        return;
-    }
-    fprintf(fp,
-            "[device 1]\n"
-            "samplerate=%u kHz\n"
-            "capturefile=logic-1\n"
-            "unitsize=1\n"
-            "total probes=%u\n"
-            "total analog=%u\n",
-            samplerate / 1000, probes, analogs);
-    if (labels) {
-        char const **label = labels;
-        for (unsigned i = 1; i <= probes; ++i)
-            fprintf(fp, "probe%u=%s\n", i, *label++);
-        for (unsigned i = probes + 1; i <= probes + analogs; ++i)
-            fprintf(fp, "analog%u=%s\n", i, *label++);
-    }
-    else {
-        for (unsigned i = 1; i <= probes; ++i)
-            fprintf(fp, "probe%u=L%u\n", i, i);
-        for (unsigned i = probes + 1; i <= probes + analogs; ++i)
-            fprintf(fp, "analog%u=A%u\n", i, i);
+static uint32_t crc32_table[256];
+
+static void crc32_init(void)
+{
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        crc32_table[n] = c;
     }
+}
 
-    // EOF
-    fclose(fp);
+static uint32_t crc32_update(uint32_t crc, uint8_t const *buf, size_t len)
+{
+    crc = ~crc;
+    for (size_t n = 0; n < len; ++n)
+        crc = crc32_table[(crc ^ buf[n]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
 
-#ifdef _WIN32
-    STARTUPINFO si;
-    PROCESS_INFORMATION pi;
-
-    ZeroMemory(&si, sizeof(si));
-    si.cb = sizeof(si);
-    ZeroMemory(&pi, sizeof(pi));
-
-    char cmd_line[MAX_PATH] = "";
-    strcat_s(cmd_line, MAX_PATH, "7z.exe");
-    strcat_s(cmd_line, MAX_PATH, " a");
-    strcat_s(cmd_line, MAX_PATH, " -bb0 ");
-    strcat_s(cmd_line, MAX_PATH, " -sdel ");
-    strcat_s(cmd_line, MAX_PATH, " -tzip ");
-    strcat_s(cmd_line, MAX_PATH, filename);
-    strcat_s(cmd_line, MAX_PATH, " version");
-    strcat_s(cmd_line, MAX_PATH, " metadata");
-
-    if (probes) {
-        strcat_s(cmd_line, MAX_PATH, " logic-1-1");
-    }
+static uint8_t *put16(uint8_t *p, unsigned v)
+{
+    p[0] = v & 0xff;
+    p[1] = (v >> 8) & 0xff;
+    return p + 2;
+}
 
-    char str_buf[64];
-    for (unsigned i = probes + 1; i <= probes + analogs; ++i) {
-        snprintf(str_buf, 64, " analog-1-%u-1", i);
-        strcat_s(cmd_line, MAX_PATH, str_buf);
-    }
+static uint8_t *put32(uint8_t *p, uint32_t v)
+{
+    p = put16(p, v & 0xffff);
+    return put16(p, v >> 16);
+}
 
-    // Start the child process.
-    if (CreateProcess(NULL,  // No module name (use command line)
-                cmd_line,     // Command line
-                NULL,        // Process handle not inheritable
-                NULL,        // Thread handle not inheritable
-                FALSE,       // Set handle inheritance to FALSE
-                0,           // No creation flags
-                NULL,        // Use parent's environment block
-                NULL,        // Use parent's starting directory
-                &si,         // Pointer to STARTUPINFO structure
-                &pi)         // Pointer to PROCESS_INFORMATION structure
-    ) {
-        // Wait until child process exits.
-        WaitForSingleObject(pi.hProcess, INFINITE);
-
-        DWORD exit_code;
-
-        if (FALSE == GetExitCodeProcess(pi.hProcess, &exit_code)) {
-            perror("GetExitCodeProcess() failure");
-        }
+static uint8_t *put64(uint8_t *p, uint64_t v)
+{
+    p = put32(p, (uint32_t)v);
+    return put32(p, (uint32_t)(v >> 32));
+}
 
-        // Close process and thread handles.
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
+static void sigrok_fwrite(sigrok_writer_t *sr, void const *buf, size_t len)
+{
+    if (sr->failed)
+        return;
+    if (fwrite(buf, 1, len, sr->file) != len) {
+        perror("writing Sigrok file");
+        sr->failed = 1;
+    }
+    sr->pos += len;
+}
 
-        if (exit_code != 0) {
-            perror("7z.exe execution failed");
+/// Write a stored zip entry, the data is complete so the sizes and CRC are known up front.
+static void sigrok_write_entry(sigrok_writer_t *sr, char const *name, void const *data, size_t len)
+{
+    if (sr->entries_len == sr->entries_size) {
+        unsigned size = sr->entries_size ? sr->entries_size * 2 : 64;
+        struct sigrok_entry *entries = realloc(sr->entries, size * sizeof(*entries));
+        if (!entries) {
+            WARN_REALLOC("sigrok_write_entry()");
+            sr->failed = 1;
             return;
         }
+        sr->entries      = entries;
+        sr->entries_size = size;
     }
-    else {
-        perror("CreateProcess for 7z.exe failed.");
-        return;
-    }
+    struct sigrok_entry *entry = &sr->entries[sr->entries_len++];
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    entry->method = 0;
+    entry->crc    = crc32_update(0, data, len);
+    entry->csize  = (uint32_t)len;
+    entry->size   = (uint32_t)len;
+    entry->offset = sr->pos;
 
-#else
-    char *argv[30] = {0};
-    int arg        = 0;
-    argv[arg++]    = "zip";
-    argv[arg++]    = (char *)filename; // "out.sr"
-    argv[arg++]    = "version";
-    argv[arg++]    = "metadata";
-
-    if (probes) {
-        argv[arg++] = "logic-1-1";
+    void const *out = data;
+#ifdef ZLIB
+    // deflate the chunk, keep it stored if that does not save space
+    if (sr->zs_init && deflateReset(&sr->zs) == Z_OK) {
+        sr->zs.next_in   = (Bytef *)data;
+        sr->zs.avail_in  = (uInt)len;
+        sr->zs.next_out  = sr->zbuf;
+        sr->zs.avail_out = (uInt)sr->zbuf_size;
+        if (deflate(&sr->zs, Z_FINISH) == Z_STREAM_END && sr->zs.total_out < len) {
+            entry->method = 8;
+            entry->csize  = (uint32_t)sr->zs.total_out;
+            out           = sr->zbuf;
+        }
     }
+#endif
+
+    uint8_t hdr[30];
+    uint8_t *p = hdr;
+    p = put32(p, 0x04034b50); // local file header
+    p = put16(p, 20);         // version needed
+    p = put16(p, 0);          // flags
+    p = put16(p, entry->method);
+    p = put16(p, sr->dos_time);
+    p = put16(p, sr->dos_date);
+    p = put32(p, entry->crc);
+    p = put32(p, entry->csize);
+    p = put32(p, entry->size);
+    p = put16(p, (unsigned)strlen(entry->name));
+    p = put16(p, 0); // extra length
+    sigrok_fwrite(sr, hdr, sizeof(hdr));
+    sigrok_fwrite(sr, entry->name, strlen(entry->name));
+    sigrok_fwrite(sr, out, entry->csize);
+}
 
-    char **argv_analog = &argv[arg];
-    char str_buf[64];
-    for (unsigned i = probes + 1; i <= probes + analogs; ++i) {
-        snprintf(str_buf, sizeof(str_buf), "analog-1-%u-1", i);
-        char* dup = strdup(str_buf);
-        if (!dup) {
-          FATAL_STRDUP("write_sigrok()");
+/// Write the central directory and the end records, with Zip64 records if the offsets need it.
+static void sigrok_write_directory(sigrok_writer_t *sr)
+{
+    uint64_t cd_offset = sr->pos;
+    for (unsigned i = 0; i < sr->entries_len; ++i) {
+        struct sigrok_entry const *entry = &sr->entries[i];
+        int zip64 = entry->offset >= 0xffffffff;
+        uint8_t hdr[46 + 12];
+        uint8_t *p = hdr;
+        p = put32(p, 0x02014b50);             // central directory header
+        p = put16(p, 3 << 8 | (zip64 ? 45 : 20)); // made by unix
+        p = put16(p, zip64 ? 45 : 20);        // version needed
+        p = put16(p, 0);                      // flags
+        p = put16(p, entry->method);
+        p = put16(p, sr->dos_time);
+        p = put16(p, sr->dos_date);
+        p = put32(p, entry->crc);
+        p = put32(p, entry->csize);
+        p = put32(p, entry->size);
+        p = put16(p, (unsigned)strlen(entry->name));
+        p = put16(p, zip64 ? 12 : 0); // extra length
+        p = put16(p, 0);              // comment length
+        p = put16(p, 0);              // disk
+        p = put16(p, 0);              // internal attributes
+        p = put32(p, 0100644u << 16); // external attributes, a regular file
+        p = put32(p, zip64 ? 0xffffffff : (uint32_t)entry->offset);
+        sigrok_fwrite(sr, hdr, 46);
+        sigrok_fwrite(sr, entry->name, strlen(entry->name));
+        if (zip64) {
+            p = put16(p, 0x0001); // Zip64 extra field
+            p = put16(p, 8);
+            p = put64(p, entry->offset);
+            sigrok_fwrite(sr, hdr + 46, 12);
         }
-        argv[arg++] = dup;
     }
+    uint64_t cd_size = sr->pos - cd_offset;
 
-    int status = 0;
-    pid_t pid = fork();
-    if (pid < 0) {
-        perror("forking zip");
-    }
-    else if (pid == 0) {
-        // child process because return value zero
-        execvp(argv[0], argv);
-        // execvp() returns only on error
-        for (int i = 0; i < arg; ++i)
-            fprintf(stderr, "%s ", argv[i]);
-        fprintf(stderr, "\n");
-        perror("execvp");
-        exit(1);
-    }
-    else {
-        // parent process because return value non-zero
-        wait(&status);
-        if (WIFEXITED(status)) {
-            if (WEXITSTATUS(status)) {
-                fprintf(stderr, "zip exited with status: %d\n", WEXITSTATUS(status));
-            }
-        }
+    uint8_t end[56 + 20 + 22];
+    uint8_t *p = end;
+    int zip64  = cd_offset >= 0xffffffff || sr->entries_len >= 0xffff;
+    if (zip64) {
+        uint64_t end64_offset = sr->pos;
+        p = put32(p, 0x06064b50); // Zip64 end of central directory record
+        p = put64(p, 44);
+        p = put16(p, 3 << 8 | 45);
+        p = put16(p, 45);
+        p = put32(p, 0);
+        p = put32(p, 0);
+        p = put64(p, sr->entries_len);
+        p = put64(p, sr->entries_len);
+        p = put64(p, cd_size);
+        p = put64(p, cd_offset);
+        p = put32(p, 0x07064b50); // Zip64 end of central directory locator
+        p = put32(p, 0);
+        p = put64(p, end64_offset);
+        p = put32(p, 1);
     }
+    p = put32(p, 0x06054b50); // end of central directory record
+    p = put16(p, 0);
+    p = put16(p, 0);
+    p = put16(p, zip64 ? 0xffff : sr->entries_len);
+    p = put16(p, zip64 ? 0xffff : sr->entries_len);
+    p = put32(p, zip64 ? 0xffffffff : (uint32_t)cd_size);
+    p = put32(p, zip64 ? 0xffffffff : (uint32_t)cd_offset);
+    p = put16(p, 0); // comment length
+    sigrok_fwrite(sr, end, (size_t)(p - end));
+}
+
+static void sigrok_flush_chunk(sigrok_writer_t *sr, unsigned channel)
+{
+    struct sigrok_chunk *chunk = &sr->chunks[channel];
+    if (!chunk->len)
+        return;
+    char name[24];
+    chunk->count++;
+    if (channel == 0)
+        snprintf(name, sizeof(name), "logic-1-%u", chunk->count);
+    else
+        snprintf(name, sizeof(name), "analog-1-%u-%u", sr->probes + channel, chunk->count);
+    sigrok_write_entry(sr, name, chunk->buf, chunk->len);
+    chunk->len = 0;
+}
 
-    // rm version metadata logic-1-1 analog-1-4-1 analog-1-5-1 analog-1-6-1 analog-1-7-1
-    if (unlink("version")) {
-        perror("unlinking Sigrok \"version\" file");
+sigrok_writer_t *sigrok_writer_create(FILE *file, unsigned probes, unsigned analogs, char const *labels[])
+{
+    sigrok_writer_t *sr = calloc(1, sizeof(*sr));
+    if (!sr) {
+        WARN_CALLOC("sigrok_writer_create()");
+        return NULL; // NOTE: returns NULL on alloc failure.
     }
-    if (unlink("metadata")) {
-        perror("unlinking Sigrok \"metadata\" file");
+    sr->chunks = calloc(1 + analogs, sizeof(*sr->chunks));
+    if (!sr->chunks) {
+        WARN_CALLOC("sigrok_writer_create()");
+        free(sr);
+        return NULL; // NOTE: returns NULL on alloc failure.
     }
+    sr->file    = file;
+    sr->probes  = probes;
+    sr->analogs = analogs;
+    sr->labels  = labels;
+
+    time_t now = time(NULL);
+    struct tm tm_info;
+#ifdef _WIN32
+    localtime_s(&tm_info, &now);
+#else
+    localtime_r(&now, &tm_info);
+#endif
+    sr->dos_time = (uint16_t)(tm_info.tm_hour << 11 | tm_info.tm_min << 5 | tm_info.tm_sec / 2);
+    sr->dos_date = (uint16_t)((tm_info.tm_year - 80) << 9 | (tm_info.tm_mon + 1) << 5 | tm_info.tm_mday);
 
-    if (probes) {
-        if (unlink("logic-1-1")) {
-            perror("unlinking Sigrok \"logic-1-1\" file");
+#ifdef ZLIB
+    // raw deflate at the fastest level, the writer must keep up with the input
+    if (deflateInit2(&sr->zs, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+        sr->zs_init   = 1;
+        sr->zbuf_size = deflateBound(&sr->zs, SIGROK_CHUNK_SIZE);
+        sr->zbuf      = malloc(sr->zbuf_size);
+        if (!sr->zbuf) {
+            WARN_MALLOC("sigrok_writer_create()");
+            deflateEnd(&sr->zs);
+            sr->zs_init = 0; // NOTE: writes uncompressed on alloc failure.
         }
     }
-    for (unsigned i = 0; i < analogs && argv_analog[i]; ++i) {
-        if (unlink(argv_analog[i])) {
-            perror("unlinking Sigrok \"analog-1-N-1\" file");
+#endif
+
+    crc32_init();
+    sigrok_write_entry(sr, "version", "2", 1);
+    return sr;
+}
+
+int sigrok_writer_add(sigrok_writer_t *sr, unsigned channel, void const *buf, size_t len)
+{
+    if (channel > sr->analogs || (channel == 0 && !sr->probes))
+        return -1;
+    struct sigrok_chunk *chunk = &sr->chunks[channel];
+    if (!chunk->buf) {
+        chunk->buf = malloc(SIGROK_CHUNK_SIZE);
+        if (!chunk->buf) {
+            WARN_MALLOC("sigrok_writer_add()");
+            sr->failed = 1;
+            return -1;
         }
-        free(argv_analog[i]);
     }
-#endif // !_WIN32
+    uint8_t const *p = buf;
+    while (len && !sr->failed) {
+        size_t n = SIGROK_CHUNK_SIZE - chunk->len;
+        if (n > len)
+            n = len;
+        memcpy(chunk->buf + chunk->len, p, n);
+        chunk->len += n;
+        p += n;
+        len -= n;
+        if (chunk->len == SIGROK_CHUNK_SIZE)
+            sigrok_flush_chunk(sr, channel);
+    }
+    return sr->failed ? -1 : 0;
+}
+
+int sigrok_writer_close(sigrok_writer_t *sr, unsigned samplerate)
+{
+    if (!sr)
+        return 0;
+    for (unsigned i = 0; i <= sr->analogs; ++i)
+        sigrok_flush_chunk(sr, i);
+
+    // e.g. uses channels
+    // probe1=FRAME
+    // probe2=ASK
+    // probe3=FSK
+    // analog4=I
+    // analog5=Q
+    // analog6=AM
+    // analog7=FM
+    char meta[1024];
+    int len = snprintf(meta, sizeof(meta),
+            "[device 1]\n"
+            "samplerate=%u kHz\n"
+            "capturefile=logic-1\n"
+            "unitsize=1\n"
+            "total probes=%u\n"
+            "total analog=%u\n",
+            samplerate / 1000, sr->probes, sr->analogs);
+    char const **label = sr->labels;
+    for (unsigned i = 1; i <= sr->probes + sr->analogs && len > 0 && (size_t)len < sizeof(meta); ++i) {
+        char const *kind = i <= sr->probes ? "probe" : "analog";
+        if (label)
+            len += snprintf(meta + len, sizeof(meta) - len, "%s%u=%s\n", kind, i, *label++);
+        else
+            len += snprintf(meta + len, sizeof(meta) - len, "%s%u=%c%u\n", kind, i, i <= sr->probes ? 'L' : 'A', i);
+    }
+    if (len > 0 && (size_t)len < sizeof(meta))
+        sigrok_write_entry(sr, "metadata", meta, (size_t)len);
+    else
+        sr->failed = 1;
+
+    sigrok_write_directory(sr);
+    if (!sr->failed && fflush(sr->file))
+        sr->failed = 1;
+
+    int ret = sr->failed ? -1 : 0;
+    for (unsigned i = 0; i <= sr->analogs; ++i)
+        free(sr->chunks[i].buf);
+    free(sr->chunks);
+    free(sr->entries);
+#ifdef ZLIB
+    if (sr->zs_init)
+        deflateEnd(&sr->zs);
+    free(sr->zbuf);
+#endif
+    free(sr);
+    return ret;
 }
 
 void open_pulseview(char const *filename)
@@ -265,6 +444,6 @@ void open_pulseview(char const *filename)
             }
         }
     }
-    free(abspath);
+    alloc_count_free_libc(abspath); // allocated inside the C library
 #endif
 }
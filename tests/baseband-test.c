@@ -13,6 +13,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #ifdef _MSC_VER
@@ -35,6 +36,7 @@ typedef SSIZE_T ssize_t;
 #include <time.h>
 
 #include "baseband.h"
+#include "fileformat.h"
 
 #define MEASURE(label, block)                                              \
     do {                                                                   \
@@ -45,6 +47,16 @@ typedef SSIZE_T ssize_t;
         printf("Time elapsed in ms: %f for: %s\n", elapsed, label);        \
     } while (0)
 
+#define MEASURE_MSPS(label, n_samples, block)                              \
+    do {                                                                   \
+        clock_t start = clock();                                           \
+        block;                                                             \
+        clock_t stop   = clock();                                          \
+        double elapsed = (double)(stop - start) * 1000.0 / CLOCKS_PER_SEC; \
+        printf("Time elapsed in ms: %f (%f ms per Msps) for: %s\n",       \
+                elapsed, elapsed * 1e6 / (n_samples), label);              \
+    } while (0)
+
 static int read_buf(const char *filename, void *buf, size_t nbyte)
 {
     int fd = open(filename, O_RDONLY);
@@ -69,9 +81,432 @@ static int write_buf(const char *filename, const void *buf, size_t nbyte)
     return ret;
 }
 
+/// Check that all supported SIMD kernels are bit-identical to the scalar kernels.
+static int check_simd(uint8_t const *cu8_buf, int16_t const *cs16_buf, unsigned long n_samples)
+{
+    int failed = 0;
+    uint16_t *ref_buf = malloc(sizeof(uint16_t) * n_samples);
+    uint16_t *out_buf = malloc(sizeof(uint16_t) * n_samples);
+    if (!ref_buf || !out_buf) {
+        free(ref_buf);
+        free(out_buf);
+        return 1;
+    }
+    int best = baseband_get_simd();
+    int envelope = baseband_get_envelope();
+
+    for (int level = BASEBAND_SIMD_NONE + 1; level < BASEBAND_SIMD_END; ++level) {
+        for (int k = 0; k < 3; ++k) {
+            char const *label[] = {"envelope_detect", "magnitude_est_cu8", "magnitude_est_cs16"};
+            float ref_db, out_db;
+            baseband_set_simd(BASEBAND_SIMD_NONE);
+            if (k == 0)
+                ref_db = envelope_detect(cu8_buf, ref_buf, n_samples);
+            else if (k == 1)
+                ref_db = magnitude_est_cu8(cu8_buf, ref_buf, n_samples);
+            else
+                ref_db = magnitude_est_cs16(cs16_buf, ref_buf, n_samples);
+            if (baseband_set_simd(level) != level)
+                break; // not supported on this CPU
+            if (k == 0)
+                baseband_set_envelope(BASEBAND_ENVELOPE_SIMD);
+            if (k == 0)
+                out_db = envelope_detect(cu8_buf, out_buf, n_samples);
+            else if (k == 1)
+                out_db = magnitude_est_cu8(cu8_buf, out_buf, n_samples);
+            else
+                out_db = magnitude_est_cs16(cs16_buf, out_buf, n_samples);
+
+            int ok = ref_db == out_db && !memcmp(ref_buf, out_buf, sizeof(uint16_t) * n_samples);
+            printf("%s %s: %s\n", baseband_simd_str(level), label[k], ok ? "ok" : "MISMATCH");
+            failed += !ok;
+        }
+    }
+
+    baseband_set_simd(best);
+    baseband_set_envelope(envelope);
+    free(ref_buf);
+    free(out_buf);
+    return failed;
+}
+
+/// Check that all envelope kernels are bit-identical to the LUT.
+static int check_envelope(uint8_t const *cu8_buf, unsigned long n_samples)
+{
+    int failed = 0;
+    uint16_t *ref_buf = malloc(sizeof(uint16_t) * n_samples);
+    uint16_t *out_buf = malloc(sizeof(uint16_t) * n_samples);
+    if (!ref_buf || !out_buf) {
+        free(ref_buf);
+        free(out_buf);
+        return 1;
+    }
+    int envelope = baseband_get_envelope();
+
+    baseband_set_envelope(BASEBAND_ENVELOPE_LUT);
+    float ref_db = envelope_detect(cu8_buf, ref_buf, n_samples);
+    for (int kernel = BASEBAND_ENVELOPE_LUT + 1; kernel < BASEBAND_ENVELOPE_END; ++kernel) {
+        if (baseband_set_envelope(kernel) != kernel)
+            continue; // not supported on this CPU
+        float out_db = envelope_detect(cu8_buf, out_buf, n_samples);
+        int ok = ref_db == out_db && !memcmp(ref_buf, out_buf, sizeof(uint16_t) * n_samples);
+        printf("envelope %s: %s\n", baseband_envelope_str(kernel), ok ? "ok" : "MISMATCH");
+        failed += !ok;
+    }
+
+    baseband_set_envelope(envelope);
+    free(ref_buf);
+    free(out_buf);
+    return failed;
+}
+
+/// Check that the fused AM/FM demodulators match the separate passes.
+static int check_fused(uint8_t const *cu8_buf, int16_t const *cs16_buf, unsigned long n_samples)
+{
+    int failed = 0;
+    uint16_t *env_buf = malloc(sizeof(uint16_t) * n_samples);
+    int16_t *buf[4];
+    for (int j = 0; j < 4; ++j)
+        buf[j] = malloc(sizeof(int16_t) * n_samples);
+    if (!env_buf || !buf[0] || !buf[1] || !buf[2] || !buf[3]) {
+        free(env_buf);
+        for (int j = 0; j < 4; ++j)
+            free(buf[j]);
+        return 1;
+    }
+
+    for (int k = 0; k < 3; ++k) {
+        char const *label[] = {"envelope_detect", "magnitude_est_cu8", "magnitude_est_cs16"};
+        filter_state_t lp_state = {0};
+        demodfm_state_t fm_state = {0};
+        float ref_db, out_db;
+        if (k == 0)
+            ref_db = envelope_detect(cu8_buf, env_buf, n_samples);
+        else if (k == 1)
+            ref_db = magnitude_est_cu8(cu8_buf, env_buf, n_samples);
+        else
+            ref_db = magnitude_est_cs16(cs16_buf, env_buf, n_samples);
+        baseband_low_pass_filter(env_buf, buf[0], n_samples, &lp_state);
+        if (k < 2)
+            baseband_demod_FM(cu8_buf, buf[1], n_samples, 250000, 0.1f, &fm_state);
+        else
+            baseband_demod_FM_cs16(cs16_buf, buf[1], n_samples, 250000, 0.1f, &fm_state);
+
+        memset(&lp_state, 0, sizeof(lp_state));
+        memset(&fm_state, 0, sizeof(fm_state));
+        if (k < 2)
+            out_db = baseband_demod_AM_FM(cu8_buf, buf[2], buf[3], n_samples, 250000, 0.1f, k == 1, &lp_state, &fm_state);
+        else
+            out_db = baseband_demod_AM_FM_cs16(cs16_buf, buf[2], buf[3], n_samples, 250000, 0.1f, &lp_state, &fm_state);
+
+        int ok = ref_db == out_db
+                && !memcmp(buf[0], buf[2], sizeof(int16_t) * n_samples)
+                && !memcmp(buf[1], buf[3], sizeof(int16_t) * n_samples);
+        printf("fused %s: %s\n", label[k], ok ? "ok" : "MISMATCH");
+        failed += !ok;
+    }
+
+    free(env_buf);
+    for (int j = 0; j < 4; ++j)
+        free(buf[j]);
+    return failed;
+}
+
+/// Check that the float FM discriminators are bit-identical for all supported SIMD levels.
+static int check_fm_simd(uint8_t const *cu8_buf, int16_t const *cs16_buf, unsigned long n_samples)
+{
+    int failed = 0;
+    int16_t *ref_buf = malloc(sizeof(int16_t) * n_samples);
+    int16_t *out_buf = malloc(sizeof(int16_t) * n_samples);
+    if (!ref_buf || !out_buf) {
+        free(ref_buf);
+        free(out_buf);
+        return 1;
+    }
+    int best = baseband_get_simd();
+
+    for (int level = BASEBAND_SIMD_NONE + 1; level < BASEBAND_SIMD_END; ++level) {
+        for (int k = 0; k < 4; ++k) {
+            char const *label[] = {"fmfast", "fmprecise", "fmfast cs16", "fmprecise cs16"};
+            demodfm_state_t fm_state = {0};
+            fm_state.mode = k % 2 ? BASEBAND_FM_PRECISE : BASEBAND_FM_FAST;
+            baseband_set_simd(BASEBAND_SIMD_NONE);
+            if (k < 2)
+                baseband_demod_FM(cu8_buf, ref_buf, n_samples, 250000, 0.1f, &fm_state);
+            else
+                baseband_demod_FM_cs16(cs16_buf, ref_buf, n_samples, 250000, 0.1f, &fm_state);
+            if (baseband_set_simd(level) != level)
+                break; // not supported on this CPU
+            int mode = fm_state.mode;
+            memset(&fm_state, 0, sizeof(fm_state));
+            fm_state.mode = mode;
+            if (k < 2)
+                baseband_demod_FM(cu8_buf, out_buf, n_samples, 250000, 0.1f, &fm_state);
+            else
+                baseband_demod_FM_cs16(cs16_buf, out_buf, n_samples, 250000, 0.1f, &fm_state);
+
+            int ok = !memcmp(ref_buf, out_buf, sizeof(int16_t) * n_samples);
+            printf("%s %s: %s\n", baseband_simd_str(level), label[k], ok ? "ok" : "MISMATCH");
+            failed += !ok;
+        }
+    }
+
+    baseband_set_simd(best);
+    free(ref_buf);
+    free(out_buf);
+    return failed;
+}
+
+/// Check that the native CS8 and CF32 kernels match the CU8 and CS16 kernels on the same signal.
+static int check_native(uint8_t const *cu8_buf, int16_t const *cs16_buf, unsigned long n_samples)
+{
+    int failed = 0;
+    int8_t *cs8_buf  = malloc(sizeof(int8_t) * 2 * n_samples);
+    float *cf32_buf  = malloc(sizeof(float) * 2 * n_samples);
+    int16_t *buf[4];
+    for (int j = 0; j < 4; ++j)
+        buf[j] = malloc(sizeof(int16_t) * n_samples);
+    if (!cs8_buf || !cf32_buf || !buf[0] || !buf[1] || !buf[2] || !buf[3]) {
+        free(cs8_buf);
+        free(cf32_buf);
+        for (int j = 0; j < 4; ++j)
+            free(buf[j]);
+        return 1;
+    }
+    for (unsigned long i = 0; i < n_samples * 2; i++) {
+        cs8_buf[i]  = (int8_t)(cu8_buf[i] ^ 0x80);
+        cf32_buf[i] = cs16_buf[i] / 32768.0f;
+    }
+
+    for (int k = 0; k < 4; ++k) {
+        // CF32 uses the float discriminator, compare with the same CS16 mode
+        char const *label[] = {"cs8 envelope", "cs8 magnitude", "cf32 fmfast", "cf32 fmprecise"};
+        baseband_kernels_t const *ref = baseband_get_kernels(k < 2 ? CU8_IQ : CS16_IQ, 0);
+        baseband_kernels_t const *out = baseband_get_kernels(k < 2 ? CS8_IQ : CF32_IQ, 0);
+        void const *ref_buf = k < 2 ? (void const *)cu8_buf : (void const *)cs16_buf;
+        void const *out_buf = k < 2 ? (void const *)cs8_buf : (void const *)cf32_buf;
+        int mode = k == 3 ? BASEBAND_FM_PRECISE : BASEBAND_FM_FAST;
+        filter_state_t lp_state = {0};
+        demodfm_state_t fm_state = {0};
+        fm_state.mode = mode;
+        baseband_clip_t ref_clip = {0};
+        baseband_clip_t out_clip = {0};
+        float ref_db = ref->demod_AM_FM(ref_buf, buf[0], NULL, buf[1], n_samples, 250000, 0.1f, k == 1, &lp_state, &fm_state, &ref_clip);
+        memset(&lp_state, 0, sizeof(lp_state));
+        memset(&fm_state, 0, sizeof(fm_state));
+        fm_state.mode = mode;
+        float out_db = out->demod_AM_FM(out_buf, buf[2], NULL, buf[3], n_samples, 250000, 0.1f, k == 1, &lp_state, &fm_state, &out_clip);
+
+        int ok = ref_db == out_db
+                && ref_clip.samples == n_samples
+                && !memcmp(&ref_clip, &out_clip, sizeof(ref_clip))
+                && !memcmp(buf[0], buf[2], sizeof(int16_t) * n_samples)
+                && !memcmp(buf[1], buf[3], sizeof(int16_t) * n_samples);
+        printf("native %s: %s\n", label[k], ok ? "ok" : "MISMATCH");
+        failed += !ok;
+    }
+
+    free(cs8_buf);
+    free(cf32_buf);
+    for (int j = 0; j < 4; ++j)
+        free(buf[j]);
+    return failed;
+}
+
+/// Check that the 8-bit envelope codes are monotonic and bound the levels, and the fused kernel writes them by tiles.
+static int check_envelope_8bit(uint8_t const *cu8_buf, unsigned long n_samples)
+{
+    int failed = 0;
+    int prev   = 0;
+    for (int level = INT16_MIN; level <= INT16_MAX; ++level) {
+        int code = envelope_8bit_code(level);
+        if (code < prev || code > 191 || level < envelope_8bit_min(code) || level > envelope_8bit_max(code)) {
+            printf("envelope 8bit code of %d: %d MISMATCH\n", level, code);
+            failed++;
+            break;
+        }
+        prev = code;
+    }
+
+    int16_t *am_buf  = malloc(sizeof(int16_t) * n_samples);
+    uint8_t *am8_buf = malloc(sizeof(uint8_t) * n_samples * 2);
+    if (!am_buf || !am8_buf) {
+        free(am_buf);
+        free(am8_buf);
+        return failed + 1;
+    }
+    baseband_kernels_t const *kernels = baseband_get_kernels(CU8_IQ, 0);
+    filter_state_t lp_state  = {0};
+    demodfm_state_t fm_state = {0};
+    kernels->demod_AM_FM(cu8_buf, am_buf, am8_buf, NULL, n_samples, 250000, 0.1f, 0, &lp_state, &fm_state, NULL);
+    baseband_envelope_8bit(am_buf, &am8_buf[n_samples], n_samples);
+    int ok = !memcmp(am8_buf, &am8_buf[n_samples], n_samples);
+    printf("fused envelope 8bit: %s\n", ok ? "ok" : "MISMATCH");
+    failed += !ok;
+
+    free(am_buf);
+    free(am8_buf);
+    return failed;
+}
+
+/// Check that the DC offset and IQ imbalance correction settles to a balanced output.
+static int check_iq_correct(void)
+{
+    enum { CHUNK = 8192, CHUNKS = 16 };
+    uint8_t *cu8_buf = malloc(sizeof(uint8_t) * 2 * CHUNK);
+    if (!cu8_buf)
+        return 1;
+    iq_correct_state_t state = {0};
+    uint32_t lcg = 1;
+    double sum_i = 0.0, sum_q = 0.0, sum_ii = 0.0, sum_qq = 0.0, sum_iq = 0.0;
+    for (int c = 0; c < CHUNKS; ++c) {
+        for (unsigned long n = 0; n < CHUNK; n++) {
+            lcg = lcg * 1664525 + 1013904223;
+            int ni = (int)(lcg >> 26) - 32;
+            lcg = lcg * 1664525 + 1013904223;
+            int nq = (int)(lcg >> 26) - 32;
+            // DC offset of +12/-7, Q gain of 1.3 and 0.2 of I leaking into Q
+            cu8_buf[2 * n]     = 128 + 12 + ni;
+            cu8_buf[2 * n + 1] = 128 - 7 + (13 * nq + 3 * ni) / 10;
+        }
+        baseband_iq_correct_cu8(cu8_buf, cu8_buf, CHUNK, &state);
+    }
+    for (unsigned long n = 0; n < CHUNK; n++) {
+        double i = cu8_buf[2 * n] - 128.0;
+        double q = cu8_buf[2 * n + 1] - 128.0;
+        sum_i += i;
+        sum_q += q;
+        sum_ii += i * i;
+        sum_qq += q * q;
+        sum_iq += i * q;
+    }
+    free(cu8_buf);
+
+    double dc_i  = sum_i / CHUNK;
+    double dc_q  = sum_q / CHUNK;
+    double ratio = sum_qq / sum_ii;
+    double corr  = sum_iq / sum_ii;
+    int ok = dc_i > -1.0 && dc_i < 1.0 && dc_q > -1.0 && dc_q < 1.0
+            && ratio > 0.95 && ratio < 1.05 && corr > -0.03 && corr < 0.03;
+    printf("iq correct: dc %.2f %.2f, power ratio %.3f, correlation %.3f: %s\n",
+            dc_i, dc_q, ratio, corr, ok ? "ok" : "FAILED");
+    return !ok;
+}
+
+/// Check the biquad low pass filters for unity DC gain and state kept across chunks.
+static int check_low_pass(void)
+{
+    int failed = 0;
+    enum { N = 5000 };
+    uint16_t x_buf[N];
+    int16_t ref_buf[N];
+    int16_t out_buf[N];
+    for (int i = 0; i < N; ++i)
+        x_buf[i] = i < N / 2 ? 10000 : (i * 7919) % 20000; // a step, then noise
+
+    for (int order = 1; order <= 2 * FILTER_MAX_SECTIONS; ++order) {
+        filter_state_t state = {0};
+        state.order = order;
+        baseband_low_pass_set_rate(&state, 250000);
+        baseband_low_pass_filter(x_buf, ref_buf, N, &state);
+        int settled = abs(ref_buf[N / 2 - 1] - 10000) <= 50; // the fixed point filter truncates
+
+        memset(&state, 0, sizeof(state));
+        state.order = order;
+        baseband_low_pass_set_rate(&state, 250000);
+        for (int pos = 0; pos < N; pos += 777) {
+            int len = N - pos < 777 ? N - pos : 777;
+            baseband_low_pass_filter(&x_buf[pos], &out_buf[pos], len, &state);
+        }
+        int chunked = !memcmp(ref_buf, out_buf, sizeof(ref_buf));
+
+        int ok = settled && chunked;
+        printf("low pass order %d: %s\n", order, ok ? "ok" : "FAILED");
+        failed += !ok;
+    }
+    return failed;
+}
+
+/// Check the FM discriminator precision modes on CS16 tones, the output is the normalized frequency.
+static int check_fm_tones(void)
+{
+    int failed = 0;
+    enum { N = 4000 };
+    int16_t iq_buf[2 * N];
+    int16_t fm_buf[N];
+    // max error in output units (Pi equals INT16_MAX), including the low pass filter rounding
+    int const max_err[] = {800, 50, 4};
+    char const *label[] = {"fmint", "fmfast", "fmprecise"};
+
+    for (int mode = BASEBAND_FM_INT; mode <= BASEBAND_FM_PRECISE; ++mode) {
+        int err = 0;
+        for (int f = -120000; f <= 120000; f += 7500) {
+            double step = 2.0 * M_PI * f / 250000;
+            for (int i = 0; i < N; ++i) {
+                iq_buf[2 * i]     = (int16_t)(30000 * cos(step * i));
+                iq_buf[2 * i + 1] = (int16_t)(30000 * sin(step * i));
+            }
+            demodfm_state_t fm_state = {0};
+            fm_state.mode = mode;
+            baseband_demod_FM_cs16(iq_buf, fm_buf, N, 250000, 0.1f, &fm_state);
+            int expected = (int)(step / M_PI * INT16_MAX);
+            for (int i = 100; i < N; ++i) { // skip the filter settling
+                int e = abs(fm_buf[i] - expected);
+                err = e > err ? e : err;
+            }
+        }
+        int ok = err <= max_err[mode];
+        printf("%s tones: max error %d: %s\n", label[mode], err, ok ? "ok" : "FAILED");
+        failed += !ok;
+    }
+    return failed;
+}
+
+/// Check the SIMD kernels with synthetic input, covering the full sample range.
+static int check_simd_synthetic(void)
+{
+    unsigned long n_samples = 100003; // not a multiple of any vector width
+    uint8_t *cu8_buf  = malloc(sizeof(uint8_t) * 2 * n_samples);
+    int16_t *cs16_buf = malloc(sizeof(int16_t) * 2 * n_samples);
+    if (!cu8_buf || !cs16_buf) {
+        free(cu8_buf);
+        free(cs16_buf);
+        return 1;
+    }
+    uint32_t lcg = 1;
+    for (unsigned long i = 0; i < n_samples * 2; i++) {
+        lcg = lcg * 1664525 + 1013904223;
+        cu8_buf[i]  = lcg >> 24;
+        cs16_buf[i] = (int16_t)(lcg >> 16);
+    }
+    // extremes
+    cu8_buf[0] = cu8_buf[1] = 0;
+    cu8_buf[2] = cu8_buf[3] = 255;
+    cs16_buf[0] = cs16_buf[1] = INT16_MIN;
+    cs16_buf[2] = cs16_buf[3] = INT16_MAX;
+    cs16_buf[4] = INT16_MIN;
+    cs16_buf[5] = 0;
+
+    int failed = check_simd(cu8_buf, cs16_buf, n_samples);
+    failed += check_envelope(cu8_buf, n_samples);
+    failed += check_fused(cu8_buf, cs16_buf, n_samples);
+    failed += check_fm_simd(cu8_buf, cs16_buf, n_samples);
+    failed += check_native(cu8_buf, cs16_buf, n_samples);
+    failed += check_envelope_8bit(cu8_buf, n_samples);
+    failed += check_fm_tones();
+    failed += check_low_pass();
+    failed += check_iq_correct();
+
+    free(cu8_buf);
+    free(cs16_buf);
+    return failed;
+}
+
 int main(int argc, char *argv[])
 {
     baseband_init();
+    printf("Using %s baseband kernels, envelope %s\n",
+            baseband_simd_str(baseband_get_simd()), baseband_envelope_str(baseband_get_envelope()));
 
     uint8_t *cu8_buf;
     uint16_t *y16_buf;
@@ -89,7 +524,7 @@ int main(int argc, char *argv[])
     demodfm_state_t fm_state;
 
     if (argc <= 1) {
-        return 1;
+        return check_simd_synthetic();
     }
     filename = argv[1];
 
@@ -109,6 +544,8 @@ int main(int argc, char *argv[])
     s32_buf  = malloc(sizeof(int32_t) * max_block_size);
 
     n_samples = n_read / (sizeof(uint8_t) * 2);
+    memset(&state, 0, sizeof(state));
+    memset(&fm_state, 0, sizeof(fm_state));
 
     for (unsigned long i = 0; i < n_samples * 2; i++) {
         //cs16_buf[i] = 127 - cu8_buf[i];
@@ -117,9 +554,26 @@ int main(int argc, char *argv[])
         //cs16_buf[i] = (int16_t)cu8_buf[i] * 256 - 32640;
     }
 
+    int failed = check_simd(cu8_buf, cs16_buf, n_samples);
+    failed += check_envelope(cu8_buf, n_samples);
+    failed += check_fused(cu8_buf, cs16_buf, n_samples);
+    failed += check_fm_simd(cu8_buf, cs16_buf, n_samples);
+    failed += check_native(cu8_buf, cs16_buf, n_samples);
+
     MEASURE("envelope_detect",
         envelope_detect(cu8_buf, y16_buf, n_samples);
     );
+    int envelope = baseband_get_envelope();
+    for (int kernel = BASEBAND_ENVELOPE_LUT; kernel < BASEBAND_ENVELOPE_END; ++kernel) {
+        char label[64];
+        if (baseband_set_envelope(kernel) != kernel)
+            continue; // not supported on this CPU
+        snprintf(label, sizeof(label), "envelope_detect %s", baseband_envelope_str(kernel));
+        MEASURE(label,
+            envelope_detect(cu8_buf, y16_buf, n_samples);
+        );
+    }
+    baseband_set_envelope(envelope);
     MEASURE("envelope_detect_nolut",
         envelope_detect_nolut(cu8_buf, y16_buf, n_samples);
     );
@@ -134,10 +588,32 @@ int main(int argc, char *argv[])
         baseband_low_pass_filter(y16_buf, (int16_t *)u16_buf, n_samples, &state);
     );
     write_buf("bb.lp.am.s16", u16_buf, sizeof(int16_t) * n_samples);
+    for (int order = 1; order <= 2 * FILTER_MAX_SECTIONS; order *= 2) {
+        char label[64];
+        filter_state_t lp_state = {0};
+        lp_state.order = order;
+        baseband_low_pass_set_rate(&lp_state, 250000);
+        snprintf(label, sizeof(label), "baseband_low_pass_filter order %d", order);
+        MEASURE_MSPS(label, n_samples,
+            baseband_low_pass_filter(y16_buf, (int16_t *)u16_buf, n_samples, &lp_state);
+        );
+    }
     MEASURE("baseband_demod_FM",
         baseband_demod_FM(cu8_buf, s16_buf, n_samples, 250000, 0.1f, &fm_state);
     );
     write_buf("bb.fm.s16", s16_buf, sizeof(int16_t) * n_samples);
+    fm_state.mode = BASEBAND_FM_FAST;
+    MEASURE("baseband_demod_FM fmfast",
+        baseband_demod_FM(cu8_buf, s16_buf, n_samples, 250000, 0.1f, &fm_state);
+    );
+    fm_state.mode = BASEBAND_FM_PRECISE;
+    MEASURE("baseband_demod_FM fmprecise",
+        baseband_demod_FM(cu8_buf, s16_buf, n_samples, 250000, 0.1f, &fm_state);
+    );
+    fm_state.mode = BASEBAND_FM_INT;
+    MEASURE("baseband_demod_AM_FM",
+        baseband_demod_AM_FM(cu8_buf, (int16_t *)u16_buf, s16_buf, n_samples, 250000, 0.1f, 0, &state, &fm_state);
+    );
 
     write_buf("bb.cs16", cs16_buf, sizeof(int16_t) * 2 * n_samples);
     //envelope_detect_cs16(cs16_buf, y32_buf, n_samples);
@@ -164,6 +640,15 @@ int main(int argc, char *argv[])
         baseband_demod_FM_cs16(cs16_buf, s16_buf, n_samples, 250000, 0.1f, &fm_state);
     );
     write_buf("bb.cs16.fm.s16", s16_buf, sizeof(int16_t) * n_samples);
+    fm_state.mode = BASEBAND_FM_FAST;
+    MEASURE("baseband_demod_FM_cs16 fmfast",
+        baseband_demod_FM_cs16(cs16_buf, s16_buf, n_samples, 250000, 0.1f, &fm_state);
+    );
+    fm_state.mode = BASEBAND_FM_PRECISE;
+    MEASURE("baseband_demod_FM_cs16 fmprecise",
+        baseband_demod_FM_cs16(cs16_buf, s16_buf, n_samples, 250000, 0.1f, &fm_state);
+    );
+    fm_state.mode = BASEBAND_FM_INT;
 
     free(cu8_buf);
     free(y16_buf);
@@ -173,4 +658,5 @@ int main(int argc, char *argv[])
     free(u32_buf);
     free(s16_buf);
     free(s32_buf);
+    return failed;
 }
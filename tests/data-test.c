@@ -46,6 +46,18 @@ int main(void)
 	data_output_print(kv_output, data);
 	data_output_print(csv_output, data);
 
+	// a record with a slot left unset, made only when printed
+	const char *record_fields[] = { "model", "id", "temperature_C", "humidity", NULL };
+	data_record_t *record = data_record_create(record_fields);
+	data_record_string(record, 0, "", "Test-Record");
+	data_record_int(record, 1, "House Code", NULL, 42);
+	data_record_double(record, 2, "Temperature", "%.02f C", 21.5);
+	data_record_int(record, 4, "Out of range", NULL, 1);
+	data_t *record_data = data_record_make(record);
+	data_record_free(record);
+	data_output_print(json_output, record_data); fprintf(stdout, "\n");
+	data_free(record_data);
+
 	data_output_free(json_output);
 	data_output_free(kv_output);
 	data_output_free(csv_output);
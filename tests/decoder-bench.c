@@ -0,0 +1,428 @@
+/** @file
+    Decoder benchmark.
+
+    Runs the slicer and decoder of each decoder on a corpus of pulse trains
+    and reports the time and allocations per package, separately for the
+    packages the decoder hits and misses.
+
+    Each run is timed for the p50, p99, and max time per package, of each decoder
+    and of the full dispatch (all decoders, as rtl_433 runs them on a package).
+    The tail shows the pathological packages, e.g. of the worst case corpus of decoder-fuzz.
+
+    The corpus is OOK text (as written by -w file.ook, pulse trains or rfraw codes)
+    or binary pulse data (as written by -w file.ookbin), text packages with a ";freq2"
+    header are FSK.
+
+    A threshold file has lines of "<protocol> <max ns/package> [<max allocs/package> [<max p99 ns>]]",
+    the protocol is a number, "*" for all others, or "dispatch" for the full dispatch,
+    a negative maximum is not checked, lines starting with "#" are comments.
+    Any decoder above its threshold fails the benchmark, e.g. as regression gate in CI.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rtl_433.h"
+#include "r_api.h"
+#include "r_device.h"
+#include "r_private.h"
+#include "r_util.h"
+#include "pulse_data.h"
+#include "pulse_bin.h"
+#include "bitbuffer.h"
+#include "util.h"
+#include "list.h"
+#include "compat_time.h"
+#include "alloc_count.h"
+
+#define DEFAULT_LOOPS 100
+
+r_device *flex_create_device(char *spec); // maybe put this in some header file?
+
+// counted if the build wraps the allocation functions, see alloc_count.h
+#define ALLOCS_NOW() ((unsigned long)alloc_count_get().allocs)
+
+/// Threshold protocol of the full dispatch.
+#define THRESHOLD_DISPATCH -2
+
+typedef struct threshold {
+    int protocol; ///< protocol number, -1 for all others, THRESHOLD_DISPATCH for the full dispatch
+    double max_ns;
+    double max_allocs; ///< negative if not checked
+    double max_p99_ns; ///< negative if not checked
+} threshold_t;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: decoder-bench [-n <loops>] [-b <us>] [-t <thresholds>] [-R <protocol>] [-X <spec>] <corpus> ...\n"
+            "  -n <loops>  runs of each decoder on each package (default: %d)\n"
+            "  -b <us>     give each decoder run a time budget, as -Y budget of rtl_433\n"
+            "  -t <file>   fail if a decoder exceeds the thresholds of the file\n"
+            "  -R <n>      benchmark only the protocol n (can be used multiple times)\n"
+            "  -X <spec>   add a general purpose decoder (can be used multiple times)\n"
+            "  <corpus>    OOK text (.ook) or binary pulse data (.ookbin) files\n",
+            DEFAULT_LOOPS);
+    exit(1);
+}
+
+/// Load all packages of a corpus file, returns the number of packages or -1 on error.
+static int load_corpus(list_t *corpus, char const *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    int binary = str_endswith(path, ".ookbin");
+    pulse_bin_reader_t reader;
+    if (binary && pulse_bin_reader_open(&reader, file)) {
+        fprintf(stderr, "Invalid binary pulse data in %s\n", path);
+        pulse_bin_reader_close(&reader);
+        fclose(file);
+        return -1;
+    }
+
+    int count = 0;
+    for (;;) {
+        pulse_data_t *data = calloc(1, sizeof(*data));
+        if (!data) {
+            fprintf(stderr, "load_corpus: calloc failed\n");
+            count = -1;
+            break;
+        }
+        if (binary) {
+            int ret = pulse_bin_load(&reader, data);
+            if (ret < 0)
+                fprintf(stderr, "Truncated or invalid package in %s\n", path);
+        }
+        else {
+            pulse_data_load(file, data, DEFAULT_SAMPLE_RATE);
+            data->fsk_f2_est = data->freq2_hz != 0.0f;
+        }
+        if (!data->num_pulses) {
+            pulse_data_free(data);
+            free(data);
+            break;
+        }
+        list_push(corpus, data);
+        count++;
+    }
+
+    if (binary)
+        pulse_bin_reader_close(&reader);
+    fclose(file);
+    return count;
+}
+
+static void free_package(void *p)
+{
+    pulse_data_free(p);
+    free(p);
+}
+
+/// Load a threshold file, returns 0 on success.
+static int load_thresholds(list_t *thresholds, char const *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        char name[32];
+        double max_ns;
+        double max_allocs = -1.0;
+        double max_p99_ns = -1.0;
+        int n = sscanf(line, "%31s %lf %lf %lf", name, &max_ns, &max_allocs, &max_p99_ns);
+        if (n < 1 || *name == '#')
+            continue;
+        if (n < 2) {
+            fprintf(stderr, "Invalid threshold line in %s: %s", path, line);
+            fclose(file);
+            return -1;
+        }
+        threshold_t *t = malloc(sizeof(*t));
+        if (!t) {
+            fprintf(stderr, "load_thresholds: malloc failed\n");
+            fclose(file);
+            return -1;
+        }
+        t->protocol   = !strcmp(name, "*") ? -1 : !strcmp(name, "dispatch") ? THRESHOLD_DISPATCH : atoi(name);
+        t->max_ns     = max_ns;
+        t->max_allocs = n > 2 ? max_allocs : -1.0;
+        t->max_p99_ns = n > 3 ? max_p99_ns : -1.0;
+        list_push(thresholds, t);
+    }
+    fclose(file);
+    return 0;
+}
+
+static threshold_t const *find_threshold(list_t *thresholds, int protocol)
+{
+    threshold_t const *any = NULL;
+    for (void **iter = thresholds->elems; iter && *iter; ++iter) {
+        threshold_t const *t = *iter;
+        if (t->protocol == protocol)
+            return t;
+        if (t->protocol == -1 && protocol >= 0)
+            any = t;
+    }
+    return any;
+}
+
+/// Time the bit order helpers that the LSB-first decoders call on every row.
+static void bench_helpers(unsigned loops)
+{
+    uint8_t row[BITBUF_COLS];
+    for (unsigned i = 0; i < sizeof(row); ++i)
+        row[i] = (uint8_t)(i * 37);
+    unsigned runs = loops * 1000;
+
+    double begin = monotonic_time_us();
+    for (unsigned k = 0; k < runs; ++k)
+        reflect_bytes(row, sizeof(row));
+    double bytes_ns = (monotonic_time_us() - begin) * 1e3 / runs / sizeof(row);
+
+    begin = monotonic_time_us();
+    for (unsigned k = 0; k < runs; ++k)
+        reflect_nibbles(row, sizeof(row));
+    double nibbles_ns = (monotonic_time_us() - begin) * 1e3 / runs / sizeof(row);
+
+    printf("Helpers: reflect_bytes %.3f ns/byte, reflect_nibbles %.3f ns/byte (%u byte rows)\n",
+            bytes_ns, nibbles_ns, (unsigned)sizeof(row));
+}
+
+static int cmp_double(void const *a, void const *b)
+{
+    double da = *(double const *)a;
+    double db = *(double const *)b;
+    return da < db ? -1 : da > db ? 1 : 0;
+}
+
+/// The time percentiles of the runs.
+typedef struct tail {
+    double p50_ns;
+    double p99_ns;
+    double max_ns;
+} tail_t;
+
+/// Sort the run times and get the percentiles.
+static tail_t run_tail(double *run_ns, size_t n)
+{
+    qsort(run_ns, n, sizeof(*run_ns), cmp_double);
+    tail_t tail = {0};
+    if (n) {
+        tail.p50_ns = run_ns[(n - 1) / 2];
+        tail.p99_ns = run_ns[(n * 99 + 99) / 100 - 1];
+        tail.max_ns = run_ns[n - 1];
+    }
+    return tail;
+}
+
+/// Run the decoders of a list on a package, as the pulse input of rtl_433 does.
+static int run_package(decoder_dispatch_t *dispatch, list_t *r_devs, pulse_data_t *data)
+{
+    if (data->fsk_f2_est)
+        return run_fsk_dispatch(NULL, dispatch, r_devs, data);
+    else
+        return run_ook_dispatch(NULL, dispatch, r_devs, data);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned loops      = DEFAULT_LOOPS;
+    unsigned budget_us  = 0;
+    char const *thr_arg = NULL;
+    list_t protocols    = {0};
+    list_t flex_specs   = {0};
+    list_t corpus       = {0};
+    list_t thresholds   = {0};
+
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+        char opt = argv[i][1];
+        if (i + 1 >= argc)
+            usage();
+        char *arg = argv[++i];
+        if (opt == 'n')
+            loops = (unsigned)atoi(arg);
+        else if (opt == 'b')
+            budget_us = (unsigned)atoi(arg);
+        else if (opt == 't')
+            thr_arg = arg;
+        else if (opt == 'R')
+            list_push(&protocols, arg);
+        else if (opt == 'X')
+            list_push(&flex_specs, arg);
+        else
+            usage();
+    }
+    if (i >= argc || !loops)
+        usage();
+
+    for (; i < argc; ++i) {
+        if (load_corpus(&corpus, argv[i]) < 0)
+            return 1;
+    }
+    if (!corpus.len) {
+        fprintf(stderr, "The corpus has no packages\n");
+        return 1;
+    }
+    if (thr_arg && load_thresholds(&thresholds, thr_arg))
+        return 1;
+
+    r_cfg_t *cfg = r_create_cfg();
+    cfg->report_time = REPORT_TIME_OFF;
+    if (protocols.len) {
+        for (void **iter = protocols.elems; iter && *iter; ++iter) {
+            unsigned n = (unsigned)atoi(*iter);
+            if (n < 1 || n > (unsigned)cfg->num_r_devices) {
+                fprintf(stderr, "Unknown protocol %s\n", (char const *)*iter);
+                return 1;
+            }
+            register_protocol(cfg, &cfg->devices[n - 1], NULL);
+        }
+    }
+    else if (!flex_specs.len) {
+        register_all_protocols(cfg, 0);
+    }
+    for (void **iter = flex_specs.elems; iter && *iter; ++iter) {
+        register_protocol(cfg, flex_create_device(*iter), "");
+    }
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev    = *iter;
+        r_dev->time_budget = budget_us;
+    }
+
+    // the loop and the width histogram shared by all decoders
+    list_t none = {0};
+    list_ensure_size(&none, 1);
+    decoder_dispatch_t dispatch = {0};
+    double begin = monotonic_time_us();
+    for (unsigned k = 0; k < loops; ++k) {
+        for (void **pkg = corpus.elems; pkg && *pkg; ++pkg) {
+            run_package(&dispatch, &none, *pkg);
+        }
+    }
+    double overhead_ns = (monotonic_time_us() - begin) * 1e3 / loops / corpus.len;
+
+    printf("Decoders: %zu, packages: %zu, loops: %u, overhead: %.0f ns/package%s\n",
+            cfg->demod->r_devs.len, corpus.len, loops, overhead_ns,
+            alloc_count_enabled() ? "" : " (allocations are not counted in this build)");
+    bench_helpers(loops);
+
+    double *run_ns = malloc(sizeof(*run_ns) * loops * corpus.len);
+    if (!run_ns) {
+        fprintf(stderr, "malloc failed\n");
+        return 1;
+    }
+
+    // all decoders, as a package is dispatched
+    int failed = 0;
+    decoder_dispatch_t dispatch_all = {0};
+    size_t runs = 0;
+    double all_us = 0.0;
+    for (void **pkg = corpus.elems; pkg && *pkg; ++pkg) {
+        run_package(&dispatch_all, &cfg->demod->r_devs, *pkg); // warm up
+        for (unsigned k = 0; k < loops; ++k) {
+            begin = monotonic_time_us();
+            run_package(&dispatch_all, &cfg->demod->r_devs, *pkg);
+            double us = monotonic_time_us() - begin;
+            all_us += us;
+            run_ns[runs++] = us * 1e3;
+        }
+    }
+    double all_ns = all_us * 1e3 / runs;
+    tail_t all    = run_tail(run_ns, runs);
+    printf("Dispatch: %.0f ns/package, p50 %.0f ns, p99 %.0f ns, max %.0f ns\n",
+            all_ns, all.p50_ns, all.p99_ns, all.max_ns);
+    threshold_t const *all_t = find_threshold(&thresholds, THRESHOLD_DISPATCH);
+    if (all_t && all_t->max_ns >= 0.0 && all_ns > all_t->max_ns) {
+        printf("FAIL dispatch: %.0f ns/package exceeds %.0f\n", all_ns, all_t->max_ns);
+        failed = 1;
+    }
+    if (all_t && all_t->max_p99_ns >= 0.0 && all.p99_ns > all_t->max_p99_ns) {
+        printf("FAIL dispatch: p99 %.0f ns exceeds %.0f\n", all.p99_ns, all_t->max_p99_ns);
+        failed = 1;
+    }
+    decoder_dispatch_free(&dispatch_all);
+
+    printf("protocol  ns/package  hit ns  hits  miss ns  p50 ns  p99 ns  max ns  allocs/package  name\n");
+    list_t one = {0};
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        list_clear(&one, NULL);
+        list_push(&one, r_dev);
+        dispatch.valid = 0;
+
+        double hit_us      = 0.0;
+        double miss_us     = 0.0;
+        unsigned hits      = 0;
+        unsigned long allocs = 0;
+        runs                 = 0;
+        for (void **pkg = corpus.elems; pkg && *pkg; ++pkg) {
+            int hit = run_package(&dispatch, &one, *pkg) > 0; // warm up and classify
+
+            unsigned long allocs_start = ALLOCS_NOW();
+            double us = 0.0;
+            for (unsigned k = 0; k < loops; ++k) {
+                begin = monotonic_time_us();
+                run_package(&dispatch, &one, *pkg);
+                double run_us = monotonic_time_us() - begin;
+                us += run_us;
+                run_ns[runs++] = run_us * 1e3;
+            }
+            allocs += ALLOCS_NOW() - allocs_start;
+
+            if (hit) {
+                hit_us += us;
+                hits++;
+            }
+            else {
+                miss_us += us;
+            }
+        }
+
+        double ns            = (hit_us + miss_us) * 1e3 / loops / corpus.len;
+        double hit_ns        = hits ? hit_us * 1e3 / loops / hits : 0.0;
+        double miss_ns       = hits < corpus.len ? miss_us * 1e3 / loops / (corpus.len - hits) : 0.0;
+        double allocs_per_pkg = (double)allocs / loops / corpus.len;
+        tail_t tail           = run_tail(run_ns, runs);
+        printf("%8u  %10.0f  %6.0f  %4u  %7.0f  %6.0f  %6.0f  %6.0f  %14.2f  %s\n",
+                r_dev->protocol_num, ns, hit_ns, hits, miss_ns, tail.p50_ns, tail.p99_ns, tail.max_ns, allocs_per_pkg, r_dev->name);
+
+        threshold_t const *t = find_threshold(&thresholds, (int)r_dev->protocol_num);
+        if (t && t->max_ns >= 0.0 && ns > t->max_ns) {
+            printf("FAIL [%u] \"%s\": %.0f ns/package exceeds %.0f\n", r_dev->protocol_num, r_dev->name, ns, t->max_ns);
+            failed = 1;
+        }
+        if (alloc_count_enabled() && t && t->max_allocs >= 0.0 && allocs_per_pkg > t->max_allocs) {
+            printf("FAIL [%u] \"%s\": %.2f allocs/package exceeds %.2f\n", r_dev->protocol_num, r_dev->name, allocs_per_pkg, t->max_allocs);
+            failed = 1;
+        }
+        if (t && t->max_p99_ns >= 0.0 && tail.p99_ns > t->max_p99_ns) {
+            printf("FAIL [%u] \"%s\": p99 %.0f ns exceeds %.0f\n", r_dev->protocol_num, r_dev->name, tail.p99_ns, t->max_p99_ns);
+            failed = 1;
+        }
+    }
+
+    free(run_ns);
+    decoder_dispatch_free(&dispatch);
+    list_free_elems(&one, NULL);
+    list_free_elems(&none, NULL);
+    list_free_elems(&thresholds, free);
+    list_free_elems(&corpus, free_package);
+    list_free_elems(&flex_specs, NULL);
+    list_free_elems(&protocols, NULL);
+    r_free_cfg(cfg);
+    free(cfg);
+    return failed;
+}
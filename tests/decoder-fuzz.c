@@ -0,0 +1,554 @@
+/** @file
+    Decoder worst case fuzzer.
+
+    Mutates the packages of a seed corpus and keeps, for each decoder, the package
+    the decoder spends the most CPU time on. The packages with the largest slowdown
+    over the decoder's average on the seeds are written as a worst case corpus,
+    e.g. for the tail latency of decoder-bench.
+
+    Besides the seeds the fuzzer starts from the known pathological shapes:
+    a noise train of PD_MAX_PULSES random widths, each seed as 50 rows,
+    and each seed's preamble repeated up to PD_MAX_PULSES.
+    The mutations jitter widths, repeat, delete, and splice runs of pulses,
+    split rows with long gaps, and replace runs with widths of the package
+    (near-matching the decoder's timings).
+
+    The corpus is written as OOK text (.ook) or binary pulse data (.ookbin),
+    packages with a ";freq2" header in text are FSK.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rtl_433.h"
+#include "r_api.h"
+#include "r_device.h"
+#include "r_private.h"
+#include "r_util.h"
+#include "pulse_data.h"
+#include "pulse_bin.h"
+#include "list.h"
+#include "compat_time.h"
+
+#define DEFAULT_ITERATIONS 1000
+#define DEFAULT_PACKAGES   16
+#define ROWS               50  // rows of the row train, as BITBUF_ROWS
+#define PREAMBLE_PULSES    16  // pulses of a seed repeated as the preamble train
+#define CONFIRM_RUNS       3   // runs to confirm a new worst case, the minimum is kept
+
+/// The worst case search of one decoder.
+typedef struct fuzz_decoder {
+    r_device *r_dev;
+    list_t r_devs; ///< the one decoder, for the dispatch
+    decoder_dispatch_t dispatch;
+    double seed_ns;       ///< average on the seeds
+    pulse_data_t *worst;  ///< the slowest package so far, not owned
+    double worst_ns;
+} fuzz_decoder_t;
+
+static uint64_t rng_state = 1;
+
+/// xorshift64*, repeatable on all platforms.
+static uint64_t rng_next(void)
+{
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+/// Uniform in [0, n), n must not be 0.
+static unsigned rng_below(unsigned n)
+{
+    return (unsigned)(rng_next() % n);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: decoder-fuzz [-n <iterations>] [-k <packages>] [-r <seed>] [-R <protocol>] -w <out> <corpus> ...\n"
+            "  -n <n>      mutations to try (default: %d)\n"
+            "  -k <n>      packages to write, the largest slowdowns (default: %d)\n"
+            "  -r <seed>   random seed (default: 1)\n"
+            "  -R <n>      fuzz only the protocol n (can be used multiple times)\n"
+            "  -w <out>    write the worst case corpus as OOK text (.ook) or binary pulse data (.ookbin)\n"
+            "  <corpus>    seed packages, OOK text (.ook) or binary pulse data (.ookbin) files\n",
+            DEFAULT_ITERATIONS, DEFAULT_PACKAGES);
+    exit(1);
+}
+
+/// Load all packages of a corpus file, returns the number of packages or -1 on error.
+static int load_corpus(list_t *corpus, char const *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    int binary = str_endswith(path, ".ookbin");
+    pulse_bin_reader_t reader;
+    if (binary && pulse_bin_reader_open(&reader, file)) {
+        fprintf(stderr, "Invalid binary pulse data in %s\n", path);
+        pulse_bin_reader_close(&reader);
+        fclose(file);
+        return -1;
+    }
+
+    int count = 0;
+    for (;;) {
+        pulse_data_t *data = calloc(1, sizeof(*data));
+        if (!data) {
+            fprintf(stderr, "load_corpus: calloc failed\n");
+            count = -1;
+            break;
+        }
+        if (binary) {
+            pulse_bin_load(&reader, data);
+        }
+        else {
+            pulse_data_load(file, data, DEFAULT_SAMPLE_RATE);
+            data->fsk_f2_est = data->freq2_hz != 0.0f;
+        }
+        if (!data->num_pulses) {
+            pulse_data_free(data);
+            free(data);
+            break;
+        }
+        list_push(corpus, data);
+        count++;
+    }
+
+    if (binary)
+        pulse_bin_reader_close(&reader);
+    fclose(file);
+    return count;
+}
+
+static void free_package(void *p)
+{
+    pulse_data_free(p);
+    free(p);
+}
+
+/// Copy a package, exits on alloc failure.
+static pulse_data_t *package_copy(pulse_data_t const *src)
+{
+    pulse_data_t *data = calloc(1, sizeof(*data));
+    if (!data) {
+        fprintf(stderr, "package_copy: calloc failed\n");
+        exit(1);
+    }
+    *data            = *src;
+    data->pulse      = NULL;
+    data->gap        = NULL;
+    data->max_pulses = 0;
+    if (pulse_data_reserve(data, src->num_pulses ? src->num_pulses : 1)) {
+        fprintf(stderr, "package_copy: alloc failed\n");
+        exit(1);
+    }
+    memcpy(data->pulse, src->pulse, sizeof(*data->pulse) * src->num_pulses);
+    memcpy(data->gap, src->gap, sizeof(*data->gap) * src->num_pulses);
+    return data;
+}
+
+/// Append a pulse, returns -1 if the package is at PD_MAX_PULSES.
+static int package_push(pulse_data_t *data, int pulse, int gap)
+{
+    if (pulse_data_reserve(data, data->num_pulses + 1))
+        return -1;
+    data->pulse[data->num_pulses] = pulse > 0 ? pulse : 1;
+    data->gap[data->num_pulses]   = gap > 0 ? gap : 1;
+    data->num_pulses++;
+    return 0;
+}
+
+/// The longest width of a package, the final gap excluded.
+static int package_max_width(pulse_data_t const *data)
+{
+    int max = 1;
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        if (data->pulse[i] > max)
+            max = data->pulse[i];
+        if (i + 1 < data->num_pulses && data->gap[i] > max)
+            max = data->gap[i];
+    }
+    return max;
+}
+
+/// A noise train of PD_MAX_PULSES random widths, 40 us to 8 ms.
+static pulse_data_t *make_noise_train(void)
+{
+    pulse_data_t proto = {0};
+    proto.sample_rate  = DEFAULT_SAMPLE_RATE;
+    pulse_data_t *data = package_copy(&proto);
+    while (!package_push(data, 10 + (int)rng_below(2000), 10 + (int)rng_below(2000))) {
+    }
+    return data;
+}
+
+/// The seed repeated as ROWS rows, separated by gaps of three times the longest width.
+static pulse_data_t *make_row_train(pulse_data_t const *seed)
+{
+    pulse_data_t *data = package_copy(seed);
+    data->num_pulses   = 0;
+    int row_gap        = 3 * package_max_width(seed);
+    for (unsigned row = 0; row < ROWS; ++row) {
+        for (unsigned i = 0; i < seed->num_pulses; ++i) {
+            int gap = i + 1 < seed->num_pulses ? seed->gap[i] : row + 1 < ROWS ? row_gap : seed->gap[i];
+            if (package_push(data, seed->pulse[i], gap))
+                return data;
+        }
+    }
+    return data;
+}
+
+/// The first pulses of the seed repeated up to PD_MAX_PULSES.
+static pulse_data_t *make_preamble_train(pulse_data_t const *seed)
+{
+    pulse_data_t *data = package_copy(seed);
+    unsigned len       = seed->num_pulses > PREAMBLE_PULSES ? PREAMBLE_PULSES : seed->num_pulses;
+    data->num_pulses   = 0;
+    for (unsigned i = 0; !package_push(data, seed->pulse[i % len], seed->gap[i % len]); ++i) {
+    }
+    return data;
+}
+
+/// Jitter about a tenth of the widths by up to 30%.
+static void mutate_jitter(pulse_data_t *data)
+{
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        if (rng_below(10))
+            continue;
+        int *w = rng_below(2) ? &data->pulse[i] : &data->gap[i];
+        *w     = (int)(*w * (0.7 + 0.6 * rng_below(1000) / 1000.0));
+        if (*w < 1)
+            *w = 1;
+    }
+}
+
+/// Repeat a run of up to 64 pulses up to 8 times in place.
+static void mutate_repeat(pulse_data_t *data, pulse_data_t *scratch)
+{
+    unsigned start = rng_below(data->num_pulses);
+    unsigned len   = 1 + rng_below(64);
+    if (start + len > data->num_pulses)
+        len = data->num_pulses - start;
+    unsigned times = 1 + rng_below(8);
+
+    scratch->num_pulses = 0;
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        package_push(scratch, data->pulse[i], data->gap[i]);
+        for (unsigned t = 0; i + 1 == start + len && t < times; ++t) {
+            for (unsigned j = start; j < start + len; ++j)
+                package_push(scratch, data->pulse[j], data->gap[j]);
+        }
+    }
+    // swap the storage, the pulses beyond PD_MAX_PULSES are dropped
+    pulse_data_t t      = *data;
+    data->pulse         = scratch->pulse;
+    data->gap           = scratch->gap;
+    data->num_pulses    = scratch->num_pulses;
+    data->max_pulses    = scratch->max_pulses;
+    scratch->pulse      = t.pulse;
+    scratch->gap        = t.gap;
+    scratch->max_pulses = t.max_pulses;
+}
+
+/// Delete a run of up to 16 pulses, keeps at least 2 pulses.
+static void mutate_delete(pulse_data_t *data)
+{
+    if (data->num_pulses <= 2)
+        return;
+    unsigned start = rng_below(data->num_pulses - 1);
+    unsigned len   = 1 + rng_below(16);
+    if (start + len > data->num_pulses - 1)
+        len = data->num_pulses - 1 - start;
+    memmove(&data->pulse[start], &data->pulse[start + len], sizeof(*data->pulse) * (data->num_pulses - start - len));
+    memmove(&data->gap[start], &data->gap[start + len], sizeof(*data->gap) * (data->num_pulses - start - len));
+    data->num_pulses -= len;
+}
+
+/// Split the package into rows, a gap of 2 to 12 times the longest width every 4 to 64 pulses.
+static void mutate_rows(pulse_data_t *data)
+{
+    int max_width  = package_max_width(data);
+    unsigned every = 4 + rng_below(61);
+    int row_gap    = max_width * (int)(2 + rng_below(11));
+    for (unsigned i = every - 1; i + 1 < data->num_pulses; i += every)
+        data->gap[i] = row_gap;
+}
+
+/// Replace a run of up to 256 widths with random widths of the package.
+static void mutate_noise(pulse_data_t *data)
+{
+    unsigned start = rng_below(data->num_pulses);
+    unsigned len   = 1 + rng_below(256);
+    if (start + len > data->num_pulses - 1)
+        len = data->num_pulses - 1 > start ? data->num_pulses - 1 - start : 0;
+    for (unsigned i = start; i < start + len; ++i) {
+        data->pulse[i] = data->pulse[rng_below(data->num_pulses)];
+        data->gap[i]   = data->gap[rng_below(data->num_pulses - 1)];
+    }
+}
+
+/// Swap the pulse and gap widths of a few pulses, i.e. flip the bits of PWM codes.
+static void mutate_swap(pulse_data_t *data)
+{
+    for (unsigned n = 1 + rng_below(8); n; --n) {
+        unsigned i = rng_below(data->num_pulses);
+        if (i + 1 == data->num_pulses)
+            continue; // keep the final gap
+        int t          = data->pulse[i];
+        data->pulse[i] = data->gap[i];
+        data->gap[i]   = t;
+    }
+}
+
+/// Append a run of another package before the final gap.
+static void mutate_splice(pulse_data_t *data, pulse_data_t const *other)
+{
+    unsigned start = rng_below(other->num_pulses);
+    unsigned len   = 1 + rng_below(other->num_pulses - start);
+    int end_gap    = data->gap[data->num_pulses - 1];
+    data->gap[data->num_pulses - 1] = data->pulse[data->num_pulses - 1];
+    for (unsigned i = start; i < start + len; ++i) {
+        if (package_push(data, other->pulse[i], other->gap[i]))
+            break;
+    }
+    data->gap[data->num_pulses - 1] = end_gap;
+}
+
+/// Run a decoder on a package, returns the time in ns.
+static double time_decoder(fuzz_decoder_t *d, pulse_data_t *data)
+{
+    double begin = monotonic_time_us();
+    if (data->fsk_f2_est)
+        run_fsk_dispatch(NULL, &d->dispatch, &d->r_devs, data);
+    else
+        run_ook_dispatch(NULL, &d->dispatch, &d->r_devs, data);
+    return (monotonic_time_us() - begin) * 1e3;
+}
+
+/// Run all decoders on a candidate and keep it where it is a new worst case, returns 1 if kept.
+static int try_candidate(fuzz_decoder_t *decoders, unsigned num_decoders, pulse_data_t *data)
+{
+    int kept = 0;
+    for (unsigned k = 0; k < num_decoders; ++k) {
+        fuzz_decoder_t *d = &decoders[k];
+        double ns         = time_decoder(d, data);
+        if (ns <= d->worst_ns)
+            continue;
+        // confirm with the best of a few runs, a preemption is not a worst case
+        for (unsigned r = 1; r < CONFIRM_RUNS && ns > d->worst_ns; ++r) {
+            double again = time_decoder(d, data);
+            if (again < ns)
+                ns = again;
+        }
+        if (ns > d->worst_ns) {
+            d->worst    = data;
+            d->worst_ns = ns;
+            kept        = 1;
+        }
+    }
+    return kept;
+}
+
+/// Free the kept candidates that are no longer the worst case of any decoder.
+static void prune_candidates(list_t *candidates, size_t num_start, fuzz_decoder_t const *decoders, unsigned num_decoders)
+{
+    for (size_t c = candidates->len; c > num_start; --c) {
+        pulse_data_t const *data = candidates->elems[c - 1];
+        unsigned k               = 0;
+        while (k < num_decoders && decoders[k].worst != data)
+            ++k;
+        if (k == num_decoders)
+            list_remove(candidates, c - 1, free_package);
+    }
+}
+
+/// Sort the decoders by slowdown, largest first.
+static int cmp_slowdown(void const *a, void const *b)
+{
+    fuzz_decoder_t const *da = a;
+    fuzz_decoder_t const *db = b;
+    double ra                = da->worst_ns / da->seed_ns;
+    double rb                = db->worst_ns / db->seed_ns;
+    return ra < rb ? 1 : ra > rb ? -1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned iterations = DEFAULT_ITERATIONS;
+    unsigned num_out    = DEFAULT_PACKAGES;
+    char const *out_arg = NULL;
+    list_t protocols    = {0};
+    list_t seeds        = {0};
+    list_t candidates   = {0};
+
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+        char opt = argv[i][1];
+        if (i + 1 >= argc)
+            usage();
+        char *arg = argv[++i];
+        if (opt == 'n')
+            iterations = (unsigned)atoi(arg);
+        else if (opt == 'k')
+            num_out = (unsigned)atoi(arg);
+        else if (opt == 'r')
+            rng_state = (uint64_t)strtoull(arg, NULL, 10) | 1;
+        else if (opt == 'R')
+            list_push(&protocols, arg);
+        else if (opt == 'w')
+            out_arg = arg;
+        else
+            usage();
+    }
+    if (i >= argc || !out_arg)
+        usage();
+
+    for (; i < argc; ++i) {
+        if (load_corpus(&seeds, argv[i]) < 0)
+            return 1;
+    }
+    if (!seeds.len) {
+        fprintf(stderr, "The corpus has no packages\n");
+        return 1;
+    }
+
+    r_cfg_t *cfg     = r_create_cfg();
+    cfg->report_time = REPORT_TIME_OFF;
+    if (protocols.len) {
+        for (void **iter = protocols.elems; iter && *iter; ++iter) {
+            unsigned n = (unsigned)atoi(*iter);
+            if (n < 1 || n > (unsigned)cfg->num_r_devices) {
+                fprintf(stderr, "Unknown protocol %s\n", (char const *)*iter);
+                return 1;
+            }
+            register_protocol(cfg, &cfg->devices[n - 1], NULL);
+        }
+    }
+    else {
+        register_all_protocols(cfg, 0);
+    }
+
+    unsigned num_decoders    = (unsigned)cfg->demod->r_devs.len;
+    fuzz_decoder_t *decoders = calloc(num_decoders, sizeof(*decoders));
+    if (!decoders) {
+        fprintf(stderr, "calloc failed\n");
+        return 1;
+    }
+    for (unsigned k = 0; k < num_decoders; ++k) {
+        fuzz_decoder_t *d = &decoders[k];
+        d->r_dev          = cfg->demod->r_devs.elems[k];
+        list_push(&d->r_devs, d->r_dev);
+        // the baseline, after a warm up run
+        double sum = 0.0;
+        for (void **pkg = seeds.elems; pkg && *pkg; ++pkg) {
+            time_decoder(d, *pkg);
+            sum += time_decoder(d, *pkg);
+        }
+        d->seed_ns = sum / seeds.len;
+        if (d->seed_ns < 10.0)
+            d->seed_ns = 10.0; // below the clock resolution
+    }
+
+    // the seeds and the known pathological shapes first
+    list_push(&candidates, make_noise_train());
+    for (void **pkg = seeds.elems; pkg && *pkg; ++pkg) {
+        list_push(&candidates, package_copy(*pkg));
+        list_push(&candidates, make_row_train(*pkg));
+        list_push(&candidates, make_preamble_train(*pkg));
+    }
+    size_t num_start = candidates.len;
+    for (size_t c = 0; c < num_start; ++c) {
+        try_candidate(decoders, num_decoders, candidates.elems[c]);
+    }
+
+    pulse_data_t proto     = {0};
+    pulse_data_t *scratch  = package_copy(&proto);
+    double begin           = monotonic_time_us();
+    unsigned kept          = 0;
+    for (unsigned n = 0; n < iterations; ++n) {
+        // mutate the worst case of a random decoder, or a start package
+        fuzz_decoder_t *d      = &decoders[rng_below(num_decoders)];
+        pulse_data_t *parent   = d->worst && rng_below(4) ? d->worst : candidates.elems[rng_below((unsigned)num_start)];
+        pulse_data_t *data     = package_copy(parent);
+        for (unsigned m = 1 + rng_below(3); m; --m) {
+            switch (rng_below(7)) {
+            case 0: mutate_jitter(data); break;
+            case 1: mutate_repeat(data, scratch); break;
+            case 2: mutate_delete(data); break;
+            case 3: mutate_rows(data); break;
+            case 4: mutate_noise(data); break;
+            case 5: mutate_swap(data); break;
+            default: mutate_splice(data, seeds.elems[rng_below((unsigned)seeds.len)]); break;
+            }
+        }
+        if (try_candidate(decoders, num_decoders, data)) {
+            list_push(&candidates, data);
+            kept++;
+            if (candidates.len > num_start + 4 * num_decoders)
+                prune_candidates(&candidates, num_start, decoders, num_decoders);
+        }
+        else {
+            free_package(data);
+        }
+    }
+    double fuzz_s = (monotonic_time_us() - begin) * 1e-6;
+
+    // write the largest slowdowns, each package once
+    FILE *out = fopen(out_arg, "wb");
+    if (!out) {
+        fprintf(stderr, "Failed to open %s\n", out_arg);
+        return 1;
+    }
+    int binary = str_endswith(out_arg, ".ookbin");
+    if (binary)
+        pulse_bin_print_header(out, DEFAULT_SAMPLE_RATE);
+    else
+        fprintf(out, ";pulse data\n;version 1\n;timescale 1us\n;decoder worst case corpus, see decoder-fuzz.c\n");
+
+    qsort(decoders, num_decoders, sizeof(*decoders), cmp_slowdown);
+    printf("Decoders: %u, seeds: %zu, mutations: %u, kept: %u, %.1f s\n", num_decoders, seeds.len, iterations, kept, fuzz_s);
+    printf("protocol  seed ns   worst ns  slowdown  pulses  name\n");
+    unsigned written = 0;
+    for (unsigned k = 0; k < num_decoders && written < num_out; ++k) {
+        fuzz_decoder_t *d = &decoders[k];
+        int dup           = !d->worst;
+        for (unsigned j = 0; j < k && !dup; ++j)
+            dup = decoders[j].worst == d->worst;
+        if (dup)
+            continue;
+        printf("%8u  %7.0f  %9.0f  %8.1f  %6u  %s\n", d->r_dev->protocol_num, d->seed_ns, d->worst_ns,
+                d->worst_ns / d->seed_ns, d->worst->num_pulses, d->r_dev->name);
+        if (binary) {
+            pulse_bin_dump(out, d->worst);
+        }
+        else {
+            fprintf(out, ";worst case of [%u] %s, %.0f ns\n", d->r_dev->protocol_num, d->r_dev->name, d->worst_ns);
+            pulse_data_dump(out, d->worst);
+        }
+        written++;
+    }
+    fclose(out);
+
+    for (unsigned k = 0; k < num_decoders; ++k) {
+        decoder_dispatch_free(&decoders[k].dispatch);
+        list_free_elems(&decoders[k].r_devs, NULL);
+    }
+    free(decoders);
+    free_package(scratch);
+    list_free_elems(&candidates, free_package);
+    list_free_elems(&seeds, free_package);
+    list_free_elems(&protocols, NULL);
+    r_free_cfg(cfg);
+    free(cfg);
+    return 0;
+}
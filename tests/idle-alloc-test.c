@@ -0,0 +1,154 @@
+/** @file
+    Zero allocation test of the no-event path.
+
+    Processes buffers of noise and of packages that no decoder claims through
+    all decoders. After a warm up pass, which may grow the buffers, the buffers
+    without events must not allocate on the heap in any stage.
+
+    Needs a build that counts the allocations, the tests count on Linux.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "rtl_433.h"
+#include "r_api.h"
+#include "r_device.h"
+#include "r_private.h"
+#include "fileformat.h"
+#include "metrics.h"
+#include "alloc_count.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define BUF_SAMPLES 131072
+#define PASSES      3
+
+static uint32_t rng_state = 1;
+
+/// Uniform in [0, 1), repeatable.
+static double rng_uniform(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (rng_state >> 8) * (1.0 / 16777216.0);
+}
+
+/// Fill CU8 noise of about -30 dBFS.
+static void fill_noise(uint8_t *buf, unsigned n_samples)
+{
+    for (unsigned k = 0; k < 2 * n_samples; ++k) {
+        double v = (rng_uniform() + rng_uniform() + rng_uniform() - 1.5) * 10.0;
+        buf[k]   = (uint8_t)(127.5 + v);
+    }
+}
+
+/** Add a burst of pulses with random widths, which no decoder should claim.
+
+    @param fsk 0 for OOK, 1 for FSK with a mark and a space frequency
+*/
+static void add_burst(uint8_t *buf, unsigned n_samples, int fsk)
+{
+    unsigned pos = n_samples / 4;
+    double phase = 0.0;
+    for (unsigned i = 0; i < 40 && pos < n_samples - 2000; ++i) {
+        unsigned pulse = 60 + (unsigned)(rng_uniform() * 400);
+        unsigned gap   = 60 + (unsigned)(rng_uniform() * 400);
+        for (unsigned k = 0; k < pulse + gap; ++k, ++pos) {
+            int mark = k < pulse;
+            if (!mark && !fsk)
+                continue;
+            phase += 2 * M_PI * (mark ? 20000.0 : -20000.0) / 250000.0;
+            buf[2 * pos]     = (uint8_t)(127.5 + 100.0 * cos(phase));
+            buf[2 * pos + 1] = (uint8_t)(127.5 + 100.0 * sin(phase));
+        }
+    }
+}
+
+int main(void)
+{
+    if (!alloc_count_enabled()) {
+        fprintf(stderr, "Allocations are not counted in this build, skipped.\n");
+        return 0;
+    }
+
+    enum { BUFS = 3 };
+    uint8_t *bufs[BUFS];
+    for (unsigned i = 0; i < BUFS; ++i) {
+        bufs[i] = malloc(2 * BUF_SAMPLES);
+        if (!bufs[i]) {
+            fprintf(stderr, "malloc failed\n");
+            return 1;
+        }
+        fill_noise(bufs[i], BUF_SAMPLES);
+    }
+    add_burst(bufs[1], BUF_SAMPLES, 0);
+    add_burst(bufs[2], BUF_SAMPLES, 1);
+    char const *names[BUFS] = {"noise", "OOK package", "FSK package"};
+
+    r_cfg_t *cfg = r_create_cfg();
+    cfg->report_time = REPORT_TIME_OFF;
+    register_all_protocols(cfg, 0);
+
+    // a build with -DRTL433_DEVICES may lack the OOK or the FSK decoders
+    int has_ook = 0;
+    int has_fsk = 0;
+    for (void **iter = cfg->demod->r_devs.elems; iter && *iter; ++iter) {
+        r_device *r_dev = *iter;
+        if (r_dev->modulation >= FSK_DEMOD_MIN_VAL)
+            has_fsk = 1;
+        else
+            has_ook = 1;
+    }
+
+    int failed = 0;
+    unsigned checked = 0;
+    for (unsigned pass = 0; pass < PASSES; ++pass) {
+        for (unsigned i = 0; i < BUFS; ++i) {
+            alloc_count_t before = alloc_count_get();
+            int events           = r_process_iq(cfg, bufs[i], 2 * BUF_SAMPLES, CU8_IQ, NULL);
+            alloc_count_t after  = alloc_count_get();
+            if (events < 0) {
+                fprintf(stderr, "r_process_iq failed\n");
+                return 1;
+            }
+            if (!pass || events)
+                continue; // the warm up grows the buffers, events allocate their data
+            checked++;
+            if (after.allocs != before.allocs) {
+                printf("FAIL %s buffer without events: %llu allocations in pass %u\n", names[i],
+                        (unsigned long long)(after.allocs - before.allocs), pass + 1);
+                failed = 1;
+            }
+        }
+    }
+
+    metrics_t const *metrics = cfg->metrics;
+    static char const *const stage_names[METRICS_STAGES] = {"baseband", "pulse_detect", "decode", "output"};
+    printf("Buffers: %llu, without events: %llu, checked: %u, allocating without events: %llu, OOK/FSK packages: %llu/%llu\n",
+            (unsigned long long)metrics->buffers, (unsigned long long)metrics->buffers_idle,
+            checked, (unsigned long long)metrics->idle_alloc_buffers,
+            (unsigned long long)metrics->frames_ook, (unsigned long long)metrics->frames_fsk);
+    for (unsigned i = 0; i < METRICS_STAGES; ++i) {
+        printf("Stage %-12s allocs %llu frees %llu\n", stage_names[i],
+                (unsigned long long)metrics->allocs[i].allocs, (unsigned long long)metrics->allocs[i].frees);
+    }
+    if (!checked || (has_ook && !metrics->frames_ook) || (has_fsk && !metrics->frames_fsk)) {
+        printf("FAIL the buffers without events were not all checked\n");
+        failed = 1;
+    }
+
+    r_free_cfg(cfg);
+    free(cfg);
+    for (unsigned i = 0; i < BUFS; ++i)
+        free(bufs[i]);
+    return failed;
+}
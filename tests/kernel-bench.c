@@ -0,0 +1,583 @@
+/** @file
+    DSP kernel benchmark.
+
+    Runs each variant of the envelope, magnitude, low pass, FM, fused AM/FM,
+    and pulse detect kernels (scalar, LUT, and each SIMD level the CPU supports)
+    over a synthetic input and recorded inputs, and reports the time per sample,
+    the throughput, and if the output is bit-exact with the reference variant.
+
+    The synthetic input is repeatable: noise, OOK and FSK bursts, a clipped burst,
+    and a full scale sweep. Recorded inputs are CU8 (.cu8) or CS16 (.cs16) files,
+    each is converted to the other format too.
+
+    The reference of a kernel is its first variant, i.e. the LUT envelope or the
+    scalar level, any other variant that is not bit-exact fails the benchmark.
+    The output is a text table, CSV, or JSON lines, to compare machines.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "baseband.h"
+#include "pulse_detect.h"
+#include "pulse_data.h"
+#include "fileformat.h"
+#include "r_util.h"
+#include "optparse.h"
+#include "compat_time.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEFAULT_SAMPLES (1 << 20)
+#define DEFAULT_RUNS    10
+#define MAX_SAMPLES     (1 << 24)
+#define BLOCK_SAMPLES   131072 // as the default SDR buffer of 256 KiB CU8
+#define SAMP_RATE       250000
+#define FM_LOW_PASS     0.1f
+
+/// The samples of an input in both formats, with the reference demodulation for the later stages.
+typedef struct input {
+    char const *name;
+    unsigned n_samples;
+    uint8_t *cu8;
+    int16_t *cs16;
+    uint16_t *env; ///< LUT envelope, input of the low pass
+    int16_t *am;   ///< low pass filtered envelope, input of the pulse detector
+    int16_t *fm;   ///< FM demodulation, input of the pulse detector
+} input_t;
+
+/** A kernel runs over the whole input in blocks, as the SDR delivers it.
+
+    @param param the kernel parameter, e.g. the filter order or the FM mode
+    @param[out] out the output, up to 4 bytes per sample and 16 bytes
+    @return the bytes of output
+*/
+typedef size_t (*kernel_fn)(input_t const *in, int param, uint8_t *out);
+
+/// What the variants of a kernel are.
+enum variants {
+    VARIANTS_NONE,     ///< scalar only
+    VARIANTS_SIMD,     ///< each SIMD level, the scalar level is the reference
+    VARIANTS_ENVELOPE, ///< each envelope kernel and SIMD level, the LUT is the reference
+};
+
+typedef struct kernel {
+    char const *name;
+    kernel_fn run;
+    int param;
+    int variants;
+} kernel_t;
+
+enum output_format {
+    OUTPUT_TEXT,
+    OUTPUT_CSV,
+    OUTPUT_JSON,
+};
+
+static size_t run_envelope(input_t const *in, int param, uint8_t *out)
+{
+    (void)param;
+    uint16_t *y = (uint16_t *)out;
+    double db   = 0.0;
+    for (unsigned off = 0; off < in->n_samples; off += BLOCK_SAMPLES) {
+        unsigned len = in->n_samples - off < BLOCK_SAMPLES ? in->n_samples - off : BLOCK_SAMPLES;
+        db += envelope_detect(&in->cu8[2 * off], &y[off], len);
+    }
+    memcpy(&y[in->n_samples], &db, sizeof(db));
+    return in->n_samples * sizeof(*y) + sizeof(db);
+}
+
+static size_t run_magnitude_cu8(input_t const *in, int param, uint8_t *out)
+{
+    (void)param;
+    uint16_t *y = (uint16_t *)out;
+    double db   = 0.0;
+    for (unsigned off = 0; off < in->n_samples; off += BLOCK_SAMPLES) {
+        unsigned len = in->n_samples - off < BLOCK_SAMPLES ? in->n_samples - off : BLOCK_SAMPLES;
+        db += magnitude_est_cu8(&in->cu8[2 * off], &y[off], len);
+    }
+    memcpy(&y[in->n_samples], &db, sizeof(db));
+    return in->n_samples * sizeof(*y) + sizeof(db);
+}
+
+static size_t run_magnitude_cs16(input_t const *in, int param, uint8_t *out)
+{
+    (void)param;
+    uint16_t *y = (uint16_t *)out;
+    double db   = 0.0;
+    for (unsigned off = 0; off < in->n_samples; off += BLOCK_SAMPLES) {
+        unsigned len = in->n_samples - off < BLOCK_SAMPLES ? in->n_samples - off : BLOCK_SAMPLES;
+        db += magnitude_est_cs16(&in->cs16[2 * off], &y[off], len);
+    }
+    memcpy(&y[in->n_samples], &db, sizeof(db));
+    return in->n_samples * sizeof(*y) + sizeof(db);
+}
+
+/// @param param the filter order
+static size_t run_low_pass(input_t const *in, int param, uint8_t *out)
+{
+    int16_t *y           = (int16_t *)out;
+    filter_state_t state = {0};
+    state.order          = param;
+    baseband_low_pass_set_rate(&state, SAMP_RATE);
+    for (unsigned off = 0; off < in->n_samples; off += BLOCK_SAMPLES) {
+        unsigned len = in->n_samples - off < BLOCK_SAMPLES ? in->n_samples - off : BLOCK_SAMPLES;
+        baseband_low_pass_filter(&in->env[off], &y[off], len, &state);
+    }
+    return in->n_samples * sizeof(*y);
+}
+
+/// @param param the FM mode, a BASEBAND_FM_ mode
+static size_t run_fm_cu8(input_t const *in, int param, uint8_t *out)
+{
+    int16_t *y            = (int16_t *)out;
+    demodfm_state_t state = {0};
+    state.mode            = param;
+    for (unsigned off = 0; off < in->n_samples; off += BLOCK_SAMPLES) {
+        unsigned len = in->n_samples - off < BLOCK_SAMPLES ? in->n_samples - off : BLOCK_SAMPLES;
+        baseband_demod_FM(&in->cu8[2 * off], &y[off], len, SAMP_RATE, FM_LOW_PASS, &state);
+    }
+    return in->n_samples * sizeof(*y);
+}
+
+/// @param param the FM mode, a BASEBAND_FM_ mode
+static size_t run_fm_cs16(input_t const *in, int param, uint8_t *out)
+{
+    int16_t *y            = (int16_t *)out;
+    demodfm_state_t state = {0};
+    state.mode            = param;
+    for (unsigned off = 0; off < in->n_samples; off += BLOCK_SAMPLES) {
+        unsigned len = in->n_samples - off < BLOCK_SAMPLES ? in->n_samples - off : BLOCK_SAMPLES;
+        baseband_demod_FM_cs16(&in->cs16[2 * off], &y[off], len, SAMP_RATE, FM_LOW_PASS, &state);
+    }
+    return in->n_samples * sizeof(*y);
+}
+
+/// @param param the sample format, CU8_IQ or CS16_IQ
+static size_t run_am_fm(input_t const *in, int param, uint8_t *out)
+{
+    baseband_kernels_t const *kernels = baseband_get_kernels((uint32_t)param, 0);
+    void const *iq                    = param == CS16_IQ ? (void const *)in->cs16 : (void const *)in->cu8;
+    int16_t *am                       = (int16_t *)out;
+    int16_t *fm                       = am + in->n_samples;
+    filter_state_t lp_state           = {0};
+    demodfm_state_t fm_state          = {0};
+    double db                         = 0.0;
+    for (unsigned off = 0; off < in->n_samples; off += BLOCK_SAMPLES) {
+        unsigned len = in->n_samples - off < BLOCK_SAMPLES ? in->n_samples - off : BLOCK_SAMPLES;
+        db += kernels->demod_AM_FM((uint8_t const *)iq + (size_t)off * kernels->sample_size, &am[off], NULL, &fm[off],
+                len, SAMP_RATE, FM_LOW_PASS, 0, &lp_state, &fm_state, NULL);
+    }
+    memcpy(&fm[in->n_samples], &db, sizeof(db));
+    return 2 * in->n_samples * sizeof(*am) + sizeof(db);
+}
+
+/// Append a value to the pulse detect output, drops values beyond the output size.
+static void put_int(int32_t *y, size_t *pos, size_t size, int32_t v)
+{
+    if (*pos < size)
+        y[*pos] = v;
+    ++*pos;
+}
+
+/// @param param the FSK pulse detector, a FSK_PULSE_DETECT_ value
+static size_t run_pulse_detect(input_t const *in, int param, uint8_t *out)
+{
+    int32_t *y          = (int32_t *)out;
+    size_t size         = in->n_samples; // 4 bytes per sample
+    size_t pos          = 0;
+    pulse_data_t pulses = {0};
+    pulse_data_t fsk    = {0};
+    pulse_detect_t *pd  = pulse_detect_create();
+    if (!pd) {
+        fprintf(stderr, "pulse_detect_create failed\n");
+        exit(1);
+    }
+    pulse_detect_set_levels(pd, 0, 0.0f, -12.1442f, 9.0f, 0);
+    for (unsigned off = 0; off < in->n_samples; off += BLOCK_SAMPLES) {
+        unsigned len = in->n_samples - off < BLOCK_SAMPLES ? in->n_samples - off : BLOCK_SAMPLES;
+        int type;
+        while ((type = pulse_detect_package(pd, &in->am[off], &in->fm[off], (int)len, SAMP_RATE, off, &pulses, &fsk, (unsigned)param))) {
+            pulse_data_t const *data = type == PULSE_DATA_OOK ? &pulses : &fsk;
+            put_int(y, &pos, size, type);
+            put_int(y, &pos, size, (int32_t)data->num_pulses);
+            for (unsigned i = 0; i < data->num_pulses; ++i) {
+                put_int(y, &pos, size, data->pulse[i]);
+                put_int(y, &pos, size, data->gap[i]);
+            }
+        }
+    }
+    pulse_detect_free(pd);
+    pulse_data_free(&pulses);
+    pulse_data_free(&fsk);
+    return (pos < size ? pos : size) * sizeof(*y);
+}
+
+static kernel_t const kernels[] = {
+        {"envelope", run_envelope, 0, VARIANTS_ENVELOPE},
+        {"magnitude_cu8", run_magnitude_cu8, 0, VARIANTS_SIMD},
+        {"magnitude_cs16", run_magnitude_cs16, 0, VARIANTS_SIMD},
+        {"low_pass_order1", run_low_pass, 1, VARIANTS_NONE},
+        {"low_pass_order2", run_low_pass, 2, VARIANTS_NONE},
+        {"low_pass_order4", run_low_pass, 4, VARIANTS_NONE},
+        {"low_pass_order8", run_low_pass, 2 * FILTER_MAX_SECTIONS, VARIANTS_NONE},
+        {"fm_cu8_int", run_fm_cu8, BASEBAND_FM_INT, VARIANTS_NONE},
+        {"fm_cu8_fast", run_fm_cu8, BASEBAND_FM_FAST, VARIANTS_SIMD},
+        {"fm_cu8_precise", run_fm_cu8, BASEBAND_FM_PRECISE, VARIANTS_SIMD},
+        {"fm_cs16_int", run_fm_cs16, BASEBAND_FM_INT, VARIANTS_NONE},
+        {"fm_cs16_fast", run_fm_cs16, BASEBAND_FM_FAST, VARIANTS_SIMD},
+        {"fm_cs16_precise", run_fm_cs16, BASEBAND_FM_PRECISE, VARIANTS_SIMD},
+        {"am_fm_cu8", run_am_fm, CU8_IQ, VARIANTS_SIMD},
+        {"am_fm_cs16", run_am_fm, CS16_IQ, VARIANTS_SIMD},
+        {"pulse_detect_fsk_old", run_pulse_detect, FSK_PULSE_DETECT_OLD, VARIANTS_NONE},
+        {"pulse_detect_fsk_new", run_pulse_detect, FSK_PULSE_DETECT_NEW, VARIANTS_NONE},
+};
+
+/// A variant of a kernel, selected with the SIMD level and the envelope kernel.
+typedef struct variant {
+    char label[32];
+    int simd;
+    int envelope;
+} variant_t;
+
+/// List the variants of a kernel this CPU supports, the reference first, returns the number of variants.
+static unsigned list_variants(kernel_t const *kernel, variant_t *variants)
+{
+    unsigned n = 0;
+    if (kernel->variants == VARIANTS_ENVELOPE) {
+        variants[n++] = (variant_t){"lut", BASEBAND_SIMD_NONE, BASEBAND_ENVELOPE_LUT};
+        variants[n++] = (variant_t){"mul", BASEBAND_SIMD_NONE, BASEBAND_ENVELOPE_MUL};
+        for (int level = BASEBAND_SIMD_NONE + 1; level < BASEBAND_SIMD_END; ++level) {
+            if (baseband_set_simd(level) != level)
+                continue; // not supported on this CPU
+            variant_t *v = &variants[n++];
+            snprintf(v->label, sizeof(v->label), "simd %s", baseband_simd_str(level));
+            v->simd     = level;
+            v->envelope = BASEBAND_ENVELOPE_SIMD;
+        }
+    }
+    else if (kernel->variants == VARIANTS_SIMD) {
+        for (int level = BASEBAND_SIMD_NONE; level < BASEBAND_SIMD_END; ++level) {
+            if (baseband_set_simd(level) != level)
+                continue; // not supported on this CPU
+            variant_t *v = &variants[n++];
+            snprintf(v->label, sizeof(v->label), "%s", baseband_simd_str(level));
+            v->simd     = level;
+            v->envelope = BASEBAND_ENVELOPE_LUT;
+        }
+    }
+    else {
+        variants[n++] = (variant_t){"scalar", BASEBAND_SIMD_NONE, BASEBAND_ENVELOPE_LUT};
+    }
+    return n;
+}
+
+/// Allocate the sample buffers of an input, exits on alloc failure.
+static void input_alloc(input_t *in, char const *name, unsigned n_samples)
+{
+    in->name      = name;
+    in->n_samples = n_samples;
+    in->cu8       = malloc(2 * (size_t)n_samples);
+    if (!in->cu8) {
+        fprintf(stderr, "input_alloc: malloc failed\n");
+        exit(1);
+    }
+    in->cs16 = malloc(2 * sizeof(*in->cs16) * n_samples);
+    if (!in->cs16) {
+        fprintf(stderr, "input_alloc: malloc failed\n");
+        exit(1);
+    }
+}
+
+/// Demodulate the reference envelope, AM, and FM with the scalar kernels, exits on alloc failure.
+static void input_demod(input_t *in)
+{
+    in->env = malloc(sizeof(*in->env) * in->n_samples);
+    if (!in->env) {
+        fprintf(stderr, "input_demod: malloc failed\n");
+        exit(1);
+    }
+    in->am = malloc(2 * sizeof(*in->am) * in->n_samples + sizeof(double));
+    if (!in->am) {
+        fprintf(stderr, "input_demod: malloc failed\n");
+        exit(1);
+    }
+    in->fm = in->am + in->n_samples;
+
+    baseband_set_simd(BASEBAND_SIMD_NONE);
+    baseband_set_envelope(BASEBAND_ENVELOPE_LUT);
+    for (unsigned off = 0; off < in->n_samples; off += BLOCK_SAMPLES) {
+        unsigned len = in->n_samples - off < BLOCK_SAMPLES ? in->n_samples - off : BLOCK_SAMPLES;
+        envelope_detect(&in->cu8[2 * off], &in->env[off], len);
+    }
+    run_am_fm(in, CU8_IQ, (uint8_t *)in->am);
+}
+
+static void input_free(input_t *in)
+{
+    free(in->cu8);
+    free(in->cs16);
+    free(in->env);
+    free(in->am);
+}
+
+static uint32_t rng_state = 1;
+
+/// Uniform in [0, 1), repeatable.
+static double rng_uniform(void)
+{
+    rng_state = rng_state * 1664525u + 1013904223u;
+    return (rng_state >> 8) * (1.0 / 16777216.0);
+}
+
+/// Set a sample of both formats from a full scale value, clamps the overrange.
+static void set_sample(input_t *in, unsigned k, double i, double q)
+{
+    double v[2] = {i, q};
+    for (unsigned j = 0; j < 2; ++j) {
+        double s            = v[j] < -1.0 ? -1.0 : v[j] > 1.0 ? 1.0 : v[j];
+        in->cu8[2 * k + j]  = (uint8_t)lrint(127.5 + 127.5 * s);
+        in->cs16[2 * k + j] = (int16_t)lrint(32767.0 * s);
+    }
+}
+
+/** Create the synthetic input: noise of about -30 dBFS, with each 64k samples one of
+    an OOK burst, an FSK burst, a burst at twice full scale (clipped), a full scale sweep
+    of the amplitude and the phase, or noise only.
+*/
+static void input_synthetic(input_t *in, unsigned n_samples)
+{
+    input_alloc(in, "synthetic", n_samples);
+    rng_state    = 1;
+    double phase = 0.0;
+    for (unsigned k = 0; k < n_samples; ++k) {
+        double ni = (rng_uniform() + rng_uniform() + rng_uniform() - 1.5) * 0.08;
+        double nq = (rng_uniform() + rng_uniform() + rng_uniform() - 1.5) * 0.08;
+        unsigned seg = k >> 16;
+        unsigned pos = k & 0xffff;
+        double amp   = 0.0;
+        double freq  = 20000.0;
+        if (pos >= 8192 && pos < 57344) {
+            int mark = (pos / 256) & 1; // 1 ms pulses and gaps
+            switch (seg % 5) {
+            case 0: amp = mark ? 0.8 : 0.0; break;
+            case 1: amp = 0.8, freq = mark ? 20000.0 : -20000.0; break;
+            case 2: amp = mark ? 2.0 : 0.0; break;
+            case 3: amp = (pos - 8192) / 49152.0, freq = 60000.0; break;
+            default: break;
+            }
+        }
+        phase += 2 * M_PI * freq / SAMP_RATE;
+        set_sample(in, k, ni + amp * cos(phase), nq + amp * sin(phase));
+    }
+    input_demod(in);
+}
+
+/// Load a recorded CU8 or CS16 input, returns 0 on success.
+static int input_load(input_t *in, char const *path)
+{
+    int cs16 = str_endswith(path, ".cs16");
+    if (!cs16 && !str_endswith(path, ".cu8")) {
+        fprintf(stderr, "Only CU8 (.cu8) and CS16 (.cs16) inputs are supported: %s\n", path);
+        return -1;
+    }
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    size_t sample_size = cs16 ? 4 : 2;
+    size_t n_samples   = size > 0 ? (size_t)size / sample_size : 0;
+    if (n_samples > MAX_SAMPLES)
+        n_samples = MAX_SAMPLES;
+    if (!n_samples) {
+        fprintf(stderr, "No samples in %s\n", path);
+        fclose(file);
+        return -1;
+    }
+    input_alloc(in, path, (unsigned)n_samples);
+    size_t n_read = fread(cs16 ? (void *)in->cs16 : (void *)in->cu8, sample_size, n_samples, file);
+    fclose(file);
+    if (n_read != n_samples) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        input_free(in);
+        return -1;
+    }
+    for (size_t k = 0; k < 2 * n_samples; ++k) {
+        if (cs16)
+            in->cu8[k] = (uint8_t)((in->cs16[k] >> 8) + 128);
+        else
+            in->cs16[k] = (int16_t)((in->cu8[k] - 128) * 256);
+    }
+    input_demod(in);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: kernel-bench [-n <runs>] [-s <samples>] [-k <kernel>] [-F text|csv|json] [<input> ...]\n"
+            "  -n <runs>     time the best of n runs of each variant (default: %d)\n"
+            "  -s <samples>  samples of the synthetic input, 0 to skip it (default: %d)\n"
+            "  -k <kernel>   benchmark only the kernels starting with this name (can be used multiple times)\n"
+            "  -F <format>   output a text table, CSV, or JSON lines (default: text)\n"
+            "  <input>       recorded CU8 (.cu8) or CS16 (.cs16) files\n",
+            DEFAULT_RUNS, DEFAULT_SAMPLES);
+    exit(1);
+}
+
+/// Returns 1 if the kernel is selected, all kernels if there are no filters.
+static int kernel_selected(kernel_t const *kernel, char **filters, unsigned num_filters)
+{
+    for (unsigned i = 0; i < num_filters; ++i) {
+        if (!strncmp(kernel->name, filters[i], strlen(filters[i])))
+            return 1;
+    }
+    return !num_filters;
+}
+
+/// Benchmark all variants of the kernels on an input, returns the number of variants that are not bit-exact.
+static int bench_input(input_t const *in, unsigned runs, int format, char **filters, unsigned num_filters)
+{
+    int failed       = 0;
+    size_t out_size  = 4 * (size_t)in->n_samples + 16;
+    uint8_t *ref_buf = malloc(out_size);
+    if (!ref_buf) {
+        fprintf(stderr, "bench_input: malloc failed\n");
+        exit(1);
+    }
+    uint8_t *out_buf = malloc(out_size);
+    if (!out_buf) {
+        fprintf(stderr, "bench_input: malloc failed\n");
+        exit(1);
+    }
+
+    for (size_t i = 0; i < sizeof(kernels) / sizeof(*kernels); ++i) {
+        kernel_t const *kernel = &kernels[i];
+        if (!kernel_selected(kernel, filters, num_filters))
+            continue;
+        variant_t variants[2 + BASEBAND_SIMD_END];
+        unsigned num_variants = list_variants(kernel, variants);
+        size_t ref_len        = 0;
+        for (unsigned v = 0; v < num_variants; ++v) {
+            baseband_set_simd(variants[v].simd);
+            baseband_set_envelope(variants[v].envelope);
+            uint8_t *buf = v ? out_buf : ref_buf;
+            size_t len   = 0;
+            double best  = 0.0;
+            for (unsigned r = 0; r < runs; ++r) {
+                double begin = monotonic_time_us();
+                len          = kernel->run(in, kernel->param, buf);
+                double us    = monotonic_time_us() - begin;
+                if (!r || us < best)
+                    best = us;
+            }
+            if (!v)
+                ref_len = len;
+            int exact        = len == ref_len && !memcmp(buf, ref_buf, len);
+            double ns_sample = best * 1e3 / in->n_samples;
+            double msps      = best > 0.0 ? in->n_samples / best : 0.0;
+            char const *ref  = variants[0].label;
+
+            if (format == OUTPUT_JSON) {
+                printf("{\"kernel\" : \"%s\", \"variant\" : \"%s\", \"reference\" : \"%s\", \"input\" : \"%s\", \"samples\" : %u, "
+                       "\"ns_per_sample\" : %.3f, \"msps\" : %.2f, \"exact\" : %s}\n",
+                        kernel->name, variants[v].label, ref, in->name, in->n_samples, ns_sample, msps, exact ? "true" : "false");
+            }
+            else if (format == OUTPUT_CSV) {
+                printf("%s,%s,%s,%s,%u,%.3f,%.2f,%d\n",
+                        kernel->name, variants[v].label, ref, in->name, in->n_samples, ns_sample, msps, exact);
+            }
+            else {
+                printf("%-22s %-10s %9.3f %9.2f  %s\n",
+                        kernel->name, variants[v].label, ns_sample, msps, !v ? "reference" : exact ? "exact" : "MISMATCH");
+            }
+            failed += !exact;
+        }
+    }
+
+    free(ref_buf);
+    free(out_buf);
+    return failed;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned runs      = DEFAULT_RUNS;
+    unsigned n_samples = DEFAULT_SAMPLES;
+    int format         = OUTPUT_TEXT;
+    char *filters[16];
+    unsigned num_filters = 0;
+
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+        char opt = argv[i][1];
+        if (i + 1 >= argc)
+            usage();
+        char *arg = argv[++i];
+        if (opt == 'n')
+            runs = (unsigned)atoi(arg);
+        else if (opt == 's')
+            n_samples = (unsigned)atoi(arg);
+        else if (opt == 'k' && num_filters < sizeof(filters) / sizeof(*filters))
+            filters[num_filters++] = arg;
+        else if (opt == 'F' && !strcasecmp(arg, "text"))
+            format = OUTPUT_TEXT;
+        else if (opt == 'F' && !strcasecmp(arg, "csv"))
+            format = OUTPUT_CSV;
+        else if (opt == 'F' && !strcasecmp(arg, "json"))
+            format = OUTPUT_JSON;
+        else
+            usage();
+    }
+    if (!runs || n_samples > MAX_SAMPLES || (!n_samples && i >= argc))
+        usage();
+
+    baseband_init();
+    int simd     = baseband_get_simd();
+    int envelope = baseband_get_envelope();
+
+    if (format == OUTPUT_CSV)
+        printf("kernel,variant,reference,input,samples,ns_per_sample,msps,exact\n");
+    else if (format == OUTPUT_TEXT)
+        printf("Best SIMD level: %s, envelope: %s, runs: %u, block: %d samples\n",
+                baseband_simd_str(simd), baseband_envelope_str(envelope), runs, BLOCK_SAMPLES);
+
+    int failed = 0;
+    input_t in = {0};
+    if (n_samples) {
+        input_synthetic(&in, n_samples);
+        if (format == OUTPUT_TEXT)
+            printf("\nInput: %s, %u samples\nkernel                 variant    ns/sample      Msps  bit-exact\n", in.name, in.n_samples);
+        failed += bench_input(&in, runs, format, filters, num_filters);
+        input_free(&in);
+    }
+    for (; i < argc; ++i) {
+        if (input_load(&in, argv[i])) {
+            failed++;
+            continue;
+        }
+        if (format == OUTPUT_TEXT)
+            printf("\nInput: %s, %u samples\nkernel                 variant    ns/sample      Msps  bit-exact\n", in.name, in.n_samples);
+        failed += bench_input(&in, runs, format, filters, num_filters);
+        input_free(&in);
+    }
+
+    baseband_set_simd(simd);
+    baseband_set_envelope(envelope);
+    if (failed && format == OUTPUT_TEXT)
+        printf("FAIL %d variants are not bit-exact or inputs failed to load\n", failed);
+    return failed ? 1 : 0;
+}
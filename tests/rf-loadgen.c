@@ -0,0 +1,561 @@
+/** @file
+    Synthetic RF load generator.
+
+    Turns pulse trains back into OOK or FSK I/Q samples, transmitted by a
+    population of sensors at random intervals, offsets and levels over noise.
+    Feed the output to rtl_433 to find the number of sensors a platform sustains,
+    e.g. with -Y bench on a file or live from the rtl_tcp server.
+
+    The pulse trains are OOK text (as written by -w file.ook, pulse trains or
+    rfraw codes), packages with a ";freq2" header are sent as FSK.
+    Each sensor repeats one package of the corpus, the sensors take turns on the packages.
+    Transmissions that overlap are counted as collided, a fraction of the
+    transmissions can be made to collide on purpose.
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "rtl_433.h"
+#include "r_api.h"
+#include "pulse_data.h"
+#include "rfraw.h"
+#include "raw_output.h"
+#include "output_rtltcp.h"
+#include "optparse.h"
+#include "list.h"
+#include "r_util.h"
+#include "r_private.h"
+#include "util.h"
+#include "compat_time.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define DEFAULT_RATE     250000
+#define DEFAULT_SENSORS  10
+#define DEFAULT_INTERVAL 30.0
+#define DEFAULT_DURATION 60.0
+#define BLOCK_SAMPLES    16384
+#define NOISE_TABLE      65536
+
+typedef struct sensor {
+    pulse_data_t const *pkg;
+    int fsk;
+    float amp;
+    double omega;    ///< carrier offset in rad/sample
+    uint64_t next;   ///< start of the next transmission in samples
+} sensor_t;
+
+/// A transmission in progress.
+typedef struct tx {
+    sensor_t const *sensor;
+    uint64_t end;    ///< end of the last pulse in samples
+    unsigned idx;    ///< the current pulse
+    int in_gap;
+    unsigned left;   ///< samples left of the current pulse or gap
+    float re, im;    ///< the carrier phasor
+    float rot_re, rot_im;
+    int collided;
+    int done;
+} tx_t;
+
+typedef struct gen {
+    uint32_t rate;
+    double interval_s;
+    double dev;          ///< FSK deviation in rad/sample
+    double collide;      ///< fraction of forced collisions
+    unsigned num_sensors;
+    sensor_t *sensors;
+    tx_t *txs;           ///< at most one transmission per sensor
+    unsigned num_txs;
+    float noise[NOISE_TABLE];
+    uint64_t rng;
+    uint64_t sent;
+    uint64_t collided;
+} gen_t;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: rf-loadgen [options] <corpus> ...\n"
+            "  -s <rate>      sample rate (default: %d)\n"
+            "  -n <sensors>   sensor population (default: %d)\n"
+            "  -i <seconds>   mean interval of each sensor (default: %.0f)\n"
+            "  -d <seconds>   duration, 0 to run until stopped (default: %.0f)\n"
+            "  -S <dB>[:<dB>] SNR range of the sensors (default: 20:30)\n"
+            "  -N <dB>        noise level in dBFS (default: -30)\n"
+            "  -F <Hz>        carrier offset range of the sensors (default: rate/20)\n"
+            "  -D <Hz>        FSK deviation (default: rate/10)\n"
+            "  -M ook|fsk     send all packages with this modulation\n"
+            "  -c <fraction>  fraction of transmissions made to collide (default: 0)\n"
+            "  -r <seed>      random seed (default: 1)\n"
+            "  -p <rfraw>     add a pulse train as rfraw code (can be used multiple times)\n"
+            "  -f cu8|cs16    sample format (default: from the file name, else cu8)\n"
+            "  -w <file>      write the samples to a file, \"-\" for stdout\n"
+            "  -T [host][:port]  serve the samples as rtl_tcp, paced in real time\n"
+            "  -t             pace the file output in real time\n"
+            "  <corpus>       OOK text (.ook) files\n",
+            DEFAULT_RATE, DEFAULT_SENSORS, DEFAULT_INTERVAL, DEFAULT_DURATION);
+    exit(1);
+}
+
+/// xorshift64*, repeatable on all platforms.
+static uint64_t rng_next(gen_t *gen)
+{
+    gen->rng ^= gen->rng >> 12;
+    gen->rng ^= gen->rng << 25;
+    gen->rng ^= gen->rng >> 27;
+    return gen->rng * 0x2545F4914F6CDD1DULL;
+}
+
+/// Uniform in [0, 1).
+static double rng_uniform(gen_t *gen)
+{
+    return (rng_next(gen) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/// Load all packages of a corpus file, returns the number of packages or -1 on error.
+static int load_corpus(list_t *corpus, char const *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return -1;
+    }
+    int count = 0;
+    for (;;) {
+        pulse_data_t *data = calloc(1, sizeof(*data));
+        if (!data) {
+            fprintf(stderr, "load_corpus: calloc failed\n");
+            count = -1;
+            break;
+        }
+        pulse_data_load(file, data, 1000000); // in us
+        if (!data->num_pulses) {
+            pulse_data_free(data);
+            free(data);
+            break;
+        }
+        list_push(corpus, data);
+        count++;
+    }
+    fclose(file);
+    return count;
+}
+
+static void free_package(void *p)
+{
+    pulse_data_free(p);
+    free(p);
+}
+
+/// Rescale the widths of a package to the sample rate, drops the final gap.
+static void rescale_package(pulse_data_t *data, uint32_t rate)
+{
+    double scale = (double)rate / data->sample_rate;
+    for (unsigned i = 0; i < data->num_pulses; ++i) {
+        data->pulse[i] = data->pulse[i] > 0 ? (int)(data->pulse[i] * scale + 0.5) : 0;
+        data->gap[i]   = data->gap[i] > 0 ? (int)(data->gap[i] * scale + 0.5) : 0;
+        if (data->pulse[i] < 1)
+            data->pulse[i] = 1;
+    }
+    data->gap[data->num_pulses - 1] = 0;
+    data->sample_rate = rate;
+}
+
+static unsigned package_len(pulse_data_t const *data)
+{
+    unsigned len = 0;
+    for (unsigned i = 0; i < data->num_pulses; ++i)
+        len += (unsigned)(data->pulse[i] + data->gap[i]);
+    return len;
+}
+
+/// Set the carrier of a transmission for the current pulse or gap.
+static void tx_tune(tx_t *tx, double dev)
+{
+    sensor_t const *s = tx->sensor;
+    double omega = s->omega;
+    if (s->fsk)
+        omega += tx->in_gap ? -dev : dev;
+    tx->rot_re = (float)cos(omega);
+    tx->rot_im = (float)sin(omega);
+    // renormalize the phasor against the float rounding
+    float mag = sqrtf(tx->re * tx->re + tx->im * tx->im);
+    tx->re /= mag;
+    tx->im /= mag;
+}
+
+/// Start the transmission of a sensor, checks for overlaps with the transmissions in progress.
+static tx_t *tx_start(gen_t *gen, sensor_t *s)
+{
+    tx_t *tx = &gen->txs[gen->num_txs++];
+    memset(tx, 0, sizeof(*tx));
+    tx->sensor    = s;
+    tx->end       = s->next + package_len(s->pkg);
+    tx->left      = (unsigned)s->pkg->pulse[0];
+    double phase  = 2 * M_PI * rng_uniform(gen);
+    tx->re        = (float)cos(phase);
+    tx->im        = (float)sin(phase);
+    tx_tune(tx, gen->dev);
+    gen->sent++;
+
+    for (unsigned i = 0; i + 1 < gen->num_txs; ++i) {
+        tx_t *other = &gen->txs[i];
+        if (other->end > s->next) {
+            gen->collided += !other->collided + !tx->collided;
+            other->collided = 1;
+            tx->collided    = 1;
+        }
+    }
+
+    // make another sensor start during this transmission
+    if (gen->collide > 0.0 && gen->num_sensors > 1 && rng_uniform(gen) < gen->collide) {
+        sensor_t *o = &gen->sensors[rng_next(gen) % gen->num_sensors];
+        uint64_t at = s->next + (uint64_t)(rng_uniform(gen) * (tx->end - s->next));
+        if (o != s && o->next > at)
+            o->next = at;
+    }
+
+    double jitter = gen->interval_s * (0.9 + 0.2 * rng_uniform(gen));
+    s->next += (uint64_t)(jitter * gen->rate);
+    return tx;
+}
+
+/// Add the samples of a transmission to a block, returns 1 once the transmission ended.
+static int tx_render(gen_t *gen, tx_t *tx, float *iq, unsigned len)
+{
+    sensor_t const *s      = tx->sensor;
+    pulse_data_t const *pd = s->pkg;
+    unsigned pos = 0;
+    while (pos < len) {
+        unsigned n = tx->left < len - pos ? tx->left : len - pos;
+        if (!tx->in_gap || s->fsk) {
+            float re = tx->re;
+            float im = tx->im;
+            for (unsigned k = pos; k < pos + n; ++k) {
+                iq[2 * k] += s->amp * re;
+                iq[2 * k + 1] += s->amp * im;
+                float t = re * tx->rot_re - im * tx->rot_im;
+                im      = re * tx->rot_im + im * tx->rot_re;
+                re      = t;
+            }
+            tx->re = re;
+            tx->im = im;
+        }
+        pos += n;
+        tx->left -= n;
+        while (!tx->left) {
+            if (tx->in_gap) {
+                if (++tx->idx >= pd->num_pulses)
+                    return 1;
+                tx->in_gap = 0;
+                tx->left   = (unsigned)pd->pulse[tx->idx];
+            }
+            else {
+                tx->in_gap = 1;
+                tx->left   = (unsigned)pd->gap[tx->idx];
+                if (!tx->left && tx->idx + 1 >= pd->num_pulses)
+                    return 1;
+            }
+            tx_tune(tx, gen->dev);
+        }
+    }
+    return 0;
+}
+
+/// Generate a block of samples starting at a sample offset.
+static void gen_block(gen_t *gen, float *iq, unsigned len, uint64_t at)
+{
+    for (unsigned k = 0; k < len; ++k) {
+        uint64_t r    = rng_next(gen);
+        iq[2 * k]     = gen->noise[r & (NOISE_TABLE - 1)];
+        iq[2 * k + 1] = gen->noise[(r >> 16) & (NOISE_TABLE - 1)];
+    }
+
+    // continue the transmissions of earlier blocks
+    for (unsigned i = 0; i < gen->num_txs; ++i)
+        gen->txs[i].done = tx_render(gen, &gen->txs[i], iq, len);
+
+    // start the transmissions in time order, the ended ones are kept to check the overlaps
+    for (;;) {
+        sensor_t *first = NULL;
+        for (unsigned i = 0; i < gen->num_sensors; ++i) {
+            sensor_t *s = &gen->sensors[i];
+            if (s->next < at + len && (!first || s->next < first->next))
+                first = s;
+        }
+        if (!first)
+            break;
+        // a sensor with a transmission in this block skips to the next block
+        int busy = 0;
+        for (unsigned i = 0; i < gen->num_txs; ++i)
+            busy |= gen->txs[i].sensor == first;
+        if (busy) {
+            first->next = at + len;
+            continue;
+        }
+        unsigned start = first->next > at ? (unsigned)(first->next - at) : 0;
+        tx_t *tx       = tx_start(gen, first);
+        tx->done       = tx_render(gen, tx, iq + 2 * start, len - start);
+    }
+
+    for (unsigned i = 0; i < gen->num_txs;) {
+        if (gen->txs[i].done)
+            gen->txs[i] = gen->txs[--gen->num_txs];
+        else
+            ++i;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t rate        = DEFAULT_RATE;
+    unsigned num_sensors = DEFAULT_SENSORS;
+    double interval_s    = DEFAULT_INTERVAL;
+    double duration_s    = DEFAULT_DURATION;
+    double snr_min       = 20.0;
+    double snr_max       = 30.0;
+    double noise_db      = -30.0;
+    double offset_hz     = -1.0;
+    double dev_hz        = -1.0;
+    int modulation       = -1; // from the packages
+    double collide       = 0.0;
+    uint64_t seed        = 1;
+    int sample_size      = 0;
+    char *out_path       = NULL;
+    char *tcp_arg        = NULL;
+    int realtime         = 0;
+    list_t corpus        = {0};
+
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; ++i) {
+        char opt = argv[i][1];
+        if (opt == 't') {
+            realtime = 1;
+            continue;
+        }
+        if (i + 1 >= argc)
+            usage();
+        char *arg = argv[++i];
+        if (opt == 's')
+            rate = atouint32_metric(arg, "-s: ");
+        else if (opt == 'n')
+            num_sensors = (unsigned)atoi(arg);
+        else if (opt == 'i')
+            interval_s = atof(arg);
+        else if (opt == 'd')
+            duration_s = atof(arg);
+        else if (opt == 'S') {
+            char *sep = strchr(arg, ':');
+            snr_min   = atof(arg);
+            snr_max   = sep ? atof(sep + 1) : snr_min;
+        }
+        else if (opt == 'N')
+            noise_db = atof(arg);
+        else if (opt == 'F')
+            offset_hz = atof(arg);
+        else if (opt == 'D')
+            dev_hz = atof(arg);
+        else if (opt == 'M' && !strcasecmp(arg, "ook"))
+            modulation = 0;
+        else if (opt == 'M' && !strcasecmp(arg, "fsk"))
+            modulation = 1;
+        else if (opt == 'c')
+            collide = atof(arg);
+        else if (opt == 'r')
+            seed = (uint64_t)strtoull(arg, NULL, 10);
+        else if (opt == 'p') {
+            pulse_data_t *data = calloc(1, sizeof(*data));
+            if (!data) {
+                fprintf(stderr, "calloc failed\n");
+                return 1;
+            }
+            if (!rfraw_check(arg) || !rfraw_parse(data, arg) || !data->num_pulses) {
+                fprintf(stderr, "Invalid rfraw code %s\n", arg);
+                return 1;
+            }
+            list_push(&corpus, data);
+        }
+        else if (opt == 'f' && !strcasecmp(arg, "cu8"))
+            sample_size = 2;
+        else if (opt == 'f' && !strcasecmp(arg, "cs16"))
+            sample_size = 4;
+        else if (opt == 'w')
+            out_path = arg;
+        else if (opt == 'T')
+            tcp_arg = arg;
+        else
+            usage();
+    }
+    for (; i < argc; ++i) {
+        if (load_corpus(&corpus, argv[i]) < 0)
+            return 1;
+    }
+    if (!corpus.len || !num_sensors || !rate || interval_s <= 0.0 || (!out_path && !tcp_arg))
+        usage();
+    if (!sample_size)
+        sample_size = out_path && str_endswith(out_path, ".cs16") ? 4 : 2;
+    if (duration_s <= 0.0 && out_path && strcmp(out_path, "-") && !tcp_arg) {
+        fprintf(stderr, "An endless run needs stdout or rtl_tcp output\n");
+        return 1;
+    }
+
+    gen_t *gen = calloc(1, sizeof(*gen));
+    if (!gen) {
+        fprintf(stderr, "calloc failed\n");
+        return 1;
+    }
+    gen->sensors = calloc(num_sensors, sizeof(*gen->sensors));
+    if (!gen->sensors) {
+        fprintf(stderr, "calloc failed\n");
+        return 1;
+    }
+    gen->txs = calloc(num_sensors, sizeof(*gen->txs));
+    if (!gen->txs) {
+        fprintf(stderr, "calloc failed\n");
+        return 1;
+    }
+    gen->rate        = rate;
+    gen->interval_s  = interval_s;
+    gen->collide     = collide;
+    gen->num_sensors = num_sensors;
+    gen->rng         = seed * 0x9E3779B97F4A7C15ULL + 1;
+    gen->dev         = 2 * M_PI * (dev_hz >= 0.0 ? dev_hz : rate / 10.0) / rate;
+    if (offset_hz < 0.0)
+        offset_hz = rate / 20.0;
+
+    for (void **iter = corpus.elems; iter && *iter; ++iter)
+        rescale_package(*iter, rate);
+
+    // Gaussian noise of the level, per component
+    double noise_pow = pow(10.0, noise_db / 10.0);
+    double sigma     = sqrt(noise_pow / 2);
+    for (unsigned k = 0; k < NOISE_TABLE; k += 2) {
+        double u1 = rng_uniform(gen);
+        double u2 = rng_uniform(gen);
+        double r  = sqrt(-2.0 * log(1.0 - u1)) * sigma;
+        gen->noise[k]     = (float)(r * cos(2 * M_PI * u2));
+        gen->noise[k + 1] = (float)(r * sin(2 * M_PI * u2));
+    }
+
+    for (unsigned k = 0; k < num_sensors; ++k) {
+        sensor_t *s = &gen->sensors[k];
+        s->pkg      = corpus.elems[k % corpus.len];
+        s->fsk      = modulation >= 0 ? modulation : s->pkg->freq2_hz != 0.0f;
+        double snr  = snr_min + (snr_max - snr_min) * rng_uniform(gen);
+        s->amp      = (float)sqrt(noise_pow * pow(10.0, snr / 10.0));
+        s->omega    = 2 * M_PI * offset_hz * (2 * rng_uniform(gen) - 1) / rate;
+        s->next     = (uint64_t)(interval_s * rate * rng_uniform(gen));
+    }
+
+    FILE *file = NULL;
+    if (out_path && !strcmp(out_path, "-")) {
+        file = stdout;
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    }
+    else if (out_path) {
+        file = fopen(out_path, "wb");
+        if (!file) {
+            fprintf(stderr, "Failed to open %s\n", out_path);
+            return 1;
+        }
+    }
+
+    r_cfg_t *cfg             = NULL;
+    struct raw_output *server = NULL;
+    if (tcp_arg) {
+        char *host = "localhost";
+        char *port = "1234";
+        hostport_param(tcp_arg, &host, &port);
+        cfg = r_create_cfg();
+        cfg->samp_rate           = rate;
+        cfg->demod->sample_size  = sample_size;
+        rtltcp_output_opts_t opts = {0};
+        server = raw_output_rtltcp_create(host, port, cfg, &opts);
+        if (!server)
+            return 1;
+        fprintf(stderr, "rtl_tcp server at %s port %s\n", host, port);
+        realtime = 1;
+    }
+
+    float *iq = malloc(sizeof(*iq) * 2 * BLOCK_SAMPLES);
+    if (!iq) {
+        fprintf(stderr, "malloc failed\n");
+        return 1;
+    }
+    uint8_t *buf = malloc((size_t)sample_size * BLOCK_SAMPLES);
+    if (!buf) {
+        fprintf(stderr, "malloc failed\n");
+        return 1;
+    }
+
+    uint64_t total  = (uint64_t)(duration_s * rate);
+    uint64_t at     = 0;
+    double begin_us = monotonic_time_us();
+    while (!total || at < total) {
+        unsigned len = total && total - at < BLOCK_SAMPLES ? (unsigned)(total - at) : BLOCK_SAMPLES;
+
+        gen_block(gen, iq, len, at);
+
+        if (sample_size == 2) {
+            for (unsigned k = 0; k < 2 * len; ++k) {
+                float v = 127.5f + 127.5f * iq[k];
+                buf[k]  = v < 0.0f ? 0 : v > 255.0f ? 255 : (uint8_t)(v + 0.5f);
+            }
+        }
+        else {
+            int16_t *s16 = (int16_t *)buf;
+            for (unsigned k = 0; k < 2 * len; ++k) {
+                float v = 32767.0f * iq[k];
+                s16[k]  = v < -32768.0f ? -32768 : v > 32767.0f ? 32767 : (int16_t)lrintf(v);
+            }
+        }
+
+        at += len;
+        if (realtime)
+            monotonic_sleep_until_us(begin_us + at * 1e6 / rate);
+        if (file && fwrite(buf, (size_t)sample_size, len, file) != len) {
+            fprintf(stderr, "Write failed\n");
+            break;
+        }
+        if (server)
+            raw_output_frame(server, buf, (uint32_t)(sample_size * len));
+    }
+
+    fprintf(stderr, "Generated %.1f s at %u Hz as %s: %u sensors, %.0f s interval, %llu transmissions, %llu collided (%.1f%%)\n",
+            (double)at / rate, rate, sample_size == 2 ? "CU8" : "CS16",
+            num_sensors, interval_s,
+            (unsigned long long)gen->sent, (unsigned long long)gen->collided,
+            gen->sent ? 100.0 * gen->collided / gen->sent : 0.0);
+
+    if (file && file != stdout)
+        fclose(file);
+    raw_output_free(server);
+    if (cfg) {
+        r_free_cfg(cfg);
+        free(cfg);
+    }
+    free(buf);
+    free(iq);
+    free(gen->txs);
+    free(gen->sensors);
+    free(gen);
+    list_free_elems(&corpus, free_package);
+    return 0;
+}